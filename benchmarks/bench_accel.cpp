@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file
+ * \brief Microbenchmarks for the acceleration schemes run by run_accel().
+ */
+#include "config.h"
+
+extern "C" {
+#include "nfa/accel.h" // run_accel has C linkage
+}
+
+#include "benchmarks.h"
+#include "nfa/accelcompile.h"
+#include "util/charreach.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace ue2;
+
+namespace {
+
+/** \brief Hit densities (average bytes between stops) to benchmark; zero
+ * means no stops at all. */
+static const size_t ACCEL_DENSITIES[] = {0, 4096, 256, 64, 16};
+
+const char *accelTypeName(u8 type) {
+    switch (type) {
+    case ACCEL_VERM:
+        return "verm";
+    case ACCEL_VERM_NOCASE:
+        return "verm_nocase";
+    case ACCEL_DVERM:
+        return "dverm";
+    case ACCEL_DVERM_NOCASE:
+        return "dverm_nocase";
+    case ACCEL_DVERM_MASKED:
+        return "dverm_masked";
+    case ACCEL_SHUFTI:
+        return "shufti";
+    case ACCEL_DSHUFTI:
+        return "dshufti";
+    case ACCEL_TRUFFLE:
+        return "truffle";
+    default:
+        return "other";
+    }
+}
+
+/** \brief An acceleration scheme built from a set of stops, with the bytes
+ * that may be used around them. */
+struct AccelCase {
+    AccelInfo info;
+    string hit;        //!< string placed at each stop
+    string background; //!< bytes that never stop the scheme
+};
+
+/** \brief All bytes except those in \a cr. */
+string bytesOutside(const CharReach &cr) {
+    string rv;
+    for (u32 c = 0; c < 256; c++) {
+        if (!cr.test(c)) {
+            rv.push_back((char)c);
+        }
+    }
+    return rv;
+}
+
+AccelCase singleCase(const CharReach &stops, const string &hit) {
+    AccelCase ac;
+    ac.info.single_stops = stops;
+    ac.hit = hit;
+    ac.background = bytesOutside(stops);
+    return ac;
+}
+
+AccelCase doubleCase(const vector<pair<u8, u8>> &pairs) {
+    AccelCase ac;
+    CharReach used;
+    for (const auto &p : pairs) {
+        ac.info.double_stop2.insert(p);
+        used.set(p.first);
+        used.set(p.second);
+    }
+    ac.hit = string(1, pairs.front().first) + (char)pairs.front().second;
+    ac.background = bytesOutside(used);
+    return ac;
+}
+
+vector<AccelCase> accelCases() {
+    vector<AccelCase> cases;
+
+    cases.push_back(singleCase(CharReach('a'), "a"));
+    cases.push_back(singleCase(CharReach("aA"), "A"));
+    cases.push_back(doubleCase({{'a', 'b'}}));
+    cases.push_back(doubleCase({{'a', 'b'}, {'A', 'b'}, {'a', 'B'},
+                                {'A', 'B'}}));
+    cases.push_back(doubleCase({{'a', 'b'}, {'a', 'c'}}));
+    cases.push_back(singleCase(CharReach("aq#7Z\n"), "#"));
+    cases.push_back(doubleCase({{'a', 'b'}, {'c', 'd'}, {'e', 'f'},
+                                {'g', 'h'}, {'q', 'z'}}));
+
+    // Enough distinct stops that shufti's buckets run out.
+    CharReach wide;
+    for (u32 c = 0; c < 256; c += 7) {
+        wide.set(c);
+    }
+    cases.push_back(singleCase(wide, string(1, (char)wide.find_first())));
+
+    return cases;
+}
+
+} // namespace
+
+void addAccelBenchmarks(vector<Benchmark> &out, u32 seed) {
+    BenchRng rng(seed);
+
+    for (const auto &ac : accelCases()) {
+        auto aux = make_shared<AccelAux>();
+        memset(aux.get(), 0, sizeof(AccelAux));
+        if (!buildAccelAux(ac.info, aux.get())) {
+            continue;
+        }
+
+        for (size_t density : ACCEL_DENSITIES) {
+            auto data = make_shared<string>(makeBenchData(
+                rng, BENCH_BUFFER_SIZE, ac.background, ac.hit, density));
+
+            string name = string("accel/") + accelTypeName(aux->accel_type) +
+                          "/" + (density ? to_string(density) : "none");
+            out.emplace_back(name, "B", data->size(), [aux, data]() {
+                const u8 *p = (const u8 *)data->data();
+                const u8 *end = p + data->size();
+                u64a stops = 0;
+                while (p < end) {
+                    p = run_accel(aux.get(), p, end);
+                    if (p >= end) {
+                        break;
+                    }
+                    stops++;
+                    p++;
+                }
+                return stops;
+            });
+        }
+    }
+}
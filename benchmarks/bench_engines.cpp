@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file
+ * \brief Microbenchmarks for the NFA and DFA engines: LimEx, McClellan and
+ * Sheng.
+ */
+#include "config.h"
+
+#include "benchmarks.h"
+#include "grey.h"
+#include "compiler/compiler.h"
+#include "nfa/mcclellancompile.h"
+#include "nfa/nfa_api.h"
+#include "nfa/nfa_api_queue.h"
+#include "nfa/nfa_internal.h"
+#include "nfa/rdfa.h"
+#include "nfa/shengcompile.h"
+#include "nfagraph/ng.h"
+#include "nfagraph/ng_limex.h"
+#include "nfagraph/ng_mcclellan.h"
+#include "nfagraph/ng_util.h"
+#include "util/alloc.h"
+#include "util/compile_context.h"
+#include "util/report_manager.h"
+#include "util/target_info.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace ue2;
+
+namespace {
+
+static const u32 MATCH_REPORT = 1024;
+
+/** \brief Bytes in the engine scan data, between pattern fragments. */
+static const string ENGINE_ALPHABET = "abcdefghijklmnopqrstuvwxyz0123456789 \n";
+
+/** \brief Pattern for the LimEx benchmarks, small enough for every model. */
+static const char *LIMEX_PATTERN = "(foo|bar)[^\\n]{0,8}baz[a-z]qux";
+
+struct EngineCase {
+    const char *name;
+    const char *expr;
+};
+
+/** \brief DFA patterns: Sheng and McClellan-8 sized, then one needing
+ * McClellan-16. */
+static const EngineCase DFA_CASES[] = {
+    {"small", "foo[^\\n]*bar"},
+    {"medium", "(foo|bar)[a-z]{20}baz"},
+    {"large", "[0-9][a-z]{300}"},
+};
+
+int countMatch(u64a, u64a, ReportID, void *ctx) {
+    (*(u64a *)ctx)++;
+    return MO_CONTINUE_MATCHING;
+}
+
+/** \brief Scan data with fragments of the benchmark patterns among noise. */
+string makeEngineData(BenchRng &rng) {
+    static const char *fragments[] = {"foo", "bar", "baz", "qux", "foobar",
+                                      "7"};
+    string data = makeBenchData(rng, BENCH_BUFFER_SIZE, ENGINE_ALPHABET, "",
+                                0);
+    for (size_t i = 0; i < BENCH_BUFFER_SIZE / 32; i++) {
+        const string frag = fragments[rng() % ARRAY_LENGTH(fragments)];
+        data.replace(rng() % (data.size() - frag.size() + 1), frag.size(),
+                     frag);
+    }
+    return data;
+}
+
+/** \brief Builds the graph for \a expr with all matches raising
+ * \ref MATCH_REPORT. */
+unique_ptr<NGWrapper> buildGraph(ReportManager &rm, const CompileContext &cc,
+                                 const char *expr) {
+    ParsedExpression parsed(0, expr, 0, 0);
+    unique_ptr<NGWrapper> g = buildWrapper(rm, cc, parsed);
+    if (g) {
+        clearReports(*g);
+        rm.setProgramOffset(0, MATCH_REPORT);
+    }
+    return g;
+}
+
+/** \brief Adds a benchmark that runs \a nfa over all of \a data. */
+void addEngine(vector<Benchmark> &out, const string &name,
+               aligned_unique_ptr<NFA> built, shared_ptr<string> data) {
+    if (!built) {
+        return;
+    }
+    shared_ptr<NFA> nfa = move(built);
+    shared_ptr<char> full_state =
+        aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+    shared_ptr<char> stream_state =
+        aligned_zmalloc_unique<char>(nfa->streamStateSize);
+
+    out.emplace_back(name, "B", data->size(),
+                     [nfa, full_state, stream_state, data]() {
+        u64a matches = 0;
+        struct mq q;
+        q.nfa = nfa.get();
+        q.cur = 0;
+        q.end = 0;
+        q.state = full_state.get();
+        q.streamState = stream_state.get();
+        q.offset = 0;
+        q.buffer = (const u8 *)data->data();
+        q.length = data->size();
+        q.history = nullptr;
+        q.hlength = 0;
+        q.scratch = nullptr;
+        q.report_current = 0;
+        q.cb = countMatch;
+        q.context = &matches;
+
+        nfaQueueInitState(nfa.get(), &q);
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_TOP, 0);
+        pushQueue(&q, MQE_END, data->size());
+        nfaQueueExec(nfa.get(), &q, data->size());
+        return matches;
+    });
+}
+
+const char *limexName(u32 type) {
+    switch (type) {
+    case LIMEX_NFA_32:
+        return "limex32";
+    case LIMEX_NFA_128:
+        return "limex128";
+    case LIMEX_NFA_256:
+        return "limex256";
+    case LIMEX_NFA_384:
+        return "limex384";
+    case LIMEX_NFA_512:
+        return "limex512";
+    default:
+        return "limex";
+    }
+}
+
+} // namespace
+
+void addEngineBenchmarks(vector<Benchmark> &out, u32 seed) {
+    BenchRng rng(seed);
+    auto data = make_shared<string>(makeEngineData(rng));
+
+    const CompileContext cc(false, false, get_current_target(), Grey());
+
+    {
+        ReportManager rm(cc.grey);
+        auto g = buildGraph(rm, cc, LIMEX_PATTERN);
+        if (g) {
+            const map<u32, u32> fixed_depth_tops;
+            const map<u32, vector<vector<CharReach>>> triggers;
+            for (u32 type = LIMEX_NFA_32; type <= LIMEX_NFA_512; type++) {
+                addEngine(out, string("nfa/") + limexName(type),
+                          constructNFA(*g, &rm, fixed_depth_tops, triggers,
+                                       false, type, cc),
+                          data);
+            }
+        }
+    }
+
+    for (const auto &dc : DFA_CASES) {
+        ReportManager rm(cc.grey);
+        auto g = buildGraph(rm, cc, dc.expr);
+        if (!g) {
+            continue;
+        }
+        unique_ptr<raw_dfa> rdfa = buildMcClellan(*g, &rm, cc.grey);
+        if (!rdfa) {
+            continue;
+        }
+
+        raw_dfa rdfa_sheng = *rdfa;
+        auto mcclellan = mcclellanCompile(*rdfa, cc, rm);
+        if (mcclellan) {
+            const char *kind =
+                mcclellan->type == MCCLELLAN_NFA_8 ? "mcclellan8"
+                                                   : "mcclellan16";
+            addEngine(out, string("dfa/") + kind + "/" + dc.name,
+                      move(mcclellan), data);
+        }
+        addEngine(out, string("dfa/sheng/") + dc.name,
+                  shengCompile(rdfa_sheng, cc, rm), data);
+    }
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file
+ * \brief Microbenchmarks for the literal matchers: noodle and FDR/Teddy.
+ */
+#include "config.h"
+
+#include "benchmarks.h"
+#include "grey.h"
+#include "fdr/fdr.h"
+#include "fdr/fdr_compile.h"
+#include "fdr/fdr_internal.h"
+#include "fdr/teddy_engine_description.h"
+#include "hwlm/hwlm_literal.h"
+#include "hwlm/noodle_build.h"
+#include "hwlm/noodle_engine.h"
+#include "hwlm/noodle_internal.h"
+#include "util/target_info.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace ue2;
+
+namespace {
+
+/** \brief Average bytes between literal occurrences in the scan data. */
+static const size_t LITERAL_DENSITY = 512;
+
+/** \brief Literal lengths benchmarked with noodle. */
+static const size_t NOODLE_LENGTHS[] = {1, 2, 4, 8, 16};
+
+/** \brief Literal counts benchmarked with FDR/Teddy. */
+static const size_t FDR_COUNTS[] = {1, 8, 16, 32, 64, 128, 256, 1000, 10000};
+
+static const string LOWER = "abcdefghijklmnopqrstuvwxyz";
+
+hwlmcb_rv_t countMatch(size_t, size_t, u32, void *ctx) {
+    (*(u64a *)ctx)++;
+    return HWLM_CONTINUE_MATCHING;
+}
+
+string randomString(BenchRng &rng, size_t len) {
+    string s;
+    for (size_t i = 0; i < len; i++) {
+        s.push_back(LOWER[rng() % LOWER.size()]);
+    }
+    return s;
+}
+
+/** \brief Builds scan data containing the given literals, chosen at random,
+ * about once every \ref LITERAL_DENSITY bytes. */
+string makeLiteralData(BenchRng &rng, const vector<hwlmLiteral> &lits) {
+    string data = makeBenchData(rng, BENCH_BUFFER_SIZE, LOWER, "", 0);
+    for (size_t i = 0; i < BENCH_BUFFER_SIZE / LITERAL_DENSITY; i++) {
+        const string &s = lits[rng() % lits.size()].s;
+        if (s.size() <= data.size()) {
+            data.replace(rng() % (data.size() - s.size() + 1), s.size(), s);
+        }
+    }
+    return data;
+}
+
+void addNoodle(vector<Benchmark> &out, BenchRng &rng) {
+    for (size_t len : NOODLE_LENGTHS) {
+        vector<hwlmLiteral> lits;
+        lits.emplace_back(randomString(rng, len), false, 0);
+        auto data = make_shared<string>(makeLiteralData(rng, lits));
+        shared_ptr<noodTable> n = noodBuildTable(lits.front());
+
+        out.emplace_back("noodle/len" + to_string(len), "B", data->size(),
+                         [n, data]() {
+            u64a matches = 0;
+            noodExec(n.get(), (const u8 *)data->data(), data->size(), 0,
+                     countMatch, &matches);
+            return matches;
+        });
+    }
+
+    for (size_t count = 2; count <= NOOD_MULTI_MAX_LITS; count++) {
+        vector<hwlmLiteral> lits;
+        for (u32 i = 0; i < count; i++) {
+            lits.emplace_back(randomString(rng, 6), false, i);
+        }
+        auto data = make_shared<string>(makeLiteralData(rng, lits));
+        shared_ptr<noodMultiTable> n = noodBuildMultiTable(lits);
+        if (!n) {
+            continue;
+        }
+
+        out.emplace_back("noodle/multi" + to_string(count), "B",
+                         data->size(), [n, data]() {
+            u64a matches = 0;
+            noodExecMulti(n.get(), (const u8 *)data->data(), data->size(), 0,
+                          countMatch, &matches, HWLM_ALL_GROUPS);
+            return matches;
+        });
+    }
+}
+
+void addFdr(vector<Benchmark> &out, BenchRng &rng) {
+    const target_t target = get_current_target();
+    const Grey grey;
+
+    for (size_t count : FDR_COUNTS) {
+        vector<hwlmLiteral> lits;
+        for (u32 i = 0; i < count; i++) {
+            lits.emplace_back(randomString(rng, 4 + rng() % 13), false, i);
+        }
+        auto data = make_shared<string>(makeLiteralData(rng, lits));
+        shared_ptr<FDR> fdr = fdrBuildTable(lits, false, target, grey);
+        if (!fdr) {
+            continue;
+        }
+
+        const char *engine =
+            getTeddyDescription(fdr->engineID) ? "teddy" : "fdr";
+        out.emplace_back(string("literal/") + engine + "/" + to_string(count),
+                         "B", data->size(), [fdr, data]() {
+            u64a matches = 0;
+            fdrExec(fdr.get(), (const u8 *)data->data(), data->size(), 0,
+                    countMatch, &matches, HWLM_ALL_GROUPS);
+            return matches;
+        });
+    }
+}
+
+} // namespace
+
+void addLiteralBenchmarks(vector<Benchmark> &out, u32 seed) {
+    BenchRng rng(seed);
+    addNoodle(out, rng);
+    addFdr(out, rng);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file
+ * \brief Microbenchmarks for multibit iteration and update.
+ */
+#include "config.h"
+
+#include "benchmarks.h"
+#include "util/multibit.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+/** \brief Multibit sizes, covering the flat model and one, two and three
+ * levels of summary. */
+static const u32 MULTIBIT_SIZES[] = {64, 1000, 100000, 1000000};
+
+/** \brief Proportion of bits set, as one bit in N. */
+static const u32 MULTIBIT_DENSITIES[] = {2, 64, 4096};
+
+} // namespace
+
+void addMultibitBenchmarks(vector<Benchmark> &out, u32 seed) {
+    BenchRng rng(seed);
+
+    for (u32 total_bits : MULTIBIT_SIZES) {
+        for (u32 density : MULTIBIT_DENSITIES) {
+            if (total_bits / density == 0) {
+                continue;
+            }
+
+            auto bits = shared_ptr<u8>(new u8[mmbit_size(total_bits)],
+                                       default_delete<u8[]>());
+            mmbit_clear(bits.get(), total_bits);
+            auto keys = make_shared<vector<u32>>();
+            for (u32 i = 0; i < total_bits / density; i++) {
+                u32 key = rng() % total_bits;
+                if (!mmbit_set(bits.get(), total_bits, key)) {
+                    keys->push_back(key);
+                }
+            }
+
+            const string suffix =
+                "/" + to_string(total_bits) + "/1in" + to_string(density);
+
+            out.emplace_back("multibit/iterate" + suffix, "bit", total_bits,
+                             [bits, total_bits]() {
+                u64a sum = 0;
+                for (u32 i = mmbit_iterate(bits.get(), total_bits,
+                                           MMB_INVALID);
+                     i != MMB_INVALID;
+                     i = mmbit_iterate(bits.get(), total_bits, i)) {
+                    sum += i;
+                }
+                return sum;
+            });
+
+            // Sets the keys in random order into an empty multibit, then
+            // clears them again.
+            auto scratch = shared_ptr<u8>(new u8[mmbit_size(total_bits)],
+                                          default_delete<u8[]>());
+            mmbit_clear(scratch.get(), total_bits);
+            out.emplace_back("multibit/set_unset" + suffix, "key",
+                             keys->size(), [scratch, keys, total_bits]() {
+                u64a already = 0;
+                for (u32 key : *keys) {
+                    already += mmbit_set(scratch.get(), total_bits, key);
+                }
+                for (u32 key : *keys) {
+                    mmbit_unset(scratch.get(), total_bits, key);
+                }
+                return already;
+            });
+        }
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file
+ * \brief Microbenchmarks for runtime primitives: common declarations.
+ */
+
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "ue2common.h"
+
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * \brief A single microbenchmark.
+ *
+ * Each call to \a run processes \a units units of input (bytes, or bits for
+ * the multibit benchmarks) and returns a value derived from the result, such
+ * as a match count, so that the work cannot be optimised away.
+ */
+struct Benchmark {
+    Benchmark(std::string name_in, const char *unit_in, size_t units_in,
+              std::function<unsigned long long()> run_in)
+        : name(std::move(name_in)), unit(unit_in), units(units_in),
+          run(std::move(run_in)) {}
+
+    std::string name;
+    const char *unit;
+    size_t units;
+    std::function<unsigned long long()> run;
+};
+
+/** \brief Size in bytes of the scan buffers used by the benchmarks. */
+static const size_t BENCH_BUFFER_SIZE = 64 * 1024;
+
+/** \brief Fixed-seed generator, so that every run sees the same data. */
+using BenchRng = std::mt19937;
+
+/**
+ * \brief Builds a buffer of \a len random bytes drawn from \a background, with
+ * \a hit inserted at random positions roughly once every \a density bytes. A
+ * \a density of zero means no hits.
+ */
+std::string makeBenchData(BenchRng &rng, size_t len,
+                          const std::string &background,
+                          const std::string &hit, size_t density);
+
+void addAccelBenchmarks(std::vector<Benchmark> &out, u32 seed);
+void addLiteralBenchmarks(std::vector<Benchmark> &out, u32 seed);
+void addEngineBenchmarks(std::vector<Benchmark> &out, u32 seed);
+void addMultibitBenchmarks(std::vector<Benchmark> &out, u32 seed);
+
+#endif // BENCHMARKS_H
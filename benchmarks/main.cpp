@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "config.h"
+
+#include "benchmarks.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+using namespace std;
+
+namespace {
+
+/** \brief Options gathered from the command line. */
+struct Options {
+    string filter;            //!< only run benchmarks whose name contains this
+    unsigned int trials = 5;  //!< timed trials per benchmark
+    unsigned int trialMs = 20; //!< minimum duration of each trial
+    unsigned int seed = 0;    //!< seed for generated data
+    bool listOnly = false;
+};
+
+void usage(const char *name, const char *error) {
+    printf("Usage: %s [OPTIONS...]\n\n", name);
+    printf("Options:\n\n");
+    printf("  -h              Display help and exit.\n");
+    printf("  -f STRING       Only run benchmarks whose name contains "
+           "STRING.\n");
+    printf("  -n NUM          Run NUM timed trials of each benchmark "
+           "(default: 5).\n");
+    printf("  -t MSEC         Run each trial for at least MSEC milliseconds "
+           "(default: 20).\n");
+    printf("  -z NUM          Seed for generated data (default: 0).\n");
+    printf("  -l              List benchmarks and exit.\n");
+    if (error) {
+        printf("Error: %s\n", error);
+    }
+}
+
+bool parseUnsigned(const char *s, unsigned int *out) {
+    char *end = nullptr;
+    unsigned long val = strtoul(s, &end, 10);
+    if (!*s || *end || val > 0xffffffffUL) {
+        return false;
+    }
+    *out = (unsigned int)val;
+    return true;
+}
+
+void processArgs(int argc, char *argv[], Options &opts) {
+    static const char *options = "f:hln:t:z:";
+    int in;
+    while ((in = getopt(argc, argv, options)) != -1) {
+        switch (in) {
+        case 'f':
+            opts.filter = optarg;
+            break;
+        case 'h':
+            usage(argv[0], nullptr);
+            exit(0);
+        case 'l':
+            opts.listOnly = true;
+            break;
+        case 'n':
+            if (!parseUnsigned(optarg, &opts.trials) || !opts.trials) {
+                usage(argv[0], "Couldn't parse argument to -n flag.");
+                exit(1);
+            }
+            break;
+        case 't':
+            if (!parseUnsigned(optarg, &opts.trialMs) || !opts.trialMs) {
+                usage(argv[0], "Couldn't parse argument to -t flag.");
+                exit(1);
+            }
+            break;
+        case 'z':
+            if (!parseUnsigned(optarg, &opts.seed)) {
+                usage(argv[0], "Couldn't parse argument to -z flag.");
+                exit(1);
+            }
+            break;
+        default:
+            usage(argv[0], "Unrecognised command line argument.");
+            exit(1);
+        }
+    }
+
+    if (optind != argc) {
+        usage(argv[0], "Unexpected argument.");
+        exit(1);
+    }
+}
+
+using Clock = chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    chrono::duration<double> secs = Clock::now() - start;
+    return secs.count();
+}
+
+/**
+ * \brief Times \a b, returning the best time per unit in nanoseconds over
+ * all trials.
+ *
+ * The number of calls per trial is calibrated first, so that each trial runs
+ * for at least the requested time.
+ */
+double timeBenchmark(const Benchmark &b, const Options &opts) {
+    const double trialSecs = opts.trialMs / 1000.0;
+    u64a sink = 0;
+
+    size_t calls = 1;
+    for (;;) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < calls; i++) {
+            sink += b.run();
+        }
+        double secs = secondsSince(start);
+        if (secs >= trialSecs / 4) {
+            calls = max(calls, (size_t)(calls * trialSecs / secs));
+            break;
+        }
+        calls *= 2;
+    }
+
+    double best = 0;
+    for (unsigned int t = 0; t < opts.trials; t++) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < calls; i++) {
+            sink += b.run();
+        }
+        double nsPerUnit =
+            secondsSince(start) * 1e9 / ((double)calls * b.units);
+        if (!t || nsPerUnit < best) {
+            best = nsPerUnit;
+        }
+    }
+
+    // Keep the results live.
+    static volatile u64a result;
+    result = sink;
+    return best;
+}
+
+} // namespace
+
+/** \brief Builds a random buffer with hits at the requested density. */
+string makeBenchData(BenchRng &rng, size_t len, const string &background,
+                     const string &hit, size_t density) {
+    assert(!background.empty());
+    string data(len, 0);
+    for (auto &c : data) {
+        c = background[rng() % background.size()];
+    }
+
+    if (!density || hit.empty() || hit.size() > len) {
+        return data;
+    }
+
+    for (size_t i = 0; i < len / density; i++) {
+        size_t pos = rng() % (len - hit.size() + 1);
+        data.replace(pos, hit.size(), hit);
+    }
+    return data;
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    processArgs(argc, argv, opts);
+
+    vector<Benchmark> benchmarks;
+    addAccelBenchmarks(benchmarks, opts.seed);
+    addLiteralBenchmarks(benchmarks, opts.seed);
+    addEngineBenchmarks(benchmarks, opts.seed);
+    addMultibitBenchmarks(benchmarks, opts.seed);
+
+    if (!opts.filter.empty()) {
+        auto it = remove_if(benchmarks.begin(), benchmarks.end(),
+                            [&](const Benchmark &b) {
+            return b.name.find(opts.filter) == string::npos;
+        });
+        benchmarks.erase(it, benchmarks.end());
+    }
+
+    if (opts.listOnly) {
+        for (const auto &b : benchmarks) {
+            printf("%s\n", b.name.c_str());
+        }
+        return 0;
+    }
+
+    printf("%-40s %12s %14s %18s\n", "Benchmark", "ns/unit", "Munits/sec",
+           "Check");
+    for (const auto &b : benchmarks) {
+        // The result of a single call, which only depends on the data.
+        const u64a check = b.run();
+        double ns = timeBenchmark(b, opts);
+        printf("%-40s %8.3f/%-3s %14.1f %18llu\n", b.name.c_str(), ns, b.unit,
+               1000.0 / ns, check);
+        fflush(stdout);
+    }
+
+    return 0;
+}
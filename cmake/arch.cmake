@@ -2,6 +2,23 @@
 #
 # must be called after determining where compiler intrinsics are defined
 
+if (ARCH_AARCH64)
+    # Advanced SIMD, with the AArch64 forms of TBL, stands in for SSSE3; there
+    # are no wider vector targets to look for
+    set (CMAKE_REQUIRED_FLAGS "${CMAKE_C_FLAGS} ${EXTRA_C_FLAGS}")
+    CHECK_C_SOURCE_COMPILES("#include <arm_neon.h>
+int main() {
+    uint8x16_t a = vdupq_n_u8(1);
+    (void)vqtbl1q_u8(a, a);
+}" HAVE_NEON)
+
+    if (NOT HAVE_NEON)
+        message(FATAL_ERROR "AArch64 Advanced SIMD compiler support is required")
+    endif ()
+    unset (CMAKE_REQUIRED_FLAGS)
+    return ()
+endif ()
+
 if (HAVE_C_X86INTRIN_H)
     set (INTRIN_INC_H "x86intrin.h")
 elseif (HAVE_C_INTRIN_H)
@@ -23,6 +40,12 @@ if (NOT HAVE_SSSE3)
     message(FATAL_ERROR "A minimum of SSSE3 compiler support is required")
 endif ()
 
+if (FAT_RUNTIME)
+    # the fat runtime builds an AVX2 variant regardless of the host, so check
+    # that the compiler can target it
+    set (CMAKE_REQUIRED_FLAGS "${CMAKE_REQUIRED_FLAGS} -march=core-avx2")
+endif ()
+
 # now look for AVX2
 CHECK_C_SOURCE_COMPILES("#include <${INTRIN_INC_H}>
 #if !defined(__AVX2__)
@@ -35,8 +58,55 @@ int main(){
 }" HAVE_AVX2)
 
 if (NOT HAVE_AVX2)
+    if (FAT_RUNTIME)
+        message(FATAL_ERROR "AVX2 compiler support is required for the fat runtime")
+    endif ()
     message(STATUS "Building without AVX2 support")
 endif ()
 
+if (FAT_RUNTIME)
+    # the AVX512 variant of the fat runtime is only built if the compiler is
+    # able to target it
+    set (CMAKE_REQUIRED_FLAGS "${CMAKE_C_FLAGS} ${EXTRA_C_FLAGS} -march=skylake-avx512")
+endif ()
+
+# and now for AVX512BW
+CHECK_C_SOURCE_COMPILES("#include <${INTRIN_INC_H}>
+#if !defined(__AVX512BW__)
+#error no avx512bw
+#endif
+
+int main(){
+    __m512i z = _mm512_setzero_si512();
+    (void)_mm512_shuffle_epi8(z, z);
+}" HAVE_AVX512)
+
+if (NOT HAVE_AVX512)
+    message(STATUS "Building without AVX512 support")
+elseif (FAT_RUNTIME)
+    set (BUILD_AVX512 TRUE)
+endif ()
+
+if (FAT_RUNTIME)
+    set (CMAKE_REQUIRED_FLAGS "${CMAKE_C_FLAGS} ${EXTRA_C_FLAGS} -march=icelake-server")
+endif ()
+
+# and AVX512VBMI, used by the wide Sheng engines
+CHECK_C_SOURCE_COMPILES("#include <${INTRIN_INC_H}>
+#if !defined(__AVX512VBMI__)
+#error no avx512vbmi
+#endif
+
+int main(){
+    __m512i z = _mm512_setzero_si512();
+    (void)_mm512_permutexvar_epi8(z, z);
+}" HAVE_AVX512VBMI)
+
+if (NOT HAVE_AVX512VBMI)
+    message(STATUS "Building without AVX512VBMI support")
+elseif (FAT_RUNTIME AND BUILD_AVX512)
+    set (BUILD_AVX512VBMI TRUE)
+endif ()
+
 unset (CMAKE_REQUIRED_FLAGS)
 unset (INTRIN_INC_H)
@@ -1,9 +1,13 @@
 # determine the target arch
 
 # really only interested in the preprocessor here
-CHECK_C_SOURCE_COMPILES("#if !(defined(__x86_64__) || defined(_M_X64))\n#error not 64bit\n#endif\nint main(void) { return 0; }" ARCH_64_BIT)
+CHECK_C_SOURCE_COMPILES("#if !(defined(__x86_64__) || defined(_M_X64))\n#error not 64bit\n#endif\nint main(void) { return 0; }" ARCH_X86_64)
+
+CHECK_C_SOURCE_COMPILES("#if !defined(__aarch64__)\n#error not aarch64\n#endif\nint main(void) { return 0; }" ARCH_AARCH64)
 
 CHECK_C_SOURCE_COMPILES("#if !(defined(__i386__) || defined(_M_IX86))\n#error not 64bit\n#endif\nint main(void) { return 0; }" ARCH_32_BIT)
 
-set(ARCH_X86_64 ${ARCH_64_BIT})
+if (ARCH_X86_64 OR ARCH_AARCH64)
+    set(ARCH_64_BIT TRUE)
+endif ()
 set(ARCH_IA32 ${ARCH_32_BIT})
@@ -0,0 +1,24 @@
+#
+# a lot of noise to find sqlite
+#
+
+# first check for sqlite on the system
+pkg_check_modules(SQLITE3 sqlite3)
+
+if (SQLITE3_FOUND)
+    set(CMAKE_REQUIRED_INCLUDES ${SQLITE3_INCLUDE_DIRS})
+    CHECK_INCLUDE_FILES(sqlite3.h HAVE_SQLITE3_H)
+    if (NOT HAVE_SQLITE3_H)
+        message(STATUS "sqlite3.h not found, assuming sqlite3 is unusable")
+        set(SQLITE3_FOUND FALSE)
+    else()
+        set(CMAKE_REQUIRED_LIBRARIES ${SQLITE3_LDFLAGS})
+        CHECK_FUNCTION_EXISTS(sqlite3_open_v2 HAVE_SQLITE3_OPEN_V2)
+        unset(CMAKE_REQUIRED_LIBRARIES)
+    endif()
+    unset(CMAKE_REQUIRED_INCLUDES)
+else()
+    message(STATUS "sqlite3 not found")
+endif()
+
+# that's enough about sqlite
@@ -30,9 +30,17 @@
  * \brief Runtime functions for setting custom allocators.
  */
 
+#if defined(__linux__)
+#define _GNU_SOURCE // for MAP_ANONYMOUS, MAP_HUGETLB
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
 #include "allocator.h"
 
 #define default_malloc malloc
@@ -48,6 +56,19 @@ hs_free_t hs_misc_free = default_free;
 hs_free_t hs_scratch_free = default_free;
 hs_free_t hs_stream_free = default_free;
 
+static
+void *placement_alloc(UNUSED size_t size, UNUSED void *context) {
+    return NULL;
+}
+
+static
+void placement_free(UNUSED void *ptr, UNUSED void *context) {
+}
+
+const hs_allocator_t hs_placement_allocator = {
+    placement_alloc, placement_free, NULL
+};
+
 static
 hs_alloc_t normalise_alloc(hs_alloc_t a) {
     if (!a) {
@@ -107,3 +128,121 @@ hs_error_t hs_set_stream_allocator(hs_alloc_t allocfunc, hs_free_t freefunc) {
 
     return HS_SUCCESS;
 }
+
+/** \brief Room left in front of each block from hs_huge_page_alloc() for the
+ * length of its mapping (zero for a block from malloc). A whole cacheline, so
+ * that blocks in huge pages are cacheline aligned. */
+#define HUGE_HEADER_LEN 64
+
+#define HUGE_PAGE_2MB (2ULL << 20)
+#define HUGE_PAGE_1GB (1ULL << 30)
+
+#if defined(__linux__)
+static
+char *huge_mmap(size_t len, int flags) {
+    void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return p == MAP_FAILED ? NULL : (char *)p;
+}
+
+/** \brief Maps at least \a len bytes backed by huge pages if at all possible;
+ * returns the mapping and sets \a map_len to its length. */
+static
+char *huge_map(size_t len, size_t *map_len) {
+    char *base;
+
+#if defined(MAP_HUGETLB)
+#if defined(MAP_HUGE_1GB)
+    if (len >= HUGE_PAGE_1GB) {
+        *map_len = ROUNDUP_N(len, HUGE_PAGE_1GB);
+        base = huge_mmap(*map_len, MAP_HUGETLB | MAP_HUGE_1GB);
+        if (base) {
+            return base;
+        }
+    }
+#endif
+
+#if defined(MAP_HUGE_2MB)
+    const int hugetlb_flags = MAP_HUGETLB | MAP_HUGE_2MB;
+#else
+    const int hugetlb_flags = MAP_HUGETLB;
+#endif
+    *map_len = ROUNDUP_N(len, HUGE_PAGE_2MB);
+    base = huge_mmap(*map_len, hugetlb_flags);
+    if (base) {
+        return base;
+    }
+#endif
+
+    /* No pool pages: over-map so that the block can be trimmed to a huge page
+     * boundary, which transparent huge pages need, and advise the kernel. */
+    *map_len = ROUNDUP_N(len, HUGE_PAGE_2MB);
+    size_t over_len = *map_len + HUGE_PAGE_2MB;
+    char *raw = huge_mmap(over_len, 0);
+    if (!raw) {
+        return NULL;
+    }
+    base = (char *)ROUNDUP_PTR(raw, HUGE_PAGE_2MB);
+    size_t head = base - raw;
+    size_t tail = over_len - head - *map_len;
+    if (head) {
+        munmap(raw, head);
+    }
+    if (tail) {
+        munmap(base + *map_len, tail);
+    }
+#if defined(MADV_HUGEPAGE)
+    madvise(base, *map_len, MADV_HUGEPAGE);
+#endif
+    return base;
+}
+#endif
+
+HS_PUBLIC_API
+void *hs_huge_page_alloc(size_t size) {
+    size_t len = size + HUGE_HEADER_LEN;
+    if (len < size) {
+        return NULL;
+    }
+
+    char *base;
+    size_t map_len = 0;
+#if defined(__linux__)
+    if (len >= HUGE_PAGE_2MB / 2) {
+        base = huge_map(len, &map_len);
+        if (!base) {
+            map_len = 0;
+        }
+    } else {
+        base = NULL;
+    }
+    if (!base)
+#endif
+    {
+        base = (char *)default_malloc(len);
+        if (!base) {
+            return NULL;
+        }
+    }
+
+    memcpy(base, &map_len, sizeof(map_len));
+    return base + HUGE_HEADER_LEN;
+}
+
+HS_PUBLIC_API
+void hs_huge_page_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    char *base = (char *)ptr - HUGE_HEADER_LEN;
+    size_t map_len;
+    memcpy(&map_len, base, sizeof(map_len));
+#if defined(__linux__)
+    if (map_len) {
+        munmap(base, map_len);
+        return;
+    }
+#endif
+    default_free(base);
+}
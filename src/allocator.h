@@ -45,6 +45,10 @@ extern hs_free_t hs_database_free;
 extern hs_free_t hs_misc_free;
 extern hs_free_t hs_scratch_free;
 extern hs_free_t hs_stream_free;
+
+/** \brief Recorded as the allocator of scratch spaces and streams built in
+ * caller-provided memory, which is never allocated or freed by Hyperscan. */
+extern const hs_allocator_t hs_placement_allocator;
 #ifdef __cplusplus
 } /* extern C */
 #endif
@@ -63,4 +67,29 @@ hs_error_t hs_check_alloc(const void *mem) {
     return ret;
 }
 
+/** \brief Allocates with the allocator context \a a, or with the process-wide
+ * allocator \a dflt if \a a is NULL. */
+static really_inline
+void *hs_ctx_alloc(const hs_allocator_t *a, hs_alloc_t dflt, size_t size) {
+    return a ? a->alloc(size, a->context) : dflt(size);
+}
+
+/** \brief Frees memory from hs_ctx_alloc() with the same allocator. */
+static really_inline
+void hs_ctx_free(const hs_allocator_t *a, hs_free_t dflt, void *ptr) {
+    if (a) {
+        a->free(ptr, a->context);
+    } else {
+        dflt(ptr);
+    }
+}
+
+/** \brief Returns the allocator for a new object copied from one that uses
+ * \a a: the same allocator, except that copies of objects in caller-provided
+ * memory use the process-wide allocator. */
+static really_inline
+const hs_allocator_t *hs_ctx_for_copy(const hs_allocator_t *a) {
+    return a == &hs_placement_allocator ? NULL : a;
+}
+
 #endif
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Backtracking confirm programs: runtime.
+ *
+ * The program is tried from each start offset in its window in turn. Each
+ * attempt is a depth-first search, with an explicit stack of alternatives and
+ * slot values to restore on backtracking. The search is bounded in steps and
+ * in stack depth; if either bound is reached, the match is reported as
+ * confirmed, since the prefilter has already found that it may exist.
+ */
+
+#include "backtrack.h"
+#include "backtrack_internal.h"
+
+#include "ue2common.h"
+#include "util/compare.h"
+
+/** \brief Most alternatives and slot restores held at once. */
+#define BT_MAX_FRAMES 512
+
+/** \brief Most instructions run by one call to btConfirm. */
+#define BT_MAX_STEPS 100000
+
+/** \brief Value of a slot that has not been set. */
+#define BT_POS_UNSET (~0ULL)
+
+/** \brief Frame slot value marking an alternative rather than a restore. */
+#define BT_NO_SLOT 0xffffffffU
+
+struct bt_frame {
+    u64a val; //!< position to resume at, or slot value to restore
+    u32 pc; //!< instruction to resume at, for an alternative
+    u32 slot; //!< slot to restore, or BT_NO_SLOT for an alternative
+};
+
+struct bt_data {
+    const u8 *hbuf;
+    size_t hlen;
+    const u8 *buf;
+    size_t len;
+    u64a buf_offset;
+    u64a end; //!< end of the match being confirmed
+};
+
+static really_inline
+char btHasByte(const struct bt_data *d, u64a pos) {
+    return pos + d->hlen >= d->buf_offset && pos < d->buf_offset + d->len;
+}
+
+static really_inline
+u8 btByte(const struct bt_data *d, u64a pos) {
+    assert(btHasByte(d, pos));
+    if (pos >= d->buf_offset) {
+        return d->buf[pos - d->buf_offset];
+    }
+    return d->hbuf[d->hlen - (d->buf_offset - pos)];
+}
+
+static really_inline
+char btIsWord(u8 c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+/** \brief Evaluate an assertion. Where the data it depends on is not
+ * available, it is taken to hold. */
+static
+char btAssert(const struct bt_data *d, u32 kind, u64a pos) {
+    const char has_prev = pos && btHasByte(d, pos - 1);
+    const char has_next = btHasByte(d, pos);
+
+    switch (kind) {
+    case BT_ASSERT_BEGIN_STRING:
+        return pos == 0;
+    case BT_ASSERT_END_STRING:
+        return !has_next;
+    case BT_ASSERT_END_STRING_OPTIONAL_LF:
+        return !has_next ||
+               (btByte(d, pos) == '\n' && !btHasByte(d, pos + 1));
+    case BT_ASSERT_BEGIN_LINE:
+        return pos == 0 || !has_prev || btByte(d, pos - 1) == '\n';
+    case BT_ASSERT_END_LINE:
+        return !has_next || btByte(d, pos) == '\n';
+    case BT_ASSERT_WORD_BOUNDARY:
+    case BT_ASSERT_NOT_WORD_BOUNDARY: {
+        if ((pos && !has_prev) || !has_next) {
+            return 1;
+        }
+        char prev = pos ? btIsWord(btByte(d, pos - 1)) : 0;
+        char next = btIsWord(btByte(d, pos));
+        return (prev != next) == (kind == BT_ASSERT_WORD_BOUNDARY);
+    }
+    default:
+        assert(0);
+        return 1;
+    }
+}
+
+static
+char btBackref(const struct bt_data *d, const u64a *slots, u32 group,
+               u32 caseless, u64a *pos) {
+    const u64a from = slots[2 * group];
+    const u64a to = slots[2 * group + 1];
+    if (from == BT_POS_UNSET || to == BT_POS_UNSET || from > to) {
+        return 0; // a reference to an unset group fails, as in PCRE
+    }
+    const u64a n = to - from;
+    if (d->end - *pos < n) {
+        return 0;
+    }
+    for (u64a i = 0; i < n; i++) {
+        u8 a = btByte(d, from + i);
+        u8 b = btByte(d, *pos + i);
+        // Caseless comparison of non-ASCII bytes is left to the prefilter;
+        // they are taken to match.
+        if (a != b && (!caseless || (mytolower(a) != mytolower(b) &&
+                                     a < 0x80 && b < 0x80))) {
+            return 0;
+        }
+    }
+    *pos += n;
+    return 1;
+}
+
+/** \brief Run the program from \a start. Returns 1 on a match, 0 if there is
+ * none, and -1 if a resource limit was reached. */
+static
+int btRun(const struct BacktrackProgram *prog, const struct bt_data *d,
+          u64a start, u32 *steps) {
+    const u32 *code = (const u32 *)(prog + 1);
+    u64a slots[BT_MAX_SLOTS];
+    struct bt_frame stack[BT_MAX_FRAMES];
+    u32 depth = 0;
+    u32 pc = 0;
+    u64a pos = start;
+
+    for (u32 i = 0; i < prog->slot_count; i++) {
+        slots[i] = BT_POS_UNSET;
+    }
+
+    for (;;) {
+        if (++*steps > BT_MAX_STEPS) {
+            DEBUG_PRINTF("out of steps\n");
+            return -1;
+        }
+        assert(pc < prog->code_words);
+
+        switch (code[pc]) {
+        case BT_OP_CLASS:
+            if (pos < d->end) {
+                u8 c = btByte(d, pos);
+                if (code[pc + 1 + c / 32] & (1U << (c % 32))) {
+                    pos++;
+                    pc += 9;
+                    continue;
+                }
+            }
+            break;
+        case BT_OP_SPLIT:
+            if (depth == BT_MAX_FRAMES) {
+                DEBUG_PRINTF("out of stack\n");
+                return -1;
+            }
+            stack[depth].val = pos;
+            stack[depth].pc = pc + code[pc + 1];
+            stack[depth].slot = BT_NO_SLOT;
+            depth++;
+            pc += 2;
+            continue;
+        case BT_OP_JMP:
+            pc += code[pc + 1];
+            continue;
+        case BT_OP_SAVE: {
+            u32 slot = code[pc + 1];
+            assert(slot < prog->slot_count);
+            if (depth == BT_MAX_FRAMES) {
+                DEBUG_PRINTF("out of stack\n");
+                return -1;
+            }
+            stack[depth].val = slots[slot];
+            stack[depth].pc = 0;
+            stack[depth].slot = slot;
+            depth++;
+            slots[slot] = pos;
+            pc += 2;
+            continue;
+        }
+        case BT_OP_PROGRESS:
+            if (slots[code[pc + 1]] != pos) {
+                pc += 2;
+                continue;
+            }
+            break;
+        case BT_OP_BACKREF:
+            if (btBackref(d, slots, code[pc + 1], code[pc + 2], &pos)) {
+                pc += 3;
+                continue;
+            }
+            break;
+        case BT_OP_ASSERT:
+            if (btAssert(d, code[pc + 1], pos)) {
+                pc += 2;
+                continue;
+            }
+            break;
+        case BT_OP_MATCH:
+            if (pos == d->end) {
+                return 1;
+            }
+            break;
+        default:
+            assert(0);
+            return -1;
+        }
+
+        // Backtrack to the most recent alternative, undoing slot writes.
+        for (;;) {
+            if (!depth) {
+                return 0;
+            }
+            const struct bt_frame *f = &stack[--depth];
+            if (f->slot == BT_NO_SLOT) {
+                pc = f->pc;
+                pos = f->val;
+                break;
+            }
+            slots[f->slot] = f->val;
+        }
+    }
+}
+
+char btConfirm(const struct BacktrackProgram *prog, const u8 *hbuf,
+               size_t hlen, const u8 *buf, size_t len, u64a buf_offset,
+               u64a end) {
+    assert(prog);
+    assert(hlen <= buf_offset);
+
+    struct bt_data d = {hbuf, hlen, buf, len, buf_offset, end};
+    const u64a avail = buf_offset - hlen;
+    if (end < avail) {
+        DEBUG_PRINTF("match end %llu not in history\n", end);
+        return 1;
+    }
+
+    u64a lo = end > prog->window ? end - prog->window : 0;
+    const char truncated = lo < avail;
+    if (truncated) {
+        lo = avail;
+    }
+
+    u32 steps = 0;
+    for (u64a start = lo; start <= end; start++) {
+        int rv = btRun(prog, &d, start, &steps);
+        if (rv) {
+            DEBUG_PRINTF("%s at [%llu,%llu]\n",
+                         rv > 0 ? "confirmed" : "gave up", start, end);
+            return 1;
+        }
+    }
+
+    DEBUG_PRINTF("no match ending at %llu%s\n", end,
+                 truncated ? " in available history" : "");
+    return truncated;
+}
@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Backtracking confirm programs: construction from a component tree.
+ *
+ * The tree is walked bottom-up, building a program fragment for each
+ * component. Constructs that cannot be checked exactly are translated
+ * permissively, so that the program accepts at least everything the original
+ * expression matches: lookaround assertions are dropped, atomic groups and
+ * possessive repeats are treated as ordinary ones, and Unicode classes and
+ * word boundaries accept any character.
+ */
+
+#include "backtrack_build.h"
+#include "backtrack_internal.h"
+
+#include "parser/AsciiComponentClass.h"
+#include "parser/ComponentAlternation.h"
+#include "parser/ComponentAssertion.h"
+#include "parser/ComponentAtomicGroup.h"
+#include "parser/ComponentBackReference.h"
+#include "parser/ComponentBoundary.h"
+#include "parser/ComponentByte.h"
+#include "parser/ComponentCondReference.h"
+#include "parser/ComponentEUS.h"
+#include "parser/ComponentEmpty.h"
+#include "parser/ComponentRepeat.h"
+#include "parser/ComponentSequence.h"
+#include "parser/ComponentWordBoundary.h"
+#include "parser/ConstComponentVisitor.h"
+#include "parser/Utf8ComponentClass.h"
+#include "util/charreach.h"
+#include "util/compile_error.h"
+#include "util/container.h"
+#include "util/verify_types.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+
+using namespace std;
+
+namespace ue2 {
+
+/** \brief Largest confirm program, in code words. */
+static const size_t MAX_CONFIRM_CODE_WORDS = 1 << 16;
+
+/** \brief Width of a fragment that can match unboundedly long strings. */
+static const u32 WIDTH_INF = ~0U;
+
+namespace {
+
+/** \brief Program for a sub-expression. */
+struct Fragment {
+    vector<u32> code;
+    u32 max_width = 0; //!< longest match, or WIDTH_INF
+    bool can_be_empty = true;
+};
+
+} // namespace
+
+static
+u32 addWidth(u32 a, u32 b) {
+    if (a == WIDTH_INF || b == WIDTH_INF || a + b < a) {
+        return WIDTH_INF;
+    }
+    return a + b;
+}
+
+static
+void checkSize(const Fragment &f) {
+    if (f.code.size() > MAX_CONFIRM_CODE_WORDS) {
+        throw CompileError("Expression is too large for HS_FLAG_CONFIRM.");
+    }
+}
+
+static
+Fragment makeClass(const CharReach &cr) {
+    Fragment f;
+    f.code.resize(9, 0);
+    f.code[0] = BT_OP_CLASS;
+    for (size_t c = cr.find_first(); c != CharReach::npos;
+         c = cr.find_next(c)) {
+        f.code[1 + c / 32] |= 1U << (c % 32);
+    }
+    f.max_width = 1;
+    f.can_be_empty = false;
+    return f;
+}
+
+static
+Fragment makeAssert(BacktrackAssert kind) {
+    Fragment f;
+    f.code = {BT_OP_ASSERT, kind};
+    return f;
+}
+
+static
+void append(Fragment &f, const Fragment &g) {
+    insert(&f.code, f.code.end(), g.code);
+    f.max_width = addWidth(f.max_width, g.max_width);
+    f.can_be_empty = f.can_be_empty && g.can_be_empty;
+    checkSize(f);
+}
+
+/** \brief Either \a a or \a b, trying \a a first. */
+static
+Fragment makeAlt(const Fragment &a, const Fragment &b) {
+    Fragment f;
+    u32 a_len = verify_u32(a.code.size());
+    u32 b_len = verify_u32(b.code.size());
+    f.code = {BT_OP_SPLIT, 2 + a_len + 2};
+    insert(&f.code, f.code.end(), a.code);
+    f.code.push_back(BT_OP_JMP);
+    f.code.push_back(2 + b_len);
+    insert(&f.code, f.code.end(), b.code);
+    f.max_width = max(a.max_width, b.max_width);
+    f.can_be_empty = a.can_be_empty || b.can_be_empty;
+    checkSize(f);
+    return f;
+}
+
+/** \brief Zero or one of \a a, trying one first. */
+static
+Fragment makeOptional(const Fragment &a) {
+    Fragment f;
+    f.code = {BT_OP_SPLIT, 2 + verify_u32(a.code.size())};
+    insert(&f.code, f.code.end(), a.code);
+    f.max_width = a.max_width;
+    checkSize(f);
+    return f;
+}
+
+/** \brief Zero or more of \a a. If \a a can match the empty string, slot \a
+ * guard is used to stop iterations that make no progress. */
+static
+Fragment makeStar(const Fragment &a, u32 guard) {
+    Fragment f;
+    f.code = {BT_OP_SPLIT, 0};
+    if (a.can_be_empty) {
+        f.code.push_back(BT_OP_SAVE);
+        f.code.push_back(guard);
+    }
+    insert(&f.code, f.code.end(), a.code);
+    if (a.can_be_empty) {
+        f.code.push_back(BT_OP_PROGRESS);
+        f.code.push_back(guard);
+    }
+    // Jump back to the split; the offset wraps around.
+    u32 jmp = verify_u32(f.code.size());
+    f.code.push_back(BT_OP_JMP);
+    f.code.push_back(0U - jmp);
+    f.code[1] = verify_u32(f.code.size());
+    f.max_width = a.max_width ? WIDTH_INF : 0;
+    checkSize(f);
+    return f;
+}
+
+namespace {
+
+/** \brief Visitor that collects the capture groups of an expression. */
+class CaptureVisitor : public DefaultConstComponentVisitor {
+public:
+    ~CaptureVisitor() override;
+
+    using DefaultConstComponentVisitor::pre;
+
+    void pre(const ComponentSequence &c) override {
+        u32 idx = c.getCaptureIndex();
+        if (idx == ComponentSequence::NOT_CAPTURED) {
+            return;
+        }
+        max_index = max(max_index, idx);
+        if (!c.getCaptureName().empty()) {
+            names.emplace(c.getCaptureName(), idx);
+        }
+    }
+
+    u32 max_index = 0;
+    map<string, u32> names;
+};
+
+CaptureVisitor::~CaptureVisitor() {}
+
+} // namespace
+
+/**
+ * \brief Visitor that builds a confirm program.
+ *
+ * Fragments for the children of a component are gathered on a stack of
+ * levels: each container pushes a level in pre() and combines it into a
+ * single fragment in post(), while leaves add their fragment to the current
+ * level directly.
+ */
+class ConfirmBuildVisitor : public DefaultConstComponentVisitor {
+public:
+    explicit ConfirmBuildVisitor(const CaptureVisitor &captures)
+        : names(captures.names),
+          next_guard(2 * (captures.max_index + 1)), levels(1) {}
+
+    ~ConfirmBuildVisitor() override;
+
+    using DefaultConstComponentVisitor::pre;
+    using DefaultConstComponentVisitor::post;
+
+    void pre(const AsciiComponentClass &c) override {
+        add(makeClass(c.cr));
+    }
+
+    void pre(const ComponentByte &) override {
+        add(makeClass(CharReach::dot()));
+    }
+
+    void pre(const ComponentEUS &) override {
+        // An extended grapheme cluster: one or more bytes.
+        Fragment f = makeClass(CharReach::dot());
+        append(f, makeStar(f, 0)); // never empty, so needs no guard slot
+        add(f);
+    }
+
+    void pre(const UTF8ComponentClass &) override {
+        // Any one UTF-8 encoded character.
+        const CharReach cont(0x80, 0xbf);
+        Fragment f = makeClass(CharReach(0xf0, 0xf7));
+        for (u32 i = 0; i < 3; i++) {
+            append(f, makeClass(cont));
+        }
+        Fragment f3 = makeClass(CharReach(0xe0, 0xef));
+        append(f3, makeClass(cont));
+        append(f3, makeClass(cont));
+        Fragment f2 = makeClass(CharReach(0xc0, 0xdf));
+        append(f2, makeClass(cont));
+        f = makeAlt(f3, f);
+        f = makeAlt(f2, f);
+        add(makeAlt(makeClass(CharReach(0, 0x7f)), f));
+    }
+
+    void pre(const ComponentEmpty &) override {
+        add(Fragment());
+    }
+
+    void pre(const ComponentBoundary &c) override {
+        switch (c.m_bound) {
+        case ComponentBoundary::BEGIN_STRING:
+            add(makeAssert(BT_ASSERT_BEGIN_STRING));
+            break;
+        case ComponentBoundary::END_STRING:
+            add(makeAssert(BT_ASSERT_END_STRING));
+            break;
+        case ComponentBoundary::END_STRING_OPTIONAL_LF:
+            add(makeAssert(BT_ASSERT_END_STRING_OPTIONAL_LF));
+            break;
+        case ComponentBoundary::BEGIN_LINE:
+            add(makeAssert(BT_ASSERT_BEGIN_LINE));
+            break;
+        case ComponentBoundary::END_LINE:
+            add(makeAssert(BT_ASSERT_END_LINE));
+            break;
+        }
+    }
+
+    void pre(const ComponentWordBoundary &c) override {
+        if (c.ucp) {
+            add(Fragment());
+            return;
+        }
+        add(makeAssert(c.negated ? BT_ASSERT_NOT_WORD_BOUNDARY
+                                 : BT_ASSERT_WORD_BOUNDARY));
+    }
+
+    void pre(const ComponentBackReference &c) override {
+        u32 group = c.getRefID();
+        if (!group) {
+            auto it = names.find(c.getRefName());
+            if (it == names.end()) {
+                assert(0); // checked by the parser
+                throw CompileError("Invalid back reference.");
+            }
+            group = it->second;
+        }
+        if (contains(unchecked_groups, group)) {
+            // The group is only set inside lookaround, which is not checked.
+            Fragment f = makeClass(CharReach::dot());
+            add(makeStar(f, 0));
+            return;
+        }
+        Fragment f;
+        f.code = {BT_OP_BACKREF, group, c.isCaseless() ? 1U : 0U};
+        auto it = group_width.find(group);
+        f.max_width = it != group_width.end() ? it->second : WIDTH_INF;
+        add(f);
+    }
+
+    void pre(const ComponentAlternation &) override { push(); }
+    void pre(const ComponentAssertion &) override {
+        push();
+        assertion_depth++;
+    }
+    void pre(const ComponentAtomicGroup &) override { push(); }
+    void pre(const ComponentCondReference &) override { push(); }
+    void pre(const ComponentRepeat &) override { push(); }
+    void pre(const ComponentSequence &) override { push(); }
+
+    void post(const ComponentAlternation &) override {
+        vector<Fragment> kids = pop();
+        if (kids.empty()) {
+            add(Fragment());
+            return;
+        }
+        Fragment f = kids.back();
+        for (auto it = kids.rbegin() + 1; it != kids.rend(); ++it) {
+            f = makeAlt(*it, f);
+        }
+        add(f);
+    }
+
+    void post(const ComponentAssertion &) override {
+        // Lookaround is not checked.
+        pop();
+        assert(assertion_depth);
+        assertion_depth--;
+        add(Fragment());
+    }
+
+    void post(const ComponentAtomicGroup &) override {
+        add(concat(pop()));
+    }
+
+    void post(const ComponentCondReference &c) override {
+        // The condition is not checked: either branch may be taken. Any
+        // assertion used as the condition has become an empty fragment.
+        Fragment f = concat(pop());
+        if (!c.hasBothBranches) {
+            f = makeAlt(f, Fragment());
+        }
+        add(f);
+    }
+
+    void post(const ComponentRepeat &c) override {
+        vector<Fragment> kids = pop();
+        assert(kids.size() == 1);
+        const Fragment &body = kids.front();
+        u32 min_count, max_count;
+        tie(min_count, max_count) = c.getBounds();
+
+        Fragment f;
+        for (u32 i = 0; i < min_count; i++) {
+            append(f, body);
+        }
+        if (max_count == ComponentRepeat::NoLimit) {
+            append(f, makeStar(body, guard()));
+        } else if (max_count > min_count) {
+            Fragment opt = makeOptional(body);
+            for (u32 i = min_count + 1; i < max_count; i++) {
+                Fragment g = body;
+                append(g, opt);
+                opt = makeOptional(g);
+            }
+            append(f, opt);
+        }
+        add(f);
+    }
+
+    void post(const ComponentSequence &c) override {
+        Fragment body = concat(pop());
+        u32 idx = c.getCaptureIndex();
+        if (idx == ComponentSequence::NOT_CAPTURED) {
+            add(body);
+            return;
+        }
+        if (assertion_depth) {
+            unchecked_groups.insert(idx);
+        }
+        Fragment f;
+        f.code = {BT_OP_SAVE, 2 * idx};
+        append(f, body);
+        f.code.push_back(BT_OP_SAVE);
+        f.code.push_back(2 * idx + 1);
+        auto &width = group_width[idx];
+        width = max(width, body.max_width);
+        add(f);
+    }
+
+    /** \brief Finishes the program, returning its root fragment. */
+    Fragment finish() {
+        assert(levels.size() == 1);
+        Fragment f = concat(move(levels.back()));
+        f.code.push_back(BT_OP_MATCH);
+        checkSize(f);
+        return f;
+    }
+
+    u32 slotCount() const { return next_guard; }
+
+private:
+    void add(Fragment f) { levels.back().push_back(move(f)); }
+
+    void push() { levels.emplace_back(); }
+
+    vector<Fragment> pop() {
+        assert(levels.size() > 1);
+        vector<Fragment> kids = move(levels.back());
+        levels.pop_back();
+        return kids;
+    }
+
+    static Fragment concat(const vector<Fragment> &kids) {
+        Fragment f;
+        for (const auto &k : kids) {
+            append(f, k);
+        }
+        return f;
+    }
+
+    u32 guard() {
+        if (next_guard >= BT_MAX_SLOTS) {
+            throw CompileError("Expression has too many groups and repeats "
+                               "for HS_FLAG_CONFIRM.");
+        }
+        return next_guard++;
+    }
+
+    const map<string, u32> &names;
+    map<u32, u32> group_width; //!< longest match of each capture group
+    set<u32> unchecked_groups; //!< groups set inside lookaround
+    u32 assertion_depth = 0; //!< lookaround nesting at this point
+    u32 next_guard; //!< next free slot
+    vector<vector<Fragment>> levels;
+};
+
+ConfirmBuildVisitor::~ConfirmBuildVisitor() {}
+
+shared_ptr<const ConfirmProgram> buildConfirmProgram(const Component &root,
+                                                     u32 max_window) {
+    CaptureVisitor captures;
+    root.accept(captures);
+    if (2 * (captures.max_index + 1) > BT_MAX_SLOTS) {
+        throw CompileError("Expression has too many groups for "
+                           "HS_FLAG_CONFIRM.");
+    }
+
+    ConfirmBuildVisitor vis(captures);
+    root.accept(vis);
+    Fragment f = vis.finish();
+
+    auto prog = make_shared<ConfirmProgram>();
+    prog->window = min(f.max_width, max_window);
+    prog->slot_count = vis.slotCount();
+    prog->code = move(f.code);
+    DEBUG_PRINTF("built confirm program: %zu words, %u slots, window %u\n",
+                 prog->code.size(), prog->slot_count, prog->window);
+    return prog;
+}
+
+size_t confirmProgramSize(const ConfirmProgram &prog) {
+    return sizeof(BacktrackProgram) + prog.code.size() * sizeof(u32);
+}
+
+void writeConfirmProgram(const ConfirmProgram &prog, u8 *dest) {
+    BacktrackProgram header;
+    header.length = verify_u32(confirmProgramSize(prog));
+    header.window = prog.window;
+    header.slot_count = prog.slot_count;
+    header.code_words = verify_u32(prog.code.size());
+    memcpy(dest, &header, sizeof(header));
+    memcpy(dest + sizeof(header), prog.code.data(),
+           prog.code.size() * sizeof(u32));
+}
+
+} // namespace ue2
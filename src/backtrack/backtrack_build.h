@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Backtracking confirm programs: construction from a component tree.
+ */
+
+#ifndef BACKTRACK_BUILD_H
+#define BACKTRACK_BUILD_H
+
+#include "ue2common.h"
+
+#include <memory>
+#include <vector>
+
+namespace ue2 {
+
+class Component;
+
+/** \brief A confirm program built from an expression's component tree. */
+struct ConfirmProgram {
+    u32 window = 0; //!< longest match that is searched for
+    u32 slot_count = 0; //!< slots used by the program
+    std::vector<u32> code; //!< code words, see backtrack_internal.h
+};
+
+/**
+ * \brief Builds a confirm program for the expression rooted at \a root, which
+ * must not yet have been rewritten for prefiltering.
+ *
+ * \a max_window bounds the length of the matches that are searched for.
+ * Throws CompileError if the expression needs a program larger than the
+ * runtime supports.
+ */
+std::shared_ptr<const ConfirmProgram>
+buildConfirmProgram(const Component &root, u32 max_window);
+
+/** \brief Size in bytes of the runtime form of \a prog, a struct
+ * BacktrackProgram followed by its code. */
+size_t confirmProgramSize(const ConfirmProgram &prog);
+
+/** \brief Writes the runtime form of \a prog to \a dest, which must have room
+ * for confirmProgramSize(prog) bytes. */
+void writeConfirmProgram(const ConfirmProgram &prog, u8 *dest);
+
+} // namespace ue2
+
+#endif // BACKTRACK_BUILD_H
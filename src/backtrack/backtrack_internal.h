@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Backtracking confirm programs: bytecode format.
+ *
+ * A program checks a match reported by a pattern compiled in prefilter mode
+ * against the original pattern, including the constructs (such as back
+ * references) that prefiltering replaced. It is a sequence of u32 words: each
+ * instruction is an opcode word followed by its operands. Jumps are relative
+ * to the opcode word of the jumping instruction, so that programs for
+ * sub-expressions can be concatenated and repeated without relocation.
+ *
+ * Captures and loop guards are kept in slots; slot 2n is the start of
+ * capture group n and slot 2n+1 its end.
+ */
+
+#ifndef BACKTRACK_INTERNAL_H
+#define BACKTRACK_INTERNAL_H
+
+#include "ue2common.h"
+
+/** \brief Most slots a program may use. */
+#define BT_MAX_SLOTS 64
+
+enum BacktrackOp {
+    /** Match one byte against a 256-bit class: 8 operand words. */
+    BT_OP_CLASS,
+
+    /** Continue with the next instruction; on failure, resume at the
+     * relative target given as the operand. */
+    BT_OP_SPLIT,
+
+    /** Jump to the relative target given as the operand. */
+    BT_OP_JMP,
+
+    /** Record the current position in the slot given as the operand. */
+    BT_OP_SAVE,
+
+    /** Fail if the current position equals the slot given as the operand,
+     * so that a loop whose body matched nothing cannot repeat forever. */
+    BT_OP_PROGRESS,
+
+    /** Match the text of the capture group given as the first operand
+     * again; caselessly if the second operand is non-zero. */
+    BT_OP_BACKREF,
+
+    /** Check the zero-width assertion given as the operand, one of
+     * enum BacktrackAssert. */
+    BT_OP_ASSERT,
+
+    /** Succeed if the current position is the end of the match. */
+    BT_OP_MATCH
+};
+
+enum BacktrackAssert {
+    BT_ASSERT_BEGIN_STRING,
+    BT_ASSERT_END_STRING,
+    BT_ASSERT_END_STRING_OPTIONAL_LF, //!< end, or before a final newline
+    BT_ASSERT_BEGIN_LINE,
+    BT_ASSERT_END_LINE,
+    BT_ASSERT_WORD_BOUNDARY,
+    BT_ASSERT_NOT_WORD_BOUNDARY
+};
+
+/** \brief Header of a confirm program; the code words follow it. */
+struct BacktrackProgram {
+    u32 length; //!< total size in bytes, including this header
+    u32 window; //!< longest match that is searched for
+    u32 slot_count; //!< slots used, at most BT_MAX_SLOTS
+    u32 code_words; //!< number of code words
+};
+
+#endif // BACKTRACK_INTERNAL_H
@@ -36,8 +36,10 @@
 #include "hs_internal.h"
 #include "hs_runtime.h"
 #include "ue2common.h"
+#include "backtrack/backtrack_build.h"
 #include "nfagraph/ng_builder.h"
 #include "nfagraph/ng_dump.h"
+#include "nfagraph/ng_fuzzy.h"
 #include "nfagraph/ng.h"
 #include "nfagraph/ng_util.h"
 #include "parser/buildstate.h"
@@ -54,19 +56,30 @@
 #include "parser/utf8_validate.h"
 #include "rose/rose_build.h"
 #include "rose/rose_build_dump.h"
+#include "rose/rose_internal.h"
 #include "som/slot_manager_dump.h"
 #include "util/alloc.h"
 #include "util/compile_error.h"
+#include "util/compile_report.h"
+#include "util/make_unique.h"
 #include "util/target_info.h"
+#include "util/ue2string.h"
 #include "util/verify_types.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <memory>
 #include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 
@@ -77,11 +90,52 @@ static
 void validateExt(const hs_expr_ext &ext) {
     static const unsigned long long ALL_EXT_FLAGS = HS_EXT_FLAG_MIN_OFFSET |
                                                     HS_EXT_FLAG_MAX_OFFSET |
-                                                    HS_EXT_FLAG_MIN_LENGTH;
+                                                    HS_EXT_FLAG_MIN_LENGTH |
+                                                    HS_EXT_FLAG_MAX_MATCHES |
+                                                    HS_EXT_FLAG_CONFIRM_WINDOW |
+                                                    HS_EXT_FLAG_PREFILTER_STATES |
+                                                    HS_EXT_FLAG_EDIT_DISTANCE |
+                                                    HS_EXT_FLAG_HAMMING_DISTANCE |
+                                                    HS_EXT_FLAG_USER_DATA;
     if (ext.flags & ~ALL_EXT_FLAGS) {
         throw CompileError("Invalid hs_expr_ext flag set.");
     }
 
+    if ((ext.flags & HS_EXT_FLAG_MAX_MATCHES) &&
+        (ext.max_matches == 0 || ext.max_matches > ~0U)) {
+        throw CompileError("In hs_expr_ext, max_matches must be between 1 "
+                           "and 2^32-1.");
+    }
+
+    if ((ext.flags & HS_EXT_FLAG_CONFIRM_WINDOW) && !ext.confirm_window) {
+        throw CompileError("In hs_expr_ext, confirm_window must be at least "
+                           "1.");
+    }
+
+    if ((ext.flags & HS_EXT_FLAG_PREFILTER_STATES) &&
+        (ext.prefilter_states == 0 || ext.prefilter_states > ~0U)) {
+        throw CompileError("In hs_expr_ext, prefilter_states must be between "
+                           "1 and 2^32-1.");
+    }
+
+    if ((ext.flags & HS_EXT_FLAG_EDIT_DISTANCE) &&
+        (ext.flags & HS_EXT_FLAG_HAMMING_DISTANCE)) {
+        throw CompileError("In hs_expr_ext, cannot have both edit_distance "
+                           "and hamming_distance.");
+    }
+
+    if ((ext.flags & HS_EXT_FLAG_EDIT_DISTANCE) &&
+        ext.edit_distance > ~0U) {
+        throw CompileError("In hs_expr_ext, edit_distance must be less than "
+                           "2^32.");
+    }
+
+    if ((ext.flags & HS_EXT_FLAG_HAMMING_DISTANCE) &&
+        ext.hamming_distance > ~0U) {
+        throw CompileError("In hs_expr_ext, hamming_distance must be less "
+                           "than 2^32.");
+    }
+
     if ((ext.flags & HS_EXT_FLAG_MIN_OFFSET) &&
         (ext.flags & HS_EXT_FLAG_MAX_OFFSET) &&
         (ext.min_offset > ext.max_offset)) {
@@ -103,13 +157,22 @@ ParsedExpression::ParsedExpression(unsigned index_in, const char *expression,
     : utf8(false),
       allow_vacuous(flags & HS_FLAG_ALLOWEMPTY),
       highlander(flags & HS_FLAG_SINGLEMATCH),
-      prefilter(flags & HS_FLAG_PREFILTER),
+      prefilter(flags & (HS_FLAG_PREFILTER | HS_FLAG_CONFIRM)),
+      quiet(flags & HS_FLAG_QUIET),
       som(SOM_NONE),
       index(index_in),
       id(actionId),
       min_offset(0),
       max_offset(MAX_OFFSET),
-      min_length(0) {
+      min_length(0),
+      max_matches(0),
+      confirm_window(0),
+      prefilter_states(0),
+      edit_distance(0),
+      hamming(false),
+      has_user_data(false),
+      user_data(0),
+      confirm(flags & HS_FLAG_CONFIRM) {
     ParseMode mode(flags);
 
     component = parse(expression, mode);
@@ -142,6 +205,11 @@ ParsedExpression::ParsedExpression(unsigned index_in, const char *expression,
                            "combination with HS_FLAG_SOM_LEFTMOST.");
     }
 
+    if ((flags & HS_FLAG_CONFIRM) && (flags & HS_FLAG_SOM_LEFTMOST)) {
+        throw CompileError("HS_FLAG_CONFIRM is not supported in "
+                           "combination with HS_FLAG_SOM_LEFTMOST.");
+    }
+
     // Set SOM type.
     if (flags & HS_FLAG_SOM_LEFTMOST) {
         som = SOM_LEFT;
@@ -161,6 +229,33 @@ ParsedExpression::ParsedExpression(unsigned index_in, const char *expression,
         if (ext->flags & HS_EXT_FLAG_MIN_LENGTH) {
             min_length = ext->min_length;
         }
+        if (ext->flags & HS_EXT_FLAG_MAX_MATCHES) {
+            max_matches = ext->max_matches;
+        }
+        if (ext->flags & HS_EXT_FLAG_CONFIRM_WINDOW) {
+            confirm_window = ext->confirm_window;
+        }
+        if (ext->flags & HS_EXT_FLAG_PREFILTER_STATES) {
+            prefilter_states = (u32)ext->prefilter_states;
+        }
+        if (ext->flags & HS_EXT_FLAG_EDIT_DISTANCE) {
+            edit_distance = (u32)ext->edit_distance;
+        }
+        if (ext->flags & HS_EXT_FLAG_HAMMING_DISTANCE) {
+            edit_distance = (u32)ext->hamming_distance;
+            hamming = true;
+        }
+        if (ext->flags & HS_EXT_FLAG_USER_DATA) {
+            has_user_data = true;
+            user_data = ext->user_data;
+        }
+    }
+
+    // Confirm programs check matches against the expression as written, so
+    // they would reject approximate matches.
+    if (confirm && edit_distance) {
+        throw CompileError("HS_FLAG_CONFIRM is not supported in combination "
+                           "with approximate matching.");
     }
 
     // These are validated in validateExt, so an error will already have been
@@ -170,12 +265,36 @@ ParsedExpression::ParsedExpression(unsigned index_in, const char *expression,
 
     // Since prefiltering and SOM aren't supported together, we must squash any
     // min_length constraint as well.
-    if (flags & HS_FLAG_PREFILTER && min_length) {
+    if (prefilter && min_length) {
         DEBUG_PRINTF("prefiltering mode: squashing min_length constraint\n");
         min_length = 0;
     }
 }
 
+ParsedExpression::ParsedExpression(const ParsedExpression &other,
+                                   unsigned index_in, ReportID actionId)
+    : utf8(other.utf8),
+      component(other.component->clone()),
+      allow_vacuous(other.allow_vacuous),
+      highlander(other.highlander),
+      prefilter(other.prefilter),
+      quiet(other.quiet),
+      som(other.som),
+      index(index_in),
+      id(actionId),
+      min_offset(other.min_offset),
+      max_offset(other.max_offset),
+      min_length(other.min_length),
+      max_matches(other.max_matches),
+      confirm_window(other.confirm_window),
+      prefilter_states(other.prefilter_states),
+      edit_distance(other.edit_distance),
+      hamming(other.hamming),
+      has_user_data(other.has_user_data),
+      user_data(other.user_data),
+      confirm(other.confirm),
+      confirm_prog(other.confirm_prog) {}
+
 #if defined(DUMP_SUPPORT) || defined(DEBUG)
 /**
  * \brief Dumps the parse tree to screen in debug mode and to disk in dump
@@ -218,12 +337,16 @@ void optimise(ParsedExpression &expr) {
     expr.component->optimise(true /* root is connected to sds */);
 }
 
-void addExpression(NG &ng, unsigned index, const char *expression,
-                   unsigned flags, const hs_expr_ext *ext, ReportID id) {
+unique_ptr<ParsedExpression> parseExpression(const CompileContext &cc,
+                                             unsigned index,
+                                             const char *expression,
+                                             unsigned flags,
+                                             const hs_expr_ext *ext,
+                                             ReportID id) {
     assert(expression);
-    const CompileContext &cc = ng.cc;
     DEBUG_PRINTF("index=%u, id=%u, flags=%u, expr='%s'\n", index, id, flags,
                  expression);
+    PhaseTimer timer(cc, PHASE_PARSE, index);
 
     // Ensure that our pattern isn't too long (in characters).
     if (strlen(expression) > cc.grey.limitPatternLength) {
@@ -232,31 +355,72 @@ void addExpression(NG &ng, unsigned index, const char *expression,
 
     // Do per-expression processing: errors here will result in an exception
     // being thrown up to our caller
-    ParsedExpression expr(index, expression, flags, id, ext);
-    dumpExpression(expr, "orig", cc.grey);
+    auto expr = ue2::make_unique<ParsedExpression>(index, expression, flags,
+                                                   id, ext);
+
+    // Start of match is never reported in any-match mode, so there is no
+    // point tracking it.
+    if (cc.any_match) {
+        expr->som = SOM_NONE;
+    }
+    dumpExpression(*expr, "orig", cc.grey);
+
+    // Confirm programs check the original expression, so must be built before
+    // prefiltering rewrites it.
+    if (expr->confirm) {
+        u64a window = expr->confirm_window ? expr->confirm_window
+                                           : cc.grey.confirmWindow;
+        if (window > cc.grey.confirmMaxWindow) {
+            ostringstream err;
+            err << "In hs_expr_ext, confirm_window must be at most "
+                << cc.grey.confirmMaxWindow << ".";
+            throw CompileError(err.str());
+        }
+        expr->confirm_prog = buildConfirmProgram(*expr->component,
+                                                 verify_u32(window));
+    }
 
     // Apply prefiltering transformations if desired.
-    if (expr.prefilter) {
-        prefilterTree(expr.component, ParseMode(flags));
-        dumpExpression(expr, "prefiltered", cc.grey);
+    if (expr->prefilter) {
+        prefilterTree(expr->component, ParseMode(flags));
+        dumpExpression(*expr, "prefiltered", cc.grey);
     }
 
     // Expressions containing zero-width assertions and other extended pcre
     // types aren't supported yet. This call will throw a ParseError exception
     // if the component tree contains such a construct.
-    checkUnsupported(*expr.component);
+    checkUnsupported(*expr->component);
 
-    expr.component->checkEmbeddedStartAnchor(true);
-    expr.component->checkEmbeddedEndAnchor(true);
+    expr->component->checkEmbeddedStartAnchor(true);
+    expr->component->checkEmbeddedEndAnchor(true);
 
     if (cc.grey.optimiseComponentTree) {
-        optimise(expr);
-        dumpExpression(expr, "opt", cc.grey);
+        optimise(*expr);
+        dumpExpression(*expr, "opt", cc.grey);
     }
 
+    return expr;
+}
+
+void addParsedExpression(NG &ng, const ParsedExpression &expr) {
+    const CompileContext &cc = ng.cc;
     DEBUG_PRINTF("component=%p, nfaId=%u, reportId=%u\n",
                  expr.component.get(), expr.index, expr.id);
 
+    ng.rm.pl.addPattern(expr.index, expr.id, expr.quiet);
+    ng.rm.setConfirm(expr.id, expr.confirm_prog, expr.index);
+
+    // Highlander patterns already stop after one match, and quiet patterns
+    // are never reported, so a match limit is only needed for the others.
+    if (expr.max_matches && !expr.highlander && !expr.quiet) {
+        ng.rm.setMatchLimit(expr.id, verify_u32(expr.max_matches),
+                            expr.index);
+    }
+
+    if (expr.has_user_data) {
+        ng.rm.setUserData(expr.id, expr.user_data, expr.index);
+    }
+
     // You can only use the SOM flags if you've also specified an SOM
     // precision mode.
     if (expr.som != SOM_NONE && cc.streaming && !ng.ssm.somPrecision()) {
@@ -285,17 +449,383 @@ void addExpression(NG &ng, unsigned index, const char *expression,
                            "HS_FLAG_ALLOWEMPTY to enable support.");
     }
 
+    // Expressions with identical graphs share their roles and engines; the
+    // graph is added to Rose by NG::flushSharedGraphs.
+    ng.addSharedGraph(move(g));
+}
+
+/** \brief Flags that may be used with HS_FLAG_COMBINATION. */
+static const unsigned COMBINATION_FLAGS_SUPPORTED =
+    HS_FLAG_COMBINATION | HS_FLAG_SINGLEMATCH;
+
+void addCombination(NG &ng, unsigned index, const char *expression,
+                    unsigned flags, const hs_expr_ext *ext, ReportID id) {
+    assert(expression);
+    assert(flags & HS_FLAG_COMBINATION);
+    DEBUG_PRINTF("index=%u, id=%u, flags=%u, logical='%s'\n", index, id,
+                 flags, expression);
+
+    if (flags & ~HS_FLAG_ALL) {
+        DEBUG_PRINTF("Unrecognised flag, flags=%u.\n", flags);
+        throw CompileError("Unrecognised flag.");
+    }
+
+    if (flags & ~COMBINATION_FLAGS_SUPPORTED) {
+        throw CompileError("Only HS_FLAG_SINGLEMATCH is supported in "
+                           "combination with HS_FLAG_COMBINATION.");
+    }
+
+    if (ext && ext->flags) {
+        throw CompileError("Extended parameters are not supported for "
+                           "logical combinations.");
+    }
+
+    if (strlen(expression) > ng.cc.grey.limitPatternLength) {
+        throw CompileError("Pattern length exceeds limit.");
+    }
+
+    // Matches for a combination are raised at most once per scan, so
+    // HS_FLAG_SINGLEMATCH needs no further handling.
+    ng.rm.pl.addCombination(index, id, expression);
+}
+
+void addExpression(NG &ng, unsigned index, const char *expression,
+                   unsigned flags, const hs_expr_ext *ext, ReportID id) {
+    if (flags & HS_FLAG_COMBINATION) {
+        addCombination(ng, index, expression, flags, ext, id);
+        return;
+    }
+
+    auto expr = parseExpression(ng.cc, index, expression, flags, ext, id);
+    addParsedExpression(ng, *expr);
+}
+
+/** \brief Number of expressions to parse ahead of the NG per worker thread.
+ *
+ * Parsed component trees are held until the serial half of the compile
+ * consumes them, so this bounds the memory used by the parallel front end. */
+static const unsigned PARSE_WINDOW_PER_THREAD = 256;
+
+/** \brief Appends the bytes of \a val to \a key. */
+template<typename T>
+static
+void appendKey(string &key, const T &val) {
+    key.append((const char *)&val, sizeof(val));
+}
+
+/**
+ * \brief Finds repeated expressions, which parse to the same component tree.
+ *
+ * Two expressions are repeats if their text, flags and extended parameters
+ * are identical. On return, source[i] is the index of the first occurrence of
+ * expression i, and last_use[i] is the index of the last repeat of expression
+ * i (or i itself if it is never repeated).
+ */
+static
+void findRepeatedExpressions(unsigned count, const char *const *expressions,
+                             const unsigned *flags,
+                             const hs_expr_ext *const *ext,
+                             vector<unsigned> &source,
+                             vector<unsigned> &last_use) {
+    source.resize(count);
+    last_use.resize(count);
+
+    unordered_map<string, unsigned> seen;
+    string key;
+    for (unsigned i = 0; i < count; i++) {
+        source[i] = i;
+        last_use[i] = i;
+
+        const unsigned fl = flags ? flags[i] : 0;
+        if (fl & HS_FLAG_COMBINATION) {
+            continue;
+        }
+
+        key.assign(expressions[i]);
+        key.push_back('\0');
+        appendKey(key, fl);
+        const hs_expr_ext *e = ext ? ext[i] : nullptr;
+        if (e && e->flags) {
+            appendKey(key, e->flags);
+            appendKey(key, e->flags & HS_EXT_FLAG_MIN_OFFSET ? e->min_offset
+                                                              : 0ULL);
+            appendKey(key, e->flags & HS_EXT_FLAG_MAX_OFFSET ? e->max_offset
+                                                              : 0ULL);
+            appendKey(key, e->flags & HS_EXT_FLAG_MIN_LENGTH ? e->min_length
+                                                              : 0ULL);
+            appendKey(key, e->flags & HS_EXT_FLAG_MAX_MATCHES ? e->max_matches
+                                                               : 0ULL);
+            appendKey(key, e->flags & HS_EXT_FLAG_CONFIRM_WINDOW
+                               ? e->confirm_window : 0ULL);
+            appendKey(key, e->flags & HS_EXT_FLAG_PREFILTER_STATES
+                               ? e->prefilter_states : 0ULL);
+            appendKey(key, e->flags & HS_EXT_FLAG_EDIT_DISTANCE
+                               ? e->edit_distance : 0ULL);
+            appendKey(key, e->flags & HS_EXT_FLAG_HAMMING_DISTANCE
+                               ? e->hamming_distance : 0ULL);
+            appendKey(key, e->flags & HS_EXT_FLAG_USER_DATA ? e->user_data
+                                                             : 0ULL);
+        }
+
+        auto it = seen.emplace(move(key), i).first;
+        key.clear();
+        source[i] = it->second;
+        last_use[it->second] = i;
+    }
+}
+
+void addExpressions(NG &ng, unsigned count, const char *const *expressions,
+                    const unsigned *flags, const hs_expr_ext *const *ext,
+                    const unsigned *ids, unsigned threads) {
+    // Graph reduction on the components of a single expression may also use
+    // the workers, even when there is only one expression to parse.
+    ng.compileThreads = max(threads, 1U);
+
+    // Rule sets often repeat an expression under several IDs. Each distinct
+    // expression is parsed once; a pristine copy of its component tree is
+    // held until its last repeat has been added.
+    vector<unsigned> source;
+    vector<unsigned> last_use;
+    findRepeatedExpressions(count, expressions, flags, ext, source, last_use);
+    unordered_map<unsigned, unique_ptr<ParsedExpression>> originals;
+
+    const CompileContext &cc = ng.cc;
+
+    auto parse_one = [&](unsigned i) {
+        return parseExpression(cc, i, expressions[i], flags ? flags[i] : 0,
+                               ext ? ext[i] : nullptr, ids ? ids[i] : 0);
+    };
+
+    // Adds expression i, given its parse result (null for a repeat).
+    auto add_parsed = [&](unsigned i, unique_ptr<ParsedExpression> expr) {
+        const unsigned src = source[i];
+        if (src != i) {
+            assert(!expr);
+            auto it = originals.find(src);
+            assert(it != originals.end());
+            expr = ue2::make_unique<ParsedExpression>(*it->second, i,
+                                                      ids ? ids[i] : 0);
+            if (last_use[src] == i) {
+                originals.erase(it);
+            }
+        } else if (last_use[i] != i) {
+            // Graph construction may rewrite the component tree, so the
+            // repeats are copied from one taken before it runs.
+            originals.emplace(i, ue2::make_unique<ParsedExpression>(
+                                     *expr, i, expr->id));
+        }
+        addParsedExpression(ng, *expr);
+    };
+
+    threads = min(threads, count);
+    if (threads <= 1) {
+        for (unsigned i = 0; i < count; i++) {
+            try {
+                if (flags && (flags[i] & HS_FLAG_COMBINATION)) {
+                    addCombination(ng, i, expressions[i], flags[i],
+                                   ext ? ext[i] : nullptr, ids ? ids[i] : 0);
+                    continue;
+                }
+                add_parsed(i, source[i] == i ? parse_one(i) : nullptr);
+            } catch (CompileError &e) {
+                /* Caught a parse error:
+                 * throw it upstream as a CompileError with a specific index */
+                e.setExpressionIndex(i);
+                throw; /* do not slice */
+            }
+        }
+        ng.flushSharedGraphs();
+        return;
+    }
+
+    DEBUG_PRINTF("parsing %u expressions with %u threads\n", count, threads);
+
+    // Parsing and the component tree passes only read the CompileContext, so
+    // we run them on a pool of workers. Everything that touches the NG (graph
+    // construction, reports, Rose) is done serially in expression order, which
+    // keeps the output identical to a single-threaded compile.
+    const unsigned window = threads * PARSE_WINDOW_PER_THREAD;
+
+    for (unsigned base = 0; base < count; base += window) {
+        const unsigned n = min(window, count - base);
+        vector<unique_ptr<ParsedExpression>> parsed(n);
+        vector<exception_ptr> errors(n);
+        atomic<unsigned> next(0);
+
+        auto worker = [&]() {
+            for (unsigned j = next++; j < n; j = next++) {
+                const unsigned i = base + j;
+                if (flags && (flags[i] & HS_FLAG_COMBINATION)) {
+                    continue; // handled in the serial pass
+                }
+                if (source[i] != i) {
+                    continue; // copied from its first occurrence
+                }
+                try {
+                    parsed[j] = parse_one(i);
+                } catch (...) {
+                    errors[j] = current_exception();
+                }
+            }
+        };
+
+        vector<thread> pool;
+        try {
+            for (unsigned t = 1; t < threads; t++) {
+                pool.emplace_back(worker);
+            }
+        } catch (const system_error &) {
+            // Couldn't start another thread; carry on with the ones we have.
+            DEBUG_PRINTF("only started %zu extra threads\n", pool.size());
+        }
+        worker();
+        for (auto &t : pool) {
+            t.join();
+        }
+
+        for (unsigned j = 0; j < n; j++) {
+            const unsigned i = base + j;
+            try {
+                if (errors[j]) {
+                    rethrow_exception(errors[j]);
+                }
+                if (flags && (flags[i] & HS_FLAG_COMBINATION)) {
+                    addCombination(ng, i, expressions[i], flags[i],
+                                   ext ? ext[i] : nullptr, ids ? ids[i] : 0);
+                    continue;
+                }
+                add_parsed(i, move(parsed[j]));
+            } catch (CompileError &e) {
+                e.setExpressionIndex(i);
+                throw; /* do not slice */
+            }
+        }
+    }
+
+    ng.flushSharedGraphs();
+}
+
+/** \brief Flags that are meaningful for a pure literal. */
+static const unsigned LIT_FLAGS_SUPPORTED =
+    HS_FLAG_CASELESS | HS_FLAG_SINGLEMATCH | HS_FLAG_SOM_LEFTMOST |
+    HS_FLAG_QUIET;
+
+/**
+ * \brief Build a simple chain graph for a literal that Rose would not take
+ * directly, so that it can go through the usual graph path.
+ */
+static
+unique_ptr<NGWrapper> buildLiteralWrapper(ReportManager &rm,
+                                          const CompileContext &cc,
+                                          const ue2_literal &lit,
+                                          unsigned index, bool highlander,
+                                          som_type som, ReportID id) {
+    auto g = ue2::make_unique<NGWrapper>(index, highlander, false, false, som,
+                                         id, 0, MAX_OFFSET, 0);
+
+    NFAVertex u = g->startDs;
+    for (const auto &c : lit) {
+        NFAVertex v = add_vertex(*g);
+        (*g)[v].char_reach = c;
+        add_edge(u, v, *g);
+        u = v;
+    }
+
+    Report ir = rm.getBasicInternalReport(*g);
+    (*g)[u].reports.insert(rm.getInternalId(ir));
+    add_edge(u, g->accept, *g);
+
+    if (num_vertices(*g) > cc.grey.limitGraphVertices) {
+        throw CompileError("Pattern too large.");
+    }
+
+    return g;
+}
+
+void addLitExpression(NG &ng, unsigned index, const char *expression,
+                      size_t len, unsigned flags, ReportID id) {
+    assert(expression);
+    const CompileContext &cc = ng.cc;
+    DEBUG_PRINTF("index=%u, id=%u, flags=%u, len=%zu\n", index, id, flags,
+                 len);
+
+    if (flags & ~HS_FLAG_ALL) {
+        DEBUG_PRINTF("Unrecognised flag, flags=%u.\n", flags);
+        throw CompileError("Unrecognised flag.");
+    }
+
+    if (flags & ~LIT_FLAGS_SUPPORTED) {
+        throw CompileError("Only HS_FLAG_CASELESS, HS_FLAG_SINGLEMATCH, "
+                           "HS_FLAG_SOM_LEFTMOST and HS_FLAG_QUIET are "
+                           "supported for literals.");
+    }
+
+    if (len == 0) {
+        throw CompileError("Literal must not be empty.");
+    }
+
+    if (len > cc.grey.limitPatternLength) {
+        throw CompileError("Pattern length exceeds limit.");
+    }
+
+    const bool highlander = flags & HS_FLAG_SINGLEMATCH;
+    const som_type som = (flags & HS_FLAG_SOM_LEFTMOST) && !cc.any_match
+                             ? SOM_LEFT : SOM_NONE;
+
+    // FIXME: we disallow highlander + SOM, see UE-1850.
+    if (highlander && som != SOM_NONE) {
+        throw CompileError("HS_FLAG_SINGLEMATCH is not supported in "
+                           "combination with HS_FLAG_SOM_LEFTMOST.");
+    }
+
+    if (som != SOM_NONE && cc.streaming && !ng.ssm.somPrecision()) {
+        throw CompileError("To use a SOM expression flag in streaming mode, "
+                           "an SOM precision mode (e.g. "
+                           "HS_MODE_SOM_HORIZON_LARGE) must be specified.");
+    }
+
+    ng.rm.pl.addPattern(index, id, flags & HS_FLAG_QUIET);
+    ng.rm.setConfirm(id, nullptr, index);
+
+    const ue2_literal lit(string(expression, len), flags & HS_FLAG_CASELESS);
+    DEBUG_PRINTF("literal %s\n", dumpString(lit).c_str());
+
+    // Single-byte highlander literals are better served by the graph path,
+    // as for shortcutLiteral().
+    if (cc.grey.allowLiteral && !(highlander && len <= 1) &&
+        ng.addLiteral(lit, index, id, highlander, som)) {
+        DEBUG_PRINTF("added literal directly to rose\n");
+        return;
+    }
+
+    auto g = buildLiteralWrapper(ng.rm, cc, lit, index, highlander, som, id);
     if (!ng.addGraph(*g)) {
-        DEBUG_PRINTF("NFA addGraph failed on ID %u.\n", expr.id);
+        DEBUG_PRINTF("NFA addGraph failed on ID %u.\n", id);
         throw CompileError("Error compiling expression.");
     }
 }
 
+void addLitExpressions(NG &ng, unsigned count, const char *const *expressions,
+                       const size_t *lens, const unsigned *flags,
+                       const unsigned *ids) {
+    for (unsigned i = 0; i < count; i++) {
+        try {
+            addLitExpression(ng, i, expressions[i], lens[i],
+                             flags ? flags[i] : 0, ids ? ids[i] : 0);
+        } catch (CompileError &e) {
+            e.setExpressionIndex(i);
+            throw; /* do not slice */
+        }
+    }
+}
+
 static
 aligned_unique_ptr<RoseEngine> generateRoseEngine(NG &ng) {
     const u32 minWidth =
         ng.minWidth.is_finite() ? verify_u32(ng.minWidth) : ROSE_BOUND_INF;
-    auto rose = ng.rose->buildRose(minWidth);
+    const u32 maxWidth =
+        ng.maxWidth.is_finite() ? verify_u32(ng.maxWidth) : ROSE_BOUND_INF;
+    auto rose = ng.rose->buildRose(minWidth, maxWidth);
 
     if (!rose) {
         DEBUG_PRINTF("error building rose\n");
@@ -303,6 +833,10 @@ aligned_unique_ptr<RoseEngine> generateRoseEngine(NG &ng) {
         return nullptr;
     }
 
+    // Logical combinations may be satisfied at the end of any stream.
+    rose->maxMatchOffset =
+        ng.rm.pl.numCombinations() ? MAX_OFFSET : ng.maxOffset;
+
     dumpRose(*ng.rose, rose.get(), ng.cc.grey);
     dumpReportManager(ng.rm, ng.cc.grey);
     dumpSomSlotManager(ng.ssm, ng.cc.grey);
@@ -318,22 +852,41 @@ platform_t target_to_platform(const target_t &target_info) {
     if (!target_info.has_avx2()) {
         p |= HS_PLATFORM_NOAVX2;
     }
+    if (!target_info.has_avx512()) {
+        p |= HS_PLATFORM_NOAVX512;
+    }
+    if (!target_info.has_avx512vbmi()) {
+        p |= HS_PLATFORM_NOAVX512VBMI;
+    }
     return p;
 }
 
-struct hs_database *build(NG &ng, unsigned int *length) {
-    assert(length);
+static
+aligned_unique_ptr<RoseEngine> buildEngine(NG &ng) {
+    // Any graphs still held back for sharing must be added before the widths
+    // and the Rose graph are final.
+    ng.flushSharedGraphs();
+
+    // All sub-pattern IDs of logical combinations must now be known.
+    ng.rm.pl.validateSubIds();
 
     auto rose = generateRoseEngine(ng);
     if (!rose) {
         throw CompileError("Unable to generate bytecode.");
     }
-    *length = roseSize(rose.get());
-    if (!*length) {
+    if (!roseSize(rose.get())) {
         DEBUG_PRINTF("RoseEngine has zero length\n");
         assert(0);
         throw CompileError("Internal error.");
     }
+    return rose;
+}
+
+struct hs_database *build(NG &ng, unsigned int *length) {
+    assert(length);
+
+    auto rose = buildEngine(ng);
+    *length = roseSize(rose.get());
 
     const char *bytecode = (const char *)(rose.get());
     const platform_t p = target_to_platform(ng.cc.target_info);
@@ -345,6 +898,35 @@ struct hs_database *build(NG &ng, unsigned int *length) {
     return db;
 }
 
+struct hs_database *buildMultiMode(NG &block_ng, NG &stream_ng,
+                                   unsigned int *length) {
+    assert(length);
+    assert(!block_ng.cc.streaming && stream_ng.cc.streaming);
+
+    auto block_rose = buildEngine(block_ng);
+    auto stream_rose = buildEngine(stream_ng);
+
+    // The streaming engine follows the block engine, cacheline-aligned, and
+    // is found through the block engine's altModeOffset.
+    const size_t block_len = roseSize(block_rose.get());
+    const size_t stream_start = ROUNDUP_CL(block_len);
+    const size_t stream_len = roseSize(stream_rose.get());
+    block_rose->altModeOffset = verify_u32(stream_start);
+    *length = verify_u32(stream_start + stream_len);
+
+    vector<char> bytecode(*length, 0);
+    memcpy(bytecode.data(), block_rose.get(), block_len);
+    memcpy(bytecode.data() + stream_start, stream_rose.get(), stream_len);
+
+    const platform_t p = target_to_platform(block_ng.cc.target_info);
+    struct hs_database *db = dbCreate(bytecode.data(), *length, p);
+    if (!db) {
+        throw CompileError("Could not allocate memory for bytecode.");
+    }
+
+    return db;
+}
+
 static
 void stripFromPositions(vector<PositionInfo> &v, Position pos) {
     auto removed = remove(v.begin(), v.end(), PositionInfo(pos));
@@ -412,6 +994,7 @@ bool isSupported(const Component &c) {
 unique_ptr<NGWrapper> buildWrapper(ReportManager &rm, const CompileContext &cc,
                                    const ParsedExpression &expr) {
     assert(isSupported(*expr.component));
+    PhaseTimer timer(cc, PHASE_PARSE, expr.index);
 
     const unique_ptr<NFABuilder> builder = makeNFABuilder(rm, cc, expr);
     assert(builder);
@@ -443,6 +1026,13 @@ unique_ptr<NGWrapper> buildWrapper(ReportManager &rm, const CompileContext &cc,
     dumpDotWrapper(*g, "00_before_asserts", cc.grey);
     removeAssertVertices(rm, *g);
 
+    if (expr.edit_distance) {
+        validate_fuzzy_compile(*g, expr.edit_distance, expr.hamming,
+                               expr.utf8, cc.grey);
+        make_fuzzy(*g, expr.edit_distance, expr.hamming, cc.grey);
+        dumpDotWrapper(*g, "00_after_fuzzy", cc.grey);
+    }
+
     return g;
 }
 
@@ -47,6 +47,7 @@ struct hs_expr_ext;
 namespace ue2 {
 
 struct CompileContext;
+struct ConfirmProgram;
 struct Grey;
 struct target_t;
 class NG;
@@ -61,6 +62,11 @@ public:
     ParsedExpression(unsigned index, const char *expression, unsigned flags,
                      ReportID actionId, const hs_expr_ext *ext = nullptr);
 
+    /** \brief Copy of \a other for a repeat of the same expression at
+     * \a index with ID \a actionId, which need not be parsed again. */
+    ParsedExpression(const ParsedExpression &other, unsigned index,
+                     ReportID actionId);
+
     bool utf8; //!< UTF-8 mode flag specified
 
     /** \brief root node of parsed component tree. */
@@ -69,6 +75,7 @@ public:
     const bool allow_vacuous;   //!< HS_FLAG_ALLOWEMPTY specified
     const bool highlander;      //!< HS_FLAG_SINGLEMATCH specified
     const bool prefilter;       //!< HS_FLAG_PREFILTER specified
+    const bool quiet;           //!< HS_FLAG_QUIET specified
     som_type som;               //!< chosen SOM mode, or SOM_NONE
 
     /** \brief index in expressions array passed to \ref hs_compile_multi */
@@ -78,6 +85,20 @@ public:
     u64a min_offset;   //!< 0 if not used
     u64a max_offset;   //!< MAX_OFFSET if not used
     u64a min_length;   //!< 0 if not used
+    u64a max_matches;  //!< 0 if not used
+    u64a confirm_window; //!< 0 if not used
+    u32 prefilter_states; //!< 0 if not used
+    u32 edit_distance; //!< 0 if not used
+    bool hamming; //!< edit_distance is a Hamming distance
+    bool has_user_data; //!< user_data is set
+    u64a user_data; //!< from hs_expr_ext::user_data
+
+    /** \brief HS_FLAG_CONFIRM specified. */
+    const bool confirm;
+
+    /** \brief Confirm program, built from the original component tree if
+     * \ref confirm is set. */
+    std::shared_ptr<const ConfirmProgram> confirm_prog;
 };
 
 /**
@@ -101,6 +122,95 @@ public:
 void addExpression(NG &ng, unsigned index, const char *expression,
                    unsigned flags, const hs_expr_ext *ext, ReportID actionId);
 
+/**
+ * Add a logical combination (an expression with HS_FLAG_COMBINATION) to the
+ * compiler. The IDs it refers to are checked against the rest of the pattern
+ * set in \ref build.
+ *
+ * Arguments are as for \ref addExpression.
+ */
+void addCombination(NG &ng, unsigned index, const char *expression,
+                    unsigned flags, const hs_expr_ext *ext, ReportID actionId);
+
+/**
+ * Parse an expression and run the component tree passes on it, without
+ * adding it to the compiler. This only reads the compile context and may be
+ * called for different expressions concurrently.
+ *
+ * Arguments are as for \ref addExpression.
+ */
+std::unique_ptr<ParsedExpression> parseExpression(const CompileContext &cc,
+                                                  unsigned index,
+                                                  const char *expression,
+                                                  unsigned flags,
+                                                  const hs_expr_ext *ext,
+                                                  ReportID actionId);
+
+/**
+ * Add an expression returned by \ref parseExpression to the compiler. Its
+ * graph may be held back to share with later identical expressions until
+ * NG::flushSharedGraphs is called.
+ */
+void addParsedExpression(NG &ng, const ParsedExpression &expr);
+
+/**
+ * Add an array of expressions to the compiler, in order. Compile errors are
+ * thrown with the index of the offending expression set.
+ *
+ * @param ng
+ *      The global NG object.
+ * @param count
+ *      The number of expressions.
+ * @param expressions
+ *      Array of NULL-terminated PCRE expressions.
+ * @param flags
+ *      Array of flags for each expression, or NULL.
+ * @param ext
+ *      Array of extended parameter structures, or NULL.
+ * @param ids
+ *      Array of identifiers for each expression, or NULL.
+ * @param threads
+ *      Number of threads to use for parsing and graph reduction; the result
+ *      does not depend on this value.
+ */
+void addExpressions(NG &ng, unsigned count, const char *const *expressions,
+                    const unsigned *flags, const hs_expr_ext *const *ext,
+                    const unsigned *ids, unsigned threads);
+
+/**
+ * Add a pure literal to the compiler, bypassing the regex parser. The literal
+ * may contain any byte values, including NUL.
+ *
+ * @param ng
+ *      The global NG object.
+ * @param index
+ *      The index of the literal (used for errors)
+ * @param expression
+ *      Literal bytes; not required to be NULL-terminated.
+ * @param len
+ *      The length of the literal in bytes.
+ * @param flags
+ *      The Hyperscan flags associated with this literal. Only
+ *      HS_FLAG_CASELESS, HS_FLAG_SINGLEMATCH, HS_FLAG_SOM_LEFTMOST and
+ *      HS_FLAG_QUIET are supported.
+ * @param actionId
+ *      The identifier to associate with the literal; returned by engine on
+ *      match.
+ */
+void addLitExpression(NG &ng, unsigned index, const char *expression,
+                      size_t len, unsigned flags, ReportID actionId);
+
+/**
+ * Add an array of pure literals to the compiler, in order. Compile errors are
+ * thrown with the index of the offending literal set.
+ *
+ * Arguments are as for \ref addExpressions, with @a lens giving the length
+ * in bytes of each literal.
+ */
+void addLitExpressions(NG &ng, unsigned count, const char *const *expressions,
+                       const size_t *lens, const unsigned *flags,
+                       const unsigned *ids);
+
 /**
  * Build a Hyperscan database out of the expressions we've been given. A
  * fatal error will result in an exception being thrown.
@@ -115,6 +225,24 @@ void addExpression(NG &ng, unsigned index, const char *expression,
  */
 struct hs_database *build(NG &ng, unsigned int *length);
 
+/**
+ * Build a multi-mode database, holding both a block mode engine and a
+ * streaming engine compiled from the same patterns. The runtime picks the
+ * engine for each API call according to its mode.
+ *
+ * @param block_ng
+ *      The global NG object for the block mode compile.
+ * @param stream_ng
+ *      The global NG object for the streaming compile.
+ * @param[out] length
+ *      The number of bytes occupied by the compiled structure.
+ * @return
+ *      The compiled structure. Should be deallocated with the
+ *      hs_database_free() function.
+ */
+struct hs_database *buildMultiMode(NG &block_ng, NG &stream_ng,
+                                   unsigned int *length);
+
 /**
  * Constructs an NFA graph from the given expression tree.
  *
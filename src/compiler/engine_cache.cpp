@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Cache of built engines, shared between compiles.
+ */
+#include "engine_cache.h"
+
+#include "nfa/nfa_internal.h"
+#include "nfa/nfa_kind.h"
+#include "nfa/rdfa.h"
+#include "util/compile_context.h"
+#include "util/report_manager.h"
+#include "util/verify_types.h"
+
+#include <cstring>
+#include <type_traits>
+
+using namespace std;
+
+namespace ue2 {
+
+aligned_unique_ptr<NFA> EngineCache::find(const string &key) const {
+    lock_guard<mutex> guard(lock);
+    auto it = engines.find(key);
+    if (it == engines.end()) {
+        return nullptr;
+    }
+
+    const vector<char> &bytecode = it->second;
+    auto nfa = aligned_zmalloc_unique<NFA>(bytecode.size());
+    memcpy(nfa.get(), bytecode.data(), bytecode.size());
+    assert(nfa->length == bytecode.size());
+    return nfa;
+}
+
+void EngineCache::insert(const string &key, const NFA &nfa) {
+    const char *bytecode = (const char *)&nfa;
+    lock_guard<mutex> guard(lock);
+    auto rv = engines.emplace(key, vector<char>(bytecode,
+                                                bytecode + nfa.length));
+    if (rv.second) {
+        total_bytes += key.size() + nfa.length;
+    }
+}
+
+size_t EngineCache::size() const {
+    lock_guard<mutex> guard(lock);
+    return engines.size();
+}
+
+size_t EngineCache::bytes() const {
+    lock_guard<mutex> guard(lock);
+    return total_bytes;
+}
+
+namespace {
+
+/** \brief Accumulates a key as a flat string of bytes. */
+class KeyWriter {
+public:
+    template<typename T>
+    void add(const T &val) {
+        static_assert(std::is_integral<T>::value, "integers only");
+        key.append((const char *)&val, sizeof(val));
+    }
+
+    void addReports(const flat_set<ReportID> &reports,
+                    const ReportManager &rm, bool managed) {
+        add(verify_u32(reports.size()));
+        for (ReportID id : reports) {
+            // Managed reports are written into the bytecode as program
+            // offsets, which change as patterns are added and removed.
+            add(managed ? rm.getProgramOffset(id) : id);
+        }
+    }
+
+    string key;
+};
+
+} // namespace
+
+string dfaEngineKey(const raw_dfa &rdfa, const ReportManager &rm,
+                    const CompileContext &cc) {
+    KeyWriter w;
+
+    // Describe the build environment: the parts of the target and mode that
+    // engine construction looks at.
+    w.add(u8{'D'});
+    w.add(u8{cc.streaming});
+    w.add(u8{cc.vectored});
+    w.add(u8{cc.target_info.has_avx2()});
+    w.add(u8{cc.target_info.has_avx512()});
+    w.add(u8{cc.target_info.has_avx512vbmi()});
+    w.add(u8{cc.target_info.is_atom_class()});
+
+    const bool managed = has_managed_reports(rdfa.kind);
+    w.add((u32)rdfa.kind);
+    w.add(rdfa.start_anchored);
+    w.add(rdfa.start_floating);
+    w.add(rdfa.alpha_size);
+    for (u16 c : rdfa.alpha_remap) {
+        w.add(c);
+    }
+
+    w.add(verify_u32(rdfa.states.size()));
+    for (const dstate &ds : rdfa.states) {
+        w.add(ds.daddy);
+        assert(ds.next.size() == rdfa.alpha_size);
+        for (dstate_id_t s : ds.next) {
+            w.add(s);
+        }
+        w.addReports(ds.reports, rm, managed);
+        w.addReports(ds.reports_eod, rm, managed);
+    }
+
+    return move(w.key);
+}
+
+} // namespace ue2
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Cache of built engines, shared between compiles.
+ *
+ * Rule updates usually add or remove a handful of patterns, leaving most of
+ * the engines in the database unchanged. The engine cache allows a compile to
+ * reuse the bytecode built for an identical engine in an earlier compile,
+ * skipping its construction.
+ *
+ * Engines are keyed on a canonical serialisation of everything their bytecode
+ * depends on, so a cached engine is only reused when the build would have
+ * produced exactly the same bytes.
+ */
+
+#ifndef ENGINE_CACHE_H
+#define ENGINE_CACHE_H
+
+#include "ue2common.h"
+#include "util/alloc.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/core/noncopyable.hpp>
+
+struct NFA;
+
+namespace ue2 {
+
+struct CompileContext;
+struct raw_dfa;
+class ReportManager;
+
+/** \brief Map from engine key to engine bytecode; safe for concurrent use by
+ * several compiles. */
+class EngineCache : boost::noncopyable {
+public:
+    /** \brief Returns a copy of the engine stored under \a key, or nullptr if
+     * there is none. */
+    aligned_unique_ptr<NFA> find(const std::string &key) const;
+
+    /** \brief Stores a copy of \a nfa under \a key. */
+    void insert(const std::string &key, const NFA &nfa);
+
+    /** \brief Number of engines held. */
+    size_t size() const;
+
+    /** \brief Memory held by the cached keys and engines, in bytes. */
+    size_t bytes() const;
+
+private:
+    mutable std::mutex lock;
+    std::unordered_map<std::string, std::vector<char>> engines;
+    size_t total_bytes = 0;
+};
+
+/**
+ * \brief Key for a DFA engine built from \a rdfa.
+ *
+ * Should be called on the raw_dfa in the state it is in immediately before
+ * the engine is built; see \ref getDfa in rose_build_bytecode.cpp.
+ */
+std::string dfaEngineKey(const raw_dfa &rdfa, const ReportManager &rm,
+                         const CompileContext &cc);
+
+} // namespace ue2
+
+#endif // ENGINE_CACHE_H
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Partitioning of a pattern set into several smaller databases.
+ *
+ * Patterns are placed greedily, those with the most literals first. Each goes
+ * to the database that already holds the most of its literals, among those
+ * with room for the rest; a pattern that fits nowhere opens a new database.
+ * A literal shared by patterns in two databases is matched by both, so
+ * keeping them together keeps the total literal matcher work down.
+ */
+#include "partition.h"
+
+#include "hs_compile.h"
+#include "nfagraph/ng_expr_info.h"
+#include "util/verify_types.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ue2 {
+
+namespace {
+
+/** \brief Engine groups for patterns with no literal: these become outfixes,
+ * which Rose can only merge with others of the same kind. */
+enum OutfixClass {
+    OUTFIX_DFA,
+    OUTFIX_NFA,
+    OUTFIX_OTHER,
+    OUTFIX_CLASS_COUNT
+};
+
+struct Part {
+    u32 literals = 0;
+    u32 confirms = 0;
+    bool outfix[OUTFIX_CLASS_COUNT] = {false, false, false};
+    vector<u32> patterns;
+};
+
+} // namespace
+
+static
+OutfixClass outfixClass(const ExpressionCostInfo &cost) {
+    if (cost.engines & HS_EXPR_ENGINE_DFA) {
+        return OUTFIX_DFA;
+    }
+    if (cost.engines & HS_EXPR_ENGINE_LIMEX) {
+        return OUTFIX_NFA;
+    }
+    return OUTFIX_OTHER;
+}
+
+vector<vector<u32>> partitionPatterns(const vector<ExpressionCostInfo> &costs,
+                                      const PartitionLimits &limits) {
+    assert(limits.max_parts);
+
+    vector<u32> order(costs.size());
+    for (u32 i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&costs](u32 a, u32 b) {
+        return costs[a].literals.size() > costs[b].literals.size();
+    });
+
+    vector<Part> parts;
+    unordered_map<string, vector<u32>> lit_parts; // literal -> parts using it
+    vector<u32> hits;
+
+    for (u32 i : order) {
+        const ExpressionCostInfo &cost = costs[i];
+
+        // Count the literals each part already has.
+        hits.assign(parts.size(), 0);
+        for (const auto &lit : cost.literals) {
+            auto it = lit_parts.find(lit);
+            if (it == lit_parts.end()) {
+                continue;
+            }
+            for (u32 p : it->second) {
+                hits[p]++;
+            }
+        }
+
+        // A pattern with no literal is confirmed by its engine instead, which
+        // we count as one confirm.
+        const u32 confirms = max(verify_u32(cost.literals.size()), 1U);
+        const OutfixClass oc = outfixClass(cost);
+        if (cost.literals.empty()) {
+            for (u32 p = 0; p < parts.size(); p++) {
+                hits[p] = parts[p].outfix[oc];
+            }
+        }
+
+        auto has_room = [&](u32 p) {
+            u32 new_lits = verify_u32(cost.literals.size()) - hits[p];
+            return parts[p].literals + new_lits <= limits.max_literals &&
+                   parts[p].confirms + confirms <= limits.max_confirms;
+        };
+
+        u32 best = verify_u32(parts.size());
+        for (u32 p = 0; p < parts.size(); p++) {
+            if (has_room(p) && (best == parts.size() || hits[p] > hits[best])) {
+                best = p;
+            }
+        }
+
+        if (best == parts.size() && parts.size() >= limits.max_parts) {
+            // Out of databases: overfill the closest match, or failing that,
+            // the least loaded.
+            best = 0;
+            for (u32 p = 1; p < parts.size(); p++) {
+                u32 load = parts[p].literals + parts[p].confirms;
+                u32 best_load = parts[best].literals + parts[best].confirms;
+                if (hits[p] > hits[best] ||
+                    (hits[p] == hits[best] && load < best_load)) {
+                    best = p;
+                }
+            }
+        }
+
+        if (best == parts.size()) {
+            DEBUG_PRINTF("pattern %u opens database %u\n", i, best);
+            parts.emplace_back();
+            hits.push_back(0);
+        }
+
+        Part &part = parts[best];
+        part.literals += verify_u32(cost.literals.size()) - hits[best];
+        part.confirms += confirms;
+        part.patterns.push_back(i);
+        if (cost.literals.empty()) {
+            part.outfix[oc] = true;
+        }
+        for (const auto &lit : cost.literals) {
+            auto &lp = lit_parts[lit];
+            if (find(lp.begin(), lp.end(), best) == lp.end()) {
+                lp.push_back(best);
+            }
+        }
+    }
+
+    vector<vector<u32>> rv;
+    rv.reserve(parts.size());
+    for (auto &part : parts) {
+        DEBUG_PRINTF("database %zu: %zu patterns, %u literals, %u confirms\n",
+                     rv.size(), part.patterns.size(), part.literals,
+                     part.confirms);
+        sort(part.patterns.begin(), part.patterns.end());
+        rv.push_back(move(part.patterns));
+    }
+    return rv;
+}
+
+} // namespace ue2
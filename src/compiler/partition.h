@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Partitioning of a pattern set into several smaller databases.
+ */
+
+#ifndef COMPILER_PARTITION_H
+#define COMPILER_PARTITION_H
+
+#include "ue2common.h"
+
+#include <vector>
+
+namespace ue2 {
+
+struct ExpressionCostInfo;
+
+/** \brief Caps on the literal matcher and confirm work given to each
+ * database in a partitioned compile. */
+struct PartitionLimits {
+    u32 max_parts; //!< most databases to produce, at least one
+    u32 max_literals; //!< distinct literals per database
+    u32 max_confirms; //!< pattern/literal pairs per database
+};
+
+/**
+ * \brief Divide patterns between databases.
+ *
+ * Patterns that share literals are kept together where the limits allow, so
+ * that each literal is matched and confirmed once, and patterns with no
+ * literal are grouped by engine type, so that Rose can merge their engines.
+ * Once \a limits.max_parts databases are in use, the limits are exceeded
+ * rather than a pattern being dropped.
+ *
+ * Returns the indices of the patterns in each database, in ascending order.
+ */
+std::vector<std::vector<u32>>
+partitionPatterns(const std::vector<ExpressionCostInfo> &costs,
+                  const PartitionLimits &limits);
+
+} // namespace ue2
+
+#endif // COMPILER_PARTITION_H
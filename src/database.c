@@ -33,6 +33,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
 #include "allocator.h"
 #include "hs_common.h"
 #include "hs_internal.h"
@@ -40,7 +44,18 @@
 #include "ue2common.h"
 #include "database.h"
 #include "crc32.h"
+#include "fdr/fdr_internal.h"
+#include "hwlm/hashlit_internal.h"
+#include "hwlm/hwlm_internal.h"
+#include "hwlm/noodle_internal.h"
+#include "hwlm/sblit_internal.h"
+#include "nfa/nfa_internal.h"
 #include "rose/rose_internal.h"
+#include "smallwrite/smallwrite_internal.h"
+#include "state.h"
+#include "util/delta.h"
+#include "util/lz.h"
+#include "util/popcount.h"
 #include "util/unaligned.h"
 
 static really_inline
@@ -48,9 +63,21 @@ int db_correctly_aligned(const void *db) {
     return ISALIGNED_N(db, alignof(unsigned long long));
 }
 
+// As validDatabase, but also rejects databases in an engine store, which
+// refer to engines outside their bytecode and so cannot be copied or
+// serialized.
+static really_inline
+hs_error_t validOwnDatabase(const hs_database_t *db) {
+    hs_error_t ret = validDatabase(db);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+    return db_is_shared(db) ? HS_INVALID : HS_SUCCESS;
+}
+
 HS_PUBLIC_API
 hs_error_t hs_free_database(hs_database_t *db) {
-    if (db && db->magic != HS_DB_MAGIC) {
+    if (db && (db->magic != HS_DB_MAGIC || db_is_shared(db))) {
         return HS_INVALID;
     }
     hs_database_free(db);
@@ -58,6 +85,29 @@ hs_error_t hs_free_database(hs_database_t *db) {
     return HS_SUCCESS;
 }
 
+// Write the serialized header for the database into out, which must have
+// room for sizeof(struct hs_database) bytes. Returns a pointer to the first
+// unused header word.
+static
+u32 *db_encode_header(char *out, const hs_database_t *db, u32 magic) {
+    u32 *buf = (u32 *)out;
+    *buf = magic;
+    buf++;
+    *buf = db->version;
+    buf++;
+    *buf = db->length;
+    buf++;
+    memcpy(buf, &db->platform, sizeof(u64a));
+    buf += 2;
+    *buf = db->crc32;
+    buf++;
+    *buf = db->flags;
+    buf++;
+    *buf = db->reserved1;
+    buf++;
+    return buf;
+}
+
 HS_PUBLIC_API
 hs_error_t hs_serialize_database(const hs_database_t *db, char **bytes,
                                  size_t *serialized_length) {
@@ -69,7 +119,7 @@ hs_error_t hs_serialize_database(const hs_database_t *db, char **bytes,
         return HS_BAD_ALIGN;
     }
 
-    hs_error_t ret = validDatabase(db);
+    hs_error_t ret = validOwnDatabase(db);
     if (ret != HS_SUCCESS) {
         return ret;
     }
@@ -85,21 +135,7 @@ hs_error_t hs_serialize_database(const hs_database_t *db, char **bytes,
 
     memset(out, 0, length);
 
-    u32 *buf = (u32 *)out;
-    *buf = db->magic;
-    buf++;
-    *buf = db->version;
-    buf++;
-    *buf = db->length;
-    buf++;
-    memcpy(buf, &db->platform, sizeof(u64a));
-    buf += 2;
-    *buf = db->crc32;
-    buf++;
-    *buf = db->reserved0;
-    buf++;
-    *buf = db->reserved1;
-    buf++;
+    u32 *buf = db_encode_header(out, db, db->magic);
 
     const char *bytecode = hs_get_bytecode(db);
     memcpy(buf, bytecode, db->length);
@@ -109,28 +145,89 @@ hs_error_t hs_serialize_database(const hs_database_t *db, char **bytes,
     return HS_SUCCESS;
 }
 
+HS_PUBLIC_API
+hs_error_t hs_serialize_database_compressed(const hs_database_t *db,
+                                            char **bytes,
+                                            size_t *serialized_length) {
+    if (!db || !bytes || !serialized_length) {
+        return HS_INVALID;
+    }
+
+    if (!db_correctly_aligned(db)) {
+        return HS_BAD_ALIGN;
+    }
+
+    hs_error_t ret = validOwnDatabase(db);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    u32 *table = hs_misc_alloc(LZ_TABLE_ENTRIES * sizeof(u32));
+    ret = hs_check_alloc(table);
+    if (ret != HS_SUCCESS) {
+        hs_misc_free(table);
+        return ret;
+    }
+
+    // We allocate for the worst case rather than compressing into a temporary
+    // buffer, as the databases that benefit most are very large. The caller
+    // only sees the length actually used.
+    size_t bound = lz_compress_bound(db->length);
+    size_t alloc_len = sizeof(struct hs_database) + bound;
+    char *out = hs_misc_alloc(alloc_len);
+    ret = hs_check_alloc(out);
+    if (ret != HS_SUCCESS) {
+        hs_misc_free(out);
+        hs_misc_free(table);
+        return ret;
+    }
+
+    // The header is as for hs_serialize_database, with its length and CRC
+    // describing the uncompressed bytecode, followed by the compressed length
+    // and then the compressed bytecode. As in the uncompressed format, the
+    // total length is that of the compressed bytecode plus a full header,
+    // with the unused space zeroed at the end.
+    u32 *buf = db_encode_header(out, db, HS_DB_COMPRESSED_MAGIC);
+    char *packed = (char *)(buf + 1);
+
+    size_t packed_len = lz_compress(hs_get_bytecode(db), db->length, packed,
+                                    bound, table);
+    hs_misc_free(table);
+    if (!packed_len || packed_len > 0xffffffffULL) {
+        hs_misc_free(out);
+        return HS_INVALID;
+    }
+    *buf = (u32)packed_len;
+
+    size_t length = sizeof(struct hs_database) + packed_len;
+    memset(packed + packed_len, 0, out + length - (packed + packed_len));
+
+    *bytes = out;
+    *serialized_length = length;
+    return HS_SUCCESS;
+}
+
 // check that the database header's platform is compatible with the current
 // runtime platform.
 static
 hs_error_t db_check_platform(const u64a p) {
     if (p != hs_current_platform
-        && p != hs_current_platform_no_avx2) {
+        && p != (hs_current_platform | hs_current_platform_no_avx2)
+        && p != (hs_current_platform | hs_current_platform_no_avx512)
+        && p != (hs_current_platform | hs_current_platform_no_avx512vbmi)) {
         return HS_DB_PLATFORM_ERROR;
     }
     // passed all checks
     return HS_SUCCESS;
 }
 
-// Decode and check the database header, returning appropriate errors or
-// HS_SUCCESS if it's OK. The header should be allocated on the stack
-// and later copied into the deserialized database.
+// Decode the fields common to all serialized headers, accepting either of
+// the magic numbers given, and advance buf past them. The magic number found
+// is returned in magic.
 static
-hs_error_t db_decode_header(const char **bytes, const size_t length,
-                            struct hs_database *header) {
-    if (!*bytes) {
-        return HS_INVALID;
-    }
-
+hs_error_t db_decode_fields(const u32 **buf, const size_t length,
+                            struct hs_database *header, u32 magic_a,
+                            u32 magic_b, u32 *magic) {
     if (length < sizeof(struct hs_database)) {
         return HS_INVALID;
     }
@@ -138,39 +235,224 @@ hs_error_t db_decode_header(const char **bytes, const size_t length,
     // There's no requirement, really, that the serialized stream of bytes
     // we've been given is 4-byte aligned, so we use unaligned loads here.
 
-    const u32 *buf = (const u32 *)*bytes;
-
     // Zero header so that none of it (e.g. its padding) is uninitialized.
     memset(header, 0, sizeof(struct hs_database));
 
-    header->magic = unaligned_load_u32(buf++);
-    if (header->magic != HS_DB_MAGIC) {
+    *magic = unaligned_load_u32((*buf)++);
+    if (*magic != magic_a && *magic != magic_b) {
         return HS_INVALID;
     }
+    header->magic = HS_DB_MAGIC;
 
-    header->version = unaligned_load_u32(buf++);
+    header->version = unaligned_load_u32((*buf)++);
     if (header->version != HS_DB_VERSION) {
         return HS_DB_VERSION_ERROR;
     }
 
-    header->length = unaligned_load_u32(buf++);
-    if (length != sizeof(struct hs_database) + header->length) {
-        DEBUG_PRINTF("bad length %zu, expecting %zu\n", length,
-                     sizeof(struct hs_database) + header->length);
+    header->length = unaligned_load_u32((*buf)++);
+    header->platform = unaligned_load_u64a(*buf);
+    *buf += 2;
+    header->crc32 = unaligned_load_u32((*buf)++);
+    header->flags = unaligned_load_u32((*buf)++);
+    header->reserved1 = unaligned_load_u32((*buf)++);
+
+    // Databases in an engine store are never serialized.
+    if (header->flags & HS_DB_FLAG_SHARED) {
         return HS_INVALID;
     }
 
-    header->platform = unaligned_load_u64a(buf);
-    buf += 2;
-    header->crc32 = unaligned_load_u32(buf++);
-    header->reserved0 = unaligned_load_u32(buf++);
-    header->reserved1 = unaligned_load_u32(buf++);
+    return HS_SUCCESS;
+}
+
+// Decode and check the database header, returning appropriate errors or
+// HS_SUCCESS if it's OK. The header should be allocated on the stack
+// and later copied into the deserialized database. For a compressed database,
+// packed_len is set to the length of the compressed bytecode, otherwise zero.
+static
+hs_error_t db_decode_header(const char **bytes, const size_t length,
+                            struct hs_database *header, size_t *packed_len) {
+    if (!*bytes) {
+        return HS_INVALID;
+    }
+
+    const u32 *buf = (const u32 *)*bytes;
+    u32 magic;
+    hs_error_t ret = db_decode_fields(&buf, length, header, HS_DB_MAGIC,
+                                      HS_DB_COMPRESSED_MAGIC, &magic);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    *packed_len = 0;
+    size_t body_len = header->length;
+    if (magic == HS_DB_COMPRESSED_MAGIC) {
+        *packed_len = unaligned_load_u32(buf++);
+        body_len = *packed_len;
+    }
+
+    if (length != sizeof(struct hs_database) + body_len) {
+        DEBUG_PRINTF("bad length %zu, expecting %zu\n", length,
+                     sizeof(struct hs_database) + body_len);
+        return HS_INVALID;
+    }
 
     *bytes = (const char *)buf;
 
     return HS_SUCCESS; // Header checks out
 }
 
+/** \brief Where the bytecode of a serialized database is found: stored
+ * directly (possibly compressed), or as a delta against another bytecode. */
+struct db_body {
+    const char *bytes; //!< bytecode, compressed bytecode or delta
+    size_t packed_len; //!< compressed length, 0 if not compressed
+    const char *base; //!< bytecode the delta applies to, NULL if not a delta
+    size_t base_len;
+    size_t delta_len;
+};
+
+/** \brief Number of fixed u32 fields at the start of a multi-target
+ * database: magic, version, variant count and a reserved word. */
+#define DB_MULTI_TARGET_FIELDS 4
+
+/** \brief Size of each multi-target variant table entry: platform, offset and
+ * length. */
+#define DB_MULTI_TARGET_ENTRY (sizeof(u64a) + 2 * sizeof(u32))
+
+static
+u32 db_platform_missing_features(u64a p) {
+    return popcount64(p & (HS_PLATFORM_NOAVX2 | HS_PLATFORM_NOAVX512 |
+                           HS_PLATFORM_NOAVX512VBMI));
+}
+
+// Decode a multi-target database, choosing the variant that uses the most
+// features of the current platform. If any_platform is set and no variant
+// suits the current platform, the first variant is chosen.
+static
+hs_error_t db_decode_multi_target(const char *bytes, const size_t length,
+                                  struct hs_database *header,
+                                  struct db_body *body, int any_platform) {
+    const size_t fixed = DB_MULTI_TARGET_FIELDS * sizeof(u32);
+    if (length < fixed) {
+        return HS_INVALID;
+    }
+
+    const u32 *buf = (const u32 *)bytes;
+    if (unaligned_load_u32(buf) != HS_DB_MULTI_TARGET_MAGIC) {
+        return HS_INVALID;
+    }
+    if (unaligned_load_u32(buf + 1) != HS_DB_VERSION) {
+        return HS_DB_VERSION_ERROR;
+    }
+    u32 count = unaligned_load_u32(buf + 2);
+    if (!count || count > (length - fixed) / DB_MULTI_TARGET_ENTRY) {
+        return HS_INVALID;
+    }
+
+    const char *table = bytes + fixed;
+    u32 best = count;
+    for (u32 i = 0; i < count; i++) {
+        const char *entry = table + i * DB_MULTI_TARGET_ENTRY;
+        u64a p = unaligned_load_u64a(entry);
+        if (db_check_platform(p) != HS_SUCCESS) {
+            continue;
+        }
+        if (best == count ||
+            db_platform_missing_features(p) <
+                db_platform_missing_features(unaligned_load_u64a(
+                    table + best * DB_MULTI_TARGET_ENTRY))) {
+            best = i;
+        }
+    }
+    if (best == count) {
+        if (!any_platform) {
+            return HS_DB_PLATFORM_ERROR;
+        }
+        best = 0;
+    }
+    DEBUG_PRINTF("chose variant %u of %u\n", best, count);
+
+    const char *variants[2];
+    size_t variant_lens[2];
+    u32 chosen[2] = { 0, best };
+    for (u32 i = 0; i < 2; i++) {
+        const char *entry = table + chosen[i] * DB_MULTI_TARGET_ENTRY;
+        u32 offset = unaligned_load_u32((const u32 *)(entry + sizeof(u64a)));
+        u32 len = unaligned_load_u32((const u32 *)(entry + sizeof(u64a)) + 1);
+        if (offset > length || len > length - offset) {
+            return HS_INVALID;
+        }
+        variants[i] = bytes + offset;
+        variant_lens[i] = len;
+    }
+
+    // The first variant is a complete serialized database.
+    const char *base = variants[0];
+    size_t packed_len;
+    hs_error_t ret = db_decode_header(&base, variant_lens[0], header,
+                                      &packed_len);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    memset(body, 0, sizeof(*body));
+    body->bytes = base;
+    body->packed_len = packed_len;
+    if (!best) {
+        return HS_SUCCESS;
+    }
+
+    // The others are deltas against the first, which is never compressed.
+    if (packed_len) {
+        return HS_INVALID;
+    }
+    u32 base_length = header->length;
+    u32 base_crc = header->crc32;
+
+    const u32 *vbuf = (const u32 *)variants[1];
+    u32 magic;
+    ret = db_decode_fields(&vbuf, variant_lens[1], header, HS_DB_DELTA_MAGIC,
+                           HS_DB_DELTA_MAGIC, &magic);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+    if (unaligned_load_u32(vbuf++) != base_length ||
+        unaligned_load_u32(vbuf++) != base_crc) {
+        DEBUG_PRINTF("variant is not relative to the first\n");
+        return HS_INVALID;
+    }
+
+    body->bytes = (const char *)vbuf;
+    body->packed_len = 0;
+    body->base = base;
+    body->base_len = base_length;
+    body->delta_len = variant_lens[1] - sizeof(struct hs_database);
+    return HS_SUCCESS;
+}
+
+// Decode the header of any serialized database that describes a complete
+// database: plain, compressed or multi-target.
+static
+hs_error_t db_decode_serialized(const char *bytes, const size_t length,
+                                struct hs_database *header,
+                                struct db_body *body, int any_platform) {
+    if (!bytes) {
+        return HS_INVALID;
+    }
+
+    if (length >= sizeof(u32) &&
+        unaligned_load_u32(bytes) == HS_DB_MULTI_TARGET_MAGIC) {
+        return db_decode_multi_target(bytes, length, header, body,
+                                      any_platform);
+    }
+
+    memset(body, 0, sizeof(*body));
+    hs_error_t ret = db_decode_header(&bytes, length, header,
+                                      &body->packed_len);
+    body->bytes = bytes;
+    return ret;
+}
+
 // Check the CRC on a database
 static
 hs_error_t db_check_crc(const hs_database_t *db) {
@@ -183,15 +465,53 @@ hs_error_t db_check_crc(const hs_database_t *db) {
     return HS_SUCCESS;
 }
 
+// Set the bytecode offset so that the bytecode is cacheline aligned, and
+// return a pointer to it.
 static
-void db_copy_bytecode(const char *serialized, hs_database_t *db) {
+char *db_place_bytecode(hs_database_t *db) {
     // we need to align things manually
     uintptr_t shift = (uintptr_t)db->bytes & 0x3f;
     db->bytecode = offsetof(struct hs_database, bytes) - shift;
-    char *bytecode = (char *)db + db->bytecode;
+    return (char *)db + db->bytecode;
+}
 
+static
+void db_copy_bytecode(const char *serialized, hs_database_t *db) {
     // Copy the bytecode into place
-    memcpy(bytecode, serialized, db->length);
+    memcpy(db_place_bytecode(db), serialized, db->length);
+}
+
+// Copy the serialized bytecode into place, decompressing it straight into the
+// database if packed_len is non-zero.
+static
+hs_error_t db_load_bytecode(const char *serialized, size_t packed_len,
+                            hs_database_t *db) {
+    if (!packed_len) {
+        db_copy_bytecode(serialized, db);
+        return HS_SUCCESS;
+    }
+
+    if (!lz_decompress(serialized, packed_len, db_place_bytecode(db),
+                       db->length)) {
+        DEBUG_PRINTF("bad compressed bytecode\n");
+        return HS_INVALID;
+    }
+    return HS_SUCCESS;
+}
+
+// Build the bytecode described by body in place in db.
+static
+hs_error_t db_load_body(const struct db_body *body, hs_database_t *db) {
+    if (!body->base) {
+        return db_load_bytecode(body->bytes, body->packed_len, db);
+    }
+
+    if (!delta_apply(body->base, body->base_len, body->bytes, body->delta_len,
+                     db_place_bytecode(db), db->length)) {
+        DEBUG_PRINTF("bad delta\n");
+        return HS_INVALID;
+    }
+    return HS_SUCCESS;
 }
 
 HS_PUBLIC_API
@@ -208,7 +528,8 @@ hs_error_t hs_deserialize_database_at(const char *bytes, const size_t length,
 
     // Decode the header
     hs_database_t header;
-    hs_error_t ret = db_decode_header(&bytes, length, &header);
+    struct db_body body;
+    hs_error_t ret = db_decode_serialized(bytes, length, &header, &body, 0);
     if (ret != HS_SUCCESS) {
         return ret;
     }
@@ -227,9 +548,8 @@ hs_error_t hs_deserialize_database_at(const char *bytes, const size_t length,
     memcpy(db, &header, sizeof(header));
 
     // Copy the bytecode into the correctly-aligned location, set offsets
-    db_copy_bytecode(bytes, db);
-
-    if (db_check_crc(db) != HS_SUCCESS) {
+    if (db_load_body(&body, db) != HS_SUCCESS ||
+        db_check_crc(db) != HS_SUCCESS) {
         return HS_INVALID;
     }
 
@@ -247,7 +567,8 @@ hs_error_t hs_deserialize_database(const char *bytes, const size_t length,
 
     // Decode and check the header
     hs_database_t header;
-    hs_error_t ret = db_decode_header(&bytes, length, &header);
+    struct db_body body;
+    hs_error_t ret = db_decode_serialized(bytes, length, &header, &body, 0);
     if (ret != HS_SUCCESS) {
         return ret;
     }
@@ -274,9 +595,8 @@ hs_error_t hs_deserialize_database(const char *bytes, const size_t length,
     memcpy(tempdb, &header, sizeof(header));
 
     // Copy the bytecode into the correctly-aligned location, set offsets
-    db_copy_bytecode(bytes, tempdb);
-
-    if (db_check_crc(tempdb) != HS_SUCCESS) {
+    if (db_load_body(&body, tempdb) != HS_SUCCESS ||
+        db_check_crc(tempdb) != HS_SUCCESS) {
         hs_database_free(tempdb);
         return HS_INVALID;
     }
@@ -285,6 +605,381 @@ hs_error_t hs_deserialize_database(const char *bytes, const size_t length,
     return HS_SUCCESS;
 }
 
+HS_PUBLIC_API
+hs_error_t hs_serialize_database_delta(const hs_database_t *old_db,
+                                       const hs_database_t *new_db,
+                                       char **bytes, size_t *length) {
+    if (!old_db || !new_db || !bytes || !length) {
+        return HS_INVALID;
+    }
+
+    if (!db_correctly_aligned(old_db) || !db_correctly_aligned(new_db)) {
+        return HS_BAD_ALIGN;
+    }
+
+    hs_error_t ret = validOwnDatabase(old_db);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+    ret = validOwnDatabase(new_db);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    const char *base = hs_get_bytecode(old_db);
+    const char *target = hs_get_bytecode(new_db);
+
+    u32 *table = hs_misc_alloc(delta_table_entries(old_db->length) *
+                               sizeof(u32));
+    ret = hs_check_alloc(table);
+    if (ret != HS_SUCCESS) {
+        hs_misc_free(table);
+        return ret;
+    }
+
+    // Size the delta first so that we can allocate exactly what we need.
+    size_t delta_len = delta_encode(base, old_db->length, target,
+                                    new_db->length, NULL, 0, table);
+    if (!delta_len) {
+        hs_misc_free(table);
+        return HS_INVALID;
+    }
+
+    size_t out_len = sizeof(struct hs_database) + delta_len;
+    char *out = hs_misc_alloc(out_len);
+    ret = hs_check_alloc(out);
+    if (ret != HS_SUCCESS) {
+        hs_misc_free(out);
+        hs_misc_free(table);
+        return ret;
+    }
+
+    memset(out, 0, out_len);
+
+    // The header is that of the new database, followed by the length and CRC
+    // of the base database the patch applies to, and then the delta. As with
+    // the other formats, the total length is that of the delta plus a full
+    // header, with the unused space zeroed at the end.
+    u32 *buf = db_encode_header(out, new_db, HS_DB_DELTA_MAGIC);
+    *buf++ = old_db->length;
+    *buf++ = old_db->crc32;
+
+    size_t written = delta_encode(base, old_db->length, target,
+                                  new_db->length, (char *)buf, delta_len,
+                                  table);
+    hs_misc_free(table);
+    if (written != delta_len) {
+        hs_misc_free(out);
+        return HS_INVALID;
+    }
+
+    *bytes = out;
+    *length = out_len;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_apply_database_delta(const hs_database_t *old_db,
+                                   const char *bytes, size_t length,
+                                   hs_database_t **new_db) {
+    if (!old_db || !bytes || !new_db) {
+        return HS_INVALID;
+    }
+
+    *new_db = NULL;
+
+    if (!db_correctly_aligned(old_db)) {
+        return HS_BAD_ALIGN;
+    }
+
+    hs_error_t ret = validOwnDatabase(old_db);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    // Decode and check the header
+    const u32 *buf = (const u32 *)bytes;
+    hs_database_t header;
+    u32 magic;
+    ret = db_decode_fields(&buf, length, &header, HS_DB_DELTA_MAGIC,
+                           HS_DB_DELTA_MAGIC, &magic);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    // The patch must have been made against this exact database.
+    u32 base_length = unaligned_load_u32(buf++);
+    u32 base_crc = unaligned_load_u32(buf++);
+    if (base_length != old_db->length || base_crc != old_db->crc32) {
+        DEBUG_PRINTF("patch is for a different database\n");
+        return HS_INVALID;
+    }
+
+    ret = db_check_platform(header.platform);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    // Allocate space for new database
+    size_t dblength = sizeof(struct hs_database) + header.length;
+    struct hs_database *tempdb = hs_database_alloc(dblength);
+    ret = hs_check_alloc(tempdb);
+    if (ret != HS_SUCCESS) {
+        hs_database_free(tempdb);
+        return ret;
+    }
+
+    // Zero new space for safety
+    memset(tempdb, 0, dblength);
+
+    // Copy the decoded header into place
+    memcpy(tempdb, &header, sizeof(header));
+
+    // Rebuild the bytecode in the correctly-aligned location from the base
+    // bytecode and the delta, and check that we got the database we expected.
+    size_t delta_len = length - sizeof(struct hs_database);
+    if (!delta_apply(hs_get_bytecode(old_db), old_db->length,
+                     (const char *)buf, delta_len, db_place_bytecode(tempdb),
+                     tempdb->length) ||
+        db_check_crc(tempdb) != HS_SUCCESS) {
+        hs_database_free(tempdb);
+        return HS_INVALID;
+    }
+
+    *new_db = tempdb;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_serialize_database_multi_target(const hs_database_t *const *dbs,
+                                              unsigned int count,
+                                              char **bytes, size_t *length) {
+    if (!dbs || !count || !bytes || !length) {
+        return HS_INVALID;
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        if (!dbs[i]) {
+            return HS_INVALID;
+        }
+        if (!db_correctly_aligned(dbs[i])) {
+            return HS_BAD_ALIGN;
+        }
+        hs_error_t ret = validOwnDatabase(dbs[i]);
+        if (ret != HS_SUCCESS) {
+            return ret;
+        }
+        // Variants must be for distinct targets and scan in the same modes.
+        const struct RoseEngine *t = hs_get_bytecode(dbs[i]);
+        const struct RoseEngine *t0 = hs_get_bytecode(dbs[0]);
+        if (i && (t->mode != t0->mode ||
+                  !roseAltModeEngine(t) != !roseAltModeEngine(t0))) {
+            return HS_INVALID;
+        }
+        for (u32 j = 0; j < i; j++) {
+            if (dbs[j]->platform == dbs[i]->platform) {
+                return HS_INVALID;
+            }
+        }
+    }
+
+    // The first variant is serialized in full, and the others as deltas
+    // against it, so that the parts of the bytecode that do not depend on the
+    // target are only stored once.
+    char **parts = hs_misc_alloc(count * sizeof(char *));
+    size_t *part_lens = hs_misc_alloc(count * sizeof(size_t));
+    if (!parts || !part_lens) {
+        hs_misc_free(parts);
+        hs_misc_free(part_lens);
+        return HS_NOMEM;
+    }
+    memset(parts, 0, count * sizeof(char *));
+
+    hs_error_t ret = hs_serialize_database(dbs[0], &parts[0], &part_lens[0]);
+    for (u32 i = 1; i < count && ret == HS_SUCCESS; i++) {
+        ret = hs_serialize_database_delta(dbs[0], dbs[i], &parts[i],
+                                          &part_lens[i]);
+    }
+
+    size_t header_len = DB_MULTI_TARGET_FIELDS * sizeof(u32)
+                      + count * DB_MULTI_TARGET_ENTRY;
+    size_t out_len = ROUNDUP_N(header_len, 8);
+    for (u32 i = 0; ret == HS_SUCCESS && i < count; i++) {
+        out_len += ROUNDUP_N(part_lens[i], 8);
+    }
+
+    char *out = NULL;
+    if (ret == HS_SUCCESS) {
+        if (out_len > ~0U) {
+            ret = HS_INVALID;
+        } else {
+            out = hs_misc_alloc(out_len);
+            ret = hs_check_alloc(out);
+        }
+    }
+
+    if (ret == HS_SUCCESS) {
+        memset(out, 0, out_len);
+        u32 *buf = (u32 *)out;
+        buf[0] = HS_DB_MULTI_TARGET_MAGIC;
+        buf[1] = HS_DB_VERSION;
+        buf[2] = count;
+        buf[3] = 0;
+
+        char *entry = out + DB_MULTI_TARGET_FIELDS * sizeof(u32);
+        size_t offset = ROUNDUP_N(header_len, 8);
+        for (u32 i = 0; i < count; i++) {
+            u32 fields[2] = { (u32)offset, (u32)part_lens[i] };
+            memcpy(entry, &dbs[i]->platform, sizeof(u64a));
+            memcpy(entry + sizeof(u64a), fields, sizeof(fields));
+            entry += DB_MULTI_TARGET_ENTRY;
+            memcpy(out + offset, parts[i], part_lens[i]);
+            offset += ROUNDUP_N(part_lens[i], 8);
+        }
+        assert(offset == out_len);
+
+        *bytes = out;
+        *length = out_len;
+    } else {
+        hs_misc_free(out);
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        hs_misc_free(parts[i]);
+    }
+    hs_misc_free(parts);
+    hs_misc_free(part_lens);
+    return ret;
+}
+
+/** \brief Offset of the bytecode in a database image, which is laid out as
+ * a database allocated at a cacheline-aligned address would be. */
+static really_inline
+u32 db_image_bytecode_offset(void) {
+    size_t offset = offsetof(struct hs_database, bytes);
+    return (u32)(offset - (offset & 0x3f));
+}
+
+HS_PUBLIC_API
+hs_error_t hs_serialize_database_image(const hs_database_t *db, char **bytes,
+                                       size_t *length) {
+    if (!db || !bytes || !length) {
+        return HS_INVALID;
+    }
+
+    if (!db_correctly_aligned(db)) {
+        return HS_BAD_ALIGN;
+    }
+
+    hs_error_t ret = validOwnDatabase(db);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    size_t image_len = sizeof(struct hs_database) + db->length;
+    char *out = hs_misc_alloc(image_len);
+    ret = hs_check_alloc(out);
+    if (ret != HS_SUCCESS) {
+        hs_misc_free(out);
+        return ret;
+    }
+
+    memset(out, 0, image_len);
+
+    // The image is position independent, so it doesn't matter whether the
+    // buffer we're writing it into is itself aligned.
+    struct hs_database header;
+    memset(&header, 0, sizeof(header));
+    header.magic = db->magic;
+    header.version = db->version;
+    header.length = db->length;
+    header.platform = db->platform;
+    header.crc32 = db->crc32;
+    header.bytecode = db_image_bytecode_offset();
+    memcpy(out, &header, offsetof(struct hs_database, padding));
+    memcpy(out + header.bytecode, hs_get_bytecode(db), db->length);
+
+    *bytes = out;
+    *length = image_len;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_map_database(const char *bytes, size_t length,
+                           const hs_database_t **db) {
+    if (!bytes || !db) {
+        return HS_INVALID;
+    }
+
+    *db = NULL;
+
+    // The image must be cacheline aligned for the bytecode within it to be.
+    if (!ISALIGNED_CL(bytes)) {
+        return HS_BAD_ALIGN;
+    }
+
+    if (length < sizeof(struct hs_database)) {
+        return HS_INVALID;
+    }
+
+    const struct hs_database *image = (const struct hs_database *)bytes;
+    hs_error_t ret = validOwnDatabase(image);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    if (length != sizeof(struct hs_database) + image->length ||
+        image->bytecode != db_image_bytecode_offset()) {
+        DEBUG_PRINTF("bad image length %zu or bytecode offset %u\n", length,
+                     image->bytecode);
+        return HS_INVALID;
+    }
+
+    // Checks platform, alignment and CRC. Note that this reads the whole
+    // image, but does not write to it.
+    ret = dbIsValid(image);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    *db = image;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_clone_database(const hs_database_t *src, hs_database_t **dest) {
+    if (!dest) {
+        return HS_INVALID;
+    }
+
+    *dest = NULL;
+
+    hs_error_t ret = validOwnDatabase(src);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    size_t dblength = sizeof(struct hs_database) + src->length;
+    struct hs_database *db = hs_database_alloc(dblength);
+    ret = hs_check_alloc(db);
+    if (ret != HS_SUCCESS) {
+        hs_database_free(db);
+        return ret;
+    }
+
+    // Write every byte of the new database from this thread, so that its
+    // pages are placed locally under a first-touch policy.
+    memset(db, 0, dblength);
+    memcpy(db, src, sizeof(struct hs_database));
+    db_copy_bytecode(hs_get_bytecode(src), db);
+    assert(ISALIGNED_CL(hs_get_bytecode(db)));
+
+    // The CRC was checked when the source was built or loaded and is copied
+    // rather than recomputed.
+    *dest = db;
+    return HS_SUCCESS;
+}
+
 HS_PUBLIC_API
 hs_error_t hs_database_size(const hs_database_t *db, size_t *size) {
     if (!size) {
@@ -300,12 +995,277 @@ hs_error_t hs_database_size(const hs_database_t *db, size_t *size) {
     return HS_SUCCESS;
 }
 
+/** \brief Stride used to touch every page of a database; no larger than any
+ * page size we run on. */
+#define WARM_PAGE_SIZE 4096
+
+static
+void warmPrefetch(const void *ptr, size_t len) {
+    const char *p = (const char *)ROUNDDOWN_PTR(ptr, 64);
+    const char *end = (const char *)ptr + len;
+    for (; p < end; p += 64) {
+        __builtin_prefetch(p);
+    }
+}
+
+size_t hwlmTableSize(const struct HWLM *h) {
+    const void *eng = HWLM_C_DATA(h);
+    size_t engSize = 0;
+
+    switch (h->type) {
+    case HWLM_ENGINE_NOOD:
+        engSize = sizeof(struct noodTable)
+                + ((const struct noodTable *)eng)->len;
+        break;
+    case HWLM_ENGINE_NOOD_MULTI:
+        engSize = ((const struct noodMultiTable *)eng)->size;
+        break;
+    case HWLM_ENGINE_HASH:
+        engSize = ((const struct hashLitTable *)eng)->size;
+        break;
+    case HWLM_ENGINE_SMALL:
+        engSize = ((const struct sbLitTable *)eng)->size;
+        break;
+    case HWLM_ENGINE_FDR:
+        engSize = ((const struct FDR *)eng)->size;
+        break;
+    }
+
+    return engSize + ROUNDUP_CL(sizeof(*h));
+}
+
+static
+void warmHwlm(const struct RoseEngine *t, u32 offset) {
+    if (!offset) {
+        return;
+    }
+    const struct HWLM *h = (const struct HWLM *)((const char *)t + offset);
+    warmPrefetch(h, hwlmTableSize(h));
+}
+
+/** \brief Prefetches the tables read on every scan against engine \a t: the
+ * engine header, the literal matchers, the small-write engine and the engine
+ * for each NFA queue. */
+static
+void warmRoseEngine(const struct RoseEngine *t) {
+    warmPrefetch(t, sizeof(*t));
+
+    warmHwlm(t, t->fmatcherOffset);
+    warmHwlm(t, t->ematcherOffset);
+    warmHwlm(t, t->sbmatcherOffset);
+
+    if (t->amatcherOffset) {
+        const struct anchored_matcher_info *curr = getALiteralMatcher(t);
+        for (;;) {
+            const struct NFA *nfa
+                = (const struct NFA *)((const char *)curr + sizeof(*curr));
+            warmPrefetch(curr, sizeof(*curr) + nfa->length);
+            if (!curr->next_offset) {
+                break;
+            }
+            curr = (const void *)((const char *)curr + curr->next_offset);
+        }
+    }
+
+    if (t->smallWriteOffset) {
+        const struct SmallWriteEngine *smwr = (const void *)
+            ((const char *)t + t->smallWriteOffset);
+        warmPrefetch(smwr, smwr->size);
+    }
+
+    const struct NfaInfo *infos
+        = (const struct NfaInfo *)((const char *)t + t->nfaInfoOffset);
+    warmPrefetch(infos, t->queueCount * sizeof(*infos));
+    for (u32 qi = 0; qi < t->queueCount; qi++) {
+        const struct NFA *nfa
+            = (const struct NFA *)((const char *)t + infos[qi].nfaOffset);
+        warmPrefetch(nfa, nfa->length);
+    }
+}
+
+HS_PUBLIC_API
+hs_error_t hs_database_warm(const hs_database_t *db, unsigned int flags) {
+    if (flags & ~HS_WARM_LOCK) {
+        return HS_INVALID;
+    }
+
+    hs_error_t ret = validDatabase(db);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    size_t len = sizeof(struct hs_database) + db->length;
+
+    if (flags & HS_WARM_LOCK) {
+#if defined(_WIN32)
+        return HS_INVALID;
+#else
+        if (mlock(db, len)) {
+            DEBUG_PRINTF("mlock of %zu bytes failed\n", len);
+            return HS_NOMEM;
+        }
+#endif
+    }
+
+    // Read one byte from every page, so that a database that has just been
+    // mapped or copied is faulted in before the first scan rather than
+    // during it.
+    const volatile char *p = (const volatile char *)db;
+    for (size_t i = 0; i < len; i += WARM_PAGE_SIZE) {
+        (void)p[i];
+    }
+    (void)p[len - 1];
+
+    const struct RoseEngine *t = hs_get_bytecode(db);
+    warmRoseEngine(t);
+    const struct RoseEngine *alt = roseAltModeEngine(t);
+    if (alt) {
+        warmRoseEngine(alt);
+    }
+
+    return HS_SUCCESS;
+}
+
+static
+u32 engineClass(u8 type) {
+    if (isNfaType(type)) {
+        return HS_DB_ENGINE_LIMEX;
+    } else if (isMcClellanType(type)) {
+        return HS_DB_ENGINE_MCCLELLAN;
+    } else if (isGoughType(type)) {
+        return HS_DB_ENGINE_GOUGH;
+    } else if (isShengType(type)) {
+        return HS_DB_ENGINE_SHENG;
+    } else if (isMcShengType(type)) {
+        return HS_DB_ENGINE_MCSHENG;
+    } else if (isLbrType(type)) {
+        return HS_DB_ENGINE_LBR;
+    }
+
+    switch (type) {
+    case CASTLE_NFA_0:
+        return HS_DB_ENGINE_CASTLE;
+    case MPV_NFA_0:
+        return HS_DB_ENGINE_MPV;
+    case TAMARAMA_NFA_0:
+        return HS_DB_ENGINE_TAMARAMA;
+    case DFA_GROUP_NFA_0:
+        return HS_DB_ENGINE_DFA_GROUP;
+    default:
+        assert(0);
+        return HS_DB_ENGINE_COUNT;
+    }
+}
+
+static
+void addEngine(hs_db_memory_t *mem, const struct NFA *nfa, u32 state) {
+    u32 c = engineClass(nfa->type);
+    if (c >= HS_DB_ENGINE_COUNT) {
+        return;
+    }
+    mem->engine_count[c]++;
+    mem->engine_bytes[c] += nfa->length;
+    mem->engine_state[c] += state;
+}
+
+static
+size_t hwlmBytes(const struct RoseEngine *t, u32 offset) {
+    if (!offset) {
+        return 0;
+    }
+    return hwlmTableSize((const struct HWLM *)((const char *)t + offset));
+}
+
+/** \brief Adds the bytecode of engine \a t to \a mem, and its stream state
+ * if \a streaming is set. */
+static
+void addRoseEngine(hs_db_memory_t *mem, const struct RoseEngine *t,
+                   char streaming) {
+    const struct NfaInfo *infos
+        = (const struct NfaInfo *)((const char *)t + t->nfaInfoOffset);
+    const struct LeftNfaInfo *left = getLeftTable(t);
+    size_t state = 0;
+    for (u32 qi = 0; qi < t->queueCount; qi++) {
+        const struct NFA *nfa
+            = (const struct NFA *)((const char *)t + infos[qi].nfaOffset);
+        // Transient leftfixes are rebuilt from history on each write and
+        // keep no state in the stream.
+        char in_stream = streaming;
+        if (qi >= t->leftfixBeginQueue
+            && left[qi - t->leftfixBeginQueue].transient) {
+            in_stream = 0;
+        }
+        u32 nfa_state = in_stream ? nfa->streamStateSize : 0;
+        addEngine(mem, nfa, nfa_state);
+        state += nfa_state;
+    }
+
+    if (t->somRevCount) {
+        const u32 *rev_offsets
+            = (const u32 *)((const char *)t + t->somRevOffsetOffset);
+        for (u32 i = 0; i < t->somRevCount; i++) {
+            addEngine(mem, (const struct NFA *)((const char *)t
+                                                + rev_offsets[i]), 0);
+        }
+    }
+
+    mem->matcher_bytes[HS_DB_MATCHER_ANCHORED] += t->asize;
+    mem->matcher_bytes[HS_DB_MATCHER_FLOATING]
+        += hwlmBytes(t, t->fmatcherOffset);
+    mem->matcher_bytes[HS_DB_MATCHER_EOD] += hwlmBytes(t, t->ematcherOffset);
+    mem->matcher_bytes[HS_DB_MATCHER_SMALL_BLOCK]
+        += hwlmBytes(t, t->sbmatcherOffset);
+
+    mem->program_bytes += t->programSize;
+    mem->lookaround_bytes += t->nfaInfoOffset - t->lookaroundReachOffset;
+
+    if (t->smallWriteOffset) {
+        const struct SmallWriteEngine *smwr = (const void *)
+            ((const char *)t + t->smallWriteOffset);
+        mem->small_write_bytes += smwr->size;
+    }
+
+    if (streaming) {
+        mem->stream_state = sizeof(struct hs_stream) + t->stateOffsets.end;
+        mem->matcher_state[HS_DB_MATCHER_ANCHORED] = t->anchorStateSize;
+        mem->matcher_state[HS_DB_MATCHER_FLOATING] = t->floatingStreamState;
+        state += t->anchorStateSize + t->floatingStreamState;
+        mem->rose_state = mem->stream_state - MIN(state, mem->stream_state);
+    }
+}
+
+HS_PUBLIC_API
+hs_error_t hs_database_memory(const hs_database_t *db,
+                              hs_db_memory_t *mem) {
+    if (!mem) {
+        return HS_INVALID;
+    }
+
+    hs_error_t ret = validDatabase(db);
+    if (unlikely(ret != HS_SUCCESS)) {
+        return ret;
+    }
+
+    memset(mem, 0, sizeof(*mem));
+    mem->total = sizeof(struct hs_database) + db->length;
+
+    const struct RoseEngine *t = hs_get_bytecode(db);
+    addRoseEngine(mem, t, t->mode == HS_MODE_STREAM);
+    const struct RoseEngine *alt = roseAltModeEngine(t);
+    if (alt) {
+        addRoseEngine(mem, alt, alt->mode == HS_MODE_STREAM);
+    }
+
+    return HS_SUCCESS;
+}
+
 HS_PUBLIC_API
 hs_error_t hs_serialized_database_size(const char *bytes, const size_t length,
                                        size_t *size) {
     // Decode and check the header
     hs_database_t header;
-    hs_error_t ret = db_decode_header(&bytes, length, &header);
+    struct db_body body;
+    hs_error_t ret = db_decode_serialized(bytes, length, &header, &body, 0);
     if (ret != HS_SUCCESS) {
         return ret;
     }
@@ -339,6 +1299,12 @@ hs_error_t dbIsValid(const hs_database_t *db) {
         return HS_INVALID;
     }
 
+    // A database in an engine store was checked when it was loaded, and its
+    // engine offsets have since been rewritten to refer to shared engines.
+    if (db_is_shared(db)) {
+        return HS_SUCCESS;
+    }
+
     hs_error_t rv = db_check_crc(db);
     if (rv != HS_SUCCESS) {
         DEBUG_PRINTF("bad crc\n");
@@ -403,11 +1369,18 @@ hs_error_t print_database_string(char **s, u32 version, const platform_t plat,
     u8 minor = (version >> 16) & 0xff;
     u8 major = (version >> 24) & 0xff;
 
-    const char *avx2 = (plat & HS_PLATFORM_NOAVX2)  ? "NOAVX2" : " AVX2";
+    const char *features = "AVX512VBMI";
+    if (plat & HS_PLATFORM_NOAVX512) {
+        features = (plat & HS_PLATFORM_NOAVX2) ? "NOAVX2" : " AVX2";
+    } else if (plat & HS_PLATFORM_NOAVX512VBMI) {
+        features = "AVX512";
+    }
 
     const char *mode = NULL;
 
-    if (raw_mode == HS_MODE_STREAM) {
+    if (raw_mode == (HS_MODE_BLOCK | HS_MODE_STREAM)) {
+        mode = "BLOCK STREAM";
+    } else if (raw_mode == HS_MODE_STREAM) {
         mode = "STREAM";
     } else if (raw_mode == HS_MODE_VECTORED) {
         mode = "VECTORED";
@@ -432,7 +1405,7 @@ hs_error_t print_database_string(char **s, u32 version, const platform_t plat,
         // that don't have snprintf but have a workalike.
         int p_len = SNPRINTF_COMPAT(
             buf, len, "Version: %u.%u.%u Features: %s Mode: %s",
-            major, minor, release, avx2, mode);
+            major, minor, release, features, mode);
         if (p_len < 0) {
             DEBUG_PRINTF("snprintf output error, returned %d\n", p_len);
             hs_misc_free(buf);
@@ -458,14 +1431,56 @@ hs_error_t hs_serialized_database_info(const char *bytes, size_t length,
     }
     *info = NULL;
 
-    // Decode and check the header
+    // Decode and check the header. For a multi-target database, this is the
+    // header of the variant that would be loaded here.
     hs_database_t header;
-    hs_error_t ret = db_decode_header(&bytes, length, &header);
+    struct db_body body;
+    hs_error_t ret = db_decode_serialized(bytes, length, &header, &body, 1);
     if (ret != HS_SUCCESS) {
         return ret;
     }
+    size_t packed_len = body.packed_len;
+    size_t bytecode_len = header.length;
+    bytes = body.bytes;
+
+    // All variants are compiled from the same patterns, so the modes of a
+    // delta variant can be read from the bytecode it is relative to.
+    if (body.base) {
+        bytes = body.base;
+        bytecode_len = body.base_len;
+    }
+
+    // A compressed bytecode must be expanded to find the engine modes.
+    char *unpacked = NULL;
+    if (packed_len) {
+        if (header.length < sizeof(struct RoseEngine)) {
+            return HS_INVALID;
+        }
+        unpacked = hs_misc_alloc(header.length);
+        ret = hs_check_alloc(unpacked);
+        if (ret != HS_SUCCESS) {
+            hs_misc_free(unpacked);
+            return ret;
+        }
+        if (!lz_decompress(bytes, packed_len, unpacked, header.length)) {
+            hs_misc_free(unpacked);
+            return HS_INVALID;
+        }
+        bytes = unpacked;
+    }
 
     u32 mode = unaligned_load_u32(bytes + offsetof(struct RoseEngine, mode));
+    u32 alt = unaligned_load_u32(bytes +
+                                 offsetof(struct RoseEngine, altModeOffset));
+    if (alt && alt < bytecode_len &&
+        bytecode_len - alt >= sizeof(struct RoseEngine)) {
+        mode |= unaligned_load_u32(bytes + alt +
+                                   offsetof(struct RoseEngine, mode));
+    }
+
+    if (unpacked) {
+        hs_misc_free(unpacked);
+    }
 
     return print_database_string(info, header.version, header.platform, mode);
 }
@@ -485,6 +1500,8 @@ hs_error_t hs_database_info(const hs_database_t *db, char **info) {
     plat = db->platform;
 
     const struct RoseEngine *rose = hs_get_bytecode(db);
+    const struct RoseEngine *alt = roseAltModeEngine(rose);
+    u32 mode = rose->mode | (alt ? alt->mode : 0);
 
-    return print_database_string(info, db->version, plat, rose->mode);
+    return print_database_string(info, db->version, plat, mode);
 }
@@ -45,6 +45,18 @@ extern "C"
 #define HS_DB_VERSION HS_VERSION_32BIT
 #define HS_DB_MAGIC   (0xdbdbdbdbU)
 
+/** \brief Magic for a database serialized with
+ * hs_serialize_database_compressed(). */
+#define HS_DB_COMPRESSED_MAGIC (0xdbdbdbdcU)
+
+/** \brief Magic for a delta patch produced by
+ * hs_serialize_database_delta(). */
+#define HS_DB_DELTA_MAGIC (0xdbdbdbddU)
+
+/** \brief Magic for a multi-target database produced by
+ * hs_serialize_database_multi_target(). */
+#define HS_DB_MULTI_TARGET_MAGIC (0xdbdbdbdeU)
+
 // Values in here cannot (easily) change - add new ones!
 
 // CPU type is the low 6 bits (we can't need more than 64, surely!)
@@ -53,6 +65,8 @@ extern "C"
 #define HS_PLATFORM_CPU_MASK        0x3F
 
 #define HS_PLATFORM_NOAVX2          (4<<13)
+#define HS_PLATFORM_NOAVX512        (8<<13)
+#define HS_PLATFORM_NOAVX512VBMI    (0x10<<13)
 
 /** \brief Platform features bitmask. */
 typedef u64a platform_t;
@@ -61,6 +75,12 @@ static UNUSED
 const platform_t hs_current_platform = {
 #if !defined(__AVX2__)
     HS_PLATFORM_NOAVX2 |
+#endif
+#if !defined(__AVX512BW__)
+    HS_PLATFORM_NOAVX512 |
+#endif
+#if !defined(__AVX512VBMI__)
+    HS_PLATFORM_NOAVX512VBMI |
 #endif
     0,
 };
@@ -68,6 +88,21 @@ const platform_t hs_current_platform = {
 static UNUSED
 const platform_t hs_current_platform_no_avx2 = {
     HS_PLATFORM_NOAVX2 |
+    HS_PLATFORM_NOAVX512 |
+    HS_PLATFORM_NOAVX512VBMI |
+    0,
+};
+
+static UNUSED
+const platform_t hs_current_platform_no_avx512 = {
+    HS_PLATFORM_NOAVX512 |
+    HS_PLATFORM_NOAVX512VBMI |
+    0,
+};
+
+static UNUSED
+const platform_t hs_current_platform_no_avx512vbmi = {
+    HS_PLATFORM_NOAVX512VBMI |
     0,
 };
 
@@ -81,13 +116,22 @@ struct hs_database {
     u32 length;
     u64a platform;
     u32 crc32;
-    u32 reserved0;
+    u32 flags;       // HS_DB_FLAG_* values
     u32 reserved1;
     u32 bytecode;    // offset relative to db start
     u32 padding[16];
     char bytes[];
 };
 
+/** \brief Database flag: the database was loaded into an engine store, and
+ * its bytecode refers to engines held by the store outside the database. */
+#define HS_DB_FLAG_SHARED 1U
+
+static really_inline
+char db_is_shared(const struct hs_database *db) {
+    return !!(db->flags & HS_DB_FLAG_SHARED);
+}
+
 static really_inline
 const void *hs_get_bytecode(const struct hs_database *db) {
     return ((const char *)db + db->bytecode);
@@ -109,8 +153,11 @@ hs_error_t validDatabase(const hs_database_t *db) {
     return HS_SUCCESS;
 }
 
+struct HWLM;
+
 hs_error_t dbIsValid(const struct hs_database *db);
 struct hs_database *dbCreate(const char *bytecode, size_t len, u64a platform);
+size_t hwlmTableSize(const struct HWLM *h);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime dispatch for the fat runtime.
+ *
+ * When built with FAT_RUNTIME, the runtime sources are compiled once per
+ * target microarchitecture, with every global symbol in each copy prefixed
+ * with the name of its target (see cmake/build_wrapper.sh). This file
+ * provides the unprefixed entry points, each of which is an ifunc resolved at
+ * load time to the best variant supported by the host CPU.
+ */
+
+#include "config.h"
+#include "hs_common.h"
+#include "hs_runtime.h"
+#include "database.h"
+#include "backtrack/backtrack.h"
+#include "ue2common.h"
+#include "util/cpuid_inline.h"
+#include "util/join.h"
+
+#if defined(BUILD_AVX512)
+#define AVX512_DEFN(RTYPE, NAME, ...) RTYPE JOIN(avx512_, NAME)(__VA_ARGS__);
+#define AVX512_RESOLVE(NAME)                                                   \
+    if (check_avx512()) {                                                      \
+        return JOIN(avx512_, NAME);                                            \
+    }
+#else
+#define AVX512_DEFN(RTYPE, NAME, ...)
+#define AVX512_RESOLVE(NAME)
+#endif
+
+#if defined(BUILD_AVX512VBMI)
+#define AVX512VBMI_DEFN(RTYPE, NAME, ...)                                      \
+    RTYPE JOIN(avx512vbmi_, NAME)(__VA_ARGS__);
+#define AVX512VBMI_RESOLVE(NAME)                                               \
+    if (check_avx512vbmi()) {                                                  \
+        return JOIN(avx512vbmi_, NAME);                                        \
+    }
+#else
+#define AVX512VBMI_DEFN(RTYPE, NAME, ...)
+#define AVX512VBMI_RESOLVE(NAME)
+#endif
+
+#define DISPATCH_FN(VIS, RTYPE, ERRVAL, NAME, ...)                             \
+    /* create defns */                                                         \
+    AVX512VBMI_DEFN(RTYPE, NAME, __VA_ARGS__)                                  \
+    AVX512_DEFN(RTYPE, NAME, __VA_ARGS__)                                      \
+    RTYPE JOIN(avx2_, NAME)(__VA_ARGS__);                                      \
+    RTYPE JOIN(corei7_, NAME)(__VA_ARGS__);                                    \
+    RTYPE JOIN(core2_, NAME)(__VA_ARGS__);                                     \
+                                                                               \
+    /* error func */                                                           \
+    static inline RTYPE JOIN(error_, NAME)(__VA_ARGS__) {                      \
+        return ERRVAL;                                                         \
+    }                                                                          \
+                                                                               \
+    /* resolver */                                                             \
+    static RTYPE (*JOIN(resolve_, NAME)(void))(__VA_ARGS__) {                  \
+        AVX512VBMI_RESOLVE(NAME)                                               \
+        AVX512_RESOLVE(NAME)                                                   \
+        if (check_avx2()) {                                                    \
+            return JOIN(avx2_, NAME);                                          \
+        }                                                                      \
+        if (check_sse42() && check_popcnt()) {                                 \
+            return JOIN(corei7_, NAME);                                        \
+        }                                                                      \
+        if (check_ssse3()) {                                                   \
+            return JOIN(core2_, NAME);                                         \
+        }                                                                      \
+        /* anything else is fail */                                            \
+        return JOIN(error_, NAME);                                             \
+    }                                                                          \
+                                                                               \
+    /* function */                                                             \
+    VIS RTYPE NAME(__VA_ARGS__) __attribute__((ifunc("resolve_" #NAME)))
+
+/** \brief Dispatch for a public API call, which returns an hs_error_t. */
+#define CREATE_DISPATCH(NAME, ...)                                             \
+    DISPATCH_FN(HS_PUBLIC_API, hs_error_t, HS_ARCH_ERROR, NAME, __VA_ARGS__)
+
+/** \brief Dispatch for an internal call used by the compiler. */
+#define CREATE_INTERNAL_DISPATCH(RTYPE, ERRVAL, NAME, ...)                     \
+    DISPATCH_FN(, RTYPE, ERRVAL, NAME, __VA_ARGS__)
+
+CREATE_DISPATCH(hs_scan, const hs_database_t *db, const char *data,
+                unsigned length, unsigned flags, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *userCtx);
+
+CREATE_DISPATCH(hs_stream_size, const hs_database_t *database,
+                size_t *stream_size);
+
+CREATE_DISPATCH(hs_database_size, const hs_database_t *db, size_t *size);
+
+CREATE_DISPATCH(hs_free_database, hs_database_t *db);
+
+CREATE_DISPATCH(hs_open_stream, const hs_database_t *db, unsigned int flags,
+                hs_stream_t **stream);
+
+CREATE_DISPATCH(hs_open_stream_ex, const hs_database_t *db,
+                unsigned int flags, const hs_allocator_t *allocator,
+                hs_stream_t **stream);
+
+CREATE_DISPATCH(hs_open_stream_at, const hs_database_t *db,
+                unsigned int flags, void *mem, size_t size,
+                hs_stream_t **stream);
+
+CREATE_DISPATCH(hs_open_stream_coalesced, const hs_database_t *db,
+                unsigned int flags, unsigned int threshold,
+                hs_stream_t **stream);
+
+CREATE_DISPATCH(hs_scan_stream, hs_stream_t *id, const char *data,
+                unsigned int length, unsigned int flags, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *ctxt);
+
+CREATE_DISPATCH(hs_prefetch_stream, const hs_stream_t *id);
+
+CREATE_DISPATCH(hs_scan_stream_partial, hs_stream_t *id, const char *data,
+                unsigned int length, unsigned int flags, unsigned int budget,
+                hs_scratch_t *scratch, match_event_handler onEvent, void *ctxt,
+                unsigned int *consumed);
+
+CREATE_DISPATCH(hs_flush_stream, hs_stream_t *id, unsigned int flags,
+                hs_scratch_t *scratch, match_event_handler onEvent,
+                void *ctxt);
+
+CREATE_DISPATCH(hs_set_stream_window, hs_stream_t *id,
+                unsigned long long min_offset, unsigned long long max_offset);
+
+CREATE_DISPATCH(hs_close_stream, hs_stream_t *id, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *ctxt);
+
+CREATE_DISPATCH(hs_scan_vector, const hs_database_t *db,
+                const char *const *data, const unsigned int *length,
+                unsigned int count, unsigned int flags, hs_scratch_t *scratch,
+                match_event_handler onevent, void *context);
+
+CREATE_DISPATCH(hs_scan_batch, const hs_database_t *db,
+                const char *const *data, const unsigned int *length,
+                unsigned int count, unsigned int flags, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *const *context);
+
+CREATE_DISPATCH(hs_check_utf8, const char *data, unsigned int length,
+                unsigned int *error_offset);
+
+CREATE_DISPATCH(hs_scan_stream_batch, hs_stream_t *const *ids,
+                const char *const *data, const unsigned int *length,
+                unsigned int count, unsigned int flags, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *const *context);
+
+CREATE_DISPATCH(hs_scan_stream_vector, hs_stream_t *id,
+                const char *const *data, const unsigned int *length,
+                unsigned int count, unsigned int flags, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *ctxt);
+
+CREATE_DISPATCH(hs_database_info, const hs_database_t *db, char **info);
+
+CREATE_DISPATCH(hs_copy_stream, hs_stream_t **to_id,
+                const hs_stream_t *from_id);
+
+CREATE_DISPATCH(hs_reset_stream, hs_stream_t *id, unsigned int flags,
+                hs_scratch_t *scratch, match_event_handler onEvent,
+                void *context);
+
+CREATE_DISPATCH(hs_reset_and_copy_stream, hs_stream_t *to_id,
+                const hs_stream_t *from_id, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *context);
+
+CREATE_DISPATCH(hs_alloc_stream_pool, const hs_database_t *db,
+                unsigned int count, hs_stream_pool_t **pool);
+
+CREATE_DISPATCH(hs_free_stream_pool, hs_stream_pool_t *pool);
+
+CREATE_DISPATCH(hs_stream_pool_size, const hs_stream_pool_t *pool,
+                size_t *pool_size);
+
+CREATE_DISPATCH(hs_open_stream_from_pool, hs_stream_pool_t *pool,
+                unsigned int flags, hs_stream_t **stream);
+
+CREATE_DISPATCH(hs_open_stream_bulk, hs_stream_pool_t *pool,
+                unsigned int flags, unsigned int count,
+                hs_stream_t **streams);
+
+CREATE_DISPATCH(hs_close_stream_to_pool, hs_stream_pool_t *pool,
+                hs_stream_t *id, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *context);
+
+CREATE_DISPATCH(hs_reset_stream_bulk, hs_stream_t *const *ids,
+                unsigned int count, unsigned int flags, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *const *context);
+
+CREATE_DISPATCH(hs_compress_stream, const hs_stream_t *stream, char *buf,
+                size_t buf_space, size_t *used_space);
+
+CREATE_DISPATCH(hs_expand_stream, const hs_database_t *db,
+                hs_stream_t **stream, const char *buf, size_t buf_size);
+
+CREATE_DISPATCH(hs_reset_and_expand_stream, hs_stream_t *to_stream,
+                const char *buf, size_t buf_size, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *context);
+
+CREATE_DISPATCH(hs_alloc_stream_checkpoint, const hs_database_t *db,
+                hs_stream_checkpoint_t **checkpoint);
+
+CREATE_DISPATCH(hs_checkpoint_stream, const hs_stream_t *id,
+                hs_stream_checkpoint_t *checkpoint);
+
+CREATE_DISPATCH(hs_rollback_stream, hs_stream_t *id,
+                const hs_stream_checkpoint_t *checkpoint);
+
+CREATE_DISPATCH(hs_free_stream_checkpoint, hs_stream_checkpoint_t *checkpoint);
+
+CREATE_DISPATCH(hs_serialize_database, const hs_database_t *db, char **bytes,
+                size_t *length);
+
+CREATE_DISPATCH(hs_serialize_database_multi_target,
+                const hs_database_t *const *dbs, unsigned int count,
+                char **bytes, size_t *length);
+
+CREATE_DISPATCH(hs_deserialize_database, const char *bytes,
+                const size_t length, hs_database_t **db);
+
+CREATE_DISPATCH(hs_deserialize_database_at, const char *bytes,
+                const size_t length, hs_database_t *db);
+
+CREATE_DISPATCH(hs_serialize_database_compressed, const hs_database_t *db,
+                char **bytes, size_t *length);
+
+CREATE_DISPATCH(hs_serialize_database_delta, const hs_database_t *old_db,
+                const hs_database_t *new_db, char **bytes, size_t *length);
+
+CREATE_DISPATCH(hs_apply_database_delta, const hs_database_t *old_db,
+                const char *bytes, size_t length, hs_database_t **new_db);
+
+CREATE_DISPATCH(hs_serialized_database_info, const char *bytes,
+                size_t length, char **info);
+
+CREATE_DISPATCH(hs_serialized_database_size, const char *bytes,
+                const size_t length, size_t *deserialized_size);
+
+CREATE_DISPATCH(hs_serialize_database_image, const hs_database_t *db,
+                char **bytes, size_t *length);
+
+CREATE_DISPATCH(hs_map_database, const char *bytes, size_t length,
+                const hs_database_t **db);
+
+CREATE_DISPATCH(hs_clone_database, const hs_database_t *src,
+                hs_database_t **dest);
+
+CREATE_DISPATCH(hs_alloc_engine_store, size_t size,
+                hs_engine_store_t **store);
+
+CREATE_DISPATCH(hs_free_engine_store, hs_engine_store_t *store);
+
+CREATE_DISPATCH(hs_engine_store_load, hs_engine_store_t *store,
+                const char *bytes, size_t length, hs_database_t **db);
+
+CREATE_DISPATCH(hs_engine_store_unload, hs_engine_store_t *store,
+                hs_database_t *db);
+
+CREATE_DISPATCH(hs_engine_store_stats, const hs_engine_store_t *store,
+                hs_engine_store_info_t *stats);
+
+CREATE_DISPATCH(hs_database_warm, const hs_database_t *db,
+                unsigned int flags);
+
+CREATE_DISPATCH(hs_database_memory, const hs_database_t *db,
+                hs_db_memory_t *mem);
+
+CREATE_DISPATCH(hs_alloc_scratch, const hs_database_t *db,
+                hs_scratch_t **scratch);
+
+CREATE_DISPATCH(hs_alloc_scratch_ex, const hs_database_t *db,
+                const hs_allocator_t *allocator, hs_scratch_t **scratch);
+
+CREATE_DISPATCH(hs_scratch_required_size, const hs_database_t *db,
+                size_t *scratch_size);
+
+CREATE_DISPATCH(hs_init_scratch_at, const hs_database_t *db, void *mem,
+                size_t size, hs_scratch_t **scratch);
+
+CREATE_DISPATCH(hs_clone_scratch, const hs_scratch_t *src,
+                hs_scratch_t **dest);
+
+CREATE_DISPATCH(hs_free_scratch, hs_scratch_t *scratch);
+
+CREATE_DISPATCH(hs_scratch_size, const hs_scratch_t *scratch,
+                size_t *scratch_size);
+
+CREATE_DISPATCH(hs_scratch_compatible, const hs_database_t *db,
+                const hs_scratch_t *scratch);
+
+CREATE_DISPATCH(hs_alloc_pattern_mask, const hs_database_t *db,
+                const unsigned int *ids, unsigned int count,
+                hs_pattern_mask_t **mask);
+
+CREATE_DISPATCH(hs_free_pattern_mask, hs_pattern_mask_t *mask);
+
+CREATE_DISPATCH(hs_set_scratch_pattern_mask, hs_scratch_t *scratch,
+                const hs_pattern_mask_t *mask);
+
+CREATE_DISPATCH(hs_reserve_scratch, size_t size, hs_scratch_t **scratch);
+
+CREATE_DISPATCH(hs_scratch_profile_info, const hs_scratch_t *scratch,
+                char **info);
+
+CREATE_DISPATCH(hs_scratch_profile_reset, hs_scratch_t *scratch);
+
+CREATE_DISPATCH(hs_profile_report, const hs_database_t *db,
+                const hs_scratch_t *scratch, unsigned int max_patterns,
+                char **info);
+
+CREATE_DISPATCH(hs_scratch_pmu_stats, const hs_scratch_t *scratch,
+                hs_pmu_stats_t *stats);
+
+CREATE_DISPATCH(hs_scratch_pmu_reset, hs_scratch_t *scratch);
+
+CREATE_DISPATCH(hs_scratch_latency_enable, hs_scratch_t *scratch, int enable);
+
+CREATE_DISPATCH(hs_scratch_latency_stats, const hs_scratch_t *scratch,
+                hs_latency_stats_t *stats);
+
+CREATE_DISPATCH(hs_scratch_latency_reset, hs_scratch_t *scratch);
+
+CREATE_DISPATCH(hs_latency_percentile, const hs_latency_histogram_t *hist,
+                double percentile, unsigned long long *ns);
+
+CREATE_DISPATCH(hs_alloc_sample_aggregate, const hs_database_t *db,
+                hs_sample_aggregate_t **agg);
+
+CREATE_DISPATCH(hs_free_sample_aggregate, hs_sample_aggregate_t *agg);
+
+CREATE_DISPATCH(hs_scratch_sample_enable, hs_scratch_t *scratch,
+                hs_sample_aggregate_t *agg, unsigned int period);
+
+CREATE_DISPATCH(hs_sample_report, const hs_sample_aggregate_t *agg,
+                unsigned int max_patterns, char **info);
+
+CREATE_DISPATCH(hs_set_scratch_match_buffer, hs_scratch_t *scratch,
+                hs_match_t *buffer, unsigned int capacity,
+                match_batch_handler onBatch);
+
+CREATE_DISPATCH(hs_get_match_data, const hs_scratch_t *scratch,
+                unsigned long long from, unsigned long long to,
+                const char **hist, size_t *hist_len, const char **data,
+                size_t *data_len);
+
+CREATE_DISPATCH(hs_get_match_user_data, const hs_scratch_t *scratch,
+                unsigned long long *user_data);
+
+CREATE_DISPATCH(hs_serialize_stream, const hs_database_t *db,
+                const hs_stream_t *stream, char *buf, size_t buf_space,
+                size_t *used_space);
+
+CREATE_DISPATCH(hs_deserialize_stream, const hs_database_t *db,
+                const char *buf, size_t buf_size, hs_stream_t **stream);
+
+CREATE_DISPATCH(hs_alloc_stream_store, const hs_database_t *db,
+                unsigned int hot_count, hs_stream_store_t **store);
+
+CREATE_DISPATCH(hs_free_stream_store, hs_stream_store_t *store);
+
+CREATE_DISPATCH(hs_store_open_stream, hs_stream_store_t *store,
+                unsigned int flags, unsigned int *flow);
+
+CREATE_DISPATCH(hs_store_scan_stream, hs_stream_store_t *store,
+                unsigned int flow, const char *data, unsigned int length,
+                unsigned int flags, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *context);
+
+CREATE_DISPATCH(hs_store_close_stream, hs_stream_store_t *store,
+                unsigned int flow, hs_scratch_t *scratch,
+                match_event_handler onEvent, void *context);
+
+CREATE_DISPATCH(hs_store_compact, hs_stream_store_t *store,
+                unsigned int idle_limit);
+
+CREATE_DISPATCH(hs_stream_store_stats, const hs_stream_store_t *store,
+                hs_stream_store_info_t *stats);
+
+CREATE_DISPATCH(hs_alloc_transform, unsigned int flags,
+                hs_transform_func_t func, void *context,
+                hs_transform_t **transform);
+
+CREATE_DISPATCH(hs_free_transform, hs_transform_t *transform);
+
+CREATE_DISPATCH(hs_reset_transform, hs_transform_t *transform);
+
+CREATE_DISPATCH(hs_scan_stream_transformed, hs_stream_t *id,
+                hs_transform_t *transform, const char *data,
+                unsigned int length, unsigned int flags,
+                hs_scratch_t *scratch, match_event_handler onEvent,
+                void *ctxt);
+
+CREATE_DISPATCH(hs_transform_map_offset, const hs_transform_t *transform,
+                unsigned long long to, unsigned long long *from);
+
+/** INTERNALS **/
+
+CREATE_INTERNAL_DISPATCH(struct hs_database *, NULL, dbCreate,
+                         const char *in_bytecode, size_t len, u64a platform);
+
+/* Used by the compiler to tune confirm programs against a sample corpus. An
+ * unsupported target reports a possible match, as btConfirm() does when it
+ * cannot finish. */
+CREATE_INTERNAL_DISPATCH(char, 1, btConfirm,
+                         const struct BacktrackProgram *prog, const u8 *hbuf,
+                         size_t hlen, const u8 *buf, size_t len,
+                         u64a buf_offset, u64a end);
@@ -0,0 +1,706 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: engine stores, which share identical engines between the
+ * databases loaded into them.
+ *
+ * An engine store owns a single arena, from which the databases loaded into
+ * it are allocated. As a database is loaded, each engine its bytecode refers
+ * to by offset (the NFA of each queue, the literal matchers and the
+ * small-write engine, in every mode's Rose engine) is looked up by content in
+ * a table of blobs. If an identical engine is already in the store, the
+ * database's offset is rewritten to refer to it; otherwise the engine is
+ * copied into a new blob, which later databases can share. Either way, the
+ * cachelines of the database's own copy are returned to the arena.
+ *
+ * Engine offsets are unsigned and relative to the Rose engine that holds
+ * them, so a blob can only be used by Rose engines below it in the arena.
+ * Databases are allocated from the bottom of the arena and blobs from the
+ * top; an engine that cannot be placed above its database stays where it is.
+ *
+ * Loaded databases are flagged with \ref HS_DB_FLAG_SHARED, which stops them
+ * from being freed, copied or serialized as ordinary databases.
+ */
+
+#include "allocator.h"
+#include "crc32.h"
+#include "database.h"
+#include "hs_common.h"
+#include "hs_internal.h"
+#include "ue2common.h"
+#include "nfa/nfa_internal.h"
+#include "rose/rose_internal.h"
+#include "smallwrite/smallwrite_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ENGINE_STORE_MAGIC 0x45535452
+
+/** \brief No arena space, or no blob. */
+#define STORE_NONE 0xffffffffU
+
+/** \brief Smallest number of blob slots. */
+#define MIN_BLOBS 64
+
+/** \brief Smallest number of free extents and databases. */
+#define MIN_ENTRIES 16
+
+/** \brief Engine offsets in a Rose engine other than those of its queues. */
+#define ROSE_ENGINE_LINKS 5
+
+/** \brief A run of arena bytes. */
+struct store_extent {
+    u32 offset;
+    u32 len;
+};
+
+/** \brief An engine held in the store. */
+struct store_blob {
+    u32 hash; /**< CRC of the engine's bytes */
+    u32 offset; /**< arena offset */
+    u32 len; /**< length of the engine, before padding */
+    u32 refs; /**< engine offsets referring to the blob, zero if unused */
+    u32 next; /**< next blob in the hash chain or on the free list */
+};
+
+/** \brief A database loaded into the store. */
+struct store_db {
+    hs_database_t *db;
+    struct store_extent extent; /**< arena space allocated for it */
+    u32 *links; /**< blob referred to by each rewritten offset */
+    struct store_extent *holes; /**< returned space within extent, sorted */
+    u32 linkCount;
+    u32 holeCount;
+};
+
+struct hs_engine_store {
+    u32 magic;
+    u32 size; /**< usable arena bytes */
+    char *mem; /**< arena allocation */
+    char *arena; /**< cacheline-aligned arena */
+    struct store_extent *free; /**< free arena space, sorted, coalesced */
+    u32 freeCount;
+    u32 freeCap;
+    size_t freeBytes;
+    u32 pieces; /**< allocated runs: blobs, and databases split by holes */
+    struct store_blob *blobs;
+    u32 blobCap;
+    u32 blobCount; /**< blobs in use */
+    u32 freeBlob; /**< head of the blob free list */
+    u32 *buckets; /**< blobCap hash chain heads */
+    struct store_db *dbs;
+    u32 dbCount;
+    u32 dbCap;
+    size_t references;
+    size_t engineBytes;
+    size_t savedBytes;
+};
+
+static really_inline
+char validEngineStore(const struct hs_engine_store *store) {
+    return store && store->magic == ENGINE_STORE_MAGIC;
+}
+
+/** \brief Replaces \a *array, holding \a count elements of \a elem bytes,
+ * with one of \a cap elements. */
+static
+hs_error_t growArray(void **array, u32 count, u32 cap, size_t elem) {
+    void *a = hs_misc_alloc((size_t)cap * elem);
+    hs_error_t err = hs_check_alloc(a);
+    if (err != HS_SUCCESS) {
+        hs_misc_free(a);
+        return err;
+    }
+    if (count) {
+        memcpy(a, *array, (size_t)count * elem);
+    }
+    hs_misc_free(*array);
+    *array = a;
+    return HS_SUCCESS;
+}
+
+static
+u32 growCap(u32 cap, u32 need, u32 min) {
+    cap = MAX(cap, min);
+    while (cap < need) {
+        cap *= 2;
+    }
+    return cap;
+}
+
+/** \brief Takes \a len bytes of arena space from the lowest free extent that
+ * fits, or the highest if \a high is set. Returns STORE_NONE if none does. */
+static
+u32 allocExtent(struct hs_engine_store *store, u32 len, char high) {
+    assert(ISALIGNED_CL(len));
+    u32 i = STORE_NONE;
+    for (u32 j = 0; j < store->freeCount; j++) {
+        u32 k = high ? store->freeCount - 1 - j : j;
+        if (store->free[k].len >= len) {
+            i = k;
+            break;
+        }
+    }
+    if (i == STORE_NONE) {
+        return STORE_NONE;
+    }
+
+    struct store_extent *e = &store->free[i];
+    u32 offset = high ? e->offset + e->len - len : e->offset;
+    if (!high) {
+        e->offset += len;
+    }
+    e->len -= len;
+    if (!e->len) {
+        memmove(e, e + 1, (store->freeCount - i - 1) * sizeof(*e));
+        store->freeCount--;
+    }
+    store->freeBytes -= len;
+    store->pieces++;
+    return offset;
+}
+
+/** \brief Returns arena space, merging it with its free neighbours. Never
+ * fails: loading reserves enough free extents for every run it allocates. */
+static
+void freeExtent(struct hs_engine_store *store, u32 offset, u32 len) {
+    assert(len && ISALIGNED_CL(offset) && ISALIGNED_CL(len));
+    u32 i = 0;
+    while (i < store->freeCount && store->free[i].offset < offset) {
+        i++;
+    }
+
+    struct store_extent *prev = i ? &store->free[i - 1] : NULL;
+    struct store_extent *next = i < store->freeCount ? &store->free[i] : NULL;
+    assert(!prev || prev->offset + prev->len <= offset);
+    assert(!next || offset + len <= next->offset);
+
+    if (prev && prev->offset + prev->len == offset) {
+        prev->len += len;
+        if (next && offset + len == next->offset) {
+            prev->len += next->len;
+            memmove(next, next + 1,
+                    (store->freeCount - i - 1) * sizeof(*next));
+            store->freeCount--;
+        }
+    } else if (next && offset + len == next->offset) {
+        next->offset = offset;
+        next->len += len;
+    } else {
+        assert(store->freeCount < store->freeCap);
+        memmove(&store->free[i + 1], &store->free[i],
+                (store->freeCount - i) * sizeof(*next));
+        store->free[i].offset = offset;
+        store->free[i].len = len;
+        store->freeCount++;
+    }
+    store->freeBytes += len;
+    store->pieces--;
+}
+
+/** \brief Grows the blob table, if need be, so that \a count more blobs can
+ * be added without allocating. */
+static
+hs_error_t reserveBlobs(struct hs_engine_store *store, u32 count) {
+    if (store->blobCap - store->blobCount >= count) {
+        return HS_SUCCESS;
+    }
+    if (count > (1U << 30) - store->blobCount) {
+        return HS_NOMEM;
+    }
+
+    u32 old_cap = store->blobCap;
+    u32 cap = growCap(old_cap, store->blobCount + count, MIN_BLOBS);
+    u32 *buckets = hs_misc_alloc((size_t)cap * sizeof(u32));
+    hs_error_t err = hs_check_alloc(buckets);
+    if (err == HS_SUCCESS) {
+        err = growArray((void **)&store->blobs, old_cap, cap,
+                        sizeof(struct store_blob));
+    }
+    if (err != HS_SUCCESS) {
+        hs_misc_free(buckets);
+        return err;
+    }
+
+    for (u32 i = old_cap; i < cap; i++) {
+        store->blobs[i].refs = 0;
+        store->blobs[i].next = i + 1 < cap ? i + 1 : store->freeBlob;
+    }
+    store->freeBlob = old_cap;
+
+    // The capacity is a power of two, so the chains can be rebuilt with a
+    // mask.
+    for (u32 i = 0; i < cap; i++) {
+        buckets[i] = STORE_NONE;
+    }
+    for (u32 i = 0; i < old_cap; i++) {
+        struct store_blob *b = &store->blobs[i];
+        if (b->refs) {
+            u32 *head = &buckets[b->hash & (cap - 1)];
+            b->next = *head;
+            *head = i;
+        }
+    }
+    hs_misc_free(store->buckets);
+    store->buckets = buckets;
+    store->blobCap = cap;
+    return HS_SUCCESS;
+}
+
+/** \brief Returns the blob with the same \a len bytes as \a data, or
+ * STORE_NONE. */
+static
+u32 findBlob(const struct hs_engine_store *store, u32 hash, const char *data,
+             u32 len) {
+    if (!store->blobCap) {
+        return STORE_NONE;
+    }
+    u32 i = store->buckets[hash & (store->blobCap - 1)];
+    for (; i != STORE_NONE; i = store->blobs[i].next) {
+        const struct store_blob *b = &store->blobs[i];
+        if (b->hash == hash && b->len == len &&
+            !memcmp(store->arena + b->offset, data, len)) {
+            return i;
+        }
+    }
+    return STORE_NONE;
+}
+
+/** \brief Copies \a len bytes of engine into a new blob, which must lie
+ * above \a rose. Returns STORE_NONE if there is no room there. */
+static
+u32 addBlob(struct hs_engine_store *store, u32 hash, const char *data,
+            u32 len, const char *rose) {
+    u32 size = ROUNDUP_CL(len);
+    u32 offset = allocExtent(store, size, 1);
+    if (offset == STORE_NONE) {
+        return STORE_NONE;
+    }
+    if (store->arena + offset <= rose) {
+        freeExtent(store, offset, size);
+        return STORE_NONE;
+    }
+
+    assert(store->freeBlob != STORE_NONE);
+    u32 i = store->freeBlob;
+    struct store_blob *b = &store->blobs[i];
+    store->freeBlob = b->next;
+    memcpy(store->arena + offset, data, len);
+    b->hash = hash;
+    b->offset = offset;
+    b->len = len;
+    b->refs = 0;
+    u32 *head = &store->buckets[hash & (store->blobCap - 1)];
+    b->next = *head;
+    *head = i;
+    store->blobCount++;
+    store->engineBytes += len;
+    return i;
+}
+
+/** \brief Drops a reference to blob \a i, freeing it with the last. */
+static
+void unrefBlob(struct hs_engine_store *store, u32 i) {
+    struct store_blob *b = &store->blobs[i];
+    assert(b->refs);
+    store->references--;
+    if (--b->refs) {
+        store->savedBytes -= b->len;
+        return;
+    }
+
+    u32 *p = &store->buckets[b->hash & (store->blobCap - 1)];
+    while (*p != i) {
+        p = &store->blobs[*p].next;
+    }
+    *p = b->next;
+    freeExtent(store, b->offset, ROUNDUP_CL(b->len));
+    store->engineBytes -= b->len;
+    store->blobCount--;
+    b->next = store->freeBlob;
+    store->freeBlob = i;
+}
+
+/** \brief Points the engine offset \a *field of \a rose, to an engine of
+ * \a len bytes, at an identical blob, adding one if there is none. The
+ * database's copy is recorded in \a sdb's holes to be returned later. */
+static
+void linkEngine(struct hs_engine_store *store, struct store_db *sdb,
+                const char *rose, u32 *field, size_t len) {
+    if (!*field || !len) {
+        return;
+    }
+
+    // Only engines within the database itself are moved.
+    const char *data = rose + *field;
+    const char *start = store->arena + sdb->extent.offset;
+    if (data < start || len > (size_t)(start + sdb->extent.len - data)) {
+        assert(0);
+        return;
+    }
+
+    u32 hash = Crc32c_ComputeBuf(0, data, len);
+    u32 i = findBlob(store, hash, data, (u32)len);
+    if (i == STORE_NONE) {
+        i = addBlob(store, hash, data, (u32)len, rose);
+        if (i == STORE_NONE) {
+            DEBUG_PRINTF("no room above engine for %zu byte blob\n", len);
+            return;
+        }
+    } else if (store->arena + store->blobs[i].offset <= rose) {
+        DEBUG_PRINTF("blob %u is below the engine\n", i);
+        return;
+    }
+
+    struct store_blob *b = &store->blobs[i];
+    if (b->refs++) {
+        store->savedBytes += len;
+    }
+    store->references++;
+    *field = (u32)(store->arena + b->offset - rose);
+    sdb->links[sdb->linkCount] = i;
+    sdb->holes[sdb->linkCount].offset = (u32)(data - store->arena);
+    sdb->holes[sdb->linkCount].len = (u32)len;
+    sdb->linkCount++;
+}
+
+static
+u32 roseLinkCount(const struct RoseEngine *t) {
+    return t->queueCount + ROSE_ENGINE_LINKS;
+}
+
+static
+void linkRoseEngine(struct hs_engine_store *store, struct store_db *sdb,
+                    struct RoseEngine *t) {
+    char *base = (char *)t;
+    const char *rose = base;
+    struct NfaInfo *infos = (struct NfaInfo *)(base + t->nfaInfoOffset);
+    for (u32 qi = 0; qi < t->queueCount; qi++) {
+        const struct NFA *nfa
+            = (const struct NFA *)(rose + infos[qi].nfaOffset);
+        linkEngine(store, sdb, rose, &infos[qi].nfaOffset, nfa->length);
+    }
+
+    if (t->amatcherOffset) {
+        linkEngine(store, sdb, rose, &t->amatcherOffset, t->asize);
+    }
+    if (t->fmatcherOffset) {
+        linkEngine(store, sdb, rose, &t->fmatcherOffset,
+                   hwlmTableSize(getFLiteralMatcher(t)));
+    }
+    if (t->ematcherOffset) {
+        linkEngine(store, sdb, rose, &t->ematcherOffset,
+                   hwlmTableSize((const struct HWLM *)(rose
+                                                       + t->ematcherOffset)));
+    }
+    if (t->sbmatcherOffset) {
+        linkEngine(store, sdb, rose, &t->sbmatcherOffset,
+                   hwlmTableSize(getSBLiteralMatcher(t)));
+    }
+    if (t->smallWriteOffset) {
+        linkEngine(store, sdb, rose, &t->smallWriteOffset,
+                   getSmallWrite(t)->size);
+    }
+}
+
+static
+int cmpExtent(const void *a, const void *b) {
+    const struct store_extent *x = a, *y = b;
+    return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+/** \brief Turns the engine copies recorded in \a sdb's holes, which may
+ * overlap, into the sorted whole cachelines they cover, and returns those to
+ * the arena. */
+static
+void punchHoles(struct hs_engine_store *store, struct store_db *sdb) {
+    struct store_extent *holes = sdb->holes;
+    qsort(holes, sdb->linkCount, sizeof(*holes), cmpExtent);
+
+    u32 count = 0;
+    u32 cover = 0; // end of the copies seen so far
+    for (u32 i = 0; i < sdb->linkCount; i++) {
+        u32 start = MAX(holes[i].offset, cover);
+        u32 end = holes[i].offset + holes[i].len;
+        if (end <= cover) {
+            continue;
+        }
+        cover = end;
+        start = ROUNDUP_CL(start);
+        end = ROUNDDOWN_N(end, 64);
+        if (start >= end) {
+            continue;
+        }
+        if (count && holes[count - 1].offset + holes[count - 1].len == start) {
+            holes[count - 1].len += end - start;
+        } else {
+            holes[count].offset = start;
+            holes[count].len = end - start;
+            count++;
+        }
+    }
+    sdb->holeCount = count;
+
+    // The database's run is split by each hole before the hole is freed.
+    for (u32 i = 0; i < count; i++) {
+        store->pieces++;
+        store->pieces++;
+        freeExtent(store, holes[i].offset, holes[i].len);
+    }
+}
+
+/** \brief Returns the remainder of a database's arena space, around its
+ * holes, and drops its references to blobs. */
+static
+void releaseDb(struct hs_engine_store *store, struct store_db *sdb) {
+    for (u32 i = 0; i < sdb->linkCount; i++) {
+        unrefBlob(store, sdb->links[i]);
+    }
+
+    u32 at = sdb->extent.offset;
+    u32 end = at + sdb->extent.len;
+    for (u32 i = 0; i < sdb->holeCount; i++) {
+        const struct store_extent *h = &sdb->holes[i];
+        if (h->offset > at) {
+            freeExtent(store, at, h->offset - at);
+        } else {
+            store->pieces--;
+        }
+        at = h->offset + h->len;
+    }
+    if (end > at) {
+        freeExtent(store, at, end - at);
+    } else {
+        store->pieces--;
+    }
+
+    hs_misc_free(sdb->links);
+    hs_misc_free(sdb->holes);
+}
+
+HS_PUBLIC_API
+hs_error_t hs_alloc_engine_store(size_t size, hs_engine_store_t **store) {
+    if (!store) {
+        return HS_INVALID;
+    }
+    *store = NULL;
+
+    // Engine offsets are 32 bits, so the whole arena must be addressable
+    // with them.
+    size = ROUNDDOWN_N(size, 64);
+    if (!size || size > 0xffffffc0ULL) {
+        return HS_INVALID;
+    }
+
+    struct hs_engine_store *s = hs_misc_alloc(sizeof(*s));
+    hs_error_t err = hs_check_alloc(s);
+    if (err != HS_SUCCESS) {
+        hs_misc_free(s);
+        return err;
+    }
+    memset(s, 0, sizeof(*s));
+    s->freeBlob = STORE_NONE;
+
+    s->mem = hs_database_alloc(size + 63);
+    s->free = hs_misc_alloc(MIN_ENTRIES * sizeof(struct store_extent));
+    if (!s->mem || !s->free) {
+        hs_database_free(s->mem);
+        hs_misc_free(s->free);
+        hs_misc_free(s);
+        return HS_NOMEM;
+    }
+
+    s->magic = ENGINE_STORE_MAGIC;
+    s->size = (u32)size;
+    s->arena = (char *)ROUNDUP_PTR(s->mem, 64);
+    s->free[0].offset = 0;
+    s->free[0].len = s->size;
+    s->freeCount = 1;
+    s->freeCap = MIN_ENTRIES;
+    s->freeBytes = size;
+    *store = s;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_free_engine_store(hs_engine_store_t *store) {
+    if (!store) {
+        return HS_SUCCESS;
+    }
+    if (!validEngineStore(store)) {
+        return HS_INVALID;
+    }
+
+    for (u32 i = 0; i < store->dbCount; i++) {
+        hs_misc_free(store->dbs[i].links);
+        hs_misc_free(store->dbs[i].holes);
+    }
+    hs_misc_free(store->dbs);
+    hs_misc_free(store->blobs);
+    hs_misc_free(store->buckets);
+    hs_misc_free(store->free);
+    hs_database_free(store->mem);
+    store->magic = 0;
+    hs_misc_free(store);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_engine_store_load(hs_engine_store_t *store, const char *bytes,
+                                size_t length, hs_database_t **db) {
+    if (!db) {
+        return HS_INVALID;
+    }
+    *db = NULL;
+    if (!validEngineStore(store) || !bytes) {
+        return HS_INVALID;
+    }
+
+    size_t size = 0;
+    hs_error_t err = hs_serialized_database_size(bytes, length, &size);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+    if (size > store->size) {
+        return HS_NOMEM;
+    }
+
+    if (store->dbCount == store->dbCap) {
+        u32 cap = growCap(store->dbCap, store->dbCount + 1, MIN_ENTRIES);
+        err = growArray((void **)&store->dbs, store->dbCount, cap,
+                        sizeof(struct store_db));
+        if (err != HS_SUCCESS) {
+            return err;
+        }
+        store->dbCap = cap;
+    }
+
+    struct store_db *sdb = &store->dbs[store->dbCount];
+    memset(sdb, 0, sizeof(*sdb));
+    sdb->extent.len = ROUNDUP_CL((u32)size);
+    sdb->extent.offset = allocExtent(store, sdb->extent.len, 0);
+    if (sdb->extent.offset == STORE_NONE) {
+        return HS_NOMEM;
+    }
+
+    hs_database_t *ndb = (hs_database_t *)(store->arena + sdb->extent.offset);
+    err = hs_deserialize_database_at(bytes, length, ndb);
+    if (err != HS_SUCCESS) {
+        freeExtent(store, sdb->extent.offset, sdb->extent.len);
+        return err;
+    }
+
+    // The copy in the arena is ours to relink, so work through ndb rather
+    // than the const accessors.
+    char *ndb_base = (char *)ndb;
+    struct RoseEngine *t = (struct RoseEngine *)(ndb_base + ndb->bytecode);
+    struct RoseEngine *alt = t->altModeOffset
+        ? (struct RoseEngine *)((char *)t + t->altModeOffset) : NULL;
+    u32 max_links = roseLinkCount(t) + (alt ? roseLinkCount(alt) : 0);
+
+    // Reserve everything linking needs up front, so that it cannot fail part
+    // way through. There is at most one more free extent than there are
+    // allocated runs, and linking adds at most one blob and one hole per
+    // engine.
+    u32 free_need = store->pieces + 2 * max_links + 2;
+    sdb->links = hs_misc_alloc(max_links * sizeof(u32));
+    sdb->holes = hs_misc_alloc(max_links * sizeof(struct store_extent));
+    err = sdb->links && sdb->holes ? HS_SUCCESS : HS_NOMEM;
+    if (err == HS_SUCCESS) {
+        err = reserveBlobs(store, max_links);
+    }
+    if (err == HS_SUCCESS && store->freeCap < free_need) {
+        u32 cap = growCap(store->freeCap, free_need, MIN_ENTRIES);
+        err = growArray((void **)&store->free, store->freeCount, cap,
+                        sizeof(struct store_extent));
+        if (err == HS_SUCCESS) {
+            store->freeCap = cap;
+        }
+    }
+    if (err != HS_SUCCESS) {
+        hs_misc_free(sdb->links);
+        hs_misc_free(sdb->holes);
+        freeExtent(store, sdb->extent.offset, sdb->extent.len);
+        return err;
+    }
+
+    linkRoseEngine(store, sdb, t);
+    if (alt) {
+        linkRoseEngine(store, sdb, alt);
+    }
+    punchHoles(store, sdb);
+
+    DEBUG_PRINTF("loaded %zu byte database with %u shared engines, %u holes\n",
+                 size, sdb->linkCount, sdb->holeCount);
+    ndb->flags |= HS_DB_FLAG_SHARED;
+    sdb->db = ndb;
+    store->dbCount++;
+    *db = ndb;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_engine_store_unload(hs_engine_store_t *store,
+                                  hs_database_t *db) {
+    if (!validEngineStore(store) || !db) {
+        return HS_INVALID;
+    }
+
+    u32 i = 0;
+    while (i < store->dbCount && store->dbs[i].db != db) {
+        i++;
+    }
+    if (i == store->dbCount) {
+        return HS_INVALID;
+    }
+
+    // Stop stale uses of the database from passing its checks, for as long as
+    // its header is not reused.
+    db->magic = 0;
+    releaseDb(store, &store->dbs[i]);
+    store->dbs[i] = store->dbs[--store->dbCount];
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_engine_store_stats(const hs_engine_store_t *store,
+                                 hs_engine_store_info_t *stats) {
+    if (!validEngineStore(store) || !stats) {
+        return HS_INVALID;
+    }
+
+    stats->databases = store->dbCount;
+    stats->engines = store->blobCount;
+    stats->references = store->references;
+    stats->engine_bytes = store->engineBytes;
+    stats->saved_bytes = store->savedBytes;
+    stats->free_bytes = store->freeBytes;
+    return HS_SUCCESS;
+}
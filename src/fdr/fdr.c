@@ -40,6 +40,11 @@
 /** \brief number of bytes processed in each iteration */
 #define ITER_BYTES          16
 
+#if defined(__AVX2__)
+/** \brief number of bytes processed in each iteration of the wide main loop */
+#define WIDE_ITER_BYTES     32
+#endif
+
 /** \brief total zone buffer size */
 #define ZONE_TOTAL_SIZE     64
 
@@ -311,10 +316,109 @@ void get_conf_stride_4(const u8 *itPtr, const u8 *start_ptr, const u8 *end_ptr,
     *conf8 ^= ~0ULL;
 }
 
+#if defined(WIDE_ITER_BYTES)
+/* The wide main loop computes the same shift-or state as get_conf_stride_*,
+ * but combines the table entries for pairs of 8-byte blocks. The entries for
+ * byte p of both blocks need a byte shift by p, so they are loaded into the
+ * two 128-bit lanes of one register and shifted together; only the final
+ * merge into the carried state is done a block at a time. This halves the
+ * byte shifts, which compete for the shuffle port.
+ *
+ * AVX-512 builds use this loop too: putting four blocks in the lanes of an
+ * m512 needs more lane inserts than it saves in shifts. */
+
+/** \brief Returns the index (in units of 8 bytes) of the table entry for the
+ * domain value ending at byte p of the 8-byte block at ptr, whose contents
+ * are given in data. */
+static really_inline
+u64a get_entry_offset(const u8 *ptr, const u8 *start_ptr, const u8 *end_ptr,
+                      u64a data, const u32 p, u64a domain_mask_adjusted) {
+    assert(p < 8);
+    if (p == 0) {
+        return (data << 1) & domain_mask_adjusted;
+    }
+    if (p == 7) {
+        /* +1: the zones ensure that we can read the byte at z->end */
+        return (lv_u16(ptr + 7, start_ptr, end_ptr + 1) << 1) &
+               domain_mask_adjusted;
+    }
+    return (data >> (8 * p - 1)) & domain_mask_adjusted;
+}
+
+/** \brief Merges the combined entries for one 8-byte block into the state
+ * and extracts its confirm word. */
+static really_inline
+u64a merge_block(m128 entries, m128 *s) {
+    *s = or128(*s, entries);
+    u64a conf = movq(*s) ^ ~0ULL;
+    *s = rshiftbyte_m128(*s, 8);
+    return conf;
+}
+#endif
+
+#if defined(__AVX2__)
+/** \brief Loads the table entries for byte p of the two 8-byte blocks at
+ * itPtr into the two lanes of an m256. */
+static really_inline
+m256 load_entry_pair(const u8 *itPtr, const u8 *start_ptr, const u8 *end_ptr,
+                     const u64a *data, const u32 p,
+                     u64a domain_mask_adjusted, const u8 *ft) {
+    m256 st = cast128to256(load128(ft + 8 * get_entry_offset(itPtr,
+                                   start_ptr, end_ptr, data[0], p,
+                                   domain_mask_adjusted)));
+    return insert128to256(st, load128(ft + 8 * get_entry_offset(itPtr + 8,
+                                      start_ptr, end_ptr, data[1], p,
+                                      domain_mask_adjusted)), 1);
+}
+
+#define FDR_PAIR(p)                                                         \
+    load_entry_pair(itPtr, start_ptr, end_ptr, data, p,                     \
+                    domain_mask_adjusted, ft)
+
+/** \brief Computes the confirm words for the 16 bytes at itPtr. */
+static really_inline
+void get_conf_pair(const u8 *itPtr, const u8 *start_ptr, const u8 *end_ptr,
+                   u64a domain_mask_adjusted, const u8 *ft, const u32 stride,
+                   u64a *conf, m128 *s) {
+    u64a data[2];
+    data[0] = lv_u64a(itPtr, start_ptr, end_ptr);
+    data[1] = lv_u64a(itPtr + 8, start_ptr, end_ptr);
+
+    m256 st = FDR_PAIR(0);
+    if (stride == 1) {
+        st = or256(st, lshift128_m256(FDR_PAIR(1), 1));
+        st = or256(st, lshift128_m256(FDR_PAIR(3), 3));
+        st = or256(st, lshift128_m256(FDR_PAIR(5), 5));
+        st = or256(st, lshift128_m256(FDR_PAIR(7), 7));
+    }
+    if (stride <= 2) {
+        st = or256(st, lshift128_m256(FDR_PAIR(2), 2));
+        st = or256(st, lshift128_m256(FDR_PAIR(6), 6));
+    }
+    st = or256(st, lshift128_m256(FDR_PAIR(4), 4));
+
+    conf[0] = merge_block(movdq_lo(st), s);
+    conf[1] = merge_block(movdq_hi(st), s);
+}
+
+#undef FDR_PAIR
+
+static really_inline
+void get_conf_wide(const u8 *itPtr, const u8 *start_ptr, const u8 *end_ptr,
+                   u64a domain_mask_adjusted, const u8 *ft, const u32 stride,
+                   u64a *conf, m128 *s) {
+    get_conf_pair(itPtr, start_ptr, end_ptr, domain_mask_adjusted, ft, stride,
+                  conf, s);
+    get_conf_pair(itPtr + 16, start_ptr, end_ptr, domain_mask_adjusted, ft,
+                  stride, conf + 2, s);
+}
+#endif
+
 static really_inline
 void do_confirm_fdr(u64a *conf, u8 offset, hwlmcb_rv_t *control,
                     const u32 *confBase, const struct FDR_Runtime_Args *a,
-                    const u8 *ptr, u32 *last_match_id, struct zone *z) {
+                    const u8 *ptr, u32 *last_match_id, struct zone *z,
+                    struct fdr_match_batch *batch) {
     const u8 bucket = 8;
     const u8 pullback = 1;
 
@@ -341,22 +445,23 @@ void do_confirm_fdr(u64a *conf, u8 offset, hwlmcb_rv_t *control,
         }
         const struct FDRConfirm *fdrc = (const struct FDRConfirm *)
                                         ((const u8 *)confBase + cf);
-        if (!(fdrc->groups & *control)) {
+        if (!(fdrc->groups & *control) && batchIsEmpty(batch)) {
             continue;
         }
         if (!fdrc->mult) {
             u32 id = fdrc->nBitsOrSoleID;
-            if ((*last_match_id == id) && (fdrc->flags & NoRepeat)) {
+            if ((*last_match_id == id) && (fdrc->flags & NoRepeat) &&
+                batchIsEmpty(batch)) {
                 continue;
             }
-           *last_match_id = id;
-           *control = a->cb(ptr_main + byte - a->buf, ptr_main + byte - a->buf,
-                            id, a->ctxt);
-           continue;
+            size_t loc = ptr_main + byte - a->buf;
+            deliverMatch(batch, a, loc, loc, id, fdrc->groups,
+                         fdrc->flags & NoRepeat, control, last_match_id);
+            continue;
         }
         u64a confVal = unaligned_load_u64a(confLoc + byte - sizeof(u64a));
         confWithBit(fdrc, a, ptr_main - a->buf + byte, pullback, control,
-                    last_match_id, confVal);
+                    last_match_id, confVal, batch);
     } while (unlikely(!!*conf));
 }
 
@@ -669,14 +774,55 @@ size_t prepareZones(const u8 *buf, size_t len, const u8 *hend,
 
 #define INVALID_MATCH_ID (~0U)
 
-#define FDR_MAIN_LOOP(zz, s, get_conf_fn)                                   \
+#if defined(WIDE_ITER_BYTES)
+/* Runs WIDE_ITER_BYTES iterations over as much of the zone as possible, leaving
+ * itPtr at the start of the remainder for FDR_MAIN_LOOP. Boundary zones are
+ * only ITER_BYTES long, so this only runs on the main zone. */
+#define FDR_WIDE_LOOP(zz, s, stride)                                        \
+    do {                                                                    \
+        for (; itPtr + WIDE_ITER_BYTES <= end_ptr;                          \
+             itPtr += WIDE_ITER_BYTES) {                                    \
+            if (unlikely(itPtr > tryFloodDetect)) {                         \
+                tryFloodDetect = floodDetect(fdr, a, &itPtr, tryFloodDetect,\
+                                             &floodBackoff, &control,       \
+                                             ITER_BYTES);                   \
+                if (unlikely(control == HWLM_TERMINATE_MATCHING)) {         \
+                    return HWLM_TERMINATED;                                 \
+                }                                                           \
+                if (itPtr + WIDE_ITER_BYTES > end_ptr) {                    \
+                    break;                                                  \
+                }                                                           \
+            }                                                               \
+            __builtin_prefetch(itPtr + (WIDE_ITER_BYTES*2));                \
+            u64a conf[WIDE_ITER_BYTES / 8];                                 \
+            get_conf_wide(itPtr, start_ptr, end_ptr, domain_mask_adjusted,  \
+                          ft, stride, conf, &s);                            \
+            for (u32 c = 0; c < WIDE_ITER_BYTES / 8; c++) {                 \
+                do_confirm_fdr(&conf[c], c * 8, &control, confBase, a,      \
+                               itPtr, &last_match_id, zz, &batch);          \
+            }                                                               \
+            if (batch.count) {                                              \
+                flushMatchBatch(&batch, a, &control, &last_match_id);       \
+            }                                                               \
+            if (unlikely(control == HWLM_TERMINATE_MATCHING)) {             \
+                return HWLM_TERMINATED;                                     \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+#else
+#define FDR_WIDE_LOOP(zz, s, stride) do { } while (0)
+#endif
+
+#define FDR_MAIN_LOOP(zz, s, get_conf_fn, stride)                           \
     do {                                                                    \
         const u8 *tryFloodDetect = zz->floodPtr;                            \
         const u8 *start_ptr = zz->start;                                    \
         const u8 *end_ptr = zz->end;                                        \
+        const u8 *itPtr = start_ptr;                                        \
                                                                             \
-        for (const u8 *itPtr = start_ptr; itPtr + ITER_BYTES <= end_ptr;    \
-            itPtr += ITER_BYTES) {                                          \
+        FDR_WIDE_LOOP(zz, s, stride);                                       \
+                                                                            \
+        for (; itPtr + ITER_BYTES <= end_ptr; itPtr += ITER_BYTES) {        \
             if (unlikely(itPtr > tryFloodDetect)) {                         \
                 tryFloodDetect = floodDetect(fdr, a, &itPtr, tryFloodDetect,\
                                              &floodBackoff, &control,       \
@@ -691,9 +837,12 @@ size_t prepareZones(const u8 *buf, size_t len, const u8 *hend,
             get_conf_fn(itPtr, start_ptr, end_ptr, domain_mask_adjusted,    \
                         ft, &conf0, &conf8, &s);                            \
             do_confirm_fdr(&conf0, 0, &control, confBase, a, itPtr,         \
-                           &last_match_id, zz);                             \
+                           &last_match_id, zz, &batch);                     \
             do_confirm_fdr(&conf8, 8, &control, confBase, a, itPtr,         \
-                           &last_match_id, zz);                             \
+                           &last_match_id, zz, &batch);                     \
+            if (batch.count) {                                              \
+                flushMatchBatch(&batch, a, &control, &last_match_id);       \
+            }                                                               \
             if (unlikely(control == HWLM_TERMINATE_MATCHING)) {             \
                 return HWLM_TERMINATED;                                     \
             }                                                               \
@@ -706,6 +855,8 @@ hwlm_error_t fdr_engine_exec(const struct FDR *fdr,
                              hwlm_group_t control) {
     u32 floodBackoff = FLOOD_BACKOFF_START;
     u32 last_match_id = INVALID_MATCH_ID;
+    struct fdr_match_batch batch;
+    batch.count = 0;
     u64a domain_mask_adjusted = fdr->domainMask << 1;
     u8 stride = fdr->stride;
     const u8 *ft = (const u8 *)fdr + ROUNDUP_16(sizeof(struct FDR));
@@ -746,13 +897,13 @@ hwlm_error_t fdr_engine_exec(const struct FDR *fdr,
 
         switch (stride) {
         case 1:
-            FDR_MAIN_LOOP(z, state, get_conf_stride_1);
+            FDR_MAIN_LOOP(z, state, get_conf_stride_1, 1);
             break;
         case 2:
-            FDR_MAIN_LOOP(z, state, get_conf_stride_2);
+            FDR_MAIN_LOOP(z, state, get_conf_stride_2, 2);
             break;
         case 4:
-            FDR_MAIN_LOOP(z, state, get_conf_stride_4);
+            FDR_MAIN_LOOP(z, state, get_conf_stride_4, 4);
             break;
         default:
             break;
@@ -768,6 +919,12 @@ hwlm_error_t fdr_engine_exec(const struct FDR *fdr,
 #define ONLY_AVX2(func) NULL
 #endif
 
+#if defined(__AVX512BW__)
+#define ONLY_AVX512(func) func
+#else
+#define ONLY_AVX512(func) NULL
+#endif
+
 typedef hwlm_error_t (*FDRFUNCTYPE)(const struct FDR *fdr,
                                     const struct FDR_Runtime_Args *a,
                                     hwlm_group_t control);
@@ -792,6 +949,36 @@ static const FDRFUNCTYPE funcs[] = {
     fdr_exec_teddy_msks3_pck,
     fdr_exec_teddy_msks4,
     fdr_exec_teddy_msks4_pck,
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks1),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks1_pck),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks2),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks2_pck),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks3),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks3_pck),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks4),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks4_pck),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks1_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks1_pck_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks2_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks2_pck_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks3_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks3_pck_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks4_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks4_pck_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks1_b32),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks1_pck_b32),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks2_b32),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks2_pck_b32),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks3_b32),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks3_pck_b32),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks4_b32),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks4_pck_b32),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks6_pck),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks6_pck_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks6_pck_b32),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks8_pck),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks8_pck_fat),
+    ONLY_AVX512(fdr_exec_teddy_avx512_msks8_pck_b32),
 };
 
 #define FAKE_HISTORY_SIZE 16
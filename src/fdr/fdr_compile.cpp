@@ -40,6 +40,9 @@
 #include "grey.h"
 #include "ue2common.h"
 #include "util/alloc.h"
+#include "util/byte_freq.h"
+#include "util/charreach.h"
+#include "util/charreach_util.h"
 #include "util/compare.h"
 #include "util/dump_mask.h"
 #include "util/target_info.h"
@@ -52,6 +55,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <map>
 #include <memory>
 #include <set>
@@ -73,6 +77,7 @@ private:
     const vector<hwlmLiteral> &lits;
     map<BucketIndex, std::vector<LiteralIndex> > bucketToLits;
     bool make_small;
+    const ByteFrequencies *byte_freq; //!< expected traffic, or nullptr
 
     u8 *tabIndexToMask(u32 indexInTable);
     void assignStringToBucket(LiteralIndex l, BucketIndex b);
@@ -86,9 +91,10 @@ private:
 
 public:
     FDRCompiler(const vector<hwlmLiteral> &lits_in,
-                const FDREngineDescription &eng_in, bool make_small_in)
+                const FDREngineDescription &eng_in, bool make_small_in,
+                const ByteFrequencies *byte_freq_in)
         : eng(eng_in), tab(eng_in.getTabSizeBytes()), lits(lits_in),
-          make_small(make_small_in) {}
+          make_small(make_small_in), byte_freq(byte_freq_in) {}
 
     aligned_unique_ptr<FDR> build(pair<aligned_unique_ptr<u8>, size_t> &link);
 };
@@ -235,10 +241,68 @@ static u64a getScoreUtil(u32 len, u32 count) {
                              // this might be overkill in the other direction
 }
 
+/**
+ * \brief For each run of chunks [j, k), the probability that a bucket holding
+ * exactly the literals in those chunks lets a position of traffic with byte
+ * frequencies \a freq through to confirm.
+ *
+ * At each of its first \a width positions (counted back from the end of the
+ * literal) that all of its literals cover, the bucket passes only the bytes
+ * that its literals have there; positions are taken to be independent.
+ * Chunks are in increasing order of length, so the shortest literals of a run
+ * are in chunk j.
+ */
+static
+vector<vector<double>> getBucketPassRates(const vector<hwlmLiteral> &lits,
+                                          const vector<LiteralIndex> &vli,
+                                          const u32 *firstIds,
+                                          const u32 *length, u32 nChunks,
+                                          u32 width,
+                                          const ByteFrequencies &freq) {
+    // Bytes found at each position of the literals in each chunk.
+    vector<vector<CharReach>> reach(nChunks);
+    for (u32 c = 0; c + 1 < nChunks; c++) {
+        const u32 n = min(length[c], width);
+        reach[c].resize(n);
+        for (u32 i = firstIds[c]; i < firstIds[c + 1]; i++) {
+            const hwlmLiteral &lit = lits[vli[i]];
+            const size_t sz = lit.s.size();
+            for (u32 p = 0; p < n; p++) {
+                CharReach cr((u8)lit.s[sz - p - 1]);
+                if (lit.nocase) {
+                    make_caseless(&cr);
+                }
+                reach[c][p] |= cr;
+            }
+        }
+    }
+
+    vector<vector<double>> rate(nChunks, vector<double>(nChunks, 1.0));
+    for (u32 j = 0; j + 1 < nChunks; j++) {
+        const u32 n = min(length[j], width);
+        vector<CharReach> seen(n);
+        vector<double> prob(n, 0.0);
+        for (u32 k = j + 1; k < nChunks; k++) {
+            double r = 1.0;
+            for (u32 p = 0; p < n; p++) {
+                const CharReach added = reach[k - 1][p] & ~seen[p];
+                for (size_t c = added.find_first(); c != CharReach::npos;
+                     c = added.find_next(c)) {
+                    prob[p] += freq.prob[c];
+                }
+                seen[p] |= added;
+                r *= prob[p];
+            }
+            rate[j][k] = r;
+        }
+    }
+    return rate;
+}
+
 //#define DEBUG_ASSIGNMENT
 void FDRCompiler::assignStringsToBuckets() {
-    typedef u64a SCORE; // 'Score' type
-    const SCORE MAX_SCORE = (SCORE)-1;
+    typedef double SCORE; // 'Score' type
+    const SCORE MAX_SCORE = numeric_limits<SCORE>::max();
     const u32 CHUNK_MAX = 512;
     const u32 BUCKET_MAX = 16;
     typedef pair<SCORE, u32> SCORE_INDEX_PAIR;
@@ -307,6 +371,21 @@ void FDRCompiler::assignStringsToBuckets() {
     }
 #endif
 
+    // With byte frequencies for the expected traffic, a bucket of chunks
+    // [j, k) is scored by its expected confirm work per position scanned,
+    // rather than by a guess from its literal lengths.
+    vector<vector<double>> passRate;
+    if (byte_freq) {
+        passRate = getBucketPassRates(lits, vli, firstIds, length, nChunks,
+                                      eng.getBucketWidth(0), *byte_freq);
+    }
+    auto bucketScore = [&](u32 j, u32 k, u32 cnt) -> SCORE {
+        if (byte_freq && length[j]) {
+            return cnt * passRate[j][k];
+        }
+        return getScoreUtil(length[j], cnt);
+    };
+
     SCORE_INDEX_PAIR t[CHUNK_MAX][BUCKET_MAX]; // pair of score, index
     u32 nb = eng.getNumBuckets();
 
@@ -315,7 +394,7 @@ void FDRCompiler::assignStringsToBuckets() {
         for (u32 k = j; k < nChunks; ++k) {
             cnt += count[k];
         }
-        t[j][0] = {getScoreUtil(length[j], cnt), 0};
+        t[j][0] = {bucketScore(j, nChunks - 1, cnt), 0};
     }
 
     for (u32 i = 1; i < nb; i++) {
@@ -323,7 +402,7 @@ void FDRCompiler::assignStringsToBuckets() {
             SCORE_INDEX_PAIR best = {MAX_SCORE, 0};
             u32 cnt = count[j];
             for (u32 k = j + 1; k < nChunks - 1; k++, cnt += count[k]) {
-                SCORE score = getScoreUtil(length[j], cnt);
+                SCORE score = bucketScore(j, k, cnt);
                 if (score > best.first) {
                     break; // if we're now worse locally than our best score, give up
                 }
@@ -341,7 +420,7 @@ void FDRCompiler::assignStringsToBuckets() {
     for (u32 j = 0; j < nChunks; j++) {
         for (u32 i = 0; i < nb; i++) {
             SCORE_INDEX_PAIR v = t[j][i];
-            printf("<%7lld,%3d>", v.first, v.second);
+            printf("<%7g,%3d>", v.first, v.second);
         }
         printf("\n");
     }
@@ -499,7 +578,8 @@ static
 aligned_unique_ptr<FDR>
 fdrBuildTableInternal(const vector<hwlmLiteral> &lits, bool make_small,
                       const target_t &target, const Grey &grey, u32 hint,
-                      hwlmStreamingControl *stream_control) {
+                      hwlmStreamingControl *stream_control,
+                      const ByteFrequencies *byte_freq) {
     pair<aligned_unique_ptr<u8>, size_t> link(nullptr, 0);
     if (stream_control) {
         link = fdrBuildTableStreaming(lits, *stream_control);
@@ -518,8 +598,9 @@ fdrBuildTableInternal(const vector<hwlmLiteral> &lits, bool make_small,
     }
 
     const unique_ptr<FDREngineDescription> des =
-        (hint == HINT_INVALID) ? chooseEngine(target, lits, make_small)
-                               : getFdrDescription(hint);
+        (hint == HINT_INVALID)
+            ? chooseEngine(target, lits, make_small, byte_freq)
+            : getFdrDescription(hint);
 
     if (!des) {
         return nullptr;
@@ -531,16 +612,17 @@ fdrBuildTableInternal(const vector<hwlmLiteral> &lits, bool make_small,
         des->stride = 1;
     }
 
-    FDRCompiler fc(lits, *des, make_small);
+    FDRCompiler fc(lits, *des, make_small, byte_freq);
     return fc.build(link);
 }
 
 aligned_unique_ptr<FDR> fdrBuildTable(const vector<hwlmLiteral> &lits,
                                       bool make_small, const target_t &target,
                                       const Grey &grey,
-                                      hwlmStreamingControl *stream_control) {
+                                      hwlmStreamingControl *stream_control,
+                                      const ByteFrequencies *byte_freq) {
     return fdrBuildTableInternal(lits, make_small, target, grey, HINT_INVALID,
-                                 stream_control);
+                                 stream_control, byte_freq);
 }
 
 #if !defined(RELEASE_BUILD)
@@ -551,7 +633,7 @@ fdrBuildTableHinted(const vector<hwlmLiteral> &lits, bool make_small, u32 hint,
                     hwlmStreamingControl *stream_control) {
     pair<u8 *, size_t> link(nullptr, 0);
     return fdrBuildTableInternal(lits, make_small, target, grey, hint,
-                                 stream_control);
+                                 stream_control, nullptr);
 }
 
 #endif
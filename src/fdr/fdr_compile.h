@@ -44,13 +44,22 @@ namespace ue2 {
 
 struct hwlmLiteral;
 struct hwlmStreamingControl;
+struct ByteFrequencies;
 struct Grey;
 struct target_t;
 
+/**
+ * \brief Builds an FDR (or Teddy) literal matcher for \a lits.
+ *
+ * If \a byte_freq is given, the FDR buckets and table domain are chosen to
+ * minimise the expected false positive rate on traffic with those byte
+ * frequencies.
+ */
 ue2::aligned_unique_ptr<FDR>
 fdrBuildTable(const std::vector<hwlmLiteral> &lits, bool make_small,
               const target_t &target, const Grey &grey,
-              hwlmStreamingControl *stream_control = nullptr);
+              hwlmStreamingControl *stream_control = nullptr,
+              const ByteFrequencies *byte_freq = nullptr);
 
 #if !defined(RELEASE_BUILD)
 
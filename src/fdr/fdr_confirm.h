@@ -75,6 +75,7 @@ struct LitInfo {
  * This structure is followed in memory by:
  *
  * -# lit index mapping (array of u32)
+ * -# filter bitmap (if filterBits is non-zero)
  * -# list of LitInfo structures
  */
 struct FDRConfirm {
@@ -86,6 +87,16 @@ struct FDRConfirm {
     u32 soleLitSize;
     u32 soleLitCmp;
     u32 soleLitMsk;
+
+    /** \brief Width of the hash used to index the filter bitmap, or zero if
+     * there is no filter.
+     *
+     * The filter has a bit set for each hash value of a literal in this
+     * table, taken at a finer resolution than the lit index; the top
+     * nBitsOrSoleID bits of the same hash give the lit index entry. As it is a
+     * fraction of the size of the lit index, it stays in cache and rejects most
+     * false positives before the lit index or LitInfo chains are touched. */
+    u32 filterBits;
 };
 
 static really_inline
@@ -97,4 +108,11 @@ const u32 *getConfirmLitIndex(const struct FDRConfirm *fdrc) {
     return litIndex;
 }
 
+static really_inline
+const u8 *getConfirmFilter(const struct FDRConfirm *fdrc) {
+    assert(fdrc->filterBits);
+    return (const u8 *)(getConfirmLitIndex(fdrc) +
+                        (1U << fdrc->nBitsOrSoleID));
+}
+
 #endif // FDR_CONFIRM_H
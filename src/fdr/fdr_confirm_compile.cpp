@@ -148,6 +148,16 @@ void fillLitInfo(const vector<hwlmLiteral> &lits, vector<LitInfo> &tmpLitInfo,
     }
 }
 
+/** \brief Smallest lit index (in hash bits) that is given a filter; below
+ * this, the lit index is small enough to stay in cache itself. */
+static const u32 CONF_FILTER_MIN_INDEX_BITS = 8;
+
+/** \brief Hash bits the filter has beyond the lit index. */
+static const u32 CONF_FILTER_EXTRA_BITS = 3;
+
+/** \brief Largest filter, in hash bits (a 4KB bitmap). */
+static const u32 CONF_FILTER_MAX_BITS = 15;
+
 //#define FDR_CONFIRM_DUMP 1
 
 static pair<aligned_unique_ptr<FDRConfirm>, size_t>
@@ -206,15 +216,25 @@ getFDRConfirm(const vector<hwlmLiteral> &lits, bool applyOneCharOpt,
         }
     }
 
+    u32 filterBits = 0;
+    if (!(flags & FDRC_FLAG_NO_CONFIRM) &&
+        nBits >= CONF_FILTER_MIN_INDEX_BITS) {
+        filterBits = min(nBits + CONF_FILTER_EXTRA_BITS, CONF_FILTER_MAX_BITS);
+    }
+
     // we can walk the vector and assign elements from the vectors to a
     // map by hash value
     map<u32, vector<LiteralIndex> > res2lits;
+    set<u32> filterHashes;
     hwlm_group_t gm = 0;
     for (LiteralIndex i = 0; i < lits.size(); i++) {
         LitInfo & li = tmpLitInfo[i];
         u32 hash = CONF_HASH_CALL(li.v, andmsk, mult, nBits);
         DEBUG_PRINTF("%016llx --> %u\n", li.v, hash);
         res2lits[hash].push_back(i);
+        if (filterBits) {
+            filterHashes.insert(CONF_HASH_CALL(li.v, andmsk, mult, filterBits));
+        }
         gm |= li.groups;
     }
 
@@ -280,11 +300,12 @@ getFDRConfirm(const vector<hwlmLiteral> &lits, bool applyOneCharOpt,
 #endif
 
     const size_t bitsToLitIndexSize = (1U << nBits) * sizeof(u32);
+    const size_t filterSize = filterBits ? (1U << filterBits) / 8 : 0;
     const size_t totalLitSize = thresholdedSize(lits, sizeof(CONF_TYPE));
 
     // this size can now be a worst-case as we can always be a bit smaller
     size_t size = ROUNDUP_N(sizeof(FDRConfirm), alignof(u32)) +
-                  ROUNDUP_N(bitsToLitIndexSize, alignof(LitInfo)) +
+                  ROUNDUP_N(bitsToLitIndexSize + filterSize, alignof(LitInfo)) +
                   sizeof(LitInfo) * lits.size() + totalLitSize;
     size = ROUNDUP_N(size, alignof(FDRConfirm));
 
@@ -298,6 +319,7 @@ getFDRConfirm(const vector<hwlmLiteral> &lits, bool applyOneCharOpt,
     fdrc->soleLitSize = soleLitSize;
     fdrc->soleLitCmp = soleLitCmp;
     fdrc->soleLitMsk = soleLitMsk;
+    fdrc->filterBits = filterBits;
 
     fdrc->groups = gm;
 
@@ -308,6 +330,15 @@ getFDRConfirm(const vector<hwlmLiteral> &lits, bool applyOneCharOpt,
     u32 *bitsToLitIndex = (u32 *)ptr;
     ptr += bitsToLitIndexSize;
 
+    // Then the filter bitmap, if we have one.
+    if (filterBits) {
+        assert(ptr == getConfirmFilter(fdrc.get()));
+        for (u32 hash : filterHashes) {
+            ptr[hash / 8] |= 1U << (hash % 8);
+        }
+        ptr += filterSize;
+    }
+
     // After the lit index array, we have the LitInfo structures themselves,
     // which vary in size (as each may have a variable-length string after it).
     ptr = ROUNDUP_PTR(ptr, alignof(LitInfo));
@@ -36,18 +36,115 @@
 #include "util/bitutils.h"
 #include "util/compare.h"
 
+/** \brief Maximum number of confirmed matches held in a match batch. */
+#define FDR_MATCH_BATCH_SIZE 32
+
+/** \brief A confirmed literal match awaiting delivery to the callback. */
+struct fdr_match {
+    size_t start;
+    size_t end;
+    hwlm_group_t groups; //!< Groups of the literal, checked on delivery.
+    u32 id;
+    u8 noRepeat; //!< Literal has the NoRepeat flag.
+};
+
+/**
+ * \brief Confirmed matches for the current block, delivered to the callback
+ * in order by flushMatchBatch().
+ *
+ * Holding matches back keeps the callback's code and data out of the confirm
+ * loop, so that high match-rate scans alternate between the two less often.
+ * Since the callback may switch groups on or off, the group and NoRepeat
+ * checks for a batched match are only final once the matches ahead of it have
+ * been delivered; they are redone at delivery time.
+ */
+struct fdr_match_batch {
+    u32 count;
+    struct fdr_match m[FDR_MATCH_BATCH_SIZE];
+};
+
+/**
+ * \brief Returns true if the current groups and last match ID reflect every
+ * match found so far, so that confirm-time checks against them are final.
+ */
+static really_inline
+int batchIsEmpty(const struct fdr_match_batch *batch) {
+    return !batch || !batch->count;
+}
+
+/** \brief Deliver all batched matches to the callback, in order. */
+static really_inline
+void flushMatchBatch(struct fdr_match_batch *batch,
+                     const struct FDR_Runtime_Args *a, hwlmcb_rv_t *control,
+                     u32 *last_match) {
+    for (u32 i = 0; i < batch->count; i++) {
+        const struct fdr_match *m = &batch->m[i];
+        if (!(m->groups & *control)) {
+            continue;
+        }
+        if (*last_match == m->id && m->noRepeat) {
+            continue;
+        }
+        *last_match = m->id;
+        *control = a->cb(m->start, m->end, m->id, a->ctxt);
+        if (unlikely(*control == HWLM_TERMINATE_MATCHING)) {
+            break;
+        }
+    }
+    batch->count = 0;
+}
+
+/**
+ * \brief Pass a confirmed match to the callback, or hold it in the batch if
+ * one is in use.
+ */
+static really_inline
+void deliverMatch(struct fdr_match_batch *batch,
+                  const struct FDR_Runtime_Args *a, size_t start, size_t end,
+                  u32 id, hwlm_group_t groups, u8 noRepeat,
+                  hwlmcb_rv_t *control, u32 *last_match) {
+    if (!batch) {
+        *last_match = id;
+        *control = a->cb(start, end, id, a->ctxt);
+        return;
+    }
+
+    if (unlikely(batch->count == FDR_MATCH_BATCH_SIZE)) {
+        flushMatchBatch(batch, a, control, last_match);
+    }
+
+    struct fdr_match *m = &batch->m[batch->count++];
+    m->start = start;
+    m->end = end;
+    m->groups = groups;
+    m->id = id;
+    m->noRepeat = noRepeat;
+}
+
 // this is ordinary confirmation function which runs through
-// the whole confirmation procedure
+// the whole confirmation procedure; matches are held in batch if it is
+// non-NULL
 static really_inline
 void confWithBit(const struct FDRConfirm *fdrc, const struct FDR_Runtime_Args *a,
                  size_t i, u32 pullBackAmount, hwlmcb_rv_t *control,
-                 u32 *last_match, u64a conf_key) {
+                 u32 *last_match, u64a conf_key,
+                 struct fdr_match_batch *batch) {
     assert(i < a->len);
     assert(ISALIGNED(fdrc));
 
     const u8 * buf = a->buf;
-    u32 c = CONF_HASH_CALL(conf_key, fdrc->andmsk, fdrc->mult,
+    u32 c;
+    if (fdrc->filterBits) {
+        u32 f = CONF_HASH_CALL(conf_key, fdrc->andmsk, fdrc->mult,
+                               fdrc->filterBits);
+        if (likely(!(getConfirmFilter(fdrc)[f / 8] & (1U << (f % 8))))) {
+            return;
+        }
+        c = f >> (fdrc->filterBits - fdrc->nBitsOrSoleID);
+    } else {
+        c = CONF_HASH_CALL(conf_key, fdrc->andmsk, fdrc->mult,
                            fdrc->nBitsOrSoleID);
+    }
     u32 start = getConfirmLitIndex(fdrc)[c];
     if (likely(!start)) {
         return;
@@ -64,7 +161,8 @@ void confWithBit(const struct FDRConfirm *fdrc, const struct FDR_Runtime_Args *a
             goto out;
         }
 
-        if ((*last_match == li->id) && (li->flags & NoRepeat)) {
+        if ((*last_match == li->id) && (li->flags & NoRepeat) &&
+            batchIsEmpty(batch)) {
             goto out;
         }
 
@@ -115,7 +213,7 @@ void confWithBit(const struct FDRConfirm *fdrc, const struct FDR_Runtime_Args *a
             }
         }
 
-        if (unlikely(!(li->groups & *control))) {
+        if (unlikely(!(li->groups & *control)) && batchIsEmpty(batch)) {
             goto out;
         }
 
@@ -131,8 +229,8 @@ void confWithBit(const struct FDRConfirm *fdrc, const struct FDR_Runtime_Args *a
             }
         }
 
-        *last_match = li->id;
-        *control = a->cb(loc - buf, i, li->id, a->ctxt);
+        deliverMatch(batch, a, loc - buf, i, li->id, li->groups,
+                     li->flags & NoRepeat, control, last_match);
     out:
         oldNext = li->next; // oldNext is either 0 or an 'adjust' value
         li = (const struct LitInfo *)((const u8 *)li + oldNext + li->size);
@@ -150,7 +248,7 @@ void confWithBit1(const struct FDRConfirm *fdrc,
     assert(ISALIGNED(fdrc));
 
     if (unlikely(fdrc->mult)) {
-        confWithBit(fdrc, a, i, 0, control, last_match, conf_key);
+        confWithBit(fdrc, a, i, 0, control, last_match, conf_key, NULL);
         return;
     } else {
         u32 id = fdrc->nBitsOrSoleID;
@@ -178,7 +276,7 @@ void confWithBitMany(const struct FDRConfirm *fdrc,
     }
 
     if (unlikely(fdrc->mult)) {
-        confWithBit(fdrc, a, i, 0, control, last_match, conf_key);
+        confWithBit(fdrc, a, i, 0, control, last_match, conf_key, NULL);
         return;
     } else {
         const u32 id = fdrc->nBitsOrSoleID;
@@ -29,10 +29,14 @@
 #include "fdr_compile_internal.h"
 #include "fdr_engine_description.h"
 #include "hs_compile.h"
+#include "util/byte_freq.h"
+#include "util/charreach.h"
+#include "util/charreach_util.h"
 #include "util/target_info.h"
 #include "util/compare.h" // for ourisalpha()
 #include "util/make_unique.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <map>
@@ -95,9 +99,73 @@ u32 findDesiredStride(size_t num_lits, size_t min_len, size_t min_len_count) {
     return desiredStride;
 }
 
-unique_ptr<FDREngineDescription> chooseEngine(const target_t &target,
-                                              const vector<hwlmLiteral> &vl,
-                                              bool make_small) {
+/**
+ * \brief Probability that the table entry looked up at a position of traffic
+ * with byte frequencies \a freq is one that the final two bytes of some
+ * literal in \a vl map to, for a domain of \a bits bits.
+ *
+ * The domain value is made up of a byte and the low (bits - 8) bits of the
+ * byte before it, so on skewed traffic a wider domain may filter out few more
+ * positions than a narrower one.
+ */
+static
+double getDomainPassRate(const vector<hwlmLiteral> &vl, u32 bits,
+                         const ByteFrequencies &freq) {
+    assert(bits > 8 && bits < 16);
+    const u32 hi_mask = (1U << (bits - 8)) - 1;
+
+    vector<double> hi_prob(hi_mask + 1, 0.0);
+    for (u32 c = 0; c < 256; c++) {
+        hi_prob[c & hi_mask] += freq.prob[c];
+    }
+
+    vector<bool> hit(1U << bits, false);
+    for (const auto &lit : vl) {
+        const string &s = lit.s;
+        const size_t sz = s.size();
+        CharReach last((u8)s[sz - 1]);
+        CharReach prev = sz > 1 ? CharReach((u8)s[sz - 2]) : CharReach::dot();
+        if (lit.nocase) {
+            make_caseless(&last);
+            make_caseless(&prev);
+        }
+        for (size_t c1 = prev.find_first(); c1 != CharReach::npos;
+             c1 = prev.find_next(c1)) {
+            for (size_t c0 = last.find_first(); c0 != CharReach::npos;
+                 c0 = last.find_next(c0)) {
+                hit[c0 | ((c1 & hi_mask) << 8)] = true;
+            }
+        }
+    }
+
+    double rate = 0;
+    for (u32 v = 0; v < hit.size(); v++) {
+        if (hit[v]) {
+            rate += freq.prob[v & 0xff] * hi_prob[v >> 8];
+        }
+    }
+    return rate;
+}
+
+/**
+ * \brief Smallest domain whose pass rate on traffic with byte frequencies
+ * \a freq is close to that of the largest domain.
+ */
+static
+u32 findProfileDomain(const vector<hwlmLiteral> &vl,
+                      const ByteFrequencies &freq) {
+    const double best_rate = getDomainPassRate(vl, 15, freq);
+    for (u32 domain = 9; domain < 15; domain++) {
+        if (getDomainPassRate(vl, domain, freq) <= best_rate * 1.1) {
+            return domain;
+        }
+    }
+    return 15;
+}
+
+unique_ptr<FDREngineDescription>
+chooseEngine(const target_t &target, const vector<hwlmLiteral> &vl,
+             bool make_small, const ByteFrequencies *byte_freq) {
     vector<FDREngineDescription> allDescs;
     getFdrDescriptions(&allDescs);
 
@@ -109,6 +177,14 @@ unique_ptr<FDREngineDescription> chooseEngine(const target_t &target,
     DEBUG_PRINTF("%zu lits, msl=%zu, desiredStride=%u\n", vl.size(), msl,
                  desiredStride);
 
+    // With byte frequencies for the expected traffic, find the domain beyond
+    // which extra table bits stop filtering out input positions.
+    u32 profileDomain = 0;
+    if (byte_freq) {
+        profileDomain = findProfileDomain(vl, *byte_freq);
+        DEBUG_PRINTF("profileDomain=%u\n", profileDomain);
+    }
+
     FDREngineDescription *best = nullptr;
     u32 best_score = 0;
 
@@ -175,6 +251,12 @@ unique_ptr<FDREngineDescription> chooseEngine(const target_t &target,
                 ideal -= 2;
             }
 
+            if (profileDomain) {
+                // Give up table size that buys nothing on this traffic, or
+                // spend a little more where it does.
+                ideal = min(max(profileDomain, ideal - 2), ideal + 1);
+            }
+
             score -= absdiff(ideal, domain);
 
             DEBUG_PRINTF("fdr %u: width=%u, domain=%u, buckets=%u, stride=%zu "
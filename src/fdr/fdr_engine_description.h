@@ -38,6 +38,8 @@
 
 namespace ue2 {
 
+struct ByteFrequencies;
+
 struct FDREngineDef {
     u32 id;
     u32 schemeWidth;
@@ -69,7 +71,7 @@ public:
 
 std::unique_ptr<FDREngineDescription>
 chooseEngine(const target_t &target, const std::vector<hwlmLiteral> &vl,
-             bool make_small);
+             bool make_small, const ByteFrequencies *byte_freq = nullptr);
 std::unique_ptr<FDREngineDescription> getFdrDescription(u32 engineID);
 void getFdrDescriptions(std::vector<FDREngineDescription> *out);
 } // namespace ue2
@@ -59,6 +59,59 @@ struct FDRFlood {
     u32 len[FDR_FLOOD_MAX_IDS]; //!< lengths to go with the string ids
 };
 
+/** \brief Longest flood period handled. Floods of a single character (period
+ * one) go through the FDRFlood structures; floods of period two and up go
+ * through the FDRPeriodicFlood structure. */
+#define FDR_PFLOOD_MAX_PERIOD 8
+
+/** \brief Most literals that can match inside a flood of a given period for
+ * that period to be handled. */
+#define FDR_PFLOOD_MAX_LITS 32
+
+/** \brief Longest literal that can match inside a flood of a given period for
+ * that period to be handled. */
+#define FDR_PFLOOD_MAX_LEN 64
+
+/** \brief Least flood needed behind the point where a periodic flood is
+ * skipped: enough for a confirm load, and for the state that the main loops
+ * carry from one iteration to the next to be the same at both ends of the
+ * skip. */
+#define FDR_PFLOOD_MIN_HISTORY 16
+
+/** \brief Header of the flood control structure, which is followed by the
+ * FDRFlood structures and then by the FDRPeriodicFlood structure, if any. */
+struct FDRFloodHeader {
+    u32 floodIdx[N_CHARS]; //!< index of the FDRFlood for each character
+    u32 periodicOffset; //!< offset of the FDRPeriodicFlood, or 0 if none
+    u32 pad;
+};
+
+/** \brief A literal that can match inside a periodic flood.
+ *
+ * Inside a flood of period p, a literal can only match if it is itself
+ * periodic with period p; if it is, it matches at a given end if its last p
+ * bytes (with any supplementary mask) do. msk and cmp hold the last eight
+ * bytes, as with confirm. */
+struct FDRPeriodicFloodLit {
+    u64a msk;
+    u64a cmp;
+    hwlm_group_t groups;
+    u32 id;
+    u32 len;
+};
+
+/** \brief Literals that can match inside floods of each period from two to
+ * FDR_PFLOOD_MAX_PERIOD, followed by the FDRPeriodicFloodLit array. */
+struct FDRPeriodicFlood {
+    /** \brief Bytes of flood needed before a match can be reported in bulk,
+     * or 0 if floods of this period are not handled. */
+    u32 history[FDR_PFLOOD_MAX_PERIOD + 1];
+    u32 litStart[FDR_PFLOOD_MAX_PERIOD + 1]; //!< first literal for the period
+    u32 litCount[FDR_PFLOOD_MAX_PERIOD + 1]; //!< literals for the period
+    u32 pad;
+    hwlm_group_t allGroups[FDR_PFLOOD_MAX_PERIOD + 1];
+};
+
 /** \brief FDR structure.
  *
  * 1. struct as-is
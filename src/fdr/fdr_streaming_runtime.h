@@ -30,7 +30,9 @@
 #define FDR_STREAMING_RUNTIME_H
 
 #include "fdr_streaming_internal.h"
+#include "util/compare.h"
 #include "util/partial_store.h"
+#include "util/simd_utils.h"
 
 #include <string.h>
 
@@ -252,24 +254,27 @@ u32 do_single_confirm(const struct FDRSTableHeader *streamingTable,
     return hashState; // our new state
 }
 
+/** \brief Returns the last \a hash_len bytes of history and data, gathered
+ * in \a tempbuf if they straddle the two. */
 static really_inline
-void fdrFindStreamingHash(const struct FDR_Runtime_Args *a,
-                          const struct FDRSTableHeader *streamingTable,
-                          u8 hash_len, u32 *hashes) {
-    u8 tempbuf[128];
-    const u8 *base;
+const u8 *fdrStreamingWindow(const struct FDR_Runtime_Args *a, u8 hash_len,
+                             u8 *tempbuf) {
     if (hash_len > a->len) {
-        assert(hash_len <= 128);
         size_t overhang = hash_len - a->len;
         assert(overhang <= a->len_history);
         memcpy(tempbuf, a->buf_history + a->len_history - overhang, overhang);
         memcpy(tempbuf + overhang, a->buf, a->len);
-        base = tempbuf;
-    } else {
-        assert(hash_len <= a->len);
-        base = a->buf + a->len - hash_len;
+        return tempbuf;
     }
 
+    assert(hash_len <= a->len);
+    return a->buf + a->len - hash_len;
+}
+
+static really_inline
+void fdrFindStreamingHash(const u8 *base,
+                          const struct FDRSTableHeader *streamingTable,
+                          u8 hash_len, u32 *hashes) {
     if (streamingTable->hashNBits[CASEFUL]) {
         hashes[CASEFUL] = streaming_hash(base, hash_len, CASEFUL);
     }
@@ -301,20 +306,45 @@ const struct FDRSHashEntry *getEnt(const struct FDRSTableHeader *streamingTable,
     return ent;
 }
 
+/**
+ * \brief Cheap filter for a hash chain entry: compares the sixteen bytes of
+ * literal before its state with the end of the window in one vector compare.
+ *
+ * Chains hold every position that shares a bucket, so most entries differ
+ * from the window within those bytes, and only the rest pay for the literal
+ * table search and full confirm. Every state is at least the window length
+ * (32 or more) bytes into its literal, so the bytes are all literal.
+ */
+static really_inline
+int stateTailMismatch(const struct FDRSTableHeader *streamingTable,
+                      m128 tail, u32 state) {
+    const u8 *lit_tail = (const u8 *)streamingTable + state - sizeof(m128);
+    return movemask128(eq128(tail, loadu128(lit_tail))) != 0xffff;
+}
+
 static really_inline
 void fdrPackStateMode(u32 *state_table, const struct FDR_Runtime_Args *a,
                       const struct FDRSTableHeader *streamingTable,
-                      const struct FDRSHashEntry *ent, const enum Modes m) {
+                      const struct FDRSHashEntry *ent, const u8 *window,
+                      const enum Modes m) {
     assert(ent);
     assert(streamingTable->hashNBits[m]);
+    assert(streamingTable->N >= sizeof(m128));
 
     const struct FDRSHashEntry *tab =
         (const struct FDRSHashEntry *)((const u8 *)streamingTable
                                        + streamingTable->hashOffset[m]);
 
+    // Caseless literals are stored upper-case.
+    m128 tail = loadu128(window + streamingTable->N - sizeof(m128));
+    if (m == CASELESS) {
+        tail = toupper128(tail);
+    }
+
     while (1) {
         u32 tmp = 0;
-        if ((tmp = do_single_confirm(streamingTable, a, ent->state, m))) {
+        if (!stateTailMismatch(streamingTable, tail, ent->state) &&
+            (tmp = do_single_confirm(streamingTable, a, ent->state, m))) {
             state_table[m] = packStateVal(streamingTable, m, tmp);
             break;
         }
@@ -344,7 +374,11 @@ void fdrPackState(const struct FDR *fdr, const struct FDR_Runtime_Args *a,
     if (streamingTable->N <= a->len + a->len_history) {
         u32 hashes[MAX_MODES] = {0, 0};
 
-        fdrFindStreamingHash(a, streamingTable, streamingTable->N, hashes);
+        u8 tempbuf[256];
+        const u8 *window =
+            fdrStreamingWindow(a, streamingTable->N, tempbuf);
+        fdrFindStreamingHash(window, streamingTable, streamingTable->N,
+                             hashes);
 
         const struct FDRSHashEntry *ent_ful = getEnt(streamingTable,
                                                     hashes[CASEFUL], CASEFUL);
@@ -352,12 +386,12 @@ void fdrPackState(const struct FDR *fdr, const struct FDR_Runtime_Args *a,
                                                     hashes[CASELESS], CASELESS);
 
         if (ent_ful) {
-            fdrPackStateMode(state_table, a, streamingTable, ent_ful,
+            fdrPackStateMode(state_table, a, streamingTable, ent_ful, window,
                              CASEFUL);
         }
 
         if (ent_less) {
-            fdrPackStateMode(state_table, a, streamingTable, ent_less,
+            fdrPackStateMode(state_table, a, streamingTable, ent_less, window,
                              CASELESS);
         }
     }
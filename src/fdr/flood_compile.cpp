@@ -38,6 +38,7 @@
 #include "util/ue2string.h"
 #include "util/verify_types.h"
 
+#include <algorithm>
 #include <cstring>
 #include <map>
 #include <memory>
@@ -90,6 +91,121 @@ void addFlood(vector<FDRFlood> &tmpFlood, u8 c, const hwlmLiteral &lit,
    }
 }
 
+/** \brief Returns the length of the longest suffix of the literal that
+ * repeats with the given period. If it is the whole literal, the literal can
+ * match inside a flood of that period. */
+static
+size_t periodicSuffixLen(const hwlmLiteral &lit, u32 period) {
+    const string &s = lit.s;
+    for (size_t i = s.length(); i > period; i--) {
+        // s[i - period - 1] is the first byte outside the suffix.
+        if (isDifferent(s[i - period - 1], s[i - 1], lit.nocase)) {
+            return s.length() - (i - period);
+        }
+    }
+    return s.length();
+}
+
+static
+FDRPeriodicFloodLit makePeriodicFloodLit(const hwlmLiteral &lit) {
+    FDRPeriodicFloodLit pl;
+    memset(&pl, 0, sizeof(pl));
+    pl.id = lit.id;
+    pl.len = verify_u32(lit.s.length());
+    pl.groups = lit.groups;
+
+    // Built up in the same way as the confirm msk and v, assuming a LE
+    // machine.
+    for (u32 j = 0; j < sizeof(u64a) && j < lit.s.length(); j++) {
+        u32 shift = (sizeof(u64a) - j - 1) * 8;
+        u8 c = lit.s[lit.s.length() - j - 1];
+        u8 m = lit.nocase && ourisalpha(c) ? CASE_CLEAR : 0xff;
+        pl.msk |= (u64a)m << shift;
+        pl.cmp |= (u64a)(c & m) << shift;
+    }
+
+    size_t mlen = lit.msk.size();
+    for (u32 j = 0; j < mlen; j++) {
+        u32 shift = (sizeof(u64a) - j - 1) * 8;
+        u8 m = lit.msk[mlen - j - 1];
+        pl.msk |= (u64a)m << shift;
+        pl.cmp |= (u64a)(lit.cmp[mlen - j - 1] & m) << shift;
+    }
+
+    return pl;
+}
+
+/**
+ * \brief Build the periodic flood structure: for each period from two to
+ * FDR_PFLOOD_MAX_PERIOD, the literals that can match inside a flood of that
+ * period. Periods with too many or too long such literals are not handled.
+ *
+ * Returns an empty vector if no period is handled.
+ */
+static
+vector<u8> setupPeriodicFlood(const vector<hwlmLiteral> &lits) {
+    FDRPeriodicFlood pf;
+    memset(&pf, 0, sizeof(pf));
+    vector<FDRPeriodicFloodLit> pflits;
+
+    for (u32 p = 2; p <= FDR_PFLOOD_MAX_PERIOD; p++) {
+        vector<FDRPeriodicFloodLit> curr;
+        size_t history = FDR_PFLOOD_MIN_HISTORY;
+        hwlm_group_t groups = 0;
+        bool ok = true;
+        for (const auto &lit : lits) {
+            size_t suffix = periodicSuffixLen(lit, p);
+            if (suffix < lit.s.length()) {
+                // This literal can only match across the start of a flood,
+                // so the flood must be longer than its periodic suffix.
+                history = max(history, suffix + 1);
+                if (history > FDR_PFLOOD_MAX_LEN) {
+                    ok = false;
+                    break;
+                }
+                continue;
+            }
+            size_t len = max(lit.s.length(), lit.msk.size());
+            if (curr.size() == FDR_PFLOOD_MAX_LITS ||
+                len > FDR_PFLOOD_MAX_LEN) {
+                ok = false;
+                break;
+            }
+            curr.push_back(makePeriodicFloodLit(lit));
+            history = max(history, len);
+            groups |= lit.groups;
+        }
+        if (!ok) {
+            DEBUG_PRINTF("floods of period %u not handled\n", p);
+            continue;
+        }
+
+        DEBUG_PRINTF("period %u: %zu lits, history %zu\n", p, curr.size(),
+                     history);
+        pf.history[p] = verify_u32(history);
+        pf.litStart[p] = verify_u32(pflits.size());
+        pf.litCount[p] = verify_u32(curr.size());
+        pf.allGroups[p] = groups;
+        pflits.insert(pflits.end(), curr.begin(), curr.end());
+    }
+
+    bool any = false;
+    for (u32 p = 2; p <= FDR_PFLOOD_MAX_PERIOD; p++) {
+        any |= pf.history[p] != 0;
+    }
+    if (!any) {
+        return {};
+    }
+
+    vector<u8> out(sizeof(pf) + pflits.size() * sizeof(FDRPeriodicFloodLit));
+    memcpy(out.data(), &pf, sizeof(pf));
+    if (!pflits.empty()) {
+        memcpy(out.data() + sizeof(pf), pflits.data(),
+               pflits.size() * sizeof(FDRPeriodicFloodLit));
+    }
+    return out;
+}
+
 pair<aligned_unique_ptr<u8>, size_t>
 setupFDRFloodControl(const vector<hwlmLiteral> &lits,
                      const EngineDescription &eng) {
@@ -193,17 +309,26 @@ setupFDRFloodControl(const vector<hwlmLiteral> &lits,
         flood2chars[fl].set(i);
     }
 
+    vector<u8> periodic = setupPeriodicFlood(lits);
+
     u32 nDistinctFloods = flood2chars.size();
-    size_t floodHeaderSize = sizeof(u32) * N_CHARS;
+    size_t floodHeaderSize = sizeof(FDRFloodHeader);
     size_t floodStructSize = sizeof(FDRFlood) * nDistinctFloods;
-    size_t totalSize = ROUNDUP_16(floodHeaderSize + floodStructSize);
+    size_t periodicOffset = ROUNDUP_16(floodHeaderSize + floodStructSize);
+    size_t totalSize = ROUNDUP_16(periodicOffset + periodic.size());
 
     auto buf = aligned_zmalloc_unique<u8>(totalSize);
     assert(buf); // otherwise would have thrown std::bad_alloc
 
-    u32 *floodHeader = (u32 *)buf.get();
+    FDRFloodHeader *fh = (FDRFloodHeader *)buf.get();
+    u32 *floodHeader = fh->floodIdx;
     FDRFlood *layoutFlood = (FDRFlood *)(buf.get() + floodHeaderSize);
 
+    if (!periodic.empty()) {
+        fh->periodicOffset = verify_u32(periodicOffset);
+        memcpy(buf.get() + periodicOffset, periodic.data(), periodic.size());
+    }
+
     u32 currentFloodIndex = 0;
     for (const auto &m : flood2chars) {
         const FDRFlood &fl = m.first;
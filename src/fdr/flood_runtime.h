@@ -29,6 +29,10 @@
 #ifndef FLOOD_RUNTIME
 #define FLOOD_RUNTIME
 
+#include "fdr_internal.h"
+#include "util/bitutils.h"
+#include "util/unaligned.h"
+
 #if defined(ARCH_64_BIT)
 #define FLOOD_64
 #else
@@ -37,6 +41,19 @@
 #define FLOOD_MINIMUM_SIZE 256
 #define FLOOD_BACKOFF_START 32
 
+/** \brief Returns the shortest period, from one to FDR_PFLOOD_MAX_PERIOD, with
+ * which the bytes at ptr repeat, or 0 if there is none. Reads 16 bytes. */
+static really_inline
+u32 floodPeriod(const u8 *ptr) {
+    u64a v = unaligned_load_u64a(ptr);
+    for (u32 p = 1; p <= FDR_PFLOOD_MAX_PERIOD; p++) {
+        if (v == unaligned_load_u64a(ptr + p)) {
+            return p;
+        }
+    }
+    return 0;
+}
+
 static really_inline
 const u8 * nextFloodDetect(const u8 * buf, size_t len, u32 floodBackoff) {
     // if we don't have a flood at either the start or end,
@@ -46,40 +63,130 @@ const u8 * nextFloodDetect(const u8 * buf, size_t len, u32 floodBackoff) {
     }
 
     /* entry points in runtime.c prefetch relevant data */
-#ifndef FLOOD_32
-    u64a x11 = *(const u64a *)ROUNDUP_PTR(buf, 8);
-    u64a x12 = *(const u64a *)ROUNDUP_PTR(buf+8, 8);
-    if (x11 == x12) {
+    if (floodPeriod(ROUNDUP_PTR(buf, 8))) {
         return buf + floodBackoff;
     }
-    u64a x21 = *(const u64a *)ROUNDUP_PTR(buf + len/2, 8);
-    u64a x22 = *(const u64a *)ROUNDUP_PTR(buf + len/2 + 8, 8);
-    if (x21 == x22) {
+    if (floodPeriod(ROUNDUP_PTR(buf + len/2, 8))) {
         return buf + floodBackoff;
     }
-    u64a x31 = *(const u64a *)ROUNDUP_PTR(buf + len - 24, 8);
-    u64a x32 = *(const u64a *)ROUNDUP_PTR(buf + len - 16, 8);
-    if (x31 == x32) {
+    if (floodPeriod(ROUNDUP_PTR(buf + len - 24, 8))) {
         return buf + floodBackoff;
     }
-#else
-    u32 x11 = *(const u32 *)ROUNDUP_PTR(buf, 4);
-    u32 x12 = *(const u32 *)ROUNDUP_PTR(buf+4, 4);
-    if (x11 == x12) {
-        return buf + floodBackoff;
+    return buf + len;
+}
+
+/**
+ * \brief Handle a flood of period two or more starting at buf[i], reporting
+ * the matches of the literals that can match inside it in bulk.
+ *
+ * Returns the position up to which matches have been reported, which is i if
+ * there is no flood that can be handled here.
+ */
+static never_inline
+u32 periodicFloodDetect(const struct FDR *fdr,
+                        const struct FDR_Runtime_Args *a, u32 i,
+                        hwlmcb_rv_t *control, u32 iterBytes) {
+    const u8 *fBase = (const u8 *)fdr + fdr->floodOffset;
+    const struct FDRFloodHeader *fh = (const struct FDRFloodHeader *)fBase;
+    if (!fh->periodicOffset) {
+        return i;
     }
-    u32 x21 = *(const u32 *)ROUNDUP_PTR(buf + len/2, 4);
-    u32 x22 = *(const u32 *)ROUNDUP_PTR(buf + len/2 + 4, 4);
-    if (x21 == x22) {
-        return buf + floodBackoff;
+    const struct FDRPeriodicFlood *pf =
+        (const struct FDRPeriodicFlood *)(fBase + fh->periodicOffset);
+    const u8 *buf = a->buf;
+    if (a->len - i < 16) {
+        return i;
     }
-    u32 x31 = *(const u32 *)ROUNDUP_PTR(buf + len - 12, 4);
-    u32 x32 = *(const u32 *)ROUNDUP_PTR(buf + len - 8, 4);
-    if (x31 == x32) {
-        return buf + floodBackoff;
+    const size_t mainLoopLen = a->len > iterBytes ? a->len - iterBytes : 0;
+
+    u32 p = floodPeriod(buf + i);
+    if (p < 2 || !pf->history[p]) {
+        return i;
     }
-#endif
-    return buf + len;
+
+    // The flood must reach far enough back that the longest literal that can
+    // match in it fits inside it when ending at i.
+    const u32 history = pf->history[p];
+    if (i + 1 < history) {
+        return i;
+    }
+    u32 x = i + 1 - history;
+    for (; x + 8 <= i; x += 8) {
+        if (unaligned_load_u64a(buf + x) != unaligned_load_u64a(buf + x + p)) {
+            return i;
+        }
+    }
+    for (; x < i; x++) {
+        if (buf[x] != buf[x + p]) {
+            return i;
+        }
+    }
+
+    // Find where the flood ends.
+    u32 j = i + p;
+    for (; j + 8 <= mainLoopLen; j += 8) {
+        if (unaligned_load_u64a(buf + j) != unaligned_load_u64a(buf + j - p)) {
+            break;
+        }
+    }
+    for (; j < mainLoopLen; j++) {
+        if (buf[j] != buf[j - p]) {
+            break;
+        }
+    }
+
+    // Skip a whole number of periods as well as of iterations, so that the
+    // main loop resumes with the same state that it left with.
+    u32 step = iterBytes;
+    while (step % p) {
+        step += iterBytes;
+    }
+    u32 floodSize = ((j - i) / step) * step;
+    if (!floodSize) {
+        return i;
+    }
+
+    DEBUG_PRINTF("period %u flood of %u bytes at %u\n", p, floodSize, i);
+
+    // Every match in the flood is a repeat of one at the first p ends.
+    const struct FDRPeriodicFloodLit *lits =
+        (const struct FDRPeriodicFloodLit *)((const u8 *)pf + sizeof(*pf)) +
+        pf->litStart[p];
+    const u32 litCount = pf->litCount[p];
+    u32 phaseMatches[FDR_PFLOOD_MAX_PERIOD];
+    u32 any = 0;
+    for (u32 k = 0; k < p; k++) {
+        u64a v = unaligned_load_u64a(buf + i + k - 7);
+        u32 m = 0;
+        for (u32 l = 0; l < litCount; l++) {
+            if ((v & lits[l].msk) == lits[l].cmp) {
+                m |= 1U << l;
+            }
+        }
+        phaseMatches[k] = m;
+        any |= m;
+    }
+
+    if (any && (*control & pf->allGroups[p])) {
+        HWLMCallback cb = a->cb;
+        void *ctxt = a->ctxt;
+        for (u32 t = 0; t < floodSize && (*control & pf->allGroups[p]);
+             t += p) {
+            for (u32 k = 0; k < p && t + k < floodSize; k++) {
+                u32 e = i + t + k;
+                u32 m = phaseMatches[k];
+                while (m) {
+                    const struct FDRPeriodicFloodLit *l =
+                        &lits[findAndClearLSB_32(&m)];
+                    if (*control & l->groups) {
+                        *control = cb(e - l->len + 1, e, l->id, ctxt);
+                    }
+                }
+            }
+        }
+    }
+
+    return i + floodSize;
 }
 
 static really_inline
@@ -107,8 +214,10 @@ const u8 * floodDetect(const struct FDR * fdr,
     // go from c to our FDRFlood structure
     u8 c = buf[i];
     const u8 * fBase = ((const u8 *)fdr) + fdr->floodOffset;
-    u32 fIdx = ((const u32 *)fBase)[c];
-    const struct FDRFlood * fsb = (const struct FDRFlood *)(fBase + sizeof(u32) * 256);
+    const struct FDRFloodHeader * fh = (const struct FDRFloodHeader *)fBase;
+    u32 fIdx = fh->floodIdx[c];
+    const struct FDRFlood * fsb =
+        (const struct FDRFlood *)(fBase + sizeof(struct FDRFloodHeader));
     const struct FDRFlood * fl = &fsb[fIdx];
 
 #ifndef FLOOD_32
@@ -124,7 +233,17 @@ const u8 * floodDetect(const struct FDR * fdr,
     u32 probe = *(const u32 *)ROUNDUP_PTR(buf+i, 4);
 #endif
 
-    if ((probe != cmpVal) || (fl->idCount >= FDR_FLOOD_MAX_IDS)) {
+    if (probe != cmpVal) {
+        j = periodicFloodDetect(fdr, a, i, control, iterBytes);
+        if (j > i) {
+            ptr += j - i;
+        } else {
+            *floodBackoffPtr *= 2;
+        }
+        goto floodout;
+    }
+
+    if (fl->idCount >= FDR_FLOOD_MAX_IDS) {
         *floodBackoffPtr *= 2;
         goto floodout;
     }
@@ -82,12 +82,12 @@ do {                                                                        \
         u64a hi = movq(rshiftbyte_m128(var, 8));                            \
         if (unlikely(lo)) {                                                 \
             conf_fn(&lo, bucket, offset, confBase, reason, a, ptr,          \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(hi)) {                                                 \
             conf_fn(&hi, bucket, offset + 8, confBase, reason, a, ptr,      \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
     }                                                                       \
@@ -102,22 +102,22 @@ do {                                                                        \
         u32 part4 = movd(rshiftbyte_m128(var, 12));                         \
         if (unlikely(part1)) {                                              \
             conf_fn(&part1, bucket, offset, confBase, reason, a, ptr,       \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part2)) {                                              \
             conf_fn(&part2, bucket, offset + 4, confBase, reason, a, ptr,   \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part3)) {                                              \
             conf_fn(&part3, bucket, offset + 8, confBase, reason, a, ptr,   \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part4)) {                                              \
             conf_fn(&part4, bucket, offset + 12, confBase, reason, a, ptr,  \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
     }                                                                       \
@@ -185,6 +185,8 @@ hwlm_error_t fdr_exec_teddy_msks1(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -241,6 +243,8 @@ hwlm_error_t fdr_exec_teddy_msks1_pck(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -297,6 +301,8 @@ hwlm_error_t fdr_exec_teddy_msks2(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -354,6 +360,8 @@ hwlm_error_t fdr_exec_teddy_msks2_pck(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -411,6 +419,8 @@ hwlm_error_t fdr_exec_teddy_msks3(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -473,6 +483,8 @@ hwlm_error_t fdr_exec_teddy_msks3_pck(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -535,6 +547,8 @@ hwlm_error_t fdr_exec_teddy_msks4(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -599,6 +613,8 @@ hwlm_error_t fdr_exec_teddy_msks4_pck(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -121,22 +121,22 @@ do {                                                                        \
         u64a part4 = extract64from256(r, 1);                                \
         if (unlikely(part1)) {                                              \
             conf_fn(&part1, bucket, offset, confBase, reason, a, ptr,       \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part2)) {                                              \
             conf_fn(&part2, bucket, offset + 4, confBase, reason, a, ptr,   \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part3)) {                                              \
             conf_fn(&part3, bucket, offset + 8, confBase, reason, a, ptr,   \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part4)) {                                              \
             conf_fn(&part4, bucket, offset + 12, confBase, reason, a, ptr,  \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
     }                                                                       \
@@ -158,41 +158,41 @@ do {                                                                        \
         u32 part8 = extract32from256(r, 3);                                 \
         if (unlikely(part1)) {                                              \
             conf_fn(&part1, bucket, offset, confBase, reason, a, ptr,       \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part2)) {                                              \
             conf_fn(&part2, bucket, offset + 2, confBase, reason, a, ptr,   \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
         }                                                                   \
         if (unlikely(part3)) {                                              \
             conf_fn(&part3, bucket, offset + 4, confBase, reason, a, ptr,   \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part4)) {                                              \
             conf_fn(&part4, bucket, offset + 6, confBase, reason, a, ptr,   \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part5)) {                                              \
             conf_fn(&part5, bucket, offset + 8, confBase, reason, a, ptr,   \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part6)) {                                              \
             conf_fn(&part6, bucket, offset + 10, confBase, reason, a, ptr,  \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part7)) {                                              \
             conf_fn(&part7, bucket, offset + 12, confBase, reason, a, ptr,  \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
         if (unlikely(part8)) {                                              \
             conf_fn(&part8, bucket, offset + 14, confBase, reason, a, ptr,  \
-                    &control, &last_match);                                 \
+                    &control, &last_match, &live);                          \
             CHECK_HWLM_TERMINATE_MATCHING;                                  \
         }                                                                   \
     }                                                                       \
@@ -358,7 +358,8 @@ void do_confWithBit_fast_teddy(u16 bits, const u32 *confBase,
         return;
     }
     u64a confVal = getConfVal(a, ptr, byte, reason);
-    confWithBit(fdrc, a, ptr - a->buf + byte, 0, control, last_match, confVal);
+    confWithBit(fdrc, a, ptr - a->buf + byte, 0, control, last_match, confVal,
+                NULL);
 }
 
 static really_inline
@@ -486,6 +487,8 @@ hwlm_error_t fdr_exec_teddy_avx2_msks1_fat(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -542,6 +545,8 @@ hwlm_error_t fdr_exec_teddy_avx2_msks1_pck_fat(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -598,6 +603,8 @@ hwlm_error_t fdr_exec_teddy_avx2_msks2_fat(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -656,6 +663,8 @@ hwlm_error_t fdr_exec_teddy_avx2_msks2_pck_fat(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -714,6 +723,8 @@ hwlm_error_t fdr_exec_teddy_avx2_msks3_fat(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -777,6 +788,8 @@ hwlm_error_t fdr_exec_teddy_avx2_msks3_pck_fat(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -840,6 +853,8 @@ hwlm_error_t fdr_exec_teddy_avx2_msks4_fat(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -904,6 +919,8 @@ hwlm_error_t fdr_exec_teddy_avx2_msks4_pck_fat(const struct FDR *fdr,
     const u8 *tryFloodDetect = a->firstFloodDetect;
     u32 last_match = (u32)-1;
     const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
     const size_t iterBytes = 32;
     DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
                  a->buf, a->len, a->start_offset);
@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Teddy literal matcher: AVX-512 engine runtime.
+ *
+ * These engines share the bytecode layout of the SSSE3 (slim, 8 bucket) and
+ * AVX2 fat (16 bucket) Teddy models, but use 512-bit registers. The slim
+ * engines look up 64 bytes of input per shuffle; the fat engines look up 32
+ * bytes against all 16 buckets at once, and the 32-bucket engines (which have
+ * no narrower equivalent) look up 16 bytes against all 32 buckets at once.
+ * Only these engines support more than four masks.
+ *
+ * Rather than shifting match results across vectors, each mask is applied to
+ * an unaligned load offset by its distance from the end of the literal. Near
+ * the edges of the buffer, the input is first stitched together (with the
+ * relevant history) into a temporary block.
+ */
+
+#include "fdr_internal.h"
+#include "flood_runtime.h"
+#include "teddy.h"
+#include "teddy_internal.h"
+#include "teddy_runtime_common.h"
+#include "util/simd_utils.h"
+
+#if defined(__AVX512BW__)
+
+/** \brief Which of the common confirm routines an engine uses. */
+#define TEDDY_512_CONF_BIT1 0 //!< do_confWithBit1_teddy
+#define TEDDY_512_CONF_BIT 1 //!< do_confWithBit_teddy
+#define TEDDY_512_CONF_MANY 2 //!< do_confWithBitMany_teddy
+
+/** \brief Size of the stitched block used for cautious scanning: 16 bytes of
+ * preceding input followed by the 64-byte block itself. */
+#define TEDDY_512_STITCH_SIZE 128
+#define TEDDY_512_STITCH_OFFSET 64
+
+#ifdef ARCH_64_BIT
+#define TEDDY_512_PART_MASK(var) ((u32)_mm512_test_epi64_mask(var, var))
+#else
+#define TEDDY_512_PART_MASK(var) ((u32)_mm512_test_epi32_mask(var, var))
+#endif
+
+#define TEDDY_512_PARTS (64 / sizeof(TEDDY_CONF_TYPE))
+
+static really_inline
+void teddy512_confirm(u32 conf_type, TEDDY_CONF_TYPE *conf, u8 bucket,
+                      u8 offset, const u32 *confBase, CautionReason reason,
+                      const struct FDR_Runtime_Args *a, const u8 *ptr,
+                      hwlmcb_rv_t *control, u32 *last_match,
+                      struct teddy_live *live) {
+    switch (conf_type) {
+    case TEDDY_512_CONF_BIT1:
+        do_confWithBit1_teddy(conf, bucket, offset, confBase, reason, a, ptr,
+                              control, last_match, live);
+        break;
+    case TEDDY_512_CONF_BIT:
+        do_confWithBit_teddy(conf, bucket, offset, confBase, reason, a, ptr,
+                             control, last_match, live);
+        break;
+    default:
+        do_confWithBitMany_teddy(conf, bucket, offset, confBase, reason, a,
+                                 ptr, control, last_match, live);
+        break;
+    }
+}
+
+/* Split a 512-bit result into TEDDY_CONF_TYPE parts and confirm the nonzero
+ * ones. Each position is described by bucket / 8 consecutive bytes. */
+#define CONFIRM_TEDDY_512(var, bucket, offset, reason)                      \
+do {                                                                        \
+    u32 parts = TEDDY_512_PART_MASK(var);                                   \
+    if (unlikely(parts)) {                                                  \
+        union {                                                             \
+            TEDDY_CONF_TYPE part[TEDDY_512_PARTS];                          \
+            __m512i v;                                                      \
+        } u;                                                                \
+        u.v = var;                                                          \
+        do {                                                                \
+            u32 i = findAndClearLSB_32(&parts);                             \
+            u8 part_offset = (offset) +                                     \
+                             i * sizeof(TEDDY_CONF_TYPE) * 8 / (bucket);    \
+            teddy512_confirm(conf_type, &u.part[i], bucket, part_offset,    \
+                             confBase, reason, a, ptr, &control,            \
+                             &last_match, &live);                           \
+            CHECK_HWLM_TERMINATE_MATCHING;                                  \
+        } while (parts);                                                    \
+    }                                                                       \
+} while (0);
+
+/** \brief Load 32 bytes for a fat engine, duplicating each 16-byte half so
+ * that it can be looked up against buckets 0-7 and 8-15 at once. */
+static really_inline
+__m512i teddy512_load_fat(const u8 *ptr) {
+    __m512i v = _mm512_castsi256_si512(loadu256(ptr));
+    return _mm512_shuffle_i64x2(v, v, _MM_SHUFFLE(1, 1, 0, 0));
+}
+
+/** \brief Compute the Teddy result for the block whose first position is at
+ * \a ptr. Mask i is applied to the input i bytes before each position. */
+static really_inline
+__m512i prep_conf_teddy_512(const __m512i *maskLo, const __m512i *maskHi,
+                            const u8 *ptr, const u32 nMasks,
+                            const u32 buckets) {
+    const __m512i nib = _mm512_set1_epi8(0xf);
+    __m512i r = _mm512_set1_epi8((char)0xff);
+    for (u32 i = 0; i < nMasks; i++) {
+        __m512i val;
+        if (buckets == 32) {
+            val = _mm512_broadcast_i32x4(loadu128(ptr - i));
+        } else if (buckets == 16) {
+            val = teddy512_load_fat(ptr - i);
+        } else {
+            val = _mm512_loadu_si512((const void *)(ptr - i));
+        }
+        __m512i lo = _mm512_and_si512(val, nib);
+        __m512i hi = _mm512_and_si512(_mm512_srli_epi16(val, 4), nib);
+        r = _mm512_and_si512(r, _mm512_and_si512(
+                            _mm512_shuffle_epi8(maskLo[i], lo),
+                            _mm512_shuffle_epi8(maskHi[i], hi)));
+    }
+    return r;
+}
+
+/** \brief Rearrange a fat result so that each position's buckets 0-15 occupy
+ * consecutive bytes, in position order. */
+static really_inline
+__m512i teddy512_fat_interleave(__m512i r) {
+    __m512i swap = _mm512_shuffle_i64x2(r, r, _MM_SHUFFLE(2, 3, 0, 1));
+    __m512i lo = _mm512_unpacklo_epi8(r, swap);
+    __m512i hi = _mm512_unpackhi_epi8(r, swap);
+    __m512i t = _mm512_shuffle_i64x2(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm512_shuffle_i64x2(t, t, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+/** \brief Expand a 32-position validity mask to the byte layout of a fat
+ * result (before interleaving). */
+static really_inline
+u64a teddy512_fat_valid(u64a valid) {
+    u64a v_lo = valid & 0xffffULL;
+    u64a v_hi = valid & 0xffff0000ULL;
+    return v_lo | (v_lo << 16) | (v_hi << 16) | (v_hi << 32);
+}
+
+/** \brief Rearrange a 32-bucket result, which holds buckets 8l to 8l + 7 of
+ * each of the 16 positions in lane l, so that each position's buckets 0-31
+ * occupy consecutive bytes, in position order. */
+static really_inline
+__m512i teddy512_b32_interleave(__m512i r) {
+    __m512i p = _mm512_shuffle_i64x2(r, r, _MM_SHUFFLE(2, 2, 0, 0));
+    __m512i q = _mm512_shuffle_i64x2(r, r, _MM_SHUFFLE(3, 3, 1, 1));
+    __m512i t = _mm512_mask_blend_epi64(0xcc, _mm512_unpacklo_epi8(p, q),
+                                        _mm512_unpackhi_epi8(p, q));
+    p = _mm512_shuffle_i64x2(t, t, _MM_SHUFFLE(1, 1, 0, 0));
+    q = _mm512_shuffle_i64x2(t, t, _MM_SHUFFLE(3, 3, 2, 2));
+    return _mm512_mask_blend_epi64(0xcc, _mm512_unpacklo_epi16(p, q),
+                                   _mm512_unpackhi_epi16(p, q));
+}
+
+/** \brief Expand a 16-position validity mask to the byte layout of a
+ * 32-bucket result (before interleaving). */
+static really_inline
+u64a teddy512_b32_valid(u64a valid) {
+    u64a v = valid & 0xffffULL;
+    return v | (v << 16) | (v << 32) | (v << 48);
+}
+
+/** \brief Validity mask for the first \a n positions of a block. */
+static really_inline
+u64a teddy512_valid(size_t n) {
+    return n >= 64 ? ~0ULL : (1ULL << n) - 1;
+}
+
+/**
+ * \brief Stitch together the block starting at \a ptr, along with the 16
+ * bytes preceding it, into \a tmp. Bytes outside the buffer are zero, except
+ * for up to nMasks - 1 bytes of history before the start of the buffer.
+ *
+ * Returns the location of \a ptr in the stitched block.
+ */
+static really_inline
+const u8 *teddy512_stitch(u8 *tmp, const u8 *ptr,
+                          const struct FDR_Runtime_Args *a, const u8 *buf_end,
+                          const u32 nMasks) {
+    assert(ptr >= a->buf && ptr < buf_end);
+    u8 *block = tmp + TEDDY_512_STITCH_OFFSET;
+
+    /* The head is loaded first, as a full vector of which only the low 16
+     * bytes are kept; the body then overwrites the rest of it. */
+    size_t before = MIN((size_t)(ptr - a->buf), 16);
+    __mmask64 head = (0xffffULL << (16 - before)) & 0xffffULL;
+    _mm512_storeu_si512((void *)(block - 16),
+                        _mm512_maskz_loadu_epi8(head, ptr - 16));
+
+    __mmask64 body = teddy512_valid((size_t)(buf_end - ptr));
+    _mm512_store_si512((void *)block, _mm512_maskz_loadu_epi8(body, ptr));
+
+    size_t need = MIN(a->len_history, nMasks - 1);
+    for (size_t i = before + 1; i <= before + need && i < nMasks; i++) {
+        *(block - i) = a->buf_history[a->len_history - (i - before)];
+    }
+
+    return block;
+}
+
+static really_inline
+hwlm_error_t fdr_exec_teddy_avx512(const struct FDR *fdr,
+                                   const struct FDR_Runtime_Args *a,
+                                   hwlm_group_t control, const u32 nMasks,
+                                   const u32 buckets, const u32 conf_type) {
+    const u8 *buf_end = a->buf + a->len;
+    const u8 *ptr = a->buf + a->start_offset;
+    u32 floodBackoff = FLOOD_BACKOFF_START;
+    const u8 *tryFloodDetect = a->firstFloodDetect;
+    u32 last_match = (u32)-1;
+    const struct Teddy *teddy = (const struct Teddy *)fdr;
+    struct teddy_live live;
+    initTeddyLive(&live, teddy);
+    const size_t iterBytes = 64;
+    DEBUG_PRINTF("params: buf %p len %zu start_offset %zu\n",
+                 a->buf, a->len, a->start_offset);
+
+    const u32 maskWidth = buckets / 8;
+    const u8 *maskBase = (const u8 *)teddy + sizeof(struct Teddy);
+    const u32 *confBase = (const u32 *)(maskBase + nMasks * 32 * maskWidth);
+
+    __m512i maskLo[8];
+    __m512i maskHi[8];
+    for (u32 i = 0; i < nMasks; i++) {
+        if (buckets == 32) {
+            maskLo[i] = _mm512_loadu_si512(maskBase + (i * 2) * 64);
+            maskHi[i] = _mm512_loadu_si512(maskBase + (i * 2 + 1) * 64);
+        } else if (buckets == 16) {
+            maskLo[i] = _mm512_broadcast_i64x4(
+                            loadu256(maskBase + (i * 2) * 32));
+            maskHi[i] = _mm512_broadcast_i64x4(
+                            loadu256(maskBase + (i * 2 + 1) * 32));
+        } else {
+            maskLo[i] = _mm512_broadcast_i32x4(
+                            load128(maskBase + (i * 2) * 16));
+            maskHi[i] = _mm512_broadcast_i32x4(
+                            load128(maskBase + (i * 2 + 1) * 16));
+        }
+    }
+
+    u8 ALIGN_CL_DIRECTIVE tmp[TEDDY_512_STITCH_SIZE];
+
+/* Scan the 64 positions starting at ptr, reading input from src. Only the
+ * positions set in valid may be reported. */
+#define TEDDY_512_BLOCK(src, valid, reason)                                 \
+do {                                                                        \
+    if (buckets == 32) {                                                    \
+        for (u32 b = 0; b < 64; b += 16) {                                  \
+            __m512i r_0 = prep_conf_teddy_512(maskLo, maskHi, (src) + b,    \
+                                              nMasks, 32);                  \
+            if ((reason) != NOT_CAUTIOUS) {                                 \
+                r_0 = _mm512_maskz_mov_epi8(                                \
+                          teddy512_b32_valid((valid) >> b), r_0);           \
+            }                                                               \
+            if (_mm512_test_epi64_mask(r_0, r_0)) {                         \
+                r_0 = teddy512_b32_interleave(r_0);                         \
+                CONFIRM_TEDDY_512(r_0, 32, b, reason);                      \
+            }                                                               \
+        }                                                                   \
+    } else if (buckets == 16) {                                             \
+        __m512i r_0 = prep_conf_teddy_512(maskLo, maskHi, (src), nMasks,    \
+                                          16);                              \
+        __m512i r_1 = prep_conf_teddy_512(maskLo, maskHi, (src) + 32,       \
+                                          nMasks, 16);                      \
+        if ((reason) != NOT_CAUTIOUS) {                                     \
+            r_0 = _mm512_maskz_mov_epi8(teddy512_fat_valid(valid), r_0);    \
+            r_1 = _mm512_maskz_mov_epi8(teddy512_fat_valid((valid) >> 32),  \
+                                        r_1);                               \
+        }                                                                   \
+        r_0 = teddy512_fat_interleave(r_0);                                 \
+        CONFIRM_TEDDY_512(r_0, 16, 0, reason);                              \
+        r_1 = teddy512_fat_interleave(r_1);                                 \
+        CONFIRM_TEDDY_512(r_1, 16, 32, reason);                             \
+    } else {                                                                \
+        __m512i r_0 = prep_conf_teddy_512(maskLo, maskHi, (src), nMasks, 8);\
+        if ((reason) != NOT_CAUTIOUS) {                                     \
+            r_0 = _mm512_maskz_mov_epi8((valid), r_0);                      \
+        }                                                                   \
+        CONFIRM_TEDDY_512(r_0, 8, 0, reason);                               \
+    }                                                                       \
+} while (0)
+
+    const u8 *mainStart = ROUNDUP_PTR(ptr, 64);
+    DEBUG_PRINTF("derive: ptr: %p mainstart %p\n", ptr, mainStart);
+    if (ptr < mainStart) {
+        const u8 *src = teddy512_stitch(tmp, ptr, a, buf_end, nMasks);
+        const u8 *end = MIN(mainStart, buf_end);
+        TEDDY_512_BLOCK(src, teddy512_valid((size_t)(end - ptr)), VECTORING);
+        ptr = mainStart;
+    }
+
+    /* The main loop reads up to nMasks - 1 bytes before each block and
+     * confirms without caution, so stay clear of the start of the buffer. */
+    if (ptr < buf_end && ptr < a->buf + 16) {
+        const u8 *src = teddy512_stitch(tmp, ptr, a, buf_end, nMasks);
+        TEDDY_512_BLOCK(src, teddy512_valid((size_t)(buf_end - ptr)),
+                        VECTORING);
+        ptr += iterBytes;
+    }
+
+    for (; ptr + iterBytes <= buf_end; ptr += iterBytes) {
+        __builtin_prefetch(ptr + (iterBytes*4));
+        CHECK_FLOOD;
+        TEDDY_512_BLOCK(ptr, ~0ULL, NOT_CAUTIOUS);
+    }
+
+    if (ptr < buf_end) {
+        const u8 *src = teddy512_stitch(tmp, ptr, a, buf_end, nMasks);
+        TEDDY_512_BLOCK(src, teddy512_valid((size_t)(buf_end - ptr)),
+                        VECTORING);
+    }
+
+#undef TEDDY_512_BLOCK
+
+    return HWLM_SUCCESS;
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks1(const struct FDR *fdr,
+                                         const struct FDR_Runtime_Args *a,
+                                         hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 1, 8, TEDDY_512_CONF_BIT1);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks1_pck(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 1, 8, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks2(const struct FDR *fdr,
+                                         const struct FDR_Runtime_Args *a,
+                                         hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 2, 8, TEDDY_512_CONF_MANY);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks2_pck(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 2, 8, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks3(const struct FDR *fdr,
+                                         const struct FDR_Runtime_Args *a,
+                                         hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 3, 8, TEDDY_512_CONF_MANY);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks3_pck(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 3, 8, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks4(const struct FDR *fdr,
+                                         const struct FDR_Runtime_Args *a,
+                                         hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 4, 8, TEDDY_512_CONF_MANY);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks4_pck(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 4, 8, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks1_fat(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 1, 16, TEDDY_512_CONF_BIT1);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks1_pck_fat(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 1, 16, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks2_fat(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 2, 16, TEDDY_512_CONF_MANY);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks2_pck_fat(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 2, 16, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks3_fat(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 3, 16, TEDDY_512_CONF_MANY);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks3_pck_fat(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 3, 16, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks4_fat(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 4, 16, TEDDY_512_CONF_MANY);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks4_pck_fat(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 4, 16, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks1_b32(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 1, 32, TEDDY_512_CONF_BIT1);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks1_pck_b32(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 1, 32, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks2_b32(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 2, 32, TEDDY_512_CONF_MANY);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks2_pck_b32(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 2, 32, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks3_b32(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 3, 32, TEDDY_512_CONF_MANY);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks3_pck_b32(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 3, 32, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks4_b32(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 4, 32, TEDDY_512_CONF_MANY);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks4_pck_b32(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 4, 32, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks6_pck(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 6, 8, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks6_pck_fat(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 6, 16, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks6_pck_b32(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 6, 32, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t fdr_exec_teddy_avx512_msks8_pck(const struct FDR *fdr,
+                                             const struct FDR_Runtime_Args *a,
+                                             hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 8, 8, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks8_pck_fat(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 8, 16, TEDDY_512_CONF_BIT);
+}
+
+hwlm_error_t
+fdr_exec_teddy_avx512_msks8_pck_b32(const struct FDR *fdr,
+                                    const struct FDR_Runtime_Args *a,
+                                    hwlm_group_t control) {
+    return fdr_exec_teddy_avx512(fdr, a, control, 8, 32, TEDDY_512_CONF_BIT);
+}
+
+#endif // __AVX512BW__
@@ -48,6 +48,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <map>
 #include <memory>
 #include <set>
@@ -103,7 +104,7 @@ public:
             printf("%04x ", (u32)nibbleSets[i]);
         }
         printf("\nnlits: %zu\nLit ids: ", litCount());
-        printf("Prob: %llu\n", probability());
+        printf("Prob: %g\n", probability());
         for (const auto &id : litIds) {
             printf("%u ", id);
         }
@@ -143,12 +144,12 @@ public:
         litIds.insert(ts.litIds.begin(), ts.litIds.end());
     }
 
-    // return a value p from 0 .. MAXINT64 that gives p/MAXINT64
+    // return a value p from 0 .. 16^(2*len) that gives p/16^(2*len)
     // likelihood of this TeddySet firing a first-stage accept
     // if it was given a bucket of its own and random data were
-    // to be passed in
-    u64a probability() const {
-        u64a val = 1;
+    // to be passed in (a double, as this overflows a u64a with 8 masks)
+    double probability() const {
+        double val = 1;
         for (size_t i = 0; i < nibbleSets.size(); i++) {
             val *= popcount32((u32)nibbleSets[i]);
         }
@@ -158,7 +159,7 @@ public:
     // return a score based around the chance of this hitting times
     // a small fixed cost + the cost of traversing some sort of followup
     // (assumption is that the followup is linear)
-    u64a heuristic() const {
+    double heuristic() const {
         return probability() * (2+litCount());
     }
 
@@ -198,7 +199,7 @@ bool TeddyCompiler::pack(map<BucketIndex,
 #endif
 
         auto m1 = sts.end(), m2 = sts.end();
-        u64a best = 0xffffffffffffffffULL;
+        double best = numeric_limits<double>::max();
 
         for (auto i1 = sts.begin(), e1 = sts.end(); i1 != e1; ++i1) {
             const TeddySet &s1 = *i1;
@@ -215,14 +216,14 @@ bool TeddyCompiler::pack(map<BucketIndex,
                 TeddySet tmpSet(eng.numMasks);
                 tmpSet.merge(s1);
                 tmpSet.merge(s2);
-                u64a newScore = tmpSet.heuristic();
-                u64a oldScore = s1.heuristic() + s2.heuristic();
+                double newScore = tmpSet.heuristic();
+                double oldScore = s1.heuristic() + s2.heuristic();
                 if (newScore < oldScore) {
                     m1 = i1;
                     m2 = i2;
                     break;
                 } else {
-                    u64a score = newScore - oldScore;
+                    double score = newScore - oldScore;
                     bool oldRunProne = s1.isRunProne() && s2.isRunProne();
                     bool newRunProne = tmpSet.isRunProne();
                     if (newRunProne && !oldRunProne) {
@@ -311,11 +312,22 @@ TeddyCompiler::build(pair<aligned_unique_ptr<u8>, size_t> &link) {
     auto floodControlTmp = setupFDRFloodControl(lits, eng);
     auto confirmTmp = setupFullMultiConfs(lits, eng, bucketToLits, make_small);
 
+    // The union of the groups of each bucket's literals, so that the runtime
+    // can discard all the candidates in buckets whose groups are off at once.
+    vector<u64a> bucketGroups(eng.getNumBuckets(), 0);
+    for (const auto &b2l : bucketToLits) {
+        for (const LiteralIndex &lit_id : b2l.second) {
+            bucketGroups[b2l.first] |= lits[lit_id].groups;
+        }
+    }
+    size_t bucketGroupsLen = bucketGroups.size() * sizeof(u64a);
+
     size_t size = ROUNDUP_N(sizeof(Teddy) +
                              maskLen +
                              confirmTmp.second +
                              floodControlTmp.second +
-                             link.second, 16 * maskWidth);
+                             link.second +
+                             alignof(u64a) + bucketGroupsLen, 16 * maskWidth);
 
     aligned_unique_ptr<FDR> fdr = aligned_zmalloc_unique<FDR>(size);
     assert(fdr); // otherwise would have thrown std::bad_alloc
@@ -337,10 +349,15 @@ TeddyCompiler::build(pair<aligned_unique_ptr<u8>, size_t> &link) {
     if (link.first) {
         teddy->link = verify_u32(ptr - teddy_base);
         memcpy(ptr, link.first.get(), link.second);
+        ptr += link.second;
     } else {
         teddy->link = 0;
     }
 
+    ptr = ROUNDUP_PTR(ptr, alignof(u64a));
+    teddy->bucketGroupsOffset = verify_u32(ptr - teddy_base);
+    memcpy(ptr, bucketGroups.data(), bucketGroupsLen);
+
     u8 *baseMsk = teddy_base + sizeof(Teddy);
 
     for (const auto &b2l : bucketToLits) {
@@ -36,6 +36,7 @@
 #include "teddy_engine_description.h"
 #include "util/make_unique.h"
 
+#include <array>
 #include <cmath>
 
 using namespace std;
@@ -46,7 +47,9 @@ TeddyEngineDescription::TeddyEngineDescription(const TeddyEngineDef &def)
     : EngineDescription(def.id, targetByArchFeatures(def.cpu_features),
                         def.numBuckets, def.confirmPullBackDistance,
                         def.confirmTopLevelSplit),
-      numMasks(def.numMasks), packed(def.packed) {}
+      numMasks(def.numMasks), packed(def.packed),
+      vectorWidth(def.cpu_features & HS_CPU_FEATURES_AVX512 ? 64
+                  : def.cpu_features & HS_CPU_FEATURES_AVX2 ? 32 : 16) {}
 
 u32 TeddyEngineDescription::getDefaultFloodSuffixLength() const {
     return numMasks;
@@ -65,7 +68,39 @@ bool TeddyEngineDescription::needConfirm(const vector<hwlmLiteral> &lits) const
 }
 
 void getTeddyDescriptions(vector<TeddyEngineDescription> *out) {
+    // Engines are considered in order and ties go to the earliest, so the
+    // AVX512 engines come first to be preferred on targets that support them.
     static const TeddyEngineDef defns[] = {
+        { 19, 0 | HS_CPU_FEATURES_AVX512, 1, 8, false, 0, 1 },
+        { 20, 0 | HS_CPU_FEATURES_AVX512, 1, 8, true, 0, 32 },
+        { 21, 0 | HS_CPU_FEATURES_AVX512, 2, 8, false, 0, 1 },
+        { 22, 0 | HS_CPU_FEATURES_AVX512, 2, 8, true, 0, 32 },
+        { 23, 0 | HS_CPU_FEATURES_AVX512, 3, 8, false, 0, 1 },
+        { 24, 0 | HS_CPU_FEATURES_AVX512, 3, 8, true, 0, 32 },
+        { 25, 0 | HS_CPU_FEATURES_AVX512, 4, 8, false, 0, 1 },
+        { 26, 0 | HS_CPU_FEATURES_AVX512, 4, 8, true, 0, 32 },
+        { 27, 0 | HS_CPU_FEATURES_AVX512, 1, 16, false, 0, 1 },
+        { 28, 0 | HS_CPU_FEATURES_AVX512, 1, 16, true, 0, 32 },
+        { 29, 0 | HS_CPU_FEATURES_AVX512, 2, 16, false, 0, 1 },
+        { 30, 0 | HS_CPU_FEATURES_AVX512, 2, 16, true, 0, 32 },
+        { 31, 0 | HS_CPU_FEATURES_AVX512, 3, 16, false, 0, 1 },
+        { 32, 0 | HS_CPU_FEATURES_AVX512, 3, 16, true, 0, 32 },
+        { 33, 0 | HS_CPU_FEATURES_AVX512, 4, 16, false, 0, 1 },
+        { 34, 0 | HS_CPU_FEATURES_AVX512, 4, 16, true, 0, 32 },
+        { 35, 0 | HS_CPU_FEATURES_AVX512, 1, 32, false, 0, 1 },
+        { 36, 0 | HS_CPU_FEATURES_AVX512, 1, 32, true, 0, 32 },
+        { 37, 0 | HS_CPU_FEATURES_AVX512, 2, 32, false, 0, 1 },
+        { 38, 0 | HS_CPU_FEATURES_AVX512, 2, 32, true, 0, 32 },
+        { 39, 0 | HS_CPU_FEATURES_AVX512, 3, 32, false, 0, 1 },
+        { 40, 0 | HS_CPU_FEATURES_AVX512, 3, 32, true, 0, 32 },
+        { 41, 0 | HS_CPU_FEATURES_AVX512, 4, 32, false, 0, 1 },
+        { 42, 0 | HS_CPU_FEATURES_AVX512, 4, 32, true, 0, 32 },
+        { 43, 0 | HS_CPU_FEATURES_AVX512, 6, 8, true, 0, 32 },
+        { 44, 0 | HS_CPU_FEATURES_AVX512, 6, 16, true, 0, 32 },
+        { 45, 0 | HS_CPU_FEATURES_AVX512, 6, 32, true, 0, 32 },
+        { 46, 0 | HS_CPU_FEATURES_AVX512, 8, 8, true, 0, 32 },
+        { 47, 0 | HS_CPU_FEATURES_AVX512, 8, 16, true, 0, 32 },
+        { 48, 0 | HS_CPU_FEATURES_AVX512, 8, 32, true, 0, 32 },
         { 1, 0 | HS_CPU_FEATURES_AVX2, 1, 8, false, 0, 1 },
         { 2, 0 | HS_CPU_FEATURES_AVX2, 1, 8, true, 0, 32 },
         { 3, 0 | HS_CPU_FEATURES_AVX2, 1, 16, false, 0, 1 },
@@ -151,6 +186,125 @@ bool isAllowed(const vector<hwlmLiteral> &vl, const TeddyEngineDescription &eng,
     return true;
 }
 
+/* The following costs are in units of one mask lookup over a vector of
+ * input, and were measured on AVX-512 hardware. */
+
+/** \brief Fixed cost of each vector of input: the loads, the test of the
+ * result and the loop overhead, which dominate the lookups themselves. */
+static const double TEDDY_BLOCK_COST = 10.0;
+
+/** \brief Cost of confirming a first-stage hit. */
+static const double TEDDY_CONF_COST = 1.0;
+
+/** \brief Extra cost charged to an engine that would be flood-prone. */
+static const double TEDDY_FLOOD_COST = 20.0;
+
+/** \brief Most masks used by any Teddy engine. */
+static const u32 TEDDY_MAX_MASKS = 8;
+
+namespace {
+
+/**
+ * \brief Statistics of a literal set used to estimate how often a Teddy
+ * bucket fires.
+ *
+ * The input is modelled on the nibbles of the literals' own bytes: data that
+ * a literal set is scanned for tends to be drawn from the same alphabet, and a
+ * uniform model badly understates the hit rate of (say) a set of text literals
+ * on text.
+ */
+struct TeddyLitStats {
+    explicit TeddyLitStats(const vector<hwlmLiteral> &vl) {
+        lo.fill(0);
+        hi.fill(0);
+        longer.fill(0);
+        size_t total = 0;
+        for (const auto &lit : vl) {
+            for (u8 c : lit.s) {
+                lo[c & 0xf]++;
+                hi[c >> 4]++;
+                total++;
+            }
+            for (u32 i = 0; i < TEDDY_MAX_MASKS && i < lit.s.length(); i++) {
+                longer[i]++;
+            }
+        }
+        for (u32 i = 0; i < 16; i++) {
+            lo[i] /= total;
+            hi[i] /= total;
+        }
+        for (auto &f : longer) {
+            f /= vl.size();
+        }
+    }
+
+    /** \brief Probability that an input byte passes mask \a i of a bucket
+     * holding k literals. A mask beyond the end of any of the bucket's
+     * literals passes everything. */
+    double passRate(u32 i, double k) const {
+        double q = coverage(lo, k) * coverage(hi, k);
+        return 1.0 - pow(longer[i], k) * (1.0 - q);
+    }
+
+private:
+    /* Chance that a nibble drawn from p is one of those of k literals. */
+    static double coverage(const array<double, 16> &p, double k) {
+        double r = 0;
+        for (double pv : p) {
+            r += pv * (1.0 - pow(1.0 - pv, k));
+        }
+        return r;
+    }
+
+    array<double, 16> lo;
+    array<double, 16> hi;
+
+    /** \brief Fraction of literals longer than i bytes. */
+    array<double, TEDDY_MAX_MASKS> longer;
+};
+
+} // namespace
+
+/**
+ * \brief Estimate the cost of scanning 64 bytes of input with this engine:
+ * the mask lookups of the scan itself, plus the confirms expected from
+ * first-stage false positives.
+ */
+static
+double teddyCost(const vector<hwlmLiteral> &vl,
+                 const TeddyEngineDescription &eng, const TeddyLitStats &stats,
+                 const size_t max_flood_tail) {
+    const u32 buckets = eng.getNumBuckets();
+    assert(eng.numMasks <= TEDDY_MAX_MASKS);
+
+    // Each vector covers vectorWidth / (buckets / 8) positions.
+    double blocks = 64.0 * (buckets / 8) / eng.vectorWidth;
+    double cost = blocks * (TEDDY_BLOCK_COST + eng.numMasks);
+
+    double k = max(1.0, (double)vl.size() / buckets);
+    double bucket_rate = 1.0;
+    for (u32 i = 0; i < eng.numMasks; i++) {
+        bucket_rate *= stats.passRate(i, k);
+    }
+    double hits = 64.0 * buckets * bucket_rate;
+
+    // Packed buckets need a hash table lookup and a comparison against each
+    // literal that shares it; unpacked ones can often skip the confirm.
+    double conf_cost = TEDDY_CONF_COST;
+    if (eng.packed) {
+        conf_cost *= 1.0 + k / 2;
+    } else if (!eng.needConfirm(vl)) {
+        conf_cost /= 4;
+    }
+    cost += hits * conf_cost;
+
+    if (eng.numMasks <= max_flood_tail) {
+        cost += TEDDY_FLOOD_COST;
+    }
+
+    return cost;
+}
+
 unique_ptr<TeddyEngineDescription>
 chooseTeddyEngine(const target_t &target, const vector<hwlmLiteral> &vl) {
     vector<TeddyEngineDescription> descs;
@@ -158,51 +312,37 @@ chooseTeddyEngine(const target_t &target, const vector<hwlmLiteral> &vl) {
     const TeddyEngineDescription *best = nullptr;
 
     const size_t max_lit_len = maxLen(vl);
+    size_t min_len_count;
+    const size_t min_lit_len = minLenCount(vl, &min_len_count);
     const size_t max_flood_tail = maxFloodTailLen(vl);
     DEBUG_PRINTF("%zu lits, max_lit_len=%zu, max_flood_tail=%zu\n", vl.size(),
                  max_lit_len, max_flood_tail);
 
-    u32 best_score = 0;
+    // Beyond the reach of the 16-bucket engines, FDR outperforms Teddy on sets
+    // of long literals, which suit its wider hash domains.
+    if (vl.size() > 16 * TEDDY_BUCKET_LOAD && min_lit_len > 6) {
+        DEBUG_PRINTF("leaving %zu long literals to FDR\n", vl.size());
+        return nullptr;
+    }
+
+    const TeddyLitStats stats(vl);
+    double best_cost = 0;
     for (size_t engineID = 0; engineID < descs.size(); engineID++) {
         const TeddyEngineDescription &eng = descs[engineID];
         if (!isAllowed(vl, eng, max_lit_len, target)) {
             continue;
         }
 
-        u32 score = 0;
-
-        // We prefer unpacked Teddy models.
-        if (!eng.packed) {
-            score += 100;
-        }
-
-        // If we're heavily loaded, we prefer to have more masks.
-        if (vl.size() > 4 * eng.getNumBuckets()) {
-            score += eng.numMasks * 4;
-        } else {
-            // Lightly loaded cases are great.
-            score += 100;
-        }
-
-        // We want enough masks to avoid becoming flood-prone.
-        if (eng.numMasks > max_flood_tail) {
-            score += 50;
-        }
-
-        // We prefer having 3 masks. 3 is just right.
-        score += 6 / (abs(3 - (int)eng.numMasks) + 1);
-
-        // We prefer cheaper, smaller Teddy models.
-        score += 16 / eng.getNumBuckets();
+        double cost = teddyCost(vl, eng, stats, max_flood_tail);
 
         DEBUG_PRINTF("teddy %u: masks=%u, buckets=%u, packed=%u "
-                     "-> score=%u\n",
+                     "-> cost=%f\n",
                      eng.getID(), eng.numMasks, eng.getNumBuckets(),
-                     eng.packed ? 1U : 0U, score);
+                     eng.packed ? 1U : 0U, cost);
 
-        if (!best || score > best_score) {
+        if (!best || cost < best_cost) {
             best = &eng;
-            best_score = score;
+            best_cost = cost;
         }
     }
 
@@ -53,6 +53,7 @@ class TeddyEngineDescription : public EngineDescription {
 public:
     u32 numMasks;
     bool packed;
+    u32 vectorWidth; //!< bytes per vector register used by the runtime
 
     explicit TeddyEngineDescription(const TeddyEngineDef &def);
 
@@ -38,7 +38,7 @@ struct Teddy {
     u32 maxStringLen;
     u32 floodOffset;
     u32 link;
-    u32 pad1;
+    u32 bucketGroupsOffset; //!< offset of the u64a groups of each bucket
     u32 pad2;
     u32 pad3;
 };
@@ -35,6 +35,7 @@
 
 #include "fdr_confirm.h"
 #include "fdr_confirm_runtime.h"
+#include "teddy_internal.h"
 #include "ue2common.h"
 #include "util/bitutils.h"
 #include "util/simd_utils.h"
@@ -172,12 +173,77 @@ u64a getConfVal(const struct FDR_Runtime_Args *a, const u8 *ptr, u32 byte,
     return confVal;
 }
 
+/**
+ * \brief Tracks which buckets have literals in groups that are switched on.
+ *
+ * A candidate in a bucket whose literals' groups are all off can never be
+ * confirmed, so such candidates are cleared from a whole conf word with one
+ * mask before any of them is looked up. The mask is recomputed whenever the
+ * groups change.
+ */
+struct teddy_live {
+    const u64a *bucketGroups; //!< groups of each bucket's literals
+    hwlm_group_t groups; //!< groups that mask was computed for
+    TEDDY_CONF_TYPE mask; //!< live bucket bits, repeated for each position
+};
+
+static really_inline
+void initTeddyLive(struct teddy_live *live, const struct Teddy *teddy) {
+    live->bucketGroups = (const u64a *)((const u8 *)teddy +
+                                        teddy->bucketGroupsOffset);
+    // No bucket is live with no groups on, so this is correct as it stands
+    // and is only computed once there is a candidate.
+    live->groups = 0;
+    live->mask = 0;
+}
+
+/** \brief Returns the mask of live buckets under \a control for conf words
+ * with \a bucket bits per position. */
+static really_inline
+TEDDY_CONF_TYPE getTeddyLiveMask(struct teddy_live *live, u8 bucket,
+                                 hwlm_group_t control) {
+    if (unlikely(control != live->groups)) {
+        TEDDY_CONF_TYPE mask = 0;
+        for (u32 b = 0; b < bucket; b++) {
+            if (live->bucketGroups[b] & control) {
+                mask |= (TEDDY_CONF_TYPE)1 << b;
+            }
+        }
+        for (u32 w = bucket; w < sizeof(TEDDY_CONF_TYPE) * 8; w *= 2) {
+            mask |= mask << w;
+        }
+        live->groups = control;
+        live->mask = mask;
+    }
+    return live->mask;
+}
+
+/**
+ * \brief Called after a candidate at \a bit may have reached the match
+ * callback: if the groups have changed, the candidates after it are taken
+ * from \a all, the unmasked conf word, and masked again, so that none are
+ * lost to a group that has just been switched on.
+ */
+static really_inline
+void refreshTeddyConf(TEDDY_CONF_TYPE *conf, TEDDY_CONF_TYPE all, u32 bit,
+                      u8 bucket, hwlm_group_t control,
+                      struct teddy_live *live) {
+    if (likely(control == live->groups)) {
+        return;
+    }
+    TEDDY_CONF_TYPE rest = all & ~(((TEDDY_CONF_TYPE)2 << bit) - 1);
+    *conf = rest & getTeddyLiveMask(live, bucket, control);
+}
+
 static really_inline
 void do_confWithBit_teddy(TEDDY_CONF_TYPE *conf, u8 bucket, u8 offset,
                           const u32 *confBase, CautionReason reason,
                           const struct FDR_Runtime_Args *a, const u8 *ptr,
-                          hwlmcb_rv_t *control, u32 *last_match) {
-    do  {
+                          hwlmcb_rv_t *control, u32 *last_match,
+                          struct teddy_live *live) {
+    const TEDDY_CONF_TYPE all = *conf;
+    *conf &= getTeddyLiveMask(live, bucket, *control);
+    while (*conf) {
         u32 bit = TEDDY_FIND_AND_CLEAR_LSB(conf);
         u32 byte = bit / bucket + offset;
         u32 bitRem  = bit % bucket;
@@ -194,16 +260,20 @@ void do_confWithBit_teddy(TEDDY_CONF_TYPE *conf, u8 bucket, u8 offset,
         }
         u64a confVal = getConfVal(a, ptr, byte, reason);
         confWithBit(fdrc, a, ptr - a->buf + byte, 0, control,
-                    last_match, confVal);
-    } while (unlikely(*conf));
+                    last_match, confVal, NULL);
+        refreshTeddyConf(conf, all, bit, bucket, *control, live);
+    }
 }
 
 static really_inline
 void do_confWithBit1_teddy(TEDDY_CONF_TYPE *conf, u8 bucket, u8 offset,
                            const u32 *confBase, CautionReason reason,
                            const struct FDR_Runtime_Args *a, const u8 *ptr,
-                           hwlmcb_rv_t *control, u32 *last_match) {
-    do {
+                           hwlmcb_rv_t *control, u32 *last_match,
+                           struct teddy_live *live) {
+    const TEDDY_CONF_TYPE all = *conf;
+    *conf &= getTeddyLiveMask(live, bucket, *control);
+    while (*conf) {
         u32 bit = TEDDY_FIND_AND_CLEAR_LSB(conf);
         u32 byte = bit / bucket + offset;
         u32 idx  = bit % bucket;
@@ -216,15 +286,19 @@ void do_confWithBit1_teddy(TEDDY_CONF_TYPE *conf, u8 bucket, u8 offset,
         u64a confVal = getConfVal(a, ptr, byte, reason);
         confWithBit1(fdrc, a, ptr - a->buf + byte, control, last_match,
                      confVal);
-    } while (unlikely(*conf));
+        refreshTeddyConf(conf, all, bit, bucket, *control, live);
+    }
 }
 
 static really_inline
 void do_confWithBitMany_teddy(TEDDY_CONF_TYPE *conf, u8 bucket, u8 offset,
                               const u32 *confBase, CautionReason reason,
                               const struct FDR_Runtime_Args *a, const u8 *ptr,
-                              hwlmcb_rv_t *control, u32 *last_match) {
-    do {
+                              hwlmcb_rv_t *control, u32 *last_match,
+                              struct teddy_live *live) {
+    const TEDDY_CONF_TYPE all = *conf;
+    *conf &= getTeddyLiveMask(live, bucket, *control);
+    while (*conf) {
         u32 bit = TEDDY_FIND_AND_CLEAR_LSB(conf);
         u32 byte = bit / bucket + offset;
         u32 idx = bit % bucket;
@@ -237,7 +311,8 @@ void do_confWithBitMany_teddy(TEDDY_CONF_TYPE *conf, u8 bucket, u8 offset,
         u64a confVal = getConfVal(a, ptr, byte, reason);
         confWithBitMany(fdrc, a, ptr - a->buf + byte, reason, control,
                         last_match, confVal);
-    } while (unlikely(*conf));
+        refreshTeddyConf(conf, all, bit, bucket, *control, live);
+    }
 }
 
 static really_inline
@@ -45,12 +45,16 @@ Grey::Grey(void) :
                    performGraphSimplification(true),
                    prefilterReductions(true),
                    removeEdgeRedundancy(true),
+                   shareIdenticalGraphs(true),
                    allowGough(true),
                    allowHaigLit(true),
                    allowLitHaig(true),
                    allowLbr(true),
                    allowMcClellan(true),
                    allowSheng(true),
+                   allowAnchoredSheng(true),
+                   allowMcSheng(true),
+                   allowDfaGroup(true),
                    allowPuff(true),
                    allowLiteral(true),
                    allowRose(true),
@@ -62,6 +66,9 @@ Grey::Grey(void) :
                    allowCastle(true),
                    allowDecoratedLiteral(true),
                    allowNoodle(true),
+                   multiNoodleMaxLiterals(2),
+                   hashLitMinLiterals(100000),
+                   sbLitMaxLiterals(64),
                    fdrAllowTeddy(true),
                    violetAvoidSuffixes(true),
                    violetAvoidWeakInfixes(true),
@@ -72,6 +79,7 @@ Grey::Grey(void) :
                    violetEarlyCleanLiteralLen(6),
                    puffImproveHead(true),
                    castleExclusive(true),
+                   castleShareRepeats(true),
                    mergeSEP(true), /* short exhaustible passthroughs */
                    mergeRose(true), // roses inside rose
                    mergeSuffixes(true), // suffix nfas inside rose
@@ -79,6 +87,9 @@ Grey::Grey(void) :
                    onlyOneOutfix(false),
                    allowShermanStates(true),
                    allowMcClellan8(true),
+                   mcclellanHotStateOrder(true),
+                   mcclellanStride2MaxSize(16384),
+                   mcclellanRowDispMinSize(32768),
                    highlanderPruneDFA(true),
                    minimizeDFA(true),
                    accelerateDFA(true),
@@ -91,6 +102,7 @@ Grey::Grey(void) :
                    allowZombies(true),
                    floodAsPuffette(false),
                    nfaForceSize(0),
+                   limexLazyDfaMinStates(65),
                    maxHistoryAvailable(DEFAULT_MAX_HISTORY),
                    minHistoryAvailable(0), /* debugging only */
                    maxAnchoredRegion(63), /* for rose's atable to run over */
@@ -100,6 +112,7 @@ Grey::Grey(void) :
                    minExtBoundedRepeatSize(32),
                    goughCopyPropagate(true),
                    goughRegisterAllocate(true),
+                   goughVectorPrograms(true),
                    shortcutLiterals(true),
                    roseGraphReduction(true),
                    roseRoleAliasing(true),
@@ -111,6 +124,7 @@ Grey::Grey(void) :
                    roseMultiTopRoses(true),
                    roseHamsterMasks(true),
                    roseLookaroundMasks(true),
+                   roseSubgroups(true),
                    roseMcClellanPrefix(1),
                    roseMcClellanSuffix(1),
                    roseMcClellanOutfix(2),
@@ -135,17 +149,30 @@ Grey::Grey(void) :
                                                 // all blocks larger than this
                                                 // are given to rose &co
                    smallWriteLargestBufferBad(35),
+                   smallWriteLargestBufferTiered(512), // medium writes, if the
+                                                       // DFA stays small and
+                                                       // fast
+                   smallWriteTieredMaxStates(1024),
                    limitSmallWriteOutfixSize(1048576), // 1 MB
                    smallWriteMaxPatterns(10000),
                    smallWriteMaxLiterals(10000),
                    allowTamarama(true), // Tamarama engine
                    tamaChunkSize(100),
+                   tamaAnalysisTimeLimit(0),
+                   partitionMaxLiterals(20000),
+                   partitionMaxConfirms(50000),
+                   confirmWindow(256),
+                   confirmMaxWindow(4096),
+                   prefilterMaxVertices(128),
+                   allowApproximateMatching(true),
+                   maxEditDistance(16),
                    dumpFlags(0),
                    limitPatternCount(8000000), // 8M patterns
                    limitPatternLength(16000),  // 16K bytes
                    limitGraphVertices(500000), // 500K vertices
                    limitGraphEdges(1000000), // 1M edges
                    limitReportCount(4*8000000),
+                   limitApproxMatchingVertices(5000),
                    limitLiteralCount(8000000), // 8M literals
                    limitLiteralLength(16000),
                    limitLiteralMatcherChars(1073741824), // 1 GB
@@ -211,12 +238,16 @@ void applyGreyOverrides(Grey *g, const string &s) {
         G_UPDATE(performGraphSimplification);
         G_UPDATE(prefilterReductions);
         G_UPDATE(removeEdgeRedundancy);
+        G_UPDATE(shareIdenticalGraphs);
         G_UPDATE(allowGough);
         G_UPDATE(allowHaigLit);
         G_UPDATE(allowLitHaig);
         G_UPDATE(allowLbr);
         G_UPDATE(allowMcClellan);
         G_UPDATE(allowSheng);
+        G_UPDATE(allowAnchoredSheng);
+        G_UPDATE(allowMcSheng);
+        G_UPDATE(allowDfaGroup);
         G_UPDATE(allowPuff);
         G_UPDATE(allowLiteral);
         G_UPDATE(allowRose);
@@ -228,6 +259,9 @@ void applyGreyOverrides(Grey *g, const string &s) {
         G_UPDATE(allowCastle);
         G_UPDATE(allowDecoratedLiteral);
         G_UPDATE(allowNoodle);
+        G_UPDATE(multiNoodleMaxLiterals);
+        G_UPDATE(hashLitMinLiterals);
+        G_UPDATE(sbLitMaxLiterals);
         G_UPDATE(fdrAllowTeddy);
         G_UPDATE(violetAvoidSuffixes);
         G_UPDATE(violetAvoidWeakInfixes);
@@ -238,6 +272,7 @@ void applyGreyOverrides(Grey *g, const string &s) {
         G_UPDATE(violetEarlyCleanLiteralLen);
         G_UPDATE(puffImproveHead);
         G_UPDATE(castleExclusive);
+        G_UPDATE(castleShareRepeats);
         G_UPDATE(mergeSEP);
         G_UPDATE(mergeRose);
         G_UPDATE(mergeSuffixes);
@@ -245,6 +280,9 @@ void applyGreyOverrides(Grey *g, const string &s) {
         G_UPDATE(onlyOneOutfix);
         G_UPDATE(allowShermanStates);
         G_UPDATE(allowMcClellan8);
+        G_UPDATE(mcclellanHotStateOrder);
+        G_UPDATE(mcclellanStride2MaxSize);
+        G_UPDATE(mcclellanRowDispMinSize);
         G_UPDATE(highlanderPruneDFA);
         G_UPDATE(minimizeDFA);
         G_UPDATE(accelerateDFA);
@@ -256,6 +294,7 @@ void applyGreyOverrides(Grey *g, const string &s) {
         G_UPDATE(allowZombies);
         G_UPDATE(floodAsPuffette);
         G_UPDATE(nfaForceSize);
+        G_UPDATE(limexLazyDfaMinStates);
         G_UPDATE(highlanderSquash);
         G_UPDATE(maxHistoryAvailable);
         G_UPDATE(minHistoryAvailable);
@@ -266,6 +305,7 @@ void applyGreyOverrides(Grey *g, const string &s) {
         G_UPDATE(minExtBoundedRepeatSize);
         G_UPDATE(goughCopyPropagate);
         G_UPDATE(goughRegisterAllocate);
+        G_UPDATE(goughVectorPrograms);
         G_UPDATE(shortcutLiterals);
         G_UPDATE(roseGraphReduction);
         G_UPDATE(roseRoleAliasing);
@@ -277,6 +317,7 @@ void applyGreyOverrides(Grey *g, const string &s) {
         G_UPDATE(roseMultiTopRoses);
         G_UPDATE(roseHamsterMasks);
         G_UPDATE(roseLookaroundMasks);
+        G_UPDATE(roseSubgroups);
         G_UPDATE(roseMcClellanPrefix);
         G_UPDATE(roseMcClellanSuffix);
         G_UPDATE(roseMcClellanOutfix);
@@ -296,16 +337,27 @@ void applyGreyOverrides(Grey *g, const string &s) {
         G_UPDATE(allowSmallWriteSheng);
         G_UPDATE(smallWriteLargestBuffer);
         G_UPDATE(smallWriteLargestBufferBad);
+        G_UPDATE(smallWriteLargestBufferTiered);
+        G_UPDATE(smallWriteTieredMaxStates);
         G_UPDATE(limitSmallWriteOutfixSize);
         G_UPDATE(smallWriteMaxPatterns);
         G_UPDATE(smallWriteMaxLiterals);
         G_UPDATE(allowTamarama);
         G_UPDATE(tamaChunkSize);
+        G_UPDATE(tamaAnalysisTimeLimit);
+        G_UPDATE(partitionMaxLiterals);
+        G_UPDATE(partitionMaxConfirms);
+        G_UPDATE(confirmWindow);
+        G_UPDATE(confirmMaxWindow);
+        G_UPDATE(prefilterMaxVertices);
+        G_UPDATE(allowApproximateMatching);
+        G_UPDATE(maxEditDistance);
         G_UPDATE(limitPatternCount);
         G_UPDATE(limitPatternLength);
         G_UPDATE(limitGraphVertices);
         G_UPDATE(limitGraphEdges);
         G_UPDATE(limitReportCount);
+        G_UPDATE(limitApproxMatchingVertices);
         G_UPDATE(limitLiteralCount);
         G_UPDATE(limitLiteralLength);
         G_UPDATE(limitLiteralMatcherChars);
@@ -44,6 +44,7 @@ struct Grey {
     bool performGraphSimplification;
     bool prefilterReductions;
     bool removeEdgeRedundancy;
+    bool shareIdenticalGraphs;
 
     bool allowGough;
     bool allowHaigLit;
@@ -51,6 +52,9 @@ struct Grey {
     bool allowLbr;
     bool allowMcClellan;
     bool allowSheng;
+    bool allowAnchoredSheng; //!< Sheng for small anchored literal DFAs
+    bool allowMcSheng;
+    bool allowDfaGroup;
     bool allowPuff;
     bool allowLiteral;
     bool allowRose;
@@ -63,6 +67,9 @@ struct Grey {
     bool allowDecoratedLiteral;
 
     bool allowNoodle;
+    u32  multiNoodleMaxLiterals; // 0 = off, else at most NOOD_MULTI_MAX_LITS
+    u32  hashLitMinLiterals; // 0 = off, else literal count to use hashlit
+    u32  sbLitMaxLiterals; // 0 = off, else most literals for small-block matcher
     bool fdrAllowTeddy;
 
     u32  violetAvoidSuffixes; /* 0=never, 1=sometimes, 2=always */
@@ -75,6 +82,7 @@ struct Grey {
 
     bool puffImproveHead;
     bool castleExclusive; // enable castle mutual exclusion analysis
+    bool castleShareRepeats; // group castle repeats with identical bounds
 
     bool mergeSEP;
     bool mergeRose;
@@ -84,6 +92,9 @@ struct Grey {
 
     bool allowShermanStates;
     bool allowMcClellan8;
+    bool mcclellanHotStateOrder; // number 16-bit DFA states by est. heat
+    u32 mcclellanStride2MaxSize; // max bytes of 8-bit two-byte stride table
+    u32 mcclellanRowDispMinSize; // 16-bit table size to try displaced rows
     bool highlanderPruneDFA;
     bool minimizeDFA;
 
@@ -100,6 +111,10 @@ struct Grey {
 
     u32 nfaForceSize;
 
+    /** \brief Minimum number of states for a LimEx NFA to use the lazy DFA
+     * cache in scratch at runtime; zero disables it. */
+    u32 limexLazyDfaMinStates;
+
     u32 maxHistoryAvailable;
     u32 minHistoryAvailable;
     u32 maxAnchoredRegion;
@@ -111,6 +126,7 @@ struct Grey {
 
     bool goughCopyPropagate;
     bool goughRegisterAllocate;
+    bool goughVectorPrograms; // fold programs of small engines for SIMD
 
     bool shortcutLiterals;
 
@@ -124,6 +140,7 @@ struct Grey {
     bool roseMultiTopRoses;
     bool roseHamsterMasks;
     bool roseLookaroundMasks;
+    bool roseSubgroups; //!< squash single literals within a literal group
     u32 roseMcClellanPrefix; /* 0 = off, 1 = only if large nfa, 2 = always */
     u32 roseMcClellanSuffix; /* 0 = off, 1 = only if very large nfa, 2 =
                               * always */
@@ -153,6 +170,8 @@ struct Grey {
     bool allowSmallWriteSheng;
     u32 smallWriteLargestBuffer;  // largest buffer that can be small write
     u32 smallWriteLargestBufferBad;// largest buffer that can be small write
+    u32 smallWriteLargestBufferTiered; // largest buffer for a fast, small DFA
+    u32 smallWriteTieredMaxStates; // max DFA states to use the tiered size
     u32 limitSmallWriteOutfixSize; //!< max total size of outfix DFAs
     u32 smallWriteMaxPatterns; // only try small writes if fewer patterns
     u32 smallWriteMaxLiterals; // only try small writes if fewer literals
@@ -160,6 +179,22 @@ struct Grey {
     // Tamarama engine
     bool allowTamarama;
     u32 tamaChunkSize; //!< max chunk size for exclusivity analysis in Tamarama
+    u32 tamaAnalysisTimeLimit; //!< ms for exclusivity analysis, 0: unlimited
+
+    // Partitioned compiles
+    u32 partitionMaxLiterals; //!< default max distinct literals per database
+    u32 partitionMaxConfirms; //!< default max literal confirms per database
+
+    // Confirm programs (HS_FLAG_CONFIRM)
+    u32 confirmWindow; //!< default longest match searched for by a confirm
+    u32 confirmMaxWindow; //!< largest confirm_window that may be requested
+
+    // Prefilter reductions
+    u32 prefilterMaxVertices; //!< default vertices kept by prefilter reduction
+
+    // Approximate matching (edit_distance, hamming_distance)
+    bool allowApproximateMatching;
+    u32 maxEditDistance; //!< largest distance that may be requested
 
     enum DumpFlags {
         DUMP_NONE       = 0,
@@ -184,6 +219,7 @@ struct Grey {
     u32 limitGraphVertices; //!< max number of states in built NFA graph
     u32 limitGraphEdges;    //!< max number of edges in build NFA graph
     u32 limitReportCount;   //!< max number of ReportIDs allocated internally
+    u32 limitApproxMatchingVertices; //!< max vertices in a fuzzed graph
 
     // HWLM literal matcher limits.
     u32 limitLiteralCount;        //!< max number of literals in an HWLM table
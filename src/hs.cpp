@@ -34,31 +34,108 @@
 #include "grey.h"
 #include "hs_compile.h"
 #include "hs_internal.h"
+#include "hs_runtime.h"
 #include "database.h"
+#include "backtrack/backtrack.h"
+#include "backtrack/backtrack_build.h"
 #include "compiler/compiler.h"
+#include "compiler/engine_cache.h"
 #include "compiler/error.h"
+#include "compiler/partition.h"
 #include "nfagraph/ng.h"
 #include "nfagraph/ng_expr_info.h"
 #include "nfagraph/ng_extparam.h"
 #include "parser/parse_error.h"
 #include "parser/Parser.h"
 #include "parser/prefilter.h"
+#include "util/byte_freq.h"
+#include "util/compile_budget.h"
 #include "util/compile_error.h"
+#include "util/compile_report.h"
 #include "util/cpuid_flags.h"
 #include "util/depth.h"
+#include "util/make_unique.h"
 #include "util/popcount.h"
+#include "util/stream_state_usage.h"
 #include "util/target_info.h"
+#include "util/verify_types.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstring>
 #include <limits.h>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace std;
 using namespace ue2;
 
+/** \brief Compile cache handle: just a wrapper for the EngineCache. */
+struct hs_compile_cache {
+    EngineCache engines;
+};
+
+/** \brief Number of threads requested with \ref hs_set_compile_threads; zero
+ * means one per hardware thread. */
+static atomic<unsigned> compile_threads(1);
+
+static
+unsigned getCompileThreads() {
+    unsigned threads = compile_threads.load(memory_order_relaxed);
+    if (!threads) {
+        threads = max(thread::hardware_concurrency(), 1U);
+    }
+    return threads;
+}
+
+/** \brief Byte frequencies set with \ref hs_set_compile_byte_frequencies or
+ * \ref hs_set_compile_byte_pair_frequencies, guarded by byte_freq_lock. */
+static shared_ptr<const ByteFrequencies> byte_freq;
+static mutex byte_freq_lock;
+
+static
+shared_ptr<const ByteFrequencies> getByteFrequencies() {
+    lock_guard<mutex> lock(byte_freq_lock);
+    return byte_freq;
+}
+
+/** \brief Compile time budget in milliseconds set with \ref
+ * hs_set_compile_time_budget; zero means no budget. */
+static atomic<unsigned> compile_budget_ms(0);
+
+/** \brief External ids of the patterns degraded by the last compile on this
+ * thread, returned by \ref hs_compile_degraded_patterns. */
+static thread_local vector<unsigned> last_degraded;
+
+/** \brief Whether compiles collect a report, set with \ref
+ * hs_set_compile_report. */
+static atomic<bool> compile_report_enabled(false);
+
+/** \brief Report of the last compile on this thread, returned by \ref
+ * hs_compile_report if \ref last_report_valid. */
+static thread_local hs_compile_stats_t last_report;
+static thread_local bool last_report_valid = false;
+
+/** \brief Stream state budget set with \ref hs_set_stream_state_budget;
+ * attribution is off unless state_budget_enabled. */
+static atomic<bool> state_budget_enabled(false);
+static atomic<unsigned> state_budget_pattern(0);
+static atomic<unsigned> state_budget_total(0);
+static atomic<unsigned> state_budget_flags(0);
+
+/** \brief Stream state attribution of the last compile on this thread,
+ * returned by \ref hs_compile_stream_state_usage if \ref
+ * last_state_usage_valid. */
+static thread_local vector<hs_stream_state_usage_t> last_state_usage;
+static thread_local bool last_state_usage_valid = false;
+
 /** \brief Cheap check that no unexpected mode flags are on. */
 static
 bool validModeFlags(unsigned int mode) {
@@ -67,7 +144,11 @@ bool validModeFlags(unsigned int mode) {
                                        | HS_MODE_VECTORED
                                        | HS_MODE_SOM_HORIZON_LARGE
                                        | HS_MODE_SOM_HORIZON_MEDIUM
-                                       | HS_MODE_SOM_HORIZON_SMALL;
+                                       | HS_MODE_SOM_HORIZON_SMALL
+                                       | HS_MODE_ANY_MATCH
+                                       | HS_MODE_UNORDERED
+                                       | HS_MODE_SOM_LAZY
+                                       | HS_MODE_COST_ATTRIBUTION;
 
     return !(mode & ~allModeFlags);
 }
@@ -82,14 +163,17 @@ bool checkMode(unsigned int mode, hs_compile_error **comp_error) {
         return false;
     }
 
-    // Our mode must be ONE of (block, streaming, vectored).
+    // Our mode must be ONE of (block, streaming, vectored), or block and
+    // streaming together for a multi-mode database.
     unsigned checkmode
         = mode & (HS_MODE_STREAM | HS_MODE_BLOCK | HS_MODE_VECTORED);
-    if (popcount32(checkmode) != 1) {
+    if (popcount32(checkmode) != 1 &&
+        checkmode != (HS_MODE_BLOCK | HS_MODE_STREAM)) {
         *comp_error = generateCompileError(
             "Invalid parameter: mode must have one "
             "(and only one) of HS_MODE_BLOCK, HS_MODE_STREAM or "
-            "HS_MODE_VECTORED set.",
+            "HS_MODE_VECTORED set, or both HS_MODE_BLOCK and "
+            "HS_MODE_STREAM.",
             -1);
         return false;
     }
@@ -112,6 +196,14 @@ bool checkMode(unsigned int mode, hs_compile_error **comp_error) {
                     "HS_MODE_SOM_HORIZON_ mode flag can be set.", -1);
             return false;
         }
+
+        // Start of match is never tracked in any-match mode.
+        if (mode & HS_MODE_ANY_MATCH) {
+            *comp_error = generateCompileError("Invalid parameter: the "
+                    "HS_MODE_SOM_HORIZON_ mode flags may not be combined with "
+                    "HS_MODE_ANY_MATCH.", -1);
+            return false;
+        }
     }
 
     return true;
@@ -120,7 +212,8 @@ bool checkMode(unsigned int mode, hs_compile_error **comp_error) {
 static
 bool checkPlatform(const hs_platform_info *p, hs_compile_error **comp_error) {
 #define HS_TUNE_LAST HS_TUNE_FAMILY_BDW
-#define HS_CPU_FEATURES_ALL (HS_CPU_FEATURES_AVX2)
+#define HS_CPU_FEATURES_ALL                                                    \
+    (HS_CPU_FEATURES_AVX2 | HS_CPU_FEATURES_AVX512 | HS_CPU_FEATURES_AVX512VBMI)
 
     if (!p) {
         return true;
@@ -161,86 +254,231 @@ unsigned getSomPrecision(unsigned mode) {
 
 namespace ue2 {
 
-hs_error_t
-hs_compile_multi_int(const char *const *expressions, const unsigned *flags,
-                     const unsigned *ids, const hs_expr_ext *const *ext,
-                     unsigned elements, unsigned mode,
-                     const hs_platform_info_t *platform, hs_database_t **db,
-                     hs_compile_error_t **comp_error, const Grey &g) {
+/**
+ * \brief Validate the arguments common to all of the compile calls.
+ *
+ * Returns false with \a comp_error (if available) and \a db set on failure.
+ */
+static
+bool checkCompileArgs(const void *expressions, unsigned elements,
+                      unsigned mode, const hs_platform_info_t *platform,
+                      hs_database_t **db, hs_compile_error_t **comp_error,
+                      const Grey &g) {
     // Check the args: note that it's OK for flags, ids or ext to be null.
     if (!comp_error) {
         if (db) {
             *db = nullptr;
         }
         // nowhere to write the string, but we can still report an error code
-        return HS_COMPILER_ERROR;
+        return false;
     }
     if (!db) {
         *comp_error = generateCompileError("Invalid parameter: db is NULL", -1);
-        return HS_COMPILER_ERROR;
+        return false;
     }
     if (!expressions) {
         *db = nullptr;
         *comp_error
             = generateCompileError("Invalid parameter: expressions is NULL",
                                    -1);
-        return HS_COMPILER_ERROR;
+        return false;
     }
     if (elements == 0) {
         *db = nullptr;
         *comp_error = generateCompileError("Invalid parameter: elements is zero", -1);
-        return HS_COMPILER_ERROR;
+        return false;
     }
 
     if (!checkMode(mode, comp_error)) {
         *db = nullptr;
         assert(*comp_error); // set by checkMode.
-        return HS_COMPILER_ERROR;
+        return false;
     }
 
     if (!checkPlatform(platform, comp_error)) {
         *db = nullptr;
         assert(*comp_error); // set by checkPlatform.
-        return HS_COMPILER_ERROR;
+        return false;
     }
 
     if (elements > g.limitPatternCount) {
         *db = nullptr;
         *comp_error = generateCompileError("Number of patterns too large", -1);
-        return HS_COMPILER_ERROR;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Checks \a usage against the stream state budget, returning an error
+ * message naming what is over it, or an empty string if all is well.
+ */
+static
+string overStateBudget(const StreamStateUsage &usage) {
+    const unsigned pattern_limit =
+        state_budget_pattern.load(memory_order_relaxed);
+    const unsigned total_limit = state_budget_total.load(memory_order_relaxed);
+
+    if (pattern_limit) {
+        vector<hs_stream_state_usage_t> rows;
+        usage.fill(rows);
+        // Rows are in decreasing order of total, so only the first matters.
+        if (!rows.empty() && rows.front().total_bytes > pattern_limit) {
+            return "Pattern " + to_string(rows.front().id) + " needs " +
+                   to_string(rows.front().total_bytes) +
+                   " bytes of stream state, over the budget of " +
+                   to_string(pattern_limit) + ".";
+        }
+    }
+
+    if (total_limit && usage.total_bytes > total_limit) {
+        return "Database needs " + to_string(usage.total_bytes) +
+               " bytes of stream state, over the budget of " +
+               to_string(total_limit) + ".";
     }
 
+    return string();
+}
+
+/** \brief Returns a copy of \a g that builds DFAs rather than NFAs wherever
+ * it can, for \ref HS_STATE_BUDGET_RESTRUCTURE. */
+static
+Grey restructureGrey(const Grey &g) {
+    Grey out(g);
+    out.roseMcClellanPrefix = 2;
+    out.roseMcClellanSuffix = 2;
+    out.roseMcClellanOutfix = 2;
+    return out;
+}
+
+/**
+ * \brief Set up the compiler, call \a addFn to feed it patterns and build the
+ * database, translating any exceptions into compile errors.
+ */
+template<typename AddFn>
+static
+hs_error_t buildDatabase(unsigned elements, unsigned mode,
+                         const hs_platform_info_t *platform,
+                         hs_database_t **db, hs_compile_error_t **comp_error,
+                         const Grey &g, hs_compile_cache_t *cache,
+                         AddFn addFn, bool restructured = false) {
     // This function is simply a wrapper around both the parser and compiler
-    bool isStreaming = mode & (HS_MODE_STREAM | HS_MODE_VECTORED);
+    bool isMultiMode = (mode & HS_MODE_BLOCK) && (mode & HS_MODE_STREAM);
+    bool isStreaming = !isMultiMode &&
+                       (mode & (HS_MODE_STREAM | HS_MODE_VECTORED));
     bool isVectored = mode & HS_MODE_VECTORED;
-    unsigned somPrecision = getSomPrecision(mode);
+    unsigned somPrecision = isMultiMode ? 0 : getSomPrecision(mode);
 
     target_t target_info = platform ? target_t(*platform)
                                     : get_current_target();
 
     CompileContext cc(isStreaming, isVectored, target_info, g);
+    if (cache) {
+        cc.engine_cache = &cache->engines;
+    }
+    cc.any_match = mode & HS_MODE_ANY_MATCH;
+    cc.unordered_matches = mode & HS_MODE_UNORDERED;
+    cc.lazy_som = mode & HS_MODE_SOM_LAZY;
+    cc.cost_attribution = mode & HS_MODE_COST_ATTRIBUTION;
+    cc.byte_freq = getByteFrequencies();
+    cc.threads = getCompileThreads();
+
+    last_degraded.clear();
+    unique_ptr<CompileBudget> budget;
+    if (unsigned budget_ms = compile_budget_ms.load(memory_order_relaxed)) {
+        budget = ue2::make_unique<CompileBudget>(
+            chrono::milliseconds(budget_ms));
+        cc.budget = budget.get();
+    }
+
+    last_report_valid = false;
+    unique_ptr<CompileReport> report;
+    if (compile_report_enabled.load(memory_order_relaxed)) {
+        report = ue2::make_unique<CompileReport>();
+        cc.report = report.get();
+    }
+
+    // The report is kept whether or not the compile succeeds.
+    auto saveReport = [&report]() {
+        if (report) {
+            report->fill(last_report);
+            last_report_valid = true;
+        }
+    };
+
+    last_state_usage_valid = false;
+    unique_ptr<StreamStateUsage> state_usage;
+    if ((isStreaming || isMultiMode) &&
+        state_budget_enabled.load(memory_order_relaxed)) {
+        state_usage = ue2::make_unique<StreamStateUsage>();
+        cc.state_usage = state_usage.get();
+    }
+
+    // Like the report, the attribution is kept even if the compile fails.
+    auto saveStateUsage = [&state_usage]() {
+        if (state_usage) {
+            state_usage->fill(last_state_usage);
+            last_state_usage_valid = true;
+        }
+    };
+
     NG ng(cc, elements, somPrecision);
 
     try {
-        for (unsigned int i = 0; i < elements; i++) {
-            // Add this expression to the compiler
-            try {
-                addExpression(ng, i, expressions[i], flags ? flags[i] : 0,
-                              ext ? ext[i] : nullptr, ids ? ids[i] : 0);
-            } catch (CompileError &e) {
-                /* Caught a parse error:
-                 * throw it upstream as a CompileError with a specific index */
-                e.setExpressionIndex(i);
-                throw; /* do not slice */
-            }
-        }
+        addFn(ng);
 
         unsigned length = 0;
-        struct hs_database *out = build(ng, &length);
+        struct hs_database *out;
+        if (isMultiMode) {
+            // The block engine comes first; the streaming engine is compiled
+            // from the same patterns with its own context.
+            CompileContext stream_cc(true, false, target_info, g);
+            stream_cc.engine_cache = cc.engine_cache;
+            stream_cc.any_match = cc.any_match;
+            stream_cc.unordered_matches = cc.unordered_matches;
+            stream_cc.lazy_som = cc.lazy_som;
+            stream_cc.cost_attribution = cc.cost_attribution;
+            stream_cc.byte_freq = cc.byte_freq;
+            stream_cc.budget = cc.budget;
+            stream_cc.report = cc.report;
+            stream_cc.state_usage = cc.state_usage;
+            stream_cc.threads = cc.threads;
+            NG stream_ng(stream_cc, elements, getSomPrecision(mode));
+            addFn(stream_ng);
+            out = buildMultiMode(ng, stream_ng, &length);
+        } else {
+            out = build(ng, &length);
+        }
 
         assert(out);    // should have thrown exception on error
         assert(length);
 
+        if (state_usage) {
+            size_t stream_size = 0;
+            hs_stream_size(out, &stream_size);
+            state_usage->total_bytes = verify_u32(stream_size);
+            string over = overStateBudget(*state_usage);
+            if (!over.empty()) {
+                hs_free_database(out);
+                if (!restructured && (state_budget_flags.load(
+                                          memory_order_relaxed) &
+                                      HS_STATE_BUDGET_RESTRUCTURE)) {
+                    DEBUG_PRINTF("%s, restructuring\n", over.c_str());
+                    return buildDatabase(elements, mode, platform, db,
+                                         comp_error, restructureGrey(g),
+                                         cache, addFn, true);
+                }
+                throw CompileError(over);
+            }
+        }
+
+        if (budget) {
+            last_degraded = budget->degradedIds();
+        }
+        saveReport();
+        saveStateUsage();
+
         *db = out;
         *comp_error = nullptr;
 
@@ -248,24 +486,82 @@ hs_compile_multi_int(const char *const *expressions, const unsigned *flags,
     }
     catch (const CompileError &e) {
         // Compiler error occurred
+        saveReport();
+        saveStateUsage();
         *db = nullptr;
         *comp_error = generateCompileError(e.reason,
                                            e.hasIndex ? (int)e.index : -1);
         return HS_COMPILER_ERROR;
     }
     catch (std::bad_alloc) {
+        saveReport();
+        saveStateUsage();
         *db = nullptr;
         *comp_error = const_cast<hs_compile_error_t *>(&hs_enomem);
         return HS_COMPILER_ERROR;
     }
     catch (...) {
         assert(!"Internal error, unexpected exception");
+        saveReport();
+        saveStateUsage();
         *db = nullptr;
         *comp_error = const_cast<hs_compile_error_t *>(&hs_einternal);
         return HS_COMPILER_ERROR;
     }
 }
 
+hs_error_t
+hs_compile_multi_int(const char *const *expressions, const unsigned *flags,
+                     const unsigned *ids, const hs_expr_ext *const *ext,
+                     unsigned elements, unsigned mode,
+                     const hs_platform_info_t *platform, hs_database_t **db,
+                     hs_compile_error_t **comp_error, const Grey &g,
+                     hs_compile_cache_t *cache) {
+    if (!checkCompileArgs(expressions, elements, mode, platform, db,
+                          comp_error, g)) {
+        return HS_COMPILER_ERROR;
+    }
+
+    return buildDatabase(elements, mode, platform, db, comp_error, g, cache,
+                         [&](NG &ng) {
+                             addExpressions(ng, elements, expressions, flags,
+                                            ext, ids, getCompileThreads());
+                         });
+}
+
+hs_error_t
+hs_compile_lit_multi_int(const char *const *expressions, const unsigned *flags,
+                         const unsigned *ids, const size_t *lens,
+                         unsigned elements, unsigned mode,
+                         const hs_platform_info_t *platform,
+                         hs_database_t **db, hs_compile_error_t **comp_error,
+                         const Grey &g) {
+    if (!checkCompileArgs(expressions, elements, mode, platform, db,
+                          comp_error, g)) {
+        return HS_COMPILER_ERROR;
+    }
+    if (!lens) {
+        *db = nullptr;
+        *comp_error = generateCompileError("Invalid parameter: lens is NULL",
+                                           -1);
+        return HS_COMPILER_ERROR;
+    }
+    for (unsigned i = 0; i < elements; i++) {
+        if (!expressions[i]) {
+            *db = nullptr;
+            *comp_error = generateCompileError("Invalid parameter: literal is "
+                                               "NULL", (int)i);
+            return HS_COMPILER_ERROR;
+        }
+    }
+
+    return buildDatabase(elements, mode, platform, db, comp_error, g, nullptr,
+                         [&](NG &ng) {
+                             addLitExpressions(ng, elements, expressions, lens,
+                                               flags, ids);
+                         });
+}
+
 } // namespace ue2
 
 extern "C" HS_PUBLIC_API
@@ -309,6 +605,138 @@ hs_error_t hs_compile_ext_multi(const char * const *expressions,
                                 platform, db, error, Grey());
 }
 
+extern "C" HS_PUBLIC_API
+hs_error_t hs_compile_ext_multi_cached(const char * const *expressions,
+                                       const unsigned *flags,
+                                       const unsigned *ids,
+                                       const hs_expr_ext * const *ext,
+                                       unsigned elements, unsigned mode,
+                                       const hs_platform_info_t *platform,
+                                       hs_compile_cache_t *cache,
+                                       hs_database_t **db,
+                                       hs_compile_error_t **error) {
+    if (!cache) {
+        if (db) {
+            *db = nullptr;
+        }
+        if (error) {
+            *error = generateCompileError("Invalid parameter: cache is NULL",
+                                          -1);
+        }
+        return HS_COMPILER_ERROR;
+    }
+    return hs_compile_multi_int(expressions, flags, ids, ext, elements, mode,
+                                platform, db, error, Grey(), cache);
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_compile_lit(const char *expression, unsigned flags, size_t len,
+                          unsigned mode, const hs_platform_info_t *platform,
+                          hs_database_t **db, hs_compile_error_t **error) {
+    if (expression == nullptr) {
+        *db = nullptr;
+        *error = generateCompileError("Invalid parameter: expression is NULL",
+                                      -1);
+        return HS_COMPILER_ERROR;
+    }
+
+    unsigned id = 0; // single expressions get zero as an ID
+
+    return hs_compile_lit_multi_int(&expression, &flags, &id, &len, 1, mode,
+                                    platform, db, error, Grey());
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_compile_lit_multi(const char * const *expressions,
+                                const unsigned *flags, const unsigned *ids,
+                                const size_t *lens, unsigned elements,
+                                unsigned mode,
+                                const hs_platform_info_t *platform,
+                                hs_database_t **db,
+                                hs_compile_error_t **error) {
+    return hs_compile_lit_multi_int(expressions, flags, ids, lens, elements,
+                                    mode, platform, db, error, Grey());
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_alloc_compile_cache(hs_compile_cache_t **cache) {
+    if (!cache) {
+        return HS_INVALID;
+    }
+    *cache = new (nothrow) hs_compile_cache;
+    return *cache ? HS_SUCCESS : HS_NOMEM;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_compile_cache_info(const hs_compile_cache_t *cache,
+                                 size_t *engines, size_t *size) {
+    if (!cache) {
+        return HS_INVALID;
+    }
+    if (engines) {
+        *engines = cache->engines.size();
+    }
+    if (size) {
+        *size = cache->engines.bytes();
+    }
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_free_compile_cache(hs_compile_cache_t *cache) {
+    delete cache;
+    return HS_SUCCESS;
+}
+
+/** \brief Compile context for the expression info calls. */
+static
+CompileContext infoCompileContext(unsigned int mode) {
+    bool isStreaming = mode & (HS_MODE_STREAM | HS_MODE_VECTORED);
+    bool isVectored = mode & HS_MODE_VECTORED;
+    return CompileContext(isStreaming, isVectored, get_current_target(),
+                          Grey());
+}
+
+/**
+ * \brief Parses an expression and builds its graph for the expression info
+ * calls, filling in \a info. Throws CompileError on failure.
+ */
+static
+unique_ptr<NGWrapper> buildInfoGraph(const char *expression, unsigned int flags,
+                                     const hs_expr_ext_t *ext,
+                                     ReportManager &rm,
+                                     const CompileContext &cc,
+                                     hs_expr_info *info) {
+    // Ensure that our pattern isn't too long (in characters).
+    if (strlen(expression) > cc.grey.limitPatternLength) {
+        throw ParseError("Pattern length exceeds limit.");
+    }
+
+    if (flags & HS_FLAG_COMBINATION) {
+        throw CompileError("Expression information is not available "
+                           "for logical combinations.");
+    }
+
+    ParsedExpression pe(0, expression, flags, 0, ext);
+    assert(pe.component);
+
+    // Apply prefiltering transformations if desired.
+    if (pe.prefilter) {
+        prefilterTree(pe.component, ParseMode(flags));
+    }
+
+    unique_ptr<NGWrapper> g = buildWrapper(rm, cc, pe);
+
+    if (!g) {
+        DEBUG_PRINTF("NFA build failed, but no exception was thrown.\n");
+        throw ParseError("Internal error.");
+    }
+
+    handleExtendedParams(rm, *g, cc);
+    fillExpressionInfo(rm, *g, info);
+    return g;
+}
+
 static
 hs_error_t hs_expression_info_int(const char *expression, unsigned int flags,
                                   const hs_expr_ext_t *ext, unsigned int mode,
@@ -337,35 +765,9 @@ hs_error_t hs_expression_info_int(const char *expression, unsigned int flags,
     memset(&local_info, 0, sizeof(local_info));
 
     try {
-        bool isStreaming = mode & (HS_MODE_STREAM | HS_MODE_VECTORED);
-        bool isVectored = mode & HS_MODE_VECTORED;
-
-        CompileContext cc(isStreaming, isVectored, get_current_target(),
-                          Grey());
-
-        // Ensure that our pattern isn't too long (in characters).
-        if (strlen(expression) > cc.grey.limitPatternLength) {
-            throw ParseError("Pattern length exceeds limit.");
-        }
-
+        CompileContext cc = infoCompileContext(mode);
         ReportManager rm(cc.grey);
-        ParsedExpression pe(0, expression, flags, 0, ext);
-        assert(pe.component);
-
-        // Apply prefiltering transformations if desired.
-        if (pe.prefilter) {
-            prefilterTree(pe.component, ParseMode(flags));
-        }
-
-        unique_ptr<NGWrapper> g = buildWrapper(rm, cc, pe);
-
-        if (!g) {
-            DEBUG_PRINTF("NFA build failed, but no exception was thrown.\n");
-            throw ParseError("Internal error.");
-        }
-
-        handleExtendedParams(rm, *g, cc);
-        fillExpressionInfo(rm, *g, &local_info);
+        buildInfoGraph(expression, flags, ext, rm, cc, &local_info);
     }
     catch (const CompileError &e) {
         // Compiler error occurred
@@ -410,6 +812,511 @@ hs_error_t hs_expression_ext_info(const char *expression, unsigned int flags,
                                   error);
 }
 
+extern "C" HS_PUBLIC_API
+hs_error_t hs_expression_cost_info(const char *expression, unsigned int flags,
+                                   const hs_expr_ext_t *ext, unsigned int mode,
+                                   hs_expr_cost_info_t **info,
+                                   hs_compile_error_t **error) {
+    if (!error) {
+        // nowhere to write an error, but we can still return an error code.
+        return HS_COMPILER_ERROR;
+    }
+
+    if (!info) {
+        *error = generateCompileError("Invalid parameter: info is NULL", -1);
+        return HS_COMPILER_ERROR;
+    }
+
+    if (!expression) {
+        *error = generateCompileError("Invalid parameter: expression is NULL",
+                                      -1);
+        return HS_COMPILER_ERROR;
+    }
+
+    *info = nullptr;
+    *error = nullptr;
+
+    if (!checkMode(mode, error)) {
+        return HS_COMPILER_ERROR;
+    }
+
+    ExpressionCostInfo cost;
+
+    try {
+        CompileContext cc = infoCompileContext(mode);
+        ReportManager rm(cc.grey);
+        hs_expr_info expr_info;
+        auto g = buildInfoGraph(expression, flags, ext, rm, cc, &expr_info);
+        fillExpressionCostInfo(rm, cc, *g, &cost);
+    }
+    catch (const CompileError &e) {
+        // Compiler error occurred
+        *error = generateCompileError(e);
+        return HS_COMPILER_ERROR;
+    }
+    catch (std::bad_alloc) {
+        *error = const_cast<hs_compile_error_t *>(&hs_enomem);
+        return HS_COMPILER_ERROR;
+    }
+    catch (...) {
+        assert(!"Internal error, unexpected exception");
+        *error = const_cast<hs_compile_error_t *>(&hs_einternal);
+        return HS_COMPILER_ERROR;
+    }
+
+    // The structure, literal lengths and literal bytes share one allocation,
+    // so that the caller can free it in one go.
+    size_t lit_bytes = 0;
+    for (const auto &lit : cost.literals) {
+        lit_bytes += lit.size();
+    }
+    size_t lengths_offset = ROUNDUP_N(sizeof(hs_expr_cost_info),
+                                      alignof(unsigned int));
+    size_t lits_offset =
+        lengths_offset + cost.literals.size() * sizeof(unsigned int);
+    size_t alloc_size = lits_offset + lit_bytes;
+
+    char *buf = (char *)hs_misc_alloc(alloc_size);
+    if (!buf) {
+        *error = const_cast<hs_compile_error_t *>(&hs_enomem);
+        return HS_COMPILER_ERROR;
+    }
+
+    hs_expr_cost_info *rv = (hs_expr_cost_info *)buf;
+    unsigned int *lengths = (unsigned int *)(buf + lengths_offset);
+    char *lits = buf + lits_offset;
+
+    rv->engines = cost.engines;
+    rv->nfa_states = cost.nfa_states;
+    rv->dfa_states = cost.dfa_states;
+    rv->stream_state_size = cost.stream_state_size;
+    rv->cost_class = cost.cost_class;
+    rv->literal_count = verify_u32(cost.literals.size());
+    rv->literal_lengths = lengths;
+    rv->literals = lits;
+
+    for (const auto &lit : cost.literals) {
+        *lengths++ = verify_u32(lit.size());
+        memcpy(lits, lit.data(), lit.size());
+        lits += lit.size();
+    }
+
+    *info = rv;
+    return HS_SUCCESS;
+}
+
+/**
+ * \brief Estimate the cost of each pattern for partitioning. Returns false
+ * with \a comp_error set if a pattern cannot be analysed.
+ */
+static
+bool partitionCosts(const char *const *expressions, const unsigned *flags,
+                    const hs_expr_ext *const *ext, unsigned elements,
+                    unsigned mode, vector<ExpressionCostInfo> &costs,
+                    hs_compile_error_t **comp_error) {
+    costs.resize(elements);
+    for (unsigned i = 0; i < elements; i++) {
+        if (!expressions[i]) {
+            *comp_error = generateCompileError("Invalid parameter: expression "
+                                               "is NULL", (int)i);
+            return false;
+        }
+        try {
+            CompileContext cc = infoCompileContext(mode);
+            ReportManager rm(cc.grey);
+            hs_expr_info expr_info;
+            auto g = buildInfoGraph(expressions[i], flags ? flags[i] : 0,
+                                    ext ? ext[i] : nullptr, rm, cc,
+                                    &expr_info);
+            fillExpressionCostInfo(rm, cc, *g, &costs[i]);
+        }
+        catch (const CompileError &e) {
+            *comp_error = generateCompileError(e.reason, (int)i);
+            return false;
+        }
+        catch (std::bad_alloc) {
+            *comp_error = const_cast<hs_compile_error_t *>(&hs_enomem);
+            return false;
+        }
+        catch (...) {
+            assert(!"Internal error, unexpected exception");
+            *comp_error = const_cast<hs_compile_error_t *>(&hs_einternal);
+            return false;
+        }
+    }
+    return true;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_compile_ext_multi_partitioned(const char * const *expressions,
+                                            const unsigned *flags,
+                                            const unsigned *ids,
+                                            const hs_expr_ext * const *ext,
+                                            unsigned elements, unsigned mode,
+                                            const hs_platform_info_t *platform,
+                                            const hs_partition_limits_t *limits,
+                                            unsigned max_databases,
+                                            hs_database_t **dbs,
+                                            unsigned *db_count,
+                                            hs_compile_error_t **error) {
+    if (db_count) {
+        *db_count = 0;
+    }
+    const Grey g;
+    if (!checkCompileArgs(expressions, elements, mode, platform, dbs, error,
+                          g)) {
+        return HS_COMPILER_ERROR;
+    }
+    if (!max_databases || !db_count) {
+        *dbs = nullptr;
+        *error = generateCompileError(!db_count
+                                      ? "Invalid parameter: db_count is NULL"
+                                      : "Invalid parameter: max_databases is "
+                                        "zero", -1);
+        return HS_COMPILER_ERROR;
+    }
+
+    PartitionLimits pl;
+    pl.max_parts = max_databases;
+    pl.max_literals = limits && limits->max_literals ? limits->max_literals
+                                                     : g.partitionMaxLiterals;
+    pl.max_confirms = limits && limits->max_confirms ? limits->max_confirms
+                                                     : g.partitionMaxConfirms;
+
+    // Logical combinations must be compiled with the patterns they refer to,
+    // so a set containing them is not divided.
+    bool combination = false;
+    for (unsigned i = 0; flags && i < elements; i++) {
+        combination |= (flags[i] & HS_FLAG_COMBINATION) != 0;
+    }
+
+    vector<vector<u32>> parts;
+    try {
+        if (combination || max_databases == 1) {
+            parts.emplace_back(elements);
+            for (unsigned i = 0; i < elements; i++) {
+                parts[0][i] = i;
+            }
+        } else {
+            vector<ExpressionCostInfo> costs;
+            if (!partitionCosts(expressions, flags, ext, elements, mode, costs,
+                                error)) {
+                *dbs = nullptr;
+                return HS_COMPILER_ERROR;
+            }
+            parts = partitionPatterns(costs, pl);
+        }
+    }
+    catch (std::bad_alloc) {
+        *dbs = nullptr;
+        *error = const_cast<hs_compile_error_t *>(&hs_enomem);
+        return HS_COMPILER_ERROR;
+    }
+    assert(!parts.empty() && parts.size() <= max_databases);
+
+    auto fail = [&]() {
+        for (unsigned p = 0; p < *db_count; p++) {
+            hs_free_database(dbs[p]);
+        }
+        *db_count = 0;
+        *dbs = nullptr;
+        return HS_COMPILER_ERROR;
+    };
+
+    vector<const char *> part_exprs;
+    vector<unsigned> part_flags;
+    vector<unsigned> part_ids;
+    vector<const hs_expr_ext *> part_ext;
+    for (size_t p = 0; p < parts.size(); p++) {
+        const auto &part = parts[p];
+        try {
+            part_exprs.clear();
+            part_flags.clear();
+            part_ids.clear();
+            part_ext.clear();
+            for (u32 i : part) {
+                part_exprs.push_back(expressions[i]);
+                part_flags.push_back(flags ? flags[i] : 0);
+                part_ids.push_back(ids ? ids[i] : 0);
+                part_ext.push_back(ext ? ext[i] : nullptr);
+            }
+        }
+        catch (std::bad_alloc) {
+            *error = const_cast<hs_compile_error_t *>(&hs_enomem);
+            return fail();
+        }
+
+        DEBUG_PRINTF("compiling database %zu with %zu patterns\n", p,
+                     part.size());
+        if (hs_compile_multi_int(part_exprs.data(), part_flags.data(),
+                                 part_ids.data(), part_ext.data(),
+                                 verify_u32(part.size()), mode, platform,
+                                 &dbs[p], error, g) != HS_SUCCESS) {
+            // Report the failing pattern by its index in the caller's array.
+            if (*error && (*error)->expression >= 0) {
+                (*error)->expression = (int)part[(*error)->expression];
+            }
+            return fail();
+        }
+        *db_count = verify_u32(p + 1);
+    }
+
+    *error = nullptr;
+    return HS_SUCCESS;
+}
+
+namespace {
+
+/** \brief A prefiltered pattern being considered for tuning. */
+struct TuneCandidate {
+    u32 index = 0; //!< index in the caller's expressions array
+    vector<u32> prog; //!< runtime confirm program, stored as u32s for alignment
+    u64a false_positives = 0;
+    u32 states = 0; //!< prefilter_states granted, zero for the default
+};
+
+struct TuneScanContext {
+    const vector<TuneCandidate *> *cands; //!< indexed by match id
+    const u8 *corpus;
+    size_t len;
+    vector<u64a> *fps;
+};
+
+} // namespace
+
+static
+int tuneMatch(unsigned id, unsigned long long, unsigned long long to,
+              unsigned, void *context) {
+    auto *ctx = static_cast<TuneScanContext *>(context);
+    const TuneCandidate &cand = *(*ctx->cands)[id];
+    const auto *prog =
+        reinterpret_cast<const BacktrackProgram *>(cand.prog.data());
+    if (!btConfirm(prog, nullptr, 0, ctx->corpus, ctx->len, 0, to)) {
+        (*ctx->fps)[id]++;
+    }
+    return 0;
+}
+
+/**
+ * \brief Compiles the prefiltering versions of \a cands as a block mode
+ * database for the host, scans the corpus with it and counts the false
+ * positives of each candidate in \a fps.
+ */
+static
+hs_error_t countFalsePositives(const char *const *expressions,
+                               const unsigned *flags,
+                               const hs_expr_ext *const *ext,
+                               const vector<TuneCandidate *> &cands,
+                               const char *corpus, unsigned corpus_len,
+                               vector<u64a> &fps, const Grey &g) {
+    vector<const char *> exprs;
+    vector<unsigned> pflags;
+    vector<unsigned> pids;
+    vector<hs_expr_ext> exts(cands.size());
+    vector<const hs_expr_ext *> pext;
+    for (size_t i = 0; i < cands.size(); i++) {
+        const TuneCandidate &c = *cands[i];
+        unsigned f = flags[c.index];
+        f &= ~(HS_FLAG_CONFIRM | HS_FLAG_SINGLEMATCH | HS_FLAG_QUIET);
+        exprs.push_back(expressions[c.index]);
+        pflags.push_back(f | HS_FLAG_PREFILTER);
+        pids.push_back(verify_u32(i));
+        hs_expr_ext &e = exts[i];
+        memset(&e, 0, sizeof(e));
+        if (ext && ext[c.index]) {
+            e = *ext[c.index];
+        }
+        // Every match is wanted, not just the first few.
+        e.flags &= ~HS_EXT_FLAG_MAX_MATCHES;
+        if (c.states) {
+            e.flags |= HS_EXT_FLAG_PREFILTER_STATES;
+            e.prefilter_states = c.states;
+        }
+        pext.push_back(&e);
+    }
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *error = nullptr;
+    if (hs_compile_multi_int(exprs.data(), pflags.data(), pids.data(),
+                             pext.data(), verify_u32(cands.size()),
+                             HS_MODE_BLOCK, nullptr, &db, &error, g)
+        != HS_SUCCESS) {
+        hs_free_compile_error(error);
+        return HS_COMPILER_ERROR;
+    }
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    if (err == HS_SUCCESS) {
+        fps.assign(cands.size(), 0);
+        TuneScanContext ctx{&cands, (const u8 *)corpus, corpus_len, &fps};
+        err = hs_scan(db, corpus, corpus_len, 0, scratch, tuneMatch, &ctx);
+        hs_free_scratch(scratch);
+    }
+    hs_free_database(db);
+    return err;
+}
+
+/**
+ * \brief Grants larger prefilter_states values to the candidates with the
+ * most false positives, within \a max_extra_states in total.
+ */
+static
+void tunePrefilters(const char *const *expressions, const unsigned *flags,
+                    const hs_expr_ext *const *ext,
+                    vector<TuneCandidate> &cands, const char *corpus,
+                    unsigned corpus_len, u32 max_extra_states,
+                    const Grey &g) {
+    // Each step doubles a pattern's budget; two steps reach the largest
+    // LimEx NFA from the default.
+    static const u32 MAX_TUNE_STEPS = 2;
+
+    vector<TuneCandidate *> all;
+    for (auto &c : cands) {
+        all.push_back(&c);
+    }
+    vector<u64a> fps;
+    if (countFalsePositives(expressions, flags, ext, all, corpus, corpus_len,
+                            fps, g) != HS_SUCCESS) {
+        // The final compile will report any problem with the patterns.
+        return;
+    }
+    for (size_t i = 0; i < cands.size(); i++) {
+        cands[i].false_positives = fps[i];
+    }
+
+    stable_sort(all.begin(), all.end(),
+                [](const TuneCandidate *a, const TuneCandidate *b) {
+                    return a->false_positives > b->false_positives;
+                });
+
+    u32 remaining = max_extra_states;
+    for (TuneCandidate *c : all) {
+        if (!c->false_positives) {
+            break;
+        }
+        u32 current = g.prefilterMaxVertices;
+        for (u32 step = 0; step < MAX_TUNE_STEPS; step++) {
+            u32 next = current * 2;
+            if (next - current > remaining) {
+                break;
+            }
+            u32 prev_states = c->states;
+            c->states = next;
+            if (countFalsePositives(expressions, flags, ext, {c}, corpus,
+                                    corpus_len, fps, g) != HS_SUCCESS
+                || fps[0] >= c->false_positives) {
+                c->states = prev_states;
+                break;
+            }
+            DEBUG_PRINTF("pattern %u: %u states, %llu -> %llu fps\n",
+                         c->index, next, c->false_positives, fps[0]);
+            c->false_positives = fps[0];
+            remaining -= next - current;
+            current = next;
+        }
+    }
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_compile_ext_multi_tuned(const char * const *expressions,
+                                      const unsigned *flags,
+                                      const unsigned *ids,
+                                      const hs_expr_ext * const *ext,
+                                      unsigned elements, unsigned mode,
+                                      const hs_platform_info_t *platform,
+                                      const char *corpus, unsigned corpus_len,
+                                      unsigned max_extra_states,
+                                      hs_database_t **db,
+                                      hs_compile_error_t **error) {
+    const Grey g;
+    if (!checkCompileArgs(expressions, elements, mode, platform, db, error,
+                          g)) {
+        return HS_COMPILER_ERROR;
+    }
+    if (!corpus && corpus_len) {
+        *db = nullptr;
+        *error = generateCompileError("Invalid parameter: corpus is NULL", -1);
+        return HS_COMPILER_ERROR;
+    }
+
+    if (!flags || !corpus_len || !max_extra_states) {
+        return hs_compile_multi_int(expressions, flags, ids, ext, elements,
+                                    mode, platform, db, error, g);
+    }
+
+    vector<TuneCandidate> cands;
+    vector<hs_expr_ext> tuned_ext;
+    vector<const hs_expr_ext *> final_ext;
+    try {
+        for (unsigned i = 0; i < elements; i++) {
+            if (!expressions[i]
+                || !(flags[i] & (HS_FLAG_PREFILTER | HS_FLAG_CONFIRM))
+                || (flags[i] & HS_FLAG_COMBINATION)
+                || (ext && ext[i]
+                    && (ext[i]->flags & HS_EXT_FLAG_PREFILTER_STATES))) {
+                continue;
+            }
+            ParsedExpression pe(i, expressions[i], flags[i], 0,
+                                ext ? ext[i] : nullptr);
+            shared_ptr<const ConfirmProgram> prog;
+            try {
+                prog = buildConfirmProgram(*pe.component, g.confirmMaxWindow);
+            }
+            catch (const CompileError &) {
+                // Too large to check, so its false positives can't be
+                // counted.
+                continue;
+            }
+            TuneCandidate c;
+            c.index = i;
+            c.prog.resize(ROUNDUP_N(confirmProgramSize(*prog), sizeof(u32))
+                          / sizeof(u32));
+            writeConfirmProgram(*prog, (u8 *)c.prog.data());
+            cands.push_back(move(c));
+        }
+
+        if (!cands.empty()) {
+            tunePrefilters(expressions, flags, ext, cands, corpus, corpus_len,
+                           max_extra_states, g);
+        }
+
+        tuned_ext.resize(cands.size());
+        final_ext.resize(elements);
+        for (unsigned i = 0; i < elements; i++) {
+            final_ext[i] = ext ? ext[i] : nullptr;
+        }
+        for (size_t i = 0; i < cands.size(); i++) {
+            const TuneCandidate &c = cands[i];
+            if (!c.states) {
+                continue;
+            }
+            hs_expr_ext &e = tuned_ext[i];
+            memset(&e, 0, sizeof(e));
+            if (final_ext[c.index]) {
+                e = *final_ext[c.index];
+            }
+            e.flags |= HS_EXT_FLAG_PREFILTER_STATES;
+            e.prefilter_states = c.states;
+            final_ext[c.index] = &e;
+        }
+    }
+    catch (const CompileError &e) {
+        *db = nullptr;
+        *error = generateCompileError(e.reason,
+                                      e.hasIndex ? (int)e.index : -1);
+        return HS_COMPILER_ERROR;
+    }
+    catch (std::bad_alloc) {
+        *db = nullptr;
+        *error = const_cast<hs_compile_error_t *>(&hs_enomem);
+        return HS_COMPILER_ERROR;
+    }
+
+    return hs_compile_multi_int(expressions, flags, ids, final_ext.data(),
+                                elements, mode, platform, db, error, g);
+}
+
 extern "C" HS_PUBLIC_API
 hs_error_t hs_populate_platform(hs_platform_info_t *platform) {
     if (!platform) {
@@ -424,6 +1331,124 @@ hs_error_t hs_populate_platform(hs_platform_info_t *platform) {
     return HS_SUCCESS;
 }
 
+extern "C" HS_PUBLIC_API
+hs_error_t hs_set_compile_threads(unsigned int num_threads) {
+    compile_threads.store(num_threads, memory_order_relaxed);
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_set_compile_byte_frequencies(const unsigned long long *counts) {
+    shared_ptr<const ByteFrequencies> freq;
+    if (counts) {
+        if (all_of(counts, counts + 256,
+                   [](unsigned long long c) { return c == 0; })) {
+            return HS_INVALID;
+        }
+        try {
+            freq = make_shared<const ByteFrequencies>(counts);
+        } catch (const bad_alloc &) {
+            return HS_NOMEM;
+        }
+    }
+
+    lock_guard<mutex> lock(byte_freq_lock);
+    byte_freq = move(freq);
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_set_compile_byte_pair_frequencies(
+        const unsigned long long *counts) {
+    shared_ptr<const ByteFrequencies> freq;
+    if (counts) {
+        if (all_of(counts, counts + 256 * 256,
+                   [](unsigned long long c) { return c == 0; })) {
+            return HS_INVALID;
+        }
+        try {
+            freq = make_shared<const ByteFrequencies>(
+                ByteFrequencies::fromPairCounts(counts));
+        } catch (const bad_alloc &) {
+            return HS_NOMEM;
+        }
+    }
+
+    lock_guard<mutex> lock(byte_freq_lock);
+    byte_freq = move(freq);
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_set_compile_time_budget(unsigned int milliseconds) {
+    compile_budget_ms.store(milliseconds, memory_order_relaxed);
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_compile_degraded_patterns(const unsigned int **ids,
+                                        unsigned int *count) {
+    if (!ids || !count) {
+        return HS_INVALID;
+    }
+
+    *ids = last_degraded.empty() ? nullptr : last_degraded.data();
+    *count = verify_u32(last_degraded.size());
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_set_compile_report(int enable) {
+    compile_report_enabled.store(enable != 0, memory_order_relaxed);
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_compile_report(const hs_compile_stats_t **report) {
+    if (!report) {
+        return HS_INVALID;
+    }
+
+    *report = last_report_valid ? &last_report : nullptr;
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_set_stream_state_budget(const hs_stream_state_budget_t *budget) {
+    if (budget && (budget->flags & ~HS_STATE_BUDGET_RESTRUCTURE)) {
+        return HS_INVALID;
+    }
+
+    if (!budget) {
+        state_budget_enabled.store(false, memory_order_relaxed);
+        return HS_SUCCESS;
+    }
+
+    state_budget_pattern.store(budget->pattern_bytes, memory_order_relaxed);
+    state_budget_total.store(budget->total_bytes, memory_order_relaxed);
+    state_budget_flags.store(budget->flags, memory_order_relaxed);
+    state_budget_enabled.store(true, memory_order_relaxed);
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_compile_stream_state_usage(const hs_stream_state_usage_t **usage,
+                                         unsigned int *count) {
+    if (!usage || !count) {
+        return HS_INVALID;
+    }
+
+    if (!last_state_usage_valid) {
+        *usage = nullptr;
+        *count = 0;
+        return HS_SUCCESS;
+    }
+
+    *usage = last_state_usage.empty() ? nullptr : last_state_usage.data();
+    *count = verify_u32(last_state_usage.size());
+    return HS_SUCCESS;
+}
+
 extern "C" HS_PUBLIC_API
 hs_error_t hs_free_compile_error(hs_compile_error_t *error) {
     freeCompileError(error);
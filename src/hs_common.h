@@ -58,6 +58,15 @@ struct hs_database;
  */
 typedef struct hs_database hs_database_t;
 
+struct hs_engine_store;
+
+/**
+ * An engine store, in which databases share their identical engines.
+ *
+ * Allocated by @ref hs_alloc_engine_store().
+ */
+typedef struct hs_engine_store hs_engine_store_t;
+
 /**
  * A type for errors returned by Hyperscan functions.
  */
@@ -163,6 +172,376 @@ hs_error_t hs_deserialize_database(const char *bytes, const size_t length,
 hs_error_t hs_deserialize_database_at(const char *bytes, const size_t length,
                                       hs_database_t *db);
 
+/**
+ * Serialize a pattern database to a compressed stream of bytes.
+ *
+ * This behaves as @ref hs_serialize_database(), but the database's bytecode
+ * is compressed, which can greatly reduce the size of large databases for
+ * storage or transmission. The output is accepted by @ref
+ * hs_deserialize_database(), @ref hs_deserialize_database_at(), @ref
+ * hs_serialized_database_size() and @ref hs_serialized_database_info(),
+ * which decompress the bytecode directly into the deserialized database.
+ *
+ * @param db
+ *      A compiled pattern database.
+ *
+ * @param bytes
+ *      On success, a pointer to an array of bytes will be returned here.
+ *      These bytes can be subsequently relocated or written to disk. The
+ *      caller is responsible for freeing this block. This memory is allocated
+ *      using the allocator supplied in @ref hs_set_misc_allocator() (or
+ *      malloc() if no allocator was set), and may be somewhat larger than the
+ *      returned length.
+ *
+ * @param length
+ *      On success, the number of bytes in the generated byte array will be
+ *      returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the byte array cannot be
+ *      allocated, other values may be returned if errors are detected.
+ */
+hs_error_t hs_serialize_database_compressed(const hs_database_t *db,
+                                            char **bytes, size_t *length);
+
+/**
+ * Produce a patch which transforms one pattern database into another.
+ *
+ * This is intended for distributing rule updates: rather than shipping a
+ * complete serialized database, a patch describing the new database in terms
+ * of a database already held by the recipient is sent, and applied with @ref
+ * hs_apply_database_delta(). Parts of the bytecode that are unchanged between
+ * the two databases, such as the engines for patterns that have not changed,
+ * are not included in the patch.
+ *
+ * Both databases must have been compiled by the same version of Hyperscan.
+ *
+ * @param old_db
+ *      The database that the patch will be applied to.
+ *
+ * @param new_db
+ *      The database that applying the patch will produce.
+ *
+ * @param bytes
+ *      On success, a pointer to an array of bytes will be returned here. The
+ *      caller is responsible for freeing this block. This memory is allocated
+ *      using the allocator supplied in @ref hs_set_misc_allocator() (or
+ *      malloc() if no allocator was set).
+ *
+ * @param length
+ *      On success, the number of bytes in the generated patch will be
+ *      returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the byte array cannot be
+ *      allocated, other values may be returned if errors are detected.
+ */
+hs_error_t hs_serialize_database_delta(const hs_database_t *old_db,
+                                       const hs_database_t *new_db,
+                                       char **bytes, size_t *length);
+
+/**
+ * Apply a patch generated by @ref hs_serialize_database_delta() to a
+ * database, producing a new database.
+ *
+ * The patch is checked against @a old_db, which is not modified, and the
+ * database produced is checked for validity (including its version, platform
+ * and checksum) as @ref hs_deserialize_database() would.
+ *
+ * @param old_db
+ *      The database that the patch was generated against.
+ *
+ * @param bytes
+ *      The patch generated by @ref hs_serialize_database_delta().
+ *
+ * @param length
+ *      The length of the patch.
+ *
+ * @param new_db
+ *      On success, a pointer to the new database will be returned here. This
+ *      database can then be used for scanning, and eventually freed by the
+ *      caller using @ref hs_free_database(). This memory is allocated using
+ *      the allocator supplied in @ref hs_set_database_allocator() (or
+ *      malloc() if no allocator was set).
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_INVALID if the patch was not
+ *      generated against @a old_db or is corrupt, other values on failure.
+ */
+hs_error_t hs_apply_database_delta(const hs_database_t *old_db,
+                                   const char *bytes, size_t length,
+                                   hs_database_t **new_db);
+
+/**
+ * Serialize several builds of one pattern database, each compiled for a
+ * different target platform, into a single multi-target serialized database.
+ *
+ * This is intended for deployments across machines with different CPU
+ * features: each database is compiled from the same patterns and in the same
+ * mode, with a different @ref hs_platform_info_t, and the result is shipped to
+ * every machine. @ref hs_deserialize_database(), @ref
+ * hs_deserialize_database_at(), @ref hs_serialized_database_size() and @ref
+ * hs_serialized_database_info() accept it, and load the variant that makes
+ * the most use of the features of the host CPU. They return @ref
+ * HS_DB_PLATFORM_ERROR if no variant can be used on the host.
+ *
+ * The first database is stored in full and the others as deltas against it
+ * (see @ref hs_serialize_database_delta()), so the parts of the bytecode that
+ * do not depend on the target are only stored once.
+ *
+ * @param dbs
+ *      The databases to serialize, each for a different target platform.
+ *
+ * @param count
+ *      The number of databases in @a dbs, at least one.
+ *
+ * @param bytes
+ *      On success, a pointer to an array of bytes will be returned here. The
+ *      caller is responsible for freeing this block. This memory is allocated
+ *      using the allocator supplied in @ref hs_set_misc_allocator() (or
+ *      malloc() if no allocator was set).
+ *
+ * @param length
+ *      On success, the number of bytes in the generated byte array will be
+ *      returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_INVALID if the databases are not
+ *      for distinct platforms or do not share a mode, other values on failure.
+ */
+hs_error_t hs_serialize_database_multi_target(const hs_database_t *const *dbs,
+                                              unsigned int count,
+                                              char **bytes, size_t *length);
+
+/**
+ * Serialize a pattern database to a position-independent image which can be
+ * used directly, without copying, by @ref hs_map_database().
+ *
+ * This is intended for applications that store a database in a file and map
+ * it read-only into the address spaces of many processes, which can then
+ * share a single physical copy of the database.
+ *
+ * Unlike the output of @ref hs_serialize_database(), the image is only valid
+ * on platforms with the same structure layout as the one that produced it.
+ *
+ * @param db
+ *      A compiled pattern database.
+ *
+ * @param bytes
+ *      On success, a pointer to an array of bytes will be returned here.
+ *      These bytes can be written to a file and later mapped into memory for
+ *      use with @ref hs_map_database(). This memory is allocated using the
+ *      allocator supplied in @ref hs_set_misc_allocator() (or malloc() if no
+ *      allocator was set) and should be freed by the caller.
+ *
+ * @param length
+ *      On success, the number of bytes in the generated image will be
+ *      returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the byte array cannot be
+ *      allocated, other values may be returned if errors are detected.
+ */
+hs_error_t hs_serialize_database_image(const hs_database_t *db, char **bytes,
+                                       size_t *length);
+
+/**
+ * Use a database image generated by @ref hs_serialize_database_image() in
+ * place, without copying it.
+ *
+ * The image is checked for validity (including its version, platform and
+ * checksum) but is never written to, so it may be in read-only memory, such
+ * as a read-only shared mapping of a file. The image must remain mapped for
+ * as long as the database is in use, and the @ref hs_free_database() call
+ * must not be used on the returned database.
+ *
+ * @param bytes
+ *      Pointer to the image, which must be aligned to a 64-byte boundary. A
+ *      memory mapping at the start of a file is always suitably aligned.
+ *
+ * @param length
+ *      The length of the image, as returned by @ref
+ *      hs_serialize_database_image().
+ *
+ * @param db
+ *      On success, a pointer to a database which can be used for scanning is
+ *      returned here. This pointer refers to the image itself.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_BAD_ALIGN if the image is not
+ *      correctly aligned, other values on failure.
+ */
+hs_error_t hs_map_database(const char *bytes, size_t length,
+                           const hs_database_t **db);
+
+/**
+ * Make a private copy of a compiled pattern database.
+ *
+ * The copy is allocated with the allocator set by @ref
+ * hs_set_database_allocator() (or @ref hs_set_allocator()) and is written
+ * entirely by the calling thread. On systems with a first-touch memory
+ * placement policy, such as Linux, calling this function from a thread bound
+ * to a particular NUMA node therefore places the copy in that node's local
+ * memory. Giving each node's worker threads their own copy of the database
+ * avoids remote memory accesses during scanning.
+ *
+ * The copy is independent of the original, which may be freed (or unmapped)
+ * while the copy remains in use. The copy must be freed with @ref
+ * hs_free_database().
+ *
+ * @param src
+ *      The database to copy. This may be a database returned by @ref
+ *      hs_map_database().
+ *
+ * @param dest
+ *      On success, a pointer to the new database is returned here; NULL on
+ *      failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the allocation fails,
+ *      other values on failure.
+ */
+hs_error_t hs_clone_database(const hs_database_t *src, hs_database_t **dest);
+
+/**
+ * Allocate an engine store: an arena into which many serialized databases can
+ * be loaded, and in which identical engines (automata and literal matchers)
+ * are held once and shared by every database that uses them.
+ *
+ * Databases built from overlapping pattern sets, such as those of many
+ * tenants built from a common rule base, contain many identical engines.
+ * Loading them into one store saves the memory of every copy but the first,
+ * and lets the databases share those engines' cachelines while scanning.
+ *
+ * The arena is allocated at once with the allocator set by @ref
+ * hs_set_database_allocator() (or @ref hs_set_allocator()); the store's
+ * bookkeeping uses the misc allocator.
+ *
+ * @param size
+ *      The size of the arena in bytes, which must be less than 4GB.
+ *
+ * @param store
+ *      On success, a pointer to the new store is returned here; NULL on
+ *      failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the arena cannot be
+ *      allocated, other values on failure.
+ */
+hs_error_t hs_alloc_engine_store(size_t size, hs_engine_store_t **store);
+
+/**
+ * Free an engine store allocated by @ref hs_alloc_engine_store(), along with
+ * every database loaded into it.
+ *
+ * @param store
+ *      The store to free. May be NULL, in which case this function does
+ *      nothing.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_free_engine_store(hs_engine_store_t *store);
+
+/**
+ * Deserialize a pattern database into an engine store.
+ *
+ * The database is deserialized as by @ref hs_deserialize_database_at(), into
+ * the store's arena. Each of its engines is then compared with those already
+ * in the store: an identical engine is shared, and any other is moved into
+ * the store so that databases loaded later can share it. The database's own
+ * copies of its engines are returned to the arena.
+ *
+ * The returned database can be used for scanning like any other, and
+ * scanning may continue while other databases are loaded into or unloaded
+ * from the store. However, the database refers to engines outside itself:
+ * it cannot be serialized, cloned or freed with @ref hs_free_database(), all
+ * of which return @ref HS_INVALID. It must be unloaded with @ref
+ * hs_engine_store_unload().
+ *
+ * The functions that modify a store are not thread-safe: calls to them must
+ * not be made concurrently on the same store.
+ *
+ * @param store
+ *      An engine store allocated by @ref hs_alloc_engine_store().
+ *
+ * @param bytes
+ *      A serialized database, as generated by @ref hs_serialize_database().
+ *
+ * @param length
+ *      The length of the serialized database.
+ *
+ * @param db
+ *      On success, a pointer to the database is returned here; NULL on
+ *      failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if there is not enough free
+ *      space in the store, other values on failure.
+ */
+hs_error_t hs_engine_store_load(hs_engine_store_t *store, const char *bytes,
+                                size_t length, hs_database_t **db);
+
+/**
+ * Unload a database from an engine store, returning its memory, and that of
+ * any engines no other database in the store uses, to the store.
+ *
+ * No scans or streams may be in progress against the database, and scratch
+ * spaces allocated for it may not be used with it again.
+ *
+ * @param store
+ *      The store the database was loaded into.
+ *
+ * @param db
+ *      A database returned by @ref hs_engine_store_load() for this store.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_INVALID if the database is not in
+ *      the store, other values on failure.
+ */
+hs_error_t hs_engine_store_unload(hs_engine_store_t *store, hs_database_t *db);
+
+/**
+ * Statistics for an engine store, as returned by @ref hs_engine_store_stats().
+ */
+typedef struct hs_engine_store_info {
+    /** The number of databases loaded into the store. */
+    size_t databases;
+
+    /** The number of distinct engines held by the store. */
+    size_t engines;
+
+    /** The number of uses of those engines by the loaded databases. */
+    size_t references;
+
+    /** The bytecode size of the engines held by the store. */
+    size_t engine_bytes;
+
+    /**
+     * The bytecode size of the engine copies that sharing has saved: every
+     * use of an engine beyond the first.
+     */
+    size_t saved_bytes;
+
+    /** The free space in the store's arena, in bytes. */
+    size_t free_bytes;
+} hs_engine_store_info_t;
+
+/**
+ * Report how much an engine store holds and how much sharing has saved.
+ *
+ * @param store
+ *      An engine store allocated by @ref hs_alloc_engine_store().
+ *
+ * @param stats
+ *      On success, the store's statistics are written here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_engine_store_stats(const hs_engine_store_t *store,
+                                 hs_engine_store_info_t *stats);
+
 /**
  * Provides the size of the stream state allocated by a single stream opened
  * against the given database.
@@ -195,6 +574,182 @@ hs_error_t hs_stream_size(const hs_database_t *database, size_t *stream_size);
 hs_error_t hs_database_size(const hs_database_t *database,
                             size_t *database_size);
 
+/**
+ * @defgroup HS_DB_ENGINE Engine classes
+ *
+ * Indices into the per-engine arrays of @ref hs_db_memory_t.
+ *
+ * @{
+ */
+
+/** LimEx NFAs of every width. */
+#define HS_DB_ENGINE_LIMEX          0
+
+/** McClellan DFAs. */
+#define HS_DB_ENGINE_MCCLELLAN      1
+
+/** Gough DFAs, used for start of match tracking. */
+#define HS_DB_ENGINE_GOUGH          2
+
+/** Sheng DFAs. */
+#define HS_DB_ENGINE_SHENG          3
+
+/** McClellan DFAs with a Sheng head. */
+#define HS_DB_ENGINE_MCSHENG        4
+
+/** Castles of bounded repeats. */
+#define HS_DB_ENGINE_CASTLE         5
+
+/** LBR (single bounded repeat) engines. */
+#define HS_DB_ENGINE_LBR            6
+
+/** The MPV engine, which drives a set of chained bounded repeats. */
+#define HS_DB_ENGINE_MPV            7
+
+/** Tamarama containers, including the engines they contain. */
+#define HS_DB_ENGINE_TAMARAMA       8
+
+/** DFA groups, including the DFAs they contain. */
+#define HS_DB_ENGINE_DFA_GROUP      9
+
+/** The number of engine classes. */
+#define HS_DB_ENGINE_COUNT          10
+
+/** @} */
+
+/**
+ * @defgroup HS_DB_MATCHER Literal matchers
+ *
+ * Indices into the per-matcher arrays of @ref hs_db_memory_t.
+ *
+ * @{
+ */
+
+/** The anchored literal matcher, run over the start of the data. */
+#define HS_DB_MATCHER_ANCHORED      0
+
+/** The floating literal matcher, run over all of the data. */
+#define HS_DB_MATCHER_FLOATING      1
+
+/** The EOD-anchored literal matcher, run over the end of the data. */
+#define HS_DB_MATCHER_EOD           2
+
+/** The literal matcher used in place of the others for small blocks. */
+#define HS_DB_MATCHER_SMALL_BLOCK   3
+
+/** The number of literal matchers. */
+#define HS_DB_MATCHER_COUNT         4
+
+/** @} */
+
+/**
+ * A breakdown of the memory used by a database, as returned by @ref
+ * hs_database_memory().
+ *
+ * Sizes are in bytes. The bytecode sizes do not add up to @p total, which
+ * also includes headers, alignment padding and a number of smaller tables.
+ * For a database compiled for more than one mode, the bytecode sizes cover
+ * the engines for all modes.
+ *
+ * The stream state sizes give the contribution of each component to the
+ * state of a single stream, as reported by @ref hs_stream_size(). They are
+ * zero for a database that does not support streaming mode.
+ */
+typedef struct hs_db_memory {
+    /** The size of the database, as reported by @ref hs_database_size(). */
+    size_t total;
+
+    /** The size of the state of one stream. */
+    size_t stream_state;
+
+    /** The number of engines of each class; see @ref HS_DB_ENGINE. */
+    size_t engine_count[HS_DB_ENGINE_COUNT];
+
+    /** The bytecode size of the engines of each class. */
+    size_t engine_bytes[HS_DB_ENGINE_COUNT];
+
+    /** The stream state used by the engines of each class. */
+    size_t engine_state[HS_DB_ENGINE_COUNT];
+
+    /**
+     * The bytecode size of each literal matcher; see @ref HS_DB_MATCHER. The
+     * anchored matcher's size includes its DFAs.
+     */
+    size_t matcher_bytes[HS_DB_MATCHER_COUNT];
+
+    /** The stream state used by each literal matcher. */
+    size_t matcher_state[HS_DB_MATCHER_COUNT];
+
+    /** The size of the Rose programs run when literals and engines match. */
+    size_t program_bytes;
+
+    /** The size of the lookaround tables used by those programs. */
+    size_t lookaround_bytes;
+
+    /** The size of the small write engine, including its DFA. */
+    size_t small_write_bytes;
+
+    /** The stream state used by Rose itself: role and group state, history
+     * and match bookkeeping. */
+    size_t rose_state;
+} hs_db_memory_t;
+
+/**
+ * Provides a breakdown of the memory used by the given database, by engine
+ * type and by literal matcher, for budgeting memory use and finding the parts
+ * of a large database that account for its size.
+ *
+ * @param database
+ *      Pointer to a compiled pattern database.
+ *
+ * @param memory
+ *      On success, the breakdown is written here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_database_memory(const hs_database_t *database,
+                              hs_db_memory_t *memory);
+
+/**
+ * Makes a database resident and cache-warm before it is used for scanning.
+ *
+ * A database that has just been deserialized, mapped with @ref
+ * hs_map_database() or copied may have pages that have not yet been faulted
+ * in, and none of it will be in the processor caches. This function reads
+ * every page of the database, and prefetches the tables that are consulted on
+ * every scan (the literal matchers, the small-write engine and the engines
+ * for each automaton), so that these costs are paid before traffic is
+ * switched to the database rather than by the first scans against it.
+ *
+ * The prefetched lines are only warm in the caches of the calling core and
+ * the caches it shares; the page faults benefit every thread.
+ *
+ * @param database
+ *      Pointer to a compiled pattern database.
+ *
+ * @param flags
+ *      Zero, or @ref HS_WARM_LOCK to also lock the database's pages into
+ *      memory.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if @ref HS_WARM_LOCK was
+ *      given and the pages could not be locked (for example, because of the
+ *      process's locked memory limit), other values on failure.
+ */
+hs_error_t hs_database_warm(const hs_database_t *database, unsigned int flags);
+
+/**
+ * Flag for @ref hs_database_warm(): lock the database's pages into memory
+ * with `mlock()`, so that they cannot be paged out.
+ *
+ * The lock is not released by @ref hs_free_database(). An application that
+ * frees a database it has locked should first call `munlock()` on the
+ * database pointer and the size reported by @ref hs_database_size(). This
+ * flag is not supported on Windows.
+ */
+#define HS_WARM_LOCK            1
+
 /**
  * Utility function for reporting the size that would be required by a
  * database if it were deserialized.
@@ -286,6 +841,33 @@ typedef void *(*hs_alloc_t)(size_t size);
  */
 typedef void (*hs_free_t)(void *ptr);
 
+/**
+ * An allocator context, which may be given to @ref hs_alloc_scratch_ex() and
+ * @ref hs_open_stream_ex() in place of the process-wide allocators set by
+ * @ref hs_set_scratch_allocator() and @ref hs_set_stream_allocator().
+ *
+ * The allocator is recorded in each scratch space or stream allocated with it
+ * and is used for every later allocation and free of that object, so that
+ * (for example) scratch spaces and streams belonging to different worker
+ * pools can come from per-thread arenas or per-NUMA-node heaps. The structure
+ * is not copied: it must remain valid until every object allocated with it
+ * has been freed.
+ */
+typedef struct hs_allocator {
+    /**
+     * Allocates @a size bytes, returning NULL on failure. The memory must be
+     * suitably aligned for the largest representable data type on this
+     * platform.
+     */
+    void *(*alloc)(size_t size, void *context);
+
+    /** Frees a region of memory previously returned by @a alloc. */
+    void (*free)(void *ptr, void *context);
+
+    /** Passed unchanged to every call of @a alloc and @a free. */
+    void *context;
+} hs_allocator_t;
+
 /**
  * Set the allocate and free functions used by Hyperscan for allocating
  * memory at runtime for stream state, scratch space, database bytecode,
@@ -425,6 +1007,40 @@ hs_error_t hs_set_scratch_allocator(hs_alloc_t alloc_func, hs_free_t free_func);
  */
 hs_error_t hs_set_stream_allocator(hs_alloc_t alloc_func, hs_free_t free_func);
 
+/**
+ * A built-in allocation function that backs large allocations with huge
+ * pages, for use with @ref hs_set_database_allocator(), @ref
+ * hs_set_scratch_allocator() or @ref hs_set_stream_allocator().
+ *
+ * Large databases spread their tables over many pages, so random accesses to
+ * them during a scan can miss in the TLB. Allocations of at least half a
+ * huge page are mapped from the explicit huge page pool (1GB pages for
+ * allocations of 1GB or more, where the system provides them, and otherwise
+ * the default huge page size). If no pool pages are available they fall back
+ * to a huge page aligned mapping advised for transparent huge pages. Smaller
+ * allocations, and all allocations on platforms without huge page support,
+ * use the system malloc().
+ *
+ * Memory returned by this function must only be freed with @ref
+ * hs_huge_page_free(), so the two must always be set as a pair.
+ *
+ * @param size
+ *      The number of bytes to allocate.
+ *
+ * @return
+ *      A pointer to the region of memory allocated, or NULL on error.
+ */
+void *hs_huge_page_alloc(size_t size);
+
+/**
+ * The free function that matches @ref hs_huge_page_alloc().
+ *
+ * @param ptr
+ *      The region of memory to be freed. NULL may also be safely provided, in
+ *      which case the function does nothing.
+ */
+void hs_huge_page_free(void *ptr);
+
 /**
  * Utility function for identifying this release version.
  *
@@ -435,6 +1051,23 @@ hs_error_t hs_set_stream_allocator(hs_alloc_t alloc_func, hs_free_t free_func);
  */
 const char *hs_version(void);
 
+/**
+ * Utility function to test the current system architecture.
+ *
+ * Hyperscan requires the Supplemental Streaming SIMD Extensions 3 instruction
+ * set. This function can be called on any x86 platform to determine if the
+ * system provides the required instruction set.
+ *
+ * This function does not test for more advanced features if Hyperscan has
+ * been built for a more specific architecture, for example the AVX2
+ * instruction set.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_ARCH_ERROR if system does not
+ *      support Hyperscan.
+ */
+hs_error_t hs_valid_platform(void);
+
 /**
  * @defgroup HS_ERROR hs_error_t values
  *
@@ -519,6 +1152,46 @@ const char *hs_version(void);
  */
 #define HS_SCRATCH_IN_USE       (-10)
 
+/**
+ * Unsupported CPU architecture.
+ *
+ * This error is returned when Hyperscan is able to detect that the current
+ * system does not support the required instruction set.
+ *
+ * At a minimum, Hyperscan requires Supplemental Streaming SIMD Extensions 3
+ * (SSSE3).
+ */
+#define HS_ARCH_ERROR           (-11)
+
+/**
+ * Provided buffer was too small.
+ *
+ * This error indicates that there was insufficient space in the buffer. The
+ * call should be repeated with a larger provided buffer.
+ *
+ * Note: in this situation, it is normal for the amount of space required to be
+ * returned in the same manner as the used space would have been returned if the
+ * call was successful.
+ */
+#define HS_INSUFFICIENT_SPACE   (-12)
+
+/**
+ * The scan stopped early because it reached its budget.
+ *
+ * This is returned by @ref hs_scan_stream_partial() when only part of the
+ * data was scanned. It is not an error: the stream remains valid, and the
+ * call should be repeated later with the remaining data.
+ */
+#define HS_SCAN_YIELD           (-13)
+
+/**
+ * The requested data is not available.
+ *
+ * This is returned by @ref hs_get_match_data() when the range asked for is
+ * not wholly within the data that Hyperscan holds at the time of the call.
+ */
+#define HS_DATA_UNAVAILABLE     (-14)
+
 /** @} */
 
 #ifdef __cplusplus
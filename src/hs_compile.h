@@ -205,6 +205,116 @@ typedef struct hs_expr_info {
     char matches_only_at_eod;
 } hs_expr_info_t;
 
+/**
+ * @defgroup HS_EXPR_ENGINE Engine types from hs_expression_cost_info()
+ *
+ * Bits of @ref hs_expr_cost_info_t::engines.
+ *
+ * @{
+ */
+
+/** The pattern has a literal factor that the literal matchers can scan for,
+ * or is wholly a literal. */
+#define HS_EXPR_ENGINE_LITERAL          1
+
+/** The pattern (or the part of it outside its literal factor) fits a LimEx
+ * NFA. */
+#define HS_EXPR_ENGINE_LIMEX            2
+
+/** The pattern can be determinised into a DFA within the compiler's state
+ * limit. */
+#define HS_EXPR_ENGINE_DFA              4
+
+/** The pattern contains bounded repeats large enough to be handled by the
+ * Castle repeat engine. */
+#define HS_EXPR_ENGINE_CASTLE           8
+
+/** The pattern is a single repeat of a character class, handled by the LBR
+ * (large bounded repeat) engine. */
+#define HS_EXPR_ENGINE_LBR              16
+
+/** @} */
+
+/**
+ * @defgroup HS_EXPR_COST Scan cost classes from hs_expression_cost_info()
+ *
+ * Values of @ref hs_expr_cost_info_t::cost_class.
+ *
+ * @{
+ */
+
+/** The pattern is literal-driven: its engines only run near occurrences of a
+ * literal of four or more bytes. */
+#define HS_EXPR_COST_LOW                0
+
+/** The pattern is driven by a short literal, so its engines may run often on
+ * typical data. */
+#define HS_EXPR_COST_MEDIUM             1
+
+/** The pattern has no usable literal factor, so an engine must scan every
+ * byte of the data. */
+#define HS_EXPR_COST_HIGH               2
+
+/** @} */
+
+/**
+ * A type containing compile-time cost estimates for an expression, returned
+ * by @ref hs_expression_cost_info().
+ *
+ * These are estimates from an analysis of the pattern on its own; the engines
+ * and state used when it is compiled into a database with other patterns may
+ * differ.
+ */
+typedef struct hs_expr_cost_info {
+    /**
+     * The engine types that the pattern would use, as a set of @ref
+     * HS_EXPR_ENGINE bits.
+     */
+    unsigned int engines;
+
+    /**
+     * The number of NFA states needed for the pattern, if @ref
+     * HS_EXPR_ENGINE_LIMEX is set; zero otherwise.
+     */
+    unsigned int nfa_states;
+
+    /**
+     * The number of DFA states needed for the pattern, if @ref
+     * HS_EXPR_ENGINE_DFA is set; zero otherwise.
+     */
+    unsigned int dfa_states;
+
+    /**
+     * The estimated stream state size in bytes, for the mode given to @ref
+     * hs_expression_cost_info(). Zero for block mode.
+     */
+    unsigned int stream_state_size;
+
+    /**
+     * The estimated scan cost class, one of the @ref HS_EXPR_COST values.
+     */
+    unsigned int cost_class;
+
+    /**
+     * The number of literals in the pattern's literal factor, which is empty
+     * if @ref HS_EXPR_ENGINE_LITERAL is not set.
+     */
+    unsigned int literal_count;
+
+    /**
+     * The length in bytes of each literal, an array of @ref literal_count
+     * entries.
+     */
+    const unsigned int *literal_lengths;
+
+    /**
+     * The literals, stored one after another with the lengths given in @ref
+     * literal_lengths. Literals may contain NUL bytes. Caseless characters
+     * are given in upper case.
+     */
+    const char *literals;
+} hs_expr_cost_info_t;
+
 /**
  * A structure containing additional parameters related to an expression,
  * passed in at build time to @ref hs_compile_ext_multi() or @ref
@@ -241,8 +351,103 @@ typedef struct hs_expr_ext {
      * @ref HS_EXT_FLAG_MIN_LENGTH flag in the hs_expr_ext::flags field.
      */
     unsigned long long min_length;
+
+    /**
+     * The maximum number of matches that should be reported for this
+     * expression's match ID in a single block scan, or over the lifetime of a
+     * stream. Once the limit has been reached, further matches are silently
+     * suppressed. The value must be between 1 and 2^32-1; a limit of one is
+     * equivalent to @ref HS_FLAG_SINGLEMATCH, and the limit has no effect on
+     * expressions that use that flag or @ref HS_FLAG_QUIET. Expressions that
+     * share a match ID share the limit. To use this parameter, set the
+     * @ref HS_EXT_FLAG_MAX_MATCHES flag in the hs_expr_ext::flags field.
+     */
+    unsigned long long max_matches;
+
+    /**
+     * The longest match, in bytes, that the confirm program of an expression
+     * compiled with @ref HS_FLAG_CONFIRM will search for. In streaming mode,
+     * this much data is retained in stream state for confirmation. To use
+     * this parameter, set the @ref HS_EXT_FLAG_CONFIRM_WINDOW flag in the
+     * hs_expr_ext::flags field; otherwise a window of 256 bytes is used.
+     */
+    unsigned long long confirm_window;
+
+    /**
+     * The number of NFA states that the prefiltering version of this
+     * expression (see @ref HS_FLAG_PREFILTER) is reduced to when it is too
+     * large to compile as it stands. Larger values keep more of the original
+     * expression, and so produce fewer false positives, at the cost of a
+     * larger and slower database; the default is 128. To use this parameter,
+     * set the @ref HS_EXT_FLAG_PREFILTER_STATES flag in the
+     * hs_expr_ext::flags field.
+     */
+    unsigned long long prefilter_states;
+
+    /**
+     * Allow matches within this Levenshtein distance of the expression: each
+     * inserted, deleted or substituted byte counts as one edit. To use this
+     * parameter, set the @ref HS_EXT_FLAG_EDIT_DISTANCE flag in the
+     * hs_expr_ext::flags field.
+     */
+    unsigned long long edit_distance;
+
+    /**
+     * Allow matches within this Hamming distance of the expression: each
+     * substituted byte counts as one edit. To use this parameter, set the
+     * @ref HS_EXT_FLAG_HAMMING_DISTANCE flag in the hs_expr_ext::flags
+     * field.
+     */
+    unsigned long long hamming_distance;
+
+    /**
+     * A value attached to matches for this expression: it is delivered in
+     * hs_match::user_data to a batch handler, and returned by @ref
+     * hs_get_match_user_data() within a match callback, so that the
+     * application can act on a match without looking up its ID. Expressions
+     * that share a match ID must specify the same value. To use this
+     * parameter, set the @ref HS_EXT_FLAG_USER_DATA flag in the
+     * hs_expr_ext::flags field; otherwise matches carry zero.
+     */
+    unsigned long long user_data;
 } hs_expr_ext_t;
 
+/**
+ * A compile cache, which retains engines built by one compile so that they
+ * can be reused by later compiles.
+ *
+ * The compile cache is allocated with @ref hs_alloc_compile_cache() and
+ * passed to @ref hs_compile_ext_multi_cached(). Its internals are not
+ * visible to the application.
+ */
+struct hs_compile_cache;
+
+/**
+ * A type containing a compile cache.
+ */
+typedef struct hs_compile_cache hs_compile_cache_t;
+
+/**
+ * Limits on the size of each database produced by @ref
+ * hs_compile_ext_multi_partitioned().
+ *
+ * A zero field selects the default limit.
+ */
+typedef struct hs_partition_limits {
+    /**
+     * The largest number of distinct literals to give the literal matchers of
+     * one database. Literals are those reported by @ref
+     * hs_expression_cost_info().
+     */
+    unsigned int max_literals;
+
+    /**
+     * The largest number of literal confirms to give one database: each
+     * pattern counts once for each of its literals, or once if it has none.
+     */
+    unsigned int max_confirms;
+} hs_partition_limits_t;
+
 /**
  * @defgroup HS_EXT_FLAG hs_expr_ext_t flags
  *
@@ -261,6 +466,24 @@ typedef struct hs_expr_ext {
 /** Flag indicating that the hs_expr_ext::min_length field is used. */
 #define HS_EXT_FLAG_MIN_LENGTH      4ULL
 
+/** Flag indicating that the hs_expr_ext::max_matches field is used. */
+#define HS_EXT_FLAG_MAX_MATCHES     8ULL
+
+/** Flag indicating that the hs_expr_ext::confirm_window field is used. */
+#define HS_EXT_FLAG_CONFIRM_WINDOW  16ULL
+
+/** Flag indicating that the hs_expr_ext::prefilter_states field is used. */
+#define HS_EXT_FLAG_PREFILTER_STATES 32ULL
+
+/** Flag indicating that the hs_expr_ext::edit_distance field is used. */
+#define HS_EXT_FLAG_EDIT_DISTANCE   64ULL
+
+/** Flag indicating that the hs_expr_ext::hamming_distance field is used. */
+#define HS_EXT_FLAG_HAMMING_DISTANCE 128ULL
+
+/** Flag indicating that the hs_expr_ext::user_data field is used. */
+#define HS_EXT_FLAG_USER_DATA       256ULL
+
 /** @} */
 
 /**
@@ -293,6 +516,7 @@ typedef struct hs_expr_ext {
  *       - HS_FLAG_PREFILTER - Compile pattern in prefiltering mode.
  *       - HS_FLAG_SOM_LEFTMOST - Report the leftmost start of match offset
  *                                when a match is found.
+ *       - HS_FLAG_QUIET - Ignore matches from this expression.
  *
  * @param mode
  *      Compiler mode flags that affect the database as a whole. One of @ref
@@ -361,6 +585,9 @@ hs_error_t hs_compile(const char *expression, unsigned int flags,
  *       - HS_FLAG_PREFILTER - Compile pattern in prefiltering mode.
  *       - HS_FLAG_SOM_LEFTMOST - Report the leftmost start of match offset
  *                                when a match is found.
+ *       - HS_FLAG_COMBINATION - Parse the expression in logical
+ *                               combination syntax.
+ *       - HS_FLAG_QUIET - Ignore matches from this expression.
  *
  * @param ids
  *      An array of integers specifying the ID number to be associated with the
@@ -439,6 +666,9 @@ hs_error_t hs_compile_multi(const char *const *expressions,
  *       - HS_FLAG_PREFILTER - Compile pattern in prefiltering mode.
  *       - HS_FLAG_SOM_LEFTMOST - Report the leftmost start of match offset
  *                                when a match is found.
+ *       - HS_FLAG_COMBINATION - Parse the expression in logical
+ *                               combination syntax.
+ *       - HS_FLAG_QUIET - Ignore matches from this expression.
  *
  * @param ids
  *      An array of integers specifying the ID number to be associated with the
@@ -494,6 +724,405 @@ hs_error_t hs_compile_ext_multi(const char *const *expressions,
                                 const hs_platform_info_t *platform,
                                 hs_database_t **db, hs_compile_error_t **error);
 
+/**
+ * The basic pure literal expression compiler.
+ *
+ * This is the function call with which a single literal is compiled into a
+ * Hyperscan database which can be passed to the runtime functions (such as
+ * @ref hs_scan(), @ref hs_open_stream(), etc.) The literal is not parsed as
+ * a regular expression: every byte, including NUL and regex
+ * meta-characters, is matched as itself.
+ *
+ * @param expression
+ *      The literal to be matched. This is not required to be NULL-terminated.
+ *
+ * @param flags
+ *      Flags which modify the behaviour of the literal. Multiple flags may be
+ *      used by ORing them together. Valid values are:
+ *       - HS_FLAG_CASELESS - Matching will be performed case-insensitively.
+ *       - HS_FLAG_SINGLEMATCH - Only one match will be generated for the
+ *                               literal per stream.
+ *       - HS_FLAG_SOM_LEFTMOST - Report the leftmost start of match offset
+ *                                when a match is found.
+ *       - HS_FLAG_QUIET - Ignore matches from this expression.
+ *
+ * @param len
+ *      The length of the literal in bytes. Must be non-zero.
+ *
+ * @param mode
+ *      Compiler mode flags that affect the database as a whole. One of @ref
+ *      HS_MODE_STREAM or @ref HS_MODE_BLOCK or @ref HS_MODE_VECTORED must be
+ *      supplied, to select between the generation of a streaming, block or
+ *      vectored database. In addition, other flags (beginning with HS_MODE_)
+ *      may be supplied to enable specific features. See @ref HS_MODE_FLAG for
+ *      more details.
+ *
+ * @param platform
+ *      If not NULL, the platform structure is used to determine the target
+ *      platform for the database. If NULL, a database suitable for running
+ *      on the current host platform is produced.
+ *
+ * @param db
+ *      On success, a pointer to the generated database will be returned in
+ *      this parameter, or NULL on failure. The caller is responsible for
+ *      deallocating the buffer using the @ref hs_free_database() function.
+ *
+ * @param error
+ *      If the compile fails, a pointer to a @ref hs_compile_error_t will be
+ *      returned, providing details of the error condition. The caller is
+ *      responsible for deallocating the buffer using the @ref
+ *      hs_free_compile_error() function.
+ *
+ * @return
+ *      @ref HS_SUCCESS is returned on successful compilation; @ref
+ *      HS_COMPILER_ERROR on failure, with details provided in the error
+ *      parameter.
+ */
+hs_error_t hs_compile_lit(const char *expression, unsigned int flags,
+                          size_t len, unsigned int mode,
+                          const hs_platform_info_t *platform,
+                          hs_database_t **db, hs_compile_error_t **error);
+
+/**
+ * The multiple pure literal expression compiler.
+ *
+ * This is the function call with which a set of literals is compiled into a
+ * database which can be passed to the runtime functions (such as @ref
+ * hs_scan(), @ref hs_open_stream(), etc.) As for @ref hs_compile_lit(), the
+ * literals are not parsed as regular expressions, so they may contain any
+ * byte values. Each literal can be labelled with a unique integer which is
+ * passed into the match callback to identify the literal that has matched.
+ *
+ * @param expressions
+ *      Array of literals to compile. These are not required to be
+ *      NULL-terminated.
+ *
+ * @param flags
+ *      Array of flags which modify the behaviour of each literal. Multiple
+ *      flags may be used by ORing them together. Specifying the NULL pointer
+ *      in place of an array will set the flags value for all literals to
+ *      zero. Valid values are:
+ *       - HS_FLAG_CASELESS - Matching will be performed case-insensitively.
+ *       - HS_FLAG_SINGLEMATCH - Only one match will be generated by literals
+ *                               with this match id per stream.
+ *       - HS_FLAG_SOM_LEFTMOST - Report the leftmost start of match offset
+ *                                when a match is found.
+ *       - HS_FLAG_QUIET - Ignore matches from this expression.
+ *
+ * @param ids
+ *      An array of integers specifying the ID number to be associated with the
+ *      corresponding literal in the expressions array. Specifying the NULL
+ *      pointer in place of an array will set the ID value for all literals to
+ *      zero.
+ *
+ * @param lens
+ *      An array of lengths in bytes of the corresponding literals in the
+ *      expressions array. Each length must be non-zero.
+ *
+ * @param elements
+ *      The number of elements in the input arrays.
+ *
+ * @param mode
+ *      Compiler mode flags that affect the database as a whole. One of @ref
+ *      HS_MODE_STREAM or @ref HS_MODE_BLOCK or @ref HS_MODE_VECTORED must be
+ *      supplied, to select between the generation of a streaming, block or
+ *      vectored database. In addition, other flags (beginning with HS_MODE_)
+ *      may be supplied to enable specific features. See @ref HS_MODE_FLAG for
+ *      more details.
+ *
+ * @param platform
+ *      If not NULL, the platform structure is used to determine the target
+ *      platform for the database. If NULL, a database suitable for running
+ *      on the current host platform is produced.
+ *
+ * @param db
+ *      On success, a pointer to the generated database will be returned in
+ *      this parameter, or NULL on failure. The caller is responsible for
+ *      deallocating the buffer using the @ref hs_free_database() function.
+ *
+ * @param error
+ *      If the compile fails, a pointer to a @ref hs_compile_error_t will be
+ *      returned, providing details of the error condition. The caller is
+ *      responsible for deallocating the buffer using the @ref
+ *      hs_free_compile_error() function.
+ *
+ * @return
+ *      @ref HS_SUCCESS is returned on successful compilation; @ref
+ *      HS_COMPILER_ERROR on failure, with details provided in the @a error
+ *      parameter.
+ */
+hs_error_t hs_compile_lit_multi(const char *const *expressions,
+                                const unsigned int *flags,
+                                const unsigned int *ids, const size_t *lens,
+                                unsigned int elements, unsigned int mode,
+                                const hs_platform_info_t *platform,
+                                hs_database_t **db,
+                                hs_compile_error_t **error);
+
+/**
+ * The multiple regular expression compiler with extended parameter support
+ * and a compile cache.
+ *
+ * This function behaves exactly as @ref hs_compile_ext_multi(), and produces
+ * an identical database, but uses the given compile cache to avoid
+ * rebuilding engines that were built by an earlier compile using the same
+ * cache. Engines built by this compile are added to the cache.
+ *
+ * This is intended for applications which recompile large pattern sets after
+ * small changes, such as the addition or removal of a few patterns. Currently
+ * the engines retained are the DFA engines used by Rose for outfixes,
+ * prefixes, infixes and suffixes.
+ *
+ * A cache may be shared between compiles of different modes and for different
+ * platforms, and may be used by several threads at once.
+ *
+ * @param expressions
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param flags
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param ids
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param ext
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param elements
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param mode
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param platform
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param cache
+ *      A compile cache allocated with @ref hs_alloc_compile_cache().
+ *
+ * @param db
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param error
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @return
+ *      @ref HS_SUCCESS is returned on successful compilation; @ref
+ *      HS_COMPILER_ERROR on failure, with details provided in the @a error
+ *      parameter.
+ */
+hs_error_t hs_compile_ext_multi_cached(const char *const *expressions,
+                                       const unsigned int *flags,
+                                       const unsigned int *ids,
+                                       const hs_expr_ext_t *const *ext,
+                                       unsigned int elements,
+                                       unsigned int mode,
+                                       const hs_platform_info_t *platform,
+                                       hs_compile_cache_t *cache,
+                                       hs_database_t **db,
+                                       hs_compile_error_t **error);
+
+/**
+ * Allocate an empty compile cache for use with @ref
+ * hs_compile_ext_multi_cached().
+ *
+ * @param cache
+ *      On success, a pointer to the new compile cache will be returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if the allocation fails.
+ *      Other errors may be returned if invalid parameters are specified.
+ */
+hs_error_t hs_alloc_compile_cache(hs_compile_cache_t **cache);
+
+/**
+ * Provides the number of engines held in a compile cache and the memory
+ * they occupy.
+ *
+ * @param cache
+ *      A compile cache allocated with @ref hs_alloc_compile_cache().
+ *
+ * @param engines
+ *      On success, the number of engines in the cache is placed in this
+ *      parameter. NULL may be provided if this is not required.
+ *
+ * @param size
+ *      On success, the approximate size of the cache contents in bytes is
+ *      placed in this parameter. NULL may be provided if this is not
+ *      required.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_compile_cache_info(const hs_compile_cache_t *cache,
+                                 size_t *engines, size_t *size);
+
+/**
+ * Free a compile cache allocated by @ref hs_alloc_compile_cache().
+ *
+ * The cache must not be in use by any compile when this is called.
+ *
+ * @param cache
+ *      The compile cache to be freed. NULL may also be safely provided.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_free_compile_cache(hs_compile_cache_t *cache);
+
+/**
+ * The multiple regular expression compiler with automatic partitioning.
+ *
+ * This function compiles a large pattern set into one or more databases,
+ * each of which holds some of the patterns. When a set gives the literal
+ * matchers so many literals that they become the bottleneck, scanning several
+ * smaller databases can be faster than scanning one.
+ *
+ * Each pattern is analysed as by @ref hs_expression_cost_info(). Patterns are
+ * then divided so that each database stays within the given limits, keeping
+ * patterns that share literals together, and grouping patterns without a
+ * literal by the engine type that would run them. A single database is
+ * produced if every pattern fits within the limits. If @a max_databases
+ * databases are not enough to keep within the limits, they are exceeded.
+ * Sets containing @ref HS_FLAG_COMBINATION patterns are not divided.
+ *
+ * Each database reports the IDs given for its own patterns. Together, they
+ * report the same matches as a single database compiled from the whole set
+ * by @ref hs_compile_ext_multi(); in block mode they may be scanned together
+ * with @ref hs_scan_multi_db(), and in any mode they may be scanned one after
+ * another or on separate threads.
+ *
+ * @param expressions
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param flags
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param ids
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param ext
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param elements
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param mode
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param platform
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param limits
+ *      The limits on each database, or NULL for the default limits.
+ *
+ * @param max_databases
+ *      The largest number of databases to produce, which must be at least
+ *      one: the number of entries in the @a dbs array.
+ *
+ * @param dbs
+ *      On success, the generated databases are returned in the first @a
+ *      db_count entries of this array. Each must be freed with @ref
+ *      hs_free_database(). On failure, the first entry is set to NULL.
+ *
+ * @param db_count
+ *      On success, the number of databases generated is returned here. On
+ *      failure, zero is returned.
+ *
+ * @param error
+ *      As for @ref hs_compile_ext_multi(). An error in one of the patterns
+ *      gives its index in the @a expressions array.
+ *
+ * @return
+ *      @ref HS_SUCCESS is returned on successful compilation; @ref
+ *      HS_COMPILER_ERROR on failure, with details provided in the @a error
+ *      parameter.
+ */
+hs_error_t hs_compile_ext_multi_partitioned(const char *const *expressions,
+                                            const unsigned int *flags,
+                                            const unsigned int *ids,
+                                            const hs_expr_ext_t *const *ext,
+                                            unsigned int elements,
+                                            unsigned int mode,
+                                            const hs_platform_info_t *platform,
+                                            const hs_partition_limits_t *limits,
+                                            unsigned int max_databases,
+                                            hs_database_t **dbs,
+                                            unsigned int *db_count,
+                                            hs_compile_error_t **error);
+
+/**
+ * The multiple regular expression compiler with prefilter tuning.
+ *
+ * This function compiles a pattern set as @ref hs_compile_ext_multi() does,
+ * but first measures how often the prefiltering version of each @ref
+ * HS_FLAG_PREFILTER or @ref HS_FLAG_CONFIRM pattern matches a sample of data
+ * that the pattern itself does not. The patterns with the most such false
+ * positives are then given a larger @ref hs_expr_ext_t::prefilter_states
+ * value, so that more of their structure survives in the database, for as
+ * long as this lowers their false positive count and the total number of
+ * extra states granted stays within @a max_extra_states.
+ *
+ * The sample is scanned as a single block. Matches of the original patterns
+ * are found in the same way as by @ref HS_FLAG_CONFIRM, so matches longer
+ * than its largest window are counted as false positives. Patterns with an
+ * explicit prefilter_states value are not changed.
+ *
+ * @param expressions
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param flags
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param ids
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param ext
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param elements
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param mode
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param platform
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param corpus
+ *      Sample data, representative of the data to be scanned. This may be
+ *      NULL only if @a corpus_len is zero, in which case no tuning is done.
+ *
+ * @param corpus_len
+ *      The length of the sample data in bytes.
+ *
+ * @param max_extra_states
+ *      The largest total number of NFA states to add to the defaults across
+ *      all the tuned patterns. If zero, no tuning is done.
+ *
+ * @param db
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @param error
+ *      As for @ref hs_compile_ext_multi().
+ *
+ * @return
+ *      @ref HS_SUCCESS is returned on successful compilation; @ref
+ *      HS_COMPILER_ERROR on failure, with details provided in the @a error
+ *      parameter.
+ */
+hs_error_t hs_compile_ext_multi_tuned(const char *const *expressions,
+                                      const unsigned int *flags,
+                                      const unsigned int *ids,
+                                      const hs_expr_ext_t *const *ext,
+                                      unsigned int elements, unsigned int mode,
+                                      const hs_platform_info_t *platform,
+                                      const char *corpus,
+                                      unsigned int corpus_len,
+                                      unsigned int max_extra_states,
+                                      hs_database_t **db,
+                                      hs_compile_error_t **error);
+
 /**
  * Free an error structure generated by @ref hs_compile(), @ref
  * hs_compile_multi() or @ref hs_compile_ext_multi().
@@ -613,6 +1242,55 @@ hs_error_t hs_expression_ext_info(const char *expression, unsigned int flags,
                                   hs_expr_info_t **info,
                                   hs_compile_error_t **error);
 
+/**
+ * Utility function providing compile-time cost estimates for a regular
+ * expression, for vetting patterns before they are compiled into a database.
+ *
+ * The estimates in @ref hs_expr_cost_info_t are made with the graph analyses
+ * that the compiler uses, without building any engines into bytecode. They
+ * cover the engine types the pattern would use, the literals that would be
+ * scanned for, the stream state needed and a coarse scan cost class.
+ *
+ * @param expression
+ *      The NULL-terminated expression to parse. Note that this string must
+ *      represent ONLY the pattern to be matched, with no delimiters or flags;
+ *      any global flags should be specified with the @a flags argument.
+ *
+ * @param flags
+ *      Flags which modify the behaviour of the expression, as for @ref
+ *      hs_expression_info().
+ *
+ * @param ext
+ *      A pointer to a filled @ref hs_expr_ext_t structure that defines
+ *      extended behaviour for this pattern. NULL may be specified if no
+ *      extended parameters are needed.
+ *
+ * @param mode
+ *      The mode the pattern would be compiled in: @ref HS_MODE_BLOCK, @ref
+ *      HS_MODE_STREAM or @ref HS_MODE_VECTORED.
+ *
+ * @param info
+ *      On success, a pointer to the cost information will be returned in this
+ *      parameter, or NULL on failure. The structure and the literal arrays it
+ *      points to are a single allocation made using the allocator supplied in
+ *      @ref hs_set_allocator() (or malloc() if no allocator was set), and
+ *      should be freed by the caller.
+ *
+ * @param error
+ *      If the call fails, a pointer to a @ref hs_compile_error_t will be
+ *      returned, providing details of the error condition. The caller is
+ *      responsible for deallocating the buffer using the @ref
+ *      hs_free_compile_error() function.
+ *
+ * @return
+ *      @ref HS_SUCCESS is returned on success; @ref HS_COMPILER_ERROR on
+ *      failure, with details provided in the error parameter.
+ */
+hs_error_t hs_expression_cost_info(const char *expression, unsigned int flags,
+                                   const hs_expr_ext_t *ext, unsigned int mode,
+                                   hs_expr_cost_info_t **info,
+                                   hs_compile_error_t **error);
+
 /**
  * Populates the platform information based on the current host.
  *
@@ -625,6 +1303,384 @@ hs_error_t hs_expression_ext_info(const char *expression, unsigned int flags,
  */
 hs_error_t hs_populate_platform(hs_platform_info_t *platform);
 
+/**
+ * Sets the number of threads used by the compile functions.
+ *
+ * When more than one thread is requested, @ref hs_compile_multi() and @ref
+ * hs_compile_ext_multi() parse and optimise their expressions on a pool of
+ * worker threads, which can greatly reduce the time taken to compile large
+ * pattern sets. The graph reduction passes for the independent components of
+ * a large expression are also shared among the workers, as is the search
+ * for mutually exclusive engines that can share stream state. The remainder
+ * of the compile is single-threaded. The resulting database is identical
+ * regardless of the number of threads used, and compile errors are still
+ * reported against the lowest-indexed failing expression.
+ *
+ * This setting applies to all subsequent compiles in the process. It is safe
+ * to call this function while other threads are compiling, but those compiles
+ * may use either the old or the new value.
+ *
+ * @param num_threads
+ *      The number of threads to use. A value of one (the default) disables
+ *      threading, and a value of zero uses one thread per hardware thread
+ *      available.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_set_compile_threads(unsigned int num_threads);
+
+/**
+ * Supplies the byte value frequencies of the data that databases will be used
+ * to scan.
+ *
+ * By default, the compiler assumes that all byte values are equally likely
+ * in the scanned data. Given a histogram of a representative sample of real
+ * traffic, the literal matcher is instead built to minimise the expected rate
+ * of candidate matches that must be confirmed, by grouping literals whose
+ * bytes are rare in the traffic and by sizing its tables to suit. This can
+ * improve scanning performance on traffic resembling the sample, at some cost
+ * on traffic that does not. The matches reported are unaffected.
+ *
+ * This setting applies to all subsequent compiles in the process. It is safe
+ * to call this function while other threads are compiling, but those compiles
+ * may use either the old or the new frequencies.
+ *
+ * @param counts
+ *      An array of 256 counts, where element i is the number of times the byte
+ *      value i occurs in the sample. Only the relative sizes of the counts are
+ *      significant, and at least one must be non-zero. The array is copied,
+ *      and need not outlive the call. NULL restores the default behaviour.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_set_compile_byte_frequencies(const unsigned long long *counts);
+
+/**
+ * Supplies the frequencies of adjacent byte pairs in the data that databases
+ * will be used to scan.
+ *
+ * This is a more detailed alternative to @ref
+ * hs_set_compile_byte_frequencies(), and replaces any histogram supplied with
+ * that function. As well as arranging the literal matcher as described there,
+ * the compiler uses the pair frequencies when choosing the literals that
+ * patterns are decomposed around: it prefers literals that are rare in the
+ * traffic, even if they are slightly shorter, over common sequences such as
+ * protocol keywords and line endings that would match very frequently and
+ * require confirmation each time. The matches reported are unaffected.
+ *
+ * This setting applies to all subsequent compiles in the process. It is safe
+ * to call this function while other threads are compiling, but those compiles
+ * may use either the old or the new frequencies.
+ *
+ * @param counts
+ *      An array of 65536 counts, where element (a * 256 + b) is the number of
+ *      times the byte value a is immediately followed by the byte value b in
+ *      the sample. Only the relative sizes of the counts are significant, and
+ *      at least one must be non-zero. The array is copied, and need not
+ *      outlive the call. NULL restores the default behaviour.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_set_compile_byte_pair_frequencies(
+                                            const unsigned long long *counts);
+
+/**
+ * Sets a time budget for the compile functions.
+ *
+ * A few patterns can take a very long time to compile, usually while their
+ * automata are being determinised or decomposed. Once a compile has run for
+ * longer than the budget, it falls back to cheaper strategies for the rest of
+ * the pattern set: graphs are built as a single NFA engine rather than being
+ * decomposed around their literals, NFA engines are no longer converted to
+ * DFAs, and engines are no longer merged with one another. The database
+ * produced still reports exactly the same matches, but may scan more slowly
+ * and use more stream state than an unbudgeted compile. The patterns whose
+ * engines were affected can be retrieved afterwards with @ref
+ * hs_compile_degraded_patterns().
+ *
+ * The budget is not a hard deadline: work already in progress when the budget
+ * runs out is completed, and some patterns have no cheaper strategy. As the
+ * point at which the budget runs out depends on the speed of the host, a
+ * budgeted compile may not produce the same database each time.
+ *
+ * This setting applies to all subsequent compiles in the process. It is safe
+ * to call this function while other threads are compiling, but those compiles
+ * may use either the old or the new value.
+ *
+ * @param milliseconds
+ *      The time budget in milliseconds. A value of zero (the default) removes
+ *      the budget.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_set_compile_time_budget(unsigned int milliseconds);
+
+/**
+ * Retrieves the patterns that the most recent successful compile on the
+ * calling thread built with a cheaper strategy because its time budget (see
+ * @ref hs_set_compile_time_budget()) was exceeded.
+ *
+ * Engine merges skipped because of the budget affect the database as a whole,
+ * and are not attributed to individual patterns.
+ *
+ * @param ids
+ *      On success, points to an array of the degraded patterns' identifiers
+ *      in ascending order, or NULL if there are none. The array is owned by
+ *      the library and remains valid until the next compile on the calling
+ *      thread.
+ *
+ * @param count
+ *      On success, the number of identifiers in @p ids.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_compile_degraded_patterns(const unsigned int **ids,
+                                        unsigned int *count);
+
+/**
+ * @defgroup HS_COMPILE_PHASE Compile phases
+ *
+ * Indices into @ref hs_compile_stats::phases.
+ *
+ * @{
+ */
+
+/** Compile phase: expression parsing and Glushkov NFA construction. */
+#define HS_COMPILE_PHASE_PARSE          0
+
+/** Compile phase: NFA graph reductions, and the other decompositions tried on
+ * each graph before Violet. */
+#define HS_COMPILE_PHASE_GRAPH          1
+
+/** Compile phase: Violet decomposition of graphs around their literals. */
+#define HS_COMPILE_PHASE_VIOLET         2
+
+/** Compile phase: conversion of NFA graphs to DFAs. */
+#define HS_COMPILE_PHASE_DETERMINISE    3
+
+/** Compile phase: Rose build, including engine merges and role aliasing. */
+#define HS_COMPILE_PHASE_ROSE           4
+
+/** Compile phase: bytecode emission for Rose and its engines. */
+#define HS_COMPILE_PHASE_BYTECODE       5
+
+/** Compile phase: small write engine build. */
+#define HS_COMPILE_PHASE_SMALLWRITE     6
+
+/** Number of compile phases in @ref hs_compile_report. */
+#define HS_COMPILE_PHASE_COUNT          7
+
+/** @} */
+
+/** Maximum number of expressions listed as the slowest in each phase of a
+ * @ref hs_compile_report. */
+#define HS_COMPILE_REPORT_SLOWEST       8
+
+/**
+ * Time and memory used by one phase of a compile, part of an @ref
+ * hs_compile_report.
+ */
+typedef struct hs_compile_phase_report {
+    /**
+     * Time spent in the phase in nanoseconds. Where a phase runs inside
+     * another (for example, determinisation during bytecode emission), the
+     * time is charged to the inner phase only. Time spent on several compile
+     * threads (see @ref hs_set_compile_threads()) is summed.
+     */
+    unsigned long long time_ns;
+
+    /**
+     * The peak resident memory of the process in bytes, as observed at the
+     * end of the phase, or zero if this is not available on the platform.
+     */
+    unsigned long long peak_memory;
+
+    /**
+     * The number of bytes by which the phase raised the peak resident memory
+     * of the process. A phase that used a lot of memory for a short time
+     * shows up here even if later phases used more.
+     */
+    unsigned long long memory_growth;
+
+    /** The number of entries in @ref slowest. */
+    unsigned int slowest_count;
+
+    /**
+     * The indices, in the expression array passed to the compile function, of
+     * the expressions that took longest in this phase, slowest first. Work
+     * done on several expressions at once, such as engine merges, is not
+     * attributed to any expression.
+     */
+    unsigned int slowest[HS_COMPILE_REPORT_SLOWEST];
+
+    /** The time in nanoseconds taken by each expression in @ref slowest. */
+    unsigned long long slowest_time_ns[HS_COMPILE_REPORT_SLOWEST];
+} hs_compile_phase_report_t;
+
+/**
+ * A per-phase report of the time and memory used by a compile, retrieved with
+ * @ref hs_compile_report().
+ */
+typedef struct hs_compile_stats {
+    /** The sum of the time spent in all phases, in nanoseconds. */
+    unsigned long long total_time_ns;
+
+    /** The report for each phase, indexed by the @ref HS_COMPILE_PHASE
+     * constants. */
+    hs_compile_phase_report_t phases[HS_COMPILE_PHASE_COUNT];
+} hs_compile_stats_t;
+
+/**
+ * Enables or disables the collection of a per-phase time and memory report
+ * by the compile functions, which can be retrieved after each compile with
+ * @ref hs_compile_report().
+ *
+ * Collecting the report adds a small cost to each compile, so it is disabled
+ * by default. The databases produced are the same either way.
+ *
+ * This setting applies to all subsequent compiles in the process. It is safe
+ * to call this function while other threads are compiling, but those compiles
+ * may use either the old or the new value.
+ *
+ * @param enable
+ *      Non-zero to collect a report for each compile, zero (the default) to
+ *      stop collecting them.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_set_compile_report(int enable);
+
+/**
+ * Retrieves the per-phase time and memory report of the most recent compile
+ * on the calling thread, collected if reports were enabled with @ref
+ * hs_set_compile_report(). A report is kept for compiles that fail as well as
+ * those that succeed, covering the phases run before the failure.
+ *
+ * @param report
+ *      On success, points to the report, or NULL if the most recent compile
+ *      on the calling thread did not collect one. The report is owned by the
+ *      library and remains valid until the next compile on the calling
+ *      thread.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_compile_report(const hs_compile_stats_t **report);
+
+/**
+ * The stream state attributed to one pattern of a streaming mode database,
+ * retrieved with @ref hs_compile_stream_state_usage().
+ *
+ * State shared by several patterns is split evenly between them, and rounded
+ * up to whole bits or bytes for each pattern. History is different: it is
+ * shared by all patterns, but its length is set by the pattern that needs the
+ * most, so each pattern is charged in full for the history it needs.
+ */
+typedef struct hs_stream_state_usage {
+    /** The pattern's identifier. */
+    unsigned int id;
+
+    /** Bits of the Rose role state used by the pattern's literals and the
+     * roles that follow them. */
+    unsigned int role_bits;
+
+    /** Bytes of automaton state for the pattern's NFA and DFA engines,
+     * excluding their bounded repeats. */
+    unsigned int engine_bytes;
+
+    /** Bytes of state for bounded repeats, such as `x{100,200}`. */
+    unsigned int repeat_bytes;
+
+    /** Bytes of start of match slots (see @ref HS_FLAG_SOM_LEFTMOST). */
+    unsigned int som_bytes;
+
+    /** Bytes of history the pattern needs kept from the previous write. */
+    unsigned int history_bytes;
+
+    /** The pattern's total: all of the above, in bytes. */
+    unsigned int total_bytes;
+} hs_stream_state_usage_t;
+
+/**
+ * Limits on the stream state of streaming mode databases, set with @ref
+ * hs_set_stream_state_budget().
+ */
+typedef struct hs_stream_state_budget {
+    /** The largest @ref hs_stream_state_usage::total_bytes allowed for any
+     * pattern, or zero for no limit. */
+    unsigned int pattern_bytes;
+
+    /** The largest stream size allowed for the database, as returned by @ref
+     * hs_stream_size(), or zero for no limit. */
+    unsigned int total_bytes;
+
+    /** Zero or @ref HS_STATE_BUDGET_RESTRUCTURE. */
+    unsigned int flags;
+} hs_stream_state_budget_t;
+
+/**
+ * Flag for @ref hs_stream_state_budget::flags: before rejecting a pattern set
+ * that is over budget, compile it again with its automata built as DFAs
+ * wherever possible, which usually need much less stream state than NFAs.
+ */
+#define HS_STATE_BUDGET_RESTRUCTURE     1
+
+/**
+ * Sets a stream state budget for the compile functions, and turns on the
+ * attribution of stream state to patterns.
+ *
+ * Once a budget is set, each compile of a streaming mode database works out
+ * how much stream state each pattern is responsible for, which can then be
+ * retrieved with @ref hs_compile_stream_state_usage(). If a pattern or the
+ * database as a whole is over budget, the compile fails with @ref
+ * HS_COMPILER_ERROR and a compile error naming the pattern identifier. The
+ * error's expression index is -1. With @ref HS_STATE_BUDGET_RESTRUCTURE, the
+ * pattern set is first compiled a second time in a way that favours small
+ * stream state, and only rejected if that is still over budget.
+ *
+ * A budget with all limits zero collects the attribution without enforcing
+ * anything. Block mode compiles are not affected.
+ *
+ * This setting applies to all subsequent compiles in the process. It is safe
+ * to call this function while other threads are compiling, but those compiles
+ * may use either the old or the new value.
+ *
+ * @param budget
+ *      The budget, or NULL (the default) to stop attributing stream state.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_set_stream_state_budget(const hs_stream_state_budget_t *budget);
+
+/**
+ * Retrieves the stream state attributed to each pattern by the most recent
+ * compile on the calling thread, if a budget was set with @ref
+ * hs_set_stream_state_budget(). The attribution is kept when the compile was
+ * rejected for being over budget, so that the expensive patterns can be
+ * found.
+ *
+ * @param usage
+ *      On success, points to an array with an entry for each pattern, in
+ *      decreasing order of total bytes, or NULL if the most recent compile
+ *      did not attribute its stream state. The array is owned by the library
+ *      and remains valid until the next compile on the calling thread.
+ *
+ * @param count
+ *      On success, the number of entries in @p usage.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_compile_stream_state_usage(const hs_stream_state_usage_t **usage,
+                                         unsigned int *count);
+
 /**
  * @defgroup HS_PATTERN_FLAG Pattern flags
  *
@@ -754,6 +1810,60 @@ hs_error_t hs_populate_platform(hs_platform_info_t *platform);
  */
 #define HS_FLAG_SOM_LEFTMOST    256
 
+/**
+ * Compile flag: Logical combination.
+ *
+ * This flag instructs Hyperscan to parse this expression as a logical
+ * combination of other patterns in the same database, rather than as a
+ * regular expression. The expression is made up of the match IDs of other
+ * patterns combined with the operators `&` (AND), `|` (OR) and `!` (NOT), and
+ * may use parentheses for grouping; for example, `(101 & 102) | !103`.
+ *
+ * The combination is evaluated as the patterns it refers to are matched, and
+ * is reported (with its own ID) at the offset at which it first becomes true.
+ * A combination that is true without any of its patterns having matched,
+ * such as `!103`, is reported at the end of data. Each combination is
+ * reported at most once per stream or block.
+ *
+ * Only @ref HS_FLAG_SINGLEMATCH may be specified in addition to this flag,
+ * and extended parameters are not supported for combinations.
+ */
+#define HS_FLAG_COMBINATION     512
+
+/**
+ * Compile flag: Don't report matches for this expression.
+ *
+ * This flag instructs Hyperscan to suppress the matches for this expression.
+ * It is intended for patterns that are only used as parts of a logical
+ * combination (see @ref HS_FLAG_COMBINATION), so that only the combined
+ * result is delivered to the match callback.
+ */
+#define HS_FLAG_QUIET           1024
+
+/**
+ * Compile flag: Confirm prefilter matches exactly.
+ *
+ * This flag implies @ref HS_FLAG_PREFILTER, and additionally instructs
+ * Hyperscan to check each match of the prefiltering version of this
+ * expression against the original expression, including any back-references
+ * or other constructs that prefiltering replaced. Only matches that pass this
+ * check are reported, so the application need not confirm them itself.
+ *
+ * The check is made by a backtracking program over the data preceding the
+ * match, and only finds matches no longer than the confirm window (256 bytes
+ * by default; see @ref hs_expr_ext_t::confirm_window). In streaming mode, the
+ * window of data is retained in stream state. Lookaround assertions, atomic
+ * groups and possessive repeats are not checked exactly, and a match whose
+ * check exceeds internal resource limits is reported: the set of matches
+ * reported is still guaranteed to be a superset of those of the original
+ * expression, within the window.
+ *
+ * An expression using this flag may not share its match ID with any other
+ * expression. The use of this flag in combination with @ref
+ * HS_FLAG_SOM_LEFTMOST is not currently supported.
+ */
+#define HS_FLAG_CONFIRM         2048
+
 /** @} */
 
 /**
@@ -770,6 +1880,24 @@ hs_error_t hs_populate_platform(hs_platform_info_t *platform);
  */
 #define HS_CPU_FEATURES_AVX2             (1ULL << 2)
 
+/**
+ * CPU features flag - Intel(R) Advanced Vector Extensions 512
+ * (Intel(R) AVX512)
+ *
+ * Setting this flag indicates that the target platform supports AVX512
+ * instructions, specifically AVX-512BW. Using AVX512 implies the use of AVX2.
+ */
+#define HS_CPU_FEATURES_AVX512           (1ULL << 3)
+
+/**
+ * CPU features flag - Intel(R) Advanced Vector Extensions 512
+ * Vector Byte Manipulation Instructions (Intel(R) AVX512VBMI)
+ *
+ * Setting this flag indicates that the target platform supports AVX512VBMI
+ * instructions. Using AVX512VBMI implies the use of AVX512.
+ */
+#define HS_CPU_FEATURES_AVX512VBMI       (1ULL << 4)
+
 /** @} */
 
 /**
@@ -840,6 +1968,10 @@ hs_error_t hs_populate_platform(hs_platform_info_t *platform);
  * HS_MODE_VECTORED. Other flags may be added to enable support for additional
  * features.
  *
+ * @ref HS_MODE_BLOCK and @ref HS_MODE_STREAM may also be given together, to
+ * build a multi-mode database holding engines for both modes, which may be
+ * used with both the block mode and the streaming API calls.
+ *
  *  @{
  */
 
@@ -902,6 +2034,72 @@ hs_error_t hs_populate_platform(hs_platform_info_t *platform);
  */
 #define HS_MODE_SOM_HORIZON_SMALL   (1U << 26)
 
+/**
+ * Compiler mode flag: stop scanning at the first match.
+ *
+ * For applications that only need to know whether any pattern matched, this
+ * mode builds a database in which the first match delivered to the match
+ * callback terminates the scan, exactly as if the callback had returned
+ * non-zero. Scanning calls that produce a match therefore return @ref
+ * HS_SCAN_TERMINATED, and this also happens if no callback is supplied.
+ *
+ * Since only one match is ever reported, the compiler omits the bookkeeping
+ * used to deduplicate and exhaust matches. Start of match is not tracked in
+ * this mode: the @ref HS_FLAG_SOM_LEFTMOST flag is ignored, and the
+ * HS_MODE_SOM_HORIZON_ mode flags may not be used.
+ */
+#define HS_MODE_ANY_MATCH           (1U << 27)
+
+/**
+ * Compiler mode flag: matches may be delivered out of offset order.
+ *
+ * By default, matches are delivered to the match callback in order of
+ * increasing end offset, which requires the engines behind more complex
+ * patterns to be run in lock step with the literal matcher. Applications that
+ * sort matches themselves, or do not depend on their order, can set this flag
+ * to let those engines run to the end of each block or stream write on their
+ * own, delivering their matches as they go.
+ *
+ * Each match is still delivered exactly once. The compiler keeps ordered
+ * delivery for databases that need it to deliver matches correctly: those
+ * containing patterns with @ref HS_FLAG_SOM_LEFTMOST or @ref
+ * HS_FLAG_COMBINATION, and those in which a pattern's matches can come from
+ * more than one engine. When this flag is used with @ref HS_FLAG_SINGLEMATCH
+ * patterns, the one match delivered is not necessarily the earliest.
+ */
+#define HS_MODE_UNORDERED           (1U << 28)
+
+/**
+ * Compiler mode flag: compute start of match lazily.
+ *
+ * By default, patterns compiled with @ref HS_FLAG_SOM_LEFTMOST track the
+ * start of every potential match as they scan, in the engines themselves and
+ * in slots held in scratch and stream state. With this flag, the compiler
+ * instead builds such patterns without start of match tracking wherever it
+ * can, and computes the start of match only when a match is reported, by
+ * running a reverse engine backwards from the end of the match.
+ *
+ * This is usually faster and smaller when matches are rare, but each match
+ * costs a scan back over the data it covers, which is slower when matches
+ * are frequent or long. In block mode, the reverse scan may extend back to
+ * the start of the data. In streaming and vectored modes, it is limited to
+ * the history retained between writes, so patterns whose matches may be
+ * longer than that are compiled as they would be without this flag. The
+ * matches reported are the same with or without this flag.
+ */
+#define HS_MODE_SOM_LAZY            (1U << 29)
+
+/**
+ * Compiler mode flag: record which patterns each part of the database can lead
+ * to.
+ *
+ * The database then carries a table of the patterns that each literal's Rose
+ * programs and each engine serve, which @ref hs_sample_report() uses to charge
+ * sampled scan costs to patterns. Scanning is unaffected, but the database is
+ * larger and takes longer to compile.
+ */
+#define HS_MODE_COST_ATTRIBUTION    (1U << 23)
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Database handle: a database that can be replaced while other threads
+ * scan with it, freeing each old database once nothing can still use it.
+ *
+ * Readers are tracked with two epoch-parity counters per stripe, each stripe
+ * on its own cache line, in the manner of sleepable RCU. A reader reads the
+ * global epoch, increments its stripe's counter for that epoch's parity and
+ * only then loads the current database, so entering and leaving a read-side
+ * section is one atomic add each, on a line that other threads rarely touch.
+ *
+ * A database replaced during epoch E was loaded only by readers that
+ * registered before the replacement. The epoch advances from e to e + 1 only
+ * once no reader is counted under the parity of e + 1 (which is that of
+ * e - 1), so by the time it reaches E + 2 both parities have been seen empty
+ * after the replacement, and every such reader has left. Epochs are only
+ * advanced by the writer side, when a database is replaced or unpinned or an
+ * explicit reclaim is requested, and never by waiting: retired databases
+ * whose readers are still busy are kept for a later attempt.
+ *
+ * Streams outlive read-side sections, so they pin the database they were
+ * opened against instead. A retired database is freed only once it has no
+ * pins as well.
+ */
+#include "hs_runtime.h"
+#include "ue2common.h"
+#include "util/alloc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/** \brief Upper bound on the number of reader stripes in a handle. */
+#define DB_HANDLE_MAX_STRIPES 64
+
+namespace {
+
+/** \brief One cache line of reader counts, indexed by epoch parity. */
+struct alignas(64) ReaderStripe {
+    atomic<size_t> count[2];
+};
+
+/** \brief A database published through a handle. */
+struct DbVersion {
+    explicit DbVersion(hs_database_t *d) : db(d) {}
+    hs_database_t *db;
+    size_t retired = 0; //!< epoch at which it was replaced
+    atomic<size_t> pins{0}; //!< streams still open against it
+};
+
+} // namespace
+
+struct hs_db_handle {
+    hs_db_handle(unsigned int n) : stripes(n), stripe_count(n) {
+        for (unsigned int i = 0; i < n; i++) {
+            stripes[i].count[0].store(0, memory_order_relaxed);
+            stripes[i].count[1].store(0, memory_order_relaxed);
+        }
+    }
+
+    /** \brief Allocated with their alignment, which plain new does not
+     * honour before C++17. */
+    vector<ReaderStripe, ue2::AlignedAllocator<ReaderStripe, 64>> stripes;
+    unsigned int stripe_count; //!< power of two
+
+    atomic<size_t> epoch{0};
+    atomic<DbVersion *> current{nullptr};
+
+    /** \brief Guards the writer side: replacement, epoch advances and the
+     * retired list. */
+    mutex lock;
+    vector<DbVersion *> retired;
+};
+
+namespace {
+
+static
+unsigned int homeStripe(const hs_db_handle *h) {
+    static thread_local size_t home =
+        hash<thread::id>()(this_thread::get_id());
+    return (unsigned int)(home & (h->stripe_count - 1));
+}
+
+static
+size_t readersWithParity(const hs_db_handle *h, u32 parity) {
+    size_t n = 0;
+    for (unsigned int i = 0; i < h->stripe_count; i++) {
+        n += h->stripes[i].count[parity].load(memory_order_seq_cst);
+    }
+    return n;
+}
+
+/** \brief Enters a read-side section, returning the current version and the
+ * token that leaves it. */
+static
+DbVersion *enterReader(hs_db_handle *h, unsigned int *token) {
+    unsigned int stripe = homeStripe(h);
+    u32 parity = (u32)(h->epoch.load(memory_order_seq_cst) & 1);
+    h->stripes[stripe].count[parity].fetch_add(1, memory_order_seq_cst);
+    *token = stripe * 2 + parity;
+    return h->current.load(memory_order_seq_cst);
+}
+
+static
+void leaveReader(hs_db_handle *h, unsigned int token) {
+    h->stripes[token / 2].count[token % 2].fetch_sub(1, memory_order_release);
+}
+
+/** \brief Advances the epoch as far as the readers allow, then frees the
+ * retired versions that are out of reach. Returns the number still retired.
+ * Called with the handle's lock held. */
+static
+size_t reclaim(hs_db_handle *h) {
+    for (u32 i = 0; i < 2 && !h->retired.empty(); i++) {
+        size_t e = h->epoch.load(memory_order_relaxed);
+        if (readersWithParity(h, (u32)((e + 1) & 1))) {
+            break;
+        }
+        h->epoch.store(e + 1, memory_order_seq_cst);
+    }
+
+    const size_t e = h->epoch.load(memory_order_relaxed);
+    auto dead = [e](DbVersion *v) {
+        if (v->retired + 2 > e || v->pins.load(memory_order_acquire)) {
+            return false;
+        }
+        DEBUG_PRINTF("freeing database %p\n", v->db);
+        hs_free_database(v->db);
+        delete v;
+        return true;
+    };
+    h->retired.erase(remove_if(h->retired.begin(), h->retired.end(), dead),
+                     h->retired.end());
+    return h->retired.size();
+}
+
+} // namespace
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_alloc_db_handle(hs_database_t *db, hs_db_handle_t **handle) {
+    if (!db || !handle) {
+        return HS_INVALID;
+    }
+    *handle = nullptr;
+
+    // One stripe per hardware thread, rounded up to a power of two.
+    unsigned int threads = max(thread::hardware_concurrency(), 1U);
+    unsigned int stripes = 1;
+    while (stripes < threads && stripes < DB_HANDLE_MAX_STRIPES) {
+        stripes *= 2;
+    }
+
+    hs_db_handle *h = nullptr;
+    try {
+        h = new hs_db_handle(stripes);
+        h->current = new DbVersion(db);
+    } catch (const bad_alloc &) {
+        delete h;
+        return HS_NOMEM;
+    }
+
+    *handle = h;
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_db_handle_acquire(hs_db_handle_t *handle,
+                                const hs_database_t **db,
+                                unsigned int *token) {
+    if (!handle || !db || !token) {
+        return HS_INVALID;
+    }
+
+    *db = enterReader(handle, token)->db;
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_db_handle_release(hs_db_handle_t *handle, unsigned int token) {
+    if (!handle || token >= handle->stripe_count * 2) {
+        return HS_INVALID;
+    }
+
+    leaveReader(handle, token);
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_db_handle_pin(hs_db_handle_t *handle, const hs_database_t **db) {
+    if (!handle || !db) {
+        return HS_INVALID;
+    }
+
+    // The version cannot be freed while we are inside the read-side section.
+    unsigned int token;
+    DbVersion *v = enterReader(handle, &token);
+    v->pins.fetch_add(1, memory_order_relaxed);
+    leaveReader(handle, token);
+
+    *db = v->db;
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_db_handle_unpin(hs_db_handle_t *handle,
+                              const hs_database_t *db) {
+    if (!handle || !db) {
+        return HS_INVALID;
+    }
+
+    // Pins are only dropped under the lock, so that a version cannot be
+    // freed between finding it and updating its count.
+    lock_guard<mutex> lock(handle->lock);
+    DbVersion *v = handle->current.load(memory_order_acquire);
+    if (v->db != db) {
+        auto it = find_if(handle->retired.begin(), handle->retired.end(),
+                          [db](const DbVersion *r) { return r->db == db; });
+        if (it == handle->retired.end()) {
+            return HS_INVALID;
+        }
+        v = *it;
+    }
+
+    if (!v->pins.load(memory_order_relaxed)) {
+        return HS_INVALID;
+    }
+    v->pins.fetch_sub(1, memory_order_release);
+    if (v != handle->current.load(memory_order_relaxed)) {
+        reclaim(handle);
+    }
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_db_handle_update(hs_db_handle_t *handle, hs_database_t *db) {
+    if (!handle || !db) {
+        return HS_INVALID;
+    }
+
+    DbVersion *v;
+    lock_guard<mutex> lock(handle->lock);
+    try {
+        v = new DbVersion(db);
+        handle->retired.reserve(handle->retired.size() + 1);
+    } catch (const bad_alloc &) {
+        return HS_NOMEM;
+    }
+
+    DbVersion *old = handle->current.exchange(v, memory_order_seq_cst);
+    old->retired = handle->epoch.load(memory_order_seq_cst);
+    handle->retired.push_back(old);
+    DEBUG_PRINTF("retired database %p at epoch %zu\n", old->db,
+                 old->retired);
+    reclaim(handle);
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_db_handle_reclaim(hs_db_handle_t *handle,
+                                unsigned int *pending) {
+    if (!handle) {
+        return HS_INVALID;
+    }
+
+    lock_guard<mutex> lock(handle->lock);
+    size_t left = reclaim(handle);
+    if (pending) {
+        *pending = (unsigned int)left;
+    }
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_free_db_handle(hs_db_handle_t *handle) {
+    if (!handle) {
+        return HS_SUCCESS;
+    }
+
+    for (DbVersion *v : handle->retired) {
+        hs_free_database(v->db);
+        delete v;
+    }
+    DbVersion *v = handle->current.load(memory_order_relaxed);
+    hs_free_database(v->db);
+    delete v;
+    delete handle;
+    return HS_SUCCESS;
+}
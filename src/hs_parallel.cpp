@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Split block mode scanning: hs_scan_parallel() divides one large block
+ * across threads, and hs_scan_multi_db() scans a block against several
+ * databases a cache-sized piece at a time.
+ *
+ * Each piece of the block is scanned as a window that starts
+ * PARALLEL_CONTEXT_BEFORE + maxMatchWidth bytes before the piece (so that any
+ * match ending in the piece starts inside the window, with a byte of
+ * lookbehind for assertions) and ends PARALLEL_CONTEXT_AFTER bytes after it
+ * (so that lookahead assertions see real data and spurious end-anchored
+ * matches fall outside the piece). Only matches ending in the piece are kept.
+ * A start-anchored match cannot begin at the start of a window and still end
+ * in its piece, so anchors need no special handling.
+ */
+#include "hs_runtime.h"
+#include "database.h"
+#include "scratch.h"
+#include "ue2common.h"
+#include "rose/rose_internal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+/** \brief Bytes of data before the earliest possible start of match that
+ * assertions may inspect. */
+static const size_t PARALLEL_CONTEXT_BEFORE = 1;
+
+/** \brief Bytes of data after a piece that assertions may inspect: a '$'
+ * may match before a trailing newline. */
+static const size_t PARALLEL_CONTEXT_AFTER = 2;
+
+/** \brief Smallest piece worth handing to a thread. */
+static const size_t PARALLEL_MIN_CHUNK = 1U << 20;
+
+/** \brief Largest piece; windows must fit in the length taken by hs_scan. */
+static const size_t PARALLEL_MAX_CHUNK = 1U << 30;
+
+/** \brief Pieces per thread, so that uneven match density balances out. */
+static const size_t PARALLEL_CHUNKS_PER_THREAD = 4;
+
+/** \brief Pieces must be this many times longer than the overlap. */
+static const size_t PARALLEL_MIN_OVERLAP_RATIO = 8;
+
+/** \brief Piece size for hs_scan_multi_db(): small enough that a piece stays
+ * in the L2 cache while every database scans it. */
+static const size_t MULTI_DB_CHUNK = 128 * 1024;
+
+struct ParallelMatch {
+    unsigned long long from;
+    unsigned long long to;
+    unsigned int id;
+    unsigned int flags;
+};
+
+struct ParallelChunk {
+    size_t begin = 0; //!< offset of first byte owned by this piece
+    size_t end = 0; //!< offset one past the last byte owned by this piece
+    vector<ParallelMatch> matches;
+    hs_error_t err = HS_SUCCESS;
+    bool done = false;
+};
+
+struct ParallelScan {
+    const hs_database_t *db;
+    const char *data;
+    size_t length;
+    unsigned int flags;
+    size_t overlap;
+    bool want_matches;
+
+    vector<ParallelChunk> chunks;
+    atomic<size_t> next{0}; //!< next unclaimed piece
+    atomic<bool> stop{false}; //!< set when remaining scans are pointless
+    mutex m;
+    condition_variable cv;
+};
+
+struct ChunkContext {
+    ParallelScan *ps;
+    ParallelChunk *chunk;
+    size_t window_begin;
+    bool nomem;
+};
+
+static
+int collectMatch(unsigned int id, unsigned long long from,
+                 unsigned long long to, unsigned int flags, void *ctx) {
+    ChunkContext *cc = (ChunkContext *)ctx;
+    if (cc->ps->stop.load(memory_order_relaxed)) {
+        return 1;
+    }
+
+    to += cc->window_begin;
+    const ParallelChunk &chunk = *cc->chunk;
+    // The first piece owns matches at offset zero.
+    if ((to <= chunk.begin && chunk.begin) || to > chunk.end) {
+        return 0;
+    }
+
+    // A start of match at the start of the window can only belong to a match
+    // ending before this piece, so zero still means "no SOM".
+    if (from) {
+        from += cc->window_begin;
+    }
+    try {
+        cc->chunk->matches.push_back({from, to, id, flags});
+    } catch (const bad_alloc &) {
+        cc->nomem = true;
+        return 1;
+    }
+    return 0;
+}
+
+static
+void scanChunk(ParallelScan &ps, size_t i, hs_scratch_t *scratch) {
+    ParallelChunk &chunk = ps.chunks[i];
+    const size_t before = ps.overlap + PARALLEL_CONTEXT_BEFORE;
+    const size_t window_begin = chunk.begin > before ? chunk.begin - before : 0;
+    const size_t window_end =
+        min(chunk.end + PARALLEL_CONTEXT_AFTER, ps.length);
+    assert(window_end - window_begin <= UINT_MAX);
+
+    ChunkContext cc = {&ps, &chunk, window_begin, false};
+    hs_error_t err = hs_scan(ps.db, ps.data + window_begin,
+                             (unsigned int)(window_end - window_begin),
+                             ps.flags, scratch,
+                             ps.want_matches ? collectMatch : nullptr, &cc);
+    if (cc.nomem) {
+        err = HS_NOMEM;
+    }
+
+    // Matches from one window are in end offset order, except that a report
+    // from an engine caught up late may come out behind a later one.
+    stable_sort(chunk.matches.begin(), chunk.matches.end(),
+                [](const ParallelMatch &a, const ParallelMatch &b) {
+                    return a.to < b.to;
+                });
+
+    lock_guard<mutex> lock(ps.m);
+    chunk.err = err;
+    chunk.done = true;
+    ps.cv.notify_all();
+}
+
+static
+void worker(ParallelScan &ps, hs_scratch_t *scratch) {
+    for (size_t i = ps.next++; i < ps.chunks.size(); i = ps.next++) {
+        if (ps.stop.load(memory_order_relaxed)) {
+            // Still mark the piece done so that the caller never waits on it.
+            lock_guard<mutex> lock(ps.m);
+            ps.chunks[i].done = true;
+            ps.cv.notify_all();
+            continue;
+        }
+        scanChunk(ps, i, scratch);
+    }
+}
+
+/** \brief Returns the maximum match width, or zero if the database cannot be
+ * split. */
+static
+size_t getOverlap(const hs_database_t *db) {
+    if (validDatabase(db) != HS_SUCCESS) {
+        return 0;
+    }
+    const RoseEngine *rose = roseEngineForMode(
+        (const RoseEngine *)hs_get_bytecode(db), HS_MODE_BLOCK);
+    if (rose->mode != HS_MODE_BLOCK || rose->maxMatchWidth == ROSE_BOUND_INF) {
+        return 0;
+    }
+    return max(rose->maxMatchWidth, 1U);
+}
+
+struct MultiDbContext {
+    match_event_handler onEvent;
+    void *context;
+    size_t begin; //!< offset of first byte owned by the current piece
+    size_t end; //!< offset one past the last byte owned by the current piece
+    size_t window_begin;
+};
+
+static
+int forwardMatch(unsigned int id, unsigned long long from,
+                 unsigned long long to, unsigned int flags, void *ctx) {
+    MultiDbContext *mc = (MultiDbContext *)ctx;
+    to += mc->window_begin;
+    if ((to <= mc->begin && mc->begin) || to > mc->end) {
+        return 0;
+    }
+    if (from) {
+        from += mc->window_begin;
+    }
+    return mc->onEvent(id, from, to, flags, mc->context);
+}
+
+static
+hs_error_t scanParallel(ParallelScan &ps, unsigned threads,
+                        hs_scratch_t *scratch, match_event_handler onEvent,
+                        void *context) {
+    vector<hs_scratch_t *> scratches;
+    vector<thread> pool;
+    scratches.reserve(threads);
+    pool.reserve(threads);
+    for (unsigned t = 1; t < threads; t++) {
+        hs_scratch_t *s = nullptr;
+        if (hs_clone_scratch(scratch, &s) != HS_SUCCESS) {
+            break; // make do with the threads we have.
+        }
+        scratches.push_back(s);
+        try {
+            pool.emplace_back(worker, ref(ps), s);
+        } catch (const system_error &) {
+            DEBUG_PRINTF("only started %zu threads\n", pool.size());
+            break;
+        }
+    }
+
+    hs_error_t rv = HS_SUCCESS;
+    for (size_t i = 0; i < ps.chunks.size(); i++) {
+        ParallelChunk &chunk = ps.chunks[i];
+
+        // Scan the piece ourselves if no worker has claimed it yet.
+        size_t expected = i;
+        if (ps.next.compare_exchange_strong(expected, i + 1)) {
+            scanChunk(ps, i, scratch);
+        } else {
+            unique_lock<mutex> lock(ps.m);
+            ps.cv.wait(lock, [&chunk] { return chunk.done; });
+        }
+
+        if (chunk.err != HS_SUCCESS) {
+            rv = chunk.err;
+            break;
+        }
+
+        for (const auto &m : chunk.matches) {
+            if (onEvent(m.id, m.from, m.to, m.flags, context)) {
+                rv = HS_SCAN_TERMINATED;
+                break;
+            }
+        }
+        if (rv != HS_SUCCESS) {
+            break;
+        }
+        vector<ParallelMatch>().swap(chunk.matches);
+    }
+
+    ps.stop = true;
+    for (auto &t : pool) {
+        t.join();
+    }
+    for (auto s : scratches) {
+        hs_free_scratch(s);
+    }
+    return rv;
+}
+
+} // namespace
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scan_parallel(const hs_database_t *db, const char *data,
+                            size_t length, unsigned int flags,
+                            unsigned int num_threads, hs_scratch_t *scratch,
+                            match_event_handler onEvent, void *context) {
+    if (!data || !scratch) {
+        return HS_INVALID;
+    }
+
+    unsigned threads = num_threads;
+    if (!threads) {
+        threads = max(thread::hardware_concurrency(), 1U);
+    }
+
+    // Pick a piece size that gives each thread a few pieces, but is large
+    // enough that the overlap between windows is a small part of the work.
+    const size_t overlap = getOverlap(db);
+    size_t chunk_size = PARALLEL_MAX_CHUNK;
+    if (overlap && overlap <= PARALLEL_MAX_CHUNK / PARALLEL_MIN_OVERLAP_RATIO) {
+        chunk_size = length / ((size_t)threads * PARALLEL_CHUNKS_PER_THREAD);
+        chunk_size = max(chunk_size, PARALLEL_MIN_CHUNK);
+        chunk_size = max(chunk_size, overlap * PARALLEL_MIN_OVERLAP_RATIO);
+        chunk_size = min(chunk_size, PARALLEL_MAX_CHUNK);
+    } else {
+        threads = 1;
+    }
+
+    if (threads == 1 || length <= chunk_size) {
+        if (length > UINT_MAX) {
+            return HS_INVALID;
+        }
+        return hs_scan(db, data, (unsigned int)length, flags, scratch, onEvent,
+                       context);
+    }
+
+    // Pieces collect their matches through a match handler, which a match
+    // buffer attached to the scratch would bypass.
+    if (ISALIGNED_CL(scratch) && scratch->magic == SCRATCH_MAGIC &&
+        scratch->batch.buf) {
+        return HS_INVALID;
+    }
+
+    DEBUG_PRINTF("len=%zu overlap=%zu chunk_size=%zu threads=%u\n", length,
+                 overlap, chunk_size, threads);
+
+    try {
+        ParallelScan ps;
+        ps.db = db;
+        ps.data = data;
+        ps.length = length;
+        ps.flags = flags;
+        ps.overlap = overlap;
+        ps.want_matches = onEvent != nullptr;
+        ps.chunks.resize((length + chunk_size - 1) / chunk_size);
+        for (size_t i = 0; i < ps.chunks.size(); i++) {
+            ps.chunks[i].begin = i * chunk_size;
+            ps.chunks[i].end = min((i + 1) * chunk_size, length);
+        }
+        threads = (unsigned)min((size_t)threads, ps.chunks.size());
+        return scanParallel(ps, threads, scratch, onEvent, context);
+    } catch (const bad_alloc &) {
+        return HS_NOMEM;
+    }
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scan_multi_db(const hs_database_t *const *dbs,
+                            unsigned int count, const char *data,
+                            unsigned int length, unsigned int flags,
+                            hs_scratch_t *scratch, match_event_handler onEvent,
+                            void *const *context) {
+    if (!data || !scratch || (count && !dbs)) {
+        return HS_INVALID;
+    }
+
+    // Check every database up front, so that an error is never returned after
+    // some matches have been delivered.
+    vector<size_t> overlap(count);
+    bool split = false;
+    for (u32 i = 0; i < count; i++) {
+        hs_error_t err = validDatabase(dbs[i]);
+        if (err != HS_SUCCESS) {
+            return err;
+        }
+        const RoseEngine *rose = roseEngineForMode(
+            (const RoseEngine *)hs_get_bytecode(dbs[i]), HS_MODE_BLOCK);
+        if (rose->mode != HS_MODE_BLOCK) {
+            return HS_DB_MODE_ERROR;
+        }
+        err = hs_scratch_compatible(dbs[i], scratch);
+        if (err != HS_SUCCESS) {
+            return err == HS_INSUFFICIENT_SPACE ? HS_INVALID : err;
+        }
+        overlap[i] = getOverlap(dbs[i]);
+        if (overlap[i] * PARALLEL_MIN_OVERLAP_RATIO > MULTI_DB_CHUNK) {
+            overlap[i] = 0;
+        }
+        split |= overlap[i] != 0;
+    }
+
+    // Pieces filter their matches through a match handler, which a match
+    // buffer attached to the scratch would bypass.
+    if (split && length > MULTI_DB_CHUNK && scratch->batch.buf) {
+        return HS_INVALID;
+    }
+
+    // As in hs_scan_batch, termination only affects the database whose
+    // callback requested it.
+    vector<bool> active(count, true);
+    hs_error_t rv = HS_SUCCESS;
+    auto scanned = [&](u32 i, hs_error_t err) {
+        if (err == HS_SCAN_TERMINATED) {
+            active[i] = false;
+            rv = HS_SCAN_TERMINATED;
+            return true;
+        }
+        return err == HS_SUCCESS;
+    };
+
+    // Databases that cannot be split see the whole block in one scan.
+    for (u32 i = 0; i < count; i++) {
+        if (overlap[i] && length > MULTI_DB_CHUNK) {
+            continue;
+        }
+        hs_error_t err = hs_scan(dbs[i], data, length, flags, scratch, onEvent,
+                                 context ? context[i] : nullptr);
+        if (!scanned(i, err)) {
+            return err;
+        }
+        active[i] = false;
+    }
+
+    // The rest take turns on each piece while it is still in cache.
+    for (size_t begin = 0; begin < length; begin += MULTI_DB_CHUNK) {
+        const size_t end = min(begin + MULTI_DB_CHUNK, (size_t)length);
+        for (u32 i = 0; i < count; i++) {
+            if (!active[i]) {
+                continue;
+            }
+            const size_t before = overlap[i] + PARALLEL_CONTEXT_BEFORE;
+            const size_t window_begin = begin > before ? begin - before : 0;
+            const size_t window_end =
+                min(end + PARALLEL_CONTEXT_AFTER, (size_t)length);
+            MultiDbContext mc = {onEvent, context ? context[i] : nullptr,
+                                 begin, end, window_begin};
+            hs_error_t err = hs_scan(dbs[i], data + window_begin,
+                                     (unsigned int)(window_end - window_begin),
+                                     flags, scratch,
+                                     onEvent ? forwardMatch : nullptr, &mc);
+            if (!scanned(i, err)) {
+                return err;
+            }
+        }
+    }
+
+    return rv;
+}
@@ -58,6 +58,62 @@ struct hs_stream;
  */
 typedef struct hs_stream hs_stream_t;
 
+struct hs_stream_pool;
+
+/**
+ * A pool of pre-allocated stream state, as created by @ref
+ * hs_alloc_stream_pool().
+ */
+typedef struct hs_stream_pool hs_stream_pool_t;
+
+struct hs_stream_checkpoint;
+
+/**
+ * A saved position in a stream, which the stream can be rolled back to, as
+ * created by @ref hs_alloc_stream_checkpoint().
+ */
+typedef struct hs_stream_checkpoint hs_stream_checkpoint_t;
+
+struct hs_stream_store;
+
+/**
+ * A store of streams that are compressed while idle, as created by @ref
+ * hs_alloc_stream_store().
+ */
+typedef struct hs_stream_store hs_stream_store_t;
+
+struct hs_transform;
+
+/**
+ * An input normalisation stage applied to stream writes ahead of scanning, as
+ * created by @ref hs_alloc_transform().
+ */
+typedef struct hs_transform hs_transform_t;
+
+struct hs_scratch_pool;
+
+/**
+ * A thread-safe pool of scratch spaces for a database, as created by @ref
+ * hs_alloc_scratch_pool().
+ */
+typedef struct hs_scratch_pool hs_scratch_pool_t;
+
+struct hs_scheduler;
+
+/**
+ * A pool of worker threads that scans block-mode jobs and stream writes, as
+ * created by @ref hs_alloc_scheduler().
+ */
+typedef struct hs_scheduler hs_scheduler_t;
+
+struct hs_db_handle;
+
+/**
+ * A database that can be replaced while other threads scan with it, as
+ * created by @ref hs_alloc_db_handle().
+ */
+typedef struct hs_db_handle hs_db_handle_t;
+
 struct hs_scratch;
 
 /**
@@ -65,6 +121,14 @@ struct hs_scratch;
  */
 typedef struct hs_scratch hs_scratch_t;
 
+struct hs_pattern_mask;
+
+/**
+ * A subset of the patterns in a database whose matches are to be reported, as
+ * created by @ref hs_alloc_pattern_mask().
+ */
+typedef struct hs_pattern_mask hs_pattern_mask_t;
+
 /**
  * Definition of the match event callback function type.
  *
@@ -148,6 +212,117 @@ typedef int (*match_event_handler)(unsigned int id,
 hs_error_t hs_open_stream(const hs_database_t *db, unsigned int flags,
                           hs_stream_t **stream);
 
+/**
+ * Open and initialise a stream, allocating its state with the given allocator
+ * context rather than the allocator set by @ref hs_set_stream_allocator().
+ *
+ * The allocator is recorded in the stream and used to free it in @ref
+ * hs_close_stream(); copies made with @ref hs_copy_stream() are allocated
+ * with it too.
+ *
+ * @param db
+ *      A compiled pattern database.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param allocator
+ *      The allocator context, which must remain valid until the stream (and
+ *      any copy of it) has been closed.
+ *
+ * @param stream
+ *      On success, a pointer to the generated @ref hs_stream_t will be
+ *      returned; NULL on failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the allocation fails,
+ *      other values on failure.
+ */
+hs_error_t hs_open_stream_ex(const hs_database_t *db, unsigned int flags,
+                             const hs_allocator_t *allocator,
+                             hs_stream_t **stream);
+
+/**
+ * Open and initialise a stream in caller-provided memory, without
+ * allocating.
+ *
+ * The stream is used like any other, and is closed with @ref
+ * hs_close_stream(), which does not free the memory; the memory may be reused
+ * or freed by the caller once the stream has been closed. Copies of the stream
+ * made with @ref hs_copy_stream() are allocated with the allocator set by @ref
+ * hs_set_stream_allocator().
+ *
+ * @param db
+ *      A compiled pattern database.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param mem
+ *      The memory to hold the stream, which must be aligned to 8 bytes.
+ *
+ * @param size
+ *      The size of @a mem, which must be at least the size given by @ref
+ *      hs_stream_size() for the database.
+ *
+ * @param stream
+ *      On success, a pointer to the generated @ref hs_stream_t will be
+ *      returned; NULL on failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_INSUFFICIENT_SPACE if @a size is
+ *      too small; @ref HS_BAD_ALIGN if @a mem is not suitably aligned. Other
+ *      errors may be returned if invalid parameters are specified.
+ */
+hs_error_t hs_open_stream_at(const hs_database_t *db, unsigned int flags,
+                             void *mem, size_t size, hs_stream_t **stream);
+
+/**
+ * Open and initialise a stream that coalesces small writes.
+ *
+ * Data written to the stream with @ref hs_scan_stream() or @ref
+ * hs_scan_stream_batch() is held in a buffer of @a threshold bytes kept with
+ * the stream, and the buffer is scanned in one go when it fills, when a write
+ * does not fit in it, when @ref hs_flush_stream() is called, or when the
+ * stream is closed or reset. Writes of @a threshold bytes or more are scanned
+ * at once, after any buffered data. This makes a run of very small writes
+ * much cheaper to scan.
+ *
+ * The matches are the same, at the same offsets, as for a stream opened with
+ * @ref hs_open_stream(), but they are reported when the data is scanned,
+ * through the callback and context of the call that scans it. Applications
+ * that need matches within a bounded time should call @ref hs_flush_stream()
+ * when that time expires.
+ *
+ * Copies made with @ref hs_copy_stream() coalesce writes in the same way. A
+ * stream with buffered data may not be compressed, serialized or
+ * checkpointed; flush it first.
+ *
+ * @param db
+ *      A compiled pattern database.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param threshold
+ *      The number of bytes to buffer. If zero, writes are never buffered and
+ *      the stream behaves as one opened with @ref hs_open_stream().
+ *
+ * @param stream
+ *      On success, a pointer to the generated @ref hs_stream_t will be
+ *      returned; NULL on failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the allocation fails,
+ *      other values on failure.
+ */
+hs_error_t hs_open_stream_coalesced(const hs_database_t *db,
+                                    unsigned int flags, unsigned int threshold,
+                                    hs_stream_t **stream);
+
 /**
  * Write data to be scanned to the opened stream.
  *
@@ -190,6 +365,263 @@ hs_error_t hs_scan_stream(hs_stream_t *id, const char *data,
                           hs_scratch_t *scratch, match_event_handler onEvent,
                           void *ctxt);
 
+/**
+ * Start loading a stream's state into the cache ahead of its next write.
+ *
+ * The state of a stream that has not been written to recently is usually not
+ * in the cache, and @ref hs_scan_stream() stalls while it is loaded. An
+ * application that knows which stream it will write to next can call this
+ * function first, and do other work, such as scanning another stream, while
+ * the state is loaded. This function issues prefetches for the parts of the
+ * stream state touched by most writes and for the start of the bytecode that
+ * runs on every write, and returns without waiting for them.
+ *
+ * Only the stream header is read, and nothing is written; matching is not
+ * affected. It is safe to call this function on a stream that another thread
+ * is scanning.
+ *
+ * @param id
+ *      The stream ID (returned by @ref hs_open_stream()) to be prefetched.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_prefetch_stream(const hs_stream_t *id);
+
+/**
+ * Write data to be scanned to the opened stream, scanning at most a given
+ * number of bytes.
+ *
+ * This behaves as @ref hs_scan_stream(), except that it stops after scanning
+ * @a budget bytes of the data. If it stops before the end of the data, it
+ * returns @ref HS_SCAN_YIELD, and the caller should later resume the scan by
+ * calling this function (or @ref hs_scan_stream()) again with the data that
+ * has not been consumed. Because the progress of the scan is kept in the
+ * stream state, any scratch space may be used to resume it, and the matches
+ * reported are the same as those from a single call to @ref hs_scan_stream()
+ * over all of the data.
+ *
+ * This allows applications such as event loops to bound the time spent in any
+ * one call.
+ *
+ * @param id
+ *      The stream ID (returned by @ref hs_open_stream()) to which the data
+ *      will be written.
+ *
+ * @param data
+ *      Pointer to the data to be scanned.
+ *
+ * @param length
+ *      The number of bytes of data available.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param budget
+ *      The maximum number of bytes to scan in this call. Must be non-zero.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch().
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param ctxt
+ *      The user defined pointer which will be passed to the callback function
+ *      when a match occurs.
+ *
+ * @param consumed
+ *      On return, the number of bytes at the start of @a data that have been
+ *      scanned.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS if all of the data was scanned; @ref
+ *      HS_SCAN_YIELD if the budget was reached first; @ref HS_SCAN_TERMINATED
+ *      if the match callback indicated that scanning should stop; other values
+ *      on error.
+ */
+hs_error_t hs_scan_stream_partial(hs_stream_t *id, const char *data,
+                                  unsigned int length, unsigned int flags,
+                                  unsigned int budget, hs_scratch_t *scratch,
+                                  match_event_handler onEvent, void *ctxt,
+                                  unsigned int *consumed);
+
+/**
+ * Write data to several open streams in a single call.
+ *
+ * Each element of the batch is scanned exactly as it would be by @ref
+ * hs_scan_stream(), in order, using the one scratch space. The streams may
+ * belong to different databases, provided the scratch space is valid for all
+ * of them. Amortising the argument checks and prefetching the state of each
+ * stream before it is scanned makes this faster than separate calls when
+ * writing small amounts of data to many streams.
+ *
+ * @param ids
+ *      An array of stream IDs, as returned by @ref hs_open_stream(). A stream
+ *      should not appear more than once in the array.
+ *
+ * @param data
+ *      An array of pointers to the data to be written to each stream.
+ *
+ * @param length
+ *      An array of lengths (in bytes) of the data for each stream.
+ *
+ * @param count
+ *      Number of streams to write to. This should correspond to the size of
+ *      the @a ids, @a data and @a length arrays.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch().
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      An array of user defined pointers, one per stream, which will be passed
+ *      to the callback function for matches in that stream. If a NULL pointer
+ *      is given, a NULL context will be passed for every stream.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
+ *      match callback indicated that scanning should stop for one or more
+ *      streams; other values on error. Terminating one stream does not prevent
+ *      the remaining streams in the batch from being scanned.
+ */
+hs_error_t hs_scan_stream_batch(hs_stream_t *const *ids,
+                                const char *const *data,
+                                const unsigned int *length, unsigned int count,
+                                unsigned int flags, hs_scratch_t *scratch,
+                                match_event_handler onEvent,
+                                void *const *context);
+
+/**
+ * Write an array of data segments to an open stream as a single write.
+ *
+ * This is equivalent to writing the concatenation of the segments with @ref
+ * hs_scan_stream(), without the caller having to copy them together. The
+ * segments are gathered into a staging buffer in the scratch space when they
+ * fit, so that the stream history and the state of the matching engines are
+ * updated once for the whole write rather than once per segment; larger
+ * segments are scanned in place.
+ *
+ * @param id
+ *      The stream ID (returned by @ref hs_open_stream()) to which the data
+ *      will be written.
+ *
+ * @param data
+ *      An array of pointers to the data segments to be scanned.
+ *
+ * @param length
+ *      An array of lengths (in bytes) of each data segment to scan.
+ *
+ * @param count
+ *      Number of data segments to scan. This should correspond to the size of
+ *      the @a data and @a length arrays.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch().
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param ctxt
+ *      The user defined pointer which will be passed to the callback function
+ *      when a match occurs.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
+ *      match callback indicated that scanning should stop; other values on
+ *      error.
+ */
+hs_error_t hs_scan_stream_vector(hs_stream_t *id, const char *const *data,
+                                 const unsigned int *length,
+                                 unsigned int count, unsigned int flags,
+                                 hs_scratch_t *scratch,
+                                 match_event_handler onEvent, void *ctxt);
+
+/**
+ * Scan any data buffered by a stream opened with @ref
+ * hs_open_stream_coalesced().
+ *
+ * Matches in the buffered data are reported to the callback given here. For
+ * other streams, and for streams with nothing buffered, this does nothing.
+ *
+ * @param id
+ *      The stream ID (returned by @ref hs_open_stream_coalesced()) to flush.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch().
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param ctxt
+ *      The user defined pointer which will be passed to the callback function
+ *      when a match occurs.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
+ *      match callback indicated that scanning should stop; other values on
+ *      error.
+ */
+hs_error_t hs_flush_stream(hs_stream_t *id, unsigned int flags,
+                           hs_scratch_t *scratch, match_event_handler onEvent,
+                           void *ctxt);
+
+/**
+ * Restrict the matches reported by a stream to a window of stream offsets.
+ *
+ * Only matches whose end offsets lie between @p min_offset and @p max_offset
+ * inclusive are reported, in the same way as the `min_offset` and
+ * `max_offset` extended parameters (see @ref hs_expr_ext_t) but for every
+ * pattern and chosen at run time, so that one database can serve many
+ * windows.
+ *
+ * Once the stream has been written past @p max_offset it is not scanned any
+ * further: the rest of any write that crosses the end of the window is
+ * skipped, and later writes return immediately. Data skipped in this way is
+ * never scanned, so moving the window later on does not bring it back.
+ * Matches before @p min_offset are suppressed but the data is still scanned,
+ * since it may begin matches that end inside the window.
+ *
+ * The window applies to all data scanned after this call, including data
+ * already buffered by a stream opened with @ref hs_open_stream_coalesced().
+ * It is kept by @ref hs_copy_stream() and @ref hs_compress_stream(), and
+ * cleared when the stream is reset.
+ *
+ * @param id
+ *      The stream ID (returned by @ref hs_open_stream()).
+ *
+ * @param min_offset
+ *      The smallest end offset of a match to report.
+ *
+ * @param max_offset
+ *      The largest end offset of a match to report. Must be no smaller than
+ *      @p min_offset.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_set_stream_window(hs_stream_t *id, unsigned long long min_offset,
+                                unsigned long long max_offset);
+
 /**
  * Close a stream.
  *
@@ -242,6 +674,10 @@ hs_error_t hs_close_stream(hs_stream_t *id, hs_scratch_t *scratch,
  *
  * Note: the stream will also be tied to the same database.
  *
+ * Only the parts of the stream state written since the stream was opened or
+ * last reset are reinitialised, so resetting a stream that has seen little
+ * or no data is cheap.
+ *
  * @param id
  *      The stream (as created by @ref hs_open_stream()) to be replaced.
  *
@@ -292,6 +728,11 @@ hs_error_t hs_copy_stream(hs_stream_t **to_id, const hs_stream_t *from_id);
  * Note: the 'to' stream and the 'from' stream must be open against the same
  * database.
  *
+ * If the 'from' stream has not been written to since it was opened or reset,
+ * it acts as a snapshot of a freshly opened stream: only the parts of the
+ * 'to' stream that have been written are restored, and a 'to' stream that
+ * has not been written needs no work at all.
+ *
  * @param to_id
  *      On success, a pointer to the new, copied @ref hs_stream_t will be
  *      returned; NULL on failure.
@@ -321,166 +762,2598 @@ hs_error_t hs_reset_and_copy_stream(hs_stream_t *to_id,
                                     void *context);
 
 /**
- * The block (non-streaming) regular expression scanner.
+ * Allocate a pool of stream state for a streaming database.
  *
- * This is the function call in which the actual pattern matching takes place
- * for block-mode pattern databases.
+ * The pool holds space for @a count streams in a single cache-line aligned
+ * allocation, which is made with the stream allocator set by @ref
+ * hs_set_stream_allocator() or @ref hs_set_allocator(). Streams can then be
+ * opened from the pool with @ref hs_open_stream_from_pool() and returned to it
+ * with @ref hs_close_stream_to_pool() without any further calls to the
+ * allocator.
  *
- * @param db
- *      A compiled pattern database.
+ * A stream pool is not thread-safe: like scratch space, each pool should be
+ * used by only one thread at a time. Applications that open streams from many
+ * threads should allocate a pool per thread. Streams opened from a pool may be
+ * used with all the other stream calls, except that they must not be passed
+ * to @ref hs_close_stream().
  *
- * @param data
- *      Pointer to the data to be scanned.
+ * @param db
+ *      A compiled pattern database, which must be in streaming mode.
  *
- * @param length
- *      The number of bytes to scan.
+ * @param count
+ *      The number of streams the pool can hold. Must be non-zero.
  *
- * @param flags
- *      Flags modifying the behaviour of this function. This parameter is
- *      provided for future use and is unused at present.
+ * @param pool
+ *      On success, a pointer to the new @ref hs_stream_pool_t will be
+ *      returned; NULL on failure.
  *
- * @param scratch
- *      A per-thread scratch space allocated by @ref hs_alloc_scratch() for this
- *      database.
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the allocation fails,
+ *      other values on failure.
+ */
+hs_error_t hs_alloc_stream_pool(const hs_database_t *db, unsigned int count,
+                                hs_stream_pool_t **pool);
+
+/**
+ * Free a stream pool allocated by @ref hs_alloc_stream_pool().
  *
- * @param onEvent
- *      Pointer to a match event callback function. If a NULL pointer is given,
- *      no matches will be returned.
+ * Any streams still open from the pool are freed with it, and must not be
+ * used afterwards.
  *
- * @param context
- *      The user defined pointer which will be passed to the callback function.
+ * @param pool
+ *      The stream pool to free. If NULL, no action is taken.
  *
  * @return
- *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
- *      match callback indicated that scanning should stop; other values on
- *      error.
+ *      @ref HS_SUCCESS on success, other values on failure.
  */
-hs_error_t hs_scan(const hs_database_t *db, const char *data,
-                   unsigned int length, unsigned int flags,
-                   hs_scratch_t *scratch, match_event_handler onEvent,
-                   void *context);
+hs_error_t hs_free_stream_pool(hs_stream_pool_t *pool);
 
 /**
- * The vectored regular expression scanner.
+ * Provides the size of the given stream pool, including the stream state for
+ * all of its streams.
  *
- * This is the function call in which the actual pattern matching takes place
- * for vectoring-mode pattern databases.
+ * @param pool
+ *      A stream pool allocated by @ref hs_alloc_stream_pool().
  *
- * @param db
- *      A compiled pattern database.
+ * @param pool_size
+ *      On success, the size of the stream pool in bytes is placed in this
+ *      parameter.
  *
- * @param data
- *      An array of pointers to the data blocks to be scanned.
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_stream_pool_size(const hs_stream_pool_t *pool,
+                               size_t *pool_size);
+
+/**
+ * Open and initialise a stream using state from a stream pool.
  *
- * @param length
- *      An array of lengths (in bytes) of each data block to scan.
+ * This is equivalent to @ref hs_open_stream() against the pool's database,
+ * but does not call the stream allocator.
+ *
+ * @param pool
+ *      A stream pool allocated by @ref hs_alloc_stream_pool().
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param stream
+ *      On success, a pointer to the opened @ref hs_stream_t will be returned;
+ *      NULL on failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the pool has no free
+ *      streams, other values on failure.
+ */
+hs_error_t hs_open_stream_from_pool(hs_stream_pool_t *pool, unsigned int flags,
+                                    hs_stream_t **stream);
+
+/**
+ * Open and initialise several streams at once using state from a stream
+ * pool.
+ *
+ * Either all @a count streams are opened, or none are.
+ *
+ * @param pool
+ *      A stream pool allocated by @ref hs_alloc_stream_pool().
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the streams. This parameter is
+ *      provided for future use and is unused at present.
  *
  * @param count
- *      Number of data blocks to scan. This should correspond to the size of
- *      of the @a data and @a length arrays.
+ *      The number of streams to open.
+ *
+ * @param streams
+ *      An array of @a count stream pointers, which will be filled in with the
+ *      opened streams on success.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the pool has fewer than
+ *      @a count free streams, other values on failure.
+ */
+hs_error_t hs_open_stream_bulk(hs_stream_pool_t *pool, unsigned int flags,
+                               unsigned int count, hs_stream_t **streams);
+
+/**
+ * Close a stream opened with @ref hs_open_stream_from_pool() or @ref
+ * hs_open_stream_bulk(), returning its state to the pool.
+ *
+ * Any matches at end of data are reported exactly as they would be by @ref
+ * hs_close_stream().
+ *
+ * @param pool
+ *      The stream pool that the stream was opened from.
+ *
+ * @param id
+ *      The stream to close.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch(). This is
+ *      allowed to be NULL only if the @a onEvent callback is also NULL.
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function
+ *      when a match occurs.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure. @ref HS_INVALID is
+ *      returned if the stream was not opened from this pool.
+ */
+hs_error_t hs_close_stream_to_pool(hs_stream_pool_t *pool, hs_stream_t *id,
+                                   hs_scratch_t *scratch,
+                                   match_event_handler onEvent, void *context);
+
+/**
+ * Reset several streams to their initial state.
+ *
+ * This is equivalent to calling @ref hs_reset_stream() on each stream in turn,
+ * but validates the scratch space only once. End of data matches for each
+ * stream are reported to the callback with that stream's context pointer.
+ *
+ * The streams need not have been opened from a stream pool, but must all have
+ * been opened against the same database.
+ *
+ * @param ids
+ *      An array of @a count streams to reset.
+ *
+ * @param count
+ *      The number of streams to reset.
  *
  * @param flags
- *      Flags modifying the behaviour of this function. This parameter is
+ *      Flags modifying the behaviour of the streams. This parameter is
  *      provided for future use and is unused at present.
  *
  * @param scratch
- *      A per-thread scratch space allocated by @ref hs_alloc_scratch() for
- *      this database.
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch(). This is
+ *      allowed to be NULL only if the @a onEvent callback is also NULL.
  *
  * @param onEvent
  *      Pointer to a match event callback function. If a NULL pointer is given,
  *      no matches will be returned.
  *
  * @param context
- *      The user defined pointer which will be passed to the callback function.
+ *      An array of @a count user defined pointers, one per stream, which will
+ *      be passed to the callback function when a match occurs. May be NULL,
+ *      in which case NULL is passed to the callback.
  *
  * @return
- *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the match
- *      callback indicated that scanning should stop; other values on error.
+ *      @ref HS_SUCCESS on success, other values on failure.
  */
-hs_error_t hs_scan_vector(const hs_database_t *db, const char *const *data,
-                          const unsigned int *length, unsigned int count,
-                          unsigned int flags, hs_scratch_t *scratch,
-                          match_event_handler onEvent, void *context);
+hs_error_t hs_reset_stream_bulk(hs_stream_t *const *ids, unsigned int count,
+                                unsigned int flags, hs_scratch_t *scratch,
+                                match_event_handler onEvent,
+                                void *const *context);
 
 /**
- * Allocate a "scratch" space for use by Hyperscan.
+ * Creates a compressed representation of the provided stream in the buffer
+ * provided. This compressed representation can be converted back into a
+ * stream state by using @ref hs_expand_stream() or @ref
+ * hs_reset_and_expand_stream(). The size of the compressed representation
+ * will be placed into @a used_space.
  *
- * This is required for runtime use, and one scratch space per thread, or
- * concurrent caller, is required. Any allocator callback set by @ref
- * hs_set_scratch_allocator() or @ref hs_set_allocator() will be used by this
- * function.
+ * Only the parts of the stream state that are currently live are stored, so
+ * the compressed representation of a stream is usually much smaller than the
+ * size reported by @ref hs_stream_size(), and varies as the stream is scanned.
+ *
+ * If there is not sufficient space in the buffer to hold the compressed
+ * representation, @ref HS_INSUFFICIENT_SPACE will be returned and @a
+ * used_space will be populated with the amount of space required.
+ *
+ * Note: this function does not close the provided stream, you may continue to
+ * use the stream or to free it with @ref hs_close_stream().
+ *
+ * @param stream
+ *      The stream (as created by @ref hs_open_stream()) to be compressed.
+ *
+ * @param buf
+ *      Buffer to write the compressed representation into. Note: if the call
+ *      is just being used to determine the amount of space required, it is
+ *      allowed to pass NULL here and @a buf_space as 0.
+ *
+ * @param buf_space
+ *      The number of bytes in @a buf. If buf_space is too small, the call will
+ *      fail with @ref HS_INSUFFICIENT_SPACE.
+ *
+ * @param used_space
+ *      Pointer to where the amount of used space will be written to. The used
+ *      buffer space is always less than or equal to @a buf_space. If the call
+ *      fails with @ref HS_INSUFFICIENT_SPACE, this pointer will be used to
+ *      write out the amount of buffer space required.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_INSUFFICIENT_SPACE if the provided
+ *      buffer is too small.
+ */
+hs_error_t hs_compress_stream(const hs_stream_t *stream, char *buf,
+                              size_t buf_space, size_t *used_space);
+
+/**
+ * Decompresses a compressed representation created by @ref
+ * hs_compress_stream() into a new stream.
+ *
+ * Note: @a buf must correspond to a complete compressed representation
+ * created by @ref hs_compress_stream() of a stream that was opened against
+ * @a db. It is not always possible to detect misuse of this API and behaviour
+ * is undefined if these properties are not satisfied.
  *
  * @param db
- *      The database, as produced by @ref hs_compile().
+ *      The compiled pattern database that the compressed stream was opened
+ *      against.
+ *
+ * @param stream
+ *      On success, a pointer to the expanded @ref hs_stream_t will be
+ *      returned; NULL on failure.
+ *
+ * @param buf
+ *      A compressed representation of a stream. These compressed forms are
+ *      created by @ref hs_compress_stream().
+ *
+ * @param buf_size
+ *      The size in bytes of the compressed representation.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_expand_stream(const hs_database_t *db, hs_stream_t **stream,
+                            const char *buf, size_t buf_size);
+
+/**
+ * Decompresses a compressed representation created by @ref
+ * hs_compress_stream() on top of the 'to' stream. The 'to' stream will first
+ * be reset (reporting any EOD matches if a non-NULL @a onEvent callback
+ * handler is provided).
+ *
+ * Note: the 'to' stream must be opened against the same database as the
+ * compressed stream.
+ *
+ * Note: @a buf must correspond to a complete compressed representation
+ * created by @ref hs_compress_stream() of a stream that was opened against
+ * the same database as the 'to' stream. It is not always possible to detect
+ * misuse of this API and behaviour is undefined if these properties are not
+ * satisfied.
+ *
+ * @param to_stream
+ *      A pointer to a valid stream state. A pointer to the expanded @ref
+ *      hs_stream_t will be returned; NULL on failure.
+ *
+ * @param buf
+ *      A compressed representation of a stream. These compressed forms are
+ *      created by @ref hs_compress_stream().
+ *
+ * @param buf_size
+ *      The size in bytes of the compressed representation.
  *
  * @param scratch
- *      On first allocation, a pointer to NULL should be provided so a new
- *      scratch can be allocated. If a scratch block has been previously
- *      allocated, then a pointer to it should be passed back in to see if it
- *      is valid for this database block. If a new scratch block is required,
- *      the original will be freed and the new one returned, otherwise the
- *      previous scratch block will be returned. On success, the scratch block
- *      will be suitable for use with the provided database in addition to any
- *      databases that original scratch space was suitable for.
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch(). This is
+ *      allowed to be NULL only if the @a onEvent callback is also NULL.
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function
+ *      when a match occurs.
  *
  * @return
- *      @ref HS_SUCCESS on successful allocation; @ref HS_NOMEM if the
- *      allocation fails.  Other errors may be returned if invalid parameters
- *      are specified.
+ *      @ref HS_SUCCESS on success, other values on failure.
  */
-hs_error_t hs_alloc_scratch(const hs_database_t *db, hs_scratch_t **scratch);
+hs_error_t hs_reset_and_expand_stream(hs_stream_t *to_stream,
+                                      const char *buf, size_t buf_size,
+                                      hs_scratch_t *scratch,
+                                      match_event_handler onEvent,
+                                      void *context);
 
 /**
- * Allocate a scratch space that is a clone of an existing scratch space.
+ * Serializes a stream into a form that can be carried to another process or
+ * node and deserialized there with @ref hs_deserialize_stream(), for instance
+ * to migrate in-flight flows when traffic is rebalanced.
  *
- * This is useful when multiple concurrent threads will be using the same set
- * of compiled databases, and another scratch space is required. Any allocator
- * callback set by @ref hs_set_scratch_allocator() or @ref hs_set_allocator()
- * will be used by this function.
+ * The serialized form is the compressed representation made by @ref
+ * hs_compress_stream(), which refers to nothing in the address space of the
+ * process that made it, behind a small header that records the CRC of the
+ * database. It can only be deserialized against a database with the same CRC,
+ * such as a copy of @a db made with @ref hs_serialize_database() and @ref
+ * hs_deserialize_database(), by a library of the same version.
  *
- * @param src
- *      The existing @ref hs_scratch_t to be cloned.
+ * As with @ref hs_compress_stream(), if there is not sufficient space in the
+ * buffer, @ref HS_INSUFFICIENT_SPACE will be returned and @a used_space will
+ * be populated with the amount of space required. The stream is not changed.
  *
- * @param dest
- *      A pointer to the new scratch space will be returned here.
+ * @param db
+ *      The compiled pattern database that the stream was opened against.
+ *
+ * @param stream
+ *      The stream to be serialized.
+ *
+ * @param buf
+ *      Buffer to write the serialized stream into. If the call is just being
+ *      used to determine the amount of space required, it is allowed to pass
+ *      NULL here and @a buf_space as 0.
+ *
+ * @param buf_space
+ *      The number of bytes in @a buf.
+ *
+ * @param used_space
+ *      Pointer to where the amount of used space will be written to, or the
+ *      amount of space required if the call fails with @ref
+ *      HS_INSUFFICIENT_SPACE.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_INSUFFICIENT_SPACE if the provided
+ *      buffer is too small, @ref HS_INVALID if the stream was not opened
+ *      against @a db, other values on failure.
+ */
+hs_error_t hs_serialize_stream(const hs_database_t *db,
+                               const hs_stream_t *stream, char *buf,
+                               size_t buf_space, size_t *used_space);
+
+/**
+ * Recreates a stream serialized with @ref hs_serialize_stream() as a new
+ * stream, allocated with the stream allocator.
+ *
+ * Scanning the new stream gives the same matches as scanning the original
+ * stream would have.
+ *
+ * @param db
+ *      A compiled pattern database with the same CRC as the one the stream
+ *      was serialized against.
+ *
+ * @param buf
+ *      A serialized stream, as created by @ref hs_serialize_stream().
+ *
+ * @param buf_size
+ *      The size in bytes of the serialized stream.
+ *
+ * @param stream
+ *      On success, a pointer to the new @ref hs_stream_t will be returned;
+ *      NULL on failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_INVALID if the buffer is not a
+ *      serialized stream or was serialized against a different database, @ref
+ *      HS_DB_VERSION_ERROR if it was written by a different version of the
+ *      library, other values on failure.
+ */
+hs_error_t hs_deserialize_stream(const hs_database_t *db, const char *buf,
+                                 size_t buf_size, hs_stream_t **stream);
+
+/**
+ * Allocate a stream checkpoint for streams opened against a database.
+ *
+ * A checkpoint records the state of a stream so that the stream can later be
+ * rolled back to it, for instance to rescan data after out-of-order segments
+ * have been repaired. Unlike a copy made with @ref hs_copy_stream(), a
+ * checkpoint holds only the live parts of the stream state, in the form used
+ * by @ref hs_compress_stream(), and is reused from one checkpoint to the next
+ * without further allocation in the common case. This makes frequent
+ * checkpoints affordable.
+ *
+ * @param db
+ *      A streaming mode database, as produced by @ref hs_compile().
+ *
+ * @param checkpoint
+ *      On success, a pointer to the new @ref hs_stream_checkpoint_t will be
+ *      returned here.
  *
  * @return
  *      @ref HS_SUCCESS on success; @ref HS_NOMEM if the allocation fails.
  *      Other errors may be returned if invalid parameters are specified.
  */
-hs_error_t hs_clone_scratch(const hs_scratch_t *src, hs_scratch_t **dest);
+hs_error_t hs_alloc_stream_checkpoint(const hs_database_t *db,
+                                      hs_stream_checkpoint_t **checkpoint);
 
 /**
- * Provides the size of the given scratch space.
+ * Record the current state of a stream in a checkpoint, replacing anything
+ * previously recorded in it.
  *
- * @param scratch
- *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
- *      hs_clone_scratch().
+ * @param id
+ *      The stream, which must have been opened against the database the
+ *      checkpoint was allocated for.
  *
- * @param scratch_size
- *      On success, the size of the scratch space in bytes is placed in this
- *      parameter.
+ * @param checkpoint
+ *      The checkpoint to record the stream's state in.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if the checkpoint had to grow
+ *      and the allocation failed, in which case the checkpoint is left empty.
+ *      Other errors may be returned if invalid parameters are specified.
+ */
+hs_error_t hs_checkpoint_stream(const hs_stream_t *id,
+                                hs_stream_checkpoint_t *checkpoint);
+
+/**
+ * Roll a stream back to the state recorded in a checkpoint.
+ *
+ * Any data scanned since the checkpoint was taken is forgotten, including its
+ * effect on the stream's history; no matches are raised. The checkpoint is
+ * not consumed, so a stream may be rolled back to it more than once. It need
+ * not have been taken from the same stream, as long as both belong to the
+ * same database.
+ *
+ * @param id
+ *      The stream to roll back.
+ *
+ * @param checkpoint
+ *      A checkpoint recorded by @ref hs_checkpoint_stream().
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_INVALID if the checkpoint is empty
+ *      or belongs to another database, or other invalid parameters are
+ *      specified.
+ */
+hs_error_t hs_rollback_stream(hs_stream_t *id,
+                              const hs_stream_checkpoint_t *checkpoint);
+
+/**
+ * Free a stream checkpoint.
+ *
+ * @param checkpoint
+ *      The checkpoint to be freed. NULL may also be safely provided.
  *
  * @return
  *      @ref HS_SUCCESS on success, other values on failure.
  */
-hs_error_t hs_scratch_size(const hs_scratch_t *scratch, size_t *scratch_size);
+hs_error_t hs_free_stream_checkpoint(hs_stream_checkpoint_t *checkpoint);
 
 /**
- * Free a scratch block previously allocated by @ref hs_alloc_scratch() or @ref
- * hs_clone_scratch().
+ * Allocate a tiered stream store for a database.
  *
- * The free callback set by @ref hs_set_scratch_allocator() or @ref
- * hs_set_allocator() will be used by this function.
+ * A stream store holds one stream per flow, identified by a flow number
+ * rather than by a stream pointer, and keeps only recently used streams
+ * resident. Streams live in one of three tiers:
  *
- * @param scratch
- *      The scratch block to be freed. NULL may also be safely provided.
+ *  - hot: resident, and opened or scanned since the last call to @ref
+ *    hs_store_compact();
+ *  - warm: resident, but idle since the last call to @ref hs_store_compact();
+ *  - cold: compressed as by @ref hs_compress_stream() into an arena that is
+ *    grown and shrunk with the live data.
+ *
+ * Calls to @ref hs_store_compact() move streams that have been idle for long
+ * enough to the cold tier. If all resident slots are taken when a flow is
+ * opened or a cold flow is scanned, a warm stream (or, failing that, a hot
+ * one) is compressed to make room. Scanning a cold flow expands it again, so
+ * an application sees the same matches as it would with ordinary streams.
+ *
+ * The store and its streams are allocated with the stream allocator (see @ref
+ * hs_set_stream_allocator()). A store must be used by only one thread at a
+ * time.
+ *
+ * @param db
+ *      A compiled pattern database, which must be in streaming mode.
+ *
+ * @param hot_count
+ *      The number of streams that may be resident at once. Must be non-zero.
+ *
+ * @param store
+ *      On success, a pointer to the new @ref hs_stream_store_t will be
+ *      returned; NULL on failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the allocation fails,
+ *      other values on failure.
+ */
+hs_error_t hs_alloc_stream_store(const hs_database_t *db,
+                                 unsigned int hot_count,
+                                 hs_stream_store_t **store);
+
+/**
+ * Free a stream store allocated by @ref hs_alloc_stream_store(), along with
+ * all of the flows still open in it.
+ *
+ * @param store
+ *      The stream store to free. If NULL, no action is taken.
  *
  * @return
  *      @ref HS_SUCCESS on success, other values on failure.
  */
-hs_error_t hs_free_scratch(hs_scratch_t *scratch);
+hs_error_t hs_free_stream_store(hs_stream_store_t *store);
+
+/**
+ * Open and initialise a stream in a stream store.
+ *
+ * @param store
+ *      A stream store allocated by @ref hs_alloc_stream_store().
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param flow
+ *      On success, the number of the new flow is written here. Flow numbers
+ *      of closed flows are reused.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if an allocation fails,
+ *      other values on failure.
+ */
+hs_error_t hs_store_open_stream(hs_stream_store_t *store, unsigned int flags,
+                                unsigned int *flow);
+
+/**
+ * Write data to a flow in a stream store, as for @ref hs_scan_stream().
+ *
+ * If the flow's stream is cold, it is expanded first.
+ *
+ * @param store
+ *      A stream store allocated by @ref hs_alloc_stream_store().
+ *
+ * @param flow
+ *      A flow opened with @ref hs_store_open_stream().
+ *
+ * @param data
+ *      Pointer to the data to be scanned.
+ *
+ * @param length
+ *      The number of bytes to scan.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of the stream. This parameter is provided
+ *      for future use and is unused at present.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch().
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function
+ *      when a match occurs.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
+ *      match callback indicated that scanning should stop; @ref HS_INVALID if
+ *      the flow is not open; other values on error.
+ */
+hs_error_t hs_store_scan_stream(hs_stream_store_t *store, unsigned int flow,
+                                const char *data, unsigned int length,
+                                unsigned int flags, hs_scratch_t *scratch,
+                                match_event_handler onEvent, void *context);
+
+/**
+ * Close a flow in a stream store, as for @ref hs_close_stream().
+ *
+ * If the flow's stream is cold and a callback is given, it is expanded to
+ * report any matches at end of data; otherwise it is simply discarded.
+ *
+ * @param store
+ *      A stream store allocated by @ref hs_alloc_stream_store().
+ *
+ * @param flow
+ *      A flow opened with @ref hs_store_open_stream().
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch(). This is
+ *      allowed to be NULL only if the @a onEvent callback is also NULL.
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function
+ *      when a match occurs.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_INVALID if the flow is not open,
+ *      other values on failure.
+ */
+hs_error_t hs_store_close_stream(hs_stream_store_t *store, unsigned int flow,
+                                 hs_scratch_t *scratch,
+                                 match_event_handler onEvent, void *context);
+
+/**
+ * Compress idle streams in a stream store.
+ *
+ * Hyperscan creates no threads of its own, so this is the store's background
+ * pass: the thread that owns the store should call it periodically, for
+ * instance on a timer or every so many packets. Each call ends a period of
+ * the store's clock.
+ *
+ * Resident streams that have not been scanned for @a idle_limit whole periods
+ * are compressed into the arena and their state released. Space held by
+ * expanded or closed flows is reclaimed, and the arena is shrunk once it is
+ * mostly empty.
+ *
+ * @param store
+ *      A stream store allocated by @ref hs_alloc_stream_store().
+ *
+ * @param idle_limit
+ *      The number of periods a stream must have been idle for to be
+ *      compressed. With 1, warm streams are compressed; with 0, all resident
+ *      streams are.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the arena could not be
+ *      grown, other values on failure.
+ */
+hs_error_t hs_store_compact(hs_stream_store_t *store, unsigned int idle_limit);
+
+/**
+ * Occupancy of a stream store's tiers, as returned by @ref
+ * hs_stream_store_stats().
+ */
+typedef struct hs_stream_store_info {
+    /** Resident flows opened or scanned in the current period. */
+    unsigned int hot;
+
+    /** Resident flows idle in the current period. */
+    unsigned int warm;
+
+    /** Flows compressed in the arena. */
+    unsigned int cold;
+
+    /** Bytes of stream state held by resident flows. */
+    unsigned long long resident_bytes;
+
+    /** Bytes of compressed stream state held by cold flows. */
+    unsigned long long cold_bytes;
+
+    /** Bytes allocated for the arena. */
+    unsigned long long arena_bytes;
+
+    /** Streams compressed since the store was allocated. */
+    unsigned long long compressions;
+
+    /** Streams expanded since the store was allocated. */
+    unsigned long long expansions;
+} hs_stream_store_info_t;
+
+/**
+ * Reports the occupancy of each tier of a stream store.
+ *
+ * @param store
+ *      A stream store allocated by @ref hs_alloc_stream_store().
+ *
+ * @param stats
+ *      On success, the occupancy is written to the structure pointed to by
+ *      this parameter.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_stream_store_stats(const hs_stream_store_t *store,
+                                 hs_stream_store_info_t *stats);
+
+/**
+ * @defgroup HS_TRANSFORM_FLAG Built-in input transforms
+ *
+ * Flags for @ref hs_alloc_transform(). Enabled transforms are applied in the
+ * order listed here, each to the output of the one before.
+ *
+ * @{
+ */
+
+/**
+ * URL percent-decoding: each `%` followed by two hex digits is replaced by the
+ * byte it encodes. Other `%` characters are passed through unchanged.
+ */
+#define HS_TRANSFORM_URL_DECODE         1
+
+/**
+ * Whitespace squeezing: each run of space, tab, newline, vertical tab, form
+ * feed and carriage return characters is replaced by a single space.
+ */
+#define HS_TRANSFORM_SQUEEZE_SPACE      2
+
+/** ASCII case folding: upper case letters are replaced by lower case ones. */
+#define HS_TRANSFORM_LOWERCASE          4
+
+/** @} */
+
+/**
+ * The type of a custom transform, applied by @ref hs_scan_stream_transformed()
+ * after any built-in transforms.
+ *
+ * The function is called with consecutive blocks of the stream, so any state
+ * needed across block boundaries must be kept in @p context. It may not
+ * produce more bytes than it is given.
+ *
+ * @param in
+ *      The block of data to transform.
+ *
+ * @param in_len
+ *      The length of @p in, in bytes.
+ *
+ * @param out
+ *      Buffer for the transformed data, with room for @p in_len bytes.
+ *
+ * @param map
+ *      Array of @p in_len entries. For each byte written to @p out, the
+ *      function must set the matching entry to the number of bytes of @p in
+ *      that had been consumed once that byte was produced: that is, one past
+ *      the index of the last input byte it depends on. Entries must not
+ *      decrease.
+ *
+ * @param context
+ *      The context pointer given to @ref hs_alloc_transform().
+ *
+ * @return
+ *      The number of bytes written to @p out.
+ */
+typedef size_t (*hs_transform_func_t)(const char *in, size_t in_len,
+                                      char *out, unsigned int *map,
+                                      void *context);
+
+/**
+ * Allocate an input normalisation stage for a stream.
+ *
+ * A transform rewrites the data given to @ref hs_scan_stream_transformed()
+ * before it is scanned, so that patterns can be written against normalised
+ * data without a separate normalisation pass and copy. The data is
+ * transformed a cache-sized block at a time, and each block is scanned while
+ * it is still in cache.
+ *
+ * A transform holds the state of one stream: bytes of an escape sequence
+ * split between writes, and the map from transformed offsets back to offsets
+ * in the original data. It must be used with a single stream from the start
+ * of that stream, and reset with @ref hs_reset_transform() when the stream
+ * is reset. It is allocated with the misc allocator (see @ref
+ * hs_set_misc_allocator()).
+ *
+ * @param flags
+ *      A combination of the @ref HS_TRANSFORM_FLAG flags.
+ *
+ * @param func
+ *      A custom transform, applied after the built-in ones, or NULL.
+ *
+ * @param context
+ *      Context pointer passed to @p func.
+ *
+ * @param transform
+ *      On success, a pointer to the new @ref hs_transform_t will be returned
+ *      here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the allocation fails,
+ *      @ref HS_INVALID if no transform or an unknown flag is given.
+ */
+hs_error_t hs_alloc_transform(unsigned int flags, hs_transform_func_t func,
+                              void *context, hs_transform_t **transform);
+
+/**
+ * Free a transform allocated by @ref hs_alloc_transform().
+ *
+ * @param transform
+ *      The transform to be freed. NULL may also be safely provided.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_free_transform(hs_transform_t *transform);
+
+/**
+ * Return a transform to its initial state, for use with a new or reset
+ * stream. Bytes held back from the previous stream are discarded.
+ *
+ * @param transform
+ *      A transform allocated by @ref hs_alloc_transform().
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_reset_transform(hs_transform_t *transform);
+
+/**
+ * Transform a write to a stream and scan the result.
+ *
+ * This behaves as @ref hs_scan_stream() called with the transformed data, and
+ * match offsets are reported in transformed coordinates. Use @ref
+ * hs_transform_map_offset() to map them back to the original data.
+ *
+ * The end of the data may be held back if it could be the start of an escape
+ * sequence that continues in the next write. Pass @ref HS_TRANSFORM_LAST in
+ * @p flags with the final write to the stream so that such bytes are scanned
+ * as they are.
+ *
+ * @param id
+ *      The stream ID (returned by @ref hs_open_stream()) to which the data
+ *      will be written.
+ *
+ * @param transform
+ *      The transform for this stream.
+ *
+ * @param data
+ *      Pointer to the data to be transformed and scanned.
+ *
+ * @param length
+ *      The number of bytes to transform and scan.
+ *
+ * @param flags
+ *      Zero or @ref HS_TRANSFORM_LAST.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch().
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param ctxt
+ *      The user defined pointer which will be passed to the callback function
+ *      when a match occurs.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
+ *      match callback indicated that scanning should stop; other values on
+ *      error.
+ */
+hs_error_t hs_scan_stream_transformed(hs_stream_t *id,
+                                      hs_transform_t *transform,
+                                      const char *data, unsigned int length,
+                                      unsigned int flags,
+                                      hs_scratch_t *scratch,
+                                      match_event_handler onEvent,
+                                      void *ctxt);
+
+/**
+ * Flag for @ref hs_scan_stream_transformed(): the data is the last write to
+ * the stream, so no bytes are held back.
+ */
+#define HS_TRANSFORM_LAST               1
+
+/**
+ * Map a match offset in transformed coordinates back to the original data.
+ *
+ * The map covers the block of transformed data most recently scanned, so
+ * this may be called from the match callback of @ref
+ * hs_scan_stream_transformed() with the offset of the match being reported,
+ * or after the call for matches reported by @ref hs_close_stream() at the
+ * end of the stream.
+ *
+ * @param transform
+ *      The transform for the stream.
+ *
+ * @param to
+ *      A match end offset in transformed coordinates.
+ *
+ * @param from
+ *      On success, the offset in the original data just past the last byte
+ *      that the transformed data up to @p to was produced from.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_INVALID if @p to is outside the
+ *      block most recently scanned.
+ */
+hs_error_t hs_transform_map_offset(const hs_transform_t *transform,
+                                   unsigned long long to,
+                                   unsigned long long *from);
+
+/**
+ * The block (non-streaming) regular expression scanner.
+ *
+ * This is the function call in which the actual pattern matching takes place
+ * for block-mode pattern databases.
+ *
+ * @param db
+ *      A compiled pattern database.
+ *
+ * @param data
+ *      Pointer to the data to be scanned.
+ *
+ * @param length
+ *      The number of bytes to scan.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of this function. This parameter is
+ *      provided for future use and is unused at present.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() for this
+ *      database.
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
+ *      match callback indicated that scanning should stop; other values on
+ *      error.
+ */
+hs_error_t hs_scan(const hs_database_t *db, const char *data,
+                   unsigned int length, unsigned int flags,
+                   hs_scratch_t *scratch, match_event_handler onEvent,
+                   void *context);
+
+/**
+ * The vectored regular expression scanner.
+ *
+ * This is the function call in which the actual pattern matching takes place
+ * for vectoring-mode pattern databases.
+ *
+ * @param db
+ *      A compiled pattern database.
+ *
+ * @param data
+ *      An array of pointers to the data blocks to be scanned.
+ *
+ * @param length
+ *      An array of lengths (in bytes) of each data block to scan.
+ *
+ * @param count
+ *      Number of data blocks to scan. This should correspond to the size of
+ *      of the @a data and @a length arrays.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of this function. This parameter is
+ *      provided for future use and is unused at present.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() for
+ *      this database.
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the match
+ *      callback indicated that scanning should stop; other values on error.
+ */
+hs_error_t hs_scan_vector(const hs_database_t *db, const char *const *data,
+                          const unsigned int *length, unsigned int count,
+                          unsigned int flags, hs_scratch_t *scratch,
+                          match_event_handler onEvent, void *context);
+
+/**
+ * The batched block regular expression scanner.
+ *
+ * This function scans a number of independent data blocks against a
+ * block-mode pattern database, as if @ref hs_scan() had been called once for
+ * each block. Validation of the database and scratch space is performed only
+ * once for the whole batch, which reduces per-call overhead when scanning
+ * large numbers of small blocks.
+ *
+ * Each block is scanned separately: matches are not found across block
+ * boundaries and match offsets are relative to the start of each block.
+ *
+ * @param db
+ *      A compiled pattern database.
+ *
+ * @param data
+ *      An array of pointers to the data blocks to be scanned.
+ *
+ * @param length
+ *      An array of lengths (in bytes) of each data block to scan.
+ *
+ * @param count
+ *      Number of data blocks to scan. This should correspond to the size of
+ *      of the @a data and @a length arrays.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of this function. This parameter is
+ *      provided for future use and is unused at present.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() for
+ *      this database.
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      An array of user defined pointers, one per data block. The pointer for
+ *      a given block will be passed to the callback function for matches in
+ *      that block. If a NULL pointer is given, a NULL context will be passed
+ *      to the callback function for every block.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
+ *      match callback indicated that scanning should stop for one or more
+ *      blocks; other values on error. Terminating the scan of one block does
+ *      not prevent the remaining blocks in the batch from being scanned.
+ */
+hs_error_t hs_scan_batch(const hs_database_t *db, const char *const *data,
+                         const unsigned int *length, unsigned int count,
+                         unsigned int flags, hs_scratch_t *scratch,
+                         match_event_handler onEvent, void *const *context);
+
+/**
+ * The parallel block regular expression scanner.
+ *
+ * This function scans a single, large data block against a block-mode pattern
+ * database, dividing the work across a number of threads. It produces the
+ * same matches as a call to @ref hs_scan() over the whole block would, and
+ * delivers them in order of end offset.
+ *
+ * The block is split into pieces which are scanned independently, each with
+ * enough preceding data to find every match that ends within it. This is only
+ * possible if every pattern in the database has a bounded maximum match width
+ * and no pattern depends on absolute offsets: databases containing unbounded
+ * patterns, @ref HS_FLAG_SINGLEMATCH, @ref HS_FLAG_COMBINATION patterns, match
+ * limits or the min_offset/max_offset extended parameters are scanned on the
+ * calling thread alone.
+ *
+ * The match callback is only ever called from the calling thread. This
+ * function is part of the full Hyperscan library only, and is not available
+ * in the runtime-only library.
+ *
+ * @param db
+ *      A compiled pattern database.
+ *
+ * @param data
+ *      Pointer to the data to be scanned.
+ *
+ * @param length
+ *      The number of bytes to scan. If the database cannot be scanned in
+ *      parallel, this must be no larger than the maximum length accepted by
+ *      @ref hs_scan().
+ *
+ * @param flags
+ *      Flags modifying the behaviour of this function. This parameter is
+ *      provided for future use and is unused at present.
+ *
+ * @param num_threads
+ *      The maximum number of worker threads to use. If zero, one thread per
+ *      hardware thread is used.
+ *
+ * @param scratch
+ *      A scratch space allocated by @ref hs_alloc_scratch() for this database.
+ *      It is used by the calling thread, and cloned for the use of each worker
+ *      thread.
+ *      If the block would be split across threads, the scratch space must not
+ *      have a match buffer attached (see @ref hs_set_scratch_match_buffer()).
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
+ *      match callback indicated that scanning should stop; other values on
+ *      error.
+ */
+hs_error_t hs_scan_parallel(const hs_database_t *db, const char *data,
+                            size_t length, unsigned int flags,
+                            unsigned int num_threads, hs_scratch_t *scratch,
+                            match_event_handler onEvent, void *context);
+
+/**
+ * The multi-database block regular expression scanner.
+ *
+ * This function scans a single data block against several block-mode pattern
+ * databases. It produces the same matches for each database as a call to @ref
+ * hs_scan() would, but rather than passing the whole block through the cache
+ * once per database, it walks the block in cache-sized pieces and scans each
+ * piece against every database in turn.
+ *
+ * Pieces are scanned with enough preceding data to find every match that ends
+ * within them, as in @ref hs_scan_parallel(). Databases that cannot be split
+ * this way (see @ref hs_scan_parallel()) are scanned over the whole block
+ * before the others. Matches are delivered piece by piece, and within a piece
+ * database by database.
+ *
+ * This function is part of the full Hyperscan library only, and is not
+ * available in the runtime-only library.
+ *
+ * @param dbs
+ *      An array of compiled block-mode pattern databases.
+ *
+ * @param count
+ *      Number of databases in the @a dbs array.
+ *
+ * @param data
+ *      Pointer to the data to be scanned.
+ *
+ * @param length
+ *      The number of bytes to scan.
+ *
+ * @param flags
+ *      Flags modifying the behaviour of this function. This parameter is
+ *      provided for future use and is unused at present.
+ *
+ * @param scratch
+ *      A per-thread scratch space which has been passed to @ref
+ *      hs_alloc_scratch() for every database in the array. If the block is
+ *      longer than one piece, the scratch space must not have a match buffer
+ *      attached (see @ref hs_set_scratch_match_buffer()).
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      An array of user defined pointers, one per database. The pointer for a
+ *      given database will be passed to the callback function for its
+ *      matches, and so identifies the database that matched. If a NULL pointer
+ *      is given, a NULL context will be passed to the callback function for
+ *      every database.
+ *
+ * @return
+ *      Returns @ref HS_SUCCESS on success; @ref HS_SCAN_TERMINATED if the
+ *      match callback indicated that scanning should stop for one or more
+ *      databases; other values on error. Terminating the scan for one database
+ *      does not prevent the block from being scanned against the others.
+ */
+hs_error_t hs_scan_multi_db(const hs_database_t *const *dbs,
+                            unsigned int count, const char *data,
+                            unsigned int length, unsigned int flags,
+                            hs_scratch_t *scratch, match_event_handler onEvent,
+                            void *const *context);
+
+/**
+ * Check that a block of data is well-formed UTF-8.
+ *
+ * Patterns compiled with the @ref HS_FLAG_UTF8 flag assume that the data
+ * they scan is valid UTF-8, and their behaviour is undefined otherwise. This
+ * function checks data cheaply before it is scanned with such a database:
+ * runs of ASCII are checked many bytes at a time.
+ *
+ * Overlong encodings, UTF-16 surrogates and code points above U+10FFFF are
+ * not well-formed, and neither is a sequence cut short by the end of the
+ * data. When checking data that will be written to a stream, a sequence may
+ * be split across writes: if the error offset is within three bytes of the
+ * end of the data, the bytes from it onwards can be checked again with the
+ * next write.
+ *
+ * @param data
+ *      Pointer to the data to be checked.
+ *
+ * @param length
+ *      The number of bytes to check.
+ *
+ * @param error_offset
+ *      On success, the offset of the first byte of the first sequence that
+ *      is not well-formed will be returned here, or @a length if the data is
+ *      well-formed UTF-8.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_check_utf8(const char *data, unsigned int length,
+                         unsigned int *error_offset);
+
+/**
+ * Allocate a "scratch" space for use by Hyperscan.
+ *
+ * This is required for runtime use, and one scratch space per thread, or
+ * concurrent caller, is required. Any allocator callback set by @ref
+ * hs_set_scratch_allocator() or @ref hs_set_allocator() will be used by this
+ * function.
+ *
+ * @param db
+ *      The database, as produced by @ref hs_compile().
+ *
+ * @param scratch
+ *      On first allocation, a pointer to NULL should be provided so a new
+ *      scratch can be allocated. If a scratch block has been previously
+ *      allocated, then a pointer to it should be passed back in to see if it
+ *      is valid for this database block. If a new scratch block is required,
+ *      the original will be freed and the new one returned, otherwise the
+ *      previous scratch block will be returned. On success, the scratch block
+ *      will be suitable for use with the provided database in addition to any
+ *      databases that original scratch space was suitable for.
+ *
+ * @return
+ *      @ref HS_SUCCESS on successful allocation; @ref HS_NOMEM if the
+ *      allocation fails.  Other errors may be returned if invalid parameters
+ *      are specified.
+ */
+hs_error_t hs_alloc_scratch(const hs_database_t *db, hs_scratch_t **scratch);
+
+/**
+ * Allocate a "scratch" space for use by Hyperscan with the given allocator
+ * context, rather than the allocator set by @ref hs_set_scratch_allocator().
+ *
+ * This behaves as @ref hs_alloc_scratch(), and the allocator is recorded in
+ * the new scratch space: it is used when the scratch space is grown by @ref
+ * hs_alloc_scratch() or @ref hs_reserve_scratch(), for clones made by @ref
+ * hs_clone_scratch(), and to free the scratch space in @ref hs_free_scratch().
+ * An existing scratch space passed in keeps the allocator it was allocated
+ * with.
+ *
+ * @param db
+ *      The database, as produced by @ref hs_compile().
+ *
+ * @param allocator
+ *      The allocator context, which must remain valid until the scratch space
+ *      (and any clone of it) has been freed.
+ *
+ * @param scratch
+ *      As for @ref hs_alloc_scratch().
+ *
+ * @return
+ *      @ref HS_SUCCESS on successful allocation; @ref HS_NOMEM if the
+ *      allocation fails.  Other errors may be returned if invalid parameters
+ *      are specified.
+ */
+hs_error_t hs_alloc_scratch_ex(const hs_database_t *db,
+                               const hs_allocator_t *allocator,
+                               hs_scratch_t **scratch);
+
+/**
+ * Provides the size of the memory required by @ref hs_init_scratch_at() for a
+ * scratch space suitable for the given database.
+ *
+ * @param db
+ *      The database, as produced by @ref hs_compile().
+ *
+ * @param scratch_size
+ *      On success, the required size in bytes is placed in this parameter.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_scratch_required_size(const hs_database_t *db,
+                                    size_t *scratch_size);
+
+/**
+ * Initialise a "scratch" space for the given database in caller-provided
+ * memory, without allocating.
+ *
+ * The scratch space is used like any other. It may be passed to @ref
+ * hs_alloc_scratch() for further databases, which succeeds only if the
+ * larger layout fits within @a size bytes and returns @ref
+ * HS_INSUFFICIENT_SPACE, leaving the scratch space unchanged, otherwise. @ref
+ * hs_free_scratch() does not free the memory, which may be reused or freed by
+ * the caller afterwards. Clones made with @ref hs_clone_scratch() are
+ * allocated with the allocator set by @ref hs_set_scratch_allocator().
+ *
+ * @param db
+ *      The database, as produced by @ref hs_compile().
+ *
+ * @param mem
+ *      The memory to hold the scratch space, which must be aligned to 8
+ *      bytes.
+ *
+ * @param size
+ *      The size of @a mem, which must be at least the size given by @ref
+ *      hs_scratch_required_size(). Any further memory is kept as room for
+ *      larger databases, as with @ref hs_reserve_scratch().
+ *
+ * @param scratch
+ *      On success, a pointer to the scratch space (which lies within @a mem)
+ *      is returned here; NULL on failure.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_INSUFFICIENT_SPACE if @a size is
+ *      too small; @ref HS_BAD_ALIGN if @a mem is not suitably aligned. Other
+ *      errors may be returned if invalid parameters are specified.
+ */
+hs_error_t hs_init_scratch_at(const hs_database_t *db, void *mem, size_t size,
+                              hs_scratch_t **scratch);
+
+/**
+ * Allocate a scratch space that is a clone of an existing scratch space.
+ *
+ * This is useful when multiple concurrent threads will be using the same set
+ * of compiled databases, and another scratch space is required. Any allocator
+ * callback set by @ref hs_set_scratch_allocator() or @ref hs_set_allocator()
+ * will be used by this function.
+ *
+ * @param src
+ *      The existing @ref hs_scratch_t to be cloned.
+ *
+ * @param dest
+ *      A pointer to the new scratch space will be returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if the allocation fails.
+ *      Other errors may be returned if invalid parameters are specified.
+ */
+hs_error_t hs_clone_scratch(const hs_scratch_t *src, hs_scratch_t **dest);
+
+/**
+ * Provides the size of the given scratch space.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @param scratch_size
+ *      On success, the size of the scratch space in bytes is placed in this
+ *      parameter.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_scratch_size(const hs_scratch_t *scratch, size_t *scratch_size);
+
+/**
+ * Determine whether a scratch space is large enough to be used with a
+ * database.
+ *
+ * This is a cheap check, taking constant time, that allows an application to
+ * tell whether the scratch spaces it already has can be used with a newly
+ * loaded database, without calling @ref hs_alloc_scratch().
+ *
+ * @param db
+ *      The database, as produced by @ref hs_compile().
+ *
+ * @param scratch
+ *      A scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @return
+ *      @ref HS_SUCCESS if the scratch space may be used with the database;
+ *      @ref HS_INSUFFICIENT_SPACE if it must be passed to @ref
+ *      hs_alloc_scratch() first. Other errors may be returned if invalid
+ *      parameters are specified.
+ */
+hs_error_t hs_scratch_compatible(const hs_database_t *db,
+                                 const hs_scratch_t *scratch);
+
+/**
+ * Ensure that a scratch space occupies an allocation of at least the given
+ * size.
+ *
+ * When @ref hs_alloc_scratch() finds that an existing scratch space is too
+ * small for a database, it lays the scratch space out again within its
+ * existing allocation if that is large enough, so that neither an allocation
+ * nor a change of the scratch pointer is required. Reserving room in advance
+ * with this function allows an application to switch to new databases with
+ * slightly larger scratch requirements without allocating.
+ *
+ * The reserved size is preserved by @ref hs_clone_scratch(). Any allocator
+ * callback set by @ref hs_set_scratch_allocator() or @ref hs_set_allocator()
+ * will be used by this function.
+ *
+ * @param size
+ *      The minimum size of the scratch space, in bytes, as would be reported
+ *      by @ref hs_scratch_size().
+ *
+ * @param scratch
+ *      A pointer to a scratch space allocated by @ref hs_alloc_scratch() or
+ *      @ref hs_clone_scratch(). If the scratch space is smaller than the
+ *      requested size, it is freed and a larger copy returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if the allocation fails, in
+ *      which case the original scratch space is unchanged; @ref
+ *      HS_INSUFFICIENT_SPACE if a scratch space initialised by @ref
+ *      hs_init_scratch_at() is smaller than the requested size. Other errors
+ *      may be returned if invalid parameters are specified.
+ */
+hs_error_t hs_reserve_scratch(size_t size, hs_scratch_t **scratch);
+
+/**
+ * Free a scratch block previously allocated by @ref hs_alloc_scratch() or @ref
+ * hs_clone_scratch().
+ *
+ * The free callback set by @ref hs_set_scratch_allocator() or @ref
+ * hs_set_allocator() will be used by this function.
+ *
+ * @param scratch
+ *      The scratch block to be freed. NULL may also be safely provided.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_free_scratch(hs_scratch_t *scratch);
+
+/**
+ * Allocate a pool of scratch spaces for a database, which may be shared by
+ * any number of threads.
+ *
+ * Threads take a scratch space from the pool with @ref hs_scratch_pool_get()
+ * before scanning and return it with @ref hs_scratch_pool_put() afterwards.
+ * Idle scratch spaces are cached in the pool, so that in the steady state no
+ * allocation is done; the pool only allocates a new scratch space (by cloning
+ * a prototype) when it has no idle one to hand out. Taking and returning
+ * scratch spaces are lock-free unless a new scratch space must be cloned.
+ *
+ * This function is part of the full Hyperscan library only, and is not
+ * available in the runtime-only library.
+ *
+ * @param db
+ *      The database, as produced by @ref hs_compile().
+ *
+ * @param num_threads
+ *      The expected number of threads that will use the pool at once, which
+ *      is used to size the cache of idle scratch spaces. If zero, one thread
+ *      per hardware thread is assumed.
+ *
+ * @param pool
+ *      On success, a pointer to the new @ref hs_scratch_pool_t will be
+ *      returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if the allocation fails.
+ *      Other errors may be returned if invalid parameters are specified.
+ */
+hs_error_t hs_alloc_scratch_pool(const hs_database_t *db,
+                                 unsigned int num_threads,
+                                 hs_scratch_pool_t **pool);
+
+/**
+ * Take a scratch space from a scratch pool.
+ *
+ * The scratch space is suitable for use with the database the pool was most
+ * recently allocated or updated for, and must be returned to the pool with
+ * @ref hs_scratch_pool_put() once the caller is finished with it.
+ *
+ * @param pool
+ *      A scratch pool allocated by @ref hs_alloc_scratch_pool().
+ *
+ * @param scratch
+ *      On success, a pointer to the scratch space is returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if a new scratch space was
+ *      required and the allocation failed. Other errors may be returned if
+ *      invalid parameters are specified.
+ */
+hs_error_t hs_scratch_pool_get(hs_scratch_pool_t *pool,
+                               hs_scratch_t **scratch);
+
+/**
+ * Return a scratch space to the scratch pool it was taken from.
+ *
+ * If the scratch space was taken before the pool was last updated, or the
+ * pool's cache of idle scratch spaces is full, it is freed instead.
+ *
+ * @param pool
+ *      The scratch pool passed to @ref hs_scratch_pool_get().
+ *
+ * @param scratch
+ *      The scratch space returned by @ref hs_scratch_pool_get().
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_SCRATCH_IN_USE if the scratch space
+ *      is still in use by a scan call. Other errors may be returned if invalid
+ *      parameters are specified.
+ */
+hs_error_t hs_scratch_pool_put(hs_scratch_pool_t *pool,
+                               hs_scratch_t *scratch);
+
+/**
+ * Switch a scratch pool to a new database, such as a reloaded version of the
+ * rule set it was allocated for.
+ *
+ * Subsequent calls to @ref hs_scratch_pool_get() will return scratch spaces
+ * sized for the new database only, which may be larger or smaller than those
+ * for the old one. Scratch spaces already taken from the pool remain valid
+ * for the old database until they are returned, at which point they are
+ * freed. This function may be called while other threads are taking and
+ * returning scratch spaces.
+ *
+ * @param pool
+ *      A scratch pool allocated by @ref hs_alloc_scratch_pool().
+ *
+ * @param db
+ *      The new database.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if the allocation fails, in
+ *      which case the pool is unchanged. Other errors may be returned if
+ *      invalid parameters are specified.
+ */
+hs_error_t hs_scratch_pool_update(hs_scratch_pool_t *pool,
+                                  const hs_database_t *db);
+
+/**
+ * Free a scratch pool and all of the idle scratch spaces cached in it.
+ *
+ * Scratch spaces that have been taken from the pool and not returned must be
+ * freed with @ref hs_free_scratch() by their owners.
+ *
+ * @param pool
+ *      The scratch pool to be freed. NULL may also be safely provided.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_free_scratch_pool(hs_scratch_pool_t *pool);
+
+/**
+ * Allocate a flow scheduler: a pool of worker threads, each with its own
+ * scratch space, that scans block-mode jobs and stream writes queued with
+ * @ref hs_scheduler_scan() and @ref hs_scheduler_scan_stream().
+ *
+ * Streams are identified by a flow key chosen by the application, and each
+ * flow has a home worker chosen from its key, so that a flow's stream state
+ * stays in one worker's caches. Writes to a flow are scanned in the order
+ * they were queued and never concurrently. Idle workers steal block-mode
+ * jobs and flows with a large amount of data queued from busy workers, so
+ * that a few heavy flows do not overload one worker.
+ *
+ * Match callbacks are called from the worker threads. Callbacks for one flow
+ * are called in order from one thread at a time, but callbacks for different
+ * flows and jobs may run concurrently.
+ *
+ * This function is part of the full Hyperscan library only, and is not
+ * available in the runtime-only library.
+ *
+ * @param db
+ *      The database to scan with. Stream writes require a streaming mode
+ *      database, and block-mode jobs a block mode one.
+ *
+ * @param num_workers
+ *      The number of worker threads to start. If zero, one worker per
+ *      hardware thread is started.
+ *
+ * @param scratch
+ *      A scratch space allocated by @ref hs_alloc_scratch() for @a db, which
+ *      is cloned for each worker. It is not used by the scheduler afterwards.
+ *
+ * @param sched
+ *      On success, a pointer to the new @ref hs_scheduler_t will be returned
+ *      here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if an allocation fails or a
+ *      thread could not be started. Other errors may be returned if invalid
+ *      parameters are specified.
+ */
+hs_error_t hs_alloc_scheduler(const hs_database_t *db,
+                              unsigned int num_workers,
+                              const hs_scratch_t *scratch,
+                              hs_scheduler_t **sched);
+
+/**
+ * Queue a block-mode scan of a data block, as by @ref hs_scan(), on a flow
+ * scheduler.
+ *
+ * The data must remain valid until the scan has finished, which is certain
+ * once @ref hs_scheduler_wait() returns.
+ *
+ * @param sched
+ *      A flow scheduler allocated by @ref hs_alloc_scheduler().
+ *
+ * @param data
+ *      Pointer to the data to be scanned.
+ *
+ * @param length
+ *      The number of bytes to scan.
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function.
+ *
+ * @return
+ *      @ref HS_SUCCESS if the scan was queued; errors from the scan itself are
+ *      returned by @ref hs_scheduler_wait().
+ */
+hs_error_t hs_scheduler_scan(hs_scheduler_t *sched, const char *data,
+                             unsigned int length, match_event_handler onEvent,
+                             void *context);
+
+/**
+ * Queue a write of data to a flow, as by @ref hs_scan_stream(), on a flow
+ * scheduler. The flow's stream is opened by the first write with a given key.
+ *
+ * The data must remain valid until the write has been scanned, which is
+ * certain once @ref hs_scheduler_wait() returns.
+ *
+ * @param sched
+ *      A flow scheduler allocated by @ref hs_alloc_scheduler().
+ *
+ * @param flow
+ *      The application's key for the flow.
+ *
+ * @param data
+ *      Pointer to the data to be scanned.
+ *
+ * @param length
+ *      The number of bytes to scan.
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function.
+ *
+ * @return
+ *      @ref HS_SUCCESS if the write was queued; errors from the scan itself
+ *      are returned by @ref hs_scheduler_wait().
+ */
+hs_error_t hs_scheduler_scan_stream(hs_scheduler_t *sched,
+                                    unsigned long long flow, const char *data,
+                                    unsigned int length,
+                                    match_event_handler onEvent,
+                                    void *context);
+
+/**
+ * Queue the close of a flow, as by @ref hs_close_stream(), on a flow
+ * scheduler. The close is done after all writes already queued to the flow;
+ * a later write with the same key opens a new flow.
+ *
+ * @param sched
+ *      A flow scheduler allocated by @ref hs_alloc_scheduler().
+ *
+ * @param flow
+ *      The application's key for the flow.
+ *
+ * @param onEvent
+ *      Pointer to a match event callback function. If a NULL pointer is given,
+ *      no matches will be returned.
+ *
+ * @param context
+ *      The user defined pointer which will be passed to the callback function.
+ *
+ * @return
+ *      @ref HS_SUCCESS if the close was queued; @ref HS_INVALID if no flow is
+ *      open with this key.
+ */
+hs_error_t hs_scheduler_close_stream(hs_scheduler_t *sched,
+                                     unsigned long long flow,
+                                     match_event_handler onEvent,
+                                     void *context);
+
+/**
+ * Wait for all of the work queued on a flow scheduler to finish.
+ *
+ * @param sched
+ *      A flow scheduler allocated by @ref hs_alloc_scheduler().
+ *
+ * @return
+ *      @ref HS_SUCCESS if every scan since the last call succeeded (or was
+ *      terminated by its callback); otherwise the first error returned by a
+ *      scan since the last call.
+ */
+hs_error_t hs_scheduler_wait(hs_scheduler_t *sched);
+
+/**
+ * Work done by one worker of a flow scheduler, as returned by @ref
+ * hs_scheduler_worker_stats().
+ */
+typedef struct hs_scheduler_stats {
+    /** Block-mode jobs scanned. */
+    unsigned long long jobs;
+
+    /** Stream writes scanned. */
+    unsigned long long writes;
+
+    /** Bytes scanned by jobs and writes. */
+    unsigned long long bytes;
+
+    /** Jobs and flows taken from other workers. */
+    unsigned long long steals;
+} hs_scheduler_stats_t;
+
+/**
+ * Reports the work done by one worker of a flow scheduler. The counts are
+ * updated by the worker as it goes, and may be read at any time.
+ *
+ * @param sched
+ *      A flow scheduler allocated by @ref hs_alloc_scheduler().
+ *
+ * @param worker
+ *      The index of the worker, less than the number of workers.
+ *
+ * @param stats
+ *      On success, the counts are written to the structure pointed to by this
+ *      parameter.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_scheduler_worker_stats(const hs_scheduler_t *sched,
+                                     unsigned int worker,
+                                     hs_scheduler_stats_t *stats);
+
+/**
+ * Free a flow scheduler, after waiting for its queued work to finish and
+ * stopping its workers. Flows that are still open are freed without
+ * reporting any end of data matches.
+ *
+ * @param sched
+ *      The flow scheduler to be freed. NULL may also be safely provided.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_free_scheduler(hs_scheduler_t *sched);
+
+/**
+ * Allocate a database handle, through which scanning threads find the current
+ * version of a database that is replaced from time to time.
+ *
+ * A scanning thread brackets its use of the database with @ref
+ * hs_db_handle_acquire() and @ref hs_db_handle_release(), which cost one
+ * atomic add each on a cache line shared with few other threads. A stream,
+ * which outlives any one scan, pins the database it was opened against with
+ * @ref hs_db_handle_pin() until it is closed. @ref hs_db_handle_update()
+ * publishes a new database without waiting for the readers of the old one;
+ * the old database is freed with @ref hs_free_database() once no thread can
+ * still be using it and no stream has it pinned.
+ *
+ * This function is part of the full Hyperscan library only, and is not
+ * available in the runtime-only library.
+ *
+ * @param db
+ *      The initial database. The handle takes ownership of it.
+ *
+ * @param handle
+ *      On success, a pointer to the new @ref hs_db_handle_t will be returned
+ *      here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if the allocation fails.
+ *      Other errors may be returned if invalid parameters are specified.
+ */
+hs_error_t hs_alloc_db_handle(hs_database_t *db, hs_db_handle_t **handle);
+
+/**
+ * Start using the current database of a database handle.
+ *
+ * The database remains valid until the matching call to @ref
+ * hs_db_handle_release(), even if it is replaced in the meantime. Read-side
+ * sections should be short, such as one scan or one stream write: a retired
+ * database cannot be freed while any section that began before it was
+ * replaced is still open.
+ *
+ * @param handle
+ *      A database handle allocated by @ref hs_alloc_db_handle().
+ *
+ * @param db
+ *      On success, the current database is returned here.
+ *
+ * @param token
+ *      On success, a token to be passed to @ref hs_db_handle_release() is
+ *      returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_db_handle_acquire(hs_db_handle_t *handle,
+                                const hs_database_t **db,
+                                unsigned int *token);
+
+/**
+ * Stop using a database obtained with @ref hs_db_handle_acquire().
+ *
+ * @param handle
+ *      The database handle passed to @ref hs_db_handle_acquire().
+ *
+ * @param token
+ *      The token returned by @ref hs_db_handle_acquire().
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_db_handle_release(hs_db_handle_t *handle, unsigned int token);
+
+/**
+ * Pin the current database of a database handle, for a stream to be opened
+ * against it.
+ *
+ * The database remains valid until it is unpinned with @ref
+ * hs_db_handle_unpin(), which should be done when the stream is closed.
+ *
+ * @param handle
+ *      A database handle allocated by @ref hs_alloc_db_handle().
+ *
+ * @param db
+ *      On success, the pinned database is returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_db_handle_pin(hs_db_handle_t *handle, const hs_database_t **db);
+
+/**
+ * Unpin a database pinned with @ref hs_db_handle_pin(). If it has been
+ * replaced and this was its last pin, it may be freed by this call.
+ *
+ * @param handle
+ *      The database handle passed to @ref hs_db_handle_pin().
+ *
+ * @param db
+ *      The database returned by @ref hs_db_handle_pin().
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_INVALID if the database is not
+ *      pinned through this handle.
+ */
+hs_error_t hs_db_handle_unpin(hs_db_handle_t *handle,
+                              const hs_database_t *db);
+
+/**
+ * Replace the current database of a database handle.
+ *
+ * Readers that acquire the handle after this call see the new database.
+ * The old database is retired: it is freed by this call or a later one on
+ * the handle once every read-side section that could have seen it has ended
+ * and it has no pins. This call never waits for readers.
+ *
+ * @param handle
+ *      A database handle allocated by @ref hs_alloc_db_handle().
+ *
+ * @param db
+ *      The new database. The handle takes ownership of it.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if an allocation fails, in
+ *      which case the handle is unchanged and @a db is not taken over.
+ */
+hs_error_t hs_db_handle_update(hs_db_handle_t *handle, hs_database_t *db);
+
+/**
+ * Free the retired databases of a database handle that are no longer in use.
+ *
+ * This is done as part of @ref hs_db_handle_update() and @ref
+ * hs_db_handle_unpin(); calling it periodically frees databases whose last
+ * readers finished after those calls.
+ *
+ * @param handle
+ *      A database handle allocated by @ref hs_alloc_db_handle().
+ *
+ * @param pending
+ *      If not NULL, the number of retired databases still waiting to be freed
+ *      is returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_db_handle_reclaim(hs_db_handle_t *handle,
+                                unsigned int *pending);
+
+/**
+ * Free a database handle and every database it holds.
+ *
+ * No thread may be using the handle or any of its databases.
+ *
+ * @param handle
+ *      The database handle to be freed. NULL may also be safely provided.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_free_db_handle(hs_db_handle_t *handle);
+
+/**
+ * Allocate a pattern mask, which enables only a subset of the patterns in a
+ * database.
+ *
+ * Once set on a scratch space with @ref hs_set_scratch_pattern_mask(), scans
+ * using that scratch space only report matches for the pattern IDs in the
+ * mask. This allows many sets of rules drawn from one pattern set to share a
+ * single database.
+ *
+ * Patterns outside the mask are suppressed as well as not reported: the
+ * literal matcher skips literals that can only lead to disabled patterns, so
+ * scans with a small mask are generally faster than with the whole database.
+ * Patterns that are sub-expressions of a logical combination (see @ref
+ * HS_FLAG_COMBINATION) are always evaluated, but only reported if enabled.
+ *
+ * The mask refers to the database, which must not be freed while the mask is
+ * in use.
+ *
+ * @param db
+ *      The database, as produced by @ref hs_compile().
+ *
+ * @param ids
+ *      An array of the pattern IDs to enable. IDs that do not appear in the
+ *      database are ignored. May be NULL if @p count is zero.
+ *
+ * @param count
+ *      The number of entries in @p ids. A mask with no IDs suppresses all
+ *      matches.
+ *
+ * @param mask
+ *      On success, a pointer to the new @ref hs_pattern_mask_t will be
+ *      returned here.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_NOMEM if the allocation fails.
+ *      Other errors may be returned if invalid parameters are specified.
+ */
+hs_error_t hs_alloc_pattern_mask(const hs_database_t *db,
+                                 const unsigned int *ids, unsigned int count,
+                                 hs_pattern_mask_t **mask);
+
+/**
+ * Free a pattern mask allocated by @ref hs_alloc_pattern_mask().
+ *
+ * The mask must not be set on any scratch space that is still in use.
+ *
+ * @param mask
+ *      The pattern mask to be freed. NULL may also be safely provided.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_free_pattern_mask(hs_pattern_mask_t *mask);
+
+/**
+ * Set the pattern mask used by scans with a scratch space.
+ *
+ * The mask applies to all subsequent scan calls with the scratch space,
+ * including each write to a stream, so different masks may be used for
+ * different scans or streams against the same database by setting the mask
+ * before each call. Scratch spaces cloned from this one inherit the mask. A
+ * pattern that is enabled part way through a stream may not match data that
+ * was scanned while it was disabled.
+ *
+ * While a mask is set, the scratch space may only be used with the database
+ * the mask was allocated for; scan calls with other databases will return
+ * @ref HS_INVALID.
+ *
+ * @param scratch
+ *      The scratch space.
+ *
+ * @param mask
+ *      The pattern mask, or NULL to report matches for all patterns.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_SCRATCH_IN_USE if the scratch space
+ *      is in use by a scan call. Other errors may be returned if invalid
+ *      parameters are specified.
+ */
+hs_error_t hs_set_scratch_pattern_mask(hs_scratch_t *scratch,
+                                       const hs_pattern_mask_t *mask);
+
+/**
+ * Provides a text dump of the Rose interpreter profiling counters collected
+ * in the given scratch space.
+ *
+ * The counters are only collected when the library has been built with the
+ * `ROSE_PROFILE` CMake option, which is intended for performance analysis of
+ * pattern sets and slows down scanning considerably. They accumulate over all
+ * scans that use this scratch space, and are cleared when the scratch space is
+ * reallocated by @ref hs_alloc_scratch() or copied by @ref
+ * hs_clone_scratch().
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @param info
+ *      On success, a string containing the count of each instruction executed,
+ *      execution, check failure and cycle counts for each literal, and
+ *      execution and cycle counts for each engine, is placed in this
+ *      parameter. This string will be allocated using the allocator
+ *      supplied in @ref hs_set_misc_allocator() (or malloc() if no allocator
+ *      was set) and should be freed by the caller.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure. @ref HS_INVALID is
+ *      returned if the library was not built with profiling support.
+ */
+hs_error_t hs_scratch_profile_info(const hs_scratch_t *scratch, char **info);
+
+/**
+ * Clears the Rose interpreter profiling counters collected in the given
+ * scratch space. See @ref hs_scratch_profile_info().
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure. @ref HS_INVALID is
+ *      returned if the library was not built with profiling support.
+ */
+hs_error_t hs_scratch_profile_reset(hs_scratch_t *scratch);
+
+/**
+ * Provides a text report of the patterns that scanning has spent the most time
+ * on, using the profiling counters collected in the given scratch space.
+ *
+ * In builds with the `ROSE_PROFILE` CMake option, the cycles spent running
+ * each literal's Rose programs (including their literal confirm checks) and
+ * executing each engine are counted in scratch. Time spent in an engine
+ * caught up while running a literal's program is charged to the engine. The
+ * database records which patterns each literal and engine can lead to, and
+ * this call divides each literal's and engine's cycles evenly between those
+ * patterns. Time spent in the literal matchers themselves is not charged to
+ * any pattern.
+ *
+ * The report is only meaningful if the scratch space has only been used to
+ * scan with the given database since it was allocated or its counters were
+ * cleared by @ref hs_scratch_profile_reset(). For a database compiled with
+ * both @ref HS_MODE_BLOCK and @ref HS_MODE_STREAM, the counters are assumed to
+ * belong to the mode that the scratch space last scanned with.
+ *
+ * @param db
+ *      The database that was scanned. It must have been compiled by a library
+ *      built with `ROSE_PROFILE`.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @param max_patterns
+ *      The maximum number of patterns to list, or zero to list every pattern
+ *      with a non-zero cost.
+ *
+ * @param info
+ *      On success, a string listing pattern IDs in order of decreasing cost,
+ *      with their cycle counts and share of the attributed cycles, is placed
+ *      in this parameter. This string will be allocated using the allocator
+ *      supplied in @ref hs_set_misc_allocator() (or malloc() if no allocator
+ *      was set) and should be freed by the caller.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure. @ref HS_INVALID is
+ *      returned if the library was not built with profiling support, or if the
+ *      database was compiled without it.
+ */
+hs_error_t hs_profile_report(const hs_database_t *db,
+                             const hs_scratch_t *scratch,
+                             unsigned int max_patterns, char **info);
+
+/**
+ * @defgroup HS_PMU_PHASE Runtime phases measured by the PMU counters
+ *
+ * Indices into @ref hs_pmu_stats_t::phase. Phases nest: the literal matcher
+ * calls back into Rose, which may catch up engines, so the counts for each
+ * phase include those of any phases run inside it.
+ *
+ * @{
+ */
+
+/** The literal matchers (FDR, Teddy and friends). */
+#define HS_PMU_PHASE_LITERAL_MATCHER    0
+
+/** Catching up all suffix and outfix engines to the current offset. */
+#define HS_PMU_PHASE_CATCHUP            1
+
+/** Execution of an engine's queue of events. */
+#define HS_PMU_PHASE_ENGINE             2
+
+/** The small write engine, used for short block mode scans. */
+#define HS_PMU_PHASE_SMALL_WRITE        3
+
+/** The number of phases. */
+#define HS_PMU_PHASE_COUNT              4
+
+/** @} */
+
+/**
+ * Hardware performance counter totals for one runtime phase.
+ */
+typedef struct hs_pmu_phase_stats {
+    /** The number of times the phase was entered. */
+    unsigned long long calls;
+
+    /** CPU cycles. */
+    unsigned long long cycles;
+
+    /** Instructions retired. */
+    unsigned long long instructions;
+
+    /** Level 1 data cache read misses. */
+    unsigned long long l1d_misses;
+
+    /** Last level cache read misses. */
+    unsigned long long llc_misses;
+
+    /** Mispredicted branches. */
+    unsigned long long branch_misses;
+} hs_pmu_phase_stats_t;
+
+/**
+ * Hardware performance counter totals for each runtime phase, as returned by
+ * @ref hs_scratch_pmu_stats().
+ */
+typedef struct hs_pmu_stats {
+    /**
+     * Non-zero if the hardware counters could be opened. If the operating
+     * system denies access to them (for example, because of the
+     * perf_event_paranoid setting on Linux) only the call counts are
+     * collected, and any counter the CPU does not provide reads as zero.
+     */
+    unsigned int available;
+
+    /** Totals for each phase, indexed by the @ref HS_PMU_PHASE values. */
+    hs_pmu_phase_stats_t phase[HS_PMU_PHASE_COUNT];
+} hs_pmu_stats_t;
+
+/**
+ * Retrieves the hardware performance counter totals collected for each
+ * runtime phase in the given scratch space.
+ *
+ * The counters are only collected when the library has been built with the
+ * `PMU_STATS` CMake option, which is available on Linux and is intended for
+ * attributing scan time to the different parts of the matcher. Reading the
+ * counters requires a system call at the start and end of each phase, so
+ * scanning is slowed down considerably. The counters are opened for the
+ * thread that scans with the scratch space, accumulate over all scans that
+ * use it, and are cleared when the scratch space is reallocated by @ref
+ * hs_alloc_scratch() or copied by @ref hs_clone_scratch().
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @param stats
+ *      On success, the totals are written to the structure pointed to by this
+ *      parameter.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure. @ref HS_INVALID is
+ *      returned if the library was not built with PMU support.
+ */
+hs_error_t hs_scratch_pmu_stats(const hs_scratch_t *scratch,
+                                hs_pmu_stats_t *stats);
+
+/**
+ * Clears the hardware performance counter totals collected in the given
+ * scratch space. See @ref hs_scratch_pmu_stats().
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure. @ref HS_INVALID is
+ *      returned if the library was not built with PMU support.
+ */
+hs_error_t hs_scratch_pmu_reset(hs_scratch_t *scratch);
+
+/**
+ * @defgroup HS_LATENCY_CALL API calls timed by the latency statistics
+ *
+ * Indices into @ref hs_latency_stats_t::call.
+ *
+ * @{
+ */
+
+/** Block mode scans with @ref hs_scan(). */
+#define HS_LATENCY_CALL_SCAN            0
+
+/** Stream writes with @ref hs_scan_stream(). */
+#define HS_LATENCY_CALL_SCAN_STREAM     1
+
+/**
+ * End of data processing in @ref hs_close_stream(). Only closes that are given
+ * a scratch space and a match handler are timed.
+ */
+#define HS_LATENCY_CALL_CLOSE_STREAM    2
+
+/** The number of API calls timed. */
+#define HS_LATENCY_CALL_COUNT           3
+
+/** @} */
+
+/**
+ * The number of buffer size classes in each call's latency histograms. Calls
+ * scanning fewer than 64 bytes fall in class 0; otherwise class c holds
+ * buffers of 64 * 4^(c-1) up to 64 * 4^c bytes, with the last class also
+ * holding anything larger. Stream closes are always in class 0.
+ */
+#define HS_LATENCY_SIZE_CLASSES         8
+
+/**
+ * The number of buckets in a latency histogram.
+ *
+ * Buckets have a width of one nanosecond up to 8ns; above that, each power of
+ * two is split into 8 equal buckets, so that a bucket is never wider than
+ * 12.5% of its lower bound. The last bucket also counts all calls of 2^34ns
+ * (about 17 seconds) and longer.
+ */
+#define HS_LATENCY_BUCKETS              256
+
+/**
+ * A histogram of call latencies, in nanoseconds.
+ */
+typedef struct hs_latency_histogram {
+    /** The number of calls recorded. */
+    unsigned long long count;
+
+    /** The total time taken by those calls. */
+    unsigned long long total_ns;
+
+    /** The longest time taken by one call. */
+    unsigned long long max_ns;
+
+    /** The number of calls in each bucket; see @ref HS_LATENCY_BUCKETS. */
+    unsigned long long bucket[HS_LATENCY_BUCKETS];
+} hs_latency_histogram_t;
+
+/**
+ * Latency histograms for each timed API call and buffer size class, as
+ * returned by @ref hs_scratch_latency_stats().
+ */
+typedef struct hs_latency_stats {
+    /**
+     * Histograms indexed by @ref HS_LATENCY_CALL value and then by buffer size
+     * class; see @ref HS_LATENCY_SIZE_CLASSES.
+     */
+    hs_latency_histogram_t call[HS_LATENCY_CALL_COUNT][HS_LATENCY_SIZE_CLASSES];
+} hs_latency_stats_t;
+
+/**
+ * Turns latency statistics on or off for the given scratch space.
+ *
+ * While they are on, the wall clock time taken by each @ref hs_scan(), @ref
+ * hs_scan_stream() and @ref hs_close_stream() call using the scratch space is
+ * recorded in a histogram for that call and the size of the buffer scanned.
+ * This costs two reads of the monotonic clock per call; when the statistics
+ * are off, the only cost is a test of a pointer in scratch.
+ *
+ * Turning the statistics on allocates about 48KB with the scratch allocator
+ * (see @ref hs_set_scratch_allocator()) and starts with empty histograms;
+ * turning them off frees it. The histograms are kept when the scratch space is
+ * grown by @ref hs_alloc_scratch() or @ref hs_reserve_scratch(). A copy made by
+ * @ref hs_clone_scratch() has its own, empty, histograms if the source has
+ * statistics turned on.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @param enable
+ *      Non-zero to turn the statistics on, zero to turn them off.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, @ref HS_NOMEM if the histograms could not be
+ *      allocated, other values on failure.
+ */
+hs_error_t hs_scratch_latency_enable(hs_scratch_t *scratch, int enable);
+
+/**
+ * Copies the latency histograms collected in the given scratch space. See
+ * @ref hs_scratch_latency_enable().
+ *
+ * This is a plain copy of the histograms, cheap enough to call periodically
+ * from the scanning thread to export them to a monitoring system.
+ *
+ * @param scratch
+ *      A per-thread scratch space with latency statistics turned on.
+ *
+ * @param stats
+ *      On success, the histograms are written to the structure pointed to by
+ *      this parameter.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure. @ref HS_INVALID is
+ *      returned if latency statistics are not turned on for the scratch space.
+ */
+hs_error_t hs_scratch_latency_stats(const hs_scratch_t *scratch,
+                                    hs_latency_stats_t *stats);
+
+/**
+ * Empties the latency histograms collected in the given scratch space,
+ * leaving the statistics turned on. See @ref hs_scratch_latency_enable().
+ *
+ * @param scratch
+ *      A per-thread scratch space with latency statistics turned on.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure. @ref HS_INVALID is
+ *      returned if latency statistics are not turned on for the scratch space.
+ */
+hs_error_t hs_scratch_latency_reset(hs_scratch_t *scratch);
+
+/**
+ * Estimates a percentile of the latencies in a histogram.
+ *
+ * The result is the upper bound of the bucket holding the requested
+ * percentile, but no more than the longest latency recorded, so it
+ * overestimates by at most one bucket width.
+ *
+ * @param hist
+ *      A histogram from @ref hs_scratch_latency_stats().
+ *
+ * @param percentile
+ *      The percentile wanted, from 0 to 100; for example 99.9.
+ *
+ * @param ns
+ *      On success, the latency in nanoseconds is written here. It is zero if
+ *      the histogram is empty.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_latency_percentile(const hs_latency_histogram_t *hist,
+                                 double percentile, unsigned long long *ns);
+
+/**
+ * A shared aggregate of the scan costs seen by sampled scans, allocated by
+ * @ref hs_alloc_sample_aggregate(). See @ref hs_scratch_sample_enable().
+ */
+typedef struct hs_sample_aggregate hs_sample_aggregate_t;
+
+/**
+ * Allocates an empty aggregate for the scan costs of the given database, to be
+ * shared by the scratch spaces that sample scans with it.
+ *
+ * The aggregate refers to the database, which must not be freed while the
+ * aggregate is in use. It is allocated with the allocator supplied in @ref
+ * hs_set_misc_allocator() (or malloc() if no allocator was set), and is
+ * freed with @ref hs_free_sample_aggregate().
+ *
+ * @param db
+ *      The database that will be scanned.
+ *
+ * @param agg
+ *      On success, a pointer to the aggregate is placed in this parameter.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_alloc_sample_aggregate(const hs_database_t *db,
+                                     hs_sample_aggregate_t **agg);
+
+/**
+ * Frees an aggregate allocated by @ref hs_alloc_sample_aggregate(). No scratch
+ * space may still be sampling into it.
+ *
+ * @param agg
+ *      The aggregate to free, or NULL.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_free_sample_aggregate(hs_sample_aggregate_t *agg);
+
+/**
+ * Turns sampled cost attribution on or off for the given scratch space.
+ *
+ * While it is on, one in every @p period scan calls (@ref hs_scan(), @ref
+ * hs_scan_stream(), @ref hs_scan_stream_vector(), @ref hs_flush_stream() and
+ * @ref hs_close_stream()) using the scratch space is sampled. During a sampled
+ * call, the time stamp counter cycles spent running each literal's Rose
+ * programs and each engine are added to the aggregate, as are the call's size
+ * and total cycles. Time spent in an engine caught up while running a
+ * literal's program is charged to the engine. Time spent in the literal
+ * matchers themselves is not charged to anything.
+ *
+ * Counters are added to the aggregate with atomic operations, so any number of
+ * scratch spaces, used on different threads, may share one aggregate without
+ * locking. Calls that are not sampled cost one predictable branch and a
+ * decrement, so with a period of a few hundred or more the overhead on
+ * scanning is well under one percent. The first sampled call is chosen
+ * differently for each scratch space, so that scratch spaces set up together
+ * do not sample in step.
+ *
+ * The setting is kept when the scratch space is grown by @ref
+ * hs_alloc_scratch() or @ref hs_reserve_scratch(), and copied to clones made
+ * by @ref hs_clone_scratch(), which share the aggregate. Only scans with the
+ * database the aggregate was allocated for are sampled.
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @param agg
+ *      The aggregate to add sampled costs to, or NULL to turn sampling off.
+ *
+ * @param period
+ *      The number of scan calls per sample; for example, 1000 samples roughly
+ *      one call in a thousand. Must be non-zero if @p agg is not NULL.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_scratch_sample_enable(hs_scratch_t *scratch,
+                                    hs_sample_aggregate_t *agg,
+                                    unsigned int period);
+
+/**
+ * Provides a text report of the scan costs collected in an aggregate. See
+ * @ref hs_scratch_sample_enable().
+ *
+ * The report gives the number of sampled calls, the number of calls they stand
+ * for, and the bytes and cycles of the sampled calls. If the database was
+ * compiled with @ref HS_MODE_COST_ATTRIBUTION, it then lists the patterns in
+ * order of decreasing cost, dividing the cycles of each literal and engine
+ * evenly between the patterns that it can lead to. Finally it lists the
+ * executions and cycles of each engine. The report may be taken while
+ * scanning threads are still adding to the aggregate.
+ *
+ * @param agg
+ *      An aggregate allocated by @ref hs_alloc_sample_aggregate().
+ *
+ * @param max_patterns
+ *      The maximum number of patterns to list, or zero to list every pattern
+ *      with a non-zero cost.
+ *
+ * @param info
+ *      On success, a string containing the report is placed in this
+ *      parameter. This string will be allocated using the allocator supplied
+ *      in @ref hs_set_misc_allocator() (or malloc() if no allocator was set)
+ *      and should be freed by the caller.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_sample_report(const hs_sample_aggregate_t *agg,
+                            unsigned int max_patterns, char **info);
+
+/**
+ * A match, as delivered to a @ref match_batch_handler().
+ */
+typedef struct hs_match {
+    /** The start offset of the match; see @ref match_event_handler(). */
+    unsigned long long from;
+
+    /** The end offset of the match. */
+    unsigned long long to;
+
+    /** The ID of the expression that matched. */
+    unsigned int id;
+
+    /** Match flags; unused at present. */
+    unsigned int flags;
+
+    /** The user data of the expression that matched, from
+     * hs_expr_ext::user_data, or zero if it has none. */
+    unsigned long long user_data;
+} hs_match_t;
+
+/**
+ * Definition of the batch match handler callback type.
+ *
+ * A batch handler is called by the library with the matches held in a match
+ * buffer attached to scratch with @ref hs_set_scratch_match_buffer(). It is
+ * called whenever the buffer fills, and once more with any matches remaining
+ * when the API call that produced them finishes.
+ *
+ * The @a context passed is the one given to the scanning call (for example,
+ * @ref hs_scan()). The matches are only valid for the duration of the call;
+ * the buffer is reused for the next batch.
+ *
+ * @param matches
+ *      The matches found, in the order they would have been delivered to a
+ *      @ref match_event_handler().
+ *
+ * @param count
+ *      The number of matches in @a matches; always at least one.
+ *
+ * @param context
+ *      The user-supplied context pointer given to the scanning call.
+ *
+ * @return
+ *      Non-zero if the matching should cease, else zero, as for @ref
+ *      match_event_handler(). Matches found before the handler was called but
+ *      not yet delivered are discarded.
+ */
+typedef int (*match_batch_handler)(const hs_match_t *matches,
+                                   unsigned int count, void *context);
+
+/**
+ * Attaches a caller-provided match buffer to the given scratch space.
+ *
+ * While a buffer is attached, matches found by calls using the scratch space
+ * are appended to it rather than being delivered one at a time; the @a onBatch
+ * handler receives them whenever the buffer fills and when the call finishes.
+ * The @ref match_event_handler() given to the scanning call is not used, but
+ * calls that only produce matches when given a handler (such as @ref
+ * hs_close_stream()) produce them if a buffer is attached.
+ *
+ * This moves the cost of calling back into the application from every match
+ * to every batch, which helps pattern sets that match very often.
+ *
+ * The buffer is kept when the scratch space is grown by @ref hs_alloc_scratch()
+ * or @ref hs_reserve_scratch(), but not copied by @ref hs_clone_scratch(). A
+ * scratch space with a buffer attached may not be used for multi-threaded
+ * scans with @ref hs_scan_parallel().
+ *
+ * @param scratch
+ *      A per-thread scratch space allocated by @ref hs_alloc_scratch() or @ref
+ *      hs_clone_scratch().
+ *
+ * @param buffer
+ *      The match buffer, which must remain valid while it is attached; or NULL
+ *      to detach any buffer and return to per-match delivery.
+ *
+ * @param capacity
+ *      The number of matches @a buffer can hold; must be non-zero if @a buffer
+ *      is not NULL.
+ *
+ * @param onBatch
+ *      The batch handler; must not be NULL if @a buffer is not NULL.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success, other values on failure.
+ */
+hs_error_t hs_set_scratch_match_buffer(hs_scratch_t *scratch,
+                                       hs_match_t *buffer,
+                                       unsigned int capacity,
+                                       match_batch_handler onBatch);
+
+/**
+ * Provides the scanned data for a range of offsets, without copying it, from
+ * within a match callback.
+ *
+ * While a match callback (@ref match_event_handler) runs, Hyperscan holds the
+ * block being scanned and, in streaming mode, the history that the stream
+ * retains from earlier writes. This function returns pointers into them for
+ * the stream offsets [@a from, @a to), which may span both: the part before
+ * the current block is returned in @a hist and the rest in @a data. Either
+ * part may be empty, in which case its pointer is NULL. The history retained
+ * is only as long as the database needs for matching, so it may not cover
+ * the start of every match.
+ *
+ * The pointers are only valid until the callback returns. The data is not
+ * available from a batch handler (@ref match_batch_handler), nor to the
+ * match callback of @ref hs_scan_parallel() when the block is divided between
+ * threads.
+ *
+ * @param scratch
+ *      The scratch space being used by the call that invoked the callback.
+ *
+ * @param from
+ *      The stream offset of the first byte wanted.
+ *
+ * @param to
+ *      The stream offset after the last byte wanted, such as the end offset
+ *      of a match. Must not be less than @a from.
+ *
+ * @param hist
+ *      On success, set to the part of the range held in stream history, or
+ *      NULL.
+ *
+ * @param hist_len
+ *      On success, set to the number of bytes at @a hist.
+ *
+ * @param data
+ *      On success, set to the part of the range in the block being scanned, or
+ *      NULL.
+ *
+ * @param data_len
+ *      On success, set to the number of bytes at @a data.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_DATA_UNAVAILABLE if the range is
+ *      not held, or if the scratch space is not in a callback; other values
+ *      on failure.
+ */
+hs_error_t hs_get_match_data(const hs_scratch_t *scratch,
+                             unsigned long long from, unsigned long long to,
+                             const char **hist, size_t *hist_len,
+                             const char **data, size_t *data_len);
+
+/**
+ * Provides the user data of the match being delivered, from within a match
+ * callback.
+ *
+ * This is the value given in hs_expr_ext::user_data when the matching
+ * expression was compiled, or zero if none was given. It lets the callback
+ * act on the match without looking up its ID; a batch handler (@ref
+ * match_batch_handler) finds it in hs_match::user_data instead. As with @ref
+ * hs_get_match_data(), it is not available to the match callback of @ref
+ * hs_scan_parallel() when the block is divided between threads.
+ *
+ * @param scratch
+ *      The scratch space being used by the call that invoked the callback.
+ *
+ * @param user_data
+ *      On success, set to the user data of the match.
+ *
+ * @return
+ *      @ref HS_SUCCESS on success; @ref HS_DATA_UNAVAILABLE if the scratch
+ *      space is not in a callback; other values on failure.
+ */
+hs_error_t hs_get_match_user_data(const hs_scratch_t *scratch,
+                                  unsigned long long *user_data);
 
 /**
  * Callback 'from' return value, indicating that the start of this match was
@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Flow scheduler: a pool of worker threads, each with its own scratch,
+ * that scans block-mode jobs and stream writes queued by the application.
+ *
+ * Each flow (stream) has a home worker chosen by hashing its key, so that its
+ * stream state stays in one worker's caches. A flow with writes pending is
+ * queued as a single task on its home worker's deque; the worker that takes
+ * the task runs the flow's writes in order until none are left, so writes to
+ * one flow are never scanned concurrently or out of order.
+ *
+ * Idle workers steal from the back of other workers' deques, but only tasks
+ * worth moving: block-mode jobs, and flows with at least
+ * SCHED_STEAL_MIN_BYTES queued. Small flows stay with their home worker.
+ *
+ * Workers sleep on their own condition variable. A worker sets its sleeping
+ * flag under its own lock before checking for work, and a producer publishes
+ * stealable work before looking for a sleeping worker to wake, so a wakeup is
+ * never lost.
+ */
+#include "hs_runtime.h"
+#include "ue2common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/** \brief Bytes a flow must have queued before another worker may steal it;
+ * smaller writes are cheaper to scan where the stream state is cached. */
+#define SCHED_STEAL_MIN_BYTES (64 * 1024)
+
+namespace {
+
+struct SchedFlow;
+
+/** \brief A queued stream write, or the close of a flow. */
+struct SchedWrite {
+    const char *data;
+    unsigned int length;
+    bool close;
+    match_event_handler onEvent;
+    void *context;
+};
+
+/** \brief A unit of work on a worker deque: a block-mode job if flow is
+ * null, otherwise a flow with pending writes. */
+struct SchedTask {
+    SchedFlow *flow;
+    const char *data;
+    unsigned int length;
+    match_event_handler onEvent;
+    void *context;
+    bool stealable;
+};
+
+struct SchedFlow {
+    hs_stream_t *stream = nullptr;
+    unsigned int home = 0;
+    deque<SchedWrite> pending; //!< guarded by the scheduler's flow_lock
+    size_t pending_bytes = 0; //!< guarded by the scheduler's flow_lock
+    bool queued = false; //!< on a deque or running; guarded by flow_lock
+};
+
+struct SchedWorker {
+    mutex m;
+    condition_variable cv;
+    deque<SchedTask> tasks; //!< guarded by m
+    atomic<bool> sleeping{false};
+    hs_scratch_t *scratch = nullptr;
+    thread t;
+
+    // Statistics, only written by this worker's thread.
+    atomic<unsigned long long> jobs{0};
+    atomic<unsigned long long> writes{0};
+    atomic<unsigned long long> bytes{0};
+    atomic<unsigned long long> steals{0};
+};
+
+} // namespace
+
+struct hs_scheduler {
+    const hs_database_t *db = nullptr;
+    vector<unique_ptr<SchedWorker>> workers;
+
+    /** \brief Guards the flow table and each flow's pending writes. A
+     * worker's lock may be taken while holding it, never the other way
+     * round. */
+    mutex flow_lock;
+    unordered_map<unsigned long long, SchedFlow *> flows; //!< open flows
+
+    /** \brief Tasks that any worker may take. */
+    atomic<size_t> stealable{0};
+    atomic<bool> stop{false};
+
+    /** \brief Queued jobs and writes not yet finished. */
+    mutex done_lock;
+    condition_variable done_cv;
+    size_t outstanding = 0; //!< guarded by done_lock
+    hs_error_t err = HS_SUCCESS; //!< first error since the last wait
+};
+
+namespace {
+
+static
+unsigned int homeWorker(const hs_scheduler *s, unsigned long long key) {
+    return (unsigned int)(hash<unsigned long long>()(key) %
+                          s->workers.size());
+}
+
+static
+void finishWork(hs_scheduler *s, size_t count, hs_error_t err) {
+    lock_guard<mutex> lock(s->done_lock);
+    if (err != HS_SUCCESS && err != HS_SCAN_TERMINATED &&
+        s->err == HS_SUCCESS) {
+        s->err = err;
+    }
+    assert(s->outstanding >= count);
+    s->outstanding -= count;
+    if (!s->outstanding) {
+        s->done_cv.notify_all();
+    }
+}
+
+/** \brief Wakes a sleeping worker other than \a home to steal work. */
+static
+void wakeThief(hs_scheduler *s, unsigned int home) {
+    for (size_t i = 0; i < s->workers.size(); i++) {
+        SchedWorker &w = *s->workers[i];
+        if (i != home && w.sleeping.load()) {
+            lock_guard<mutex> lock(w.m);
+            w.cv.notify_one();
+            return;
+        }
+    }
+}
+
+/** \brief Adds \a task to worker \a home's deque without waking anyone;
+ * follow with notifyTask(). May throw std::bad_alloc, leaving the deque as it
+ * was. */
+static
+void enqueueTask(hs_scheduler *s, unsigned int home, const SchedTask &task) {
+    SchedWorker &w = *s->workers[home];
+    lock_guard<mutex> lock(w.m);
+    w.tasks.push_back(task);
+    if (task.stealable) {
+        s->stealable++;
+    }
+}
+
+/** \brief Wakes the workers that may run a task added by enqueueTask(). */
+static
+void notifyTask(hs_scheduler *s, unsigned int home, bool stealable) {
+    s->workers[home]->cv.notify_one();
+    if (stealable) {
+        wakeThief(s, home);
+    }
+}
+
+static
+void pushTask(hs_scheduler *s, unsigned int home, const SchedTask &task) {
+    enqueueTask(s, home, task);
+    notifyTask(s, home, task.stealable);
+}
+
+/** \brief Takes the oldest task from worker \a i's own deque. */
+static
+bool popOwn(hs_scheduler *s, SchedWorker &w, SchedTask *task) {
+    lock_guard<mutex> lock(w.m);
+    if (w.tasks.empty()) {
+        return false;
+    }
+    *task = w.tasks.front();
+    w.tasks.pop_front();
+    if (task->stealable) {
+        s->stealable--;
+    }
+    return true;
+}
+
+/** \brief Takes the newest stealable task from another worker's deque. */
+static
+bool steal(hs_scheduler *s, unsigned int self, SchedTask *task) {
+    size_t n = s->workers.size();
+    for (size_t k = 1; k < n && s->stealable.load(); k++) {
+        SchedWorker &v = *s->workers[(self + k) % n];
+        lock_guard<mutex> lock(v.m);
+        for (auto it = v.tasks.rbegin(); it != v.tasks.rend(); ++it) {
+            if (it->stealable) {
+                *task = *it;
+                v.tasks.erase(next(it).base());
+                s->stealable--;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/** \brief Scans a flow's pending writes until there are none left. */
+static
+void runFlow(hs_scheduler *s, SchedWorker &w, SchedFlow *f) {
+    for (;;) {
+        SchedWrite wr;
+        {
+            lock_guard<mutex> lock(s->flow_lock);
+            if (f->pending.empty()) {
+                f->queued = false;
+                return;
+            }
+            wr = f->pending.front();
+            f->pending.pop_front();
+            f->pending_bytes -= wr.length;
+        }
+
+        hs_error_t err;
+        if (wr.close) {
+            // The close is always the flow's last write; the flow has already
+            // been removed from the flow table.
+            err = hs_close_stream(f->stream, w.scratch, wr.onEvent,
+                                  wr.context);
+            delete f;
+            finishWork(s, 1, err);
+            return;
+        }
+
+        err = hs_scan_stream(f->stream, wr.data, wr.length, 0, w.scratch,
+                             wr.onEvent, wr.context);
+        w.writes.fetch_add(1, memory_order_relaxed);
+        w.bytes.fetch_add(wr.length, memory_order_relaxed);
+        finishWork(s, 1, err);
+    }
+}
+
+static
+void runTask(hs_scheduler *s, SchedWorker &w, const SchedTask &task) {
+    if (task.flow) {
+        runFlow(s, w, task.flow);
+        return;
+    }
+
+    hs_error_t err = hs_scan(s->db, task.data, task.length, 0, w.scratch,
+                             task.onEvent, task.context);
+    w.jobs.fetch_add(1, memory_order_relaxed);
+    w.bytes.fetch_add(task.length, memory_order_relaxed);
+    finishWork(s, 1, err);
+}
+
+static
+void workerMain(hs_scheduler *s, unsigned int self) {
+    SchedWorker &w = *s->workers[self];
+    for (;;) {
+        SchedTask task;
+        if (popOwn(s, w, &task)) {
+            runTask(s, w, task);
+            continue;
+        }
+        if (steal(s, self, &task)) {
+            w.steals.fetch_add(1, memory_order_relaxed);
+            runTask(s, w, task);
+            continue;
+        }
+
+        unique_lock<mutex> lock(w.m);
+        w.sleeping = true;
+        w.cv.wait(lock, [s, &w] {
+            return !w.tasks.empty() || s->stealable.load() || s->stop.load();
+        });
+        w.sleeping = false;
+        if (w.tasks.empty() && s->stop.load()) {
+            return;
+        }
+    }
+}
+
+static
+void addOutstanding(hs_scheduler *s) {
+    lock_guard<mutex> lock(s->done_lock);
+    s->outstanding++;
+}
+
+/** \brief Queues a write to a flow, and the flow on its home worker if it is
+ * not queued already. */
+static
+hs_error_t queueWrite(hs_scheduler *s, SchedFlow *f, const SchedWrite &wr) {
+    // Count the write before it is visible: a worker already running the flow
+    // may take and finish it as soon as flow_lock is released.
+    addOutstanding(s);
+
+    bool queued_flow = false;
+    bool stealable = false;
+    bool failed = false;
+    {
+        lock_guard<mutex> lock(s->flow_lock);
+        try {
+            f->pending.push_back(wr);
+        } catch (const bad_alloc &) {
+            failed = true;
+        }
+        if (!failed) {
+            f->pending_bytes += wr.length;
+        }
+        if (!failed && !f->queued) {
+            // Queue the flow before releasing flow_lock. Once it is released,
+            // writes from other threads can join this one and return success
+            // on the strength of the flow being queued.
+            stealable = f->pending_bytes >= SCHED_STEAL_MIN_BYTES;
+            SchedTask task = {f, nullptr, 0, nullptr, nullptr, stealable};
+            try {
+                enqueueTask(s, f->home, task);
+                f->queued = true;
+                queued_flow = true;
+            } catch (const bad_alloc &) {
+                f->pending.pop_back();
+                f->pending_bytes -= wr.length;
+                failed = true;
+            }
+        }
+    }
+
+    if (failed) {
+        finishWork(s, 1, HS_SUCCESS);
+        return HS_NOMEM;
+    }
+    if (queued_flow) {
+        notifyTask(s, f->home, stealable);
+    }
+    return HS_SUCCESS;
+}
+
+static
+void stopWorkers(hs_scheduler *s) {
+    s->stop = true;
+    for (auto &w : s->workers) {
+        {
+            lock_guard<mutex> lock(w->m);
+        }
+        w->cv.notify_all();
+    }
+    for (auto &w : s->workers) {
+        if (w->t.joinable()) {
+            w->t.join();
+        }
+        hs_free_scratch(w->scratch);
+    }
+}
+
+} // namespace
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_alloc_scheduler(const hs_database_t *db,
+                              unsigned int num_workers,
+                              const hs_scratch_t *scratch,
+                              hs_scheduler_t **sched) {
+    if (!db || !scratch || !sched) {
+        return HS_INVALID;
+    }
+    *sched = nullptr;
+
+    unsigned int workers = num_workers;
+    if (!workers) {
+        workers = max(thread::hardware_concurrency(), 1U);
+    }
+
+    hs_scheduler *s = nullptr;
+    try {
+        s = new hs_scheduler;
+        s->db = db;
+        s->workers.reserve(workers);
+        for (unsigned int i = 0; i < workers; i++) {
+            s->workers.emplace_back(new SchedWorker);
+        }
+    } catch (const bad_alloc &) {
+        delete s;
+        return HS_NOMEM;
+    }
+
+    for (auto &w : s->workers) {
+        hs_error_t err = hs_clone_scratch(scratch, &w->scratch);
+        if (err != HS_SUCCESS) {
+            stopWorkers(s);
+            delete s;
+            return err;
+        }
+    }
+
+    for (unsigned int i = 0; i < workers; i++) {
+        try {
+            s->workers[i]->t = thread(workerMain, s, i);
+        } catch (const system_error &) {
+            stopWorkers(s);
+            delete s;
+            return HS_NOMEM;
+        }
+    }
+
+    DEBUG_PRINTF("scheduler %p has %u workers\n", s, workers);
+    *sched = s;
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scheduler_scan(hs_scheduler_t *sched, const char *data,
+                             unsigned int length, match_event_handler onEvent,
+                             void *context) {
+    if (!sched || !data) {
+        return HS_INVALID;
+    }
+
+    // Block jobs have no affinity: spread them round robin, for any idle
+    // worker to steal.
+    static thread_local unsigned int next_home = 0;
+    unsigned int home = next_home++ % sched->workers.size();
+
+    addOutstanding(sched);
+    SchedTask task = {nullptr, data, length, onEvent, context, true};
+    try {
+        pushTask(sched, home, task);
+    } catch (const bad_alloc &) {
+        finishWork(sched, 1, HS_SUCCESS);
+        return HS_NOMEM;
+    }
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scheduler_scan_stream(hs_scheduler_t *sched,
+                                    unsigned long long flow, const char *data,
+                                    unsigned int length,
+                                    match_event_handler onEvent,
+                                    void *context) {
+    if (!sched || !data) {
+        return HS_INVALID;
+    }
+
+    SchedFlow *f;
+    {
+        lock_guard<mutex> lock(sched->flow_lock);
+        auto it = sched->flows.find(flow);
+        if (it != sched->flows.end()) {
+            f = it->second;
+        } else {
+            try {
+                f = new SchedFlow;
+            } catch (const bad_alloc &) {
+                return HS_NOMEM;
+            }
+            hs_error_t err = hs_open_stream(sched->db, 0, &f->stream);
+            if (err != HS_SUCCESS) {
+                delete f;
+                return err;
+            }
+            f->home = homeWorker(sched, flow);
+            try {
+                sched->flows.emplace(flow, f);
+            } catch (const bad_alloc &) {
+                hs_close_stream(f->stream, nullptr, nullptr, nullptr);
+                delete f;
+                return HS_NOMEM;
+            }
+        }
+    }
+
+    SchedWrite wr = {data, length, false, onEvent, context};
+    return queueWrite(sched, f, wr);
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scheduler_close_stream(hs_scheduler_t *sched,
+                                     unsigned long long flow,
+                                     match_event_handler onEvent,
+                                     void *context) {
+    if (!sched) {
+        return HS_INVALID;
+    }
+
+    SchedFlow *f;
+    {
+        lock_guard<mutex> lock(sched->flow_lock);
+        auto it = sched->flows.find(flow);
+        if (it == sched->flows.end()) {
+            return HS_INVALID;
+        }
+        f = it->second;
+        // Later writes with the same key open a new flow.
+        sched->flows.erase(it);
+    }
+
+    SchedWrite wr = {nullptr, 0, true, onEvent, context};
+    return queueWrite(sched, f, wr);
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scheduler_wait(hs_scheduler_t *sched) {
+    if (!sched) {
+        return HS_INVALID;
+    }
+
+    unique_lock<mutex> lock(sched->done_lock);
+    sched->done_cv.wait(lock, [sched] { return !sched->outstanding; });
+    hs_error_t err = sched->err;
+    sched->err = HS_SUCCESS;
+    return err;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scheduler_worker_stats(const hs_scheduler_t *sched,
+                                     unsigned int worker,
+                                     hs_scheduler_stats_t *stats) {
+    if (!sched || !stats || worker >= sched->workers.size()) {
+        return HS_INVALID;
+    }
+
+    const SchedWorker &w = *sched->workers[worker];
+    stats->jobs = w.jobs.load(memory_order_relaxed);
+    stats->writes = w.writes.load(memory_order_relaxed);
+    stats->bytes = w.bytes.load(memory_order_relaxed);
+    stats->steals = w.steals.load(memory_order_relaxed);
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_free_scheduler(hs_scheduler_t *sched) {
+    if (!sched) {
+        return HS_SUCCESS;
+    }
+
+    hs_scheduler_wait(sched);
+    stopWorkers(sched);
+
+    // Flows never closed are freed without reporting their EOD matches.
+    for (auto &m : sched->flows) {
+        hs_close_stream(m.second->stream, nullptr, nullptr, nullptr);
+        delete m.second;
+    }
+    delete sched;
+    return HS_SUCCESS;
+}
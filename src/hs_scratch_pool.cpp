@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Scratch pool: a thread-safe cache of scratch spaces for a database.
+ *
+ * Idle scratch spaces are kept in a set of stripes, each a small array of
+ * atomic slots on its own cache line. Each thread starts its search at a
+ * stripe chosen from its thread id, so that threads rarely contend for the
+ * same line. Taking a scratch is an atomic exchange of a slot with NULL and
+ * returning one is a compare-and-swap of an empty slot, so the fast paths are
+ * lock-free; as only the scratch pointer itself moves in and out of a slot,
+ * there is no ABA problem.
+ *
+ * Every scratch handed out by the pool is cloned from a prototype sized for
+ * the pool's current database, and is stamped with the prototype's
+ * generation. Swapping the database builds a new prototype under a lock and
+ * bumps the generation; scratch spaces from older generations are freed
+ * lazily as they are met in the slots or returned to the pool, so the pool
+ * grows or shrinks to suit the new database without stopping the scanning
+ * threads.
+ */
+#include "hs_runtime.h"
+#include "scratch.h"
+#include "ue2common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+using namespace std;
+
+/** \brief Number of scratch spaces cached in each stripe. */
+#define SCRATCH_POOL_SLOTS 8
+
+/** \brief Upper bound on the number of stripes in a pool. */
+#define SCRATCH_POOL_MAX_STRIPES 64
+
+namespace {
+
+/** \brief One cache line of idle scratch spaces. */
+struct ScratchStripe {
+    atomic<hs_scratch_t *> slot[SCRATCH_POOL_SLOTS];
+};
+
+} // namespace
+
+struct hs_scratch_pool {
+    hs_scratch_pool(unsigned int n) : stripes(new ScratchStripe[n]),
+                                      stripe_count(n) {
+        for (unsigned int i = 0; i < n; i++) {
+            for (auto &s : stripes[i].slot) {
+                s.store(nullptr, memory_order_relaxed);
+            }
+        }
+    }
+
+    unique_ptr<ScratchStripe[]> stripes;
+    unsigned int stripe_count; //!< power of two
+
+    /** \brief Generation of the current prototype; scratch spaces with any
+     * other value in pool_gen are stale. */
+    atomic<u32> gen{0};
+
+    /** \brief Guards proto, which is only used when the pool has no suitable
+     * idle scratch space. */
+    mutex proto_lock;
+    hs_scratch_t *proto = nullptr;
+};
+
+namespace {
+
+/** \brief Index of the first stripe searched by the calling thread. */
+static
+unsigned int homeStripe(const hs_scratch_pool *pool) {
+    static thread_local size_t home =
+        hash<thread::id>()(this_thread::get_id());
+    return (unsigned int)(home & (pool->stripe_count - 1));
+}
+
+static
+bool isCurrent(const hs_scratch_pool *pool, const hs_scratch_t *s) {
+    return s->pool_gen == pool->gen.load(memory_order_acquire);
+}
+
+/** \brief Takes an idle scratch space from the pool, or returns NULL if there
+ * is none. Stale scratch spaces found along the way are freed. */
+static
+hs_scratch_t *takeIdle(hs_scratch_pool *pool) {
+    const unsigned int home = homeStripe(pool);
+    for (unsigned int i = 0; i < pool->stripe_count; i++) {
+        ScratchStripe &stripe =
+            pool->stripes[(home + i) & (pool->stripe_count - 1)];
+        for (auto &slot : stripe.slot) {
+            if (!slot.load(memory_order_relaxed)) {
+                continue;
+            }
+            hs_scratch_t *s = slot.exchange(nullptr, memory_order_acquire);
+            if (!s) {
+                continue;
+            }
+            if (isCurrent(pool, s)) {
+                return s;
+            }
+            DEBUG_PRINTF("freeing stale scratch %p\n", s);
+            hs_free_scratch(s);
+        }
+    }
+    return nullptr;
+}
+
+/** \brief Puts a scratch space into an empty slot, returning false if the pool
+ * is full. */
+static
+bool putIdle(hs_scratch_pool *pool, hs_scratch_t *s) {
+    const unsigned int home = homeStripe(pool);
+    for (unsigned int i = 0; i < pool->stripe_count; i++) {
+        ScratchStripe &stripe =
+            pool->stripes[(home + i) & (pool->stripe_count - 1)];
+        for (auto &slot : stripe.slot) {
+            hs_scratch_t *expected = nullptr;
+            if (slot.compare_exchange_strong(expected, s,
+                                             memory_order_release,
+                                             memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/** \brief Builds a prototype scratch space for the given database and
+ * installs it as the pool's current generation. */
+static
+hs_error_t installPrototype(hs_scratch_pool *pool, const hs_database_t *db) {
+    hs_scratch_t *proto = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &proto);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    lock_guard<mutex> lock(pool->proto_lock);
+    u32 gen = pool->gen.load(memory_order_relaxed) + 1;
+    proto->pool_gen = gen;
+    hs_free_scratch(pool->proto);
+    pool->proto = proto;
+    pool->gen.store(gen, memory_order_release);
+    return HS_SUCCESS;
+}
+
+} // namespace
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_alloc_scratch_pool(const hs_database_t *db,
+                                 unsigned int num_threads,
+                                 hs_scratch_pool_t **pool) {
+    if (!db || !pool) {
+        return HS_INVALID;
+    }
+    *pool = nullptr;
+
+    unsigned int threads = num_threads;
+    if (!threads) {
+        threads = max(thread::hardware_concurrency(), 1U);
+    }
+
+    // One stripe per SCRATCH_POOL_SLOTS threads, rounded up to a power of
+    // two.
+    unsigned int stripes = 1;
+    while (stripes * SCRATCH_POOL_SLOTS < threads &&
+           stripes < SCRATCH_POOL_MAX_STRIPES) {
+        stripes *= 2;
+    }
+
+    hs_scratch_pool *p;
+    try {
+        p = new hs_scratch_pool(stripes);
+    } catch (const bad_alloc &) {
+        return HS_NOMEM;
+    }
+
+    hs_error_t err = installPrototype(p, db);
+    if (err != HS_SUCCESS) {
+        delete p;
+        return err;
+    }
+
+    DEBUG_PRINTF("pool %p has %u stripes\n", p, stripes);
+    *pool = p;
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scratch_pool_get(hs_scratch_pool_t *pool,
+                               hs_scratch_t **scratch) {
+    if (!pool || !scratch) {
+        return HS_INVALID;
+    }
+
+    hs_scratch_t *s = takeIdle(pool);
+    if (s) {
+        *scratch = s;
+        return HS_SUCCESS;
+    }
+
+    lock_guard<mutex> lock(pool->proto_lock);
+    return hs_clone_scratch(pool->proto, scratch);
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scratch_pool_put(hs_scratch_pool_t *pool,
+                               hs_scratch_t *scratch) {
+    if (!pool || !scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    if (scratch->in_use) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    if (!isCurrent(pool, scratch) || !putIdle(pool, scratch)) {
+        DEBUG_PRINTF("freeing scratch %p\n", scratch);
+        return hs_free_scratch(scratch);
+    }
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_scratch_pool_update(hs_scratch_pool_t *pool,
+                                  const hs_database_t *db) {
+    if (!pool || !db) {
+        return HS_INVALID;
+    }
+
+    hs_error_t err = installPrototype(pool, db);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    // Release the memory held by idle scratch spaces from older generations
+    // now, rather than waiting for them to be found by hs_scratch_pool_get().
+    for (unsigned int i = 0; i < pool->stripe_count; i++) {
+        for (auto &slot : pool->stripes[i].slot) {
+            hs_scratch_t *s = slot.exchange(nullptr, memory_order_acquire);
+            if (!s) {
+                continue;
+            }
+            if (!isCurrent(pool, s) || !putIdle(pool, s)) {
+                hs_free_scratch(s);
+            }
+        }
+    }
+    return HS_SUCCESS;
+}
+
+extern "C" HS_PUBLIC_API
+hs_error_t hs_free_scratch_pool(hs_scratch_pool_t *pool) {
+    if (!pool) {
+        return HS_SUCCESS;
+    }
+
+    for (unsigned int i = 0; i < pool->stripe_count; i++) {
+        for (auto &slot : pool->stripes[i].slot) {
+            hs_free_scratch(slot.load(memory_order_relaxed));
+        }
+    }
+    hs_free_scratch(pool->proto);
+    delete pool;
+    return HS_SUCCESS;
+}
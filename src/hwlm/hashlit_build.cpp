@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ * \brief Hashed literal matcher: build code.
+ */
+
+#include "hashlit_build.h"
+
+#include "hashlit_internal.h"
+#include "hwlm_literal.h"
+#include "util/alloc.h"
+#include "util/unaligned.h"
+#include "util/verify_types.h"
+#include "ue2common.h"
+
+#include <algorithm>
+#include <cstring> // for memcpy
+#include <vector>
+
+using namespace std;
+
+namespace ue2 {
+
+/** \brief Bloom filter bits per literal. With two probes this lets about one
+ * position in seventy through to the bucket lookup on random data. */
+static const size_t FILTER_BITS_PER_LIT = 16;
+
+static const u32 MIN_FILTER_BITS = 10;
+static const u32 MAX_FILTER_BITS = 31;
+
+/** \brief Aim for about two entries per bucket, keeping the bucket index
+ * small while each lookup still reads only one or two cache lines. */
+static const size_t LITS_PER_BUCKET = 2;
+
+static
+u32 ceilLog2(size_t x) {
+    u32 bits = 0;
+    while (bits < 63 && (1ULL << bits) < x) {
+        bits++;
+    }
+    return bits;
+}
+
+namespace {
+struct KeyedEntry {
+    u32 bucket;
+    hashLitEntry e;
+};
+}
+
+aligned_unique_ptr<hashLitTable>
+hashLitBuildTable(const vector<hwlmLiteral> &lits) {
+    vector<KeyedEntry> keyed[HASHLIT_CLASSES];
+    size_t str_len = 0;
+    u32 max_len = 0;
+
+    for (const auto &lit : lits) {
+        if (!lit.msk.empty()) {
+            DEBUG_PRINTF("hashlit can't handle supplementary masks\n");
+            return nullptr;
+        }
+        const size_t len = lit.s.length();
+        if (len < HASHLIT_MIN_LEN) {
+            DEBUG_PRINTF("literal too short for hashlit\n");
+            return nullptr;
+        }
+        str_len += len;
+        max_len = max(max_len, verify_u32(len));
+
+        const u8 *s = (const u8 *)lit.s.c_str();
+        KeyedEntry k;
+        memset(&k, 0, sizeof(k));
+        k.e.groups = lit.groups;
+        k.e.key_lo = unaligned_load_u32(s + len - 4) & HASHLIT_FOLD;
+        k.e.id = lit.id;
+        k.e.len = verify_u16(len);
+        k.e.nocase = lit.nocase ? 1 : 0;
+
+        u32 c = HASHLIT_CLASS_4;
+        if (len >= 8) {
+            c = HASHLIT_CLASS_8;
+            k.e.key_hi = unaligned_load_u32(s + len - 8) & HASHLIT_FOLD;
+        }
+        keyed[c].push_back(k);
+    }
+
+    // Lay out the table: header, then filter, buckets and entries for each
+    // class, then the literal strings.
+    size_t size = ROUNDUP_CL(sizeof(hashLitTable));
+    hashLitClass cls[HASHLIT_CLASSES];
+    memset(cls, 0, sizeof(cls));
+    for (u32 c = 0; c < HASHLIT_CLASSES; c++) {
+        auto &hc = cls[c];
+        const size_t count = keyed[c].size();
+        if (!count) {
+            continue;
+        }
+        hc.count = verify_u32(count);
+        hc.filter_bits = min(MAX_FILTER_BITS,
+                             max(MIN_FILTER_BITS,
+                                 ceilLog2(count * FILTER_BITS_PER_LIT)));
+        hc.bucket_bits = max(1U, ceilLog2(count / LITS_PER_BUCKET));
+
+        hc.filter_offset = verify_u32(size);
+        size = ROUNDUP_CL(size + (1ULL << hc.filter_bits) / 8);
+        hc.bucket_offset = verify_u32(size);
+        size = ROUNDUP_CL(size + ((1ULL << hc.bucket_bits) + 1) * sizeof(u32));
+        hc.entry_offset = verify_u32(size);
+        size = ROUNDUP_CL(size + count * sizeof(hashLitEntry));
+    }
+    const size_t str_offset = size;
+    size = verify_u32(size + str_len);
+
+    auto t = aligned_zmalloc_unique<hashLitTable>(size);
+    assert(t);
+
+    t->size = verify_u32(size);
+    t->count = verify_u32(lits.size());
+    t->max_len = max_len;
+    copy(begin(cls), end(cls), t->cls);
+
+    // The literal strings are written in input order, and each literal's
+    // entry is pointed at its string.
+    u8 *base = (u8 *)t.get();
+    size_t curr = str_offset;
+    size_t idx[HASHLIT_CLASSES] = {0, 0};
+    for (const auto &lit : lits) {
+        const size_t len = lit.s.length();
+        u32 c = len >= 8 ? HASHLIT_CLASS_8 : HASHLIT_CLASS_4;
+        keyed[c][idx[c]++].e.str_offset = verify_u32(curr);
+        memcpy(base + curr, lit.s.c_str(), len);
+        curr += len;
+    }
+    assert(curr == size);
+
+    for (u32 c = 0; c < HASHLIT_CLASSES; c++) {
+        const auto &hc = cls[c];
+        if (!hc.count) {
+            continue;
+        }
+
+        auto &entries = keyed[c];
+        u32 *filter = (u32 *)(base + hc.filter_offset);
+        for (auto &k : entries) {
+            u32 mix = hashLitMix(k.e.key_lo, k.e.key_hi);
+            u32 p1 = hashLitProbe1(mix, hc.filter_bits);
+            u32 p2 = hashLitProbe2(mix, hc.filter_bits);
+            filter[p1 / 32] |= 1U << (p1 % 32);
+            filter[p2 / 32] |= 1U << (p2 % 32);
+            k.bucket = hashLitBucket(mix, hc.bucket_bits);
+        }
+
+        stable_sort(begin(entries), end(entries),
+                    [](const KeyedEntry &a, const KeyedEntry &b) {
+                        return a.bucket < b.bucket;
+                    });
+
+        u32 *buckets = (u32 *)(base + hc.bucket_offset);
+        hashLitEntry *out = (hashLitEntry *)(base + hc.entry_offset);
+        const u32 num_buckets = 1U << hc.bucket_bits;
+        u32 i = 0;
+        for (u32 b = 0; b < num_buckets; b++) {
+            buckets[b] = i;
+            while (i < entries.size() && entries[i].bucket == b) {
+                out[i] = entries[i].e;
+                i++;
+            }
+        }
+        buckets[num_buckets] = i;
+        assert(i == hc.count);
+    }
+
+    return t;
+}
+
+size_t hashLitSize(const hashLitTable *t) {
+    assert(t);
+    return t->size;
+}
+
+} // namespace ue2
+
+#ifdef DUMP_SUPPORT
+
+namespace ue2 {
+
+void hashLitPrintStats(const hashLitTable *t, FILE *f) {
+    fprintf(f, "Hashed literal table\n");
+    fprintf(f, "Literals: %u Max Len: %u Size: %u\n", t->count, t->max_len,
+            t->size);
+    for (u32 c = 0; c < HASHLIT_CLASSES; c++) {
+        const hashLitClass &hc = t->cls[c];
+        if (!hc.count) {
+            continue;
+        }
+
+        const u32 *buckets =
+            (const u32 *)((const u8 *)t + hc.bucket_offset);
+        const u32 num_buckets = 1U << hc.bucket_bits;
+        u32 used = 0, longest = 0;
+        for (u32 b = 0; b < num_buckets; b++) {
+            u32 n = buckets[b + 1] - buckets[b];
+            used += n ? 1 : 0;
+            longest = max(longest, n);
+        }
+
+        fprintf(f, "Class %u-byte key: %u literals, filter 2^%u bits, "
+                "%u/%u buckets used, longest %u\n",
+                c == HASHLIT_CLASS_8 ? 8 : 4, hc.count, hc.filter_bits, used,
+                num_buckets, longest);
+    }
+}
+
+} // namespace ue2
+
+#endif
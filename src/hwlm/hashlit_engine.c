@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Hashed literal matcher: runtime.
+ */
+
+#include "hashlit_engine.h"
+#include "hashlit_internal.h"
+#include "hwlm.h"
+#include "ue2common.h"
+#include "util/bitutils.h"
+#include "util/compare.h"
+#include "util/simd_utils.h"
+#include "util/unaligned.h"
+
+#include <string.h>
+
+#define RETURN_IF_TERMINATED(x)                                                \
+    {                                                                          \
+        if ((x) == HWLM_TERMINATED) {                                          \
+            return HWLM_TERMINATED;                                            \
+        }                                                                      \
+    }
+
+static really_inline
+const struct hashLitClass *getClass(const struct hashLitTable *t, u32 c) {
+    const struct hashLitClass *hc = &t->cls[c];
+    return hc->count ? hc : NULL;
+}
+
+static really_inline
+int filterProbe(const struct hashLitTable *t, const struct hashLitClass *hc,
+                u32 probe) {
+    const u32 *filter = (const u32 *)((const u8 *)t + hc->filter_offset);
+    return !!(filter[probe / 32] & (1U << (probe % 32)));
+}
+
+/** \brief Reports the literals of class \a hc whose key hashes to \a mix and
+ * which end at \a end, start no later than \a max_start and match the data. */
+static really_inline
+hwlm_error_t confirm(const struct hashLitTable *t,
+                     const struct hashLitClass *hc, u32 mix, u32 lo, u32 hi,
+                     const u8 *buf, size_t end, size_t max_start,
+                     size_t offset_adj, HWLMCallback cb, void *ctxt,
+                     hwlm_group_t *groups) {
+    const u8 *base = (const u8 *)t;
+    const u32 *buckets = (const u32 *)(base + hc->bucket_offset);
+    const struct hashLitEntry *entries
+        = (const struct hashLitEntry *)(base + hc->entry_offset);
+
+    u32 b = hashLitBucket(mix, hc->bucket_bits);
+    for (u32 i = buckets[b], e = buckets[b + 1]; i < e; i++) {
+        const struct hashLitEntry *ent = &entries[i];
+        if (ent->key_lo != lo || ent->key_hi != hi
+            || !(ent->groups & *groups) || end + 1 < ent->len) {
+            continue;
+        }
+        size_t start = end + 1 - ent->len;
+        if (start > max_start) {
+            continue;
+        }
+        if (cmpForward(buf + start, base + ent->str_offset, ent->len,
+                       ent->nocase)) {
+            continue;
+        }
+
+        DEBUG_PRINTF("match @ %zu->%zu\n", start + offset_adj,
+                     end + offset_adj);
+        hwlmcb_rv_t rv = cb(start + offset_adj, end + offset_adj, ent->id,
+                            ctxt);
+        if (rv == HWLM_TERMINATE_MATCHING) {
+            return HWLM_TERMINATED;
+        }
+        *groups = rv;
+    }
+    return HWLM_SUCCESS;
+}
+
+/** \brief Checks class \a hc at a position whose first filter probe has
+ * already passed. */
+static really_inline
+hwlm_error_t checkClass(const struct hashLitTable *t,
+                        const struct hashLitClass *hc, u32 mix, u32 lo,
+                        u32 hi, const u8 *buf, size_t end, size_t max_start,
+                        size_t offset_adj, HWLMCallback cb, void *ctxt,
+                        hwlm_group_t *groups) {
+    if (!filterProbe(t, hc, hashLitProbe2(mix, hc->filter_bits))) {
+        return HWLM_SUCCESS;
+    }
+    return confirm(t, hc, mix, lo, hi, buf, end, max_start, offset_adj, cb,
+                   ctxt, groups);
+}
+
+/** \brief Checks both classes at position \a end, hashing in scalar code. */
+static really_inline
+hwlm_error_t scanPos(const struct hashLitTable *t,
+                     const struct hashLitClass *c4,
+                     const struct hashLitClass *c8, const u8 *buf,
+                     size_t end, size_t max_start, size_t offset_adj,
+                     HWLMCallback cb, void *ctxt, hwlm_group_t *groups) {
+    assert(end >= HASHLIT_MIN_LEN - 1);
+    u32 lo = unaligned_load_u32(buf + end - 3) & HASHLIT_FOLD;
+
+    if (c4) {
+        u32 mix = hashLitMix(lo, 0);
+        if (filterProbe(t, c4, hashLitProbe1(mix, c4->filter_bits))) {
+            hwlm_error_t rv = checkClass(t, c4, mix, lo, 0, buf, end,
+                                         max_start, offset_adj, cb, ctxt,
+                                         groups);
+            RETURN_IF_TERMINATED(rv);
+        }
+    }
+
+    if (c8 && end >= 7) {
+        u32 hi = unaligned_load_u32(buf + end - 7) & HASHLIT_FOLD;
+        u32 mix = hashLitMix(lo, hi);
+        if (filterProbe(t, c8, hashLitProbe1(mix, c8->filter_bits))) {
+            hwlm_error_t rv = checkClass(t, c8, mix, lo, hi, buf, end,
+                                         max_start, offset_adj, cb, ctxt,
+                                         groups);
+            RETURN_IF_TERMINATED(rv);
+        }
+    }
+
+    return HWLM_SUCCESS;
+}
+
+#if defined(__AVX2__)
+/** \brief Number of positions fingerprinted together. */
+#define HASHLIT_BLOCK 8
+
+/** \brief Applies the first filter probe of class \a hc to the eight hashes in
+ * \a mix, returning a mask of the positions that pass. */
+static really_inline
+u32 filterBlock(const struct hashLitTable *t, const struct hashLitClass *hc,
+                m256 mix) {
+    const int *filter = (const int *)((const u8 *)t + hc->filter_offset);
+    m256 probe = _mm256_srl_epi32(mix, _mm_cvtsi32_si128(32 - hc->filter_bits));
+    m256 words = _mm256_i32gather_epi32(filter, _mm256_srli_epi32(probe, 5), 4);
+    m256 bits = _mm256_sllv_epi32(_mm256_set1_epi32(1),
+                                  and256(probe, _mm256_set1_epi32(31)));
+    m256 miss = _mm256_cmpeq_epi32(and256(words, bits), zeroes256());
+    return ~(u32)_mm256_movemask_ps(_mm256_castsi256_ps(miss)) & 0xff;
+}
+
+/**
+ * \brief Scans the eight positions from \a end, which must be at least seven,
+ * with at least nine bytes of data from \a end.
+ *
+ * The sixteen bytes from seven before \a end are shuffled into the four-byte
+ * keys ending at each position, which are folded and hashed together; the
+ * first filter probe of each class is then a single gather.
+ */
+static really_inline
+hwlm_error_t scanBlock(const struct hashLitTable *t,
+                       const struct hashLitClass *c4,
+                       const struct hashLitClass *c8, const u8 *buf,
+                       size_t end, size_t max_start, size_t offset_adj,
+                       HWLMCallback cb, void *ctxt, hwlm_group_t *groups) {
+    const m256 lo_ctl = _mm256_setr_epi8(4, 5, 6, 7, 5, 6, 7, 8,
+                                         6, 7, 8, 9, 7, 8, 9, 10,
+                                         8, 9, 10, 11, 9, 10, 11, 12,
+                                         10, 11, 12, 13, 11, 12, 13, 14);
+    const m256 hi_ctl = _mm256_setr_epi8(0, 1, 2, 3, 1, 2, 3, 4,
+                                         2, 3, 4, 5, 3, 4, 5, 6,
+                                         4, 5, 6, 7, 5, 6, 7, 8,
+                                         6, 7, 8, 9, 7, 8, 9, 10);
+    const m256 fold = _mm256_set1_epi32((int)HASHLIT_FOLD);
+
+    assert(end >= 7);
+    m256 v = set2x128(loadu128(buf + end - 7));
+    m256 lo = and256(vpshufb(v, lo_ctl), fold);
+    m256 mix4 = _mm256_mullo_epi32(lo, _mm256_set1_epi32((int)0x9e3779b1U));
+
+    u32 ALIGN_AVX_DIRECTIVE los[HASHLIT_BLOCK];
+    u32 ALIGN_AVX_DIRECTIVE mixes4[HASHLIT_BLOCK];
+    u32 ALIGN_AVX_DIRECTIVE his[HASHLIT_BLOCK];
+    u32 ALIGN_AVX_DIRECTIVE mixes8[HASHLIT_BLOCK];
+
+    u32 m4 = 0;
+    if (c4) {
+        m4 = filterBlock(t, c4, mix4);
+    }
+
+    u32 m8 = 0;
+    m256 hi = zeroes256();
+    m256 mix8 = zeroes256();
+    if (c8) {
+        hi = and256(vpshufb(v, hi_ctl), fold);
+        mix8 = xor256(mix4, _mm256_mullo_epi32(hi, _mm256_set1_epi32(
+                                                       (int)0x85ebca77U)));
+        m8 = filterBlock(t, c8, mix8);
+    }
+
+    u32 any = m4 | m8;
+    if (likely(!any)) {
+        return HWLM_SUCCESS;
+    }
+
+    store256(los, lo);
+    store256(mixes4, mix4);
+    store256(his, hi);
+    store256(mixes8, mix8);
+
+    while (any) {
+        u32 i = findAndClearLSB_32(&any);
+        if (m4 & (1U << i)) {
+            hwlm_error_t rv = checkClass(t, c4, mixes4[i], los[i], 0, buf,
+                                         end + i, max_start, offset_adj, cb,
+                                         ctxt, groups);
+            RETURN_IF_TERMINATED(rv);
+        }
+        if (m8 & (1U << i)) {
+            hwlm_error_t rv = checkClass(t, c8, mixes8[i], los[i], his[i],
+                                         buf, end + i, max_start, offset_adj,
+                                         cb, ctxt, groups);
+            RETURN_IF_TERMINATED(rv);
+        }
+    }
+
+    return HWLM_SUCCESS;
+}
+#endif
+
+/** \brief Reports matches ending at or after \a min_end and starting at or
+ * before \a max_start, in order of end offset. */
+static never_inline
+hwlm_error_t scan(const struct hashLitTable *t, const u8 *buf, size_t len,
+                  size_t min_end, size_t max_start, size_t offset_adj,
+                  HWLMCallback cb, void *ctxt, hwlm_group_t groups) {
+    const struct hashLitClass *c4 = getClass(t, HASHLIT_CLASS_4);
+    const struct hashLitClass *c8 = getClass(t, HASHLIT_CLASS_8);
+
+    size_t end = MAX(min_end, HASHLIT_MIN_LEN - 1);
+
+#if defined(__AVX2__)
+    for (; end < 7 && end < len; end++) {
+        hwlm_error_t rv = scanPos(t, c4, c8, buf, end, max_start, offset_adj,
+                                  cb, ctxt, &groups);
+        RETURN_IF_TERMINATED(rv);
+    }
+    for (; end + HASHLIT_BLOCK + 1 <= len; end += HASHLIT_BLOCK) {
+        hwlm_error_t rv = scanBlock(t, c4, c8, buf, end, max_start,
+                                    offset_adj, cb, ctxt, &groups);
+        RETURN_IF_TERMINATED(rv);
+    }
+#endif
+
+    for (; end < len; end++) {
+        hwlm_error_t rv = scanPos(t, c4, c8, buf, end, max_start, offset_adj,
+                                  cb, ctxt, &groups);
+        RETURN_IF_TERMINATED(rv);
+    }
+
+    return HWLM_SUCCESS;
+}
+
+hwlm_error_t hashLitExec(const struct hashLitTable *t, const u8 *buf,
+                         size_t len, size_t offset_adj, HWLMCallback cb,
+                         void *ctxt, hwlm_group_t groups) {
+    assert(t && buf);
+
+    DEBUG_PRINTF("hashlit scan of %zu bytes for %u literals\n", len,
+                 t->count);
+    return scan(t, buf, len, 0, len, offset_adj, cb, ctxt, groups);
+}
+
+hwlm_error_t hashLitExecStreaming(const struct hashLitTable *t,
+                                  const u8 *hbuf, size_t hlen,
+                                  const u8 *buf, size_t len,
+                                  HWLMCallback cb, void *ctxt,
+                                  hwlm_group_t groups, u8 *temp_buf,
+                                  UNUSED size_t temp_buffer_size) {
+    assert(t);
+
+    size_t tl1 = MIN(t->max_len - 1, hlen);
+    if (tl1) {
+        assert(hbuf);
+
+        // Matches that span the boundary: they must start in the history and
+        // end in the new data.
+        size_t tl2 = MIN(t->max_len - 1, len);
+        size_t temp_len = tl1 + tl2;
+        assert(temp_len < temp_buffer_size);
+        memcpy(temp_buf, hbuf + hlen - tl1, tl1);
+        memcpy(temp_buf + tl1, buf, tl2);
+
+        hwlm_error_t rv = scan(t, temp_buf, temp_len, tl1, tl1 - 1, -tl1, cb,
+                               ctxt, groups);
+        RETURN_IF_TERMINATED(rv);
+    }
+
+    assert(buf);
+
+    return scan(t, buf, len, 0, len, 0, cb, ctxt, groups);
+}
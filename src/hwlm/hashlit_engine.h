@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Hashed literal matcher: runtime API.
+ */
+
+#ifndef HASHLIT_ENGINE_H_E40B8F1A26C953
+#define HASHLIT_ENGINE_H_E40B8F1A26C953
+
+#include "hwlm.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct hashLitTable;
+
+/** \brief Block-mode scanner. */
+hwlm_error_t hashLitExec(const struct hashLitTable *t, const u8 *buf,
+                         size_t len, size_t offset_adj, HWLMCallback cb,
+                         void *ctxt, hwlm_group_t groups);
+
+/** \brief Streaming-mode scanner. */
+hwlm_error_t hashLitExecStreaming(const struct hashLitTable *t,
+                                  const u8 *hbuf, size_t hlen,
+                                  const u8 *buf, size_t len,
+                                  HWLMCallback cb, void *ctxt,
+                                  hwlm_group_t groups, u8 *temp_buf,
+                                  size_t temp_buffer_size);
+
+#ifdef __cplusplus
+}       /* extern "C" */
+#endif
+
+#endif
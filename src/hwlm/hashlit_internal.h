@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Data structures for the hashed literal matcher engine.
+ *
+ * The engine is built for very large literal sets (hundreds of thousands to
+ * millions of literals). Each literal is keyed on its last four bytes (if it
+ * is shorter than eight bytes) or its last eight bytes. At each position in
+ * the data, the key that would end there is hashed for each of the two key
+ * lengths; a Bloom filter per key length discards most positions, and the
+ * rest are looked up in a bucketed table of confirm entries.
+ */
+
+#ifndef HASHLIT_INTERNAL_H_0C5E7A3B91D2F4
+#define HASHLIT_INTERNAL_H_0C5E7A3B91D2F4
+
+#include "ue2common.h"
+
+/** \brief Shortest literal handled by the engine. */
+#define HASHLIT_MIN_LEN 4
+
+/** \brief Key class for literals of length four to seven, keyed on their
+ * last four bytes. */
+#define HASHLIT_CLASS_4 0
+
+/** \brief Key class for literals of length eight or more, keyed on their
+ * last eight bytes. */
+#define HASHLIT_CLASS_8 1
+
+#define HASHLIT_CLASSES 2
+
+/** \brief Mask applied to every byte before hashing, so that caseless and
+ * case-sensitive literals share keys. It also merges some non-letter bytes,
+ * which only costs an extra confirm. */
+#define HASHLIT_FOLD 0xdfdfdfdfU
+
+/** \brief One literal; 32 bytes, so that two share a cache line. */
+struct hashLitEntry {
+    u64a groups;
+    u32 key_lo; //!< folded last four bytes of the literal
+    u32 key_hi; //!< folded four bytes before those, zero for class 4
+    u32 id;
+    u32 str_offset; //!< offset of the literal string from the table
+    u16 len;
+    u8 nocase;
+    u8 reserved;
+};
+
+/** \brief Tables for one key class. All offsets are from the start of the
+ * hashLitTable. */
+struct hashLitClass {
+    u32 count; //!< number of entries, zero if the class is unused
+    u32 filter_bits; //!< log2 of the number of bits in the Bloom filter
+    u32 bucket_bits; //!< log2 of the number of buckets
+    u32 filter_offset; //!< Bloom filter, as an array of u32 words
+    u32 bucket_offset; //!< u32 index of each bucket's first entry, plus one
+                       //!< past the last bucket
+    u32 entry_offset; //!< array of struct hashLitEntry, grouped by bucket
+};
+
+/** \brief Hashed literal matcher table, followed by its filters, buckets,
+ * entries and literal strings. */
+struct hashLitTable {
+    u32 size; //!< total size of the table in bytes
+    u32 count; //!< number of literals
+    u32 max_len; //!< length of the longest literal
+    u32 reserved;
+    struct hashLitClass cls[HASHLIT_CLASSES];
+};
+
+/** \brief Hash of a key: the four folded bytes ending at a position, and for
+ * class 8 the four before them. The filter probes and the bucket index are
+ * all taken from this value. */
+static really_inline
+u32 hashLitMix(u32 lo, u32 hi) {
+    return (lo * 0x9e3779b1U) ^ (hi * 0x85ebca77U);
+}
+
+static really_inline
+u32 hashLitProbe1(u32 mix, u32 bits) {
+    return mix >> (32 - bits);
+}
+
+static really_inline
+u32 hashLitProbe2(u32 mix, u32 bits) {
+    return (mix * 0xc2b2ae3dU) >> (32 - bits);
+}
+
+static really_inline
+u32 hashLitBucket(u32 mix, u32 bits) {
+    return (mix * 0x27d4eb2fU) >> (32 - bits);
+}
+
+#endif /* HASHLIT_INTERNAL_H_0C5E7A3B91D2F4 */
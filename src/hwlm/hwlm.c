@@ -29,10 +29,13 @@
 /** \file
  * \brief Hamster Wheel Literal Matcher: runtime.
  */
+#include "hashlit_engine.h"
 #include "hwlm.h"
 #include "hwlm_internal.h"
 #include "noodle_engine.h"
+#include "sblit_engine.h"
 #include "scratch.h"
+#include "tracepoints.h"
 #include "ue2common.h"
 #include "fdr/fdr.h"
 #include "nfa/accel.h"
@@ -169,9 +172,10 @@ void do_accel_streaming(const union AccelAux *aux, const u8 *hbuf, size_t hlen,
     }
 }
 
-hwlm_error_t hwlmExec(const struct HWLM *t, const u8 *buf, size_t len,
-                      size_t start, HWLMCallback cb, void *ctxt,
-                      hwlm_group_t groups) {
+static really_inline
+hwlm_error_t hwlmExec_i(const struct HWLM *t, const u8 *buf, size_t len,
+                        size_t start, HWLMCallback cb, void *ctxt,
+                        hwlm_group_t groups) {
     DEBUG_PRINTF("buf len=%zu, start=%zu, groups=%llx\n", len, start, groups);
     if (!groups) {
         DEBUG_PRINTF("groups all off\n");
@@ -184,6 +188,18 @@ hwlm_error_t hwlmExec(const struct HWLM *t, const u8 *buf, size_t len,
         DEBUG_PRINTF("calling noodExec\n");
         return noodExec(HWLM_C_DATA(t), buf + start, len - start, start, cb,
                         ctxt);
+    } else if (t->type == HWLM_ENGINE_NOOD_MULTI) {
+        DEBUG_PRINTF("calling noodExecMulti\n");
+        return noodExecMulti(HWLM_C_DATA(t), buf + start, len - start, start,
+                             cb, ctxt, groups);
+    } else if (t->type == HWLM_ENGINE_HASH) {
+        DEBUG_PRINTF("calling hashLitExec\n");
+        return hashLitExec(HWLM_C_DATA(t), buf + start, len - start, start,
+                           cb, ctxt, groups);
+    } else if (t->type == HWLM_ENGINE_SMALL) {
+        DEBUG_PRINTF("calling sbLitExec\n");
+        return sbLitExec(HWLM_C_DATA(t), buf + start, len - start, start, cb,
+                         ctxt, groups);
     } else {
         assert(t->type == HWLM_ENGINE_FDR);
         const union AccelAux *aa = &t->accel0;
@@ -198,10 +214,20 @@ hwlm_error_t hwlmExec(const struct HWLM *t, const u8 *buf, size_t len,
     }
 }
 
-hwlm_error_t hwlmExecStreaming(const struct HWLM *t, struct hs_scratch *scratch,
-                               size_t len, size_t start, HWLMCallback cb,
-                               void *ctxt, hwlm_group_t groups,
-                               u8 *stream_state) {
+hwlm_error_t hwlmExec(const struct HWLM *t, const u8 *buf, size_t len,
+                      size_t start, HWLMCallback cb, void *ctxt,
+                      hwlm_group_t groups) {
+    HS_TRACE3(hwlm_exec_start, t, len, start);
+    hwlm_error_t rv = hwlmExec_i(t, buf, len, start, cb, ctxt, groups);
+    HS_TRACE2(hwlm_exec_end, t, rv);
+    return rv;
+}
+
+static really_inline
+hwlm_error_t hwlmExecStreaming_i(const struct HWLM *t,
+                                 struct hs_scratch *scratch, size_t len,
+                                 size_t start, HWLMCallback cb, void *ctxt,
+                                 hwlm_group_t groups, u8 *stream_state) {
     const u8 *hbuf = scratch->core_info.hbuf;
     const size_t hlen = scratch->core_info.hlen;
     const u8 *buf = scratch->core_info.buf;
@@ -227,6 +253,28 @@ hwlm_error_t hwlmExecStreaming(const struct HWLM *t, struct hs_scratch *scratch,
                                      ctxt, scratch->fdr_temp_buf,
                                      FDR_TEMP_BUF_SIZE);
         }
+    } else if (t->type == HWLM_ENGINE_NOOD_MULTI) {
+        DEBUG_PRINTF("calling noodExecMulti\n");
+        if (start) {
+            return noodExecMulti(HWLM_C_DATA(t), buf + start, len - start,
+                                 start, cb, ctxt, groups);
+        } else {
+            return noodExecMultiStreaming(HWLM_C_DATA(t), hbuf, hlen, buf, len,
+                                          cb, ctxt, groups,
+                                          scratch->fdr_temp_buf,
+                                          FDR_TEMP_BUF_SIZE);
+        }
+    } else if (t->type == HWLM_ENGINE_HASH) {
+        DEBUG_PRINTF("calling hashLitExec\n");
+        if (start) {
+            return hashLitExec(HWLM_C_DATA(t), buf + start, len - start,
+                               start, cb, ctxt, groups);
+        } else {
+            return hashLitExecStreaming(HWLM_C_DATA(t), hbuf, hlen, buf, len,
+                                        cb, ctxt, groups,
+                                        scratch->fdr_temp_buf,
+                                        FDR_TEMP_BUF_SIZE);
+        }
     } else {
         // t->type == HWLM_ENGINE_FDR
         const union AccelAux *aa = &t->accel0;
@@ -244,3 +292,14 @@ hwlm_error_t hwlmExecStreaming(const struct HWLM *t, struct hs_scratch *scratch,
                                 start, cb, ctxt, groups, stream_state);
     }
 }
+
+hwlm_error_t hwlmExecStreaming(const struct HWLM *t, struct hs_scratch *scratch,
+                               size_t len, size_t start, HWLMCallback cb,
+                               void *ctxt, hwlm_group_t groups,
+                               u8 *stream_state) {
+    HS_TRACE3(hwlm_exec_start, t, len, start);
+    hwlm_error_t rv = hwlmExecStreaming_i(t, scratch, len, start, cb, ctxt,
+                                          groups, stream_state);
+    HS_TRACE2(hwlm_exec_end, t, rv);
+    return rv;
+}
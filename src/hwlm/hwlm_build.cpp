@@ -30,11 +30,16 @@
  * \brief Hamster Wheel Literal Matcher: build code.
  */
 #include "grey.h"
+#include "hashlit_build.h"
+#include "hashlit_internal.h"
 #include "hwlm.h"
 #include "hwlm_build.h"
 #include "hwlm_internal.h"
 #include "noodle_engine.h"
 #include "noodle_build.h"
+#include "noodle_internal.h"
+#include "sblit_build.h"
+#include "sblit_internal.h"
 #include "scratch.h"
 #include "ue2common.h"
 #include "fdr/fdr_compile.h"
@@ -51,6 +56,7 @@
 #include "util/ue2string.h"
 #include "util/verify_types.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
@@ -64,6 +70,11 @@ namespace ue2 {
 static const unsigned int MAX_ACCEL_OFFSET = 16;
 static const unsigned int MAX_SHUFTI_WIDTH = 240;
 
+/** \brief Longest literal given to the multi-literal Noodle engine. Its key
+ * is two bytes wide, so literals no longer than that need no confirm; longer
+ * ones are better filtered by Teddy's extra masks. */
+static const size_t MULTI_NOODLE_MAX_LEN = 2;
+
 static
 size_t mask_overhang(const hwlmLiteral &lit) {
     size_t msk_true_size = lit.msk.size();
@@ -543,6 +554,93 @@ bool isNoodleable(const vector<hwlmLiteral> &lits,
     return true;
 }
 
+static
+bool isMultiNoodleable(const vector<hwlmLiteral> &lits,
+                       const hwlmStreamingControl *stream_control,
+                       const CompileContext &cc) {
+    if (!cc.grey.allowNoodle) {
+        return false;
+    }
+
+    const size_t max_lits =
+        min((size_t)cc.grey.multiNoodleMaxLiterals, (size_t)NOOD_MULTI_MAX_LITS);
+    if (lits.size() < 2 || lits.size() > max_lits) {
+        DEBUG_PRINTF("%zu literals is wrong for multi noodle\n", lits.size());
+        return false;
+    }
+
+    for (const auto &lit : lits) {
+        if (lit.s.length() > MULTI_NOODLE_MAX_LEN) {
+            DEBUG_PRINTF("literal too long for multi noodle\n");
+            return false;
+        }
+        if (!lit.msk.empty()) {
+            DEBUG_PRINTF("noodle can't handle supplementary masks\n");
+            return false;
+        }
+        if (stream_control &&
+            lit.s.length() + 1 > stream_control->history_max) {
+            DEBUG_PRINTF("length of %zu too long for history max %zu\n",
+                         lit.s.length(), stream_control->history_max);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** \brief Use the hashed literal matcher for very large literal sets, where
+ * FDR's build time and confirm chains suffer. */
+static
+bool isHashLitable(const vector<hwlmLiteral> &lits,
+                   const hwlmStreamingControl *stream_control,
+                   const CompileContext &cc) {
+    if (!cc.grey.hashLitMinLiterals ||
+        lits.size() < cc.grey.hashLitMinLiterals) {
+        return false;
+    }
+
+    size_t max_len = 0;
+    for (const auto &lit : lits) {
+        if (lit.s.length() < HASHLIT_MIN_LEN) {
+            DEBUG_PRINTF("literal too short for hashlit\n");
+            return false;
+        }
+        if (!lit.msk.empty()) {
+            DEBUG_PRINTF("hashlit can't handle supplementary masks\n");
+            return false;
+        }
+        max_len = max(max_len, lit.s.length());
+    }
+
+    if (stream_control) { // nullptr if in block mode
+        if (max_len + 1 > stream_control->history_max ||
+            2 * max_len - 2 > FDR_TEMP_BUF_SIZE) {
+            DEBUG_PRINTF("length of %zu too long for history max %zu\n",
+                         max_len, stream_control->history_max);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** \brief Wrap an engine of \a engSize bytes in its HWLM header. */
+static
+aligned_unique_ptr<HWLM> makeHwlm(u8 engType, const void *eng, size_t engSize,
+                                  const CompileContext &cc) {
+    assert(engSize);
+    if (engSize > cc.grey.limitLiteralMatcherSize) {
+        throw ResourceLimitError();
+    }
+
+    auto h = aligned_zmalloc_unique<HWLM>(ROUNDUP_CL(sizeof(HWLM)) + engSize);
+
+    h->type = engType;
+    memcpy(HWLM_DATA(h.get()), eng, engSize);
+    return h;
+}
+
 aligned_unique_ptr<HWLM> hwlmBuild(const vector<hwlmLiteral> &lits,
                                    hwlmStreamingControl *stream_control,
                                    bool make_small, const CompileContext &cc,
@@ -605,11 +703,39 @@ aligned_unique_ptr<HWLM> hwlmBuild(const vector<hwlmLiteral> &lits,
             stream_control->literal_stream_state_required = 0;
         }
         eng = move(noodle);
+    } else if (isMultiNoodleable(lits, stream_control, cc)) {
+        DEBUG_PRINTF("build multi noodle table\n");
+        engType = HWLM_ENGINE_NOOD_MULTI;
+        auto noodle = noodBuildMultiTable(lits);
+        if (noodle) {
+            engSize = noodMultiSize(noodle.get());
+            if (stream_control) {
+                stream_control->literal_history_required = noodle->max_len - 1;
+                assert(stream_control->literal_history_required
+                       <= stream_control->history_max);
+                stream_control->literal_stream_state_required = 0;
+            }
+        }
+        eng = move(noodle);
+    } else if (isHashLitable(lits, stream_control, cc)) {
+        DEBUG_PRINTF("build hashlit table\n");
+        engType = HWLM_ENGINE_HASH;
+        auto table = hashLitBuildTable(lits);
+        if (table) {
+            engSize = hashLitSize(table.get());
+            if (stream_control) {
+                stream_control->literal_history_required = table->max_len - 1;
+                assert(stream_control->literal_history_required
+                       <= stream_control->history_max);
+                stream_control->literal_stream_state_required = 0;
+            }
+        }
+        eng = move(table);
     } else {
         DEBUG_PRINTF("building a new deal\n");
         engType = HWLM_ENGINE_FDR;
         auto fdr = fdrBuildTable(lits, make_small, cc.target_info, cc.grey,
-                            stream_control);
+                                 stream_control, cc.byte_freq.get());
         if (fdr) {
             engSize = fdrSize(fdr.get());
         }
@@ -620,15 +746,7 @@ aligned_unique_ptr<HWLM> hwlmBuild(const vector<hwlmLiteral> &lits,
         return nullptr;
     }
 
-    assert(engSize);
-    if (engSize > cc.grey.limitLiteralMatcherSize) {
-        throw ResourceLimitError();
-    }
-
-    auto h = aligned_zmalloc_unique<HWLM>(ROUNDUP_CL(sizeof(HWLM)) + engSize);
-
-    h->type = engType;
-    memcpy(HWLM_DATA(h.get()), eng.get(), engSize);
+    auto h = makeHwlm(engType, eng.get(), engSize, cc);
 
     if (engType == HWLM_ENGINE_FDR && cc.grey.hamsterAccelForward) {
         buildForwardAccel(h.get(), lits, expected_groups);
@@ -645,6 +763,25 @@ aligned_unique_ptr<HWLM> hwlmBuild(const vector<hwlmLiteral> &lits,
     return h;
 }
 
+aligned_unique_ptr<HWLM>
+hwlmBuildSmallBlock(const vector<hwlmLiteral> &lits, const CompileContext &cc) {
+    assert(!lits.empty());
+    if (!cc.grey.sbLitMaxLiterals || lits.size() > cc.grey.sbLitMaxLiterals) {
+        DEBUG_PRINTF("%zu literals is too many for sblit\n", lits.size());
+        return nullptr;
+    }
+
+    assert(everyoneHasGroups(lits));
+
+    auto table = sbLitBuildTable(lits);
+    if (!table) {
+        return nullptr;
+    }
+
+    DEBUG_PRINTF("built sblit table with %u keys\n", table->key_count);
+    return makeHwlm(HWLM_ENGINE_SMALL, table.get(), sbLitSize(table.get()), cc);
+}
+
 size_t hwlmSize(const HWLM *h) {
     size_t engSize = 0;
 
@@ -652,6 +789,15 @@ size_t hwlmSize(const HWLM *h) {
     case HWLM_ENGINE_NOOD:
         engSize = noodSize((const noodTable *)HWLM_C_DATA(h));
         break;
+    case HWLM_ENGINE_NOOD_MULTI:
+        engSize = noodMultiSize((const noodMultiTable *)HWLM_C_DATA(h));
+        break;
+    case HWLM_ENGINE_HASH:
+        engSize = hashLitSize((const hashLitTable *)HWLM_C_DATA(h));
+        break;
+    case HWLM_ENGINE_SMALL:
+        engSize = sbLitSize((const sbLitTable *)HWLM_C_DATA(h));
+        break;
     case HWLM_ENGINE_FDR:
         engSize = fdrSize((const FDR *)HWLM_C_DATA(h));
         break;
@@ -89,6 +89,16 @@ hwlmBuild(const std::vector<hwlmLiteral> &lits,
           const CompileContext &cc,
           hwlm_group_t expected_groups = HWLM_ALL_GROUPS);
 
+/** \brief Build an \ref HWLM literal matcher for block-mode scans of at most
+ * 32 bytes, using the small-block literal matcher.
+ *
+ * Returns nullptr if the literals are unsuitable, in which case the caller
+ * should fall back to \ref hwlmBuild.
+ */
+aligned_unique_ptr<HWLM>
+hwlmBuildSmallBlock(const std::vector<hwlmLiteral> &lits,
+                    const CompileContext &cc);
+
 /**
  * Returns an estimate of the number of repeated characters on the end of a
  * literal that will make a literal set of size \a numLiterals suffer
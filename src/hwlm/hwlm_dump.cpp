@@ -33,8 +33,10 @@
 #include "config.h"
 
 #include "hwlm_dump.h"
+#include "hashlit_build.h"
 #include "hwlm_internal.h"
 #include "noodle_build.h"
+#include "sblit_build.h"
 #include "ue2common.h"
 #include "fdr/fdr_dump.h"
 #include "nfa/accel_dump.h"
@@ -52,6 +54,15 @@ void hwlmPrintStats(const HWLM *h, FILE *f) {
     case HWLM_ENGINE_NOOD:
         noodPrintStats((const noodTable *)HWLM_C_DATA(h), f);
         break;
+    case HWLM_ENGINE_NOOD_MULTI:
+        noodMultiPrintStats((const noodMultiTable *)HWLM_C_DATA(h), f);
+        break;
+    case HWLM_ENGINE_HASH:
+        hashLitPrintStats((const hashLitTable *)HWLM_C_DATA(h), f);
+        break;
+    case HWLM_ENGINE_SMALL:
+        sbLitPrintStats((const sbLitTable *)HWLM_C_DATA(h), f);
+        break;
     case HWLM_ENGINE_FDR:
         fdrPrintStats((const FDR *)HWLM_C_DATA(h), f);
         break;
@@ -43,10 +43,20 @@
 /** \brief Underlying engine is Noodle. */
 #define HWLM_ENGINE_NOOD    16
 
+/** \brief Underlying engine is a multi-literal Noodle. */
+#define HWLM_ENGINE_NOOD_MULTI 17
+
+/** \brief Underlying engine is the hashed literal matcher. */
+#define HWLM_ENGINE_HASH    18
+
+/** \brief Underlying engine is the small-block literal matcher. */
+#define HWLM_ENGINE_SMALL   19
+
 /** \brief Main Hamster Wheel Literal Matcher header. Followed by
  * engine-specific structure. */
 struct HWLM {
-    u8 type; /**< HWLM_ENGINE_NOOD or HWLM_ENGINE_FDR */
+    u8 type; /**< HWLM_ENGINE_NOOD, HWLM_ENGINE_NOOD_MULTI,
+              * HWLM_ENGINE_HASH, HWLM_ENGINE_SMALL or HWLM_ENGINE_FDR */
     hwlm_group_t accel1_groups; /**< accelerable groups. */
     union AccelAux accel1; /**< used if group mask is subset of accel1_groups */
     union AccelAux accel0; /**< fallback accel scheme */
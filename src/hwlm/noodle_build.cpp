@@ -40,7 +40,11 @@
 #include "util/verify_types.h"
 #include "ue2common.h"
 
+#include <algorithm>
 #include <cstring> // for memcpy
+#include <vector>
+
+using namespace std;
 
 namespace ue2 {
 
@@ -94,6 +98,77 @@ size_t noodSize(const noodTable *n) {
     return sizeof(*n) + n->len;
 }
 
+aligned_unique_ptr<noodMultiTable>
+noodBuildMultiTable(const vector<hwlmLiteral> &lits) {
+    assert(lits.size() >= 2 && lits.size() <= NOOD_MULTI_MAX_LITS);
+
+    size_t size = sizeof(noodMultiTable);
+    for (const auto &lit : lits) {
+        if (!lit.msk.empty()) {
+            DEBUG_PRINTF("noodle can't handle supplementary masks\n");
+            return nullptr;
+        }
+        size += lit.s.length();
+    }
+
+    auto n = aligned_zmalloc_unique<noodMultiTable>(size);
+    assert(n);
+
+    n->size = verify_u32(size);
+    n->count = verify_u32(lits.size());
+
+    size_t offset = sizeof(noodMultiTable);
+    for (u32 i = 0; i < lits.size(); i++) {
+        const hwlmLiteral &lit = lits[i];
+        const auto &s = lit.s;
+        noodMultiLit &ml = n->lits[i];
+
+        ml.groups = lit.groups;
+        ml.id = lit.id;
+        ml.len = verify_u32(s.length());
+        ml.str_offset = verify_u32(offset);
+        ml.nocase = lit.nocase ? 1 : 0;
+
+        // The key is anchored at the end of the literal, so that keys found
+        // in order of position give matches in order of end offset.
+        for (u32 j = 0; j < 2; j++) {
+            if (s.length() + j < 2) {
+                ml.key_msk[j] = 0;
+                ml.key_cmp[j] = 0;
+                continue;
+            }
+            u8 c = s[s.length() - 2 + j];
+            if (lit.nocase && ourisalpha(c)) {
+                ml.key_msk[j] = 0xdf;
+                ml.key_cmp[j] = c & 0xdf;
+            } else {
+                ml.key_msk[j] = 0xff;
+                ml.key_cmp[j] = c;
+            }
+        }
+
+        // Byte s[len - 1 - j] sits in byte 7 - j of the confirm value.
+        for (u32 j = 0; j < 8 && j < s.length(); j++) {
+            u8 c = s[s.length() - 1 - j];
+            u64a m = lit.nocase && ourisalpha(c) ? 0xdf : 0xff;
+            u32 shift = (7 - j) * 8;
+            ml.msk |= m << shift;
+            ml.cmp |= (u64a)(c & m) << shift;
+        }
+
+        memcpy((u8 *)n.get() + offset, s.c_str(), s.length());
+        offset += s.length();
+        n->max_len = max(n->max_len, ml.len);
+    }
+
+    return n;
+}
+
+size_t noodMultiSize(const noodMultiTable *n) {
+    assert(n);
+    return n->size;
+}
+
 } // namespace ue2
 
 #ifdef DUMP_SUPPORT
@@ -101,18 +176,33 @@ size_t noodSize(const noodTable *n) {
 
 namespace ue2 {
 
+static
+void noodPrintString(const u8 *str, u32 len, FILE *f) {
+    for (u32 i = 0; i < len; i++) {
+        if (isgraph(str[i]) && str[i] != '\\') {
+            fprintf(f, "%c", str[i]);
+        } else {
+            fprintf(f, "\\x%02hhx", str[i]);
+        }
+    }
+    fprintf(f, "\n");
+}
+
 void noodPrintStats(const noodTable *n, FILE *f) {
     fprintf(f, "Noodle table\n");
     fprintf(f, "Len: %u Key Offset: %u\n", n->len, n->key_offset);
     fprintf(f, "String: ");
-    for (u32 i = 0; i < n->len; i++) {
-        if (isgraph(n->str[i]) && n->str[i] != '\\') {
-            fprintf(f, "%c", n->str[i]);
-        } else {
-            fprintf(f, "\\x%02hhx", n->str[i]);
-        }
+    noodPrintString(n->str, n->len, f);
+}
+
+void noodMultiPrintStats(const noodMultiTable *n, FILE *f) {
+    fprintf(f, "Multi-literal Noodle table\n");
+    fprintf(f, "Literals: %u Max Len: %u\n", n->count, n->max_len);
+    for (u32 i = 0; i < n->count; i++) {
+        const noodMultiLit &ml = n->lits[i];
+        fprintf(f, "String %u%s: ", ml.id, ml.nocase ? " (nocase)" : "");
+        noodPrintString((const u8 *)n + ml.str_offset, ml.len, f);
     }
-    fprintf(f, "\n");
 }
 
 } // namespace ue2
@@ -36,7 +36,10 @@
 #include "ue2common.h"
 #include "util/alloc.h"
 
+#include <vector>
+
 struct noodTable;
+struct noodMultiTable;
 
 namespace ue2 {
 
@@ -47,6 +50,13 @@ ue2::aligned_unique_ptr<noodTable> noodBuildTable(const hwlmLiteral &lit);
 
 size_t noodSize(const noodTable *n);
 
+/** \brief Construct a Noodle matcher for a set of between two and
+ * NOOD_MULTI_MAX_LITS literals. */
+ue2::aligned_unique_ptr<noodMultiTable>
+noodBuildMultiTable(const std::vector<hwlmLiteral> &lits);
+
+size_t noodMultiSize(const noodMultiTable *n);
+
 } // namespace ue2
 
 #ifdef DUMP_SUPPORT
@@ -56,6 +66,7 @@ size_t noodSize(const noodTable *n);
 namespace ue2 {
 
 void noodPrintStats(const noodTable *n, FILE *f);
+void noodMultiPrintStats(const noodMultiTable *n, FILE *f);
 
 } // namespace ue2
 
@@ -37,6 +37,7 @@
 #include "util/compare.h"
 #include "util/masked_move.h"
 #include "util/simd_utils.h"
+#include "util/unaligned.h"
 
 #include <ctype.h>
 #include <stdbool.h>
@@ -362,3 +363,202 @@ hwlm_error_t noodExecStreaming(const struct noodTable *n, const u8 *hbuf,
     cbi.offsetAdj = 0;
     return scan(buf, len, n->str, n->len, n->key_offset, n->nocase, &cbi);
 }
+
+/** \brief Report a match of literal \a ml ending at \a end, if the rest of the
+ * literal is there and it starts no later than \a max_start. */
+static really_inline
+hwlm_error_t confirmMulti(const struct noodMultiTable *n,
+                          const struct noodMultiLit *ml, const u8 *buf,
+                          size_t end, size_t max_start, size_t offset_adj,
+                          HWLMCallback cb, void *ctxt, hwlm_group_t *groups) {
+    if (!(ml->groups & *groups) || end + 1 < ml->len) {
+        return HWLM_SUCCESS;
+    }
+    size_t start = end + 1 - ml->len;
+    if (start > max_start) {
+        return HWLM_SUCCESS;
+    }
+
+    const u8 *str = (const u8 *)n + ml->str_offset;
+    if (likely(end >= 7)) {
+        if ((unaligned_load_u64a(buf + end - 7) & ml->msk) != ml->cmp) {
+            return HWLM_SUCCESS;
+        }
+        if (ml->len > 8 &&
+            cmpForward(buf + start, str, ml->len - 8, ml->nocase)) {
+            return HWLM_SUCCESS;
+        }
+    } else if (cmpForward(buf + start, str, ml->len, ml->nocase)) {
+        return HWLM_SUCCESS;
+    }
+
+    DEBUG_PRINTF("match @ %zu->%zu\n", start + offset_adj, end + offset_adj);
+    hwlmcb_rv_t rv = cb(start + offset_adj, end + offset_adj, ml->id, ctxt);
+    if (rv == HWLM_TERMINATE_MATCHING) {
+        return HWLM_TERMINATED;
+    }
+    *groups = rv;
+    return HWLM_SUCCESS;
+}
+
+/** \brief Report the matches found in one chunk, in end offset order. */
+static really_inline
+hwlm_error_t reportMulti(const struct noodMultiTable *n, const u8 *buf,
+                         size_t base, const u32 *z, u32 any, const u32 count,
+                         size_t min_end, size_t max_start, size_t offset_adj,
+                         HWLMCallback cb, void *ctxt, hwlm_group_t *groups) {
+    while (any) {
+        u32 pos = findAndClearLSB_32(&any);
+        size_t end = base + pos;
+        if (end < min_end) {
+            continue;
+        }
+        for (u32 i = 0; i < count; i++) {
+            if (!(z[i] & (1U << pos))) {
+                continue;
+            }
+            hwlm_error_t rv = confirmMulti(n, &n->lits[i], buf, end,
+                                           max_start, offset_adj, cb, ctxt,
+                                           groups);
+            RETURN_IF_TERMINATED(rv);
+        }
+    }
+    return HWLM_SUCCESS;
+}
+
+/**
+ * \brief Scan for all the literals of a multi-literal table at once.
+ *
+ * Matches are reported in order of end offset, for those that end at or after
+ * \a min_end and start at or before \a max_start. The literal count is a
+ * compile-time constant in each caller, so that the per-literal compares are
+ * unrolled and kept in registers.
+ */
+static really_inline
+hwlm_error_t scanMulti(const struct noodMultiTable *n, const u8 *buf,
+                       size_t len, size_t min_end, size_t max_start,
+                       size_t offset_adj, HWLMCallback cb, void *ctxt,
+                       hwlm_group_t groups, const u32 count) {
+    assert(count == n->count);
+    assert(count <= NOOD_MULTI_MAX_LITS);
+
+    MASK_TYPE msk1[NOOD_MULTI_MAX_LITS], cmp1[NOOD_MULTI_MAX_LITS];
+    MASK_TYPE msk2[NOOD_MULTI_MAX_LITS], cmp2[NOOD_MULTI_MAX_LITS];
+    u32 carry[NOOD_MULTI_MAX_LITS];
+    for (u32 i = 0; i < count; i++) {
+        const struct noodMultiLit *ml = &n->lits[i];
+        msk1[i] = getMultiMask(ml->key_msk[0]);
+        cmp1[i] = getMultiMask(ml->key_cmp[0]);
+        msk2[i] = getMultiMask(ml->key_msk[1]);
+        cmp2[i] = getMultiMask(ml->key_cmp[1]);
+        // Only a one-byte literal can end at the first position.
+        carry[i] = ml->key_msk[0] ? 0 : 1;
+    }
+
+    size_t base = 0;
+    for (; base + CHUNKSIZE <= len; base += CHUNKSIZE) {
+        const MASK_TYPE v = loadMultiChunk(buf + base, CHUNKSIZE);
+
+        u32 z[NOOD_MULTI_MAX_LITS];
+        u32 any = 0;
+        for (u32 i = 0; i < count; i++) {
+            u32 z1 = matchMultiKey(v, msk1[i], cmp1[i]);
+            u32 z2 = matchMultiKey(v, msk2[i], cmp2[i]);
+            z[i] = ((z1 << 1) | carry[i]) & z2;
+            carry[i] = z1 >> (CHUNKSIZE - 1);
+            any |= z[i];
+        }
+
+        if (unlikely(any)) {
+            hwlm_error_t rv = reportMulti(n, buf, base, z, any, count, min_end,
+                                          max_start, offset_adj, cb, ctxt,
+                                          &groups);
+            RETURN_IF_TERMINATED(rv);
+        }
+    }
+
+    if (base == len) {
+        return HWLM_SUCCESS;
+    }
+
+    // Partial chunk at the end.
+    const size_t l = len - base;
+    const MASK_TYPE v = loadMultiChunk(buf + base, l);
+    const u32 valid = (1U << l) - 1;
+    u32 z[NOOD_MULTI_MAX_LITS];
+    u32 any = 0;
+    for (u32 i = 0; i < count; i++) {
+        u32 z1 = matchMultiKey(v, msk1[i], cmp1[i]);
+        u32 z2 = matchMultiKey(v, msk2[i], cmp2[i]);
+        z[i] = ((z1 << 1) | carry[i]) & z2 & valid;
+        any |= z[i];
+    }
+    return reportMulti(n, buf, base, z, any, count, min_end, max_start,
+                       offset_adj, cb, ctxt, &groups);
+}
+
+static never_inline
+hwlm_error_t scanMultiDispatch(const struct noodMultiTable *n, const u8 *buf,
+                               size_t len, size_t min_end, size_t max_start,
+                               size_t offset_adj, HWLMCallback cb, void *ctxt,
+                               hwlm_group_t groups) {
+    switch (n->count) {
+    case 2:
+        return scanMulti(n, buf, len, min_end, max_start, offset_adj, cb, ctxt,
+                         groups, 2);
+    case 3:
+        return scanMulti(n, buf, len, min_end, max_start, offset_adj, cb, ctxt,
+                         groups, 3);
+    case 4:
+        return scanMulti(n, buf, len, min_end, max_start, offset_adj, cb, ctxt,
+                         groups, 4);
+    default:
+        assert(0);
+        return HWLM_SUCCESS;
+    }
+}
+
+/** \brief Block-mode scanner for a multi-literal table. */
+hwlm_error_t noodExecMulti(const struct noodMultiTable *n, const u8 *buf,
+                           size_t len, size_t offset_adj, HWLMCallback cb,
+                           void *ctxt, hwlm_group_t groups) {
+    assert(n && buf);
+
+    DEBUG_PRINTF("multi nood scan of %zu bytes for %u literals\n", len,
+                 n->count);
+    return scanMultiDispatch(n, buf, len, 0, len, offset_adj, cb, ctxt,
+                             groups);
+}
+
+/** \brief Streaming-mode scanner for a multi-literal table. */
+hwlm_error_t noodExecMultiStreaming(const struct noodMultiTable *n,
+                                    const u8 *hbuf, size_t hlen,
+                                    const u8 *buf, size_t len,
+                                    HWLMCallback cb, void *ctxt,
+                                    hwlm_group_t groups, u8 *temp_buf,
+                                    UNUSED size_t temp_buffer_size) {
+    assert(n);
+
+    size_t tl1 = MIN(n->max_len - 1, hlen);
+    if (tl1) {
+        assert(hbuf);
+
+        // Matches that span the boundary: they must start in the history and
+        // end in the new data.
+        size_t tl2 = MIN(n->max_len - 1, len);
+        size_t temp_len = tl1 + tl2;
+        assert(temp_len < temp_buffer_size);
+        memcpy(temp_buf, hbuf + hlen - tl1, tl1);
+        memcpy(temp_buf + tl1, buf, tl2);
+
+        hwlm_error_t rv = scanMultiDispatch(n, temp_buf, temp_len, tl1,
+                                            tl1 - 1, -tl1, cb, ctxt, groups);
+        if (rv == HWLM_TERMINATED) {
+            return HWLM_TERMINATED;
+        }
+    }
+
+    assert(buf);
+
+    return scanMultiDispatch(n, buf, len, 0, len, 0, cb, ctxt, groups);
+}
@@ -52,6 +52,21 @@ hwlm_error_t noodExecStreaming(const struct noodTable *n, const u8 *hbuf,
                                HWLMCallback cb, void *ctxt, u8 *temp_buf,
                                size_t temp_buffer_size);
 
+struct noodMultiTable;
+
+/** \brief Block-mode scanner for a multi-literal table. */
+hwlm_error_t noodExecMulti(const struct noodMultiTable *n, const u8 *buf,
+                           size_t len, size_t offset_adj, HWLMCallback cb,
+                           void *ctxt, hwlm_group_t groups);
+
+/** \brief Streaming-mode scanner for a multi-literal table. */
+hwlm_error_t noodExecMultiStreaming(const struct noodMultiTable *n,
+                                    const u8 *hbuf, size_t hlen,
+                                    const u8 *buf, size_t len,
+                                    HWLMCallback cb, void *ctxt,
+                                    hwlm_group_t groups, u8 *temp_buf,
+                                    size_t temp_buffer_size);
+
 #ifdef __cplusplus
 }       /* extern "C" */
 #endif
@@ -37,6 +37,27 @@ static really_inline m256 getCaseMask(void) {
     return set32x8(0xdf);
 }
 
+static really_inline m256 getMultiMask(u8 c) {
+    return set32x8(c);
+}
+
+// Load the l bytes at d, which may be fewer than a full chunk.
+static really_inline
+m256 loadMultiChunk(const u8 *d, size_t l) {
+    if (l == sizeof(m256)) {
+        return loadu256(d);
+    }
+    m256 v = zeroes256();
+    memcpy(&v, d, l);
+    return v;
+}
+
+// Positions in v whose byte c satisfies (c & msk) == cmp.
+static really_inline
+u32 matchMultiKey(m256 v, m256 msk, m256 cmp) {
+    return movemask256(eq256(and256(v, msk), cmp));
+}
+
 static really_inline
 hwlm_error_t scanSingleUnaligned(const u8 *buf, size_t len, size_t offset,
                                  const u8 *key, bool noCase, m256 caseMask,
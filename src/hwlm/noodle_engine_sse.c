@@ -37,6 +37,27 @@ static really_inline m128 getCaseMask(void) {
     return set16x8(0xdf);
 }
 
+static really_inline m128 getMultiMask(u8 c) {
+    return set16x8(c);
+}
+
+// Load the l bytes at d, which may be fewer than a full chunk.
+static really_inline
+m128 loadMultiChunk(const u8 *d, size_t l) {
+    if (l == sizeof(m128)) {
+        return loadu128(d);
+    }
+    m128 v = zeroes128();
+    memcpy(&v, d, l);
+    return v;
+}
+
+// Positions in v whose byte c satisfies (c & msk) == cmp.
+static really_inline
+u32 matchMultiKey(m128 v, m128 msk, m128 cmp) {
+    return movemask128(eq128(and128(v, msk), cmp));
+}
+
 static really_inline
 hwlm_error_t scanSingleShort(const u8 *buf, size_t len, const u8 *key,
                              bool noCase, m128 caseMask, m128 mask1,
@@ -43,5 +43,38 @@ struct noodTable {
     u8  str[];
 };
 
+/** \brief Most literals handled by a multi-literal Noodle table. */
+#define NOOD_MULTI_MAX_LITS 4
+
+/** \brief One literal in a multi-literal Noodle table.
+ *
+ * The key is the last two bytes of the literal: byte i of the key matches an
+ * input byte c if (c & key_msk[i]) == key_cmp[i]. A one-byte literal has a
+ * first key byte that matches anything.
+ *
+ * The last eight bytes of the literal (or all of it, if shorter) are also
+ * held as a mask and compare value for an unaligned 64-bit load ending at the
+ * last byte of a candidate match, so that most confirms are one compare. */
+struct noodMultiLit {
+    u64a groups;
+    u64a msk;
+    u64a cmp;
+    u32 id;
+    u32 len;
+    u32 str_offset; //!< offset of the literal string from the table
+    u8  nocase;
+    u8  key_msk[2];
+    u8  key_cmp[2];
+};
+
+/** \brief Noodle table for a small set of literals, followed by the literal
+ * strings. */
+struct noodMultiTable {
+    u32 size; //!< total size of the table in bytes
+    u32 count; //!< number of literals, at most NOOD_MULTI_MAX_LITS
+    u32 max_len; //!< length of the longest literal
+    struct noodMultiLit lits[NOOD_MULTI_MAX_LITS];
+};
+
 #endif /* NOODLE_INTERNAL_H_25D751C42E34A6 */
 
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ * \brief Small-block literal matcher: build code.
+ */
+
+#include "sblit_build.h"
+
+#include "sblit_internal.h"
+#include "hwlm_literal.h"
+#include "util/alloc.h"
+#include "util/bitutils.h"
+#include "util/verify_types.h"
+#include "ue2common.h"
+
+#include <algorithm>
+#include <cstring> // for memcpy
+#include <map>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+namespace ue2 {
+
+static
+u8 keyByte(char c, bool nocase) {
+    return nocase ? (u8)c & CASE_CLEAR : (u8)c;
+}
+
+aligned_unique_ptr<sbLitTable>
+sbLitBuildTable(const vector<hwlmLiteral> &lits) {
+    // (first, last, dist, nocase) -> indices of literals with that key
+    using Key = tuple<u8, u8, u8, u8>;
+    map<Key, vector<u32>> keyed;
+    size_t str_len = 0;
+    u32 max_len = 0;
+
+    for (u32 i = 0; i < lits.size(); i++) {
+        const auto &lit = lits[i];
+        const size_t len = lit.s.length();
+        assert(len);
+        if (len > SBLIT_MAX_LEN) {
+            DEBUG_PRINTF("literal too long for sblit\n");
+            return nullptr;
+        }
+        if (lit.msk.size() > len) {
+            DEBUG_PRINTF("sblit can't handle masks beyond the literal\n");
+            return nullptr;
+        }
+        str_len += len;
+        max_len = max(max_len, verify_u32(len));
+
+        Key k(keyByte(lit.s.front(), lit.nocase),
+              keyByte(lit.s.back(), lit.nocase), verify_u8(len - 1),
+              lit.nocase ? 1 : 0);
+        keyed[k].push_back(i);
+    }
+
+    if (keyed.size() > SBLIT_MAX_KEYS) {
+        DEBUG_PRINTF("%zu keys is too many for sblit\n", keyed.size());
+        return nullptr;
+    }
+
+    const size_t key_offset = ROUNDUP_CL(sizeof(sbLitTable));
+    const size_t entry_offset =
+        ROUNDUP_N(key_offset + keyed.size() * sizeof(sbLitKey),
+                  alignof(sbLitEntry));
+    const size_t str_offset = entry_offset + lits.size() * sizeof(sbLitEntry);
+    const size_t size = str_offset + str_len;
+
+    auto t = aligned_zmalloc_unique<sbLitTable>(size);
+    assert(t);
+
+    t->size = verify_u32(size);
+    t->key_count = verify_u32(keyed.size());
+    t->entry_count = verify_u32(lits.size());
+    t->key_offset = verify_u32(key_offset);
+    t->entry_offset = verify_u32(entry_offset);
+    t->max_len = max_len;
+
+    u8 *base = (u8 *)t.get();
+    sbLitKey *keys = (sbLitKey *)(base + key_offset);
+    sbLitEntry *entries = (sbLitEntry *)(base + entry_offset);
+    size_t curr = str_offset;
+    u32 e = 0;
+    for (const auto &m : keyed) {
+        sbLitKey &key = *keys++;
+        tie(key.first, key.last, key.dist, key.nocase) = m.first;
+        key.entry_start = verify_u16(e);
+        key.entry_count = verify_u16(m.second.size());
+
+        for (u32 i : m.second) {
+            const auto &lit = lits[i];
+            sbLitEntry &ent = entries[e++];
+            key.groups |= lit.groups;
+            ent.groups = lit.groups;
+            ent.id = lit.id;
+            ent.str_offset = verify_u32(curr);
+            ent.len = verify_u8(lit.s.length());
+            ent.nocase = lit.nocase ? 1 : 0;
+            ent.msk_len = verify_u8(lit.msk.size());
+            copy(lit.msk.begin(), lit.msk.end(), ent.msk);
+            copy(lit.cmp.begin(), lit.cmp.end(), ent.cmp);
+            memcpy(base + curr, lit.s.c_str(), lit.s.length());
+            curr += lit.s.length();
+        }
+    }
+    assert(e == lits.size());
+    assert(curr == size);
+
+    return t;
+}
+
+size_t sbLitSize(const sbLitTable *t) {
+    assert(t);
+    return t->size;
+}
+
+} // namespace ue2
+
+#ifdef DUMP_SUPPORT
+
+namespace ue2 {
+
+void sbLitPrintStats(const sbLitTable *t, FILE *f) {
+    const sbLitKey *keys =
+        (const sbLitKey *)((const u8 *)t + t->key_offset);
+    u32 longest = 0;
+    for (u32 k = 0; k < t->key_count; k++) {
+        longest = max(longest, (u32)keys[k].entry_count);
+    }
+
+    fprintf(f, "Small-block literal table\n");
+    fprintf(f, "Literals: %u Keys: %u Max Len: %u Size: %u\n",
+            t->entry_count, t->key_count, t->max_len, t->size);
+    fprintf(f, "Longest key chain: %u\n", longest);
+}
+
+} // namespace ue2
+
+#endif
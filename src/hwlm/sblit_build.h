@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Small-block literal matcher: build code.
+ */
+
+#ifndef SBLIT_BUILD_H_C8512F6E0A3D97
+#define SBLIT_BUILD_H_C8512F6E0A3D97
+
+#include "ue2common.h"
+#include "util/alloc.h"
+
+#include <vector>
+
+struct sbLitTable;
+
+namespace ue2 {
+
+struct hwlmLiteral;
+
+/** \brief Construct a small-block literal matcher for the given literals, or
+ * return nullptr if they need more than SBLIT_MAX_KEYS keys or any is longer
+ * than SBLIT_MAX_LEN bytes. */
+ue2::aligned_unique_ptr<sbLitTable>
+sbLitBuildTable(const std::vector<hwlmLiteral> &lits);
+
+size_t sbLitSize(const sbLitTable *t);
+
+} // namespace ue2
+
+#ifdef DUMP_SUPPORT
+
+#include <cstdio>
+
+namespace ue2 {
+
+void sbLitPrintStats(const sbLitTable *t, FILE *f);
+
+} // namespace ue2
+
+#endif // DUMP_SUPPORT
+
+#endif /* SBLIT_BUILD_H_C8512F6E0A3D97 */
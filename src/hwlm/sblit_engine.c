@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Small-block literal matcher: runtime.
+ */
+
+#include "sblit_engine.h"
+#include "sblit_internal.h"
+#include "hwlm.h"
+#include "ue2common.h"
+#include "util/bitutils.h"
+#include "util/compare.h"
+#include "util/simd_utils.h"
+
+#include <string.h>
+
+/** \brief The block being scanned, as is and case-cleared. */
+struct sblit_block {
+#if defined(__AVX2__)
+    m256 v;
+    m256 vf;
+#else
+    m128 lo;
+    m128 hi;
+    m128 flo;
+    m128 fhi;
+#endif
+};
+
+static really_inline
+void loadBlock(struct sblit_block *b, const u8 *p) {
+#if defined(__AVX2__)
+    b->v = load256(p);
+    b->vf = and256(b->v, set32x8(CASE_CLEAR));
+#else
+    const m128 cc = set16x8(CASE_CLEAR);
+    b->lo = load128(p);
+    b->hi = load128(p + 16);
+    b->flo = and128(b->lo, cc);
+    b->fhi = and128(b->hi, cc);
+#endif
+}
+
+/** \brief Mask of the positions in the block holding \a c. */
+static really_inline
+u32 charMask(const struct sblit_block *b, u8 c, u8 nocase) {
+#if defined(__AVX2__)
+    return movemask256(eq256(nocase ? b->vf : b->v, set32x8(c)));
+#else
+    const m128 k = set16x8(c);
+    u32 lo = movemask128(eq128(nocase ? b->flo : b->lo, k));
+    u32 hi = movemask128(eq128(nocase ? b->fhi : b->hi, k));
+    return lo | hi << 16;
+#endif
+}
+
+static really_inline
+int confirmEntry(const struct sbLitTable *t, const struct sbLitEntry *ent,
+                 const u8 *buf, size_t start, size_t end) {
+    if (cmpForward(buf + start, (const u8 *)t + ent->str_offset, ent->len,
+                   ent->nocase)) {
+        return 0;
+    }
+    const u8 *p = buf + end + 1 - ent->msk_len;
+    for (u32 i = 0; i < ent->msk_len; i++) {
+        if ((p[i] & ent->msk[i]) != ent->cmp[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+hwlm_error_t sbLitExec(const struct sbLitTable *t, const u8 *buf, size_t len,
+                       size_t offset_adj, HWLMCallback cb, void *ctxt,
+                       hwlm_group_t groups) {
+    assert(t && buf);
+    assert(len <= SBLIT_MAX_LEN);
+    assert(t->key_count <= SBLIT_MAX_KEYS);
+
+    /* Pad the block into an aligned buffer; the padding is masked off. */
+    ALIGN_AVX_DIRECTIVE u8 tmp[SBLIT_MAX_LEN];
+    memset(tmp, 0, sizeof(tmp));
+    memcpy(tmp, buf, len);
+    struct sblit_block b;
+    loadBlock(&b, tmp);
+
+    const u32 valid = len == SBLIT_MAX_LEN ? ~0U : (1U << len) - 1;
+    const struct sbLitKey *keys
+        = (const struct sbLitKey *)((const u8 *)t + t->key_offset);
+    const struct sbLitEntry *entries
+        = (const struct sbLitEntry *)((const u8 *)t + t->entry_offset);
+
+    u32 ends[SBLIT_MAX_KEYS];
+    u32 any = 0;
+    for (u32 k = 0; k < t->key_count; k++) {
+        const struct sbLitKey *key = &keys[k];
+        u32 m = 0;
+        if (key->groups & groups) {
+            m = charMask(&b, key->last, key->nocase)
+                & (charMask(&b, key->first, key->nocase) << key->dist)
+                & valid;
+        }
+        ends[k] = m;
+        any |= m;
+    }
+
+    /* Matches must be reported in order of end offset. */
+    while (any) {
+        u32 end = findAndClearLSB_32(&any);
+        for (u32 k = 0; k < t->key_count; k++) {
+            if (!(ends[k] & (1U << end))) {
+                continue;
+            }
+            const struct sbLitKey *key = &keys[k];
+            size_t start = end - key->dist;
+            for (u32 i = 0; i < key->entry_count; i++) {
+                const struct sbLitEntry *ent = &entries[key->entry_start + i];
+                if (!(ent->groups & groups) ||
+                    !confirmEntry(t, ent, buf, start, end)) {
+                    continue;
+                }
+                DEBUG_PRINTF("match @ %zu->%u\n", start + offset_adj,
+                             end + (u32)offset_adj);
+                hwlmcb_rv_t rv = cb(start + offset_adj, end + offset_adj,
+                                    ent->id, ctxt);
+                if (rv == HWLM_TERMINATE_MATCHING) {
+                    return HWLM_TERMINATED;
+                }
+                groups = rv;
+            }
+        }
+    }
+
+    return HWLM_SUCCESS;
+}
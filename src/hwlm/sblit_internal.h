@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Data structures for the small-block literal matcher.
+ *
+ * The engine is only run over blocks of at most SBLIT_MAX_LEN bytes, which
+ * fit in one AVX2 register or two SSE registers, so there is no need for the
+ * zones and domain hashing of FDR. Literals are grouped by key: their first
+ * and last bytes and the distance between them, with both bytes case-cleared
+ * for caseless literals. Each key is compared against the whole block at
+ * once, giving a mask of the positions at which one of its literals could
+ * end, and only those positions are confirmed.
+ */
+
+#ifndef SBLIT_INTERNAL_H_93D0B4E1F7A52C
+#define SBLIT_INTERNAL_H_93D0B4E1F7A52C
+
+#include "ue2common.h"
+
+/** \brief Longest block, and so longest literal, handled by the engine. */
+#define SBLIT_MAX_LEN 32
+
+/** \brief Most keys in a table: each costs two compares per scan. */
+#define SBLIT_MAX_KEYS 64
+
+/** \brief One key, and the range of entries for the literals that share it. */
+struct sbLitKey {
+    u64a groups; //!< union of the groups of the key's literals
+    u8 first; //!< first byte, case-cleared if nocase
+    u8 last; //!< last byte, case-cleared if nocase
+    u8 dist; //!< literal length minus one
+    u8 nocase; //!< compare against the case-cleared block
+    u16 entry_start;
+    u16 entry_count;
+};
+
+/** \brief One literal. */
+struct sbLitEntry {
+    u64a groups;
+    u32 id;
+    u32 str_offset; //!< offset of the literal string from the table
+    u8 len;
+    u8 nocase;
+    u8 msk_len; //!< length of the supplementary mask, zero if none
+    u8 reserved;
+    u8 msk[8]; //!< supplementary mask over the last msk_len bytes
+    u8 cmp[8];
+};
+
+/** \brief Small-block literal matcher table, followed by its keys, entries
+ * and literal strings. */
+struct sbLitTable {
+    u32 size; //!< total size of the table in bytes
+    u32 key_count;
+    u32 entry_count;
+    u32 key_offset; //!< array of struct sbLitKey
+    u32 entry_offset; //!< array of struct sbLitEntry, grouped by key
+    u32 max_len; //!< length of the longest literal
+};
+
+#endif /* SBLIT_INTERNAL_H_93D0B4E1F7A52C */
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: optional per-call latency histograms kept with scratch.
+ */
+
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 199309L // for clock_gettime()
+#endif
+
+#include "latency_stats.h"
+#include "allocator.h"
+#include "hs_internal.h"
+#include "hs_runtime.h"
+#include "scratch.h"
+#include "ue2common.h"
+#include "util/bitutils.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/** \brief log2 of the number of buckets each power of two is split into. */
+#define LATENCY_SUB_BITS 3
+
+/** \brief Number of buckets each power of two is split into. */
+#define LATENCY_SUB_BUCKETS (1U << LATENCY_SUB_BITS)
+
+u64a latencyNow(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER now, freq;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+    return (u64a)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64a)ts.tv_sec * 1000000000ULL + (u64a)ts.tv_nsec;
+#endif
+}
+
+/** \brief The histogram bucket holding a latency of \a ns. */
+static really_inline
+u32 latencyBucket(u64a ns) {
+    if (ns < LATENCY_SUB_BUCKETS) {
+        return (u32)ns;
+    }
+    u32 msb = 63 - clz64(ns);
+    u32 shift = msb - LATENCY_SUB_BITS;
+    u64a b = (u64a)(shift + 1) * LATENCY_SUB_BUCKETS +
+             ((ns >> shift) & (LATENCY_SUB_BUCKETS - 1));
+    return (u32)MIN(b, HS_LATENCY_BUCKETS - 1);
+}
+
+/** \brief The smallest latency that falls in bucket \a b. */
+static
+u64a latencyBucketLow(u32 b) {
+    if (b < LATENCY_SUB_BUCKETS) {
+        return b;
+    }
+    u32 shift = b / LATENCY_SUB_BUCKETS - 1;
+    u64a sub = b % LATENCY_SUB_BUCKETS;
+    return (LATENCY_SUB_BUCKETS + sub) << shift;
+}
+
+/** \brief The size class of a call scanning \a len bytes. */
+static really_inline
+u32 latencySizeClass(size_t len) {
+    if (len < 64) {
+        return 0;
+    }
+    u32 c = (lg2_64(len) - 6) / 2 + 1;
+    return MIN(c, HS_LATENCY_SIZE_CLASSES - 1);
+}
+
+void latencyRecord(struct hs_latency_stats *stats, u32 call, size_t len,
+                   u64a ns) {
+    assert(call < HS_LATENCY_CALL_COUNT);
+    hs_latency_histogram_t *h = &stats->call[call][latencySizeClass(len)];
+    h->count++;
+    h->total_ns += ns;
+    h->max_ns = MAX(h->max_ns, ns);
+    h->bucket[latencyBucket(ns)]++;
+}
+
+void latencyFree(struct hs_scratch *scratch) {
+    if (scratch->latency) {
+        hs_scratch_free(scratch->latency);
+        scratch->latency = NULL;
+    }
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_latency_enable(hs_scratch_t *scratch, int enable) {
+    if (!scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    if (markScratchInUse(scratch)) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    hs_error_t err = HS_SUCCESS;
+    if (!enable) {
+        latencyFree(scratch);
+    } else if (!scratch->latency) {
+        struct hs_latency_stats *stats =
+            hs_scratch_alloc(sizeof(struct hs_latency_stats));
+        err = hs_check_alloc(stats);
+        if (err == HS_SUCCESS) {
+            memset(stats, 0, sizeof(*stats));
+            scratch->latency = stats;
+        } else {
+            hs_scratch_free(stats);
+        }
+    }
+
+    unmarkScratchInUse(scratch);
+    return err;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_latency_stats(const hs_scratch_t *scratch,
+                                    hs_latency_stats_t *stats) {
+    if (!stats || !scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC || !scratch->latency) {
+        return HS_INVALID;
+    }
+
+    memcpy(stats, scratch->latency, sizeof(*stats));
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_latency_reset(hs_scratch_t *scratch) {
+    if (!scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC || !scratch->latency) {
+        return HS_INVALID;
+    }
+    if (markScratchInUse(scratch)) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    memset(scratch->latency, 0, sizeof(*scratch->latency));
+
+    unmarkScratchInUse(scratch);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_latency_percentile(const hs_latency_histogram_t *hist,
+                                 double percentile, unsigned long long *ns) {
+    if (!hist || !ns || !(percentile >= 0.0 && percentile <= 100.0)) {
+        return HS_INVALID;
+    }
+
+    *ns = 0;
+    if (!hist->count) {
+        return HS_SUCCESS;
+    }
+
+    // The rank of the call at the requested percentile, counting from one.
+    double exact = (double)hist->count * percentile / 100.0;
+    u64a rank = (u64a)exact;
+    if ((double)rank < exact || !rank) {
+        rank++;
+    }
+
+    u64a seen = 0;
+    for (u32 b = 0; b < HS_LATENCY_BUCKETS; b++) {
+        seen += hist->bucket[b];
+        if (seen >= rank) {
+            u64a high = b + 1 < HS_LATENCY_BUCKETS ? latencyBucketLow(b + 1) - 1
+                                                   : hist->max_ns;
+            *ns = MIN(high, hist->max_ns);
+            return HS_SUCCESS;
+        }
+    }
+
+    *ns = hist->max_ns;
+    return HS_SUCCESS;
+}
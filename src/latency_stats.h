@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: optional per-call latency histograms kept with scratch.
+ *
+ * When latency statistics are turned on for a scratch region with
+ * hs_scratch_latency_enable(), the public scan entry points time themselves
+ * with the monotonic clock and record the result in a histogram for the call
+ * and the size of the buffer scanned. When they are off, scratch->latency is
+ * NULL and the hooks here cost one predictable branch.
+ */
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include "hs_runtime.h"
+#include "scratch.h"
+#include "ue2common.h"
+
+/** \brief Current time in nanoseconds from a monotonic clock. */
+u64a latencyNow(void);
+
+/** \brief Add one call of \a ns nanoseconds that scanned \a len bytes to the
+ * histograms for \a call. */
+void latencyRecord(struct hs_latency_stats *stats, u32 call, size_t len,
+                   u64a ns);
+
+/** \brief Free the histograms held by \a scratch, if any. */
+void latencyFree(struct hs_scratch *scratch);
+
+/** \brief Start timing a call if latency statistics are on for \a scratch.
+ * Returns the start time, or zero if they are off. */
+static really_inline
+u64a latencyStart(const struct hs_scratch *scratch) {
+    return unlikely(scratch->latency != NULL) ? latencyNow() : 0;
+}
+
+/** \brief Finish timing a call started with latencyStart(). */
+static really_inline
+void latencyEnd(struct hs_scratch *scratch, u32 call, size_t len,
+                u64a start) {
+    if (unlikely(scratch->latency != NULL)) {
+        latencyRecord(scratch->latency, call, len, latencyNow() - start);
+    }
+}
+
+#endif // LATENCY_STATS_H
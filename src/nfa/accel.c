@@ -27,6 +27,7 @@
  */
 
 #include "accel.h"
+#include "accel_literal.h"
 #include "shufti.h"
 #include "truffle.h"
 #include "vermicelli.h"
@@ -127,6 +128,48 @@ const u8 *run_accel(const union AccelAux *accel, const u8 *c, const u8 *c_end) {
                               accel->dshufti.hi2, c, c_end - 1);
         break;
 
+    case ACCEL_DSHUFTI_DIST:
+        DEBUG_PRINTF("accel dshufti dist %u %p %p\n",
+                     accel->dshufti_dist.dist, c, c_end);
+        if (c + 15 + accel->dshufti_dist.dist >= c_end) {
+            return c;
+        }
+
+        /* stop dist early so that the second class is read inside the
+         * buffer */
+        rv = shuftiDistExec(accel->dshufti_dist.lo1, accel->dshufti_dist.hi1,
+                            accel->dshufti_dist.lo2, accel->dshufti_dist.hi2,
+                            accel->dshufti_dist.dist, c,
+                            c_end - accel->dshufti_dist.dist);
+        break;
+
+    case ACCEL_SHUFTI_DVERM:
+        DEBUG_PRINTF("accel shufti dverm %p %p\n", c, c_end);
+        if (c + 15 + 1 >= c_end) {
+            return c;
+        }
+
+        /* need to stop one early to get an accurate end state */
+        rv = shuftiVermDoubleExec(accel->shufti_dverm.lo,
+                                  accel->shufti_dverm.hi,
+                                  accel->shufti_dverm.c1,
+                                  accel->shufti_dverm.c2, c, c_end - 1);
+        break;
+
+    case ACCEL_LITERAL:
+        DEBUG_PRINTF("accel literal %u x %u %p %p\n", accel->lit.count,
+                     accel->lit.len, c, c_end);
+        if (c + 15 + accel->lit.len - 1 >= c_end) {
+            return c;
+        }
+
+        /* stop len - 1 early so that whole literals are read inside the
+         * buffer */
+        rv = literalAccelExec(accel->lit.lit, accel->lit.msk, accel->lit.count,
+                              accel->lit.len, accel->lit.pos, c,
+                              c_end - (accel->lit.len - 1));
+        break;
+
     case ACCEL_RED_TAPE:
         DEBUG_PRINTF("accel red tape %p %p\n", c, c_end);
         rv = c_end;
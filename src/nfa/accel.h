@@ -43,6 +43,12 @@
 /// Minimum length of the scan buffer for us to attempt acceleration.
 #define ACCEL_MIN_LEN       16
 
+/// Most stop literals in an ACCEL_LITERAL scheme.
+#define LITERAL_ACCEL_MAX_LITS 4
+
+/// Longest stop literal in an ACCEL_LITERAL scheme.
+#define LITERAL_ACCEL_MAX_LEN  8
+
 enum AccelType {
     ACCEL_NONE,
     ACCEL_VERM,
@@ -90,6 +96,14 @@ enum AccelType {
     ACCEL_MDSGTRUFFLE,
     /* masked dverm */
     ACCEL_DVERM_MASKED,
+    /* shufti class followed by a second class some bytes later */
+    ACCEL_DSHUFTI_DIST,
+    /* reverse truffle over bytes below 0x80, NFA reverse accel only */
+    ACCEL_RTRUFFLE_LOW,
+    /* shufti class and a double-vermicelli pair, scanned together */
+    ACCEL_SHUFTI_DVERM,
+    /* start of any of a few short masked literals */
+    ACCEL_LITERAL,
 
 };
 
@@ -140,6 +154,32 @@ union AccelAux {
         m128 lo2;
         m128 hi2;
     } dshufti;
+    struct {
+        u8 accel_type;
+        u8 offset;
+        u8 dist; // distance from the first class to the second
+        m128 lo1;
+        m128 hi1;
+        m128 lo2;
+        m128 hi2;
+    } dshufti_dist;
+    struct {
+        u8 accel_type;
+        u8 offset;
+        u8 c1; // first byte of the pair
+        u8 c2; // second byte of the pair
+        m128 lo;
+        m128 hi;
+    } shufti_dverm;
+    struct {
+        u8 accel_type;
+        u8 offset;
+        u8 count; // number of literals
+        u8 len; // length of the longest literal
+        u8 pos; // first of the two bytes used to find candidates
+        u64a lit[LITERAL_ACCEL_MAX_LITS]; // byte i is the literal's i-th byte
+        u64a msk[LITERAL_ACCEL_MAX_LITS]; // bits of lit that must match
+    } lit;
     struct {
         u8 accel_type;
         u8 offset;
@@ -29,6 +29,7 @@
 #include "accel_dfa_build_strat.h"
 
 #include "accel.h"
+#include "accelcompile.h"
 #include "grey.h"
 #include "nfagraph/ng_limex_accel.h"
 #include "shufticompile.h"
@@ -38,11 +39,24 @@
 #include "util/dump_charclass.h"
 #include "util/verify_types.h"
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <vector>
 
 #define PATHS_LIMIT 500
 
+/** \brief Largest distance between the two classes of a distance scheme. */
+#define DIST_ACCEL_MAX_DIST 8
+
+/** \brief Escape classes at least this wide are worth a distance scheme. */
+#define DIST_ACCEL_MIN_WIDTH 8
+
+/** \brief Most significant strings followed at each depth when looking for
+ * escape literals. */
+#define LIT_ACCEL_MAX_NODES 32
+
 using namespace std;
 
 namespace ue2 {
@@ -54,6 +68,18 @@ struct path {
     explicit path(dstate_id_t base) : dest(base) {
     }
 };
+
+/**
+ * A string w of symbols read from the base state that is significant: reading
+ * it leaves the DFA in a different state than reading w without its first
+ * symbol, and the same holds for every prefix of w.
+ */
+struct lit_node {
+    vector<u16> syms;
+    dstate_id_t state; //!< state after reading w from the base
+    dstate_id_t suffix_state; //!< state after reading w without its first
+                              //!< symbol
+};
 };
 
 static UNUSED
@@ -188,13 +214,174 @@ AccelScheme look_for_offset_accel(const raw_dfa &rdfa, dstate_id_t base,
     return as;
 }
 
+static
+bool shufti_ok(const CharReach &cr) {
+    m128 lo, hi;
+    return !cr.none() && shuftiBuildMasks(cr, &lo, &hi) != -1;
+}
+
+/**
+ * Looks for a pair of classes dist bytes apart which every escape path from
+ * base must pass through, starting no later than max_offset bytes in. Each
+ * path is given the start position which keeps the classes narrowest, and the
+ * distance which gives the narrowest classes overall wins.
+ */
+static
+AccelScheme look_for_dist_accel(const raw_dfa &rdfa, dstate_id_t base,
+                                u32 max_offset) {
+    DEBUG_PRINTF("looking for dist accel for %hu\n", base);
+    vector<vector<CharReach>> paths =
+        generate_paths(rdfa, base, max_offset + DIST_ACCEL_MAX_DIST + 1);
+
+    AccelScheme rv;
+    size_t best_cost = SIZE_MAX;
+    for (u32 dist = 1; dist <= DIST_ACCEL_MAX_DIST; dist++) {
+        CharReach cr1;
+        CharReach cr2;
+        u32 offset = 0;
+        bool ok = true;
+        for (const auto &p : paths) {
+            /* a trailing empty class marks a report or eod, not a byte */
+            size_t len = p.size();
+            if (len && p.back().none()) {
+                len--;
+            }
+
+            size_t path_cost = SIZE_MAX;
+            u32 path_i = 0;
+            for (u32 i = 0; i <= max_offset && i + dist < len; i++) {
+                size_t cost = (cr1 | p[i]).count() * (cr2 | p[i + dist]).count();
+                if (cost < path_cost) {
+                    path_cost = cost;
+                    path_i = i;
+                }
+            }
+
+            if (path_cost == SIZE_MAX) {
+                DEBUG_PRINTF("path too short for dist %u\n", dist);
+                ok = false;
+                break;
+            }
+
+            cr1 |= p[path_i];
+            cr2 |= p[path_i + dist];
+            offset = MAX(offset, path_i);
+        }
+
+        if (!ok || !shufti_ok(cr1) || !shufti_ok(cr2)) {
+            continue;
+        }
+
+        size_t cost = cr1.count() * cr2.count();
+        DEBUG_PRINTF("dist %u: %s then %s, offset %u\n", dist,
+                     describeClass(cr1).c_str(), describeClass(cr2).c_str(),
+                     offset);
+        if (cost < best_cost) {
+            best_cost = cost;
+            rv.dist_cr1 = cr1;
+            rv.dist_cr2 = cr2;
+            rv.dist = dist;
+            rv.dist_offset = offset;
+        }
+    }
+
+    return rv;
+}
+
+/**
+ * Looks for a set of literals, all of the same length K, such that the DFA can
+ * only leave base where one of them starts.
+ *
+ * If no significant string of length K starts in [p, q) and the DFA is in base
+ * at p, its state at q depends only on the last K - 1 bytes read, and running
+ * from base at q instead gives the same state K - 1 bytes later. So the
+ * significant strings of length K are stop literals, provided that none of
+ * the shorter ones raise callbacks. The K which gives the lowest stop rate
+ * wins; an empty set is returned if no K works.
+ */
+static
+vector<vector<CharReach>> look_for_literal_accel(const raw_dfa &rdfa,
+                                                 dstate_id_t base,
+                                                 const vector<CharReach> &rev_map) {
+    DEBUG_PRINTF("looking for literal accel for %hu\n", base);
+    vector<lit_node> curr;
+    for (u16 sym = 0; sym < rev_map.size(); sym++) {
+        dstate_id_t t = rdfa.states[base].next[sym];
+        if (t != base) {
+            curr.push_back(lit_node{{sym}, t, base});
+        }
+    }
+
+    vector<vector<CharReach>> best;
+    double best_rate = HUGE_VAL;
+    for (u32 depth = 1; !curr.empty() && curr.size() <= LIT_ACCEL_MAX_NODES;
+         depth++) {
+        if (depth >= 2) {
+            vector<vector<CharReach>> lits;
+            for (const auto &n : curr) {
+                vector<CharReach> lit;
+                for (u16 sym : n.syms) {
+                    lit.push_back(rev_map[sym]);
+                }
+                lits.push_back(move(lit));
+            }
+
+            AccelAux aux;
+            if (buildLiteralAccel(lits, &aux)) {
+                double rate = literalAccelRate(aux);
+                DEBUG_PRINTF("depth %u: %zu literals, rate %g\n", depth,
+                             lits.size(), rate);
+                if (rate < best_rate) {
+                    best_rate = rate;
+                    best = move(lits);
+                }
+            }
+        }
+
+        if (depth == LITERAL_ACCEL_MAX_LEN) {
+            break;
+        }
+
+        /* the scan skips over the states of significant strings shorter than
+         * the literals, so they may not raise callbacks */
+        if (generates_callbacks(rdfa.kind)) {
+            for (const auto &n : curr) {
+                if (!rdfa.states[n.state].reports.empty()) {
+                    DEBUG_PRINTF("depth %u leads to report\n", depth);
+                    return best;
+                }
+            }
+        }
+
+        vector<lit_node> next;
+        for (const auto &n : curr) {
+            for (u16 sym = 0; sym < rev_map.size(); sym++) {
+                dstate_id_t t1 = rdfa.states[n.state].next[sym];
+                dstate_id_t t2 = rdfa.states[n.suffix_state].next[sym];
+                if (t1 == t2) {
+                    continue;
+                }
+                lit_node child{n.syms, t1, t2};
+                child.syms.push_back(sym);
+                next.push_back(move(child));
+            }
+            if (next.size() > LIT_ACCEL_MAX_NODES) {
+                break;
+            }
+        }
+        curr = move(next);
+    }
+
+    return best;
+}
+
 static UNUSED
 bool better(const AccelScheme &a, const AccelScheme &b) {
     if (!a.double_byte.empty() && b.double_byte.empty()) {
         return true;
     }
 
-    if (!b.double_byte.empty()) {
+    if (!b.double_byte.empty() || !b.literals.empty()) {
         return false;
     }
 
@@ -219,6 +406,21 @@ bool double_byte_ok(const AccelScheme &info) {
            info.double_cr.count() <= 2 && !info.double_byte.empty();
 }
 
+/** \brief Expected fraction of positions at which the byte-class scheme in
+ * \a as stops, on uniformly random input. */
+static
+double stop_rate(const AccelScheme &as) {
+    const double pairs = N_CHARS * N_CHARS;
+    if (double_byte_ok(as)) {
+        return as.double_cr.count() * N_CHARS / pairs +
+               as.double_byte.size() / pairs;
+    }
+    if (as.dist) {
+        return as.dist_cr1.count() * as.dist_cr2.count() / pairs;
+    }
+    return (double)as.cr.count() / N_CHARS;
+}
+
 static
 bool has_self_loop(dstate_id_t s, const raw_dfa &raw) {
     u16 top_remap = raw.alpha_remap[TOP];
@@ -417,6 +619,37 @@ accel_dfa_build_strat::find_escape_strings(dstate_id_t this_idx) const {
         }
     }
 
+    if (!double_byte_ok(rv) && !is_triggered(rdfa.kind) &&
+        this_idx == rdfa.start_floating && this_idx != DEAD_STATE &&
+        rv.cr.count() >= DIST_ACCEL_MIN_WIDTH) {
+        DEBUG_PRINTF("looking for dist accel at %u\n", this_idx);
+        auto dist =
+            look_for_dist_accel(rdfa, this_idx, max_allowed_offset_accel());
+        /* the pair scan costs about twice a single shufti, so only take it if
+         * it lets through a quarter of the bytes or fewer */
+        if (dist.dist && dist.dist_cr1.count() * dist.dist_cr2.count() * 4 <=
+                             rv.cr.count() * N_CHARS) {
+            DEBUG_PRINTF("using dist accel\n");
+            rv.dist_cr1 = dist.dist_cr1;
+            rv.dist_cr2 = dist.dist_cr2;
+            rv.dist = dist.dist;
+            rv.dist_offset = dist.dist_offset;
+        }
+    }
+
+    /* states exited only by a few short strings can skip spans full of their
+     * first bytes; not worth the search once a single pair is the stop */
+    if (this_idx != DEAD_STATE && has_self_loop(this_idx, rdfa) &&
+        stop_rate(rv) * N_CHARS * N_CHARS > 1) {
+        auto lits = look_for_literal_accel(rdfa, this_idx, rev_map);
+        AccelAux aux;
+        if (!lits.empty() && buildLiteralAccel(lits, &aux) &&
+            literalAccelRate(aux) * LITERAL_ACCEL_COST <= stop_rate(rv)) {
+            DEBUG_PRINTF("using literal accel\n");
+            rv.literals = move(lits);
+        }
+    }
+
     return rv;
 }
 
@@ -430,6 +663,11 @@ accel_dfa_build_strat::buildAccel(UNUSED dstate_id_t this_idx,
                  info.double_offset);
     accel->generic.offset = verify_u8(info.offset);
 
+    if (!info.literals.empty() && buildLiteralAccel(info.literals, accel)) {
+        DEBUG_PRINTF("state %hu is literal accel\n", this_idx);
+        return;
+    }
+
     if (double_byte_ok(info) && info.double_cr.none() &&
         info.double_byte.size() == 1) {
         accel->accel_type = ACCEL_DVERM;
@@ -491,6 +729,18 @@ accel_dfa_build_strat::buildAccel(UNUSED dstate_id_t this_idx,
         return;
     }
 
+    if (info.dist &&
+        shuftiBuildMasks(info.dist_cr1, &accel->dshufti_dist.lo1,
+                         &accel->dshufti_dist.hi1) != -1 &&
+        shuftiBuildMasks(info.dist_cr2, &accel->dshufti_dist.lo2,
+                         &accel->dshufti_dist.hi2) != -1) {
+        accel->accel_type = ACCEL_DSHUFTI_DIST;
+        accel->dshufti_dist.offset = verify_u8(info.dist_offset);
+        accel->dshufti_dist.dist = verify_u8(info.dist);
+        DEBUG_PRINTF("state %hu is dist shufti\n", this_idx);
+        return;
+    }
+
     if (info.cr.none()) {
         accel->accel_type = ACCEL_RED_TAPE;
         DEBUG_PRINTF("state %hu is a dead end full of bureaucratic red tape"
@@ -560,7 +810,7 @@ accel_dfa_build_strat::getAccelInfo(const Grey &grey) {
         DEBUG_PRINTF("inspecting %zu/%hu: %zu\n", i, sds_proxy, single_limit);
 
         AccelScheme ei = find_escape_strings(i);
-        if (ei.cr.count() > single_limit) {
+        if (ei.cr.count() > single_limit && !ei.dist && ei.literals.empty()) {
             DEBUG_PRINTF("state %zu is not accelerable has %zu\n", i,
                          ei.cr.count());
             continue;
@@ -572,10 +822,13 @@ accel_dfa_build_strat::getAccelInfo(const Grey &grey) {
     }
 
     /* provide accleration states to states in the region of sds */
-    if (contains(rv, sds_proxy)) {
+    if (contains(rv, sds_proxy) &&
+        rv[sds_proxy].cr.count() <= max_floating_stop_char()) {
         AccelScheme sds_ei = rv[sds_proxy];
         sds_ei.double_byte.clear(); /* region based on single byte scheme
                                      * may differ from double byte */
+        sds_ei.dist = 0; /* likewise the distance scheme */
+        sds_ei.literals.clear(); /* and the literal scheme */
         DEBUG_PRINTF("looking to expand offset accel to nearby states, %zu\n",
                      sds_ei.cr.count());
         auto sds_region = find_region(rdfa, sds_proxy, sds_ei);
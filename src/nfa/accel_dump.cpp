@@ -89,6 +89,12 @@ const char *accelName(u8 accel_type) {
         return "shufti";
     case ACCEL_DSHUFTI:
         return "double-shufti";
+    case ACCEL_DSHUFTI_DIST:
+        return "distance double-shufti";
+    case ACCEL_SHUFTI_DVERM:
+        return "shufti and double-vermicelli";
+    case ACCEL_LITERAL:
+        return "literal";
     case ACCEL_TRUFFLE:
         return "truffle";
     case ACCEL_RED_TAPE:
@@ -269,6 +275,29 @@ void dumpAccelInfo(FILE *f, const AccelAux &accel) {
         dumpDShuftiCharReach(f, accel.dshufti.lo1, accel.dshufti.hi1,
                              accel.dshufti.lo2, accel.dshufti.hi2);
         break;
+    case ACCEL_DSHUFTI_DIST:
+        fprintf(f, " dist %u\n", accel.dshufti_dist.dist);
+        fprintf(f, "mask 1\n");
+        dumpShuftiMasks(f, accel.dshufti_dist.lo1, accel.dshufti_dist.hi1);
+        dumpShuftiCharReach(f, accel.dshufti_dist.lo1, accel.dshufti_dist.hi1);
+        fprintf(f, "mask 2\n");
+        dumpShuftiMasks(f, accel.dshufti_dist.lo2, accel.dshufti_dist.hi2);
+        dumpShuftiCharReach(f, accel.dshufti_dist.lo2, accel.dshufti_dist.hi2);
+        break;
+    case ACCEL_SHUFTI_DVERM:
+        fprintf(f, " [\\x%02hhx\\x%02hhx]\n", accel.shufti_dverm.c1,
+                accel.shufti_dverm.c2);
+        dumpShuftiMasks(f, accel.shufti_dverm.lo, accel.shufti_dverm.hi);
+        dumpShuftiCharReach(f, accel.shufti_dverm.lo, accel.shufti_dverm.hi);
+        break;
+    case ACCEL_LITERAL:
+        fprintf(f, " %u literals, len %u, prefilter at %u\n",
+                accel.lit.count, accel.lit.len, accel.lit.pos);
+        for (u32 i = 0; i < accel.lit.count; i++) {
+            fprintf(f, "lit 0x%016llx mask 0x%016llx\n", accel.lit.lit[i],
+                    accel.lit.msk[i]);
+        }
+        break;
     case ACCEL_TRUFFLE: {
         fprintf(f, "\n");
         dumpTruffleMasks(f, accel.truffle.mask1, accel.truffle.mask2);
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Literal acceleration: finds the start of any of a few short literals.
+ */
+
+#include "accel.h"
+#include "accel_literal.h"
+#include "ue2common.h"
+#include "util/bitutils.h"
+#include "util/partial_store.h"
+#include "util/simd_utils.h"
+
+/** \brief Returns non-zero if one of the literals starts at \a p. */
+static really_inline
+int literalAt(const u64a *lit, const u64a *msk, u32 count, u32 len,
+              const u8 *p) {
+    u64a v = partial_load_u64a(p, len);
+    for (u32 i = 0; i < count; i++) {
+        if ((v & msk[i]) == lit[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** \brief Naive byte-by-byte implementation. */
+static really_inline
+const u8 *literalAccelSlow(const u64a *lit, const u64a *msk, u32 count,
+                           u32 len, const u8 *buf, const u8 *buf_end) {
+    for (; buf < buf_end; buf++) {
+        if (literalAt(lit, msk, count, len, buf)) {
+            return buf;
+        }
+    }
+    return buf_end;
+}
+
+/** \brief Candidate masks for the two prefilter bytes of each literal. */
+struct lit_prefilter {
+    m128 c1[LITERAL_ACCEL_MAX_LITS];
+    m128 m1[LITERAL_ACCEL_MAX_LITS];
+    m128 c2[LITERAL_ACCEL_MAX_LITS];
+    m128 m2[LITERAL_ACCEL_MAX_LITS];
+};
+
+/** \brief Checks the 16 start positions from \a buf; returns the first at
+ * which a literal starts, or NULL. */
+static really_inline
+const u8 *literalBlock(const struct lit_prefilter *pf, const u64a *lit,
+                       const u64a *msk, u32 count, u32 len, u32 pos,
+                       const u8 *buf) {
+    m128 d1 = loadu128(buf + pos);
+    m128 d2 = loadu128(buf + pos + 1);
+
+    u32 z = 0;
+    for (u32 i = 0; i < count; i++) {
+        m128 t1 = eq128(and128(d1, pf->m1[i]), pf->c1[i]);
+        m128 t2 = eq128(and128(d2, pf->m2[i]), pf->c2[i]);
+        z |= movemask128(and128(t1, t2));
+    }
+
+    while (z) {
+        const u8 *p = buf + findAndClearLSB_32(&z);
+        if (literalAt(lit, msk, count, len, p)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+const u8 *literalAccelExec(const u64a *lit, const u64a *msk, u32 count,
+                           u32 len, u32 pos, const u8 *buf,
+                           const u8 *buf_end) {
+    assert(buf && buf_end);
+    assert(buf < buf_end);
+    assert(count && count <= LITERAL_ACCEL_MAX_LITS);
+    assert(len >= 2 && len <= LITERAL_ACCEL_MAX_LEN);
+    assert(pos + 1 < len);
+
+    if (buf_end - buf < 16) {
+        return literalAccelSlow(lit, msk, count, len, buf, buf_end);
+    }
+
+    struct lit_prefilter pf;
+    for (u32 i = 0; i < count; i++) {
+        pf.c1[i] = set16x8((u8)(lit[i] >> (8 * pos)));
+        pf.m1[i] = set16x8((u8)(msk[i] >> (8 * pos)));
+        pf.c2[i] = set16x8((u8)(lit[i] >> (8 * (pos + 1))));
+        pf.m2[i] = set16x8((u8)(msk[i] >> (8 * (pos + 1))));
+    }
+
+    /* the prefilter loads are unaligned whatever we do, so don't bother
+     * aligning */
+    const u8 *last_block = buf_end - 16;
+    for (; buf < last_block; buf += 16) {
+        const u8 *rv = literalBlock(&pf, lit, msk, count, len, pos, buf);
+        if (rv) {
+            return rv;
+        }
+    }
+
+    const u8 *rv = literalBlock(&pf, lit, msk, count, len, pos, last_block);
+    return rv ? rv : buf_end;
+}
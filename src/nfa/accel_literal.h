@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Literal acceleration: finds the start of any of a few short literals.
+ *
+ * Candidates are found by comparing two bytes of each literal with a vector of
+ * input at a time, then checked against the whole literal.
+ */
+
+#ifndef ACCEL_LITERAL_H
+#define ACCEL_LITERAL_H
+
+#include "ue2common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Finds the first position in [buf, buf_end) at which one of the
+ * \a count literals starts.
+ *
+ * Byte i of \a lit[j] is the i-th byte of literal j, and \a msk[j] holds the
+ * bits that must match; literals are at most \a len bytes long and bytes
+ * \a pos and \a pos + 1 of each are compared first. Returns buf_end if no
+ * literal starts in the range; a literal may end beyond buf_end, so this reads
+ * up to buf_end + len - 1.
+ */
+const u8 *literalAccelExec(const u64a *lit, const u64a *msk, u32 count,
+                           u32 len, u32 pos, const u8 *buf,
+                           const u8 *buf_end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ACCEL_LITERAL_H */
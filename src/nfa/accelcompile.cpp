@@ -32,8 +32,12 @@
 #include "trufflecompile.h"
 #include "nfagraph/ng_limex_accel.h" /* for constants */
 #include "util/bitutils.h"
+#include "util/popcount.h"
 #include "util/verify_types.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <map>
 #include <set>
 #include <vector>
@@ -219,6 +223,21 @@ void buildAccelDouble(const AccelInfo &info, AccelAux *aux) {
         }
     }
 
+    if (outs2 == 1 && outs1 < info.single_stops.count()) {
+        // One pair and a class of single bytes: scanning for both at once
+        // stops on fewer bytes than the single-byte scheme would.
+        DEBUG_PRINTF("building shufti-dverm for %zu one-byte literals\n",
+                     outs1);
+        if (-1 != shuftiBuildMasks(info.double_stop1, &aux->shufti_dverm.lo,
+                                   &aux->shufti_dverm.hi)) {
+            aux->accel_type = ACCEL_SHUFTI_DVERM;
+            aux->shufti_dverm.offset = offset;
+            aux->shufti_dverm.c1 = info.double_stop2.begin()->first;
+            aux->shufti_dverm.c2 = info.double_stop2.begin()->second;
+            return;
+        }
+    }
+
     // drop back to attempt single-byte accel
     DEBUG_PRINTF("dropping back to single-byte acceleration\n");
     aux->accel_type = ACCEL_NONE;
@@ -492,6 +511,220 @@ void buildAccelMulti(const AccelInfo &info, AccelAux *aux) {
     DEBUG_PRINTF("unable to accelerate multibyte case with %zu outs\n", outs);
 }
 
+/** \brief Smallest set of bytes of the form {b : (b & mask) == val} that
+ * contains every byte in \a cr. */
+static
+void literalClassMask(const CharReach &cr, u8 *val, u8 *mask) {
+    assert(cr.any());
+    size_t first = cr.find_first();
+    u8 diff = 0;
+    for (size_t i = first; i != CharReach::npos; i = cr.find_next(i)) {
+        diff |= (u8)(i ^ first);
+    }
+    *mask = (u8)~diff;
+    *val = (u8)first & *mask;
+}
+
+/** \brief Fraction of positions at which a literal starts on uniformly random
+ * input, once its classes have been widened to masks. */
+static
+double literalRate(const vector<CharReach> &lit) {
+    double rate = 1.0;
+    for (const auto &cr : lit) {
+        u8 val, mask;
+        literalClassMask(cr, &val, &mask);
+        rate /= 1U << popcount32(mask);
+    }
+    return rate;
+}
+
+/** \brief Literal that matches wherever either \a a or \a b does. */
+static
+vector<CharReach> literalUnion(const vector<CharReach> &a,
+                               const vector<CharReach> &b) {
+    /* the shorter literal matches whatever follows it, so the union stops
+     * where it does */
+    vector<CharReach> rv(min(a.size(), b.size()));
+    for (size_t i = 0; i < rv.size(); i++) {
+        rv[i] = a[i] | b[i];
+    }
+    return rv;
+}
+
+/** \brief Merges literals that differ in a single class, which loses
+ * nothing. */
+static
+void mergeLiteralsExact(vector<vector<CharReach>> &lits) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < lits.size() && !changed; i++) {
+            for (size_t j = i + 1; j < lits.size() && !changed; j++) {
+                const auto &a = lits[i];
+                const auto &b = lits[j];
+                if (a.size() != b.size()) {
+                    continue;
+                }
+                u32 diffs = 0;
+                for (size_t k = 0; k < a.size() && diffs < 2; k++) {
+                    diffs += a[k] != b[k] ? 1 : 0;
+                }
+                if (diffs <= 1) {
+                    lits[i] = literalUnion(a, b);
+                    lits.erase(lits.begin() + j);
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+/** \brief Merges the pair of literals whose union adds the least to the stop
+ * rate. */
+static
+void mergeLiteralsCheapest(vector<vector<CharReach>> &lits) {
+    assert(lits.size() >= 2);
+    size_t best_i = 0;
+    size_t best_j = 1;
+    double best_cost = HUGE_VAL;
+    for (size_t i = 0; i < lits.size(); i++) {
+        for (size_t j = i + 1; j < lits.size(); j++) {
+            double cost = literalRate(literalUnion(lits[i], lits[j])) -
+                          literalRate(lits[i]) - literalRate(lits[j]);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_i = i;
+                best_j = j;
+            }
+        }
+    }
+    lits[best_i] = literalUnion(lits[best_i], lits[best_j]);
+    lits.erase(lits.begin() + best_j);
+}
+
+/** \brief Picks the pair of bytes compared first: the pair that lets the
+ * fewest candidates through, preferring pairs that do not recur elsewhere in
+ * their literal (the middle "\n\r" of "\r\n\r\n") and then later pairs. */
+static
+u8 pickLiteralPrefilter(const AccelAux &aux) {
+    u32 best_pos = 0;
+    double best_rate = HUGE_VAL;
+    u32 best_repeats = ~0U;
+    for (u32 pos = 0; pos + 1 < aux.lit.len; pos++) {
+        double rate = 0;
+        u32 repeats = 0;
+        for (u32 i = 0; i < aux.lit.count; i++) {
+            u64a m = (aux.lit.msk[i] >> (8 * pos)) & 0xffff;
+            u64a v = (aux.lit.lit[i] >> (8 * pos)) & 0xffff;
+            rate += 1.0 / (1ULL << popcount64(m));
+            for (u32 other = 0; other + 1 < aux.lit.len; other++) {
+                if (other != pos &&
+                    ((aux.lit.msk[i] >> (8 * other)) & 0xffff) == m &&
+                    ((aux.lit.lit[i] >> (8 * other)) & 0xffff) == v) {
+                    repeats++;
+                    break;
+                }
+            }
+        }
+        if (rate < best_rate ||
+            (rate == best_rate && repeats <= best_repeats)) {
+            best_pos = pos;
+            best_rate = rate;
+            best_repeats = repeats;
+        }
+    }
+    return verify_u8(best_pos);
+}
+
+bool buildLiteralAccel(const vector<vector<CharReach>> &lits_in,
+                       AccelAux *aux) {
+    vector<vector<CharReach>> lits;
+    for (const auto &lit : lits_in) {
+        if (lit.empty()) {
+            DEBUG_PRINTF("empty literal, would stop everywhere\n");
+            return false;
+        }
+        if (any_of(lit.begin(), lit.end(),
+                   [](const CharReach &cr) { return cr.none(); })) {
+            continue; /* can never match */
+        }
+        lits.emplace_back(lit.begin(),
+                          lit.begin() + min(lit.size(),
+                                            (size_t)LITERAL_ACCEL_MAX_LEN));
+    }
+    if (lits.empty()) {
+        return false;
+    }
+
+    sort(lits.begin(), lits.end());
+    lits.erase(unique(lits.begin(), lits.end()), lits.end());
+    mergeLiteralsExact(lits);
+    while (lits.size() > LITERAL_ACCEL_MAX_LITS) {
+        mergeLiteralsCheapest(lits);
+    }
+
+    size_t len = 0;
+    for (const auto &lit : lits) {
+        len = max(len, lit.size());
+    }
+    if (len < 2) {
+        DEBUG_PRINTF("single byte literals only\n");
+        return false;
+    }
+
+    memset(aux, 0, sizeof(*aux));
+    aux->accel_type = ACCEL_LITERAL;
+    aux->lit.offset = 0;
+    aux->lit.count = verify_u8(lits.size());
+    aux->lit.len = verify_u8(len);
+    for (size_t i = 0; i < lits.size(); i++) {
+        for (size_t j = 0; j < lits[i].size(); j++) {
+            u8 val, mask;
+            literalClassMask(lits[i][j], &val, &mask);
+            aux->lit.lit[i] |= (u64a)val << (8 * j);
+            aux->lit.msk[i] |= (u64a)mask << (8 * j);
+        }
+    }
+    aux->lit.pos = pickLiteralPrefilter(*aux);
+    DEBUG_PRINTF("built literal accel: %u literals, len %u, pos %u\n",
+                 aux->lit.count, aux->lit.len, aux->lit.pos);
+    return true;
+}
+
+double literalAccelRate(const AccelAux &aux) {
+    assert(aux.accel_type == ACCEL_LITERAL);
+    double rate = 0;
+    for (u32 i = 0; i < aux.lit.count; i++) {
+        rate += 1.0 / (1ULL << popcount64(aux.lit.msk[i]));
+    }
+    return rate;
+}
+
+/** \brief Expected fraction of positions at which the byte-class scheme
+ * built from \a info stops, for comparison with a literal scheme; zero for
+ * schemes that should not be replaced. */
+static
+double accelStopRate(const AccelInfo &info, const AccelAux &aux) {
+    switch (aux.accel_type) {
+    case ACCEL_NONE:
+        return 1.0;
+    case ACCEL_VERM:
+    case ACCEL_VERM_NOCASE:
+    case ACCEL_SHUFTI:
+    case ACCEL_TRUFFLE:
+        return (double)info.single_stops.count() / N_CHARS;
+    case ACCEL_DVERM:
+    case ACCEL_DVERM_NOCASE:
+    case ACCEL_DVERM_MASKED:
+    case ACCEL_DSHUFTI:
+    case ACCEL_SHUFTI_DVERM:
+        return (double)info.double_stop1.count() / N_CHARS +
+               (double)info.double_stop2.size() / (N_CHARS * N_CHARS);
+    default:
+        return 0;
+    }
+}
+
 bool buildAccelAux(const AccelInfo &info, AccelAux *aux) {
     assert(aux->accel_type == ACCEL_NONE);
     if (info.single_stops.none()) {
@@ -509,7 +742,18 @@ bool buildAccelAux(const AccelInfo &info, AccelAux *aux) {
         buildAccelSingle(info, aux);
     }
 
+    if (!info.literals.empty()) {
+        AccelAux lit_aux;
+        if (buildLiteralAccel(info.literals, &lit_aux) &&
+            literalAccelRate(lit_aux) * LITERAL_ACCEL_COST <=
+                accelStopRate(info, *aux)) {
+            DEBUG_PRINTF("picked literal scheme\n");
+            *aux = lit_aux;
+        }
+    }
+
     assert(aux->accel_type == ACCEL_NONE
+           || aux->accel_type == ACCEL_LITERAL
            || aux->generic.offset == info.single_offset
            || aux->generic.offset == info.double_offset);
     return aux->accel_type != ACCEL_NONE;
@@ -33,6 +33,8 @@
 #include "util/charreach.h"
 #include "util/ue2_containers.h"
 
+#include <vector>
+
 union AccelAux;
 
 namespace ue2 {
@@ -73,10 +75,27 @@ struct AccelInfo {
     u32 ma_len1; /**< multiaccel len1 */
     u32 ma_len2; /**< multiaccel len2 */
     MultibyteAccelInfo::multiaccel_type ma_type; /**< multiaccel type */
+    std::vector<std::vector<CharReach>> literals; /**< escape literals for a
+                                                   * literal scheme, at offset
+                                                   * zero */
 };
 
+/** \brief A literal scheme must stop this many times less often than the
+ * byte-class scheme it replaces, to pay for its slower scan. */
+#define LITERAL_ACCEL_COST 4
+
 bool buildAccelAux(const AccelInfo &info, AccelAux *aux);
 
+/** \brief Builds an ACCEL_LITERAL scheme which stops at the start of any of
+ * the given sequences of classes, merging and widening them to fit; returns
+ * false if they cannot be accelerated this way. */
+bool buildLiteralAccel(const std::vector<std::vector<CharReach>> &lits,
+                       AccelAux *aux);
+
+/** \brief Expected fraction of positions at which the ACCEL_LITERAL scheme in
+ * \a aux stops, on uniformly random input. */
+double literalAccelRate(const AccelAux &aux);
+
 /* returns true is the escape set can be handled with a masked double_verm */
 bool buildDvermMask(const flat_set<std::pair<u8, u8>> &escape_set,
                     u8 *m1_out = nullptr, u8 *m2_out = nullptr);
@@ -267,10 +267,16 @@ void castleDeactivateStaleSubs(const struct Castle *c, const u64a offset,
     }
 }
 
+/**
+ * \brief Marks the repeat for \a top active and fills in \a entry with the
+ * repeat store needed for this top. Returns 0 if the top is a duplicate and
+ * nothing need be stored.
+ */
 static really_inline
-void castleProcessTop(const struct Castle *c, const u32 top, const u64a offset,
-                      void *full_state, void *stream_state,
-                      UNUSED char stale_checked) {
+char castleActivateTop(const struct Castle *c, const u32 top,
+                       const u64a offset, void *full_state, void *stream_state,
+                       UNUSED char stale_checked,
+                       struct RepeatStoreEntry *entry) {
     assert(top < c->numRepeats);
 
     const struct SubCastle *sub = getSubCastle(c, top);
@@ -311,11 +317,102 @@ void castleProcessTop(const struct Castle *c, const u32 top, const u64a offset,
         assert(last <= offset);
         if (last == offset) {
             DEBUG_PRINTF("dupe top at %llu\n", offset);
-            return;
+            return 0;
         }
     }
 
-    repeatStore(info, rctrl, rstate, offset, is_alive);
+    entry->info = info;
+    entry->ctrl = rctrl;
+    entry->state = rstate;
+    entry->is_alive = is_alive;
+    return 1;
+}
+
+static really_inline
+void castleProcessTop(const struct Castle *c, const u32 top, const u64a offset,
+                      void *full_state, void *stream_state,
+                      char stale_checked) {
+    struct RepeatStoreEntry entry;
+    if (castleActivateTop(c, top, offset, full_state, stream_state,
+                          stale_checked, &entry)) {
+        repeatStore(entry.info, entry.ctrl, entry.state, offset,
+                    entry.is_alive);
+    }
+}
+
+/** \brief Maximum number of tops gathered for one call to repeatStoreBatch. */
+#define CASTLE_TOP_BATCH 16
+
+/** \brief Returns 1 if the repeat for \a top already has a store pending in
+ * \a batch. */
+static really_inline
+char castleTopPending(const struct Castle *c, const u32 top,
+                      const void *full_state,
+                      const struct RepeatStoreEntry *batch, u32 count) {
+    const union RepeatControl *rctrl =
+        getControlConst(full_state, getSubCastle(c, top));
+    for (u32 i = 0; i < count; i++) {
+        if (batch[i].ctrl == rctrl) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Handles the event at q->cur and every following event at the same
+ * location, leaving q->cur at the first event not handled.
+ *
+ * Tops for non-exclusive repeats are gathered and stored with a single
+ * repeatStoreBatch call. Tops for exclusive repeats share state with the rest
+ * of their group, so pending stores are flushed before each is handled alone.
+ */
+static really_inline
+void castleHandleEvents(const struct Castle *c, struct mq *q, const u64a sp,
+                        char stale_checked) {
+    const s64a loc = q_cur_loc(q);
+    struct RepeatStoreEntry batch[CASTLE_TOP_BATCH];
+    u32 count = 0;
+
+    do {
+        const u32 event = q->items[q->cur].type;
+        if (event < MQE_TOP_FIRST) {
+            assert(event != MQE_TOP); // should be a numbered top
+            assert(event == MQE_START || event == MQE_END);
+            q->cur++;
+            continue;
+        }
+
+        assert(event < MQE_INVALID);
+        u32 top = event - MQE_TOP_FIRST;
+        DEBUG_PRINTF("top %u at offset %llu\n", top, sp);
+        q->cur++;
+
+        if (getSubCastle(c, top)->exclusiveId < c->numRepeats) {
+            repeatStoreBatch(batch, count, sp);
+            count = 0;
+            castleProcessTop(c, top, sp, q->state, q->streamState,
+                             stale_checked);
+            continue;
+        }
+
+        if (castleTopPending(c, top, q->state, batch, count)) {
+            DEBUG_PRINTF("dupe top at %llu\n", sp);
+            continue;
+        }
+
+        if (count == CASTLE_TOP_BATCH) {
+            repeatStoreBatch(batch, count, sp);
+            count = 0;
+        }
+
+        if (castleActivateTop(c, top, sp, q->state, q->streamState,
+                              stale_checked, &batch[count])) {
+            count++;
+        }
+    } while (q->cur < q->end && q_cur_loc(q) == loc);
+
+    repeatStoreBatch(batch, count, sp);
 }
 
 static really_inline
@@ -710,27 +807,6 @@ char castleRevScan(const struct Castle *c, const u8 *buf, const size_t begin,
     }
 }
 
-static really_inline
-void castleHandleEvent(const struct Castle *c, struct mq *q, const u64a sp,
-                       char stale_checked) {
-    const u32 event = q->items[q->cur].type;
-    switch (event) {
-    case MQE_TOP:
-        assert(0); // should be a numbered top
-        break;
-    case MQE_START:
-    case MQE_END:
-        break;
-    default:
-        assert(event >= MQE_TOP_FIRST);
-        assert(event < MQE_INVALID);
-        u32 top = event - MQE_TOP_FIRST;
-        DEBUG_PRINTF("top %u at offset %llu\n", top, sp);
-        castleProcessTop(c, top, sp, q->state, q->streamState, stale_checked);
-        break;
-    }
-}
-
 static really_inline
 void clear_repeats(const struct Castle *c, const struct mq *q, u8 *active) {
     DEBUG_PRINTF("clearing active repeats due to escape\n");
@@ -842,8 +918,7 @@ char nfaExecCastle0_Q_i(const struct NFA *n, struct mq *q, s64a end,
         }
 
         sp = q_cur_offset(q);
-        castleHandleEvent(c, q, sp, 1);
-        q->cur++;
+        castleHandleEvents(c, q, sp, 1);
     }
 
     if (c->exclusive) {
@@ -934,8 +1009,7 @@ char nfaExecCastle0_QR(const struct NFA *n, struct mq *q, ReportID report) {
         DEBUG_PRINTF("q item type=%d offset=%llu\n", q_cur_type(q),
                      q_cur_offset(q));
         u64a sp = q_cur_offset(q);
-        castleHandleEvent(c, q, sp, 0);
-        q->cur++;
+        castleHandleEvents(c, q, sp, 0);
     }
 
     castleDeactivateStaleSubs(c, end_offset, q->state, q->streamState);
@@ -55,7 +55,9 @@
 #include "util/verify_types.h"
 #include "grey.h"
 
+#include <algorithm>
 #include <stack>
+#include <tuple>
 #include <cassert>
 
 #include <boost/range/adaptor/map.hpp>
@@ -337,6 +339,13 @@ struct ExclusiveInfo {
 };
 }
 
+/**
+ * \brief Subcastles whose repeats have the same model, bounds and min period
+ * have identical RepeatInfo structures (and sparse tables), so they can share
+ * one copy in the bytecode. This is the key used to find them.
+ */
+using RepeatShareKey = std::tuple<u8, u32, u32, u32>;
+
 static
 void buildSubcastles(const CastleProto &proto, vector<SubCastle> &subs,
                      vector<RepeatInfo> &infos, vector<u64a> &patchSize,
@@ -344,7 +353,8 @@ void buildSubcastles(const CastleProto &proto, vector<SubCastle> &subs,
                      u32 &scratchStateSize, u32 &streamStateSize,
                      u32 &tableSize, vector<u64a> &tables, u32 &sparseRepeats,
                      const ExclusiveInfo &exclusiveInfo,
-                     vector<u32> &may_stale, const ReportManager &rm) {
+                     vector<u32> &may_stale, vector<u32> &infoLeader,
+                     bool share_repeats, const ReportManager &rm) {
     const bool remap_reports = has_managed_reports(proto.kind);
 
     u32 i = 0;
@@ -352,6 +362,12 @@ void buildSubcastles(const CastleProto &proto, vector<SubCastle> &subs,
     const auto &numGroups = exclusiveInfo.numGroups;
     vector<u32> maxStreamSize(numGroups, 0);
 
+    // Non-exclusive subcastles, and their stream state sizes, in the order
+    // their state is to be laid out.
+    vector<u32> order;
+    vector<u32> subStreamSizes(subs.size(), 0);
+    map<RepeatShareKey, u32> leaders;
+
     for (auto it = proto.repeats.begin(), ite = proto.repeats.end();
          it != ite; ++it, ++i) {
         const PureRepeat &pr = it->second;
@@ -378,10 +394,10 @@ void buildSubcastles(const CastleProto &proto, vector<SubCastle> &subs,
             // SubCastle full/stream state offsets are written in for the group
             // below.
         } else {
-            sub.fullStateOffset = scratchStateSize;
-            sub.streamStateOffset = streamStateSize;
-            scratchStateSize += verify_u32(sizeof(RepeatControl));
-            streamStateSize += subStreamStateSize;
+            // Non-exclusive state offsets are also assigned below, once we
+            // know which subcastles share a repeat.
+            order.push_back(i);
+            subStreamSizes[i] = subStreamStateSize;
         }
 
         if (pr.bounds.max.is_finite()) {
@@ -407,7 +423,18 @@ void buildSubcastles(const CastleProto &proto, vector<SubCastle> &subs,
         ReportID id = *pr.reports.begin();
         sub.report = remap_reports ? rm.getProgramOffset(id) : id;
 
-        if (rtype == REPEAT_SPARSE_OPTIMAL_P) {
+        infoLeader[i] = i;
+        if (share_repeats) {
+            RepeatShareKey key(info.type, info.repeatMin, info.repeatMax,
+                               info.minPeriod);
+            auto lit = leaders.emplace(key, i).first;
+            infoLeader[i] = lit->second;
+        }
+
+        if (infoLeader[i] != i) {
+            DEBUG_PRINTF("sub %u shares repeat info with sub %u\n", i,
+                         infoLeader[i]);
+        } else if (rtype == REPEAT_SPARSE_OPTIMAL_P) {
             for (u32 j = 0; j < rsi.patchSize; j++) {
                 tables.push_back(rsi.table[j]);
             }
@@ -417,6 +444,21 @@ void buildSubcastles(const CastleProto &proto, vector<SubCastle> &subs,
         }
     }
 
+    // Lay out the state for subcastles sharing a repeat contiguously, so that
+    // each group's control blocks and repeat state form packed arrays.
+    if (share_repeats) {
+        stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+            return infoLeader[a] < infoLeader[b];
+        });
+    }
+    for (u32 j : order) {
+        SubCastle &sub = subs[j];
+        sub.fullStateOffset = scratchStateSize;
+        sub.streamStateOffset = streamStateSize;
+        scratchStateSize += verify_u32(sizeof(RepeatControl));
+        streamStateSize += subStreamSizes[j];
+    }
+
     vector<u32> scratchOffset(numGroups, 0);
     vector<u32> streamOffset(numGroups, 0);
     for (const auto &j : groupId) {
@@ -550,10 +592,19 @@ buildCastle(const CastleProto &proto,
     u32 tableSize = 0;
     u32 sparseRepeats = 0;
     vector<u32> may_stale; /* sub castles that may go stale */
+    vector<u32> infoLeader(numRepeats); /* sub whose RepeatInfo each uses */
 
     buildSubcastles(proto, subs, infos, patchSize, repeatInfoPair,
                     scratchStateSize, streamStateSize, tableSize,
-                    tables, sparseRepeats, exclusiveInfo, may_stale, rm);
+                    tables, sparseRepeats, exclusiveInfo, may_stale,
+                    infoLeader, cc.grey.castleShareRepeats, rm);
+
+    u32 numInfos = 0;
+    for (i = 0; i < numRepeats; i++) {
+        numInfos += infoLeader[i] == i;
+    }
+    DEBUG_PRINTF("%u distinct repeat infos for %zu subcastles\n", numInfos,
+                 numRepeats);
 
     DEBUG_PRINTF("%zu subcastles may go stale\n", may_stale.size());
     vector<mmbit_sparse_iter> stale_iter;
@@ -566,7 +617,7 @@ buildCastle(const CastleProto &proto,
         sizeof(NFA) +                      // initial NFA structure
         sizeof(Castle) +                   // Castle structure
         sizeof(SubCastle) * subs.size() +  // SubCastles themselves
-        sizeof(RepeatInfo) * subs.size() + // RepeatInfo structure
+        sizeof(RepeatInfo) * numInfos +    // RepeatInfo structures
         sizeof(u64a) * tableSize +         // table size for
                                            // REPEAT_SPARSE_OPTIMAL_P
         sizeof(u64a) * sparseRepeats;      // paddings for
@@ -603,8 +654,27 @@ buildCastle(const CastleProto &proto,
     u32 length = 0;
     u32 tableIdx = 0;
     for (i = 0; i < numRepeats; i++) {
-        u32 offset = sizeof(SubCastle) * (numRepeats - i) + length;
         SubCastle *sub = &subCastles[i];
+
+        // set exclusive group info
+        if (contains(exclusiveInfo.groupId, i)) {
+            sub->exclusiveId = exclusiveInfo.groupId[i];
+        } else {
+            sub->exclusiveId = numRepeats;
+        }
+
+        if (infoLeader[i] != i) {
+            // Point at the copy written for the leader of this group, which
+            // always comes earlier.
+            assert(infoLeader[i] < i);
+            const SubCastle *leader = &subCastles[infoLeader[i]];
+            const char *leader_info =
+                (const char *)leader + leader->repeatInfoOffset;
+            sub->repeatInfoOffset = verify_u32(leader_info - (char *)sub);
+            continue;
+        }
+
+        u32 offset = sizeof(SubCastle) * (numRepeats - i) + length;
         sub->repeatInfoOffset = offset;
 
         ptr = (char *)sub + offset;
@@ -624,13 +694,6 @@ buildCastle(const CastleProto &proto,
         } else {
             length += sizeof(RepeatInfo);
         }
-
-        // set exclusive group info
-        if (contains(exclusiveInfo.groupId, i)) {
-            sub->exclusiveId = exclusiveInfo.groupId[i];
-        } else {
-            sub->exclusiveId = numRepeats;
-        }
     }
 
     ptr = base_ptr + total_size - sizeof(NFA) - byte_length(stale_iter);
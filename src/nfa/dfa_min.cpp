@@ -80,17 +80,18 @@ namespace ue2 {
 
 namespace {
 
-struct hopcroft_state_info {
-    vector<vector<dstate_id_t> > prev;
-};
-
 struct DFA_components : boost::noncopyable {
     dstate_id_t nstates;
     size_t inp_size;
     set<size_t> work_queue;
     /*Partition contains reduced states*/
     partitioned_set<dstate_id_t> partition;
-    vector<hopcroft_state_info> states;
+
+    /* Reverse transition table, flattened: the states which move to state s
+     * on input j are prev[prev_offset[s * inp_size + j]] up to
+     * prev[prev_offset[s * inp_size + j + 1]], in ascending order. */
+    vector<u32> prev_offset;
+    vector<dstate_id_t> prev;
 
     explicit DFA_components(const raw_dfa &rdfa);
 };
@@ -149,17 +150,27 @@ DFA_components::DFA_components(const raw_dfa &rdfa)
                              : nstates(rdfa.states.size()),
                                inp_size(rdfa.states[nstates - 1].next.size()),
                                partition(create_map(rdfa, work_queue)) {
-    /* initializing states */
-    for (size_t i = 0; i < nstates; i++) {
-        states.push_back(hopcroft_state_info());
-        states.back().prev.resize(inp_size);
+    /* Creating X_table: count the predecessors of each (state, input) pair,
+     * then place them. Visiting previous states in order leaves each run
+     * sorted. */
+    prev_offset.assign(nstates * inp_size + 1, 0);
+    for (size_t i = 0; i < nstates; i++) {  // i is the previous state
+        for (size_t j = 0; j < inp_size; j++) {
+            dstate_id_t present_state = rdfa.states[i].next[j];
+            prev_offset[present_state * inp_size + j + 1]++;
+        }
     }
 
-    for (size_t i = 0; i < nstates; i++) {  // i is the previous state
-        for (size_t  j = 0; j < inp_size; j++) {
-            /* Creating X_table */
+    for (size_t k = 1; k < prev_offset.size(); k++) {
+        prev_offset[k] += prev_offset[k - 1];
+    }
+
+    prev.resize(nstates * inp_size);
+    vector<u32> fill(prev_offset.begin(), prev_offset.end() - 1);
+    for (size_t i = 0; i < nstates; i++) {
+        for (size_t j = 0; j < inp_size; j++) {
             dstate_id_t present_state = rdfa.states[i].next[j];
-            states[present_state].prev[j].push_back(i);
+            prev[fill[present_state * inp_size + j]++] = i;
 
             DEBUG_PRINTF("rdfa.states[%zu].next[%zu] %hu \n", i, j,
                          rdfa.states[i].next[j]);
@@ -171,26 +182,34 @@ DFA_components::DFA_components(const raw_dfa &rdfa)
  * choose and remove a set A from work_queue.
  */
 static
-void get_work_item(DFA_components &mdfa, ue2::flat_set<dstate_id_t> &A) {
+void get_work_item(DFA_components &mdfa, vector<dstate_id_t> &A) {
     A.clear();
     assert(!mdfa.work_queue.empty());
     set<size_t>::iterator pt = mdfa.work_queue.begin();
-    insert(&A, mdfa.partition[*pt]);
+    insert(&A, A.end(), mdfa.partition[*pt]);
     mdfa.work_queue.erase(pt);
 }
 
 /**
  * X is the set of states for which a transition on the input leads to a state
- * in A.
+ * in A, returned sorted.
+ *
+ * A state has only one successor on each input, so the predecessor runs of
+ * the members of A are disjoint and X needs no deduplication.
  */
 static
-void create_X(const DFA_components &mdfa, const ue2::flat_set<dstate_id_t> &A,
-              size_t inp, ue2::flat_set<dstate_id_t> &X) {
+void create_X(const DFA_components &mdfa, const vector<dstate_id_t> &A,
+              size_t inp, vector<dstate_id_t> &X) {
     X.clear();
 
     for (dstate_id_t id : A) {
-        insert(&X, mdfa.states[id].prev[inp]);
+        size_t k = id * mdfa.inp_size + inp;
+        X.insert(X.end(), mdfa.prev.begin() + mdfa.prev_offset[k],
+                 mdfa.prev.begin() + mdfa.prev_offset[k + 1]);
     }
+
+    sort(X.begin(), X.end());
+    assert(adjacent_find(X.begin(), X.end()) == X.end());
 }
 
 /**
@@ -207,7 +226,7 @@ void create_X(const DFA_components &mdfa, const ue2::flat_set<dstate_id_t> &A,
  */
 static
 void split_and_replace_set(const size_t part_index, DFA_components &mdfa,
-                           const ue2::flat_set<dstate_id_t> &splitter) {
+                           const vector<dstate_id_t> &splitter) {
     /* singleton sets cannot be split */
     if (mdfa.partition[part_index].size() == 1) {
         return;
@@ -235,7 +254,7 @@ void split_and_replace_set(const size_t part_index, DFA_components &mdfa,
  */
 static
 void dfa_min(DFA_components &mdfa) {
-    ue2::flat_set<dstate_id_t> A, X;
+    vector<dstate_id_t> A, X;
     vector<size_t> cand_subsets;
 
     while (!mdfa.work_queue.empty()) {
@@ -0,0 +1,612 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief DFA group: container engine running several McClellan DFAs in
+ *                   lockstep over the same data, runtime code.
+ *
+ * The member DFAs are independent, so stepping all of them on each byte gives
+ * the CPU several unrelated transition table loads to overlap, rather than
+ * one dependent load per byte as in a single McClellan scan. There is no
+ * acceleration: a group is only worthwhile when its members are rarely in
+ * accelerable states at the same time.
+ */
+
+#include "config.h"
+
+#include "dfagroup.h"
+
+#include "dfagroup_internal.h"
+#include "mcclellan_internal.h"
+#include "nfa_api.h"
+#include "nfa_api_queue.h"
+#include "nfa_internal.h"
+#include "util/bitutils.h"
+#include "util/simd_utils.h"
+#include "util/unaligned.h"
+#include "ue2common.h"
+
+#include "mcclellan_common_impl.h"
+
+#include <string.h>
+
+/** \brief Per-member scan context, set up on entry to each call. */
+struct group_member {
+    const struct mcclellan *m;
+    const char *succ_table;
+    const char *sherman_base_offset;
+    u32 arb_report;
+    u32 cached_accept_id;
+    u16 cached_accept_state;
+    u16 sherman_limit;
+    u16 accept_limit_8;
+    u8 alpha_shift;
+    u8 wide; /**< 16-bit engine */
+    u8 single; /**< MCCLELLAN_FLAG_SINGLE */
+};
+
+static really_inline
+const struct DfaGroup *getGroup(const struct NFA *n) {
+    assert(n->type == DFA_GROUP_NFA_0);
+    return getImplNfa(n);
+}
+
+static really_inline
+const struct NFA *getMember(const struct DfaGroup *g, u32 i) {
+    assert(i < g->numMembers);
+    const struct NFA *sub
+        = (const struct NFA *)((const char *)g + g->memberOffset[i]);
+    assert(ISALIGNED_CL(sub));
+    assert(isMcClellanType(sub->type));
+    return sub;
+}
+
+static really_inline
+u32 initMembers(const struct DfaGroup *g, struct group_member *mem) {
+    u32 count = g->numMembers;
+    assert(count >= 1 && count <= DFA_GROUP_MAX_MEMBERS);
+    for (u32 i = 0; i < count; i++) {
+        const struct NFA *sub = getMember(g, i);
+        const struct mcclellan *m = getImplNfa(sub);
+        mem[i].m = m;
+        mem[i].succ_table = (const char *)m + sizeof(struct mcclellan);
+        mem[i].sherman_base_offset
+            = (const char *)m - sizeof(struct NFA) + m->sherman_offset;
+        mem[i].arb_report = m->arb_report;
+        mem[i].cached_accept_id = 0;
+        mem[i].cached_accept_state = 0;
+        mem[i].sherman_limit = m->sherman_limit;
+        mem[i].accept_limit_8 = m->accept_limit_8;
+        mem[i].alpha_shift = (u8)m->alphaShift;
+        mem[i].wide = sub->type == MCCLELLAN_NFA_16;
+        mem[i].single = !!(m->flags & MCCLELLAN_FLAG_SINGLE);
+    }
+    return count;
+}
+
+static really_inline
+void loadStates(const struct DfaGroup *g, const struct group_member *mem,
+                u32 count, const char *state, u16 *s) {
+    for (u32 i = 0; i < count; i++) {
+        const char *ptr = state + g->stateOffset[i];
+        if (mem[i].wide) {
+            assert(ISALIGNED_N(ptr, 2));
+            s[i] = *(const u16 *)ptr;
+        } else {
+            s[i] = *(const u8 *)ptr;
+        }
+    }
+}
+
+static really_inline
+void storeStates(const struct DfaGroup *g, const struct group_member *mem,
+                 u32 count, char *state, const u16 *s) {
+    for (u32 i = 0; i < count; i++) {
+        char *ptr = state + g->stateOffset[i];
+        if (mem[i].wide) {
+            assert(ISALIGNED_N(ptr, 2));
+            *(u16 *)ptr = s[i];
+        } else {
+            *(u8 *)ptr = (u8)s[i];
+        }
+    }
+}
+
+static really_inline
+char anyAlive(const u16 *s, u32 count) {
+    u16 live = 0;
+    for (u32 i = 0; i < count; i++) {
+        live |= s[i];
+    }
+    return !!live;
+}
+
+/** \brief True if the (masked) state \a s is an accept state. */
+static really_inline
+char memberInAccept(const struct group_member *mem, u16 s) {
+    if (mem->wide) {
+        return !!get_aux(mem->m, s)->accept;
+    }
+    return s >= mem->accept_limit_8;
+}
+
+/**
+ * \brief Transition from state \a s on byte \a c. For 16-bit members, the
+ * result still carries the ACCEPT_FLAG and ACCEL_FLAG bits.
+ */
+static really_inline
+u16 memberStep(const struct group_member *mem, u16 s, u8 c) {
+    u8 cprime = mem->m->remap[c];
+    u32 as = mem->alpha_shift;
+
+    if (!mem->wide) {
+        const u8 *succ_table = (const u8 *)mem->succ_table;
+        return succ_table[((u32)s << as) + cprime];
+    }
+
+    const u16 *succ_table = (const u16 *)mem->succ_table;
+    assert(ISALIGNED_N(succ_table, 2));
+    if (s < mem->sherman_limit) {
+        assert(s < mem->m->state_count);
+        return doNormal16(mem->m, succ_table, s, cprime, as);
+    }
+
+    const char *sherman_state = findShermanState(mem->m,
+                                                 mem->sherman_base_offset,
+                                                 mem->sherman_limit, s);
+    return doSherman16(sherman_state, cprime, succ_table, as);
+}
+
+static really_inline
+char memberReport(struct group_member *mem, u16 s, u64a loc, char eod,
+                  NfaCallback cb, void *ctxt) {
+    const struct mcclellan *m = mem->m;
+
+    if (!eod && mem->single) {
+        DEBUG_PRINTF("reporting %u\n", mem->arb_report);
+        return cb(0, loc, mem->arb_report, ctxt) == MO_HALT_MATCHING
+                 ? MO_HALT_MATCHING : MO_CONTINUE_MATCHING;
+    }
+
+    if (!eod && s == mem->cached_accept_state) {
+        if (cb(0, loc, mem->cached_accept_id, ctxt) == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING; /* termination requested */
+        }
+
+        return MO_CONTINUE_MATCHING; /* continue execution */
+    }
+
+    const struct mstate_aux *aux = get_aux(m, s);
+    size_t offset = eod ? aux->accept_eod : aux->accept;
+
+    assert(offset);
+    const struct report_list *rl
+        = (const void *)((const char *)m + offset - sizeof(struct NFA));
+    assert(ISALIGNED(rl));
+
+    DEBUG_PRINTF("report list size %u\n", rl->count);
+    u32 count = rl->count;
+
+    if (!eod && count == 1) {
+        mem->cached_accept_state = s;
+        mem->cached_accept_id = rl->report[0];
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        DEBUG_PRINTF("reporting %u\n", rl->report[i]);
+        if (cb(0, loc, rl->report[i], ctxt) == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING; /* termination requested */
+        }
+    }
+
+    return MO_CONTINUE_MATCHING; /* continue execution */
+}
+
+/** \brief Report every member currently in an accept state. */
+static really_inline
+char reportAccepting(struct group_member *mem, u32 count, const u16 *s,
+                     u64a loc, NfaCallback cb, void *ctxt) {
+    for (u32 i = 0; i < count; i++) {
+        if (s[i] && memberInAccept(&mem[i], s[i])) {
+            if (memberReport(&mem[i], s[i], loc, 0, cb, ctxt)
+                == MO_HALT_MATCHING) {
+                return MO_HALT_MATCHING;
+            }
+        }
+    }
+    return MO_CONTINUE_MATCHING;
+}
+
+static really_inline
+char dfaGroupExec_i(struct group_member *mem, u32 count, u16 *s,
+                    const u8 *buf, size_t len, u64a offAdj, NfaCallback cb,
+                    void *ctxt, const u8 **c_final, enum MatchMode mode) {
+    const u8 *c = buf, *c_end = buf + len;
+
+    DEBUG_PRINTF("%u members, len %zu\n", count, len);
+
+    while (c < c_end) {
+        u8 byte = *(c++);
+        u16 live = 0;
+        u32 accepts = 0;
+
+        for (u32 i = 0; i < count; i++) {
+            if (!s[i]) {
+                continue;
+            }
+            u16 next = memberStep(&mem[i], s[i], byte);
+            if (mem[i].wide) {
+                if (next & ACCEPT_FLAG) {
+                    accepts |= 1U << i;
+                }
+                next &= STATE_MASK;
+            } else if (next >= mem[i].accept_limit_8) {
+                accepts |= 1U << i;
+            }
+            s[i] = next;
+            live |= next;
+        }
+
+        if (mode != NO_MATCHES && accepts) {
+            if (mode == STOP_AT_MATCH) {
+                DEBUG_PRINTF("match - pausing\n");
+                *c_final = c - 1;
+                return MO_CONTINUE_MATCHING;
+            }
+
+            u64a loc = (c - 1) - buf + offAdj + 1;
+            while (accepts) {
+                u32 i = findAndClearLSB_32(&accepts);
+                if (memberReport(&mem[i], s[i], loc, 0, cb, ctxt)
+                    == MO_HALT_MATCHING) {
+                    return MO_HALT_MATCHING;
+                }
+            }
+        }
+
+        if (!live) {
+            DEBUG_PRINTF("all members dead\n");
+            break;
+        }
+    }
+
+    if (mode == STOP_AT_MATCH) {
+        *c_final = c_end;
+    }
+
+    return MO_CONTINUE_MATCHING;
+}
+
+static never_inline
+char dfaGroupExec_cb(struct group_member *mem, u32 count, u16 *s,
+                     const u8 *buf, size_t len, u64a offAdj, NfaCallback cb,
+                     void *ctxt, const u8 **final_point) {
+    return dfaGroupExec_i(mem, count, s, buf, len, offAdj, cb, ctxt,
+                          final_point, CALLBACK_OUTPUT);
+}
+
+static never_inline
+char dfaGroupExec_sam(struct group_member *mem, u32 count, u16 *s,
+                      const u8 *buf, size_t len, u64a offAdj, NfaCallback cb,
+                      void *ctxt, const u8 **final_point) {
+    return dfaGroupExec_i(mem, count, s, buf, len, offAdj, cb, ctxt,
+                          final_point, STOP_AT_MATCH);
+}
+
+static never_inline
+char dfaGroupExec_nm(struct group_member *mem, u32 count, u16 *s,
+                     const u8 *buf, size_t len, u64a offAdj, NfaCallback cb,
+                     void *ctxt, const u8 **final_point) {
+    return dfaGroupExec_i(mem, count, s, buf, len, offAdj, cb, ctxt,
+                          final_point, NO_MATCHES);
+}
+
+static really_inline
+char dfaGroupExec_ni(struct group_member *mem, u32 count, u16 *s,
+                     const u8 *buf, size_t len, u64a offAdj, NfaCallback cb,
+                     void *ctxt, const u8 **final_point, enum MatchMode mode) {
+    if (mode == CALLBACK_OUTPUT) {
+        return dfaGroupExec_cb(mem, count, s, buf, len, offAdj, cb, ctxt,
+                               final_point);
+    } else if (mode == STOP_AT_MATCH) {
+        return dfaGroupExec_sam(mem, count, s, buf, len, offAdj, cb, ctxt,
+                                final_point);
+    } else {
+        assert(mode == NO_MATCHES);
+        return dfaGroupExec_nm(mem, count, s, buf, len, offAdj, cb, ctxt,
+                               final_point);
+    }
+}
+
+static really_inline
+char nfaExecDfaGroup0_Q2i(const struct NFA *n, struct mq *q, s64a end,
+                          enum MatchMode mode) {
+    const struct DfaGroup *g = getGroup(n);
+    u64a offset = q->offset;
+    const u8 *buffer = q->buffer;
+    const u8 *hend = q->history + q->hlength;
+    NfaCallback cb = q->cb;
+    void *context = q->context;
+
+    struct group_member mem[DFA_GROUP_MAX_MEMBERS];
+    u16 s[DFA_GROUP_MAX_MEMBERS];
+    u32 count = initMembers(g, mem);
+    loadStates(g, mem, count, q->state, s);
+
+    if (q->report_current) {
+        assert(anyAlive(s, count));
+
+        char rv = reportAccepting(mem, count, s, q_cur_offset(q), cb,
+                                  context);
+        q->report_current = 0;
+
+        if (rv == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING;
+        }
+    }
+
+    s64a sp = q_cur_loc(q);
+    q->cur++;
+
+    const u8 *cur_buf = sp < 0 ? hend : buffer;
+
+    char report = 1;
+    if (mode == CALLBACK_OUTPUT) {
+        /* we are starting inside the history buffer: matches are suppressed */
+        report = !(sp < 0);
+    }
+
+    assert(q->cur);
+    if (mode != NO_MATCHES && q->items[q->cur - 1].location > end) {
+        DEBUG_PRINTF("this is as far as we go\n");
+        q->cur--;
+        q->items[q->cur].type = MQE_START;
+        q->items[q->cur].location = end;
+        storeStates(g, mem, count, q->state, s);
+        return MO_ALIVE;
+    }
+
+    while (1) {
+        assert(q->cur < q->end);
+        s64a ep = q->items[q->cur].location;
+        if (mode != NO_MATCHES) {
+            ep = MIN(ep, end);
+        }
+
+        assert(ep >= sp);
+
+        s64a local_ep = ep;
+        if (sp < 0) {
+            local_ep = MIN(0, ep);
+        }
+
+        /* do main buffer region */
+        const u8 *final_look;
+        if (dfaGroupExec_ni(mem, count, s, cur_buf + sp, local_ep - sp,
+                            offset + sp, cb, context, &final_look,
+                            report ? mode : NO_MATCHES)
+            == MO_HALT_MATCHING) {
+            assert(report);
+            memset(q->state, 0, n->scratchStateSize);
+            return 0;
+        }
+        if (mode == STOP_AT_MATCH && final_look != cur_buf + local_ep) {
+            DEBUG_PRINTF("this is as far as we go\n");
+            assert(q->cur);
+            q->cur--;
+            q->items[q->cur].type = MQE_START;
+            q->items[q->cur].location = final_look - cur_buf + 1; /* due to
+                                                                   * early -1 */
+            storeStates(g, mem, count, q->state, s);
+            return MO_MATCHES_PENDING;
+        }
+
+        assert(q->cur);
+        if (mode != NO_MATCHES && q->items[q->cur].location > end) {
+            DEBUG_PRINTF("this is as far as we go\n");
+            q->cur--;
+            q->items[q->cur].type = MQE_START;
+            q->items[q->cur].location = end;
+            storeStates(g, mem, count, q->state, s);
+            return MO_ALIVE;
+        }
+
+        sp = local_ep;
+
+        if (sp == 0) {
+            cur_buf = buffer;
+            report = 1;
+        }
+
+        if (sp != ep) {
+            continue;
+        }
+
+        switch (q->items[q->cur].type) {
+        case MQE_TOP:
+            for (u32 i = 0; i < count; i++) {
+                assert(sp + offset || !s[i]);
+                if (sp + offset == 0) {
+                    s[i] = mem[i].m->start_anchored;
+                } else {
+                    s[i] = mcclellanEnableStarts(mem[i].m, s[i]);
+                }
+            }
+            break;
+        case MQE_END:
+            storeStates(g, mem, count, q->state, s);
+            q->cur++;
+            return anyAlive(s, count) ? MO_ALIVE : 0;
+        default:
+            assert(!"invalid queue event");
+        }
+
+        q->cur++;
+    }
+}
+
+char nfaExecDfaGroup0_Q(const struct NFA *n, struct mq *q, s64a end) {
+    return nfaExecDfaGroup0_Q2i(n, q, end, CALLBACK_OUTPUT);
+}
+
+char nfaExecDfaGroup0_Q2(const struct NFA *n, struct mq *q, s64a end) {
+    return nfaExecDfaGroup0_Q2i(n, q, end, STOP_AT_MATCH);
+}
+
+char nfaExecDfaGroup0_QR(const struct NFA *n, struct mq *q, ReportID report) {
+    char rv = nfaExecDfaGroup0_Q2i(n, q, 0 /* end */, NO_MATCHES);
+    if (rv && nfaExecDfaGroup0_inAccept(n, report, q)) {
+        return MO_MATCHES_PENDING;
+    } else {
+        return rv;
+    }
+}
+
+char nfaExecDfaGroup0_reportCurrent(const struct NFA *n, struct mq *q) {
+    const struct DfaGroup *g = getGroup(n);
+    struct group_member mem[DFA_GROUP_MAX_MEMBERS];
+    u16 s[DFA_GROUP_MAX_MEMBERS];
+    u32 count = initMembers(g, mem);
+    loadStates(g, mem, count, q->state, s);
+    assert(q_cur_type(q) == MQE_START);
+
+    reportAccepting(mem, count, s, q_cur_offset(q), q->cb, q->context);
+    return 0;
+}
+
+char nfaExecDfaGroup0_inAccept(const struct NFA *n, ReportID report,
+                               struct mq *q) {
+    assert(n && q);
+
+    const struct DfaGroup *g = getGroup(n);
+    struct group_member mem[DFA_GROUP_MAX_MEMBERS];
+    u16 s[DFA_GROUP_MAX_MEMBERS];
+    u32 count = initMembers(g, mem);
+    loadStates(g, mem, count, q->state, s);
+
+    for (u32 i = 0; i < count; i++) {
+        if (!s[i] || !memberInAccept(&mem[i], s[i])) {
+            continue;
+        }
+
+        const struct mcclellan *m = mem[i].m;
+        const struct report_list *rl = (const struct report_list *)
+            ((const char *)m + get_aux(m, s[i])->accept - sizeof(struct NFA));
+        assert(ISALIGNED_N(rl, 4));
+        for (u32 j = 0; j < rl->count; j++) {
+            if (rl->report[j] == report) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+char nfaExecDfaGroup0_inAnyAccept(const struct NFA *n, struct mq *q) {
+    assert(n && q);
+
+    const struct DfaGroup *g = getGroup(n);
+    struct group_member mem[DFA_GROUP_MAX_MEMBERS];
+    u16 s[DFA_GROUP_MAX_MEMBERS];
+    u32 count = initMembers(g, mem);
+    loadStates(g, mem, count, q->state, s);
+
+    for (u32 i = 0; i < count; i++) {
+        if (s[i] && memberInAccept(&mem[i], s[i])) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+char nfaExecDfaGroup0_testEOD(const struct NFA *n, const char *state,
+                              UNUSED const char *streamState, u64a offset,
+                              NfaCallback callback, void *context) {
+    const struct DfaGroup *g = getGroup(n);
+    struct group_member mem[DFA_GROUP_MAX_MEMBERS];
+    u16 s[DFA_GROUP_MAX_MEMBERS];
+    u32 count = initMembers(g, mem);
+    loadStates(g, mem, count, state, s);
+
+    for (u32 i = 0; i < count; i++) {
+        if (!get_aux(mem[i].m, s[i])->accept_eod) {
+            continue;
+        }
+        if (memberReport(&mem[i], s[i], offset, 1, callback, context)
+            == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING;
+        }
+    }
+
+    return MO_CONTINUE_MATCHING;
+}
+
+char nfaExecDfaGroup0_queueInitState(const struct NFA *n, struct mq *q) {
+    assert(ISALIGNED_N(q->state, 2));
+    memset(q->state, 0, n->scratchStateSize);
+    return 0;
+}
+
+char nfaExecDfaGroup0_initCompressedState(const struct NFA *n, u64a offset,
+                                          void *state, UNUSED u8 key) {
+    const struct DfaGroup *g = getGroup(n);
+    char alive = 0;
+
+    for (u32 i = 0; i < g->numMembers; i++) {
+        const struct NFA *sub = getMember(g, i);
+        const struct mcclellan *m = getImplNfa(sub);
+        u16 s = offset ? m->start_floating : m->start_anchored;
+        char *ptr = (char *)state + g->stateOffset[i];
+        if (sub->type == MCCLELLAN_NFA_16) {
+            unaligned_store_u16(ptr, s);
+        } else {
+            *(u8 *)ptr = (u8)s;
+        }
+        alive |= !!s;
+    }
+
+    return alive;
+}
+
+char nfaExecDfaGroup0_queueCompressState(const struct NFA *n,
+                                         const struct mq *q, UNUSED s64a loc) {
+    /* stream state and scratch state share a layout */
+    assert(n->streamStateSize == n->scratchStateSize);
+    memcpy(q->streamState, q->state, n->streamStateSize);
+    return 0;
+}
+
+char nfaExecDfaGroup0_expandState(const struct NFA *n, void *dest,
+                                  const void *src, UNUSED u64a offset,
+                                  UNUSED u8 key) {
+    assert(n->streamStateSize == n->scratchStateSize);
+    memcpy(dest, src, n->streamStateSize);
+    return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief DFA group: container engine running several McClellan DFAs in
+ *                   lockstep over the same data, dump code.
+ */
+
+#include "config.h"
+
+#include "dfagroup_dump.h"
+
+#include "dfagroup_internal.h"
+#include "nfa_dump_api.h"
+#include "nfa_dump_internal.h"
+#include "nfa_internal.h"
+
+#include <string>
+#include <sstream>
+
+#ifndef DUMP_SUPPORT
+#error No dump support!
+#endif
+
+namespace ue2 {
+
+static
+const NFA *getMember(const DfaGroup *g, u32 i) {
+    return (const NFA *)((const char *)g + g->memberOffset[i]);
+}
+
+void nfaExecDfaGroup0_dumpDot(const struct NFA *nfa, UNUSED FILE *f,
+                              const std::string &base) {
+    const DfaGroup *g = (const DfaGroup *)getImplNfa(nfa);
+    for (u32 i = 0; i < g->numMembers; i++) {
+        std::stringstream ssdot;
+        ssdot << base << "rose_nfa_" << nfa->queueIndex
+            << "_member_" << i << ".dot";
+        FILE *f1 = fopen(ssdot.str().c_str(), "w");
+        nfaDumpDot(getMember(g, i), f1, base);
+        fclose(f1);
+    }
+}
+
+void nfaExecDfaGroup0_dumpText(const struct NFA *nfa, FILE *f) {
+    const DfaGroup *g = (const DfaGroup *)getImplNfa(nfa);
+
+    fprintf(f, "DFA group container engine\n");
+    fprintf(f, "\n");
+    fprintf(f, "Number of members:  %u\n", g->numMembers);
+
+    fprintf(f, "\n");
+    dumpTextReverse(nfa, f);
+    fprintf(f, "\n");
+
+    for (u32 i = 0; i < g->numMembers; i++) {
+        fprintf(f, "Member %u (state offset %u):\n", i, g->stateOffset[i]);
+        nfaDumpText(getMember(g, i), f);
+        fprintf(f, "\n");
+    }
+}
+
+} // namespace ue2
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief DFA group: container engine running several McClellan DFAs in
+ *                   lockstep over the same data, data structures.
+ */
+
+/* DFA group bytecode layout:
+ * * |-----|
+ * * |     | struct NFA
+ * * |-----|
+ * * |     | struct DfaGroup
+ * * |     |
+ * * |-----|
+ * * ||--| | member 0 (struct NFA + rest of McClellan engine)
+ * * ||  | |
+ * * ||--| |
+ * * |     |
+ * * ||--| | member 1 (struct NFA + rest of McClellan engine)
+ * * ||  | |
+ * * ||--| |
+ * * ...
+ * * |-----| total size of DFA group
+ * *
+ * * Stream state and scratch state have the same layout: the state of each
+ * * member is stored at DfaGroup::stateOffset. 16-bit members come first so
+ * * that their state is 2-byte aligned in scratch.
+ * */
+
+#ifndef NFA_DFAGROUP_INTERNAL_H
+#define NFA_DFAGROUP_INTERNAL_H
+
+#include "ue2common.h"
+
+/** \brief Maximum number of DFAs in a group. */
+#define DFA_GROUP_MAX_MEMBERS 4
+
+struct DfaGroup {
+    u32 numMembers;
+    u32 memberOffset[DFA_GROUP_MAX_MEMBERS]; /**< offset from the start of
+                                              * struct DfaGroup to the member
+                                              * engine */
+    u32 stateOffset[DFA_GROUP_MAX_MEMBERS]; /**< offset of the member's state
+                                             * in the group state */
+};
+
+#endif // NFA_DFAGROUP_INTERNAL_H
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief DFA group: container engine running several McClellan DFAs in
+ *                   lockstep over the same data, compiler code.
+ */
+
+#include "config.h"
+
+#include "dfagroupcompile.h"
+
+#include "dfagroup_internal.h"
+#include "nfa_internal.h"
+#include "util/verify_types.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace ue2 {
+
+aligned_unique_ptr<NFA> buildDfaGroup(const vector<const NFA *> &members) {
+    assert(members.size() >= 2);
+    assert(members.size() <= DFA_GROUP_MAX_MEMBERS);
+
+    for (const NFA *sub : members) {
+        if (!isMcClellanType(sub->type)) {
+            DEBUG_PRINTF("member of type %u is not a McClellan DFA\n",
+                         sub->type);
+            return nullptr;
+        }
+    }
+
+    // 16-bit members go first, so that their state is 2-byte aligned.
+    vector<const NFA *> order(members);
+    stable_partition(order.begin(), order.end(), [](const NFA *sub) {
+        return sub->type == MCCLELLAN_NFA_16;
+    });
+
+    size_t total_size = sizeof(NFA) + ROUNDUP_CL(sizeof(DfaGroup));
+    for (const NFA *sub : order) {
+        total_size += ROUNDUP_CL(sub->length);
+    }
+
+    aligned_unique_ptr<NFA> nfa = aligned_zmalloc_unique<NFA>(total_size);
+    nfa->type = verify_u8(DFA_GROUP_NFA_0);
+    nfa->length = verify_u32(total_size);
+
+    char *base = (char *)nfa.get() + sizeof(NFA);
+    DfaGroup *g = (DfaGroup *)base;
+    g->numMembers = verify_u32(order.size());
+
+    char *sub_ptr = base + ROUNDUP_CL(sizeof(DfaGroup));
+    u32 state_size = 0;
+    bool infinite_max_width = false;
+    bool infinite_max_offset = false;
+    nfa->minWidth = ~0U;
+
+    for (size_t i = 0; i < order.size(); i++) {
+        const NFA *sub = order[i];
+        assert(sub->streamStateSize == sub->scratchStateSize);
+
+        memcpy(sub_ptr, sub, sub->length);
+        g->memberOffset[i] = verify_u32(sub_ptr - base);
+        g->stateOffset[i] = state_size;
+        DEBUG_PRINTF("member %zu: type %u at %u, state at %u\n", i, sub->type,
+                     g->memberOffset[i], g->stateOffset[i]);
+        sub_ptr += ROUNDUP_CL(sub->length);
+        state_size += sub->scratchStateSize;
+
+        // update nfa properties
+        nfa->flags |= sub->flags;
+        nfa->nPositions += sub->nPositions;
+        nfa->minWidth = min(nfa->minWidth, sub->minWidth);
+        if (!sub->maxWidth) {
+            infinite_max_width = true;
+        } else if (!infinite_max_width) {
+            nfa->maxWidth = max(nfa->maxWidth, sub->maxWidth);
+        }
+        if (!sub->maxOffset) {
+            infinite_max_offset = true;
+        } else if (!infinite_max_offset) {
+            nfa->maxOffset = max(nfa->maxOffset, sub->maxOffset);
+        }
+    }
+
+    if (infinite_max_width) {
+        nfa->maxWidth = 0;
+    }
+    if (infinite_max_offset) {
+        nfa->maxOffset = 0;
+    }
+    nfa->streamStateSize = state_size;
+    nfa->scratchStateSize = state_size;
+
+    assert((size_t)(sub_ptr - (char *)nfa.get()) == total_size);
+    return nfa;
+}
+
+} // namespace ue2
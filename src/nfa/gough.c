@@ -179,12 +179,77 @@ const char *dump_op(u8 op) {
         return "NEW";
     case GOUGH_INS_MIN:
         return "MIN";
+    case GOUGH_INS_VEC:
+        return "VEC";
     default:
         return "???";
     }
 }
 #endif
 
+#if defined(__AVX2__)
+/* unsigned 64-bit min */
+static really_inline
+m256 min_u64_m256(m256 a, m256 b) {
+    const m256 bias = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    m256 gt = _mm256_cmpgt_epi64(xor256(a, bias), xor256(b, bias));
+    return _mm256_blendv_epi8(a, b, gt);
+}
+
+#define VEC_TAKE_SLOT(j)                                                       \
+    do {                                                                       \
+        const m256 bit = _mm256_set1_epi64x(1LL << (j));                       \
+        m256 sel = _mm256_cmpeq_epi64(and256(masks, bit), bit);                \
+        m256 v = _mm256_permute4x64_epi64(old, (j) * 0x55);                    \
+        rv = min_u64_m256(rv, _mm256_blendv_epi8(ones, v, sel));               \
+    } while (0)
+#endif
+
+/* Values are held one higher while running a GOUGH_INS_VEC program, so that
+ * GOUGH_SOM_EARLY becomes zero and a plain unsigned min does the right thing.
+ */
+static really_inline
+void run_vec_prog(const struct gough_vec_ins *vi, u64a som_offset,
+                  struct gough_som_info *som) {
+#if defined(__AVX2__)
+    const m256 one = _mm256_set1_epi64x(1);
+    const m256 ones = ones256();
+    const m256 old = _mm256_add_epi64(loadu256(som->slots), one);
+    const m256 masks = _mm256_cvtepu8_epi64(
+                        _mm_cvtsi32_si128((int)unaligned_load_u32(vi->src_mask)));
+    const m256 adj = _mm256_cvtepu32_epi64(loadu128(vi->new_adjust));
+    const m256 no_new = _mm256_cmpeq_epi64(adj,
+                                        _mm256_set1_epi64x(GOUGH_VEC_NO_NEW));
+
+    m256 rv = or256(_mm256_sub_epi64(_mm256_set1_epi64x(som_offset + 1), adj),
+                    no_new);
+    VEC_TAKE_SLOT(0);
+    VEC_TAKE_SLOT(1);
+    VEC_TAKE_SLOT(2);
+    VEC_TAKE_SLOT(3);
+    _mm256_storeu_si256((m256 *)som->slots, _mm256_sub_epi64(rv, one));
+#else
+    u64a old[GOUGH_VEC_SLOTS];
+    for (u32 i = 0; i < GOUGH_VEC_SLOTS; i++) {
+        old[i] = som->slots[i] + 1;
+    }
+
+    for (u32 i = 0; i < GOUGH_VEC_SLOTS; i++) {
+        u64a v = ~0ULL;
+        if (vi->new_adjust[i] != GOUGH_VEC_NO_NEW) {
+            assert(som_offset >= vi->new_adjust[i]);
+            v = som_offset + 1 - vi->new_adjust[i];
+        }
+        for (u32 j = 0; j < GOUGH_VEC_SLOTS; j++) {
+            if (vi->src_mask[i] & (1U << j)) {
+                v = MIN(v, old[j]);
+            }
+        }
+        som->slots[i] = v - 1;
+    }
+#endif
+}
+
 static really_inline
 void run_prog_i(UNUSED const struct NFA *nfa,
                 const struct gough_ins *pc, u64a som_offset,
@@ -195,12 +260,16 @@ void run_prog_i(UNUSED const struct NFA *nfa,
         assert((const u8 *)pc < (const u8 *)nfa + nfa->length);
         u32 dest = pc->dest;
         u32 src = pc->src;
-        assert(pc->op == GOUGH_INS_END
+        assert(pc->op == GOUGH_INS_END || pc->op == GOUGH_INS_VEC
                || dest < (nfa->scratchStateSize - 16) / 8);
         DEBUG_PRINTF("%s %u %u\n", dump_op(pc->op), dest, src);
         switch (pc->op) {
         case GOUGH_INS_END:
             return;
+        case GOUGH_INS_VEC:
+            assert((nfa->scratchStateSize - 16) / 8 >= GOUGH_VEC_SLOTS);
+            run_vec_prog((const struct gough_vec_ins *)pc, som_offset, som);
+            return; /* always the whole program */
         case GOUGH_INS_MOV:
             som->slots[dest] = som->slots[src];
             break;
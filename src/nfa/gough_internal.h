@@ -39,6 +39,7 @@
 #define GOUGH_INS_MOV 1
 #define GOUGH_INS_NEW 2
 #define GOUGH_INS_MIN 3
+#define GOUGH_INS_VEC 4 /* whole program in parallel form, see gough_vec_ins */
 /* todo: add instructions targeting acc reg? */
 
 struct gough_ins {
@@ -48,6 +49,28 @@ struct gough_ins {
               * current offset */
 };
 
+/** \brief Max slots in an engine for its programs to use GOUGH_INS_VEC. */
+#define GOUGH_VEC_SLOTS 4
+
+/** \brief Value of gough_vec_ins::new_adjust for a slot with no new som. */
+#define GOUGH_VEC_NO_NEW (~0U)
+
+/* Parallel form of an entire program for engines with no more than
+ * GOUGH_VEC_SLOTS slots: the MOV/NEW/MIN sequence is folded at compile time so
+ * that each slot becomes the min of a set of the old slots and (optionally) a
+ * new som at the current offset less an adjustment. This lets the runtime
+ * update the whole slot file with a few vector ops rather than interpreting
+ * the program one instruction at a time.
+ *
+ * Occupies the space of two gough_ins and is always followed by
+ * GOUGH_INS_END. */
+struct gough_vec_ins {
+    u32 op; /* GOUGH_INS_VEC */
+    u8 src_mask[GOUGH_VEC_SLOTS]; /* old slots to take the min of */
+    u32 new_adjust[GOUGH_VEC_SLOTS]; /* adjustment for new som, or
+                                      * GOUGH_VEC_NO_NEW */
+};
+
 /*
  * HAPPY FUN ASCII ART TIME
  *
@@ -984,6 +984,60 @@ void copy_in_blocks(raw_som_dfa &raw, u8 alphaShift, const GoughGraph &cfg,
     }
 }
 
+/**
+ * \brief Folds a program over no more than GOUGH_VEC_SLOTS slots into a single
+ * GOUGH_INS_VEC instruction, which updates every slot in parallel.
+ */
+static
+vector<gough_ins> make_vec_prog(const vector<gough_ins> &block) {
+    static_assert(sizeof(gough_vec_ins) % sizeof(gough_ins) == 0,
+                  "vec ins must be a whole number of ins");
+
+    gough_vec_ins vi;
+    memset(&vi, 0, sizeof(vi));
+    vi.op = GOUGH_INS_VEC;
+    for (u32 i = 0; i < GOUGH_VEC_SLOTS; i++) {
+        vi.src_mask[i] = 1U << i;
+        vi.new_adjust[i] = GOUGH_VEC_NO_NEW;
+    }
+
+    for (const gough_ins &ins : block) {
+        u32 d = ins.dest;
+        u32 s = ins.src;
+        switch (ins.op) {
+        case GOUGH_INS_END:
+            break;
+        case GOUGH_INS_MOV:
+            assert(d < GOUGH_VEC_SLOTS && s < GOUGH_VEC_SLOTS);
+            vi.src_mask[d] = vi.src_mask[s];
+            vi.new_adjust[d] = vi.new_adjust[s];
+            break;
+        case GOUGH_INS_NEW:
+            assert(d < GOUGH_VEC_SLOTS && s != GOUGH_VEC_NO_NEW);
+            vi.src_mask[d] = 0;
+            vi.new_adjust[d] = s;
+            break;
+        case GOUGH_INS_MIN:
+            assert(d < GOUGH_VEC_SLOTS && s < GOUGH_VEC_SLOTS);
+            vi.src_mask[d] |= vi.src_mask[s];
+            /* the earliest new som is the one with the largest adjustment */
+            if (vi.new_adjust[d] == GOUGH_VEC_NO_NEW) {
+                vi.new_adjust[d] = vi.new_adjust[s];
+            } else if (vi.new_adjust[s] != GOUGH_VEC_NO_NEW) {
+                ENSURE_AT_LEAST(&vi.new_adjust[d], vi.new_adjust[s]);
+            }
+            break;
+        default:
+            assert(0);
+        }
+    }
+
+    vector<gough_ins> out(sizeof(vi) / sizeof(gough_ins));
+    memcpy(&out[0], &vi, sizeof(vi));
+    out.push_back(make_gough_ins(GOUGH_INS_END));
+    return out;
+}
+
 bool find_normal_self_loop(GoughVertex v, const GoughGraph &g, GoughEdge *out) {
     for (const auto &e : out_edges_range(v, g)) {
         if (target(e, g) != v) {
@@ -1077,6 +1131,16 @@ aligned_unique_ptr<NFA> goughCompile(raw_som_dfa &raw, u8 somPrecision,
         return nullptr;
     }
 
+    if (cc.grey.goughVectorPrograms
+        && scratch_slot_count <= GOUGH_VEC_SLOTS) {
+        DEBUG_PRINTF("using parallel programs\n");
+        for (vector<gough_ins> &block : blocks | map_values) {
+            block = make_vec_prog(block);
+        }
+        /* vec programs always update the full set of slots */
+        scratch_slot_count = GOUGH_VEC_SLOTS;
+    }
+
     u8 alphaShift
         = ((const mcclellan *)getImplNfa(basic_dfa.get()))->alphaShift;
     u32 edge_count = (1U << alphaShift) * raw.states.size();
@@ -1158,6 +1222,8 @@ AccelScheme gough_build_strat::find_escape_strings(dstate_id_t this_idx) const {
     }
 
     rv = mcclellan_build_strat::find_escape_strings(this_idx);
+    rv.dist = 0; /* only single and double byte schemes are supported */
+    rv.literals.clear();
 
     assert(!rv.offset || rv.cr.all()); /* should have been limited by strat */
     if (rv.offset) {
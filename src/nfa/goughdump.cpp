@@ -179,6 +179,19 @@ void dump_program(FILE *f, const pair<u32, u32> &e, const gough_ins *prog) {
         case GOUGH_INS_MIN:
             fprintf(f, "MIN %u %u", d, s);
             break;
+        case GOUGH_INS_VEC: {
+            const gough_vec_ins *vi = (const gough_vec_ins *)it;
+            fprintf(f, "VEC");
+            for (u32 i = 0; i < GOUGH_VEC_SLOTS; i++) {
+                fprintf(f, " [%u: mask=0x%x", i, vi->src_mask[i]);
+                if (vi->new_adjust[i] != GOUGH_VEC_NO_NEW) {
+                    fprintf(f, " new-%u", vi->new_adjust[i]);
+                }
+                fprintf(f, "]");
+            }
+            it += sizeof(*vi) / sizeof(*it) - 1;
+            break;
+        }
         default:
             fprintf(f, "<UNKNOWN>");
             fprintf(f, "\n");
@@ -40,6 +40,7 @@
 #include "shufti.h"
 #include "truffle.h"
 #include "vermicelli.h"
+#include "scratch.h"
 #include "util/partial_store.h"
 #include "util/unaligned.h"
 
@@ -90,6 +91,7 @@ void clearRepeat(const struct RepeatInfo *info, struct lbr_state *lstate) {
         lstate->ctrl.ring.offset = REPEAT_DEAD;
         break;
     case REPEAT_RANGE:
+    case REPEAT_DELTA:
         lstate->ctrl.range.offset = REPEAT_DEAD;
         break;
     case REPEAT_FIRST:
@@ -120,6 +122,7 @@ char repeatIsDead(const struct RepeatInfo *info,
     case REPEAT_RING:
         return lstate->ctrl.ring.offset == REPEAT_DEAD;
     case REPEAT_RANGE:
+    case REPEAT_DELTA:
         return lstate->ctrl.range.offset == REPEAT_DEAD;
     case REPEAT_FIRST:
     case REPEAT_LAST:
@@ -514,6 +517,41 @@ char lbrFwdScanTruf(const struct NFA *nfa, const u8 *buf,
     return 1;
 }
 
+/** \brief Returns the scratch escape cache slot used by this engine, or NULL
+ * if it does not share its escape scans. */
+static really_inline
+struct lbr_escape_cache *lbrEscapeCache(const struct lbr_common *l,
+                                        const struct mq *q) {
+    if (l->escapeClass == LBR_NO_ESCAPE_CLASS || !q->scratch) {
+        return NULL;
+    }
+    return &q->scratch->lbr_escape[l->escapeClass % LBR_ESCAPE_CACHE_SIZE];
+}
+
+/** \brief True if the cache entry holds a scan of this engine's escapes over
+ * the queue's buffer, starting at or before \p begin, made during the current
+ * scan call. */
+static really_inline
+char lbrEscapeCacheValid(const struct lbr_escape_cache *ec,
+                         const struct lbr_common *l, const struct mq *q,
+                         size_t begin) {
+    return ec->gen == q->scratch->lbr_escape_gen &&
+           ec->escapeClass == l->escapeClass && ec->buf == q->buffer &&
+           ec->begin <= begin && begin <= ec->end;
+}
+
+static really_inline
+void lbrEscapeCacheStore(struct lbr_escape_cache *ec,
+                         const struct lbr_common *l, const struct mq *q,
+                         size_t begin, size_t end, char found) {
+    ec->gen = q->scratch->lbr_escape_gen;
+    ec->escapeClass = l->escapeClass;
+    ec->buf = q->buffer;
+    ec->begin = begin;
+    ec->end = end;
+    ec->found = found;
+}
+
 #define ENGINE_ROOT_NAME Dot
 #include "lbr_common_impl.h"
 
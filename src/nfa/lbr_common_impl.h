@@ -36,6 +36,52 @@
 #define EXEC_FN JOIN(lbrExec, ENGINE_ROOT_NAME)
 #define FWDSCAN_FN JOIN(lbrFwdScan, ENGINE_ROOT_NAME)
 #define REVSCAN_FN JOIN(lbrRevScan, ENGINE_ROOT_NAME)
+#define SHARED_FWDSCAN_FN JOIN(lbrSharedFwdScan, ENGINE_ROOT_NAME)
+
+/** \brief Forward escape scan over [begin, end) of the queue's buffer.
+ *
+ * Every LBR engine with the same escapes scans the same bytes of the same
+ * buffer, so the result of each scan is recorded in scratch and reused by the
+ * other engines of the escape class rather than being recomputed. */
+static really_inline
+char SHARED_FWDSCAN_FN(const struct NFA *nfa, const struct mq *q,
+                       size_t begin, size_t end, size_t *loc) {
+    assert(begin <= end);
+    const struct lbr_common *l = getImplNfa(nfa);
+    struct lbr_escape_cache *ec = lbrEscapeCache(l, q);
+    if (!ec) {
+        return FWDSCAN_FN(nfa, q->buffer, begin, end, loc);
+    }
+
+    if (lbrEscapeCacheValid(ec, l, q, begin)) {
+        if (ec->found) {
+            size_t eloc = ec->end - 1;
+            if (eloc >= begin) {
+                DEBUG_PRINTF("cached escape at %zu\n", eloc);
+                if (eloc < end) {
+                    *loc = eloc;
+                    return 1;
+                }
+                return 0;
+            }
+            // The cached escape is behind us: fall through and rescan.
+        } else {
+            if (end <= ec->end) {
+                DEBUG_PRINTF("no escapes in cached region\n");
+                return 0;
+            }
+            // Only the bytes beyond the cached region need scanning.
+            char found = FWDSCAN_FN(nfa, q->buffer, ec->end, end, loc);
+            ec->end = found ? *loc + 1 : end;
+            ec->found = found;
+            return found;
+        }
+    }
+
+    char found = FWDSCAN_FN(nfa, q->buffer, begin, end, loc);
+    lbrEscapeCacheStore(ec, l, q, begin, found ? *loc + 1 : end, found);
+    return found;
+}
 
 char JOIN(ENGINE_EXEC_NAME, _queueCompressState)(const struct NFA *nfa,
                                                  const struct mq *q, s64a loc) {
@@ -250,7 +296,8 @@ char JOIN(ENGINE_EXEC_NAME, _Q_i)(const struct NFA *nfa, struct mq *q,
             char escape_found = 0;
             DEBUG_PRINTF("scanning from sp=%llu to ep=%llu\n", sp, ep);
             assert(sp >= q->offset && ep >= q->offset);
-            if (FWDSCAN_FN(nfa, q->buffer, sp - q->offset, ep - q->offset, &eloc)) {
+            if (SHARED_FWDSCAN_FN(nfa, q, sp - q->offset, ep - q->offset,
+                                  &eloc)) {
                 escape_found = 1;
                 ep = q->offset + eloc;
                 DEBUG_PRINTF("escape found at %llu\n", ep);
@@ -459,4 +506,5 @@ scan_done:
 #undef EXEC_FN
 #undef FWDSCAN_FN
 #undef REVSCAN_FN
+#undef SHARED_FWDSCAN_FN
 #undef ENGINE_ROOT_NAME
@@ -84,6 +84,9 @@ void lbrDumpCommon(const lbr_common *lc, FILE *f) {
     fprintf(f, "repeat bounds: {%u, %u}\n", info->repeatMin,
             info->repeatMax);
     fprintf(f, "report id:     %u\n", lc->report);
+    if (lc->escapeClass != LBR_NO_ESCAPE_CLASS) {
+        fprintf(f, "escape class:  %u\n", lc->escapeClass);
+    }
     fprintf(f, "\n");
     fprintf(f, "min period: %u\n", info->minPeriod);
 }
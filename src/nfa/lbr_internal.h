@@ -40,11 +40,18 @@ extern "C"
 
 #include "repeat_internal.h"
 
+/** \brief Value of lbr_common::escapeClass for engines that do not share
+ * their escape scans with other engines. */
+#define LBR_NO_ESCAPE_CLASS 0xffffffffU
+
 /** \brief Common LBR header. */
 struct lbr_common {
     u32 repeatInfoOffset;   //!< offset of RepeatInfo structure relative
                             //   to the start of lbr_common
     ReportID report;        //!< report to raise on match
+    u32 escapeClass;        //!< engines with identical escapes in the same
+                            //   Rose engine share a class, and thus the
+                            //   results of their escape scans
 };
 
 struct lbr_dot {
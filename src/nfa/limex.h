@@ -77,10 +77,12 @@ extern "C"
     GENERATE_NFA_DUMP_DECL(gf_name)
 
 GENERATE_NFA_DECL(nfaExecLimEx32)
+GENERATE_NFA_DECL(nfaExecLimEx64)
 GENERATE_NFA_DECL(nfaExecLimEx128)
 GENERATE_NFA_DECL(nfaExecLimEx256)
 GENERATE_NFA_DECL(nfaExecLimEx384)
 GENERATE_NFA_DECL(nfaExecLimEx512)
+GENERATE_NFA_DECL(nfaExecLimEx1024)
 
 #undef GENERATE_NFA_DECL
 #undef GENERATE_NFA_DUMP_DECL
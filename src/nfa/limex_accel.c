@@ -82,6 +82,13 @@ size_t doAccel32(u32 s, u32 accel, const u8 *accelTable,
     return accelScanWrapper(accelTable, aux, input, idx, i, end);
 }
 
+size_t doAccel64(u64a s, u64a accel, const u8 *accelTable,
+                 const union AccelAux *aux, const u8 *input, size_t i,
+                 size_t end) {
+    u32 idx = packedExtract64(s, accel);
+    return accelScanWrapper(accelTable, aux, input, idx, i, end);
+}
+
 size_t doAccel128(const m128 *state, const struct LimExNFA128 *limex,
                   const u8 *accelTable, const union AccelAux *aux,
                   const u8 *input, size_t i, size_t end) {
@@ -129,15 +136,12 @@ size_t doAccel384(const m384 *state, const struct LimExNFA384 *limex,
     return accelScanWrapper(accelTable, aux, input, idx, i, end);
 }
 
-size_t doAccel512(const m512 *state, const struct LimExNFA512 *limex,
-                  const u8 *accelTable, const union AccelAux *aux,
-                  const u8 *input, size_t i, size_t end) {
+static really_inline
+u32 accelIndex512(m512 s, m512 accelPerm, m512 accelComp) {
     u32 idx;
-    m512 s = *state;
-    DEBUG_PRINTF("using PSHUFB for 512-bit shuffle\n");
-    m512 accelPerm = limex->accelPermute;
-    m512 accelComp = limex->accelCompare;
-#if !defined(__AVX2__)
+#if defined(__AVX512BW__)
+    idx = packedExtract512(s, accelPerm, accelComp);
+#elif !defined(__AVX2__)
     u32 idx1 = packedExtract128(s.lo.lo, accelPerm.lo.lo, accelComp.lo.lo);
     u32 idx2 = packedExtract128(s.lo.hi, accelPerm.lo.hi, accelComp.lo.hi);
     u32 idx3 = packedExtract128(s.hi.lo, accelPerm.hi.lo, accelComp.hi.lo);
@@ -150,5 +154,32 @@ size_t doAccel512(const m512 *state, const struct LimExNFA512 *limex,
     assert((idx1 & idx2) == 0); // should be no shared bits
     idx = idx1 | idx2;
 #endif
+    return idx;
+}
+
+size_t doAccel512(const m512 *state, const struct LimExNFA512 *limex,
+                  const u8 *accelTable, const union AccelAux *aux,
+                  const u8 *input, size_t i, size_t end) {
+    u32 idx;
+    m512 s = *state;
+    DEBUG_PRINTF("using PSHUFB for 512-bit shuffle\n");
+    m512 accelPerm = limex->accelPermute;
+    m512 accelComp = limex->accelCompare;
+    idx = accelIndex512(s, accelPerm, accelComp);
+    return accelScanWrapper(accelTable, aux, input, idx, i, end);
+}
+
+size_t doAccel1024(const m1024 *state, const struct LimExNFA1024 *limex,
+                   const u8 *accelTable, const union AccelAux *aux,
+                   const u8 *input, size_t i, size_t end) {
+    u32 idx;
+    m1024 s = *state;
+    DEBUG_PRINTF("using PSHUFB for 1024-bit shuffle\n");
+    m1024 accelPerm = limex->accelPermute;
+    m1024 accelComp = limex->accelCompare;
+    u32 idx1 = accelIndex512(s.lo, accelPerm.lo, accelComp.lo);
+    u32 idx2 = accelIndex512(s.hi, accelPerm.hi, accelComp.hi);
+    assert((idx1 & idx2) == 0); // should be no shared bits
+    idx = idx1 | idx2;
     return accelScanWrapper(accelTable, aux, input, idx, i, end);
 }
@@ -44,11 +44,16 @@ struct LimExNFA128;
 struct LimExNFA256;
 struct LimExNFA384;
 struct LimExNFA512;
+struct LimExNFA1024;
 
 size_t doAccel32(u32 s, u32 accel, const u8 *accelTable,
                  const union AccelAux *aux, const u8 *input, size_t i,
                  size_t end);
 
+size_t doAccel64(u64a s, u64a accel, const u8 *accelTable,
+                 const union AccelAux *aux, const u8 *input, size_t i,
+                 size_t end);
+
 size_t doAccel128(const m128 *s, const struct LimExNFA128 *limex,
                   const u8 *accelTable, const union AccelAux *aux,
                   const u8 *input, size_t i, size_t end);
@@ -65,4 +70,8 @@ size_t doAccel512(const m512 *s, const struct LimExNFA512 *limex,
                   const u8 *accelTable, const union AccelAux *aux,
                   const u8 *input, size_t i, size_t end);
 
+size_t doAccel1024(const m1024 *s, const struct LimExNFA1024 *limex,
+                   const u8 *accelTable, const union AccelAux *aux,
+                   const u8 *input, size_t i, size_t end);
+
 #endif
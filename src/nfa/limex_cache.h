@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Lazy DFA cache for LimEx NFAs.
+ *
+ * LimEx NFAs built with LIMEX_FLAG_LAZY_DFA intern the state vectors they
+ * reach during scanning into this cache, which lives in scratch. Each interned
+ * state records its successors (before reach is applied) and, as they are
+ * discovered, the index of the state reached on each reach class, so that
+ * runs of input in cached states are scanned like a DFA.
+ *
+ * Only state vectors with no complex exceptions (triggers or reports) and no
+ * accept states are interned, as their transitions have no side effects. When
+ * the cache fills up, it is flushed and starts again.
+ */
+
+#ifndef LIMEX_CACHE_H
+#define LIMEX_CACHE_H
+
+#include "ue2common.h"
+
+#include <string.h>
+
+/** \brief Max number of state vectors held in the cache. */
+#define LIMEX_CACHE_STATES 64
+
+/** \brief Number of slots in the cache's hash table; a power of two. */
+#define LIMEX_CACHE_HASH_SLOTS 128
+
+/** \brief Bytes reserved for each state vector: enough for the largest LimEx
+ * model. */
+#define LIMEX_CACHE_STATE_BYTES 128
+
+/** \brief Index value used for an empty hash slot or unknown transition. */
+#define LIMEX_CACHE_NONE 0xff
+
+struct ALIGN_CL_DIRECTIVE limex_dfa_cache {
+    /** \brief Interned state vectors. */
+    u8 state[LIMEX_CACHE_STATES][LIMEX_CACHE_STATE_BYTES];
+
+    /** \brief Successors of each interned state, including exceptions, before
+     * reach is applied. */
+    u8 succ[LIMEX_CACHE_STATES][LIMEX_CACHE_STATE_BYTES];
+
+    /** \brief Index of the state reached from each interned state on each
+     * reach class, or LIMEX_CACHE_NONE if not yet known. */
+    u8 next[LIMEX_CACHE_STATES][N_CHARS];
+
+    /** \brief Open-addressed hash table of interned state indices. */
+    u8 slots[LIMEX_CACHE_HASH_SLOTS];
+
+    const void *owner; /**< LimEx NFA whose states are held, or NULL */
+    u32 count; /**< number of interned states */
+};
+
+/** \brief Empties the cache and hands it to the LimEx NFA \a owner. */
+static really_inline
+void limexCacheReset(struct limex_dfa_cache *c, const void *owner) {
+    c->owner = owner;
+    c->count = 0;
+    memset(c->slots, LIMEX_CACHE_NONE, sizeof(c->slots));
+}
+
+static really_inline
+u32 limexCacheHash(const void *s, u32 len) {
+    assert(len % sizeof(u32) == 0);
+    u64a h = 0;
+    for (u32 i = 0; i < len; i += sizeof(u32)) {
+        u32 w;
+        memcpy(&w, (const u8 *)s + i, sizeof(w));
+        h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+    }
+    return (u32)(h >> 32) & (LIMEX_CACHE_HASH_SLOTS - 1);
+}
+
+/** \brief Returns the index of the \a len byte state vector \a s in the
+ * cache, or LIMEX_CACHE_NONE if it isn't there, in which case \a slot is set
+ * to the hash slot it should be inserted into. */
+static really_inline
+u32 limexCacheFind(const struct limex_dfa_cache *c, const void *s, u32 len,
+                   u32 *slot) {
+    assert(len <= LIMEX_CACHE_STATE_BYTES);
+    u32 h = limexCacheHash(s, len);
+    for (;;) {
+        u32 idx = c->slots[h];
+        if (idx == LIMEX_CACHE_NONE || !memcmp(c->state[idx], s, len)) {
+            *slot = h;
+            return idx;
+        }
+        h = (h + 1) & (LIMEX_CACHE_HASH_SLOTS - 1);
+    }
+}
+
+/** \brief Interns the \a len byte state vector \a s at hash slot \a slot,
+ * from limexCacheFind(). Returns its index, or LIMEX_CACHE_NONE if the cache
+ * is full. The caller must fill in its successors. */
+static really_inline
+u32 limexCacheInsert(struct limex_dfa_cache *c, u32 slot, const void *s,
+                     u32 len) {
+    assert(c->slots[slot] == LIMEX_CACHE_NONE);
+    if (c->count == LIMEX_CACHE_STATES) {
+        return LIMEX_CACHE_NONE;
+    }
+    u32 idx = c->count++;
+    memcpy(c->state[idx], s, len);
+    memset(c->next[idx], LIMEX_CACHE_NONE, sizeof(c->next[idx]));
+    c->slots[slot] = idx;
+    return idx;
+}
+
+#endif
@@ -82,6 +82,8 @@ struct precalcAccel {
     u32 double_offset;
 
     MultibyteAccelInfo ma_info;
+
+    vector<vector<CharReach>> literals; /* escape literals, if any */
 };
 
 struct limex_accel_info {
@@ -167,7 +169,7 @@ struct build_info {
     limex_accel_info accel;
 };
 
-#define LAST_LIMEX_NFA LIMEX_NFA_512
+#define LAST_LIMEX_NFA LIMEX_NFA_1024
 
 // Constants for scoring mechanism
 const int SHIFT_COST = 10; // limex: cost per shift mask
@@ -205,7 +207,7 @@ struct DISPATCH_BY_LIMEX_TYPE_INT<sfunc, rv_t, arg_t,
 
 // Given a number of states, find the size of the smallest container NFA it
 // will fit in. We support NFAs of the following sizes: 32, 64, 128, 256, 384,
-// 512.
+// 512, 1024.
 size_t findContainerSize(size_t states) {
     if (states > 256 && states <= 384) {
         return 384;
@@ -667,6 +669,7 @@ void fillAccelInfo(build_info &bi) {
             pa.double_lits = as.double_byte;
             pa.double_cr = as.double_cr;
         };
+        pa.literals = as.literals;
     }
 
     for (const auto &m : accel_map) {
@@ -699,6 +702,16 @@ void fillAccelInfo(build_info &bi) {
     }
 }
 
+static
+bool hasAccelFriends(const limex_accel_info &accel) {
+    for (const auto &m : accel.friends) {
+        if (!m.second.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /** The AccelAux structure has large alignment specified, and this makes some
  * compilers do odd things unless we specify a custom allocator. */
 typedef vector<AccelAux, AlignedAllocator<AccelAux, alignof(AccelAux)> >
@@ -730,7 +743,7 @@ void buildAccel(const build_info &args, NFAStateSet &accelMask,
     // combination of accelerable states.
     assert(accelStates.size() < 32);
     const u32 accelCount = 1U << accelStates.size();
-    assert(accelCount <= 256);
+    assert(accelCount <= 1U << NFA_MAX_ACCEL_STATES);
 
     // Set up a unioned AccelBuild for every possible combination of the set
     // bits in accelStates.
@@ -755,6 +768,10 @@ void buildAccel(const build_info &args, NFAStateSet &accelMask,
     memset(&auxvec[0], 0, sizeof(AccelAux));
     auxvec[0].accel_type = ACCEL_NONE; // no states on.
 
+    /* Friends carry partial matches that began before the accel point, which
+     * escape literals read from that point on would not see. */
+    const bool has_friends = hasAccelFriends(accel);
+
     AccelAux aux;
     for (u32 i = 1; i < accelCount; i++) {
         memset(&aux, 0, sizeof(aux));
@@ -782,6 +799,9 @@ void buildAccel(const build_info &args, NFAStateSet &accelMask,
             } else {
                 ainfo.single_offset = precalc.single_offset;
                 ainfo.single_stops = precalc.single_cr;
+                if (!has_friends) {
+                    ainfo.literals = precalc.literals;
+                }
             }
         }
 
@@ -790,11 +810,16 @@ void buildAccel(const build_info &args, NFAStateSet &accelMask,
         // FIXME: We may want a faster way to find AccelAux structures that
         // we've already built before.
         auto it = find_if(auxvec.begin(), auxvec.end(), AccelAuxCmp(aux));
-        if (it == auxvec.end()) {
+        if (it != auxvec.end()) {
+            accelTable[i] = verify_u8(it - auxvec.begin());
+        } else if (auxvec.size() < 256) {
             accelTable[i] = verify_u8(auxvec.size());
             auxvec.push_back(aux);
         } else {
-            accelTable[i] = verify_u8(it - auxvec.begin());
+            // Table entries are a byte wide; any further combinations go
+            // unaccelerated.
+            DEBUG_PRINTF("out of accel aux slots for combination %u\n", i);
+            accelTable[i] = 0;
         }
     }
 
@@ -1682,6 +1707,13 @@ struct Factory {
             // set this bit in the exception mask
             maskSetBit(limex->exceptionMask, state_id);
 
+            // Exceptions that only switch on successors and squash states can
+            // be handled in bulk at runtime; the rest are run one at a time.
+            if (proto.trigger != LIMEX_TRIGGER_NONE ||
+                proto.reports_index != MO_INVALID_IDX) {
+                maskSetBit(limex->complexExceptionMask, state_id);
+            }
+
             ecount++;
         }
 
@@ -2009,6 +2041,16 @@ struct Factory {
             setNfaFlag(nfa.get(), NFA_ACCEPTS_EOD);
         }
 
+        // Large NFAs without bounded repeats may scan through the lazy DFA
+        // cache in scratch, which only pays off if they have exceptions.
+        u32 lazyMinStates = args.cc.grey.limexLazyDfaMinStates;
+        if (lazyMinStates && args.num_states >= lazyMinStates &&
+            exceptionCount && args.repeats.empty()) {
+            DEBUG_PRINTF("using lazy dfa cache\n");
+            setLimexFlag(limex, LIMEX_FLAG_LAZY_DFA);
+            setNfaFlag(nfa.get(), NFA_LIMEX_CACHE);
+        }
+
         return nfa;
     }
 
@@ -2021,13 +2063,6 @@ struct Factory {
             sz = 32;
         }
 
-        // Special case: with SIMD available, we definitely prefer using
-        // 128-bit NFAs over 64-bit ones given the paucity of registers
-        // available.
-        if (sz == 64) {
-            sz = 128;
-        }
-
         if (args.cc.grey.nfaForceSize) {
             sz = args.cc.grey.nfaForceSize;
         }
@@ -2070,10 +2105,12 @@ struct scoreNfa {
     };
 
 MAKE_LIMEX_TRAITS(32)
+MAKE_LIMEX_TRAITS(64)
 MAKE_LIMEX_TRAITS(128)
 MAKE_LIMEX_TRAITS(256)
 MAKE_LIMEX_TRAITS(384)
 MAKE_LIMEX_TRAITS(512)
+MAKE_LIMEX_TRAITS(1024)
 
 } // namespace
 
@@ -37,6 +37,8 @@
 #include "callback.h"
 #include "util/simd_utils.h" // for m128 etc
 
+struct limex_dfa_cache;
+
 // Runtime context structures.
 
 /* cached_estate/esucc etc...
@@ -60,16 +62,19 @@ struct ALIGN_CL_DIRECTIVE NFAContext##nsize {                               \
     char cached_br; /**< cached_estate contains a br state */               \
     const ReportID *cached_reports;                                         \
     union RepeatControl *repeat_ctrl;                                       \
+    struct limex_dfa_cache *cache; /**< lazy DFA cache, or NULL */          \
     char *repeat_state;                                                     \
     NfaCallback callback;                                                   \
     void *context;                                                          \
 };
 
 GEN_CONTEXT_STRUCT(32,  u32)
+GEN_CONTEXT_STRUCT(64,  u64a)
 GEN_CONTEXT_STRUCT(128, m128)
 GEN_CONTEXT_STRUCT(256, m256)
 GEN_CONTEXT_STRUCT(384, m384)
 GEN_CONTEXT_STRUCT(512, m512)
+GEN_CONTEXT_STRUCT(1024, m1024)
 
 #undef GEN_CONTEXT_STRUCT
 
@@ -54,6 +54,10 @@ using namespace std;
 namespace ue2 {
 
 template<typename T> struct limex_traits {};
+template<> struct limex_traits<LimExNFA1024> {
+    static const u32 size = 1024;
+    typedef NFAException1024 exception_type;
+};
 template<> struct limex_traits<LimExNFA512> {
     static const u32 size = 512;
     typedef NFAException512 exception_type;
@@ -70,6 +74,10 @@ template<> struct limex_traits<LimExNFA128> {
     static const u32 size = 128;
     typedef NFAException128 exception_type;
 };
+template<> struct limex_traits<LimExNFA64> {
+    static const u32 size = 64;
+    typedef NFAException64 exception_type;
+};
 template<> struct limex_traits<LimExNFA32> {
     static const u32 size = 32;
     typedef NFAException32 exception_type;
@@ -285,6 +293,8 @@ void dumpLimexText(const limex_type *limex, FILE *f) {
              size);
     dumpMask(f, "compress_mask", (const u8 *)&limex->compressMask, size);
     dumpMask(f, "emask", (const u8 *)&limex->exceptionMask, size);
+    dumpMask(f, "complex_emask", (const u8 *)&limex->complexExceptionMask,
+             size);
     dumpMask(f, "zombie", (const u8 *)&limex->zombieMask, size);
 
     // Dump top masks, if there are any.
@@ -486,9 +496,11 @@ void dumpLimDotInfo(const limex_type *limex, u32 state, FILE *f) {
     DUMP_DOT_FN(size)
 
 LIMEX_DUMP_FNS(32)
+LIMEX_DUMP_FNS(64)
 LIMEX_DUMP_FNS(128)
 LIMEX_DUMP_FNS(256)
 LIMEX_DUMP_FNS(384)
 LIMEX_DUMP_FNS(512)
+LIMEX_DUMP_FNS(1024)
 
 } // namespace ue2
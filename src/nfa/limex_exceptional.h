@@ -44,6 +44,7 @@
 #define PE_FN                   JOIN(processExceptional, SIZE)
 #define RUN_EXCEPTION_FN        JOIN(runException, SIZE)
 #define ZERO_STATE              JOIN(zero_, STATE_T)
+#define ONES_STATE              JOIN(ones_, STATE_T)
 #define LOAD_STATE              JOIN(load_, STATE_T)
 #define STORE_STATE             JOIN(store_, STATE_T)
 #define AND_STATE               JOIN(and_, STATE_T)
@@ -248,14 +249,23 @@ int PE_FN(STATE_ARG, ESTATE_ARG, u32 diffmask, STATE_T *succ,
     memcpy(chunks, estatep, sizeof(STATE_T));
 #endif
     memcpy(emask_chunks, &limex->exceptionMask, sizeof(STATE_T));
+    CHUNK_T complex_chunks[sizeof(STATE_T) / sizeof(CHUNK_T)];
+    memcpy(complex_chunks, &limex->complexExceptionMask, sizeof(STATE_T));
+
+    // Exceptions without triggers or reports only switch on successors and
+    // squash states, so they are accumulated here without branching and
+    // applied once at the end.
+    STATE_T simple_succ = ZERO_STATE;
+    STATE_T simple_squash = ONES_STATE;
+    u8 simple_has_squash = 0;
 
     struct proto_cache new_cache = {0, NULL};
     enum CacheResult cacheable = CACHE_RESULT;
 
     u32 base_index[sizeof(STATE_T) / sizeof(CHUNK_T)];
     base_index[0] = 0;
-    for (u32 i = 0; i < ARRAY_LENGTH(base_index) - 1; i++) {
-        base_index[i + 1] = base_index[i] + POPCOUNT_FN(emask_chunks[i]);
+    for (u32 i = 1; i < ARRAY_LENGTH(base_index); i++) {
+        base_index[i] = base_index[i - 1] + POPCOUNT_FN(emask_chunks[i - 1]);
     }
 
     do {
@@ -264,11 +274,24 @@ int PE_FN(STATE_ARG, ESTATE_ARG, u32 diffmask, STATE_T *succ,
         t >>= 1; // Due to diffmask64, which leaves holes in the bitmask.
 #endif
         assert(t < ARRAY_LENGTH(chunks));
-        CHUNK_T word = chunks[t];
-        assert(word != 0);
-        do {
+        assert(chunks[t] != 0);
+        CHUNK_T word = chunks[t] & ~complex_chunks[t];
+        CHUNK_T complex_word = chunks[t] & complex_chunks[t];
+        while (word) {
             u32 bit = FIND_AND_CLEAR_FN(&word);
             u32 local_index = RANK_IN_MASK_FN(emask_chunks[t], bit);
+            const EXCEPTION_T *e = &exceptions[local_index + base_index[t]];
+            assert(e->trigger == LIMEX_TRIGGER_NONE);
+            assert(e->reports == MO_INVALID_IDX);
+
+            // The squash mask is all-ones for exceptions without a squash.
+            simple_succ = OR_STATE(simple_succ, LOAD_STATE(&e->successors));
+            simple_squash = AND_STATE(simple_squash, LOAD_STATE(&e->squash));
+            simple_has_squash |= e->hasSquash;
+        }
+        while (complex_word) {
+            u32 bit = FIND_AND_CLEAR_FN(&complex_word);
+            u32 local_index = RANK_IN_MASK_FN(emask_chunks[t], bit);
             u32 idx = local_index + base_index[t];
             const EXCEPTION_T *e = &exceptions[idx];
 
@@ -280,13 +303,22 @@ int PE_FN(STATE_ARG, ESTATE_ARG, u32 diffmask, STATE_T *succ,
                                   &cacheable, in_rev, flags)) {
                 return PE_RV_HALT;
             }
-        } while (word);
+        }
     } while (diffmask);
 
+    if (simple_has_squash && cacheable == CACHE_RESULT) {
+        cacheable = DO_NOT_CACHE_RESULT;
+    }
+
 #ifndef BIG_MODEL
-    STORE_STATE(succ, OR_STATE(LOAD_STATE(succ), local_succ));
+    local_succ = OR_STATE(local_succ, simple_succ);
+    STORE_STATE(succ, OR_STATE(AND_STATE(LOAD_STATE(succ), simple_squash),
+                               local_succ));
 #else
-    STORE_STATE(succ, OR_STATE(LOAD_STATE(succ), ctx->local_succ));
+    STORE_STATE(&ctx->local_succ,
+                OR_STATE(LOAD_STATE(&ctx->local_succ), simple_succ));
+    STORE_STATE(succ, OR_STATE(AND_STATE(LOAD_STATE(succ), simple_squash),
+                               LOAD_STATE(&ctx->local_succ)));
 #endif
 
     if (cacheable == CACHE_RESULT) {
@@ -310,6 +342,7 @@ int PE_FN(STATE_ARG, ESTATE_ARG, u32 diffmask, STATE_T *succ,
 #endif
 
 #undef ZERO_STATE
+#undef ONES_STATE
 #undef AND_STATE
 #undef EQ_STATE
 #undef OR_STATE
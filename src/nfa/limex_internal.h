@@ -85,6 +85,7 @@
 
 #define LIMEX_FLAG_COMPRESS_STATE  1 /**< pack state into stream state */
 #define LIMEX_FLAG_COMPRESS_MASKED 2 /**< use reach mask-based compression */
+#define LIMEX_FLAG_LAZY_DFA        4 /**< use the lazy DFA cache in scratch */
 
 enum LimExTrigger {
     LIMEX_TRIGGER_NONE = 0,
@@ -108,6 +109,7 @@ typedef m128 u_128;
 typedef m256 u_256;
 typedef m384 u_384;
 typedef m512 u_512;
+typedef m1024 u_1024;
 
 #define CREATE_NFA_LIMEX(size)                                              \
 struct NFAException##size {                                                 \
@@ -152,6 +154,8 @@ struct LimExNFA##size {                                                     \
                                     *  followers */                         \
     u_##size compressMask; /**< switch off before compress */               \
     u_##size exceptionMask;                                                 \
+    u_##size complexExceptionMask; /**< exceptions with triggers or reports,
+                                     *  which are run one at a time */      \
     u_##size repeatCyclicMask;                                              \
     u_##size zombieMask; /**< zombie if in any of the set states */         \
     u_##size shift[MAX_SHIFT_COUNT];                                        \
@@ -160,10 +164,12 @@ struct LimExNFA##size {                                                     \
 };
 
 CREATE_NFA_LIMEX(32)
+CREATE_NFA_LIMEX(64)
 CREATE_NFA_LIMEX(128)
 CREATE_NFA_LIMEX(256)
 CREATE_NFA_LIMEX(384)
 CREATE_NFA_LIMEX(512)
+CREATE_NFA_LIMEX(1024)
 
 /** \brief Structure describing a bounded repeat within the LimEx NFA.
  *
@@ -38,10 +38,13 @@
 #define LIMEX_RUNTIME_H
 
 #include "limex_accel.h"
+#include "limex_cache.h"
 #include "limex_context.h"
 #include "limex_internal.h"
+#include "nfa_api_queue.h"
 #include "nfa_api_util.h"
 #include "nfa_internal.h"
+#include "scratch.h"
 #include "util/uniform_ops.h"
 
 ////////////////////////////////////////////////////////////////////////////
@@ -138,6 +141,16 @@ int limexRunReports(const ReportID *reports, NfaCallback callback,
     return MO_CONTINUE_MATCHING; // continue
 }
 
+/** \brief Returns the lazy DFA cache in scratch for a LimEx NFA with the
+ * given flags, or NULL if it doesn't use one. */
+static really_inline
+struct limex_dfa_cache *getLimExCache(u32 flags, const struct mq *q) {
+    if (!(flags & LIMEX_FLAG_LAZY_DFA) || !q->scratch) {
+        return NULL;
+    }
+    return q->scratch->limex_cache;
+}
+
 /** \brief Return a (correctly typed) pointer to the exception table. */
 #define getExceptionTable(exc_type, lim)                                       \
     ((const exc_type *)((const char *)(lim) + (lim)->exceptionOffset))
@@ -170,10 +183,12 @@ int limexRunReports(const ReportID *reports, NfaCallback callback,
     }
 
 MAKE_GET_NFA_REPEAT_INFO(32)
+MAKE_GET_NFA_REPEAT_INFO(64)
 MAKE_GET_NFA_REPEAT_INFO(128)
 MAKE_GET_NFA_REPEAT_INFO(256)
 MAKE_GET_NFA_REPEAT_INFO(384)
 MAKE_GET_NFA_REPEAT_INFO(512)
+MAKE_GET_NFA_REPEAT_INFO(1024)
 
 static really_inline
 const struct RepeatInfo *getRepeatInfo(const struct NFARepeatInfo *info) {
@@ -60,6 +60,8 @@
 #define GET_NFA_REPEAT_INFO_FN JOIN(getNfaRepeatInfo, SIZE)
 #define RUN_ACCEL_FN        JOIN(LIMEX_API_ROOT, _Run_Accel)
 #define RUN_EXCEPTIONS_FN   JOIN(LIMEX_API_ROOT, _Run_Exceptions)
+#define LAZY_INTERN_FN      JOIN(LIMEX_API_ROOT, _Lazy_Intern)
+#define RUN_LAZY_FN         JOIN(LIMEX_API_ROOT, _Run_Lazy)
 #define REV_STREAM_FN       JOIN(LIMEX_API_ROOT, _Rev_Stream)
 #define STREAM_FN           JOIN(LIMEX_API_ROOT, _Stream)
 #define STREAMCB_FN         JOIN(LIMEX_API_ROOT, _Stream_CB)
@@ -142,6 +144,93 @@ char RUN_EXCEPTIONS_FN(const IMPL_NFA_T *limex, const EXCEPTION_T *exceptions,
     return 0;
 }
 
+// Returns the index of state s in the lazy DFA cache, interning it and
+// computing its successors if it isn't there already, or LIMEX_CACHE_NONE if
+// the cache is full.
+static really_inline
+u32 LAZY_INTERN_FN(const IMPL_NFA_T *limex, const EXCEPTION_T *exceptions,
+                   const ReportID *exReports, STATE_T s, const STATE_T emask,
+                   struct CONTEXT_T *ctx) {
+    struct limex_dfa_cache *c = ctx->cache;
+    u32 slot;
+    u32 idx = limexCacheFind(c, &s, sizeof(STATE_T), &slot);
+    if (idx != LIMEX_CACHE_NONE) {
+        return idx;
+    }
+
+    idx = limexCacheInsert(c, slot, &s, sizeof(STATE_T));
+    if (idx == LIMEX_CACHE_NONE) {
+        DEBUG_PRINTF("lazy dfa cache full\n");
+        return LIMEX_CACHE_NONE;
+    }
+
+    // Only simple exceptions can be on, so this neither raises reports nor
+    // touches repeat state.
+    STATE_T succ;
+    NFA_EXEC_GET_LIM_SUCC(STATE_T);
+    UNUSED char rv = RUN_EXCEPTIONS_FN(limex, exceptions, exReports, s, emask,
+                                       1, 0, &succ, NULL, ctx, NO_OUTPUT, 0,
+                                       0);
+    assert(!rv);
+    STORE_STATE((STATE_T *)c->succ[idx], succ);
+    DEBUG_PRINTF("interned lazy dfa state %u\n", idx);
+    return idx;
+}
+
+// Scans input[i, end) through the lazy DFA cache for as long as the state has
+// no accepts or complex exceptions, and returns the index of the next byte to
+// be scanned normally, with its state in *sp.
+static really_inline
+size_t RUN_LAZY_FN(const IMPL_NFA_T *limex, const STATE_T *reach,
+                   const EXCEPTION_T *exceptions, const ReportID *exReports,
+                   const STATE_T emask, const u8 *input, size_t i, size_t end,
+                   STATE_T *sp, struct CONTEXT_T *ctx) {
+    struct limex_dfa_cache *c = ctx->cache;
+    const STATE_T unsafe = OR_STATE(LOAD_STATE(&limex->complexExceptionMask),
+                                    LOAD_STATE(&limex->accept));
+    STATE_T s = *sp;
+    if (ISNONZERO_STATE(AND_STATE(s, unsafe))) {
+        return i;
+    }
+
+    if (c->owner != limex) {
+        limexCacheReset(c, limex);
+    }
+    u32 idx = LAZY_INTERN_FN(limex, exceptions, exReports, s, emask, ctx);
+    if (idx == LIMEX_CACHE_NONE) {
+        limexCacheReset(c, limex);
+        idx = LAZY_INTERN_FN(limex, exceptions, exReports, s, emask, ctx);
+    }
+    assert(idx != LIMEX_CACHE_NONE);
+
+    for (; i != end; i++) {
+        DUMP_INPUT(i);
+        u8 cls = limex->reachMap[input[i]];
+        u32 next = c->next[idx][cls];
+        if (next == LIMEX_CACHE_NONE) {
+            s = AND_STATE(LOAD_STATE((const STATE_T *)c->succ[idx]),
+                          LOAD_STATE(&reach[cls]));
+            if (ISZERO_STATE(s) || ISNONZERO_STATE(AND_STATE(s, unsafe))) {
+                *sp = s;
+                return i + 1;
+            }
+            next = LAZY_INTERN_FN(limex, exceptions, exReports, s, emask, ctx);
+            if (next == LIMEX_CACHE_NONE) {
+                limexCacheReset(c, limex);
+                next = LAZY_INTERN_FN(limex, exceptions, exReports, s, emask,
+                                      ctx);
+                assert(next != LIMEX_CACHE_NONE);
+            } else {
+                c->next[idx][cls] = next;
+            }
+        }
+        idx = next;
+    }
+
+    *sp = LOAD_STATE((const STATE_T *)c->state[idx]);
+    return i;
+}
+
 static really_inline
 size_t RUN_ACCEL_FN(const STATE_T s, UNUSED const STATE_T accelMask,
                     UNUSED const IMPL_NFA_T *limex, const u8 *accelTable,
@@ -199,6 +288,15 @@ without_accel:
             return MO_CONTINUE_MATCHING;
         }
 
+        if (ctx->cache) {
+            i = RUN_LAZY_FN(limex, reach, exceptions, exReports,
+                            EXCEPTION_MASK, input, i, min_accel_offset, &s,
+                            ctx);
+            if (i == min_accel_offset) {
+                break;
+            }
+        }
+
         u8 c = input[i];
         STATE_T succ;
         NFA_EXEC_GET_LIM_SUCC(STATE_T);
@@ -568,6 +666,7 @@ char JOIN(LIMEX_API_ROOT, _Q)(const struct NFA *n, struct mq *q, s64a end) {
     struct CONTEXT_T ctx;
     ctx.repeat_ctrl = getRepeatControlBase(q->state, sizeof(STATE_T));
     ctx.repeat_state = q->streamState + limex->stateSize;
+    ctx.cache = getLimExCache(limex->flags, q);
     ctx.callback = q->cb;
     ctx.context = q->context;
     STORE_STATE(&ctx.cached_estate, ZERO_STATE);
@@ -663,6 +762,7 @@ char JOIN(LIMEX_API_ROOT, _Q2)(const struct NFA *n, struct mq *q, s64a end) {
     struct CONTEXT_T ctx;
     ctx.repeat_ctrl = getRepeatControlBase(q->state, sizeof(STATE_T));
     ctx.repeat_state = q->streamState + limex->stateSize;
+    ctx.cache = getLimExCache(limex->flags, q);
     ctx.callback = q->cb;
     ctx.context = q->context;
     STORE_STATE(&ctx.cached_estate, ZERO_STATE);
@@ -775,6 +875,7 @@ char JOIN(LIMEX_API_ROOT, _QR)(const struct NFA *n, struct mq *q,
     struct CONTEXT_T ctx;
     ctx.repeat_ctrl = getRepeatControlBase(q->state, sizeof(STATE_T));
     ctx.repeat_state = q->streamState + limex->stateSize;
+    ctx.cache = getLimExCache(limex->flags, q);
     ctx.callback = NULL;
     ctx.context = NULL;
     STORE_STATE(&ctx.cached_estate, ZERO_STATE);
@@ -873,6 +974,7 @@ char JOIN(LIMEX_API_ROOT, _B_Reverse)(const struct NFA *n, u64a offset,
     struct CONTEXT_T ctx;
     ctx.repeat_ctrl = NULL;
     ctx.repeat_state = NULL;
+    ctx.cache = NULL;
     ctx.callback = cb;
     ctx.context = context;
     STORE_STATE(&ctx.cached_estate, ZERO_STATE);
@@ -974,6 +1076,8 @@ enum nfa_zombie_status JOIN(LIMEX_API_ROOT, _zombie_status)(
 #undef GET_NFA_REPEAT_INFO_FN
 #undef RUN_ACCEL_FN
 #undef RUN_EXCEPTIONS_FN
+#undef LAZY_INTERN_FN
+#undef RUN_LAZY_FN
 #undef REV_STREAM_FN
 #undef STREAM_FN
 #undef STREAMCB_FN
@@ -41,13 +41,9 @@
 #include "util/bitutils.h"
 #include "util/simd_utils.h"
 
-#if defined(__BMI2__) || (defined(_WIN32) && defined(__AVX2__))
-#define HAVE_PEXT
-#endif
-
 static really_inline
 u32 packedExtract32(u32 x, u32 mask) {
-#if defined(HAVE_PEXT)
+#if defined(HAVE_BMI2)
     // Intel BMI2 can do this operation in one instruction.
     return _pext_u32(x, mask);
 #else
@@ -67,7 +63,7 @@ u32 packedExtract32(u32 x, u32 mask) {
 
 static really_inline
 u32 packedExtract64(u64a x, u64a mask) {
-#if defined(HAVE_PEXT) && defined(ARCH_64_BIT)
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
     // Intel BMI2 can do this operation in one instruction.
     return _pext_u64(x, mask);
 #else
@@ -85,8 +81,6 @@ u32 packedExtract64(u64a x, u64a mask) {
 #endif
 }
 
-#undef HAVE_PEXT
-
 static really_inline
 u32 packedExtract128(m128 s, const m128 permute, const m128 compare) {
     m128 shuffled = pshufb(s, permute);
@@ -107,4 +101,17 @@ u32 packedExtract256(m256 s, const m256 permute, const m256 compare) {
 }
 #endif // AVX2
 
+#if defined(__AVX512BW__)
+static really_inline
+u32 packedExtract512(m512 s, const m512 permute, const m512 compare) {
+    // vpshufb doesn't cross lanes, so this is a bit of a cheat
+    m512 shuffled = _mm512_shuffle_epi8(s, permute);
+    m512 compared = and512(shuffled, compare);
+    u64a rv = ~_mm512_cmpeq_epi8_mask(compared, shuffled);
+    // stitch the lane-wise results back together
+    u32 rv32 = (u32)(rv | (rv >> 32));
+    return (rv32 >> 16) | (rv32 & 0xffffU);
+}
+#endif // AVX512BW
+
 #endif // LIMEX_SHUFFLE_H
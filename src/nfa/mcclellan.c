@@ -126,7 +126,7 @@ without_accel:
         if (s < sherman_base) {
             DEBUG_PRINTF("doing normal\n");
             assert(s < m->state_count);
-            s = succ_table[((u32)s << as) + cprime];
+            s = doNormal16(m, succ_table, s, cprime, as);
         } else {
             const char *sherman_state
                 = findShermanState(m, sherman_base_offset, sherman_base, s);
@@ -166,7 +166,7 @@ with_accel:
         if (s < sherman_base) {
             DEBUG_PRINTF("doing normal\n");
             assert(s < m->state_count);
-            s = succ_table[((u32)s << as) + cprime];
+            s = doNormal16(m, succ_table, s, cprime, as);
         } else {
             const char *sherman_state
                 = findShermanState(m, sherman_base_offset, sherman_base, s);
@@ -297,6 +297,13 @@ char mcclellanExec8_i(const struct mcclellan *m, u8 *state, const u8 *buf,
     u32 cached_accept_id = 0;
     u16 cached_accept_state = 0;
 
+    /* two-byte stride: halves the dependent table loads per byte while the
+     * state between the bytes is neither accepting nor accelerable */
+    const u16 *stride2 = m->stride2_offset
+        ? (const u16 *)((const char *)m + m->stride2_offset - sizeof(struct NFA))
+        : NULL;
+    const u32 as2 = 2 * as;
+
     DEBUG_PRINTF("accel %hu, accept %hu\n", accel_limit, accept_limit);
 
     DEBUG_PRINTF("s: %hhu, len %zu\n", s, len);
@@ -311,12 +318,25 @@ char mcclellanExec8_i(const struct mcclellan *m, u8 *state, const u8 *buf,
 
 without_accel:
     while (c < min_accel_offset && s) {
+        if (stride2 && c + 1 < min_accel_offset) {
+            u16 t = stride2[((u32)s << as2) + ((u32)m->remap[c[0]] << as)
+                            + m->remap[c[1]]];
+            if (!(t & MCCLELLAN_STRIDE2_MID)) {
+                c += 2;
+                s = (u8)t;
+                DEBUG_PRINTF("stride2 s: %hhu\n", s);
+                goto check_accept_without_accel;
+            }
+        }
+
         u8 cprime = m->remap[*(c++)];
         DEBUG_PRINTF("c: %02hhx '%c' cp:%02hhx\n", *(c-1),
                      ourisprint(*(c-1)) ? *(c-1) : '?', cprime);
         s = succ_table[((u32)s << as) + cprime];
         DEBUG_PRINTF("s: %hhu\n", s);
 
+    check_accept_without_accel:
+
         if (mode != NO_MATCHES && s >= accept_limit) {
             if (mode == STOP_AT_MATCH) {
                 DEBUG_PRINTF("match - pausing\n");
@@ -342,12 +362,24 @@ without_accel:
 
 with_accel:
     while (c < c_end && s) {
+        if (stride2 && c + 1 < c_end) {
+            u16 t = stride2[((u32)s << as2) + ((u32)m->remap[c[0]] << as)
+                            + m->remap[c[1]]];
+            if (!(t & MCCLELLAN_STRIDE2_MID)) {
+                c += 2;
+                s = (u8)t;
+                DEBUG_PRINTF("stride2 s: %hhu\n", s);
+                goto check_special_with_accel;
+            }
+        }
+
         u8 cprime = m->remap[*(c++)];
         DEBUG_PRINTF("c: %02hhx '%c' cp:%02hhx\n", *(c-1),
                      ourisprint(*(c-1)) ? *(c-1) : '?', cprime);
         s = succ_table[((u32)s << as) + cprime];
         DEBUG_PRINTF("s: %hhu\n", s);
 
+    check_special_with_accel:
         if (s >= accel_limit) { /* accept_limit >= accel_limit */
             if (mode != NO_MATCHES && s >= accept_limit) {
                 if (mode == STOP_AT_MATCH) {
@@ -823,6 +855,129 @@ char nfaExecMcClellan16_Q(const struct NFA *n, struct mq *q, s64a end) {
                                   CALLBACK_OUTPUT);
 }
 
+/** \brief Length of the prefix shared by every lane of a batch. */
+static really_inline
+size_t batchCommonLength(const size_t *lengths, u32 count) {
+    size_t min_len = lengths[0];
+    for (u32 i = 1; i < count; i++) {
+        min_len = MIN(min_len, lengths[i]);
+    }
+    return min_len;
+}
+
+u32 nfaExecMcClellan8_Bbatch(const struct NFA *n, const u8 *const *buffers,
+                             const size_t *lengths, u32 count) {
+    assert(n->type == MCCLELLAN_NFA_8);
+    assert(count && count <= MCCLELLAN_BATCH_LANES);
+    const struct mcclellan *m = getImplNfa(n);
+    const u8 *succ_table = (const u8 *)((const char *)m
+                                        + sizeof(struct mcclellan));
+    const u32 as = m->alphaShift;
+    const u8 accept_limit = (u8)m->accept_limit_8;
+
+    u8 s[MCCLELLAN_BATCH_LANES];
+    u32 accepted = 0;
+    for (u32 i = 0; i < count; i++) {
+        s[i] = (u8)m->start_anchored;
+    }
+
+    size_t common = batchCommonLength(lengths, count);
+    DEBUG_PRINTF("%u lanes, common len %zu\n", count, common);
+
+    /* Dead state 0 transitions to itself on every byte, so the shared prefix
+     * needs no per-lane liveness checks. */
+    for (size_t j = 0; j < common; j++) {
+        u8 live = 0;
+        for (u32 i = 0; i < count; i++) {
+            u8 cprime = m->remap[buffers[i][j]];
+            s[i] = succ_table[((u32)s[i] << as) + cprime];
+            accepted |= (u32)(s[i] >= accept_limit) << i;
+            live |= s[i];
+        }
+        if (!live) {
+            DEBUG_PRINTF("all lanes dead at %zu\n", j);
+            return accepted;
+        }
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        for (size_t j = common; j < lengths[i] && s[i]; j++) {
+            u8 cprime = m->remap[buffers[i][j]];
+            s[i] = succ_table[((u32)s[i] << as) + cprime];
+            accepted |= (u32)(s[i] >= accept_limit) << i;
+        }
+        if (get_aux(m, s[i])->accept_eod) {
+            accepted |= 1U << i;
+        }
+    }
+
+    return accepted;
+}
+
+static really_inline
+u16 batchStep16(const struct mcclellan *m, const u16 *succ_table,
+                const char *sherman_base_offset, u32 as, u16 s, u8 c) {
+    u8 cprime = m->remap[c];
+    if (s < m->sherman_limit) {
+        assert(s < m->state_count);
+        return doNormal16(m, succ_table, s, cprime, as);
+    }
+    const char *sherman_state
+        = findShermanState(m, sherman_base_offset, m->sherman_limit, s);
+    return doSherman16(sherman_state, cprime, succ_table, as);
+}
+
+u32 nfaExecMcClellan16_Bbatch(const struct NFA *n, const u8 *const *buffers,
+                              const size_t *lengths, u32 count) {
+    assert(n->type == MCCLELLAN_NFA_16);
+    assert(count && count <= MCCLELLAN_BATCH_LANES);
+    const struct mcclellan *m = getImplNfa(n);
+    const u16 *succ_table = (const u16 *)((const char *)m
+                                          + sizeof(struct mcclellan));
+    assert(ISALIGNED_N(succ_table, 2));
+    const char *sherman_base_offset
+        = (const char *)m - sizeof(struct NFA) + m->sherman_offset;
+    const u32 as = m->alphaShift;
+
+    u16 s[MCCLELLAN_BATCH_LANES];
+    u32 accepted = 0;
+    for (u32 i = 0; i < count; i++) {
+        s[i] = m->start_anchored & STATE_MASK;
+    }
+
+    size_t common = batchCommonLength(lengths, count);
+    DEBUG_PRINTF("%u lanes, common len %zu\n", count, common);
+
+    for (size_t j = 0; j < common; j++) {
+        u16 live = 0;
+        for (u32 i = 0; i < count; i++) {
+            u16 t = batchStep16(m, succ_table, sherman_base_offset, as, s[i],
+                                buffers[i][j]);
+            accepted |= (u32)!!(t & ACCEPT_FLAG) << i;
+            s[i] = t & STATE_MASK;
+            live |= s[i];
+        }
+        if (!live) {
+            DEBUG_PRINTF("all lanes dead at %zu\n", j);
+            return accepted;
+        }
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        for (size_t j = common; j < lengths[i] && s[i]; j++) {
+            u16 t = batchStep16(m, succ_table, sherman_base_offset, as, s[i],
+                                buffers[i][j]);
+            accepted |= (u32)!!(t & ACCEPT_FLAG) << i;
+            s[i] = t & STATE_MASK;
+        }
+        if (get_aux(m, s[i])->accept_eod) {
+            accepted |= 1U << i;
+        }
+    }
+
+    return accepted;
+}
+
 char nfaExecMcClellan8_reportCurrent(const struct NFA *n, struct mq *q) {
     const struct mcclellan *m = getImplNfa(n);
     NfaCallback cb = q->cb;
@@ -1119,6 +1274,90 @@ char nfaExecMcClellan8_expandState(UNUSED const struct NFA *nfa, void *dest,
     return 0;
 }
 
+/** \brief Number of bytes between merges of the states being tracked by
+ * nfaExecMcClellan8_stateMap. */
+#define MCCLELLAN_STATE_MAP_MERGE 16
+
+char nfaExecMcClellan8_stateMap(const struct NFA *n, const u8 *buf, size_t len,
+                                u8 *map) {
+    const struct mcclellan *m = getImplNfa(n);
+    const u8 *succ_table = (const u8 *)((const char *)m
+                                        + sizeof(struct mcclellan));
+    const u32 as = m->alphaShift;
+    const u32 count = m->state_count;
+    assert(count <= 256);
+
+    /* Most DFAs quickly converge on a few states, so we only track the
+     * distinct states reached so far. Start state i is currently in state
+     * cur[owner[i]]. */
+    u8 cur[256];
+    u8 owner[256];
+    u32 live = count;
+    for (u32 i = 0; i < count; i++) {
+        cur[i] = i;
+        owner[i] = i;
+    }
+
+    const u8 *c = buf, *c_end = buf + len;
+    while (c < c_end) {
+        const u8 *block_end = MIN(c + MCCLELLAN_STATE_MAP_MERGE, c_end);
+        for (; c < block_end; c++) {
+            const u8 cprime = m->remap[*c];
+            for (u32 j = 0; j < live; j++) {
+                cur[j] = succ_table[((u32)cur[j] << as) + cprime];
+            }
+        }
+
+        if (live == 1) {
+            continue;
+        }
+
+        /* merge duplicates */
+        u8 prev[256];
+        u8 slot[256];
+        u8 seen[256];
+        memcpy(prev, cur, live);
+        memset(seen, 0, sizeof(seen));
+        u32 new_live = 0;
+        for (u32 j = 0; j < live; j++) {
+            u8 s = prev[j];
+            if (!seen[s]) {
+                seen[s] = 1;
+                slot[s] = new_live;
+                cur[new_live++] = s;
+            }
+        }
+        if (new_live == live) {
+            continue;
+        }
+        for (u32 i = 0; i < count; i++) {
+            owner[i] = slot[prev[owner[i]]];
+        }
+        live = new_live;
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        map[i] = cur[owner[i]];
+    }
+    return 1;
+}
+
+void nfaExecMcClellan8_composeStateMaps(const struct NFA *n, u8 *map,
+                                        const u8 *next) {
+    const struct mcclellan *m = getImplNfa(n);
+    for (u32 i = 0; i < m->state_count; i++) {
+        map[i] = next[map[i]];
+    }
+}
+
+void nfaExecMcClellan8_applyStateMap(UNUSED const struct NFA *n,
+                                     const u8 *map, char *state) {
+    assert(n->streamStateSize == 1);
+    u8 *s = (u8 *)state;
+    assert(*s < ((const struct mcclellan *)getImplNfa(n))->state_count);
+    *s = map[*s];
+}
+
 char nfaExecMcClellan16_queueCompressState(UNUSED const struct NFA *nfa,
                                            const struct mq *q,
                                            UNUSED s64a loc) {
@@ -55,6 +55,14 @@ char nfaExecMcClellan8_queueCompressState(const struct NFA *nfa,
 char nfaExecMcClellan8_expandState(const struct NFA *nfa, void *dest,
                                    const void *src, u64a offset, u8 key);
 
+/* State maps: run a buffer from every state at once, see nfaBuildStateMap. */
+char nfaExecMcClellan8_stateMap(const struct NFA *n, const u8 *buf, size_t len,
+                                u8 *map);
+void nfaExecMcClellan8_composeStateMaps(const struct NFA *n, u8 *map,
+                                        const u8 *next);
+void nfaExecMcClellan8_applyStateMap(const struct NFA *n, const u8 *map,
+                                     char *state);
+
 #define nfaExecMcClellan8_B_Reverse NFA_API_NO_IMPL
 #define nfaExecMcClellan8_zombie_status NFA_API_ZOMBIE_NO_IMPL
 
@@ -106,4 +114,21 @@ char nfaExecMcClellan8_B(const struct NFA *n, u64a offset, const u8 *buffer,
 char nfaExecMcClellan16_B(const struct NFA *n, u64a offset, const u8 *buffer,
                           size_t length, NfaCallback cb, void *context);
 
+/** \brief Maximum number of buffers walked together by the batch screen. */
+#define MCCLELLAN_BATCH_LANES 8
+
+/**
+ * Batch block mode screen:
+ * - walks up to MCCLELLAN_BATCH_LANES buffers from the anchored start state in
+ *   lockstep, so that the independent transition lookups of each lane overlap
+ * - never raises callbacks
+ * - returns a mask with bit i set iff buffer i reaches an accept or eod accept
+ *   state, i.e. iff the corresponding _B call could raise a match
+ */
+u32 nfaExecMcClellan8_Bbatch(const struct NFA *n, const u8 *const *buffers,
+                             const size_t *lengths, u32 count);
+
+u32 nfaExecMcClellan16_Bbatch(const struct NFA *n, const u8 *const *buffers,
+                              const size_t *lengths, u32 count);
+
 #endif
@@ -71,12 +71,13 @@ u16 doSherman16(const char *sherman_state, u8 cprime, const u16 *succ_table,
 
         u32 z = movemask128(eq128(ss_char, cur_char));
 
-        /* remove header cruft: type 1, len 1, daddy 2*/
-        z &= ~0xf;
-        z &= (1U << (len + 4)) - 1;
+        /* keep only the char list; skip header cruft: type 1, len 1,
+         * daddy 2 */
+        assert(len <= sizeof(m128) - SHERMAN_CHARS_OFFSET);
+        z &= ((1U << len) - 1) << SHERMAN_CHARS_OFFSET;
 
         if (z) {
-            u32 i = ctz32(z & ~0xf) - 4;
+            u32 i = ctz32(z) - SHERMAN_CHARS_OFFSET;
 
             u16 s_out = unaligned_load_u16((const u8 *)sherman_state
                                            + SHERMAN_STATES_OFFSET(len)
@@ -63,6 +63,30 @@ struct mstate_aux {
 };
 
 #define MCCLELLAN_FLAG_SINGLE 1  /**< we raise only single accept id */
+#define MCCLELLAN_FLAG_ROWDISP 2 /**< 16 bit: rows are stored displaced */
+
+/** \brief Check value of an unused row displacement entry; never a state. */
+#define ROWDISP_CHECK_NONE 0xffff
+
+/**
+ * \brief Per-state record of a 16-bit DFA with MCCLELLAN_FLAG_ROWDISP.
+ *
+ * These replace the rows of the transition table. The transitions of a state
+ * that differ from its default are stored in a shared array of u32 entries
+ * (check state in the low half, successor in the high half) starting at
+ * entry \a base; the row of the state is overlaid on the rows of others, so
+ * an entry belongs to this state only if its check value matches. Sherman
+ * states are not used with this layout.
+ */
+struct mcclellan_row {
+    u16 base; /**< index of the entry for symbol 0 */
+    u16 deflt; /**< successor (with flags) for all other symbols */
+};
+
+/** \brief Set in a two-byte stride table entry when the state between the
+ * two bytes is at or above accel_limit_8 (and so may accept or accelerate);
+ * the pair must then be taken one byte at a time. */
+#define MCCLELLAN_STRIDE2_MID 0x100
 
 struct mcclellan {
     u16 state_count; /**< total number of states */
@@ -86,6 +110,15 @@ struct mcclellan {
     ReportID arb_report; /**< one of the accepts that this dfa may raise */
     u32 accel_offset; /**< offset of the accel structures from start of NFA */
     u32 haig_offset; /**< reserved for use by Haig, relative to start of NFA */
+    u32 stride2_offset; /**< 8 bit only: offset of the two-byte stride table
+                         * from start of NFA; 0 if none. Entries are u16,
+                         * indexed by (state << 2 * alphaShift) +
+                         * (remap[c0] << alphaShift) + remap[c1]: the low byte
+                         * is the state after both bytes, plus
+                         * MCCLELLAN_STRIDE2_MID. */
+    u32 rowdisp_offset; /**< 16 bit, MCCLELLAN_FLAG_ROWDISP only: offset of
+                         * the displaced transition entries from start of
+                         * NFA. */
 };
 
 static really_inline
@@ -100,6 +133,24 @@ const char *findShermanState(UNUSED const struct mcclellan *m,
     return rv;
 }
 
+/** \brief Successor (with flags) of normal state \a s of a 16-bit DFA on
+ * remapped symbol \a cprime. \a succ_table follows the mcclellan header. */
+static really_inline
+u16 doNormal16(const struct mcclellan *m, const u16 *succ_table, u16 s,
+               u8 cprime, u32 as) {
+    assert(s < m->sherman_limit);
+    if (!(m->flags & MCCLELLAN_FLAG_ROWDISP)) {
+        return succ_table[((u32)s << as) + cprime];
+    }
+
+    const struct mcclellan_row *row = (const struct mcclellan_row *)succ_table
+                                      + s;
+    const u32 *entries = (const u32 *)((const char *)m - sizeof(struct NFA)
+                                       + m->rowdisp_offset);
+    u32 e = entries[(u32)row->base + cprime];
+    return (u16)e == s ? (u16)(e >> 16) : row->deflt;
+}
+
 static really_inline
 char *findMutableShermanState(char *sherman_base_offset, u16 sherman_base,
                               u16 s) {
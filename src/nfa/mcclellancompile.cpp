@@ -56,6 +56,7 @@
 #include <cstring>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <set>
 #include <vector>
 
@@ -415,9 +416,72 @@ void fillInAux(mstate_aux *aux, dstate_id_t i, const dfa_info &info,
                              : info.raw.start_floating);
 }
 
+/** Number of steps of the random walk used by \ref estimateStateHeat. */
+#define STATE_HEAT_WALK_LENGTH 16
+
+/**
+ * \brief Estimate how often each state is visited when scanning.
+ *
+ * We have no corpus at compile time, so we use the expected number of visits
+ * to each state during a short walk over uniformly random bytes, starting from
+ * the start states. Input that does not match tends to keep the DFA near its
+ * start states, and this captures that well enough to decide which states
+ * should share cache lines in the transition table.
+ */
+static
+vector<double> estimateStateHeat(const dfa_info &info) {
+    const raw_dfa &raw = info.raw;
+
+    // Probability of each symbol on random input; special symbols (TOP, EOD)
+    // never appear in the data.
+    vector<double> sym_weight(info.alpha_size, 0.0);
+    for (u32 c = 0; c < ALPHABET_SIZE; c++) {
+        sym_weight[info.alpha_remap[c]] += 1.0 / ALPHABET_SIZE;
+    }
+
+    vector<double> curr(info.size(), 0.0);
+    vector<double> next(info.size(), 0.0);
+    vector<double> heat(info.size(), 0.0);
+
+    // Split our time between the starts, as a floating start is also used by
+    // the rest of a block once its anchored prefix has died.
+    const dstate_id_t starts[] = {raw.start_anchored, raw.start_floating};
+    for (dstate_id_t s : starts) {
+        if (s != DEAD_STATE) {
+            curr[s] += 0.5;
+        }
+    }
+
+    for (u32 step = 0; step < STATE_HEAT_WALK_LENGTH; step++) {
+        fill(next.begin(), next.end(), 0.0);
+        for (u32 i = 1; i < info.size(); i++) {
+            if (curr[i] == 0.0) {
+                continue;
+            }
+            heat[i] += curr[i];
+            const dstate &ds = info.states[i];
+            for (u32 sym = 0; sym < info.alpha_size; sym++) {
+                if (sym_weight[sym] != 0.0) {
+                    next[ds.next[sym]] += curr[i] * sym_weight[sym];
+                }
+            }
+        }
+
+        // Scanning restarts from the floating start when the DFA dies.
+        if (raw.start_floating != DEAD_STATE) {
+            next[raw.start_floating] += next[DEAD_STATE];
+        }
+        next[DEAD_STATE] = 0.0;
+        curr.swap(next);
+    }
+
+    return heat;
+}
+
 /* returns non-zero on error */
 static
-int allocateFSN16(dfa_info &info, dstate_id_t *sherman_base) {
+int allocateFSN16(dfa_info &info, const Grey &grey,
+                  dstate_id_t *sherman_base) {
     info.states[0].impl_id = 0; /* dead is always 0 */
 
     vector<dstate_id_t> norm;
@@ -437,6 +501,16 @@ int allocateFSN16(dfa_info &info, dstate_id_t *sherman_base) {
         }
     }
 
+    /* Rows of the transition table are laid out in impl id order, so give the
+     * hottest normal states the lowest ids to keep their rows together. */
+    if (grey.mcclellanHotStateOrder) {
+        const vector<double> heat = estimateStateHeat(info);
+        stable_sort(norm.begin(), norm.end(),
+                    [&heat](dstate_id_t a, dstate_id_t b) {
+                        return heat[a] > heat[b];
+                    });
+    }
+
     dstate_id_t next_norm = 1;
     for (const dstate_id_t &s : norm) {
         info.states[s].impl_id = next_norm++;
@@ -455,9 +529,188 @@ int allocateFSN16(dfa_info &info, dstate_id_t *sherman_base) {
     return (next_sherman - 1) != ((next_sherman - 1) & STATE_MASK);
 }
 
+namespace {
+
+/** \brief Row displacement layout of a 16-bit DFA, in raw state ids. */
+struct RowDispLayout {
+    vector<u16> base; //!< per state: index of the entry for symbol 0
+    vector<dstate_id_t> deflt; //!< per state: default successor
+    u32 entries = 0; //!< length of the shared entry array
+};
+
+} // namespace
+
+/**
+ * \brief Overlays the rows of the DFA, with the most common successor of
+ * each state removed as its default, first-fit into one array.
+ *
+ * Returns false if the layout would need more than \a max_entries entries
+ * (or a base too large for mcclellan_row).
+ */
+static
+bool buildRowDisp(const dfa_info &info, u32 max_entries,
+                  RowDispLayout &layout) {
+    const u16 alpha = info.impl_alpha_size;
+    const size_t n = info.size();
+    max_entries = min(max_entries, (u32)UINT16_MAX + 1);
+    layout.base.assign(n, 0);
+    layout.deflt.assign(n, DEAD_STATE);
+
+    vector<vector<u16>> exceptions(n);
+    for (size_t i = 0; i < n; i++) {
+        const auto &next = info.states[i].next;
+        map<dstate_id_t, u32> freq;
+        for (u16 c = 0; c < alpha; c++) {
+            freq[next[c]]++;
+        }
+        dstate_id_t best = DEAD_STATE;
+        u32 best_count = 0;
+        for (const auto &m : freq) {
+            if (m.second > best_count) {
+                best = m.first;
+                best_count = m.second;
+            }
+        }
+        layout.deflt[i] = best;
+        for (u16 c = 0; c < alpha; c++) {
+            if (next[c] != best) {
+                exceptions[i].push_back(c);
+            }
+        }
+    }
+
+    // Densest rows first, as they are the hardest to fit.
+    vector<dstate_id_t> order(n);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(),
+                [&exceptions](dstate_id_t a, dstate_id_t b) {
+                    return exceptions[a].size() > exceptions[b].size();
+                });
+
+    vector<bool> used;
+    u32 first_free = 0;
+    u32 entries = alpha; /* every row may be probed over the whole alphabet */
+    for (dstate_id_t i : order) {
+        const vector<u16> &exc = exceptions[i];
+        if (exc.empty()) {
+            continue; /* any base will do: probes never match */
+        }
+
+        u32 b = first_free > exc.front() ? first_free - exc.front() : 0;
+        for (;; b++) {
+            if (b + alpha > max_entries) {
+                DEBUG_PRINTF("row displacement too big\n");
+                return false;
+            }
+            if (none_of(exc.begin(), exc.end(), [&](u16 c) {
+                    return b + c < used.size() && used[b + c];
+                })) {
+                break;
+            }
+        }
+
+        if (used.size() < b + alpha) {
+            used.resize(b + alpha, false);
+        }
+        for (u16 c : exc) {
+            used[b + c] = true;
+        }
+        while (first_free < used.size() && used[first_free]) {
+            first_free++;
+        }
+        layout.base[i] = verify_u16(b);
+        entries = max(entries, b + alpha);
+    }
+
+    if (entries > max_entries) {
+        return false;
+    }
+    layout.entries = entries;
+    return true;
+}
+
+/**
+ * \brief Decides whether to lay out the rows of a 16-bit DFA displaced, which
+ * we do if the table (rows and Sherman states) is at least
+ * Grey::mcclellanRowDispMinSize bytes and displacement at least halves it.
+ * Fills in \a layout if so.
+ */
+static
+bool chooseRowDisp(const dfa_info &info, const Grey &grey,
+                   RowDispLayout &layout) {
+    if (!grey.mcclellanRowDispMinSize) {
+        return false;
+    }
+
+    size_t normal_count = 0;
+    for (size_t i = 0; i < info.size(); i++) {
+        if (!info.is_sherman(i)) {
+            normal_count++;
+        }
+    }
+    size_t table_size = ((size_t)1 << info.getAlphaShift()) * sizeof(u16)
+                      * normal_count + calcShermanRegionSize(info);
+    if (table_size < grey.mcclellanRowDispMinSize) {
+        return false;
+    }
+
+    size_t rows_size = ROUNDUP_16(sizeof(mcclellan_row) * info.size());
+    if (rows_size * 2 >= table_size) {
+        return false;
+    }
+    u32 max_entries = (table_size / 2 - rows_size) / sizeof(u32);
+    if (!buildRowDisp(info, max_entries, layout)) {
+        return false;
+    }
+
+    DEBUG_PRINTF("row displacement: %zu bytes rather than %zu\n",
+                 rows_size + layout.entries * sizeof(u32), table_size);
+    return true;
+}
+
+/** \brief Returns impl id \a s with the accept and accel flags of its
+ * state. */
+static
+u16 flagState(NFA *n, u16 s) {
+    const mstate_aux *aux = getAux(n, s);
+    if (aux->accept) {
+        s |= ACCEPT_FLAG;
+    }
+    if (aux->accel_offset) {
+        s |= ACCEL_FLAG;
+    }
+    return s;
+}
+
+/** \brief Writes the displaced rows of a 16-bit DFA; aux structures must
+ * already be filled in. */
+static
+void fillRowDisp(NFA *n, const dfa_info &info, const RowDispLayout &layout,
+                 mcclellan_row *rows, u32 *entries) {
+    fill_n(entries, layout.entries, (u32)ROWDISP_CHECK_NONE);
+
+    for (size_t i = 0; i < info.size(); i++) {
+        u16 fs = info.implId(i);
+        mcclellan_row &row = rows[fs];
+        row.base = layout.base[i];
+        row.deflt = flagState(n, info.implId(layout.deflt[i]));
+
+        for (u16 c = 0; c < info.impl_alpha_size; c++) {
+            dstate_id_t next = info.states[i].next[c];
+            if (next == layout.deflt[i]) {
+                continue;
+            }
+            u32 &e = entries[row.base + c];
+            assert(e == ROWDISP_CHECK_NONE);
+            e = (u32)fs | (u32)flagState(n, info.implId(next)) << 16;
+        }
+    }
+}
+
 static
 aligned_unique_ptr<NFA> mcclellanCompile16(dfa_info &info,
                                            const CompileContext &cc,
+                                           bool mcclellan_runtime,
                                            set<dstate_id_t> *accel_states) {
     DEBUG_PRINTF("building mcclellan 16\n");
 
@@ -469,8 +722,20 @@ aligned_unique_ptr<NFA> mcclellanCompile16(dfa_info &info,
     u8 alphaShift = info.getAlphaShift();
     assert(alphaShift <= 8);
 
+    /* displaced rows replace Sherman states, which would otherwise need their
+     * daddy's row to be at a fixed place */
+    RowDispLayout rowdisp;
+    bool use_rowdisp = mcclellan_runtime
+                    && chooseRowDisp(info, cc.grey, rowdisp);
+    if (use_rowdisp) {
+        for (auto &e : info.extra) {
+            e.shermanState = false;
+            e.daddytaken = 0;
+        }
+    }
+
     u16 count_real_states;
-    if (allocateFSN16(info, &count_real_states)) {
+    if (allocateFSN16(info, cc.grey, &count_real_states)) {
         DEBUG_PRINTF("failed to allocate state numbers, %zu states total\n",
                      info.size());
         return nullptr;
@@ -482,6 +747,13 @@ aligned_unique_ptr<NFA> mcclellanCompile16(dfa_info &info,
 
     size_t tran_size = (1 << info.getAlphaShift())
         * sizeof(u16) * count_real_states;
+    size_t rowdisp_offset = 0;
+    if (use_rowdisp) {
+        rowdisp_offset = ROUNDUP_16(sizeof(NFA) + sizeof(mcclellan)
+                                    + sizeof(mcclellan_row) * info.size());
+        tran_size = rowdisp_offset + sizeof(u32) * rowdisp.entries
+                  - sizeof(NFA) - sizeof(mcclellan);
+    }
 
     size_t aux_size = sizeof(mstate_aux) * info.size();
 
@@ -527,9 +799,11 @@ aligned_unique_ptr<NFA> mcclellanCompile16(dfa_info &info,
 
         assert(fs < count_real_states);
 
-        for (size_t j = 0; j < info.impl_alpha_size; j++) {
-            succ_table[(fs << alphaShift) + j] =
-                info.implId(info.states[i].next[j]);
+        if (!use_rowdisp) {
+            for (size_t j = 0; j < info.impl_alpha_size; j++) {
+                succ_table[(fs << alphaShift) + j] =
+                    info.implId(info.states[i].next[j]);
+            }
         }
 
         fillInAux(&aux[fs], i, info, reports, reports_eod, reportOffsets);
@@ -599,7 +873,14 @@ aligned_unique_ptr<NFA> mcclellanCompile16(dfa_info &info,
         }
     }
 
-    markEdges(nfa.get(), succ_table, info);
+    if (use_rowdisp) {
+        m->flags |= MCCLELLAN_FLAG_ROWDISP;
+        m->rowdisp_offset = verify_u32(rowdisp_offset);
+        fillRowDisp(nfa.get(), info, rowdisp, (mcclellan_row *)succ_table,
+                    (u32 *)(nfa_base + rowdisp_offset));
+    } else {
+        markEdges(nfa.get(), succ_table, info);
+    }
 
     if (accel_states && nfa) {
         fillAccelOut(accel_escape_info, accel_states);
@@ -684,9 +965,44 @@ void allocateFSN8(dfa_info &info,
     }
 }
 
+/** \brief Size in bytes of the two-byte stride table for an 8-bit DFA, or
+ * zero if it would exceed the grey box budget. */
+static
+size_t stride2Size(const dfa_info &info, bool mcclellan_runtime,
+                   const Grey &grey) {
+    if (!mcclellan_runtime || !grey.mcclellanStride2MaxSize) {
+        return 0;
+    }
+    size_t size = sizeof(u16) * info.size() << (2 * info.getAlphaShift());
+    if (size > grey.mcclellanStride2MaxSize) {
+        DEBUG_PRINTF("stride2 table too big (%zu bytes)\n", size);
+        return 0;
+    }
+    return size;
+}
+
+/** \brief Fills in the two-byte stride table from the (already built)
+ * single-byte transition table. */
+static
+void fillStride2(const mcclellan *m, const u8 *succ_table, u16 *stride2) {
+    const u32 as = m->alphaShift;
+    const u32 width = 1U << as;
+    for (u32 s = 0; s < m->state_count; s++) {
+        for (u32 a = 0; a < width; a++) {
+            u8 mid = succ_table[(s << as) + a];
+            u16 flag = mid >= m->accel_limit_8 ? MCCLELLAN_STRIDE2_MID : 0;
+            for (u32 b = 0; b < width; b++) {
+                u8 t = succ_table[((u32)mid << as) + b];
+                stride2[(s << (2 * as)) + (a << as) + b] = flag | t;
+            }
+        }
+    }
+}
+
 static
 aligned_unique_ptr<NFA> mcclellanCompile8(dfa_info &info,
                                           const CompileContext &cc,
+                                          bool mcclellan_runtime,
                                           set<dstate_id_t> *accel_states) {
     DEBUG_PRINTF("building mcclellan 8\n");
 
@@ -705,13 +1021,17 @@ aligned_unique_ptr<NFA> mcclellanCompile8(dfa_info &info,
     size_t accel_size = info.strat.accelSize() * accel_escape_info.size();
     size_t accel_offset = ROUNDUP_N(aux_offset + aux_size
                                      + ri->getReportListSize(), 32);
-    size_t total_size = accel_offset + accel_size;
+    size_t stride2_size = stride2Size(info, mcclellan_runtime, cc.grey);
+    size_t stride2_offset = ROUNDUP_CL(accel_offset + accel_size);
+    size_t total_size = stride2_size ? stride2_offset + stride2_size
+                                     : accel_offset + accel_size;
 
     DEBUG_PRINTF("aux_size %zu\n", aux_size);
     DEBUG_PRINTF("aux_offset %zu\n", aux_offset);
     DEBUG_PRINTF("rl size %u\n", ri->getReportListSize());
     DEBUG_PRINTF("accel_size %zu\n", accel_size);
     DEBUG_PRINTF("accel_offset %zu\n", accel_offset);
+    DEBUG_PRINTF("stride2_size %zu\n", stride2_size);
     DEBUG_PRINTF("total_size %zu\n", total_size);
 
     accel_offset -= sizeof(NFA); /* adj accel offset to be relative to m */
@@ -751,6 +1071,11 @@ aligned_unique_ptr<NFA> mcclellanCompile8(dfa_info &info,
 
     assert(accel_offset + sizeof(NFA) <= total_size);
 
+    if (stride2_size) {
+        m->stride2_offset = verify_u32(stride2_offset);
+        fillStride2(m, succ_table, (u16 *)(nfa_base + stride2_offset));
+    }
+
     DEBUG_PRINTF("rl size %zu\n", ri->size());
 
     if (accel_states && nfa) {
@@ -941,7 +1266,8 @@ bool is_cyclic_near(const raw_dfa &raw, dstate_id_t root) {
 
 aligned_unique_ptr<NFA> mcclellanCompile_i(raw_dfa &raw, accel_dfa_build_strat &strat,
                                            const CompileContext &cc,
-                                           set<dstate_id_t> *accel_states) {
+                                           set<dstate_id_t> *accel_states,
+                                           bool mcclellan_runtime) {
     u16 total_daddy = 0;
     dfa_info info(strat);
     bool using8bit = cc.grey.allowMcClellan8 && info.size() <= 256;
@@ -967,9 +1293,9 @@ aligned_unique_ptr<NFA> mcclellanCompile_i(raw_dfa &raw, accel_dfa_build_strat &
 
     aligned_unique_ptr<NFA> nfa;
     if (!using8bit) {
-        nfa = mcclellanCompile16(info, cc, accel_states);
+        nfa = mcclellanCompile16(info, cc, mcclellan_runtime, accel_states);
     } else {
-        nfa = mcclellanCompile8(info, cc, accel_states);
+        nfa = mcclellanCompile8(info, cc, mcclellan_runtime, accel_states);
     }
 
     if (has_eod_reports) {
@@ -984,7 +1310,7 @@ aligned_unique_ptr<NFA> mcclellanCompile(raw_dfa &raw, const CompileContext &cc,
                                          const ReportManager &rm,
                                          set<dstate_id_t> *accel_states) {
     mcclellan_build_strat mbs(raw, rm);
-    return mcclellanCompile_i(raw, mbs, cc, accel_states);
+    return mcclellanCompile_i(raw, mbs, cc, accel_states, true);
 }
 
 size_t mcclellan_build_strat::accelSize(void) const {
@@ -74,11 +74,14 @@ mcclellanCompile(raw_dfa &raw, const CompileContext &cc,
                  const ReportManager &rm,
                  std::set<dstate_id_t> *accel_states = nullptr);
 
-/* used internally by mcclellan/haig/gough compile process */
+/* used internally by mcclellan/haig/gough compile process; mcclellan_runtime
+ * permits the layouts that only the McClellan runtime understands (two-byte
+ * stride table, displaced rows) */
 ue2::aligned_unique_ptr<NFA>
 mcclellanCompile_i(raw_dfa &raw, accel_dfa_build_strat &strat,
                    const CompileContext &cc,
-                   std::set<dstate_id_t> *accel_states = nullptr);
+                   std::set<dstate_id_t> *accel_states = nullptr,
+                   bool mcclellan_runtime = false);
 
 /**
  * \brief Returns the width of the character reach at start.
@@ -96,9 +96,7 @@ void mcclellanGetTransitions(const NFA *n, u16 s, u16 *t) {
         const u16 *succ_table = (const u16 *)((const char *)m
                                               + sizeof(mcclellan));
         for (u16 c = 0; c < N_CHARS; c++) {
-            const u8 *addr = (const u8*)(succ_table + (((u32)base_s << as)
-                                                       + m->remap[c]));
-            t[c] = unaligned_load_u16(addr);
+            t[c] = doNormal16(m, succ_table, base_s, m->remap[c], as);
             t[c] &= STATE_MASK;
         }
 
@@ -177,6 +175,15 @@ void dumpAccelText(FILE *f, const union AccelAux *accel) {
     case ACCEL_DSHUFTI:
         fprintf(f, ":SS");
         break;
+    case ACCEL_DSHUFTI_DIST:
+        fprintf(f, ":S.S");
+        break;
+    case ACCEL_SHUFTI_DVERM:
+        fprintf(f, ":SVV");
+        break;
+    case ACCEL_LITERAL:
+        fprintf(f, ":L");
+        break;
     case ACCEL_TRUFFLE:
         fprintf(f, ":M");
         break;
@@ -198,6 +205,9 @@ void dumpAccelDot(FILE *f, u16 i, const union AccelAux *accel) {
         break;
     case ACCEL_SHUFTI:
     case ACCEL_DSHUFTI:
+    case ACCEL_DSHUFTI_DIST:
+    case ACCEL_SHUFTI_DVERM:
+    case ACCEL_LITERAL:
     case ACCEL_TRUFFLE:
         fprintf(f, "%u [ color = darkgreen style=diagonals ];\n", i);
         break;
@@ -407,6 +417,10 @@ void nfaExecMcClellan16_dumpText(const NFA *nfa, FILE *f) {
     dumpCommonHeader(f, m);
     fprintf(f, "sherman_limit: %d, sherman_end: %d\n", (int)m->sherman_limit,
             (int)m->sherman_end);
+    if (m->flags & MCCLELLAN_FLAG_ROWDISP) {
+        fprintf(f, "displaced rows: %u bytes of entries\n",
+                m->aux_offset - m->rowdisp_offset);
+    }
     fprintf(f, "\n");
 
     describeAlphabet(f, m);
@@ -427,6 +441,10 @@ void nfaExecMcClellan8_dumpText(const NFA *nfa, FILE *f) {
     dumpCommonHeader(f, m);
     fprintf(f, "accel_limit: %hu, accept_limit %hu\n", m->accel_limit_8,
             m->accept_limit_8);
+    if (m->stride2_offset) {
+        fprintf(f, "two-byte stride table: %u bytes\n",
+                (u32)sizeof(u16) * m->state_count << (2 * m->alphaShift));
+    }
     fprintf(f, "\n");
 
     describeAlphabet(f, m);
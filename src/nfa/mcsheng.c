@@ -0,0 +1,909 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mcsheng.h"
+
+#include "accel.h"
+#include "mcsheng_internal.h"
+#include "nfa_api.h"
+#include "nfa_api_queue.h"
+#include "nfa_internal.h"
+#include "util/bitutils.h"
+#include "util/compare.h"
+#include "util/simd_utils.h"
+#include "util/unaligned.h"
+#include "ue2common.h"
+
+#include "mcclellan_common_impl.h"
+
+static really_inline
+const struct mstate_aux *get_mcsheng_aux(const struct mcsheng *m, u32 s) {
+    const char *nfa = (const char *)m - sizeof(struct NFA);
+    const struct mstate_aux *aux
+        = s + (const struct mstate_aux *)(nfa + m->aux_offset);
+
+    assert(ISALIGNED(aux));
+    return aux;
+}
+
+static really_inline
+u32 mcshengEnableStarts(const struct mcsheng *m, u32 s) {
+    const struct mstate_aux *aux = get_mcsheng_aux(m, s);
+
+    DEBUG_PRINTF("enabling starts %u->%hu\n", s, aux->top);
+    return aux->top;
+}
+
+static really_inline
+u32 mcshengLoadState(const void *state, const u8 width) {
+    if (width == sizeof(u8)) {
+        return *(const u8 *)state;
+    }
+    assert(ISALIGNED_N(state, 2));
+    return *(const u16 *)state;
+}
+
+static really_inline
+void mcshengStoreState(void *state, u32 s, const u8 width) {
+    if (width == sizeof(u8)) {
+        *(u8 *)state = (u8)s;
+    } else {
+        assert(ISALIGNED_N(state, 2));
+        *(u16 *)state = (u16)s;
+    }
+}
+
+static really_inline
+char doComplexReport(NfaCallback cb, void *ctxt, const struct mcsheng *m,
+                     u32 s, u64a loc, char eod, u32 *const cached_accept_state,
+                     u32 *const cached_accept_id) {
+    DEBUG_PRINTF("reporting state = %u, loc=%llu, eod %hhu\n", s, loc, eod);
+
+    if (!eod && s == *cached_accept_state) {
+        if (cb(0, loc, *cached_accept_id, ctxt) == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING; /* termination requested */
+        }
+
+        return MO_CONTINUE_MATCHING; /* continue execution */
+    }
+
+    const struct mstate_aux *aux = get_mcsheng_aux(m, s);
+    size_t offset = eod ? aux->accept_eod : aux->accept;
+
+    assert(offset);
+    const struct report_list *rl
+        = (const void *)((const char *)m + offset - sizeof(struct NFA));
+    assert(ISALIGNED(rl));
+
+    DEBUG_PRINTF("report list size %u\n", rl->count);
+    u32 count = rl->count;
+
+    if (!eod && count == 1) {
+        *cached_accept_state = s;
+        *cached_accept_id = rl->report[0];
+
+        DEBUG_PRINTF("reporting %u\n", rl->report[0]);
+        if (cb(0, loc, rl->report[0], ctxt) == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING; /* termination requested */
+        }
+
+        return MO_CONTINUE_MATCHING; /* continue execution */
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        DEBUG_PRINTF("reporting %u\n", rl->report[i]);
+        if (cb(0, loc, rl->report[i], ctxt) == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING; /* termination requested */
+        }
+    }
+
+    return MO_CONTINUE_MATCHING; /* continue execution */
+}
+
+static really_inline
+char mcshengReport(NfaCallback cb, void *ctxt, const struct mcsheng *m,
+                   u32 s, u64a loc, char single, u32 *const cached_accept_state,
+                   u32 *const cached_accept_id) {
+    if (single) {
+        DEBUG_PRINTF("reporting %u\n", m->arb_report);
+        return cb(0, loc, m->arb_report, ctxt) == MO_HALT_MATCHING
+                   ? MO_HALT_MATCHING : MO_CONTINUE_MATCHING;
+    }
+    return doComplexReport(cb, ctxt, m, s, loc, 0, cached_accept_state,
+                           cached_accept_id);
+}
+
+static really_inline
+const u8 *mcshengDoAccel(const struct mcsheng *m, u32 s, const u8 *c,
+                         const u8 *c_end, const u8 **min_accel_offset) {
+    const struct mstate_aux *aux = get_mcsheng_aux(m, s);
+    u32 accel_offset = aux->accel_offset;
+    assert(accel_offset);
+
+    const union AccelAux *aaux
+        = (const void *)((const char *)m + accel_offset);
+    const u8 *c2 = run_accel(aaux, c, c_end);
+
+    if (c2 < *min_accel_offset + BAD_ACCEL_DIST) {
+        *min_accel_offset = c2 + BIG_ACCEL_PENALTY;
+    } else {
+        *min_accel_offset = c2 + SMALL_ACCEL_PENALTY;
+    }
+
+    if (*min_accel_offset >= c_end - ACCEL_MIN_LEN) {
+        *min_accel_offset = c_end;
+    }
+
+    DEBUG_PRINTF("advanced %zd, next accel chance in %zd/%zd\n",
+                 c2 - c, *min_accel_offset - c2, c_end - c2);
+    return c2;
+}
+
+/**
+ * \brief Main McSheng execution loop.
+ *
+ * Runs the sheng kernel while the DFA remains in the sheng region; when a
+ * transition leaves it, the byte is rerun from the McClellan table and we
+ * stay with the table until a transition lands back in the sheng region.
+ *
+ * width is the size of the McClellan table entries (1 or 2 bytes), and along
+ * with mode is expected to be a compile-time constant.
+ */
+static really_inline
+char mcshengExec_i(const struct mcsheng *m, u32 *state, const u8 *buf,
+                   size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                   char single, const u8 **c_final, enum MatchMode mode,
+                   const u8 width) {
+    u32 s = *state;
+    const u8 *c = buf, *c_end = buf + len;
+    const m128 *masks = m->sheng_masks;
+    const u8 *succ_table_8 = (const u8 *)m + sizeof(struct mcsheng);
+    const u16 *succ_table_16 = (const u16 *)succ_table_8;
+    const u32 as = m->alphaShift;
+    const u32 sheng_end = m->sheng_end;
+    const u32 accel_limit = m->accel_limit_8;
+    const u32 accept_limit = m->accept_limit_8;
+
+    assert(ISALIGNED_N(succ_table_16, 2));
+
+    u32 cached_accept_id = 0;
+    u32 cached_accept_state = 0;
+
+    DEBUG_PRINTF("s: %u, len %zu, sheng_end %u\n", s, len, sheng_end);
+
+    const u8 *min_accel_offset = c;
+    if (!m->has_accel || len < ACCEL_MIN_LEN) {
+        min_accel_offset = c_end;
+    }
+
+    /* sheng state flags that always need the slow path */
+    const u8 sheng_stop = MCSHENG_STATE_EXIT
+                        | (mode != NO_MATCHES ? MCSHENG_STATE_ACCEPT : 0);
+
+    while (c < c_end && s) {
+        if (s < sheng_end) {
+            m128 cur_state = set16x8((u8)s);
+            char exited = 0;
+
+            while (c < c_end) {
+                const u8 interest = sheng_stop
+                    | (c >= min_accel_offset ? MCSHENG_STATE_ACCEL : 0);
+
+                if (c + 4 <= c_end) {
+                    m128 s1 = pshufb(masks[c[0]], cur_state);
+                    u8 b1 = movd(s1);
+                    m128 s2 = pshufb(masks[c[1]], s1);
+                    u8 b2 = movd(s2);
+                    m128 s3 = pshufb(masks[c[2]], s2);
+                    u8 b3 = movd(s3);
+                    m128 s4 = pshufb(masks[c[3]], s3);
+                    u8 b4 = movd(s4);
+
+                    if (!((b1 | b2 | b3 | b4) & interest)) {
+                        cur_state = s4;
+                        c += 4;
+                        if (!b4) {
+                            break; /* dead */
+                        }
+                        continue;
+                    }
+                }
+
+                m128 next_state = pshufb(masks[*c], cur_state);
+                u8 b = movd(next_state);
+                c++;
+                DEBUG_PRINTF("c: %02hhx sheng s: %02hhx\n", *(c - 1), b);
+
+                if (b & MCSHENG_STATE_EXIT) {
+                    /* leaving the sheng region: rerun this byte from the
+                     * McClellan table */
+                    s = b & MCSHENG_STATE_MASK;
+                    c--;
+                    exited = 1;
+                    break;
+                }
+
+                u32 sheng_s = b & MCSHENG_STATE_MASK;
+                if (mode != NO_MATCHES && (b & MCSHENG_STATE_ACCEPT)) {
+                    if (mode == STOP_AT_MATCH) {
+                        *state = sheng_s;
+                        *c_final = c - 1;
+                        return MO_CONTINUE_MATCHING;
+                    }
+
+                    u64a loc = (c - 1) - buf + offAdj + 1;
+                    if (mcshengReport(cb, ctxt, m, sheng_s, loc, single,
+                                      &cached_accept_state,
+                                      &cached_accept_id)
+                        == MO_HALT_MATCHING) {
+                        return MO_HALT_MATCHING;
+                    }
+                } else if ((b & MCSHENG_STATE_ACCEL)
+                           && c >= min_accel_offset) {
+                    DEBUG_PRINTF("skipping\n");
+                    c = mcshengDoAccel(m, sheng_s, c, c_end,
+                                       &min_accel_offset);
+                }
+
+                cur_state = next_state;
+                if (!sheng_s) {
+                    break; /* dead */
+                }
+            }
+
+            if (!exited) {
+                s = movd(cur_state) & MCSHENG_STATE_MASK;
+                continue;
+            }
+        }
+
+        /* McClellan region */
+        do {
+            u8 cprime = m->remap[*(c++)];
+            DEBUG_PRINTF("c: %02hhx cp:%02hhx (s=%u)\n", *(c - 1), cprime, s);
+
+            if (width == sizeof(u8)) {
+                s = succ_table_8[(s << as) + cprime];
+                DEBUG_PRINTF("s: %u\n", s);
+
+                if (s < sheng_end) {
+                    if (mode != NO_MATCHES && s
+                        && get_mcsheng_aux(m, s)->accept) {
+                        goto report;
+                    }
+                    break;
+                }
+
+                if (s >= accel_limit) { /* accept_limit >= accel_limit */
+                    if (mode != NO_MATCHES && s >= accept_limit) {
+                        goto report;
+                    } else if (c >= min_accel_offset
+                               && get_mcsheng_aux(m, s)->accel_offset) {
+                        DEBUG_PRINTF("skipping\n");
+                        c = mcshengDoAccel(m, s, c, c_end, &min_accel_offset);
+                    }
+                }
+                continue;
+            } else {
+                u16 e = succ_table_16[(s << as) + cprime];
+                s = e & STATE_MASK;
+                DEBUG_PRINTF("s: %u (flags %hx)\n", s, (u16)(e & ~STATE_MASK));
+
+                if (mode != NO_MATCHES && (e & ACCEPT_FLAG)) {
+                    goto report;
+                } else if ((e & ACCEL_FLAG) && c >= min_accel_offset) {
+                    DEBUG_PRINTF("skipping\n");
+                    c = mcshengDoAccel(m, s, c, c_end, &min_accel_offset);
+                }
+
+                if (s < sheng_end) {
+                    break;
+                }
+                continue;
+            }
+
+        report:
+            if (mode == STOP_AT_MATCH) {
+                *state = s;
+                *c_final = c - 1;
+                return MO_CONTINUE_MATCHING;
+            }
+
+            if (mcshengReport(cb, ctxt, m, s, (c - 1) - buf + offAdj + 1,
+                              single, &cached_accept_state, &cached_accept_id)
+                == MO_HALT_MATCHING) {
+                return MO_HALT_MATCHING;
+            }
+        } while (c < c_end && s >= sheng_end);
+    }
+
+    if (mode == STOP_AT_MATCH) {
+        *c_final = c_end;
+    }
+    *state = s;
+
+    return MO_CONTINUE_MATCHING;
+}
+
+static never_inline
+char mcshengExec8_i_cb(const struct mcsheng *m, u32 *state, const u8 *buf,
+                       size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                       char single, const u8 **final_point) {
+    return mcshengExec_i(m, state, buf, len, offAdj, cb, ctxt, single,
+                         final_point, CALLBACK_OUTPUT, sizeof(u8));
+}
+
+static never_inline
+char mcshengExec8_i_sam(const struct mcsheng *m, u32 *state, const u8 *buf,
+                        size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                        char single, const u8 **final_point) {
+    return mcshengExec_i(m, state, buf, len, offAdj, cb, ctxt, single,
+                         final_point, STOP_AT_MATCH, sizeof(u8));
+}
+
+static never_inline
+char mcshengExec8_i_nm(const struct mcsheng *m, u32 *state, const u8 *buf,
+                       size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                       char single, const u8 **final_point) {
+    return mcshengExec_i(m, state, buf, len, offAdj, cb, ctxt, single,
+                         final_point, NO_MATCHES, sizeof(u8));
+}
+
+static really_inline
+char mcshengExec8_i_ni(const struct mcsheng *m, u32 *state, const u8 *buf,
+                       size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                       char single, const u8 **final_point,
+                       enum MatchMode mode) {
+    if (mode == CALLBACK_OUTPUT) {
+        return mcshengExec8_i_cb(m, state, buf, len, offAdj, cb, ctxt,
+                                  single, final_point);
+    } else if (mode == STOP_AT_MATCH) {
+        return mcshengExec8_i_sam(m, state, buf, len, offAdj, cb, ctxt,
+                                   single, final_point);
+    } else {
+        assert(mode == NO_MATCHES);
+        return mcshengExec8_i_nm(m, state, buf, len, offAdj, cb, ctxt,
+                                  single, final_point);
+    }
+}
+
+static never_inline
+char mcshengExec16_i_cb(const struct mcsheng *m, u32 *state, const u8 *buf,
+                        size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                        char single, const u8 **final_point) {
+    return mcshengExec_i(m, state, buf, len, offAdj, cb, ctxt, single,
+                         final_point, CALLBACK_OUTPUT, sizeof(u16));
+}
+
+static never_inline
+char mcshengExec16_i_sam(const struct mcsheng *m, u32 *state, const u8 *buf,
+                         size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                         char single, const u8 **final_point) {
+    return mcshengExec_i(m, state, buf, len, offAdj, cb, ctxt, single,
+                         final_point, STOP_AT_MATCH, sizeof(u16));
+}
+
+static never_inline
+char mcshengExec16_i_nm(const struct mcsheng *m, u32 *state, const u8 *buf,
+                        size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                        char single, const u8 **final_point) {
+    return mcshengExec_i(m, state, buf, len, offAdj, cb, ctxt, single,
+                         final_point, NO_MATCHES, sizeof(u16));
+}
+
+static really_inline
+char mcshengExec16_i_ni(const struct mcsheng *m, u32 *state, const u8 *buf,
+                        size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                        char single, const u8 **final_point,
+                        enum MatchMode mode) {
+    if (mode == CALLBACK_OUTPUT) {
+        return mcshengExec16_i_cb(m, state, buf, len, offAdj, cb, ctxt,
+                                  single, final_point);
+    } else if (mode == STOP_AT_MATCH) {
+        return mcshengExec16_i_sam(m, state, buf, len, offAdj, cb, ctxt,
+                                   single, final_point);
+    } else {
+        assert(mode == NO_MATCHES);
+        return mcshengExec16_i_nm(m, state, buf, len, offAdj, cb, ctxt,
+                                  single, final_point);
+    }
+}
+
+static really_inline
+char mcshengExec_ni(const struct mcsheng *m, u32 *state, const u8 *buf,
+                    size_t len, u64a offAdj, NfaCallback cb, void *ctxt,
+                    char single, const u8 **final_point, enum MatchMode mode,
+                    const u8 width) {
+    if (width == sizeof(u8)) {
+        return mcshengExec8_i_ni(m, state, buf, len, offAdj, cb, ctxt, single,
+                                 final_point, mode);
+    } else {
+        return mcshengExec16_i_ni(m, state, buf, len, offAdj, cb, ctxt,
+                                  single, final_point, mode);
+    }
+}
+
+static really_inline
+char mcshengCheckEOD(const struct NFA *nfa, u32 s, u64a offset,
+                     NfaCallback cb, void *ctxt) {
+    const struct mcsheng *m = getImplNfa(nfa);
+    const struct mstate_aux *aux = get_mcsheng_aux(m, s);
+
+    if (!aux->accept_eod) {
+        return MO_CONTINUE_MATCHING;
+    }
+    return doComplexReport(cb, ctxt, m, s, offset, 1, NULL, NULL);
+}
+
+static really_inline
+char nfaExecMcSheng_Q2i(const struct NFA *n, u64a offset, const u8 *buffer,
+                        const u8 *hend, NfaCallback cb, void *context,
+                        struct mq *q, char single, s64a end,
+                        enum MatchMode mode, const u8 width) {
+    const struct mcsheng *m = getImplNfa(n);
+    s64a sp;
+
+    u32 s = mcshengLoadState(q->state, width);
+
+    if (q->report_current) {
+        assert(s);
+        assert(get_mcsheng_aux(m, s)->accept);
+
+        int rv;
+        if (single) {
+            DEBUG_PRINTF("reporting %u\n", m->arb_report);
+            rv = cb(0, q_cur_offset(q), m->arb_report, context);
+        } else {
+            u32 cached_accept_id = 0;
+            u32 cached_accept_state = 0;
+
+            rv = doComplexReport(cb, context, m, s, q_cur_offset(q), 0,
+                                 &cached_accept_state, &cached_accept_id);
+        }
+
+        q->report_current = 0;
+
+        if (rv == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING;
+        }
+    }
+
+    sp = q_cur_loc(q);
+    q->cur++;
+
+    const u8 *cur_buf = sp < 0 ? hend : buffer;
+
+    char report = 1;
+    if (mode == CALLBACK_OUTPUT) {
+        /* we are starting inside the history buffer: matches are suppressed */
+        report = !(sp < 0);
+    }
+
+    assert(q->cur);
+    if (mode != NO_MATCHES && q->items[q->cur - 1].location > end) {
+        DEBUG_PRINTF("this is as far as we go\n");
+        q->cur--;
+        q->items[q->cur].type = MQE_START;
+        q->items[q->cur].location = end;
+        mcshengStoreState(q->state, s, width);
+        return MO_ALIVE;
+    }
+
+    while (1) {
+        assert(q->cur < q->end);
+        s64a ep = q->items[q->cur].location;
+        if (mode != NO_MATCHES) {
+            ep = MIN(ep, end);
+        }
+
+        assert(ep >= sp);
+
+        s64a local_ep = ep;
+        if (sp < 0) {
+            local_ep = MIN(0, ep);
+        }
+
+        /* do main buffer region */
+        const u8 *final_look;
+        if (mcshengExec_ni(m, &s, cur_buf + sp, local_ep - sp, offset + sp,
+                           cb, context, single, &final_look,
+                           report ? mode : NO_MATCHES, width)
+            == MO_HALT_MATCHING) {
+            assert(report);
+            mcshengStoreState(q->state, 0, width);
+            return 0;
+        }
+        if (mode == STOP_AT_MATCH && final_look != cur_buf + local_ep) {
+            DEBUG_PRINTF("this is as far as we go\n");
+            assert(q->cur);
+            DEBUG_PRINTF("state %u final_look %zd\n", s,
+                         final_look - cur_buf);
+            q->cur--;
+            q->items[q->cur].type = MQE_START;
+            q->items[q->cur].location = final_look - cur_buf + 1; /* due to
+                                                                   * early -1 */
+            mcshengStoreState(q->state, s, width);
+            return MO_MATCHES_PENDING;
+        }
+
+        assert(q->cur);
+        if (mode != NO_MATCHES && q->items[q->cur].location > end) {
+            DEBUG_PRINTF("this is as far as we go\n");
+            q->cur--;
+            q->items[q->cur].type = MQE_START;
+            q->items[q->cur].location = end;
+            mcshengStoreState(q->state, s, width);
+            return MO_ALIVE;
+        }
+
+        sp = local_ep;
+
+        if (sp == 0) {
+            cur_buf = buffer;
+            report = 1;
+        }
+
+        if (sp != ep) {
+            continue;
+        }
+
+        switch (q->items[q->cur].type) {
+        case MQE_TOP:
+            assert(sp + offset || !s);
+            if (sp + offset == 0) {
+                s = m->start_anchored;
+                break;
+            }
+            s = mcshengEnableStarts(m, s);
+            break;
+        case MQE_END:
+            mcshengStoreState(q->state, s, width);
+            q->cur++;
+            return s ? MO_ALIVE : 0;
+        default:
+            assert(!"invalid queue event");
+        }
+
+        q->cur++;
+    }
+}
+
+static really_inline really_flatten
+char nfaExecMcSheng_Bi(const struct NFA *n, u64a offset, const u8 *buffer,
+                       size_t length, NfaCallback cb, void *context,
+                       char single, const u8 width) {
+    const struct mcsheng *m = getImplNfa(n);
+    u32 s = m->start_anchored;
+
+    if (mcshengExec_i(m, &s, buffer, length, offset, cb, context, single,
+                      NULL, CALLBACK_OUTPUT, width)
+        == MO_HALT_MATCHING) {
+        return 0;
+    }
+
+    const struct mstate_aux *aux = get_mcsheng_aux(m, s);
+
+    if (aux->accept_eod) {
+        doComplexReport(cb, context, m, s, offset + length, 1, NULL, NULL);
+    }
+
+    return !!s;
+}
+
+char nfaExecMcSheng8_B(const struct NFA *n, u64a offset, const u8 *buffer,
+                       size_t length, NfaCallback cb, void *context) {
+    assert(n->type == MCSHENG_NFA_8);
+    const struct mcsheng *m = getImplNfa(n);
+
+    if (m->flags & MCSHENG_FLAG_SINGLE) {
+        return nfaExecMcSheng_Bi(n, offset, buffer, length, cb, context, 1,
+                                 sizeof(u8));
+    } else {
+        return nfaExecMcSheng_Bi(n, offset, buffer, length, cb, context, 0,
+                                 sizeof(u8));
+    }
+}
+
+char nfaExecMcSheng16_B(const struct NFA *n, u64a offset, const u8 *buffer,
+                        size_t length, NfaCallback cb, void *context) {
+    assert(n->type == MCSHENG_NFA_16);
+    const struct mcsheng *m = getImplNfa(n);
+
+    if (m->flags & MCSHENG_FLAG_SINGLE) {
+        return nfaExecMcSheng_Bi(n, offset, buffer, length, cb, context, 1,
+                                 sizeof(u16));
+    } else {
+        return nfaExecMcSheng_Bi(n, offset, buffer, length, cb, context, 0,
+                                 sizeof(u16));
+    }
+}
+
+char nfaExecMcSheng8_Q(const struct NFA *n, struct mq *q, s64a end) {
+    assert(n->type == MCSHENG_NFA_8);
+    const struct mcsheng *m = getImplNfa(n);
+    const u8 *hend = q->history + q->hlength;
+
+    return nfaExecMcSheng_Q2i(n, q->offset, q->buffer, hend, q->cb,
+                              q->context, q, m->flags & MCSHENG_FLAG_SINGLE,
+                              end, CALLBACK_OUTPUT, sizeof(u8));
+}
+
+char nfaExecMcSheng16_Q(const struct NFA *n, struct mq *q, s64a end) {
+    assert(n->type == MCSHENG_NFA_16);
+    const struct mcsheng *m = getImplNfa(n);
+    const u8 *hend = q->history + q->hlength;
+
+    return nfaExecMcSheng_Q2i(n, q->offset, q->buffer, hend, q->cb,
+                              q->context, q, m->flags & MCSHENG_FLAG_SINGLE,
+                              end, CALLBACK_OUTPUT, sizeof(u16));
+}
+
+char nfaExecMcSheng8_Q2(const struct NFA *n, struct mq *q, s64a end) {
+    assert(n->type == MCSHENG_NFA_8);
+    const struct mcsheng *m = getImplNfa(n);
+    const u8 *hend = q->history + q->hlength;
+
+    return nfaExecMcSheng_Q2i(n, q->offset, q->buffer, hend, q->cb,
+                              q->context, q, m->flags & MCSHENG_FLAG_SINGLE,
+                              end, STOP_AT_MATCH, sizeof(u8));
+}
+
+char nfaExecMcSheng16_Q2(const struct NFA *n, struct mq *q, s64a end) {
+    assert(n->type == MCSHENG_NFA_16);
+    const struct mcsheng *m = getImplNfa(n);
+    const u8 *hend = q->history + q->hlength;
+
+    return nfaExecMcSheng_Q2i(n, q->offset, q->buffer, hend, q->cb,
+                              q->context, q, m->flags & MCSHENG_FLAG_SINGLE,
+                              end, STOP_AT_MATCH, sizeof(u16));
+}
+
+static
+char mcshengHasAccept(const struct mcsheng *m, const struct mstate_aux *aux,
+                      ReportID report) {
+    assert(m && aux);
+
+    if (!aux->accept) {
+        return 0;
+    }
+
+    const struct report_list *rl = (const struct report_list *)
+            ((const char *)m + aux->accept - sizeof(struct NFA));
+    assert(ISALIGNED_N(rl, 4));
+
+    DEBUG_PRINTF("report list has %u entries\n", rl->count);
+
+    for (u32 i = 0; i < rl->count; i++) {
+        if (rl->report[i] == report) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static really_inline
+char mcshengReportCurrent(const struct NFA *n, struct mq *q, const u8 width) {
+    const struct mcsheng *m = getImplNfa(n);
+    NfaCallback cb = q->cb;
+    void *ctxt = q->context;
+    u32 s = mcshengLoadState(q->state, width);
+    u8 single = m->flags & MCSHENG_FLAG_SINGLE;
+    u64a offset = q_cur_offset(q);
+    assert(q_cur_type(q) == MQE_START);
+    DEBUG_PRINTF("state %u\n", s);
+    assert(s);
+
+    if (get_mcsheng_aux(m, s)->accept) {
+        if (single) {
+            DEBUG_PRINTF("reporting %u\n", m->arb_report);
+            cb(0, offset, m->arb_report, ctxt);
+        } else {
+            u32 cached_accept_id = 0;
+            u32 cached_accept_state = 0;
+
+            doComplexReport(cb, ctxt, m, s, offset, 0, &cached_accept_state,
+                            &cached_accept_id);
+        }
+    }
+
+    return 0;
+}
+
+char nfaExecMcSheng8_reportCurrent(const struct NFA *n, struct mq *q) {
+    return mcshengReportCurrent(n, q, sizeof(u8));
+}
+
+char nfaExecMcSheng16_reportCurrent(const struct NFA *n, struct mq *q) {
+    return mcshengReportCurrent(n, q, sizeof(u16));
+}
+
+char nfaExecMcSheng8_inAccept(const struct NFA *n, ReportID report,
+                              struct mq *q) {
+    assert(n && q);
+
+    const struct mcsheng *m = getImplNfa(n);
+    u8 s = *(u8 *)q->state;
+    DEBUG_PRINTF("checking accepts for %hhu\n", s);
+
+    return mcshengHasAccept(m, get_mcsheng_aux(m, s), report);
+}
+
+char nfaExecMcSheng8_inAnyAccept(const struct NFA *n, struct mq *q) {
+    assert(n && q);
+
+    const struct mcsheng *m = getImplNfa(n);
+    u8 s = *(u8 *)q->state;
+    DEBUG_PRINTF("checking accepts for %hhu\n", s);
+
+    return !!get_mcsheng_aux(m, s)->accept;
+}
+
+char nfaExecMcSheng16_inAccept(const struct NFA *n, ReportID report,
+                               struct mq *q) {
+    assert(n && q);
+
+    const struct mcsheng *m = getImplNfa(n);
+    u16 s = *(u16 *)q->state;
+    DEBUG_PRINTF("checking accepts for %hu\n", s);
+
+    return mcshengHasAccept(m, get_mcsheng_aux(m, s), report);
+}
+
+char nfaExecMcSheng16_inAnyAccept(const struct NFA *n, struct mq *q) {
+    assert(n && q);
+
+    const struct mcsheng *m = getImplNfa(n);
+    u16 s = *(u16 *)q->state;
+    DEBUG_PRINTF("checking accepts for %hu\n", s);
+
+    return !!get_mcsheng_aux(m, s)->accept;
+}
+
+char nfaExecMcSheng8_QR(const struct NFA *n, struct mq *q, ReportID report) {
+    assert(n->type == MCSHENG_NFA_8);
+    const struct mcsheng *m = getImplNfa(n);
+    const u8 *hend = q->history + q->hlength;
+
+    char rv = nfaExecMcSheng_Q2i(n, q->offset, q->buffer, hend, q->cb,
+                                 q->context, q, m->flags & MCSHENG_FLAG_SINGLE,
+                                 0 /* end */, NO_MATCHES, sizeof(u8));
+    if (rv && nfaExecMcSheng8_inAccept(n, report, q)) {
+        return MO_MATCHES_PENDING;
+    } else {
+        return rv;
+    }
+}
+
+char nfaExecMcSheng16_QR(const struct NFA *n, struct mq *q, ReportID report) {
+    assert(n->type == MCSHENG_NFA_16);
+    const struct mcsheng *m = getImplNfa(n);
+    const u8 *hend = q->history + q->hlength;
+
+    char rv = nfaExecMcSheng_Q2i(n, q->offset, q->buffer, hend, q->cb,
+                                 q->context, q, m->flags & MCSHENG_FLAG_SINGLE,
+                                 0 /* end */, NO_MATCHES, sizeof(u16));
+    if (rv && nfaExecMcSheng16_inAccept(n, report, q)) {
+        return MO_MATCHES_PENDING;
+    } else {
+        return rv;
+    }
+}
+
+char nfaExecMcSheng8_initCompressedState(const struct NFA *nfa, u64a offset,
+                                         void *state, UNUSED u8 key) {
+    const struct mcsheng *m = getImplNfa(nfa);
+    u8 s = offset ? m->start_floating : m->start_anchored;
+    if (s) {
+        *(u8 *)state = s;
+        return 1;
+    }
+    return 0;
+}
+
+char nfaExecMcSheng16_initCompressedState(const struct NFA *nfa, u64a offset,
+                                          void *state, UNUSED u8 key) {
+    const struct mcsheng *m = getImplNfa(nfa);
+    u16 s = offset ? m->start_floating : m->start_anchored;
+    if (s) {
+        unaligned_store_u16(state, s);
+        return 1;
+    }
+    return 0;
+}
+
+char nfaExecMcSheng8_testEOD(const struct NFA *nfa, const char *state,
+                             UNUSED const char *streamState, u64a offset,
+                             NfaCallback callback, void *context) {
+    return mcshengCheckEOD(nfa, *(const u8 *)state, offset, callback,
+                           context);
+}
+
+char nfaExecMcSheng16_testEOD(const struct NFA *nfa, const char *state,
+                              UNUSED const char *streamState, u64a offset,
+                              NfaCallback callback, void *context) {
+    assert(ISALIGNED_N(state, 2));
+    return mcshengCheckEOD(nfa, *(const u16 *)state, offset, callback,
+                           context);
+}
+
+char nfaExecMcSheng8_queueInitState(UNUSED const struct NFA *nfa,
+                                    struct mq *q) {
+    assert(nfa->scratchStateSize == 1);
+    *(u8 *)q->state = 0;
+    return 0;
+}
+
+char nfaExecMcSheng16_queueInitState(UNUSED const struct NFA *nfa,
+                                     struct mq *q) {
+    assert(nfa->scratchStateSize == 2);
+    assert(ISALIGNED_N(q->state, 2));
+    *(u16 *)q->state = 0;
+    return 0;
+}
+
+char nfaExecMcSheng8_queueCompressState(UNUSED const struct NFA *nfa,
+                                        const struct mq *q, UNUSED s64a loc) {
+    void *dest = q->streamState;
+    const void *src = q->state;
+    assert(nfa->scratchStateSize == 1);
+    assert(nfa->streamStateSize == 1);
+    *(u8 *)dest = *(const u8 *)src;
+    return 0;
+}
+
+char nfaExecMcSheng8_expandState(UNUSED const struct NFA *nfa, void *dest,
+                                 const void *src, UNUSED u64a offset,
+                                 UNUSED u8 key) {
+    assert(nfa->scratchStateSize == 1);
+    assert(nfa->streamStateSize == 1);
+    *(u8 *)dest = *(const u8 *)src;
+    return 0;
+}
+
+char nfaExecMcSheng16_queueCompressState(UNUSED const struct NFA *nfa,
+                                         const struct mq *q,
+                                         UNUSED s64a loc) {
+    void *dest = q->streamState;
+    const void *src = q->state;
+    assert(nfa->scratchStateSize == 2);
+    assert(nfa->streamStateSize == 2);
+    assert(ISALIGNED_N(src, 2));
+    unaligned_store_u16(dest, *(const u16 *)(src));
+    return 0;
+}
+
+char nfaExecMcSheng16_expandState(UNUSED const struct NFA *nfa, void *dest,
+                                  const void *src, UNUSED u64a offset,
+                                  UNUSED u8 key) {
+    assert(nfa->scratchStateSize == 2);
+    assert(nfa->streamStateSize == 2);
+    assert(ISALIGNED_N(dest, 2));
+    *(u16 *)dest = unaligned_load_u16(src);
+    return 0;
+}
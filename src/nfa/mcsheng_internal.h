@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSHENG_INTERNAL_H
+#define MCSHENG_INTERNAL_H
+
+#include "mcclellan_internal.h"
+#include "nfa_internal.h"
+#include "ue2common.h"
+#include "util/simd_utils.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* McSheng runs the states in its sheng region (state ids below sheng_end,
+ * with the dead state at 0) using a shuffle-based Sheng kernel. The remaining
+ * states are run from a McClellan 8 or 16-bit transition table; the 16-bit
+ * table entries carry the McClellan ACCEPT_FLAG and ACCEL_FLAG bits. The
+ * McClellan table has rows for the sheng states as well, so that transitions
+ * out of the sheng region can be resolved from it. */
+
+/* Layout of a byte in the sheng shuffle masks. */
+#define MCSHENG_STATE_MASK  0x0f
+#define MCSHENG_STATE_ACCEPT 0x10
+#define MCSHENG_STATE_ACCEL  0x20
+#define MCSHENG_STATE_EXIT   0x40 /**< successor is outside the sheng region;
+                                   * the low bits hold the source state */
+
+/** \brief Maximum number of states (including dead) in the sheng region. */
+#define MCSHENG_MAX_SHENG_STATES 16
+
+#define MCSHENG_FLAG_SINGLE 1 /**< we raise only single accept id */
+
+struct mcsheng {
+    m128 sheng_masks[N_CHARS]; /**< sheng successors, indexed by raw char */
+    u16 state_count; /**< total number of states */
+    u32 length; /**< length of dfa in bytes */
+    u16 start_anchored; /**< anchored start state */
+    u16 start_floating; /**< floating start state */
+    u32 aux_offset; /**< offset of the aux structures relative to the start of
+                     *  the nfa structure */
+    u32 accel_offset; /**< offset of the accel structures relative to the start
+                       *  of struct mcsheng */
+    u16 sheng_end; /**< first state id outside the sheng region */
+    u16 accel_limit_8; /**< 8 bit, lowest accelerable McClellan state */
+    u16 accept_limit_8; /**< 8 bit, lowest accept McClellan state */
+    u8 alphaShift;
+    u8 flags;
+    u8 has_accel; /**< 1 iff there are any accel planes */
+    u8 remap[256]; /**< remaps characters to a smaller alphabet */
+    ReportID arb_report; /**< one of the accepts that this dfa may raise */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
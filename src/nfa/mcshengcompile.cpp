@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mcshengcompile.h"
+
+#include "accel.h"
+#include "grey.h"
+#include "mcclellancompile.h"
+#include "mcsheng_internal.h"
+#include "nfa_internal.h"
+#include "ue2common.h"
+#include "util/alloc.h"
+#include "util/bitutils.h"
+#include "util/compile_context.h"
+#include "util/container.h"
+#include "util/report_manager.h"
+#include "util/verify_types.h"
+
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+namespace ue2 {
+
+/** \brief Minimum percentage of the transitions out of the sheng region (over
+ * all 256 characters) that must stay inside it for McSheng to be worthwhile;
+ * otherwise we would spend our time bouncing between the two kernels. */
+#define MCSHENG_MIN_LOCALITY 50
+
+namespace /* anon */ {
+
+struct dfa_info {
+    accel_dfa_build_strat &strat;
+    raw_dfa &raw;
+    vector<dstate> &states;
+    const u16 alpha_size; /* including special symbols */
+    const array<u16, ALPHABET_SIZE> &alpha_remap;
+    const u16 impl_alpha_size;
+
+    u8 getAlphaShift() const;
+
+    explicit dfa_info(accel_dfa_build_strat &s)
+                                : strat(s),
+                                  raw(s.get_raw()),
+                                  states(raw.states),
+                                  alpha_size(raw.alpha_size),
+                                  alpha_remap(raw.alpha_remap),
+                                  impl_alpha_size(raw.getImplAlphaSize()) {}
+
+    dstate_id_t implId(dstate_id_t raw_id) const {
+        return states[raw_id].impl_id;
+    }
+
+    size_t size(void) const { return states.size(); }
+};
+
+u8 dfa_info::getAlphaShift() const {
+    if (impl_alpha_size < 2) {
+        return 1;
+    } else {
+        /* log2 round up */
+        return 32 - clz32(impl_alpha_size - 1);
+    }
+}
+
+} // namespace
+
+/**
+ * \brief Selects the states for the sheng region.
+ *
+ * A scan spends most of its time near the start states, so we take the states
+ * in order of BFS depth from the start states until the region is full. The
+ * dead state is not included; it always occupies sheng state 0.
+ */
+static
+vector<dstate_id_t> findShengStates(const dfa_info &info) {
+    const raw_dfa &raw = info.raw;
+    vector<bool> seen(info.size(), false);
+    deque<dstate_id_t> pending;
+    vector<dstate_id_t> rv;
+
+    seen[DEAD_STATE] = true;
+    for (dstate_id_t s : {raw.start_anchored, raw.start_floating}) {
+        if (!seen[s]) {
+            seen[s] = true;
+            pending.push_back(s);
+        }
+    }
+
+    while (!pending.empty() && rv.size() < MCSHENG_MAX_SHENG_STATES - 1) {
+        dstate_id_t s = pending.front();
+        pending.pop_front();
+        rv.push_back(s);
+
+        for (symbol_t c = 0; c < info.impl_alpha_size; c++) {
+            dstate_id_t t = info.states[s].next[c];
+            if (!seen[t]) {
+                seen[t] = true;
+                pending.push_back(t);
+            }
+        }
+    }
+
+    return rv;
+}
+
+static
+bool isShengRegionWorthwhile(const dfa_info &info,
+                             const vector<dstate_id_t> &sheng_states) {
+    vector<bool> in_sheng(info.size(), false);
+    in_sheng[DEAD_STATE] = true;
+    for (dstate_id_t s : sheng_states) {
+        in_sheng[s] = true;
+    }
+
+    u32 local = 0;
+    u32 total = 0;
+    for (dstate_id_t s : sheng_states) {
+        for (u32 c = 0; c < N_CHARS; c++) {
+            total++;
+            if (in_sheng[info.states[s].next[info.alpha_remap[c]]]) {
+                local++;
+            }
+        }
+    }
+
+    DEBUG_PRINTF("%u/%u sheng transitions stay in the sheng region\n", local,
+                 total);
+    return local * 100 >= total * MCSHENG_MIN_LOCALITY;
+}
+
+/* Numbers the states: the dead state, then the sheng region, then the
+ * McClellan states. For the 8-bit table the McClellan states are ordered
+ * normal, accel, accept so that limits can be used to identify them. */
+static
+void allocateImplIds(dfa_info &info, const vector<dstate_id_t> &sheng_states,
+                     const map<dstate_id_t, AccelScheme> &accel_escape_info,
+                     bool using8bit, mcsheng *m) {
+    vector<bool> is_sheng(info.size(), false);
+
+    info.states[DEAD_STATE].impl_id = 0; /* dead is always 0 */
+    u32 j = 1;
+    for (dstate_id_t s : sheng_states) {
+        is_sheng[s] = true;
+        info.states[s].impl_id = j++;
+    }
+    m->sheng_end = verify_u16(j);
+
+    vector<dstate_id_t> norm;
+    vector<dstate_id_t> accel;
+    vector<dstate_id_t> accept;
+
+    for (dstate_id_t i = 1; i < info.size(); i++) {
+        if (is_sheng[i]) {
+            continue;
+        }
+        if (!using8bit) {
+            norm.push_back(i);
+        } else if (!info.states[i].reports.empty()) {
+            accept.push_back(i);
+        } else if (contains(accel_escape_info, i)) {
+            accel.push_back(i);
+        } else {
+            norm.push_back(i);
+        }
+    }
+
+    for (dstate_id_t s : norm) {
+        info.states[s].impl_id = j++;
+    }
+    m->accel_limit_8 = verify_u16(j);
+    for (dstate_id_t s : accel) {
+        info.states[s].impl_id = j++;
+    }
+    m->accept_limit_8 = verify_u16(j);
+    for (dstate_id_t s : accept) {
+        info.states[s].impl_id = j++;
+    }
+
+    assert(j == info.size());
+    DEBUG_PRINTF("sheng_end %hu, accel_limit %hu, accept_limit %hu\n",
+                 m->sheng_end, m->accel_limit_8, m->accept_limit_8);
+}
+
+static
+void fillInAux(mstate_aux *aux, dstate_id_t i, const dfa_info &info,
+               const vector<u32> &reports, const vector<u32> &reports_eod,
+               const vector<u32> &reportOffsets) {
+    const dstate &raw_state = info.states[i];
+    aux->accept = raw_state.reports.empty() ? 0 : reportOffsets[reports[i]];
+    aux->accept_eod = raw_state.reports_eod.empty() ? 0
+                                              : reportOffsets[reports_eod[i]];
+    aux->top = info.implId(i ? raw_state.next[info.alpha_remap[TOP]]
+                             : info.raw.start_floating);
+}
+
+static
+void fillSuccTable(const dfa_info &info,
+                   const map<dstate_id_t, AccelScheme> &accel_escape_info,
+                   bool using8bit, char *succ_base) {
+    const u8 alphaShift = info.getAlphaShift();
+
+    for (dstate_id_t i = 0; i < info.size(); i++) {
+        u32 row = (u32)info.implId(i) << alphaShift;
+        for (symbol_t s = 0; s < info.impl_alpha_size; s++) {
+            dstate_id_t raw_succ = info.states[i].next[s];
+            u16 succ = info.implId(raw_succ);
+            if (using8bit) {
+                ((u8 *)succ_base)[row + s] = verify_u8(succ);
+                continue;
+            }
+
+            if (!info.states[raw_succ].reports.empty()) {
+                succ |= ACCEPT_FLAG;
+            }
+            if (contains(accel_escape_info, raw_succ)) {
+                succ |= ACCEL_FLAG;
+            }
+            ((u16 *)succ_base)[row + s] = succ;
+        }
+    }
+}
+
+static
+void createShengMasks(const dfa_info &info,
+                      const vector<dstate_id_t> &sheng_states,
+                      const map<dstate_id_t, AccelScheme> &accel_escape_info,
+                      mcsheng *m) {
+    vector<dstate_id_t> raw_ids(1, DEAD_STATE);
+    raw_ids.insert(raw_ids.end(), sheng_states.begin(), sheng_states.end());
+    assert(raw_ids.size() == m->sheng_end);
+
+    for (u32 c = 0; c < N_CHARS; c++) {
+        u8 buf[sizeof(m128)] = {0};
+
+        for (u32 i = 0; i < raw_ids.size(); i++) {
+            dstate_id_t raw_succ = info.states[raw_ids[i]].next[
+                                                        info.alpha_remap[c]];
+            u16 succ = info.implId(raw_succ);
+            if (succ >= m->sheng_end) {
+                buf[i] = MCSHENG_STATE_EXIT | i;
+                continue;
+            }
+
+            buf[i] = verify_u8(succ);
+            if (!info.states[raw_succ].reports.empty()) {
+                buf[i] |= MCSHENG_STATE_ACCEPT;
+            }
+            if (contains(accel_escape_info, raw_succ)) {
+                buf[i] |= MCSHENG_STATE_ACCEL;
+            }
+        }
+
+        memcpy(&m->sheng_masks[c], buf, sizeof(buf));
+    }
+}
+
+static
+void fillAccelOut(const map<dstate_id_t, AccelScheme> &accel_escape_info,
+                  set<dstate_id_t> *accel_states) {
+    for (const auto &e : accel_escape_info) {
+        accel_states->insert(e.first);
+    }
+}
+
+aligned_unique_ptr<NFA> mcshengCompile(raw_dfa &raw, const CompileContext &cc,
+                                       const ReportManager &rm,
+                                       set<dstate_id_t> *accel_states) {
+    if (!cc.grey.allowMcSheng) {
+        DEBUG_PRINTF("McSheng is not allowed!\n");
+        return nullptr;
+    }
+
+    mcclellan_build_strat mbs(raw, rm);
+    dfa_info info(mbs);
+    bool using8bit = cc.grey.allowMcClellan8 && info.size() <= 256;
+
+    if (info.size() > (1U << 16) || info.size() - 1 > STATE_MASK) {
+        DEBUG_PRINTF("too many states\n");
+        return nullptr;
+    }
+
+    vector<dstate_id_t> sheng_states = findShengStates(info);
+    if (sheng_states.empty() || !isShengRegionWorthwhile(info, sheng_states)) {
+        DEBUG_PRINTF("sheng region not worthwhile\n");
+        return nullptr;
+    }
+
+    if (!cc.streaming) { /* TODO: work out if we can do the strip in streaming
+                          * mode with our semantics */
+        raw.stripExtraEodReports();
+    }
+
+    DEBUG_PRINTF("building mcsheng %s, %zu states, %zu in sheng region\n",
+                 using8bit ? "8" : "16", info.size(), sheng_states.size() + 1);
+
+    vector<u32> reports; /* index in ri for the appropriate report list */
+    vector<u32> reports_eod; /* as above */
+    ReportID arb;
+    u8 single;
+
+    auto ri = info.strat.gatherReports(reports, reports_eod, &single, &arb);
+    map<dstate_id_t, AccelScheme> accel_escape_info
+        = info.strat.getAccelInfo(cc.grey);
+
+    const size_t width = using8bit ? sizeof(u8) : sizeof(u16);
+    size_t tran_size = (1 << info.getAlphaShift()) * width * info.size();
+    size_t aux_size = sizeof(mstate_aux) * info.size();
+    size_t aux_offset = ROUNDUP_16(sizeof(NFA) + sizeof(mcsheng) + tran_size);
+    size_t accel_size = info.strat.accelSize() * accel_escape_info.size();
+    size_t accel_offset = ROUNDUP_N(aux_offset + aux_size
+                                    + ri->getReportListSize(), 32);
+    size_t total_size = accel_offset + accel_size;
+
+    DEBUG_PRINTF("aux_offset %zu, accel_offset %zu, total_size %zu\n",
+                 aux_offset, accel_offset, total_size);
+
+    accel_offset -= sizeof(NFA); /* adj accel offset to be relative to m */
+    assert(ISALIGNED_N(accel_offset, alignof(union AccelAux)));
+
+    aligned_unique_ptr<NFA> nfa = aligned_zmalloc_unique<NFA>(total_size);
+    char *nfa_base = (char *)nfa.get();
+    mcsheng *m = (mcsheng *)getMutableImplNfa(nfa.get());
+
+    allocateImplIds(info, sheng_states, accel_escape_info, using8bit, m);
+
+    nfa->type = using8bit ? MCSHENG_NFA_8 : MCSHENG_NFA_16;
+    nfa->length = verify_u32(total_size);
+    nfa->nPositions = verify_u32(info.size());
+    nfa->scratchStateSize = verify_u32(width);
+    nfa->streamStateSize = verify_u32(width);
+    if (raw.hasEodReports()) {
+        nfa->flags |= NFA_ACCEPTS_EOD;
+    }
+
+    for (u32 i = 0; i < N_CHARS; i++) {
+        m->remap[i] = verify_u8(info.alpha_remap[i]);
+    }
+    m->alphaShift = info.getAlphaShift();
+    m->length = verify_u32(total_size);
+    m->aux_offset = verify_u32(aux_offset);
+    m->accel_offset = verify_u32(accel_offset);
+    m->arb_report = arb;
+    m->state_count = verify_u16(info.size());
+    m->start_anchored = info.implId(raw.start_anchored);
+    m->start_floating = info.implId(raw.start_floating);
+    m->has_accel = accel_escape_info.empty() ? 0 : 1;
+    if (single) {
+        m->flags |= MCSHENG_FLAG_SINGLE;
+    }
+
+    vector<u32> reportOffsets;
+    ri->fillReportLists(nfa.get(), aux_offset + aux_size, reportOffsets);
+
+    mstate_aux *aux = (mstate_aux *)(nfa_base + aux_offset);
+    for (dstate_id_t i = 0; i < info.size(); i++) {
+        mstate_aux *this_aux = &aux[info.implId(i)];
+        fillInAux(this_aux, i, info, reports, reports_eod, reportOffsets);
+
+        if (contains(accel_escape_info, i)) {
+            this_aux->accel_offset = verify_u32(accel_offset);
+            accel_offset += info.strat.accelSize();
+            assert(accel_offset + sizeof(NFA) <= total_size);
+            info.strat.buildAccel(i, accel_escape_info.at(i),
+                                  (void *)((char *)m + this_aux->accel_offset));
+        }
+    }
+
+    fillSuccTable(info, accel_escape_info, using8bit,
+                  nfa_base + sizeof(NFA) + sizeof(mcsheng));
+    createShengMasks(info, sheng_states, accel_escape_info, m);
+
+    if (accel_states) {
+        fillAccelOut(accel_escape_info, accel_states);
+    }
+
+    DEBUG_PRINTF("compile done\n");
+    return nfa;
+}
+
+bool has_accel_mcsheng(const NFA *nfa) {
+    const mcsheng *m = (const mcsheng *)getImplNfa(nfa);
+    return m->has_accel;
+}
+
+} // namespace ue2
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include "mcshengdump.h"
+
+#include "accel.h"
+#include "accel_dump.h"
+#include "mcclellandump.h"
+#include "mcsheng_internal.h"
+#include "nfa_dump_internal.h"
+#include "nfa_internal.h"
+#include "ue2common.h"
+#include "util/charreach.h"
+#include "util/dump_charclass.h"
+
+#include <cstdio>
+#include <map>
+
+#ifndef DUMP_SUPPORT
+#error No dump support!
+#endif
+
+using namespace std;
+
+namespace ue2 {
+
+static
+const mstate_aux *getMcShengAux(const NFA *n, u16 i) {
+    assert(n && isMcShengType(n->type));
+
+    const mcsheng *m = (const mcsheng *)getImplNfa(n);
+    const mstate_aux *aux_base
+        = (const mstate_aux *)((const char *)n + m->aux_offset);
+
+    const mstate_aux *aux = aux_base + i;
+
+    assert((const char *)aux < (const char *)n + m->length);
+    return aux;
+}
+
+static
+void mcshengGetTransitions(const NFA *n, u16 s, u16 *t) {
+    assert(isMcShengType(n->type));
+    const mcsheng *m = (const mcsheng *)getImplNfa(n);
+    const mstate_aux *aux = getMcShengAux(n, s);
+    const u32 as = m->alphaShift;
+    const char *succ_base = (const char *)m + sizeof(mcsheng);
+
+    for (u16 c = 0; c < N_CHARS; c++) {
+        u32 idx = ((u32)s << as) + m->remap[c];
+        if (n->type == MCSHENG_NFA_8) {
+            t[c] = ((const u8 *)succ_base)[idx];
+        } else {
+            t[c] = ((const u16 *)succ_base)[idx] & STATE_MASK;
+        }
+    }
+
+    t[TOP] = aux->top & STATE_MASK;
+}
+
+static
+void describeNode(const NFA *n, const mcsheng *m, u16 i, FILE *f) {
+    const mstate_aux *aux = getMcShengAux(n, i);
+
+    bool isSheng = i < m->sheng_end;
+
+    fprintf(f, "%u [ width = 1, fixedsize = true, fontsize = 12, "
+            "label = \"%u%s\" ]; \n", i, i, isSheng ? "s" : "");
+
+    if (aux->accel_offset) {
+        dumpAccelDot(f, i, (const union AccelAux *)
+                     ((const char *)m + aux->accel_offset));
+    }
+
+    if (isSheng) {
+        fprintf(f, "%u [ fillcolor = lightblue style=filled ];\n", i);
+    }
+
+    if (aux->accept_eod) {
+        fprintf(f, "%u [ color = darkorchid ];\n", i);
+    }
+
+    if (aux->accept) {
+        fprintf(f, "%u [ shape = doublecircle ];\n", i);
+    }
+
+    if (aux->top && aux->top != i) {
+        fprintf(f, "%u -> %u [color = darkgoldenrod weight=0.1 ]\n", i,
+                aux->top);
+    }
+
+    if (i == m->start_anchored) {
+        fprintf(f, "STARTA -> %u [color = blue ]\n", i);
+    }
+
+    if (i == m->start_floating) {
+        fprintf(f, "STARTF -> %u [color = red ]\n", i);
+    }
+}
+
+static
+void dumpDotMcSheng(const NFA *nfa, FILE *f) {
+    const mcsheng *m = (const mcsheng *)getImplNfa(nfa);
+
+    dumpDotPreambleDfa(f);
+
+    for (u16 i = 1; i < m->state_count; i++) {
+        describeNode(nfa, m, i, f);
+
+        u16 t[ALPHABET_SIZE];
+
+        mcshengGetTransitions(nfa, i, t);
+
+        describeEdge(f, t, i);
+    }
+
+    fprintf(f, "}\n");
+}
+
+void nfaExecMcSheng16_dumpDot(const NFA *nfa, FILE *f,
+                              UNUSED const string &base) {
+    assert(nfa->type == MCSHENG_NFA_16);
+    dumpDotMcSheng(nfa, f);
+}
+
+void nfaExecMcSheng8_dumpDot(const NFA *nfa, FILE *f,
+                             UNUSED const string &base) {
+    assert(nfa->type == MCSHENG_NFA_8);
+    dumpDotMcSheng(nfa, f);
+}
+
+static
+void dumpAccelMasks(FILE *f, const mcsheng *m, const mstate_aux *aux) {
+    fprintf(f, "\n");
+    fprintf(f, "Acceleration\n");
+    fprintf(f, "------------\n");
+
+    for (u16 i = 0; i < m->state_count; i++) {
+        if (!aux[i].accel_offset) {
+            continue;
+        }
+
+        const AccelAux *accel = (const AccelAux *)((const char *)m
+                                                   + aux[i].accel_offset);
+        fprintf(f, "%05hu ", i);
+        dumpAccelInfo(f, *accel);
+    }
+}
+
+static
+void describeAlphabet(FILE *f, const mcsheng *m) {
+    map<u8, CharReach> rev;
+
+    for (u16 i = 0; i < N_CHARS; i++) {
+        rev[m->remap[i]].set(i);
+    }
+
+    fprintf(f, "\nAlphabet\n");
+    for (const auto &e : rev) {
+        fprintf(f, "%3hhu: ", e.first);
+        describeClass(f, e.second, 10240, CC_OUT_TEXT);
+        fprintf(f, "\n");
+    }
+    fprintf(f, "\n");
+}
+
+static
+void dumpShengMasks(FILE *f, const mcsheng *m) {
+    fprintf(f, "\nSheng region masks\n");
+    fprintf(f, "------------------\n");
+
+    for (u16 c = 0; c < N_CHARS; c++) {
+        const u8 *buf = (const u8 *)&m->sheng_masks[c];
+        fprintf(f, "%02hx:", c);
+        for (u16 i = 0; i < m->sheng_end; i++) {
+            if (buf[i] & MCSHENG_STATE_EXIT) {
+                fprintf(f, " --");
+            } else {
+                fprintf(f, " %2u%s%s", buf[i] & MCSHENG_STATE_MASK,
+                        buf[i] & MCSHENG_STATE_ACCEPT ? "a" : "",
+                        buf[i] & MCSHENG_STATE_ACCEL ? "c" : "");
+            }
+        }
+        fprintf(f, "\n");
+    }
+}
+
+static
+void dumpTransitions(FILE *f, const NFA *nfa, const mcsheng *m,
+                     const mstate_aux *aux) {
+    for (u16 i = 0; i < m->state_count; i++) {
+        fprintf(f, "%05hu%s", i, i < m->sheng_end ? "s" : "");
+        if (aux[i].accel_offset) {
+            dumpAccelText(f, (const union AccelAux *)((const char *)m +
+                                                      aux[i].accel_offset));
+        }
+
+        u16 trans[ALPHABET_SIZE];
+        mcshengGetTransitions(nfa, i, trans);
+
+        int rstart = 0;
+        u16 prev = 0xffff;
+        for (int j = 0; j < N_CHARS; j++) {
+            u16 curr = trans[j];
+            if (curr == prev) {
+                continue;
+            }
+
+            if (prev != 0xffff) {
+                if (j == rstart + 1) {
+                    fprintf(f, " %02x->%hu", rstart, prev);
+                } else {
+                    fprintf(f, " [%02x - %02x]->%hu", rstart, j - 1, prev);
+                }
+            }
+
+            prev = curr;
+            rstart = j;
+        }
+        if (N_CHARS == rstart + 1) {
+            fprintf(f, " %02x->%hu", rstart, prev);
+        } else {
+            fprintf(f, " [%02x - %02x]->%hu", rstart, N_CHARS - 1, prev);
+        }
+        fprintf(f, "\n");
+    }
+}
+
+static
+void dumpTextMcSheng(const NFA *nfa, FILE *f, const char *title) {
+    const mcsheng *m = (const mcsheng *)getImplNfa(nfa);
+    const mstate_aux *aux =
+        (const mstate_aux *)((const char *)nfa + m->aux_offset);
+
+    fprintf(f, "%s\n", title);
+    fprintf(f, "report: %u, states: %u, length: %u\n", m->arb_report,
+            m->state_count, m->length);
+    fprintf(f, "astart: %hu, fstart: %hu\n", m->start_anchored,
+            m->start_floating);
+    fprintf(f, "single accept: %d, has_accel: %d\n",
+            !!(m->flags & MCSHENG_FLAG_SINGLE), m->has_accel);
+    fprintf(f, "sheng_end: %hu\n", m->sheng_end);
+    if (nfa->type == MCSHENG_NFA_8) {
+        fprintf(f, "accel_limit: %hu, accept_limit %hu\n", m->accel_limit_8,
+                m->accept_limit_8);
+    }
+    fprintf(f, "\n");
+
+    describeAlphabet(f, m);
+    dumpShengMasks(f, m);
+    fprintf(f, "\n");
+    dumpTransitions(f, nfa, m, aux);
+    dumpAccelMasks(f, m, aux);
+
+    fprintf(f, "\n");
+    dumpTextReverse(nfa, f);
+}
+
+void nfaExecMcSheng16_dumpText(const NFA *nfa, FILE *f) {
+    assert(nfa->type == MCSHENG_NFA_16);
+    dumpTextMcSheng(nfa, f, "mcsheng 16");
+}
+
+void nfaExecMcSheng8_dumpText(const NFA *nfa, FILE *f) {
+    assert(nfa->type == MCSHENG_NFA_8);
+    dumpTextMcSheng(nfa, f, "mcsheng 8");
+}
+
+} // namespace ue2
@@ -39,6 +39,7 @@
 #include "vermicelli_run.h"
 #include "util/multibit.h"
 #include "util/partial_store.h"
+#include "util/popcount.h"
 #include "util/simd_utils.h"
 #include "util/unaligned.h"
 
@@ -97,6 +98,52 @@ void normalize_counters(struct mpv_decomp_state *dstate, const struct mpv *m) {
     dstate->counter_adj = 0;
 }
 
+/** \brief Number of thresholds in the block at \a t that are not greater
+ * than the biased \a bound, comparing the whole block at once. */
+static really_inline
+u32 countBlock(const u32 *t, m128 bound) {
+    /* each lane of the movemask is four bits */
+    u32 gt = movemask128(gt32x4(loadu128(t), bound))
+           | movemask128(gt32x4(loadu128(t + 4), bound)) << 16;
+    return MPV_THRESH_BLOCK - popcount32(gt) / 4;
+}
+
+/** \brief Number of the kilopuff's puffettes with repeats <= \a bound.
+ *
+ * The thresholds are sorted, so a binary search over the first threshold of
+ * each block finds the only block that straddles the bound, which is then
+ * counted with SIMD compares. */
+static really_inline
+u32 countSatisfied(const struct mpv *m, const struct mpv_kilopuff *kp,
+                   u64a bound) {
+    if (bound >= ~0U) {
+        return kp->count;
+    }
+
+    const u32 *t = get_thresholds(m, kp);
+    const s32 b = (s32)mpv_threshold((u32)bound);
+    u32 lo = 0;
+    u32 hi = (kp->count + MPV_THRESH_BLOCK - 1) / MPV_THRESH_BLOCK;
+    if (!hi || (s32)t[0] > b) {
+        return 0;
+    }
+
+    /* find the last block whose first threshold is <= bound */
+    while (hi - lo > 1) {
+        u32 mid = (lo + hi) / 2;
+        if ((s32)t[mid * MPV_THRESH_BLOCK] <= b) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    u32 rv = lo * MPV_THRESH_BLOCK
+           + countBlock(t + lo * MPV_THRESH_BLOCK, set4x32((u32)b));
+    assert(rv <= kp->count);
+    return rv;
+}
+
 static really_inline
 char processReports(const struct mpv *m, u8 *reporters,
                     const struct mpv_decomp_state *dstate, u64a counter_adj,
@@ -118,26 +165,44 @@ char processReports(const struct mpv *m, u8 *reporters,
                                                      * is -1 */
         char did_stuff = 0;
 
+        /* Bounded puffettes fire only when their repeats equal the counter;
+         * those are the ones from eq_begin up to curr. Below eq_begin only
+         * the unbounded puffettes fire, so we jump between them. Reports are
+         * delivered from curr downwards, as before. */
+        const struct mpv_puffette *puffs = get_puff_array(m, &kp[i]);
+        const struct mpv_puffette *eq_begin
+            = puffs + countSatisfied(m, &kp[i], curr_counter_val - 1);
+        const u32 *unbounded = get_unbounded(m, &kp[i]);
+        u32 ub = kp[i].unbounded_count;
+
         while (curr->report != INVALID_REPORT) {
-            assert(curr_counter_val >= curr->repeats);
-            if (curr->unbounded || curr_counter_val == curr->repeats) {
-                DEBUG_PRINTF("report %u at %llu\n", curr->report,
-                              report_offset);
-
-                if (curr->unbounded && !curr->simple_exhaust) {
-                    assert(rl_count < m->puffette_count);
-                    *rl = curr->report;
-                    ++rl;
-                    rl_count++;
+            if (curr < eq_begin) {
+                while (ub && puffs + unbounded[ub - 1] > curr) {
+                    ub--;
                 }
-
-                if (cb(0, report_offset, curr->report, ctxt) ==
-                    MO_HALT_MATCHING) {
-                    DEBUG_PRINTF("bailing\n");
-                    return MO_HALT_MATCHING;
+                if (!ub) {
+                    break;
                 }
-                did_stuff = 1;
+                curr = puffs + unbounded[--ub];
+            }
+
+            assert(curr_counter_val >= curr->repeats);
+            assert(curr->unbounded || curr_counter_val == curr->repeats);
+            DEBUG_PRINTF("report %u at %llu\n", curr->report, report_offset);
+
+            if (curr->unbounded && !curr->simple_exhaust) {
+                assert(rl_count < m->puffette_count);
+                *rl = curr->report;
+                ++rl;
+                rl_count++;
+            }
+
+            if (cb(0, report_offset, curr->report, ctxt) ==
+                MO_HALT_MATCHING) {
+                DEBUG_PRINTF("bailing\n");
+                return MO_HALT_MATCHING;
             }
+            did_stuff = 1;
 
             curr--;
         }
@@ -199,16 +264,8 @@ const struct mpv_puffette *get_curr_puff(const struct mpv *m,
     u64a counter = *get_counter_for_kilo(dstate, kp);
     assert(counter != MPV_DEAD_VALUE);
 
-    const struct mpv_puffette *p = get_puff_array(m, kp);
     DEBUG_PRINTF("looking for current puffette (counter = %llu)\n", counter);
-    DEBUG_PRINTF("next: (%u, %u)\n", p->repeats, p->report);
-    while (counter + 1 >= p->repeats && p->report != INVALID_REPORT) {
-        DEBUG_PRINTF("advancing\n");
-        ++p;
-        DEBUG_PRINTF("next: (%u, %u)\n", p->repeats, p->report);
-    }
-
-    return p - 1;
+    return get_puff_array(m, kp) + countSatisfied(m, kp, counter + 1) - 1;
 }
 
 static
@@ -230,14 +287,12 @@ const struct mpv_puffette *update_curr_puff(const struct mpv *m, u8 *reporters,
                                             u32 kilo_index) {
     assert(counter != MPV_DEAD_VALUE);
 
-    const struct mpv_puffette *p = in;
     DEBUG_PRINTF("looking for current puffette (counter = %llu)\n", counter);
-    DEBUG_PRINTF("curr: (%u, %u)\n", p->repeats, p->report);
-    while (counter + 1 >= p[1].repeats && p[1].report != INVALID_REPORT) {
-        DEBUG_PRINTF("advancing\n");
-        ++p;
-        DEBUG_PRINTF("curr: (%u, %u)\n", p->repeats, p->report);
-    }
+    const struct mpv_kilopuff *kp = (const void *)(m + 1);
+    const struct mpv_puffette *p = get_puff_array(m, &kp[kilo_index])
+                                 + countSatisfied(m, &kp[kilo_index],
+                                                  counter + 1) - 1;
+    assert(p >= in);
 
     if (p != in) {
         mmbit_set(reporters, m->kilo_count, kilo_index);
@@ -102,6 +102,8 @@ void dumpKilo(FILE *f, const mpv *m, const mpv_kilopuff *k) {
     fprintf(f, "    dead point %llu\n", k->dead_point);
     fprintf(f, "    counter offset %u\n", k->counter_offset);
     fprintf(f, "    puffette offset %u\n", k->puffette_offset);
+    fprintf(f, "    threshold offset %u\n", k->threshold_offset);
+    fprintf(f, "    %u unbounded puffettes\n", k->unbounded_count);
 
     const mpv_puffette *p = get_puff_array(m, k);
     for (u32 i = 0; i < k->count; i++) {
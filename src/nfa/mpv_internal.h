@@ -58,6 +58,12 @@ struct mpv_kilopuff {
     u32 count; /**< number of real (non sentinel mpv puffettes) */
     u32 puffette_offset; /**< relative to base of mpv, points past the 1st
                           * sent */
+    u32 threshold_offset; /**< relative to base of mpv, packed repeat
+                           * thresholds for the puffettes, see
+                           * mpv_threshold() */
+    u32 unbounded_offset; /**< relative to base of mpv, ascending indices of
+                           * the unbounded puffettes */
+    u32 unbounded_count; /**< number of unbounded puffettes */
     u64a dead_point;
     u8 auto_restart;
     u8 type; /* MPV_DOT, MPV_VERM, etc */
@@ -116,6 +122,19 @@ struct mpv_decomp_state {
     struct mpv_decomp_kilo active[];
 };
 
+/** \brief Puffette repeat thresholds are packed per kilopuff, MPV_THRESH_BLOCK
+ * to a block, so that the current puffette can be found by comparing a block
+ * of thresholds against the counter at once. */
+#define MPV_THRESH_BLOCK 8
+
+/** \brief Biases a repeat count so that signed comparisons order it as
+ * unsigned. Padding at the end of the last block is mpv_threshold(~0U), which
+ * no counter reaches. */
+static really_inline
+u32 mpv_threshold(u32 repeats) {
+    return repeats ^ 0x80000000U;
+}
+
 /* ---
  * | | mpv
  * ---
@@ -145,6 +164,10 @@ struct mpv_decomp_state {
  * ---
  * | | sentinel mpv_puffette
  * ---
+ * | | for each kilopuff: 16-byte aligned thresholds (padded to a multiple of
+ * | | MPV_THRESH_BLOCK), then indices of unbounded puffettes
+ * ...
+ * ---
  */
 
 /*
@@ -185,6 +208,16 @@ const struct mpv_puffette *get_puff_array(const struct mpv *m,
     return (const struct mpv_puffette *)((const char *)m + kp->puffette_offset);
 }
 
+static really_inline
+const u32 *get_thresholds(const struct mpv *m, const struct mpv_kilopuff *kp) {
+    return (const u32 *)((const char *)m + kp->threshold_offset);
+}
+
+static really_inline
+const u32 *get_unbounded(const struct mpv *m, const struct mpv_kilopuff *kp) {
+    return (const u32 *)((const char *)m + kp->unbounded_offset);
+}
+
 static really_inline
 const struct mpv_counter_info *get_counter_info(const struct mpv *m) {
     return (const struct mpv_counter_info *)((const char *)(m + 1)
@@ -112,6 +112,15 @@ void writeDeadPoint(mpv_kilopuff *out, const vector<raw_puff> &puffs) {
     out->dead_point = puffs.back().repeats + 1;
 }
 
+/** \brief Size of a kilopuff's packed thresholds and unbounded indices. */
+static
+size_t calcSearchSize(const vector<raw_puff> &puffs) {
+    size_t thresh = ROUNDUP_N(puffs.size(), MPV_THRESH_BLOCK);
+    size_t unbounded = count_if(puffs.begin(), puffs.end(),
+                                [](const raw_puff &p) { return p.unbounded; });
+    return ROUNDUP_16((thresh + unbounded) * sizeof(u32));
+}
+
 static
 size_t calcSize(const map<ClusterKey, vector<raw_puff>> &raw,
                 const vector<mpv_counter_info> &counters) {
@@ -129,6 +138,11 @@ size_t calcSize(const map<ClusterKey, vector<raw_puff>> &raw,
         len += sizeof(mpv_puffette); /* terminal sent */
     }
 
+    len = ROUNDUP_16(len);
+    for (const vector<raw_puff> &puffs : raw | map_values) {
+        len += calcSearchSize(puffs);
+    }
+
     return len;
 }
 
@@ -154,6 +168,32 @@ void populateClusters(const vector<raw_puff> &puffs_in,
     }
 }
 
+/** \brief Writes the packed thresholds and unbounded indices that the runtime
+ * uses to find puffettes without walking the puffette array. */
+static
+void writeSearch(const vector<raw_puff> &puffs, mpv *m, mpv_kilopuff *kp,
+                 char **sa) {
+    assert(ISALIGNED_16(*sa));
+    u32 *thresh = (u32 *)*sa;
+    size_t thresh_count = ROUNDUP_N(puffs.size(), MPV_THRESH_BLOCK);
+    u32 *unbounded = thresh + thresh_count;
+
+    kp->threshold_offset = verify_u32(*sa - (char *)m);
+    kp->unbounded_offset = verify_u32((char *)unbounded - (char *)m);
+    kp->unbounded_count = 0;
+
+    for (size_t i = 0; i < thresh_count; i++) {
+        thresh[i] = mpv_threshold(i < puffs.size() ? puffs[i].repeats : ~0U);
+    }
+    for (size_t i = 0; i < puffs.size(); i++) {
+        if (puffs[i].unbounded) {
+            unbounded[kp->unbounded_count++] = verify_u32(i);
+        }
+    }
+
+    *sa += calcSearchSize(puffs);
+}
+
 static
 void writeKiloPuff(const map<ClusterKey, vector<raw_puff>>::const_iterator &it,
                    const ReportManager &rm, u32 counter_offset, mpv *m,
@@ -381,7 +421,15 @@ aligned_unique_ptr<NFA> mpvCompile(const vector<raw_puff> &puffs_in,
                       kp, &pa);
         ++kp;
     }
-    assert((char *)pa == (char *)nfa.get() + len);
+
+    char *sa = (char *)nfa.get()
+             + ROUNDUP_16((char *)pa - (char *)nfa.get());
+    kp = kp_begin;
+    for (const vector<raw_puff> &puffs : puff_clusters | map_values) {
+        writeSearch(puffs, m, kp, &sa);
+        ++kp;
+    }
+    assert(sa == (char *)nfa.get() + len);
 
     mpv_counter_info *out_ci = (mpv_counter_info *)kp;
     for (const auto &counter : counters) {
@@ -48,6 +48,38 @@ const u8 *JOIN(MATCH_ALGO, fwdBlock)(m256 mask_lo, m256 mask_hi, m256 chars,
                                                              );
 }
 
+#if defined(__AVX512BW__)
+/*
+ * 64-byte block: the class lookup covers all 64 bytes at once, but the run
+ * matchers work on 32-byte masks, so each half is checked in turn.
+ */
+static really_inline
+const u8 *JOIN(MATCH_ALGO, fwdBlock512)(m512 mask_lo, m512 mask_hi,
+                                        m512 chars, const u8 *buf,
+                                        const m512 low4bits, const u8 run_len
+#ifdef MULTIACCEL_DOUBLE
+                                        , const u8 run_len2
+#endif
+                                        ) {
+    u64a z = block512(mask_lo, mask_hi, chars, low4bits);
+    const u8 *rv = (*JOIN4(MATCH_ALGO, match_funcs, _, 64)[run_len])
+            (buf, z & 0xffffffff
+#ifdef MULTIACCEL_DOUBLE
+             , run_len2
+#endif
+             );
+    if (rv) {
+        return rv;
+    }
+    return (*JOIN4(MATCH_ALGO, match_funcs, _, 64)[run_len])
+            (buf + 32, z >> 32
+#ifdef MULTIACCEL_DOUBLE
+             , run_len2
+#endif
+             );
+}
+#endif
+
 const u8 *JOIN(MATCH_ALGO, shuftiExec)(m128 mask_lo, m128 mask_hi,
                                        const u8 *buf,
                                        const u8 *buf_end, u8 run_len
@@ -89,6 +121,28 @@ const u8 *JOIN(MATCH_ALGO, shuftiExec)(m128 mask_lo, m128 mask_hi,
     // Unrolling was here, but it wasn't doing anything but taking up space.
     // Reroll FTW.
     const u8 *last_block = buf_end - 32;
+
+#if defined(__AVX512BW__)
+    if (buf + 64 <= last_block) {
+        const m512 low4bits512 = set64x8(0xf);
+        const m512 mask_lo512 = set4x128(mask_lo);
+        const m512 mask_hi512 = set4x128(mask_hi);
+        do {
+            rv = JOIN(MATCH_ALGO, fwdBlock512)(mask_lo512, mask_hi512,
+                                               loadu512(buf), buf,
+                                               low4bits512, run_len
+#ifdef MULTIACCEL_DOUBLE
+                                               , run_len2
+#endif
+                                               );
+            if (rv) {
+                return rv;
+            }
+            buf += 64;
+        } while (buf + 64 <= last_block);
+    }
+#endif
+
     while (buf < last_block) {
         m256 lchars = load256(buf);
         rv = JOIN(MATCH_ALGO, fwdBlock)(wide_mask_lo, wide_mask_hi, lchars, buf,
@@ -58,6 +58,38 @@ const u8 *JOIN(MATCH_ALGO, fwdBlock)(m256 shuf_mask_lo_highclear, m256 shuf_mask
                                                              );
 }
 
+#if defined(__AVX512BW__)
+/*
+ * 64-byte block: the class lookup covers all 64 bytes at once, but the run
+ * matchers work on 32-byte masks, so each half is checked in turn.
+ */
+static really_inline
+const u8 *JOIN(MATCH_ALGO, fwdBlock512)(m512 shuf_mask_lo_highclear,
+                                        m512 shuf_mask_lo_highset, m512 v,
+                                        const u8 *buf, const u8 run_len
+#ifdef MULTIACCEL_DOUBLE
+                                        , const u8 run_len2
+#endif
+                                        ) {
+    u64a z = block512(shuf_mask_lo_highclear, shuf_mask_lo_highset, v);
+    const u8 *rv = (*JOIN4(MATCH_ALGO, match_funcs, _, 64)[run_len])
+            (buf, z & 0xffffffff
+#ifdef MULTIACCEL_DOUBLE
+             , run_len2
+#endif
+             );
+    if (rv) {
+        return rv;
+    }
+    return (*JOIN4(MATCH_ALGO, match_funcs, _, 64)[run_len])
+            (buf + 32, z >> 32
+#ifdef MULTIACCEL_DOUBLE
+             , run_len2
+#endif
+             );
+}
+#endif
+
 const u8 *JOIN(MATCH_ALGO, truffleExec)(m128 shuf_mask_lo_highclear,
                                         m128 shuf_mask_lo_highset,
                                         const u8 *buf, const u8 *buf_end, const u8 run_len
@@ -93,6 +125,26 @@ const u8 *JOIN(MATCH_ALGO, truffleExec)(m128 shuf_mask_lo_highclear,
     buf += (32 - min);
 
     const u8 *last_block = buf_end - 32;
+
+#if defined(__AVX512BW__)
+    if (buf + 64 <= last_block) {
+        const m512 wide512_clear = set4x128(shuf_mask_lo_highclear);
+        const m512 wide512_set = set4x128(shuf_mask_lo_highset);
+        do {
+            rv = JOIN(MATCH_ALGO, fwdBlock512)(wide512_clear, wide512_set,
+                                               loadu512(buf), buf, run_len
+#ifdef MULTIACCEL_DOUBLE
+                                               , run_len2
+#endif
+                                               );
+            if (rv) {
+                return rv;
+            }
+            buf += 64;
+        } while (buf + 64 <= last_block);
+    }
+#endif
+
     while (buf < last_block) {
         m256 lchars = load256(buf);
         rv = JOIN(MATCH_ALGO, fwdBlock)(wide_clear, wide_set, lchars,
@@ -80,6 +80,38 @@ const u8 *JOIN(MATCH_ALGO, vermUnalign)(m256 chars,
     return NULL;
 }
 
+#if defined(__AVX512BW__)
+/*
+ * 64-byte block: the compare covers all 64 bytes at once, but the run
+ * matchers work on 32-byte masks, so each half is checked in turn. For
+ * case-sensitive scans casemask is all ones.
+ */
+static really_inline
+const u8 *JOIN(MATCH_ALGO, vermBlock512)(m512 chars, m512 casemask,
+                                         const u8 *buf, const u8 run_len
+#ifdef MULTIACCEL_DOUBLE
+                                         , const u8 run_len2
+#endif
+                                         ) {
+    u64a z = eq512mask(chars, and512(casemask, loadu512(buf)));
+    const u8 *ptr = (*JOIN4(MATCH_ALGO, match_funcs, _, 64)[run_len])
+            (buf, z & 0xffffffff
+#ifdef MULTIACCEL_DOUBLE
+             , run_len2
+#endif
+             );
+    if (unlikely(ptr)) {
+        return ptr;
+    }
+    return (*JOIN4(MATCH_ALGO, match_funcs, _, 64)[run_len])
+            (buf + 32, z >> 32
+#ifdef MULTIACCEL_DOUBLE
+             , run_len2
+#endif
+             );
+}
+#endif
+
 /*
  * 32-byte pipeline
  */
@@ -248,6 +280,25 @@ const u8 *JOIN(MATCH_ALGO, vermicelliExec)(char c, char nocase,
         buf += 32 - min;
     }
 
+#if defined(__AVX512BW__)
+    if (buf_end - buf >= 64) {
+        const m512 chars512 = set64x8(c);
+        const m512 casemask512 = set64x8(nocase ? CASE_CLEAR : 0xff);
+        do {
+            ptr = JOIN(MATCH_ALGO, vermBlock512)(chars512, casemask512, buf,
+                                                 run_len
+#ifdef MULTIACCEL_DOUBLE
+                                                 , run_len2
+#endif
+                                                 );
+            if (unlikely(ptr)) {
+                return ptr;
+            }
+            buf += 64;
+        } while (buf_end - buf >= 64);
+    }
+#endif
+
     if (buf_end - buf >= 32){
         ptr = nocase ? JOIN(MATCH_ALGO, vermPipelineNocase)(chars,
                 buf, buf_end, run_len
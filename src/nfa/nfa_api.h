@@ -273,6 +273,52 @@ char nfaCheckFinalState(const struct NFA *nfa, const char *state,
  */
 enum nfa_zombie_status nfaGetZombieStatus(const struct NFA *nfa, struct mq *q,
                                           s64a loc);
+
+/**
+ * Returns the number of entries in a state map for the given engine, or zero
+ * if it does not support state maps.
+ *
+ * A state map records, for every state of a small DFA, the state reached by
+ * scanning some buffer from it. Maps for consecutive pieces of a stream can
+ * be built independently (e.g. on different threads), composed in any
+ * grouping, and applied to the engine's compressed stream state to skip over
+ * all of them at once. Only the 16-state Sheng and 8-bit McClellan engines
+ * support them.
+ *
+ * @param nfa engine to consider
+ */
+u32 nfaStateMapSize(const struct NFA *nfa);
+
+/**
+ * Builds the state map for a buffer. Returns zero if the engine does not
+ * support state maps.
+ *
+ * @param nfa engine to run
+ * @param buf buffer to scan; no matches are raised
+ * @param len length of the buffer
+ * @param map output, with room for @ref nfaStateMapSize entries
+ */
+char nfaBuildStateMap(const struct NFA *nfa, const u8 *buf, size_t len,
+                      u8 *map);
+
+/**
+ * Composes two state maps in place, so that @a map describes scanning its own
+ * buffer followed by the buffer described by @a next.
+ *
+ * @param nfa engine the maps were built for
+ * @param map state map for the earlier buffer, updated
+ * @param next state map for the later buffer
+ */
+void nfaComposeStateMaps(const struct NFA *nfa, u8 *map, const u8 *next);
+
+/**
+ * Moves an engine's compressed stream state through a state map.
+ *
+ * @param nfa engine the map was built for
+ * @param map state map
+ * @param state compressed stream state, updated
+ */
+void nfaApplyStateMap(const struct NFA *nfa, const u8 *map, char *state);
 #ifdef __cplusplus
 }       /* extern "C" */
 #endif
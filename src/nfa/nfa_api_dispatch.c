@@ -33,14 +33,20 @@
 
 #include "nfa_api_queue.h"
 #include "nfa_internal.h"
+#include "pmu_stats.h"
+#include "rose/rose_profile.h"
+#include "sample_stats.h"
+#include "tracepoints.h"
 #include "ue2common.h"
 
 // Engine implementations.
 #include "castle.h"
+#include "dfagroup.h"
 #include "gough.h"
 #include "lbr.h"
 #include "limex.h"
 #include "mcclellan.h"
+#include "mcsheng.h"
 #include "mpv.h"
 #include "sheng.h"
 #include "tamarama.h"
@@ -55,10 +61,12 @@
 #define DISPATCH_BY_NFA_TYPE(dbnt_func)                       \
     switch (nfa->type) {                                      \
         DISPATCH_CASE(LIMEX, LimEx, 32, dbnt_func);           \
+        DISPATCH_CASE(LIMEX, LimEx, 64, dbnt_func);           \
         DISPATCH_CASE(LIMEX, LimEx, 128, dbnt_func);          \
         DISPATCH_CASE(LIMEX, LimEx, 256, dbnt_func);          \
         DISPATCH_CASE(LIMEX, LimEx, 384, dbnt_func);          \
         DISPATCH_CASE(LIMEX, LimEx, 512, dbnt_func);          \
+        DISPATCH_CASE(LIMEX, LimEx, 1024, dbnt_func);         \
         DISPATCH_CASE(MCCLELLAN, McClellan, 8, dbnt_func);    \
         DISPATCH_CASE(MCCLELLAN, McClellan, 16, dbnt_func);   \
         DISPATCH_CASE(GOUGH, Gough, 8, dbnt_func);            \
@@ -72,6 +80,11 @@
         DISPATCH_CASE(CASTLE, Castle, 0, dbnt_func);          \
         DISPATCH_CASE(SHENG, Sheng, 0, dbnt_func);            \
         DISPATCH_CASE(TAMARAMA, Tamarama, 0, dbnt_func);      \
+        DISPATCH_CASE(SHENG, Sheng, 32, dbnt_func);           \
+        DISPATCH_CASE(SHENG, Sheng, 64, dbnt_func);           \
+        DISPATCH_CASE(MCSHENG, McSheng, 8, dbnt_func);        \
+        DISPATCH_CASE(MCSHENG, McSheng, 16, dbnt_func);       \
+        DISPATCH_CASE(DFA_GROUP, DfaGroup, 0, dbnt_func);     \
     default:                                                  \
         assert(0);                                            \
     }
@@ -220,7 +233,15 @@ char nfaQueueExec(const struct NFA *nfa, struct mq *q, s64a end) {
         return 0;
     }
 
+    HS_TRACE3(nfa_queue_exec_start, nfa->queueIndex, nfa->type, end);
+    PMU_PHASE_BEGIN(q->scratch, pmu);
+    u32 prev_owner = roseProfileEngineBegin(q);
+    u32 prev_sample = sampleEngineBegin(q);
     char rv = nfaQueueExec_i(nfa, q, end);
+    sampleEngineEnd(q, prev_sample);
+    roseProfileEngineEnd(q, prev_owner);
+    PMU_PHASE_END(q->scratch, HS_PMU_PHASE_ENGINE, pmu);
+    HS_TRACE2(nfa_queue_exec_end, nfa->queueIndex, rv);
 
 #ifdef DEBUG
     debugQueue(q);
@@ -269,7 +290,15 @@ char nfaQueueExecToMatch(const struct NFA *nfa, struct mq *q, s64a end) {
         return 0;
     }
 
+    HS_TRACE3(nfa_queue_exec_start, nfa->queueIndex, nfa->type, end);
+    PMU_PHASE_BEGIN(q->scratch, pmu);
+    u32 prev_owner = roseProfileEngineBegin(q);
+    u32 prev_sample = sampleEngineBegin(q);
     char rv = nfaQueueExec2_i(nfa, q, end);
+    sampleEngineEnd(q, prev_sample);
+    roseProfileEngineEnd(q, prev_owner);
+    PMU_PHASE_END(q->scratch, HS_PMU_PHASE_ENGINE, pmu);
+    HS_TRACE2(nfa_queue_exec_end, nfa->queueIndex, rv);
     assert(!q->report_current);
     DEBUG_PRINTF("returned rv=%d, q_trimmed=%d\n", rv, q_trimmed);
     if (rv == MO_MATCHES_PENDING) {
@@ -312,7 +341,17 @@ char nfaQueueExecRose(const struct NFA *nfa, struct mq *q, ReportID r) {
     assert(ISALIGNED_CL(nfa) && ISALIGNED_CL(getImplNfa(nfa)));
     assert(!q->report_current);
 
-    return nfaQueueExecRose_i(nfa, q, r);
+    HS_TRACE3(nfa_queue_exec_start, nfa->queueIndex, nfa->type,
+              q_last_loc(q));
+    PMU_PHASE_BEGIN(q->scratch, pmu);
+    u32 prev_owner = roseProfileEngineBegin(q);
+    u32 prev_sample = sampleEngineBegin(q);
+    char rv = nfaQueueExecRose_i(nfa, q, r);
+    sampleEngineEnd(q, prev_sample);
+    roseProfileEngineEnd(q, prev_owner);
+    PMU_PHASE_END(q->scratch, HS_PMU_PHASE_ENGINE, pmu);
+    HS_TRACE2(nfa_queue_exec_end, nfa->queueIndex, rv);
+    return rv;
 }
 
 char nfaBlockExecReverse(const struct NFA *nfa, u64a offset, const u8 *buf,
@@ -358,3 +397,55 @@ enum nfa_zombie_status nfaGetZombieStatus(const struct NFA *nfa, struct mq *q,
     DISPATCH_BY_NFA_TYPE(_zombie_status(nfa, q, loc));
     return NFA_ZOMBIE_NO;
 }
+
+/* State maps are only implemented by the small DFAs, so these dispatch by
+ * hand rather than requiring every engine to provide a stub. */
+
+u32 nfaStateMapSize(const struct NFA *nfa) {
+    switch (nfa->type) {
+    case SHENG_NFA_0:
+    case MCCLELLAN_NFA_8:
+        return nfa->nPositions;
+    default:
+        return 0;
+    }
+}
+
+char nfaBuildStateMap(const struct NFA *nfa, const u8 *buf, size_t len,
+                      u8 *map) {
+    assert(nfa && map);
+    switch (nfa->type) {
+    case SHENG_NFA_0:
+        return nfaExecSheng0_stateMap(nfa, buf, len, map);
+    case MCCLELLAN_NFA_8:
+        return nfaExecMcClellan8_stateMap(nfa, buf, len, map);
+    default:
+        return 0;
+    }
+}
+
+void nfaComposeStateMaps(const struct NFA *nfa, u8 *map, const u8 *next) {
+    switch (nfa->type) {
+    case SHENG_NFA_0:
+        nfaExecSheng0_composeStateMaps(nfa, map, next);
+        break;
+    case MCCLELLAN_NFA_8:
+        nfaExecMcClellan8_composeStateMaps(nfa, map, next);
+        break;
+    default:
+        assert(0);
+    }
+}
+
+void nfaApplyStateMap(const struct NFA *nfa, const u8 *map, char *state) {
+    switch (nfa->type) {
+    case SHENG_NFA_0:
+        nfaExecSheng0_applyStateMap(nfa, map, state);
+        break;
+    case MCCLELLAN_NFA_8:
+        nfaExecMcClellan8_applyStateMap(nfa, map, state);
+        break;
+    default:
+        assert(0);
+    }
+}
@@ -37,8 +37,12 @@ extern "C"
 #include "ue2common.h"
 #include "callback.h"
 
-/** Size of mq::items, max elements on a queue. */
-#define MAX_MQE_LEN 10
+#include <string.h>
+
+/** Size of mq::items, max elements on a queue. Long runs of tops can be
+ * queued up and handed to an engine in a single exec call, rather than
+ * flushing the queue every few triggers. */
+#define MAX_MQE_LEN 32
 
 /** Queue events */
 
@@ -180,6 +184,39 @@ void pushQueueNoMerge(struct mq * restrict q, u32 e, s64a loc) {
     q->end = end + 1;
 }
 
+/** \brief Returns the number of items that can still be pushed onto the
+ * queue. */
+static really_inline
+u32 q_space(const struct mq *q) {
+    assert(q->end <= MAX_MQE_LEN);
+    return MAX_MQE_LEN - q->end;
+}
+
+/**
+ * Pushes a run of \a count items onto a queue in one go. The items must be in
+ * location order and must not contain duplicates; only the first item is
+ * merged with the last item already on the queue, as in @ref pushQueueSom.
+ * @param q queue
+ * @param items items to push
+ * @param count number of items, which must fit in the space left on the queue
+ */
+static really_inline
+void pushQueueItems(struct mq * restrict q, const struct mq_item *items,
+                    u32 count) {
+    DEBUG_PRINTF("pushing %u items -> %u\n", count, q->end);
+    if (!count) {
+        return;
+    }
+
+    pushQueueSom(q, items[0].type, items[0].location, items[0].som);
+    items++;
+    count--;
+
+    assert(count <= q_space(q));
+    memcpy(&q->items[q->end], items, count * sizeof(*items));
+    q->end += count;
+}
+
 /** \brief Returns the type of the current queue event. */
 static really_inline u32 q_cur_type(const struct mq *q) {
     assert(q->cur < q->end);
@@ -30,10 +30,12 @@
 
 #include "limex_internal.h"
 #include "mcclellancompile.h"
+#include "mcshengcompile.h"
 #include "shengcompile.h"
 #include "nfa_internal.h"
 #include "repeat_internal.h"
 #include "ue2common.h"
+#include "util/target_info.h"
 
 #include <algorithm>
 #include <cassert>
@@ -170,6 +172,18 @@ enum NFACategory {NFA_LIMEX, NFA_OTHER};
 #define DO_IF_DUMP_SUPPORT(a)
 #endif
 
+/*
+ * Scan costs are rough estimates of the cycles spent per byte of input by an
+ * unaccelerated engine of each type, in tenths of a cycle; see
+ * estimated_scan_cost().
+ */
+
+/* LimEx cost grows with the width of the state vector each byte must be run
+ * through. */
+static constexpr u32 limexScanCost(u32 mlt_size) {
+    return 15 + mlt_size / 8;
+}
+
 #define MAKE_LIMEX_TRAITS(mlt_size)                                     \
     template<> struct NFATraits<LIMEX_NFA_##mlt_size> {                 \
         static UNUSED const char *name;                                 \
@@ -182,6 +196,7 @@ enum NFACategory {NFA_LIMEX, NFA_OTHER};
         static const u32 stateAlign =                                   \
                 MAX(alignof(tableRow_t), alignof(RepeatControl));       \
         static const bool fast = mlt_size <= 64;                        \
+        static const u32 scanCost = limexScanCost(mlt_size);            \
     };                                                                  \
     const nfa_dispatch_fn NFATraits<LIMEX_NFA_##mlt_size>::has_accel    \
             = has_accel_limex<LimExNFA##mlt_size>;                      \
@@ -200,16 +215,19 @@ enum NFACategory {NFA_LIMEX, NFA_OTHER};
     };)
 
 MAKE_LIMEX_TRAITS(32)
+MAKE_LIMEX_TRAITS(64)
 MAKE_LIMEX_TRAITS(128)
 MAKE_LIMEX_TRAITS(256)
 MAKE_LIMEX_TRAITS(384)
 MAKE_LIMEX_TRAITS(512)
+MAKE_LIMEX_TRAITS(1024)
 
 template<> struct NFATraits<MCCLELLAN_NFA_8> {
     UNUSED static const char *name;
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 1;
     static const bool fast = true;
+    static const u32 scanCost = 30;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -226,6 +244,7 @@ template<> struct NFATraits<MCCLELLAN_NFA_16> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 2;
     static const bool fast = true;
+    static const u32 scanCost = 40;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -242,6 +261,7 @@ template<> struct NFATraits<GOUGH_NFA_8> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 8;
     static const bool fast = true;
+    static const u32 scanCost = 60;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -258,6 +278,7 @@ template<> struct NFATraits<GOUGH_NFA_16> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 8;
     static const bool fast = true;
+    static const u32 scanCost = 70;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -274,6 +295,7 @@ template<> struct NFATraits<MPV_NFA_0> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 8;
     static const bool fast = true;
+    static const u32 scanCost = 20;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -290,6 +312,7 @@ template<> struct NFATraits<CASTLE_NFA_0> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 8;
     static const bool fast = true;
+    static const u32 scanCost = 20;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -306,6 +329,7 @@ template<> struct NFATraits<LBR_NFA_Dot> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 8;
     static const bool fast = true;
+    static const u32 scanCost = 10;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -322,6 +346,7 @@ template<> struct NFATraits<LBR_NFA_Verm> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 8;
     static const bool fast = true;
+    static const u32 scanCost = 10;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -338,6 +363,7 @@ template<> struct NFATraits<LBR_NFA_NVerm> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 8;
     static const bool fast = true;
+    static const u32 scanCost = 10;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -354,6 +380,7 @@ template<> struct NFATraits<LBR_NFA_Shuf> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 8;
     static const bool fast = true;
+    static const u32 scanCost = 10;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -370,6 +397,7 @@ template<> struct NFATraits<LBR_NFA_Truf> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 8;
     static const bool fast = true;
+    static const u32 scanCost = 10;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -386,6 +414,7 @@ template<> struct NFATraits<SHENG_NFA_0> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 1;
     static const bool fast = true;
+    static const u32 scanCost = 10;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -402,6 +431,7 @@ template<> struct NFATraits<TAMARAMA_NFA_0> {
     static const NFACategory category = NFA_OTHER;
     static const u32 stateAlign = 32;
     static const bool fast = true;
+    static const u32 scanCost = 30;
     static const nfa_dispatch_fn has_accel;
     static const nfa_dispatch_fn has_repeats;
     static const nfa_dispatch_fn has_repeats_other_than_firsts;
@@ -413,6 +443,91 @@ const nfa_dispatch_fn NFATraits<TAMARAMA_NFA_0>::has_repeats_other_than_firsts =
 const char *NFATraits<TAMARAMA_NFA_0>::name = "Tamarama";
 #endif
 
+template<> struct NFATraits<SHENG_NFA_32> {
+    UNUSED static const char *name;
+    static const NFACategory category = NFA_OTHER;
+    static const u32 stateAlign = 1;
+    static const bool fast = true;
+    static const u32 scanCost = 15;
+    static const nfa_dispatch_fn has_accel;
+    static const nfa_dispatch_fn has_repeats;
+    static const nfa_dispatch_fn has_repeats_other_than_firsts;
+};
+const nfa_dispatch_fn NFATraits<SHENG_NFA_32>::has_accel = has_accel_sheng32;
+const nfa_dispatch_fn NFATraits<SHENG_NFA_32>::has_repeats = dispatch_false;
+const nfa_dispatch_fn NFATraits<SHENG_NFA_32>::has_repeats_other_than_firsts = dispatch_false;
+#if defined(DUMP_SUPPORT)
+const char *NFATraits<SHENG_NFA_32>::name = "Sheng 32";
+#endif
+
+template<> struct NFATraits<SHENG_NFA_64> {
+    UNUSED static const char *name;
+    static const NFACategory category = NFA_OTHER;
+    static const u32 stateAlign = 1;
+    static const bool fast = true;
+    static const u32 scanCost = 15;
+    static const nfa_dispatch_fn has_accel;
+    static const nfa_dispatch_fn has_repeats;
+    static const nfa_dispatch_fn has_repeats_other_than_firsts;
+};
+const nfa_dispatch_fn NFATraits<SHENG_NFA_64>::has_accel = dispatch_false;
+const nfa_dispatch_fn NFATraits<SHENG_NFA_64>::has_repeats = dispatch_false;
+const nfa_dispatch_fn NFATraits<SHENG_NFA_64>::has_repeats_other_than_firsts = dispatch_false;
+#if defined(DUMP_SUPPORT)
+const char *NFATraits<SHENG_NFA_64>::name = "Sheng 64";
+#endif
+
+template<> struct NFATraits<MCSHENG_NFA_8> {
+    UNUSED static const char *name;
+    static const NFACategory category = NFA_OTHER;
+    static const u32 stateAlign = 1;
+    static const bool fast = true;
+    static const u32 scanCost = 20;
+    static const nfa_dispatch_fn has_accel;
+    static const nfa_dispatch_fn has_repeats;
+    static const nfa_dispatch_fn has_repeats_other_than_firsts;
+};
+const nfa_dispatch_fn NFATraits<MCSHENG_NFA_8>::has_accel = has_accel_mcsheng;
+const nfa_dispatch_fn NFATraits<MCSHENG_NFA_8>::has_repeats = dispatch_false;
+const nfa_dispatch_fn NFATraits<MCSHENG_NFA_8>::has_repeats_other_than_firsts = dispatch_false;
+#if defined(DUMP_SUPPORT)
+const char *NFATraits<MCSHENG_NFA_8>::name = "McSheng 8";
+#endif
+
+template<> struct NFATraits<MCSHENG_NFA_16> {
+    UNUSED static const char *name;
+    static const NFACategory category = NFA_OTHER;
+    static const u32 stateAlign = 2;
+    static const bool fast = true;
+    static const u32 scanCost = 30;
+    static const nfa_dispatch_fn has_accel;
+    static const nfa_dispatch_fn has_repeats;
+    static const nfa_dispatch_fn has_repeats_other_than_firsts;
+};
+const nfa_dispatch_fn NFATraits<MCSHENG_NFA_16>::has_accel = has_accel_mcsheng;
+const nfa_dispatch_fn NFATraits<MCSHENG_NFA_16>::has_repeats = dispatch_false;
+const nfa_dispatch_fn NFATraits<MCSHENG_NFA_16>::has_repeats_other_than_firsts = dispatch_false;
+#if defined(DUMP_SUPPORT)
+const char *NFATraits<MCSHENG_NFA_16>::name = "McSheng 16";
+#endif
+
+template<> struct NFATraits<DFA_GROUP_NFA_0> {
+    UNUSED static const char *name;
+    static const NFACategory category = NFA_OTHER;
+    static const u32 stateAlign = 2;
+    static const bool fast = true;
+    static const u32 scanCost = 30;
+    static const nfa_dispatch_fn has_accel;
+    static const nfa_dispatch_fn has_repeats;
+    static const nfa_dispatch_fn has_repeats_other_than_firsts;
+};
+const nfa_dispatch_fn NFATraits<DFA_GROUP_NFA_0>::has_accel = dispatch_false;
+const nfa_dispatch_fn NFATraits<DFA_GROUP_NFA_0>::has_repeats = dispatch_false;
+const nfa_dispatch_fn NFATraits<DFA_GROUP_NFA_0>::has_repeats_other_than_firsts = dispatch_false;
+#if defined(DUMP_SUPPORT)
+const char *NFATraits<DFA_GROUP_NFA_0>::name = "DFA Group";
+#endif
+
 } // namespace
 
 #if defined(DUMP_SUPPORT)
@@ -454,6 +569,15 @@ bool is_fast(const NFA &nfa) {
     return DISPATCH_BY_NFA_TYPE(t, getFastness, nullptr);
 }
 
+namespace {
+template<NFAEngineType t>
+struct getScanCost {
+    static u32 call(void *) {
+        return NFATraits<t>::scanCost;
+    }
+};
+}
+
 namespace {
 template<NFAEngineType t>
 struct is_limex {
@@ -506,8 +630,63 @@ bool has_accel(const NFA &nfa) {
                                 &nfa)(&nfa);
 }
 
+/* DFA transition tables larger than this no longer stay in L1 cache. */
+static const u32 DFA_CACHE_RESIDENT_BYTES = 32 * 1024;
+
+u32 estimated_scan_cost(const NFA &nfa, const target_t &target) {
+    const NFAEngineType t = (NFAEngineType)nfa.type;
+    u32 cost = DISPATCH_BY_NFA_TYPE(t, getScanCost, nullptr);
+    bool limex = DISPATCH_BY_NFA_TYPE(t, is_limex, &nfa);
+
+    if (limex) {
+        // Wide state vectors take fewer operations with wider registers.
+        if (nfa.nPositions > 128 && target.has_avx2()) {
+            cost = cost * 3 / 4;
+        }
+        if (nfa.nPositions > 256 && target.has_avx512()) {
+            cost = cost * 2 / 3;
+        }
+        if (has_bounded_repeats(nfa)) {
+            cost += 10;
+        }
+    }
+
+    if (isDfaType(t) && !isShengType(t)
+        && nfa.length > DFA_CACHE_RESIDENT_BYTES) {
+        cost = cost * 3 / 2;
+    }
+
+    // Shuffle-based engines are slow on Atom-class cores.
+    if ((isShengType(t) || isMcShengType(t)) && target.is_atom_class()) {
+        cost *= 2;
+    }
+
+    // DFA acceleration applies in every accelerable state; LimEx acceleration
+    // only once the set of live states is small enough.
+    if (has_accel(nfa)) {
+        cost = limex ? cost * 2 / 3 : cost / 2;
+    }
+
+    return max(cost, 1U);
+}
+
 bool requires_decompress_key(const NFA &nfa) {
     return DISPATCH_BY_NFA_TYPE((NFAEngineType)nfa.type, is_limex, &nfa);
 }
 
+u32 repeat_stream_state_size(const NFA &nfa) {
+    if (nfa.type == CASTLE_NFA_0 || nfa.type == MPV_NFA_0 ||
+        isLbrType(nfa.type)) {
+        return nfa.streamStateSize;
+    }
+    if (isNfaType(nfa.type)) {
+        // Repeat state follows the state vector, whose size is at the same
+        // offset in every LimEx width.
+        const LimExNFA32 *limex = (const LimExNFA32 *)getImplNfa(&nfa);
+        assert(limex->stateSize <= nfa.streamStateSize);
+        return nfa.streamStateSize - limex->stateSize;
+    }
+    return 0;
+}
+
 } // namespace ue2
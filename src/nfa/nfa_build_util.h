@@ -38,6 +38,8 @@ struct NFA;
 
 namespace ue2 {
 
+struct target_t;
+
 #ifdef DUMP_SUPPORT
 /* provided for debugging functions */
 const char *nfa_type_name(NFAEngineType type);
@@ -59,6 +61,19 @@ bool has_accel(const NFA &n);
 
 bool requires_decompress_key(const NFA &n);
 
+/** \brief Bytes of the stream state of \a n used by bounded repeats. */
+u32 repeat_stream_state_size(const NFA &n);
+
+/**
+ * \brief Estimated cost of scanning data with \a n on \a target, in tenths of
+ * a cycle per byte.
+ *
+ * This is a static model based on the engine type, its size and features and
+ * the target's instruction set; it is used to choose between alternative
+ * implementations of the same graph.
+ */
+u32 estimated_scan_cost(const NFA &n, const target_t &target);
+
 } // namespace ue2
 
 #endif
@@ -36,9 +36,11 @@
 // Engine implementations.
 #include "goughdump.h"
 #include "castle_dump.h"
+#include "dfagroup_dump.h"
 #include "lbr_dump.h"
 #include "limex.h"
 #include "mcclellandump.h"
+#include "mcshengdump.h"
 #include "mpv_dump.h"
 #include "shengdump.h"
 #include "tamarama_dump.h"
@@ -60,10 +62,12 @@ namespace ue2 {
     DEBUG_PRINTF("dispatch for NFA type %u\n", nfa->type);    \
     switch (nfa->type) {                                      \
         DISPATCH_CASE(LIMEX, LimEx, 32, dbnt_func);           \
+        DISPATCH_CASE(LIMEX, LimEx, 64, dbnt_func);           \
         DISPATCH_CASE(LIMEX, LimEx, 128, dbnt_func);          \
         DISPATCH_CASE(LIMEX, LimEx, 256, dbnt_func);          \
         DISPATCH_CASE(LIMEX, LimEx, 384, dbnt_func);          \
         DISPATCH_CASE(LIMEX, LimEx, 512, dbnt_func);          \
+        DISPATCH_CASE(LIMEX, LimEx, 1024, dbnt_func);         \
         DISPATCH_CASE(MCCLELLAN, McClellan, 8, dbnt_func);    \
         DISPATCH_CASE(MCCLELLAN, McClellan, 16, dbnt_func);   \
         DISPATCH_CASE(GOUGH, Gough, 8, dbnt_func);            \
@@ -77,6 +81,11 @@ namespace ue2 {
         DISPATCH_CASE(CASTLE, Castle, 0, dbnt_func);          \
         DISPATCH_CASE(SHENG, Sheng, 0, dbnt_func);            \
         DISPATCH_CASE(TAMARAMA, Tamarama, 0, dbnt_func);      \
+        DISPATCH_CASE(SHENG, Sheng, 32, dbnt_func);           \
+        DISPATCH_CASE(SHENG, Sheng, 64, dbnt_func);           \
+        DISPATCH_CASE(MCSHENG, McSheng, 8, dbnt_func);        \
+        DISPATCH_CASE(MCSHENG, McSheng, 16, dbnt_func);       \
+        DISPATCH_CASE(DFA_GROUP, DfaGroup, 0, dbnt_func);     \
     default:                                                  \
         assert(0);                                            \
     }
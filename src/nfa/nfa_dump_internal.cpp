@@ -32,7 +32,11 @@
 
 #include "accel.h"
 #include "nfa_internal.h"
+#include "trufflecompile.h"
 #include "ue2common.h"
+#include "util/charreach.h"
+#include "util/dump_charclass.h"
+#include "util/simd_utils.h"
 
 #include <cctype> // for isprint
 #include <sstream>
@@ -128,6 +132,12 @@ void dumpTextReverse(const struct NFA *nfa, FILE *f) {
         fprintf(f, "R EOD x2 NOCASE");
         twofer = true;
         break;
+    case ACCEL_RTRUFFLE_LOW:
+        fprintf(f, "R TRUFFLE %s offset %hhd\n",
+                describeClass(truffle2cr(nfa->rAccelData.mask, zeroes128()))
+                    .c_str(),
+                nfa->rAccelOffset);
+        return;
     default:
         fprintf(f, "UNKNOWN\n");
         return;
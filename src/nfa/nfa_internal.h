@@ -38,6 +38,7 @@ extern "C"
 #endif
 
 #include "ue2common.h"
+#include "util/simd_types.h"
 
 // Constants
 
@@ -47,15 +48,18 @@ extern "C"
 
 #define NFA_ACCEPTS_EOD 1U     /**< can produce matches on EOD. */
 #define NFA_ZOMBIE      2U     /**< supports zombies */
+#define NFA_LIMEX_CACHE 4U     /**< uses the LimEx lazy DFA cache in scratch */
 
 // Common data structures for NFAs
 
 enum NFAEngineType {
     LIMEX_NFA_32,
+    LIMEX_NFA_64,
     LIMEX_NFA_128,
     LIMEX_NFA_256,
     LIMEX_NFA_384,
     LIMEX_NFA_512,
+    LIMEX_NFA_1024,
     MCCLELLAN_NFA_8,    /**< magic pseudo nfa */
     MCCLELLAN_NFA_16,   /**< magic pseudo nfa */
     GOUGH_NFA_8,        /**< magic pseudo nfa */
@@ -69,6 +73,11 @@ enum NFAEngineType {
     CASTLE_NFA_0,       /**< magic pseudo nfa */
     SHENG_NFA_0,        /**< magic pseudo nfa */
     TAMARAMA_NFA_0,     /**< magic nfa container */
+    SHENG_NFA_32,       /**< magic pseudo nfa */
+    SHENG_NFA_64,       /**< magic pseudo nfa */
+    MCSHENG_NFA_8,      /**< magic pseudo nfa */
+    MCSHENG_NFA_16,     /**< magic pseudo nfa */
+    DFA_GROUP_NFA_0,    /**< magic nfa container */
     /** \brief bogus NFA - not used */
     INVALID_NFA
 };
@@ -94,6 +103,7 @@ struct ALIGN_CL_DIRECTIVE NFA {
         u8 c;
         u16 dc;
         u8 array[2];
+        m128 mask; /**< truffle mask for a class of bytes below 0x80 */
     } rAccelData;
 
     u32 queueIndex; /**< index of the associated queue in scratch */
@@ -137,6 +147,10 @@ static really_inline u32 nfaSupportsZombie(const struct NFA *nfa) {
     return nfa->flags & NFA_ZOMBIE;
 }
 
+static really_inline u32 nfaUsesLimExCache(const struct NFA *nfa) {
+    return nfa->flags & NFA_LIMEX_CACHE;
+}
+
 /** \brief True if the given type (from NFA::type) is a McClellan DFA. */
 static really_inline int isMcClellanType(u8 t) {
     return t == MCCLELLAN_NFA_8 || t == MCCLELLAN_NFA_16;
@@ -149,25 +163,39 @@ static really_inline int isGoughType(u8 t) {
 
 /** \brief True if the given type (from NFA::type) is a Sheng DFA. */
 static really_inline int isShengType(u8 t) {
-    return t == SHENG_NFA_0;
+    return t == SHENG_NFA_0 || t == SHENG_NFA_32 || t == SHENG_NFA_64;
+}
+
+/** \brief True if the given type (from NFA::type) is a McSheng DFA. */
+static really_inline int isMcShengType(u8 t) {
+    return t == MCSHENG_NFA_8 || t == MCSHENG_NFA_16;
 }
 
 /**
- * \brief True if the given type (from NFA::type) is a McClellan, Gough or
- * Sheng DFA.
+ * \brief True if the given type (from NFA::type) is a McClellan, Gough,
+ * Sheng or McSheng DFA.
  */
 static really_inline int isDfaType(u8 t) {
-    return isMcClellanType(t) || isGoughType(t) || isShengType(t);
+    return isMcClellanType(t) || isGoughType(t) || isShengType(t)
+        || isMcShengType(t);
+}
+
+/** \brief True if the given type (from NFA::type) is a DFA with 16-bit
+ * state. */
+static really_inline int isBigDfaType(u8 t) {
+    return t == MCCLELLAN_NFA_16 || t == GOUGH_NFA_16 || t == MCSHENG_NFA_16;
 }
 
 /** \brief True if the given type (from NFA::type) is an NFA. */
 static really_inline int isNfaType(u8 t) {
     switch (t) {
     case LIMEX_NFA_32:
+    case LIMEX_NFA_64:
     case LIMEX_NFA_128:
     case LIMEX_NFA_256:
     case LIMEX_NFA_384:
     case LIMEX_NFA_512:
+    case LIMEX_NFA_1024:
         return 1;
     default:
         break;
@@ -188,9 +216,15 @@ int isContainerType(u8 t) {
     return t == TAMARAMA_NFA_0;
 }
 
+/** \brief True if the given type (from NFA::type) is a DFA group. */
+static really_inline
+int isDfaGroupType(u8 t) {
+    return t == DFA_GROUP_NFA_0;
+}
+
 static really_inline
 int isMultiTopType(u8 t) {
-    return !isDfaType(t) && !isLbrType(t);
+    return !isDfaType(t) && !isLbrType(t) && !isDfaGroupType(t);
 }
 
 /** Macros used in place of unimplemented NFA API functions for a given
@@ -35,7 +35,9 @@
 
 #include "accel.h"
 #include "nfa_internal.h"
+#include "truffle.h"
 #include "vermicelli.h"
+#include "util/simd_utils.h"
 #include "util/unaligned.h"
 
 static really_inline
@@ -89,6 +91,16 @@ size_t nfaRevAccel_i(const struct NFA *nfa, const u8 *buffer, size_t length) {
                                    buffer + length + 1 - nfa->rAccelOffset);
         length = (size_t)(rv - buffer + nfa->rAccelOffset);
         break;
+    case ACCEL_RTRUFFLE_LOW:
+        DEBUG_PRINTF("ACCEL_RTRUFFLE_LOW\n");
+        if (length + 1 - nfa->rAccelOffset < 16) {
+            break;
+        }
+
+        rv = rtruffleExec(nfa->rAccelData.mask, zeroes128(), buffer,
+                          buffer + length + 1 - nfa->rAccelOffset);
+        length = (size_t)(rv - buffer + nfa->rAccelOffset);
+        break;
     case ACCEL_REOD:
         DEBUG_PRINTF("ACCEL_REOD\n");
         if (buffer[length - nfa->rAccelOffset] != nfa->rAccelData.c) {
@@ -38,6 +38,7 @@
 #include "util/multibit.h"
 #include "util/pack_bits.h"
 #include "util/partial_store.h"
+#include "util/simd_utils.h"
 #include "util/unaligned.h"
 
 #include <stdint.h>
@@ -62,6 +63,34 @@ u32 ringOccupancy(const struct RepeatRingControl *xs, const u32 ringSize) {
     }
 }
 
+/** \brief True if the ring is small enough to be held in a single m256.
+ *
+ * Such rings use the flat multibit model, in which bit i is bit (i % 8) of
+ * byte (i / 8), so we can load, mask and store the whole ring at once. */
+static really_inline
+char ringIsFlat(const u32 ringSize) {
+    return ringSize <= sizeof(m256) * 8 && mmbit_is_flat_model(ringSize);
+}
+
+/** \brief Returns a mask with bits [begin, end) switched on, for use with a
+ * flat ring. */
+static really_inline
+m256 ringRangeMask(u32 begin, u32 end) {
+    assert(begin <= end);
+    assert(end <= sizeof(m256) * 8);
+
+    u64a words[4];
+    for (u32 k = 0; k < 4; k++) {
+        u32 base = k * 64;
+        u32 lo = MIN(MAX(begin, base) - base, 64);
+        u32 hi = MIN(MAX(end, base) - base, 64);
+        u64a below_lo = lo == 64 ? ~0ULL : (1ULL << lo) - 1;
+        u64a below_hi = hi == 64 ? ~0ULL : (1ULL << hi) - 1;
+        words[k] = below_hi & ~below_lo;
+    }
+    return loadu256(words);
+}
+
 /** \brief Returns the offset of the _last_ top stored in the ring. */
 static
 u64a ringLastTop(const struct RepeatRingControl *xs, const u32 ringSize) {
@@ -403,15 +432,31 @@ void repeatStoreRing(const struct RepeatInfo *info, union RepeatControl *ctrl,
 
         u32 i = xs->last + n;
 
-        mmbit_unset_range(ring, ringSize, xs->last, MIN(i, ringSize));
-        if (i >= ringSize) {
-            i -= ringSize;
-            mmbit_unset_range(ring, ringSize, 0, i);
-        }
+        if (ringIsFlat(ringSize)) {
+            // Clear the run of zeroes (which may wrap) and set the new top
+            // with one masked update of the whole ring.
+            const u32 ringBytes = mmbit_flat_size(ringSize);
+            m256 clear = ringRangeMask(xs->last, MIN(i, ringSize));
+            if (i >= ringSize) {
+                i -= ringSize;
+                clear = or256(clear, ringRangeMask(0, i));
+            }
+            assert(i != xs->first);
+            DEBUG_PRINTF("set bit %u\n", i);
+            m256 bits = loadbytes256(ring, ringBytes);
+            bits = or256(andnot256(clear, bits), mask1bit256(i));
+            storebytes256(ring, bits, ringBytes);
+        } else {
+            mmbit_unset_range(ring, ringSize, xs->last, MIN(i, ringSize));
+            if (i >= ringSize) {
+                i -= ringSize;
+                mmbit_unset_range(ring, ringSize, 0, i);
+            }
 
-        assert(i != xs->first);
-        DEBUG_PRINTF("set bit %u\n", i);
-        mmbit_set(ring, ringSize, i);
+            assert(i != xs->first);
+            DEBUG_PRINTF("set bit %u\n", i);
+            mmbit_set(ring, ringSize, i);
+        }
         xs->last = i + 1;
         if (xs->last == ringSize) {
             xs->last = 0;
@@ -593,6 +638,17 @@ int ringHasMatch(const struct RepeatRingControl *xs, const u8 *ring,
         end -= ringSize;
     }
 
+    if (ringIsFlat(ringSize)) {
+        m256 mask;
+        if (i < end) {
+            mask = ringRangeMask(i, end);
+        } else {
+            mask = or256(ringRangeMask(i, ringSize), ringRangeMask(0, end));
+        }
+        m256 bits = loadbytes256(ring, mmbit_flat_size(ringSize));
+        return isnonzero256(and256(bits, mask));
+    }
+
     // First scan, either to end if there's no wrap-around or ringSize (end of
     // the underlying multibit) if we are wrapping.
 
@@ -799,6 +855,89 @@ enum RepeatMatch repeatHasMatchRange(const struct RepeatInfo *info,
     return REPEAT_NOMATCH;
 }
 
+/** \brief Returns slot \a i of a ::REPEAT_DELTA list, which is packed into
+ * \a bits bits per slot. */
+static really_inline
+u16 deltaLoad(const u8 *state, u32 bits, u32 i) {
+    const u32 bit = i * bits;
+    const u32 shift = bit % 8;
+    const u32 len = (shift + bits + 7) / 8;
+    u64a v = partial_load_u64a(state + bit / 8, len);
+    return (u16)((v >> shift) & ((1ULL << bits) - 1));
+}
+
+/** \brief Writes \a val into slot \a i of a ::REPEAT_DELTA list. */
+static really_inline
+void deltaStore(u8 *state, u32 bits, u32 i, u16 val) {
+    const u32 bit = i * bits;
+    const u32 shift = bit % 8;
+    const u32 len = (shift + bits + 7) / 8;
+    const u64a mask = ((1ULL << bits) - 1) << shift;
+    assert(val < (1ULL << bits));
+    u8 *p = state + bit / 8;
+    u64a v = partial_load_u64a(p, len);
+    v = (v & ~mask) | ((u64a)val << shift);
+    partial_store_u64a(p, v, len);
+}
+
+/** \brief Unpacks the first \a num slots of a ::REPEAT_DELTA list into a
+ * ::REPEAT_RANGE style array of u16 values. */
+static really_inline
+void deltaDecode(const struct RepeatInfo *info, u32 num, const void *state,
+                 u16 *ring) {
+    const u32 bits = info->packedFieldSizes[0];
+    assert(num <= REPEAT_RANGE_MAX_SLOTS);
+    for (u32 i = 0; i < num; i++) {
+        ring[i] = deltaLoad((const u8 *)state, bits, i);
+    }
+}
+
+/** \brief Packs the first \a num values of a ::REPEAT_RANGE style array back
+ * into a ::REPEAT_DELTA list. */
+static really_inline
+void deltaEncode(const struct RepeatInfo *info, u32 num, const u16 *ring,
+                 void *state) {
+    const u32 bits = info->packedFieldSizes[0];
+    assert(num <= REPEAT_RANGE_MAX_SLOTS);
+    for (u32 i = 0; i < num; i++) {
+        deltaStore((u8 *)state, bits, i, ring[i]);
+    }
+}
+
+u64a repeatLastTopDelta(const struct RepeatInfo *info,
+                        const union RepeatControl *ctrl, const void *state) {
+    const struct RepeatRangeControl *xs = &ctrl->range;
+    assert(xs->num);
+    return xs->offset + deltaLoad((const u8 *)state, info->packedFieldSizes[0],
+                                  xs->num - 1);
+}
+
+u64a repeatNextMatchDelta(const struct RepeatInfo *info,
+                          const union RepeatControl *ctrl, const void *state,
+                          u64a offset) {
+    u16 ring[REPEAT_RANGE_MAX_SLOTS];
+    deltaDecode(info, ctrl->range.num, state, ring);
+    return repeatNextMatchRange(info, ctrl, ring, offset);
+}
+
+void repeatStoreDelta(const struct RepeatInfo *info, union RepeatControl *ctrl,
+                      void *state, u64a offset, char is_alive) {
+    u16 ring[REPEAT_RANGE_MAX_SLOTS];
+    if (is_alive) {
+        deltaDecode(info, ctrl->range.num, state, ring);
+    }
+    repeatStoreRange(info, ctrl, ring, offset, is_alive);
+    deltaEncode(info, ctrl->range.num, ring, state);
+}
+
+enum RepeatMatch repeatHasMatchDelta(const struct RepeatInfo *info,
+                                     const union RepeatControl *ctrl,
+                                     const void *state, u64a offset) {
+    u16 ring[REPEAT_RANGE_MAX_SLOTS];
+    deltaDecode(info, ctrl->range.num, state, ring);
+    return repeatHasMatchRange(info, ctrl, ring, offset);
+}
+
 enum RepeatMatch repeatHasMatchBitmap(const struct RepeatInfo *info,
                                       const union RepeatControl *ctrl,
                                       u64a offset) {
@@ -883,6 +1022,20 @@ enum RepeatMatch repeatHasMatchTrailer(const struct RepeatInfo *info,
 }
 
 /** \brief True if the given value can be packed into len bytes.  */
+void repeatStoreBatch(const struct RepeatStoreEntry *entries, u32 count,
+                      u64a offset) {
+    DEBUG_PRINTF("storing %u tops at offset %llu\n", count, offset);
+    for (u32 i = 0; i < count; i++) {
+        const struct RepeatStoreEntry *e = &entries[i];
+        if (i + 1 < count) {
+            // The next repeat's state is independent of this one, so start
+            // fetching it while we work.
+            __builtin_prefetch(entries[i + 1].state);
+        }
+        repeatStore(e->info, e->ctrl, e->state, offset, e->is_alive);
+    }
+}
+
 static really_inline
 int fits_in_len_bytes(u64a val, u32 len) {
     if (len >= 8) {
@@ -1045,6 +1198,7 @@ void repeatPack(char *dest, const struct RepeatInfo *info,
         repeatPackOffset(dest, info, ctrl, offset);
         break;
     case REPEAT_RANGE:
+    case REPEAT_DELTA:
         repeatPackRange(dest, info, ctrl, offset);
         break;
     case REPEAT_BITMAP:
@@ -1163,6 +1317,7 @@ void repeatUnpack(const char *src, const struct RepeatInfo *info, u64a offset,
         repeatUnpackOffset(src, info, offset, ctrl);
         break;
     case REPEAT_RANGE:
+    case REPEAT_DELTA:
         repeatUnpackRange(src, info, offset, ctrl);
         break;
     case REPEAT_BITMAP:
@@ -1208,6 +1363,25 @@ void storeInitialRingTopPatch(const struct RepeatInfo *info,
     xs->last = 1;
 }
 
+/** \brief Returns the largest index j in [0, hi] with table[j] <= val, or -1
+ * if there is none.
+ *
+ * The repeat table is strictly increasing, so this is a binary search rather
+ * than a scan of every entry. */
+static really_inline
+s32 sparseTableSearch(const u64a *table, s32 hi, u64a val) {
+    s32 lo = 0;
+    while (lo <= hi) {
+        s32 mid = lo + (hi - lo) / 2;
+        if (table[mid] <= val) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo - 1;
+}
+
 static
 u32 getSparseOptimalTargetValue(const struct RepeatInfo *info,
                                 const u32 tval, u64a *val) {
@@ -1215,13 +1389,18 @@ u32 getSparseOptimalTargetValue(const struct RepeatInfo *info,
     const u64a *repeatTable = getImplTable(info);
     u32 loc = 0;
     DEBUG_PRINTF("val:%llu \n", *val);
-    for (u32 i = 1; i <= patch_size - tval; i++) {
-        u64a tmp = repeatTable[patch_size - i];
-        if (*val >= tmp) {
-            *val -= tmp;
-            loc = i;
-            i += (info->minPeriod - 1);
+
+    // Decode tops greedily from the top of the patch down to tval: each one
+    // is the largest table entry that still fits in what is left of val.
+    s32 idx = (s32)patch_size - 1;
+    while (idx >= (s32)tval) {
+        s32 j = sparseTableSearch(repeatTable, idx, *val);
+        if (j < (s32)tval) {
+            break;
         }
+        *val -= repeatTable[j];
+        loc = patch_size - j;
+        idx = j - (s32)info->minPeriod;
     }
 
     return loc;
@@ -1247,16 +1426,10 @@ u64a sparseLastTop(const struct RepeatInfo *info,
 
     DEBUG_PRINTF("val:%llu\n", val);
     const u64a *repeatTable = getImplTable(info);
-    for (s32 i = patch_size - 1; i >= 0; i--) {
-        if (val >= repeatTable[i]) {
-            DEBUG_PRINTF("xs->offset%llu v%u p%llu\n",
-                         xs->offset, i, repeatTable[i]);
-            return xs->offset + i + (occ - 1) * patch_size;
-        }
-    }
-
-    assert(0);
-    return 0;
+    s32 i = sparseTableSearch(repeatTable, (s32)patch_size - 1, val);
+    assert(i >= 0);
+    DEBUG_PRINTF("xs->offset%llu v%d p%llu\n", xs->offset, i, repeatTable[i]);
+    return xs->offset + i + (occ - 1) * patch_size;
 }
 
 u64a repeatLastTopSparseOptimalP(const struct RepeatInfo *info,
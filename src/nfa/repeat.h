@@ -72,6 +72,20 @@ static really_inline
 void repeatStore(const struct RepeatInfo *info, union RepeatControl *ctrl,
                  void *state, u64a offset, char is_alive);
 
+/** \brief One repeat to be updated by \ref repeatStoreBatch. */
+struct RepeatStoreEntry {
+    const struct RepeatInfo *info;
+    union RepeatControl *ctrl;
+    void *state;
+    char is_alive;
+};
+
+/** \brief Stores a new top at the same offset in each of \a count repeats,
+ * as though \ref repeatStore had been called on each entry in turn. The
+ * entries must refer to distinct repeats. */
+void repeatStoreBatch(const struct RepeatStoreEntry *entries, u32 count,
+                      u64a offset);
+
 /** Return type for repeatHasMatch. */
 enum RepeatMatch {
     REPEAT_NOMATCH, /**< This offset is not a valid match. */
@@ -107,6 +121,9 @@ u64a repeatLastTopRing(const struct RepeatInfo *info,
 u64a repeatLastTopRange(const union RepeatControl *ctrl,
                         const void *state);
 
+u64a repeatLastTopDelta(const struct RepeatInfo *info,
+                        const union RepeatControl *ctrl, const void *state);
+
 u64a repeatLastTopBitmap(const union RepeatControl *ctrl);
 
 u64a repeatLastTopTrailer(const struct RepeatInfo *info,
@@ -129,6 +146,8 @@ u64a repeatLastTop(const struct RepeatInfo *info,
         return ctrl->offset.offset;
     case REPEAT_RANGE:
         return repeatLastTopRange(ctrl, state);
+    case REPEAT_DELTA:
+        return repeatLastTopDelta(info, ctrl, state);
     case REPEAT_BITMAP:
         return repeatLastTopBitmap(ctrl);
     case REPEAT_SPARSE_OPTIMAL_P:
@@ -169,6 +188,10 @@ u64a repeatNextMatchRange(const struct RepeatInfo *info,
                           const union RepeatControl *ctrl,
                           const void *state, u64a offset);
 
+u64a repeatNextMatchDelta(const struct RepeatInfo *info,
+                          const union RepeatControl *ctrl,
+                          const void *state, u64a offset);
+
 u64a repeatNextMatchBitmap(const struct RepeatInfo *info,
                            const union RepeatControl *ctrl, u64a offset);
 
@@ -196,6 +219,8 @@ u64a repeatNextMatch(const struct RepeatInfo *info,
         return repeatNextMatchOffset(info, ctrl, offset);
     case REPEAT_RANGE:
         return repeatNextMatchRange(info, ctrl, state, offset);
+    case REPEAT_DELTA:
+        return repeatNextMatchDelta(info, ctrl, state, offset);
     case REPEAT_BITMAP:
         return repeatNextMatchBitmap(info, ctrl, offset);
     case REPEAT_SPARSE_OPTIMAL_P:
@@ -235,6 +260,10 @@ void repeatStoreRange(const struct RepeatInfo *info,
                       union RepeatControl *ctrl, void *state, u64a offset,
                       char is_alive);
 
+void repeatStoreDelta(const struct RepeatInfo *info,
+                      union RepeatControl *ctrl, void *state, u64a offset,
+                      char is_alive);
+
 void repeatStoreBitmap(const struct RepeatInfo *info,
                        union RepeatControl *ctrl, u64a offset,
                        char is_alive);
@@ -270,6 +299,9 @@ void repeatStore(const struct RepeatInfo *info, union RepeatControl *ctrl,
     case REPEAT_RANGE:
         repeatStoreRange(info, ctrl, state, offset, is_alive);
         break;
+    case REPEAT_DELTA:
+        repeatStoreDelta(info, ctrl, state, offset, is_alive);
+        break;
     case REPEAT_BITMAP:
         repeatStoreBitmap(info, ctrl, offset, is_alive);
         break;
@@ -320,6 +352,10 @@ enum RepeatMatch repeatHasMatchRange(const struct RepeatInfo *info,
                                      const union RepeatControl *ctrl,
                                      const void *state, u64a offset);
 
+enum RepeatMatch repeatHasMatchDelta(const struct RepeatInfo *info,
+                                     const union RepeatControl *ctrl,
+                                     const void *state, u64a offset);
+
 enum RepeatMatch repeatHasMatchSparseOptimalP(const struct RepeatInfo *info,
                                               const union RepeatControl *ctrl,
                                               const void *state, u64a offset);
@@ -349,6 +385,8 @@ enum RepeatMatch repeatHasMatch(const struct RepeatInfo *info,
         return repeatHasMatchLast(info, ctrl, offset);
     case REPEAT_RANGE:
         return repeatHasMatchRange(info, ctrl, state, offset);
+    case REPEAT_DELTA:
+        return repeatHasMatchDelta(info, ctrl, state, offset);
     case REPEAT_BITMAP:
         return repeatHasMatchBitmap(info, ctrl, offset);
     case REPEAT_SPARSE_OPTIMAL_P:
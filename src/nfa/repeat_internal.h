@@ -86,6 +86,12 @@ enum RepeatType {
      * \ref RepeatTrailerControl structure at runtime. */
     REPEAT_TRAILER,
 
+    /** Like ::REPEAT_RANGE, but each top index is stored as a bit-packed delta
+     * from \ref RepeatRangeControl::offset, using only as many bits as are
+     * needed to represent repeatMax, rather than a full u16. Uses the \ref
+     * RepeatRangeControl structure at runtime. */
+    REPEAT_DELTA,
+
     /** Degenerate repeat that always returns true. Used by castle for pseudo
      * [^X]* repeats. */
     REPEAT_ALWAYS,
@@ -99,8 +105,8 @@ enum RepeatType {
  */
 #define REPEAT_INF 65535
 
-/** Max slots used by ::REPEAT_RANGE repeat model. */
-#define REPEAT_RANGE_MAX_SLOTS 16
+/** Max slots used by ::REPEAT_RANGE and ::REPEAT_DELTA repeat models. */
+#define REPEAT_RANGE_MAX_SLOTS 64
 
 /** Structure describing a bounded repeat in the bytecode */
 struct RepeatInfo {
@@ -118,7 +124,7 @@ struct RepeatInfo {
     u32 packedCtrlSize;
 
     /** Size of the repeat state block in bytes. This is where the REPEAT_RANGE
-     * vector and REPEAT_RING multibit are stored, in stream state, and they
+     * and REPEAT_DELTA vectors and REPEAT_RING multibit are stored, in stream state, and they
      * are manipulated directly (i.e. not copied at stream boundaries). */
     u32 stateSize;
 
@@ -126,7 +132,8 @@ struct RepeatInfo {
      * Used by REPEAT_SPARSE_OPTIMAL_P. */
     u32 minPeriod;
 
-    /** Packed control block field sizes (in bits), used by REPEAT_TRAILER. */
+    /** Packed control block field sizes (in bits), used by REPEAT_TRAILER.
+     * REPEAT_DELTA stores the width of each packed slot in the first. */
     u32 packedFieldSizes[2];
 
     /* Number of patches, used by REPEAT_SPARSE_OPTIMAL_P. */
@@ -155,8 +162,8 @@ struct RepeatRingControl {
     u16 last; //!< end index in ring.
 };
 
-/** Runtime control block structure for ::REPEAT_RANGE bounded repeats. Note
- * that this struct is packed (may not be aligned). */
+/** Runtime control block structure for ::REPEAT_RANGE and ::REPEAT_DELTA
+ * bounded repeats. Note that this struct is packed (may not be aligned). */
 struct RepeatRangeControl {
     u64a offset; //!< index of first top.
     u8 num; //!< number of elements in array.
@@ -208,6 +215,8 @@ const char *repeatTypeName(u8 type) {
         return "SPARSE_OPTIMAL_P";
     case REPEAT_TRAILER:
         return "TRAILER";
+    case REPEAT_DELTA:
+        return "DELTA";
     case REPEAT_ALWAYS:
         return "ALWAYS";
     }
@@ -162,6 +162,19 @@ RepeatStateInfo::RepeatStateInfo(enum RepeatType type, const depth &repeatMin,
         // elements.
         packedCtrlSize = calcPackedBytes(horizon + 1) + 1;
         break;
+    case REPEAT_DELTA:
+        assert(repeatMax.is_finite());
+        assert(repeatMin < repeatMax);
+        // Each slot holds a delta from the base offset, which is never more
+        // than repeatMax.
+        packedFieldSizes.resize(1);
+        packedFieldSizes[0] = calcPackedBits(repeatMax + 1);
+        stateSize = (numRangeSlots(repeatMin, repeatMax) * packedFieldSizes[0]
+                     + 7U) / 8U;
+        horizon = repeatMax * 2 + 1;
+        // As for REPEAT_RANGE.
+        packedCtrlSize = calcPackedBytes(horizon + 1) + 1;
+        break;
     case REPEAT_BITMAP:
         stateSize = 0; // everything is in the control block.
         horizon = 0;   // unused
@@ -220,22 +233,13 @@ RepeatStateInfo::RepeatStateInfo(enum RepeatType type, const depth &repeatMin,
     assert(packedCtrlSize <= sizeof(RepeatControl));
 }
 
-/** \brief Returns the packed control block size in bytes for a given bounded
- * repeat. */
-static
-u32 packedSize(enum RepeatType type, const depth &repeatMin,
-               const depth &repeatMax, u32 minPeriod) {
-    RepeatStateInfo rsi(type, repeatMin, repeatMax, minPeriod);
-    return rsi.packedCtrlSize;
-}
-
-/** \brief Returns the stream state size in bytes for a given bounded
- * repeat. */
+/** \brief Returns the total number of bytes of stream state (packed control
+ * block plus repeat state) used by the given bounded repeat. */
 static
-u32 streamStateSize(enum RepeatType type, const depth &repeatMin,
-                    const depth &repeatMax, u32 minPeriod) {
+u32 totalStateSize(enum RepeatType type, const depth &repeatMin,
+                   const depth &repeatMax, u32 minPeriod) {
     RepeatStateInfo rsi(type, repeatMin, repeatMax, minPeriod);
-    return rsi.stateSize;
+    return rsi.packedCtrlSize + rsi.stateSize;
 }
 
 enum RepeatType chooseRepeatType(const depth &repeatMin, const depth &repeatMax,
@@ -253,42 +257,41 @@ enum RepeatType chooseRepeatType(const depth &repeatMin, const depth &repeatMax,
         return REPEAT_LAST;
     }
 
-    // Cases with max < 64 can be handled with either bitmap or trailer. We use
-    // whichever has smaller packed state.
+    assert(repeatMax.is_finite());
 
+    // Otherwise, we choose the model that uses the fewest bytes of stream
+    // state from those that can represent this repeat. Candidates are listed
+    // in order of runtime preference, which is used to break ties.
+    vector<RepeatType> candidates;
     if (repeatMax < depth(64)) {
-        u32 bitmap_len =
-            packedSize(REPEAT_BITMAP, repeatMin, repeatMax, minPeriod);
-        u32 trailer_len =
-            packedSize(REPEAT_TRAILER, repeatMin, repeatMax, minPeriod);
-        return bitmap_len <= trailer_len ? REPEAT_BITMAP : REPEAT_TRAILER;
+        candidates.push_back(REPEAT_BITMAP);
     }
-
     if (repeatMin <= depth(64)) {
-        return REPEAT_TRAILER;
+        candidates.push_back(REPEAT_TRAILER);
     }
-
-    u32 range_len = ~0U;
     if (repeatMax > repeatMin &&
         numRangeSlots(repeatMin, repeatMax) <= REPEAT_RANGE_MAX_SLOTS) {
         assert(numRangeSlots(repeatMin, repeatMax) < 256); // stored in u8
-        range_len =
-        streamStateSize(REPEAT_RANGE, repeatMin, repeatMax, minPeriod);
+        candidates.push_back(REPEAT_RANGE);
+        candidates.push_back(REPEAT_DELTA);
     }
-
-    assert(repeatMax.is_finite());
-
-    u32 sparse_len = ~0U;
     if (minPeriod > 6) {
-        sparse_len =
-        streamStateSize(REPEAT_SPARSE_OPTIMAL_P, repeatMin, repeatMax, minPeriod);
+        candidates.push_back(REPEAT_SPARSE_OPTIMAL_P);
     }
-
-    if (range_len != ~0U || sparse_len != ~0U) {
-        return range_len < sparse_len ? REPEAT_RANGE : REPEAT_SPARSE_OPTIMAL_P;
+    candidates.push_back(REPEAT_RING);
+
+    RepeatType best = REPEAT_RING;
+    u32 best_len = ~0U;
+    for (const auto &type : candidates) {
+        u32 len = totalStateSize(type, repeatMin, repeatMax, minPeriod);
+        DEBUG_PRINTF("%s model needs %u bytes\n", repeatTypeName(type), len);
+        if (len < best_len) {
+            best = type;
+            best_len = len;
+        }
     }
 
-    return REPEAT_RING;
+    return best;
 }
 
 bool matches(vector<CharReach>::const_iterator a_it,
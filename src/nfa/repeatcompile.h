@@ -66,6 +66,9 @@ struct RepeatStateInfo {
 /**
  * \brief Given the parameters of a repeat, choose a repeat implementation
  * type.
+ *
+ * Bounded repeats use whichever model that can represent them needs the
+ * fewest bytes of stream state.
  */
 enum RepeatType chooseRepeatType(const depth &repeatMin, const depth &repeatMax,
                                  u32 minPeriod, bool is_reset,
@@ -545,6 +545,31 @@ char nfaExecSheng0_B(const struct NFA *n, u64a offset, const u8 *buffer,
     return state & SHENG_STATE_DEAD ? MO_DEAD : MO_ALIVE;
 }
 
+void nfaExecSheng0_SimpStream(const struct NFA *n, char *state, const u8 *buf,
+                              char top, size_t start_off, size_t len,
+                              NfaCallback cb, void *ctxt) {
+    assert(n->type == SHENG_NFA_0);
+    const struct sheng *sh = getImplNfa(n);
+    u8 s = top ? sh->anchored : *(u8 *)state;
+    if (s & SHENG_STATE_DEAD) {
+        return;
+    }
+
+    u8 cached_accept_state = 0;
+    ReportID cached_accept_id = 0;
+    const u8 *scanned;
+    runShengCb(sh, cb, ctxt, 0, &cached_accept_state, &cached_accept_id, buf,
+               buf + start_off, buf + len, sh->flags & SHENG_FLAG_CAN_DIE,
+               sh->flags & SHENG_FLAG_HAS_ACCEL,
+               sh->flags & SHENG_FLAG_SINGLE_REPORT, &scanned, &s);
+
+    *(u8 *)state = s;
+}
+
+char nfaExecSheng0_stateDead(const char *state) {
+    return *(const u8 *)state & SHENG_STATE_DEAD;
+}
+
 char nfaExecSheng0_Q(const struct NFA *n, struct mq *q, s64a end) {
     const struct sheng *sh = get_sheng(n);
     char rv = runSheng(sh, q, end, CALLBACK_OUTPUT);
@@ -674,3 +699,66 @@ char nfaExecSheng0_expandState(UNUSED const struct NFA *nfa, void *dest,
     *(u8 *)dest = *(const u8 *)src;
     return 0;
 }
+
+/* One lane per state: scanning from the identity permutation tracks the
+ * successor of every state at once, one PSHUFB per byte. */
+static const u8 sheng_identity[16] ALIGN_DIRECTIVE = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+char nfaExecSheng0_stateMap(const struct NFA *n, const u8 *buf, size_t len,
+                            u8 *map) {
+    const struct sheng *sh = get_sheng(n);
+    m128 s = load128(sheng_identity);
+    const u8 *c = buf, *c_end = buf + len;
+
+    /* state flags live in bits 4-6, which PSHUFB ignores */
+    while (c + 4 <= c_end) {
+        s = pshufb(sh->shuffle_masks[c[0]], s);
+        s = pshufb(sh->shuffle_masks[c[1]], s);
+        s = pshufb(sh->shuffle_masks[c[2]], s);
+        s = pshufb(sh->shuffle_masks[c[3]], s);
+        c += 4;
+    }
+    for (; c < c_end; c++) {
+        s = pshufb(sh->shuffle_masks[*c], s);
+    }
+
+    u8 tmp[16] ALIGN_DIRECTIVE;
+    store128(tmp, s);
+    memcpy(map, tmp, sh->n_states);
+    return 1;
+}
+
+void nfaExecSheng0_composeStateMaps(const struct NFA *n, u8 *map,
+                                    const u8 *next) {
+    const struct sheng *sh = get_sheng(n);
+    u8 a[16] ALIGN_DIRECTIVE;
+    u8 b[16] ALIGN_DIRECTIVE;
+    memset(a, 0, sizeof(a));
+    memset(b, 0, sizeof(b));
+    memcpy(a, map, sh->n_states);
+    memcpy(b, next, sh->n_states);
+    store128(a, pshufb(load128(b), load128(a)));
+    memcpy(map, a, sh->n_states);
+}
+
+void nfaExecSheng0_applyStateMap(UNUSED const struct NFA *n, const u8 *map,
+                                 char *state) {
+    assert(n->streamStateSize == 1);
+    u8 *s = (u8 *)state;
+    assert((*s & SHENG_STATE_MASK) < get_sheng(n)->n_states);
+    *s = map[*s & SHENG_STATE_MASK];
+}
+
+#if defined(__AVX512VBMI__)
+
+#define SHENG_SIZE 32
+#include "sheng_wide_impl.h"
+#undef SHENG_SIZE
+
+#define SHENG_SIZE 64
+#include "sheng_wide_impl.h"
+#undef SHENG_SIZE
+
+#endif // __AVX512VBMI__
@@ -0,0 +1,693 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Sheng-32 and Sheng-64: runtime implementation.
+ *
+ * These engines work in the same way as Sheng, but keep the current state in
+ * every byte of a 512-bit register and use VPERMB to look up the successor
+ * state, so a single instruction covers DFAs of up to 64 states.
+ *
+ * In order to use this header, the following must be defined:
+ *
+ *  - SHENG_SIZE (32 or 64, the maximum number of states)
+ */
+
+#define SHENG_T struct JOIN(sheng, SHENG_SIZE)
+#define SHENG_FN(x) JOIN(x, SHENG_SIZE)
+#define SHENG_API(x) JOIN3(nfaExecSheng, SHENG_SIZE, x)
+
+#define STATE_MASK JOIN3(SHENG, SHENG_SIZE, _STATE_MASK)
+#define STATE_ACCEPT JOIN3(SHENG, SHENG_SIZE, _STATE_ACCEPT)
+#define STATE_DEAD JOIN3(SHENG, SHENG_SIZE, _STATE_DEAD)
+#define STATE_ACCEL JOIN3(SHENG, SHENG_SIZE, _STATE_ACCEL)
+
+static really_inline
+const SHENG_T *SHENG_FN(get_sheng)(const struct NFA *n) {
+    return (const SHENG_T *)getImplNfa(n);
+}
+
+static really_inline
+const struct sstate_aux *SHENG_FN(get_aux)(const SHENG_T *sh, u8 id) {
+    u32 offset = sh->aux_offset - sizeof(struct NFA) +
+            (id & STATE_MASK) * sizeof(struct sstate_aux);
+    DEBUG_PRINTF("Getting aux for state %u at offset %llu\n",
+                 id & STATE_MASK, (u64a)offset + sizeof(struct NFA));
+    return (const struct sstate_aux *)((const char *) sh + offset);
+}
+
+static really_inline
+const union AccelAux *SHENG_FN(get_accel)(const SHENG_T *sh, u8 id) {
+    const struct sstate_aux *saux = SHENG_FN(get_aux)(sh, id);
+    DEBUG_PRINTF("Getting accel aux at offset %u\n", saux->accel);
+    const union AccelAux *aux = (const union AccelAux *)
+            ((const char *)sh + saux->accel - sizeof(struct NFA));
+    return aux;
+}
+
+static really_inline
+const struct report_list *SHENG_FN(get_rl)(const SHENG_T *sh,
+                                           const struct sstate_aux *aux) {
+    DEBUG_PRINTF("Getting report list at offset %u\n", aux->accept);
+    return (const struct report_list *)
+        ((const char *)sh + aux->accept - sizeof(struct NFA));
+}
+
+static really_inline
+const struct report_list *SHENG_FN(get_eod_rl)(const SHENG_T *sh,
+                                               const struct sstate_aux *aux) {
+    DEBUG_PRINTF("Getting EOD report list at offset %u\n", aux->accept);
+    return (const struct report_list *)
+        ((const char *)sh + aux->accept_eod - sizeof(struct NFA));
+}
+
+static really_inline
+char SHENG_FN(shengHasAccept)(const SHENG_T *sh, const struct sstate_aux *aux,
+                              ReportID report) {
+    assert(sh && aux);
+
+    const struct report_list *rl = SHENG_FN(get_rl)(sh, aux);
+    assert(ISALIGNED_N(rl, 4));
+
+    DEBUG_PRINTF("report list has %u entries\n", rl->count);
+
+    for (u32 i = 0; i < rl->count; i++) {
+        if (rl->report[i] == report) {
+            DEBUG_PRINTF("reporting %u\n", rl->report[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static really_inline
+char SHENG_FN(fireReports)(const SHENG_T *sh, NfaCallback cb, void *ctxt,
+                           const u8 state, u64a loc,
+                           u8 *const cached_accept_state,
+                           ReportID *const cached_accept_id, char eod) {
+    DEBUG_PRINTF("reporting matches @ %llu\n", loc);
+
+    if (!eod && state == *cached_accept_state) {
+        DEBUG_PRINTF("reporting %u\n", *cached_accept_id);
+        if (cb(0, loc, *cached_accept_id, ctxt) == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING; /* termination requested */
+        }
+
+        return MO_CONTINUE_MATCHING; /* continue execution */
+    }
+    const struct sstate_aux *aux = SHENG_FN(get_aux)(sh, state);
+    const struct report_list *rl =
+        eod ? SHENG_FN(get_eod_rl)(sh, aux) : SHENG_FN(get_rl)(sh, aux);
+    assert(ISALIGNED(rl));
+
+    DEBUG_PRINTF("report list has %u entries\n", rl->count);
+    u32 count = rl->count;
+
+    if (!eod && count == 1) {
+        *cached_accept_state = state;
+        *cached_accept_id = rl->report[0];
+
+        DEBUG_PRINTF("reporting %u\n", rl->report[0]);
+        if (cb(0, loc, rl->report[0], ctxt) == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING; /* termination requested */
+        }
+
+        return MO_CONTINUE_MATCHING; /* continue execution */
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        DEBUG_PRINTF("reporting %u\n", rl->report[i]);
+        if (cb(0, loc, rl->report[i], ctxt) == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING; /* termination requested */
+        }
+    }
+    return MO_CONTINUE_MATCHING; /* continue execution */
+}
+
+static really_inline
+char SHENG_FN(fireMatch)(const SHENG_T *sh, NfaCallback cb, void *ctxt,
+                         u8 state, u64a loc, u8 *const cached_accept_state,
+                         ReportID *const cached_accept_id, u8 single) {
+    DEBUG_PRINTF("Accept state %u reached\n", state & STATE_MASK);
+    DEBUG_PRINTF("Match @ %llu\n", loc);
+    if (single) {
+        return fireSingleReport(cb, ctxt, sh->report, loc);
+    }
+    return SHENG_FN(fireReports)(sh, cb, ctxt, state, loc, cached_accept_state,
+                                 cached_accept_id, 0);
+}
+
+static really_inline
+const u8 *SHENG_FN(shengAccel)(const SHENG_T *sh, u8 state, const u8 *cur_buf,
+                               const u8 *end, const u8 **min_accel_dist) {
+    const union AccelAux *aaux = SHENG_FN(get_accel)(sh, state);
+    const u8 *new_offset = run_accel(aaux, cur_buf, end);
+    if (new_offset < cur_buf + BAD_ACCEL_DIST) {
+        *min_accel_dist = new_offset + BIG_ACCEL_PENALTY;
+    } else {
+        *min_accel_dist = new_offset + SMALL_ACCEL_PENALTY;
+    }
+    DEBUG_PRINTF("Accel scanned %zu bytes\n", new_offset - cur_buf);
+    return new_offset;
+}
+
+static really_inline
+__m512i SHENG_FN(shengStep)(const m512 *masks, __m512i cur_state, u8 c) {
+    DEBUG_PRINTF("c: %02hhx '%c'\n", c, ourisprint(c) ? c : '?');
+    return _mm512_permutexvar_epi8(cur_state, _mm512_loadu_si512(&masks[c]));
+}
+
+static really_inline
+u8 SHENG_FN(shengState)(__m512i cur_state) {
+    return (u8)_mm_cvtsi128_si32(_mm512_castsi512_si128(cur_state));
+}
+
+/* Scans [start, end), four bytes at a time. As with Sheng, accept states are
+ * checked after every byte but dead and accel states only on every fourth
+ * byte; having died or being in an accel loop is sticky, so nothing is lost
+ * but a few bytes of work. The can_die, has_accel and mode arguments are
+ * always constants, so each caller gets its own specialised loop. */
+static really_inline
+char SHENG_FN(shengExec)(const SHENG_T *sh, NfaCallback cb, void *ctxt,
+                         u64a base_offset, u8 *const cached_accept_state,
+                         ReportID *const cached_accept_id, const u8 *buf,
+                         const u8 *start, const u8 *end, const char can_die,
+                         const char has_accel, u8 single,
+                         const enum MatchMode mode, const u8 **scan_end,
+                         u8 *state) {
+    DEBUG_PRINTF("Starting DFA execution in state %u\n", *state & STATE_MASK);
+    DEBUG_PRINTF("Scanning %lli bytes\n", (s64a)(end - start));
+
+    const u8 interesting = (mode != NO_MATCHES ? STATE_ACCEPT : 0) |
+                           (can_die ? STATE_DEAD : 0) |
+                           (has_accel ? STATE_ACCEL : 0);
+    const u8 *cur_buf = start;
+    const u8 *min_accel_dist = start;
+
+    if (can_die && (*state & STATE_DEAD)) {
+        DEBUG_PRINTF("Dead on arrival\n");
+        *scan_end = end;
+        return MO_CONTINUE_MATCHING;
+    }
+
+    if (has_accel && (*state & STATE_ACCEL)) {
+        DEBUG_PRINTF("Accel state reached @ 0\n");
+        cur_buf = SHENG_FN(shengAccel)(sh, *state, cur_buf, end,
+                                       &min_accel_dist);
+    }
+
+    __m512i cur_state = _mm512_set1_epi8(*state);
+    const m512 *masks = sh->succ_masks;
+
+    while (likely(end - cur_buf >= 4)) {
+        const u8 *b = cur_buf;
+        u8 a[4];
+        for (u32 i = 0; i < 4; i++) {
+            cur_state = SHENG_FN(shengStep)(masks, cur_state, b[i]);
+            a[i] = SHENG_FN(shengState)(cur_state);
+            DEBUG_PRINTF("s: %u\n", a[i] & STATE_MASK);
+        }
+        cur_buf += 4;
+
+        if (likely(!((a[0] | a[1] | a[2] | a[3]) & interesting))) {
+            continue;
+        }
+
+        if (mode != NO_MATCHES) {
+            for (u32 i = 0; i < 4; i++) {
+                if (!(a[i] & STATE_ACCEPT)) {
+                    continue;
+                }
+                if (mode == STOP_AT_MATCH) {
+                    DEBUG_PRINTF("Stopping at match @ %lli\n",
+                                 (s64a)(b + i - start));
+                    *state = a[i];
+                    *scan_end = b + i;
+                    return MO_MATCHES_PENDING;
+                }
+                u64a match_offset = base_offset + (b + i - buf) + 1;
+                if (SHENG_FN(fireMatch)(sh, cb, ctxt, a[i], match_offset,
+                                        cached_accept_state, cached_accept_id,
+                                        single) == MO_HALT_MATCHING) {
+                    return MO_HALT_MATCHING;
+                }
+            }
+        }
+
+        if (can_die && (a[3] & STATE_DEAD)) {
+            DEBUG_PRINTF("Dead state reached @ %lli\n", (s64a)(b + 3 - buf));
+            *state = a[3];
+            *scan_end = end;
+            return MO_CONTINUE_MATCHING;
+        }
+
+        if (has_accel && (a[3] & STATE_ACCEL) && cur_buf > min_accel_dist) {
+            DEBUG_PRINTF("Accel state reached @ %lli\n", (s64a)(b + 3 - buf));
+            cur_buf = SHENG_FN(shengAccel)(sh, a[3], cur_buf, end,
+                                           &min_accel_dist);
+        }
+    }
+
+    /* byte-by-byte tail; not worth checking for death over at most 3 bytes */
+    while (cur_buf != end) {
+        cur_state = SHENG_FN(shengStep)(masks, cur_state, *cur_buf);
+        const u8 tmp = SHENG_FN(shengState)(cur_state);
+        DEBUG_PRINTF("s: %u\n", tmp & STATE_MASK);
+
+        if (mode != NO_MATCHES && (tmp & STATE_ACCEPT)) {
+            if (mode == STOP_AT_MATCH) {
+                DEBUG_PRINTF("Stopping at match @ %lli\n",
+                             (s64a)(cur_buf - start));
+                *state = tmp;
+                *scan_end = cur_buf;
+                return MO_MATCHES_PENDING;
+            }
+            u64a match_offset = base_offset + (cur_buf - buf) + 1;
+            if (SHENG_FN(fireMatch)(sh, cb, ctxt, tmp, match_offset,
+                                    cached_accept_state, cached_accept_id,
+                                    single) == MO_HALT_MATCHING) {
+                return MO_HALT_MATCHING;
+            }
+        }
+        cur_buf++;
+    }
+
+    *state = SHENG_FN(shengState)(cur_state);
+    *scan_end = cur_buf;
+    return MO_CONTINUE_MATCHING;
+}
+
+static really_inline
+char SHENG_FN(runShengMode)(const SHENG_T *sh, NfaCallback cb, void *ctxt,
+                            u64a offset, u8 *const cached_accept_state,
+                            ReportID *const cached_accept_id,
+                            const u8 *cur_buf, const u8 *start, const u8 *end,
+                            u8 can_die, u8 has_accel, u8 single,
+                            const enum MatchMode mode, const u8 **scanned,
+                            u8 *state) {
+    DEBUG_PRINTF("can die: %u has accel: %u single: %u\n", !!can_die,
+                 !!has_accel, !!single);
+    if (can_die) {
+        if (has_accel) {
+            return SHENG_FN(shengExec)(sh, cb, ctxt, offset,
+                                       cached_accept_state, cached_accept_id,
+                                       cur_buf, start, end, 1, 1, single, mode,
+                                       scanned, state);
+        }
+        return SHENG_FN(shengExec)(sh, cb, ctxt, offset, cached_accept_state,
+                                   cached_accept_id, cur_buf, start, end, 1, 0,
+                                   single, mode, scanned, state);
+    }
+    if (has_accel) {
+        return SHENG_FN(shengExec)(sh, cb, ctxt, offset, cached_accept_state,
+                                   cached_accept_id, cur_buf, start, end, 0, 1,
+                                   single, mode, scanned, state);
+    }
+    return SHENG_FN(shengExec)(sh, cb, ctxt, offset, cached_accept_state,
+                               cached_accept_id, cur_buf, start, end, 0, 0,
+                               single, mode, scanned, state);
+}
+
+static never_inline
+char SHENG_FN(runSheng)(const SHENG_T *sh, struct mq *q, s64a b_end,
+                        enum MatchMode mode) {
+    u8 state = *(u8 *)q->state;
+    u8 can_die = sh->flags & SHENG_FLAG_CAN_DIE;
+    u8 has_accel = sh->flags & SHENG_FLAG_HAS_ACCEL;
+    u8 single = sh->flags & SHENG_FLAG_SINGLE_REPORT;
+
+    u8 cached_accept_state = 0;
+    ReportID cached_accept_id = 0;
+
+    DEBUG_PRINTF("starting Sheng%u execution in state %u\n", SHENG_SIZE,
+                 state & STATE_MASK);
+
+    if (q->report_current) {
+        DEBUG_PRINTF("reporting current pending matches\n");
+        assert(sh);
+
+        q->report_current = 0;
+
+        int rv;
+        if (single) {
+            rv = fireSingleReport(q->cb, q->context, sh->report,
+                                  q_cur_offset(q));
+        } else {
+            rv = SHENG_FN(fireReports)(sh, q->cb, q->context, state,
+                                       q_cur_offset(q), &cached_accept_state,
+                                       &cached_accept_id, 0);
+        }
+        if (rv == MO_HALT_MATCHING) {
+            DEBUG_PRINTF("exiting in state %u\n", state & STATE_MASK);
+            return MO_DEAD;
+        }
+
+        DEBUG_PRINTF("proceeding with matching\n");
+    }
+
+    assert(q_cur_type(q) == MQE_START);
+    s64a start = q_cur_loc(q);
+
+    const u8 *cur_buf;
+    if (start < 0) {
+        DEBUG_PRINTF("negative location, scanning history\n");
+        cur_buf = q->history + q->hlength;
+    } else {
+        DEBUG_PRINTF("positive location, scanning buffer\n");
+        cur_buf = q->buffer;
+    }
+
+    /* if we our queue event is past our end */
+    if (mode != NO_MATCHES && q_cur_loc(q) > b_end) {
+        DEBUG_PRINTF("current location past buffer end\n");
+        q->items[q->cur].location = b_end;
+        return MO_ALIVE;
+    }
+
+    q->cur++;
+
+    s64a cur_start = start;
+
+    while (1) {
+        s64a end = q_cur_loc(q);
+        if (mode != NO_MATCHES) {
+            end = MIN(end, b_end);
+        }
+        assert(end <= (s64a) q->length);
+        s64a cur_end = end;
+
+        /* we may cross the border between history and current buffer */
+        if (cur_start < 0) {
+            cur_end = MIN(0, cur_end);
+        }
+
+        DEBUG_PRINTF("start: %lli end: %lli\n", start, end);
+
+        /* don't scan zero length buffer */
+        if (cur_start != cur_end) {
+            const u8 * scanned = cur_buf;
+            char rv;
+
+            /* if we're in nomatch mode or if we're scanning history buffer */
+            if (mode == NO_MATCHES ||
+                (cur_start < 0 && mode == CALLBACK_OUTPUT)) {
+                SHENG_FN(runShengMode)(sh, q->cb, q->context, q->offset,
+                                       &cached_accept_state, &cached_accept_id,
+                                       cur_buf, cur_buf + cur_start,
+                                       cur_buf + cur_end, can_die, has_accel,
+                                       single, NO_MATCHES, &scanned, &state);
+            } else if (mode == CALLBACK_OUTPUT) {
+                rv = SHENG_FN(runShengMode)(sh, q->cb, q->context, q->offset,
+                                            &cached_accept_state,
+                                            &cached_accept_id, cur_buf,
+                                            cur_buf + cur_start,
+                                            cur_buf + cur_end, can_die,
+                                            has_accel, single, CALLBACK_OUTPUT,
+                                            &scanned, &state);
+                if (rv == MO_HALT_MATCHING) {
+                    DEBUG_PRINTF("exiting in state %u\n", state & STATE_MASK);
+                    return MO_DEAD;
+                }
+            } else if (mode == STOP_AT_MATCH) {
+                rv = SHENG_FN(runShengMode)(sh, q->cb, q->context, q->offset,
+                                            &cached_accept_state,
+                                            &cached_accept_id, cur_buf,
+                                            cur_buf + cur_start,
+                                            cur_buf + cur_end, can_die,
+                                            has_accel, single, STOP_AT_MATCH,
+                                            &scanned, &state);
+                if (rv == MO_HALT_MATCHING) {
+                    DEBUG_PRINTF("exiting in state %u\n", state & STATE_MASK);
+                    return MO_DEAD;
+                } else if (rv == MO_MATCHES_PENDING) {
+                    assert(q->cur);
+                    DEBUG_PRINTF("found a match, setting q location to %zd\n",
+                                 scanned - cur_buf + 1);
+                    q->cur--;
+                    q->items[q->cur].type = MQE_START;
+                    q->items[q->cur].location =
+                            scanned - cur_buf + 1; /* due to exiting early */
+                    *(u8 *)q->state = state;
+                    DEBUG_PRINTF("exiting in state %u\n", state & STATE_MASK);
+                    return rv;
+                }
+            } else {
+                assert(!"invalid scanning mode!");
+            }
+            assert(scanned == cur_buf + cur_end);
+
+            cur_start = cur_end;
+        }
+
+        /* if we our queue event is past our end */
+        if (mode != NO_MATCHES && q_cur_loc(q) > b_end) {
+            DEBUG_PRINTF("current location past buffer end\n");
+            DEBUG_PRINTF("exiting in state %u\n", state & STATE_MASK);
+            q->cur--;
+            q->items[q->cur].type = MQE_START;
+            q->items[q->cur].location = b_end;
+            *(u8 *)q->state = state;
+            return MO_ALIVE;
+        }
+
+        /* crossing over into actual buffer */
+        if (cur_start == 0) {
+            DEBUG_PRINTF("positive location, scanning buffer\n");
+            cur_buf = q->buffer;
+        }
+
+        /* continue scanning the same buffer */
+        if (end != cur_end) {
+            continue;
+        }
+
+        switch (q_cur_type(q)) {
+        case MQE_END:
+            *(u8 *)q->state = state;
+            q->cur++;
+            DEBUG_PRINTF("exiting in state %u\n", state & STATE_MASK);
+            if (can_die) {
+                return (state & STATE_DEAD) ? MO_DEAD : MO_ALIVE;
+            }
+            return MO_ALIVE;
+        case MQE_TOP:
+            if (q->offset + cur_start == 0) {
+                DEBUG_PRINTF("Anchored start, going to state %u\n",
+                             sh->anchored);
+                state = sh->anchored;
+            } else {
+                u8 new_state = SHENG_FN(get_aux)(sh, state)->top;
+                DEBUG_PRINTF("Top event %u->%u\n", state & STATE_MASK,
+                             new_state & STATE_MASK);
+                state = new_state;
+            }
+            break;
+        default:
+            assert(!"invalid queue event");
+            break;
+        }
+        q->cur++;
+    }
+}
+
+char SHENG_API(_B)(const struct NFA *n, u64a offset, const u8 *buffer,
+                   size_t length, NfaCallback cb, void *context) {
+    DEBUG_PRINTF("smallwrite Sheng%u\n", SHENG_SIZE);
+    assert(n->type == JOIN(SHENG_NFA_, SHENG_SIZE));
+    const SHENG_T *sh = getImplNfa(n);
+    u8 state = sh->anchored;
+    u8 can_die = sh->flags & SHENG_FLAG_CAN_DIE;
+    u8 has_accel = sh->flags & SHENG_FLAG_HAS_ACCEL;
+    u8 single = sh->flags & SHENG_FLAG_SINGLE_REPORT;
+    u8 cached_accept_state = 0;
+    ReportID cached_accept_id = 0;
+
+    /* scan and report all matches */
+    s64a end = length;
+    const u8 *scanned;
+
+    char rv = SHENG_FN(runShengMode)(sh, cb, context, offset,
+                                     &cached_accept_state, &cached_accept_id,
+                                     buffer, buffer, buffer + end, can_die,
+                                     has_accel, single, CALLBACK_OUTPUT,
+                                     &scanned, &state);
+    if (rv == MO_HALT_MATCHING) {
+        DEBUG_PRINTF("exiting in state %u\n", state & STATE_MASK);
+        return MO_DEAD;
+    }
+
+    DEBUG_PRINTF("%u\n", state & STATE_MASK);
+
+    const struct sstate_aux *aux = SHENG_FN(get_aux)(sh, state);
+
+    if (aux->accept_eod) {
+        DEBUG_PRINTF("Reporting EOD matches\n");
+        SHENG_FN(fireReports)(sh, cb, context, state, end + offset,
+                              &cached_accept_state, &cached_accept_id, 1);
+    }
+
+    return state & STATE_DEAD ? MO_DEAD : MO_ALIVE;
+}
+
+char SHENG_API(_Q)(const struct NFA *n, struct mq *q, s64a end) {
+    const SHENG_T *sh = SHENG_FN(get_sheng)(n);
+    char rv = SHENG_FN(runSheng)(sh, q, end, CALLBACK_OUTPUT);
+    return rv;
+}
+
+char SHENG_API(_Q2)(const struct NFA *n, struct mq *q, s64a end) {
+    const SHENG_T *sh = SHENG_FN(get_sheng)(n);
+    char rv = SHENG_FN(runSheng)(sh, q, end, STOP_AT_MATCH);
+    return rv;
+}
+
+char SHENG_API(_QR)(const struct NFA *n, struct mq *q, ReportID report) {
+    assert(q_cur_type(q) == MQE_START);
+
+    const SHENG_T *sh = SHENG_FN(get_sheng)(n);
+    char rv = SHENG_FN(runSheng)(sh, q, 0 /* end */, NO_MATCHES);
+
+    if (rv && SHENG_API(_inAccept)(n, report, q)) {
+        return MO_MATCHES_PENDING;
+    }
+    return rv;
+}
+
+char SHENG_API(_inAccept)(const struct NFA *n, ReportID report, struct mq *q) {
+    assert(n && q);
+
+    const SHENG_T *sh = SHENG_FN(get_sheng)(n);
+    u8 s = *(const u8 *)q->state;
+    DEBUG_PRINTF("checking accepts for %u\n", (u8)(s & STATE_MASK));
+
+    const struct sstate_aux *aux = SHENG_FN(get_aux)(sh, s);
+
+    if (!aux->accept) {
+        return 0;
+    }
+
+    return SHENG_FN(shengHasAccept)(sh, aux, report);
+}
+
+char SHENG_API(_inAnyAccept)(const struct NFA *n, struct mq *q) {
+    assert(n && q);
+
+    const SHENG_T *sh = SHENG_FN(get_sheng)(n);
+    u8 s = *(const u8 *)q->state;
+    DEBUG_PRINTF("checking accepts for %u\n", (u8)(s & STATE_MASK));
+
+    const struct sstate_aux *aux = SHENG_FN(get_aux)(sh, s);
+    return !!aux->accept;
+}
+
+char SHENG_API(_testEOD)(const struct NFA *nfa, const char *state,
+                         UNUSED const char *streamState, u64a offset,
+                         NfaCallback cb, void *ctxt) {
+    assert(nfa);
+
+    const SHENG_T *sh = SHENG_FN(get_sheng)(nfa);
+    u8 s = *(const u8 *)state;
+    DEBUG_PRINTF("checking EOD accepts for %u\n", (u8)(s & STATE_MASK));
+
+    const struct sstate_aux *aux = SHENG_FN(get_aux)(sh, s);
+
+    if (!aux->accept_eod) {
+        return MO_CONTINUE_MATCHING;
+    }
+
+    return SHENG_FN(fireReports)(sh, cb, ctxt, s, offset, NULL, NULL, 1);
+}
+
+char SHENG_API(_reportCurrent)(const struct NFA *n, struct mq *q) {
+    const SHENG_T *sh = SHENG_FN(get_sheng)(n);
+    NfaCallback cb = q->cb;
+    void *ctxt = q->context;
+    u8 s = *(u8 *)q->state;
+    const struct sstate_aux *aux = SHENG_FN(get_aux)(sh, s);
+    u64a offset = q_cur_offset(q);
+    u8 cached_state_id = 0;
+    ReportID cached_report_id = 0;
+    assert(q_cur_type(q) == MQE_START);
+
+    if (aux->accept) {
+        if (sh->flags & SHENG_FLAG_SINGLE_REPORT) {
+            fireSingleReport(cb, ctxt, sh->report, offset);
+        } else {
+            SHENG_FN(fireReports)(sh, cb, ctxt, s, offset, &cached_state_id,
+                                  &cached_report_id, 1);
+        }
+    }
+
+    return 0;
+}
+
+char SHENG_API(_initCompressedState)(const struct NFA *nfa, u64a offset,
+                                     void *state, UNUSED u8 key) {
+    const SHENG_T *sh = SHENG_FN(get_sheng)(nfa);
+    u8 *s = (u8 *)state;
+    *s = offset ? sh->floating: sh->anchored;
+    return !(*s & STATE_DEAD);
+}
+
+char SHENG_API(_queueInitState)(const struct NFA *nfa, struct mq *q) {
+    assert(nfa->scratchStateSize == 1);
+
+    /* starting in floating state */
+    const SHENG_T *sh = SHENG_FN(get_sheng)(nfa);
+    *(u8 *)q->state = sh->floating;
+    DEBUG_PRINTF("starting in floating state\n");
+    return 0;
+}
+
+char SHENG_API(_queueCompressState)(UNUSED const struct NFA *nfa,
+                                    const struct mq *q, UNUSED s64a loc) {
+    void *dest = q->streamState;
+    const void *src = q->state;
+    assert(nfa->scratchStateSize == 1);
+    assert(nfa->streamStateSize == 1);
+    *(u8 *)dest = *(const u8 *)src;
+    return 0;
+}
+
+char SHENG_API(_expandState)(UNUSED const struct NFA *nfa, void *dest,
+                             const void *src, UNUSED u64a offset,
+                             UNUSED u8 key) {
+    assert(nfa->scratchStateSize == 1);
+    assert(nfa->streamStateSize == 1);
+    *(u8 *)dest = *(const u8 *)src;
+    return 0;
+}
+
+#undef SHENG_T
+#undef SHENG_FN
+#undef SHENG_API
+#undef STATE_MASK
+#undef STATE_ACCEPT
+#undef STATE_DEAD
+#undef STATE_ACCEL
@@ -50,6 +50,7 @@
 #include "util/verify_types.h"
 #include "util/simd_utils.h"
 
+#include <cstring>
 #include <map>
 #include <vector>
 #include <sstream>
@@ -290,14 +291,48 @@ size_t sheng_build_strat::accelSize() const {
     return sizeof(AccelAux);
 }
 
+namespace {
+
+/** \brief Parameters of each of the Sheng engine variants. */
+template<typename T> struct ShengTraits;
+
+template<> struct ShengTraits<sheng> {
+    static constexpr NFAEngineType type = SHENG_NFA_0;
+    static constexpr u32 max_states = 16;
+    static constexpr u8 accept = SHENG_STATE_ACCEPT;
+    static constexpr u8 dead = SHENG_STATE_DEAD;
+    static constexpr u8 accel = SHENG_STATE_ACCEL;
+    static constexpr u8 state_mask = SHENG_STATE_MASK;
+};
+
+template<> struct ShengTraits<sheng32> {
+    static constexpr NFAEngineType type = SHENG_NFA_32;
+    static constexpr u32 max_states = 32;
+    static constexpr u8 accept = SHENG32_STATE_ACCEPT;
+    static constexpr u8 dead = SHENG32_STATE_DEAD;
+    static constexpr u8 accel = SHENG32_STATE_ACCEL;
+    static constexpr u8 state_mask = SHENG32_STATE_MASK;
+};
+
+template<> struct ShengTraits<sheng64> {
+    static constexpr NFAEngineType type = SHENG_NFA_64;
+    static constexpr u32 max_states = 64;
+    static constexpr u8 accept = SHENG64_STATE_ACCEPT;
+    static constexpr u8 dead = SHENG64_STATE_DEAD;
+    static constexpr u8 accel = SHENG64_STATE_ACCEL; /* none */
+    static constexpr u8 state_mask = SHENG64_STATE_MASK;
+};
+
+} // namespace
+
 #ifdef DEBUG
 static really_inline
-void dumpShuffleMask(const u8 chr, const u8 *buf, unsigned sz) {
+void dumpShuffleMask(const u8 chr, const u8 *buf, unsigned sz, u8 state_mask) {
     stringstream o;
 
     for (unsigned i = 0; i < sz; i++) {
         o.width(2);
-        o << (buf[i] & SHENG_STATE_MASK) << " ";
+        o << (buf[i] & state_mask) << " ";
     }
     DEBUG_PRINTF("chr %3u: %s\n", chr, o.str().c_str());
 }
@@ -311,27 +346,29 @@ void fillAccelOut(const map<dstate_id_t, AccelScheme> &accel_escape_info,
     }
 }
 
+template<typename T>
 static
 u8 getShengState(dstate &state, dfa_info &info,
                  map<dstate_id_t, AccelScheme> &accelInfo) {
     u8 s = state.impl_id;
     if (!state.reports.empty()) {
-        s |= SHENG_STATE_ACCEPT;
+        s |= ShengTraits<T>::accept;
     }
     if (info.isDead(state)) {
-        s |= SHENG_STATE_DEAD;
+        s |= ShengTraits<T>::dead;
     }
     if (accelInfo.find(info.raw_id(state.impl_id)) != accelInfo.end()) {
-        s |= SHENG_STATE_ACCEL;
+        s |= ShengTraits<T>::accel;
     }
     return s;
 }
 
+template<typename T>
 static
 void fillAccelAux(struct NFA *n, dfa_info &info,
                   map<dstate_id_t, AccelScheme> &accelInfo) {
     DEBUG_PRINTF("Filling accel aux structures\n");
-    sheng *s = (sheng *)getMutableImplNfa(n);
+    T *s = (T *)getMutableImplNfa(n);
     u32 offset = s->accel_offset;
 
     for (dstate_id_t i = 0; i < info.size(); i++) {
@@ -349,6 +386,7 @@ void fillAccelAux(struct NFA *n, dfa_info &info,
     }
 }
 
+template<typename T>
 static
 void populateBasicInfo(struct NFA *n, dfa_info &info,
                        map<dstate_id_t, AccelScheme> &accelInfo, u32 aux_offset,
@@ -358,10 +396,10 @@ void populateBasicInfo(struct NFA *n, dfa_info &info,
     n->scratchStateSize = 1;
     n->streamStateSize = 1;
     n->nPositions = info.size();
-    n->type = SHENG_NFA_0;
+    n->type = ShengTraits<T>::type;
     n->flags |= info.raw.hasEodReports() ? NFA_ACCEPTS_EOD : 0;
 
-    sheng *s = (sheng *)getMutableImplNfa(n);
+    T *s = (T *)getMutableImplNfa(n);
     s->aux_offset = aux_offset;
     s->report_offset = report_offset;
     s->accel_offset = accel_offset;
@@ -369,14 +407,15 @@ void populateBasicInfo(struct NFA *n, dfa_info &info,
     s->length = dfa_size;
     s->flags |= info.can_die ? SHENG_FLAG_CAN_DIE : 0;
 
-    s->anchored = getShengState(info.anchored, info, accelInfo);
-    s->floating = getShengState(info.floating, info, accelInfo);
+    s->anchored = getShengState<T>(info.anchored, info, accelInfo);
+    s->floating = getShengState<T>(info.floating, info, accelInfo);
 }
 
+template<typename T>
 static
 void fillTops(NFA *n, dfa_info &info, dstate_id_t id,
               map<dstate_id_t, AccelScheme> &accelInfo) {
-    sheng *s = (sheng *)getMutableImplNfa(n);
+    T *s = (T *)getMutableImplNfa(n);
     u32 aux_base = s->aux_offset;
 
     DEBUG_PRINTF("Filling tops for state %u\n", id);
@@ -393,13 +432,14 @@ void fillTops(NFA *n, dfa_info &info, dstate_id_t id,
 
     DEBUG_PRINTF("Top transition for state %u: %u\n", id, top_state.impl_id);
 
-    aux->top = getShengState(top_state, info, accelInfo);
+    aux->top = getShengState<T>(top_state, info, accelInfo);
 }
 
+template<typename T>
 static
 void fillAux(NFA *n, dfa_info &info, dstate_id_t id, vector<u32> &reports,
                  vector<u32> &reports_eod, vector<u32> &report_offsets) {
-    sheng *s = (sheng *)getMutableImplNfa(n);
+    T *s = (T *)getMutableImplNfa(n);
     u32 aux_base = s->aux_offset;
     auto raw_id = info.raw_id(id);
 
@@ -419,9 +459,10 @@ void fillAux(NFA *n, dfa_info &info, dstate_id_t id, vector<u32> &reports,
     DEBUG_PRINTF("EOD report list offset: %u\n", aux->accept_eod);
 }
 
+template<typename T>
 static
 void fillSingleReport(NFA *n, ReportID r_id) {
-    sheng *s = (sheng *)getMutableImplNfa(n);
+    T *s = (T *)getMutableImplNfa(n);
 
     DEBUG_PRINTF("Single report ID: %u\n", r_id);
     s->report = r_id;
@@ -429,21 +470,43 @@ void fillSingleReport(NFA *n, ReportID r_id) {
 }
 
 static
-void createShuffleMasks(sheng *s, dfa_info &info,
+m128 *getShuffleMask(sheng *s, u16 chr) {
+    return &s->shuffle_masks[chr];
+}
+
+static
+m512 *getShuffleMask(sheng32 *s, u16 chr) {
+    return &s->succ_masks[chr];
+}
+
+static
+m512 *getShuffleMask(sheng64 *s, u16 chr) {
+    return &s->succ_masks[chr];
+}
+
+template<typename T>
+static
+void createShuffleMasks(T *s, dfa_info &info,
                         map<dstate_id_t, AccelScheme> &accelInfo) {
     for (u16 chr = 0; chr < 256; chr++) {
-        u8 buf[16] = {0};
+        auto *mask = getShuffleMask(s, chr);
+        u8 buf[sizeof(*mask)] = {0};
 
         for (dstate_id_t idx = 0; idx < info.size(); idx++) {
             auto &succ_state = info.next(idx, chr);
 
-            buf[idx] = getShengState(succ_state, info, accelInfo);
+            buf[idx] = getShengState<T>(succ_state, info, accelInfo);
+        }
+
+        /* masks wider than the state index (Sheng-32) are looked up with
+         * the flag bits set too, so repeat the successors across them */
+        for (u32 i = ShengTraits<T>::max_states; i < sizeof(buf); i++) {
+            buf[i] = buf[i % ShengTraits<T>::max_states];
         }
 #ifdef DEBUG
-        dumpShuffleMask(chr, buf, sizeof(buf));
+        dumpShuffleMask(chr, buf, sizeof(buf), ShengTraits<T>::state_mask);
 #endif
-        m128 mask = loadu128(buf);
-        s->shuffle_masks[chr] = mask;
+        memcpy(mask, buf, sizeof(buf));
     }
 }
 
@@ -452,10 +515,17 @@ bool has_accel_sheng(const NFA *nfa) {
     return s->flags & SHENG_FLAG_HAS_ACCEL;
 }
 
-aligned_unique_ptr<NFA> shengCompile(raw_dfa &raw,
-                                     const CompileContext &cc,
-                                     const ReportManager &rm,
-                                     set<dstate_id_t> *accel_states) {
+bool has_accel_sheng32(const NFA *nfa) {
+    const sheng32 *s = (const sheng32 *)getImplNfa(nfa);
+    return s->flags & SHENG_FLAG_HAS_ACCEL;
+}
+
+template<typename T>
+static
+aligned_unique_ptr<NFA> shengCompile_int(raw_dfa &raw,
+                                         const CompileContext &cc,
+                                         const ReportManager &rm,
+                                         set<dstate_id_t> *accel_states) {
     if (!cc.grey.allowSheng) {
         DEBUG_PRINTF("Sheng is not allowed!\n");
         return nullptr;
@@ -471,7 +541,7 @@ aligned_unique_ptr<NFA> shengCompile(raw_dfa &raw,
 
     DEBUG_PRINTF("This DFA %s die so effective number of states is %zu\n",
                  info.can_die ? "can" : "cannot", info.size());
-    if (info.size() > 16) {
+    if (info.size() > ShengTraits<T>::max_states) {
         DEBUG_PRINTF("Too many states\n");
         return nullptr;
     }
@@ -480,7 +550,11 @@ aligned_unique_ptr<NFA> shengCompile(raw_dfa &raw,
                           * mode with our semantics */
         raw.stripExtraEodReports();
     }
-    auto accelInfo = strat.getAccelInfo(cc.grey);
+
+    map<dstate_id_t, AccelScheme> accelInfo;
+    if (ShengTraits<T>::accel) {
+        accelInfo = strat.getAccelInfo(cc.grey);
+    }
 
     // set impl_id of each dfa state
     for (dstate_id_t i = 0; i < info.size(); i++) {
@@ -490,7 +564,7 @@ aligned_unique_ptr<NFA> shengCompile(raw_dfa &raw,
     DEBUG_PRINTF("Anchored start state: %u, floating start state: %u\n",
                  info.anchored.impl_id, info.floating.impl_id);
 
-    u32 nfa_size = ROUNDUP_16(sizeof(NFA) + sizeof(sheng));
+    u32 nfa_size = ROUNDUP_16(sizeof(NFA) + sizeof(T));
     vector<u32> reports, eod_reports, report_offsets;
     u8 isSingle = 0;
     ReportID single_report = 0;
@@ -512,30 +586,56 @@ aligned_unique_ptr<NFA> shengCompile(raw_dfa &raw,
 
     aligned_unique_ptr<NFA> nfa = aligned_zmalloc_unique<NFA>(total_size);
 
-    populateBasicInfo(nfa.get(), info, accelInfo, nfa_size, reports_offset,
-                      accel_offset, total_size, total_size - sizeof(NFA));
+    populateBasicInfo<T>(nfa.get(), info, accelInfo, nfa_size, reports_offset,
+                         accel_offset, total_size, total_size - sizeof(NFA));
 
     DEBUG_PRINTF("Setting up aux and report structures\n");
 
     ri->fillReportLists(nfa.get(), reports_offset, report_offsets);
 
     for (dstate_id_t idx = 0; idx < info.size(); idx++) {
-        fillTops(nfa.get(), info, idx, accelInfo);
-        fillAux(nfa.get(), info, idx, reports, eod_reports, report_offsets);
+        fillTops<T>(nfa.get(), info, idx, accelInfo);
+        fillAux<T>(nfa.get(), info, idx, reports, eod_reports, report_offsets);
     }
     if (isSingle) {
-        fillSingleReport(nfa.get(), single_report);
+        fillSingleReport<T>(nfa.get(), single_report);
     }
 
-    fillAccelAux(nfa.get(), info, accelInfo);
+    fillAccelAux<T>(nfa.get(), info, accelInfo);
 
     if (accel_states) {
         fillAccelOut(accelInfo, accel_states);
     }
 
-    createShuffleMasks((sheng *)getMutableImplNfa(nfa.get()), info, accelInfo);
+    createShuffleMasks<T>((T *)getMutableImplNfa(nfa.get()), info, accelInfo);
 
     return nfa;
 }
 
+aligned_unique_ptr<NFA> shengCompile(raw_dfa &raw, const CompileContext &cc,
+                                     const ReportManager &rm,
+                                     set<dstate_id_t> *accel_states) {
+    return shengCompile_int<sheng>(raw, cc, rm, accel_states);
+}
+
+aligned_unique_ptr<NFA> sheng32Compile(raw_dfa &raw, const CompileContext &cc,
+                                       const ReportManager &rm,
+                                       set<dstate_id_t> *accel_states) {
+    if (!cc.target_info.has_avx512vbmi()) {
+        DEBUG_PRINTF("Sheng-32 requires AVX512VBMI\n");
+        return nullptr;
+    }
+    return shengCompile_int<sheng32>(raw, cc, rm, accel_states);
+}
+
+aligned_unique_ptr<NFA> sheng64Compile(raw_dfa &raw, const CompileContext &cc,
+                                       const ReportManager &rm,
+                                       set<dstate_id_t> *accel_states) {
+    if (!cc.target_info.has_avx512vbmi()) {
+        DEBUG_PRINTF("Sheng-64 requires AVX512VBMI\n");
+        return nullptr;
+    }
+    return shengCompile_int<sheng64>(raw, cc, rm, accel_states);
+}
+
 } // namespace ue2
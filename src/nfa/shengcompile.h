@@ -66,6 +66,22 @@ aligned_unique_ptr<NFA>
 shengCompile(raw_dfa &raw, const CompileContext &cc, const ReportManager &rm,
              std::set<dstate_id_t> *accel_states = nullptr);
 
+/**
+ * \brief Builds a Sheng-32 (up to 32 states) engine. Requires a target with
+ * AVX512VBMI; returns nullptr if the DFA cannot be built as a Sheng-32.
+ */
+aligned_unique_ptr<NFA>
+sheng32Compile(raw_dfa &raw, const CompileContext &cc, const ReportManager &rm,
+               std::set<dstate_id_t> *accel_states = nullptr);
+
+/**
+ * \brief Builds a Sheng-64 (up to 64 states) engine. Requires a target with
+ * AVX512VBMI; returns nullptr if the DFA cannot be built as a Sheng-64.
+ */
+aligned_unique_ptr<NFA>
+sheng64Compile(raw_dfa &raw, const CompileContext &cc, const ReportManager &rm,
+               std::set<dstate_id_t> *accel_states = nullptr);
+
 struct sheng_escape_info {
     CharReach outs;
     CharReach outs2_single;
@@ -75,6 +91,8 @@ struct sheng_escape_info {
 
 bool has_accel_sheng(const NFA *nfa);
 
+bool has_accel_sheng32(const NFA *nfa);
+
 } // namespace ue2
 
 #endif /* SHENGCOMPILE_H_ */
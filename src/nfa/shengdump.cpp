@@ -40,6 +40,7 @@
 #include "util/dump_charclass.h"
 #include "util/simd_utils.h"
 
+#include <cstring>
 
 #ifndef DUMP_SUPPORT
 #error No dump support!
@@ -49,11 +50,51 @@ using namespace std;
 
 namespace ue2 {
 
+namespace {
+
+template<typename T> struct ShengDumpTraits;
+
+template<> struct ShengDumpTraits<sheng> {
+    static constexpr u32 max_states = 16;
+    static constexpr u8 state_mask = SHENG_STATE_MASK;
+    static constexpr u8 flag_mask = SHENG_STATE_FLAG_MASK;
+};
+
+template<> struct ShengDumpTraits<sheng32> {
+    static constexpr u32 max_states = 32;
+    static constexpr u8 state_mask = SHENG32_STATE_MASK;
+    static constexpr u8 flag_mask = SHENG32_STATE_FLAG_MASK;
+};
+
+template<> struct ShengDumpTraits<sheng64> {
+    static constexpr u32 max_states = 64;
+    static constexpr u8 state_mask = SHENG64_STATE_MASK;
+    static constexpr u8 flag_mask = SHENG64_STATE_FLAG_MASK;
+};
+
+} // namespace
+
+static
+void getShuffleMask(const sheng *s, u32 chr, u8 *buf) {
+    store128(buf, s->shuffle_masks[chr]);
+}
+
+static
+void getShuffleMask(const sheng32 *s, u32 chr, u8 *buf) {
+    memcpy(buf, &s->succ_masks[chr], sizeof(m512));
+}
+
+static
+void getShuffleMask(const sheng64 *s, u32 chr, u8 *buf) {
+    memcpy(buf, &s->succ_masks[chr], sizeof(m512));
+}
+
+template<typename T>
 static
 const sstate_aux *get_aux(const NFA *n, dstate_id_t i) {
     assert(n && isShengType(n->type));
 
-    const sheng *s = (const sheng *)getImplNfa(n);
+    const T *s = (const T *)getImplNfa(n);
     const sstate_aux *aux_base =
         (const sstate_aux *)((const char *)n + s->aux_offset);
 
@@ -64,15 +105,17 @@ const sstate_aux *get_aux(const NFA *n, dstate_id_t i) {
     return aux;
 }
 
+template<typename T>
 static
-void dumpHeader(FILE *f, const sheng *s) {
+void dumpHeader(FILE *f, const T *s) {
+    const u8 state_mask = ShengDumpTraits<T>::state_mask;
     fprintf(f, "number of states: %u, DFA engine size: %u\n", s->n_states,
             s->length);
     fprintf(f, "aux base offset: %u, reports base offset: %u, "
                "accel offset: %u\n",
             s->aux_offset, s->report_offset, s->accel_offset);
     fprintf(f, "anchored start state: %u, floating start state: %u\n",
-            s->anchored & SHENG_STATE_MASK, s->floating & SHENG_STATE_MASK);
+            s->anchored & state_mask, s->floating & state_mask);
     fprintf(f, "has accel: %u can die: %u single report: %u\n",
             !!(s->flags & SHENG_FLAG_HAS_ACCEL),
             !!(s->flags & SHENG_FLAG_CAN_DIE),
@@ -80,11 +123,11 @@ void dumpHeader(FILE *f, const sheng *s) {
 }
 
 static
-void dumpAux(FILE *f, u32 state, const sstate_aux *aux) {
+void dumpAux(FILE *f, u32 state, const sstate_aux *aux, u8 state_mask) {
     fprintf(f, "state id: %u, reports offset: %u, EOD reports offset: %u, "
                "accel offset: %u, top: %u\n",
             state, aux->accept, aux->accept_eod, aux->accel,
-            aux->top & SHENG_STATE_MASK);
+            aux->top & state_mask);
 }
 
 static
@@ -95,36 +138,38 @@ void dumpReports(FILE *f, const report_list *rl) {
     }
 }
 
+template<typename T>
 static
-void dumpMasks(FILE *f, const sheng *s) {
+void dumpMasks(FILE *f, const T *s) {
+    const u8 state_mask = ShengDumpTraits<T>::state_mask;
     for (u32 chr = 0; chr < 256; chr++) {
-        u8 buf[16];
-        m128 shuffle_mask = s->shuffle_masks[chr];
-        store128(buf, shuffle_mask);
+        u8 buf[64];
+        getShuffleMask(s, chr, buf);
 
         fprintf(f, "%3u: ", chr);
-        for (u32 pos = 0; pos < 16; pos++) {
+        for (u32 pos = 0; pos < ShengDumpTraits<T>::max_states; pos++) {
             u8 c = buf[pos];
-            if (c & SHENG_STATE_FLAG_MASK) {
-                fprintf(f, "%2u* ", c & SHENG_STATE_MASK);
+            if (c & ShengDumpTraits<T>::flag_mask) {
+                fprintf(f, "%2u* ", c & state_mask);
             } else {
-                fprintf(f, "%2u  ", c & SHENG_STATE_MASK);
+                fprintf(f, "%2u  ", c & state_mask);
             }
         }
         fprintf(f, "\n");
     }
 }
 
-void nfaExecSheng0_dumpText(const NFA *nfa, FILE *f) {
-    assert(nfa->type == SHENG_NFA_0);
-    const sheng *s = (const sheng *)getImplNfa(nfa);
+template<typename T>
+static
+void dumpText_int(const NFA *nfa, FILE *f, const char *title) {
+    const T *s = (const T *)getImplNfa(nfa);
 
-    fprintf(f, "sheng DFA\n");
+    fprintf(f, "%s\n", title);
     dumpHeader(f, s);
 
     for (u32 state = 0; state < s->n_states; state++) {
-        const sstate_aux *aux = get_aux(nfa, state);
-        dumpAux(f, state, aux);
+        const sstate_aux *aux = get_aux<T>(nfa, state);
+        dumpAux(f, state, aux, ShengDumpTraits<T>::state_mask);
         if (aux->accept) {
             fprintf(f, "report list:\n");
             const report_list *rl =
@@ -152,6 +197,21 @@ void nfaExecSheng0_dumpText(const NFA *nfa, FILE *f) {
     fprintf(f, "\n");
 }
 
+void nfaExecSheng0_dumpText(const NFA *nfa, FILE *f) {
+    assert(nfa->type == SHENG_NFA_0);
+    dumpText_int<sheng>(nfa, f, "sheng DFA");
+}
+
+void nfaExecSheng32_dumpText(const NFA *nfa, FILE *f) {
+    assert(nfa->type == SHENG_NFA_32);
+    dumpText_int<sheng32>(nfa, f, "sheng32 DFA");
+}
+
+void nfaExecSheng64_dumpText(const NFA *nfa, FILE *f) {
+    assert(nfa->type == SHENG_NFA_64);
+    dumpText_int<sheng64>(nfa, f, "sheng64 DFA");
+}
+
 static
 void dumpDotPreambleDfa(FILE *f) {
     dumpDotPreamble(f);
@@ -162,9 +222,11 @@ void dumpDotPreambleDfa(FILE *f) {
     fprintf(f, "0 [style=invis];\n");
 }
 
+template<typename T>
 static
-void describeNode(const NFA *n, const sheng *s, u16 i, FILE *f) {
-    const sstate_aux *aux = get_aux(n, i);
+void describeNode(const NFA *n, const T *s, u16 i, FILE *f) {
+    const u8 state_mask = ShengDumpTraits<T>::state_mask;
+    const sstate_aux *aux = get_aux<T>(n, i);
 
     fprintf(f, "%u [ width = 1, fixedsize = true, fontsize = 12, "
                "label = \"%u\" ]; \n",
@@ -178,16 +240,16 @@ void describeNode(const NFA *n, const sheng *s, u16 i, FILE *f) {
         fprintf(f, "%u [ shape = doublecircle ];\n", i);
     }
 
-    if (aux->top && (aux->top & SHENG_STATE_MASK) != i) {
+    if (aux->top && (aux->top & state_mask) != i) {
         fprintf(f, "%u -> %u [color = darkgoldenrod weight=0.1 ]\n", i,
-                aux->top & SHENG_STATE_MASK);
+                aux->top & state_mask);
     }
 
-    if (i == (s->anchored & SHENG_STATE_MASK)) {
+    if (i == (s->anchored & state_mask)) {
         fprintf(f, "STARTA -> %u [color = blue ]\n", i);
     }
 
-    if (i == (s->floating & SHENG_STATE_MASK)) {
+    if (i == (s->floating & state_mask)) {
         fprintf(f, "STARTF -> %u [color = red ]\n", i);
     }
 }
@@ -225,27 +287,27 @@ void describeEdge(FILE *f, const u16 *t, u16 i) {
     }
 }
 
+template<typename T>
 static
 void shengGetTransitions(const NFA *n, u16 state, u16 *t) {
     assert(isShengType(n->type));
-    const sheng *s = (const sheng *)getImplNfa(n);
-    const sstate_aux *aux = get_aux(n, state);
+    const T *s = (const T *)getImplNfa(n);
+    const sstate_aux *aux = get_aux<T>(n, state);
 
     for (unsigned i = 0; i < N_CHARS; i++) {
-        u8 buf[16];
-        m128 shuffle_mask = s->shuffle_masks[i];
-
-        store128(buf, shuffle_mask);
+        u8 buf[64];
+        getShuffleMask(s, i, buf);
 
-        t[i] = buf[state] & SHENG_STATE_MASK;
+        t[i] = buf[state] & ShengDumpTraits<T>::state_mask;
     }
 
-    t[TOP] = aux->top & SHENG_STATE_MASK;
+    t[TOP] = aux->top & ShengDumpTraits<T>::state_mask;
 }
 
-void nfaExecSheng0_dumpDot(const NFA *nfa, FILE *f, const string &) {
-    assert(nfa->type == SHENG_NFA_0);
-    const sheng *s = (const sheng *)getImplNfa(nfa);
+template<typename T>
+static
+void dumpDot_int(const NFA *nfa, FILE *f) {
+    const T *s = (const T *)getImplNfa(nfa);
 
     dumpDotPreambleDfa(f);
 
@@ -254,7 +316,7 @@ void nfaExecSheng0_dumpDot(const NFA *nfa, FILE *f, const string &) {
 
         u16 t[ALPHABET_SIZE];
 
-        shengGetTransitions(nfa, i, t);
+        shengGetTransitions<T>(nfa, i, t);
 
         describeEdge(f, t, i);
     }
@@ -262,4 +324,19 @@ void nfaExecSheng0_dumpDot(const NFA *nfa, FILE *f, const string &) {
     fprintf(f, "}\n");
 }
 
+void nfaExecSheng0_dumpDot(const NFA *nfa, FILE *f, const string &) {
+    assert(nfa->type == SHENG_NFA_0);
+    dumpDot_int<sheng>(nfa, f);
+}
+
+void nfaExecSheng32_dumpDot(const NFA *nfa, FILE *f, const string &) {
+    assert(nfa->type == SHENG_NFA_32);
+    dumpDot_int<sheng32>(nfa, f);
+}
+
+void nfaExecSheng64_dumpDot(const NFA *nfa, FILE *f, const string &) {
+    assert(nfa->type == SHENG_NFA_64);
+    dumpDot_int<sheng64>(nfa, f);
+}
+
 } // namespace ue2
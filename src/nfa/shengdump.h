@@ -41,6 +41,12 @@ namespace ue2 {
 void nfaExecSheng0_dumpDot(const struct NFA *nfa, FILE *file,
                            const std::string &base);
 void nfaExecSheng0_dumpText(const struct NFA *nfa, FILE *file);
+void nfaExecSheng32_dumpDot(const struct NFA *nfa, FILE *file,
+                            const std::string &base);
+void nfaExecSheng32_dumpText(const struct NFA *nfa, FILE *file);
+void nfaExecSheng64_dumpDot(const struct NFA *nfa, FILE *file,
+                            const std::string &base);
+void nfaExecSheng64_dumpText(const struct NFA *nfa, FILE *file);
 
 } // namespace ue2
 
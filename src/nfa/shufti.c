@@ -89,7 +89,7 @@ const u8 *shuftiExec(m128 mask_lo, m128 mask_hi, const u8 *buf,
     }
 
     const m128 zeroes = zeroes128();
-    const m128 low4bits = _mm_set1_epi8(0xf);
+    const m128 low4bits = set16x8(0xf);
     const u8 *rv;
 
     size_t min = (size_t)buf % 16;
@@ -176,7 +176,7 @@ const u8 *rshuftiExec(m128 mask_lo, m128 mask_hi, const u8 *buf,
     }
 
     const m128 zeroes = zeroes128();
-    const m128 low4bits = _mm_set1_epi8(0xf);
+    const m128 low4bits = set16x8(0xf);
     const u8 *rv;
 
     assert(buf_end - buf >= 16);
@@ -249,7 +249,7 @@ const u8 *shuftiDoubleExec(m128 mask1_lo, m128 mask1_hi,
                            m128 mask2_lo, m128 mask2_hi,
                            const u8 *buf, const u8 *buf_end) {
     const m128 ones = ones128();
-    const m128 low4bits = _mm_set1_epi8(0xf);
+    const m128 low4bits = set16x8(0xf);
     const u8 *rv;
 
     size_t min = (size_t)buf % 16;
@@ -289,6 +289,100 @@ const u8 *shuftiDoubleExec(m128 mask1_lo, m128 mask1_hi,
     return buf_end;
 }
 
+/* returns a bit set for every byte of the block that starts a pair */
+static really_inline
+u32 distBlock(m128 mask1_lo, m128 mask1_hi, m128 mask2_lo, m128 mask2_hi,
+              u8 dist, const u8 *buf, const m128 low4bits,
+              const m128 zeroes) {
+    u32 z1 = block(mask1_lo, mask1_hi, loadu128(buf), low4bits, zeroes);
+    u32 z2 = block(mask2_lo, mask2_hi, loadu128(buf + dist), low4bits,
+                   zeroes);
+    return ~(z1 | z2) & 0xffff;
+}
+
+const u8 *shuftiDistExec(m128 mask1_lo, m128 mask1_hi,
+                         m128 mask2_lo, m128 mask2_hi, u8 dist,
+                         const u8 *buf, const u8 *buf_end) {
+    assert(buf && buf_end);
+    assert(buf < buf_end);
+    assert(dist);
+
+    if (buf_end - buf < 16) {
+        return shuftiDistSlow((const u8 *)&mask1_lo, (const u8 *)&mask1_hi,
+                              (const u8 *)&mask2_lo, (const u8 *)&mask2_hi,
+                              dist, buf, buf_end);
+    }
+
+    const m128 zeroes = zeroes128();
+    const m128 low4bits = set16x8(0xf);
+
+    /* the second load of each pair is unaligned whatever we do, so don't
+     * bother aligning the first */
+    const u8 *last_block = buf_end - 16;
+    for (; buf < last_block; buf += 16) {
+        u32 z = distBlock(mask1_lo, mask1_hi, mask2_lo, mask2_hi, dist, buf,
+                          low4bits, zeroes);
+        if (z) {
+            return buf + ctz32(z);
+        }
+    }
+
+    u32 z = distBlock(mask1_lo, mask1_hi, mask2_lo, mask2_hi, dist,
+                      last_block, low4bits, zeroes);
+    if (z) {
+        return last_block + ctz32(z);
+    }
+
+    return buf_end;
+}
+
+/* returns a bit set for every byte of the block that is in the class or
+ * starts the pair */
+static really_inline
+u32 vermDoubleBlock(m128 mask_lo, m128 mask_hi, m128 chars1, m128 chars2,
+                    const u8 *buf, const m128 low4bits, const m128 zeroes) {
+    m128 data = loadu128(buf);
+    u32 z = block(mask_lo, mask_hi, data, low4bits, zeroes);
+    u32 pairs = movemask128(and128(eq128(data, chars1),
+                                   eq128(loadu128(buf + 1), chars2)));
+    return (~z & 0xffff) | pairs;
+}
+
+const u8 *shuftiVermDoubleExec(m128 mask_lo, m128 mask_hi, u8 c1, u8 c2,
+                               const u8 *buf, const u8 *buf_end) {
+    assert(buf && buf_end);
+    assert(buf < buf_end);
+
+    if (buf_end - buf < 16) {
+        return shuftiVermDoubleSlow((const u8 *)&mask_lo,
+                                    (const u8 *)&mask_hi, c1, c2, buf,
+                                    buf_end);
+    }
+
+    const m128 zeroes = zeroes128();
+    const m128 low4bits = set16x8(0xf);
+    const m128 chars1 = set16x8(c1);
+    const m128 chars2 = set16x8(c2);
+
+    /* the pair load is unaligned whatever we do, so don't bother aligning */
+    const u8 *last_block = buf_end - 16;
+    for (; buf < last_block; buf += 16) {
+        u32 z = vermDoubleBlock(mask_lo, mask_hi, chars1, chars2, buf,
+                                low4bits, zeroes);
+        if (z) {
+            return buf + ctz32(z);
+        }
+    }
+
+    u32 z = vermDoubleBlock(mask_lo, mask_hi, chars1, chars2, last_block,
+                            low4bits, zeroes);
+    if (z) {
+        return last_block + ctz32(z);
+    }
+
+    return buf_end;
+}
+
 #else // AVX2 - 256 wide shuftis
 
 static really_inline
@@ -343,6 +437,25 @@ const u8 *shuftiExec(m128 mask_lo, m128 mask_hi, const u8 *buf,
     // Reroll FTW.
 
     const u8 *last_block = buf_end - 32;
+
+#if defined(__AVX512BW__)
+    // Take 64 bytes at a time while there's room; the 32-byte loop below
+    // mops up what's left.
+    if (buf + 64 <= last_block) {
+        const m512 low4bits512 = set64x8(0xf);
+        const m512 mask_lo512 = set4x128(mask_lo);
+        const m512 mask_hi512 = set4x128(mask_hi);
+        do {
+            m512 lchars = loadu512(buf);
+            u64a z = block512(mask_lo512, mask_hi512, lchars, low4bits512);
+            if (unlikely(z)) {
+                return buf + ctz64(z);
+            }
+            buf += 64;
+        } while (buf + 64 <= last_block);
+    }
+#endif
+
     while (buf < last_block) {
         m256 lchars = load256(buf);
         rv = fwdBlock(wide_mask_lo, wide_mask_hi, lchars, buf, low4bits, zeroes);
@@ -429,6 +542,23 @@ const u8 *rshuftiExec(m128 mask_lo, m128 mask_hi, const u8 *buf,
     // Unrolling was here, but it wasn't doing anything but taking up space.
     // Reroll FTW.
     const u8 *last_block = buf + 32;
+
+#if defined(__AVX512BW__)
+    if (buf_end - last_block >= 64) {
+        const m512 low4bits512 = set64x8(0xf);
+        const m512 mask_lo512 = set4x128(mask_lo);
+        const m512 mask_hi512 = set4x128(mask_hi);
+        do {
+            buf_end -= 64;
+            m512 lchars = loadu512(buf_end);
+            u64a z = block512(mask_lo512, mask_hi512, lchars, low4bits512);
+            if (unlikely(z)) {
+                return buf_end + 63 - clz64(z);
+            }
+        } while (buf_end - last_block >= 64);
+    }
+#endif
+
     while (buf_end > last_block) {
         buf_end -= 32;
         m256 lchars = load256(buf_end);
@@ -482,6 +612,24 @@ const u8 *fwdBlock2(m256 mask1_lo, m256 mask1_hi, m256 mask2_lo, m256 mask2_hi,
     return firstMatch(buf, z);
 }
 
+#if defined(__AVX512BW__)
+/* returns a bit set for every byte of chars that may start a match; unlike
+ * fwdBlock2, the second byte of each pair comes from its own load, so the
+ * block has no boundary to be conservative about */
+static really_inline
+u64a block2x512(m512 mask1_lo, m512 mask1_hi, m512 mask2_lo, m512 mask2_hi,
+                m512 chars, m512 chars2, const m512 low4bits) {
+    m512 c_lo = pshufb_m512(mask1_lo, and512(chars, low4bits));
+    m512 c_hi = pshufb_m512(mask1_hi,
+                            and512(rshift64_m512(chars, 4), low4bits));
+    m512 c2_lo = pshufb_m512(mask2_lo, and512(chars2, low4bits));
+    m512 c2_hi = pshufb_m512(mask2_hi,
+                             and512(rshift64_m512(chars2, 4), low4bits));
+    m512 t = or512(or512(c_lo, c_hi), or512(c2_lo, c2_hi));
+    return _mm512_cmpneq_epi8_mask(t, ones512());
+}
+#endif
+
 /* takes 128 bit masks, but operates on 256 bits of data */
 const u8 *shuftiDoubleExec(m128 mask1_lo, m128 mask1_hi,
                            m128 mask2_lo, m128 mask2_hi,
@@ -512,6 +660,28 @@ const u8 *shuftiDoubleExec(m128 mask1_lo, m128 mask1_hi,
     // Unrolling was here, but it wasn't doing anything but taking up space.
     // Reroll FTW.
     const u8 *last_block = buf_end - 32;
+
+#if defined(__AVX512BW__)
+    // The pair partners are read one byte further on, which stays inside the
+    // buffer as last_block is 32 bytes from the end.
+    if (buf + 64 <= last_block) {
+        const m512 low4bits512 = set64x8(0xf);
+        const m512 mask1_lo512 = set4x128(mask1_lo);
+        const m512 mask1_hi512 = set4x128(mask1_hi);
+        const m512 mask2_lo512 = set4x128(mask2_lo);
+        const m512 mask2_hi512 = set4x128(mask2_hi);
+        do {
+            u64a z = block2x512(mask1_lo512, mask1_hi512, mask2_lo512,
+                                mask2_hi512, loadu512(buf), loadu512(buf + 1),
+                                low4bits512);
+            if (unlikely(z)) {
+                return buf + ctz64(z);
+            }
+            buf += 64;
+        } while (buf + 64 <= last_block);
+    }
+#endif
+
     while (buf < last_block) {
         m256 lchars = load256(buf);
         rv = fwdBlock2(wide_mask1_lo, wide_mask1_hi, wide_mask2_lo, wide_mask2_hi,
@@ -534,4 +704,127 @@ const u8 *shuftiDoubleExec(m128 mask1_lo, m128 mask1_hi,
     return buf_end;
 }
 
+/* returns a bit set for every byte of the block that starts a pair */
+static really_inline
+u32 distBlock(m256 mask1_lo, m256 mask1_hi, m256 mask2_lo, m256 mask2_hi,
+              u8 dist, const u8 *buf, const m256 low4bits,
+              const m256 zeroes) {
+    u32 z1 = block(mask1_lo, mask1_hi, loadu256(buf), low4bits, zeroes);
+    u32 z2 = block(mask2_lo, mask2_hi, loadu256(buf + dist), low4bits,
+                   zeroes);
+    return ~(z1 | z2);
+}
+
+/* takes 128 bit masks, but operates on 256 bits of data */
+const u8 *shuftiDistExec(m128 mask1_lo, m128 mask1_hi,
+                         m128 mask2_lo, m128 mask2_hi, u8 dist,
+                         const u8 *buf, const u8 *buf_end) {
+    assert(buf && buf_end);
+    assert(buf < buf_end);
+    assert(dist);
+
+    if (buf_end - buf < 32) {
+        return shuftiDistSlow((const u8 *)&mask1_lo, (const u8 *)&mask1_hi,
+                              (const u8 *)&mask2_lo, (const u8 *)&mask2_hi,
+                              dist, buf, buf_end);
+    }
+
+    const m256 zeroes = zeroes256();
+    const m256 low4bits = set32x8(0xf);
+    const m256 wide_mask1_lo = set2x128(mask1_lo);
+    const m256 wide_mask1_hi = set2x128(mask1_hi);
+    const m256 wide_mask2_lo = set2x128(mask2_lo);
+    const m256 wide_mask2_hi = set2x128(mask2_hi);
+
+    /* the second load of each pair is unaligned whatever we do, so don't
+     * bother aligning the first */
+    const u8 *last_block = buf_end - 32;
+
+#if defined(__AVX512BW__)
+    if (buf + 64 <= last_block) {
+        const m512 low4bits512 = set64x8(0xf);
+        const m512 mask1_lo512 = set4x128(mask1_lo);
+        const m512 mask1_hi512 = set4x128(mask1_hi);
+        const m512 mask2_lo512 = set4x128(mask2_lo);
+        const m512 mask2_hi512 = set4x128(mask2_hi);
+        do {
+            u64a z = block512(mask1_lo512, mask1_hi512, loadu512(buf),
+                              low4bits512)
+                   & block512(mask2_lo512, mask2_hi512, loadu512(buf + dist),
+                              low4bits512);
+            if (unlikely(z)) {
+                return buf + ctz64(z);
+            }
+            buf += 64;
+        } while (buf + 64 <= last_block);
+    }
+#endif
+
+    for (; buf < last_block; buf += 32) {
+        u32 z = distBlock(wide_mask1_lo, wide_mask1_hi, wide_mask2_lo,
+                          wide_mask2_hi, dist, buf, low4bits, zeroes);
+        if (z) {
+            return buf + ctz32(z);
+        }
+    }
+
+    u32 z = distBlock(wide_mask1_lo, wide_mask1_hi, wide_mask2_lo,
+                      wide_mask2_hi, dist, last_block, low4bits, zeroes);
+    if (z) {
+        return last_block + ctz32(z);
+    }
+
+    return buf_end;
+}
+
+/* returns a bit set for every byte of the block that is in the class or
+ * starts the pair */
+static really_inline
+u32 vermDoubleBlock(m256 mask_lo, m256 mask_hi, m256 chars1, m256 chars2,
+                    const u8 *buf, const m256 low4bits, const m256 zeroes) {
+    m256 data = loadu256(buf);
+    u32 z = block(mask_lo, mask_hi, data, low4bits, zeroes);
+    u32 pairs = movemask256(and256(eq256(data, chars1),
+                                   eq256(loadu256(buf + 1), chars2)));
+    return ~z | pairs;
+}
+
+/* takes 128 bit masks, but operates on 256 bits of data */
+const u8 *shuftiVermDoubleExec(m128 mask_lo, m128 mask_hi, u8 c1, u8 c2,
+                               const u8 *buf, const u8 *buf_end) {
+    assert(buf && buf_end);
+    assert(buf < buf_end);
+
+    if (buf_end - buf < 32) {
+        return shuftiVermDoubleSlow((const u8 *)&mask_lo,
+                                    (const u8 *)&mask_hi, c1, c2, buf,
+                                    buf_end);
+    }
+
+    const m256 zeroes = zeroes256();
+    const m256 low4bits = set32x8(0xf);
+    const m256 wide_mask_lo = set2x128(mask_lo);
+    const m256 wide_mask_hi = set2x128(mask_hi);
+    const m256 chars1 = set32x8(c1);
+    const m256 chars2 = set32x8(c2);
+
+    /* the pair load is unaligned whatever we do, so don't bother aligning */
+    const u8 *last_block = buf_end - 32;
+    for (; buf < last_block; buf += 32) {
+        u32 z = vermDoubleBlock(wide_mask_lo, wide_mask_hi, chars1, chars2,
+                                buf, low4bits, zeroes);
+        if (z) {
+            return buf + ctz32(z);
+        }
+    }
+
+    u32 z = vermDoubleBlock(wide_mask_lo, wide_mask_hi, chars1, chars2,
+                            last_block, low4bits, zeroes);
+    if (z) {
+        return last_block + ctz32(z);
+    }
+
+    return buf_end;
+}
+
 #endif //AVX2
@@ -54,6 +54,29 @@ const u8 *shuftiDoubleExec(m128 mask1_lo, m128 mask1_hi,
                            m128 mask2_lo, m128 mask2_hi,
                            const u8 *buf, const u8 *buf_end);
 
+/**
+ * \brief Finds the first byte in the first class that is followed, \a dist
+ * bytes later, by a byte in the second class.
+ *
+ * The classes use the single shufti masks. Returns buf_end if there is no such
+ * pair; the second byte of a pair may lie beyond buf_end, so this reads up to
+ * buf_end + dist.
+ */
+const u8 *shuftiDistExec(m128 mask1_lo, m128 mask1_hi,
+                         m128 mask2_lo, m128 mask2_hi, u8 dist,
+                         const u8 *buf, const u8 *buf_end);
+
+/**
+ * \brief Finds the first byte that is either in the class or the first byte
+ * of the pair \a c1 \a c2, in a single pass.
+ *
+ * The class uses the single shufti masks. Returns buf_end if there is no such
+ * byte; the second byte of a pair may lie at buf_end, so this reads up to
+ * buf_end + 1.
+ */
+const u8 *shuftiVermDoubleExec(m128 mask_lo, m128 mask_hi, u8 c1, u8 c2,
+                               const u8 *buf, const u8 *buf_end);
+
 #ifdef __cplusplus
 }
 #endif
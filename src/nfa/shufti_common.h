@@ -54,6 +54,39 @@ const u8 *shuftiFwdSlow(const u8 *lo, const u8 *hi, const u8 *buf,
     return buf;
 }
 
+/** \brief Naive byte-by-byte implementation of the distance scheme. */
+static really_inline
+const u8 *shuftiDistSlow(const u8 *lo1, const u8 *hi1, const u8 *lo2,
+                         const u8 *hi2, u8 dist, const u8 *buf,
+                         const u8 *buf_end) {
+    assert(buf < buf_end);
+
+    for (; buf < buf_end; ++buf) {
+        u8 c1 = buf[0];
+        u8 c2 = buf[dist];
+        if ((lo1[c1 & 0xf] & hi1[c1 >> 4]) && (lo2[c2 & 0xf] & hi2[c2 >> 4])) {
+            break;
+        }
+    }
+    return buf;
+}
+
+/** \brief Naive byte-by-byte implementation of the fused class and pair
+ * scheme. */
+static really_inline
+const u8 *shuftiVermDoubleSlow(const u8 *lo, const u8 *hi, u8 c1, u8 c2,
+                               const u8 *buf, const u8 *buf_end) {
+    assert(buf < buf_end);
+
+    for (; buf < buf_end; ++buf) {
+        u8 c = buf[0];
+        if ((lo[c & 0xf] & hi[c >> 4]) || (c == c1 && buf[1] == c2)) {
+            break;
+        }
+    }
+    return buf;
+}
+
 #ifdef DEBUG
 #include <ctype.h>
 
@@ -139,6 +172,17 @@ u32 block(m256 mask_lo, m256 mask_hi, m256 chars, const m256 low4bits,
     return movemask256(eq256(t, compare));
 }
 
+#if defined(__AVX512BW__)
+/* returns a bit set for every byte of chars that is in the class */
+static really_inline
+u64a block512(m512 mask_lo, m512 mask_hi, m512 chars, const m512 low4bits) {
+    m512 c_lo = pshufb_m512(mask_lo, and512(chars, low4bits));
+    m512 c_hi = pshufb_m512(mask_hi,
+                            and512(rshift64_m512(chars, 4), low4bits));
+    return _mm512_test_epi8_mask(c_lo, c_hi);
+}
+#endif
+
 #endif
 
 
@@ -34,6 +34,9 @@
 #include "tamarama.h"
 
 #include "tamarama_internal.h"
+#include "castle.h"
+#include "limex.h"
+#include "mcclellan.h"
 #include "nfa_api.h"
 #include "nfa_api_queue.h"
 #include "nfa_api_util.h"
@@ -137,15 +140,22 @@ void copyQueue(const struct Tamarama *t, const struct NFA *sub,
 static
 u32 findEngineForTop(const u32 *baseTop, const u32 cur,
                      const u32 numSubEngines) {
-    u32 i;
-    for (i = 0; i < numSubEngines; ++i) {
-        DEBUG_PRINTF("cur:%u base:%u\n", cur, baseTop[i]);
-        if (cur >= baseTop[i] &&
-            (i == numSubEngines - 1 || cur < baseTop[i + 1])) {
-            break;
+    // Top bases are strictly increasing: find the last one <= cur.
+    assert(numSubEngines);
+    if (cur < baseTop[0]) {
+        return numSubEngines;
+    }
+    u32 lo = 0, hi = numSubEngines;
+    while (hi - lo > 1) {
+        u32 mid = lo + (hi - lo) / 2;
+        DEBUG_PRINTF("cur:%u base[%u]:%u\n", cur, mid, baseTop[mid]);
+        if (baseTop[mid] <= cur) {
+            lo = mid;
+        } else {
+            hi = mid;
         }
     }
-    return i;
+    return lo;
 }
 
 static
@@ -397,38 +407,49 @@ enum nfa_zombie_status nfaExecTamarama0_zombie_status(const struct NFA *n,
     return nfaGetZombieStatus(sub, &q1, loc);
 }
 
-char nfaExecTamarama0_Q(const struct NFA *n, struct mq *q, s64a end) {
-    DEBUG_PRINTF("exec\n");
-    struct mq q1;
-    char rv = MO_ALIVE;
-    char copy = 0;
-    const struct Tamarama *t = getImplNfa(n);
-    while (q->cur < q->end && q_cur_loc(q) <= end) {
-        updateQueues(t, q, &q1);
-        rv = nfaQueueExec_raw(q1.nfa, &q1, end);
-        q->report_current = q1.report_current;
-        copy = 1;
-        if (can_stop_matching(q->scratch)) {
-            break;
-        }
-    }
-    if (copy) {
-        copyBack(t, q, &q1);
+/* When every subengine has the same type (recorded at compile time in
+ * Tamarama::subType), the common types below are called directly, and the
+ * exec loop is specialised for them, rather than going through the general
+ * dispatcher for every subqueue. */
+#define TAMA_SUBTYPE_CASES(case_fn)                                            \
+    case_fn(LIMEX_NFA_32, LimEx32)                                             \
+    case_fn(LIMEX_NFA_64, LimEx64)                                             \
+    case_fn(LIMEX_NFA_128, LimEx128)                                           \
+    case_fn(LIMEX_NFA_256, LimEx256)                                           \
+    case_fn(LIMEX_NFA_384, LimEx384)                                           \
+    case_fn(LIMEX_NFA_512, LimEx512)                                           \
+    case_fn(LIMEX_NFA_1024, LimEx1024)                                         \
+    case_fn(MCCLELLAN_NFA_8, McClellan8)                                       \
+    case_fn(MCCLELLAN_NFA_16, McClellan16)                                     \
+    case_fn(CASTLE_NFA_0, Castle0)
+
+#define TAMA_EXEC_CASE(type, name)                                             \
+    case type:                                                                 \
+        return to_match ? nfaExec##name##_Q2(sub, q1, end)                     \
+                        : nfaExec##name##_Q(sub, q1, end);
+
+static really_inline
+char tamaSubQueueExec(const u8 subType, const struct NFA *sub, struct mq *q1,
+                      s64a end, const char to_match) {
+    assert(subType == INVALID_NFA || subType == sub->type);
+    switch (subType) {
+    TAMA_SUBTYPE_CASES(TAMA_EXEC_CASE)
+    default:
+        return to_match ? nfaQueueExec2_raw(sub, q1, end)
+                        : nfaQueueExec_raw(sub, q1, end);
     }
-    return rv;
 }
 
-char nfaExecTamarama0_Q2(const struct NFA *n,
-                         struct mq *q, s64a end) {
-    DEBUG_PRINTF("exec to match\n");
+static really_inline
+char tamaQueueExec_i(const struct Tamarama *t, struct mq *q, s64a end,
+                     const u8 subType, const char to_match) {
     struct mq q1;
-    char rv = 0;
+    char rv = to_match ? 0 : MO_ALIVE;
     char copy = 0;
-    const struct Tamarama *t = getImplNfa(n);
     while (q->cur < q->end && q_cur_loc(q) <= end &&
-           rv != MO_MATCHES_PENDING) {
+           (!to_match || rv != MO_MATCHES_PENDING)) {
         updateQueues(t, q, &q1);
-        rv = nfaQueueExec2_raw(q1.nfa, &q1, end);
+        rv = tamaSubQueueExec(subType, q1.nfa, &q1, end, to_match);
         q->report_current = q1.report_current;
         copy = 1;
         if (can_stop_matching(q->scratch)) {
@@ -441,3 +462,28 @@ char nfaExecTamarama0_Q2(const struct NFA *n,
     return rv;
 }
 
+#define TAMA_SPECIALISE_CASE(type, name)                                       \
+    case type:                                                                 \
+        return tamaQueueExec_i(t, q, end, type, to_match);
+
+static really_inline
+char tamaQueueExec(const struct NFA *n, struct mq *q, s64a end,
+                   const char to_match) {
+    const struct Tamarama *t = getImplNfa(n);
+    switch (t->subType) {
+    TAMA_SUBTYPE_CASES(TAMA_SPECIALISE_CASE)
+    default:
+        return tamaQueueExec_i(t, q, end, INVALID_NFA, to_match);
+    }
+}
+
+char nfaExecTamarama0_Q(const struct NFA *n, struct mq *q, s64a end) {
+    DEBUG_PRINTF("exec\n");
+    return tamaQueueExec(n, q, end, 0);
+}
+
+char nfaExecTamarama0_Q2(const struct NFA *n,
+                         struct mq *q, s64a end) {
+    DEBUG_PRINTF("exec to match\n");
+    return tamaQueueExec(n, q, end, 1);
+}
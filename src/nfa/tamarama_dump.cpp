@@ -35,6 +35,7 @@
 #include "tamarama_dump.h"
 
 #include "tamarama_internal.h"
+#include "nfa_build_util.h"
 #include "nfa_dump_api.h"
 #include "nfa_dump_internal.h"
 #include "nfa_internal.h"
@@ -71,6 +72,10 @@ void nfaExecTamarama0_dumpText(const struct NFA *nfa, FILE *f) {
     fprintf(f, "Tamarama container engine\n");
     fprintf(f, "\n");
     fprintf(f, "Number of subengine tenants:  %u\n", t->numSubEngines);
+    if (t->subType != INVALID_NFA) {
+        fprintf(f, "Subengine type:               %s\n",
+                nfa_type_name((NFAEngineType)t->subType));
+    }
 
     fprintf(f, "\n");
     dumpTextReverse(nfa, f);
@@ -100,6 +100,8 @@
 struct ALIGN_AVX_DIRECTIVE Tamarama {
     u32 numSubEngines;
     u8 activeIdxSize;
+    u8 subType; /**< NFAEngineType shared by every subengine, or INVALID_NFA
+                 * if they differ; lets the runtime dispatch directly */
 };
 
 #endif // NFA_TAMARAMA_INTERNAL_H
@@ -143,6 +143,14 @@ aligned_unique_ptr<NFA> buildTamarama(const TamaInfo &tamaInfo, const u32 queue,
     Tamarama *t = (Tamarama *)ptr;
     t->numSubEngines = verify_u32(subSize);
     t->activeIdxSize = verify_u8(activeIdxSize);
+    t->subType = verify_u8(tamaInfo.subengines.front()->type);
+    for (const auto &sub : tamaInfo.subengines) {
+        if (sub->type != t->subType) {
+            t->subType = verify_u8(INVALID_NFA);
+            break;
+        }
+    }
+    DEBUG_PRINTF("subengine type:%u\n", t->subType);
 
     ptr += sizeof(Tamarama);
     copy_bytes(ptr, top_base);
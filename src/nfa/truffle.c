@@ -235,6 +235,22 @@ const u8 *truffleExec(m128 shuf_mask_lo_highclear,
     buf += (32 - min);
 
     const u8 *last_block = buf_end - 32;
+
+#if defined(__AVX512BW__)
+    if (buf + 64 <= last_block) {
+        const m512 wide512_clear = set4x128(shuf_mask_lo_highclear);
+        const m512 wide512_set = set4x128(shuf_mask_lo_highset);
+        do {
+            m512 lchars = loadu512(buf);
+            u64a z = block512(wide512_clear, wide512_set, lchars);
+            if (unlikely(z)) {
+                return buf + ctz64(z);
+            }
+            buf += 64;
+        } while (buf + 64 <= last_block);
+    }
+#endif
+
     while (buf < last_block) {
         m256 lchars = load256(buf);
         rv = fwdBlock(wide_clear, wide_set, lchars, buf);
@@ -303,6 +319,22 @@ const u8 *rtruffleExec(m128 shuf_mask_lo_highclear,
     buf_end = (const u8 *)((size_t)buf_end & ~((size_t)0x1f));
 
     const u8 *last_block = buf + 32;
+
+#if defined(__AVX512BW__)
+    if (buf_end - last_block >= 64) {
+        const m512 wide512_clear = set4x128(shuf_mask_lo_highclear);
+        const m512 wide512_set = set4x128(shuf_mask_lo_highset);
+        do {
+            buf_end -= 64;
+            m512 lchars = loadu512(buf_end);
+            u64a z = block512(wide512_clear, wide512_set, lchars);
+            if (unlikely(z)) {
+                return buf_end + 63 - clz64(z);
+            }
+        } while (buf_end - last_block >= 64);
+    }
+#endif
+
     while (buf_end > last_block) {
         buf_end -= 32;
         m256 lchars = load256(buf_end);
@@ -51,8 +51,8 @@ const u8 *firstMatch(const u8 *buf, u32 z) {
 static really_inline
 u32 block(m128 shuf_mask_lo_highclear, m128 shuf_mask_lo_highset, m128 v) {
 
-    m128 highconst = _mm_set1_epi8(0x80);
-    m128 shuf_mask_hi = _mm_set1_epi64x(0x8040201008040201);
+    m128 highconst = set16x8(0x80);
+    m128 shuf_mask_hi = set64x2(0x8040201008040201, 0x8040201008040201);
 
     // and now do the real work
     m128 shuf1 = pshufb(shuf_mask_lo_highclear, v);
@@ -141,6 +141,23 @@ const u8 *truffleMini(m256 shuf_mask_lo_highclear, m256 shuf_mask_lo_highset,
     }
 }
 
+#if defined(__AVX512BW__)
+/* returns a bit set for every byte of v that is in the class */
+static really_inline
+u64a block512(m512 shuf_mask_lo_highclear, m512 shuf_mask_lo_highset,
+              m512 v) {
+    m512 highconst = set64x8(0x80);
+    m512 shuf_mask_hi = _mm512_set1_epi64(0x8040201008040201);
+
+    m512 shuf1 = pshufb_m512(shuf_mask_lo_highclear, v);
+    m512 t1 = xor512(v, highconst);
+    m512 shuf2 = pshufb_m512(shuf_mask_lo_highset, t1);
+    m512 t2 = andnot512(highconst, rshift64_m512(v, 4));
+    m512 shuf3 = pshufb_m512(shuf_mask_hi, t2);
+    return _mm512_test_epi8_mask(or512(shuf1, shuf2), shuf3);
+}
+#endif
+
 #endif
 
 #endif /* TRUFFLE_COMMON_H_ */
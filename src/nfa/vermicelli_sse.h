@@ -29,6 +29,9 @@
 /** \file
  * \brief Vermicelli: Intel SSE implementation.
  *
+ * When AVX-512BW is available, the aligned search loops take 64 bytes at a
+ * time before dropping back to 16-byte blocks for the remainder.
+ *
  * (users should include vermicelli.h)
  */
 
@@ -40,6 +43,18 @@ static really_inline
 const u8 *vermSearchAligned(m128 chars, const u8 *buf, const u8 *buf_end,
                             char negate) {
     assert((size_t)buf % 16 == 0);
+#if defined(__AVX512BW__)
+    const m512 chars512 = set4x128(chars);
+    for (; buf + 63 < buf_end; buf += 64) {
+        u64a z = eq512mask(chars512, loadu512(buf));
+        if (negate) {
+            z = ~z;
+        }
+        if (unlikely(z)) {
+            return buf + ctz64(z);
+        }
+    }
+#endif
     for (; buf + 31 < buf_end; buf += 32) {
         m128 data = load128(buf);
         u32 z1 = movemask128(eq128(chars, data));
@@ -74,6 +89,20 @@ const u8 *vermSearchAlignedNocase(m128 chars, const u8 *buf,
     assert((size_t)buf % 16 == 0);
     m128 casemask = set16x8(CASE_CLEAR);
 
+#if defined(__AVX512BW__)
+    const m512 chars512 = set4x128(chars);
+    const m512 casemask512 = set64x8(CASE_CLEAR);
+    for (; buf + 63 < buf_end; buf += 64) {
+        u64a z = eq512mask(chars512, and512(casemask512, loadu512(buf)));
+        if (negate) {
+            z = ~z;
+        }
+        if (unlikely(z)) {
+            return buf + ctz64(z);
+        }
+    }
+#endif
+
     for (; buf + 31 < buf_end; buf += 32) {
         m128 data = load128(buf);
         u32 z1 = movemask128(eq128(chars, and128(casemask, data)));
@@ -135,6 +164,21 @@ const u8 *vermUnalignNocase(m128 chars, const u8 *buf, char negate) {
 static really_inline
 const u8 *dvermSearchAligned(m128 chars1, m128 chars2, u8 c1, u8 c2,
                              const u8 *buf, const u8 *buf_end) {
+#if defined(__AVX512BW__)
+    const m512 chars1_512 = set4x128(chars1);
+    const m512 chars2_512 = set4x128(chars2);
+    for (; buf + 64 < buf_end; buf += 64) {
+        m512 data = loadu512(buf);
+        u64a z = eq512mask(chars1_512, data) &
+                 (eq512mask(chars2_512, data) >> 1);
+        if (buf[63] == c1 && buf[64] == c2) {
+            z |= 1ULL << 63;
+        }
+        if (unlikely(z)) {
+            return buf + ctz64(z);
+        }
+    }
+#endif
     for (; buf + 16 < buf_end; buf += 16) {
         m128 data = load128(buf);
         u32 z = movemask128(and128(eq128(chars1, data),
@@ -157,6 +201,22 @@ const u8 *dvermSearchAlignedNocase(m128 chars1, m128 chars2, u8 c1, u8 c2,
     assert((size_t)buf % 16 == 0);
     m128 casemask = set16x8(CASE_CLEAR);
 
+#if defined(__AVX512BW__)
+    const m512 chars1_512 = set4x128(chars1);
+    const m512 chars2_512 = set4x128(chars2);
+    const m512 casemask512 = set64x8(CASE_CLEAR);
+    for (; buf + 64 < buf_end; buf += 64) {
+        m512 v = and512(casemask512, loadu512(buf));
+        u64a z = eq512mask(chars1_512, v) & (eq512mask(chars2_512, v) >> 1);
+        if ((buf[63] & CASE_CLEAR) == c1 && (buf[64] & CASE_CLEAR) == c2) {
+            z |= 1ULL << 63;
+        }
+        if (unlikely(z)) {
+            return buf + ctz64(z);
+        }
+    }
+#endif
+
     for (; buf + 16 < buf_end; buf += 16) {
         m128 data = load128(buf);
         m128 v = and128(casemask, data);
@@ -180,6 +240,25 @@ const u8 *dvermSearchAlignedMasked(m128 chars1, m128 chars2,
                                    u8 m2, const u8 *buf, const u8 *buf_end) {
     assert((size_t)buf % 16 == 0);
 
+#if defined(__AVX512BW__)
+    const m512 chars1_512 = set4x128(chars1);
+    const m512 chars2_512 = set4x128(chars2);
+    const m512 mask1_512 = set4x128(mask1);
+    const m512 mask2_512 = set4x128(mask2);
+    for (; buf + 64 < buf_end; buf += 64) {
+        m512 data = loadu512(buf);
+        u64a z1 = eq512mask(chars1_512, and512(data, mask1_512));
+        u64a z2 = eq512mask(chars2_512, and512(data, mask2_512));
+        u64a z = z1 & (z2 >> 1);
+        if ((buf[63] & m1) == c1 && (buf[64] & m2) == c2) {
+            z |= 1ULL << 63;
+        }
+        if (unlikely(z)) {
+            return buf + ctz64(z);
+        }
+    }
+#endif
+
     for (; buf + 16 < buf_end; buf += 16) {
         m128 data = load128(buf);
         m128 v1 = eq128(chars1, and128(data, mask1));
@@ -258,6 +337,18 @@ static really_inline
 const u8 *rvermSearchAligned(m128 chars, const u8 *buf, const u8 *buf_end,
                              char negate) {
     assert((size_t)buf_end % 16 == 0);
+#if defined(__AVX512BW__)
+    const m512 chars512 = set4x128(chars);
+    for (; buf + 63 < buf_end; buf_end -= 64) {
+        u64a z = eq512mask(chars512, loadu512(buf_end - 64));
+        if (negate) {
+            z = ~z;
+        }
+        if (unlikely(z)) {
+            return buf_end - 1 - clz64(z);
+        }
+    }
+#endif
     for (; buf + 15 < buf_end; buf_end -= 16) {
         m128 data = load128(buf_end - 16);
         u32 z = movemask128(eq128(chars, data));
@@ -277,6 +368,21 @@ const u8 *rvermSearchAlignedNocase(m128 chars, const u8 *buf,
     assert((size_t)buf_end % 16 == 0);
     m128 casemask = set16x8(CASE_CLEAR);
 
+#if defined(__AVX512BW__)
+    const m512 chars512 = set4x128(chars);
+    const m512 casemask512 = set64x8(CASE_CLEAR);
+    for (; buf + 63 < buf_end; buf_end -= 64) {
+        m512 data = loadu512(buf_end - 64);
+        u64a z = eq512mask(chars512, and512(casemask512, data));
+        if (negate) {
+            z = ~z;
+        }
+        if (unlikely(z)) {
+            return buf_end - 1 - clz64(z);
+        }
+    }
+#endif
+
     for (; buf + 15 < buf_end; buf_end -= 16) {
         m128 data = load128(buf_end - 16);
         u32 z = movemask128(eq128(chars, and128(casemask, data)));
@@ -324,6 +430,22 @@ const u8 *rdvermSearchAligned(m128 chars1, m128 chars2, u8 c1, u8 c2,
                               const u8 *buf, const u8 *buf_end) {
     assert((size_t)buf_end % 16 == 0);
 
+#if defined(__AVX512BW__)
+    const m512 chars1_512 = set4x128(chars1);
+    const m512 chars2_512 = set4x128(chars2);
+    for (; buf + 64 < buf_end; buf_end -= 64) {
+        m512 data = loadu512(buf_end - 64);
+        u64a z = eq512mask(chars2_512, data) &
+                 (eq512mask(chars1_512, data) << 1);
+        if (buf_end[-65] == c1 && buf_end[-64] == c2) {
+            z |= 1;
+        }
+        if (unlikely(z)) {
+            return buf_end - 1 - clz64(z);
+        }
+    }
+#endif
+
     for (; buf + 16 < buf_end; buf_end -= 16) {
         m128 data = load128(buf_end - 16);
         u32 z = movemask128(and128(eq128(chars2, data),
@@ -344,6 +466,23 @@ const u8 *rdvermSearchAlignedNocase(m128 chars1, m128 chars2, u8 c1, u8 c2,
     assert((size_t)buf_end % 16 == 0);
     m128 casemask = set16x8(CASE_CLEAR);
 
+#if defined(__AVX512BW__)
+    const m512 chars1_512 = set4x128(chars1);
+    const m512 chars2_512 = set4x128(chars2);
+    const m512 casemask512 = set64x8(CASE_CLEAR);
+    for (; buf + 64 < buf_end; buf_end -= 64) {
+        m512 v = and512(casemask512, loadu512(buf_end - 64));
+        u64a z = eq512mask(chars2_512, v) & (eq512mask(chars1_512, v) << 1);
+        if ((buf_end[-65] & CASE_CLEAR) == c1
+            && (buf_end[-64] & CASE_CLEAR) == c2) {
+            z |= 1;
+        }
+        if (unlikely(z)) {
+            return buf_end - 1 - clz64(z);
+        }
+    }
+#endif
+
     for (; buf + 16 < buf_end; buf_end -= 16) {
         m128 data = load128(buf_end - 16);
         m128 v = and128(casemask, data);
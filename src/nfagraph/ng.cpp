@@ -42,6 +42,7 @@
 #include "ng_extparam.h"
 #include "ng_fixed_width.h"
 #include "ng_haig.h"
+#include "ng_is_equal.h"
 #include "ng_literal_component.h"
 #include "ng_literal_decorated.h"
 #include "ng_misc_opt.h"
@@ -66,12 +67,19 @@
 #include "rose/rose_build.h"
 #include "smallwrite/smallwrite_build.h"
 #include "util/compile_error.h"
+#include "util/compile_report.h"
 #include "util/container.h"
 #include "util/depth.h"
 #include "util/graph_range.h"
 #include "util/make_unique.h"
 #include "util/ue2string.h"
 
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <tuple>
+
 using namespace std;
 
 namespace ue2 {
@@ -80,9 +88,12 @@ NG::NG(const CompileContext &in_cc, size_t num_patterns,
        unsigned in_somPrecision)
     : maxSomRevHistoryAvailable(in_cc.grey.somMaxRevNfaLength),
       minWidth(depth::infinity()),
+      maxWidth(0),
+      maxOffset(0),
       rm(in_cc.grey),
       ssm(in_somPrecision),
       cc(in_cc),
+      compileThreads(1),
       smwr(makeSmallWriteBuilder(num_patterns, rm, cc)),
       rose(makeRoseBuilder(rm, ssm, *smwr, cc, boundary)) {
 }
@@ -199,26 +210,112 @@ void reduceGraph(NGHolder &g, som_type som, bool utf8,
     }
 }
 
+/** \brief Graph-local passes run on each component before it is offered to
+ * Rose. These only read the CompileContext, so they may run concurrently on
+ * different components. */
 static
-bool addComponent(NG &ng, NGHolder &g, const NGWrapper &w, const som_type som,
-                  const u32 comp_id) {
-    const CompileContext &cc = ng.cc;
-
+void reduceComponent(NGHolder &g, const NGWrapper &w, const som_type som,
+                     const CompileContext &cc, const u32 comp_id) {
     DEBUG_PRINTF("expr=%u, comp=%u: %zu vertices, %zu edges\n",
                  w.expressionIndex, comp_id, num_vertices(g), num_edges(g));
 
-    dumpComponent(g, "01_begin", w.expressionIndex, comp_id, ng.cc.grey);
-
-    assert(allMatchStatesHaveReports(w));
+    dumpComponent(g, "01_begin", w.expressionIndex, comp_id, cc.grey);
 
     reduceGraph(g, som, w.utf8, cc);
 
-    dumpComponent(g, "02_reduced", w.expressionIndex, comp_id, ng.cc.grey);
+    dumpComponent(g, "02_reduced", w.expressionIndex, comp_id, cc.grey);
 
     // There may be redundant regions that we can remove
     if (cc.grey.performGraphSimplification) {
         removeRegionRedundancy(g, som);
     }
+}
+
+/** \brief Total component size below which reducing on worker threads costs
+ * more in thread start-up than it saves. */
+static const size_t PARALLEL_REDUCE_MIN_VERTICES = 1000;
+
+/**
+ * \brief Runs \ref reduceComponent over all live components on a pool of
+ * worker threads.
+ *
+ * Returns false (having done nothing) if the components should instead be
+ * reduced one at a time by \ref addComponent. SOM components are always left
+ * to the serial path, as a failure there abandons the remaining components
+ * before they are reduced.
+ */
+static
+bool reduceComponentsParallel(NG &ng, const NGWrapper &w,
+                              deque<unique_ptr<NGHolder>> &g_comp,
+                              const som_type som) {
+    if (som || ng.compileThreads <= 1) {
+        return false;
+    }
+
+    vector<u32> live;
+    size_t total_vertices = 0;
+    for (u32 i = 0; i < g_comp.size(); i++) {
+        if (g_comp[i]) {
+            live.push_back(i);
+            total_vertices += num_vertices(*g_comp[i]);
+        }
+    }
+
+    if (live.size() < 2 || total_vertices < PARALLEL_REDUCE_MIN_VERTICES) {
+        return false;
+    }
+
+    const u32 n = live.size();
+    const unsigned threads = min(ng.compileThreads, n);
+    DEBUG_PRINTF("reducing %u components with %u threads\n", n, threads);
+
+    const CompileContext &cc = ng.cc;
+    vector<exception_ptr> errors(n);
+    atomic<u32> next(0);
+
+    auto worker = [&]() {
+        for (u32 j = next++; j < n; j = next++) {
+            try {
+                reduceComponent(*g_comp[live[j]], w, som, cc, live[j]);
+            } catch (...) {
+                errors[j] = current_exception();
+            }
+        }
+    };
+
+    vector<thread> pool;
+    try {
+        for (unsigned t = 1; t < threads; t++) {
+            pool.emplace_back(worker);
+        }
+    } catch (const system_error &) {
+        // Couldn't start another thread; carry on with the ones we have.
+        DEBUG_PRINTF("only started %zu extra threads\n", pool.size());
+    }
+    worker();
+    for (auto &t : pool) {
+        t.join();
+    }
+
+    for (const auto &e : errors) {
+        if (e) {
+            rethrow_exception(e);
+        }
+    }
+
+    return true;
+}
+
+static
+bool addComponent(NG &ng, NGHolder &g, const NGWrapper &w, const som_type som,
+                  const u32 comp_id, const bool reduced) {
+    const CompileContext &cc = ng.cc;
+
+    assert(allMatchStatesHaveReports(w));
+
+    if (!reduced) {
+        reduceComponent(g, w, som, cc, comp_id);
+    }
 
     // "Short Exhaustible Passthrough" patterns always become outfixes.
     if (!som && isSEP(g, ng.rm, cc.grey)) {
@@ -228,6 +325,19 @@ bool addComponent(NG &ng, NGHolder &g, const NGWrapper &w, const som_type som,
         }
     }
 
+    // Over the compile time budget, skip the search for a decomposition and
+    // take the whole component as an outfix engine if we can.
+    if (!som && overBudget(cc)) {
+        if (w.prefilter && cc.grey.prefilterReductions) {
+            prefilterReductions(g, cc, w.prefilter_states);
+        }
+        if (ng.rose->addOutfix(g)) {
+            DEBUG_PRINTF("over budget, added as outfix\n");
+            markDegraded(g, ng.rm, cc);
+            return true;
+        }
+    }
+
     // Start Of Match handling.
     if (som) {
         if (addComponentSom(ng, g, w, som, comp_id)) {
@@ -310,12 +420,14 @@ bool processComponents(NG &ng, NGWrapper &w,
                        const som_type som) {
     const u32 num_components = g_comp.size();
 
+    const bool reduced = reduceComponentsParallel(ng, w, g_comp, som);
+
     u32 failed = 0;
     for (u32 i = 0; i < num_components; i++) {
         if (!g_comp[i]) {
             continue;
         }
-        if (addComponent(ng, *g_comp[i], w, som, i)) {
+        if (addComponent(ng, *g_comp[i], w, som, i, reduced)) {
             g_comp[i].reset();
             continue;
         }
@@ -336,6 +448,8 @@ bool processComponents(NG &ng, NGWrapper &w,
 }
 
 bool NG::addGraph(NGWrapper &w) {
+    PhaseTimer timer(cc, PHASE_GRAPH, w.expressionIndex);
+
     // remove reports that aren't on vertices connected to accept.
     clearReports(w);
 
@@ -349,6 +463,21 @@ bool NG::addGraph(NGWrapper &w) {
     dumpDotWrapper(w, "01_initial", cc.grey);
     assert(allMatchStatesHaveReports(w));
 
+    if (w.highlander || w.min_offset || w.max_offset != MAX_OFFSET) {
+        maxWidth = depth::infinity();
+    } else {
+        maxWidth = max(maxWidth, findMaxWidth(w));
+    }
+
+    if (w.max_offset != MAX_OFFSET) {
+        maxOffset = max(maxOffset, w.max_offset);
+    } else if (isAnchored(w)) {
+        depth d = findMaxWidth(w);
+        maxOffset = max(maxOffset, d.is_finite() ? (u64a)(u32)d : MAX_OFFSET);
+    } else {
+        maxOffset = MAX_OFFSET;
+    }
+
     /* ensure utf8 starts at cp boundary */
     ensureCodePointStart(rm, w);
     resolveAsserts(rm, w);
@@ -446,6 +575,11 @@ bool NG::addGraph(NGWrapper &w) {
     assert(!g_comp.empty());
 
     if (!som) {
+        // The components are copies, and nothing past this point reads the
+        // expression graph except in SOM mode, so release it rather than
+        // keeping both alive while the components are compiled.
+        clear_graph(w);
+
         for (u32 i = 0; i < g_comp.size(); i++) {
             assert(g_comp[i]);
             reformLeadingDots(*g_comp[i]);
@@ -467,7 +601,7 @@ bool NG::addGraph(NGWrapper &w) {
                 continue;
             }
 
-            prefilterReductions(*g_comp[i], cc);
+            prefilterReductions(*g_comp[i], cc, w.prefilter_states);
         }
 
         if (processComponents(*this, w, g_comp, som)) {
@@ -488,6 +622,163 @@ bool NG::addGraph(NGWrapper &w) {
     return false;
 }
 
+/** \brief Largest graph that \ref NG::addSharedGraph will hold back for
+ * comparison with later expressions. */
+static const size_t MAX_SHARED_GRAPH_VERTICES = 500;
+
+/** \brief Returns true if \a w is a candidate for sharing its graph with
+ * other expressions: the only thing that may distinguish it from another
+ * expression with the same graph is the report it raises. */
+static
+bool canShareGraph(const NGWrapper &w) {
+    return w.som == SOM_NONE && !w.highlander && !w.min_offset &&
+           w.max_offset == MAX_OFFSET && !w.min_length &&
+           num_vertices(w) <= MAX_SHARED_GRAPH_VERTICES;
+}
+
+/** \brief The parts of a report that must agree for two expressions to share
+ * a graph; the external id (and hence the exhaustion key) may differ. */
+using SharedReportKey =
+    tuple<ReportType, bool, u64a, u64a, u64a, s32, u32, u64a, u64a, bool>;
+
+static
+SharedReportKey sharedReportKey(const Report &r) {
+    return make_tuple(r.type, r.quashSom, r.minOffset, r.maxOffset,
+                      r.minLength, r.offsetAdjust, r.revNfaIndex,
+                      r.somDistance, r.topSquashDistance,
+                      r.ekey != INVALID_EKEY);
+}
+
+static
+bool sameReportsExceptId(const ReportManager &rm, const flat_set<ReportID> &a,
+                         const flat_set<ReportID> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    vector<SharedReportKey> keys_a, keys_b;
+    for (ReportID id : a) {
+        keys_a.push_back(sharedReportKey(rm.getReport(id)));
+    }
+    for (ReportID id : b) {
+        keys_b.push_back(sharedReportKey(rm.getReport(id)));
+    }
+    sort(keys_a.begin(), keys_a.end());
+    sort(keys_b.begin(), keys_b.end());
+    return keys_a == keys_b;
+}
+
+/** \brief Vertices of \a g, indexed by vertex index. */
+static
+vector<NFAVertex> verticesByIndex(const NGHolder &g) {
+    vector<NFAVertex> verts(num_vertices(g));
+    for (auto v : vertices_range(g)) {
+        verts[g[v].index] = v;
+    }
+    return verts;
+}
+
+/** \brief Assertions are not compared by is_equal, as they have normally been
+ * resolved by the time it is used. */
+static
+bool sameAsserts(const NGHolder &a, const NGHolder &b) {
+    const auto verts_b = verticesByIndex(b);
+
+    for (auto va : vertices_range(a)) {
+        NFAVertex vb = verts_b[a[va].index];
+        if (a[va].assert_flags != b[vb].assert_flags) {
+            return false;
+        }
+    }
+
+    for (const auto &e : edges_range(a)) {
+        NFAVertex ub = verts_b[a[source(e, a)].index];
+        NFAVertex vb = verts_b[a[target(e, a)].index];
+        NFAEdge eb = edge(ub, vb, b).first;
+        if (a[e].assert_flags != b[eb].assert_flags) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static
+bool canMergeGraphs(const ReportManager &rm, const NGWrapper &a,
+                    const NGWrapper &b) {
+    if (a.utf8 != b.utf8 || a.prefilter != b.prefilter) {
+        return false;
+    }
+
+    auto reports_equal = [&rm](const flat_set<ReportID> &ra,
+                               const flat_set<ReportID> &rb) {
+        return sameReportsExceptId(rm, ra, rb);
+    };
+
+    return is_equal(a, b, reports_equal) && sameAsserts(a, b);
+}
+
+/** \brief Adds the reports on the vertices of \a b to the corresponding
+ * vertices of \a a. */
+static
+void mergeGraphReports(NGWrapper &a, const NGWrapper &b) {
+    const auto verts_a = verticesByIndex(a);
+    for (auto vb : vertices_range(b)) {
+        const auto &reports = b[vb].reports;
+        a[verts_a[b[vb].index]].reports.insert(reports.begin(), reports.end());
+    }
+}
+
+void NG::addSharedGraph(unique_ptr<NGWrapper> w) {
+    assert(w);
+
+    if (!cc.grey.shareIdenticalGraphs || !canShareGraph(*w)) {
+        if (!addGraph(*w)) {
+            throw CompileError(w->expressionIndex,
+                               "Error compiling expression.");
+        }
+        return;
+    }
+
+    renumber_vertices(*w);
+
+    auto &candidates = shared_graph_index[hash_holder(*w)];
+    for (size_t i : candidates) {
+        NGWrapper &cand = *shared_graphs[i];
+        if (canMergeGraphs(rm, cand, *w)) {
+            DEBUG_PRINTF("expression %u shares graph of expression %u\n",
+                         w->expressionIndex, cand.expressionIndex);
+            mergeGraphReports(cand, *w);
+            return;
+        }
+    }
+
+    candidates.push_back(shared_graphs.size());
+    shared_graphs.push_back(move(w));
+}
+
+void NG::flushSharedGraphs() {
+    DEBUG_PRINTF("adding %zu shared graphs\n", shared_graphs.size());
+
+    auto graphs = move(shared_graphs);
+    shared_graphs.clear();
+    shared_graph_index.clear();
+
+    for (auto &w : graphs) {
+        try {
+            if (!addGraph(*w)) {
+                throw CompileError("Error compiling expression.");
+            }
+        } catch (CompileError &e) {
+            // Errors are attributed to the first expression that used the
+            // graph.
+            e.setExpressionIndex(w->expressionIndex);
+            throw; /* do not slice */
+        }
+        w.reset();
+    }
+}
+
 /** \brief Used from SOM mode to add an arbitrary NGHolder as an engine. */
 bool NG::addHolder(NGHolder &w) {
     DEBUG_PRINTF("adding holder of %zu states\n", num_vertices(w));
@@ -556,7 +847,52 @@ bool NG::addHolder(NGHolder &w) {
 
 bool NG::addLiteral(const ue2_literal &literal, u32 expr_index,
                     u32 external_report, bool highlander, som_type som) {
-    assert(!literal.empty());
+    return addLiterals({literal}, expr_index, external_report, highlander, som,
+                       LiteralDecoration());
+}
+
+/** \brief Builds the graph for literals added by \ref NG::addLiterals, for
+ * the small write engine. \a lit_report is raised at the end of each literal
+ * and \a lf_report after its optional trailing newline. */
+static
+unique_ptr<NGWrapper> buildDecoratedWrapper(const vector<ue2_literal> &lits,
+                                            u32 expr_index, bool highlander,
+                                            som_type som, ReportID id,
+                                            const LiteralDecoration &dec,
+                                            ReportID lit_report,
+                                            ReportID lf_report) {
+    auto g = ue2::make_unique<NGWrapper>(expr_index, highlander, false, false,
+                                         som, id, dec.min_offset,
+                                         dec.max_offset, dec.min_length);
+    NFAVertex accept = dec.eod || dec.eod_lf ? g->acceptEod : g->accept;
+
+    for (const auto &lit : lits) {
+        NFAVertex u = dec.anchored ? g->start : g->startDs;
+        for (const auto &c : lit) {
+            NFAVertex v = add_vertex(*g);
+            (*g)[v].char_reach = c;
+            add_edge(u, v, *g);
+            u = v;
+        }
+        (*g)[u].reports.insert(lit_report);
+        add_edge(u, accept, *g);
+
+        if (dec.eod_lf) {
+            NFAVertex v = add_vertex(*g);
+            (*g)[v].char_reach = CharReach('\n');
+            (*g)[v].reports.insert(lf_report);
+            add_edge(u, v, *g);
+            add_edge(v, accept, *g);
+        }
+    }
+
+    return g;
+}
+
+bool NG::addLiterals(const vector<ue2_literal> &lits, u32 expr_index,
+                     u32 external_report, bool highlander, som_type som,
+                     const LiteralDecoration &dec) {
+    assert(!lits.empty());
 
     if (!cc.grey.shortcutLiterals) {
         return false;
@@ -565,8 +901,34 @@ bool NG::addLiteral(const ue2_literal &literal, u32 expr_index,
     // We can't natively handle arbitrary literals with mixed case sensitivity
     // in Rose -- they require mechanisms like benefits masks, which have
     // length limits etc. Better to let those go through full graph processing.
-    if (mixed_sensitivity(literal)) {
-        DEBUG_PRINTF("mixed sensitivity\n");
+    for (const auto &lit : lits) {
+        assert(!lit.empty());
+        assert(lit.length() == lits.front().length());
+        if (mixed_sensitivity(lit)) {
+            DEBUG_PRINTF("mixed sensitivity\n");
+            return false;
+        }
+    }
+
+    const size_t len = lits.front().length();
+
+    // Every match is exactly len bytes long, so min_length either always
+    // holds or never does; the latter is left to the graph path.
+    if (dec.min_length > len || dec.max_offset < len) {
+        DEBUG_PRINTF("bounds can never be satisfied\n");
+        return false;
+    }
+
+    // An anchored literal only matches at offset len.
+    if (dec.anchored && dec.min_offset > len) {
+        DEBUG_PRINTF("anchored literal outside bounds\n");
+        return false;
+    }
+
+    // The report raised after a trailing newline is adjusted back by one
+    // byte, which the SOM distance does not account for.
+    if (dec.eod_lf && som) {
+        DEBUG_PRINTF("no SOM for literals before an optional newline\n");
         return false;
     }
 
@@ -574,28 +936,64 @@ bool NG::addLiteral(const ue2_literal &literal, u32 expr_index,
     rm.registerExtReport(external_report,
                          external_report_info(highlander, expr_index));
 
-    ReportID id;
+    const u32 ekey = highlander ? rm.getExhaustibleKey(external_report)
+                                : INVALID_EKEY;
+    auto make_report = [&](s32 adjust) {
+        Report r = som ? makeSomRelativeCallback(external_report, adjust, len)
+                       : makeECallback(external_report, adjust, ekey);
+        // Bounds are checked against the unadjusted match offset.
+        if (!dec.anchored) {
+            r.minOffset = dec.min_offset ? dec.min_offset - adjust : 0;
+            r.maxOffset = dec.max_offset == MAX_OFFSET
+                              ? MAX_OFFSET : dec.max_offset - adjust;
+        }
+        return rm.getInternalId(r);
+    };
+
+    assert(!som || !highlander); // not allowed, checked earlier.
     if (som) {
-        assert(!highlander); // not allowed, checked earlier.
-        Report r = makeSomRelativeCallback(external_report, 0, literal.length());
-        id = rm.getInternalId(r);
         rose->setSom();
-    } else {
-        u32 ekey = highlander ? rm.getExhaustibleKey(external_report)
-                              : INVALID_EKEY;
-        Report r = makeECallback(external_report, 0, ekey);
-        id = rm.getInternalId(r);
     }
 
-    DEBUG_PRINTF("success: graph is literal '%s', report ID %u\n",
-                 dumpString(literal).c_str(), id);
+    const ReportID id = make_report(0);
+    const ReportID lf_id = dec.eod_lf ? make_report(-1) : id;
 
-    rose->add(false, false, literal, {id});
+    for (const auto &lit : lits) {
+        DEBUG_PRINTF("success: graph is literal '%s', report ID %u\n",
+                     dumpString(lit).c_str(), id);
+        rose->add(dec.anchored, dec.eod || dec.eod_lf, lit, {id});
 
-    minWidth = min(minWidth, depth(literal.length()));
+        if (dec.eod_lf) {
+            ue2_literal lit_lf = lit;
+            lit_lf.push_back('\n', false);
+            rose->add(dec.anchored, true, lit_lf, {lf_id});
+        }
+    }
 
-    /* inform small write handler about this literal */
-    smwr->add(literal, id);
+    const bool bounded = dec.min_offset || dec.max_offset != MAX_OFFSET ||
+                         dec.min_length;
+    minWidth = min(minWidth, depth(len));
+    maxWidth = highlander || bounded
+                   ? depth::infinity()
+                   : max(maxWidth, depth(dec.eod_lf ? len + 1 : len));
+    if (dec.max_offset != MAX_OFFSET) {
+        maxOffset = max(maxOffset, dec.max_offset);
+    } else if (dec.anchored) {
+        maxOffset = max(maxOffset, (u64a)(dec.eod_lf ? len + 1 : len));
+    } else {
+        maxOffset = MAX_OFFSET;
+    }
+
+    /* inform small write handler about these literals */
+    if (dec.plain()) {
+        for (const auto &lit : lits) {
+            smwr->add(lit, id);
+        }
+    } else {
+        auto g = buildDecoratedWrapper(lits, expr_index, highlander, som,
+                                       external_report, dec, id, lf_id);
+        smwr->add(*g);
+    }
 
     return true;
 }
@@ -80,6 +80,24 @@ public:
     u64a min_offset; /**< extparam min_offset value */
     u64a max_offset; /**< extparam max_offset value */
     u64a min_length; /**< extparam min_length value */
+    u32 prefilter_states = 0; /**< extparam prefilter_states value, or 0 */
+};
+
+/** \brief Anchoring and offset bounds shared by the literals of one
+ * expression added by \ref NG::addLiterals. */
+struct LiteralDecoration {
+    bool anchored = false; //!< literal starts at offset zero (^ or \A)
+    bool eod = false;      //!< literal ends at end of data (\z)
+    bool eod_lf = false;   //!< ends at end of data or before a final \\n ($)
+    u64a min_offset = 0;          //!< extparam min_offset value
+    u64a max_offset = MAX_OFFSET; //!< extparam max_offset value
+    u64a min_length = 0;          //!< extparam min_length value
+
+    /** \brief True if this is a plain floating literal. */
+    bool plain() const {
+        return !anchored && !eod && !eod_lf && !min_offset &&
+               max_offset == MAX_OFFSET && !min_length;
+    }
 };
 
 class RoseBuild;
@@ -95,6 +113,15 @@ public:
      * exception if the graph cannot be consumed. */
     bool addGraph(NGWrapper &w);
 
+    /** \brief Consumes a pattern like \ref addGraph, but may hold it back so
+     * that later expressions with an identical graph can share its roles
+     * and engines. Held graphs are added by \ref flushSharedGraphs, which
+     * throws a CompileError naming the expression on failure. */
+    void addSharedGraph(std::unique_ptr<NGWrapper> w);
+
+    /** \brief Adds all graphs held back by \ref addSharedGraph. */
+    void flushSharedGraphs();
+
     /** \brief Consumes a graph, cut-down version of addGraph for use by SOM
      * processing. */
     bool addHolder(NGHolder &h);
@@ -104,6 +131,13 @@ public:
     bool addLiteral(const ue2_literal &lit, u32 expr_index, u32 external_report,
                     bool highlander, som_type som);
 
+    /** \brief Adds literals that together make up one expression to Rose,
+     * with the anchoring and bounds given by \a dec. Returns false without
+     * adding anything if they cannot all be added. */
+    bool addLiterals(const std::vector<ue2_literal> &lits, u32 expr_index,
+                     u32 external_report, bool highlander, som_type som,
+                     const LiteralDecoration &dec);
+
     /** \brief Maximum history in bytes available for use by SOM reverse NFAs,
      * a hack for pattern support (see UE-1903). This is always set to the max
      * "lookbehind" length. */
@@ -114,13 +148,38 @@ public:
      * patterns, which give an effective minWidth of zero). */
     depth minWidth;
 
+    /** \brief The length of the longest match of any pattern contained in the
+     * NG, or infinity if some pattern is unbounded or can only be matched
+     * with knowledge of absolute offsets (extended parameters, single match
+     * mode). */
+    depth maxWidth;
+
+    /** \brief The largest end offset of any match of any pattern contained in
+     * the NG, or MAX_OFFSET if some pattern can match arbitrarily far into
+     * the data. Only patterns with a max_offset or that are anchored with a
+     * bounded width give a finite bound. */
+    u64a maxOffset;
+
     ReportManager rm;
     SomSlotManager ssm;
     BoundaryReports boundary;
     const CompileContext cc;
 
+    /** \brief Number of threads \ref addGraph may use to run the graph
+     * reduction passes on independent components. The result does not
+     * depend on this. */
+    unsigned compileThreads;
+
     const std::unique_ptr<SmallWriteBuild> smwr; //!< SmallWrite builder.
     const std::unique_ptr<RoseBuild> rose; //!< Rose builder.
+
+private:
+    /** \brief Graphs held back by \ref addSharedGraph, in expression
+     * order. */
+    std::vector<std::unique_ptr<NGWrapper>> shared_graphs;
+
+    /** \brief Indices into shared_graphs, keyed by graph hash. */
+    ue2::unordered_map<u64a, std::vector<size_t>> shared_graph_index;
 };
 
 /** \brief Run graph reduction passes.
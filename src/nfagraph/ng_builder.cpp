@@ -114,6 +114,7 @@ NFABuilderImpl::NFABuilderImpl(ReportManager &rm_in, const Grey &grey_in,
           expr.index, expr.highlander, expr.utf8, expr.prefilter, expr.som,
           expr.id, expr.min_offset, expr.max_offset, expr.min_length)),
       vertIdx(N_SPECIALS) {
+    graph->prefilter_states = expr.prefilter_states;
 
     // Reserve space for a reasonably-sized NFA
     id2vertex.reserve(64);
@@ -38,17 +38,26 @@
 #include "ng_depth.h"
 #include "ng_edge_redundancy.h"
 #include "ng_holder.h"
+#include "ng_limex.h"
+#include "ng_literal_analysis.h"
+#include "ng_mcclellan.h"
+#include "ng_netflow.h"
+#include "ng_repeat.h"
 #include "ng_reports.h"
 #include "ng_util.h"
 #include "ue2common.h"
+#include "grey.h"
+#include "nfa/rdfa.h"
 #include "parser/position.h" // for POS flags
 #include "util/boundary_reports.h"
 #include "util/compile_context.h"
+#include "util/container.h"
 #include "util/depth.h"
 #include "util/graph.h"
 #include "util/graph_range.h"
 #include "util/report_manager.h"
 
+#include <algorithm>
 #include <limits.h>
 #include <set>
 
@@ -175,4 +184,124 @@ void fillExpressionInfo(ReportManager &rm, NGWrapper &w, hs_expr_info *info) {
     info->matches_only_at_eod = can_only_match_at_eod(w);
 }
 
+/** \brief Literals at least this long give a pattern a low cost class. */
+static const size_t COST_LOW_MIN_LITERAL_LEN = 4;
+
+/** \brief Literals at least this long give a pattern a medium cost class;
+ * anything shorter is treated as having no usable literal. */
+static const size_t COST_MEDIUM_MIN_LITERAL_LEN = 2;
+
+/** \brief Estimated stream state for each bounded repeat: the offset of its
+ * last top. */
+static const u32 REPEAT_STATE_ESTIMATE = sizeof(u64a);
+
+/**
+ * \brief Find the literal factor that Rose would scan for, using the same
+ * min-cut over literal scores as its graph decomposition. Returns an empty set
+ * if no cut has a literal on every edge.
+ */
+static
+set<ue2_literal> findLiteralFactor(NGHolder &h, const Grey &grey) {
+    if (num_edges(h) > grey.maxRoseNetflowEdges) {
+        DEBUG_PRINTF("too many edges for netflow\n");
+        return {};
+    }
+
+    h.renumberVertices();
+    h.renumberEdges();
+    vector<u64a> scores = scoreEdges(h);
+    vector<NFAEdge> cut = findMinCut(h, scores);
+
+    set<ue2_literal> lits;
+    for (const auto &e : cut) {
+        if (scores[h[e].index] >= NO_LITERAL_AT_EDGE_SCORE) {
+            DEBUG_PRINTF("cut edge has no literal\n");
+            return {};
+        }
+        set<ue2_literal> edge_lits = getLiteralSet(h, e);
+        compressAndScore(edge_lits);
+        insert(&lits, edge_lits);
+    }
+    return lits;
+}
+
+void fillExpressionCostInfo(const ReportManager &rm, const CompileContext &cc,
+                            const NGWrapper &w, ExpressionCostInfo *info) {
+    assert(info);
+
+    NGHolder h;
+    cloneHolder(h, w);
+    reduceGraph(h, SOM_NONE, w.utf8, cc);
+
+    set<ue2_literal> lits = findLiteralFactor(h, cc.grey);
+    size_t min_lit_len = 0;
+    size_t max_lit_len = 0;
+    if (!lits.empty()) {
+        info->engines |= HS_EXPR_ENGINE_LITERAL;
+        min_lit_len = SIZE_MAX;
+        for (const auto &lit : lits) {
+            info->literals.push_back(lit.get_string());
+            min_lit_len = min(min_lit_len, lit.length());
+            max_lit_len = max(max_lit_len, lit.length());
+        }
+    }
+
+    bool pure_literal =
+        lits.size() == 1 && literalIsWholeGraph(h, *lits.begin());
+    u32 engine_state = 0;
+
+    PureRepeat repeat;
+    if (pure_literal) {
+        DEBUG_PRINTF("pure literal\n");
+    } else if (cc.grey.allowLbr && isPureRepeat(h, repeat)) {
+        DEBUG_PRINTF("pure repeat %s\n", repeat.bounds.str().c_str());
+        info->engines |= HS_EXPR_ENGINE_LBR;
+        engine_state = REPEAT_STATE_ESTIMATE;
+    } else {
+        if (cc.grey.allowCastle) {
+            vector<GraphRepeatInfo> repeats;
+            findRepeats(h, cc.grey.minExtBoundedRepeatSize, &repeats);
+            if (!repeats.empty()) {
+                info->engines |= HS_EXPR_ENGINE_CASTLE;
+                engine_state += verify_u32(repeats.size())
+                                * REPEAT_STATE_ESTIMATE;
+            }
+        }
+
+        u32 nfa_state_bytes = 0;
+        if (isImplementableNFA(h, &rm, cc)) {
+            info->engines |= HS_EXPR_ENGINE_LIMEX;
+            info->nfa_states = verify_u32(num_vertices(h) - N_SPECIALS);
+            nfa_state_bytes = ROUNDUP_N(info->nfa_states, 8) / 8;
+        }
+
+        u32 dfa_state_bytes = 0;
+        if (cc.grey.allowMcClellan) {
+            auto rdfa = buildMcClellan(h, &rm, cc.grey);
+            if (rdfa) {
+                info->engines |= HS_EXPR_ENGINE_DFA;
+                info->dfa_states = verify_u32(rdfa->states.size());
+                dfa_state_bytes = info->dfa_states <= 256 ? 1 : 2;
+            }
+        }
+
+        // The compiler prefers a DFA where it can build one.
+        engine_state += dfa_state_bytes ? dfa_state_bytes : nfa_state_bytes;
+    }
+
+    if (cc.streaming) {
+        // Literals that straddle stream writes need history to confirm.
+        u32 history = max_lit_len ? verify_u32(max_lit_len - 1) : 0;
+        info->stream_state_size = engine_state + history;
+    }
+
+    if (pure_literal || min_lit_len >= COST_LOW_MIN_LITERAL_LEN) {
+        info->cost_class = HS_EXPR_COST_LOW;
+    } else if (min_lit_len >= COST_MEDIUM_MIN_LITERAL_LEN) {
+        info->cost_class = HS_EXPR_COST_MEDIUM;
+    } else {
+        info->cost_class = HS_EXPR_COST_HIGH;
+    }
+}
+
 } // namespace ue2
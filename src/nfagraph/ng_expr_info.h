@@ -38,13 +38,34 @@ struct hs_expr_info;
 
 #include "ue2common.h"
 
+#include <string>
+#include <vector>
+
 namespace ue2 {
 
 class NGWrapper;
 class ReportManager;
+struct CompileContext;
 
 void fillExpressionInfo(ReportManager &rm, NGWrapper &w, hs_expr_info *info);
 
+/** \brief Compile-time cost estimates for an expression, used by
+ * hs_expression_cost_info. */
+struct ExpressionCostInfo {
+    u32 engines = 0; //!< HS_EXPR_ENGINE_* bits
+    u32 nfa_states = 0;
+    u32 dfa_states = 0;
+    u32 stream_state_size = 0;
+    u32 cost_class = 0; //!< an HS_EXPR_COST_* value
+    std::vector<std::string> literals;
+};
+
+/** \brief Estimate the engines, literals, stream state and scan cost for an
+ * expression. Must be called after \ref fillExpressionInfo, which resolves
+ * the graph's assertions. */
+void fillExpressionCostInfo(const ReportManager &rm, const CompileContext &cc,
+                            const NGWrapper &w, ExpressionCostInfo *info);
+
 } // namespace ue2
 
 #endif // NG_EXPR_INFO_H
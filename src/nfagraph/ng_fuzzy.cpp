@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Graph transformation for approximate matching.
+ *
+ * The graph is built in levels: level d holds a copy of each vertex, and a
+ * state on at level d has matched the data so far with d edits. At each level
+ * after the first, every vertex v gains two companions that are entered by an
+ * edit rather than by a match:
+ *
+ *  - a substitution vertex, entered from v's predecessors one level down on
+ *    any byte outside v's reach;
+ *  - an insertion vertex, entered from v one level down on any byte.
+ *
+ * Both have the same successors as v's copy at their level. A deletion skips
+ * a vertex without consuming a byte, so it is folded into the edges: a state
+ * at level d also has the out-edges that the vertex it skips has at level
+ * d + 1. The start vertex gets insertion vertices too, so that anchored
+ * patterns tolerate bytes inserted in front of them.
+ *
+ * Substituting a byte that the vertex accepts anyway gains nothing over a
+ * match, so substitution vertices take only the complement of the reach, which
+ * keeps fewer states on at once.
+ */
+#include "ng_fuzzy.h"
+
+#include "grey.h"
+#include "ng_holder.h"
+#include "ng_util.h"
+#include "ng_width.h"
+#include "ue2common.h"
+#include "parser/position.h"
+#include "util/compile_error.h"
+#include "util/container.h"
+#include "util/depth.h"
+#include "util/graph_range.h"
+#include "util/ue2_containers.h"
+
+#include <map>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace ue2 {
+
+void validate_fuzzy_compile(const NGHolder &g, u32 distance, bool hamming,
+                            bool utf8, const Grey &grey) {
+    if (!distance) {
+        return;
+    }
+    if (!grey.allowApproximateMatching) {
+        throw CompileError("Approximate matching is disabled.");
+    }
+    if (distance > grey.maxEditDistance) {
+        ostringstream err;
+        err << "In hs_expr_ext, "
+            << (hamming ? "hamming_distance" : "edit_distance")
+            << " must not exceed " << grey.maxEditDistance << ".";
+        throw CompileError(err.str());
+    }
+    if (utf8) {
+        throw CompileError("UTF-8 is disallowed for approximate matching.");
+    }
+
+    // End-of-data anchors are fine; all other assertions would have to be
+    // re-evaluated against edited data, which we cannot do.
+    for (const auto &e : edges_range(g)) {
+        if (g[e].assert_flags) {
+            throw CompileError("Zero-width assertions are disallowed for "
+                               "approximate matching.");
+        }
+    }
+    for (auto v : vertices_range(g)) {
+        if (g[v].assert_flags & ~POS_FLAG_FIDDLE_ACCEPT) {
+            throw CompileError("Zero-width assertions are disallowed for "
+                               "approximate matching.");
+        }
+    }
+
+    // With deletions, a pattern no wider than the distance would match
+    // everywhere.
+    if (!hamming && findMinWidth(g) <= depth(distance)) {
+        throw CompileError("Approximate matching patterns that reduce to "
+                           "vacuous patterns are disallowed.");
+    }
+}
+
+namespace {
+
+/** \brief Targets of the out-edges of a state at some level, by vertex index,
+ * and the reports that it raises if they include an accept. */
+struct FuzzEdges {
+    flat_set<u32> targets;
+    flat_set<ReportID> reports;
+};
+
+class GraphFuzzer {
+public:
+    GraphFuzzer(NGHolder &g_in, u32 distance_in, bool hamming_in);
+
+    /** \brief Number of vertices that \ref fuzz will add. */
+    size_t newVertexCount() const;
+
+    void fuzz();
+
+private:
+    /** \brief Vertices for the end-of-data newline, which are shared by all
+     * levels: an edit there would change what the anchor means. */
+    bool isFixed(NFAVertex v) const {
+        return g[v].assert_flags & POS_FLAG_FIDDLE_ACCEPT;
+    }
+
+    void addVertices();
+    vector<NFAVertex> statesAt(NFAVertex u, u32 d) const;
+    const FuzzEdges &edgesFrom(NFAVertex u, u32 d);
+
+    NGHolder &g;
+    const u32 distance;
+    const bool hamming;
+
+    /** \brief Original vertices that get copies: all but the specials and
+     * those that can never be entered. */
+    vector<NFAVertex> verts;
+
+    /** \brief Original out-edge targets, by vertex index. */
+    vector<vector<NFAVertex>> succs;
+
+    /** \brief Original reports, by vertex index: fuzz() adds to them. */
+    vector<flat_set<ReportID>> reports;
+
+    /** \brief Copy, substitution and insertion vertices of each original
+     * vertex at each level, by vertex index. Entries that do not exist are
+     * null_vertex(); copies[i][0] is the original vertex. */
+    vector<vector<NFAVertex>> copies;
+    vector<vector<NFAVertex>> subs;
+    vector<vector<NFAVertex>> ins;
+
+    map<pair<u32, u32>, FuzzEdges> memo;
+};
+
+GraphFuzzer::GraphFuzzer(NGHolder &g_in, u32 distance_in, bool hamming_in)
+    : g(g_in), distance(distance_in), hamming(hamming_in) {
+    renumber_vertices(g);
+
+    const size_t num = num_vertices(g);
+    succs.resize(num);
+    reports.resize(num);
+    copies.resize(num);
+    subs.resize(num);
+    ins.resize(num);
+
+    for (auto v : vertices_range(g)) {
+        for (auto w : adjacent_vertices_range(v, g)) {
+            succs[g[v].index].push_back(w);
+        }
+        reports[g[v].index] = g[v].reports;
+        if (!is_special(v, g) && g[v].char_reach.any()) {
+            verts.push_back(v);
+        }
+    }
+}
+
+size_t GraphFuzzer::newVertexCount() const {
+    size_t per_level = hamming ? 2 : 3;
+    size_t count = verts.size() * per_level * distance;
+    if (!hamming) {
+        count += distance; // insertions at start
+    }
+    return count;
+}
+
+void GraphFuzzer::addVertices() {
+    const NFAVertex null = NGHolder::null_vertex();
+
+    for (auto v : verts) {
+        u32 i = g[v].index;
+        copies[i].assign(distance + 1, v);
+        if (isFixed(v)) {
+            continue;
+        }
+
+        const CharReach sub_cr = ~g[v].char_reach;
+        subs[i].assign(distance + 1, null);
+        ins[i].assign(distance + 1, null);
+
+        for (u32 d = 1; d <= distance; d++) {
+            NFAVertex c = clone_vertex(g, v);
+            g[c].reports.clear();
+            copies[i][d] = c;
+
+            if (sub_cr.any()) {
+                NFAVertex s = add_vertex(g);
+                g[s].char_reach = sub_cr;
+                subs[i][d] = s;
+            }
+
+            if (!hamming) {
+                NFAVertex n = add_vertex(g);
+                g[n].char_reach.setall();
+                ins[i][d] = n;
+            }
+        }
+    }
+
+    if (!hamming) {
+        u32 i = g[g.start].index;
+        ins[i].assign(distance + 1, null);
+        for (u32 d = 1; d <= distance; d++) {
+            NFAVertex n = add_vertex(g);
+            g[n].char_reach.setall();
+            ins[i][d] = n;
+        }
+    }
+}
+
+/** \brief The vertices that stand for original vertex \a u at level \a d. */
+vector<NFAVertex> GraphFuzzer::statesAt(NFAVertex u, u32 d) const {
+    const u32 i = g[u].index;
+    vector<NFAVertex> states;
+
+    if (u == g.start || u == g.startDs) {
+        if (!d) {
+            states.push_back(u);
+        } else if (u == g.start && !ins[i].empty()) {
+            states.push_back(ins[i][d]);
+        }
+        return states;
+    }
+
+    if (copies[i].empty()) {
+        return states;
+    }
+    if (!d || isFixed(u)) {
+        states.push_back(copies[i][d]);
+        return states;
+    }
+
+    states.push_back(copies[i][d]);
+    if (subs[i][d] != NGHolder::null_vertex()) {
+        states.push_back(subs[i][d]);
+    }
+    if (ins[i][d] != NGHolder::null_vertex()) {
+        states.push_back(ins[i][d]);
+    }
+    return states;
+}
+
+/** \brief Out-edges of every state standing for original vertex \a u at level
+ * \a d. */
+const FuzzEdges &GraphFuzzer::edgesFrom(NFAVertex u, u32 d) {
+    const u32 ui = g[u].index;
+    auto key = make_pair(ui, d);
+    auto it = memo.find(key);
+    if (it != memo.end()) {
+        return it->second;
+    }
+
+    FuzzEdges out;
+    for (auto w : succs[ui]) {
+        const u32 wi = g[w].index;
+        if (is_any_accept(w, g)) {
+            out.targets.insert(wi);
+            insert(&out.reports, reports[ui]);
+            continue;
+        }
+        if (w == g.start || w == g.startDs) {
+            if (!d) {
+                out.targets.insert(wi);
+            }
+            continue;
+        }
+        if (copies[wi].empty()) {
+            continue;
+        }
+
+        out.targets.insert(g[copies[wi][d]].index);
+        if (isFixed(w) || d == distance) {
+            continue;
+        }
+        if (subs[wi][d + 1] != NGHolder::null_vertex()) {
+            out.targets.insert(g[subs[wi][d + 1]].index);
+        }
+        if (!hamming) {
+            // Delete w: go wherever it goes, one level up. Map references
+            // stay valid across the recursive insertions.
+            const FuzzEdges &skip = edgesFrom(w, d + 1);
+            insert(&out.targets, skip.targets);
+            insert(&out.reports, skip.reports);
+        }
+    }
+
+    if (!hamming && d < distance && !ins[ui].empty()) {
+        out.targets.insert(g[ins[ui][d + 1]].index);
+    }
+
+    return memo.emplace(key, move(out)).first->second;
+}
+
+void GraphFuzzer::fuzz() {
+    addVertices();
+
+    vector<NFAVertex> by_index(num_vertices(g));
+    for (auto v : vertices_range(g)) {
+        by_index[g[v].index] = v;
+    }
+
+    vector<NFAVertex> sources = {g.start, g.startDs};
+    sources.insert(sources.end(), verts.begin(), verts.end());
+
+    for (auto u : sources) {
+        for (u32 d = 0; d <= distance; d++) {
+            if (d && isFixed(u)) {
+                break; // shared by all levels, wired at level 0
+            }
+            const FuzzEdges &fe = edgesFrom(u, d);
+            for (auto v : statesAt(u, d)) {
+                for (u32 t : fe.targets) {
+                    NFAVertex w = by_index[t];
+                    if (!edge(v, w, g).second) {
+                        add_edge(v, w, g);
+                    }
+                }
+                insert(&g[v].reports, fe.reports);
+            }
+        }
+    }
+}
+
+} // namespace
+
+void make_fuzzy(NGHolder &g, u32 distance, bool hamming, const Grey &grey) {
+    if (!distance) {
+        return;
+    }
+
+    GraphFuzzer fuzzer(g, distance, hamming);
+    if (num_vertices(g) + fuzzer.newVertexCount() >
+        grey.limitApproxMatchingVertices) {
+        DEBUG_PRINTF("too many vertices for approximate matching\n");
+        throw ResourceLimitError();
+    }
+
+    fuzzer.fuzz();
+    renumber_edges(g);
+}
+
+} // namespace ue2
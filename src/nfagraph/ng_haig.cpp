@@ -237,7 +237,8 @@ public:
 
 struct Big_Traits {
     using StateSet = dynamic_bitset<>;
-    using StateMap = map<StateSet, dstate_id_t>;
+    using StateMap = ue2::unordered_map<StateSet, dstate_id_t,
+                                        DynamicBitsetHasher>;
 
     static StateSet init_states(u32 num) {
         return StateSet(num);
@@ -77,6 +77,17 @@ private:
     ReportID a_rep;
     ReportID b_rep;
 };
+
+struct func_check_report : public check_report {
+    explicit func_check_report(const report_equiv_fn &f_in) : f(f_in) {}
+
+    bool operator()(const flat_set<ReportID> &reports_a,
+                    const flat_set<ReportID> &reports_b) const override {
+        return f(reports_a, reports_b);
+    }
+private:
+    const report_equiv_fn &f;
+};
 }
 
 static
@@ -212,4 +223,10 @@ bool is_equal(const NGHolder &a, ReportID a_rep,
     return is_equal_i(a, b, equiv_check_report(a_rep, b_rep));
 }
 
+bool is_equal(const NGHolder &a, const NGHolder &b,
+              const report_equiv_fn &reports_equal) {
+    DEBUG_PRINTF("testing %p %p\n", &a, &b);
+    return is_equal_i(a, b, func_check_report(reports_equal));
+}
+
 } // namespace ue2
@@ -37,7 +37,9 @@
 #define NG_IS_EQUAL_H
 
 #include "ue2common.h"
+#include "util/ue2_containers.h"
 
+#include <functional>
 #include <memory>
 #include <boost/core/noncopyable.hpp>
 
@@ -48,6 +50,15 @@ class NGHolder;
 bool is_equal(const NGHolder &a, const NGHolder &b);
 bool is_equal(const NGHolder &a, ReportID a_r, const NGHolder &b, ReportID b_r);
 
+/** \brief Predicate deciding whether two vertices' report sets correspond. */
+using report_equiv_fn = std::function<bool(const flat_set<ReportID> &,
+                                           const flat_set<ReportID> &)>;
+
+/** \brief As is_equal, but vertex reports are compared with \a
+ * reports_equal. */
+bool is_equal(const NGHolder &a, const NGHolder &b,
+              const report_equiv_fn &reports_equal);
+
 u64a hash_holder(const NGHolder &g);
 
 // Util Functors
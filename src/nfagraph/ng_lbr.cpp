@@ -91,6 +91,7 @@ void fillNfa(NFA *nfa, lbr_common *c, ReportID report, const depth &repeatMin,
     const u32 info_offset = sizeof(LbrStruct);
     c->repeatInfoOffset = info_offset;
     c->report = report;
+    c->escapeClass = LBR_NO_ESCAPE_CLASS; // assigned by Rose, if at all
 
     RepeatInfo *info = (RepeatInfo *)((char *)c + info_offset);
     info->type = verify_u8(rtype);
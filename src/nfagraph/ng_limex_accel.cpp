@@ -545,6 +545,43 @@ DAccelScheme findBestDoubleAccelScheme(vector<vector<CharReach> > paths,
 
 #define MAX_EXPLORE_PATHS 40
 
+/** \brief Most escape paths we will turn into literals for a literal scheme;
+ * beyond this they would be merged into something too broad anyway. */
+#define MAX_LITERAL_PATHS 16
+
+/**
+ * Turns the escape paths from a set of accel states into stop literals: the
+ * terminating bytes on their own, and each path that can leave the states.
+ * Paths end where the analysis stopped following them, so a path occurring in
+ * full is the only way out along it. Paths through an empty class lead back
+ * into the accel states and need no stop.
+ */
+static
+vector<vector<CharReach>> findEscapeLiterals(
+        const vector<vector<CharReach>> &paths, const CharReach &terminating) {
+    vector<vector<CharReach>> rv;
+    if (terminating.any()) {
+        rv.push_back({terminating});
+    }
+    for (const auto &p : paths) {
+        if (p.empty()) {
+            return {}; /* escapes without reading anything */
+        }
+        if (any_of(p.begin(), p.end(),
+                   [](const CharReach &cr) { return cr.none(); })) {
+            continue;
+        }
+        rv.push_back(p);
+    }
+
+    sort(rv.begin(), rv.end());
+    rv.erase(unique(rv.begin(), rv.end()), rv.end());
+    if (rv.size() > MAX_LITERAL_PATHS) {
+        return {};
+    }
+    return rv;
+}
+
 AccelScheme findBestAccelScheme(vector<vector<CharReach> > paths,
                                 const CharReach &terminating,
                                 bool look_for_double_byte) {
@@ -648,8 +685,11 @@ AccelScheme nfaFindAccel(const NGHolder &g, const vector<NFAVertex> &verts,
         reverse(it->begin(), it->end());
     }
 
-    return findBestAccelScheme(std::move(paths), terminating,
-                               look_for_double_byte);
+    auto literals = findEscapeLiterals(paths, terminating);
+    AccelScheme rv = findBestAccelScheme(std::move(paths), terminating,
+                                         look_for_double_byte);
+    rv.literals = move(literals);
+    return rv;
 }
 
 NFAVertex get_sds_or_proxy(const NGHolder &g) {
@@ -36,6 +36,7 @@
 #include "ng_util.h"
 #include "ue2common.h"
 #include "rose/rose_common.h"
+#include "util/byte_freq.h"
 #include "util/compare.h"
 #include "util/depth.h"
 #include "util/graph.h"
@@ -43,6 +44,7 @@
 #include "util/ue2string.h"
 
 #include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <queue>
 
@@ -59,6 +61,11 @@ static const u32 MAX_WIDTH = 11;
 /** Scoring adjustment for 'uniqueness' in literal. */
 static const u64a WEIGHT_OF_UNIQUENESS = 250;
 
+/** Most significant bits credited to one character of a literal when scoring
+ * with a byte frequency model, so that a single byte that is missing from the
+ * sample cannot outweigh a longer literal. */
+static const double MAX_BITS_PER_CHAR = 16.0;
+
 namespace {
 
 /* Small literal graph type used for the suffix tree used in
@@ -362,14 +369,61 @@ u64a litCountBits(const ue2_literal &lit) {
     return n;
 }
 
+/** Count the significant bits of this literal under the given byte frequency
+ * model, i.e. -log2 of the probability of the literal appearing at a given
+ * position in the traffic. With all byte values equally likely, this is the
+ * same as litCountBits(). */
+static
+u64a litCountBits(const ue2_literal &lit, const ByteFrequencies &freq) {
+    // Forward pass over the (at most two) byte values at each position,
+    // renormalising as we go so that long literals do not underflow.
+    u8 vals[2], prev_vals[2];
+    double p[2], prev_p[2];
+    u32 n = 0, prev_n = 0;
+    double bits = 0;
+
+    for (const auto &c : lit) {
+        u8 ch = (u8)c.c;
+        n = 0;
+        vals[n++] = ch;
+        if (c.nocase && ourisalpha(c.c)) {
+            vals[0] = (u8)mytolower(c.c);
+            vals[n++] = (u8)mytoupper(c.c);
+        }
+
+        double total = 0;
+        for (u32 i = 0; i < n; i++) {
+            if (!prev_n) {
+                p[i] = freq.prob[vals[i]];
+            } else {
+                p[i] = 0;
+                for (u32 j = 0; j < prev_n; j++) {
+                    p[i] += prev_p[j] * freq.probAfter(prev_vals[j], vals[i]);
+                }
+            }
+            total += p[i];
+        }
+
+        assert(total > 0);
+        bits += min(-log2(total), MAX_BITS_PER_CHAR);
+        for (u32 i = 0; i < n; i++) {
+            prev_vals[i] = vals[i];
+            prev_p[i] = p[i] / total;
+        }
+        prev_n = n;
+    }
+
+    return max((u64a)llround(bits), u64a{1});
+}
+
 /** Returns a fairly arbitrary score for the given literal, used to compare the
  * suitability of different candidates. */
 static
-u64a scoreLiteral(const ue2_literal &s) {
+u64a scoreLiteral(const ue2_literal &s, const ByteFrequencies *freq) {
     // old scoring scheme: SUM(s in S: 1/s.len()^2)
     // now weight (currently 75/25) with number of unique chars
     // in the string
-    u64a len = litCountBits(s);
+    u64a len = freq ? litCountBits(s, *freq) : litCountBits(s);
     u64a lenUnique = litUniqueness(s.get_string()) * 8;
 
     u64a weightedLen = (1000ULL - WEIGHT_OF_UNIQUENESS) * len +
@@ -390,12 +444,12 @@ u64a scoreLiteral(const ue2_literal &s) {
  * - score of any literal should be non-zero.
  */
 static
-u64a calculateScore(const ue2_literal &s) {
+u64a calculateScore(const ue2_literal &s, const ByteFrequencies *freq) {
     if (s.empty()) {
         return NO_LITERAL_AT_EDGE_SCORE;
     }
 
-    u64a weightedLen = scoreLiteral(s);
+    u64a weightedLen = scoreLiteral(s, freq);
 
     DEBUG_PRINTF("len %zu, wl %llu\n", s.length(), weightedLen);
     u64a rv = 1000000000000000ULL/(weightedLen * weightedLen * weightedLen);
@@ -410,7 +464,8 @@ u64a calculateScore(const ue2_literal &s) {
 /** Adds a literal in reverse order, building up a suffix tree. */
 static
 void addReversedLiteral(const ue2_literal &lit, LitGraph &lg,
-                        const LitVertex &root, const LitVertex &sink) {
+                        const LitVertex &root, const LitVertex &sink,
+                        const ByteFrequencies *freq) {
     DEBUG_PRINTF("literal: '%s'\n", escapeString(lit).c_str());
     ue2_literal suffix;
     LitVertex v = root;
@@ -424,7 +479,7 @@ void addReversedLiteral(const ue2_literal &lit, LitGraph &lg,
             }
         }
         w = add_vertex(LitGraphVertexProps(*it), lg);
-        add_edge(v, w, LitGraphEdgeProps(calculateScore(suffix)), lg);
+        add_edge(v, w, LitGraphEdgeProps(calculateScore(suffix, freq)), lg);
 next_char:
         v = w;
     }
@@ -594,16 +649,16 @@ void findMinCut(LitGraph &lg, const LitVertex &root, const LitVertex &sink,
  * score. Literals with a common suffix S will be replaced with S. (for
  * example, {foobar, fooobar} -> {oobar}).
  */
-u64a compressAndScore(set<ue2_literal> &s) {
+u64a compressAndScore(set<ue2_literal> &s, const ByteFrequencies *freq) {
     if (s.empty()) {
         return NO_LITERAL_AT_EDGE_SCORE;
     }
 
     if (s.size() == 1) {
-        return calculateScore(*s.begin());
+        return calculateScore(*s.begin(), freq);
     }
 
-    UNUSED u64a initialScore = scoreSet(s);
+    UNUSED u64a initialScore = scoreSet(s, freq);
     DEBUG_PRINTF("begin, initial literals have score %llu\n",
                   initialScore);
 
@@ -612,7 +667,7 @@ u64a compressAndScore(set<ue2_literal> &s) {
     const LitVertex sink = add_vertex(lg);
 
     for (const auto &lit : s) {
-        addReversedLiteral(lit, lg, root, sink);
+        addReversedLiteral(lit, lg, root, sink, freq);
     }
 
     DEBUG_PRINTF("suffix tree has %zu vertices and %zu edges\n",
@@ -624,7 +679,7 @@ u64a compressAndScore(set<ue2_literal> &s) {
     s.clear();
     extractLiterals(cutset, lg, root, s);
 
-    u64a score = scoreSet(s);
+    u64a score = scoreSet(s, freq);
     DEBUG_PRINTF("compressed score is %llu\n", score);
     assert(score <= initialScore);
     return score;
@@ -632,7 +687,8 @@ u64a compressAndScore(set<ue2_literal> &s) {
 
 /* like compressAndScore, but replaces long mixed sensitivity literals with
  * something weaker. */
-u64a sanitizeAndCompressAndScore(set<ue2_literal> &lits) {
+u64a sanitizeAndCompressAndScore(set<ue2_literal> &lits,
+                                 const ByteFrequencies *freq) {
     const size_t maxExploded = 8; // only case-explode this far
 
     /* TODO: the whole compression thing could be made better by systematically
@@ -669,10 +725,10 @@ u64a sanitizeAndCompressAndScore(set<ue2_literal> &lits) {
     }
 
     insert(&lits, replacements);
-    return compressAndScore(lits);
+    return compressAndScore(lits, freq);
 }
 
-u64a scoreSet(const set<ue2_literal> &s) {
+u64a scoreSet(const set<ue2_literal> &s, const ByteFrequencies *freq) {
     if (s.empty()) {
         return NO_LITERAL_AT_EDGE_SCORE;
     }
@@ -680,7 +736,7 @@ u64a scoreSet(const set<ue2_literal> &s) {
     u64a score = 1ULL;
 
     for (const auto &lit : s) {
-        score += calculateScore(lit);
+        score += calculateScore(lit, freq);
     }
 
     return score;
@@ -722,7 +778,8 @@ set<ue2_literal> getLiteralSet(const NGHolder &g, const NFAVertex &v,
     return s;
 }
 
-vector<u64a> scoreEdges(const NGHolder &g, const flat_set<NFAEdge> &known_bad) {
+vector<u64a> scoreEdges(const NGHolder &g, const flat_set<NFAEdge> &known_bad,
+                        const ByteFrequencies *freq) {
     assert(hasCorrectlyNumberedEdges(g));
 
     vector<u64a> scores(num_edges(g));
@@ -734,7 +791,7 @@ vector<u64a> scoreEdges(const NGHolder &g, const flat_set<NFAEdge> &known_bad) {
             scores[eidx] = NO_LITERAL_AT_EDGE_SCORE;
         } else {
             set<ue2_literal> ls = getLiteralSet(g, e);
-            scores[eidx] = compressAndScore(ls);
+            scores[eidx] = compressAndScore(ls, freq);
         }
     }
 
@@ -45,6 +45,7 @@ namespace ue2 {
 #define INVALID_EDGE_CAP         100000000ULL /* special-to-special score */
 
 class NGHolder;
+struct ByteFrequencies;
 
 /**
  * Fetch the literal set for a given vertex, returning it in \p s. Note: does
@@ -68,21 +69,29 @@ bool bad_mixed_sensitivity(const ue2_literal &s);
 
 /**
  * Score all the edges in the given graph, returning them in \p scores indexed
- * by edge_index. */
+ * by edge_index.
+ *
+ * The scoring functions take an optional byte frequency model of the traffic
+ * to be scanned, \p freq; with one, literals are scored by how rarely they
+ * are expected to occur rather than by their length alone. */
 std::vector<u64a> scoreEdges(const NGHolder &h,
-                             const flat_set<NFAEdge> &known_bad = {});
+                             const flat_set<NFAEdge> &known_bad = {},
+                             const ByteFrequencies *freq = nullptr);
 
 /** Returns a score for a literal set. Lower scores are better. */
-u64a scoreSet(const std::set<ue2_literal> &s);
+u64a scoreSet(const std::set<ue2_literal> &s,
+              const ByteFrequencies *freq = nullptr);
 
 /** Compress a literal set to fewer literals. */
-u64a compressAndScore(std::set<ue2_literal> &s);
+u64a compressAndScore(std::set<ue2_literal> &s,
+                      const ByteFrequencies *freq = nullptr);
 
 /**
  * Compress a literal set to fewer literals and replace any long mixed
  * sensitivity literals with supported literals.
  */
-u64a sanitizeAndCompressAndScore(std::set<ue2_literal> &s);
+u64a sanitizeAndCompressAndScore(std::set<ue2_literal> &s,
+                                 const ByteFrequencies *freq = nullptr);
 
 bool splitOffLeadingLiteral(const NGHolder &g, ue2_literal *lit_out,
                             NGHolder *rhs);
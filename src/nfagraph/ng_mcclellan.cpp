@@ -41,6 +41,7 @@
 #include "ng_util.h"
 #include "ue2common.h"
 #include "util/bitfield.h"
+#include "util/compile_report.h"
 #include "util/determinise.h"
 #include "util/graph_range.h"
 #include "util/make_unique.h"
@@ -467,7 +468,8 @@ public:
 
 struct Big_Traits {
     using StateSet = dynamic_bitset<>;
-    using StateMap = map<StateSet, dstate_id_t>;
+    using StateMap = ue2::unordered_map<StateSet, dstate_id_t,
+                                        DynamicBitsetHasher>;
 
     static StateSet init_states(u32 num) {
         return StateSet(num);
@@ -526,6 +528,7 @@ unique_ptr<raw_dfa> buildMcClellan(const NGHolder &graph,
         return nullptr;
     }
 
+    PhaseTimer timer(PHASE_DETERMINISE);
     auto unused = findUnusedStates(graph);
 
     DEBUG_PRINTF("attempting to build ?%d? mcclellan\n", (int)graph.kind);
@@ -42,6 +42,7 @@
 #include "util/ue2_containers.h"
 
 #include <boost/dynamic_bitset.hpp>
+#include <boost/functional/hash/hash.hpp>
 
 #include <map>
 #include <vector>
@@ -50,6 +51,18 @@ namespace ue2 {
 
 struct raw_dfa;
 
+/** \brief Hash for the dynamic_bitset state sets used by the "big"
+ * determinisation automata, which have too many NFA states for a bitfield. */
+struct DynamicBitsetHasher {
+    size_t operator()(const boost::dynamic_bitset<> &b) const {
+        size_t val = b.size();
+        for (size_t i = b.find_first(); i != b.npos; i = b.find_next(i)) {
+            boost::hash_combine(val, i);
+        }
+        return val;
+    }
+};
+
 /** Fills alpha, unalpha and returns alphabet size. */
 u16 buildAlphabetFromEquivSets(const std::vector<CharReach> &esets,
                                std::array<u16, ALPHABET_SIZE> &alpha,
@@ -39,138 +39,189 @@
 #include "util/graph_range.h"
 
 #include <algorithm>
-#include <boost/graph/boykov_kolmogorov_max_flow.hpp>
+#include <limits>
 
 using namespace std;
-using boost::default_color_type;
 
 namespace ue2 {
 
-static
-void addReverseEdge(const NGHolder &g, vector<NFAEdge> &reverseEdge,
-                    NFAEdge fwd, NFAEdge rev) {
-    u32 fwdIndex = g[fwd].index;
-    u32 revIndex = g[rev].index;
+NetflowGraph::NetflowGraph(const NGHolder &h_in) : h(h_in) {
+    assert(hasCorrectlyNumberedEdges(h));
+    assert(hasCorrectlyNumberedVertices(h));
+
+    // netflow relies on these stylised edges, as all starts should be covered
+    // by our source and all accepts by our sink.
+    assert(edge(h.start, h.startDs, h).second);
+    assert(edge(h.accept, h.acceptEod, h).second);
+
+    const size_t numVertices = num_vertices(h);
+    src = h[h.start].index;
+    sink = h[h.acceptEod].index;
 
-    // Make sure our vector is big enough.
-    size_t sz = max(fwdIndex, revIndex) + 1;
-    if (reverseEdge.size() < sz) {
-        reverseEdge.resize(sz);
+    // Each edge gives a forward arc out of its source and a residual arc out
+    // of its target. Self-loops can never carry flow, so they are left out.
+    first.assign(numVertices + 1, 0);
+    for (const auto &e : edges_range(h)) {
+        u32 u = h[source(e, h)].index;
+        u32 v = h[target(e, h)].index;
+        if (u != v) {
+            first[u + 1]++;
+            first[v + 1]++;
+        }
+    }
+    for (size_t i = 0; i < numVertices; i++) {
+        first[i + 1] += first[i];
     }
 
-    // Add entries to list.
-    reverseEdge[fwdIndex] = rev;
-    reverseEdge[revIndex] = fwd;
+    const u32 numArcs = first[numVertices];
+    head.resize(numArcs);
+    rev.resize(numArcs);
+    edgeIndex.resize(numArcs);
+    vector<u32> pos(first.begin(), first.end() - 1);
+    for (const auto &e : edges_range(h)) {
+        u32 u = h[source(e, h)].index;
+        u32 v = h[target(e, h)].index;
+        if (u == v) {
+            continue;
+        }
+        u32 fwd = pos[u]++;
+        u32 bwd = pos[v]++;
+        head[fwd] = v;
+        head[bwd] = u;
+        rev[fwd] = bwd;
+        rev[bwd] = fwd;
+        edgeIndex[fwd] = h[e].index;
+        edgeIndex[bwd] = NO_EDGE;
+    }
+
+    DEBUG_PRINTF("built flow network with %zu vertices, %u arcs\n",
+                 numVertices, numArcs);
 }
 
-/** Add temporary reverse edges to the graph \p g, as they are required by the
- * BGL's boykov_kolmogorov_max_flow algorithm. */
-static
-void addReverseEdges(NGHolder &g, vector<NFAEdge> &reverseEdge,
-                     vector<u64a> &capacityMap) {
-    // We're probably going to need space for 2x edge count.
-    const size_t numEdges = num_edges(g);
-    reverseEdge.reserve(numEdges * 2);
-    capacityMap.reserve(numEdges * 2);
-
-    // To avoid walking the graph for _ages_, we build a temporary map of all
-    // edges indexed by vertex pair for existence checks.
-    map<pair<size_t, size_t>, NFAEdge> allEdges;
-    for (const auto &e : edges_range(g)) {
-        NFAVertex u = source(e, g), v = target(e, g);
-        size_t uidx = g[u].index, vidx = g[v].index;
-        allEdges[make_pair(uidx, vidx)] = e;
+/** Breadth-first search from the source over arcs with residual capacity,
+ * labelling each vertex with its distance. Returns true if the sink is
+ * reachable. */
+bool NetflowGraph::buildLevels(const vector<u64a> &residual,
+                               vector<s32> &level) const {
+    fill(level.begin(), level.end(), -1);
+    vector<u32> queue;
+    queue.reserve(level.size());
+    level[src] = 0;
+    queue.push_back(src);
+    for (size_t i = 0; i < queue.size(); i++) {
+        u32 u = queue[i];
+        for (u32 a = first[u]; a < first[u + 1]; a++) {
+            u32 v = head[a];
+            if (residual[a] && level[v] < 0) {
+                level[v] = level[u] + 1;
+                queue.push_back(v);
+            }
+        }
     }
+    return level[sink] >= 0;
+}
 
-    // Now we walk over all edges and add their reverse edges to the reverseEdge
-    // vector, also adding them to the graph when they don't already exist.
-    for (const auto &m : allEdges) {
-        const NFAEdge &fwd = m.second;
-        const size_t uidx = m.first.first, vidx = m.first.second;
-
-        auto it = allEdges.find(make_pair(vidx, uidx));
-        if (it == allEdges.end()) {
-            // No reverse edge, add one.
-            NFAVertex u = source(fwd, g), v = target(fwd, g);
-            NFAEdge rev = add_edge(v, u, g).first;
-            it = allEdges.insert(make_pair(make_pair(vidx, uidx), rev)).first;
-            // Add to capacity map.
-            u32 revIndex = g[rev].index;
-            if (capacityMap.size() < revIndex + 1) {
-                capacityMap.resize(revIndex + 1);
+/** Saturates the level graph with augmenting paths, returning the flow added.
+ * The search is iterative as paths can be as long as the graph is deep. */
+u64a NetflowGraph::blockingFlow(vector<u64a> &residual, vector<s32> &level,
+                                vector<u32> &next) const {
+    u64a flow = 0;
+    vector<u32> path; // arcs from the source
+    u32 u = src;
+
+    while (true) {
+        if (u == sink) {
+            u64a bottleneck = numeric_limits<u64a>::max();
+            for (u32 a : path) {
+                bottleneck = min(bottleneck, residual[a]);
             }
-            capacityMap[revIndex] = 0;
+            size_t retreat = path.size();
+            for (size_t i = 0; i < path.size(); i++) {
+                u32 a = path[i];
+                residual[a] -= bottleneck;
+                residual[rev[a]] += bottleneck;
+                if (!residual[a] && retreat == path.size()) {
+                    retreat = i;
+                }
+            }
+            flow += bottleneck;
+            // Resume from the tail of the first saturated arc.
+            path.resize(retreat);
+            u = path.empty() ? src : head[path.back()];
+            continue;
+        }
+
+        u32 &a = next[u];
+        while (a < first[u + 1] &&
+               (!residual[a] || level[head[a]] != level[u] + 1)) {
+            a++;
+        }
+
+        if (a < first[u + 1]) {
+            path.push_back(a);
+            u = head[a];
+            continue;
         }
 
-        addReverseEdge(g, reverseEdge, fwd, it->second);
+        // Dead end: nothing more can pass through u in this phase.
+        level[u] = -1;
+        if (path.empty()) {
+            break;
+        }
+        u = head[rev[path.back()]];
+        path.pop_back();
+        next[u]++;
     }
-}
 
-/** Remove all edges with indices >= \p idx. */
-static
-void removeEdgesFromIndex(NGHolder &g, vector<u64a> &capacityMap, u32 idx) {
-    remove_edge_if([&](const NFAEdge &e) { return g[e].index >= idx; }, g);
-    capacityMap.resize(idx);
+    return flow;
 }
 
-/** A wrapper around boykov_kolmogorov_max_flow, returns the max flow and
- * colour map (from which we can find the min cut). */
-static
-u64a getMaxFlow(NGHolder &h, const vector<u64a> &capacityMap_in,
-                vector<default_color_type> &colorMap) {
-    vector<u64a> capacityMap = capacityMap_in;
-    NFAVertex src = h.start;
-    NFAVertex sink = h.acceptEod;
+/** Marks the vertices reachable from \p from in the residual graph, walking
+ * arcs forwards or (to find vertices that can reach the sink) backwards. */
+vector<bool> NetflowGraph::residualReach(const vector<u64a> &residual,
+                                         u32 from, bool forwards) const {
+    vector<bool> seen(first.size() - 1, false);
+    vector<u32> stack(1, from);
+    seen[from] = true;
+    while (!stack.empty()) {
+        u32 u = stack.back();
+        stack.pop_back();
+        for (u32 a = first[u]; a < first[u + 1]; a++) {
+            u32 v = head[a];
+            u64a cap = forwards ? residual[a] : residual[rev[a]];
+            if (cap && !seen[v]) {
+                seen[v] = true;
+                stack.push_back(v);
+            }
+        }
+    }
+    return seen;
+}
 
-    // netflow relies on these stylised edges, as all starts should be covered
-    // by our source and all accepts by our sink.
-    assert(edge(h.start, h.startDs, h).second);
-    assert(edge(h.accept, h.acceptEod, h).second);
+vector<NFAEdge> NetflowGraph::findMinCut(const vector<u64a> &scores) const {
+    assert(scores.size() >= num_edges(h));
 
-    // The boykov_kolmogorov_max_flow algorithm requires us to have reverse
-    // edges for all edges in the graph, so we create them here (and remove
-    // them after the call).
-    const unsigned int numRealEdges = num_edges(h);
-    vector<NFAEdge> reverseEdges;
-    addReverseEdges(h, reverseEdges, capacityMap);
-
-    const unsigned int numTotalEdges = num_edges(h);
-    const unsigned int numVertices = num_vertices(h);
-
-    vector<u64a> edgeResiduals(numTotalEdges);
-    vector<NFAEdge> predecessors(numVertices);
-    vector<s32> distances(numVertices);
-    assert(colorMap.size() == numVertices);
-
-    const NFAGraph &g = h.g;
-    auto v_index_map = get(&NFAGraphVertexProps::index, g);
-    auto e_index_map = get(&NFAGraphEdgeProps::index, g);
-
-    u64a flow = boykov_kolmogorov_max_flow(g,
-         make_iterator_property_map(capacityMap.begin(), e_index_map),
-         make_iterator_property_map(edgeResiduals.begin(), e_index_map),
-         make_iterator_property_map(reverseEdges.begin(), e_index_map),
-         make_iterator_property_map(predecessors.begin(), v_index_map),
-         make_iterator_property_map(colorMap.begin(), v_index_map),
-         make_iterator_property_map(distances.begin(), v_index_map),
-         v_index_map,
-         src, sink);
-
-    // Remove reverse edges from graph.
-    removeEdgesFromIndex(h, capacityMap, numRealEdges);
-    assert(num_edges(h.g) == numRealEdges);
+    vector<u64a> residual(head.size());
+    for (size_t a = 0; a < head.size(); a++) {
+        residual[a] = edgeIndex[a] == NO_EDGE ? 0 : scores[edgeIndex[a]];
+    }
 
+    // Dinic's algorithm: repeated blocking flows over BFS level graphs.
+    const size_t numVertices = first.size() - 1;
+    vector<s32> level(numVertices);
+    vector<u32> next(numVertices);
+    u64a flow = 0;
+    while (buildLevels(residual, level)) {
+        copy(first.begin(), first.end() - 1, next.begin());
+        flow += blockingFlow(residual, level, next);
+    }
     DEBUG_PRINTF("flow = %llu\n", flow);
-    return flow;
-}
 
-/** Returns a min cut (in \p cutset) for the graph in \p h. */
-vector<NFAEdge> findMinCut(NGHolder &h, const vector<u64a> &scores) {
-    assert(hasCorrectlyNumberedEdges(h));
-    assert(hasCorrectlyNumberedVertices(h));
-
-    vector<default_color_type> colorMap(num_vertices(h));
-    u64a flow = getMaxFlow(h, scores, colorMap);
+    // There are two canonical min cuts: the edges leaving the set of vertices
+    // still reachable from the source ("black"), and the edges entering the
+    // set of vertices that can still reach the sink ("white").
+    const auto black = residualReach(residual, src, true);
+    const auto white = residualReach(residual, sink, false);
 
     vector<NFAEdge> picked_white;
     vector<NFAEdge> picked_black;
@@ -182,23 +233,23 @@ vector<NFAEdge> findMinCut(NGHolder &h, const vector<u64a> &scores) {
         NFAVertex to = target(e, h);
         u64a ec = scores[h[e].index];
         if (ec == 0) {
-            continue; // skips, among other things, reverse edges
+            continue;
         }
 
-        default_color_type fromColor = colorMap[h[from].index];
-        default_color_type toColor = colorMap[h[to].index];
+        u32 fromIdx = h[from].index;
+        u32 toIdx = h[to].index;
 
-        if (fromColor != boost::white_color && toColor == boost::white_color) {
+        if (!white[fromIdx] && white[toIdx]) {
             assert(ec <= INVALID_EDGE_CAP);
             DEBUG_PRINTF("found white cut edge %u->%u cap %llu\n",
-                     h[from].index, h[to].index, ec);
+                     fromIdx, toIdx, ec);
             observed_white_flow += ec;
             picked_white.push_back(e);
         }
-        if (fromColor == boost::black_color && toColor != boost::black_color) {
+        if (black[fromIdx] && !black[toIdx]) {
             assert(ec <= INVALID_EDGE_CAP);
             DEBUG_PRINTF("found black cut edge %u->%u cap %llu\n",
-                     h[from].index, h[to].index, ec);
+                     fromIdx, toIdx, ec);
             observed_black_flow += ec;
             picked_black.push_back(e);
         }
@@ -206,9 +257,8 @@ vector<NFAEdge> findMinCut(NGHolder &h, const vector<u64a> &scores) {
 
     DEBUG_PRINTF("min flow = %llu b flow = %llu w flow %llu\n", flow,
                  observed_black_flow, observed_white_flow);
-    if (MIN(observed_white_flow, observed_black_flow) != flow) {
-        DEBUG_PRINTF("bad cut\n");
-    }
+    assert(observed_black_flow == flow);
+    assert(observed_white_flow == flow);
 
     if (observed_white_flow < observed_black_flow) {
         return picked_white;
@@ -217,4 +267,9 @@ vector<NFAEdge> findMinCut(NGHolder &h, const vector<u64a> &scores) {
     }
 }
 
+/** Returns a min cut (in \p cutset) for the graph in \p h. */
+vector<NFAEdge> findMinCut(const NGHolder &h, const vector<u64a> &scores) {
+    return NetflowGraph(h).findMinCut(scores);
+}
+
 } // namespace ue2
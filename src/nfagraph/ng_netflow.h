@@ -41,8 +41,44 @@ namespace ue2 {
 
 class NGHolder;
 
+/**
+ * \brief Compact (CSR) flow network over the vertices and edges of a holder.
+ *
+ * The network is built once and can be used for any number of min cuts with
+ * different edge scores, as long as the holder is not modified in between.
+ * The holder itself is never changed.
+ */
+class NetflowGraph {
+public:
+    explicit NetflowGraph(const NGHolder &h);
+
+    /** Returns a min cut for the graph, separating start from acceptEod, with
+     * edge capacities given by \p scores (indexed by edge index). */
+    std::vector<NFAEdge> findMinCut(const std::vector<u64a> &scores) const;
+
+private:
+    static constexpr u32 NO_EDGE = ~0U;
+
+    bool buildLevels(const std::vector<u64a> &residual,
+                     std::vector<s32> &level) const;
+    u64a blockingFlow(std::vector<u64a> &residual, std::vector<s32> &level,
+                      std::vector<u32> &next) const;
+    std::vector<bool> residualReach(const std::vector<u64a> &residual,
+                                    u32 from, bool forwards) const;
+
+    const NGHolder &h;
+    u32 src;
+    u32 sink;
+
+    std::vector<u32> first; //!< first arc of each vertex, by vertex index
+    std::vector<u32> head; //!< target vertex index of each arc
+    std::vector<u32> rev; //!< paired residual arc of each arc
+    std::vector<u32> edgeIndex; //!< edge index, or NO_EDGE for residual arcs
+};
+
 /** Returns a min cut (in \p cutset) for the graph in \p h. */
-std::vector<NFAEdge> findMinCut(NGHolder &h, const std::vector<u64a> &scores);
+std::vector<NFAEdge> findMinCut(const NGHolder &h,
+                                const std::vector<u64a> &scores);
 
 } // namespace ue2
 
@@ -51,6 +51,7 @@
 #include "ng_util.h"
 #include "ng_width.h"
 #include "ue2common.h"
+#include "grey.h"
 #include "util/compile_context.h"
 #include "util/container.h"
 #include "util/dump_charclass.h"
@@ -66,10 +67,6 @@ using boost::adaptors::map_values;
 
 namespace ue2 {
 
-/** Keep attempting to reduce the size of the graph until the number of
- * vertices falls below this value. */
-static const size_t MAX_COMPONENT_VERTICES = 128;
-
 /** Only replace a region with at least this many vertices. */
 static const size_t MIN_REPLACE_VERTICES = 2;
 
@@ -322,8 +319,10 @@ struct SourceHasEdgeToAccept {
 };
 }
 
+/** Keep attempting to reduce the size of the graph until the number of
+ * vertices falls below \a max_vertices. */
 static
-void reduceRegions(NGHolder &h) {
+void reduceRegions(NGHolder &h, size_t max_vertices) {
     map<u32, RegionInfo> regions = findRegionInfo(h, assignRegions(h));
 
     RegionInfoQueueComp cmp;
@@ -335,7 +334,7 @@ void reduceRegions(NGHolder &h) {
         pq.push(ri);
     }
 
-    while (numVertices > MAX_COMPONENT_VERTICES && !pq.empty()) {
+    while (numVertices > max_vertices && !pq.empty()) {
         const RegionInfo &ri = pq.top();
         DEBUG_PRINTF("region %u: vertices=%zu reach=%s score=%zu, "
                      "widths=[%s,%s]\n",
@@ -364,12 +363,17 @@ void reduceRegions(NGHolder &h) {
     remove_in_edge_if(h.acceptEod, SourceHasEdgeToAccept(h), h.g);
 }
 
-void prefilterReductions(NGHolder &h, const CompileContext &cc) {
+void prefilterReductions(NGHolder &h, const CompileContext &cc,
+                         u32 max_vertices) {
     if (!cc.grey.prefilterReductions) {
         return;
     }
 
-    if (num_vertices(h) <= MAX_COMPONENT_VERTICES) {
+    if (!max_vertices) {
+        max_vertices = cc.grey.prefilterMaxVertices;
+    }
+
+    if (num_vertices(h) <= max_vertices) {
         DEBUG_PRINTF("graph is already small enough (%zu vertices)\n",
                      num_vertices(h));
         return;
@@ -381,7 +385,7 @@ void prefilterReductions(NGHolder &h, const CompileContext &cc) {
     h.renumberVertices();
     h.renumberEdges();
 
-    reduceRegions(h);
+    reduceRegions(h, max_vertices);
 
     h.renumberVertices();
     h.renumberEdges();
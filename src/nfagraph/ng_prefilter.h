@@ -33,12 +33,20 @@
 #ifndef NG_PREFILTER_H
 #define NG_PREFILTER_H
 
+#include "ue2common.h"
+
 namespace ue2 {
 
 class NGHolder;
 struct CompileContext;
 
-void prefilterReductions(NGHolder &h, const CompileContext &cc);
+/**
+ * \brief Reduce the size of prefilter graph \a h to about \a max_vertices
+ * vertices (or the Grey default, if zero) by replacing regions with bounded
+ * repeats.
+ */
+void prefilterReductions(NGHolder &h, const CompileContext &cc,
+                         u32 max_vertices);
 
 } // namespace ue2
 
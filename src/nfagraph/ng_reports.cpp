@@ -33,6 +33,7 @@
 
 #include "ng_holder.h"
 #include "util/container.h"
+#include "util/compile_budget.h"
 #include "util/compile_context.h"
 #include "util/graph_range.h"
 #include "util/report_manager.h"
@@ -83,4 +84,17 @@ u64a findMaxOffset(const NGHolder &g, const ReportManager &rm) {
     return maxOffset;
 }
 
+void markDegraded(const NGHolder &g, const ReportManager &rm,
+                  const CompileContext &cc) {
+    if (!cc.budget) {
+        return;
+    }
+    for (ReportID report_id : all_reports(g)) {
+        const Report &report = rm.getReport(report_id);
+        if (isExternalReport(report)) {
+            cc.budget->markDegraded(report.onmatch);
+        }
+    }
+}
+
 } // namespace ue2
@@ -39,6 +39,7 @@
 
 namespace ue2 {
 
+struct CompileContext;
 class NGHolder;
 class ReportManager;
 
@@ -52,6 +53,11 @@ bool can_exhaust(const NGHolder &g, const ReportManager &rm);
  * reports. Returns MAX_OFFSET for inf. */
 u64a findMaxOffset(const NGHolder &g, const ReportManager &rm);
 
+/** Records the patterns reported by the graph as degraded by the compile time
+ * budget (see \ref overBudget). */
+void markDegraded(const NGHolder &g, const ReportManager &rm,
+                  const CompileContext &cc);
+
 } // namespace ue2
 
 #endif // NG_REPORTS_H
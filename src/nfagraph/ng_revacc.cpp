@@ -36,14 +36,19 @@
 #include "ue2common.h"
 #include "nfa/accel.h"
 #include "nfa/nfa_internal.h"
+#include "nfa/trufflecompile.h"
 #include "util/bitutils.h"
 #include "util/charreach.h"
 #include "util/graph_range.h"
+#include "util/simd_utils.h"
 
 using namespace std;
 
 namespace ue2 {
 
+/** \brief Widest class we will build a reverse truffle scheme for. */
+#define MAX_RACCEL_CLASS 64
+
 static
 bool isPseudoNoCaseChar(const CharReach &cr) {
     return cr.count() == 2 && !(cr.find_first() & 32)
@@ -124,6 +129,40 @@ bool lookForEodSchemes(const RevAccInfo &rev_info, const u32 minWidth,
     return false;
 }
 
+/** \brief Looks for the narrowest class of bytes below 0x80 at a fixed offset
+ * from the end of every match; its truffle mask fits in the NFA header. */
+static
+bool lookForClassScheme(const RevAccInfo &rev_info, const u32 minWidth,
+                        NFA *nfa) {
+    const CharReach low(0, 0x7f);
+    CharReach best;
+    u8 best_i = 0;
+
+    for (u8 i = 0; i < MAX_RACCEL_OFFSET && i < minWidth; i++) {
+        CharReach cr = rev_info.acceptEodReach[i] | rev_info.acceptReach[i];
+        if (cr.none() || !cr.isSubsetOf(low) || cr.count() > MAX_RACCEL_CLASS) {
+            continue;
+        }
+        if (best.none() || cr.count() < best.count()) {
+            best = cr;
+            best_i = i;
+        }
+    }
+
+    if (best.none()) {
+        return false;
+    }
+
+    m128 highset;
+    truffleBuildMasks(best, &nfa->rAccelData.mask, &highset);
+    assert(!isnonzero128(highset));
+    nfa->rAccelType = ACCEL_RTRUFFLE_LOW;
+    nfa->rAccelOffset = best_i + 1;
+    DEBUG_PRINTF("raccel truffle %u, %zu chars\n", nfa->rAccelOffset,
+                 best.count());
+    return true;
+}
+
 static
 bool lookForFloatingSchemes(const RevAccInfo &rev_info,
                             const u32 minWidth, NFA *nfa) {
@@ -195,7 +234,7 @@ bool lookForFloatingSchemes(const RevAccInfo &rev_info,
         }
     }
 
-    return false;
+    return lookForClassScheme(rev_info, minWidth, nfa);
 }
 
 void buildReverseAcceleration(NFA *nfa, const RevAccInfo &rev_info,
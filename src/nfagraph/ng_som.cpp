@@ -1806,7 +1806,10 @@ bool doSomRevNfa(NG &ng, NGHolder &g, const CompileContext &cc) {
     depth maxWidth = findMaxWidth(g);
     DEBUG_PRINTF("maxWidth=%s\n", maxWidth.str().c_str());
 
-    if (maxWidth > depth(ng.maxSomRevHistoryAvailable)) {
+    // In block mode, lazy SOM lets the rev NFA scan back as far as the start
+    // of the buffer, so it needs no history and its width is unbounded.
+    const bool in_history = maxWidth <= depth(ng.maxSomRevHistoryAvailable);
+    if (!in_history && !(cc.lazy_som && !cc.streaming)) {
         DEBUG_PRINTF("too wide\n");
         return false;
     }
@@ -1834,7 +1837,8 @@ bool doSomRevNfa(NG &ng, NGHolder &g, const CompileContext &cc) {
         assert(som_nfa.nfa);
 
         // Transfer ownership of the NFA to the SOM slot manager.
-        u32 comp_id = ng.ssm.addRevNfa(move(som_nfa.nfa), maxWidth);
+        u32 comp_id = ng.ssm.addRevNfa(move(som_nfa.nfa),
+                                       in_history ? (u32)maxWidth : 0);
 
         // Replace this report on 'g' with a SOM_REV_NFA report pointing at our
         // new component.
@@ -2893,6 +2897,13 @@ sombe_rv doSom(NG &ng, NGHolder &g, const NGWrapper &w, u32 comp_id,
         return SOMBE_HANDLED_INTERNAL;
     }
 
+    // In lazy SOM mode, the forward engines are built without SOM tracking
+    // wherever possible; SOM is computed only for each match by a rev NFA.
+    if (cc.lazy_som && doSomRevNfa(ng, g, cc)) {
+        DEBUG_PRINTF("lazy som\n");
+        return SOMBE_HANDLED_INTERNAL;
+    }
+
     if (!cc.grey.allowSomChain) {
         return SOMBE_FAIL;
     }
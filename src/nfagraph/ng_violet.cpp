@@ -54,6 +54,7 @@
 #include "rose/rose_in_util.h"
 #include "util/compare.h"
 #include "util/compile_context.h"
+#include "util/compile_report.h"
 #include "util/container.h"
 #include "util/graph.h"
 #include "util/graph_range.h"
@@ -160,8 +161,10 @@ struct VertLitInfo {
  */
 class LitComparator {
 public:
-    LitComparator(const NGHolder &g_in, bool sa, bool st)
-        : g(g_in), seeking_anchored(sa), seeking_transient(st) {}
+    LitComparator(const NGHolder &g_in, bool sa, bool st,
+                  const ByteFrequencies *freq_in)
+        : g(g_in), seeking_anchored(sa), seeking_transient(st),
+          freq(freq_in) {}
     bool operator()(const unique_ptr<VertLitInfo> &a,
                     const unique_ptr<VertLitInfo> &b) const {
         assert(a && b);
@@ -178,8 +181,8 @@ public:
             }
         }
 
-        u64a score_a = scoreSet(a->lit);
-        u64a score_b = scoreSet(b->lit);
+        u64a score_a = scoreSet(a->lit, freq);
+        u64a score_b = scoreSet(b->lit, freq);
 
         if (score_a != score_b) {
             return score_a > score_b;
@@ -195,6 +198,7 @@ private:
 
     bool seeking_anchored;
     bool seeking_transient;
+    const ByteFrequencies *freq; /**< expected traffic, or nullptr */
 };
 }
 
@@ -327,7 +331,7 @@ void getSimpleRoseLiterals(const NGHolder &g, bool seeking_anchored,
 
         DEBUG_PRINTF("|candidate raw literal set| = %zu\n", s.size());
         dumpRoseLiteralSet(s);
-        u64a score = sanitizeAndCompressAndScore(s);
+        u64a score = sanitizeAndCompressAndScore(s, cc.byte_freq.get());
 
         bool anchored = false;
         if (seeking_anchored) {
@@ -481,7 +485,7 @@ void getRegionRoseLiterals(const NGHolder &g, bool seeking_anchored,
 
         DEBUG_PRINTF("|candidate raw literal set| = %zu\n", s.size());
         dumpRoseLiteralSet(s);
-        u64a score = sanitizeAndCompressAndScore(s);
+        u64a score = sanitizeAndCompressAndScore(s, cc.byte_freq.get());
 
         DEBUG_PRINTF("|candidate literal set| = %zu\n", s.size());
         dumpRoseLiteralSet(s);
@@ -660,7 +664,8 @@ unique_ptr<VertLitInfo> findBestSplit(const NGHolder &g,
         }
     }
 
-    auto cmp = LitComparator(g, seeking_anchored, seeking_transient);
+    auto cmp = LitComparator(g, seeking_anchored, seeking_transient,
+                             cc.byte_freq.get());
 
     unique_ptr<VertLitInfo> best = move(lits.back());
     lits.pop_back();
@@ -1255,8 +1260,8 @@ bool doNetflowCut(NGHolder &h,
                   const vector<NFAVertexDepth> *depths,
                   RoseInGraph &vg,
                   const vector<RoseInEdge> &ee, bool for_prefix,
-                  const Grey &grey, u32 min_allowed_length = 0U) {
-    ENSURE_AT_LEAST(&min_allowed_length, grey.minRoseNetflowLiteralLength);
+                  const CompileContext &cc, u32 min_allowed_length = 0U) {
+    ENSURE_AT_LEAST(&min_allowed_length, cc.grey.minRoseNetflowLiteralLength);
 
     DEBUG_PRINTF("doing netflow cut\n");
     /* TODO: we should really get literals/scores from the full graph as this
@@ -1265,7 +1270,7 @@ bool doNetflowCut(NGHolder &h,
     assert(&h == &*vg[ee.front()].graph);
     assert(!for_prefix || depths);
 
-    if (num_edges(h) > grey.maxRoseNetflowEdges) {
+    if (num_edges(h) > cc.grey.maxRoseNetflowEdges) {
         /* We have a limit on this because scoring edges and running netflow
          * gets very slow for big graphs. */
         DEBUG_PRINTF("too many edges, skipping netflow cut\n");
@@ -1275,10 +1280,11 @@ bool doNetflowCut(NGHolder &h,
     assert(hasCorrectlyNumberedVertices(h));
     assert(hasCorrectlyNumberedEdges(h));
 
-    auto known_bad = poisonEdges(h, depths, vg, ee, for_prefix, grey);
+    auto known_bad = poisonEdges(h, depths, vg, ee, for_prefix, cc.grey);
 
     /* Step 1: Get scores for all edges */
-    vector<u64a> scores = scoreEdges(h, known_bad); /* scores by edge_index */
+    /* scores by edge_index */
+    vector<u64a> scores = scoreEdges(h, known_bad, cc.byte_freq.get());
 
     /* Step 2: Find cutset based on scores */
     vector<NFAEdge> cut = findMinCut(h, scores);
@@ -1287,7 +1293,7 @@ bool doNetflowCut(NGHolder &h,
     map<NFAEdge, set<ue2_literal>> cut_lits;
     for (const auto &e : cut) {
         set<ue2_literal> lits = getLiteralSet(h, e);
-        sanitizeAndCompressAndScore(lits);
+        sanitizeAndCompressAndScore(lits, cc.byte_freq.get());
 
         cut_lits[e] = lits;
     }
@@ -1389,7 +1395,7 @@ void avoidOutfixes(RoseInGraph &vg, const CompileContext &cc) {
     if (split && splitRoseEdge(h, vg, {e}, *split)) {
         DEBUG_PRINTF("split on simple literal\n");
     } else {
-        doNetflowCut(h, nullptr, vg, {e}, false, cc.grey);
+        doNetflowCut(h, nullptr, vg, {e}, false, cc);
     }
 }
 
@@ -1836,7 +1842,7 @@ bool improvePrefix(NGHolder &h, RoseInGraph &vg, const vector<RoseInEdge> &ee,
     /* large back edges may prevent us identifing anchored or transient cases
      * properly - use a simple walk instead */
 
-    if (doNetflowCut(h, &depths, vg, ee, true, cc.grey)) {
+    if (doNetflowCut(h, &depths, vg, ee, true, cc)) {
         return true;
     }
 
@@ -1848,7 +1854,7 @@ bool improvePrefix(NGHolder &h, RoseInGraph &vg, const vector<RoseInEdge> &ee,
     }
 
     /* look for netflow cuts which don't produce good prefixes */
-    if (doNetflowCut(h, &depths, vg, ee, false, cc.grey)) {
+    if (doNetflowCut(h, &depths, vg, ee, false, cc)) {
         return true;
     }
 
@@ -2036,7 +2042,7 @@ bool improveInfix(NGHolder &h, RoseInGraph &vg, const vector<RoseInEdge> &ee,
 
     DEBUG_PRINTF("trying for a netflow cut\n");
     /* look for netflow cuts which don't produce good prefixes */
-    bool rv = doNetflowCut(h, nullptr, vg, ee, false, cc.grey, 8);
+    bool rv = doNetflowCut(h, nullptr, vg, ee, false, cc, 8);
 
     DEBUG_PRINTF("did netfow cut? = %d\n", (int)rv);
 
@@ -2604,6 +2610,7 @@ bool doViolet(RoseBuild &rose, const NGHolder &h, bool prefilter,
         return false;
     }
 
+    PhaseTimer timer(cc, PHASE_VIOLET);
     DEBUG_PRINTF("hello world\n");
 
     RoseInGraph vg = populateTrivialGraph(h);
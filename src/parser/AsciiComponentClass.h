@@ -39,6 +39,7 @@
 namespace ue2 {
 
 class AsciiComponentClass : public ComponentClass {
+    friend class ConfirmBuildVisitor;
     friend class ConstructLiteralVisitor;
     friend class DumpVisitor;
     friend class PrintVisitor;
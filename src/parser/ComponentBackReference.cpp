@@ -45,11 +45,13 @@ using namespace std;
 
 namespace ue2 {
 
-ComponentBackReference::ComponentBackReference(unsigned int id)
-    : ref_id(id) {}
+ComponentBackReference::ComponentBackReference(unsigned int id,
+                                               bool caseless_in)
+    : ref_id(id), caseless(caseless_in) {}
 
-ComponentBackReference::ComponentBackReference(const string &s)
-    : name(s), ref_id(0) {}
+ComponentBackReference::ComponentBackReference(const string &s,
+                                               bool caseless_in)
+    : name(s), ref_id(0), caseless(caseless_in) {}
 
 ComponentBackReference * ComponentBackReference::clone() const {
     return new ComponentBackReference(*this);
@@ -43,8 +43,9 @@ class ComponentBackReference : public Component {
     friend class PrintVisitor;
     friend class ReferenceVisitor;
 public:
-    explicit ComponentBackReference(unsigned int id);
-    explicit ComponentBackReference(const std::string &s);
+    explicit ComponentBackReference(unsigned int id, bool caseless = false);
+    explicit ComponentBackReference(const std::string &s,
+                                    bool caseless = false);
     ~ComponentBackReference() override {}
     ComponentBackReference *clone() const override;
 
@@ -62,6 +63,7 @@ public:
 
     unsigned int getRefID() const { return ref_id; }
     const std::string &getRefName() const { return name; }
+    bool isCaseless() const { return caseless; }
 
     std::vector<PositionInfo> first() const override;
     std::vector<PositionInfo> last() const override;
@@ -73,10 +75,13 @@ public:
 private:
     // Private copy ctor. Use clone instead.
     ComponentBackReference(const ComponentBackReference &other)
-        : Component(other), name(other.name), ref_id(other.ref_id) {}
+        : Component(other), name(other.name), ref_id(other.ref_id),
+          caseless(other.caseless) {}
 
     std::string name;
     unsigned int ref_id;
+    bool caseless; //!< referent text is matched caselessly
+
 };
 
 } // namespace ue2
@@ -40,6 +40,8 @@ namespace ue2 {
 
 /** \brief Encapsulates a line/string boundary assertion. */
 class ComponentBoundary : public Component {
+    friend class ConfirmBuildVisitor;
+    friend class ConstructLiteralVisitor;
     friend class DumpVisitor;
     friend class PrintVisitor;
     friend class UnsafeBoundsVisitor;
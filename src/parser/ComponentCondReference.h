@@ -41,6 +41,7 @@
 namespace ue2 {
 
 class ComponentCondReference : public ComponentSequence {
+    friend class ConfirmBuildVisitor;
     friend class DumpVisitor;
     friend class PrefilterVisitor;
     friend class ReferenceVisitor;
@@ -43,6 +43,7 @@ struct ParseMode;
 /** \brief Encapsulates a positive (\\b) or negative (\\B) word boundary
  * assertion. */
 class ComponentWordBoundary : public Component {
+    friend class ConfirmBuildVisitor;
     friend class DumpVisitor;
     friend class PrintVisitor;
     friend class UnsupportedVisitor;
@@ -481,7 +481,8 @@ unichar readUtf8CodePoint4c(const u8 *ts) {
         if (accumulator == 0) {
             throw LocatedParseError("Numbered reference cannot be zero");
         }
-        currentSeq->addComponent(ue2::make_unique<ComponentBackReference>(accumulator));
+        currentSeq->addComponent(
+            ue2::make_unique<ComponentBackReference>(accumulator, mode.caseless));
     }
 
     action addNegativeNumberedBackRef {
@@ -493,11 +494,13 @@ unichar readUtf8CodePoint4c(const u8 *ts) {
             throw LocatedParseError("Invalid reference");
         }
         unsigned idx = groupIndex - accumulator;
-        currentSeq->addComponent(ue2::make_unique<ComponentBackReference>(idx));
+        currentSeq->addComponent(
+            ue2::make_unique<ComponentBackReference>(idx, mode.caseless));
     }
 
     action addNamedBackRef {
-        currentSeq->addComponent(ue2::make_unique<ComponentBackReference>(label));
+        currentSeq->addComponent(
+            ue2::make_unique<ComponentBackReference>(label, mode.caseless));
     }
 
     escapedOctal0 = '\\0' @clearOctAccumulator [0-7]{0,2} $appendAccumulatorOctDigit;
@@ -1426,7 +1429,8 @@ unichar readUtf8CodePoint4c(const u8 *ts) {
                   // a back reference
                   accumulator = parseAsDecimal(octAccumulator);
                   if (accumulator < groupIndex) {
-                      currentSeq->addComponent(ue2::make_unique<ComponentBackReference>(accumulator));
+                      currentSeq->addComponent(
+                          ue2::make_unique<ComponentBackReference>(accumulator, mode.caseless));
                   } else {
                       addEscapedOctal(currentSeq, octAccumulator, mode);
                   }
@@ -1441,7 +1445,8 @@ unichar readUtf8CodePoint4c(const u8 *ts) {
               '\\' backRefId => {
                   // if there are enough left parens to this point, back ref
                   if (accumulator < groupIndex) {
-                      currentSeq->addComponent(ue2::make_unique<ComponentBackReference>(accumulator));
+                      currentSeq->addComponent(
+                          ue2::make_unique<ComponentBackReference>(accumulator, mode.caseless));
                   } else {
                       // Otherwise, we interpret the first three digits as an
                       // octal escape, and the remaining characters stand for
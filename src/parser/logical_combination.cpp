@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Parse and build logical combinations of pattern IDs.
+ */
+
+#include "logical_combination.h"
+
+#include "util/compile_error.h"
+#include "util/container.h"
+
+#include <cctype>
+#include <sstream>
+
+using namespace std;
+
+namespace ue2 {
+
+/** \brief Maximum nesting depth of a logical combination. */
+static const u32 MAX_LOGICAL_DEPTH = 256;
+
+/**
+ * \brief Simple recursive-descent parser for logical combinations.
+ *
+ * The grammar, in order of increasing precedence:
+ *
+ *     or  := and ( '|' and )*
+ *     and := not ( '&' not )*
+ *     not := '!' not | '(' or ')' | id
+ *
+ * Whitespace between tokens is ignored.
+ */
+class LogicalParser {
+public:
+    LogicalParser(ParsedLogical &pl_in, u32 index_in, const char *logical)
+        : pl(pl_in), index(index_in), start(logical), p(logical) {}
+
+    /** \brief Parse the whole combination, returning the logical key of its
+     * result. */
+    u32 parse() {
+        u32 lkey = parseOr(0);
+        skipSpace();
+        if (*p) {
+            error();
+        }
+        return lkey;
+    }
+
+    /** \brief IDs referred to by the combination, in order of appearance. */
+    vector<ReportID> ids;
+
+private:
+    [[noreturn]] void error() const {
+        ostringstream oss;
+        oss << "Logical combination syntax error at offset " << (p - start)
+            << ".";
+        throw CompileError(index, oss.str());
+    }
+
+    void skipSpace() {
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+    }
+
+    bool accept(char c) {
+        skipSpace();
+        if (*p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    u32 parseOr(u32 depth) {
+        u32 lo = parseAnd(depth);
+        while (accept('|')) {
+            u32 ro = parseAnd(depth);
+            lo = pl.addOp(LOGICAL_OP_OR, lo, ro);
+        }
+        return lo;
+    }
+
+    u32 parseAnd(u32 depth) {
+        u32 lo = parseNot(depth);
+        while (accept('&')) {
+            u32 ro = parseNot(depth);
+            lo = pl.addOp(LOGICAL_OP_AND, lo, ro);
+        }
+        return lo;
+    }
+
+    u32 parseNot(u32 depth) {
+        if (depth > MAX_LOGICAL_DEPTH) {
+            throw CompileError(index,
+                               "Logical combination is too deeply nested.");
+        }
+        if (accept('!')) {
+            u32 ro = parseNot(depth + 1);
+            return pl.addOp(LOGICAL_OP_NOT, ro, INVALID_LKEY);
+        }
+        if (accept('(')) {
+            u32 lkey = parseOr(depth + 1);
+            if (!accept(')')) {
+                error();
+            }
+            return lkey;
+        }
+        return parseId();
+    }
+
+    u32 parseId() {
+        skipSpace();
+        if (!isdigit((unsigned char)*p)) {
+            error();
+        }
+        u64a id = 0;
+        while (isdigit((unsigned char)*p)) {
+            id = id * 10 + (*p - '0');
+            if (id > 0xffffffffULL) {
+                error();
+            }
+            p++;
+        }
+        ids.push_back((ReportID)id);
+        return pl.getOrAssignLogicalKey((ReportID)id);
+    }
+
+    ParsedLogical &pl;
+    const u32 index;
+    const char *start;
+    const char *p;
+};
+
+void ParsedLogical::addPattern(u32 index, ReportID id, bool quiet) {
+    auto it = patterns.find(id);
+    if (it == patterns.end()) {
+        patterns.emplace(id, PatternInfo(quiet, index));
+        return;
+    }
+
+    const PatternInfo &pi = it->second;
+    if (pi.quiet != quiet) {
+        ostringstream out;
+        out << "Expression (index " << index << ") with match ID " << id
+            << " " << (quiet ? "specified" : "did not specify")
+            << " HS_FLAG_QUIET whereas previous expression (index "
+            << pi.first_pattern_index << ") with the same match ID did"
+            << (quiet ? " not" : "") << ".";
+        throw CompileError(index, out.str());
+    }
+}
+
+void ParsedLogical::addCombination(u32 index, ReportID id,
+                                   const char *logical) {
+    u32 ckey = numCombinations();
+    u32 start = verify_u32(logicalTree.size());
+
+    LogicalParser parser(*this, index, logical);
+    u32 result = parser.parse();
+
+    CombInfo ci;
+    ci.id = id;
+    ci.start = start;
+    ci.end = verify_u32(logicalTree.size());
+    ci.result = result;
+    combInfos.push_back(ci);
+    combIndices.push_back(index);
+
+    for (const auto &sub : parser.ids) {
+        auto &ckeys = lkeyToCkeys[toLogicalKeyMap.at(sub)];
+        if (ckeys.empty() || ckeys.back() != ckey) {
+            ckeys.push_back(ckey);
+        }
+    }
+    combSubIds.push_back(move(parser.ids));
+}
+
+void ParsedLogical::validateSubIds() const {
+    for (size_t i = 0; i < combSubIds.size(); i++) {
+        for (const auto &sub : combSubIds[i]) {
+            if (!contains(patterns, sub)) {
+                ostringstream out;
+                out << "Logical combination refers to unknown pattern ID "
+                    << sub << ".";
+                throw CompileError(combIndices[i], out.str());
+            }
+        }
+    }
+}
+
+u32 ParsedLogical::getLogicalKey(ReportID id) const {
+    auto it = toLogicalKeyMap.find(id);
+    if (it == toLogicalKeyMap.end()) {
+        return INVALID_LKEY;
+    }
+    return it->second;
+}
+
+const vector<u32> &ParsedLogical::getCombKeys(u32 lkey) const {
+    return lkeyToCkeys.at(lkey);
+}
+
+bool ParsedLogical::isQuiet(ReportID id) const {
+    auto it = patterns.find(id);
+    return it != patterns.end() && it->second.quiet;
+}
+
+u32 ParsedLogical::getOrAssignLogicalKey(ReportID id) {
+    auto it = toLogicalKeyMap.find(id);
+    if (it != toLogicalKeyMap.end()) {
+        return it->second;
+    }
+    u32 lkey = lkeyCount++;
+    toLogicalKeyMap.emplace(id, lkey);
+    return lkey;
+}
+
+u32 ParsedLogical::addOp(u32 op, u32 lo, u32 ro) {
+    LogicalOp lop;
+    lop.id = lkeyCount++;
+    lop.op = op;
+    lop.lo = lo;
+    lop.ro = ro;
+    logicalTree.push_back(lop);
+    return lop.id;
+}
+
+} // namespace ue2
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Parse and build logical combinations of pattern IDs.
+ */
+
+#ifndef LOGICAL_COMBINATION_H
+#define LOGICAL_COMBINATION_H
+
+#include "ue2common.h"
+#include "util/logical.h"
+#include "util/verify_types.h"
+
+#include <map>
+#include <vector>
+
+namespace ue2 {
+
+/**
+ * \brief Tracks the logical combinations in a pattern set, along with the
+ * logical keys assigned to the patterns they refer to.
+ */
+class ParsedLogical {
+public:
+    /** \brief Note a (non-combination) pattern with match ID \a id, and
+     * whether it was specified with HS_FLAG_QUIET. Throws a CompileError if
+     * patterns sharing an ID disagree about HS_FLAG_QUIET. */
+    void addPattern(u32 index, ReportID id, bool quiet);
+
+    /** \brief Parse the logical combination \a logical (such as
+     * "(101 & 102) | !103") with match ID \a id and add it. Throws a
+     * CompileError on syntax errors. */
+    void addCombination(u32 index, ReportID id, const char *logical);
+
+    /** \brief Check that every ID referred to by a combination belongs to a
+     * pattern in this set. */
+    void validateSubIds() const;
+
+    /** \brief Logical key for pattern \a id, or INVALID_LKEY if the ID is not
+     * used by any combination. */
+    u32 getLogicalKey(ReportID id) const;
+
+    /** \brief Combination keys of the combinations that refer to the logical
+     * key \a lkey of a pattern. */
+    const std::vector<u32> &getCombKeys(u32 lkey) const;
+
+    /** \brief True if matches for \a id should not be reported. */
+    bool isQuiet(ReportID id) const;
+
+    /** \brief Total number of logical keys, including those used to hold
+     * the results of operations. */
+    u32 numLogicalKeys() const { return lkeyCount; }
+
+    /** \brief Number of combinations. */
+    u32 numCombinations() const { return verify_u32(combInfos.size()); }
+
+    /** \brief Operations for all combinations, in evaluation order. */
+    const std::vector<LogicalOp> &getLogicalTree() const { return logicalTree; }
+
+    /** \brief Combinations, indexed by combination key. */
+    const std::vector<CombInfo> &getCombInfos() const { return combInfos; }
+
+private:
+    friend class LogicalParser;
+
+    /** \brief Fetch the logical key for pattern \a id, assigning one if
+     * necessary. */
+    u32 getOrAssignLogicalKey(ReportID id);
+
+    /** \brief Append an operation to the logical tree, returning the logical
+     * key holding its result. */
+    u32 addOp(u32 op, u32 lo, u32 ro);
+
+    struct PatternInfo {
+        PatternInfo(bool q, u32 fpi) : quiet(q), first_pattern_index(fpi) {}
+        bool quiet;
+        u32 first_pattern_index;
+    };
+
+    /** \brief Patterns (other than combinations), by match ID. */
+    std::map<ReportID, PatternInfo> patterns;
+
+    /** \brief Logical keys of patterns referred to by combinations. */
+    std::map<ReportID, u32> toLogicalKeyMap;
+
+    /** \brief For each pattern logical key, the combinations using it. */
+    std::map<u32, std::vector<u32>> lkeyToCkeys;
+
+    /** \brief Operations for all combinations. */
+    std::vector<LogicalOp> logicalTree;
+
+    /** \brief Combinations, indexed by combination key. */
+    std::vector<CombInfo> combInfos;
+
+    /** \brief Expression index of each combination, for errors. */
+    std::vector<u32> combIndices;
+
+    /** \brief Patterns referred to by each combination. */
+    std::vector<std::vector<ReportID>> combSubIds;
+
+    /** \brief Number of logical keys assigned so far. */
+    u32 lkeyCount = 0;
+};
+
+} // namespace ue2
+
+#endif
@@ -47,17 +47,20 @@
 #include "grey.h"
 #include "nfagraph/ng.h"
 #include "compiler/compiler.h"
+#include "util/compare.h"
 #include "util/ue2string.h"
 #include "ue2common.h"
 
 #include <stack>
+#include <vector>
 
 using namespace std;
 
 namespace ue2 {
 
 /**
- * \brief Visitor that constructs a ue2_literal from a component tree.
+ * \brief Visitor that constructs a sequence of character classes, with its
+ * anchors, from a component tree.
  *
  * If a component that can't be part of a literal is encountered, this visitor
  * will throw ConstructLiteralVisitor::NotLiteral.
@@ -70,19 +73,39 @@ public:
     struct NotLiteral {};
 
     void pre(const AsciiComponentClass &c) override {
-        const CharReach &cr = c.cr;
-        const size_t width = cr.count();
-        if (width == 1) {
-            lit.push_back(cr.find_first(), false);
-        } else if (width == 2 && cr.isCaselessChar()) {
-            lit.push_back(cr.find_first(), true);
-        } else {
+        if (end_anchored() || c.cr.none()) {
+            throw NotLiteral();
+        }
+        seq.push_back(c.cr);
+    }
+
+    void pre(const ComponentBoundary &c) override {
+        // Anchors may only appear outside repeats, at the ends of the
+        // sequence.
+        if (!repeat_stack.empty() || end_anchored()) {
+            throw NotLiteral();
+        }
+
+        switch (c.m_bound) {
+        case ComponentBoundary::BEGIN_STRING:
+            if (!seq.empty() || dec.anchored) {
+                throw NotLiteral();
+            }
+            dec.anchored = true;
+            break;
+        case ComponentBoundary::END_STRING:
+            dec.eod = true;
+            break;
+        case ComponentBoundary::END_STRING_OPTIONAL_LF:
+            dec.eod_lf = true;
+            break;
+        default:
             throw NotLiteral();
         }
     }
 
     void pre(const ComponentRepeat &c) override {
-        if (c.m_min == 0 || c.m_min != c.m_max) {
+        if (c.m_min == 0 || c.m_min != c.m_max || end_anchored()) {
             throw NotLiteral();
         }
 
@@ -90,20 +113,21 @@ public:
             throw ParseError("Bounded repeat is too large.");
         }
 
-        // Store the current length of the literal; in this repeat's post()
+        // Store the current length of the sequence; in this repeat's post()
         // call we will append N-1 more copies of [index..end].
-        repeat_stack.push(lit.length());
+        repeat_stack.push(seq.size());
     }
 
     void post(const ComponentRepeat &c) override {
-        // Add N-1 copies of the string between the entry to the repeat and the
-        // current end of the literal.
+        // Add N-1 copies of the classes between the entry to the repeat and
+        // the current end of the sequence.
         assert(!repeat_stack.empty());
-        const ue2_literal suffix = lit.substr(repeat_stack.top());
+        const vector<CharReach> suffix(seq.begin() + repeat_stack.top(),
+                                       seq.end());
         repeat_stack.pop();
 
         for (unsigned i = 1; i < c.m_min; i++) {
-            lit += suffix;
+            seq.insert(seq.end(), suffix.begin(), suffix.end());
         }
     }
 
@@ -115,7 +139,6 @@ public:
     void pre(const ComponentAssertion &) override { throw NotLiteral(); }
     void pre(const ComponentAtomicGroup &) override { throw NotLiteral(); }
     void pre(const ComponentBackReference &) override { throw NotLiteral(); }
-    void pre(const ComponentBoundary &) override { throw NotLiteral(); }
     void pre(const ComponentByte &) override { throw NotLiteral(); }
     void pre(const ComponentCondReference &) override { throw NotLiteral(); }
     void pre(const ComponentEmpty &) override { throw NotLiteral(); }
@@ -152,12 +175,64 @@ public:
     void post(const ComponentWordBoundary &) override {}
     void post(const UTF8ComponentClass &) override {}
 
-    ue2_literal lit;
+    bool end_anchored() const { return dec.eod || dec.eod_lf; }
+
+    vector<CharReach> seq; //!< one class per literal position
+    LiteralDecoration dec; //!< anchors seen; bounds are filled in later
     stack<size_t> repeat_stack; //!< index of entry to repeat.
 };
 
 ConstructLiteralVisitor::~ConstructLiteralVisitor() {}
 
+/** \brief Largest number of literals that a sequence of classes will be
+ * expanded into. */
+static const size_t MAX_SHORTCUT_LITERALS = 8;
+
+/**
+ * \brief Expands a sequence of classes into the set of literals it matches.
+ *
+ * If \a nocase is true, a letter present in both cases becomes one caseless
+ * character; otherwise each case is a separate literal. Returns false if there
+ * would be more than \ref MAX_SHORTCUT_LITERALS literals.
+ */
+static
+bool expandLiterals(const vector<CharReach> &seq, bool nocase,
+                    vector<ue2_literal> &lits) {
+    lits.assign(1, ue2_literal());
+
+    vector<ue2_literal::elem> chars;
+    for (const CharReach &cr : seq) {
+        chars.clear();
+        for (size_t c = cr.find_first(); c != CharReach::npos;
+             c = cr.find_next(c)) {
+            if (nocase && ourisalpha(c) && cr.test(mytoupper(c)) &&
+                cr.test(mytolower(c))) {
+                if (myisupper(c)) {
+                    chars.emplace_back(c, true);
+                }
+                continue;
+            }
+            chars.emplace_back(c, false);
+        }
+
+        if (lits.size() * chars.size() > MAX_SHORTCUT_LITERALS) {
+            DEBUG_PRINTF("too many literals\n");
+            return false;
+        }
+
+        vector<ue2_literal> next;
+        for (const auto &lit : lits) {
+            for (const auto &e : chars) {
+                next.push_back(lit);
+                next.back().push_back(e);
+            }
+        }
+        lits.swap(next);
+    }
+
+    return true;
+}
+
 /** \brief True if the literal expression \a expr could be added to Rose. */
 bool shortcutLiteral(NG &ng, const ParsedExpression &expr) {
     assert(expr.component);
@@ -166,9 +241,8 @@ bool shortcutLiteral(NG &ng, const ParsedExpression &expr) {
         return false;
     }
 
-    // XXX: don't shortcut literals with extended params (yet)
-    if (expr.min_offset || expr.max_offset != MAX_OFFSET || expr.min_length) {
-        DEBUG_PRINTF("extended params not allowed\n");
+    // Approximate matches are found by the fuzzed graph.
+    if (expr.edit_distance) {
         return false;
     }
 
@@ -182,20 +256,37 @@ bool shortcutLiteral(NG &ng, const ParsedExpression &expr) {
         return false;
     }
 
-    const ue2_literal &lit = vis.lit;
+    const vector<CharReach> &seq = vis.seq;
 
-    if (lit.empty()) {
+    if (seq.empty()) {
         DEBUG_PRINTF("empty literal\n");
         return false;
     }
 
-    if (expr.highlander && lit.length() <= 1) {
+    if (expr.highlander && seq.size() <= 1) {
         DEBUG_PRINTF("not shortcutting SEP literal\n");
         return false;
     }
 
-    DEBUG_PRINTF("constructed literal %s\n", dumpString(lit).c_str());
-    return ng.addLiteral(lit, expr.index, expr.id, expr.highlander, expr.som);
+    // Rose can't take literals of mixed case sensitivity, so those are split
+    // into case-sensitive literals instead.
+    vector<ue2_literal> lits;
+    if (!expandLiterals(seq, true, lits)) {
+        return false;
+    }
+    if (mixed_sensitivity(lits.front()) && !expandLiterals(seq, false, lits)) {
+        return false;
+    }
+
+    LiteralDecoration dec = vis.dec;
+    dec.min_offset = expr.min_offset;
+    dec.max_offset = expr.max_offset;
+    dec.min_length = expr.min_length;
+
+    DEBUG_PRINTF("constructed %zu literals, first %s\n", lits.size(),
+                 dumpString(lits.front()).c_str());
+    return ng.addLiterals(lits, expr.index, expr.id, expr.highlander, expr.som,
+                          dec);
 }
 
 } // namespace ue2
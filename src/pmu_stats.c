@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: optional hardware performance counters for runtime phases.
+ */
+
+#ifdef PMU_STATS
+#define _GNU_SOURCE // for syscall()
+#endif
+
+#include "pmu_stats.h"
+#include "hs_internal.h"
+#include "hs_runtime.h"
+#include "scratch.h"
+#include "ue2common.h"
+
+#include <string.h>
+
+#ifdef PMU_STATS
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/** \brief The events counted, in hs_pmu_phase_stats_t order. */
+static const struct {
+    u32 type;
+    u64a config;
+} pmu_events[PMU_EVENT_COUNT] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+static
+int openEvent(u32 type, u64a config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    /* this thread, any CPU */
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static
+long currentThread(void) {
+    return (long)syscall(SYS_gettid);
+}
+
+void pmuInit(struct hs_scratch *scratch) {
+    struct pmu_stats *p = &scratch->pmu;
+    memset(p, 0, sizeof(*p));
+    for (u32 i = 0; i < PMU_EVENT_COUNT; i++) {
+        p->fd[i] = -1;
+        p->slot[i] = -1;
+    }
+}
+
+void pmuClose(struct hs_scratch *scratch) {
+    struct pmu_stats *p = &scratch->pmu;
+    for (u32 i = 0; i < PMU_EVENT_COUNT; i++) {
+        if (p->fd[i] >= 0) {
+            close(p->fd[i]);
+        }
+        p->fd[i] = -1;
+        p->slot[i] = -1;
+    }
+    p->open_count = 0;
+    p->tid = 0;
+}
+
+/** \brief Open the event group for the calling thread. Events that the system
+ * cannot provide are skipped. */
+static
+void pmuOpen(struct hs_scratch *scratch, long tid) {
+    struct pmu_stats *p = &scratch->pmu;
+    pmuClose(scratch);
+    p->tid = tid;
+
+    int leader = -1;
+    for (u32 i = 0; i < PMU_EVENT_COUNT; i++) {
+        int fd = openEvent(pmu_events[i].type, pmu_events[i].config, leader);
+        if (fd < 0) {
+            DEBUG_PRINTF("unable to open event %u\n", i);
+            continue;
+        }
+        if (leader < 0) {
+            leader = fd;
+        }
+        p->fd[i] = fd;
+        p->slot[i] = (s8)p->open_count++;
+    }
+}
+
+/** \brief Group leader fd, or -1 if no events are open. */
+static really_inline
+int leaderFd(const struct pmu_stats *p) {
+    for (u32 i = 0; i < PMU_EVENT_COUNT; i++) {
+        if (p->slot[i] == 0) {
+            return p->fd[i];
+        }
+    }
+    return -1;
+}
+
+static
+void pmuRead(const struct pmu_stats *p, struct pmu_snapshot *snap) {
+    memset(snap, 0, sizeof(*snap));
+
+    int fd = leaderFd(p);
+    if (fd < 0) {
+        return;
+    }
+
+    /* PERF_FORMAT_GROUP: the number of events, then each value */
+    u64a buf[1 + PMU_EVENT_COUNT];
+    ssize_t len = read(fd, buf, sizeof(buf));
+    if (len < (ssize_t)sizeof(u64a) || buf[0] != p->open_count) {
+        return;
+    }
+
+    for (u32 i = 0; i < PMU_EVENT_COUNT; i++) {
+        if (p->slot[i] >= 0) {
+            snap->v[i] = buf[1 + p->slot[i]];
+        }
+    }
+}
+
+void pmuSnapshot(struct hs_scratch *scratch, struct pmu_snapshot *snap) {
+    if (!scratch) {
+        return;
+    }
+
+    struct pmu_stats *p = &scratch->pmu;
+
+    /* A scratch may be used by different threads over its lifetime, and perf
+     * events only count the thread they were opened for. */
+    long tid = currentThread();
+    if (p->tid != tid) {
+        pmuOpen(scratch, tid);
+    }
+
+    pmuRead(p, snap);
+}
+
+void pmuAccumulate(struct hs_scratch *scratch, u32 phase,
+                   const struct pmu_snapshot *start) {
+    assert(phase < HS_PMU_PHASE_COUNT);
+    if (!scratch) {
+        return;
+    }
+
+    struct pmu_stats *p = &scratch->pmu;
+
+    struct pmu_snapshot end;
+    pmuRead(p, &end);
+
+    p->calls[phase]++;
+    for (u32 i = 0; i < PMU_EVENT_COUNT; i++) {
+        p->count[phase][i] += end.v[i] - start->v[i];
+    }
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_pmu_stats(const hs_scratch_t *scratch,
+                                hs_pmu_stats_t *stats) {
+    if (!stats || !scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+
+    const struct pmu_stats *p = &scratch->pmu;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->available = p->open_count ? 1 : 0;
+    for (u32 i = 0; i < HS_PMU_PHASE_COUNT; i++) {
+        hs_pmu_phase_stats_t *ps = &stats->phase[i];
+        ps->calls = p->calls[i];
+        ps->cycles = p->count[i][0];
+        ps->instructions = p->count[i][1];
+        ps->l1d_misses = p->count[i][2];
+        ps->llc_misses = p->count[i][3];
+        ps->branch_misses = p->count[i][4];
+    }
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_pmu_reset(hs_scratch_t *scratch) {
+    if (!scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    if (markScratchInUse(scratch)) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    struct pmu_stats *p = &scratch->pmu;
+    memset(p->calls, 0, sizeof(p->calls));
+    memset(p->count, 0, sizeof(p->count));
+
+    unmarkScratchInUse(scratch);
+    return HS_SUCCESS;
+}
+
+#else // PMU_STATS
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_pmu_stats(UNUSED const hs_scratch_t *scratch,
+                                UNUSED hs_pmu_stats_t *stats) {
+    return HS_INVALID;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_pmu_reset(UNUSED hs_scratch_t *scratch) {
+    return HS_INVALID;
+}
+
+#endif // PMU_STATS
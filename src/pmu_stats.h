@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: optional hardware performance counters for runtime phases.
+ *
+ * When the library is configured with PMU_STATS, the major phases of a scan
+ * (literal matching, catch-up, engine execution and the small write engine)
+ * are bracketed by reads of a group of Linux perf events, and the deltas are
+ * accumulated in scratch for hs_scratch_pmu_stats(). In other builds, the
+ * hooks here compile away to nothing.
+ */
+
+#ifndef PMU_STATS_H
+#define PMU_STATS_H
+
+#include "scratch.h"
+#include "ue2common.h"
+
+#ifdef PMU_STATS
+
+/** \brief Event counter values read at the start of a phase. */
+struct pmu_snapshot {
+    u64a v[PMU_EVENT_COUNT];
+};
+
+/** \brief Read the current counter values into \a snap, opening the events
+ * for the calling thread if necessary. \a scratch may be NULL for engines run
+ * outside a scan, in which case nothing is counted. */
+void pmuSnapshot(struct hs_scratch *scratch, struct pmu_snapshot *snap);
+
+/** \brief Add the counts since \a start to the totals for \a phase. */
+void pmuAccumulate(struct hs_scratch *scratch, u32 phase,
+                   const struct pmu_snapshot *start);
+
+/** \brief Reset the per-scratch counter state; used when scratch is
+ * allocated. Does not close any events. */
+void pmuInit(struct hs_scratch *scratch);
+
+/** \brief Close any events opened for this scratch. */
+void pmuClose(struct hs_scratch *scratch);
+
+#define PMU_PHASE_BEGIN(scratch, snap)                                         \
+    struct pmu_snapshot snap;                                                  \
+    pmuSnapshot(scratch, &snap)
+
+#define PMU_PHASE_END(scratch, phase, snap) pmuAccumulate(scratch, phase, &snap)
+
+#define PMU_INIT(scratch) pmuInit(scratch)
+#define PMU_CLOSE(scratch) pmuClose(scratch)
+
+#else // PMU_STATS
+
+#define PMU_PHASE_BEGIN(scratch, snap) do { } while (0)
+#define PMU_PHASE_END(scratch, phase, snap) do { } while (0)
+#define PMU_INIT(scratch) do { } while (0)
+#define PMU_CLOSE(scratch) do { } while (0)
+
+#endif // PMU_STATS
+
+#endif // PMU_STATS_H
@@ -37,12 +37,15 @@
 #include "hs_runtime.h"
 #include "scratch.h"
 #include "ue2common.h"
+#include "backtrack/backtrack.h"
 #include "nfa/callback.h"
 #include "nfa/nfa_internal.h"
 #include "rose/runtime.h"
 #include "som/som_runtime.h"
+#include "util/bitutils.h"
 #include "util/exhaust.h"
 #include "util/fatbit.h"
+#include "util/unaligned.h"
 
 enum DedupeResult {
     DEDUPE_CONTINUE, //!< Continue with match, not a dupe.
@@ -66,11 +69,22 @@ enum DedupeResult dedupeCatchup(const struct RoseEngine *rose,
     if (offset != deduper->current_report_offset) {
         assert(deduper->current_report_offset == ~0ULL ||
                deduper->current_report_offset < offset);
+        /* only logs that have had a dkey set need clearing; databases with
+         * no dkeys (SOM catch-up only) never touch them */
         if (offset == deduper->current_report_offset + 1) {
-            fatbit_clear(deduper->log[offset % 2]);
+            u8 bit = 1U << (offset % 2);
+            if (deduper->log_dirty & bit) {
+                fatbit_clear(deduper->log[offset % 2], rose->dkeyCount);
+                deduper->log_dirty &= ~bit;
+            }
         } else {
-            fatbit_clear(deduper->log[0]);
-            fatbit_clear(deduper->log[1]);
+            if (deduper->log_dirty & 1) {
+                fatbit_clear(deduper->log[0], rose->dkeyCount);
+            }
+            if (deduper->log_dirty & 2) {
+                fatbit_clear(deduper->log[1], rose->dkeyCount);
+            }
+            deduper->log_dirty = 0;
         }
 
         if (do_som && flushStoredSomMatches(scratch, offset)) {
@@ -84,6 +98,7 @@ enum DedupeResult dedupeCatchup(const struct RoseEngine *rose,
         if (is_external_report || quash_som) {
             DEBUG_PRINTF("checking dkey %u at offset %llu\n", dkey, to_offset);
             assert(offset_adjust == 0 || offset_adjust == -1);
+            deduper->log_dirty |= 1U << (to_offset % 2);
             if (fatbit_set(deduper->log[to_offset % 2], dkeyCount, dkey)) {
                 /* we have already raised this report at this offset, squash
                  * dupe match. */
@@ -144,6 +159,55 @@ void markAsMatched(const struct RoseEngine *rose, char *evec, u32 ekey) {
     mmbit_set((u8 *)evec, rose->ekeyCount, ekey);
 }
 
+/**
+ * \brief Turn off the literal groups that can now only lead to exhausted
+ * reports, as key \a ekey has just been set.
+ *
+ * Their literals would only be rejected by exhaustion checks later, so this
+ * just saves literal matcher and program work on the rest of the stream.
+ */
+static really_inline
+void roseSquashExhaustedGroups(const struct RoseEngine *rose,
+                               struct hs_scratch *scratch, u32 ekey) {
+    if (!rose->ekeyGroupsOffset) {
+        return;
+    }
+
+    assert(ekey < rose->ekeyCount);
+    const rose_group *ekey_groups =
+        (const rose_group *)((const char *)rose + rose->ekeyGroupsOffset);
+    rose_group groups = ekey_groups[ekey] & scratch->tctxt.groups;
+    if (!groups) {
+        return;
+    }
+
+    const u32 *group_idx =
+        (const u32 *)((const char *)rose + rose->groupEkeysOffset);
+    const u32 *group_ekeys = group_idx + sizeof(rose_group) * 8 + 1;
+    const char *evec = scratch->core_info.exhaustionVector;
+    while (groups) {
+        u32 g = findAndClearLSB_64(&groups);
+        u32 i = group_idx[g];
+        const u32 end = group_idx[g + 1];
+        while (i < end && isExhausted(rose, evec, group_ekeys[i])) {
+            i++;
+        }
+        if (i == end) {
+            DEBUG_PRINTF("group %u is exhausted, turning it off\n", g);
+            scratch->tctxt.groups &= ~(1ULL << g);
+        }
+    }
+}
+
+/** \brief Mark key \a ekey on in the exhaustion vector and turn off any
+ * literal groups that only lead to exhausted reports. */
+static really_inline
+void roseMarkExhausted(const struct RoseEngine *rose,
+                       struct hs_scratch *scratch, u32 ekey) {
+    markAsMatched(rose, scratch->core_info.exhaustionVector, ekey);
+    roseSquashExhaustedGroups(rose, scratch, ekey);
+}
+
 /** \brief Clear all keys in the exhaustion vector. */
 static really_inline
 void clearEvec(const struct RoseEngine *rose, char *evec) {
@@ -151,6 +215,65 @@ void clearEvec(const struct RoseEngine *rose, char *evec) {
     mmbit_clear((u8 *)evec, rose->ekeyCount);
 }
 
+/** \brief Clear all keys in the logical vector. */
+static really_inline
+void clearLvec(const struct RoseEngine *rose, char *lvec) {
+    DEBUG_PRINTF("clearing lvec %p %u\n", lvec, rose->lkeyCount);
+    mmbit_clear((u8 *)lvec, rose->lkeyCount);
+}
+
+/** \brief Clear all keys in the combination vector and its active set. */
+static really_inline
+void clearCvec(const struct RoseEngine *rose, char *cvec, char *active) {
+    DEBUG_PRINTF("clearing cvec %p %u\n", cvec, rose->ckeyCount);
+    mmbit_clear((u8 *)cvec, rose->ckeyCount);
+    mmbit_clear((u8 *)active, rose->ckeyCount);
+}
+
+/** \brief Zero the match counters for reports with a match limit. */
+static really_inline
+void clearMatchCounts(const struct RoseEngine *rose, char *state) {
+    memset(state + rose->stateOffsets.matchCounts, 0,
+           rose->matchLimitCount * sizeof(u32));
+}
+
+/**
+ * \brief Count a match against match counter \a key.
+ *
+ * Returns non-zero if this match brings the count up to \a limit, after which
+ * no more matches should be reported.
+ */
+static really_inline
+int roseCountMatch(const struct RoseEngine *rose, struct hs_scratch *scratch,
+                   u32 key, u32 limit) {
+    assert(key < rose->matchLimitCount);
+    char *c = scratch->core_info.state + rose->stateOffsets.matchCounts +
+              key * sizeof(u32);
+    u32 count = unaligned_load_u32(c) + 1;
+    assert(count <= limit);
+    unaligned_store_u32(c, count);
+    DEBUG_PRINTF("match counter %u is now %u/%u\n", key, count, limit);
+    return count == limit;
+}
+
+/**
+ * \brief Run confirm program \a key for a match ending at \a end.
+ *
+ * Returns non-zero if the match is confirmed and should be reported.
+ */
+static really_inline
+char roseCheckConfirm(const struct RoseEngine *rose,
+                      const struct hs_scratch *scratch, u32 key, u64a end) {
+    assert(key < rose->confirmCount);
+    const char *table = (const char *)rose + rose->confirmOffset;
+    const u32 *offsets = (const u32 *)table;
+    const struct BacktrackProgram *prog =
+        (const struct BacktrackProgram *)(table + offsets[key]);
+    const struct core_info *ci = &scratch->core_info;
+    return btConfirm(prog, ci->hbuf, ci->hlen, ci->buf, ci->len,
+                     ci->buf_offset, end);
+}
+
 /**
  * \brief Deliver the given report to the user callback.
  *
@@ -183,16 +306,26 @@ int roseDeliverReport(u64a offset, ReportID onmatch, s32 offset_adjust,
     DEBUG_PRINTF(">> reporting match @[%llu,%llu] for sig %u ctxt %p <<\n",
                  from_offset, to_offset, onmatch, ci->userContext);
 
-    int halt = ci->userCallback(onmatch, from_offset, to_offset, flags,
-                                ci->userContext);
-    if (halt) {
+    if (!patternMaskAllows(scratch, onmatch)) {
+        DEBUG_PRINTF("pattern %u is masked off\n", onmatch);
+        return ROSE_CONTINUE_MATCHING_NO_EXHAUST;
+    }
+
+    if (!matchInWindow(ci, to_offset)) {
+        DEBUG_PRINTF("match outside offset window\n");
+        return ROSE_CONTINUE_MATCHING_NO_EXHAUST;
+    }
+
+    int halt = deliverUserMatch(ci, onmatch, from_offset, to_offset, flags,
+                                roseMatchUserData(ci->rose, onmatch));
+    if (halt || ci->rose->anyMatch) {
         DEBUG_PRINTF("callback requested to terminate matches\n");
         ci->status |= STATUS_TERMINATED;
         return MO_HALT_MATCHING;
     }
 
     if (ekey != INVALID_EKEY) {
-        markAsMatched(ci->rose, ci->exhaustionVector, ekey);
+        roseMarkExhausted(ci->rose, scratch, ekey);
         return MO_CONTINUE_MATCHING;
     } else {
         return ROSE_CONTINUE_MATCHING_NO_EXHAUST;
@@ -232,17 +365,27 @@ int roseDeliverSomReport(u64a from_offset, u64a to_offset, ReportID onmatch,
     DEBUG_PRINTF(">> reporting match @[%llu,%llu] for sig %u ctxt %p <<\n",
                  from_offset, to_offset, onmatch, ci->userContext);
 
-    int halt = ci->userCallback(onmatch, from_offset, to_offset, flags,
-                                ci->userContext);
+    if (!patternMaskAllows(scratch, onmatch)) {
+        DEBUG_PRINTF("pattern %u is masked off\n", onmatch);
+        return ROSE_CONTINUE_MATCHING_NO_EXHAUST;
+    }
+
+    if (!matchInWindow(ci, to_offset)) {
+        DEBUG_PRINTF("match outside offset window\n");
+        return ROSE_CONTINUE_MATCHING_NO_EXHAUST;
+    }
+
+    int halt = deliverUserMatch(ci, onmatch, from_offset, to_offset, flags,
+                                roseMatchUserData(ci->rose, onmatch));
 
-    if (halt) {
+    if (halt || ci->rose->anyMatch) {
         DEBUG_PRINTF("callback requested to terminate matches\n");
         ci->status |= STATUS_TERMINATED;
         return MO_HALT_MATCHING;
     }
 
     if (ekey != INVALID_EKEY) {
-        markAsMatched(ci->rose, ci->exhaustionVector, ekey);
+        roseMarkExhausted(ci->rose, scratch, ekey);
         return MO_CONTINUE_MATCHING;
     } else {
         return ROSE_CONTINUE_MATCHING_NO_EXHAUST;
@@ -27,6 +27,7 @@
  */
 
 #include "catchup.h"
+#include "catchup_pq.h"
 #include "init.h"
 #include "match.h"
 #include "program_runtime.h"
@@ -36,7 +37,9 @@
 #include "nfa/nfa_internal.h"
 #include "nfa/nfa_rev_api.h"
 #include "nfa/mcclellan.h"
+#include "nfa/sheng.h"
 #include "util/fatbit.h"
+#include "pmu_stats.h"
 
 static rose_inline
 void runAnchoredTableBlock(const struct RoseEngine *t, const void *atable,
@@ -58,8 +61,11 @@ void runAnchoredTableBlock(const struct RoseEngine *t, const void *atable,
             const u8 *local_buffer = buffer + curr->anchoredMinDistance;
 
             DEBUG_PRINTF("--anchored nfa (+%u)\n", curr->anchoredMinDistance);
-            assert(isMcClellanType(nfa->type));
-            if (nfa->type == MCCLELLAN_NFA_8) {
+            assert(isMcClellanType(nfa->type) || nfa->type == SHENG_NFA_0);
+            if (nfa->type == SHENG_NFA_0) {
+                nfaExecSheng0_B(nfa, curr->anchoredMinDistance, local_buffer,
+                                local_alen, roseAnchoredCallback, scratch);
+            } else if (nfa->type == MCCLELLAN_NFA_8) {
                 nfaExecMcClellan8_B(nfa, curr->anchoredMinDistance,
                                     local_buffer, local_alen,
                                     roseAnchoredCallback, scratch);
@@ -139,7 +145,7 @@ void init_for_block(const struct RoseEngine *t, struct hs_scratch *scratch,
 
     struct RoseContext *tctxt = &scratch->tctxt;
 
-    tctxt->groups = t->initialGroups;
+    tctxt->groups = t->initialGroups & patternMaskGroups(scratch);
     tctxt->lit_offset_adjust = 1; // index after last byte
     tctxt->delayLastEndOffset = 0;
     tctxt->lastEndOffset = 0;
@@ -151,9 +157,9 @@ void init_for_block(const struct RoseEngine *t, struct hs_scratch *scratch,
 
     scratch->al_log_sum = 0;
 
-    fatbit_clear(scratch->aqa);
+    fatbit_clear(scratch->aqa, t->queueCount);
 
-    scratch->catchup_pq.qm_size = 0;
+    catchupPqReset(&scratch->catchup_pq);
 
     init_outfixes_for_block(t, scratch, state, is_small_block);
 }
@@ -257,8 +263,10 @@ int roseBlockFloating(const struct RoseEngine *t, struct hs_scratch *scratch) {
 
     DEBUG_PRINTF("BEGIN FLOATING (over %zu/%zu)\n", flen, length);
     DEBUG_PRINTF("-- %016llx\n", tctxt->groups);
+    PMU_PHASE_BEGIN(scratch, pmu);
     hwlmExec(ftable, buffer, flen, t->floatingMinDistance, roseFloatingCallback,
              scratch, tctxt->groups & t->floating_group_mask);
+    PMU_PHASE_END(scratch, HS_PMU_PHASE_LITERAL_MATCHER, pmu);
 
     return can_stop_matching(scratch);
 }
@@ -300,6 +308,14 @@ void runEagerPrefixesBlock(const struct RoseEngine *t,
              * we can immediately squash/ */
             mmbit_unset(ara, arCount, ri);
             scratch->tctxt.groups &= left->squash_mask;
+            continue;
+        }
+
+        if (!(scratch->tctxt.groups & ~left->squash_mask)) {
+            /* an earlier eager prefix has already squashed everything this one
+             * could; leave it to be run lazily if it is ever checked */
+            DEBUG_PRINTF("leftfix %u has nothing left to squash\n", ri);
+            continue;
         }
 
         s64a loc = MIN(scratch->core_info.len, EAGER_STOP_OFFSET);
@@ -307,9 +323,9 @@ void runEagerPrefixesBlock(const struct RoseEngine *t,
         fatbit_set(scratch->aqa, qCount, qi);
         initRoseQueue(t, qi, left, scratch);
 
-        pushQueueAt(q, 0, MQE_START, 0);
-        pushQueueAt(q, 1, MQE_TOP, 0);
-        pushQueueAt(q, 2, MQE_END, loc);
+        const struct mq_item seed[] = {
+            {MQE_START, 0, 0}, {MQE_TOP, 0, 0}, {MQE_END, loc, 0}};
+        pushQueueItems(q, seed, ARRAY_LENGTH(seed));
         nfaQueueInitState(nfa, q);
 
         char alive = nfaQueueExecToMatch(q->nfa, q, loc);
@@ -378,6 +394,13 @@ void roseBlockExec(const struct RoseEngine *t, struct hs_scratch *scratch) {
 
     init_for_block(t, scratch, state, is_small_block);
 
+    // With unordered delivery, outfixes have already reported their matches
+    // and may have been told to stop.
+    if (can_stop_matching(scratch)) {
+        DEBUG_PRINTF("stopped by outfix matches\n");
+        return;
+    }
+
     struct RoseContext *tctxt = &scratch->tctxt;
 
     if (is_small_block) {
@@ -388,8 +411,10 @@ void roseBlockExec(const struct RoseEngine *t, struct hs_scratch *scratch) {
 
         DEBUG_PRINTF("BEGIN SMALL BLOCK (over %zu/%zu)\n", sblen, length);
         DEBUG_PRINTF("-- %016llx\n", tctxt->groups);
+        PMU_PHASE_BEGIN(scratch, pmu);
         hwlmExec(sbtable, scratch->core_info.buf, sblen, 0, roseCallback,
                  scratch, tctxt->groups);
+        PMU_PHASE_END(scratch, HS_PMU_PHASE_LITERAL_MATCHER, pmu);
     } else {
         runEagerPrefixesBlock(t, scratch);
 
@@ -32,6 +32,7 @@
  */
 
 #include "catchup.h"
+#include "catchup_pq.h"
 #include "match.h"
 #include "program_runtime.h"
 #include "rose.h"
@@ -40,12 +41,8 @@
 #include "som/som_runtime.h"
 #include "util/fatbit.h"
 #include "report.h"
-
-typedef struct queue_match PQ_T;
-#define PQ_COMP(pqc_items, a, b) ((pqc_items)[a].loc < (pqc_items)[b].loc)
-#define PQ_COMP_B(pqc_items, a, b_fixed) ((pqc_items)[a].loc < (b_fixed).loc)
-
-#include "util/pqueue.h"
+#include "pmu_stats.h"
+#include "tracepoints.h"
 
 static really_inline
 int roseNfaRunProgram(const struct RoseEngine *rose, struct hs_scratch *scratch,
@@ -126,42 +123,30 @@ void pq_replace_top_with(struct catchup_pq *pq,
                          UNUSED struct hs_scratch *scratch, u32 queue,
                          s64a loc) {
     DEBUG_PRINTF("inserting q%u in pq at %lld\n", queue, loc);
-    struct queue_match temp = {
-        .queue = queue,
-        .loc = (size_t)loc
-    };
-
     assert(loc > 0);
     assert(pq->qm_size);
     assert(loc <= (s64a)scratch->core_info.len);
-    pq_replace_top(pq->qm, pq->qm_size, temp);
+    catchupPqReplaceTop(pq, queue, (size_t)loc);
 }
 
 static really_inline
 void pq_insert_with(struct catchup_pq *pq,
                     UNUSED struct hs_scratch *scratch, u32 queue, s64a loc) {
     DEBUG_PRINTF("inserting q%u in pq at %lld\n", queue, loc);
-    struct queue_match temp = {
-        .queue = queue,
-        .loc = (size_t)loc
-    };
-
     assert(loc > 0);
     assert(loc <= (s64a)scratch->core_info.len);
-    pq_insert(pq->qm, pq->qm_size, temp);
-    ++pq->qm_size;
+    catchupPqInsert(pq, queue, (size_t)loc);
 }
 
 static really_inline
 void pq_pop_nice(struct catchup_pq *pq) {
-    pq_pop(pq->qm, pq->qm_size);
-    pq->qm_size--;
+    catchupPqPop(pq);
 }
 
 static really_inline
 s64a pq_top_loc(struct catchup_pq *pq) {
     assert(pq->qm_size);
-    return (s64a)pq_top(pq->qm)->loc;
+    return (s64a)catchupPqMinLoc(pq);
 }
 
 /* requires that we are the top item on the pq */
@@ -170,7 +155,7 @@ hwlmcb_rv_t runExistingNfaToNextMatch(const struct RoseEngine *t, u32 qi,
                                       struct mq *q, s64a loc,
                                       struct hs_scratch *scratch, u8 *aa,
                                       char report_curr) {
-    assert(pq_top(scratch->catchup_pq.qm)->queue == qi);
+    assert(catchupPqTop(&scratch->catchup_pq)->queue == qi);
     assert(scratch->catchup_pq.qm_size);
     assert(!q->report_current);
     if (report_curr) {
@@ -339,18 +324,8 @@ static really_inline
 s64a findSecondPlace(struct catchup_pq *pq, s64a loc_limit) {
     assert(pq->qm_size); /* we are still on the pq and we are first place */
 
-    /* we know (*cough* encapsulation) that second place will either be in
-     * pq->qm[1] or pq->qm[2] (we are pq->qm[0]) */
-    switch (pq->qm_size) {
-    case 0:
-    case 1:
-        return (s64a)loc_limit;
-    case 2:
-        return MIN((s64a)pq->qm[1].loc, loc_limit);
-    default:;
-        size_t best = MIN(pq->qm[1].loc, pq->qm[2].loc);
-        return MIN((s64a)best, loc_limit);
-    }
+    assert(loc_limit >= 0);
+    return (s64a)catchupPqSecondLoc(pq, (size_t)loc_limit);
 }
 
 hwlmcb_rv_t roseCatchUpMPV_i(const struct RoseEngine *t, s64a loc,
@@ -494,6 +469,33 @@ char blast_queue(struct hs_scratch *scratch, struct mq *q, u32 qi, s64a to_loc,
     return alive;
 }
 
+/**
+ * \brief Runs an outfix to the end of the buffer, delivering its matches
+ * directly rather than adding it to the priority queue. Used by databases that
+ * permit unordered delivery.
+ */
+static really_inline
+hwlmcb_rv_t blastOutfix(const struct RoseEngine *t, u8 *aa, u32 qi,
+                        s64a length, struct hs_scratch *scratch) {
+    struct mq *q = scratch->queues + qi;
+    char alive = blast_queue(scratch, q, qi, length, 0);
+
+    if (!alive) {
+        if (can_stop_matching(scratch)) {
+            DEBUG_PRINTF("bailing\n");
+            return HWLM_TERMINATE_MATCHING;
+        }
+        deactivateQueue(t, aa, qi, scratch);
+    } else {
+        assert(q->cur == q->end);
+        DEBUG_PRINTF("queue %u finished, nfa lives\n", qi);
+        q->cur = q->end = 0;
+        pushQueueAt(q, 0, MQE_START, length);
+    }
+
+    return HWLM_CONTINUE_MATCHING;
+}
+
 static really_inline
 hwlmcb_rv_t buildSufPQ_final(const struct RoseEngine *t, s64a report_ok_loc,
                              s64a second_place_loc, s64a final_loc,
@@ -582,6 +584,15 @@ void streamInitSufPQ(const struct RoseEngine *t, char *state,
         ensureQueueActive(t, qi, qCount, q, scratch);
         ensureEnd(q, qi, length);
 
+        if (t->unorderedMatches) {
+            if (blastOutfix(t, aa, qi, length, scratch)
+                == HWLM_TERMINATE_MATCHING) {
+                return;
+            }
+            qi = mmbit_iterate_bounded(aa, aaCount, qi + 1, t->outfixEndQueue);
+            continue;
+        }
+
         char alive = nfaQueueExecToMatch(q->nfa, q, length);
 
         if (alive == MO_MATCHES_PENDING) {
@@ -640,9 +651,17 @@ void blockInitSufPQ(const struct RoseEngine *t, char *state,
         initQueue(q, qi, t, scratch);
         q->length = len; /* adjust for rev_accel */
         nfaQueueInitState(nfa, q);
-        pushQueueAt(q, 0, MQE_START, 0);
-        pushQueueAt(q, 1, MQE_TOP, 0);
-        pushQueueAt(q, 2, MQE_END, length);
+        const struct mq_item seed[] = {
+            {MQE_START, 0, 0}, {MQE_TOP, 0, 0}, {MQE_END, (s64a)length, 0}};
+        pushQueueItems(q, seed, ARRAY_LENGTH(seed));
+
+        if (t->unorderedMatches) {
+            if (blastOutfix(t, aa, qi, length, scratch)
+                == HWLM_TERMINATE_MATCHING) {
+                return;
+            }
+            continue;
+        }
 
         DEBUG_PRINTF("adding qi=%u to pq\n", qi);
 
@@ -766,7 +785,7 @@ hwlmcb_rv_t roseCatchUpNfas(const struct RoseEngine *t, s64a loc,
     /* fire off earliest nfa match and catchup anchored matches to that point */
     while (scratch->catchup_pq.qm_size) {
         s64a match_loc = pq_top_loc(&scratch->catchup_pq);
-        u32 qi = pq_top(scratch->catchup_pq.qm)->queue;
+        u32 qi = catchupPqTop(&scratch->catchup_pq)->queue;
 
         DEBUG_PRINTF("winrar q%u@%lld loc %lld\n", qi, match_loc, loc);
         assert(match_loc + scratch->core_info.buf_offset
@@ -845,7 +864,8 @@ exit:;
     return HWLM_CONTINUE_MATCHING;
 }
 
-hwlmcb_rv_t roseCatchUpAll(s64a loc, struct hs_scratch *scratch) {
+static really_inline
+hwlmcb_rv_t roseCatchUpAll_i(s64a loc, struct hs_scratch *scratch) {
     /* just need suf/outfixes and mpv */
     DEBUG_PRINTF("loc %lld mnmmo %llu mmo %llu\n", loc,
                  scratch->tctxt.minNonMpvMatchOffset,
@@ -873,6 +893,73 @@ hwlmcb_rv_t roseCatchUpAll(s64a loc, struct hs_scratch *scratch) {
     return rv;
 }
 
+hwlmcb_rv_t roseCatchUpAll(s64a loc, struct hs_scratch *scratch) {
+    HS_TRACE1(catchup_start, loc);
+    PMU_PHASE_BEGIN(scratch, pmu);
+    hwlmcb_rv_t rv = roseCatchUpAll_i(loc, scratch);
+    PMU_PHASE_END(scratch, HS_PMU_PHASE_CATCHUP, pmu);
+    HS_TRACE2(catchup_end, loc, rv);
+    return rv;
+}
+
+static never_inline
+hwlmcb_rv_t roseCatchUpUnordered_i(s64a loc, struct hs_scratch *scratch) {
+    const struct RoseEngine *t = scratch->core_info.rose;
+    assert(t->unorderedMatches);
+    assert(!has_chained_nfas(t));
+    assert(!scratch->catchup_pq.qm_size);
+
+    u8 *aa = getActiveLeafArray(t, scratch->core_info.state);
+    u32 aaCount = t->activeArrayCount;
+
+    /* outfixes ran to the end of the buffer when the scan began, so only
+     * suffixes are left; each runs to loc without waiting for the others */
+    for (u32 qi = mmbit_iterate_bounded(aa, aaCount, t->outfixEndQueue,
+                                        aaCount);
+         qi != MMB_INVALID; qi = mmbit_iterate(aa, aaCount, qi)) {
+        struct mq *q = scratch->queues + qi;
+        const struct NfaInfo *info = getNfaInfoByQueue(t, qi);
+
+        if (roseSuffixInfoIsExhausted(t, info,
+                                      scratch->core_info.exhaustionVector)) {
+            deactivateQueue(t, aa, qi, scratch);
+            continue;
+        }
+
+        ensureQueueActive(t, qi, t->queueCount, q, scratch);
+        if (unlikely(loc < q_cur_loc(q))) {
+            DEBUG_PRINTF("queue %u already at %lld\n", qi, q_cur_loc(q));
+            continue;
+        }
+        ensureEnd(q, qi, loc);
+
+        char alive = blast_queue(scratch, q, qi, loc, 0);
+        if (!alive) {
+            if (can_stop_matching(scratch)) {
+                DEBUG_PRINTF("bailing\n");
+                return HWLM_TERMINATE_MATCHING;
+            }
+            deactivateQueue(t, aa, qi, scratch);
+        } else {
+            assert(q->cur == q->end);
+            q->cur = q->end = 0;
+            pushQueueAt(q, 0, MQE_START, loc);
+        }
+    }
+
+    updateMinMatchOffset(&scratch->tctxt, scratch->core_info.buf_offset + loc);
+    return HWLM_CONTINUE_MATCHING;
+}
+
+hwlmcb_rv_t roseCatchUpUnordered(s64a loc, struct hs_scratch *scratch) {
+    HS_TRACE1(catchup_start, loc);
+    PMU_PHASE_BEGIN(scratch, pmu);
+    hwlmcb_rv_t rv = roseCatchUpUnordered_i(loc, scratch);
+    PMU_PHASE_END(scratch, HS_PMU_PHASE_CATCHUP, pmu);
+    HS_TRACE2(catchup_end, loc, rv);
+    return rv;
+}
+
 hwlmcb_rv_t roseCatchUpSuf(s64a loc, struct hs_scratch *scratch) {
     /* just need suf/outfixes. mpv will be caught up only to last reported
      * external match */
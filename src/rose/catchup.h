@@ -43,6 +43,11 @@
  * - (B) process the matches from the priority queue in order;
  * - (C) As we report matches from (B) we interleave matches from the MPV if it
  *       exists.
+ *
+ * Databases built with HS_MODE_UNORDERED skip all of this when they can:
+ * outfixes run to the end of the buffer as soon as the scan starts, and
+ * suffixes are only caught up when their queues fill and at the end of the
+ * buffer, each running on its own without a priority queue.
  */
 
 #ifndef ROSE_CATCHUP_H
@@ -58,6 +63,10 @@
 
 hwlmcb_rv_t roseCatchUpAll(s64a loc, struct hs_scratch *scratch);
 
+/* catches up suffixes without ordering their matches; for databases built
+ * with RoseEngine::unorderedMatches only */
+hwlmcb_rv_t roseCatchUpUnordered(s64a loc, struct hs_scratch *scratch);
+
 /* will only catch mpv up to last reported external match */
 hwlmcb_rv_t roseCatchUpSuf(s64a loc, struct hs_scratch *scratch);
 
@@ -141,6 +150,8 @@ hwlmcb_rv_t roseCatchUpTo(const struct RoseEngine *t,
         || !mmbit_any(getActiveLeafArray(t, state), t->activeArrayCount)) {
         updateMinMatchOffset(&scratch->tctxt, end);
         rv = HWLM_CONTINUE_MATCHING;
+    } else if (t->unorderedMatches) {
+        rv = roseCatchUpUnordered(loc, scratch);
     } else {
         rv = roseCatchUpAll(loc, scratch);
     }
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ * \brief Rose runtime: priority queue used to order engine catch up.
+ *
+ * Suffix and outfix queues are ordered by the location of their next match.
+ * Catch up pops them in almost monotone location order, so rather than a
+ * binary heap we use a radix heap: an entry lives in the bucket given by the
+ * highest bit in which its location differs from the last minimum, and only
+ * the lowest non-empty bucket is ever redistributed. Each entry moves down at
+ * most once per bit of the buffer length, the current minimum and second
+ * place are available in constant time, and all entries live in one array
+ * indexed by queue.
+ */
+
+#ifndef ROSE_CATCHUP_PQ_H
+#define ROSE_CATCHUP_PQ_H
+
+#include "scratch.h"
+#include "ue2common.h"
+#include "util/bitutils.h"
+
+#define CATCHUP_PQ_NONE (~0U)
+
+static really_inline
+void catchupPqReset(struct catchup_pq *pq) {
+    pq->qm_size = 0;
+    pq->nonempty = 0;
+    pq->last = 0;
+}
+
+static really_inline
+u32 catchupPqBucket(const struct catchup_pq *pq, size_t loc) {
+    assert(loc >= pq->last);
+    if (loc == pq->last) {
+        return 0;
+    }
+    u32 b = 64 - clz64((u64a)(loc ^ pq->last));
+    assert(b < CATCHUP_PQ_BUCKETS);
+    return b;
+}
+
+/** \brief Link the entry for \a queue (with its loc set) into its bucket. */
+static really_inline
+void catchupPqLink(struct catchup_pq *pq, u32 queue) {
+    struct queue_match *m = &pq->qm[queue];
+    u32 b = catchupPqBucket(pq, m->loc);
+    u64a bit = 1ULL << b;
+    if (pq->nonempty & bit) {
+        pq->bucket_min[b] = MIN(pq->bucket_min[b], m->loc);
+        m->next = pq->head[b];
+    } else {
+        pq->bucket_min[b] = m->loc;
+        m->next = CATCHUP_PQ_NONE;
+        pq->nonempty |= bit;
+    }
+    pq->head[b] = queue;
+}
+
+/**
+ * \brief Re-bucket every entry relative to location zero. Needed only when
+ * an entry is inserted before the last minimum, which happens at most once
+ * per catch up phase as new suffixes join the outfixes already queued.
+ */
+static never_inline
+void catchupPqRebase(struct catchup_pq *pq) {
+    u32 old_head[CATCHUP_PQ_BUCKETS];
+    u64a old_nonempty = pq->nonempty;
+    DEBUG_PRINTF("rebasing %u entries from %zu\n", pq->qm_size, pq->last);
+
+    for (u64a iter = old_nonempty; iter;) {
+        u32 b = findAndClearLSB_64(&iter);
+        old_head[b] = pq->head[b];
+    }
+
+    pq->nonempty = 0;
+    pq->last = 0;
+
+    for (u64a iter = old_nonempty; iter;) {
+        u32 b = findAndClearLSB_64(&iter);
+        for (u32 i = old_head[b]; i != CATCHUP_PQ_NONE;) {
+            u32 next = pq->qm[i].next;
+            catchupPqLink(pq, i);
+            i = next;
+        }
+    }
+}
+
+/**
+ * \brief Ensure that bucket zero holds the minimum entry, by redistributing
+ * the lowest non-empty bucket around its minimum if necessary.
+ */
+static really_inline
+void catchupPqNormalise(struct catchup_pq *pq) {
+    assert(pq->qm_size);
+    assert(pq->nonempty);
+    if (pq->nonempty & 1) {
+        return;
+    }
+
+    u32 b = ctz64(pq->nonempty);
+    u32 i = pq->head[b];
+    pq->nonempty &= ~(1ULL << b);
+    pq->last = pq->bucket_min[b];
+
+    /* Every entry in bucket b shares all bits above b - 1 with the new
+     * minimum, so each one moves to a lower bucket. */
+    while (i != CATCHUP_PQ_NONE) {
+        u32 next = pq->qm[i].next;
+        catchupPqLink(pq, i);
+        i = next;
+    }
+    assert(pq->nonempty & 1);
+}
+
+static really_inline
+void catchupPqInsert(struct catchup_pq *pq, u32 queue, size_t loc) {
+    if (unlikely(loc < pq->last)) {
+        catchupPqRebase(pq);
+    }
+    struct queue_match *m = &pq->qm[queue];
+    m->loc = loc;
+    m->queue = queue;
+    catchupPqLink(pq, queue);
+    pq->qm_size++;
+}
+
+static really_inline
+const struct queue_match *catchupPqTop(struct catchup_pq *pq) {
+    catchupPqNormalise(pq);
+    return &pq->qm[pq->head[0]];
+}
+
+static really_inline
+void catchupPqPop(struct catchup_pq *pq) {
+    catchupPqNormalise(pq);
+    u32 i = pq->head[0];
+    pq->head[0] = pq->qm[i].next;
+    if (pq->head[0] == CATCHUP_PQ_NONE) {
+        pq->nonempty &= ~1ULL;
+    }
+    pq->qm_size--;
+}
+
+/** \brief Replace the top entry, which must be for \a queue, with a new
+ * location. */
+static really_inline
+void catchupPqReplaceTop(struct catchup_pq *pq, u32 queue, size_t loc) {
+    assert(catchupPqTop(pq)->queue == queue);
+    catchupPqPop(pq);
+    catchupPqInsert(pq, queue, loc);
+}
+
+/** \brief Location of the minimum entry, without reorganising the queue. */
+static really_inline
+size_t catchupPqMinLoc(const struct catchup_pq *pq) {
+    assert(pq->qm_size);
+    if (pq->nonempty & 1) {
+        return pq->last;
+    }
+    return pq->bucket_min[ctz64(pq->nonempty)];
+}
+
+/** \brief Location of the entry after the top one, or \a limit if it is
+ * earlier or there is no such entry. */
+static really_inline
+size_t catchupPqSecondLoc(struct catchup_pq *pq, size_t limit) {
+    catchupPqNormalise(pq);
+    if (pq->qm[pq->head[0]].next != CATCHUP_PQ_NONE) {
+        return MIN(pq->last, limit);
+    }
+    u64a rest = pq->nonempty & ~1ULL;
+    if (!rest) {
+        return limit;
+    }
+    return MIN(pq->bucket_min[ctz64(rest)], limit);
+}
+
+#endif // ROSE_CATCHUP_PQ_H
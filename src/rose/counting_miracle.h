@@ -33,11 +33,12 @@
 #include "runtime.h"
 #include "rose_internal.h"
 #include "nfa/nfa_api_queue.h"
+#include "util/popcount.h"
 #include "util/simd_utils.h"
 
 /** \brief Maximum number of bytes to scan when looking for a "counting miracle"
  * stop character. */
-#define COUNTING_MIRACLE_LEN_MAX 256
+#define COUNTING_MIRACLE_LEN_MAX 1024
 
 static really_inline
 char roseCountingMiracleScan(u8 c, const u8 *d, const u8 *d_end,
@@ -47,6 +48,31 @@ char roseCountingMiracleScan(u8 c, const u8 *d, const u8 *d_end,
 
     u32 count = *count_inout;
 
+    // Consume wide blocks while they can't complete the count; the block that
+    // would is left to the 16-byte loop below, so that the miracle location
+    // is identical to a scan done entirely with 16-byte blocks.
+#if defined(__AVX512BW__)
+    const m512 wide_chars = set64x8(c);
+    for (; d + 64 <= d_end; d_end -= 64) {
+        m512 data = loadu512(d_end - 64);
+        u32 n = popcount64(eq512mask(wide_chars, data));
+        if (count + n >= target_count) {
+            break;
+        }
+        count += n;
+    }
+#elif defined(__AVX2__)
+    const m256 wide_chars = set32x8(c);
+    for (; d + 32 <= d_end; d_end -= 32) {
+        m256 data = loadu256(d_end - 32);
+        u32 n = popcount32(movemask256(eq256(wide_chars, data)));
+        if (count + n >= target_count) {
+            break;
+        }
+        count += n;
+    }
+#endif
+
     m128 chars = set16x8(c);
 
     for (; d + 16 <= d_end; d_end -= 16) {
@@ -93,8 +119,44 @@ u32 roseCountingMiracleScanShufti(m128 mask_lo, m128 mask_hi, u8 poison,
 
     u32 count = *count_inout;
 
+    // As in roseCountingMiracleScan(), wide blocks are only consumed while
+    // they can't complete the count.
+#if defined(__AVX512BW__)
+    const m512 wide_lo = set4x128(mask_lo);
+    const m512 wide_hi = set4x128(mask_hi);
+    const m512 wide_low4bits = set64x8(0xf);
+    for (; d + 64 <= d_end; d_end -= 64) {
+        m512 data = loadu512(d_end - 64);
+        m512 c_lo = pshufb_m512(wide_lo, and512(data, wide_low4bits));
+        m512 c_hi = pshufb_m512(wide_hi,
+                        rshift64_m512(andnot512(wide_low4bits, data), 4));
+        m512 t = and512(c_lo, c_hi);
+        u32 n = popcount64(~eq512mask(t, zeroes512()));
+        if (count + n >= target_count) {
+            break;
+        }
+        count += n;
+    }
+#elif defined(__AVX2__)
+    const m256 wide_lo = set2x128(mask_lo);
+    const m256 wide_hi = set2x128(mask_hi);
+    const m256 wide_low4bits = set32x8(0xf);
+    for (; d + 32 <= d_end; d_end -= 32) {
+        m256 data = loadu256(d_end - 32);
+        m256 c_lo = vpshufb(wide_lo, and256(data, wide_low4bits));
+        m256 c_hi = vpshufb(wide_hi,
+                        rshift64_m256(andnot256(wide_low4bits, data), 4));
+        m256 t = and256(c_lo, c_hi);
+        u32 n = popcount32(~movemask256(eq256(t, zeroes256())));
+        if (count + n >= target_count) {
+            break;
+        }
+        count += n;
+    }
+#endif
+
     const m128 zeroes = zeroes128();
-    const m128 low4bits = _mm_set1_epi8(0xf);
+    const m128 low4bits = set16x8(0xf);
 
     for (; d + 16 <= d_end; d_end -= 16) {
         m128 data = loadu128(d_end - 16);
@@ -30,8 +30,11 @@
 #include "match.h"
 #include "program_runtime.h"
 #include "rose.h"
+#include "sample_stats.h"
+#include "tracepoints.h"
 #include "util/bitutils.h"
 #include "util/fatbit.h"
+#include "util/logical.h"
 
 #if defined(DEBUG) || defined(DUMP_SUPPORT)
 #include "util/compare.h"
@@ -249,8 +252,15 @@ hwlmcb_rv_t roseProcessMatchInline(const struct RoseEngine *t,
     assert(id < t->literalCount);
     const u64a som = 0;
     const u8 flags = 0;
-    return roseRunProgram_i(t, scratch, programs[id], som, end, match_len,
-                            flags);
+    HS_TRACE2(rose_literal_start, id, end);
+    u32 prev_lit = roseProfileLitBegin(scratch, id);
+    u32 prev_sample = sampleLitBegin(scratch, id);
+    hwlmcb_rv_t rv = roseRunProgram_i(t, scratch, programs[id], som, end,
+                                      match_len, flags);
+    sampleLitEnd(scratch, prev_sample);
+    roseProfileLitEnd(scratch, prev_lit);
+    HS_TRACE2(rose_literal_end, id, rv);
+    return rv;
 }
 
 /**
@@ -268,18 +278,46 @@ hwlmcb_rv_t roseProcessMatch(const struct RoseEngine *t,
     assert(id < t->literalCount);
     const u64a som = 0;
     const u8 flags = 0;
-    return roseRunProgram(t, scratch, programs[id], som, end, match_len, flags);
+    HS_TRACE2(rose_literal_start, id, end);
+    u32 prev_lit = roseProfileLitBegin(scratch, id);
+    u32 prev_sample = sampleLitBegin(scratch, id);
+    hwlmcb_rv_t rv = roseRunProgram(t, scratch, programs[id], som, end,
+                                    match_len, flags);
+    sampleLitEnd(scratch, prev_sample);
+    roseProfileLitEnd(scratch, prev_lit);
+    HS_TRACE2(rose_literal_end, id, rv);
+    return rv;
+}
+
+static rose_inline
+hwlmcb_rv_t playDelayedLiteral(const struct RoseEngine *t,
+                               struct hs_scratch *scratch, u32 delay_index,
+                               u64a offset) {
+    struct RoseContext *tctxt = &scratch->tctxt;
+    u32 literal_id = t->delay_base_id + delay_index;
+
+    UNUSED rose_group old_groups = tctxt->groups;
+
+    DEBUG_PRINTF("DELAYED MATCH id=%u offset=%llu\n", literal_id, offset);
+    hwlmcb_rv_t rv = roseProcessMatch(t, scratch, offset, 0, literal_id);
+    DEBUG_PRINTF("DONE groups=0x%016llx\n", tctxt->groups);
+
+    /* delayed literals can't safely set groups.
+     * However we may be setting groups that successors already have
+     * worked out that we don't need to match the group */
+    DEBUG_PRINTF("groups in %016llx out %016llx\n", old_groups,
+                 tctxt->groups);
+
+    return rv;
 }
 
 static rose_inline
 hwlmcb_rv_t playDelaySlot(const struct RoseEngine *t,
-                          struct hs_scratch *scratch,
-                          struct fatbit **delaySlots, u32 vicIndex,
+                          struct hs_scratch *scratch, u32 vicIndex,
                           u64a offset) {
     /* assert(!tctxt->in_anchored); */
     assert(vicIndex < DELAY_SLOT_COUNT);
-    const struct fatbit *vicSlot = delaySlots[vicIndex];
-    u32 delay_count = t->delay_count;
+    const struct delay_slot *ds = getDelayRing(scratch) + vicIndex;
 
     if (offset < t->floatingMinLiteralMatchOffset) {
         DEBUG_PRINTF("too soon\n");
@@ -290,23 +328,23 @@ hwlmcb_rv_t playDelaySlot(const struct RoseEngine *t,
     roseFlushLastByteHistory(t, scratch, offset);
     tctxt->lastEndOffset = offset;
 
+    if (!ds->spilled) {
+        DEBUG_PRINTF("%u inline entries\n", ds->count);
+        for (u32 i = 0; i < ds->count; i++) {
+            if (playDelayedLiteral(t, scratch, ds->ids[i], offset)
+                == HWLM_TERMINATE_MATCHING) {
+                return HWLM_TERMINATE_MATCHING;
+            }
+        }
+        return HWLM_CONTINUE_MATCHING;
+    }
+
+    const struct fatbit *vicSlot = getDelaySlots(scratch)[vicIndex];
+    u32 delay_count = t->delay_count;
     for (u32 it = fatbit_iterate(vicSlot, delay_count, MMB_INVALID);
          it != MMB_INVALID; it = fatbit_iterate(vicSlot, delay_count, it)) {
-        u32 literal_id = t->delay_base_id + it;
-
-        UNUSED rose_group old_groups = tctxt->groups;
-
-        DEBUG_PRINTF("DELAYED MATCH id=%u offset=%llu\n", literal_id, offset);
-        hwlmcb_rv_t rv = roseProcessMatch(t, scratch, offset, 0, literal_id);
-        DEBUG_PRINTF("DONE groups=0x%016llx\n", tctxt->groups);
-
-        /* delayed literals can't safely set groups.
-         * However we may be setting groups that successors already have
-         * worked out that we don't need to match the group */
-        DEBUG_PRINTF("groups in %016llx out %016llx\n", old_groups,
-                     tctxt->groups);
-
-        if (rv == HWLM_TERMINATE_MATCHING) {
+        if (playDelayedLiteral(t, scratch, it, offset)
+            == HWLM_TERMINATE_MATCHING) {
             return HWLM_TERMINATE_MATCHING;
         }
     }
@@ -391,8 +429,8 @@ hwlmcb_rv_t flushAnchoredLiterals(const struct RoseEngine *t,
 
 static really_inline
 hwlmcb_rv_t playVictims(const struct RoseEngine *t, struct hs_scratch *scratch,
-                        u32 *anchored_it, u64a lastEnd, u64a victimDelaySlots,
-                        struct fatbit **delaySlots) {
+                        u32 *anchored_it, u64a lastEnd,
+                        u64a victimDelaySlots) {
     while (victimDelaySlots) {
         u32 vic = findAndClearLSB_64(&victimDelaySlots);
         DEBUG_PRINTF("vic = %u\n", vic);
@@ -403,8 +441,8 @@ hwlmcb_rv_t playVictims(const struct RoseEngine *t, struct hs_scratch *scratch,
             return HWLM_TERMINATE_MATCHING;
         }
 
-        if (playDelaySlot(t, scratch, delaySlots, vic % DELAY_SLOT_COUNT,
-                          vicOffset) == HWLM_TERMINATE_MATCHING) {
+        if (playDelaySlot(t, scratch, vic % DELAY_SLOT_COUNT, vicOffset)
+            == HWLM_TERMINATE_MATCHING) {
             return HWLM_TERMINATE_MATCHING;
         }
     }
@@ -430,8 +468,6 @@ hwlmcb_rv_t flushQueuedLiterals_i(const struct RoseEngine *t,
     }
 
     {
-        struct fatbit **delaySlots = getDelaySlots(scratch);
-
         u32 lastIndex = lastEnd & DELAY_MASK;
         u32 currIndex = currEnd & DELAY_MASK;
 
@@ -483,8 +519,8 @@ hwlmcb_rv_t flushQueuedLiterals_i(const struct RoseEngine *t,
                          second_half, victimDelaySlots, lastIndex);
         }
 
-        if (playVictims(t, scratch, &anchored_it, lastEnd, victimDelaySlots,
-                        delaySlots) == HWLM_TERMINATE_MATCHING) {
+        if (playVictims(t, scratch, &anchored_it, lastEnd, victimDelaySlots)
+            == HWLM_TERMINATE_MATCHING) {
             return HWLM_TERMINATE_MATCHING;
         }
     }
@@ -575,8 +611,8 @@ int roseRunBoundaryProgram(const struct RoseEngine *rose, u32 program,
          * as we are reporting matches. This is done explicitly as we are
          * shortcutting the som handling in the vacuous repeats as we know they
          * all come from non-som patterns. */
-        fatbit_clear(scratch->deduper.som_log[0]);
-        fatbit_clear(scratch->deduper.som_log[1]);
+        fatbit_clear(scratch->deduper.som_log[0], rose->dkeyCount);
+        fatbit_clear(scratch->deduper.som_log[1], rose->dkeyCount);
         scratch->deduper.som_log_dirty = 0;
     }
 
@@ -618,3 +654,97 @@ int roseReportAdaptor(u64a start, u64a end, ReportID id, void *context) {
 
     return can_stop_matching(scratch) ? MO_HALT_MATCHING : MO_CONTINUE_MATCHING;
 }
+
+/** \brief Evaluate a logical combination against the logical vector. */
+static really_inline
+char evalCombination(const struct RoseEngine *t, u8 *lvec,
+                     const struct LogicalOp *tree, const struct CombInfo *ci) {
+    const u32 lkeyCount = t->lkeyCount;
+    for (u32 i = ci->start; i < ci->end; i++) {
+        const struct LogicalOp *op = tree + i;
+        char lo = mmbit_isset(lvec, lkeyCount, op->lo);
+        char val;
+        switch (op->op) {
+        case LOGICAL_OP_NOT:
+            val = !lo;
+            break;
+        case LOGICAL_OP_AND:
+            val = lo && mmbit_isset(lvec, lkeyCount, op->ro);
+            break;
+        case LOGICAL_OP_OR:
+            val = lo || mmbit_isset(lvec, lkeyCount, op->ro);
+            break;
+        default:
+            assert(0);
+            val = 0;
+        }
+        if (val) {
+            mmbit_set(lvec, lkeyCount, op->id);
+        } else {
+            mmbit_unset(lvec, lkeyCount, op->id);
+        }
+    }
+    return mmbit_isset(lvec, lkeyCount, ci->result);
+}
+
+/** \brief Evaluate combination \a ckey, reporting it at \a offset if it has
+ * become true. */
+static really_inline
+int checkCombination(const struct RoseEngine *t, struct hs_scratch *scratch,
+                     u32 ckey, u64a offset) {
+    struct core_info *ci = &scratch->core_info;
+    u8 *cvec = (u8 *)ci->combVector;
+    if (mmbit_isset(cvec, t->ckeyCount, ckey)) {
+        DEBUG_PRINTF("combination %u already reported\n", ckey);
+        return MO_CONTINUE_MATCHING;
+    }
+
+    const struct LogicalOp *tree = getByOffset(t, t->logicalTreeOffset);
+    const struct CombInfo *comb =
+        (const struct CombInfo *)getByOffset(t, t->combInfoMapOffset) + ckey;
+    if (!evalCombination(t, (u8 *)ci->logicalVector, tree, comb)) {
+        return MO_CONTINUE_MATCHING;
+    }
+
+    DEBUG_PRINTF("combination %u (id %u) is true at %llu\n", ckey, comb->id,
+                 offset);
+    mmbit_set(cvec, t->ckeyCount, ckey);
+    return roseDeliverReport(offset, comb->id, 0, scratch, INVALID_EKEY);
+}
+
+int roseFlushCombinations(const struct RoseEngine *t,
+                          struct hs_scratch *scratch, char eod) {
+    assert(t->ckeyCount);
+    struct core_info *ci = &scratch->core_info;
+    u8 *active = (u8 *)ci->state + t->stateOffsets.activeCombVec;
+    const u32 ckeyCount = t->ckeyCount;
+
+    if (mmbit_any(active, ckeyCount)) {
+        const u64a offset = scratch->tctxt.lastCombMatchOffset;
+        DEBUG_PRINTF("flushing active combinations at %llu\n", offset);
+        for (u32 i = mmbit_iterate(active, ckeyCount, MMB_INVALID);
+             i != MMB_INVALID; i = mmbit_iterate(active, ckeyCount, i)) {
+            if (checkCombination(t, scratch, i, offset) == MO_HALT_MATCHING) {
+                mmbit_clear(active, ckeyCount);
+                return MO_HALT_MATCHING;
+            }
+        }
+        mmbit_clear(active, ckeyCount);
+    }
+
+    if (!eod) {
+        return MO_CONTINUE_MATCHING;
+    }
+
+    // At EOD, combinations that have never been evaluated may be true (for
+    // example, a negation of a sub-pattern that did not match).
+    const u64a offset = ci->buf_offset + ci->len;
+    DEBUG_PRINTF("evaluating all combinations at eod %llu\n", offset);
+    for (u32 i = 0; i < ckeyCount; i++) {
+        if (checkCombination(t, scratch, i, offset) == MO_HALT_MATCHING) {
+            return MO_HALT_MATCHING;
+        }
+    }
+
+    return MO_CONTINUE_MATCHING;
+}
@@ -83,12 +83,29 @@ void initQueue(struct mq *q, u32 qi, const struct RoseEngine *t,
     q->cb = roseNfaAdaptor;
     q->context = scratch;
     q->report_current = 0;
+    q->scratch = scratch;
 
     DEBUG_PRINTF("qi=%u, offset=%llu, fullState=%u, streamState=%u, "
                  "state=%u\n", qi, q->offset, info->fullStateOffset,
                  info->stateOffset, *(u32 *)q->state);
 }
 
+static really_inline
+struct leftfix_check_cache *leftfixCheckCache(struct hs_scratch *scratch,
+                                              u32 qi) {
+    return &scratch->leftfix_check[qi % LEFTFIX_CHECK_CACHE_SIZE];
+}
+
+/** \brief Forgets any recorded check of the leftfix on queue \a qi; called
+ * whenever its queue is reinitialised or has events pushed. */
+static really_inline
+void invalidateLeftfixCheck(struct hs_scratch *scratch, u32 qi) {
+    struct leftfix_check_cache *lc = leftfixCheckCache(scratch, qi);
+    if (lc->qi == qi) {
+        lc->gen = 0;
+    }
+}
+
 static really_inline
 void initRoseQueue(const struct RoseEngine *t, u32 qi,
                    const struct LeftNfaInfo *left,
@@ -118,6 +135,9 @@ void initRoseQueue(const struct RoseEngine *t, u32 qi,
     q->cb = NULL;
     q->context = NULL;
     q->report_current = 0;
+    q->scratch = scratch;
+
+    invalidateLeftfixCheck(scratch, qi);
 
     DEBUG_PRINTF("qi=%u, offset=%llu, fullState=%u, streamState=%u, "
                  "state=%u\n", qi, q->offset, info->fullStateOffset,
@@ -127,7 +147,7 @@ void initRoseQueue(const struct RoseEngine *t, u32 qi,
 /** returns 0 if space for two items (top and end) on the queue */
 static really_inline
 char isQueueFull(const struct mq *q) {
-    return q->end + 2 > MAX_MQE_LEN;
+    return q_space(q) < 2;
 }
 
 static really_inline
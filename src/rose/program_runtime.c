@@ -31,6 +31,12 @@
  * \brief Rose runtime: program interpreter.
  */
 
+/* The out-of-line interpreter uses direct-threaded dispatch where the compiler
+ * supports taking the address of a label. */
+#if defined(__GNUC__)
+#define ROSE_PROGRAM_THREADED
+#endif
+
 #include "program_runtime.h"
 
 int roseNfaEarliestSom(u64a start, UNUSED u64a end, UNUSED ReportID id,
@@ -42,9 +42,11 @@
 #include "report.h"
 #include "rose.h"
 #include "rose_internal.h"
+#include "rose_profile.h"
 #include "rose_program.h"
 #include "rose_types.h"
 #include "validate_mask.h"
+#include "validate_shufti.h"
 #include "runtime.h"
 #include "scratch.h"
 #include "ue2common.h"
@@ -153,16 +155,47 @@ void rosePushDelayedMatch(const struct RoseEngine *t,
     }
 
     const u32 delay_count = t->delay_count;
-    struct fatbit **delaySlots = getDelaySlots(scratch);
-    struct fatbit *slot = delaySlots[slot_index];
+    struct delay_slot *ds = getDelayRing(scratch) + slot_index;
 
     DEBUG_PRINTF("pushing tab %u into slot %u\n", delay_index, slot_index);
     if (!(tctxt->filledDelayedSlots & (1U << slot_index))) {
         tctxt->filledDelayedSlots |= 1U << slot_index;
-        fatbit_clear(slot);
+        ds->count = 0;
+        ds->spilled = 0;
     }
 
-    fatbit_set(slot, delay_count, delay_index);
+    if (ds->spilled) {
+        fatbit_set(getDelaySlots(scratch)[slot_index], delay_count,
+                   delay_index);
+        return;
+    }
+
+    /* keep the inline ids sorted so that playback is in literal order */
+    u32 pos = ds->count;
+    while (pos && ds->ids[pos - 1] > delay_index) {
+        pos--;
+    }
+    if (pos && ds->ids[pos - 1] == delay_index) {
+        DEBUG_PRINTF("already pending\n");
+        return;
+    }
+
+    if (ds->count == DELAY_SLOT_INLINE_MAX) {
+        DEBUG_PRINTF("slot %u full, spilling to fatbit\n", slot_index);
+        struct fatbit *slot = getDelaySlots(scratch)[slot_index];
+        fatbit_clear(slot, delay_count);
+        for (u32 i = 0; i < ds->count; i++) {
+            fatbit_set(slot, delay_count, ds->ids[i]);
+        }
+        fatbit_set(slot, delay_count, delay_index);
+        ds->spilled = 1;
+        return;
+    }
+
+    memmove(&ds->ids[pos + 1], &ds->ids[pos],
+            (ds->count - pos) * sizeof(ds->ids[0]));
+    ds->ids[pos] = delay_index;
+    ds->count++;
 }
 
 static rose_inline
@@ -182,7 +215,7 @@ void recordAnchoredLiteralMatch(const struct RoseEngine *t,
     if (!bf64_set(&scratch->al_log_sum, end - 1)) {
         // first time, clear row
         DEBUG_PRINTF("clearing %llu/%u\n", end - 1, t->anchored_count);
-        fatbit_clear(anchoredLiteralRows[end - 1]);
+        fatbit_clear(anchoredLiteralRows[end - 1], t->anchored_count);
     }
 
     u32 rel_idx = literal_id - t->anchored_base_id;
@@ -281,6 +314,7 @@ hwlmcb_rv_t roseTriggerSuffix(const struct RoseEngine *t,
         nfaQueueInitState(nfa, q);
         pushQueueAt(q, 0, MQE_START, loc);
         fatbit_set(scratch->aqa, qCount, qi);
+        ci->status |= STATUS_EOD_LIVE;
     } else if (info->no_retrigger) {
         DEBUG_PRINTF("yawn\n");
         /* nfa only needs one top; we can go home now */
@@ -324,6 +358,17 @@ hwlmcb_rv_t roseTriggerSuffix(const struct RoseEngine *t,
     return HWLM_CONTINUE_MATCHING;
 }
 
+static really_inline
+void storeLeftfixCheck(struct hs_scratch *scratch, u32 qi, s64a loc,
+                       ReportID report, char rv) {
+    struct leftfix_check_cache *lc = leftfixCheckCache(scratch, qi);
+    lc->gen = scratch->leftfix_check_gen;
+    lc->qi = qi;
+    lc->loc = loc;
+    lc->report = report;
+    lc->rv = rv;
+}
+
 static really_inline
 char roseTestLeftfix(const struct RoseEngine *t, struct hs_scratch *scratch,
                      u32 qi, u32 leftfixLag, ReportID leftfixReport, u64a end,
@@ -440,6 +485,8 @@ char roseTestLeftfix(const struct RoseEngine *t, struct hs_scratch *scratch,
 
         DEBUG_PRINTF("checking for report %u\n", leftfixReport);
         DEBUG_PRINTF("leftfix done %hhd\n", (signed char)rv);
+        storeLeftfixCheck(scratch, qi, loc, leftfixReport,
+                          rv == MO_MATCHES_PENDING);
         return rv == MO_MATCHES_PENDING;
     } else if (q_cur_loc(q) > loc) {
         /* an eager leftfix may have already progressed past loc if there is no
@@ -448,9 +495,20 @@ char roseTestLeftfix(const struct RoseEngine *t, struct hs_scratch *scratch,
         return 0;
     } else {
         assert(q_cur_loc(q) == loc);
+        /* the queue is unchanged since it was last run to loc, so a check of
+         * the same report there has the same answer */
+        struct leftfix_check_cache *lc = leftfixCheckCache(scratch, qi);
+        if (lc->gen == scratch->leftfix_check_gen && lc->qi == qi &&
+            lc->loc == loc && lc->report == leftfixReport) {
+            DEBUG_PRINTF("cached check of report %u: %hhd\n", leftfixReport,
+                         (signed char)lc->rv);
+            return lc->rv;
+        }
+
         DEBUG_PRINTF("checking for report %u\n", leftfixReport);
         char rv = nfaInAcceptState(q->nfa, leftfixReport, q);
         DEBUG_PRINTF("leftfix done %hhd\n", (signed char)rv);
+        storeLeftfixCheck(scratch, qi, loc, leftfixReport, rv);
         return rv;
     }
 
@@ -508,6 +566,8 @@ void roseTriggerInfix(const struct RoseEngine *t, struct hs_scratch *scratch,
         return;
     }
 
+    invalidateLeftfixCheck(scratch, qi);
+
     if (cancel) {
         DEBUG_PRINTF("dominating top: (re)init\n");
         fatbit_set(aqa, qCount, qi);
@@ -568,6 +628,36 @@ hwlmcb_rv_t roseReport(const struct RoseEngine *t, struct hs_scratch *scratch,
     return roseHaltIfExhausted(t, scratch);
 }
 
+/**
+ * \brief Fires the \a count reports in \a entries in turn, as a run of REPORT
+ * and exhaustion-checked REPORT_EXHAUST instructions would, and sets
+ * \a work_done if any of them was delivered.
+ */
+static rose_inline
+hwlmcb_rv_t roseReportMulti(const struct RoseEngine *t,
+                            struct hs_scratch *scratch, u64a end,
+                            const struct rose_report_entry *entries, u32 count,
+                            int *work_done) {
+    assert(count);
+    const char *evec = scratch->core_info.exhaustionVector;
+    for (u32 i = 0; i < count; i++) {
+        const struct rose_report_entry *e = &entries[i];
+        // Checked here rather than up front, as an earlier report in the
+        // list may have set the same key.
+        if (e->ekey != INVALID_EKEY && isExhausted(t, evec, e->ekey)) {
+            DEBUG_PRINTF("ekey %u already set, skipping report %u\n",
+                         e->ekey, e->onmatch);
+            continue;
+        }
+        if (roseReport(t, scratch, end, e->onmatch, e->offset_adjust,
+                       e->ekey) == HWLM_TERMINATE_MATCHING) {
+            return HWLM_TERMINATE_MATCHING;
+        }
+        *work_done = 1;
+    }
+    return HWLM_CONTINUE_MATCHING;
+}
+
 /* catches up engines enough to ensure any earlier mpv triggers are enqueued
  * and then adds the trigger to the mpv queue. Must not be called during catch
  * up */
@@ -783,6 +873,137 @@ int roseCheckMask(const struct core_info *ci, u64a and_mask, u64a cmp_mask,
         return 0;
     }
 }
+/*
+ * Copy the len bytes starting at buffer-relative offset loc into data, taking
+ * them from the history and current buffers as necessary. Bytes before the
+ * start of history or beyond the end of the current buffer are zeroed.
+ * Returns a mask with bit i set if byte i was available.
+ */
+static rose_inline
+u64a getBufferDataComplex(const struct core_info *ci, const s64a loc,
+                          u8 *data, const u32 len) {
+    assert(len <= 64);
+    memset(data, 0, len);
+    u64a valid_data_mask = 0;
+    const s64a loc_end = loc + len;
+
+    const s64a h_start = MAX(loc, -(s64a)ci->hlen);
+    const s64a h_end = MIN(loc_end, 0);
+    if (h_start < h_end) {
+        u32 n = (u32)(h_end - h_start);
+        DEBUG_PRINTF("%u bytes in history\n", n);
+        memcpy(data + (h_start - loc), ci->hbuf + ci->hlen + h_start, n);
+        valid_data_mask |= (n == 64 ? ~0ULL : (1ULL << n) - 1)
+                           << (h_start - loc);
+    }
+
+    const s64a b_start = MAX(loc, 0);
+    const s64a b_end = MIN(loc_end, (s64a)ci->len);
+    if (b_start < b_end) {
+        u32 n = (u32)(b_end - b_start);
+        DEBUG_PRINTF("%u bytes in buffer\n", n);
+        memcpy(data + (b_start - loc), ci->buf + b_start, n);
+        valid_data_mask |= (n == 64 ? ~0ULL : (1ULL << n) - 1)
+                           << (b_start - loc);
+    }
+
+    return valid_data_mask;
+}
+
+static rose_inline
+int roseCheckMask32(const struct core_info *ci, const u8 *and_mask,
+                    const u8 *cmp_mask, const u32 neg_mask,
+                    s32 checkOffset, u64a end) {
+    const s64a base_offset = (s64a)end - ci->buf_offset;
+    s64a offset = base_offset + checkOffset;
+    DEBUG_PRINTF("checkOffset %d offset %lld\n", checkOffset, offset);
+    if (unlikely(checkOffset < 0 && (u64a)(0 - checkOffset) > end)) {
+        DEBUG_PRINTF("too early, fail\n");
+        return 0;
+    }
+
+    m256 data;
+    u32 valid_data_mask;
+    if (offset >= 0 && offset + 32 <= (s64a)ci->len) {
+        data = loadu256(ci->buf + offset);
+        valid_data_mask = ~0U;
+    } else {
+        u8 buf[32];
+        valid_data_mask = (u32)getBufferDataComplex(ci, offset, buf, 32);
+        if (!valid_data_mask) {
+            DEBUG_PRINTF("no data in range\n");
+            return 1;
+        }
+        data = loadu256(buf);
+    }
+
+    return validateMask32(data, valid_data_mask, loadu256(and_mask),
+                          loadu256(cmp_mask), neg_mask);
+}
+
+static rose_inline
+int roseCheckMask64(const struct core_info *ci, const u8 *and_mask,
+                    const u8 *cmp_mask, const u64a neg_mask,
+                    s32 checkOffset, u64a end) {
+    const s64a base_offset = (s64a)end - ci->buf_offset;
+    s64a offset = base_offset + checkOffset;
+    DEBUG_PRINTF("checkOffset %d offset %lld\n", checkOffset, offset);
+    if (unlikely(checkOffset < 0 && (u64a)(0 - checkOffset) > end)) {
+        DEBUG_PRINTF("too early, fail\n");
+        return 0;
+    }
+
+    m512 data;
+    u64a valid_data_mask;
+    if (offset >= 0 && offset + 64 <= (s64a)ci->len) {
+        data = loadu512(ci->buf + offset);
+        valid_data_mask = ~0ULL;
+    } else {
+        u8 buf[64];
+        valid_data_mask = getBufferDataComplex(ci, offset, buf, 64);
+        if (!valid_data_mask) {
+            DEBUG_PRINTF("no data in range\n");
+            return 1;
+        }
+        data = loadu512(buf);
+    }
+
+    return validateMask64(data, valid_data_mask, loadu512(and_mask),
+                          loadu512(cmp_mask), neg_mask);
+}
+
+static rose_inline
+int roseCheckShufti32x8(const struct core_info *ci, const u8 *hi_mask,
+                        const u8 *lo_mask, const u8 *bucket_select_mask,
+                        const u32 neg_mask, s32 checkOffset, u64a end) {
+    const s64a base_offset = (s64a)end - ci->buf_offset;
+    s64a offset = base_offset + checkOffset;
+    DEBUG_PRINTF("checkOffset %d offset %lld\n", checkOffset, offset);
+    if (unlikely(checkOffset < 0 && (u64a)(0 - checkOffset) > end)) {
+        DEBUG_PRINTF("too early, fail\n");
+        return 0;
+    }
+
+    m256 data;
+    u32 valid_data_mask;
+    if (offset >= 0 && offset + 32 <= (s64a)ci->len) {
+        data = loadu256(ci->buf + offset);
+        valid_data_mask = ~0U;
+    } else {
+        u8 buf[32];
+        valid_data_mask = (u32)getBufferDataComplex(ci, offset, buf, 32);
+        if (!valid_data_mask) {
+            DEBUG_PRINTF("no data in range\n");
+            return 1;
+        }
+        data = loadu256(buf);
+    }
+
+    return validateShuftiMask32x8(data, loadu256(hi_mask), loadu256(lo_mask),
+                                  loadu256(bucket_select_mask), neg_mask,
+                                  valid_data_mask);
+}
+
 /**
  * \brief Scan around a literal, checking that that "lookaround" reach masks
  * are satisfied.
@@ -1041,7 +1262,10 @@ hwlmcb_rv_t roseMatcherEod(const struct RoseEngine *rose,
     // the eod-anchored matcher region.
     size_t adj = eod_len - MIN(eod_len, rose->ematcherRegionSize);
 
-    const struct HWLM *etable = getByOffset(rose, rose->ematcherOffset);
+    // Not getByOffset(): in an engine store, the matcher may be shared and
+    // lie beyond the end of the engine.
+    const struct HWLM *etable
+        = (const struct HWLM *)((const char *)rose + rose->ematcherOffset);
     hwlmExec(etable, eod_data, eod_len, adj, roseCallback, scratch,
              scratch->tctxt.groups);
 
@@ -1065,10 +1289,47 @@ void updateSeqPoint(struct RoseContext *tctxt, u64a offset,
     }
 }
 
+/*
+ * If ROSE_PROGRAM_THREADED is defined before this header is included, the
+ * interpreter below is built with direct-threaded dispatch: each instruction
+ * jumps straight to the handler for the next one through a table of label
+ * addresses, rather than returning to a single switch. This gives the branch
+ * predictor one indirect branch per instruction handler to learn from.
+ *
+ * Functions that take the address of a label cannot be inlined, so the
+ * threaded interpreter is only built out-of-line in program_runtime.c.
+ * Explicit jumps (fail_jump, done_jump) still go back through the switch.
+ */
+#if defined(ROSE_PROGRAM_THREADED)
+
+#define PROGRAM_CASE(name)                                                     \
+    case ROSE_INSTR_##name:                                                    \
+    LABEL_ROSE_INSTR_##name: {                                                 \
+        DEBUG_PRINTF("instruction: " #name " (pc=%u)\n",                       \
+                     programOffset + (u32)(pc - pc_base));                     \
+        roseProfileInstr(scratch, ROSE_INSTR_##name);                          \
+        const struct ROSE_STRUCT_##name *ri =                                  \
+            (const struct ROSE_STRUCT_##name *)pc;
+
+#define PROGRAM_NEXT_INSTRUCTION                                               \
+    pc += ROUNDUP_N(sizeof(*ri), ROSE_INSTR_MIN_ALIGN);                        \
+    assert(ISALIGNED_N(pc, ROSE_INSTR_MIN_ALIGN));                             \
+    assert((size_t)(pc - pc_base) < t->size);                                  \
+    assert(*(const u8 *)pc <= ROSE_INSTR_END);                                 \
+    goto *next_instr[*(const u8 *)pc];                                         \
+    }
+
+#define PROGRAM_LABEL(name) [ROSE_INSTR_##name] = &&LABEL_ROSE_INSTR_##name
+
+#define PROGRAM_FN static never_inline
+
+#else
+
 #define PROGRAM_CASE(name)                                                     \
     case ROSE_INSTR_##name: {                                                  \
         DEBUG_PRINTF("instruction: " #name " (pc=%u)\n",                       \
                      programOffset + (u32)(pc - pc_base));                     \
+        roseProfileInstr(scratch, ROSE_INSTR_##name);                          \
         const struct ROSE_STRUCT_##name *ri =                                  \
             (const struct ROSE_STRUCT_##name *)pc;
 
@@ -1077,7 +1338,11 @@ void updateSeqPoint(struct RoseContext *tctxt, u64a offset,
     break;                                                                     \
     }
 
-static rose_inline
+#define PROGRAM_FN static rose_inline
+
+#endif
+
+PROGRAM_FN
 hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
                              struct hs_scratch *scratch, u32 programOffset,
                              u64a som, u64a end, size_t match_len,
@@ -1106,6 +1371,69 @@ hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
 
     struct RoseContext *tctxt = &scratch->tctxt;
 
+#if defined(ROSE_PROGRAM_THREADED)
+    static const void *const next_instr[ROSE_INSTR_END + 1] = {
+        PROGRAM_LABEL(ANCHORED_DELAY),
+        PROGRAM_LABEL(CHECK_LIT_MASK),
+        PROGRAM_LABEL(CHECK_LIT_EARLY),
+        PROGRAM_LABEL(CHECK_GROUPS),
+        PROGRAM_LABEL(CHECK_ONLY_EOD),
+        PROGRAM_LABEL(CHECK_BOUNDS),
+        PROGRAM_LABEL(CHECK_NOT_HANDLED),
+        PROGRAM_LABEL(CHECK_BOUNDS_NOT_HANDLED),
+        PROGRAM_LABEL(CHECK_LOOKAROUND),
+        PROGRAM_LABEL(CHECK_MULTIPATH_LOOKAROUND),
+        PROGRAM_LABEL(CHECK_MASK),
+        PROGRAM_LABEL(CHECK_MASK_32),
+        PROGRAM_LABEL(CHECK_MASK_64),
+        PROGRAM_LABEL(CHECK_SHUFTI_32x8),
+        PROGRAM_LABEL(CHECK_BYTE),
+        PROGRAM_LABEL(CHECK_INFIX),
+        PROGRAM_LABEL(CHECK_PREFIX),
+        PROGRAM_LABEL(PUSH_DELAYED),
+        PROGRAM_LABEL(RECORD_ANCHORED),
+        PROGRAM_LABEL(CATCH_UP),
+        PROGRAM_LABEL(CATCH_UP_MPV),
+        PROGRAM_LABEL(SOM_ADJUST),
+        PROGRAM_LABEL(SOM_LEFTFIX),
+        PROGRAM_LABEL(SOM_FROM_REPORT),
+        PROGRAM_LABEL(SOM_ZERO),
+        PROGRAM_LABEL(TRIGGER_INFIX),
+        PROGRAM_LABEL(TRIGGER_SUFFIX),
+        PROGRAM_LABEL(DEDUPE),
+        PROGRAM_LABEL(DEDUPE_SOM),
+        PROGRAM_LABEL(REPORT_CHAIN),
+        PROGRAM_LABEL(REPORT_SOM_INT),
+        PROGRAM_LABEL(REPORT_SOM_AWARE),
+        PROGRAM_LABEL(REPORT),
+        PROGRAM_LABEL(REPORT_EXHAUST),
+        PROGRAM_LABEL(REPORT_SOM),
+        PROGRAM_LABEL(REPORT_SOM_EXHAUST),
+        PROGRAM_LABEL(DEDUPE_AND_REPORT),
+        PROGRAM_LABEL(FINAL_REPORT),
+        PROGRAM_LABEL(REPORT_MULTI),
+        PROGRAM_LABEL(CHECK_EXHAUSTED),
+        PROGRAM_LABEL(CHECK_MIN_LENGTH),
+        PROGRAM_LABEL(SET_STATE),
+        PROGRAM_LABEL(SET_GROUPS),
+        PROGRAM_LABEL(SQUASH_GROUPS),
+        PROGRAM_LABEL(CHECK_STATE),
+        PROGRAM_LABEL(SPARSE_ITER_BEGIN),
+        PROGRAM_LABEL(SPARSE_ITER_NEXT),
+        PROGRAM_LABEL(ENGINES_EOD),
+        PROGRAM_LABEL(SUFFIXES_EOD),
+        PROGRAM_LABEL(MATCHER_EOD),
+        PROGRAM_LABEL(FLUSH_COMBINATION),
+        PROGRAM_LABEL(SET_LOGICAL),
+        PROGRAM_LABEL(SET_COMBINATION),
+        PROGRAM_LABEL(COUNT_MATCH),
+        PROGRAM_LABEL(CHECK_CONFIRM),
+        PROGRAM_LABEL(CHECK_SUBGROUP),
+        PROGRAM_LABEL(SQUASH_SUBGROUP),
+        PROGRAM_LABEL(END)
+    };
+#endif
+
     assert(*(const u8 *)pc != ROSE_INSTR_END);
 
     for (;;) {
@@ -1134,6 +1462,7 @@ hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
                 if (!roseCheckBenefits(ci, end, match_len, ri->and_mask.a8,
                                        ri->cmp_mask.a8)) {
                     DEBUG_PRINTF("halt: failed mask check\n");
+                    roseProfileLitMaskFail(scratch);
                     return HWLM_CONTINUE_MATCHING;
                 }
             }
@@ -1190,10 +1519,49 @@ hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
             }
             PROGRAM_NEXT_INSTRUCTION
 
+            PROGRAM_CASE(CHECK_BOUNDS_NOT_HANDLED) {
+                if (!roseCheckBounds(end, ri->min_bound, ri->max_bound)) {
+                    DEBUG_PRINTF("failed bounds check\n");
+                    assert(ri->fail_jump); // must progress
+                    pc += ri->fail_jump;
+                    continue;
+                }
+                struct fatbit *handled = scratch->handled_roles;
+                if (fatbit_set(handled, t->handledKeyCount, ri->key)) {
+                    DEBUG_PRINTF("key %u already set\n", ri->key);
+                    assert(ri->fail_jump); // must progress
+                    pc += ri->fail_jump;
+                    continue;
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
             PROGRAM_CASE(CHECK_LOOKAROUND) {
                 if (!roseCheckLookaround(t, scratch, ri->index, ri->count,
                                          end)) {
                     DEBUG_PRINTF("failed lookaround check\n");
+                    roseProfileLookaroundFail(scratch);
+                    assert(ri->fail_jump); // must progress
+                    pc += ri->fail_jump;
+                    continue;
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_MULTIPATH_LOOKAROUND) {
+                assert(ri->path_count > 1);
+                assert(ri->path_count <= ROSE_MULTIPATH_LOOKAROUND_MAX);
+                int match = 0;
+                for (u32 i = 0; i < ri->path_count; i++) {
+                    if (roseCheckLookaround(t, scratch, ri->index[i],
+                                            ri->count[i], end)) {
+                        match = 1;
+                        break;
+                    }
+                }
+                if (!match) {
+                    DEBUG_PRINTF("failed multipath lookaround check\n");
+                    roseProfileLookaroundFail(scratch);
                     assert(ri->fail_jump); // must progress
                     pc += ri->fail_jump;
                     continue;
@@ -1213,6 +1581,43 @@ hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
             }
             PROGRAM_NEXT_INSTRUCTION
 
+            PROGRAM_CASE(CHECK_MASK_32) {
+                struct core_info *ci = &scratch->core_info;
+                if (!roseCheckMask32(ci, ri->and_mask, ri->cmp_mask,
+                                     ri->neg_mask, ri->offset, end)) {
+                    DEBUG_PRINTF("failed mask check\n");
+                    assert(ri->fail_jump); // must progress
+                    pc += ri->fail_jump;
+                    continue;
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_MASK_64) {
+                struct core_info *ci = &scratch->core_info;
+                if (!roseCheckMask64(ci, ri->and_mask, ri->cmp_mask,
+                                     ri->neg_mask, ri->offset, end)) {
+                    DEBUG_PRINTF("failed mask check\n");
+                    assert(ri->fail_jump); // must progress
+                    pc += ri->fail_jump;
+                    continue;
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_SHUFTI_32x8) {
+                struct core_info *ci = &scratch->core_info;
+                if (!roseCheckShufti32x8(ci, ri->hi_mask, ri->lo_mask,
+                                         ri->bucket_select_mask,
+                                         ri->neg_mask, ri->offset, end)) {
+                    DEBUG_PRINTF("failed shufti check\n");
+                    assert(ri->fail_jump); // must progress
+                    pc += ri->fail_jump;
+                    continue;
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
             PROGRAM_CASE(CHECK_BYTE) {
                 const struct core_info *ci = &scratch->core_info;
                 if (!roseCheckByte(ci, ri->and_mask, ri->cmp_mask,
@@ -1466,6 +1871,17 @@ hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
             }
             PROGRAM_NEXT_INSTRUCTION
 
+            PROGRAM_CASE(REPORT_MULTI) {
+                updateSeqPoint(tctxt, end, from_mpv);
+                const struct rose_report_entry *entries =
+                    getByOffset(t, ri->list_offset);
+                if (roseReportMulti(t, scratch, end, entries, ri->count,
+                                    &work_done) == HWLM_TERMINATE_MATCHING) {
+                    return HWLM_TERMINATE_MATCHING;
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
             PROGRAM_CASE(CHECK_EXHAUSTED) {
                 DEBUG_PRINTF("check ekey %u\n", ri->ekey);
                 assert(ri->ekey != INVALID_EKEY);
@@ -1502,6 +1918,7 @@ hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
                 DEBUG_PRINTF("set state index %u\n", ri->index);
                 mmbit_set(getRoleState(scratch->core_info.state),
                           t->rolesWithStateCount, ri->index);
+                scratch->core_info.status |= STATUS_EOD_LIVE;
                 work_done = 1;
             }
             PROGRAM_NEXT_INSTRUCTION
@@ -1553,7 +1970,7 @@ hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
                     continue;
                 }
 
-                fatbit_clear(scratch->handled_roles);
+                fatbit_clear(scratch->handled_roles, t->handledKeyCount);
 
                 const u32 *jumps = getByOffset(t, ri->jump_table);
                 DEBUG_PRINTF("state %u (idx=%u) is on, jump to %u\n", i, idx,
@@ -1614,6 +2031,90 @@ hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
             }
             PROGRAM_NEXT_INSTRUCTION
 
+            PROGRAM_CASE(FLUSH_COMBINATION) {
+                const u8 *active =
+                    (const u8 *)scratch->core_info.state +
+                    t->stateOffsets.activeCombVec;
+                if (end + ri->offset_adjust > tctxt->lastCombMatchOffset &&
+                    mmbit_any(active, t->ckeyCount)) {
+                    if (roseFlushCombinations(t, scratch, 0) ==
+                        MO_HALT_MATCHING) {
+                        return HWLM_TERMINATE_MATCHING;
+                    }
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(SET_LOGICAL) {
+                DEBUG_PRINTF("set logical key %u @ %llu\n", ri->lkey,
+                             end + ri->offset_adjust);
+                mmbit_set((u8 *)scratch->core_info.logicalVector,
+                          t->lkeyCount, ri->lkey);
+                tctxt->lastCombMatchOffset = end + ri->offset_adjust;
+                work_done = 1;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(SET_COMBINATION) {
+                DEBUG_PRINTF("activate combination %u\n", ri->ckey);
+                mmbit_set((u8 *)scratch->core_info.state +
+                              t->stateOffsets.activeCombVec,
+                          t->ckeyCount, ri->ckey);
+                work_done = 1;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(COUNT_MATCH) {
+                if (roseCountMatch(t, scratch, ri->key, ri->limit)) {
+                    DEBUG_PRINTF("match limit %u reached, setting ekey %u\n",
+                                 ri->limit, ri->ekey);
+                    roseMarkExhausted(t, scratch, ri->ekey);
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_CONFIRM) {
+                const u64a match_end = end + ri->offset_adjust;
+                if (!roseCheckConfirm(t, scratch, ri->key, match_end)) {
+                    DEBUG_PRINTF("match at %llu failed confirm %u\n",
+                                 match_end, ri->key);
+                    assert(ri->fail_jump); // must progress
+                    pc += ri->fail_jump;
+                    continue;
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_SUBGROUP) {
+                const char *state = scratch->core_info.state;
+                u64a subgroups = loadSubgroups(t, state, ri->index);
+                DEBUG_PRINTF("subgroups[%u]=0x%llx, checking 0x%llx\n",
+                             ri->index, subgroups, ri->subgroup);
+                if (!(subgroups & ri->subgroup)) {
+                    DEBUG_PRINTF("halt: subgroup squashed\n");
+                    return HWLM_CONTINUE_MATCHING;
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(SQUASH_SUBGROUP) {
+                assert(popcount64(ri->subgroup) == 1);
+                if (work_done) {
+                    char *state = scratch->core_info.state;
+                    u64a subgroups = loadSubgroups(t, state, ri->index);
+                    subgroups &= ~ri->subgroup;
+                    storeSubgroups(t, state, ri->index, subgroups);
+                    DEBUG_PRINTF("squash subgroup 0x%llx -> 0x%llx\n",
+                                 ri->subgroup, subgroups);
+                    if (!subgroups) {
+                        tctxt->groups &= ri->groups;
+                        DEBUG_PRINTF("squash groups 0x%llx -> 0x%llx\n",
+                                     ri->groups, tctxt->groups);
+                    }
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
             PROGRAM_CASE(END) {
                 DEBUG_PRINTF("finished\n");
                 return HWLM_CONTINUE_MATCHING;
@@ -1628,5 +2129,7 @@ hwlmcb_rv_t roseRunProgram_i(const struct RoseEngine *t,
 
 #undef PROGRAM_CASE
 #undef PROGRAM_NEXT_INSTRUCTION
+#undef PROGRAM_LABEL
+#undef PROGRAM_FN
 
 #endif // PROGRAM_RUNTIME_H
@@ -53,4 +53,8 @@ int roseReportAdaptor(u64a start, u64a end, ReportID id, void *context);
 int roseRunBoundaryProgram(const struct RoseEngine *rose, u32 program,
                            u64a stream_offset, struct hs_scratch *scratch);
 
+/* evaluates active logical combinations, and all unreported ones if eod */
+int roseFlushCombinations(const struct RoseEngine *t,
+                          struct hs_scratch *scratch, char eod);
+
 #endif // ROSE_H
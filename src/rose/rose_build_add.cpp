@@ -1063,7 +1063,7 @@ bool canImplementGraph(RoseBuildImpl *tbi, const RoseInGraph &in, NGHolder &h,
     if (prefilter && cc.grey.prefilterReductions) {
         // If we're prefiltering, we can have another go with a reduced graph.
         UNUSED size_t numBefore = num_vertices(h);
-        prefilterReductions(h, cc);
+        prefilterReductions(h, cc, 0);
         UNUSED size_t numAfter = num_vertices(h);
         DEBUG_PRINTF("reduced from %zu to %zu vertices\n", numBefore, numAfter);
 
@@ -1800,7 +1800,13 @@ bool RoseBuildImpl::addOutfix(const NGHolder &h) {
 
     if (!nfa_states || cc.grey.roseMcClellanOutfix == 2 ||
         (cc.grey.roseMcClellanOutfix == 1 && dfa_cand)) {
-        rdfa = buildMcClellan(h, &rm, cc.grey);
+        // Over the compile time budget, don't determinise what we can
+        // already run as an NFA.
+        if (nfa_states && overBudget(cc)) {
+            markDegraded(h, rm, cc);
+        } else {
+            rdfa = buildMcClellan(h, &rm, cc.grey);
+        }
     }
 
     if (!nfa_states && !rdfa) {
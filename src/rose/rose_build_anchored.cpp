@@ -37,6 +37,7 @@
 #include "nfa/mcclellancompile_util.h"
 #include "nfa/nfa_build_util.h"
 #include "nfa/rdfa_merge.h"
+#include "nfa/shengcompile.h"
 #include "nfagraph/ng_holder.h"
 #include "nfagraph/ng_repeat.h"
 #include "nfagraph/ng_util.h"
@@ -806,7 +807,16 @@ size_t buildNfas(vector<raw_dfa> &anchored_dfas,
 
         minimize_hopcroft(rdfa, cc.grey);
 
-        auto nfa = mcclellanCompile(rdfa, cc, rm);
+        // Small DFAs, such as those for a few protocol header literals, run
+        // faster as Sheng, which steps with a shuffle rather than a table
+        // lookup per byte.
+        aligned_unique_ptr<NFA> nfa;
+        if (cc.grey.allowAnchoredSheng) {
+            nfa = shengCompile(rdfa, cc, rm);
+        }
+        if (!nfa) {
+            nfa = mcclellanCompile(rdfa, cc, rm);
+        }
         if (!nfa) {
             assert(0);
             throw std::bad_alloc();
@@ -42,11 +42,17 @@
 #include "rose_build_util.h"
 #include "rose_build_width.h"
 #include "rose_program.h"
+#include "backtrack/backtrack_build.h"
+#include "compiler/engine_cache.h"
 #include "hwlm/hwlm.h" /* engine types */
 #include "nfa/castlecompile.h"
+#include "nfa/dfagroupcompile.h"
 #include "nfa/goughcompile.h"
+#include "nfa/lbr_internal.h"
 #include "nfa/mcclellancompile.h"
 #include "nfa/mcclellancompile_util.h"
+#include "nfa/limex_cache.h"
+#include "nfa/mcshengcompile.h"
 #include "nfa/nfa_api_queue.h"
 #include "nfa/nfa_build_util.h"
 #include "nfa/nfa_internal.h"
@@ -70,10 +76,13 @@
 #include "util/alloc.h"
 #include "util/bitutils.h"
 #include "util/boundary_reports.h"
+#include "util/byte_freq.h"
 #include "util/charreach.h"
 #include "util/charreach_util.h"
+#include "util/compare.h"
 #include "util/compile_context.h"
 #include "util/compile_error.h"
+#include "util/compile_report.h"
 #include "util/container.h"
 #include "util/graph_range.h"
 #include "util/make_unique.h"
@@ -82,14 +91,17 @@
 #include "util/popcount.h"
 #include "util/queue_index_factory.h"
 #include "util/report_manager.h"
+#include "util/stream_state_usage.h"
 #include "util/ue2string.h"
 #include "util/verify_types.h"
 
 #include <algorithm>
+#include <cmath>
 #include <map>
 #include <queue>
 #include <set>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <utility>
 
@@ -131,8 +143,8 @@ struct left_build_info {
           countingMiracleReach(cm_cr) {}
 
     // Constructor for a lookaround implementation.
-    explicit left_build_info(const vector<LookEntry> &look)
-        : has_lookaround(true), lookaround(look) {}
+    explicit left_build_info(const vector<vector<LookEntry>> &looks)
+        : has_lookaround(true), lookaround(looks) {}
 
     u32 queue = 0; /* uniquely idents the left_build_info */
     u32 lag = 0;
@@ -144,7 +156,7 @@ struct left_build_info {
     CharReach countingMiracleReach;
     u32 countingMiracleOffset = 0; /* populated later when laying out bytecode */
     bool has_lookaround = false;
-    vector<LookEntry> lookaround; // alternative implementation to the NFA
+    vector<vector<LookEntry>> lookaround; // alternative to the NFA, per path
 };
 
 /**
@@ -199,8 +211,15 @@ public:
         case ROSE_INSTR_CHECK_ONLY_EOD: return &u.checkOnlyEod;
         case ROSE_INSTR_CHECK_BOUNDS: return &u.checkBounds;
         case ROSE_INSTR_CHECK_NOT_HANDLED: return &u.checkNotHandled;
+        case ROSE_INSTR_CHECK_BOUNDS_NOT_HANDLED:
+            return &u.checkBoundsNotHandled;
         case ROSE_INSTR_CHECK_LOOKAROUND: return &u.checkLookaround;
+        case ROSE_INSTR_CHECK_MULTIPATH_LOOKAROUND:
+            return &u.checkMultipathLookaround;
         case ROSE_INSTR_CHECK_MASK: return &u.checkMask;
+        case ROSE_INSTR_CHECK_MASK_32: return &u.checkMask32;
+        case ROSE_INSTR_CHECK_MASK_64: return &u.checkMask64;
+        case ROSE_INSTR_CHECK_SHUFTI_32x8: return &u.checkShufti32x8;
         case ROSE_INSTR_CHECK_BYTE: return &u.checkByte;
         case ROSE_INSTR_CHECK_INFIX: return &u.checkInfix;
         case ROSE_INSTR_CHECK_PREFIX: return &u.checkPrefix;
@@ -226,6 +245,7 @@ public:
         case ROSE_INSTR_REPORT_SOM_EXHAUST: return &u.reportSomExhaust;
         case ROSE_INSTR_DEDUPE_AND_REPORT: return &u.dedupeAndReport;
         case ROSE_INSTR_FINAL_REPORT: return &u.finalReport;
+        case ROSE_INSTR_REPORT_MULTI: return &u.reportMulti;
         case ROSE_INSTR_CHECK_EXHAUSTED: return &u.checkExhausted;
         case ROSE_INSTR_CHECK_MIN_LENGTH: return &u.checkMinLength;
         case ROSE_INSTR_SET_STATE: return &u.setState;
@@ -237,6 +257,13 @@ public:
         case ROSE_INSTR_ENGINES_EOD: return &u.enginesEod;
         case ROSE_INSTR_SUFFIXES_EOD: return &u.suffixesEod;
         case ROSE_INSTR_MATCHER_EOD: return &u.matcherEod;
+        case ROSE_INSTR_FLUSH_COMBINATION: return &u.flushCombination;
+        case ROSE_INSTR_SET_LOGICAL: return &u.setLogical;
+        case ROSE_INSTR_SET_COMBINATION: return &u.setCombination;
+        case ROSE_INSTR_COUNT_MATCH: return &u.countMatch;
+        case ROSE_INSTR_CHECK_CONFIRM: return &u.checkConfirm;
+        case ROSE_INSTR_CHECK_SUBGROUP: return &u.checkSubgroup;
+        case ROSE_INSTR_SQUASH_SUBGROUP: return &u.squashSubgroup;
         case ROSE_INSTR_END: return &u.end;
         }
         assert(0);
@@ -251,8 +278,15 @@ public:
         case ROSE_INSTR_CHECK_ONLY_EOD: return sizeof(u.checkOnlyEod);
         case ROSE_INSTR_CHECK_BOUNDS: return sizeof(u.checkBounds);
         case ROSE_INSTR_CHECK_NOT_HANDLED: return sizeof(u.checkNotHandled);
+        case ROSE_INSTR_CHECK_BOUNDS_NOT_HANDLED:
+            return sizeof(u.checkBoundsNotHandled);
         case ROSE_INSTR_CHECK_LOOKAROUND: return sizeof(u.checkLookaround);
+        case ROSE_INSTR_CHECK_MULTIPATH_LOOKAROUND:
+            return sizeof(u.checkMultipathLookaround);
         case ROSE_INSTR_CHECK_MASK: return sizeof(u.checkMask);
+        case ROSE_INSTR_CHECK_MASK_32: return sizeof(u.checkMask32);
+        case ROSE_INSTR_CHECK_MASK_64: return sizeof(u.checkMask64);
+        case ROSE_INSTR_CHECK_SHUFTI_32x8: return sizeof(u.checkShufti32x8);
         case ROSE_INSTR_CHECK_BYTE: return sizeof(u.checkByte);
         case ROSE_INSTR_CHECK_INFIX: return sizeof(u.checkInfix);
         case ROSE_INSTR_CHECK_PREFIX: return sizeof(u.checkPrefix);
@@ -278,6 +312,7 @@ public:
         case ROSE_INSTR_REPORT_SOM_EXHAUST: return sizeof(u.reportSomExhaust);
         case ROSE_INSTR_DEDUPE_AND_REPORT: return sizeof(u.dedupeAndReport);
         case ROSE_INSTR_FINAL_REPORT: return sizeof(u.finalReport);
+        case ROSE_INSTR_REPORT_MULTI: return sizeof(u.reportMulti);
         case ROSE_INSTR_CHECK_EXHAUSTED: return sizeof(u.checkExhausted);
         case ROSE_INSTR_CHECK_MIN_LENGTH: return sizeof(u.checkMinLength);
         case ROSE_INSTR_SET_STATE: return sizeof(u.setState);
@@ -289,6 +324,13 @@ public:
         case ROSE_INSTR_ENGINES_EOD: return sizeof(u.enginesEod);
         case ROSE_INSTR_SUFFIXES_EOD: return sizeof(u.suffixesEod);
         case ROSE_INSTR_MATCHER_EOD: return sizeof(u.matcherEod);
+        case ROSE_INSTR_FLUSH_COMBINATION: return sizeof(u.flushCombination);
+        case ROSE_INSTR_SET_LOGICAL: return sizeof(u.setLogical);
+        case ROSE_INSTR_SET_COMBINATION: return sizeof(u.setCombination);
+        case ROSE_INSTR_COUNT_MATCH: return sizeof(u.countMatch);
+        case ROSE_INSTR_CHECK_CONFIRM: return sizeof(u.checkConfirm);
+        case ROSE_INSTR_CHECK_SUBGROUP: return sizeof(u.checkSubgroup);
+        case ROSE_INSTR_SQUASH_SUBGROUP: return sizeof(u.squashSubgroup);
         case ROSE_INSTR_END: return sizeof(u.end);
         }
         assert(0);
@@ -302,8 +344,13 @@ public:
         ROSE_STRUCT_CHECK_ONLY_EOD checkOnlyEod;
         ROSE_STRUCT_CHECK_BOUNDS checkBounds;
         ROSE_STRUCT_CHECK_NOT_HANDLED checkNotHandled;
+        ROSE_STRUCT_CHECK_BOUNDS_NOT_HANDLED checkBoundsNotHandled;
         ROSE_STRUCT_CHECK_LOOKAROUND checkLookaround;
+        ROSE_STRUCT_CHECK_MULTIPATH_LOOKAROUND checkMultipathLookaround;
         ROSE_STRUCT_CHECK_MASK checkMask;
+        ROSE_STRUCT_CHECK_MASK_32 checkMask32;
+        ROSE_STRUCT_CHECK_MASK_64 checkMask64;
+        ROSE_STRUCT_CHECK_SHUFTI_32x8 checkShufti32x8;
         ROSE_STRUCT_CHECK_BYTE checkByte;
         ROSE_STRUCT_CHECK_INFIX checkInfix;
         ROSE_STRUCT_CHECK_PREFIX checkPrefix;
@@ -329,6 +376,7 @@ public:
         ROSE_STRUCT_REPORT_SOM_EXHAUST reportSomExhaust;
         ROSE_STRUCT_DEDUPE_AND_REPORT dedupeAndReport;
         ROSE_STRUCT_FINAL_REPORT finalReport;
+        ROSE_STRUCT_REPORT_MULTI reportMulti;
         ROSE_STRUCT_CHECK_EXHAUSTED checkExhausted;
         ROSE_STRUCT_CHECK_MIN_LENGTH checkMinLength;
         ROSE_STRUCT_SET_STATE setState;
@@ -340,6 +388,13 @@ public:
         ROSE_STRUCT_ENGINES_EOD enginesEod;
         ROSE_STRUCT_SUFFIXES_EOD suffixesEod;
         ROSE_STRUCT_MATCHER_EOD matcherEod;
+        ROSE_STRUCT_FLUSH_COMBINATION flushCombination;
+        ROSE_STRUCT_SET_LOGICAL setLogical;
+        ROSE_STRUCT_SET_COMBINATION setCombination;
+        ROSE_STRUCT_COUNT_MATCH countMatch;
+        ROSE_STRUCT_CHECK_CONFIRM checkConfirm;
+        ROSE_STRUCT_CHECK_SUBGROUP checkSubgroup;
+        ROSE_STRUCT_SQUASH_SUBGROUP squashSubgroup;
         ROSE_STRUCT_END end;
     } u;
 
@@ -405,6 +460,14 @@ struct build_context : boost::noncopyable {
      * deduplication. */
     ue2::unordered_map<vector<RoseInstruction>, u32> program_cache;
 
+    /** \brief Cache of report lists used by REPORT_MULTI instructions,
+     * mapping each list to its offset in the engine blob. */
+    map<vector<tuple<ReportID, s32, u32>>, u32> reportListCache;
+
+    /** \brief Total size in bytes of the programs written to the engine
+     * blob, not counting alignment padding. */
+    size_t programBytes = 0;
+
     /** \brief LookEntry list cache, so that we don't have to go scanning
      * through the full list to find cases we've used already. */
     ue2::unordered_map<vector<LookEntry>, size_t> lookaround_cache;
@@ -447,6 +510,14 @@ struct build_context : boost::noncopyable {
     /** \brief Global bitmap of groups that can be squashed. */
     rose_group squashable_groups = 0;
 
+    /** \brief Initial subgroup masks of the groups with subgroup squashers,
+     * by group index; the subgroup index of a group is its position here. */
+    map<u32, u64a> subgroup_masks;
+
+    /** \brief Escape class assigned to each distinct LBR escape (engine type
+     * followed by its escape char or masks). */
+    map<vector<u8>, u32> lbrEscapeClasses;
+
     /** \brief Base offset of engine_blob in the Rose engine bytecode. */
     static constexpr u32 engine_blob_base = ROUNDUP_CL(sizeof(RoseEngine));
 };
@@ -525,8 +596,55 @@ const NFA *get_nfa_from_blob(const build_context &bc, u32 qi) {
     return n;
 }
 
+/**
+ * \brief Places LBR engines with identical escapes in the same escape class,
+ * so that they can share the results of their escape scans at runtime.
+ */
+static
+void assignLbrEscapeClass(build_context &bc, NFA &nfa) {
+    if (!isLbrType(nfa.type) || nfa.type == LBR_NFA_Dot) {
+        return; // nothing to share, dots can't be escaped
+    }
+
+    lbr_common *l = (lbr_common *)getMutableImplNfa(&nfa);
+    const u8 *escape;
+    size_t escape_len;
+    switch (nfa.type) {
+    case LBR_NFA_Verm:
+    case LBR_NFA_NVerm:
+        escape = (const u8 *)&((lbr_verm *)l)->c;
+        escape_len = 1;
+        break;
+    case LBR_NFA_Shuf:
+        escape = (const u8 *)&((lbr_shuf *)l)->mask_lo;
+        escape_len = sizeof(m128) * 2;
+        break;
+    case LBR_NFA_Truf:
+        escape = (const u8 *)&((lbr_truf *)l)->mask1;
+        escape_len = sizeof(m128) * 2;
+        break;
+    default:
+        assert(0);
+        return;
+    }
+
+    vector<u8> key(1, nfa.type);
+    key.insert(key.end(), escape, escape + escape_len);
+
+    auto it = bc.lbrEscapeClasses.find(key);
+    if (it == bc.lbrEscapeClasses.end()) {
+        u32 escapeClass = verify_u32(bc.lbrEscapeClasses.size());
+        it = bc.lbrEscapeClasses.emplace(move(key), escapeClass).first;
+    }
+    l->escapeClass = it->second;
+    DEBUG_PRINTF("lbr qi=%u in escape class %u\n", nfa.queueIndex,
+                 l->escapeClass);
+}
+
 static
 const NFA *add_nfa_to_blob(build_context &bc, NFA &nfa) {
+    assignLbrEscapeClass(bc, nfa);
+
     u32 qi = nfa.queueIndex;
     u32 nfa_offset = add_to_engine_blob(bc, nfa, nfa.length);
     DEBUG_PRINTF("added nfa qi=%u, type=%u, length=%u at offset=%u\n", qi,
@@ -593,6 +711,44 @@ bool needsCatchup(const RoseBuildImpl &build) {
     return false;
 }
 
+/**
+ * \brief True if suffixes and outfixes may deliver their matches directly,
+ * out of offset order, as permitted by HS_MODE_UNORDERED.
+ *
+ * Match deduplication, SOM, logical combinations and the chained MPV engine
+ * all depend on matches arriving in order, so any of them rules this out.
+ */
+static
+bool canDeliverUnordered(const RoseBuildImpl &build) {
+    if (!build.cc.unordered_matches) {
+        return false;
+    }
+
+    if (build.hasSom) {
+        DEBUG_PRINTF("has som\n");
+        return false;
+    }
+
+    if (build.rm.numDkeys()) {
+        DEBUG_PRINTF("has dedupe keys\n");
+        return false;
+    }
+
+    if (build.rm.pl.numCombinations()) {
+        DEBUG_PRINTF("has logical combinations\n");
+        return false;
+    }
+
+    for (const auto &outfix : build.outfixes) {
+        if (outfix.mpv()) {
+            DEBUG_PRINTF("has mpv\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static
 bool isPureFloating(const RoseResources &resources) {
     if (resources.has_outfixes || resources.has_suffixes ||
@@ -709,7 +865,7 @@ void fillStateOffsets(const RoseBuildImpl &tbi, u32 rolesWithStateCount,
                       u32 anchorStateSize, u32 activeArrayCount,
                       u32 activeLeftCount, u32 laggedRoseCount,
                       u32 floatingStreamStateRequired, u32 historyRequired,
-                      RoseStateOffsets *so) {
+                      u32 subgroupCount, RoseStateOffsets *so) {
     u32 curr_offset = 0;
 
     // First, runtime status (stores per-stream state, like whether we need a
@@ -741,14 +897,46 @@ void fillStateOffsets(const RoseBuildImpl &tbi, u32 rolesWithStateCount,
     assert(so->groups_size <= sizeof(u64a));
     curr_offset += so->groups_size;
 
+    // Subgroup masks, one u64a per group with subgroup squashers.
+    so->subgroups = curr_offset;
+    curr_offset += subgroupCount * sizeof(u64a);
+
     // The history consists of the bytes in the history only. YAY
     so->history = curr_offset;
     curr_offset += historyRequired;
 
+    // note: state space for engines is allocated later, followed by the cold
+    // state laid out by fillColdStateOffsets()
+    so->end = curr_offset;
+}
+
+/**
+ * \brief Lay out the Rose state that is rarely written during a scan.
+ *
+ * This is placed after all engine state, so that the state touched by every
+ * stream write is packed into as few cache lines as possible at the start of
+ * the stream state.
+ */
+static
+void fillColdStateOffsets(const RoseBuildImpl &tbi, RoseStateOffsets *so) {
+    u32 curr_offset = so->end;
+
     // Exhaustion multibit.
     so->exhausted = curr_offset;
     curr_offset += mmbit_size(tbi.rm.numEkeys());
 
+    // Logical and combination multibits, for logical combinations.
+    so->logicalVec = curr_offset;
+    curr_offset += mmbit_size(tbi.rm.pl.numLogicalKeys());
+    so->combVec = curr_offset;
+    curr_offset += mmbit_size(tbi.rm.pl.numCombinations());
+    so->activeCombVec = curr_offset;
+    curr_offset += mmbit_size(tbi.rm.pl.numCombinations());
+
+    // Match counters, one u32 per report with a match limit.
+    so->matchCounts = curr_offset;
+    curr_offset += tbi.rm.numMatchLimits() * sizeof(u32);
+
     // SOM locations and valid/writeable multibit structures.
     if (tbi.ssm.numSomSlots()) {
         const u32 somWidth = tbi.ssm.somPrecision();
@@ -770,7 +958,6 @@ void fillStateOffsets(const RoseBuildImpl &tbi, u32 rolesWithStateCount,
         so->somWritable = 0;
     }
 
-    // note: state space for mask nfas is allocated later
     so->end = curr_offset;
 }
 
@@ -856,12 +1043,13 @@ void findFixedDepthTops(const RoseGraph &g, const set<PredTopPair> &triggers,
 }
 
 /**
- * \brief Heuristic for picking between a DFA or NFA implementation of an
- * engine.
+ * \brief Picks between a DFA or NFA implementation of an engine by their
+ * estimated scan cost on the target.
  */
 static
 aligned_unique_ptr<NFA> pickImpl(aligned_unique_ptr<NFA> dfa_impl,
-                                 aligned_unique_ptr<NFA> nfa_impl) {
+                                 aligned_unique_ptr<NFA> nfa_impl,
+                                 const CompileContext &cc) {
     assert(nfa_impl);
     assert(dfa_impl);
     assert(isDfaType(dfa_impl->type));
@@ -871,41 +1059,16 @@ aligned_unique_ptr<NFA> pickImpl(aligned_unique_ptr<NFA> dfa_impl,
         return nfa_impl;
     }
 
-    // if our DFA is an accelerated Sheng, it always wins.
-    if (isShengType(dfa_impl->type) && has_accel(*dfa_impl)) {
-        return dfa_impl;
-    }
+    u32 d_cost = estimated_scan_cost(*dfa_impl, cc.target_info);
+    u32 n_cost = estimated_scan_cost(*nfa_impl, cc.target_info);
+    DEBUG_PRINTF("dfa cost %u, nfa cost %u\n", d_cost, n_cost);
 
-    bool d_accel = has_accel(*dfa_impl);
-    bool n_accel = has_accel(*nfa_impl);
-    bool d_big = dfa_impl->type == MCCLELLAN_NFA_16;
-    bool n_vsmall = nfa_impl->nPositions <= 32;
-    bool n_br = has_bounded_repeats(*nfa_impl);
-    DEBUG_PRINTF("da %d na %d db %d nvs %d nbr %d\n", (int)d_accel,
-                 (int)n_accel, (int)d_big, (int)n_vsmall, (int)n_br);
-    if (d_big) {
-        if (!n_vsmall) {
-            if (d_accel || !n_accel) {
-                return dfa_impl;
-            } else {
-                return nfa_impl;
-            }
-        } else {
-            if (n_accel) {
-                return nfa_impl;
-            } else {
-                return dfa_impl;
-            }
-        }
-    } else {
-        /* favour a McClellan 8, unless the nfa looks really good and the dfa
-         * looks like trouble */
-        if (!d_accel && n_vsmall && n_accel && !n_br) {
-            return nfa_impl;
-        } else {
-            return dfa_impl;
-        }
+    // DFAs have simpler stream state and no repeat handling, so they win
+    // ties.
+    if (n_cost < d_cost) {
+        return nfa_impl;
     }
+    return dfa_impl;
 }
 
 /**
@@ -931,12 +1094,42 @@ buildRepeatEngine(const CastleProto &proto,
 static
 aligned_unique_ptr<NFA> getDfa(raw_dfa &rdfa, const CompileContext &cc,
                                const ReportManager &rm) {
+    string key;
+    if (cc.engine_cache) {
+        // Both engine builders start by doing this, so do it before taking
+        // the key in order that a cache hit leaves rdfa in the same state.
+        if (!cc.streaming) {
+            rdfa.stripExtraEodReports();
+        }
+        key = dfaEngineKey(rdfa, rm, cc);
+        auto dfa = cc.engine_cache->find(key);
+        if (dfa) {
+            DEBUG_PRINTF("engine cache hit\n");
+            return dfa;
+        }
+    }
+
     // Unleash the Sheng!!
     auto dfa = shengCompile(rdfa, cc, rm);
+    if (!dfa) {
+        // Too big for Sheng; try the wide variants, if the target has them.
+        dfa = sheng32Compile(rdfa, cc, rm);
+    }
+    if (!dfa) {
+        dfa = sheng64Compile(rdfa, cc, rm);
+    }
+    if (!dfa) {
+        // Try the hybrid: Sheng for the hot core, McClellan for the rest.
+        dfa = mcshengCompile(rdfa, cc, rm);
+    }
     if (!dfa) {
         // Sheng wasn't successful, so unleash McClellan!
         dfa = mcclellanCompile(rdfa, cc, rm);
     }
+
+    if (dfa && cc.engine_cache) {
+        cc.engine_cache->insert(key, *dfa);
+    }
     return dfa;
 }
 
@@ -986,19 +1179,24 @@ buildSuffix(const ReportManager &rm, const SomSlotManager &ssm,
     if (oneTop && cc.grey.roseMcClellanSuffix) {
         if (cc.grey.roseMcClellanSuffix == 2 || n->nPositions > 128 ||
             !has_bounded_repeats_other_than_firsts(*n)) {
+            // Over the compile time budget, keep the NFA.
+            if (overBudget(cc)) {
+                markDegraded(holder, rm, cc);
+                return n;
+            }
             auto rdfa = buildMcClellan(holder, &rm, false, triggers.at(0),
                                        cc.grey);
             if (rdfa) {
                 auto d = getDfa(*rdfa, cc, rm);
                 assert(d);
                 if (cc.grey.roseMcClellanSuffix != 2) {
-                    n = pickImpl(move(d), move(n));
+                    n = pickImpl(move(d), move(n), cc);
                 } else {
                     n = move(d);
                 }
 
                 assert(n);
-                if (isMcClellanType(n->type)) {
+                if (isMcClellanType(n->type) || isMcShengType(n->type)) {
                     // DFA chosen. We may be able to set some more properties
                     // in the NFA structure here.
                     u64a maxOffset = findMaxOffset(holder, rm);
@@ -1143,7 +1341,7 @@ makeLeftNfa(const RoseBuildImpl &tbi, left_id &left,
         if (rdfa) {
             auto d = getDfa(*rdfa, cc, rm);
             assert(d);
-            n = pickImpl(move(d), move(n));
+            n = pickImpl(move(d), move(n), cc);
         }
     }
 
@@ -1794,7 +1992,7 @@ bool buildLeftfixes(RoseBuildImpl &tbi, build_context &bc,
         // TODO: Handle SOM-tracking cases as well.
         if (cc.grey.roseLookaroundMasks && is_transient &&
             !g[v].left.tracksSom()) {
-            vector<LookEntry> lookaround;
+            vector<vector<LookEntry>> lookaround;
             if (makeLeftfixLookaround(tbi, v, lookaround)) {
                 DEBUG_PRINTF("implementing as lookaround!\n");
                 bc.leftfix_info.emplace(v, left_build_info(lookaround));
@@ -1900,14 +2098,18 @@ public:
         auto n = constructNFA(h, &rm, fixed_depth_tops, triggers,
                               compress_state, cc);
 
-        // Try for a DFA upgrade.
+        // Try for a DFA upgrade, unless over the compile time budget.
         if (n && cc.grey.roseMcClellanOutfix &&
             !has_bounded_repeats_other_than_firsts(*n)) {
+            if (overBudget(cc)) {
+                markDegraded(h, rm, cc);
+                return n;
+            }
             auto rdfa = buildMcClellan(h, &rm, cc.grey);
             if (rdfa) {
                 auto d = getDfa(*rdfa, cc, rm);
                 if (d) {
-                    n = pickImpl(move(d), move(n));
+                    n = pickImpl(move(d), move(n), cc);
                 }
             }
         }
@@ -1921,6 +2123,25 @@ public:
         return nullptr;
     }
 
+    aligned_unique_ptr<NFA> operator()(DfaGroupProto &group) const {
+        // Members are always McClellan: the group engine steps their
+        // transition tables directly.
+        vector<aligned_unique_ptr<NFA>> members;
+        for (auto &rdfa : group.members) {
+            auto n = mcclellanCompile(*rdfa, build.cc, build.rm);
+            if (!n) {
+                return nullptr;
+            }
+            members.push_back(move(n));
+        }
+
+        vector<const NFA *> member_ptrs;
+        for (const auto &n : members) {
+            member_ptrs.push_back(n.get());
+        }
+        return buildDfaGroup(member_ptrs);
+    }
+
 private:
     const RoseBuildImpl &build;
 };
@@ -2375,7 +2596,8 @@ void findTransientQueues(const map<RoseVertex, left_build_info> &leftfix_info,
 }
 
 static
-void updateNfaState(const build_context &bc, RoseStateOffsets *so,
+void updateNfaState(const build_context &bc, u32 outfixEndQueue,
+                    u32 leftfixBeginQueue, RoseStateOffsets *so,
                     NfaInfo *nfa_infos, u32 *fullStateSize, u32 *nfaStateSize,
                     u32 *tStateSize) {
     *nfaStateSize = 0;
@@ -2385,15 +2607,51 @@ void updateNfaState(const build_context &bc, RoseStateOffsets *so,
     set<u32> transient_queues;
     findTransientQueues(bc.leftfix_info, &transient_queues);
 
+    // The MPV, outfixes and leftfixes are live for much of a stream, so their
+    // state goes first. Suffixes are only live once triggered, so theirs goes
+    // after the hot part of the stream state.
+    vector<u32> hot_queues;
+    vector<u32> suffix_queues;
     for (const auto &m : bc.engineOffsets) {
-        const NFA *n = get_nfa_from_blob(bc, m.first);
+        u32 qi = m.first;
+        if (qi >= outfixEndQueue && qi < leftfixBeginQueue) {
+            suffix_queues.push_back(qi);
+        } else {
+            hot_queues.push_back(qi);
+        }
+    }
+    sort(begin(hot_queues), end(hot_queues));
+    sort(begin(suffix_queues), end(suffix_queues));
+
+    for (u32 qi : hot_queues) {
+        const NFA *n = get_nfa_from_blob(bc, qi);
         allocateStateSpace(n, transient_queues, so, nfa_infos, fullStateSize,
                            nfaStateSize, tStateSize);
     }
+
+    so->hotEnd = so->end;
+
+    for (u32 qi : suffix_queues) {
+        const NFA *n = get_nfa_from_blob(bc, qi);
+        allocateStateSpace(n, transient_queues, so, nfa_infos, fullStateSize,
+                           nfaStateSize, tStateSize);
+    }
+}
+
+/** \brief Returns the size of the LimEx lazy DFA cache required in scratch:
+ * zero if no engine uses it. */
+static
+u32 limexCacheSize(const build_context &bc) {
+    for (const auto &m : bc.engineOffsets) {
+        if (nfaUsesLimExCache(get_nfa_from_blob(bc, m.first))) {
+            return sizeof(struct limex_dfa_cache);
+        }
+    }
+    return 0;
 }
 
 /* does not include history requirements for outfixes or literal matchers */
-u32 RoseBuildImpl::calcHistoryRequired() const {
+u32 RoseBuildImpl::calcHistoryRequired(bool idle) const {
     u32 m = cc.grey.minHistoryAvailable;
 
     for (auto v : vertices_range(g)) {
@@ -2416,7 +2674,7 @@ u32 RoseBuildImpl::calcHistoryRequired() const {
                 }
 
                 m = MAX(m, mv);
-            } else {
+            } else if (!idle) {
                 /* rose will be caught up from (lag - 1), also need an extra
                  * byte behind that to find the decompression key */
                 m = MAX(m, lag + 1);
@@ -2430,7 +2688,7 @@ u32 RoseBuildImpl::calcHistoryRequired() const {
     for (const auto &e : literals.right) {
         const u32 id = e.first;
         const auto &lit = e.second;
-        if (lit.delay) {
+        if (lit.delay && !idle) {
             // If the literal is delayed _and_ has a mask that is longer than
             // the literal, we need enough history to match the whole mask as
             // well when rebuilding delayed matches.
@@ -2770,6 +3028,45 @@ getLiteralInfoByFinalId(const RoseBuildImpl &build, u32 final_id) {
     return out;
 }
 
+/**
+ * \brief Replaces common adjacent instruction pairs within a program block
+ * with equivalent super-instructions, so that the interpreter dispatches fewer
+ * instructions.
+ *
+ * Jumps only ever target the start of a block or the end of the program, so
+ * fusing instructions within a block cannot invalidate a jump target.
+ */
+static
+vector<RoseInstruction> fuseInstructions(const vector<RoseInstruction> &block) {
+    vector<RoseInstruction> out;
+    out.reserve(block.size());
+
+    for (size_t i = 0; i < block.size(); i++) {
+        const auto &ri = block[i];
+        if (i + 1 < block.size() && ri.code() == ROSE_INSTR_CHECK_BOUNDS &&
+            ri.target == JumpTarget::NEXT_BLOCK) {
+            const auto &next = block[i + 1];
+            if (next.code() == ROSE_INSTR_CHECK_NOT_HANDLED &&
+                next.target == JumpTarget::NEXT_BLOCK) {
+                DEBUG_PRINTF("fusing CHECK_BOUNDS and CHECK_NOT_HANDLED\n");
+                auto ri2 = RoseInstruction(ROSE_INSTR_CHECK_BOUNDS_NOT_HANDLED,
+                                           JumpTarget::NEXT_BLOCK);
+                ri2.u.checkBoundsNotHandled.min_bound =
+                    ri.u.checkBounds.min_bound;
+                ri2.u.checkBoundsNotHandled.max_bound =
+                    ri.u.checkBounds.max_bound;
+                ri2.u.checkBoundsNotHandled.key = next.u.checkNotHandled.key;
+                out.push_back(move(ri2));
+                i++; // Skip the CHECK_NOT_HANDLED.
+                continue;
+            }
+        }
+        out.push_back(ri);
+    }
+
+    return out;
+}
+
 /**
  * \brief Flattens a list of role programs into one finalised program with its
  * fail_jump/done_jump targets set correctly.
@@ -2786,7 +3083,8 @@ flattenProgram(const vector<vector<RoseInstruction>> &programs) {
     DEBUG_PRINTF("%zu program blocks\n", programs.size());
 
     size_t curr_offset = 0;
-    for (const auto &program : programs) {
+    for (const auto &orig_program : programs) {
+        const auto program = fuseInstructions(orig_program);
         DEBUG_PRINTF("block with %zu instructions\n", program.size());
         block_offsets.push_back(curr_offset);
         for (const auto &ri : program) {
@@ -2841,12 +3139,27 @@ flattenProgram(const vector<vector<RoseInstruction>> &programs) {
         case ROSE_INSTR_CHECK_NOT_HANDLED:
             ri.u.checkNotHandled.fail_jump = jump_val;
             break;
+        case ROSE_INSTR_CHECK_BOUNDS_NOT_HANDLED:
+            ri.u.checkBoundsNotHandled.fail_jump = jump_val;
+            break;
         case ROSE_INSTR_CHECK_LOOKAROUND:
             ri.u.checkLookaround.fail_jump = jump_val;
             break;
+        case ROSE_INSTR_CHECK_MULTIPATH_LOOKAROUND:
+            ri.u.checkMultipathLookaround.fail_jump = jump_val;
+            break;
         case ROSE_INSTR_CHECK_MASK:
             ri.u.checkMask.fail_jump = jump_val;
             break;
+        case ROSE_INSTR_CHECK_MASK_32:
+            ri.u.checkMask32.fail_jump = jump_val;
+            break;
+        case ROSE_INSTR_CHECK_MASK_64:
+            ri.u.checkMask64.fail_jump = jump_val;
+            break;
+        case ROSE_INSTR_CHECK_SHUFTI_32x8:
+            ri.u.checkShufti32x8.fail_jump = jump_val;
+            break;
         case ROSE_INSTR_CHECK_BYTE:
             ri.u.checkByte.fail_jump = jump_val;
             break;
@@ -2880,6 +3193,9 @@ flattenProgram(const vector<vector<RoseInstruction>> &programs) {
         case ROSE_INSTR_SPARSE_ITER_NEXT:
             ri.u.sparseIterNext.fail_jump = jump_val;
             break;
+        case ROSE_INSTR_CHECK_CONFIRM:
+            ri.u.checkConfirm.fail_jump = jump_val;
+            break;
         default:
             assert(0); // Unhandled opcode?
             break;
@@ -3009,6 +3325,7 @@ u32 writeProgram(build_context &bc, const vector<RoseInstruction> &program) {
             add_to_engine_blob(bc, ri.get(), ri.length(), ROSE_INSTR_MIN_ALIGN);
         DEBUG_PRINTF("code %u len %zu written at offset %u\n", ri.code(),
                      ri.length(), offset);
+        bc.programBytes += ri.length();
         if (!programOffset) {
             programOffset = offset;
         }
@@ -3292,6 +3609,183 @@ bool makeRoleMask(const vector<LookEntry> &look,
     return false;
 }
 
+/**
+ * \brief Build byte-wise and/cmp masks and a negation bitmask covering a
+ * window of \a width bytes starting at the first lookaround entry. Positions
+ * with no entry are left as zero masks, which always pass.
+ */
+static
+bool makeWideMask(const vector<LookEntry> &look, u32 width, u8 *and_mask,
+                  u8 *cmp_mask, u64a &neg_mask) {
+    assert(width <= 64);
+    if (look.back().offset >= look.front().offset + (s32)width) {
+        return false;
+    }
+
+    fill(and_mask, and_mask + width, 0);
+    fill(cmp_mask, cmp_mask + width, 0);
+    neg_mask = 0;
+    for (const auto &entry : look) {
+        u8 andmask_u8, cmpmask_u8, flip;
+        if (!checkReachWithFlip(entry.reach, andmask_u8, cmpmask_u8, flip)) {
+            return false;
+        }
+        u32 shift = entry.offset - look.front().offset;
+        and_mask[shift] = andmask_u8;
+        cmp_mask[shift] = cmpmask_u8;
+        if (flip) {
+            neg_mask |= 1ULL << shift;
+        }
+    }
+    return true;
+}
+
+static
+bool makeRoleMask32(const vector<LookEntry> &look,
+                    vector<RoseInstruction> &program) {
+    auto ri = RoseInstruction(ROSE_INSTR_CHECK_MASK_32,
+                              JumpTarget::NEXT_BLOCK);
+    auto &check = ri.u.checkMask32;
+    u64a neg_mask;
+    if (!makeWideMask(look, sizeof(check.and_mask), check.and_mask,
+                      check.cmp_mask, neg_mask)) {
+        return false;
+    }
+    DEBUG_PRINTF("CHECK MASK 32 neg_mask=%llx\n", neg_mask);
+    check.neg_mask = verify_u32(neg_mask);
+    check.offset = verify_s32(look.front().offset);
+    program.push_back(ri);
+    return true;
+}
+
+static
+bool makeRoleMask64(const vector<LookEntry> &look,
+                    vector<RoseInstruction> &program) {
+    auto ri = RoseInstruction(ROSE_INSTR_CHECK_MASK_64,
+                              JumpTarget::NEXT_BLOCK);
+    auto &check = ri.u.checkMask64;
+    u64a neg_mask;
+    if (!makeWideMask(look, sizeof(check.and_mask), check.and_mask,
+                      check.cmp_mask, neg_mask)) {
+        return false;
+    }
+    DEBUG_PRINTF("CHECK MASK 64 neg_mask=%llx\n", neg_mask);
+    check.neg_mask = neg_mask;
+    check.offset = verify_s32(look.front().offset);
+    program.push_back(ri);
+    return true;
+}
+
+/**
+ * \brief Implement lookarounds spanning at most 32 bytes with a shufti check
+ * using up to eight buckets.
+ *
+ * Each reach is split into (low nibble set, high nibble set) products by
+ * grouping the high nibbles that share the same set of low nibbles; every
+ * distinct product needs its own bucket. Reaches with more than half the
+ * alphabet are flipped and checked with negation, as that usually needs
+ * fewer buckets.
+ */
+static
+bool makeRoleShufti(const vector<LookEntry> &look,
+                    vector<RoseInstruction> &program) {
+    const s32 base_offset = look.front().offset;
+    if (look.back().offset >= base_offset + 32) {
+        return false;
+    }
+
+    auto ri = RoseInstruction(ROSE_INSTR_CHECK_SHUFTI_32x8,
+                              JumpTarget::NEXT_BLOCK);
+    auto &check = ri.u.checkShufti32x8;
+    u8 lo_mask[16] = {0};
+    u8 hi_mask[16] = {0};
+    fill(begin(check.bucket_select_mask), end(check.bucket_select_mask), 0);
+    u32 neg_mask = ~0U; // Positions without entries always pass.
+
+    map<pair<u16, u16>, u8> buckets; // (lo nibbles, hi nibbles) -> bucket bit
+    for (const auto &entry : look) {
+        CharReach cr = entry.reach;
+        bool flip = false;
+        if (cr.count() > 128) {
+            cr.flip();
+            flip = true;
+        }
+
+        // Low nibble set for each high nibble, grouped by that set.
+        map<u16, u16> groups; // lo nibbles -> hi nibbles
+        for (u32 hi = 0; hi < 16; hi++) {
+            u16 lo_set = 0;
+            for (u32 lo = 0; lo < 16; lo++) {
+                if (cr.test(hi << 4 | lo)) {
+                    lo_set |= 1U << lo;
+                }
+            }
+            if (lo_set) {
+                groups[lo_set] |= 1U << hi;
+            }
+        }
+
+        u8 select = 0;
+        for (const auto &g : groups) {
+            auto key = make_pair(g.first, g.second);
+            auto it = buckets.find(key);
+            if (it == buckets.end()) {
+                if (buckets.size() == 8) {
+                    DEBUG_PRINTF("too many buckets\n");
+                    return false;
+                }
+                u8 bit = 1U << buckets.size();
+                it = buckets.emplace(key, bit).first;
+                for (u32 i = 0; i < 16; i++) {
+                    if (g.first & (1U << i)) {
+                        lo_mask[i] |= bit;
+                    }
+                    if (g.second & (1U << i)) {
+                        hi_mask[i] |= bit;
+                    }
+                }
+            }
+            select |= it->second;
+        }
+
+        u32 shift = entry.offset - base_offset;
+        check.bucket_select_mask[shift] = select;
+        if (!flip) {
+            neg_mask &= ~(1U << shift);
+        }
+    }
+
+    DEBUG_PRINTF("CHECK SHUFTI 32x8 with %zu buckets neg_mask=%08x\n",
+                 buckets.size(), neg_mask);
+    for (u32 i = 0; i < 32; i++) {
+        check.lo_mask[i] = lo_mask[i % 16];
+        check.hi_mask[i] = hi_mask[i % 16];
+    }
+    check.neg_mask = neg_mask;
+    check.offset = verify_s32(base_offset);
+    program.push_back(ri);
+    return true;
+}
+
+static
+void makeRoleMultipathLookaround(build_context &bc,
+                                 const vector<vector<LookEntry>> &paths,
+                                 vector<RoseInstruction> &program) {
+    assert(paths.size() > 1);
+    assert(paths.size() <= ROSE_MULTIPATH_LOOKAROUND_MAX);
+    DEBUG_PRINTF("role has %zu lookaround paths\n", paths.size());
+
+    auto ri = RoseInstruction(ROSE_INSTR_CHECK_MULTIPATH_LOOKAROUND,
+                              JumpTarget::NEXT_BLOCK);
+    auto &multi = ri.u.checkMultipathLookaround;
+    multi.path_count = verify_u8(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        multi.index[i] = addLookaround(bc, paths[i]);
+        multi.count[i] = verify_u32(paths[i].size());
+    }
+    program.push_back(ri);
+}
+
 static
 void makeRoleLookaround(RoseBuildImpl &build, build_context &bc, RoseVertex v,
                         vector<RoseInstruction> &program) {
@@ -3303,8 +3797,15 @@ void makeRoleLookaround(RoseBuildImpl &build, build_context &bc, RoseVertex v,
 
     // Lookaround from leftfix (mandatory).
     if (contains(bc.leftfix_info, v) && bc.leftfix_info.at(v).has_lookaround) {
-        DEBUG_PRINTF("using leftfix lookaround\n");
-        look = bc.leftfix_info.at(v).lookaround;
+        const auto &paths = bc.leftfix_info.at(v).lookaround;
+        if (paths.size() == 1) {
+            DEBUG_PRINTF("using leftfix lookaround\n");
+            look = paths.front();
+        } else {
+            // Any one path satisfies the leftfix; advisory lookaround is
+            // checked on its own below.
+            makeRoleMultipathLookaround(bc, paths, program);
+        }
     }
 
     // We may be able to find more lookaround info (advisory) and merge it
@@ -3325,6 +3826,18 @@ void makeRoleLookaround(RoseBuildImpl &build, build_context &bc, RoseVertex v,
         return;
     }
 
+    if (makeRoleMask32(look, program)) {
+        return;
+    }
+
+    if (makeRoleShufti(look, program)) {
+        return;
+    }
+
+    if (makeRoleMask64(look, program)) {
+        return;
+    }
+
     DEBUG_PRINTF("role has lookaround\n");
     u32 look_idx = addLookaround(bc, look);
     u32 look_count = verify_u32(look.size());
@@ -3409,6 +3922,21 @@ void makeDedupeSom(const RoseBuildImpl &build, const Report &report,
     report_block.push_back(move(ri));
 }
 
+static
+void makeMatchCount(const RoseBuildImpl &build, const Report &report,
+                    vector<RoseInstruction> &report_block) {
+    const match_limit_info *limit = build.rm.getMatchLimit(report.onmatch);
+    if (!limit || build.cc.any_match) {
+        return;
+    }
+
+    report_block.emplace_back(ROSE_INSTR_COUNT_MATCH);
+    auto &ri = report_block.back();
+    ri.u.countMatch.key = limit->key;
+    ri.u.countMatch.limit = limit->limit;
+    ri.u.countMatch.ekey = limit->ekey;
+}
+
 static
 void makeCatchup(RoseBuildImpl &build, build_context &bc,
                  const flat_set<ReportID> &reports,
@@ -3519,14 +4047,39 @@ void writeSomOperation(const Report &report, som_operation *op) {
     }
 }
 
+/** \brief Resolve the jumps in a report block and append it to \a program. */
+static
+void addReportBlock(vector<RoseInstruction> &program,
+                    vector<RoseInstruction> &report_block) {
+    report_block = flattenProgram({report_block});
+    assert(report_block.back().code() == ROSE_INSTR_END);
+    report_block.pop_back();
+    insert(&program, program.end(), report_block);
+}
+
 static
 void makeReport(RoseBuildImpl &build, const ReportID id,
                 const bool has_som, vector<RoseInstruction> &program) {
     assert(id < build.rm.numReports());
     const Report &report = build.rm.getReport(id);
+    const ParsedLogical &pl = build.rm.pl;
+    const bool ext = isExternalReport(report);
 
     vector<RoseInstruction> report_block;
 
+    // In HS_MODE_ANY_MATCH mode, the first report delivered to the user
+    // terminates the scan, so plain reports need neither dedupe nor
+    // exhaustion handling.
+    const bool any_match = build.cc.any_match && !build.hasSom;
+
+    // Any external report may move us past the offset at which active
+    // logical combinations must be evaluated.
+    if (ext && pl.numCombinations()) {
+        report_block.emplace_back(ROSE_INSTR_FLUSH_COMBINATION);
+        auto &ri = report_block.back();
+        ri.u.flushCombination.offset_adjust = report.offsetAdjust;
+    }
+
     // Handle min/max offset checks.
     if (report.minOffset > 0 || report.maxOffset < MAX_OFFSET) {
         auto ri = RoseInstruction(ROSE_INSTR_CHECK_BOUNDS,
@@ -3538,13 +4091,35 @@ void makeReport(RoseBuildImpl &build, const ReportID id,
 
     // If this report has an exhaustion key, we can check it in the program
     // rather than waiting until we're in the callback adaptor.
-    if (report.ekey != INVALID_EKEY) {
+    if (report.ekey != INVALID_EKEY && !any_match) {
         auto ri = RoseInstruction(ROSE_INSTR_CHECK_EXHAUSTED,
                                   JumpTarget::NEXT_BLOCK);
         ri.u.checkExhausted.ekey = report.ekey;
         report_block.push_back(move(ri));
     }
 
+    // Reports with a match limit are suppressed once it has been reached.
+    const match_limit_info *limit =
+        ext && !any_match ? build.rm.getMatchLimit(report.onmatch) : nullptr;
+    if (limit) {
+        auto ri = RoseInstruction(ROSE_INSTR_CHECK_EXHAUSTED,
+                                  JumpTarget::NEXT_BLOCK);
+        ri.u.checkExhausted.ekey = limit->ekey;
+        report_block.push_back(move(ri));
+    }
+
+    // Matches of HS_FLAG_CONFIRM patterns must pass their confirm program
+    // before they have any other effect.
+    const confirm_info *confirm =
+        ext ? build.rm.getConfirm(report.onmatch) : nullptr;
+    if (confirm) {
+        auto ri = RoseInstruction(ROSE_INSTR_CHECK_CONFIRM,
+                                  JumpTarget::NEXT_BLOCK);
+        ri.u.checkConfirm.key = confirm->key;
+        ri.u.checkConfirm.offset_adjust = report.offsetAdjust;
+        report_block.push_back(move(ri));
+    }
+
     // External SOM reports that aren't passthrough need their SOM value
     // calculated.
     if (isExternalSomReport(report) &&
@@ -3568,13 +4143,45 @@ void makeReport(RoseBuildImpl &build, const ReportID id,
         report_block.emplace_back(ROSE_INSTR_SOM_ZERO);
     }
 
+    // Sub-patterns of logical combinations set their logical key and mark
+    // the combinations that use them for evaluation.
+    const u32 lkey = ext ? pl.getLogicalKey(report.onmatch) : INVALID_LKEY;
+    if (lkey != INVALID_LKEY) {
+        report_block.emplace_back(ROSE_INSTR_SET_LOGICAL);
+        auto &ri = report_block.back();
+        ri.u.setLogical.lkey = lkey;
+        ri.u.setLogical.offset_adjust = report.offsetAdjust;
+        for (u32 ckey : pl.getCombKeys(lkey)) {
+            report_block.emplace_back(ROSE_INSTR_SET_COMBINATION);
+            report_block.back().u.setCombination.ckey = ckey;
+        }
+    }
+
+    // Quiet patterns (HS_FLAG_QUIET) are never reported to the user.
+    if (ext && pl.isQuiet(report.onmatch)) {
+        DEBUG_PRINTF("report %u is quiet\n", id);
+        if (!report_block.empty()) {
+            addReportBlock(program, report_block);
+        }
+        return;
+    }
+
     switch (report.type) {
     case EXTERNAL_CALLBACK:
         if (!has_som) {
             // Dedupe is only necessary if this report has a dkey, or if there
             // are SOM reports to catch up.
-            bool needs_dedupe = build.rm.getDkey(report) != ~0U || build.hasSom;
-            if (report.ekey == INVALID_EKEY) {
+            bool needs_dedupe = !any_match &&
+                (build.rm.getDkey(report) != ~0U || build.hasSom);
+            if (limit) {
+                // Only count matches that survive dedupe.
+                if (needs_dedupe) {
+                    makeDedupe(build, report, report_block);
+                    needs_dedupe = false;
+                }
+                makeMatchCount(build, report, report_block);
+            }
+            if (report.ekey == INVALID_EKEY || any_match) {
                 if (needs_dedupe) {
                     report_block.emplace_back(ROSE_INSTR_DEDUPE_AND_REPORT,
                                               JumpTarget::NEXT_BLOCK);
@@ -3601,6 +4208,7 @@ void makeReport(RoseBuildImpl &build, const ReportID id,
             }
         } else { // has_som
             makeDedupeSom(build, report, report_block);
+            makeMatchCount(build, report, report_block);
             if (report.ekey == INVALID_EKEY) {
                 report_block.emplace_back(ROSE_INSTR_REPORT_SOM);
                 auto &ri = report_block.back();
@@ -3648,6 +4256,7 @@ void makeReport(RoseBuildImpl &build, const ReportID id,
     case EXTERNAL_CALLBACK_SOM_ABS:
     case EXTERNAL_CALLBACK_SOM_REV_NFA:
         makeDedupeSom(build, report, report_block);
+        makeMatchCount(build, report, report_block);
         if (report.ekey == INVALID_EKEY) {
             report_block.emplace_back(ROSE_INSTR_REPORT_SOM);
             auto &ri = report_block.back();
@@ -3663,6 +4272,7 @@ void makeReport(RoseBuildImpl &build, const ReportID id,
         break;
     case EXTERNAL_CALLBACK_SOM_PASS:
         makeDedupeSom(build, report, report_block);
+        makeMatchCount(build, report, report_block);
         if (report.ekey == INVALID_EKEY) {
             report_block.emplace_back(ROSE_INSTR_REPORT_SOM);
             auto &ri = report_block.back();
@@ -3683,10 +4293,103 @@ void makeReport(RoseBuildImpl &build, const ReportID id,
     }
 
     assert(!report_block.empty());
-    report_block = flattenProgram({report_block});
-    assert(report_block.back().code() == ROSE_INSTR_END);
-    report_block.pop_back();
-    insert(&program, program.end(), report_block);
+    addReportBlock(program, report_block);
+}
+
+/**
+ * \brief Returns true if \a block is the program for a plain report, or for
+ * an exhaustible report with nothing more than its exhaustion check, and
+ * fills in \a entry for it.
+ */
+static
+bool isBatchableReport(const vector<RoseInstruction> &block,
+                       rose_report_entry *entry) {
+    if (block.size() == 1 && block[0].code() == ROSE_INSTR_REPORT) {
+        entry->onmatch = block[0].u.report.onmatch;
+        entry->offset_adjust = block[0].u.report.offset_adjust;
+        entry->ekey = INVALID_EKEY;
+        return true;
+    }
+
+    if (block.size() == 2 && block[0].code() == ROSE_INSTR_CHECK_EXHAUSTED &&
+        block[1].code() == ROSE_INSTR_REPORT_EXHAUST &&
+        block[0].u.checkExhausted.ekey == block[1].u.reportExhaust.ekey) {
+        entry->onmatch = block[1].u.reportExhaust.onmatch;
+        entry->offset_adjust = block[1].u.reportExhaust.offset_adjust;
+        entry->ekey = block[1].u.reportExhaust.ekey;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * \brief Appends the pending run of batchable report programs to \a program,
+ * as a single REPORT_MULTI instruction if there is more than one of them.
+ */
+static
+void flushReportBatch(build_context &bc, vector<rose_report_entry> &entries,
+                      vector<RoseInstruction> &batch,
+                      vector<RoseInstruction> &program) {
+    if (entries.size() > 1) {
+        vector<tuple<ReportID, s32, u32>> key;
+        for (const auto &e : entries) {
+            key.emplace_back(e.onmatch, e.offset_adjust, e.ekey);
+        }
+
+        u32 list_offset;
+        auto it = bc.reportListCache.find(key);
+        if (it != bc.reportListCache.end()) {
+            list_offset = it->second;
+        } else {
+            list_offset = add_to_engine_blob(bc, entries.begin(),
+                                             entries.end());
+            bc.reportListCache.emplace(move(key), list_offset);
+        }
+
+        DEBUG_PRINTF("batching %zu reports into REPORT_MULTI\n",
+                     entries.size());
+        auto ri = RoseInstruction(ROSE_INSTR_REPORT_MULTI);
+        ri.u.reportMulti.count = verify_u32(entries.size());
+        ri.u.reportMulti.list_offset = list_offset;
+        program.push_back(move(ri));
+    } else {
+        insert(&program, program.end(), batch);
+    }
+
+    entries.clear();
+    batch.clear();
+}
+
+/**
+ * \brief Appends the programs for the given reports to \a program, fusing
+ * runs of plain and exhaustible reports into REPORT_MULTI instructions.
+ */
+template<class Container>
+static
+void makeReports(RoseBuildImpl &build, build_context &bc,
+                 const Container &reports, const bool has_som,
+                 vector<RoseInstruction> &program) {
+    vector<rose_report_entry> entries;
+    vector<RoseInstruction> batch;
+    vector<RoseInstruction> block;
+
+    for (ReportID id : reports) {
+        block.clear();
+        makeReport(build, id, has_som, block);
+
+        rose_report_entry entry;
+        if (isBatchableReport(block, &entry)) {
+            entries.push_back(entry);
+            insert(&batch, batch.end(), block);
+            continue;
+        }
+
+        flushReportBatch(bc, entries, batch, program);
+        insert(&program, program.end(), block);
+    }
+
+    flushReportBatch(bc, entries, batch, program);
 }
 
 static
@@ -3715,9 +4418,7 @@ void makeRoleReports(RoseBuildImpl &build, build_context &bc, RoseVertex v,
     const auto &reports = g[v].reports;
     makeCatchup(build, bc, reports, program);
 
-    for (ReportID id : reports) {
-        makeReport(build, id, has_som, program);
-    }
+    makeReports(build, bc, reports, has_som, program);
 }
 
 static
@@ -4025,9 +4726,7 @@ u32 writeBoundaryProgram(RoseBuildImpl &build, build_context &bc,
 
     const bool has_som = false;
     vector<RoseInstruction> program;
-    for (const auto &id : reports) {
-        makeReport(build, id, has_som, program);
-    }
+    makeReports(build, bc, reports, has_som, program);
     program = flattenProgram({program});
     applyFinalSpecialisation(program);
     return writeProgram(bc, program);
@@ -4459,6 +5158,51 @@ void makeGroupSquashInstruction(const RoseBuildImpl &build, u32 final_id,
     program.push_back(move(ri));
 }
 
+static
+u32 getSubgroupIndex(const build_context &bc, u32 group) {
+    auto it = bc.subgroup_masks.find(group);
+    assert(it != bc.subgroup_masks.end());
+    return verify_u32(distance(bc.subgroup_masks.begin(), it));
+}
+
+static
+void makeSubgroupCheckInstruction(const RoseBuildImpl &build,
+                                  const build_context &bc, u32 final_id,
+                                  vector<RoseInstruction> &program) {
+    const auto &lit_infos = getLiteralInfoByFinalId(build, final_id);
+    const auto &info = *lit_infos.front();
+    if (!info.squash_subgroup) {
+        return;
+    }
+
+    u32 group = ctz64(info.group_mask);
+    auto ri = RoseInstruction(ROSE_INSTR_CHECK_SUBGROUP);
+    ri.u.checkSubgroup.index = getSubgroupIndex(bc, group);
+    ri.u.checkSubgroup.subgroup = 1ULL << info.subgroup;
+    program.push_back(move(ri));
+}
+
+static
+void makeSubgroupSquashInstruction(const RoseBuildImpl &build,
+                                   const build_context &bc, u32 final_id,
+                                   vector<RoseInstruction> &program) {
+    const auto &lit_infos = getLiteralInfoByFinalId(build, final_id);
+    const auto &info = *lit_infos.front();
+    if (!info.squash_subgroup) {
+        return;
+    }
+
+    u32 group = ctz64(info.group_mask);
+    DEBUG_PRINTF("final_id %u squashes subgroup %u of group %u\n", final_id,
+                 info.subgroup, group);
+
+    auto ri = RoseInstruction(ROSE_INSTR_SQUASH_SUBGROUP);
+    ri.u.squashSubgroup.index = getSubgroupIndex(bc, group);
+    ri.u.squashSubgroup.subgroup = 1ULL << info.subgroup;
+    ri.u.squashSubgroup.groups = ~info.group_mask; // Negated, as above.
+    program.push_back(move(ri));
+}
+
 static
 u32 findMaxOffset(const RoseBuildImpl &build, u32 lit_id) {
     const auto &lit_vertices = build.literal_info.at(lit_id).vertices;
@@ -4597,6 +5341,9 @@ vector<RoseInstruction> buildLitInitialProgram(RoseBuildImpl &build,
 
     DEBUG_PRINTF("final_id %u\n", final_id);
 
+    // Stop early if the literal's subgroup has been squashed.
+    makeSubgroupCheckInstruction(build, bc, final_id, pre_program);
+
     // Check lit mask.
     makeCheckLitMaskInstruction(build, final_id, pre_program);
 
@@ -4662,8 +5409,9 @@ vector<RoseInstruction> buildLiteralProgram(RoseBuildImpl &build,
     if (final_id != MO_INVALID_IDX) {
         vector<RoseInstruction> prog;
 
-        // Literal may squash groups.
+        // Literal may squash groups or its subgroup.
         makeGroupSquashInstruction(build, final_id, prog);
+        makeSubgroupSquashInstruction(build, bc, final_id, prog);
 
         // Literal may be anchored and need to be recorded.
         makeRecordAnchoredInstruction(build, bc, final_id, prog);
@@ -4686,15 +5434,15 @@ vector<RoseInstruction> buildLiteralProgram(RoseBuildImpl &build,
 }
 
 static
-u32 writeLiteralProgram(RoseBuildImpl &build, build_context &bc, u32 final_id,
-                        const vector<RoseEdge> &lit_edges) {
+vector<RoseInstruction> makeLiteralProgram(RoseBuildImpl &build,
+                                           build_context &bc, u32 final_id,
+                                           const vector<RoseEdge> &lit_edges) {
     auto program = buildLiteralProgram(build, bc, final_id, lit_edges);
-    if (program.empty()) {
-        return 0;
+    if (!program.empty()) {
+        // Note: already flattened.
+        applyFinalSpecialisation(program);
     }
-    // Note: already flattened.
-    applyFinalSpecialisation(program);
-    return writeProgram(bc, program);
+    return program;
 }
 
 static
@@ -4749,9 +5497,48 @@ map<u32, vector<RoseEdge>> findEdgesByLiteral(const RoseBuildImpl &build) {
     return lit_edge_map;
 }
 
+/**
+ * \brief Estimates how often the literals with the given final ID match, as
+ * the log of the probability of a match at any given byte of the input.
+ *
+ * Byte values are taken to be equally likely unless the compile was given
+ * the frequencies of the traffic to be scanned. Short literals and those made
+ * of common bytes score highest.
+ */
+static
+double literalHotness(const RoseBuildImpl &build, u32 final_id) {
+    const ByteFrequencies *freq = build.cc.byte_freq.get();
+    double best = -HUGE_VAL;
+    for (u32 lit_id : build.final_id_to_literal.at(final_id)) {
+        const ue2_literal &s = build.literals.right.at(lit_id).s;
+        double score = 0;
+        for (const auto &e : s) {
+            bool both = e.nocase && ourisalpha(e.c);
+            double p;
+            if (!freq) {
+                p = (both ? 2.0 : 1.0) / 256;
+            } else if (both) {
+                p = freq->prob[(u8)mytolower(e.c)]
+                  + freq->prob[(u8)mytoupper(e.c)];
+            } else {
+                p = freq->prob[(u8)e.c];
+            }
+            score += log(p);
+        }
+        best = max(best, score);
+    }
+    return best;
+}
+
 /**
  * \brief Build the interpreter programs for each literal.
  *
+ * Programs are laid out by expected hotness: the literal program table is
+ * followed by the literal programs in order of decreasing literalHotness(),
+ * so that those run most often share a few cache lines next to the table.
+ * Identical programs are written once, at their hottest position. The delay
+ * rebuild programs, which are only run at stream boundaries, come last.
+ *
  * Returns the base of the literal program list and the base of the delay
  * rebuild program list.
  */
@@ -4760,20 +5547,42 @@ pair<u32, u32> buildLiteralPrograms(RoseBuildImpl &build, build_context &bc) {
     const u32 num_literals = build.final_id_to_literal.size();
     auto lit_edge_map = findEdgesByLiteral(build);
 
-    bc.litPrograms.resize(num_literals);
+    bc.litPrograms.assign(num_literals, 0);
     vector<u32> delayRebuildPrograms(num_literals);
 
+    // Building a program may write its sparse iterators to the engine blob,
+    // so all are built before any is written, to keep the programs together.
+    vector<vector<RoseInstruction>> programs(num_literals);
     for (u32 finalId = 0; finalId != num_literals; ++finalId) {
         const auto &lit_edges = lit_edge_map[finalId];
+        programs[finalId] = makeLiteralProgram(build, bc, finalId, lit_edges);
+    }
 
-        bc.litPrograms[finalId] =
-            writeLiteralProgram(build, bc, finalId, lit_edges);
-        delayRebuildPrograms[finalId] =
-            buildDelayRebuildProgram(build, bc, finalId);
+    vector<pair<double, u32>> order;
+    order.reserve(num_literals);
+    for (u32 finalId = 0; finalId != num_literals; ++finalId) {
+        if (!programs[finalId].empty()) {
+            order.emplace_back(-literalHotness(build, finalId), finalId);
+        }
     }
+    sort(begin(order), end(order));
 
+    // The table is filled in once the programs have been written.
     u32 litProgramsOffset =
         add_to_engine_blob(bc, begin(bc.litPrograms), end(bc.litPrograms));
+    for (const auto &m : order) {
+        u32 finalId = m.second;
+        bc.litPrograms[finalId] = writeProgram(bc, programs[finalId]);
+    }
+    if (num_literals) {
+        memcpy(&bc.engine_blob[litProgramsOffset - bc.engine_blob_base],
+               bc.litPrograms.data(), byte_length(bc.litPrograms));
+    }
+
+    for (u32 finalId = 0; finalId != num_literals; ++finalId) {
+        delayRebuildPrograms[finalId] =
+            buildDelayRebuildProgram(build, bc, finalId);
+    }
     u32 delayRebuildProgramsOffset = add_to_engine_blob(
         bc, begin(delayRebuildPrograms), end(delayRebuildPrograms));
 
@@ -4856,9 +5665,7 @@ vector<RoseInstruction> makeEodAnchorProgram(RoseBuildImpl &build,
     makeCatchup(build, bc, reports, program);
 
     const bool has_som = false;
-    for (const auto &id : reports) {
-        makeReport(build, id, has_som, program);
-    }
+    makeReports(build, bc, reports, has_som, program);
 
     return program;
 }
@@ -4888,6 +5695,34 @@ bool hasEodMatcher(const RoseBuildImpl &build) {
     return false;
 }
 
+/**
+ * \brief True if all EOD work for a stream depends on role state or suffix
+ * engines that must have been switched on during the scan.
+ *
+ * Outfixes are live from the start of the stream, and the EOD event literal
+ * and EOD-anchored matcher can fire on a stream that has matched nothing, so
+ * any of these rule it out.
+ */
+static
+bool eodNeedsLiveState(const RoseBuildImpl &build, const build_context &bc,
+                       u32 outfixEndQueue) {
+    if (!build.cc.streaming) {
+        return false;
+    }
+
+    for (u32 i = 0; i < outfixEndQueue; i++) {
+        if (nfaAcceptsEod(get_nfa_from_blob(bc, i))) {
+            return false;
+        }
+    }
+
+    if (build.eod_event_literal_id != MO_INVALID_IDX) {
+        return false;
+    }
+
+    return !hasEodMatcher(build);
+}
+
 static
 void addEodAnchorProgram(RoseBuildImpl &build, build_context &bc,
                          bool in_etable, vector<RoseInstruction> &program) {
@@ -5148,6 +5983,228 @@ void fillMatcherDistances(const RoseBuildImpl &build, RoseEngine *engine) {
     }
 }
 
+template<class Container>
+static
+void addExternalIds(const ReportManager &rm, const Container &reports,
+                    set<u32> *ids) {
+    for (ReportID id : reports) {
+        const Report &ir = rm.getReport(id);
+        if (isExternalReport(ir)) {
+            ids->insert(ir.onmatch);
+        }
+    }
+}
+
+/** \brief Returns the external ids reported by the given roles and the roles
+ * downstream of them. */
+static
+set<u32> reachableExternalIds(const RoseBuildImpl &build,
+                              vector<RoseVertex> pending) {
+    const RoseGraph &g = build.g;
+    ue2::unordered_set<RoseVertex> seen(pending.begin(), pending.end());
+    set<u32> ids;
+    while (!pending.empty()) {
+        RoseVertex v = pending.back();
+        pending.pop_back();
+
+        addExternalIds(build.rm, g[v].reports, &ids);
+        if (g[v].suffix) {
+            addExternalIds(build.rm, all_reports(g[v].suffix), &ids);
+        }
+
+        for (auto w : adjacent_vertices_range(v, g)) {
+            if (seen.insert(w).second) {
+                pending.push_back(w);
+            }
+        }
+    }
+    return ids;
+}
+
+/** \brief Returns the external ids served by each engine queue. */
+static
+vector<set<u32>> findQueueOwners(const RoseBuildImpl &build,
+                                 const build_context &bc, u32 queue_count) {
+    vector<set<u32>> owners(queue_count);
+
+    for (const auto &out : build.outfixes) {
+        if (out.is_dead()) {
+            continue;
+        }
+        u32 qi = out.get_queue();
+        assert(qi < queue_count);
+        addExternalIds(build.rm, all_reports(out), &owners[qi]);
+    }
+
+    for (const auto &e : bc.suffixes) {
+        assert(e.second < queue_count);
+        addExternalIds(build.rm, all_reports(e.first), &owners[e.second]);
+    }
+
+    for (const auto &m : bc.leftfix_info) {
+        if (m.second.has_lookaround) {
+            continue;
+        }
+        u32 qi = m.second.queue;
+        assert(qi < queue_count);
+        insert(&owners[qi], reachableExternalIds(build, {m.first}));
+    }
+
+    return owners;
+}
+
+/**
+ * \brief Builds the table of external ids served by each literal program and
+ * each engine queue, used to charge profiled costs to patterns. See
+ * RoseEngine::profileOwnersOffset for the layout.
+ */
+static
+vector<u32> buildProfileOwners(const RoseBuildImpl &build,
+                               const build_context &bc, u32 queue_count) {
+    const u32 num_literals = verify_u32(build.final_id_to_literal.size());
+    vector<set<u32>> owners(num_literals);
+
+    for (const auto &m : build.final_id_to_literal) {
+        assert(m.first < num_literals);
+        vector<RoseVertex> roots;
+        for (u32 lit_id : m.second) {
+            const auto &info = build.literal_info.at(lit_id);
+            insert(&roots, roots.end(), info.vertices);
+            for (u32 delayed_id : info.delayed_ids) {
+                insert(&roots, roots.end(),
+                       build.literal_info.at(delayed_id).vertices);
+            }
+        }
+        owners[m.first] = reachableExternalIds(build, move(roots));
+    }
+
+    auto queue_owners = findQueueOwners(build, bc, queue_count);
+    insert(&owners, owners.end(), queue_owners);
+
+    vector<u32> table;
+    u32 id_count = 0;
+    for (const auto &ids : owners) {
+        table.push_back(id_count);
+        id_count += verify_u32(ids.size());
+    }
+    table.push_back(id_count);
+    for (const auto &ids : owners) {
+        insert(&table, table.end(), ids);
+    }
+    return table;
+}
+
+/**
+ * \brief Charges the engine's stream state to the patterns that use it, for
+ * hs_compile_stream_state_usage().
+ *
+ * Role bits and SOM slots are charged to the patterns reachable from their
+ * roles, and engine state to the patterns reported by the engine, split
+ * evenly where several patterns share them.
+ */
+static
+void attributeStreamState(const RoseBuildImpl &build, const build_context &bc,
+                          u32 queue_count, StreamStateUsage *usage) {
+    const RoseGraph &g = build.g;
+    const ReportManager &rm = build.rm;
+
+    for (const auto &ir : rm.reports()) {
+        if (isExternalReport(ir)) {
+            usage->addPattern(ir.onmatch);
+        }
+    }
+
+    ue2::unordered_map<RoseVertex, set<u32>> role_owners;
+    auto owners_of = [&](RoseVertex v) -> const set<u32> & {
+        auto it = role_owners.find(v);
+        if (it == role_owners.end()) {
+            it = role_owners.emplace(v, reachableExternalIds(build, {v}))
+                     .first;
+        }
+        return it->second;
+    };
+
+    for (const auto &m : bc.roleStateIndices) {
+        usage->charge(owners_of(m.first), &PatternStateUsage::role_bits, 1);
+    }
+
+    // Transient leftfixes keep no stream state.
+    set<u32> transient_queues;
+    findTransientQueues(bc.leftfix_info, &transient_queues);
+
+    const auto queue_owners = findQueueOwners(build, bc, queue_count);
+    for (const auto &m : bc.engineOffsets) {
+        u32 qi = m.first;
+        if (contains(transient_queues, qi)) {
+            continue;
+        }
+        const NFA *n = get_nfa_from_blob(bc, qi);
+        const u32 repeat = repeat_stream_state_size(*n);
+        assert(repeat <= n->streamStateSize);
+        const auto &ids = queue_owners.at(qi);
+        // One bit of the active queue multibit, too.
+        usage->charge(ids, &PatternStateUsage::engine_bytes,
+                      n->streamStateSize - repeat + 1.0 / 8);
+        usage->charge(ids, &PatternStateUsage::repeat_bytes, repeat);
+    }
+
+    // Each SOM slot takes somPrecision() bytes and a bit in each of the valid
+    // and writable multibits. Slots read back by a pattern's report are
+    // charged to it; the rest are shared by all the SOM patterns.
+    const u32 num_som_slots = build.ssm.numSomSlots();
+    if (num_som_slots) {
+        const double slot_bytes = build.ssm.somPrecision() + 2.0 / 8;
+        vector<set<u32>> slot_readers(num_som_slots);
+        set<u32> som_patterns;
+        for (const auto &ir : rm.reports()) {
+            if (!isExternalSomReport(ir)) {
+                continue;
+            }
+            som_patterns.insert(ir.onmatch);
+            if (ir.type == EXTERNAL_CALLBACK_SOM_STORED &&
+                ir.somDistance < num_som_slots) {
+                slot_readers[ir.somDistance].insert(ir.onmatch);
+            }
+        }
+        for (const auto &ids : slot_readers) {
+            usage->charge(ids.empty() ? som_patterns : ids,
+                          &PatternStateUsage::som_bytes, slot_bytes);
+        }
+    }
+
+    // History, following calcHistoryRequired().
+    for (auto v : vertices_range(g)) {
+        if (g[v].suffix) {
+            usage->needHistory(owners_of(v), 2);
+        }
+        if (g[v].left) {
+            const u32 lag = g[v].left.lag;
+            const left_id leftfix(g[v].left);
+            u32 bytes;
+            if (contains(build.transient, leftfix)) {
+                bytes = lag + findMaxWidth(leftfix);
+                if (build.hasLiteralInTable(v, ROSE_EVENT)) {
+                    bytes++;
+                }
+            } else {
+                bytes = max(lag + 1, 2U);
+            }
+            usage->needHistory(owners_of(v), bytes);
+        }
+    }
+
+    for (const auto &e : build.literals.right) {
+        const auto &lit = e.second;
+        if (!lit.delay) {
+            continue;
+        }
+        size_t len = max(lit.elength(), lit.msk.size() + lit.delay);
+        for (auto v : build.literal_info.at(e.first).vertices) {
+            usage->needHistory(owners_of(v), verify_u32(len));
+        }
+    }
+}
+
 static
 u32 buildEagerQueueIter(const set<u32> &eager, u32 leftfixBeginQueue,
                         u32 queue_count,
@@ -5167,10 +6224,90 @@ u32 buildEagerQueueIter(const set<u32> &eager, u32 leftfixBeginQueue,
     return addIteratorToTable(bc, iter);
 }
 
+/**
+ * \brief Lay out the confirm programs for HS_FLAG_CONFIRM patterns: a u32
+ * offset (from the start of the table) for each program, indexed by key,
+ * followed by the programs themselves.
+ */
+static
+vector<u8> buildConfirmTable(const ReportManager &rm) {
+    const auto &progs = rm.getConfirmPrograms();
+    if (progs.empty()) {
+        return {};
+    }
+
+    vector<u32> offsets;
+    size_t len = progs.size() * sizeof(u32);
+    for (const auto &prog : progs) {
+        offsets.push_back(verify_u32(len));
+        len += confirmProgramSize(*prog);
+    }
+
+    vector<u8> table(len);
+    memcpy(table.data(), offsets.data(), byte_length(offsets));
+    for (size_t i = 0; i < progs.size(); i++) {
+        writeConfirmProgram(*progs[i], table.data() + offsets[i]);
+    }
+    return table;
+}
+
+/**
+ * \brief Lay out the user data table read by roseMatchUserData(): directly
+ * indexed by ID when the IDs are dense enough, otherwise sorted IDs followed
+ * by their values.
+ */
+static
+vector<u8> buildUserDataTable(const ReportManager &rm, u32 *count,
+                              bool *dense) {
+    const auto &user_data = rm.getUserData();
+    *count = 0;
+    *dense = false;
+    if (user_data.empty()) {
+        return {};
+    }
+
+    const u32 max_id = user_data.rbegin()->first;
+    if (max_id < 2 * user_data.size() + 64) {
+        vector<u64a> values(max_id + 1, 0);
+        for (const auto &m : user_data) {
+            values[m.first] = m.second.value;
+        }
+        *count = verify_u32(values.size());
+        *dense = true;
+        vector<u8> table(byte_length(values));
+        memcpy(table.data(), values.data(), table.size());
+        return table;
+    }
+
+    vector<u32> ids;
+    vector<u64a> values;
+    for (const auto &m : user_data) {
+        ids.push_back(m.first);
+        values.push_back(m.second.value);
+    }
+    *count = verify_u32(ids.size());
+    size_t values_offset = ROUNDUP_N(byte_length(ids), sizeof(u64a));
+    vector<u8> table(values_offset + byte_length(values));
+    memcpy(table.data(), ids.data(), byte_length(ids));
+    memcpy(table.data() + values_offset, values.data(), byte_length(values));
+    return table;
+}
+
+/** \brief Longest window of any confirm program. */
+static
+u32 maxConfirmWindow(const ReportManager &rm) {
+    u32 window = 0;
+    for (const auto &prog : rm.getConfirmPrograms()) {
+        window = max(window, prog->window);
+    }
+    return window;
+}
+
 static
 aligned_unique_ptr<RoseEngine> addSmallWriteEngine(RoseBuildImpl &build,
                                         aligned_unique_ptr<RoseEngine> rose) {
     assert(rose);
+    PhaseTimer timer(build.cc, PHASE_SMALLWRITE);
 
     if (roseIsPureLiteral(rose.get())) {
         DEBUG_PRINTF("pure literal case, not adding smwr\n");
@@ -5202,10 +6339,13 @@ aligned_unique_ptr<RoseEngine> addSmallWriteEngine(RoseBuildImpl &build,
     return rose2;
 }
 
-aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
+aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth,
+                                                               u32 maxWidth) {
+    PhaseTimer timer(cc, PHASE_BYTECODE);
     DerivedBoundaryReports dboundary(boundary);
 
     size_t historyRequired = calcHistoryRequired(); // Updated by HWLM.
+    size_t idleHistoryRequired = calcHistoryRequired(true);
 
     auto anchored_dfas = buildAnchoredDfas(*this);
 
@@ -5213,6 +6353,11 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
     bc.floatingMinLiteralMatchOffset =
         findMinFloatingLiteralMatch(*this, anchored_dfas);
     bc.needs_catchup = needsCatchup(*this);
+    const bool unordered = bc.needs_catchup && canDeliverUnordered(*this);
+    if (unordered) {
+        DEBUG_PRINTF("engines will deliver matches unordered\n");
+        bc.needs_catchup = false;
+    }
     recordResources(bc.resources, *this);
     if (!anchored_dfas.empty()) {
         bc.resources.has_anchored = true;
@@ -5220,6 +6365,7 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
     bc.needs_mpv_catchup = needsMpvCatchup(*this);
     bc.vertex_group_map = getVertexGroupMap(*this);
     bc.squashable_groups = getSquashableGroups(*this);
+    bc.subgroup_masks = findSubgroupMasks(*this);
 
     auto boundary_out = makeBoundaryPrograms(*this, bc, boundary, dboundary);
 
@@ -5312,8 +6458,10 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
     // Build floating HWLM matcher.
     rose_group fgroups = 0;
     size_t fsize = 0;
+    size_t floatingHistoryRequired = 0;
     size_t floatingStreamStateRequired = 0;
     auto ftable = buildFloatingMatcher(*this, &fgroups, &fsize, &historyRequired,
+                                       &floatingHistoryRequired,
                                        &floatingStreamStateRequired);
     u32 fmatcherOffset = 0;
     if (ftable) {
@@ -5380,21 +6528,39 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
     // Some SOM schemes (reverse NFAs, for example) may require more history.
     historyRequired = max(historyRequired, (size_t)ssm.somHistoryRequired());
 
+    // Confirm programs look back over their window from any match, so their
+    // history is needed whatever is alive.
+    const size_t confirmWindow = cc.streaming ? maxConfirmWindow(rm) : 0;
+    historyRequired = max(historyRequired, confirmWindow);
+
+    // The floating matcher and SOM need their history whatever is alive, as
+    // does any engine that needs a decompression key.
+    idleHistoryRequired = max({idleHistoryRequired, floatingHistoryRequired,
+                               (size_t)ssm.somHistoryRequired(), confirmWindow,
+                               min(historyRequired, (size_t)1)});
+    assert(idleHistoryRequired <= historyRequired);
+
     assert(!cc.streaming || historyRequired <=
-           max(cc.grey.maxHistoryAvailable, cc.grey.somMaxRevNfaLength));
+           max({(size_t)cc.grey.maxHistoryAvailable,
+                (size_t)cc.grey.somMaxRevNfaLength, confirmWindow}));
 
     RoseStateOffsets stateOffsets;
     memset(&stateOffsets, 0, sizeof(stateOffsets));
     fillStateOffsets(*this, bc.numStates, anchorStateSize,
                      activeArrayCount, activeLeftCount, laggedRoseCount,
                      floatingStreamStateRequired, historyRequired,
-                     &stateOffsets);
+                     verify_u32(bc.subgroup_masks.size()), &stateOffsets);
+
+    vector<u64a> subgroupInit;
+    for (const auto &m : bc.subgroup_masks) {
+        subgroupInit.push_back(m.second);
+    }
 
     scatter_plan_raw state_scatter;
     buildStateScatterPlan(sizeof(u8), bc.numStates,
                           activeLeftCount, rosePrefixCount, stateOffsets,
                           cc.streaming, activeArrayCount, outfixBeginQueue,
-                          outfixEndQueue, &state_scatter);
+                          outfixEndQueue, subgroupInit, &state_scatter);
 
     currOffset = ROUNDUP_N(currOffset, alignof(scatter_unit_u64a));
 
@@ -5405,6 +6571,95 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
     u32 dkeyOffset = currOffset;
     currOffset += rm.numDkeys() * sizeof(ReportID);
 
+    currOffset = ROUNDUP_N(currOffset, alignof(LogicalOp));
+    u32 logicalTreeOffset = currOffset;
+    currOffset += byte_length(rm.pl.getLogicalTree());
+
+    currOffset = ROUNDUP_N(currOffset, alignof(CombInfo));
+    u32 combInfoMapOffset = currOffset;
+    currOffset += byte_length(rm.pl.getCombInfos());
+
+    const vector<u8> confirm_table = buildConfirmTable(rm);
+    currOffset = ROUNDUP_N(currOffset, alignof(u32));
+    u32 confirmOffset = currOffset;
+    currOffset += byte_length(confirm_table);
+
+    u32 userDataCount;
+    bool userDataDense;
+    const vector<u8> user_data_table =
+        buildUserDataTable(rm, &userDataCount, &userDataDense);
+    currOffset = ROUNDUP_N(currOffset, alignof(u64a));
+    u32 userDataOffset = user_data_table.empty() ? 0 : currOffset;
+    currOffset += byte_length(user_data_table);
+
+    vector<vector<u32>> group_reports;
+    rose_group patternMaskGroups = findGroupReports(*this, group_reports);
+    vector<u32> group_report_table;
+    group_report_table.reserve(ROSE_GROUPS_MAX + 1);
+    u32 group_report_count = 0;
+    for (const auto &ids : group_reports) {
+        group_report_table.push_back(group_report_count);
+        group_report_count += verify_u32(ids.size());
+    }
+    group_report_table.push_back(group_report_count);
+    for (const auto &ids : group_reports) {
+        insert(&group_report_table, group_report_table.end(), ids);
+    }
+
+    currOffset = ROUNDUP_N(currOffset, alignof(u32));
+    u32 groupReportsOffset = currOffset;
+    currOffset += byte_length(group_report_table);
+
+    // Groups whose literals can only lead to exhaustible reports are turned
+    // off at runtime once all of those reports are exhausted.
+    vector<vector<u32>> group_ekeys;
+    rose_group exhaustibleGroups = findGroupEkeys(*this, group_ekeys);
+    vector<u32> group_ekey_table;
+    vector<rose_group> ekey_group_table;
+    if (exhaustibleGroups) {
+        u32 group_ekey_count = 0;
+        for (const auto &ekeys : group_ekeys) {
+            group_ekey_table.push_back(group_ekey_count);
+            group_ekey_count += verify_u32(ekeys.size());
+        }
+        group_ekey_table.push_back(group_ekey_count);
+        ekey_group_table.assign(rm.numEkeys(), 0);
+        for (u32 group = 0; group < ROSE_GROUPS_MAX; group++) {
+            insert(&group_ekey_table, group_ekey_table.end(),
+                   group_ekeys[group]);
+            for (u32 ekey : group_ekeys[group]) {
+                ekey_group_table[ekey] |= 1ULL << group;
+            }
+        }
+    }
+
+    u32 groupEkeysOffset = 0;
+    u32 ekeyGroupsOffset = 0;
+    if (!group_ekey_table.empty()) {
+        currOffset = ROUNDUP_N(currOffset, alignof(rose_group));
+        ekeyGroupsOffset = currOffset;
+        currOffset += byte_length(ekey_group_table);
+        currOffset = ROUNDUP_N(currOffset, alignof(u32));
+        groupEkeysOffset = currOffset;
+        currOffset += byte_length(group_ekey_table);
+    }
+
+    vector<u32> profile_owner_table;
+#ifdef ROSE_PROFILE
+    const bool want_owners = true;
+#else
+    const bool want_owners = cc.cost_attribution;
+#endif
+    if (want_owners) {
+        profile_owner_table = buildProfileOwners(*this, bc, queue_count);
+    }
+    u32 profileOwnersOffset = 0;
+    if (!profile_owner_table.empty()) {
+        currOffset = ROUNDUP_N(currOffset, alignof(u32));
+        profileOwnersOffset = currOffset;
+        currOffset += byte_length(profile_owner_table);
+    }
+
     aligned_unique_ptr<RoseEngine> engine
         = aligned_zmalloc_unique<RoseEngine>(currOffset);
     assert(engine); // will have thrown bad_alloc otherwise.
@@ -5431,16 +6686,52 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
     memcpy(&engine->stateOffsets, &stateOffsets, sizeof(stateOffsets));
 
     engine->historyRequired = verify_u32(historyRequired);
+    engine->idleHistoryRequired = verify_u32(idleHistoryRequired);
 
     engine->ekeyCount = rm.numEkeys();
     engine->dkeyCount = rm.numDkeys();
     engine->invDkeyOffset = dkeyOffset;
     copy_bytes(ptr + dkeyOffset, rm.getDkeyToReportTable());
 
+    engine->lkeyCount = rm.pl.numLogicalKeys();
+    engine->lopCount = verify_u32(rm.pl.getLogicalTree().size());
+    engine->ckeyCount = rm.pl.numCombinations();
+    engine->matchLimitCount = rm.numMatchLimits();
+    engine->subgroupCount = verify_u32(bc.subgroup_masks.size());
+    engine->logicalTreeOffset = logicalTreeOffset;
+    engine->combInfoMapOffset = combInfoMapOffset;
+    copy_bytes(ptr + logicalTreeOffset, rm.pl.getLogicalTree());
+    copy_bytes(ptr + combInfoMapOffset, rm.pl.getCombInfos());
+
+    engine->confirmCount = verify_u32(rm.getConfirmPrograms().size());
+    engine->confirmOffset = confirmOffset;
+    copy_bytes(ptr + confirmOffset, confirm_table);
+
+    engine->userDataCount = userDataCount;
+    engine->userDataOffset = userDataOffset;
+    engine->userDataDense = userDataDense ? 1 : 0;
+    copy_bytes(ptr + userDataOffset, user_data_table);
+
+    engine->patternMaskGroups = patternMaskGroups;
+    engine->groupReportsOffset = groupReportsOffset;
+    copy_bytes(ptr + groupReportsOffset, group_report_table);
+    engine->groupEkeysOffset = groupEkeysOffset;
+    engine->ekeyGroupsOffset = ekeyGroupsOffset;
+    if (exhaustibleGroups) {
+        copy_bytes(ptr + groupEkeysOffset, group_ekey_table);
+        copy_bytes(ptr + ekeyGroupsOffset, ekey_group_table);
+    }
+    engine->profileOwnersOffset = profileOwnersOffset;
+    if (profileOwnersOffset) {
+        copy_bytes(ptr + profileOwnersOffset, profile_owner_table);
+    }
+
     engine->somHorizon = ssm.somPrecision();
     engine->somLocationCount = ssm.numSomSlots();
 
     engine->needsCatchup = bc.needs_catchup ? 1 : 0;
+    engine->anyMatch = cc.any_match ? 1 : 0;
+    engine->unorderedMatches = unordered ? 1 : 0;
 
     engine->literalCount = verify_u32(final_id_to_literal.size());
     engine->litProgramOffset = litProgramOffset;
@@ -5471,6 +6762,7 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
     engine->nfaInfoOffset = nfaInfoOffset;
 
     engine->eodProgramOffset = eodProgramOffset;
+    engine->programSize = verify_u32(bc.programBytes);
 
     engine->lastByteHistoryIterOffset = lastByteOffset;
 
@@ -5509,13 +6801,24 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
     engine->amatcherMaxBiAnchoredWidth = findMaxBAWidth(*this, ROSE_ANCHORED);
     engine->fmatcherMaxBiAnchoredWidth = findMaxBAWidth(*this, ROSE_FLOATING);
     engine->size = currOffset;
-    engine->minWidth = hasBoundaryReports(boundary) ? 0 : minWidth;
+    // Logical combinations may be satisfied (and reported at EOD) by a
+    // buffer that none of their sub-patterns can match.
+    engine->minWidth = hasBoundaryReports(boundary) || rm.pl.numCombinations()
+                           ? 0 : minWidth;
     engine->minWidthExcludingBoundaries = minWidth;
+    // Match limits and logical combinations are evaluated across the whole
+    // scan, so such databases cannot be scanned in independent pieces. Confirm
+    // programs may look back further than the prefilter's matches extend.
+    engine->maxMatchWidth = rm.numMatchLimits() || rm.pl.numCombinations()
+                                ? ROSE_BOUND_INF
+                                : max(maxWidth, maxConfirmWindow(rm));
     engine->floatingMinLiteralMatchOffset = bc.floatingMinLiteralMatchOffset;
 
     engine->maxBiAnchoredWidth = findMaxBAWidth(*this);
     engine->noFloatingRoots = hasNoFloatingRoots();
     engine->requiresEodCheck = hasEodAnchors(*this, bc, outfixEndQueue);
+    engine->eodNeedsLiveState = engine->requiresEodCheck &&
+                                eodNeedsLiveState(*this, bc, outfixEndQueue);
     engine->hasOutfixesInSmallBlock = hasNonSmallBlockOutfix(outfixes);
     engine->canExhaust = rm.patternSetCanExhaust();
     engine->hasSom = hasSom;
@@ -5540,9 +6843,14 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildFinalEngine(u32 minWidth) {
     NfaInfo *nfa_infos = (NfaInfo *)(ptr + nfaInfoOffset);
     populateNfaInfoBasics(*this, bc, outfixes, suffixEkeyLists,
                           no_retrigger_queues, nfa_infos);
-    updateNfaState(bc, &engine->stateOffsets, nfa_infos,
-                   &engine->scratchStateSize, &engine->nfaStateSize,
-                   &engine->tStateSize);
+    updateNfaState(bc, outfixEndQueue, leftfixBeginQueue,
+                   &engine->stateOffsets, nfa_infos, &engine->scratchStateSize,
+                   &engine->nfaStateSize, &engine->tStateSize);
+    engine->limexCacheSize = limexCacheSize(bc);
+    fillColdStateOffsets(*this, &engine->stateOffsets);
+    if (cc.streaming && cc.state_usage) {
+        attributeStreamState(*this, bc, queue_count, cc.state_usage);
+    }
 
     // Copy in other tables
     copy_bytes(ptr + bc.engine_blob_base, bc.engine_blob);
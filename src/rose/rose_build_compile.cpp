@@ -58,6 +58,7 @@
 #include "util/charreach_util.h"
 #include "util/compare.h"
 #include "util/compile_context.h"
+#include "util/compile_report.h"
 #include "util/container.h"
 #include "util/dump_charclass.h"
 #include "util/graph_range.h"
@@ -88,6 +89,10 @@ namespace ue2 {
 #define ANCHORED_REHOME_DEEP 25
 #define ANCHORED_REHOME_SHORT_LEN 3
 
+/** \brief Most anchored literals folded into the floating table so that
+ * block mode runs a single literal pass, see foldAnchoredLiterals(). */
+#define ANCHORED_FOLD_MAX_LITERALS 8
+
 #ifdef DEBUG
 static UNUSED
 void printLitInfo(const rose_literal_info &li, u32 id) {
@@ -109,8 +114,8 @@ void allocateFinalIdToSet(const RoseGraph &g, const set<u32> &lits,
                           u32 *next_final_id) {
     /* We can allocate the same final id to multiple literals of the same type
      * if they share the same vertex set and trigger the same delayed literal
-     * ids and squash the same roles and have the same group squashing
-     * behaviour. Benefits literals cannot be merged. */
+     * ids and squash the same roles and have the same group and subgroup
+     * squashing behaviour. Benefits literals cannot be merged. */
 
     for (u32 int_id : lits) {
         rose_literal_info &curr_info = (*literal_info)[int_id];
@@ -149,17 +154,22 @@ void allocateFinalIdToSet(const RoseGraph &g, const set<u32> &lits,
 
                 if (lits.find(cand_id) == lits.end()
                     || cand_info.vertices.size() != verts.size()
-                    || cand_info.squash_group != curr_info.squash_group) {
+                    || cand_info.squash_group != curr_info.squash_group
+                    || cand_info.squash_subgroup != curr_info.squash_subgroup) {
                     continue;
                 }
 
                 /* if we are squashing groups we need to check if they are the
                  * same group */
-                if (cand_info.squash_group
+                if ((cand_info.squash_group || cand_info.squash_subgroup)
                     && cand_info.group_mask != curr_info.group_mask) {
                     continue;
                 }
 
+                if (cand_info.subgroup != curr_info.subgroup) {
+                    continue;
+                }
+
                 u32 final_id = cand_info.final_id;
                 assert(final_id != MO_INVALID_IDX);
                 assert(curr_info.final_id == MO_INVALID_IDX);
@@ -1235,6 +1245,61 @@ void rehomeAnchoredLiterals(RoseBuildImpl &tbi) {
     }
 }
 
+/**
+ * \brief In block mode, moves every anchored literal into the floating table
+ * if there are few enough of them, so that only one literal pass is run over
+ * the buffer rather than the anchored matcher followed by the floating one.
+ *
+ * The anchoring becomes a bounds check in each literal's role program. This
+ * is only worthwhile if it removes the anchored matcher altogether, if there
+ * is a floating table to fold into, and if the literals are long enough to be
+ * rare outside the anchored region.
+ */
+static
+void foldAnchoredLiterals(RoseBuildImpl &tbi) {
+    if (tbi.cc.streaming) {
+        DEBUG_PRINTF("not block mode\n");
+        return;
+    }
+    if (tbi.anchored_simple.empty() || !tbi.anchored_nfas.empty()) {
+        DEBUG_PRINTF("anchored table is empty or not purely literal\n");
+        return;
+    }
+    if (tbi.anchored_simple.size() > ANCHORED_FOLD_MAX_LITERALS) {
+        DEBUG_PRINTF("too many anchored literals (%zu)\n",
+                     tbi.anchored_simple.size());
+        return;
+    }
+
+    u32 total_count;
+    u32 short_count;
+    countFloatingLiterals(tbi, &total_count, &short_count);
+    if (!total_count) {
+        DEBUG_PRINTF("no floating table\n");
+        return;
+    }
+
+    for (const auto &e : tbi.anchored_simple) {
+        if (e.first.literal.length() < ANCHORED_REHOME_SHORT_LEN) {
+            DEBUG_PRINTF("literal too short to fold\n");
+            return;
+        }
+        for (u32 lit_id : e.second) {
+            if (!tbi.literal_info[lit_id].delayed_ids.empty()) {
+                DEBUG_PRINTF("literal %u has delayed ids\n", lit_id);
+                return;
+            }
+        }
+    }
+
+    DEBUG_PRINTF("folding %zu anchored literals into %u floating\n",
+                 tbi.anchored_simple.size(), total_count);
+    for (const auto &e : tbi.anchored_simple) {
+        rehomeAnchoredLiteral(tbi, e.first, e.second);
+    }
+    tbi.anchored_simple.clear();
+}
+
 /** \brief Maximum number of single-byte literals to add to the small block
  * table. */
 static const size_t MAX_1BYTE_SMALL_BLOCK_LITERALS = 20;
@@ -1603,7 +1668,9 @@ bool hasOrphanedTops(const RoseBuildImpl &tbi) {
 
 #endif // NDEBUG
 
-aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildRose(u32 minWidth) {
+aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildRose(u32 minWidth,
+                                                        u32 maxWidth) {
+    PhaseTimer timer(cc, PHASE_ROSE);
     dumpRoseGraph(*this, nullptr, "rose_early.dot");
 
     // Early check for Rose implementability.
@@ -1629,6 +1696,10 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildRose(u32 minWidth) {
     assert(roleOffsetsAreValid(g));
     stealEodVertices(*this);
 
+    // Likewise, fold a few anchored literals into the floating table if that
+    // saves running the anchored matcher in block mode.
+    foldAnchoredLiterals(*this);
+
     addAnchoredSmallBlockLiterals(*this);
 
     // Merge duplicate leaf nodes
@@ -1658,34 +1729,44 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildRose(u32 minWidth) {
     findTransientLeftfixes();
 
     dedupeLeftfixesVariableLag(*this);
-    mergeLeftfixesVariableLag(*this);
-    mergeSmallLeftfixes(*this);
-    mergeCastleLeftfixes(*this);
 
-    // Do a rose-merging aliasing pass.
-    aliasRoles(*this, true);
+    // Engine merging is optional, and is skipped once we are over the compile
+    // time budget.
+    const bool merge = !overBudget(cc);
+    DEBUG_PRINTF("engine merges %s\n", merge ? "enabled" : "skipped");
+
+    if (merge) {
+        mergeLeftfixesVariableLag(*this);
+        mergeSmallLeftfixes(*this);
+        mergeCastleLeftfixes(*this);
 
-    // Merging of suffixes _below_ role aliasing, as otherwise we'd have to
-    // teach role aliasing about suffix tops.
-    mergeCastleSuffixes(*this);
-    mergePuffixes(*this);
-    mergeAcyclicSuffixes(*this);
-    mergeSmallSuffixes(*this);
+        // Do a rose-merging aliasing pass.
+        aliasRoles(*this, true);
+
+        // Merging of suffixes _below_ role aliasing, as otherwise we'd have
+        // to teach role aliasing about suffix tops.
+        mergeCastleSuffixes(*this);
+        mergePuffixes(*this);
+        mergeAcyclicSuffixes(*this);
+        mergeSmallSuffixes(*this);
+    }
 
     // Convert Castles that would be better off as NFAs back to NGHolder
     // infixes/suffixes.
-    if (unmakeCastles(*this)) {
+    if (unmakeCastles(*this) && merge) {
         // We may be able to save some stream state by merging the newly
         // "unmade" Castles.
         mergeSmallSuffixes(*this);
         mergeSmallLeftfixes(*this);
     }
 
-    // Do a rose-merging aliasing pass.
-    aliasRoles(*this, true);
+    if (merge) {
+        // Do a rose-merging aliasing pass.
+        aliasRoles(*this, true);
 
-    // Run a merge pass over the outfixes as well.
-    mergeOutfixes(*this);
+        // Run a merge pass over the outfixes as well.
+        mergeOutfixes(*this);
+    }
 
     assert(!danglingVertexRef(*this));
 
@@ -1694,6 +1775,7 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildRose(u32 minWidth) {
     assignGroupsToLiterals(*this);
     assignGroupsToRoles(*this);
     findGroupSquashers(*this);
+    findSubgroupSquashers(*this);
 
     /* final prep work */
     remapCastleTops(*this);
@@ -1716,7 +1798,7 @@ aligned_unique_ptr<RoseEngine> RoseBuildImpl::buildRose(u32 minWidth) {
 
     dumpRoseGraph(*this, nullptr, "rose_pre_norm.dot");
 
-    return buildFinalEngine(minWidth);
+    return buildFinalEngine(minWidth, maxWidth);
 }
 
 } // namespace ue2
@@ -40,6 +40,12 @@
 #include "util/graph.h"
 #include "util/make_unique.h"
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <system_error>
+#include <thread>
+
 using namespace std;
 
 namespace ue2 {
@@ -330,7 +336,9 @@ map<u32, set<u32>> findExclusiveGroups(const RoseBuildImpl &build,
         for (const auto &val : s) {
             set<RoseVertex> q2(vertex_map.at(val).begin(),
                                vertex_map.at(val).end());
-            if (contains(exclusiveInfo.at(val), i) &&
+            // Roles that were not analysed have no entry.
+            auto it = exclusiveInfo.find(val);
+            if (it != exclusiveInfo.end() && contains(it->second, i) &&
                 (!is_infix || mergeableRoseVertices(build, q1, q2))) {
                 group.insert(val);
             }
@@ -388,6 +396,12 @@ bool setTriggerLiteralsSuffix(RoleInfo<suffix_id> &roleInfo,
     return setTriggerLiterals(roleInfo, triggers);
 }
 
+/** \brief Exclusivity of one role against the others in its chunk. */
+struct RoleExclusivity {
+    bool analysed = false;
+    ue2::unordered_set<u32> exclusive;
+};
+
 template<typename role_id>
 static
 void exclusiveAnalysis(const RoseBuildImpl &build,
@@ -396,27 +410,94 @@ void exclusiveAnalysis(const RoseBuildImpl &build,
                vector<vector<u32>> &exclusive_roles, const bool is_infix) {
     const auto &chunks = divideIntoChunks(build, roleInfoSet);
     DEBUG_PRINTF("Exclusivity analysis entry\n");
-    map<u32, ue2::unordered_set<u32>> exclusiveInfo;
 
+    // Each role is checked against the rest of its chunk independently, so
+    // the checks are shared out between the compile threads. The skip list
+    // only short-circuits checks that would fail anyway, and exclusivity must
+    // be mutual to be used, so per-thread skip lists give the same result.
+    vector<pair<const RoleChunk<role_id> *, const RoleInfo<role_id> *>> work;
     for (const auto &roleChunk : chunks) {
-        map<u32, ue2::unordered_set<u32>> skipList;
         for (const auto &role1 : roleChunk.roles) {
-            const u32 id1 = role1.id;
-            const role_id &s1 = role1.role;
-            const auto &triggers1 = role1.literals;
-
-            NGHolder h;
-            u32 num = prepareRoleGraph(h, s1);
-            DEBUG_PRINTF("role id1:%u\n", id1);
-            unordered_set<u32> tailId;
-            if (!addPrefixLiterals(h, tailId, triggers1)) {
-                continue;
+            work.emplace_back(&roleChunk, &role1);
+        }
+    }
+
+    const CompileContext &cc = build.cc;
+    const u32 n = work.size();
+    const unsigned threads = max(min(cc.threads, n), 1U);
+    DEBUG_PRINTF("checking %u roles with %u threads\n", n, threads);
+
+    // Large role sets can take a long time; if we run out of time, the roles
+    // not yet checked are left out of the exclusive groups.
+    const auto limit = chrono::milliseconds(cc.grey.tamaAnalysisTimeLimit);
+    const auto deadline = chrono::steady_clock::now() + limit;
+    auto outOfTime = [&]() {
+        return overBudget(cc) || (cc.grey.tamaAnalysisTimeLimit &&
+                                  chrono::steady_clock::now() > deadline);
+    };
+
+    vector<RoleExclusivity> results(n);
+    vector<exception_ptr> errors(n);
+    atomic<u32> next(0);
+    atomic<bool> stop(false);
+
+    auto worker = [&]() {
+        map<u32, ue2::unordered_set<u32>> skipList;
+        for (u32 j = next++; j < n && !stop; j = next++) {
+            if (outOfTime()) {
+                stop = true;
+                break;
             }
+            try {
+                const auto &roleChunk = *work[j].first;
+                const auto &role1 = *work[j].second;
+                DEBUG_PRINTF("role id1:%u\n", role1.id);
+
+                NGHolder h;
+                u32 num = prepareRoleGraph(h, role1.role);
+                ue2::unordered_set<u32> tailId;
+                if (!addPrefixLiterals(h, tailId, role1.literals)) {
+                    continue;
+                }
 
-            exclusiveInfo[id1] = checkExclusivity(h, num, tailId,
-                                             skipList, role1, roleChunk);
+                results[j].exclusive = checkExclusivity(h, num, tailId,
+                                                skipList, role1, roleChunk);
+                results[j].analysed = true;
+            } catch (...) {
+                errors[j] = current_exception();
+            }
+        }
+    };
+
+    vector<thread> pool;
+    try {
+        for (unsigned t = 1; t < threads; t++) {
+            pool.emplace_back(worker);
+        }
+    } catch (const system_error &) {
+        // Couldn't start another thread; carry on with the ones we have.
+        DEBUG_PRINTF("only started %zu extra threads\n", pool.size());
+    }
+    worker();
+    for (auto &t : pool) {
+        t.join();
+    }
+
+    for (const auto &e : errors) {
+        if (e) {
+            rethrow_exception(e);
+        }
+    }
+
+    DEBUG_PRINTF("analysis %s\n", stop ? "stopped early" : "complete");
+
+    map<u32, ue2::unordered_set<u32>> exclusiveInfo;
+    for (u32 j = 0; j < n; j++) {
+        if (results[j].analysed) {
+            exclusiveInfo[work[j].second->id] = std::move(results[j].exclusive);
         }
     }
+    results.clear();
 
     // Create final candidate exclusive groups
     const auto exclusiveGroups =
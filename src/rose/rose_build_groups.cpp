@@ -33,7 +33,15 @@
 
 #include "rose_build_groups.h"
 
+#include "util/compile_context.h"
+#include "util/report.h"
+#include "util/report_manager.h"
+#include "util/verify_types.h"
+
+#include <algorithm>
+#include <map>
 #include <queue>
+#include <set>
 #include <vector>
 
 #include <boost/graph/topological_sort.hpp>
@@ -42,6 +50,7 @@
 
 using namespace std;
 using boost::adaptors::map_keys;
+using boost::adaptors::map_values;
 
 namespace ue2 {
 
@@ -443,7 +452,7 @@ getVertexGroupMap(const RoseBuildImpl &build) {
 rose_group getSquashableGroups(const RoseBuildImpl &build) {
     rose_group squashable_groups = 0;
     for (const auto &info : build.literal_info) {
-        if (info.squash_group) {
+        if (info.squash_group || info.squash_subgroup) {
             DEBUG_PRINTF("lit squash mask 0x%llx\n", info.group_mask);
             squashable_groups |= info.group_mask;
         }
@@ -494,24 +503,25 @@ bool coversGroup(const RoseBuildImpl &build,
     return true;
 }
 
+/**
+ * \brief True if, once literal \p id has matched, any later match of it can
+ * have no further effect, so that its group (if it covers the group) or its
+ * subgroup may be squashed.
+ */
 static
-bool isGroupSquasher(const RoseBuildImpl &build, const u32 id /* literal id */,
-                     rose_group forbidden_squash_group) {
+bool isSelfSquasher(const RoseBuildImpl &build, const u32 id /* literal id */,
+                    rose_group forbidden_squash_group) {
     const RoseGraph &g = build.g;
 
     const rose_literal_info &lit_info = build.literal_info.at(id);
 
-    DEBUG_PRINTF("checking if %u '%s' is a group squasher %016llx\n", id,
-                  dumpString(build.literals.right.at(id).s).c_str(),
-                  lit_info.group_mask);
-
     if (build.literals.right.at(id).table == ROSE_EVENT) {
         DEBUG_PRINTF("event literal, has no groups to squash\n");
         return false;
     }
 
-    if (!coversGroup(build, lit_info)) {
-        DEBUG_PRINTF("does not cover group\n");
+    if (lit_info.vertices.empty() || !lit_info.group_mask) {
+        DEBUG_PRINTF("no vertices or no group\n");
         return false;
     }
 
@@ -561,7 +571,7 @@ bool isGroupSquasher(const RoseBuildImpl &build, const u32 id /* literal id */,
             }
         }
 
-        DEBUG_PRINTF("%u is a path 1 group squasher\n", id);
+        DEBUG_PRINTF("%u is a path 1 squasher\n", id);
         return true;
 
         /* note: we could also squash the groups of its preds (if nobody else is
@@ -624,17 +634,41 @@ bool isGroupSquasher(const RoseBuildImpl &build, const u32 id /* literal id */,
         }
     }
 
-    DEBUG_PRINTF("literal %u is a multi-vertex group squasher\n", id);
+    DEBUG_PRINTF("literal %u is a multi-vertex squasher\n", id);
     return true;
 }
 
-void findGroupSquashers(RoseBuildImpl &build) {
+static
+bool isGroupSquasher(const RoseBuildImpl &build, const u32 id /* literal id */,
+                     rose_group forbidden_squash_group) {
+    const rose_literal_info &lit_info = build.literal_info.at(id);
+
+    DEBUG_PRINTF("checking if %u '%s' is a group squasher %016llx\n", id,
+                  dumpString(build.literals.right.at(id).s).c_str(),
+                  lit_info.group_mask);
+
+    if (!coversGroup(build, lit_info)) {
+        DEBUG_PRINTF("does not cover group\n");
+        return false;
+    }
+
+    return isSelfSquasher(build, id, forbidden_squash_group);
+}
+
+/** \brief Groups containing delayed literals, which may not be squashed. */
+static
+rose_group findForbiddenSquashGroups(const RoseBuildImpl &build) {
     rose_group forbidden_squash_group = 0;
     for (const auto &e : build.literals.right) {
         if (e.second.delay) {
             forbidden_squash_group |= build.literal_info[e.first].group_mask;
         }
     }
+    return forbidden_squash_group;
+}
+
+void findGroupSquashers(RoseBuildImpl &build) {
+    rose_group forbidden_squash_group = findForbiddenSquashGroups(build);
 
     for (u32 id = 0; id < build.literal_info.size(); id++) {
         if (isGroupSquasher(build, id, forbidden_squash_group)) {
@@ -643,4 +677,220 @@ void findGroupSquashers(RoseBuildImpl &build) {
     }
 }
 
+void findSubgroupSquashers(RoseBuildImpl &build) {
+    if (!build.cc.grey.roseSubgroups) {
+        return;
+    }
+
+    const rose_group forbidden_squash_group = findForbiddenSquashGroups(build);
+
+    // Candidates in each group, keyed by vertex set. Literals with the same
+    // vertices cover each other, so they can share a subgroup.
+    map<u32, map<vector<size_t>, vector<u32>>> candidates;
+    for (u32 id = 0; id < build.literal_info.size(); id++) {
+        const rose_literal_info &info = build.literal_info[id];
+        if (info.squash_group || popcount64(info.group_mask) != 1) {
+            continue;
+        }
+        if (!isSelfSquasher(build, id, forbidden_squash_group)) {
+            continue;
+        }
+
+        vector<size_t> verts;
+        for (auto v : info.vertices) {
+            verts.push_back(build.g[v].idx);
+        }
+        sort(verts.begin(), verts.end());
+        candidates[ctz64(info.group_mask)][verts].push_back(id);
+    }
+
+    for (const auto &m : candidates) {
+        // Subgroup 0 is left for the literals that cannot squash themselves.
+        u32 subgroup = 1;
+        for (const auto &lits : m.second | map_values) {
+            if (subgroup == ROSE_SUBGROUPS_MAX) {
+                DEBUG_PRINTF("group %u is out of subgroups\n", m.first);
+                break;
+            }
+            for (u32 id : lits) {
+                DEBUG_PRINTF("lit %u squashes subgroup %u of group %u\n", id,
+                             subgroup, m.first);
+                build.literal_info[id].subgroup = verify_u8(subgroup);
+                build.literal_info[id].squash_subgroup = true;
+            }
+            subgroup++;
+        }
+    }
+}
+
+map<u32, u64a> findSubgroupMasks(const RoseBuildImpl &build) {
+    map<u32, u64a> masks;
+    for (const auto &info : build.literal_info) {
+        if (info.squash_subgroup) {
+            masks[ctz64(info.group_mask)] |= 1ULL << info.subgroup;
+        }
+    }
+
+    // Any literal left in the shared subgroup keeps its group alive.
+    for (auto &m : masks) {
+        for (u32 id : build.group_to_literal.at(m.first)) {
+            if (!build.literal_info[id].squash_subgroup) {
+                m.second |= 1ULL;
+                break;
+            }
+        }
+        DEBUG_PRINTF("group %u subgroups 0x%llx\n", m.first, m.second);
+    }
+
+    return masks;
+}
+
+/**
+ * \brief True if the report must be delivered whatever the pattern mask, as
+ * it drives internal machinery rather than (only) a user callback.
+ */
+static
+bool isMaskFixedReport(const RoseBuildImpl &build, ReportID id) {
+    const Report &ir = build.rm.getReport(id);
+    return !isExternalReport(ir) ||
+           build.rm.pl.getLogicalKey(ir.onmatch) != INVALID_LKEY;
+}
+
+/** \brief Rose vertices with literals, along with their literal groups. */
+static
+vector<pair<RoseVertex, rose_group>>
+findLiteralVertices(const RoseBuildImpl &build) {
+    vector<pair<RoseVertex, rose_group>> lit_vertices;
+    for (auto v : vertices_range(build.g)) {
+        rose_group groups = build.getGroups(v);
+        if (groups) {
+            lit_vertices.emplace_back(v, groups);
+        }
+    }
+    return lit_vertices;
+}
+
+/**
+ * \brief All reports raised by the roles and suffixes downstream of the
+ * literals in the given group.
+ */
+static
+set<ReportID>
+findReachableReports(const RoseBuildImpl &build,
+                     const vector<pair<RoseVertex, rose_group>> &lit_vertices,
+                     u32 group) {
+    const RoseGraph &g = build.g;
+    const rose_group mask = 1ULL << group;
+
+    vector<RoseVertex> pending;
+    unordered_set<RoseVertex> seen;
+    for (const auto &m : lit_vertices) {
+        if (m.second & mask) {
+            pending.push_back(m.first);
+            seen.insert(m.first);
+        }
+    }
+
+    set<ReportID> reports;
+    while (!pending.empty()) {
+        RoseVertex v = pending.back();
+        pending.pop_back();
+
+        insert(&reports, g[v].reports);
+        if (g[v].suffix) {
+            insert(&reports, all_reports(g[v].suffix));
+        }
+
+        for (auto w : adjacent_vertices_range(v, g)) {
+            if (seen.insert(w).second) {
+                pending.push_back(w);
+            }
+        }
+    }
+
+    return reports;
+}
+
+rose_group findGroupReports(const RoseBuildImpl &build,
+                            vector<vector<u32>> &group_reports) {
+    const auto lit_vertices = findLiteralVertices(build);
+
+    group_reports.assign(ROSE_GROUPS_MAX, vector<u32>());
+    rose_group fixed_groups = 0;
+
+    for (u32 group = 0; group < ROSE_GROUPS_MAX; group++) {
+        set<u32> ids;
+        bool fixed = false;
+        for (ReportID id : findReachableReports(build, lit_vertices, group)) {
+            if (isMaskFixedReport(build, id)) {
+                fixed = true;
+                break;
+            }
+            ids.insert(build.rm.getReport(id).onmatch);
+        }
+
+        if (fixed) {
+            DEBUG_PRINTF("group %u reaches internal reports\n", group);
+            fixed_groups |= 1ULL << group;
+            continue;
+        }
+
+        DEBUG_PRINTF("group %u reaches %zu external ids\n", group, ids.size());
+        group_reports[group].assign(ids.begin(), ids.end());
+    }
+
+    return fixed_groups;
+}
+
+/**
+ * \brief The exhaustion key that, once set, stops the given report from ever
+ * being raised again; INVALID_EKEY if it has none.
+ */
+static
+u32 findExhaustionKey(const RoseBuildImpl &build, ReportID id) {
+    const Report &ir = build.rm.getReport(id);
+    if (ir.ekey != INVALID_EKEY) {
+        return ir.ekey;
+    }
+    const match_limit_info *limit = build.rm.getMatchLimit(ir.onmatch);
+    return limit ? limit->ekey : INVALID_EKEY;
+}
+
+rose_group findGroupEkeys(const RoseBuildImpl &build,
+                          vector<vector<u32>> &group_ekeys) {
+    group_ekeys.assign(ROSE_GROUPS_MAX, vector<u32>());
+
+    if (build.cc.any_match || !build.rm.numEkeys()) {
+        // No exhaustion checks are done in any-match mode.
+        return 0;
+    }
+
+    const auto lit_vertices = findLiteralVertices(build);
+    rose_group exhaustible = 0;
+
+    for (u32 group = 0; group < ROSE_GROUPS_MAX; group++) {
+        set<u32> ekeys;
+        bool ok = true;
+        for (ReportID id : findReachableReports(build, lit_vertices, group)) {
+            u32 ekey = findExhaustionKey(build, id);
+            if (ekey == INVALID_EKEY || isMaskFixedReport(build, id)) {
+                ok = false;
+                break;
+            }
+            ekeys.insert(ekey);
+        }
+
+        if (!ok || ekeys.empty()) {
+            continue;
+        }
+
+        DEBUG_PRINTF("group %u is exhausted by %zu ekeys\n", group,
+                     ekeys.size());
+        group_ekeys[group].assign(ekeys.begin(), ekeys.end());
+        exhaustible |= 1ULL << group;
+    }
+
+    return exhaustible;
+}
+
 } // namespace ue2
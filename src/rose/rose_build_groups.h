@@ -37,6 +37,9 @@
 #include "rose_build_impl.h"
 #include "util/ue2_containers.h"
 
+#include <map>
+#include <vector>
+
 namespace ue2 {
 
 unordered_map<RoseVertex, rose_group>
@@ -50,6 +53,44 @@ void assignGroupsToRoles(RoseBuildImpl &build);
 
 void findGroupSquashers(RoseBuildImpl &build);
 
+/**
+ * \brief Give literals that can squash themselves, but not their whole group,
+ * a subgroup of their own within the group.
+ *
+ * Must be run after findGroupSquashers().
+ */
+void findSubgroupSquashers(RoseBuildImpl &build);
+
+/**
+ * \brief The initial subgroup masks of the groups that have subgroup
+ * squashers, by group index. Bit 0 is set if the group has literals that are
+ * never squashed.
+ */
+std::map<u32, u64a> findSubgroupMasks(const RoseBuildImpl &build);
+
+/**
+ * \brief Find the external report ids that depend on each literal group, for
+ * runtime pattern masks.
+ *
+ * Returns the groups that must stay on under any pattern mask, as they lead
+ * to internal reports or to sub-patterns of logical combinations. For every
+ * other group, group_reports receives the sorted report ids downstream of the
+ * group's literals.
+ */
+rose_group findGroupReports(const RoseBuildImpl &build,
+                            std::vector<std::vector<u32>> &group_reports);
+
+/**
+ * \brief Find the exhaustion keys that each literal group depends on, so that
+ * the runtime can turn a group off once all of them are set.
+ *
+ * Returns the groups whose literals only lead to exhaustible external
+ * reports. For each of these, group_ekeys receives the sorted exhaustion keys
+ * of those reports.
+ */
+rose_group findGroupEkeys(const RoseBuildImpl &build,
+                          std::vector<std::vector<u32>> &group_ekeys);
+
 } // namespace ue2
 
 #endif // ROSE_BUILD_GROUPS_H
@@ -55,6 +55,7 @@ struct RoseEngine;
 namespace ue2 {
 
 #define ROSE_GROUPS_MAX 64
+#define ROSE_SUBGROUPS_MAX 64
 
 struct BoundaryReports;
 struct CastleProto;
@@ -252,6 +253,16 @@ struct rose_literal_info {
     u32 undelayed_id = MO_INVALID_IDX;
     u32 final_id = MO_INVALID_IDX; /* id reported by fdr */
     bool squash_group = false;
+
+    /** \brief Subgroup of this literal within its (single) group. Subgroup 0
+     * is shared by all literals that cannot squash themselves and is never
+     * squashed. */
+    u8 subgroup = 0;
+
+    /** \brief True if this literal squashes its own subgroup once it has
+     * matched, see findSubgroupSquashers(). */
+    bool squash_subgroup = false;
+
     bool requires_explode = false;
     bool requires_benefits = false;
 };
@@ -334,12 +345,27 @@ struct MpvProto {
     std::vector<raw_puff> triggered_puffettes;
 };
 
+/**
+ * \brief McClellan DFAs that could not be merged into one without blowing up
+ * the state count, to be run together in lockstep as a DFA group engine.
+ */
+struct DfaGroupProto {
+    DfaGroupProto() = default;
+    DfaGroupProto(DfaGroupProto &&) = default;
+    DfaGroupProto &operator=(DfaGroupProto &&) = default;
+
+    std::vector<std::unique_ptr<raw_dfa>> members;
+};
+
 struct OutfixInfo {
     template<class T>
     explicit OutfixInfo(std::unique_ptr<T> x) : proto(std::move(x)) {}
 
     explicit OutfixInfo(MpvProto mpv_in) : proto(std::move(mpv_in)) {}
 
+    explicit OutfixInfo(DfaGroupProto group_in)
+        : proto(std::move(group_in)) {}
+
     u32 get_queue(QueueIndexFactory &qif);
 
     u32 get_queue() const {
@@ -381,6 +407,9 @@ struct OutfixInfo {
     MpvProto *mpv() {
         return boost::get<MpvProto>(&proto);
     }
+    DfaGroupProto *dfa_group() {
+        return boost::get<DfaGroupProto>(&proto);
+    }
 
     // Convenience const accessor functions.
 
@@ -399,6 +428,9 @@ struct OutfixInfo {
     const MpvProto *mpv() const {
         return boost::get<MpvProto>(&proto);
     }
+    const DfaGroupProto *dfa_group() const {
+        return boost::get<DfaGroupProto>(&proto);
+    }
 
     /**
      * \brief Variant wrapping the various engine types. If this is
@@ -409,7 +441,8 @@ struct OutfixInfo {
         std::unique_ptr<NGHolder>,
         std::unique_ptr<raw_dfa>,
         std::unique_ptr<raw_som_dfa>,
-        MpvProto> proto = boost::blank();
+        MpvProto,
+        DfaGroupProto> proto = boost::blank();
 
     RevAccInfo rev_info;
     u32 maxBAWidth = 0; //!< max bi-anchored width
@@ -460,8 +493,10 @@ public:
                  bool eod) override;
 
     // Construct a runtime implementation.
-    aligned_unique_ptr<RoseEngine> buildRose(u32 minWidth) override;
-    aligned_unique_ptr<RoseEngine> buildFinalEngine(u32 minWidth);
+    aligned_unique_ptr<RoseEngine> buildRose(u32 minWidth,
+                                             u32 maxWidth) override;
+    aligned_unique_ptr<RoseEngine> buildFinalEngine(u32 minWidth,
+                                                    u32 maxWidth);
 
     void setSom() override { hasSom = true; }
 
@@ -490,7 +525,10 @@ public:
 
     RoseVertex cloneVertex(RoseVertex v);
 
-    u32 calcHistoryRequired() const;
+    /** \brief History required in streaming mode. If \a idle is true,
+     * omits the history needed only while a non-transient leftfix is alive
+     * or delayed literals are waiting to be rebuilt. */
+    u32 calcHistoryRequired(bool idle = false) const;
 
     rose_group getInitialGroups() const;
     rose_group getSuccGroups(RoseVertex start) const;
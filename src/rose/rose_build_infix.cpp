@@ -48,6 +48,11 @@ using namespace std;
 
 namespace ue2 {
 
+/** \brief Largest infix match count for which we will build a counting
+ * miracle. Must fit in RoseCountingMiracle::count (a u8) once incremented. The
+ * runtime scan is vectorised, so large counts over long windows are cheap. */
+static const u32 MAX_COUNTING_MIRACLE_COUNT = 200;
+
 static
 bool couldEndLiteral(const ue2_literal &s, NFAVertex initial,
                      const NGHolder &h) {
@@ -317,7 +322,7 @@ void findCountingMiracleInfo(const left_id &left, const vector<u8> &stopTable,
 
     u32 count = findMaxInfixMatches(*left.graph(), lits);
     DEBUG_PRINTF("counting miracle %u\n", count + 1);
-    if (count && count < 50) {
+    if (count && count < MAX_COUNTING_MIRACLE_COUNT) {
         *cm_count = count + 1;
     }
 }
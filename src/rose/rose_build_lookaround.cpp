@@ -32,6 +32,7 @@
 #include "rose_build_lookaround.h"
 
 #include "rose_build_impl.h"
+#include "rose_program.h"
 #include "nfa/castlecompile.h"
 #include "nfa/goughcompile.h"
 #include "nfa/rdfa.h"
@@ -45,6 +46,7 @@
 
 #include <cstdlib>
 #include <queue>
+#include <set>
 
 using namespace std;
 
@@ -59,6 +61,17 @@ static const u32 MAX_BACK_LEN = 64;
 /** \brief Max lookaround entries for a role. */
 static const u32 MAX_LOOKAROUND_ENTRIES = 16;
 
+/** \brief Max lookaround entries for a path of a leftfix implemented as
+ * lookaround, enough for the 64-byte mask check. */
+static const u32 MAX_LEFTFIX_LOOKAROUND_ENTRIES = 64;
+
+/** \brief Max distance behind a role for a leftfix lookaround, the furthest an
+ * s8 offset can reach. */
+static const u32 MAX_LEFTFIX_LOOKAROUND_DIST = 128;
+
+/** \brief Max paths for a leftfix implemented as lookaround. */
+static const u32 MAX_LEFTFIX_LOOKAROUND_PATHS = ROSE_MULTIPATH_LOOKAROUND_MAX;
+
 /** \brief We would rather have lookarounds with smaller reach than this. */
 static const u32 LOOKAROUND_WIDE_REACH = 200;
 
@@ -538,28 +551,27 @@ void findLookaroundMasks(const RoseBuildImpl &tbi, const RoseVertex v,
     }
 }
 
+/**
+ * \brief Returns true if every way into the graph is floating: the anchored
+ * start may only lead to startDs or to vertices that startDs also leads to.
+ */
 static
-bool hasSingleFloatingStart(const NGHolder &g) {
-    NFAVertex initial = NGHolder::null_vertex();
+bool hasOnlyFloatingStarts(const NGHolder &g) {
+    bool has_start = false;
     for (auto v : adjacent_vertices_range(g.startDs, g)) {
-        if (v == g.startDs) {
-            continue;
-        }
-        if (initial != NGHolder::null_vertex()) {
-            DEBUG_PRINTF("more than one start\n");
-            return false;
+        if (v != g.startDs) {
+            has_start = true;
+            break;
         }
-        initial = v;
     }
 
-    if (initial == NGHolder::null_vertex()) {
+    if (!has_start) {
         DEBUG_PRINTF("no floating starts\n");
         return false;
     }
 
-    // Anchored start must have no successors other than startDs and initial.
     for (auto v : adjacent_vertices_range(g.start, g)) {
-        if (v != initial && v != g.startDs) {
+        if (v != g.startDs && !edge(g.startDs, v, g).second) {
             DEBUG_PRINTF("anchored start\n");
             return false;
         }
@@ -568,60 +580,95 @@ bool hasSingleFloatingStart(const NGHolder &g) {
     return true;
 }
 
+/**
+ * \brief Walks backwards from \a v, which is \a dist bytes behind the role
+ * match, adding a lookaround path to \a paths for each way back to startDs.
+ */
 static
-bool getTransientPrefixReach(const NGHolder &g, u32 lag,
-                             map<s32, CharReach> &look) {
-    if (in_degree(g.accept, g) != 1) {
-        DEBUG_PRINTF("more than one accept\n");
+bool walkPrefixPaths(const NGHolder &g, NFAVertex v, u32 dist,
+                     map<s32, CharReach> &look,
+                     vector<map<s32, CharReach>> &paths) {
+    DEBUG_PRINTF("dist=%u, v=%u\n", dist, g[v].index);
+    if (is_special(v, g)) {
+        DEBUG_PRINTF("special\n");
         return false;
     }
 
-    // Must be a floating chain wired to startDs.
-    if (!hasSingleFloatingStart(g)) {
-        DEBUG_PRINTF("not a single floating start\n");
+    if (dist > MAX_LEFTFIX_LOOKAROUND_DIST) {
+        DEBUG_PRINTF("too far back\n");
         return false;
     }
 
-    NFAVertex v = *(inv_adjacent_vertices(g.accept, g).first);
-    u32 i = lag + 1;
-    while (v != g.startDs) {
-        DEBUG_PRINTF("i=%u, v=%u\n", i, g[v].index);
-        if (is_special(v, g)) {
-            DEBUG_PRINTF("special\n");
+    const s32 offset = 0 - (s32)dist;
+    look[offset] = g[v].char_reach;
+
+    if (edge(g.startDs, v, g).second) {
+        // Any longer path through v is subsumed by this one.
+        paths.push_back(look);
+        look.erase(offset);
+        if (paths.size() > MAX_LEFTFIX_LOOKAROUND_PATHS) {
+            DEBUG_PRINTF("too many paths\n");
             return false;
         }
+        return true;
+    }
 
-        look[0 - i] = g[v].char_reach;
-
-        NFAVertex next = NGHolder::null_vertex();
-        for (auto u : inv_adjacent_vertices_range(v, g)) {
-            if (u == g.start) {
-                continue; // Benign, checked by hasSingleFloatingStart
-            }
-            if (next == NGHolder::null_vertex()) {
-                next = u;
-                continue;
-            }
-            DEBUG_PRINTF("branch\n");
+    bool has_pred = false;
+    for (auto u : inv_adjacent_vertices_range(v, g)) {
+        if (u == g.start) {
+            continue; // Benign, checked by hasOnlyFloatingStarts
+        }
+        if (u == v) {
+            DEBUG_PRINTF("self-loop\n");
             return false;
         }
-
-        if (next == NGHolder::null_vertex() || next == v) {
-            DEBUG_PRINTF("no predecessor or only self-loop\n");
-            // This graph is malformed -- all vertices in a graph that makes it
-            // to this analysis should have predecessors.
-            assert(0);
+        has_pred = true;
+        if (!walkPrefixPaths(g, u, dist + 1, look, paths)) {
             return false;
         }
+    }
 
-        v = next;
-        i++;
+    if (!has_pred) {
+        // This graph is malformed -- all vertices in a graph that makes it to
+        // this analysis should have predecessors.
+        assert(0);
+        return false;
     }
 
-    DEBUG_PRINTF("done\n");
+    look.erase(offset);
     return true;
 }
 
+/**
+ * \brief Collects the reach along every path from startDs to the vertices
+ * raising \a report, if the prefix is a small acyclic floating graph.
+ */
+static
+bool getTransientPrefixPaths(const NGHolder &g, ReportID report, u32 lag,
+                             vector<map<s32, CharReach>> &paths) {
+    if (!hasOnlyFloatingStarts(g)) {
+        DEBUG_PRINTF("not floating\n");
+        return false;
+    }
+
+    map<s32, CharReach> look;
+    for (auto v : inv_adjacent_vertices_range(g.accept, g)) {
+        if (is_special(v, g)) {
+            DEBUG_PRINTF("accepts empty string\n");
+            return false;
+        }
+        if (!contains(g[v].reports, report)) {
+            continue;
+        }
+        if (!walkPrefixPaths(g, v, lag + 1, look, paths)) {
+            return false;
+        }
+    }
+
+    DEBUG_PRINTF("found %zu paths\n", paths.size());
+    return !paths.empty();
+}
+
 static
 void normaliseLeftfix(map<s32, CharReach> &look) {
     // We can erase entries where the reach is "all characters", except for the
@@ -647,7 +694,7 @@ void normaliseLeftfix(map<s32, CharReach> &look) {
 }
 
 bool makeLeftfixLookaround(const RoseBuildImpl &build, const RoseVertex v,
-                           vector<LookEntry> &lookaround) {
+                           vector<vector<LookEntry>> &lookaround) {
     lookaround.clear();
 
     const RoseGraph &g = build.g;
@@ -663,35 +710,48 @@ bool makeLeftfixLookaround(const RoseBuildImpl &build, const RoseVertex v,
         return false;
     }
 
-    map<s32, CharReach> look;
-    if (!getTransientPrefixReach(*leftfix.graph(), g[v].left.lag, look)) {
-        DEBUG_PRINTF("not a chain\n");
+    vector<map<s32, CharReach>> paths;
+    if (!getTransientPrefixPaths(*leftfix.graph(), g[v].left.leftfix_report,
+                                 g[v].left.lag, paths)) {
+        DEBUG_PRINTF("not a small acyclic prefix\n");
         return false;
     }
 
-    trimLiterals(build, v, look);
-    normaliseLeftfix(look);
+    // Paths may coincide once trimmed against the literal.
+    set<map<s32, CharReach>> looks;
+    for (auto &look : paths) {
+        trimLiterals(build, v, look);
+        normaliseLeftfix(look);
 
-    if (look.size() > MAX_LOOKAROUND_ENTRIES) {
-        DEBUG_PRINTF("lookaround too big (%zu entries)\n", look.size());
-        return false;
-    }
+        if (look.size() > MAX_LEFTFIX_LOOKAROUND_ENTRIES) {
+            DEBUG_PRINTF("lookaround too big (%zu entries)\n", look.size());
+            return false;
+        }
 
-    if (look.empty()) {
-        DEBUG_PRINTF("lookaround empty; this is weird\n");
-        return false;
+        if (look.empty()) {
+            DEBUG_PRINTF("lookaround empty; this is weird\n");
+            return false;
+        }
+
+        looks.insert(move(look));
     }
 
-    lookaround.reserve(look.size());
-    for (const auto &m : look) {
-        if (m.first < -128 || m.first > 127) {
-            DEBUG_PRINTF("range too big\n");
-            return false;
+    for (const auto &look : looks) {
+        vector<LookEntry> path;
+        path.reserve(look.size());
+        for (const auto &m : look) {
+            if (m.first < -128 || m.first > 127) {
+                DEBUG_PRINTF("range too big\n");
+                lookaround.clear();
+                return false;
+            }
+            s8 offset = verify_s8(m.first);
+            path.emplace_back(offset, m.second);
         }
-        s8 offset = verify_s8(m.first);
-        lookaround.emplace_back(offset, m.second);
+        lookaround.push_back(move(path));
     }
 
+    DEBUG_PRINTF("leftfix has %zu lookaround paths\n", lookaround.size());
     return true;
 }
 
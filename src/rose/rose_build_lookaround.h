@@ -68,11 +68,12 @@ void findLookaroundMasks(const RoseBuildImpl &tbi, const RoseVertex v,
 /**
  * \brief If possible, render the prefix of the given vertex as a lookaround.
  *
- * Given a prefix, returns true (and fills the lookaround vector) if
- * it can be satisfied with a lookaround alone.
+ * Given a prefix, returns true (and fills the lookaround vector with one
+ * lookaround per path through the prefix) if it can be satisfied with
+ * lookarounds alone: the prefix matches if any one of the paths does.
  */
 bool makeLeftfixLookaround(const RoseBuildImpl &build, const RoseVertex v,
-                           std::vector<LookEntry> &lookaround);
+                           std::vector<std::vector<LookEntry>> &lookaround);
 
 void mergeLookaround(std::vector<LookEntry> &lookaround,
                      const std::vector<LookEntry> &more_lookaround);
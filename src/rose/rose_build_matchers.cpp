@@ -711,9 +711,11 @@ aligned_unique_ptr<HWLM> buildFloatingMatcher(const RoseBuildImpl &build,
                                               rose_group *fgroups,
                                               size_t *fsize,
                                               size_t *historyRequired,
+                                              size_t *literalHistoryRequired,
                                               size_t *streamStateRequired) {
     *fsize = 0;
     *fgroups = 0;
+    *literalHistoryRequired = 0;
 
     auto fl = fillHamsterLiteralList(build, ROSE_FLOATING);
     if (fl.empty()) {
@@ -753,6 +755,7 @@ aligned_unique_ptr<HWLM> buildFloatingMatcher(const RoseBuildImpl &build,
                build.cc.grey.maxHistoryAvailable);
         *historyRequired = max(*historyRequired,
                 ctl.literal_history_required);
+        *literalHistoryRequired = ctl.literal_history_required;
         *streamStateRequired = ctl.literal_stream_state_required;
     }
 
@@ -807,8 +810,13 @@ aligned_unique_ptr<HWLM> buildSmallBlockMatcher(const RoseBuildImpl &build,
         return nullptr;
     }
 
-    aligned_unique_ptr<HWLM> hwlm =
-        hwlmBuild(lits, nullptr, true, build.cc, build.getInitialGroups());
+    // The small block is at most ROSE_SMALL_BLOCK_LEN bytes, which the
+    // dedicated small-block engine covers with one or two vector loads.
+    aligned_unique_ptr<HWLM> hwlm = hwlmBuildSmallBlock(lits, build.cc);
+    if (!hwlm) {
+        hwlm = hwlmBuild(lits, nullptr, true, build.cc,
+                         build.getInitialGroups());
+    }
     if (!hwlm) {
         throw CompileError("Unable to generate bytecode.");
     }
@@ -57,6 +57,7 @@ aligned_unique_ptr<HWLM> buildFloatingMatcher(const RoseBuildImpl &build,
                                               rose_group *fgroups,
                                               size_t *fsize,
                                               size_t *historyRequired,
+                                              size_t *literalHistoryRequired,
                                               size_t *streamStateRequired);
 
 aligned_unique_ptr<HWLM> buildSmallBlockMatcher(const RoseBuildImpl &build,
@@ -38,6 +38,7 @@
 #include "rose_build_util.h"
 #include "ue2common.h"
 #include "nfa/castlecompile.h"
+#include "nfa/dfagroup_internal.h"
 #include "nfa/goughcompile.h"
 #include "nfa/limex_limits.h"
 #include "nfa/mcclellancompile.h"
@@ -783,8 +784,43 @@ typedef Bouquet<suffix_id> SuffixBouquet;
 
 } // namespace
 
+/** \brief Union of the reach of the (non-special) vertices of \a h. */
+static
+CharReach graphReach(const NGHolder &h) {
+    CharReach cr;
+    for (auto v : vertices_range(h)) {
+        if (!is_special(v, h)) {
+            cr |= h[v].char_reach;
+        }
+    }
+    return cr;
+}
+
+/**
+ * \brief Similarity key for an engine, used to order merge candidates.
+ *
+ * Engines over the same characters merge without losing acceleration and
+ * tend to share states, so sorting by this key brings likely merge partners
+ * together, with engines of similar size next to each other.
+ */
+template <class EngineRef>
+static
+pair<CharReach, size_t> similarityKey(const EngineRef &e) {
+    if (e.graph()) {
+        return {graphReach(*e.graph()), num_vertices(*e.graph())};
+    }
+    if (e.castle()) {
+        return {e.castle()->reach(), e.castle()->repeats.size()};
+    }
+    return {CharReach(), 0};
+}
+
 /**
  * Split a \ref Bouquet of some type into several smaller ones.
+ *
+ * When the input must be split, engines are first ordered by \ref
+ * similarityKey so that each chunk holds engines that are likely to merge,
+ * rather than whichever engines happened to be adjacent in insertion order.
  */
 template <class EngineRef>
 static void chunkBouquets(const Bouquet<EngineRef> &in,
@@ -795,8 +831,22 @@ static void chunkBouquets(const Bouquet<EngineRef> &in,
         return;
     }
 
-    out.push_back(Bouquet<EngineRef>());
+    vector<pair<pair<CharReach, size_t>, EngineRef>> keyed;
+    keyed.reserve(in.size());
     for (const auto &engine : in) {
+        keyed.emplace_back(similarityKey(engine), engine);
+    }
+    // Stable, so that engines with equal keys keep their (deterministic)
+    // insertion order.
+    stable_sort(keyed.begin(), keyed.end(),
+                [](const pair<pair<CharReach, size_t>, EngineRef> &a,
+                   const pair<pair<CharReach, size_t>, EngineRef> &b) {
+                    return a.first < b.first;
+                });
+
+    out.push_back(Bouquet<EngineRef>());
+    for (const auto &m : keyed) {
+        const EngineRef &engine = m.second;
         if (out.back().size() >= chunk_size) {
             out.push_back(Bouquet<EngineRef>());
         }
@@ -2421,9 +2471,23 @@ void mergeOutfixInfo(OutfixInfo &winner, const OutfixInfo &victim) {
 
 static
 map<NGHolder *, NGHolder *> chunkedNfaMerge(RoseBuildImpl &build,
-                                            const vector<NGHolder *> &nfas) {
+                                            const vector<NGHolder *> &in) {
     map<NGHolder *, NGHolder *> merged;
 
+    // As for chunkBouquets: if the engines must be split into batches, batch
+    // similar engines together.
+    vector<NGHolder *> nfas(in);
+    if (nfas.size() > MERGE_GROUP_SIZE_MAX) {
+        map<const NGHolder *, pair<CharReach, size_t>> keys;
+        for (const auto *h : nfas) {
+            keys.emplace(h, make_pair(graphReach(*h), num_vertices(*h)));
+        }
+        stable_sort(nfas.begin(), nfas.end(),
+                    [&keys](const NGHolder *a, const NGHolder *b) {
+                        return keys.at(a) < keys.at(b);
+                    });
+    }
+
     vector<NGHolder *> batch;
     for (auto it = begin(nfas), ite = end(nfas); it != ite; ++it) {
         batch.push_back(*it);
@@ -2697,6 +2761,70 @@ void mergeOutfixHaigs(RoseBuildImpl &tbi, vector<raw_som_dfa *> &dfas,
     removeDeadOutfixes(outfixes);
 }
 
+/**
+ * \brief DFA outfixes with this many states or fewer are left out of DFA
+ * groups, as they may be built as (faster) Sheng engines.
+ */
+static const size_t DFA_GROUP_MIN_STATES = 16;
+
+/**
+ * Gathers the DFA outfixes left over after merging (which could not be merged
+ * into one another without blowing up the state count) into DFA group engines
+ * of up to DFA_GROUP_MAX_MEMBERS, which scan their members in lockstep.
+ */
+static
+void groupOutfixDfas(RoseBuildImpl &tbi) {
+    if (!tbi.cc.grey.allowDfaGroup) {
+        return;
+    }
+
+    vector<size_t> candidates;
+    for (size_t i = 0; i < tbi.outfixes.size(); i++) {
+        const OutfixInfo &outfix = tbi.outfixes[i];
+        const raw_dfa *rdfa = outfix.rdfa();
+        if (!rdfa) {
+            continue;
+        }
+        if (rdfa->states.size() <= DFA_GROUP_MIN_STATES) {
+            DEBUG_PRINTF("outfix %zu is small enough for sheng\n", i);
+            continue;
+        }
+        if (outfix.minWidth == depth(1) && outfix.maxWidth == depth(1)) {
+            DEBUG_PRINTF("outfix %zu may go in the small block matcher\n", i);
+            continue;
+        }
+        candidates.push_back(i);
+    }
+
+    DEBUG_PRINTF("%zu candidate dfas for grouping\n", candidates.size());
+    if (candidates.size() < 2) {
+        return;
+    }
+
+    for (size_t base = 0; base + 1 < candidates.size();
+         base += DFA_GROUP_MAX_MEMBERS) {
+        size_t end = min(base + DFA_GROUP_MAX_MEMBERS, candidates.size());
+        OutfixInfo &winner = tbi.outfixes[candidates[base]];
+
+        DfaGroupProto group;
+        for (size_t i = base; i < end; i++) {
+            OutfixInfo &outfix = tbi.outfixes[candidates[i]];
+            auto *up = boost::get<unique_ptr<raw_dfa>>(&outfix.proto);
+            assert(up && *up);
+            group.members.push_back(move(*up));
+            if (i != base) {
+                mergeOutfixInfo(winner, outfix);
+                outfix.clear();
+            }
+        }
+
+        DEBUG_PRINTF("built group of %zu dfas\n", group.members.size());
+        winner.proto = move(group);
+    }
+
+    removeDeadOutfixes(tbi.outfixes);
+}
+
 /**
  * This pass attempts to merge outfix engines together. At this point in time,
  * the engine type (NFA, DFA, Haig) has already been decided for each outfix
@@ -2732,6 +2860,7 @@ void mergeOutfixes(RoseBuildImpl &tbi) {
     mergeOutfixHaigs(tbi, som_dfas, 255);
     mergeOutfixHaigs(tbi, som_dfas, 8192);
     mergeOutfixCombo(tbi, tbi.rm, tbi.cc.grey);
+    groupOutfixDfas(tbi);
 }
 
 static
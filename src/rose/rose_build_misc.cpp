@@ -945,6 +945,13 @@ public:
         }
         return reports;
     }
+    set<ReportID> operator()(const DfaGroupProto &group) const {
+        set<ReportID> reports;
+        for (const auto &rdfa : group.members) {
+            insert(&reports, all_reports(*rdfa));
+        }
+        return reports;
+    }
 };
 }
 
@@ -1226,7 +1233,7 @@ u32 roseQuality(const RoseEngine *t) {
         }
         const NFA *nfa = (const NFA *)((const char *)atable + sizeof(*atable));
 
-        if (nfa->type != MCCLELLAN_NFA_8) {
+        if (nfa->type != MCCLELLAN_NFA_8 && nfa->type != SHENG_NFA_0) {
             DEBUG_PRINTF("m16 atable engine\n");
             return 0;
         }
@@ -156,6 +156,50 @@ private:
     ue2::unordered_set<RoseVertex> hash_cont; /* member checks */
 };
 
+/**
+ * \brief Candidate vertices grouped by a hash of the properties that a merge
+ * pass requires to be equal, so that each vertex need only be compared with
+ * the others in its bucket. Buckets are kept in vertex index order for
+ * determinism.
+ */
+class RoleBuckets {
+public:
+    explicit RoleBuckets(const RoseGraph &g_in) : g(g_in) {}
+
+    void insert(RoseVertex v, size_t key) {
+        assert(!ue2::contains(keys, v));
+        keys.emplace(v, key);
+        auto &bucket = buckets[key];
+        bucket.insert(upper_bound(bucket.begin(), bucket.end(), v,
+                                  VertexIndexComp(g)),
+                      v);
+    }
+
+    void erase(RoseVertex v) {
+        auto it = keys.find(v);
+        if (it == keys.end()) {
+            return;
+        }
+        auto &bucket = buckets[it->second];
+        bucket.erase(find(bucket.begin(), bucket.end(), v));
+        keys.erase(it);
+    }
+
+    bool contains(RoseVertex v) const {
+        return ue2::contains(keys, v);
+    }
+
+    /** \brief The vertices in the same bucket as \a v, including \a v. */
+    const vector<RoseVertex> &siblings(RoseVertex v) const {
+        return buckets.at(keys.at(v));
+    }
+
+private:
+    const RoseGraph &g;
+    ue2::unordered_map<size_t, vector<RoseVertex>> buckets;
+    ue2::unordered_map<RoseVertex, size_t> keys;
+};
+
 struct RoseAliasingInfo {
     RoseAliasingInfo(const RoseBuildImpl &build) {
         const auto &g = build.g;
@@ -493,6 +537,92 @@ size_t hashRightRoleProperties(RoseVertex v, const RoseGraph &g) {
     return val;
 }
 
+static
+size_t hashEdgeProps(const RoseEdgeProps &props) {
+    using boost::hash_combine;
+
+    size_t val = 0;
+    hash_combine(val, props.minBound);
+    hash_combine(val, props.maxBound);
+    hash_combine(val, props.rose_top);
+    hash_combine(val, (u32)props.history);
+    return val;
+}
+
+/**
+ * Hash on the properties required for left equivalence: literals, role
+ * properties and predecessors (with edge properties).
+ */
+static
+size_t hashLeftRoleProperties(RoseVertex v, const RoseGraph &g) {
+    using boost::hash_combine;
+    using boost::hash_range;
+
+    const RoseVertexProps &props = g[v];
+
+    size_t val = 0;
+    hash_combine(val, hash_range(begin(props.literals), end(props.literals)));
+    hash_combine(val, props.eod_accept);
+    hash_combine(val, props.som_adjust);
+
+    vector<pair<size_t, size_t>> preds;
+    for (const auto &e : in_edges_range(v, g)) {
+        preds.emplace_back(g[source(e, g)].idx, hashEdgeProps(g[e]));
+    }
+    sort(preds.begin(), preds.end());
+    hash_combine(val, hash_range(preds.begin(), preds.end()));
+
+    return val;
+}
+
+/**
+ * Hash on the properties required for right equivalence: literals, role
+ * properties, reports, suffix and successors (with edge properties).
+ */
+static
+size_t hashRightMergeProperties(RoseVertex v, const RoseGraph &g) {
+    using boost::hash_combine;
+    using boost::hash_range;
+
+    const RoseVertexProps &props = g[v];
+
+    size_t val = hashRightRoleProperties(v, g);
+    hash_combine(val, hash_range(begin(props.literals), end(props.literals)));
+    hash_combine(val, props.eod_accept);
+    hash_combine(val, props.som_adjust);
+
+    vector<pair<size_t, size_t>> succs;
+    for (const auto &e : out_edges_range(v, g)) {
+        succs.emplace_back(g[target(e, g)].idx, hashEdgeProps(g[e]));
+    }
+    sort(succs.begin(), succs.end());
+    hash_combine(val, hash_range(succs.begin(), succs.end()));
+
+    return val;
+}
+
+/**
+ * \brief Re-files \a a's neighbours that are still in \a buckets after \a a
+ * has been merged into \a b, as their edges have changed.
+ */
+template<typename HashFn>
+static
+void rehashAfterMerge(RoleBuckets &buckets, RoseVertex a, RoseVertex b,
+                      const vector<RoseVertex> &neighbours,
+                      const RoseGraph &g, HashFn hash) {
+    buckets.erase(a);
+    for (RoseVertex v : neighbours) {
+        if (buckets.contains(v)) {
+            buckets.erase(v);
+            buckets.insert(v, hash(v, g));
+        }
+    }
+    if (buckets.contains(b)) {
+        buckets.erase(b);
+        buckets.insert(b, hash(b, g));
+    }
+}
+
 static
 void mergeEdgeAdd(RoseVertex u, RoseVertex v, const RoseEdge &from_edge,
                   const RoseEdge *to_edge, RoseGraph &g) {
@@ -695,35 +825,6 @@ void findCandidates(const RoseBuildImpl &build, CandidateSet *candidates) {
                  num_vertices(build.g));
 }
 
-static
-RoseVertex pickSucc(const RoseVertex v, const RoseGraph &g) {
-    RoseGraph::adjacency_iterator ai, ae;
-    tie(ai, ae) = adjacent_vertices(v, g);
-    if (ai == ae) {
-        return RoseGraph::null_vertex();
-    }
-    return *ai;
-}
-
-static
-RoseVertex pickPred(const RoseVertex v, const RoseGraph &g,
-                    const RoseBuildImpl &build) {
-    RoseGraph::in_edge_iterator ei, ee;
-    tie(ei, ee) = in_edges(v, g);
-    if (ei == ee) {
-        assert(0); // every candidate should have in-degree!
-        return RoseGraph::null_vertex();
-    }
-
-    // Avoid roots if we have other options, since it doesn't matter to the
-    // merge pass which predecessor we pick.
-    RoseVertex u = source(*ei, g);
-    while (build.isAnyStart(u) && ++ei != ee) {
-        u = source(*ei, g);
-    }
-    return u;
-}
-
 template<>
 bool contains<>(const CandidateSet &container, const RoseVertex &key) {
     return container.contains(key);
@@ -1636,9 +1737,9 @@ void diamondMergePass(CandidateSet &candidates, RoseBuildImpl &build,
 }
 
 static
-vector<RoseVertex>::iterator findLeftMergeSibling(
-                          vector<RoseVertex>::iterator it,
-                          const vector<RoseVertex>::iterator &end,
+vector<RoseVertex>::const_iterator findLeftMergeSibling(
+                          vector<RoseVertex>::const_iterator it,
+                          const vector<RoseVertex>::const_iterator &end,
                           const RoseVertex a, const RoseBuildImpl &build,
                           const RoseAliasingInfo &rai,
                           const CandidateSet &candidates) {
@@ -1688,36 +1789,23 @@ void leftMergePass(CandidateSet &candidates, RoseBuildImpl &build,
                    vector<RoseVertex> *dead, RoseAliasingInfo &rai) {
     DEBUG_PRINTF("begin (%zu)\n", candidates.size());
     RoseGraph &g = build.g;
-    vector<RoseVertex> siblings;
 
+    // Left-equivalent vertices share literals and predecessors, so only
+    // vertices with the same hash of these need be compared.
+    RoleBuckets buckets(g);
+    for (auto v : candidates) {
+        buckets.insert(v, hashLeftRoleProperties(v, g));
+    }
+
+    vector<RoseVertex> succs;
     CandidateSet::iterator it = candidates.begin();
     while (it != candidates.end()) {
         RoseVertex a = *it;
         CandidateSet::iterator ait = it;
         ++it;
 
-        // We have to find a sibling to merge `a' with, and we select between
-        // two approaches to minimize the number of vertices we have to
-        // examine; which we use depends on the shape of the graph.
-
         assert(!g[a].literals.empty());
-        u32 lit_id = *g[a].literals.begin();
-        const auto &verts = build.literal_info.at(lit_id).vertices;
-        RoseVertex pred = pickPred(a, g, build);
-
-        siblings.clear();
-        if (pred == RoseGraph::null_vertex() || build.isAnyStart(pred) ||
-                    hasGreaterOutDegree(verts.size(), pred, g)) {
-            // Select sibling from amongst the vertices that share a literal.
-            siblings.insert(siblings.end(), verts.begin(), verts.end());
-        } else {
-            // Select sibling from amongst the vertices that share a
-            // predecessor.
-            insert(&siblings, siblings.end(), adjacent_vertices(pred, g));
-        }
-
-        sort(siblings.begin(), siblings.end(), VertexIndexComp(g));
-
+        const auto &siblings = buckets.siblings(a);
         auto jt = findLeftMergeSibling(siblings.begin(), siblings.end(), a,
                                        build, rai, candidates);
         if (jt == siblings.end()) {
@@ -1731,9 +1819,15 @@ void leftMergePass(CandidateSet &candidates, RoseBuildImpl &build,
             continue;
         }
 
+        succs.clear();
+        insert(&succs, succs.end(), adjacent_vertices(a, g));
+
         mergeVerticesLeft(a, b, build, rai);
         dead->push_back(a);
         candidates.erase(ait);
+
+        // a's successors now have b as a predecessor instead.
+        rehashAfterMerge(buckets, a, b, succs, g, hashLeftRoleProperties);
     }
 
     DEBUG_PRINTF("%zu candidates remaining\n", candidates.size());
@@ -1817,116 +1911,28 @@ vector<RoseVertex>::const_iterator findRightMergeSibling(
     return end;
 }
 
-template<class Iter>
-static
-void split(map<RoseVertex, size_t> &keys, size_t *next_key, Iter it,
-           const Iter end) {
-    map<size_t, size_t> new_keys;
-
-    for (; it != end; ++it) {
-        RoseVertex v = *it;
-        size_t ok = keys[v];
-        size_t nk;
-        if (contains(new_keys, ok)) {
-            nk = new_keys[ok];
-        } else {
-            nk = (*next_key)++;
-            new_keys[ok] = nk;
-        }
-        keys[v] = nk;
-    }
-}
-
-static never_inline
-void buildCandidateRightSiblings(CandidateSet &candidates, RoseBuildImpl &build,
-                                 map<size_t, vector<RoseVertex>> &sibling_cache,
-                                 map<RoseVertex, size_t> &keys_ext) {
-    RoseGraph &g = build.g;
-
-    size_t next_key = 1;
-    map<RoseVertex, size_t> keys;
-
-    for (const auto &c : candidates) {
-        keys[c] = 0;
-    }
-
-    set<RoseVertex> done_succ;
-    set<u32> done_lit;
-
-    for (auto a : candidates) {
-        assert(!g[a].literals.empty());
-        u32 lit_id = *g[a].literals.begin();
-        RoseVertex succ = pickSucc(a, g);
-        const auto &verts = build.literal_info.at(lit_id).vertices;
-        if (succ != RoseGraph::null_vertex() &&
-                !hasGreaterInDegree(verts.size(), succ, g)) {
-            if (!done_succ.insert(succ).second) {
-                continue; // succ already in done_succ.
-            }
-            RoseGraph::inv_adjacency_iterator ai, ae;
-            tie (ai, ae) = inv_adjacent_vertices(succ, g);
-            split(keys, &next_key, ai, ae);
-        } else {
-            if (!done_lit.insert(lit_id).second) {
-                continue; // lit_id already in done_lit.
-            }
-            split(keys, &next_key, verts.begin(), verts.end());
-        }
-    }
-
-    map<size_t, map<size_t, size_t>> int_to_ext;
-
-    for (const auto &key : keys) {
-        RoseVertex v = key.first;
-        u32 ext;
-        size_t rph = hashRightRoleProperties(v, g);
-        if (contains(int_to_ext[key.second], rph)) {
-            ext = int_to_ext[key.second][rph];
-        } else {
-            ext = keys_ext.size();
-            int_to_ext[key.second][rph] = ext;
-        }
-
-        keys_ext[v] = ext;
-        sibling_cache[ext].push_back(v);
-    }
-
-    for (auto &siblings : sibling_cache | map_values) {
-        sort(siblings.begin(), siblings.end(), VertexIndexComp(build.g));
-    }
-}
-
-static
-const vector<RoseVertex> &getCandidateRightSiblings(
-                         const map<size_t, vector<RoseVertex>> &sibling_cache,
-                         map<RoseVertex, size_t> &keys, RoseVertex a) {
-    size_t key = keys.at(a);
-    return sibling_cache.at(key);
-}
-
 static never_inline
 void rightMergePass(CandidateSet &candidates, RoseBuildImpl &build,
                     vector<RoseVertex> *dead, bool mergeRoses,
                     RoseAliasingInfo &rai) {
     DEBUG_PRINTF("begin\n");
+    RoseGraph &g = build.g;
 
-    map<size_t, vector<RoseVertex>> sibling_cache;
-    map<RoseVertex, size_t> keys;
-
-    buildCandidateRightSiblings(candidates, build, sibling_cache, keys);
+    // Right-equivalent vertices share literals, successors and reports, so
+    // only vertices with the same hash of these need be compared.
+    RoleBuckets buckets(g);
+    for (auto v : candidates) {
+        buckets.insert(v, hashRightMergeProperties(v, g));
+    }
 
+    vector<RoseVertex> preds;
     CandidateSet::iterator it = candidates.begin();
     while (it != candidates.end()) {
         RoseVertex a = *it;
         CandidateSet::iterator ait = it;
         ++it;
 
-        // We have to find a sibling to merge `a' with, and we select between
-        // two approaches to minimize the number of vertices we have to
-        // examine; which we use depends on the shape of the graph.
-
-        const vector<RoseVertex> &siblings
-            = getCandidateRightSiblings(sibling_cache, keys, a);
+        const vector<RoseVertex> &siblings = buckets.siblings(a);
 
         auto jt = siblings.begin();
         while (jt != siblings.end()) {
@@ -1946,9 +1952,16 @@ void rightMergePass(CandidateSet &candidates, RoseBuildImpl &build,
         }
 
         RoseVertex b = *jt;
+
+        preds.clear();
+        insert(&preds, preds.end(), inv_adjacent_vertices(a, g));
+
         mergeVerticesRight(a, b, build, rai);
         dead->push_back(a);
         candidates.erase(ait);
+
+        // a's predecessors now have b as a successor instead.
+        rehashAfterMerge(buckets, a, b, preds, g, hashRightMergeProperties);
     }
 
     DEBUG_PRINTF("%zu candidates remaining\n", candidates.size());
@@ -68,6 +68,7 @@ void buildStateScatterPlan(u32 role_state_offset, u32 role_state_count,
                            const RoseStateOffsets &stateOffsets,
                            bool streaming, u32 leaf_array_count,
                            u32 outfix_begin, u32 outfix_end,
+                           const vector<u64a> &subgroup_init,
                            scatter_plan_raw *out) {
     /* init role array */
     scatter_plan_raw spr_role;
@@ -92,6 +93,14 @@ void buildStateScatterPlan(u32 role_state_offset, u32 role_state_count,
     }
     rebase(&spr_leaf, stateOffsets.activeLeafArray);
     merge_in(out, spr_leaf);
+
+    /* subgroup masks: all subgroups on */
+    for (u32 i = 0; i < subgroup_init.size(); i++) {
+        scatter_unit_u64a su;
+        su.offset = stateOffsets.subgroups + i * sizeof(u64a);
+        su.val = subgroup_init[i];
+        out->p_u64a.push_back(su);
+    }
 }
 
 u32 aux_size(const scatter_plan_raw &raw) {
@@ -50,6 +50,7 @@ void buildStateScatterPlan(u32 role_state_offset, u32 role_state_count,
                            const RoseStateOffsets &stateOffsets,
                            bool streaming, u32 leaf_array_count,
                            u32 outfix_begin, u32 outfix_end,
+                           const std::vector<u64a> &subgroup_init,
                            scatter_plan_raw *out);
 
 u32 aux_size(const scatter_plan_raw &raw);
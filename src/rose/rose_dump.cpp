@@ -42,6 +42,7 @@
 #include "nfa/nfa_internal.h"
 #include "nfa/nfa_kind.h"
 #include "util/dump_charclass.h"
+#include "util/exhaust.h"
 #include "util/multibit_internal.h"
 #include "util/multibit.h"
 
@@ -131,17 +132,14 @@ CharReach bitvectorToReach(const u8 *reach) {
 }
 
 static
-void dumpLookaround(ofstream &os, const RoseEngine *t,
-                    const ROSE_STRUCT_CHECK_LOOKAROUND *ri) {
-    assert(ri);
-
+void dumpLookaround(ofstream &os, const RoseEngine *t, u32 index, u32 count) {
     const u8 *base = (const u8 *)t;
     const s8 *look_base = (const s8 *)(base + t->lookaroundTableOffset);
     const u8 *reach_base = base + t->lookaroundReachOffset;
 
-    const s8 *look = look_base + ri->index;
-    const s8 *look_end = look + ri->count;
-    const u8 *reach = reach_base + ri->index * REACH_BITVECTOR_LEN;
+    const s8 *look = look_base + index;
+    const s8 *look_end = look + count;
+    const u8 *reach = reach_base + index * REACH_BITVECTOR_LEN;
 
     os << "    contents:" << endl;
 
@@ -283,11 +281,30 @@ void dumpProgram(ofstream &os, const RoseEngine *t, const char *pc) {
             }
             PROGRAM_NEXT_INSTRUCTION
 
+            PROGRAM_CASE(CHECK_BOUNDS_NOT_HANDLED) {
+                os << "    min_bound " << ri->min_bound << endl;
+                os << "    max_bound " << ri->max_bound << endl;
+                os << "    key " << ri->key << endl;
+                os << "    fail_jump " << offset + ri->fail_jump << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
             PROGRAM_CASE(CHECK_LOOKAROUND) {
                 os << "    index " << ri->index << endl;
                 os << "    count " << ri->count << endl;
                 os << "    fail_jump " << offset + ri->fail_jump << endl;
-                dumpLookaround(os, t, ri);
+                dumpLookaround(os, t, ri->index, ri->count);
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_MULTIPATH_LOOKAROUND) {
+                os << "    path_count " << u32{ri->path_count} << endl;
+                os << "    fail_jump " << offset + ri->fail_jump << endl;
+                for (u32 i = 0; i < ri->path_count; i++) {
+                    os << "    path " << i << ": index " << ri->index[i]
+                       << ", count " << ri->count[i] << endl;
+                    dumpLookaround(os, t, ri->index[i], ri->count[i]);
+                }
             }
             PROGRAM_NEXT_INSTRUCTION
 
@@ -303,6 +320,52 @@ void dumpProgram(ofstream &os, const RoseEngine *t, const char *pc) {
             }
             PROGRAM_NEXT_INSTRUCTION
 
+            PROGRAM_CASE(CHECK_MASK_32) {
+                os << "    and_mask "
+                   << dumpStrMask(ri->and_mask, sizeof(ri->and_mask))
+                   << endl;
+                os << "    cmp_mask "
+                   << dumpStrMask(ri->cmp_mask, sizeof(ri->cmp_mask))
+                   << endl;
+                os << "    neg_mask 0x" << std::hex << std::setw(8)
+                   << std::setfill('0') << ri->neg_mask << std::dec << endl;
+                os << "    offset " << ri->offset << endl;
+                os << "    fail_jump " << offset + ri->fail_jump << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_MASK_64) {
+                os << "    and_mask "
+                   << dumpStrMask(ri->and_mask, sizeof(ri->and_mask))
+                   << endl;
+                os << "    cmp_mask "
+                   << dumpStrMask(ri->cmp_mask, sizeof(ri->cmp_mask))
+                   << endl;
+                os << "    neg_mask 0x" << std::hex << std::setw(16)
+                   << std::setfill('0') << ri->neg_mask << std::dec << endl;
+                os << "    offset " << ri->offset << endl;
+                os << "    fail_jump " << offset + ri->fail_jump << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_SHUFTI_32x8) {
+                os << "    hi_mask "
+                   << dumpStrMask(ri->hi_mask, sizeof(ri->hi_mask))
+                   << endl;
+                os << "    lo_mask "
+                   << dumpStrMask(ri->lo_mask, sizeof(ri->lo_mask))
+                   << endl;
+                os << "    bucket_select_mask "
+                   << dumpStrMask(ri->bucket_select_mask,
+                                  sizeof(ri->bucket_select_mask))
+                   << endl;
+                os << "    neg_mask 0x" << std::hex << std::setw(8)
+                   << std::setfill('0') << ri->neg_mask << std::dec << endl;
+                os << "    offset " << ri->offset << endl;
+                os << "    fail_jump " << offset + ri->fail_jump << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
             PROGRAM_CASE(CHECK_BYTE) {
                 os << "    and_mask 0x" << std::hex << std::setw(2)
                    << std::setfill('0') << u32{ri->and_mask} << std::dec
@@ -455,6 +518,23 @@ void dumpProgram(ofstream &os, const RoseEngine *t, const char *pc) {
             }
             PROGRAM_NEXT_INSTRUCTION
 
+            PROGRAM_CASE(REPORT_MULTI) {
+                os << "    count " << ri->count << endl;
+                os << "    list_offset " << ri->list_offset << endl;
+                const auto *entries = (const rose_report_entry *)
+                    loadFromByteCodeOffset(t, ri->list_offset);
+                for (u32 i = 0; i < ri->count; i++) {
+                    os << "    report " << i << ": onmatch "
+                       << entries[i].onmatch << ", offset_adjust "
+                       << entries[i].offset_adjust;
+                    if (entries[i].ekey != INVALID_EKEY) {
+                        os << ", ekey " << entries[i].ekey;
+                    }
+                    os << endl;
+                }
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
             PROGRAM_CASE(CHECK_EXHAUSTED) {
                 os << "    ekey " << ri->ekey << endl;
                 os << "    fail_jump " << offset + ri->fail_jump << endl;
@@ -518,6 +598,52 @@ void dumpProgram(ofstream &os, const RoseEngine *t, const char *pc) {
             PROGRAM_CASE(MATCHER_EOD) {}
             PROGRAM_NEXT_INSTRUCTION
 
+            PROGRAM_CASE(FLUSH_COMBINATION) {
+                os << "    offset_adjust " << ri->offset_adjust << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(SET_LOGICAL) {
+                os << "    lkey " << ri->lkey << endl;
+                os << "    offset_adjust " << ri->offset_adjust << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(SET_COMBINATION) {
+                os << "    ckey " << ri->ckey << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(COUNT_MATCH) {
+                os << "    key " << ri->key << endl;
+                os << "    limit " << ri->limit << endl;
+                os << "    ekey " << ri->ekey << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_CONFIRM) {
+                os << "    key " << ri->key << endl;
+                os << "    offset_adjust " << ri->offset_adjust << endl;
+                os << "    fail_jump " << offset + ri->fail_jump << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(CHECK_SUBGROUP) {
+                os << "    index " << ri->index << endl;
+                os << "    subgroup 0x" << std::hex << ri->subgroup << std::dec
+                   << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
+            PROGRAM_CASE(SQUASH_SUBGROUP) {
+                os << "    index " << ri->index << endl;
+                os << "    subgroup 0x" << std::hex << ri->subgroup << std::dec
+                   << endl;
+                os << "    groups 0x" << std::hex << ri->groups << std::dec
+                   << endl;
+            }
+            PROGRAM_NEXT_INSTRUCTION
+
             PROGRAM_CASE(END) { return; }
             PROGRAM_NEXT_INSTRUCTION
 
@@ -976,12 +1102,24 @@ void roseDumpText(const RoseEngine *t, FILE *f) {
     if (t->canExhaust) {
         fprintf(f, " canExhaust");
     }
+    if (t->anyMatch) {
+        fprintf(f, " anyMatch");
+    }
+    if (t->unorderedMatches) {
+        fprintf(f, " unorderedMatches");
+    }
     if (t->hasSom) {
         fprintf(f, " hasSom");
     }
     fprintf(f, "\n");
 
     fprintf(f, "dkey count           : %u\n", t->dkeyCount);
+    fprintf(f, "lkey count           : %u\n", t->lkeyCount);
+    fprintf(f, "ckey count           : %u\n", t->ckeyCount);
+    fprintf(f, "match limit count    : %u\n", t->matchLimitCount);
+    fprintf(f, "user data entries    : %u (%s)\n", t->userDataCount,
+            t->userDataDense ? "dense" : "sorted");
+    fprintf(f, "subgroup count       : %u\n", t->subgroupCount);
     fprintf(f, "som slot count       : %u\n", t->somLocationCount);
     fprintf(f, "som width            : %u bytes\n", t->somHorizon);
     fprintf(f, "rose count           : %u\n", t->roseCount);
@@ -1009,14 +1147,22 @@ void roseDumpText(const RoseEngine *t, FILE *f) {
             t->rolesWithStateCount * sizeof(u32));
     fprintf(f, " - nfa info table    : %zu bytes\n",
             t->queueCount * sizeof(NfaInfo));
+    fprintf(f, " - rose programs     : %u bytes\n", t->programSize);
     fprintf(f, " - lookaround table  : %u bytes\n",
             t->nfaInfoOffset - t->lookaroundTableOffset);
     fprintf(f, " - lookaround reach  : %u bytes\n",
             t->lookaroundTableOffset - t->lookaroundReachOffset);
 
     fprintf(f, "state space required : %u bytes\n", t->stateOffsets.end);
+    fprintf(f, " - hot state         : %u bytes\n", t->stateOffsets.hotEnd);
     fprintf(f, " - history buffer    : %u bytes\n", t->historyRequired);
+    fprintf(f, " - idle history      : %u bytes\n", t->idleHistoryRequired);
     fprintf(f, " - exhaustion vector : %u bytes\n", (t->ekeyCount + 7) / 8);
+    fprintf(f, " - logical vector    : %u bytes\n", mmbit_size(t->lkeyCount));
+    fprintf(f, " - comb vectors      : %u bytes\n",
+            2 * mmbit_size(t->ckeyCount));
+    fprintf(f, " - match counters    : %zu bytes\n",
+            t->matchLimitCount * sizeof(u32));
     fprintf(f, " - role state mmbit  : %u bytes\n", t->stateSize);
     fprintf(f, " - floating matcher  : %u bytes\n", t->floatingStreamState);
     fprintf(f, " - active array      : %u bytes\n",
@@ -1030,6 +1176,8 @@ void roseDumpText(const RoseEngine *t, FILE *f) {
             t->stateOffsets.anchorState - t->stateOffsets.leftfixLagTable);
     fprintf(f, " - groups            : %u bytes\n",
             t->stateOffsets.groups_size);
+    fprintf(f, " - subgroups         : %zu bytes\n",
+            t->subgroupCount * sizeof(u64a));
     fprintf(f, "\n");
 
     fprintf(f, "initial groups       : 0x%016llx\n", t->initialGroups);
@@ -1047,6 +1195,13 @@ void roseDumpText(const RoseEngine *t, FILE *f) {
             t->minWidthExcludingBoundaries);
     fprintf(f, "  maxBiAnchoredWidth          : %s\n",
             rose_off(t->maxBiAnchoredWidth).str().c_str());
+    fprintf(f, "  maxMatchWidth               : %s\n",
+            rose_off(t->maxMatchWidth).str().c_str());
+    if (t->maxMatchOffset == MAX_OFFSET) {
+        fprintf(f, "  maxMatchOffset              : inf\n");
+    } else {
+        fprintf(f, "  maxMatchOffset              : %llu\n", t->maxMatchOffset);
+    }
     fprintf(f, "  minFloatLitMatchOffset      : %s\n",
             rose_off(t->floatingMinLiteralMatchOffset).str().c_str());
     fprintf(f, "  delay_base_id               : %u\n", t->delay_base_id);
@@ -1085,6 +1240,7 @@ void roseDumpStructRaw(const RoseEngine *t, FILE *f) {
     fprintf(f, "struct RoseEngine {\n");
     DUMP_U8(t, noFloatingRoots);
     DUMP_U8(t, requiresEodCheck);
+    DUMP_U8(t, eodNeedsLiveState);
     DUMP_U8(t, hasOutfixesInSmallBlock);
     DUMP_U8(t, runtimeImpl);
     DUMP_U8(t, mpvTriggeredByLeaf);
@@ -1092,17 +1248,37 @@ void roseDumpStructRaw(const RoseEngine *t, FILE *f) {
     DUMP_U8(t, hasSom);
     DUMP_U8(t, somHorizon);
     DUMP_U8(t, needsCatchup);
+    DUMP_U8(t, anyMatch);
+    DUMP_U8(t, unorderedMatches);
     DUMP_U32(t, mode);
     DUMP_U32(t, historyRequired);
+    DUMP_U32(t, idleHistoryRequired);
     DUMP_U32(t, ekeyCount);
     DUMP_U32(t, dkeyCount);
     DUMP_U32(t, invDkeyOffset);
+    DUMP_U32(t, lkeyCount);
+    DUMP_U32(t, lopCount);
+    DUMP_U32(t, ckeyCount);
+    DUMP_U32(t, matchLimitCount);
+    DUMP_U32(t, subgroupCount);
+    DUMP_U32(t, logicalTreeOffset);
+    DUMP_U32(t, combInfoMapOffset);
+    DUMP_U32(t, confirmCount);
+    DUMP_U32(t, confirmOffset);
+    DUMP_U32(t, userDataCount);
+    DUMP_U32(t, userDataOffset);
+    DUMP_U32(t, userDataDense);
+    DUMP_U32(t, groupReportsOffset);
+    DUMP_U32(t, groupEkeysOffset);
+    DUMP_U32(t, ekeyGroupsOffset);
+    DUMP_U32(t, profileOwnersOffset);
     DUMP_U32(t, somLocationCount);
     DUMP_U32(t, rolesWithStateCount);
     DUMP_U32(t, stateSize);
     DUMP_U32(t, anchorStateSize);
     DUMP_U32(t, nfaStateSize);
     DUMP_U32(t, tStateSize);
+    DUMP_U32(t, limexCacheSize);
     DUMP_U32(t, smallWriteOffset);
     DUMP_U32(t, amatcherOffset);
     DUMP_U32(t, ematcherOffset);
@@ -1128,10 +1304,13 @@ void roseDumpStructRaw(const RoseEngine *t, FILE *f) {
     DUMP_U32(t, lookaroundTableOffset);
     DUMP_U32(t, lookaroundReachOffset);
     DUMP_U32(t, eodProgramOffset);
+    DUMP_U32(t, programSize);
     DUMP_U32(t, lastByteHistoryIterOffset);
     DUMP_U32(t, minWidth);
     DUMP_U32(t, minWidthExcludingBoundaries);
     DUMP_U32(t, maxBiAnchoredWidth);
+    DUMP_U32(t, maxMatchWidth);
+    DUMP_U64(t, maxMatchOffset);
     DUMP_U32(t, anchoredDistance);
     DUMP_U32(t, anchoredMinDistance);
     DUMP_U32(t, floatingDistance);
@@ -1141,6 +1320,7 @@ void roseDumpStructRaw(const RoseEngine *t, FILE *f) {
     DUMP_U32(t, nfaInfoOffset);
     DUMP_U64(t, initialGroups);
     DUMP_U64(t, floating_group_mask);
+    DUMP_U64(t, patternMaskGroups);
     DUMP_U32(t, size);
     DUMP_U32(t, delay_count);
     DUMP_U32(t, delay_base_id);
@@ -1150,6 +1330,10 @@ void roseDumpStructRaw(const RoseEngine *t, FILE *f) {
     DUMP_U32(t, delayRebuildLength);
     DUMP_U32(t, stateOffsets.history);
     DUMP_U32(t, stateOffsets.exhausted);
+    DUMP_U32(t, stateOffsets.logicalVec);
+    DUMP_U32(t, stateOffsets.combVec);
+    DUMP_U32(t, stateOffsets.activeCombVec);
+    DUMP_U32(t, stateOffsets.matchCounts);
     DUMP_U32(t, stateOffsets.activeLeafArray);
     DUMP_U32(t, stateOffsets.activeLeftArray);
     DUMP_U32(t, stateOffsets.activeLeftArray_size);
@@ -1157,10 +1341,12 @@ void roseDumpStructRaw(const RoseEngine *t, FILE *f) {
     DUMP_U32(t, stateOffsets.anchorState);
     DUMP_U32(t, stateOffsets.groups);
     DUMP_U32(t, stateOffsets.groups_size);
+    DUMP_U32(t, stateOffsets.subgroups);
     DUMP_U32(t, stateOffsets.floatingMatcherState);
     DUMP_U32(t, stateOffsets.somLocation);
     DUMP_U32(t, stateOffsets.somValid);
     DUMP_U32(t, stateOffsets.somWritable);
+    DUMP_U32(t, stateOffsets.hotEnd);
     DUMP_U32(t, stateOffsets.end);
     DUMP_U32(t, boundary.reportEodOffset);
     DUMP_U32(t, boundary.reportZeroOffset);
@@ -195,6 +195,31 @@ struct RoseStateOffsets {
      * reports with that ekey should not be delivered to the user. */
     u32 exhausted;
 
+    /** Logical multibit.
+     *
+     * 1 bit per logical key: set for sub-patterns of logical combinations
+     * that have matched, and used to hold the results of logical operations
+     * during evaluation. */
+    u32 logicalVec;
+
+    /** Combination multibit.
+     *
+     * 1 bit per logical combination. If a bit is set, the combination has
+     * already been reported and should not be delivered again. */
+    u32 combVec;
+
+    /** Active combination multibit.
+     *
+     * 1 bit per logical combination, set for combinations that need to be
+     * evaluated at the next flush. */
+    u32 activeCombVec;
+
+    /** Match counters.
+     *
+     * One (unaligned) u32 per report with a match limit, counting the matches
+     * delivered so far. */
+    u32 matchCounts;
+
     /** Multibit for active suffix/outfix engines. */
     u32 activeLeafArray;
 
@@ -217,6 +242,10 @@ struct RoseStateOffsets {
     /** Size of packed Rose groups value, in bytes. */
     u32 groups_size;
 
+    /** Subgroup masks: one (unaligned) u64a per group with subgroup
+     * squashers, see RoseEngine::subgroupCount. */
+    u32 subgroups;
+
     /** State for floating literal matcher (managed by HWLM). */
     u32 floatingMatcherState;
 
@@ -229,6 +258,14 @@ struct RoseStateOffsets {
     /** Multibit guarding SOM location slots. */
     u32 somWritable;
 
+    /** End of the hot part of the stream state, in bytes.
+     *
+     * The state written by most stream writes (the Rose state up to and
+     * including the history, then the MPV, outfix and leftfix engine state)
+     * lies before this offset. Suffix engine state, the exhaustion and
+     * logical combination multibits, match counters and SOM state follow. */
+    u32 hotEnd;
+
     /** Total size of Rose state, in bytes. */
     u32 end;
 };
@@ -295,6 +332,9 @@ struct RoseEngine {
     u8  noFloatingRoots; /* only need to run the anchored table if something
                           * matched in the anchored table */
     u8  requiresEodCheck; /* stuff happens at eod time */
+    u8  eodNeedsLiveState; /**< streaming EOD work can only produce matches
+                            * from role state or triggered suffixes, so it
+                            * can be skipped unless STATUS_EOD_LIVE is set */
     u8  hasOutfixesInSmallBlock; /**< has at least one outfix that must run even
                                     in small block scans. */
     u8  runtimeImpl; /**< can we just run the floating table or a single outfix?
@@ -305,12 +345,39 @@ struct RoseEngine {
     u8  somHorizon; /**< width in bytes of SOM offset storage (governed by
                         SOM precision) */
     u8 needsCatchup; /** catch up needs to be run on every report. */
+    u8 anyMatch; /**< HS_MODE_ANY_MATCH: stop after the first report. */
+    u8 unorderedMatches; /**< suffixes and outfixes deliver their matches
+                          * directly rather than through catch up. */
     u32 mode; /**< scanning mode, one of HS_MODE_{BLOCK,STREAM,VECTORED} */
+    u32 altModeOffset; /**< offset from this engine to the engine for another
+                        * scanning mode in the same database, or 0 */
     u32 historyRequired; /**< max amount of history required for streaming */
+    u32 idleHistoryRequired; /**< history required for streaming when no
+                              * non-transient leftfix is alive and no delayed
+                              * literals are waiting to be rebuilt */
     u32 ekeyCount; /**< number of exhaustion keys */
     u32 dkeyCount; /**< number of dedupe keys */
     u32 invDkeyOffset; /**< offset to table mapping from dkeys to the external
                          *  report ids */
+    u32 lkeyCount; /**< number of logical keys */
+    u32 lopCount; /**< number of logical operations */
+    u32 ckeyCount; /**< number of logical combinations */
+    u32 matchLimitCount; /**< number of reports with a match limit */
+    u32 subgroupCount; /**< number of groups with a subgroup mask */
+    u32 logicalTreeOffset; /**< offset to array of struct LogicalOp */
+    u32 combInfoMapOffset; /**< offset to array of struct CombInfo, indexed by
+                             *  combination key */
+    u32 confirmCount; /**< number of confirm programs (HS_FLAG_CONFIRM) */
+    u32 confirmOffset; /**< offset to table of confirm programs: an array of
+                         *  u32 offsets (relative to the table), indexed by
+                         *  key, followed by the programs */
+    u32 userDataCount; /**< number of entries in the user data table */
+    u32 userDataOffset; /**< offset to the user data table, or 0 if no
+                          *  expression has user data: see
+                          *  roseMatchUserData() */
+    u32 userDataDense; /**< the user data table is an array of u64a indexed by
+                         *  ID, rather than sorted u32 IDs followed by their
+                         *  u64a values */
     u32 somLocationCount; /**< number of som locations required */
     u32 rolesWithStateCount; // number of roles with entries in state bitset
     u32 stateSize; /* size of the state bitset
@@ -320,6 +387,8 @@ struct RoseEngine {
     u32 tStateSize; /* total size of the state for transient rose nfas */
     u32 scratchStateSize; /**< uncompressed state req'd for NFAs in scratch;
                            * used for sizing scratch only. */
+    u32 limexCacheSize; /**< size of the LimEx lazy DFA cache req'd in
+                         * scratch, zero if no engine uses it. */
     u32 smallWriteOffset; /**< offset of small-write matcher */
     u32 amatcherOffset; // offset of the anchored literal matcher (bytes)
     u32 ematcherOffset; // offset of the eod-anchored literal matcher (bytes)
@@ -384,6 +453,7 @@ struct RoseEngine {
                                 * bytes each) */
 
     u32 eodProgramOffset; //!< EOD program, otherwise 0.
+    u32 programSize; //!< total size of all Rose programs (bytes)
 
     u32 lastByteHistoryIterOffset; // if non-zero
 
@@ -396,6 +466,16 @@ struct RoseEngine {
 
     u32 maxBiAnchoredWidth; /* ROSE_BOUND_INF if any non bianchored patterns
                              * present */
+
+    /** \brief Maximum number of bytes in any match, or ROSE_BOUND_INF if
+     * matches are unbounded or depend on absolute offsets. Used to split a
+     * block scan into overlapping pieces, see \ref hs_scan_parallel. */
+    u32 maxMatchWidth;
+
+    /** \brief Largest end offset of any match, or MAX_OFFSET if some pattern
+     * can match arbitrarily far into the data. A stream that has passed it
+     * can never match again, see hs_scan_stream(). */
+    u64a maxMatchOffset;
     u32 anchoredDistance; // region to run the anchored table over
     u32 anchoredMinDistance; /* start of region to run anchored table over */
     u32 floatingDistance; /* end of region to run the floating table over
@@ -409,6 +489,33 @@ struct RoseEngine {
     u32 nfaInfoOffset; /* offset to the nfa info offset array */
     rose_group initialGroups;
     rose_group floating_group_mask; /* groups that are used by the ftable */
+
+    /** \brief Groups that stay on under any pattern mask, as they can lead to
+     * internal reports or logical combination sub-patterns. */
+    rose_group patternMaskGroups;
+
+    /** \brief Offset of the table of external report ids downstream of each
+     * group: ROSE_GROUPS_MAX + 1 u32 indices into the sorted u32 id list that
+     * follows. Used to build pattern masks, see \ref hs_pattern_mask. */
+    u32 groupReportsOffset;
+
+    /** \brief Offset of the table of exhaustion keys that each literal group
+     * depends on, in the same layout as the group reports table; zero if no
+     * group can be exhausted. */
+    u32 groupEkeysOffset;
+
+    /** \brief Offset of an array of ekeyCount rose_group masks, giving the
+     * exhaustible groups that depend on each exhaustion key; zero if no group
+     * can be exhausted. See roseSquashExhaustedGroups(). */
+    u32 ekeyGroupsOffset;
+
+    /** \brief Offset of the table of external report ids served by each cost
+     * owner, for ROSE_PROFILE builds and HS_MODE_COST_ATTRIBUTION databases;
+     * zero otherwise. The owners are the literal programs followed by the
+     * engine queues: literalCount + queueCount + 1 u32 indices into the u32
+     * id list that follows. Used by hs_profile_report() and
+     * hs_sample_report(). */
+    u32 profileOwnersOffset;
     u32 size; // (bytes)
     u32 delay_count; /* number of delayed literal ids. */
     u32 delay_base_id; /* literal id of the first delayed literal.
@@ -445,6 +552,63 @@ struct ALIGN_CL_DIRECTIVE anchored_matcher_info {
     u32 anchoredMinDistance; /* start of region to run anchored table over */
 };
 
+/**
+ * \brief Returns the engine for another scanning mode held in the same
+ * database as \a t, or NULL if there is none.
+ */
+static really_inline
+const struct RoseEngine *roseAltModeEngine(const struct RoseEngine *t) {
+    if (!t->altModeOffset) {
+        return NULL;
+    }
+    return (const struct RoseEngine *)((const char *)t + t->altModeOffset);
+}
+
+/**
+ * \brief Returns the engine for scanning mode \a mode from a database's
+ * bytecode \a t, or \a t itself if the database has no engine for that mode
+ * (so that the caller's mode check fails).
+ */
+static really_inline
+const struct RoseEngine *roseEngineForMode(const struct RoseEngine *t,
+                                           u32 mode) {
+    const struct RoseEngine *alt = roseAltModeEngine(t);
+    if (t->mode != mode && alt && alt->mode == mode) {
+        return alt;
+    }
+    return t;
+}
+
+/** \brief Returns the user data attached to matches for external report
+ * \a id, or zero if it has none. */
+static really_inline
+u64a roseMatchUserData(const struct RoseEngine *t, u32 id) {
+    if (!t->userDataOffset) {
+        return 0;
+    }
+
+    const char *table = (const char *)t + t->userDataOffset;
+    if (t->userDataDense) {
+        return id < t->userDataCount ? ((const u64a *)table)[id] : 0;
+    }
+
+    const u32 *ids = (const u32 *)table;
+    const u64a *values =
+        (const u64a *)(table + ROUNDUP_N(t->userDataCount * sizeof(u32),
+                                         sizeof(u64a)));
+    u32 lo = 0;
+    u32 hi = t->userDataCount;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (ids[mid] < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < t->userDataCount && ids[lo] == id ? values[lo] : 0;
+}
+
 static really_inline
 const struct anchored_matcher_info *getALiteralMatcher(
         const struct RoseEngine *t) {
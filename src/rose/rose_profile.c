@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Rose runtime: access to the interpreter profiling counters.
+ */
+
+#include "rose_profile.h"
+#include "rose_internal.h"
+#include "runtime.h"
+#include "allocator.h"
+#include "database.h"
+#include "hs_internal.h"
+#include "hs_runtime.h"
+#include "scratch.h"
+#include "ue2common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ROSE_PROFILE)
+
+#if defined(_WIN32)
+#define SNPRINTF_COMPAT _snprintf
+#else
+#define SNPRINTF_COMPAT snprintf
+#endif
+
+/** \brief Longest line we will ever print into the profile info string. */
+#define PROFILE_LINE_MAX 96
+
+static const char *const instr_names[ROSE_INSTR_END + 1] = {
+    [ROSE_INSTR_ANCHORED_DELAY] = "ANCHORED_DELAY",
+    [ROSE_INSTR_CHECK_LIT_MASK] = "CHECK_LIT_MASK",
+    [ROSE_INSTR_CHECK_LIT_EARLY] = "CHECK_LIT_EARLY",
+    [ROSE_INSTR_CHECK_GROUPS] = "CHECK_GROUPS",
+    [ROSE_INSTR_CHECK_ONLY_EOD] = "CHECK_ONLY_EOD",
+    [ROSE_INSTR_CHECK_BOUNDS] = "CHECK_BOUNDS",
+    [ROSE_INSTR_CHECK_NOT_HANDLED] = "CHECK_NOT_HANDLED",
+    [ROSE_INSTR_CHECK_BOUNDS_NOT_HANDLED] = "CHECK_BOUNDS_NOT_HANDLED",
+    [ROSE_INSTR_CHECK_LOOKAROUND] = "CHECK_LOOKAROUND",
+    [ROSE_INSTR_CHECK_MULTIPATH_LOOKAROUND] = "CHECK_MULTIPATH_LOOKAROUND",
+    [ROSE_INSTR_CHECK_MASK] = "CHECK_MASK",
+    [ROSE_INSTR_CHECK_MASK_32] = "CHECK_MASK_32",
+    [ROSE_INSTR_CHECK_MASK_64] = "CHECK_MASK_64",
+    [ROSE_INSTR_CHECK_SHUFTI_32x8] = "CHECK_SHUFTI_32x8",
+    [ROSE_INSTR_CHECK_BYTE] = "CHECK_BYTE",
+    [ROSE_INSTR_CHECK_INFIX] = "CHECK_INFIX",
+    [ROSE_INSTR_CHECK_PREFIX] = "CHECK_PREFIX",
+    [ROSE_INSTR_PUSH_DELAYED] = "PUSH_DELAYED",
+    [ROSE_INSTR_RECORD_ANCHORED] = "RECORD_ANCHORED",
+    [ROSE_INSTR_CATCH_UP] = "CATCH_UP",
+    [ROSE_INSTR_CATCH_UP_MPV] = "CATCH_UP_MPV",
+    [ROSE_INSTR_SOM_ADJUST] = "SOM_ADJUST",
+    [ROSE_INSTR_SOM_LEFTFIX] = "SOM_LEFTFIX",
+    [ROSE_INSTR_SOM_FROM_REPORT] = "SOM_FROM_REPORT",
+    [ROSE_INSTR_SOM_ZERO] = "SOM_ZERO",
+    [ROSE_INSTR_TRIGGER_INFIX] = "TRIGGER_INFIX",
+    [ROSE_INSTR_TRIGGER_SUFFIX] = "TRIGGER_SUFFIX",
+    [ROSE_INSTR_DEDUPE] = "DEDUPE",
+    [ROSE_INSTR_DEDUPE_SOM] = "DEDUPE_SOM",
+    [ROSE_INSTR_REPORT_CHAIN] = "REPORT_CHAIN",
+    [ROSE_INSTR_REPORT_SOM_INT] = "REPORT_SOM_INT",
+    [ROSE_INSTR_REPORT_SOM_AWARE] = "REPORT_SOM_AWARE",
+    [ROSE_INSTR_REPORT] = "REPORT",
+    [ROSE_INSTR_REPORT_EXHAUST] = "REPORT_EXHAUST",
+    [ROSE_INSTR_REPORT_SOM] = "REPORT_SOM",
+    [ROSE_INSTR_REPORT_SOM_EXHAUST] = "REPORT_SOM_EXHAUST",
+    [ROSE_INSTR_DEDUPE_AND_REPORT] = "DEDUPE_AND_REPORT",
+    [ROSE_INSTR_FINAL_REPORT] = "FINAL_REPORT",
+    [ROSE_INSTR_REPORT_MULTI] = "REPORT_MULTI",
+    [ROSE_INSTR_CHECK_EXHAUSTED] = "CHECK_EXHAUSTED",
+    [ROSE_INSTR_CHECK_MIN_LENGTH] = "CHECK_MIN_LENGTH",
+    [ROSE_INSTR_SET_STATE] = "SET_STATE",
+    [ROSE_INSTR_SET_GROUPS] = "SET_GROUPS",
+    [ROSE_INSTR_SQUASH_GROUPS] = "SQUASH_GROUPS",
+    [ROSE_INSTR_CHECK_STATE] = "CHECK_STATE",
+    [ROSE_INSTR_SPARSE_ITER_BEGIN] = "SPARSE_ITER_BEGIN",
+    [ROSE_INSTR_SPARSE_ITER_NEXT] = "SPARSE_ITER_NEXT",
+    [ROSE_INSTR_ENGINES_EOD] = "ENGINES_EOD",
+    [ROSE_INSTR_SUFFIXES_EOD] = "SUFFIXES_EOD",
+    [ROSE_INSTR_MATCHER_EOD] = "MATCHER_EOD",
+    [ROSE_INSTR_FLUSH_COMBINATION] = "FLUSH_COMBINATION",
+    [ROSE_INSTR_SET_LOGICAL] = "SET_LOGICAL",
+    [ROSE_INSTR_SET_COMBINATION] = "SET_COMBINATION",
+    [ROSE_INSTR_COUNT_MATCH] = "COUNT_MATCH",
+    [ROSE_INSTR_CHECK_CONFIRM] = "CHECK_CONFIRM",
+    [ROSE_INSTR_CHECK_SUBGROUP] = "CHECK_SUBGROUP",
+    [ROSE_INSTR_SQUASH_SUBGROUP] = "SQUASH_SUBGROUP",
+    [ROSE_INSTR_END] = "END",
+};
+
+static
+int litIsActive(const struct RoseLiteralProfile *lp) {
+    return lp->executions || lp->lookaround_fail || lp->lit_mask_fail;
+}
+
+static
+int engineIsActive(const struct RoseEngineProfile *ep) {
+    return ep->executions || ep->cycles;
+}
+
+/** \brief Append one formatted line to the buffer, which the caller has sized
+ * to have at least PROFILE_LINE_MAX bytes free. */
+#define PRINT_LINE(...)                                                        \
+    do {                                                                       \
+        int p_len = SNPRINTF_COMPAT(out, PROFILE_LINE_MAX, __VA_ARGS__);       \
+        assert(p_len >= 0 && p_len < PROFILE_LINE_MAX);                        \
+        out += p_len;                                                          \
+    } while (0)
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_profile_info(const hs_scratch_t *scratch, char **info) {
+    if (!info || !scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+
+    const struct RoseProfile *p = scratch->profile;
+
+    u32 active_lits = 0;
+    for (u32 i = 0; i < p->literal_count; i++) {
+        active_lits += litIsActive(&p->lit[i]) ? 1 : 0;
+    }
+    u32 active_engines = 0;
+    for (u32 i = 0; i < p->engine_count; i++) {
+        active_engines += engineIsActive(&p->engine[i]) ? 1 : 0;
+    }
+
+    // Four header lines, one per instruction, one per active literal and one
+    // per active engine.
+    size_t len = (size_t)(ROSE_INSTR_END + 1 + 4 + active_lits
+                          + active_engines) * PROFILE_LINE_MAX + 1;
+    char *buf = hs_misc_alloc(len);
+    hs_error_t ret = hs_check_alloc(buf);
+    if (ret != HS_SUCCESS) {
+        hs_misc_free(buf);
+        return ret;
+    }
+
+    char *out = buf;
+    *out = '\0';
+
+    PRINT_LINE("instructions:\n");
+    for (u32 i = 0; i <= ROSE_INSTR_END; i++) {
+        if (!p->instr_count[i]) {
+            continue;
+        }
+        assert(instr_names[i]);
+        PRINT_LINE("  %-20s %llu\n", instr_names[i], p->instr_count[i]);
+    }
+
+    PRINT_LINE("lookaround failures: %llu, lit mask rejections: %llu\n",
+               p->lookaround_fail, p->lit_mask_fail);
+
+    PRINT_LINE("literals (id: executions, lookaround fails, lit mask "
+               "rejections, cycles):\n");
+    for (u32 i = 0; i < p->literal_count; i++) {
+        const struct RoseLiteralProfile *lp = &p->lit[i];
+        if (!litIsActive(lp)) {
+            continue;
+        }
+        PRINT_LINE("  %u: %llu, %llu, %llu, %llu\n", i, lp->executions,
+                   lp->lookaround_fail, lp->lit_mask_fail, lp->cycles);
+    }
+
+    PRINT_LINE("engines (queue: executions, cycles):\n");
+    for (u32 i = 0; i < p->engine_count; i++) {
+        const struct RoseEngineProfile *ep = &p->engine[i];
+        if (!engineIsActive(ep)) {
+            continue;
+        }
+        PRINT_LINE("  %u: %llu, %llu\n", i, ep->executions, ep->cycles);
+    }
+
+    assert(out < buf + len);
+    *info = buf;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_profile_reset(hs_scratch_t *scratch) {
+    if (!scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    if (markScratchInUse(scratch)) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    struct RoseProfile *p = scratch->profile;
+    memset(p->instr_count, 0, sizeof(p->instr_count));
+    p->lookaround_fail = 0;
+    p->lit_mask_fail = 0;
+    p->curr_lit = ROSE_PROFILE_NO_LITERAL;
+    p->curr_owner = ROSE_PROFILE_NO_LITERAL;
+    memset(p->lit, 0, sizeof(struct RoseLiteralProfile) * p->literal_count);
+    memset(p->engine, 0, sizeof(struct RoseEngineProfile) * p->engine_count);
+
+    unmarkScratchInUse(scratch);
+    return HS_SUCCESS;
+}
+
+/** \brief Cycles charged to a single pattern ID. */
+struct pattern_cost {
+    u32 id;
+    u64a cycles;
+};
+
+static
+int cmp_cost_id(const void *a, const void *b) {
+    const struct pattern_cost *x = a;
+    const struct pattern_cost *y = b;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static
+int cmp_cost_desc(const void *a, const void *b) {
+    const struct pattern_cost *x = a;
+    const struct pattern_cost *y = b;
+    if (x->cycles != y->cycles) {
+        return x->cycles > y->cycles ? -1 : 1;
+    }
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/** \brief Returns the cycles charged to owner \a i of the given engine, where
+ * owners are the engine's literals followed by its queues. */
+static
+u64a ownerCycles(const struct RoseProfile *p, const struct RoseEngine *t,
+                 u32 i) {
+    if (i < t->literalCount) {
+        return i < p->literal_count ? p->lit[i].cycles : 0;
+    }
+    u32 qi = i - t->literalCount;
+    return qi < p->engine_count ? p->engine[qi].cycles : 0;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_profile_report(const hs_database_t *db,
+                             const hs_scratch_t *scratch,
+                             unsigned int max_patterns, char **info) {
+    if (!info || !scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    hs_error_t err = validDatabase(db);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    // For a multi-mode database, use the engine the scratch last scanned.
+    const struct RoseEngine *t = hs_get_bytecode(db);
+    const struct RoseEngine *alt = roseAltModeEngine(t);
+    if (alt && scratch->core_info.rose == alt) {
+        t = alt;
+    }
+    if (!t->profileOwnersOffset) {
+        return HS_INVALID;
+    }
+
+    const struct RoseProfile *p = scratch->profile;
+    const u32 owner_count = t->literalCount + t->queueCount;
+    const u32 *owner_idx = getByOffset(t, t->profileOwnersOffset);
+    const u32 *owner_ids = owner_idx + owner_count + 1;
+    const u32 entries = owner_idx[owner_count];
+
+    struct pattern_cost *costs =
+        hs_misc_alloc(sizeof(struct pattern_cost) * (entries + 1));
+    err = hs_check_alloc(costs);
+    if (err != HS_SUCCESS) {
+        hs_misc_free(costs);
+        return err;
+    }
+
+    // Split each owner's cycles evenly between the patterns it serves.
+    u64a attributed = 0;
+    u64a unattributed = 0;
+    u32 n = 0;
+    for (u32 i = 0; i < owner_count; i++) {
+        u64a cycles = ownerCycles(p, t, i);
+        u32 id_count = owner_idx[i + 1] - owner_idx[i];
+        if (!cycles) {
+            continue;
+        }
+        if (!id_count) {
+            unattributed += cycles;
+            continue;
+        }
+        attributed += cycles;
+        for (u32 j = owner_idx[i]; j < owner_idx[i + 1]; j++) {
+            costs[n].id = owner_ids[j];
+            costs[n].cycles = cycles / id_count;
+            n++;
+        }
+    }
+
+    // Merge the charges for each pattern, then sort by cost.
+    qsort(costs, n, sizeof(struct pattern_cost), cmp_cost_id);
+    u32 patterns = 0;
+    for (u32 i = 0; i < n; i++) {
+        if (patterns && costs[patterns - 1].id == costs[i].id) {
+            costs[patterns - 1].cycles += costs[i].cycles;
+        } else {
+            costs[patterns++] = costs[i];
+        }
+    }
+    qsort(costs, patterns, sizeof(struct pattern_cost), cmp_cost_desc);
+    if (max_patterns && patterns > max_patterns) {
+        patterns = max_patterns;
+    }
+
+    // Two header lines and one per pattern.
+    size_t len = (size_t)(patterns + 2) * PROFILE_LINE_MAX + 1;
+    char *buf = hs_misc_alloc(len);
+    err = hs_check_alloc(buf);
+    if (err != HS_SUCCESS) {
+        hs_misc_free(costs);
+        hs_misc_free(buf);
+        return err;
+    }
+
+    char *out = buf;
+    *out = '\0';
+
+    PRINT_LINE("cycles attributed to patterns: %llu, unattributed: %llu\n",
+               attributed, unattributed);
+    PRINT_LINE("patterns (id: cycles, percentage):\n");
+    for (u32 i = 0; i < patterns; i++) {
+        double pct = attributed ? 100.0 * costs[i].cycles / attributed : 0;
+        PRINT_LINE("  %u: %llu, %.2f%%\n", costs[i].id, costs[i].cycles, pct);
+    }
+
+    assert(out < buf + len);
+    hs_misc_free(costs);
+    *info = buf;
+    return HS_SUCCESS;
+}
+
+#else // ROSE_PROFILE
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_profile_info(UNUSED const hs_scratch_t *scratch,
+                                   UNUSED char **info) {
+    return HS_INVALID;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_profile_reset(UNUSED hs_scratch_t *scratch) {
+    return HS_INVALID;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_profile_report(UNUSED const hs_database_t *db,
+                             UNUSED const hs_scratch_t *scratch,
+                             UNUSED unsigned int max_patterns,
+                             UNUSED char **info) {
+    return HS_INVALID;
+}
+
+#endif // ROSE_PROFILE
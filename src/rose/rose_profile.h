@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Rose runtime: optional profiling counters for the program
+ * interpreter.
+ *
+ * When the library is configured with ROSE_PROFILE, the interpreter counts
+ * the instructions it executes and the failures of some checks, both in total
+ * and per literal ID. The counters live in scratch and are read with
+ * hs_scratch_profile_info(). In other builds, all of the hooks here compile
+ * away to nothing.
+ *
+ * Profiling builds also charge the time stamp counter cycles spent in each
+ * literal's program and each engine's queue execution to that literal or
+ * engine. The charge is exclusive: an engine caught up from inside a literal
+ * program is charged to the engine, not the literal. hs_profile_report() maps
+ * these costs back to pattern IDs.
+ */
+
+#ifndef ROSE_PROFILE_H
+#define ROSE_PROFILE_H
+
+#include "rose_program.h"
+#include "scratch.h"
+#include "nfa/nfa_api_queue.h"
+#include "ue2common.h"
+
+/** \brief Value of RoseProfile::curr_lit when the running program does not
+ * belong to a literal (anchored matches, EOD, boundary reports). */
+#define ROSE_PROFILE_NO_LITERAL 0xffffffffU
+
+/** \brief Flag set in a cost owner to mark it as an engine queue index rather
+ * than a literal ID. */
+#define ROSE_PROFILE_ENGINE_OWNER 0x80000000U
+
+#ifdef ROSE_PROFILE
+
+#if defined(_WIN32)
+#include <intrin.h>
+#elif !defined(ARCH_AARCH64)
+#include <x86intrin.h>
+#endif
+
+/** \brief Counters for the programs run for a single literal ID. */
+struct RoseLiteralProfile {
+    u64a executions; //!< number of times the literal's program was run
+    u64a lookaround_fail; //!< CHECK_LOOKAROUND failures
+    u64a lit_mask_fail; //!< CHECK_LIT_MASK rejections
+    u64a cycles; //!< cycles spent in the literal's programs
+};
+
+/** \brief Counters for the queue executions of a single engine. */
+struct RoseEngineProfile {
+    u64a executions; //!< number of queue executions
+    u64a cycles; //!< cycles spent executing the queue
+};
+
+/** \brief Profiling counters, allocated as part of scratch. */
+struct RoseProfile {
+    /** \brief Executions of each instruction, indexed by opcode. */
+    u64a instr_count[ROSE_INSTR_END + 1];
+    u64a lookaround_fail; //!< total CHECK_LOOKAROUND failures
+    u64a lit_mask_fail; //!< total CHECK_LIT_MASK rejections
+    u32 literal_count; //!< number of entries in \ref lit
+    u32 curr_lit; //!< literal being processed, or ROSE_PROFILE_NO_LITERAL
+    u32 engine_count; //!< number of entries in \ref engine
+    u32 curr_owner; //!< literal or engine being charged for cycles
+    u64a last_tick; //!< time stamp counter when \ref curr_owner was last charged
+    struct RoseLiteralProfile *lit; //!< per-literal counters
+    struct RoseEngineProfile *engine; //!< per-queue counters
+};
+
+/** \brief Charge the cycles since the last switch to the current owner, then
+ * make \a owner the current owner. Returns the previous owner. Cycles spent
+ * with no owner, in the literal matchers or outside a scan, are not charged.
+ */
+static really_inline
+u32 roseProfileSwitchOwner(struct RoseProfile *p, u32 owner) {
+#if defined(ARCH_AARCH64)
+    // The virtual counter ticks at a fixed rate rather than with the core
+    // clock, but the relative costs it gives are just as useful.
+    u64a now;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(now));
+#else
+    u64a now = __rdtsc();
+#endif
+    u32 prev = p->curr_owner;
+    if (prev == ROSE_PROFILE_NO_LITERAL) {
+        // nobody to charge
+    } else if (prev & ROSE_PROFILE_ENGINE_OWNER) {
+        u32 qi = prev & ~ROSE_PROFILE_ENGINE_OWNER;
+        if (qi < p->engine_count) {
+            p->engine[qi].cycles += now - p->last_tick;
+        }
+    } else if (prev < p->literal_count) {
+        p->lit[prev].cycles += now - p->last_tick;
+    }
+    p->curr_owner = owner;
+    p->last_tick = now;
+    return prev;
+}
+
+static really_inline
+void roseProfileInstr(struct hs_scratch *scratch, u8 code) {
+    assert(code <= ROSE_INSTR_END);
+    scratch->profile->instr_count[code]++;
+}
+
+static really_inline
+struct RoseLiteralProfile *roseProfileCurrLit(struct hs_scratch *scratch) {
+    struct RoseProfile *p = scratch->profile;
+    if (p->curr_lit == ROSE_PROFILE_NO_LITERAL ||
+        p->curr_lit >= p->literal_count) {
+        return NULL;
+    }
+    return &p->lit[p->curr_lit];
+}
+
+static really_inline
+void roseProfileLookaroundFail(struct hs_scratch *scratch) {
+    scratch->profile->lookaround_fail++;
+    struct RoseLiteralProfile *lp = roseProfileCurrLit(scratch);
+    if (lp) {
+        lp->lookaround_fail++;
+    }
+}
+
+static really_inline
+void roseProfileLitMaskFail(struct hs_scratch *scratch) {
+    scratch->profile->lit_mask_fail++;
+    struct RoseLiteralProfile *lp = roseProfileCurrLit(scratch);
+    if (lp) {
+        lp->lit_mask_fail++;
+    }
+}
+
+/** \brief Note that we are about to run the program for literal \a id;
+ * returns the previous literal, to be passed to \ref roseProfileLitEnd.
+ *
+ * Literal programs are never run from inside an engine, so the previous
+ * literal is also the previous cost owner. */
+static really_inline
+u32 roseProfileLitBegin(struct hs_scratch *scratch, u32 id) {
+    struct RoseProfile *p = scratch->profile;
+    u32 prev = p->curr_lit;
+    p->curr_lit = id;
+    struct RoseLiteralProfile *lp = roseProfileCurrLit(scratch);
+    if (lp) {
+        lp->executions++;
+    }
+    roseProfileSwitchOwner(p, id);
+    return prev;
+}
+
+static really_inline
+void roseProfileLitEnd(struct hs_scratch *scratch, u32 prev) {
+    scratch->profile->curr_lit = prev;
+    roseProfileSwitchOwner(scratch->profile, prev);
+}
+
+/** \brief Note that we are about to execute the queue \a q; returns the
+ * previous cost owner, to be passed to \ref roseProfileEngineEnd. */
+static really_inline
+u32 roseProfileEngineBegin(const struct mq *q) {
+    struct hs_scratch *scratch = q->scratch;
+    if (!scratch) {
+        return ROSE_PROFILE_NO_LITERAL;
+    }
+    struct RoseProfile *p = scratch->profile;
+    u32 owner = ROSE_PROFILE_NO_LITERAL;
+    if (q >= scratch->queues && q < scratch->queues + p->engine_count) {
+        u32 qi = (u32)(q - scratch->queues);
+        p->engine[qi].executions++;
+        owner = qi | ROSE_PROFILE_ENGINE_OWNER;
+    }
+    return roseProfileSwitchOwner(p, owner);
+}
+
+static really_inline
+void roseProfileEngineEnd(const struct mq *q, u32 prev) {
+    if (q->scratch) {
+        roseProfileSwitchOwner(q->scratch->profile, prev);
+    }
+}
+
+#else // ROSE_PROFILE
+
+static really_inline
+void roseProfileInstr(UNUSED struct hs_scratch *scratch, UNUSED u8 code) {}
+
+static really_inline
+void roseProfileLookaroundFail(UNUSED struct hs_scratch *scratch) {}
+
+static really_inline
+void roseProfileLitMaskFail(UNUSED struct hs_scratch *scratch) {}
+
+static really_inline
+u32 roseProfileLitBegin(UNUSED struct hs_scratch *scratch, UNUSED u32 id) {
+    return ROSE_PROFILE_NO_LITERAL;
+}
+
+static really_inline
+void roseProfileLitEnd(UNUSED struct hs_scratch *scratch, UNUSED u32 prev) {}
+
+static really_inline
+u32 roseProfileEngineBegin(UNUSED const struct mq *q) {
+    return ROSE_PROFILE_NO_LITERAL;
+}
+
+static really_inline
+void roseProfileEngineEnd(UNUSED const struct mq *q, UNUSED u32 prev) {}
+
+#endif // ROSE_PROFILE
+
+#endif // ROSE_PROFILE_H
@@ -40,6 +40,9 @@
 /** \brief Minimum alignment for each instruction in memory. */
 #define ROSE_INSTR_MIN_ALIGN 8U
 
+/** \brief Max paths in a CHECK_MULTIPATH_LOOKAROUND instruction. */
+#define ROSE_MULTIPATH_LOOKAROUND_MAX 8
+
 /** \brief Role program instruction opcodes. */
 enum RoseInstructionCode {
     ROSE_INSTR_ANCHORED_DELAY,    //!< Delay until after anchored matcher.
@@ -49,8 +52,20 @@ enum RoseInstructionCode {
     ROSE_INSTR_CHECK_ONLY_EOD,    //!< Role matches only at EOD.
     ROSE_INSTR_CHECK_BOUNDS,      //!< Bounds on distance from offset 0.
     ROSE_INSTR_CHECK_NOT_HANDLED, //!< Test & set role in "handled".
+
+    /** \brief Super-instruction combining CHECK_BOUNDS and
+     * CHECK_NOT_HANDLED. */
+    ROSE_INSTR_CHECK_BOUNDS_NOT_HANDLED,
+
     ROSE_INSTR_CHECK_LOOKAROUND,  //!< Lookaround check.
+
+    /** \brief Lookaround check that passes if any of several paths does. */
+    ROSE_INSTR_CHECK_MULTIPATH_LOOKAROUND,
+
     ROSE_INSTR_CHECK_MASK,        //!< 8-bytes mask check.
+    ROSE_INSTR_CHECK_MASK_32,     //!< 32-bytes and/cmp/neg mask check.
+    ROSE_INSTR_CHECK_MASK_64,     //!< 64-bytes and/cmp/neg mask check.
+    ROSE_INSTR_CHECK_SHUFTI_32x8, //!< Check 32-byte data by 8-bucket shufti.
     ROSE_INSTR_CHECK_BYTE,        //!< Single Byte check.
     ROSE_INSTR_CHECK_INFIX,       //!< Infix engine must be in accept state.
     ROSE_INSTR_CHECK_PREFIX,      //!< Prefix engine must be in accept state.
@@ -91,6 +106,12 @@ enum RoseInstructionCode {
      */
     ROSE_INSTR_FINAL_REPORT,
 
+    /**
+     * \brief Fire a list of plain and exhaustible reports in turn, skipping
+     * any whose exhaustion key is already set.
+     */
+    ROSE_INSTR_REPORT_MULTI,
+
     ROSE_INSTR_CHECK_EXHAUSTED,   //!< Check if an ekey has already been set.
     ROSE_INSTR_CHECK_MIN_LENGTH,  //!< Check (EOM - SOM) against min length.
     ROSE_INSTR_SET_STATE,         //!< Switch a state index on.
@@ -110,6 +131,39 @@ enum RoseInstructionCode {
     /** \brief Run the EOD-anchored HWLM literal matcher. */
     ROSE_INSTR_MATCHER_EOD,
 
+    /**
+     * \brief Evaluate any logical combinations made active by sub-pattern
+     * matches at an earlier offset, and report those that have become true.
+     */
+    ROSE_INSTR_FLUSH_COMBINATION,
+
+    /** \brief Set the logical key of a logical combination sub-pattern. */
+    ROSE_INSTR_SET_LOGICAL,
+
+    /** \brief Mark a logical combination as needing to be evaluated. */
+    ROSE_INSTR_SET_COMBINATION,
+
+    /**
+     * \brief Count a match against its report's match limit, setting the
+     * limit's exhaustion key once the limit has been reached.
+     */
+    ROSE_INSTR_COUNT_MATCH,
+
+    /**
+     * \brief Check a match of an HS_FLAG_CONFIRM pattern with its backtracking
+     * confirm program.
+     */
+    ROSE_INSTR_CHECK_CONFIRM,
+
+    /** \brief Check that the literal's subgroup has not been squashed. */
+    ROSE_INSTR_CHECK_SUBGROUP,
+
+    /**
+     * \brief Conditionally turn off a subgroup, and its group once it has no
+     * subgroups left.
+     */
+    ROSE_INSTR_SQUASH_SUBGROUP,
+
     ROSE_INSTR_END                //!< End of program.
 };
 
@@ -161,6 +215,14 @@ struct ROSE_STRUCT_CHECK_NOT_HANDLED {
     u32 fail_jump; //!< Jump forward this many bytes if we have seen key before.
 };
 
+struct ROSE_STRUCT_CHECK_BOUNDS_NOT_HANDLED {
+    u8 code; //!< From enum RoseInstructionCode.
+    u64a min_bound; //!< Min distance from zero.
+    u64a max_bound; //!< Max distance from zero.
+    u32 key; //!< Key in the "handled_roles" fatbit in scratch.
+    u32 fail_jump; //!< Jump forward this many bytes on failure.
+};
+
 struct ROSE_STRUCT_CHECK_LOOKAROUND {
     u8 code; //!< From enum RoseInstructionCode.
     u32 index;
@@ -168,6 +230,14 @@ struct ROSE_STRUCT_CHECK_LOOKAROUND {
     u32 fail_jump; //!< Jump forward this many bytes on failure.
 };
 
+struct ROSE_STRUCT_CHECK_MULTIPATH_LOOKAROUND {
+    u8 code; //!< From enum RoseInstructionCode.
+    u8 path_count; //!< Number of paths in use.
+    u32 index[ROSE_MULTIPATH_LOOKAROUND_MAX]; //!< Table index of each path.
+    u32 count[ROSE_MULTIPATH_LOOKAROUND_MAX]; //!< Entry count of each path.
+    u32 fail_jump; //!< Jump forward this many bytes on failure.
+};
+
 struct ROSE_STRUCT_CHECK_MASK {
     u8 code; //!< From enum roseInstructionCode.
     u64a and_mask; //!< 64-bits and mask.
@@ -177,6 +247,40 @@ struct ROSE_STRUCT_CHECK_MASK {
     u32 fail_jump; //!< Jump forward this many bytes on failure.
 };
 
+struct ROSE_STRUCT_CHECK_MASK_32 {
+    u8 code; //!< From enum RoseInstructionCode.
+    u8 and_mask[32]; //!< 32-byte and mask.
+    u8 cmp_mask[32]; //!< 32-byte cmp mask.
+    u32 neg_mask; //!< Negation mask, one bit per byte.
+    s32 offset; //!< Relative offset of the first byte.
+    u32 fail_jump; //!< Jump forward this many bytes on failure.
+};
+
+struct ROSE_STRUCT_CHECK_MASK_64 {
+    u8 code; //!< From enum RoseInstructionCode.
+    u8 and_mask[64]; //!< 64-byte and mask.
+    u8 cmp_mask[64]; //!< 64-byte cmp mask.
+    u64a neg_mask; //!< Negation mask, one bit per byte.
+    s32 offset; //!< Relative offset of the first byte.
+    u32 fail_jump; //!< Jump forward this many bytes on failure.
+};
+
+/**
+ * Note: each byte of the 32-byte window must fall in the shufti buckets named
+ * by its byte of bucket_select_mask (or must not, if its neg_mask bit is set).
+ * Positions with no lookaround entry have their neg_mask bit set and an empty
+ * bucket_select_mask byte, so they always pass.
+ */
+struct ROSE_STRUCT_CHECK_SHUFTI_32x8 {
+    u8 code; //!< From enum RoseInstructionCode.
+    u8 hi_mask[32]; //!< High nibble mask, repeated in both 16-byte lanes.
+    u8 lo_mask[32]; //!< Low nibble mask, repeated in both 16-byte lanes.
+    u8 bucket_select_mask[32]; //!< Buckets accepted at each byte.
+    u32 neg_mask; //!< Negation mask, one bit per byte.
+    s32 offset; //!< Relative offset of the first byte.
+    u32 fail_jump; //!< Jump forward this many bytes on failure.
+};
+
 struct ROSE_STRUCT_CHECK_BYTE {
     u8 code; //!< From enum RoseInstructionCode.
     u8 and_mask; //!< 8-bits and mask.
@@ -332,6 +436,19 @@ struct ROSE_STRUCT_FINAL_REPORT {
     s32 offset_adjust; //!< Offset adjustment to apply to end offset.
 };
 
+/** \brief One report in the list used by a REPORT_MULTI instruction. */
+struct rose_report_entry {
+    ReportID onmatch; //!< Report ID to deliver to user.
+    s32 offset_adjust; //!< Offset adjustment to apply to end offset.
+    u32 ekey; //!< Exhaustion key, or INVALID_EKEY.
+};
+
+struct ROSE_STRUCT_REPORT_MULTI {
+    u8 code; //!< From enum RoseInstructionCode.
+    u32 count; //!< Number of reports in the list.
+    u32 list_offset; //!< Offset of the list of rose_report_entry structures.
+};
+
 struct ROSE_STRUCT_CHECK_EXHAUSTED {
     u8 code; //!< From enum RoseInstructionCode.
     u32 ekey; //!< Exhaustion key to check.
@@ -402,6 +519,50 @@ struct ROSE_STRUCT_MATCHER_EOD {
     u8 code; //!< From enum RoseInstructionCode.
 };
 
+struct ROSE_STRUCT_FLUSH_COMBINATION {
+    u8 code; //!< From enum RoseInstructionCode.
+    s32 offset_adjust; //!< Offset adjustment to apply to end offset.
+};
+
+struct ROSE_STRUCT_SET_LOGICAL {
+    u8 code; //!< From enum RoseInstructionCode.
+    u32 lkey; //!< Logical key to set.
+    s32 offset_adjust; //!< Offset adjustment to apply to end offset.
+};
+
+struct ROSE_STRUCT_SET_COMBINATION {
+    u8 code; //!< From enum RoseInstructionCode.
+    u32 ckey; //!< Combination key to mark as active.
+};
+
+struct ROSE_STRUCT_COUNT_MATCH {
+    u8 code; //!< From enum RoseInstructionCode.
+    u32 key; //!< Index of the match counter in stream state.
+    u32 limit; //!< Maximum number of matches to report.
+    u32 ekey; //!< Exhaustion key to set when the limit is reached.
+};
+
+struct ROSE_STRUCT_CHECK_CONFIRM {
+    u8 code; //!< From enum RoseInstructionCode.
+    u32 key; //!< Index of the confirm program in the confirm table.
+    s32 offset_adjust; //!< Offset adjustment to apply to end offset.
+    u32 fail_jump; //!< Jump forward this many bytes on failure.
+};
+
+/** Note: check failure will halt program. */
+struct ROSE_STRUCT_CHECK_SUBGROUP {
+    u8 code; //!< From enum RoseInstructionCode.
+    u32 index; //!< Index of the group's subgroup mask in stream state.
+    u64a subgroup; //!< Subgroup bit.
+};
+
+struct ROSE_STRUCT_SQUASH_SUBGROUP {
+    u8 code; //!< From enum RoseInstructionCode.
+    u32 index; //!< Index of the group's subgroup mask in stream state.
+    u64a subgroup; //!< Subgroup bit to turn off.
+    rose_group groups; //!< Bitmask to AND into groups once none are left.
+};
+
 struct ROSE_STRUCT_END {
     u8 code; //!< From enum RoseInstructionCode.
 };
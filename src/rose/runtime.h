@@ -96,6 +96,22 @@ void storeGroups(const struct RoseEngine *t, char *state, rose_group groups) {
                        t->stateOffsets.groups_size);
 }
 
+/** \brief Load the subgroup mask of the group with subgroup index \p index. */
+static really_inline
+u64a loadSubgroups(const struct RoseEngine *t, const char *state, u32 index) {
+    assert(index < t->subgroupCount);
+    return unaligned_load_u64a(state + t->stateOffsets.subgroups +
+                               index * sizeof(u64a));
+}
+
+static really_inline
+void storeSubgroups(const struct RoseEngine *t, char *state, u32 index,
+                    u64a subgroups) {
+    assert(index < t->subgroupCount);
+    unaligned_store_u64a(state + t->stateOffsets.subgroups +
+                         index * sizeof(u64a), subgroups);
+}
+
 static really_inline
 u8 *getFloatingMatcherState(const struct RoseEngine *t, char *state) {
     return (u8 *)(state + t->stateOffsets.floatingMatcherState);
@@ -27,6 +27,7 @@
  */
 
 #include "catchup.h"
+#include "catchup_pq.h"
 #include "counting_miracle.h"
 #include "infix.h"
 #include "match.h"
@@ -38,7 +39,9 @@
 #include "nfa/nfa_api.h"
 #include "nfa/nfa_api_queue.h"
 #include "nfa/nfa_internal.h"
+#include "nfa/sheng.h"
 #include "util/fatbit.h"
+#include "pmu_stats.h"
 
 static rose_inline
 void runAnchoredTableStream(const struct RoseEngine *t, const void *atable,
@@ -54,7 +57,7 @@ void runAnchoredTableStream(const struct RoseEngine *t, const void *atable,
         const struct NFA *nfa
             = (const struct NFA *)((const char *)curr + sizeof(*curr));
         assert(ISALIGNED_CL(nfa));
-        assert(isMcClellanType(nfa->type));
+        assert(isMcClellanType(nfa->type) || nfa->type == SHENG_NFA_0);
 
         char *state = state_base + curr->state_offset;
 
@@ -70,7 +73,11 @@ void runAnchoredTableStream(const struct RoseEngine *t, const void *atable,
             start = 1;
         } else {
             // (No state decompress necessary.)
-            if (nfa->type == MCCLELLAN_NFA_8) {
+            if (nfa->type == SHENG_NFA_0) {
+                if (nfaExecSheng0_stateDead(state)) {
+                    goto next_nfa;
+                }
+            } else if (nfa->type == MCCLELLAN_NFA_8) {
                 if (!*(u8 *)state) {
                     goto next_nfa;
                 }
@@ -81,7 +88,10 @@ void runAnchoredTableStream(const struct RoseEngine *t, const void *atable,
             }
         }
 
-        if (nfa->type == MCCLELLAN_NFA_8) {
+        if (nfa->type == SHENG_NFA_0) {
+            nfaExecSheng0_SimpStream(nfa, state, scratch->core_info.buf, start,
+                                     adj, alen, roseAnchoredCallback, scratch);
+        } else if (nfa->type == MCCLELLAN_NFA_8) {
             nfaExecMcClellan8_SimpStream(nfa, state, scratch->core_info.buf,
                                          start, adj, alen, roseAnchoredCallback,
                                          scratch);
@@ -405,7 +415,14 @@ void ensureStreamNeatAndTidy(const struct RoseEngine *t, char *state,
     roseCatchUpLeftfixes(t, state, scratch);
     roseFlushLastByteHistory(t, scratch, offset + length);
     tctxt->lastEndOffset = offset + length;
-    storeGroups(t, state, tctxt->groups);
+
+    rose_group groups = tctxt->groups;
+    if (scratch->pattern_mask) {
+        /* groups masked off for this write stay as they were in the stream,
+         * as later writes may use another mask */
+        groups |= loadGroups(t, state) & ~patternMaskGroups(scratch);
+    }
+    storeGroups(t, state, groups);
 }
 
 static really_inline
@@ -418,8 +435,10 @@ void do_rebuild(const struct RoseEngine *t, const struct HWLM *ftable,
 
     scratch->core_info.status &= ~STATUS_DELAY_DIRTY;
 
+    PMU_PHASE_BEGIN(scratch, pmu);
     hwlmExec(ftable, buf, len, 0, roseDelayRebuildCallback, scratch,
              scratch->tctxt.groups);
+    PMU_PHASE_END(scratch, HS_PMU_PHASE_LITERAL_MATCHER, pmu);
     assert(!can_stop_matching(scratch));
 }
 
@@ -479,9 +498,9 @@ void runEagerPrefixesStream(const struct RoseEngine *t,
                 nfaQueueInitState(q->nfa, q);
             }
         } else {
-            pushQueueAt(q, 0, MQE_START, 0);
-            pushQueueAt(q, 1, MQE_TOP, 0);
-            pushQueueAt(q, 2, MQE_END, loc);
+            const struct mq_item seed[] = {
+                {MQE_START, 0, 0}, {MQE_TOP, 0, 0}, {MQE_END, loc, 0}};
+            pushQueueItems(q, seed, ARRAY_LENGTH(seed));
             nfaQueueInitState(nfa, q);
         }
 
@@ -539,7 +558,7 @@ void roseStreamExec(const struct RoseEngine *t, struct hs_scratch *scratch) {
 
     struct RoseContext *tctxt = &scratch->tctxt;
     tctxt->mpv_inactive = 0;
-    tctxt->groups = loadGroups(t, state);
+    tctxt->groups = loadGroups(t, state) & patternMaskGroups(scratch);
     tctxt->lit_offset_adjust = offset + 1; // index after last byte
     tctxt->delayLastEndOffset = offset;
     tctxt->lastEndOffset = offset;
@@ -551,12 +570,16 @@ void roseStreamExec(const struct RoseEngine *t, struct hs_scratch *scratch) {
     DEBUG_PRINTF("BEGIN: history len=%zu, buffer len=%zu groups=%016llx\n",
                  scratch->core_info.hlen, scratch->core_info.len, tctxt->groups);
 
-    fatbit_clear(scratch->aqa);
+    fatbit_clear(scratch->aqa, t->queueCount);
     scratch->al_log_sum = 0;
-    scratch->catchup_pq.qm_size = 0;
+    catchupPqReset(&scratch->catchup_pq);
 
     if (t->outfixBeginQueue != t->outfixEndQueue) {
         streamInitSufPQ(t, state, scratch);
+        if (can_stop_matching(scratch)) {
+            /* unordered delivery: outfixes have reported their matches */
+            goto exit;
+        }
     }
 
     runEagerPrefixesStream(t, scratch);
@@ -629,9 +652,11 @@ void roseStreamExec(const struct RoseEngine *t, struct hs_scratch *scratch) {
         }
 
         DEBUG_PRINTF("BEGIN FLOATING (over %zu/%zu)\n", flen, length);
+        PMU_PHASE_BEGIN(scratch, pmu);
         hwlmExecStreaming(ftable, scratch, flen, start, roseFloatingCallback,
                           scratch, tctxt->groups & t->floating_group_mask,
                           stream_state);
+        PMU_PHASE_END(scratch, HS_PMU_PHASE_LITERAL_MATCHER, pmu);
     }
 
 flush_delay_and_exit:
@@ -655,7 +680,8 @@ void roseStreamInitEod(const struct RoseEngine *t, u64a offset,
                        struct hs_scratch *scratch) {
     struct RoseContext *tctxt = &scratch->tctxt;
     /* TODO: diff groups for eod */
-    tctxt->groups = loadGroups(t, scratch->core_info.state);
+    tctxt->groups = loadGroups(t, scratch->core_info.state) &
+                    patternMaskGroups(scratch);
     tctxt->lit_offset_adjust = scratch->core_info.buf_offset
                              - scratch->core_info.hlen
                              + 1; // index after last byte
@@ -667,10 +693,10 @@ void roseStreamInitEod(const struct RoseEngine *t, u64a offset,
     tctxt->minNonMpvMatchOffset = offset;
     tctxt->next_mpv_offset = offset;
 
-    scratch->catchup_pq.qm_size = 0;
+    catchupPqReset(&scratch->catchup_pq);
     scratch->al_log_sum = 0; /* clear the anchored logs */
 
-    fatbit_clear(scratch->aqa);
+    fatbit_clear(scratch->aqa, t->queueCount);
 }
 
 void roseStreamEodExec(const struct RoseEngine *t, u64a offset,
@@ -26,7 +26,11 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifndef VALIDATE_MASK_H
+#define VALIDATE_MASK_H
+
 #include "ue2common.h"
+#include "util/simd_utils.h"
 
 // check positive bytes in cmp_result.
 // return one if the check passed, zero otherwise.
@@ -75,3 +79,57 @@ int validateMask(u64a data, u64a valid_data_mask, u64a and_mask,
         return 0;
     }
 }
+
+/*
+ * Return a mask with bit i set if byte i of data fails its and/cmp check, that
+ * is, (data[i] & and_mask[i]) != cmp_mask[i].
+ */
+static really_inline
+u32 mismatchMask32(const m256 data, const m256 and_mask, const m256 cmp_mask) {
+#if defined(__AVX2__)
+    return ~movemask256(eq256(and256(data, and_mask), cmp_mask));
+#else
+    u32 lo = movemask128(eq128(and128(data.lo, and_mask.lo), cmp_mask.lo));
+    u32 hi = movemask128(eq128(and128(data.hi, and_mask.hi), cmp_mask.hi));
+    return ~(lo | hi << 16);
+#endif
+}
+
+/*
+ * Check 32 bytes of data against byte-wise and/cmp masks. Unlike
+ * validateMask(), neg_mask and valid_data_mask carry one bit per byte.
+ * Return one if the check passed, zero otherwise.
+ */
+static really_inline
+int validateMask32(const m256 data, const u32 valid_data_mask,
+                   const m256 and_mask, const m256 cmp_mask,
+                   const u32 neg_mask) {
+    u32 mismatch = mismatchMask32(data, and_mask, cmp_mask);
+    u32 failed = (mismatch ^ neg_mask) & valid_data_mask;
+    DEBUG_PRINTF("mismatch %08x neg_mask %08x valid_data_mask %08x\n",
+                 mismatch, neg_mask, valid_data_mask);
+    return !failed;
+}
+
+/*
+ * Check 64 bytes of data against byte-wise and/cmp masks, with one bit per
+ * byte in neg_mask and valid_data_mask.
+ * Return one if the check passed, zero otherwise.
+ */
+static really_inline
+int validateMask64(const m512 data, const u64a valid_data_mask,
+                   const m512 and_mask, const m512 cmp_mask,
+                   const u64a neg_mask) {
+#if defined(__AVX512BW__)
+    u64a mismatch = _mm512_cmpneq_epi8_mask(and512(data, and_mask), cmp_mask);
+#else
+    u64a mismatch = mismatchMask32(data.lo, and_mask.lo, cmp_mask.lo) |
+        (u64a)mismatchMask32(data.hi, and_mask.hi, cmp_mask.hi) << 32;
+#endif
+    u64a failed = (mismatch ^ neg_mask) & valid_data_mask;
+    DEBUG_PRINTF("mismatch %016llx neg_mask %016llx valid_data_mask %016llx\n",
+                 mismatch, neg_mask, valid_data_mask);
+    return !failed;
+}
+
+#endif // VALIDATE_MASK_H
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VALIDATE_SHUFTI_H
+#define VALIDATE_SHUFTI_H
+
+#include "ue2common.h"
+#include "util/simd_utils.h"
+
+/*
+ * Check each byte of a 32-byte window for membership of the character classes
+ * encoded by a set of up to eight shufti buckets. Byte i is in its class if
+ * its shufti lookup hits any of the buckets in bucket_select_mask[i]; bit i of
+ * neg_mask inverts this test and bytes outside valid_data_mask are ignored.
+ * Return one if the check passed, zero otherwise.
+ */
+static really_inline
+int validateShuftiMask32x8(const m256 data, const m256 hi_mask,
+                           const m256 lo_mask, const m256 bucket_select_mask,
+                           const u32 neg_mask, const u32 valid_data_mask) {
+    const m256 low4bits = set32x8(0xf);
+    m256 c_lo = vpshufb(lo_mask, and256(data, low4bits));
+    m256 c_hi = vpshufb(hi_mask,
+                        rshift64_m256(andnot256(low4bits, data), 4));
+    m256 t = and256(and256(c_lo, c_hi), bucket_select_mask);
+
+    // Bit i of nresult is set if byte i was not in its class.
+#if defined(__AVX2__)
+    u32 nresult = movemask256(eq256(t, zeroes256()));
+#else
+    const m128 zeroes = zeroes128();
+    u32 nresult = movemask128(eq128(t.lo, zeroes)) |
+                  movemask128(eq128(t.hi, zeroes)) << 16;
+#endif
+
+    u32 failed = (nresult ^ neg_mask) & valid_data_mask;
+    DEBUG_PRINTF("nresult %08x neg_mask %08x valid_data_mask %08x\n",
+                 nresult, neg_mask, valid_data_mask);
+    return !failed;
+}
+
+#endif // VALIDATE_SHUFTI_H
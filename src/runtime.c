@@ -44,19 +44,27 @@
 #include "nfa/nfa_internal.h"
 #include "nfa/nfa_rev_api.h"
 #include "nfa/sheng.h"
+#include "nfa/shufti.h"
+#include "nfa/truffle.h"
 #include "smallwrite/smallwrite_internal.h"
 #include "rose/rose.h"
 #include "rose/runtime.h"
 #include "database.h"
+#include "latency_stats.h"
+#include "pmu_stats.h"
 #include "report.h"
+#include "sample_stats.h"
 #include "scratch.h"
 #include "som/som_runtime.h"
 #include "som/som_stream.h"
 #include "state.h"
+#include "stream_compress.h"
+#include "tracepoints.h"
 #include "ue2common.h"
 #include "util/exhaust.h"
 #include "util/fatbit.h"
 #include "util/multibit.h"
+#include "util/utf8_check.h"
 
 static really_inline
 void prefetch_data(const char *data, unsigned length) {
@@ -74,14 +82,9 @@ int null_onEvent(UNUSED unsigned id, UNUSED unsigned long long from,
 }
 
 static really_inline
-u32 getHistoryAmount(const struct RoseEngine *t, u64a offset) {
-    return MIN(t->historyRequired, offset);
-}
-
-static really_inline
-u8 *getHistory(char *state, const struct RoseEngine *t, u64a offset) {
-    return (u8 *)state + t->stateOffsets.history + t->historyRequired
-        - MIN(t->historyRequired, offset);
+u8 *getHistory(char *state, const struct RoseEngine *t, u32 hlen) {
+    assert(hlen <= t->historyRequired);
+    return (u8 *)state + t->stateOffsets.history + t->historyRequired - hlen;
 }
 
 /** \brief Sanity checks for scratch space.
@@ -111,6 +114,12 @@ char validScratch(const struct RoseEngine *t, const struct hs_scratch *s) {
         return 0;
     }
 
+    if (s->pattern_mask && s->pattern_mask->rose != t &&
+        s->pattern_mask->alt_rose != t) {
+        DEBUG_PRINTF("pattern mask is for another database\n");
+        return 0;
+    }
+
     /* TODO: add quick rose sanity checks */
 
     return 1;
@@ -125,31 +134,51 @@ void populateCoreInfo(struct hs_scratch *s, const struct RoseEngine *rose,
     assert(rose);
     s->core_info.userContext = userCtx;
     s->core_info.userCallback = onEvent ? onEvent : null_onEvent;
+    s->core_info.batch = s->batch.buf ? &s->batch : NULL;
     s->core_info.rose = rose;
     s->core_info.state = state; /* required for chained queues + evec */
 
     s->core_info.exhaustionVector = state + rose->stateOffsets.exhausted;
+    s->core_info.logicalVector = state + rose->stateOffsets.logicalVec;
+    s->core_info.combVector = state + rose->stateOffsets.combVec;
     s->core_info.status = status;
     s->core_info.buf = (const u8 *)data;
     s->core_info.len = length;
     s->core_info.hbuf = history;
     s->core_info.hlen = hlen;
     s->core_info.buf_offset = offset;
+    s->core_info.window_min = 0;
+    s->core_info.window_max = MAX_OFFSET;
 
     /* and some stuff not actually in core info */
     s->som_set_now_offset = ~0ULL;
     s->deduper.current_report_offset = ~0ULL;
+    s->deduper.log_dirty = 3; /* logs have not been cleared */
     s->deduper.som_log_dirty = 1; /* som logs have not been cleared */
 
+    // Escape scans recorded by LBR engines are only valid for this call.
+    if (unlikely(!++s->lbr_escape_gen)) {
+        memset(s->lbr_escape, 0, sizeof(s->lbr_escape));
+        s->lbr_escape_gen = 1;
+    }
+
+    // Likewise the leftfix check results, which refer to queue locations.
+    if (unlikely(!++s->leftfix_check_gen)) {
+        memset(s->leftfix_check, 0, sizeof(s->leftfix_check));
+        s->leftfix_check_gen = 1;
+    }
+
     // Rose program execution (used for some report paths) depends on these
     // values being initialised.
     s->tctxt.lastMatchOffset = 0;
     s->tctxt.minMatchOffset = offset;
     s->tctxt.minNonMpvMatchOffset = offset;
+    s->tctxt.lastCombMatchOffset = offset;
 }
 
 #define STATUS_VALID_BITS                                                      \
-    (STATUS_TERMINATED | STATUS_EXHAUSTED | STATUS_DELAY_DIRTY)
+    (STATUS_TERMINATED | STATUS_EXHAUSTED | STATUS_DELAY_DIRTY |               \
+     STATUS_EOD_LIVE)
 
 /** \brief Retrieve status bitmask from stream state. */
 static really_inline
@@ -200,11 +229,13 @@ void pureLiteralBlockExec(const struct RoseEngine *rose,
     DEBUG_PRINTF("rose engine %d\n", rose->runtimeImpl);
 
     // RoseContext values that need to be set for use by roseCallback.
-    scratch->tctxt.groups = rose->initialGroups;
+    scratch->tctxt.groups = rose->initialGroups & patternMaskGroups(scratch);
     scratch->tctxt.lit_offset_adjust = 1;
 
+    PMU_PHASE_BEGIN(scratch, pmu);
     hwlmExec(ftable, buffer, length, 0, roseCallback, scratch,
-             rose->initialGroups);
+             scratch->tctxt.groups);
+    PMU_PHASE_END(scratch, HS_PMU_PHASE_LITERAL_MATCHER, pmu);
 }
 
 static really_inline
@@ -224,6 +255,7 @@ void initOutfixQueue(struct mq *q, u32 qi, const struct RoseEngine *t,
     q->cb = roseReportAdaptor;
     q->context = scratch;
     q->report_current = 0;
+    q->scratch = scratch;
 
     DEBUG_PRINTF("qi=%u, offset=%llu, fullState=%u, streamState=%u, "
                  "state=%u\n", qi, q->offset, info->fullStateOffset,
@@ -266,6 +298,26 @@ void soleOutfixBlockExec(const struct RoseEngine *t,
     }
 }
 
+/** \brief Returns zero if the small write prefilter shows that nothing in the
+ * buffer can match. */
+static really_inline
+int smallWritePrefilter(const struct SmallWriteEngine *smwr, const u8 *buf,
+                        size_t len) {
+    assert(len);
+    const u8 *buf_end = buf + len;
+    switch (smwr->prefilter) {
+    case SMWR_PREFILTER_SHUFTI:
+        return shuftiExec(smwr->prefilter_lo, smwr->prefilter_hi, buf,
+                          buf_end) != buf_end;
+    case SMWR_PREFILTER_TRUFFLE:
+        return truffleExec(smwr->prefilter_lo, smwr->prefilter_hi, buf,
+                           buf_end) != buf_end;
+    default:
+        assert(smwr->prefilter == SMWR_PREFILTER_NONE);
+        return 1;
+    }
+}
+
 static rose_inline
 void runSmallWriteEngine(const struct SmallWriteEngine *smwr,
                          struct hs_scratch *scratch) {
@@ -287,6 +339,11 @@ void runSmallWriteEngine(const struct SmallWriteEngine *smwr,
     size_t local_alen = length - smwr->start_offset;
     const u8 *local_buffer = buffer + smwr->start_offset;
 
+    if (!smallWritePrefilter(smwr, local_buffer, local_alen)) {
+        DEBUG_PRINTF("prefilter found no required bytes\n");
+        return;
+    }
+
     assert(isDfaType(nfa->type));
     if (nfa->type == MCCLELLAN_NFA_8) {
         nfaExecMcClellan8_B(nfa, smwr->start_offset, local_buffer,
@@ -300,39 +357,112 @@ void runSmallWriteEngine(const struct SmallWriteEngine *smwr,
     }
 }
 
-HS_PUBLIC_API
-hs_error_t hs_scan(const hs_database_t *db, const char *data, unsigned length,
-                   unsigned flags, hs_scratch_t *scratch,
-                   match_event_handler onEvent, void *userCtx) {
-    if (unlikely(!scratch || !data)) {
-        return HS_INVALID;
+/**
+ * \brief Screens up to MCCLELLAN_BATCH_LANES blocks of a batch against the
+ * small write DFA together.
+ *
+ * Returns a mask with bit i set if block i is one the small write engine
+ * would handle and the DFA shows that it cannot raise a match there, so that
+ * runSmallWriteEngine() can be skipped for it.
+ */
+static really_inline
+u32 screenSmallWriteBatch(const struct RoseEngine *rose,
+                          const char *const *data, const unsigned *length,
+                          u32 count) {
+    assert(count && count <= MCCLELLAN_BATCH_LANES);
+    if (!rose->smallWriteOffset) {
+        return 0;
     }
 
-    hs_error_t err = validDatabase(db);
-    if (unlikely(err != HS_SUCCESS)) {
-        return err;
+    const struct SmallWriteEngine *smwr = getSmallWrite(rose);
+    const struct NFA *nfa = getSmwrNfa(smwr);
+    if (nfa->type != MCCLELLAN_NFA_8 && nfa->type != MCCLELLAN_NFA_16) {
+        /* Sheng already steps with a shuffle; nothing to gain here. */
+        return 0;
     }
 
-    const struct RoseEngine *rose = hs_get_bytecode(db);
-    if (unlikely(!ISALIGNED_16(rose))) {
-        return HS_INVALID;
+    const u8 *lane_buf[MCCLELLAN_BATCH_LANES];
+    size_t lane_len[MCCLELLAN_BATCH_LANES];
+    u8 lane_block[MCCLELLAN_BATCH_LANES];
+    u32 lanes = 0;
+    for (u32 i = 0; i < count; i++) {
+        if (length[i] >= smwr->largestBuffer
+            || length[i] <= smwr->start_offset) {
+            continue;
+        }
+        lane_buf[lanes] = (const u8 *)data[i] + smwr->start_offset;
+        lane_len[lanes] = length[i] - smwr->start_offset;
+        lane_block[lanes] = (u8)i;
+        lanes++;
     }
 
-    if (unlikely(rose->mode != HS_MODE_BLOCK)) {
-        return HS_DB_MODE_ERROR;
+    if (lanes < 2) {
+        return 0;
     }
 
-    if (unlikely(!validScratch(rose, scratch))) {
-        return HS_INVALID;
+    u32 accepted;
+    if (nfa->type == MCCLELLAN_NFA_8) {
+        accepted = nfaExecMcClellan8_Bbatch(nfa, lane_buf, lane_len, lanes);
+    } else {
+        accepted = nfaExecMcClellan16_Bbatch(nfa, lane_buf, lane_len, lanes);
     }
 
-    if (unlikely(markScratchInUse(scratch))) {
-        return HS_SCRATCH_IN_USE;
+    u32 quiet = 0;
+    for (u32 j = 0; j < lanes; j++) {
+        if (!(accepted & (1U << j))) {
+            quiet |= 1U << lane_block[j];
+        }
     }
+    DEBUG_PRINTF("screened %u blocks, quiet mask 0x%x\n", lanes, quiet);
+    return quiet;
+}
+
+/**
+ * \brief Returns non-zero if the caller of an API call wants matches, either
+ * through the match handler \a onEvent or through a match buffer attached to
+ * scratch \a s.
+ */
+static really_inline
+char matchesWanted(match_event_handler onEvent, const struct hs_scratch *s) {
+    return onEvent || (s && ISALIGNED_CL(s) && s->magic == SCRATCH_MAGIC &&
+                       s->batch.buf);
+}
+
+/**
+ * \brief Hands any matches left in the scratch's match buffer to the batch
+ * handler at the end of an API call.
+ *
+ * Returns non-zero if the handler asked for matching to stop.
+ */
+static really_inline
+int flushMatchBatch(struct hs_scratch *scratch) {
+    struct match_batch *mb = &scratch->batch;
+    if (!mb->count) {
+        return 0;
+    }
+
+    assert(mb->buf);
+    u32 count = mb->count;
+    mb->count = 0;
+    DEBUG_PRINTF("delivering last %u buffered matches\n", count);
+    return mb->onBatch(mb->buf, count, scratch->core_info.userContext);
+}
 
+/**
+ * \brief Scan a single block with a database and scratch that have already
+ * been validated; the caller is responsible for marking the scratch in use.
+ *
+ * If \a smwr_quiet is set, the caller has already established that the small
+ * write engine cannot match in this block (see screenSmallWriteBatch()).
+ */
+static really_inline
+hs_error_t hs_scan_block_internal(const struct RoseEngine *rose,
+                                  const char *data, unsigned length,
+                                  unsigned flags, hs_scratch_t *scratch,
+                                  match_event_handler onEvent, void *userCtx,
+                                  char smwr_quiet) {
     if (rose->minWidth > length) {
         DEBUG_PRINTF("minwidth=%u > length=%u\n", rose->minWidth, length);
-        unmarkScratchInUse(scratch);
         return HS_SUCCESS;
     }
 
@@ -343,6 +473,14 @@ hs_error_t hs_scan(const hs_database_t *db, const char *data, unsigned length,
                      length, NULL, 0, 0, 0, flags);
 
     clearEvec(rose, scratch->core_info.exhaustionVector);
+    if (rose->ckeyCount) {
+        clearLvec(rose, scratch->core_info.logicalVector);
+        clearCvec(rose, scratch->core_info.combVector,
+                  scratch->bstate + rose->stateOffsets.activeCombVec);
+    }
+    if (rose->matchLimitCount) {
+        clearMatchCounts(rose, scratch->bstate);
+    }
 
     if (!length) {
         if (rose->boundary.reportZeroEodOffset) {
@@ -383,9 +521,16 @@ hs_error_t hs_scan(const hs_database_t *db, const char *data, unsigned length,
         // Apply the small write engine if and only if the block (buffer) is
         // small enough. Otherwise, we allow rose &co to deal with it.
         if (length < smwr->largestBuffer) {
+            if (smwr_quiet) {
+                DEBUG_PRINTF("small write screened out by batch\n");
+                goto done_scan;
+            }
             DEBUG_PRINTF("Attempting small write of block %u bytes long.\n",
                          length);
+            HS_TRACE1(small_write, length);
+            PMU_PHASE_BEGIN(scratch, pmu);
             runSmallWriteEngine(smwr, scratch);
+            PMU_PHASE_END(scratch, HS_PMU_PHASE_SMALL_WRITE, pmu);
             goto done_scan;
         }
     }
@@ -406,14 +551,12 @@ hs_error_t hs_scan(const hs_database_t *db, const char *data, unsigned length,
 
 done_scan:
     if (told_to_stop_matching(scratch)) {
-        unmarkScratchInUse(scratch);
         return HS_SCAN_TERMINATED;
     }
 
     if (rose->hasSom) {
         int halt = flushStoredSomMatches(scratch, ~0ULL);
         if (halt) {
-            unmarkScratchInUse(scratch);
             return HS_SCAN_TERMINATED;
         }
     }
@@ -424,17 +567,165 @@ done_scan:
     }
 
 set_retval:
+    if (rose->ckeyCount && !told_to_stop_matching(scratch)) {
+        roseFlushCombinations(rose, scratch, 1);
+    }
+
     DEBUG_PRINTF("done. told_to_stop_matching=%d\n",
                  told_to_stop_matching(scratch));
-    hs_error_t rv = told_to_stop_matching(scratch) ? HS_SCAN_TERMINATED
-                                                   : HS_SUCCESS;
+    return told_to_stop_matching(scratch) ? HS_SCAN_TERMINATED : HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scan(const hs_database_t *db, const char *data, unsigned length,
+                   unsigned flags, hs_scratch_t *scratch,
+                   match_event_handler onEvent, void *userCtx) {
+    if (unlikely(!scratch || !data)) {
+        return HS_INVALID;
+    }
+
+    hs_error_t err = validDatabase(db);
+    if (unlikely(err != HS_SUCCESS)) {
+        return err;
+    }
+
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    if (unlikely(!ISALIGNED_16(rose))) {
+        return HS_INVALID;
+    }
+
+    rose = roseEngineForMode(rose, HS_MODE_BLOCK);
+    if (unlikely(rose->mode != HS_MODE_BLOCK)) {
+        return HS_DB_MODE_ERROR;
+    }
+
+    if (unlikely(!validScratch(rose, scratch))) {
+        return HS_INVALID;
+    }
+
+    if (unlikely(markScratchInUse(scratch))) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    u64a start = latencyStart(scratch);
+    sampleCallBegin(scratch, rose);
+    hs_error_t rv = hs_scan_block_internal(rose, data, length, flags, scratch,
+                                           onEvent, userCtx, 0);
+    if (flushMatchBatch(scratch)) {
+        rv = HS_SCAN_TERMINATED;
+    }
+    sampleCallEnd(scratch, length);
+    latencyEnd(scratch, HS_LATENCY_CALL_SCAN, length, start);
+    unmarkScratchInUse(scratch);
+    return rv;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scan_batch(const hs_database_t *db, const char *const *data,
+                         const unsigned int *length, unsigned int count,
+                         unsigned int flags, hs_scratch_t *scratch,
+                         match_event_handler onEvent, void *const *context) {
+    if (unlikely(!scratch || (count && (!data || !length)))) {
+        return HS_INVALID;
+    }
+
+    hs_error_t err = validDatabase(db);
+    if (unlikely(err != HS_SUCCESS)) {
+        return err;
+    }
+
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    if (unlikely(!ISALIGNED_16(rose))) {
+        return HS_INVALID;
+    }
+
+    rose = roseEngineForMode(rose, HS_MODE_BLOCK);
+    if (unlikely(rose->mode != HS_MODE_BLOCK)) {
+        return HS_DB_MODE_ERROR;
+    }
+
+    if (unlikely(!validScratch(rose, scratch))) {
+        return HS_INVALID;
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        if (unlikely(!data[i])) {
+            return HS_INVALID;
+        }
+    }
+
+    if (unlikely(markScratchInUse(scratch))) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    hs_error_t rv = HS_SUCCESS;
+    u32 smwr_quiet = 0;
+    for (u32 i = 0; i < count; i++) {
+        DEBUG_PRINTF("block %u/%u len=%u\n", i, count, length[i]);
+
+        /* Walk the small write DFA over the next group of blocks in lockstep
+         * so that their table lookup chains overlap. */
+        u32 lane = i % MCCLELLAN_BATCH_LANES;
+        if (!lane) {
+            u32 group = MIN(count - i, MCCLELLAN_BATCH_LANES);
+            smwr_quiet = screenSmallWriteBatch(rose, data + i, length + i,
+                                               group);
+        }
+
+        /* Start pulling in the next buffer while we scan this one: for small
+         * blocks the loads of the next block otherwise dominate. */
+        if (i + 1 < count) {
+            prefetch_data(data[i + 1], length[i + 1]);
+        }
+
+        void *ctx = context ? context[i] : NULL;
+        hs_error_t ret = hs_scan_block_internal(rose, data[i], length[i],
+                                                flags, scratch, onEvent, ctx,
+                                                (smwr_quiet >> lane) & 1);
+        if (flushMatchBatch(scratch)) {
+            ret = HS_SCAN_TERMINATED;
+        }
+        if (ret == HS_SCAN_TERMINATED) {
+            /* Termination only applies to the block whose callback requested
+             * it; carry on with the rest of the batch. */
+            rv = HS_SCAN_TERMINATED;
+        } else if (ret != HS_SUCCESS) {
+            unmarkScratchInUse(scratch);
+            return ret;
+        }
+    }
+
     unmarkScratchInUse(scratch);
     return rv;
 }
 
+/** \brief Amount of history the stream needs to keep for its next write.
+ *
+ * The full RoseEngine::historyRequired is only needed while a non-transient
+ * leftfix is alive (it is caught up over the history) or delayed literals
+ * are waiting to be rebuilt from it. */
+static really_inline
+u32 historyToKeep(const struct RoseEngine *rose, const char *state) {
+    if (rose->idleHistoryRequired == rose->historyRequired) {
+        return rose->historyRequired;
+    }
+
+    if (getStreamStatus(state) & STATUS_DELAY_DIRTY) {
+        return rose->historyRequired;
+    }
+
+    const u8 *active = (const u8 *)state + rose->stateOffsets.activeLeftArray;
+    if (rose->activeLeftCount && mmbit_any(active, rose->activeLeftCount)) {
+        return rose->historyRequired;
+    }
+
+    return rose->idleHistoryRequired;
+}
+
 static really_inline
 void maintainHistoryBuffer(const struct RoseEngine *rose, char *state,
-                           const char *buffer, size_t length) {
+                           struct hs_stream *id, const char *buffer,
+                           size_t length) {
     if (!rose->historyRequired) {
         return;
     }
@@ -445,26 +736,48 @@ void maintainHistoryBuffer(const struct RoseEngine *rose, char *state,
         return;
     }
 
-    char *his_state = state + rose->stateOffsets.history;
+    // The history is kept at the end of the history buffer.
+    char *his_end = state + rose->stateOffsets.history + rose->historyRequired;
+    u32 keep = historyToKeep(rose, state);
+    u32 hlen = (u32)MIN((u64a)keep, (u64a)id->hlen + length);
 
-    if (length < rose->historyRequired) {
-        size_t shortfall = rose->historyRequired - length;
-        memmove(his_state, his_state + rose->historyRequired - shortfall,
-                shortfall);
+    if (length < hlen) {
+        size_t shortfall = hlen - length;
+        assert(shortfall <= id->hlen);
+        memmove(his_end - hlen, his_end - shortfall, shortfall);
     }
-    size_t amount = MIN(rose->historyRequired, length);
+    size_t amount = MIN(hlen, length);
 
-    memcpy(his_state + rose->historyRequired - amount, buffer + length - amount,
-           amount);
+    memcpy(his_end - amount, buffer + length - amount, amount);
+    id->hlen = hlen;
 #ifdef DEBUG_HISTORY
-    printf("History [%u] : ", rose->historyRequired);
-    for (size_t i = 0; i < rose->historyRequired; i++) {
-        printf(" %02hhx", his_state[i]);
+    printf("History [%u/%u] : ", hlen, rose->historyRequired);
+    for (size_t i = 0; i < hlen; i++) {
+        printf(" %02hhx", (u8)his_end[i - hlen]);
     }
     printf("\n");
 #endif
 }
 
+/** \brief Clears the status byte and the report logs of a stream. */
+static really_inline
+void init_stream_logs(const struct RoseEngine *rose, char *state) {
+    setStreamStatus(state, 0);
+
+    clearEvec(rose, state + rose->stateOffsets.exhausted);
+    if (rose->ckeyCount) {
+        clearLvec(rose, state + rose->stateOffsets.logicalVec);
+        clearCvec(rose, state + rose->stateOffsets.combVec,
+                  state + rose->stateOffsets.activeCombVec);
+    }
+    if (rose->matchLimitCount) {
+        clearMatchCounts(rose, state);
+    }
+
+    // SOM state multibit structures.
+    initSomState(rose, state);
+}
+
 static really_inline
 void init_stream(struct hs_stream *s, const struct RoseEngine *rose,
                  char init_history) {
@@ -482,46 +795,200 @@ void init_stream(struct hs_stream *s, const struct RoseEngine *rose,
 
     s->rose = rose;
     s->offset = 0;
+    s->window_min = 0;
+    s->window_max = MAX_OFFSET;
+    s->hlen = 0;
+    s->dirty = 0;
+    s->pending = 0;
 
-    setStreamStatus(state, 0);
     roseInitState(rose, state);
+    init_stream_logs(rose, state);
+}
 
-    clearEvec(rose, state + rose->stateOffsets.exhausted);
+/**
+ * \brief Returns an open stream to its freshly opened state, reinitialising
+ * only the regions that have been written since it was last initialised.
+ */
+static really_inline
+void reset_stream(struct hs_stream *s) {
+    if (s->dirty & STREAM_DIRTY_STATE) {
+        // history already initialised
+        init_stream(s, s->rose, 0);
+        return;
+    }
 
-    // SOM state multibit structures.
-    initSomState(rose, state);
+    if (s->dirty & STREAM_DIRTY_LOGS) {
+        DEBUG_PRINTF("only logs are dirty\n");
+        init_stream_logs(s->rose, getMultiState(s));
+    }
+
+    // Buffered writes are simply dropped, and the offset window goes with
+    // the data it was set for.
+    s->pending = 0;
+    s->dirty = 0;
+    s->window_min = 0;
+    s->window_max = MAX_OFFSET;
+
+    assert(!s->offset && !s->hlen);
 }
 
-HS_PUBLIC_API
-hs_error_t hs_open_stream(const hs_database_t *db, UNUSED unsigned flags,
-                          hs_stream_t **stream) {
-    if (unlikely(!stream)) {
-        return HS_INVALID;
+/**
+ * \brief Resets stream \a s to \a snapshot, a stream for the same engine that
+ * has not been written since it was initialised.
+ *
+ * A stream that is itself clean needs no work at all, and one with dirty
+ * engine state is restored with a copy rather than by initialising every
+ * engine again.
+ */
+static really_inline
+void reset_stream_to_snapshot(struct hs_stream *s,
+                              const struct hs_stream *snapshot) {
+    assert(!snapshot->dirty && !snapshot->pending);
+    assert(s != snapshot);
+
+    const struct RoseEngine *rose = snapshot->rose;
+    if (s->rose == rose && !(s->dirty & STREAM_DIRTY_STATE)) {
+        reset_stream(s);
+        return;
     }
 
-    *stream = NULL;
+    const hs_allocator_t *allocator = s->allocator;
+    u32 pending_cap = s->pending_cap;
+    memcpy(s, snapshot, sizeof(struct hs_stream) + rose->stateOffsets.end);
+    s->allocator = allocator;
+    s->pending_cap = pending_cap;
+}
 
-    hs_error_t err = validDatabase(db);
-    if (unlikely(err != HS_SUCCESS)) {
-        return err;
+/** \brief Allocates a stream of \a size bytes with the given allocator (NULL
+ * for the stream allocator), and records the allocator in it. The stream has
+ * no pending buffer. */
+static really_inline
+struct hs_stream *alloc_stream(const hs_allocator_t *allocator, size_t size) {
+    struct hs_stream *s = hs_ctx_alloc(allocator, hs_stream_alloc, size);
+    if (likely(s)) {
+        s->allocator = allocator;
+        s->pending_cap = 0;
+    }
+    return s;
+}
+
+/** \brief Frees a stream with the allocator it was allocated with. */
+static really_inline
+void free_stream(struct hs_stream *s) {
+    hs_ctx_free(s->allocator, hs_stream_free, s);
+}
+
+/** \brief Returns the streaming engine for the database, or NULL with an
+ * error in \a err. */
+static really_inline
+const struct RoseEngine *streamEngine(const hs_database_t *db,
+                                      hs_error_t *err) {
+    *err = validDatabase(db);
+    if (unlikely(*err != HS_SUCCESS)) {
+        return NULL;
     }
 
     const struct RoseEngine *rose = hs_get_bytecode(db);
     if (unlikely(!ISALIGNED_16(rose))) {
-        return HS_INVALID;
+        *err = HS_INVALID;
+        return NULL;
     }
 
+    rose = roseEngineForMode(rose, HS_MODE_STREAM);
     if (unlikely(rose->mode != HS_MODE_STREAM)) {
-        return HS_DB_MODE_ERROR;
+        *err = HS_DB_MODE_ERROR;
+        return NULL;
+    }
+
+    return rose;
+}
+
+static
+hs_error_t open_stream(const hs_database_t *db,
+                       const hs_allocator_t *allocator, u32 pending_cap,
+                       hs_stream_t **stream) {
+    if (unlikely(!stream)) {
+        return HS_INVALID;
+    }
+
+    *stream = NULL;
+
+    hs_error_t err;
+    const struct RoseEngine *rose = streamEngine(db, &err);
+    if (unlikely(!rose)) {
+        return err;
     }
 
     size_t stateSize = rose->stateOffsets.end;
-    struct hs_stream *s = hs_stream_alloc(sizeof(struct hs_stream) + stateSize);
+    struct hs_stream *s = alloc_stream(
+        allocator, sizeof(struct hs_stream) + stateSize + pending_cap);
     if (unlikely(!s)) {
         return HS_NOMEM;
     }
 
+    s->pending_cap = pending_cap;
+    init_stream(s, rose, 1);
+    HS_TRACE1(stream_open, s);
+
+    *stream = s;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_open_stream(const hs_database_t *db, UNUSED unsigned flags,
+                          hs_stream_t **stream) {
+    return open_stream(db, NULL, 0, stream);
+}
+
+HS_PUBLIC_API
+hs_error_t hs_open_stream_ex(const hs_database_t *db, UNUSED unsigned flags,
+                             const hs_allocator_t *allocator,
+                             hs_stream_t **stream) {
+    if (unlikely(!allocator || !allocator->alloc || !allocator->free)) {
+        return HS_INVALID;
+    }
+    return open_stream(db, allocator, 0, stream);
+}
+
+HS_PUBLIC_API
+hs_error_t hs_open_stream_coalesced(const hs_database_t *db,
+                                    UNUSED unsigned int flags,
+                                    unsigned int threshold,
+                                    hs_stream_t **stream) {
+    return open_stream(db, NULL, threshold, stream);
+}
+
+HS_PUBLIC_API
+hs_error_t hs_open_stream_at(const hs_database_t *db, UNUSED unsigned flags,
+                             void *mem, size_t size, hs_stream_t **stream) {
+    if (unlikely(!stream)) {
+        return HS_INVALID;
+    }
+
+    *stream = NULL;
+
+    if (unlikely(!mem)) {
+        return HS_INVALID;
+    }
+    if (unlikely(!ISALIGNED_N(mem, alignof(unsigned long long)))) {
+        return HS_BAD_ALIGN;
+    }
+
+    hs_error_t err;
+    const struct RoseEngine *rose = streamEngine(db, &err);
+    if (unlikely(!rose)) {
+        return err;
+    }
+
+    if (unlikely(size < sizeof(struct hs_stream) + rose->stateOffsets.end)) {
+        return HS_INSUFFICIENT_SPACE;
+    }
+
+    struct hs_stream *s = mem;
+    s->allocator = &hs_placement_allocator;
+    s->pending_cap = 0;
     init_stream(s, rose, 1);
+    HS_TRACE1(stream_open, s);
 
     *stream = s;
     return HS_SUCCESS;
@@ -582,10 +1049,10 @@ void soleOutfixEodExec(hs_stream_t *id, hs_scratch_t *scratch) {
 }
 
 static really_inline
-void report_eod_matches(hs_stream_t *id, hs_scratch_t *scratch,
-                        match_event_handler onEvent, void *context) {
+void report_eod_matches_i(hs_stream_t *id, hs_scratch_t *scratch,
+                          match_event_handler onEvent, void *context) {
     DEBUG_PRINTF("--- report eod matches at offset %llu\n", id->offset);
-    assert(onEvent);
+    assert(onEvent || scratch->batch.buf);
 
     const struct RoseEngine *rose = id->rose;
     char *state = getMultiState(id);
@@ -596,9 +1063,17 @@ void report_eod_matches(hs_stream_t *id, hs_scratch_t *scratch,
         return;
     }
 
+    if (id->offset < id->window_min || id->offset > id->window_max) {
+        DEBUG_PRINTF("end of data is outside the offset window\n");
+        return;
+    }
+
     populateCoreInfo(scratch, rose, state, onEvent, context, NULL, 0,
-                     getHistory(state, rose, id->offset),
-                     getHistoryAmount(rose, id->offset), id->offset, status, 0);
+                     getHistory(state, rose, id->hlen), id->hlen, id->offset,
+                     status, 0);
+    scratch->core_info.window_min = id->window_min;
+    scratch->core_info.window_max = id->window_max;
+    id->dirty |= STREAM_DIRTY_LOGS;
 
     if (rose->somLocationCount) {
         loadSomFromStream(scratch, id->offset);
@@ -621,7 +1096,10 @@ void report_eod_matches(hs_stream_t *id, hs_scratch_t *scratch,
             }
         }
 
-        if (rose->requiresEodCheck) {
+        if (rose->eodNeedsLiveState && !(status & STATUS_EOD_LIVE)) {
+            DEBUG_PRINTF("no live eod state, skipping eod program\n");
+        } else if (rose->requiresEodCheck) {
+            id->dirty |= STREAM_DIRTY_STATE;
             switch (rose->runtimeImpl) {
             default:
             case ROSE_RUNTIME_PURE_LITERAL:
@@ -643,6 +1121,28 @@ void report_eod_matches(hs_stream_t *id, hs_scratch_t *scratch,
             scratch->core_info.status |= STATUS_TERMINATED;
         }
     }
+
+    if (rose->ckeyCount && !told_to_stop_matching(scratch)) {
+        roseFlushCombinations(rose, scratch, 1);
+    }
+}
+
+static
+hs_error_t flush_pending(hs_stream_t *id, hs_scratch_t *scratch,
+                         match_event_handler onEvent, void *context);
+
+static really_inline
+void report_eod_matches(hs_stream_t *id, hs_scratch_t *scratch,
+                        match_event_handler onEvent, void *context) {
+    if (id->pending) {
+        /* Writes still buffered in a coalescing stream come before the end
+         * of data. */
+        flush_pending(id, scratch, onEvent, context);
+    }
+    report_eod_matches_i(id, scratch, onEvent, context);
+    if (flushMatchBatch(scratch)) {
+        scratch->core_info.status |= STATUS_TERMINATED;
+    }
 }
 
 HS_PUBLIC_API
@@ -660,12 +1160,14 @@ hs_error_t hs_copy_stream(hs_stream_t **to_id, const hs_stream_t *from_id) {
     const struct RoseEngine *rose = from_id->rose;
     size_t stateSize = sizeof(struct hs_stream) + rose->stateOffsets.end;
 
-    struct hs_stream *s = hs_stream_alloc(stateSize);
+    struct hs_stream *s = alloc_stream(hs_ctx_for_copy(from_id->allocator),
+                                       stateSize + from_id->pending_cap);
     if (!s) {
         return HS_NOMEM;
     }
 
-    memcpy(s, from_id, stateSize);
+    s->pending_cap = from_id->pending_cap;
+    copy_stream(s, from_id);
 
     *to_id = s;
 
@@ -690,7 +1192,12 @@ hs_error_t hs_reset_and_copy_stream(hs_stream_t *to_id,
         return HS_INVALID;
     }
 
-    if (onEvent) {
+    if (from_id->pending > to_id->pending_cap) {
+        DEBUG_PRINTF("no room for %u pending bytes\n", from_id->pending);
+        return HS_INVALID;
+    }
+
+    if (matchesWanted(onEvent, scratch)) {
         if (!scratch || !validScratch(to_id->rose, scratch)) {
             return HS_INVALID;
         }
@@ -701,10 +1208,11 @@ hs_error_t hs_reset_and_copy_stream(hs_stream_t *to_id,
         unmarkScratchInUse(scratch);
     }
 
-    size_t stateSize
-        = sizeof(struct hs_stream) + from_id->rose->stateOffsets.end;
-
-    memcpy(to_id, from_id, stateSize);
+    if (!from_id->dirty) {
+        reset_stream_to_snapshot(to_id, from_id);
+    } else {
+        copy_stream(to_id, from_id);
+    }
 
     return HS_SUCCESS;
 }
@@ -754,15 +1262,19 @@ void pureLiteralStreamExec(struct hs_stream *stream_state,
                  stream_state->offset, scratch->core_info.len);
 
     // RoseContext values that need to be set for use by roseCallback.
-    scratch->tctxt.groups = loadGroups(rose, scratch->core_info.state);
+    scratch->tctxt.groups = loadGroups(rose, scratch->core_info.state) &
+                            patternMaskGroups(scratch);
     scratch->tctxt.lit_offset_adjust = scratch->core_info.buf_offset + 1;
 
     // Pure literal cases don't have floatingMinDistance set, so we always
     // start the match region at zero.
     const size_t start = 0;
 
+    PMU_PHASE_BEGIN(scratch, pmu);
     hwlmExecStreaming(ftable, scratch, len2, start, roseCallback,
-                      scratch, rose->initialGroups, hwlm_stream_state);
+                      scratch, rose->initialGroups & patternMaskGroups(scratch),
+                      hwlm_stream_state);
+    PMU_PHASE_END(scratch, HS_PMU_PHASE_LITERAL_MATCHER, pmu);
 
     if (!told_to_stop_matching(scratch) &&
         isAllExhausted(rose, scratch->core_info.exhaustionVector)) {
@@ -807,6 +1319,16 @@ void soleOutfixStreamExec(struct hs_stream *stream_state,
     }
 }
 
+/** \brief Pull in the hot part of a stream's state; the rest is only touched
+ * by rarer events, such as suffix engines being triggered. */
+static really_inline
+void prefetch_stream_state(const char *state, const struct RoseEngine *rose) {
+    u32 len = rose->stateOffsets.hotEnd;
+    for (u32 i = 0; i < len; i += 64) {
+        __builtin_prefetch(state + i);
+    }
+}
+
 static inline
 hs_error_t hs_scan_stream_internal(hs_stream_t *id, const char *data,
                                    unsigned length, UNUSED unsigned flags,
@@ -822,6 +1344,13 @@ hs_error_t hs_scan_stream_internal(hs_stream_t *id, const char *data,
     const struct RoseEngine *rose = id->rose;
     char *state = getMultiState(id);
 
+    /* The state of a resumed stream has usually left the cache since its
+     * last write, so request all of its hot lines at once rather than
+     * stalling on each in turn as the scan reaches it. */
+    if (id->offset) {
+        prefetch_stream_state(state, rose);
+    }
+
     u8 status = getStreamStatus(state);
     if (status & (STATUS_TERMINATED | STATUS_EXHAUSTED)) {
         DEBUG_PRINTF("stream is broken, halting scan\n");
@@ -840,10 +1369,38 @@ hs_error_t hs_scan_stream_internal(hs_stream_t *id, const char *data,
         return HS_SUCCESS;
     }
 
-    u32 historyAmount = getHistoryAmount(rose, id->offset);
+    // Matches in this write end after the current offset, so none are
+    // possible once the stream has passed the last offset any pattern can
+    // match at, or the end of its offset window. The stream is marked
+    // exhausted, which also stops any matches at end of data, and is never
+    // scanned again. Matches at offset zero are raised by the first write, so
+    // it is always scanned.
+    const u64a max_offset = MIN(rose->maxMatchOffset, id->window_max);
+    if (unlikely(id->offset && id->offset >= max_offset)) {
+        DEBUG_PRINTF("stream offset %llu past max match offset %llu\n",
+                     id->offset, max_offset);
+        setStreamStatus(state, status | STATUS_EXHAUSTED);
+        id->dirty |= STREAM_DIRTY_LOGS;
+        return HS_SUCCESS;
+    }
+
+    // A write that runs past the end of the window only needs to be scanned
+    // up to it, plus a byte for matches raised by the byte that follows them.
+    // The rest of the data is skipped and the stream is exhausted afterwards.
+    char past_window = 0;
+    if (unlikely(id->window_max - id->offset < length)) {
+        length = (unsigned)(id->window_max - id->offset) + 1;
+        past_window = 1;
+        DEBUG_PRINTF("write passes window end %llu, scanning %u bytes\n",
+                     id->window_max, length);
+    }
+
+    id->dirty = STREAM_DIRTY_ALL;
     populateCoreInfo(scratch, rose, state, onEvent, context, data, length,
-                     getHistory(state, rose, id->offset), historyAmount,
-                     id->offset, status, flags);
+                     getHistory(state, rose, id->hlen), id->hlen, id->offset,
+                     status, flags);
+    scratch->core_info.window_min = id->window_min;
+    scratch->core_info.window_max = id->window_max;
     assert(scratch->core_info.hlen <= id->offset
            && scratch->core_info.hlen <= rose->historyRequired);
 
@@ -889,10 +1446,14 @@ hs_error_t hs_scan_stream_internal(hs_stream_t *id, const char *data,
         }
     }
 
+    if (rose->ckeyCount && !told_to_stop_matching(scratch)) {
+        roseFlushCombinations(rose, scratch, 0);
+    }
+
     setStreamStatus(state, scratch->core_info.status);
 
     if (likely(!can_stop_matching(scratch))) {
-        maintainHistoryBuffer(rose, state, data, length);
+        maintainHistoryBuffer(rose, state, id, data, length);
         id->offset += length; /* maintain offset */
 
         if (rose->somLocationCount) {
@@ -902,9 +1463,93 @@ hs_error_t hs_scan_stream_internal(hs_stream_t *id, const char *data,
         return HS_SCAN_TERMINATED;
     }
 
+    if (unlikely(past_window)) {
+        setStreamStatus(state, getStreamStatus(state) | STATUS_EXHAUSTED);
+    }
+
     return HS_SUCCESS;
 }
 
+/**
+ * \brief Hands any matches left in the scratch's match buffer to the batch
+ * handler after a write to stream \a id, terminating the stream if the
+ * handler asks for matching to stop.
+ */
+static really_inline
+hs_error_t flushStreamMatchBatch(hs_stream_t *id, hs_scratch_t *scratch,
+                                 hs_error_t rv) {
+    if (!flushMatchBatch(scratch) || rv != HS_SUCCESS) {
+        return rv;
+    }
+
+    char *state = getMultiState(id);
+    setStreamStatus(state, getStreamStatus(state) | STATUS_TERMINATED);
+    id->dirty |= STREAM_DIRTY_LOGS;
+    return HS_SCAN_TERMINATED;
+}
+
+/** \brief Scans the writes buffered in coalescing stream \a id, reporting
+ * their matches to \a onEvent. */
+static
+hs_error_t flush_pending(hs_stream_t *id, hs_scratch_t *scratch,
+                         match_event_handler onEvent, void *context) {
+    u32 len = id->pending;
+    if (!len) {
+        return HS_SUCCESS;
+    }
+
+    DEBUG_PRINTF("flushing %u pending bytes at offset %llu\n", len,
+                 id->offset);
+    id->pending = 0;
+    hs_error_t rv = hs_scan_stream_internal(id, getPendingBuf(id), len, 0,
+                                            scratch, onEvent, context);
+    return flushStreamMatchBatch(id, scratch, rv);
+}
+
+/**
+ * \brief Writes data to stream \a id.
+ *
+ * A coalescing stream holds small writes in its pending buffer and scans them
+ * together once the buffer fills, so that a run of tiny writes pays for one
+ * scan rather than one each; a write that would overflow the buffer flushes
+ * it first. Stream offsets only advance as data is scanned, so the matches
+ * are the same as if every write had been scanned as it came, but matches in
+ * buffered data are reported to the callback of the call that scans them.
+ */
+static really_inline
+hs_error_t scan_stream_write(hs_stream_t *id, const char *data,
+                             unsigned length, unsigned flags,
+                             hs_scratch_t *scratch,
+                             match_event_handler onEvent, void *context) {
+    const u32 cap = id->pending_cap;
+    if (likely(!cap) ||
+        (getStreamStatus(getMultiState(id)) &
+         (STATUS_TERMINATED | STATUS_EXHAUSTED))) {
+        assert(!id->pending);
+        return hs_scan_stream_internal(id, data, length, flags, scratch,
+                                       onEvent, context);
+    }
+
+    if (length > cap - id->pending) {
+        hs_error_t rv = flush_pending(id, scratch, onEvent, context);
+        if (rv != HS_SUCCESS) {
+            return rv;
+        }
+        if (length >= cap) {
+            return hs_scan_stream_internal(id, data, length, flags, scratch,
+                                           onEvent, context);
+        }
+    }
+
+    memcpy(getPendingBuf(id) + id->pending, data, length);
+    id->pending += length;
+    id->dirty |= STREAM_DIRTY_PENDING;
+    if (id->pending < cap) {
+        return HS_SUCCESS;
+    }
+    return flush_pending(id, scratch, onEvent, context);
+}
+
 HS_PUBLIC_API
 hs_error_t hs_scan_stream(hs_stream_t *id, const char *data, unsigned length,
                           unsigned flags, hs_scratch_t *scratch,
@@ -917,12 +1562,207 @@ hs_error_t hs_scan_stream(hs_stream_t *id, const char *data, unsigned length,
     if (unlikely(markScratchInUse(scratch))) {
         return HS_SCRATCH_IN_USE;
     }
-    hs_error_t rv = hs_scan_stream_internal(id, data, length, flags, scratch,
-                                            onEvent, context);
+    u64a start = latencyStart(scratch);
+    sampleCallBegin(scratch, id->rose);
+    hs_error_t rv = scan_stream_write(id, data, length, flags, scratch,
+                                      onEvent, context);
+    rv = flushStreamMatchBatch(id, scratch, rv);
+    sampleCallEnd(scratch, length);
+    latencyEnd(scratch, HS_LATENCY_CALL_SCAN_STREAM, length, start);
+    unmarkScratchInUse(scratch);
+    return rv;
+}
+
+/** \brief Most engines whose bytecode hs_prefetch_stream() pulls in; beyond
+ * this the prefetches would only evict each other. */
+#define PREFETCH_MAX_ENGINES 8
+
+HS_PUBLIC_API
+hs_error_t hs_prefetch_stream(const hs_stream_t *id) {
+    if (unlikely(!id)) {
+        return HS_INVALID;
+    }
+
+    /* The header must be read to find the engine, so this load is the only
+     * one that may stall. */
+    const struct RoseEngine *rose = id->rose;
+    const char *state = getMultiStateConst(id);
+    __builtin_prefetch(rose);
+    prefetch_stream_state(state, rose);
+
+    /* The floating matcher and the engines that are live for the whole
+     * stream, the MPV and outfixes, run on nearly every write. Suffixes are
+     * skipped: finding the live ones would read the state being fetched. */
+    const struct HWLM *ftable = getFLiteralMatcher(rose);
+    if (ftable) {
+        __builtin_prefetch(ftable);
+    }
+    u32 count = MIN(rose->outfixEndQueue, PREFETCH_MAX_ENGINES);
+    for (u32 qi = 0; qi < count; qi++) {
+        const struct NFA *nfa = getNfaByQueue(rose, qi);
+        __builtin_prefetch(nfa);
+        __builtin_prefetch((const char *)nfa + 64);
+    }
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scan_stream_partial(hs_stream_t *id, const char *data,
+                                  unsigned length, unsigned flags,
+                                  unsigned budget, hs_scratch_t *scratch,
+                                  match_event_handler onEvent, void *context,
+                                  unsigned *consumed) {
+    if (unlikely(!id || !scratch || !data || !budget || !consumed ||
+                 !validScratch(id->rose, scratch))) {
+        return HS_INVALID;
+    }
+
+    /* Stream semantics make a write of part of the data followed by a write
+     * of the rest equivalent to one write of all of it, so the stream state
+     * is all the continuation we need. */
+    const unsigned len = MIN(length, budget);
+    DEBUG_PRINTF("scanning %u of %u bytes\n", len, length);
+
+    *consumed = 0;
+    if (unlikely(markScratchInUse(scratch))) {
+        return HS_SCRATCH_IN_USE;
+    }
+    /* The budget bounds the scan, so this is never buffered; earlier writes
+     * that were are scanned first. */
+    hs_error_t rv = flush_pending(id, scratch, onEvent, context);
+    if (rv == HS_SUCCESS) {
+        rv = hs_scan_stream_internal(id, data, len, flags, scratch, onEvent,
+                                     context);
+        rv = flushStreamMatchBatch(id, scratch, rv);
+    }
+    unmarkScratchInUse(scratch);
+
+    if (rv != HS_SUCCESS && rv != HS_SCAN_TERMINATED) {
+        return rv;
+    }
+    *consumed = len;
+    if (rv == HS_SUCCESS && len < length) {
+        return HS_SCAN_YIELD;
+    }
+    return rv;
+}
+
+/** \brief Pull in the header and state of a stream that is about to be
+ * scanned. */
+static really_inline
+void prefetch_stream(const struct hs_stream *id) {
+    __builtin_prefetch(id);
+    prefetch_stream_state(getMultiStateConst(id), id->rose);
+}
+
+HS_PUBLIC_API
+hs_error_t hs_check_utf8(const char *data, unsigned int length,
+                         unsigned int *error_offset) {
+    if (unlikely(!data || !error_offset)) {
+        return HS_INVALID;
+    }
+
+    *error_offset = (unsigned int)utf8_check((const u8 *)data, length);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scan_stream_batch(hs_stream_t *const *ids,
+                                const char *const *data,
+                                const unsigned int *length, unsigned int count,
+                                unsigned int flags, hs_scratch_t *scratch,
+                                match_event_handler onEvent,
+                                void *const *context) {
+    if (unlikely(!scratch || (count && (!ids || !data || !length)))) {
+        return HS_INVALID;
+    }
+
+    /* Bursts usually come from one database, so only check the scratch
+     * again when the database changes. */
+    const struct RoseEngine *checked = NULL;
+    for (u32 i = 0; i < count; i++) {
+        if (unlikely(!ids[i] || !data[i])) {
+            return HS_INVALID;
+        }
+        if (ids[i]->rose != checked) {
+            if (unlikely(!validScratch(ids[i]->rose, scratch))) {
+                return HS_INVALID;
+            }
+            checked = ids[i]->rose;
+        }
+    }
+
+    if (unlikely(markScratchInUse(scratch))) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    hs_error_t rv = HS_SUCCESS;
+    for (u32 i = 0; i < count; i++) {
+        DEBUG_PRINTF("stream %u/%u len=%u\n", i, count, length[i]);
+
+        /* Each write is short-lived, so pull in the next stream's state and
+         * data while this one is scanned rather than stalling on them. */
+        if (i + 1 < count) {
+            prefetch_stream(ids[i + 1]);
+            prefetch_data(data[i + 1], length[i + 1]);
+        }
+
+        void *ctx = context ? context[i] : NULL;
+        hs_error_t ret = scan_stream_write(ids[i], data[i], length[i], flags,
+                                           scratch, onEvent, ctx);
+        ret = flushStreamMatchBatch(ids[i], scratch, ret);
+        if (ret == HS_SCAN_TERMINATED) {
+            /* As in hs_scan_batch, termination only affects the stream whose
+             * callback requested it. */
+            rv = HS_SCAN_TERMINATED;
+        } else if (ret != HS_SUCCESS) {
+            unmarkScratchInUse(scratch);
+            return ret;
+        }
+    }
+
+    unmarkScratchInUse(scratch);
+    return rv;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_flush_stream(hs_stream_t *id, UNUSED unsigned int flags,
+                           hs_scratch_t *scratch, match_event_handler onEvent,
+                           void *context) {
+    if (unlikely(!id || !scratch || !validScratch(id->rose, scratch))) {
+        return HS_INVALID;
+    }
+
+    if (!id->pending) {
+        return HS_SUCCESS;
+    }
+
+    if (unlikely(markScratchInUse(scratch))) {
+        return HS_SCRATCH_IN_USE;
+    }
+    u64a start = latencyStart(scratch);
+    sampleCallBegin(scratch, id->rose);
+    u32 len = id->pending;
+    hs_error_t rv = flush_pending(id, scratch, onEvent, context);
+    sampleCallEnd(scratch, len);
+    latencyEnd(scratch, HS_LATENCY_CALL_SCAN_STREAM, len, start);
     unmarkScratchInUse(scratch);
     return rv;
 }
 
+HS_PUBLIC_API
+hs_error_t hs_set_stream_window(hs_stream_t *id, unsigned long long min_offset,
+                                unsigned long long max_offset) {
+    if (unlikely(!id || !id->rose || min_offset > max_offset)) {
+        return HS_INVALID;
+    }
+
+    id->window_min = min_offset;
+    id->window_max = max_offset;
+    return HS_SUCCESS;
+}
+
 HS_PUBLIC_API
 hs_error_t hs_close_stream(hs_stream_t *id, hs_scratch_t *scratch,
                            match_event_handler onEvent, void *context) {
@@ -930,18 +1770,23 @@ hs_error_t hs_close_stream(hs_stream_t *id, hs_scratch_t *scratch,
         return HS_INVALID;
     }
 
-    if (onEvent) {
+    if (matchesWanted(onEvent, scratch)) {
         if (!scratch || !validScratch(id->rose, scratch)) {
             return HS_INVALID;
         }
         if (unlikely(markScratchInUse(scratch))) {
             return HS_SCRATCH_IN_USE;
         }
+        u64a start = latencyStart(scratch);
+        sampleCallBegin(scratch, id->rose);
         report_eod_matches(id, scratch, onEvent, context);
+        sampleCallEnd(scratch, 0);
+        latencyEnd(scratch, HS_LATENCY_CALL_CLOSE_STREAM, 0, start);
         unmarkScratchInUse(scratch);
     }
 
-    hs_stream_free(id);
+    HS_TRACE2(stream_close, id, id->offset);
+    free_stream(id);
 
     return HS_SUCCESS;
 }
@@ -954,7 +1799,7 @@ hs_error_t hs_reset_stream(hs_stream_t *id, UNUSED unsigned int flags,
         return HS_INVALID;
     }
 
-    if (onEvent) {
+    if (matchesWanted(onEvent, scratch)) {
         if (!scratch || !validScratch(id->rose, scratch)) {
             return HS_INVALID;
         }
@@ -965,120 +1810,905 @@ hs_error_t hs_reset_stream(hs_stream_t *id, UNUSED unsigned int flags,
         unmarkScratchInUse(scratch);
     }
 
-    // history already initialised
-    init_stream(id, id->rose, 0);
+    reset_stream(id);
 
     return HS_SUCCESS;
 }
 
 HS_PUBLIC_API
-hs_error_t hs_stream_size(const hs_database_t *db, size_t *stream_size) {
-    if (!stream_size) {
+hs_error_t hs_alloc_stream_pool(const hs_database_t *db, unsigned int count,
+                                hs_stream_pool_t **pool) {
+    if (!pool) {
         return HS_INVALID;
     }
 
-    hs_error_t ret = validDatabase(db);
-    if (ret != HS_SUCCESS) {
-        return ret;
+    *pool = NULL;
+
+    if (!count) {
+        return HS_INVALID;
+    }
+
+    hs_error_t err = validDatabase(db);
+    if (unlikely(err != HS_SUCCESS)) {
+        return err;
     }
 
     const struct RoseEngine *rose = hs_get_bytecode(db);
-    if (!ISALIGNED_16(rose)) {
+    if (unlikely(!ISALIGNED_16(rose))) {
         return HS_INVALID;
     }
 
-    if (rose->mode != HS_MODE_STREAM) {
+    rose = roseEngineForMode(rose, HS_MODE_STREAM);
+    if (unlikely(rose->mode != HS_MODE_STREAM)) {
         return HS_DB_MODE_ERROR;
     }
 
-    u32 base_stream_size = rose->stateOffsets.end;
+    size_t slotSize = ROUNDUP_CL(sizeof(struct hs_stream)
+                                 + rose->stateOffsets.end);
+    size_t headerSize = ROUNDUP_CL(sizeof(struct hs_stream_pool)
+                                   + (sizeof(u32) + sizeof(u8)) * count);
+    if (slotSize > ~0U
+        || (size_t)count >= (SIZE_MAX - headerSize) / slotSize) {
+        return HS_NOMEM;
+    }
 
-    // stream state plus the hs_stream struct itself
-    *stream_size = base_stream_size + sizeof(struct hs_stream);
+    /* the pool header, free list and flags plus the slots and the pristine
+     * stream plus padding for cacheline alignment */
+    size_t allocSize = headerSize + slotSize * ((size_t)count + 1) + 64;
+    char *p_tmp = hs_stream_alloc(allocSize);
+    err = hs_check_alloc(p_tmp);
+    if (err != HS_SUCCESS) {
+        hs_stream_free(p_tmp);
+        return err;
+    }
 
+    memset(p_tmp, 0, headerSize + 64);
+    struct hs_stream_pool *p =
+        (struct hs_stream_pool *)ROUNDUP_PTR(p_tmp, 64);
+    DEBUG_PRINTF("allocated %zu bytes at %p but realigning to %p\n",
+                 allocSize, p_tmp, p);
+
+    p->magic = STREAM_POOL_MAGIC;
+    p->count = count;
+    p->freeCount = count;
+    p->slotSize = (u32)slotSize;
+    p->poolSize = allocSize;
+    p->rose = rose;
+    p->freeList = (u32 *)((char *)p + sizeof(*p));
+    p->used = (u8 *)(p->freeList + count);
+    p->slots = (char *)p + headerSize;
+    p->pool_alloc = p_tmp;
+    assert(ISALIGNED_CL(p->slots));
+
+    /* hand out low slots first, so that a lightly used pool stays compact */
+    for (u32 i = 0; i < count; i++) {
+        p->freeList[i] = count - 1 - i;
+        /* not yet a stream: taking the slot copies in the pristine stream */
+        struct hs_stream *slot =
+            (struct hs_stream *)(p->slots + (size_t)i * slotSize);
+        slot->rose = NULL;
+        slot->allocator = &hs_placement_allocator; /* owned by the pool */
+        slot->pending_cap = 0;
+    }
+
+    /* Streams are opened by resetting their slot to a stream initialised
+     * once here, which only costs a copy for slots that have not been used
+     * before or that were scanned. */
+    p->pristine = (struct hs_stream *)(p->slots + (size_t)count * slotSize);
+    p->pristine->allocator = &hs_placement_allocator;
+    p->pristine->pending_cap = 0;
+    init_stream(p->pristine, rose, 1);
+
+    *pool = p;
     return HS_SUCCESS;
 }
 
-#if defined(DEBUG) || defined(DUMP_SUPPORT)
-#include "util/compare.h"
-// A debugging crutch: print a hex-escaped version of the match for our
-// perusal.
-static UNUSED
-void dumpData(const char *data, size_t len) {
-    DEBUG_PRINTF("BUFFER:");
-    for (size_t i = 0; i < len; i++) {
-        u8 c = data[i];
-        if (ourisprint(c) && c != '\'') {
-            printf("%c", c);
-        } else {
-            printf("\\x%02x", c);
-        }
-    }
-    printf("\n");
+static really_inline
+char validStreamPool(const struct hs_stream_pool *pool) {
+    return pool && ISALIGNED_CL(pool) && pool->magic == STREAM_POOL_MAGIC;
 }
-#endif
 
 HS_PUBLIC_API
-hs_error_t hs_scan_vector(const hs_database_t *db, const char * const * data,
-                          const unsigned int *length, unsigned int count,
-                          UNUSED unsigned int flags, hs_scratch_t *scratch,
-                          match_event_handler onEvent, void *context) {
-    if (unlikely(!scratch || !data || !length)) {
-        return HS_INVALID;
+hs_error_t hs_free_stream_pool(hs_stream_pool_t *pool) {
+    if (!pool) {
+        return HS_SUCCESS;
     }
 
-    hs_error_t err = validDatabase(db);
-    if (unlikely(err != HS_SUCCESS)) {
-        return err;
+    if (!validStreamPool(pool)) {
+        return HS_INVALID;
     }
 
-    const struct RoseEngine *rose = hs_get_bytecode(db);
-    if (unlikely(!ISALIGNED_16(rose))) {
+    pool->magic = 0;
+    hs_stream_free(pool->pool_alloc);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_stream_pool_size(const hs_stream_pool_t *pool,
+                               size_t *pool_size) {
+    if (!pool_size || !validStreamPool(pool)) {
         return HS_INVALID;
     }
 
-    if (unlikely(rose->mode != HS_MODE_VECTORED)) {
-        return HS_DB_MODE_ERROR;
+    *pool_size = pool->poolSize;
+    return HS_SUCCESS;
+}
+
+static really_inline
+struct hs_stream *poolTakeStream(struct hs_stream_pool *pool) {
+    assert(pool->freeCount);
+    u32 slot = pool->freeList[--pool->freeCount];
+    assert(slot < pool->count);
+    assert(!pool->used[slot]);
+    pool->used[slot] = 1;
+
+    struct hs_stream *s =
+        (struct hs_stream *)(pool->slots + (size_t)slot * pool->slotSize);
+    reset_stream_to_snapshot(s, pool->pristine);
+    HS_TRACE1(stream_open, s);
+    return s;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_open_stream_from_pool(hs_stream_pool_t *pool,
+                                    UNUSED unsigned int flags,
+                                    hs_stream_t **stream) {
+    if (unlikely(!stream)) {
+        return HS_INVALID;
     }
 
-    if (unlikely(!validScratch(rose, scratch))) {
+    *stream = NULL;
+
+    if (unlikely(!validStreamPool(pool))) {
         return HS_INVALID;
     }
 
-    if (unlikely(markScratchInUse(scratch))) {
-        return HS_SCRATCH_IN_USE;
+    if (unlikely(!pool->freeCount)) {
+        DEBUG_PRINTF("pool is empty\n");
+        return HS_NOMEM;
     }
 
-    hs_stream_t *id = (hs_stream_t *)(scratch->bstate);
+    *stream = poolTakeStream(pool);
+    return HS_SUCCESS;
+}
 
-    init_stream(id, rose, 1); /* open stream */
+HS_PUBLIC_API
+hs_error_t hs_open_stream_bulk(hs_stream_pool_t *pool,
+                               UNUSED unsigned int flags, unsigned int count,
+                               hs_stream_t **streams) {
+    if (unlikely(!streams || !validStreamPool(pool))) {
+        return HS_INVALID;
+    }
+
+    if (unlikely(count > pool->freeCount)) {
+        DEBUG_PRINTF("pool has %u free streams, %u requested\n",
+                     pool->freeCount, count);
+        return HS_NOMEM;
+    }
 
     for (u32 i = 0; i < count; i++) {
-        DEBUG_PRINTF("block %u/%u offset=%llu len=%u\n", i, count, id->offset,
-                     length[i]);
-#ifdef DEBUG
-        dumpData(data[i], length[i]);
-#endif
-        hs_error_t ret
-            = hs_scan_stream_internal(id, data[i], length[i], 0, scratch,
-                                      onEvent, context);
-        if (ret != HS_SUCCESS) {
-            unmarkScratchInUse(scratch);
-            return ret;
-        }
+        streams[i] = poolTakeStream(pool);
     }
 
-    /* close stream */
-    if (onEvent) {
-        report_eod_matches(id, scratch, onEvent, context);
+    return HS_SUCCESS;
+}
 
-        if (told_to_stop_matching(scratch)) {
-            unmarkScratchInUse(scratch);
-            return HS_SCAN_TERMINATED;
+/** \brief Returns the slot index of stream \a id in \a pool, or
+ * pool->count if it is not an open stream from this pool. */
+static really_inline
+u32 poolSlotForStream(const struct hs_stream_pool *pool,
+                      const struct hs_stream *id) {
+    const char *p = (const char *)id;
+    if (p < pool->slots) {
+        return pool->count;
+    }
+    size_t offset = (size_t)(p - pool->slots);
+    if (offset % pool->slotSize) {
+        return pool->count;
+    }
+    size_t slot = offset / pool->slotSize;
+    if (slot >= pool->count || !pool->used[slot]) {
+        return pool->count;
+    }
+    return (u32)slot;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_close_stream_to_pool(hs_stream_pool_t *pool, hs_stream_t *id,
+                                   hs_scratch_t *scratch,
+                                   match_event_handler onEvent,
+                                   void *context) {
+    if (!id || !validStreamPool(pool)) {
+        return HS_INVALID;
+    }
+
+    u32 slot = poolSlotForStream(pool, id);
+    if (slot == pool->count) {
+        DEBUG_PRINTF("stream %p is not open in pool %p\n", id, pool);
+        return HS_INVALID;
+    }
+
+    if (matchesWanted(onEvent, scratch)) {
+        if (!scratch || !validScratch(id->rose, scratch)) {
+            return HS_INVALID;
+        }
+        if (unlikely(markScratchInUse(scratch))) {
+            return HS_SCRATCH_IN_USE;
+        }
+        report_eod_matches(id, scratch, onEvent, context);
+        unmarkScratchInUse(scratch);
+    }
+
+    HS_TRACE2(stream_close, id, id->offset);
+    assert(pool->freeCount < pool->count);
+    pool->used[slot] = 0;
+    pool->freeList[pool->freeCount++] = slot;
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_reset_stream_bulk(hs_stream_t *const *ids, unsigned int count,
+                                UNUSED unsigned int flags,
+                                hs_scratch_t *scratch,
+                                match_event_handler onEvent,
+                                void *const *context) {
+    if (!ids) {
+        return HS_INVALID;
+    }
+
+    if (!count) {
+        return HS_SUCCESS;
+    }
+
+    const struct RoseEngine *rose = ids[0] ? ids[0]->rose : NULL;
+    if (!rose) {
+        return HS_INVALID;
+    }
+    for (u32 i = 1; i < count; i++) {
+        if (!ids[i] || ids[i]->rose != rose) {
+            return HS_INVALID;
+        }
+    }
+
+    if (matchesWanted(onEvent, scratch)) {
+        if (!scratch || !validScratch(rose, scratch)) {
+            return HS_INVALID;
+        }
+        if (unlikely(markScratchInUse(scratch))) {
+            return HS_SCRATCH_IN_USE;
+        }
+        for (u32 i = 0; i < count; i++) {
+            report_eod_matches(ids[i], scratch, onEvent,
+                               context ? context[i] : NULL);
+        }
+        unmarkScratchInUse(scratch);
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        reset_stream(ids[i]);
+    }
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_stream_size(const hs_database_t *db, size_t *stream_size) {
+    if (!stream_size) {
+        return HS_INVALID;
+    }
+
+    hs_error_t ret = validDatabase(db);
+    if (ret != HS_SUCCESS) {
+        return ret;
+    }
+
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    if (!ISALIGNED_16(rose)) {
+        return HS_INVALID;
+    }
+
+    rose = roseEngineForMode(rose, HS_MODE_STREAM);
+    if (rose->mode != HS_MODE_STREAM) {
+        return HS_DB_MODE_ERROR;
+    }
+
+    u32 base_stream_size = rose->stateOffsets.end;
+
+    // stream state plus the hs_stream struct itself
+    *stream_size = base_stream_size + sizeof(struct hs_stream);
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_compress_stream(const hs_stream_t *stream, char *buf,
+                              size_t buf_space, size_t *used_space) {
+    if (unlikely(!stream || !stream->rose || !used_space)) {
+        return HS_INVALID;
+    }
+
+    /* The compressed form has no room for buffered writes. */
+    if (unlikely(stream->pending)) {
+        return HS_INVALID;
+    }
+
+    if (unlikely(buf_space && !buf)) {
+        return HS_INVALID;
+    }
+
+    size_t stream_size = compressed_stream_size(stream);
+    DEBUG_PRINTF("compressed size %zu (uncompressed %zu)\n", stream_size,
+                 sizeof(struct hs_stream) + stream->rose->stateOffsets.end);
+
+    if (buf_space < stream_size) {
+        *used_space = stream_size;
+        return HS_INSUFFICIENT_SPACE;
+    }
+
+    *used_space = compress_stream(buf, buf_space, stream);
+    assert(*used_space == stream_size);
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_expand_stream(const hs_database_t *db, hs_stream_t **stream,
+                            const char *buf, size_t buf_size) {
+    if (unlikely(!stream || !buf)) {
+        return HS_INVALID;
+    }
+
+    *stream = NULL;
+
+    hs_error_t err = validDatabase(db);
+    if (unlikely(err != HS_SUCCESS)) {
+        return err;
+    }
+
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    if (unlikely(!ISALIGNED_16(rose))) {
+        return HS_INVALID;
+    }
+
+    rose = roseEngineForMode(rose, HS_MODE_STREAM);
+    if (unlikely(rose->mode != HS_MODE_STREAM)) {
+        return HS_DB_MODE_ERROR;
+    }
+
+    size_t stateSize = sizeof(struct hs_stream) + rose->stateOffsets.end;
+
+    struct hs_stream *s = alloc_stream(NULL, stateSize);
+    if (unlikely(!s)) {
+        return HS_NOMEM;
+    }
+
+    if (!expand_stream(s, rose, buf, buf_size)) {
+        free_stream(s);
+        return HS_INVALID;
+    }
+
+    *stream = s;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_reset_and_expand_stream(hs_stream_t *to_stream,
+                                      const char *buf, size_t buf_size,
+                                      hs_scratch_t *scratch,
+                                      match_event_handler onEvent,
+                                      void *context) {
+    if (unlikely(!to_stream || !to_stream->rose || !buf)) {
+        return HS_INVALID;
+    }
+
+    const struct RoseEngine *rose = to_stream->rose;
+
+    if (matchesWanted(onEvent, scratch)) {
+        if (!scratch || !validScratch(rose, scratch)) {
+            return HS_INVALID;
+        }
+        if (unlikely(markScratchInUse(scratch))) {
+            return HS_SCRATCH_IN_USE;
+        }
+        report_eod_matches(to_stream, scratch, onEvent, context);
+        unmarkScratchInUse(scratch);
+    }
+
+    if (!expand_stream(to_stream, rose, buf, buf_size)) {
+        return HS_INVALID;
+    }
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_serialize_stream(const hs_database_t *db,
+                               const hs_stream_t *stream, char *buf,
+                               size_t buf_space, size_t *used_space) {
+    if (unlikely(!stream || !stream->rose || !used_space ||
+                 stream->pending)) {
+        return HS_INVALID;
+    }
+
+    if (unlikely(buf_space && !buf)) {
+        return HS_INVALID;
+    }
+
+    hs_error_t err = validDatabase(db);
+    if (unlikely(err != HS_SUCCESS)) {
+        return err;
+    }
+
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    if (unlikely(!ISALIGNED_16(rose))) {
+        return HS_INVALID;
+    }
+
+    rose = roseEngineForMode(rose, HS_MODE_STREAM);
+    if (unlikely(rose != stream->rose)) {
+        return HS_INVALID;
+    }
+
+    struct hs_serialized_stream_header header;
+    size_t stream_size = compressed_stream_size(stream);
+    size_t size = sizeof(header) + stream_size;
+    if (unlikely(stream_size > ~0U)) {
+        return HS_INVALID;
+    }
+
+    if (buf_space < size) {
+        *used_space = size;
+        return HS_INSUFFICIENT_SPACE;
+    }
+
+    header.magic = STREAM_SERIAL_MAGIC;
+    header.version = HS_DB_VERSION;
+    header.crc32 = db->crc32;
+    header.length = (u32)stream_size;
+    memcpy(buf, &header, sizeof(header));
+
+    UNUSED size_t used = compress_stream(buf + sizeof(header),
+                                         buf_space - sizeof(header), stream);
+    assert(used == stream_size);
+
+    *used_space = size;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_deserialize_stream(const hs_database_t *db, const char *buf,
+                                 size_t buf_size, hs_stream_t **stream) {
+    if (unlikely(!stream || !buf)) {
+        return HS_INVALID;
+    }
+
+    *stream = NULL;
+
+    hs_error_t err = validDatabase(db);
+    if (unlikely(err != HS_SUCCESS)) {
+        return err;
+    }
+
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    if (unlikely(!ISALIGNED_16(rose))) {
+        return HS_INVALID;
+    }
+
+    rose = roseEngineForMode(rose, HS_MODE_STREAM);
+    if (unlikely(rose->mode != HS_MODE_STREAM)) {
+        return HS_DB_MODE_ERROR;
+    }
+
+    struct hs_serialized_stream_header header;
+    if (buf_size < sizeof(header)) {
+        return HS_INVALID;
+    }
+    memcpy(&header, buf, sizeof(header));
+
+    if (header.magic != STREAM_SERIAL_MAGIC
+        || header.length != buf_size - sizeof(header)) {
+        return HS_INVALID;
+    }
+    if (header.version != HS_DB_VERSION) {
+        return HS_DB_VERSION_ERROR;
+    }
+    if (header.crc32 != db->crc32) {
+        DEBUG_PRINTF("stream is for db crc %08x, not %08x\n", header.crc32,
+                     db->crc32);
+        return HS_INVALID;
+    }
+
+    size_t stateSize = sizeof(struct hs_stream) + rose->stateOffsets.end;
+
+    struct hs_stream *s = alloc_stream(NULL, stateSize);
+    if (unlikely(!s)) {
+        return HS_NOMEM;
+    }
+
+    if (!expand_stream(s, rose, buf + sizeof(header), header.length)) {
+        free_stream(s);
+        return HS_INVALID;
+    }
+
+    *stream = s;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_alloc_stream_checkpoint(const hs_database_t *db,
+                                      hs_stream_checkpoint_t **checkpoint) {
+    if (unlikely(!checkpoint)) {
+        return HS_INVALID;
+    }
+
+    *checkpoint = NULL;
+
+    hs_error_t err = validDatabase(db);
+    if (unlikely(err != HS_SUCCESS)) {
+        return err;
+    }
+
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    if (unlikely(!ISALIGNED_16(rose))) {
+        return HS_INVALID;
+    }
+
+    rose = roseEngineForMode(rose, HS_MODE_STREAM);
+    if (unlikely(rose->mode != HS_MODE_STREAM)) {
+        return HS_DB_MODE_ERROR;
+    }
+
+    struct hs_stream_checkpoint *c = hs_misc_alloc(sizeof(*c));
+    err = hs_check_alloc(c);
+    if (err != HS_SUCCESS) {
+        hs_misc_free(c);
+        return err;
+    }
+
+    /* The compressed state is almost always smaller than the full state; the
+     * buffer grows on demand in the rare case that it is not. */
+    size_t capacity = sizeof(struct hs_stream) + rose->stateOffsets.end;
+    c->buf = hs_misc_alloc(capacity);
+    if (!c->buf) {
+        hs_misc_free(c);
+        return HS_NOMEM;
+    }
+
+    c->magic = STREAM_CHECKPOINT_MAGIC;
+    c->rose = rose;
+    c->used = 0;
+    c->capacity = capacity;
+
+    *checkpoint = c;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_checkpoint_stream(const hs_stream_t *id,
+                                hs_stream_checkpoint_t *checkpoint) {
+    if (unlikely(!id || !id->rose || id->pending || !checkpoint ||
+                 checkpoint->magic != STREAM_CHECKPOINT_MAGIC ||
+                 checkpoint->rose != id->rose)) {
+        return HS_INVALID;
+    }
+
+    size_t used = compress_stream(checkpoint->buf, checkpoint->capacity, id);
+    if (unlikely(!used)) {
+        size_t capacity = compressed_stream_size(id);
+        DEBUG_PRINTF("growing checkpoint from %zu to %zu bytes\n",
+                     checkpoint->capacity, capacity);
+        hs_misc_free(checkpoint->buf);
+        checkpoint->used = 0;
+        checkpoint->capacity = 0;
+        checkpoint->buf = hs_misc_alloc(capacity);
+        if (!checkpoint->buf) {
+            return HS_NOMEM;
         }
+        checkpoint->capacity = capacity;
+        used = compress_stream(checkpoint->buf, capacity, id);
+        assert(used == capacity);
+    }
+
+    DEBUG_PRINTF("checkpoint at offset %llu is %zu bytes\n", id->offset,
+                 used);
+    checkpoint->used = used;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_rollback_stream(hs_stream_t *id,
+                              const hs_stream_checkpoint_t *checkpoint) {
+    if (unlikely(!id || !id->rose || !checkpoint ||
+                 checkpoint->magic != STREAM_CHECKPOINT_MAGIC ||
+                 checkpoint->rose != id->rose || !checkpoint->used)) {
+        return HS_INVALID;
+    }
+
+    if (!expand_stream(id, id->rose, checkpoint->buf, checkpoint->used)) {
+        return HS_INVALID;
+    }
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_free_stream_checkpoint(hs_stream_checkpoint_t *checkpoint) {
+    if (checkpoint) {
+        if (checkpoint->magic != STREAM_CHECKPOINT_MAGIC) {
+            return HS_INVALID;
+        }
+        checkpoint->magic = 0;
+        hs_misc_free(checkpoint->buf);
+        hs_misc_free(checkpoint);
+    }
+
+    return HS_SUCCESS;
+}
+
+#if defined(DEBUG) || defined(DUMP_SUPPORT)
+#include "util/compare.h"
+// A debugging crutch: print a hex-escaped version of the match for our
+// perusal.
+static UNUSED
+void dumpData(const char *data, size_t len) {
+    DEBUG_PRINTF("BUFFER:");
+    for (size_t i = 0; i < len; i++) {
+        u8 c = data[i];
+        if (ourisprint(c) && c != '\'') {
+            printf("%c", c);
+        } else {
+            printf("\\x%02x", c);
+        }
+    }
+    printf("\n");
+}
+#endif
+
+/**
+ * \brief Writes \a count segments to stream \a id as one logical write.
+ *
+ * Each stream write pays for history maintenance and Rose catchup, so the
+ * segments are gathered into the staging buffer in scratch and scanned as a
+ * single write when they all fit. Otherwise runs of small segments are
+ * gathered and larger segments are scanned in place. As stream writes are
+ * simply concatenated, the matches produced are the same as if every segment
+ * were scanned separately.
+ */
+static
+hs_error_t scan_stream_segments(hs_stream_t *id, const char *const *data,
+                                const unsigned int *length, u32 count,
+                                hs_scratch_t *scratch,
+                                match_event_handler onEvent, void *context) {
+    char *vbuf = scratch->vector_buf;
+    const u32 vbuf_size = scratch->vectorBufSize;
+    u32 vbuf_used = 0;
+    hs_error_t ret = HS_SUCCESS;
+
+    u64a total = 0;
+    for (u32 i = 0; i < count; i++) {
+        total += length[i];
+    }
+    const char gather_all = total <= vbuf_size;
+
+    for (u32 i = 0; i < count; i++) {
+        DEBUG_PRINTF("block %u/%u offset=%llu len=%u\n", i, count, id->offset,
+                     length[i]);
+#ifdef DEBUG
+        dumpData(data[i], length[i]);
+#endif
+        if (!length[i]) {
+            continue;
+        }
+
+        if ((gather_all || length[i] < VECTOR_COALESCE_MAX_SEG) &&
+            vbuf_used + length[i] <= vbuf_size) {
+            memcpy(vbuf + vbuf_used, data[i], length[i]);
+            vbuf_used += length[i];
+            continue;
+        }
+
+        if (vbuf_used) {
+            DEBUG_PRINTF("flushing %u coalesced bytes\n", vbuf_used);
+            ret = hs_scan_stream_internal(id, vbuf, vbuf_used, 0, scratch,
+                                          onEvent, context);
+            vbuf_used = 0;
+            if (ret != HS_SUCCESS) {
+                return ret;
+            }
+        }
+
+        if (length[i] < VECTOR_COALESCE_MAX_SEG && vbuf_size) {
+            /* buffer was full; start refilling it */
+            memcpy(vbuf, data[i], length[i]);
+            vbuf_used = length[i];
+            continue;
+        }
+
+        ret = hs_scan_stream_internal(id, data[i], length[i], 0, scratch,
+                                      onEvent, context);
+        if (ret != HS_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (vbuf_used) {
+        DEBUG_PRINTF("flushing %u coalesced bytes\n", vbuf_used);
+        ret = hs_scan_stream_internal(id, vbuf, vbuf_used, 0, scratch,
+                                      onEvent, context);
+    }
+
+    return ret;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scan_vector(const hs_database_t *db, const char * const * data,
+                          const unsigned int *length, unsigned int count,
+                          UNUSED unsigned int flags, hs_scratch_t *scratch,
+                          match_event_handler onEvent, void *context) {
+    if (unlikely(!scratch || !data || !length)) {
+        return HS_INVALID;
+    }
+
+    hs_error_t err = validDatabase(db);
+    if (unlikely(err != HS_SUCCESS)) {
+        return err;
+    }
+
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    if (unlikely(!ISALIGNED_16(rose))) {
+        return HS_INVALID;
+    }
+
+    rose = roseEngineForMode(rose, HS_MODE_VECTORED);
+    if (unlikely(rose->mode != HS_MODE_VECTORED)) {
+        return HS_DB_MODE_ERROR;
+    }
+
+    if (unlikely(!validScratch(rose, scratch))) {
+        return HS_INVALID;
+    }
+
+    if (unlikely(markScratchInUse(scratch))) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    hs_stream_t *id = (hs_stream_t *)(scratch->bstate);
+
+    init_stream(id, rose, 1); /* open stream */
+
+    hs_error_t ret = scan_stream_segments(id, data, length, count, scratch,
+                                          onEvent, context);
+    if (ret != HS_SUCCESS) {
+        goto done;
+    }
+
+    /* close stream */
+    if (matchesWanted(onEvent, scratch)) {
+        report_eod_matches(id, scratch, onEvent, context);
+
+        if (told_to_stop_matching(scratch)) {
+            ret = HS_SCAN_TERMINATED;
+        }
+    }
+
+done:
+    /* matches are buffered across segments and delivered once per call */
+    if (flushMatchBatch(scratch) && ret == HS_SUCCESS) {
+        ret = HS_SCAN_TERMINATED;
     }
 
     unmarkScratchInUse(scratch);
 
+    return ret;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scan_stream_vector(hs_stream_t *id, const char *const *data,
+                                 const unsigned int *length,
+                                 unsigned int count, unsigned int flags,
+                                 hs_scratch_t *scratch,
+                                 match_event_handler onEvent, void *context) {
+    if (unlikely(!id || !scratch || (count && (!data || !length)) ||
+                 !validScratch(id->rose, scratch))) {
+        return HS_INVALID;
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        if (unlikely(!data[i])) {
+            return HS_INVALID;
+        }
+    }
+
+    if (unlikely(markScratchInUse(scratch))) {
+        return HS_SCRATCH_IN_USE;
+    }
+    u64a start = latencyStart(scratch);
+    sampleCallBegin(scratch, id->rose);
+
+    u64a total = 0;
+    hs_error_t rv = HS_SUCCESS;
+    if (id->pending_cap) {
+        /* A coalescing stream buffers the segments itself. */
+        for (u32 i = 0; i < count && rv == HS_SUCCESS; i++) {
+            total += length[i];
+            rv = scan_stream_write(id, data[i], length[i], flags, scratch,
+                                   onEvent, context);
+        }
+    } else {
+        for (u32 i = 0; i < count; i++) {
+            total += length[i];
+        }
+        rv = scan_stream_segments(id, data, length, count, scratch, onEvent,
+                                  context);
+    }
+    rv = flushStreamMatchBatch(id, scratch, rv);
+
+    sampleCallEnd(scratch, total);
+    latencyEnd(scratch, HS_LATENCY_CALL_SCAN_STREAM, total, start);
+    unmarkScratchInUse(scratch);
+    return rv;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_get_match_data(const hs_scratch_t *scratch,
+                             unsigned long long from, unsigned long long to,
+                             const char **hist, size_t *hist_len,
+                             const char **data, size_t *data_len) {
+    if (unlikely(!scratch || scratch->magic != SCRATCH_MAGIC || !hist ||
+                 !hist_len || !data || !data_len || from > to)) {
+        return HS_INVALID;
+    }
+
+    /* The core info only describes the data being scanned while a scan is
+     * calling back; buffered matches may come from earlier data. */
+    const struct core_info *ci = &scratch->core_info;
+    if (!scratch->in_use || ci->batch) {
+        return HS_DATA_UNAVAILABLE;
+    }
+
+    const u64a buf_start = ci->buf_offset;
+    const u64a buf_end = buf_start + ci->len;
+    const u64a hist_start = buf_start - ci->hlen;
+    if (from < hist_start || to > buf_end) {
+        DEBUG_PRINTF("[%llu,%llu) outside [%llu,%llu)\n", from, to,
+                     hist_start, buf_end);
+        return HS_DATA_UNAVAILABLE;
+    }
+
+    if (from < buf_start) {
+        *hist = (const char *)ci->hbuf + (from - hist_start);
+        *hist_len = MIN(to, buf_start) - from;
+    } else {
+        *hist = NULL;
+        *hist_len = 0;
+    }
+
+    if (to > buf_start) {
+        u64a start = MAX(from, buf_start);
+        *data = (const char *)ci->buf + (start - buf_start);
+        *data_len = to - start;
+    } else {
+        *data = NULL;
+        *data_len = 0;
+    }
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_get_match_user_data(const hs_scratch_t *scratch,
+                                  unsigned long long *user_data) {
+    if (unlikely(!scratch || scratch->magic != SCRATCH_MAGIC || !user_data)) {
+        return HS_INVALID;
+    }
+
+    /* Buffered matches carry their user data in the buffer. */
+    const struct core_info *ci = &scratch->core_info;
+    if (!scratch->in_use || ci->batch) {
+        return HS_DATA_UNAVAILABLE;
+    }
+
+    *user_data = ci->match_user_data;
     return HS_SUCCESS;
 }
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: sampled cost attribution, charged to a shared aggregate.
+ */
+
+#include "sample_stats.h"
+#include "allocator.h"
+#include "database.h"
+#include "hs_internal.h"
+#include "hs_runtime.h"
+#include "scratch.h"
+#include "ue2common.h"
+#include "rose/rose_internal.h"
+#include "rose/runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define SNPRINTF_COMPAT _snprintf
+#else
+#define SNPRINTF_COMPAT snprintf
+#endif
+
+/** \brief Longest line we will ever print into the report string. */
+#define SAMPLE_LINE_MAX 112
+
+void sampleCallStart(struct hs_scratch *scratch,
+                     const struct RoseEngine *rose) {
+    struct hs_sample_aggregate *agg = scratch->sample_agg;
+    assert(agg);
+    scratch->sample_countdown = scratch->sample_period;
+
+    for (u32 i = 0; i < agg->mode_count; i++) {
+        if (agg->mode[i].rose == rose) {
+            scratch->sample_set = &agg->mode[i];
+            scratch->sample_owner = SAMPLE_NO_OWNER;
+            scratch->sample_start = sampleTick();
+            scratch->sample_tick = scratch->sample_start;
+            return;
+        }
+    }
+
+    DEBUG_PRINTF("scan of another database, not sampled\n");
+}
+
+void sampleCallFinish(struct hs_scratch *scratch, size_t len) {
+    struct hs_sample_aggregate *agg = scratch->sample_agg;
+    assert(agg);
+
+    sampleSwitchOwner(scratch, SAMPLE_NO_OWNER);
+    sampleAdd(&agg->sampled_calls, 1);
+    sampleAdd(&agg->represented_calls, scratch->sample_period);
+    sampleAdd(&agg->sampled_bytes, len);
+    sampleAdd(&agg->sampled_cycles, sampleTick() - scratch->sample_start);
+    scratch->sample_set = NULL;
+}
+
+/** \brief Scan calls until the first sample of a scratch region, spread
+ * over the period by the region's address so that regions set up together
+ * do not sample the same calls. */
+static
+u32 sampleFirstCountdown(const struct hs_scratch *scratch, u32 period) {
+    u32 h = (u32)((size_t)scratch >> 6) * 2654435761U;
+    return 1 + h % period;
+}
+
+void sampleReseed(struct hs_scratch *scratch) {
+    if (scratch->sample_agg) {
+        scratch->sample_countdown =
+            sampleFirstCountdown(scratch, scratch->sample_period);
+    }
+    scratch->sample_set = NULL;
+}
+
+static
+size_t countersSize(const struct RoseEngine *t) {
+    return sizeof(u64a) * 2 * ((size_t)t->literalCount + t->queueCount);
+}
+
+/** \brief Points the counter arrays of \a c at \a mem, which has
+ * countersSize() bytes. */
+static
+void initCounters(struct sample_counters *c, const struct RoseEngine *t,
+                  u64a *mem) {
+    c->rose = t;
+    c->literal_count = t->literalCount;
+    c->engine_count = t->queueCount;
+    c->lit_execs = mem;
+    c->lit_cycles = c->lit_execs + c->literal_count;
+    c->engine_execs = c->lit_cycles + c->literal_count;
+    c->engine_cycles = c->engine_execs + c->engine_count;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_alloc_sample_aggregate(const hs_database_t *db,
+                                     hs_sample_aggregate_t **agg) {
+    if (!agg) {
+        return HS_INVALID;
+    }
+    *agg = NULL;
+    hs_error_t err = validDatabase(db);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    const struct RoseEngine *t = hs_get_bytecode(db);
+    const struct RoseEngine *alt = roseAltModeEngine(t);
+
+    size_t len = sizeof(struct hs_sample_aggregate) + countersSize(t);
+    if (alt) {
+        len += countersSize(alt);
+    }
+
+    struct hs_sample_aggregate *a = hs_misc_alloc(len);
+    err = hs_check_alloc(a);
+    if (err != HS_SUCCESS) {
+        hs_misc_free(a);
+        return err;
+    }
+    memset(a, 0, len);
+
+    u64a *mem = (u64a *)(a + 1);
+    initCounters(&a->mode[0], t, mem);
+    a->mode_count = 1;
+    if (alt) {
+        initCounters(&a->mode[1], alt,
+                     (u64a *)((char *)mem + countersSize(t)));
+        a->mode_count = 2;
+    }
+
+    *agg = a;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_free_sample_aggregate(hs_sample_aggregate_t *agg) {
+    hs_misc_free(agg);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_sample_enable(hs_scratch_t *scratch,
+                                    hs_sample_aggregate_t *agg,
+                                    unsigned int period) {
+    if (!scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    if (agg && !period) {
+        return HS_INVALID;
+    }
+    if (markScratchInUse(scratch)) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    scratch->sample_agg = agg;
+    scratch->sample_period = agg ? period : 0;
+    sampleReseed(scratch);
+
+    unmarkScratchInUse(scratch);
+    return HS_SUCCESS;
+}
+
+/** \brief Relaxed atomic read of a shared counter. */
+static really_inline
+u64a sampleLoad(const u64a *counter) {
+#if defined(_WIN32)
+    return *(const volatile u64a *)counter;
+#else
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+#endif
+}
+
+/** \brief Cycles charged to a single pattern ID. */
+struct pattern_cost {
+    u32 id;
+    u64a cycles;
+};
+
+static
+int cmp_cost_id(const void *a, const void *b) {
+    const struct pattern_cost *x = a;
+    const struct pattern_cost *y = b;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static
+int cmp_cost_desc(const void *a, const void *b) {
+    const struct pattern_cost *x = a;
+    const struct pattern_cost *y = b;
+    if (x->cycles != y->cycles) {
+        return x->cycles > y->cycles ? -1 : 1;
+    }
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/** \brief Returns the cycles charged to owner \a i of the given counters,
+ * where owners are the literals followed by the queues. */
+static
+u64a ownerCycles(const struct sample_counters *c, u32 i) {
+    if (i < c->literal_count) {
+        return sampleLoad(&c->lit_cycles[i]);
+    }
+    return sampleLoad(&c->engine_cycles[i - c->literal_count]);
+}
+
+/** \brief Number of owner-pattern pairs in the owner table of \a c's
+ * engine, or zero if it has none. */
+static
+u32 ownerEntries(const struct sample_counters *c) {
+    const struct RoseEngine *t = c->rose;
+    if (!t->profileOwnersOffset) {
+        return 0;
+    }
+    const u32 *owner_idx = getByOffset(t, t->profileOwnersOffset);
+    return owner_idx[c->literal_count + c->engine_count];
+}
+
+/** \brief Splits each owner's cycles evenly between the patterns it serves,
+ * appending the charges to \a costs. */
+static
+u32 chargePatterns(const struct sample_counters *c, struct pattern_cost *costs,
+                   u64a *attributed, u64a *unattributed) {
+    const struct RoseEngine *t = c->rose;
+    const u32 owner_count = c->literal_count + c->engine_count;
+    const u32 *owner_idx = getByOffset(t, t->profileOwnersOffset);
+    const u32 *owner_ids = owner_idx + owner_count + 1;
+
+    u32 n = 0;
+    for (u32 i = 0; i < owner_count; i++) {
+        u64a cycles = ownerCycles(c, i);
+        u32 id_count = owner_idx[i + 1] - owner_idx[i];
+        if (!cycles) {
+            continue;
+        }
+        if (!id_count) {
+            *unattributed += cycles;
+            continue;
+        }
+        *attributed += cycles;
+        for (u32 j = owner_idx[i]; j < owner_idx[i + 1]; j++) {
+            costs[n].id = owner_ids[j];
+            costs[n].cycles = cycles / id_count;
+            n++;
+        }
+    }
+    return n;
+}
+
+/** \brief Append one formatted line to the buffer, which the caller has sized
+ * to have at least SAMPLE_LINE_MAX bytes free. */
+#define PRINT_LINE(...)                                                        \
+    do {                                                                       \
+        int p_len = SNPRINTF_COMPAT(out, SAMPLE_LINE_MAX, __VA_ARGS__);        \
+        assert(p_len >= 0 && p_len < SAMPLE_LINE_MAX);                         \
+        out += p_len;                                                          \
+    } while (0)
+
+HS_PUBLIC_API
+hs_error_t hs_sample_report(const hs_sample_aggregate_t *agg,
+                            unsigned int max_patterns, char **info) {
+    if (!agg || !info) {
+        return HS_INVALID;
+    }
+
+    int has_owners = 1;
+    u32 entries = 0;
+    u32 active_engines = 0;
+    for (u32 m = 0; m < agg->mode_count; m++) {
+        const struct sample_counters *c = &agg->mode[m];
+        if (!c->rose->profileOwnersOffset) {
+            has_owners = 0;
+        }
+        entries += ownerEntries(c);
+        for (u32 i = 0; i < c->engine_count; i++) {
+            active_engines += sampleLoad(&c->engine_execs[i]) ? 1 : 0;
+        }
+    }
+
+    struct pattern_cost *costs = NULL;
+    u32 patterns = 0;
+    u64a attributed = 0;
+    u64a unattributed = 0;
+    hs_error_t err;
+    if (has_owners) {
+        costs = hs_misc_alloc(sizeof(struct pattern_cost) * (entries + 1));
+        err = hs_check_alloc(costs);
+        if (err != HS_SUCCESS) {
+            hs_misc_free(costs);
+            return err;
+        }
+
+        u32 n = 0;
+        for (u32 m = 0; m < agg->mode_count; m++) {
+            n += chargePatterns(&agg->mode[m], costs + n, &attributed,
+                                &unattributed);
+        }
+
+        // Merge the charges for each pattern, then sort by cost.
+        qsort(costs, n, sizeof(struct pattern_cost), cmp_cost_id);
+        for (u32 i = 0; i < n; i++) {
+            if (patterns && costs[patterns - 1].id == costs[i].id) {
+                costs[patterns - 1].cycles += costs[i].cycles;
+            } else {
+                costs[patterns++] = costs[i];
+            }
+        }
+        qsort(costs, patterns, sizeof(struct pattern_cost), cmp_cost_desc);
+        if (max_patterns && patterns > max_patterns) {
+            patterns = max_patterns;
+        }
+    }
+
+    // Four header lines, one per pattern and one per active engine.
+    size_t len = (size_t)(patterns + active_engines + 4) * SAMPLE_LINE_MAX + 1;
+    char *buf = hs_misc_alloc(len);
+    err = hs_check_alloc(buf);
+    if (err != HS_SUCCESS) {
+        hs_misc_free(costs);
+        hs_misc_free(buf);
+        return err;
+    }
+
+    char *out = buf;
+    *out = '\0';
+
+    PRINT_LINE("sampled calls: %llu of %llu, bytes: %llu, cycles: %llu\n",
+               sampleLoad(&agg->sampled_calls),
+               sampleLoad(&agg->represented_calls),
+               sampleLoad(&agg->sampled_bytes),
+               sampleLoad(&agg->sampled_cycles));
+
+    if (has_owners) {
+        PRINT_LINE("cycles attributed to patterns: %llu, unattributed: "
+                   "%llu\n", attributed, unattributed);
+        PRINT_LINE("patterns (id: cycles, percentage):\n");
+        for (u32 i = 0; i < patterns; i++) {
+            double pct = attributed ? 100.0 * costs[i].cycles / attributed
+                                    : 0;
+            PRINT_LINE("  %u: %llu, %.2f%%\n", costs[i].id, costs[i].cycles,
+                       pct);
+        }
+    } else {
+        PRINT_LINE("patterns: database compiled without "
+                   "HS_MODE_COST_ATTRIBUTION\n");
+    }
+
+    // Scans still running may bring more engines into use; we only have room
+    // for those counted above.
+    PRINT_LINE("engines (mode, queue: executions, cycles):\n");
+    u32 printed = 0;
+    for (u32 m = 0; m < agg->mode_count; m++) {
+        const struct sample_counters *c = &agg->mode[m];
+        const char *mode = c->rose->mode == HS_MODE_BLOCK ? "block"
+                         : c->rose->mode == HS_MODE_STREAM ? "stream"
+                                                            : "vectored";
+        for (u32 i = 0; i < c->engine_count; i++) {
+            u64a execs = sampleLoad(&c->engine_execs[i]);
+            if (!execs || printed == active_engines) {
+                continue;
+            }
+            printed++;
+            PRINT_LINE("  %s, %u: %llu, %llu\n", mode, i, execs,
+                       sampleLoad(&c->engine_cycles[i]));
+        }
+    }
+
+    assert(out < buf + len);
+    hs_misc_free(costs);
+    *info = buf;
+    return HS_SUCCESS;
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: sampled cost attribution, charged to a shared aggregate.
+ *
+ * When sampling is turned on for a scratch region with
+ * hs_scratch_sample_enable(), one scan call in every sampling period runs
+ * with cost attribution on: the time stamp counter cycles spent in each
+ * literal's Rose programs and each engine's queue executions are added to the
+ * aggregate with atomic adds, so that any number of scratch regions on
+ * different threads can share one aggregate without locks. The charge is
+ * exclusive, as for ROSE_PROFILE builds: an engine caught up from inside a
+ * literal program is charged to the engine. Outside a sampled scan,
+ * scratch->sample_set is NULL and the hooks here cost one predictable branch.
+ */
+
+#ifndef SAMPLE_STATS_H
+#define SAMPLE_STATS_H
+
+#include "hs_runtime.h"
+#include "scratch.h"
+#include "ue2common.h"
+#include "nfa/nfa_api_queue.h"
+
+#if defined(_WIN32)
+#include <intrin.h>
+#elif !defined(ARCH_AARCH64)
+#include <x86intrin.h>
+#endif
+
+/** \brief Cost owner value for time that is not charged to anything: the
+ * literal matchers, and the Rose work outside literal programs. */
+#define SAMPLE_NO_OWNER 0xffffffffU
+
+/** \brief Flag set in a cost owner to mark it as an engine queue index rather
+ * than a literal ID. */
+#define SAMPLE_ENGINE_OWNER 0x80000000U
+
+/** \brief Counters for the cost owners of one Rose engine. */
+struct sample_counters {
+    const struct RoseEngine *rose; //!< engine these counters belong to
+    u32 literal_count; //!< number of literal programs
+    u32 engine_count; //!< number of engine queues
+    u64a *lit_execs; //!< executions of each literal's programs
+    u64a *lit_cycles; //!< cycles spent in each literal's programs
+    u64a *engine_execs; //!< queue executions of each engine
+    u64a *engine_cycles; //!< cycles spent executing each engine's queue
+};
+
+/** \brief Shared aggregate of the costs seen by sampled scans, allocated in
+ * one block by hs_alloc_sample_aggregate(). All counters are updated with
+ * relaxed atomic adds. */
+struct hs_sample_aggregate {
+    u64a sampled_calls; //!< scan calls sampled
+    u64a represented_calls; //!< scan calls the samples stand for
+    u64a sampled_bytes; //!< bytes scanned by the sampled calls
+    u64a sampled_cycles; //!< cycles taken by the sampled calls
+    u32 mode_count; //!< entries used in \ref mode
+    struct sample_counters mode[2]; //!< counters for each engine of the db
+};
+
+/** \brief Time stamp counter, as used by ROSE_PROFILE builds. */
+static really_inline
+u64a sampleTick(void) {
+#if defined(ARCH_AARCH64)
+    u64a now;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(now));
+    return now;
+#else
+    return __rdtsc();
+#endif
+}
+
+/** \brief Lock-free add of \a v to a counter shared between threads. */
+static really_inline
+void sampleAdd(u64a *counter, u64a v) {
+#if defined(_WIN32)
+    _InterlockedExchangeAdd64((volatile __int64 *)counter, (__int64)v);
+#else
+    __atomic_fetch_add(counter, v, __ATOMIC_RELAXED);
+#endif
+}
+
+/** \brief Start a sampled scan call: picks the counters for \a rose and starts
+ * the clock. */
+void sampleCallStart(struct hs_scratch *scratch,
+                     const struct RoseEngine *rose);
+
+/** \brief Finish a sampled scan call of \a len bytes. */
+void sampleCallFinish(struct hs_scratch *scratch, size_t len);
+
+/** \brief Restarts the countdown to the first sample of a scratch region that
+ * has just been set up or copied. */
+void sampleReseed(struct hs_scratch *scratch);
+
+/** \brief Charge the cycles since the last switch to the current owner, then
+ * make \a owner the current owner. Returns the previous owner. */
+static really_inline
+u32 sampleSwitchOwner(struct hs_scratch *scratch, u32 owner) {
+    struct sample_counters *c = scratch->sample_set;
+    u64a now = sampleTick();
+    u32 prev = scratch->sample_owner;
+    if (prev == SAMPLE_NO_OWNER) {
+        // nobody to charge
+    } else if (prev & SAMPLE_ENGINE_OWNER) {
+        u32 qi = prev & ~SAMPLE_ENGINE_OWNER;
+        if (qi < c->engine_count) {
+            sampleAdd(&c->engine_cycles[qi], now - scratch->sample_tick);
+        }
+    } else if (prev < c->literal_count) {
+        sampleAdd(&c->lit_cycles[prev], now - scratch->sample_tick);
+    }
+    scratch->sample_owner = owner;
+    scratch->sample_tick = now;
+    return prev;
+}
+
+/** \brief Called at the start of each scan call; starts a sample once every
+ * sampling period. */
+static really_inline
+void sampleCallBegin(struct hs_scratch *scratch,
+                     const struct RoseEngine *rose) {
+    if (unlikely(scratch->sample_agg != NULL)) {
+        if (!--scratch->sample_countdown) {
+            sampleCallStart(scratch, rose);
+        }
+    }
+}
+
+/** \brief Called at the end of each scan call started with
+ * sampleCallBegin(). */
+static really_inline
+void sampleCallEnd(struct hs_scratch *scratch, size_t len) {
+    if (unlikely(scratch->sample_set != NULL)) {
+        sampleCallFinish(scratch, len);
+    }
+}
+
+/** \brief Note that we are about to run the program for literal \a id;
+ * returns the previous owner, to be passed to \ref sampleLitEnd. */
+static really_inline
+u32 sampleLitBegin(struct hs_scratch *scratch, u32 id) {
+    if (likely(scratch->sample_set == NULL)) {
+        return SAMPLE_NO_OWNER;
+    }
+    struct sample_counters *c = scratch->sample_set;
+    if (id < c->literal_count) {
+        sampleAdd(&c->lit_execs[id], 1);
+    }
+    return sampleSwitchOwner(scratch, id);
+}
+
+static really_inline
+void sampleLitEnd(struct hs_scratch *scratch, u32 prev) {
+    if (unlikely(scratch->sample_set != NULL)) {
+        sampleSwitchOwner(scratch, prev);
+    }
+}
+
+/** \brief Note that we are about to execute the queue \a q; returns the
+ * previous owner, to be passed to \ref sampleEngineEnd. */
+static really_inline
+u32 sampleEngineBegin(const struct mq *q) {
+    struct hs_scratch *scratch = q->scratch;
+    if (likely(!scratch || scratch->sample_set == NULL)) {
+        return SAMPLE_NO_OWNER;
+    }
+    struct sample_counters *c = scratch->sample_set;
+    u32 owner = SAMPLE_NO_OWNER;
+    if (q >= scratch->queues && q < scratch->queues + c->engine_count) {
+        u32 qi = (u32)(q - scratch->queues);
+        sampleAdd(&c->engine_execs[qi], 1);
+        owner = qi | SAMPLE_ENGINE_OWNER;
+    }
+    return sampleSwitchOwner(scratch, owner);
+}
+
+static really_inline
+void sampleEngineEnd(const struct mq *q, u32 prev) {
+    struct hs_scratch *scratch = q->scratch;
+    if (unlikely(scratch && scratch->sample_set != NULL)) {
+        sampleSwitchOwner(scratch, prev);
+    }
+}
+
+#endif // SAMPLE_STATS_H
@@ -36,12 +36,17 @@
 #include "allocator.h"
 #include "hs_internal.h"
 #include "hs_runtime.h"
+#include "latency_stats.h"
+#include "pmu_stats.h"
+#include "sample_stats.h"
 #include "scratch.h"
 #include "state.h"
 #include "ue2common.h"
 #include "database.h"
+#include "nfa/limex_cache.h"
 #include "nfa/nfa_api_queue.h"
 #include "rose/rose_internal.h"
+#include "rose/rose_profile.h"
 #include "util/fatbit.h"
 #include "util/multibit.h"
 
@@ -66,39 +71,33 @@ size_t fatbit_array_size(u32 num_entries, u32 num_keys) {
     return ROUNDUP_N(len, 8); // Round up for potential padding.
 }
 
-/** Used by hs_alloc_scratch and hs_clone_scratch to allocate a complete
- * scratch region from a prototype structure. */
+/** Returns the size of the allocation required for a scratch region with the
+ * sizes given in the prototype structure. */
 static
-hs_error_t alloc_scratch(const hs_scratch_t *proto, hs_scratch_t **scratch) {
+size_t scratch_alloc_size(const hs_scratch_t *proto) {
     u32 queueCount = proto->queueCount;
     u32 deduperCount = proto->deduper.log_size;
-    u32 bStateSize = proto->bStateSize;
-    u32 tStateSize = proto->tStateSize;
-    u32 fullStateSize = proto->fullStateSize;
-    u32 anchored_literal_region_len = proto->anchored_literal_region_len;
-    u32 anchored_literal_region_width = proto->anchored_literal_count;
 
     u32 som_store_size = proto->som_store_count * sizeof(u64a);
     u32 som_attempted_store_size = proto->som_store_count * sizeof(u64a);
     u32 som_now_size = fatbit_size(proto->som_store_count);
     u32 som_attempted_size = fatbit_size(proto->som_store_count);
 
-    struct hs_scratch *s;
-    struct hs_scratch *s_tmp;
     size_t queue_size = queueCount * sizeof(struct mq);
     size_t qmpq_size = queueCount * sizeof(struct queue_match);
 
-    assert(anchored_literal_region_len < 8 * sizeof(s->al_log_sum));
+    assert(proto->anchored_literal_region_len < 8 * sizeof(proto->al_log_sum));
 
     size_t anchored_literal_region_size = fatbit_array_size(
-        anchored_literal_region_len, anchored_literal_region_width);
+        proto->anchored_literal_region_len, proto->anchored_literal_count);
     size_t delay_region_size =
-        fatbit_array_size(DELAY_SLOT_COUNT, proto->delay_count);
+        sizeof(struct delay_slot) * DELAY_SLOT_COUNT + 7
+        + fatbit_array_size(DELAY_SLOT_COUNT, proto->delay_count);
 
     // the size is all the allocated stuff, not including the struct itself
     size_t size = queue_size + 63
-                  + bStateSize + tStateSize
-                  + fullStateSize + 63 /* cacheline padding */
+                  + proto->bStateSize + proto->tStateSize + 63
+                  + proto->fullStateSize + 63 /* cacheline padding */
                   + fatbit_size(proto->handledKeyCount) /* handled roles */
                   + fatbit_size(queueCount) /* active queue array */
                   + 2 * fatbit_size(deduperCount) /* need odd and even logs */
@@ -109,29 +108,67 @@ hs_error_t alloc_scratch(const hs_scratch_t *proto, hs_scratch_t **scratch) {
                   + som_store_size
                   + som_now_size
                   + som_attempted_size
-                  + som_attempted_store_size + 15;
+                  + som_attempted_store_size
+                  + proto->vectorBufSize + 15
+                  + proto->limexCacheSize + 63;
+
+#ifdef ROSE_PROFILE
+    size_t profile_size = sizeof(struct RoseProfile) + 7
+        + sizeof(struct RoseLiteralProfile) * proto->profileLiteralCount
+        + sizeof(struct RoseEngineProfile) * queueCount;
+    size += profile_size;
+#endif
 
     /* the struct plus the allocated stuff plus padding for cacheline
      * alignment */
-    const size_t alloc_size = sizeof(struct hs_scratch) + size + 256;
-    s_tmp = hs_scratch_alloc(alloc_size);
-    hs_error_t err = hs_check_alloc(s_tmp);
-    if (err != HS_SUCCESS) {
-        hs_scratch_free(s_tmp);
-        *scratch = NULL;
-        return err;
-    }
+    return sizeof(struct hs_scratch) + size + 256;
+}
+
+/** Lays out a complete scratch region with the sizes given in the prototype
+ * structure at s, which lies within the allocation s_alloc of alloc_size
+ * bytes. The allocation must be at least scratch_alloc_size(proto) bytes, and
+ * s must be the first cacheline-aligned address in it. */
+static
+void layout_scratch(hs_scratch_t *s, const hs_scratch_t *proto, char *s_alloc,
+                    size_t alloc_size) {
+    u32 queueCount = proto->queueCount;
+    u32 deduperCount = proto->deduper.log_size;
+    u32 bStateSize = proto->bStateSize;
+    u32 tStateSize = proto->tStateSize;
+    u32 fullStateSize = proto->fullStateSize;
+    u32 anchored_literal_region_len = proto->anchored_literal_region_len;
+    u32 anchored_literal_region_width = proto->anchored_literal_count;
+
+    u32 som_store_size = proto->som_store_count * sizeof(u64a);
+    u32 som_attempted_store_size = proto->som_store_count * sizeof(u64a);
+    u32 som_now_size = fatbit_size(proto->som_store_count);
+    u32 som_attempted_size = fatbit_size(proto->som_store_count);
+
+    size_t queue_size = queueCount * sizeof(struct mq);
+    size_t qmpq_size = queueCount * sizeof(struct queue_match);
+
+    assert(alloc_size >= scratch_alloc_size(proto));
+    assert((char *)s == ROUNDUP_PTR(s_alloc, 64));
 
-    memset(s_tmp, 0, alloc_size);
-    s = ROUNDUP_PTR(s_tmp, 64);
-    DEBUG_PRINTF("allocated %zu bytes at %p but realigning to %p\n", alloc_size, s_tmp, s);
+    DEBUG_PRINTF("laying out %zu bytes at %p from %p\n", alloc_size, s,
+                 s_alloc);
     DEBUG_PRINTF("sizeof %zu\n", sizeof(struct hs_scratch));
     *s = *proto;
+    PMU_INIT(s);
 
     s->magic = SCRATCH_MAGIC;
     s->in_use = 0;
     s->scratchSize = alloc_size;
-    s->scratch_alloc = (char *)s_tmp;
+    s->scratch_alloc = s_alloc;
+
+    /* The scratch region is laid out in two parts. Structures used on every
+     * scan (Rose block and transient state, the active queue array, the
+     * deduper and delay slot fatbits, etc) are packed together immediately
+     * after the header. The per-engine structures (queues, full engine state
+     * and SOM stores), which can be very large for databases with many
+     * engines but are only touched for engines that become active, follow at
+     * the end. Only the first part is zeroed here; queues are fully
+     * initialised when their engine is activated. */
 
     // each of these is at an offset from the previous
     char *current = (char *)s + sizeof(*s);
@@ -140,15 +177,9 @@ hs_error_t alloc_scratch(const hs_scratch_t *proto, hs_scratch_t **scratch) {
     // is accounted for in the padding allocated
     current = ROUNDUP_PTR(current, 8);
 
-    s->queues = (struct mq *)current;
-    current += queue_size;
-
-    assert(ISALIGNED_N(current, 8));
-    s->som_store = (u64a *)current;
-    current += som_store_size;
-
-    s->som_attempted_store = (u64a *)current;
-    current += som_attempted_store_size;
+    current = ROUNDUP_PTR(current, alignof(struct delay_slot));
+    s->delay_ring = (struct delay_slot *)current;
+    current += sizeof(struct delay_slot) * DELAY_SLOT_COUNT;
 
     current = ROUNDUP_PTR(current, alignof(struct fatbit *));
     s->delay_slots = (struct fatbit **)current;
@@ -216,27 +247,196 @@ hs_error_t alloc_scratch(const hs_scratch_t *proto, hs_scratch_t **scratch) {
     s->som_attempted_set = (struct fatbit *)current;
     current += som_attempted_size;
 
+#ifdef ROSE_PROFILE
+    current = ROUNDUP_PTR(current, 8);
+    char *profile_start = current;
+    current += sizeof(struct RoseProfile);
+    current += sizeof(struct RoseLiteralProfile) * proto->profileLiteralCount;
+    current += sizeof(struct RoseEngineProfile) * queueCount;
+#endif
+
+    // zero the header's trailing padding and all of the per-scan structures
+    char *hot_start = (char *)s + sizeof(*s);
+    memset(hot_start, 0, current - hot_start);
+
+#ifdef ROSE_PROFILE
+    s->profile = (struct RoseProfile *)profile_start;
+    s->profile->literal_count = proto->profileLiteralCount;
+    s->profile->curr_lit = ROSE_PROFILE_NO_LITERAL;
+    s->profile->engine_count = queueCount;
+    s->profile->curr_owner = ROSE_PROFILE_NO_LITERAL;
+    s->profile->lit = (struct RoseLiteralProfile *)(s->profile + 1);
+    s->profile->engine = (struct RoseEngineProfile *)(s->profile->lit
+                                                + proto->profileLiteralCount);
+#endif
+
+    // per-engine structures follow, starting on a fresh cache line
+    current = ROUNDUP_PTR(current, 64);
+
+    s->queues = (struct mq *)current;
+    current += queue_size;
+
+    assert(ISALIGNED_N(current, 8));
+    s->som_store = (u64a *)current;
+    current += som_store_size;
+
+    s->som_attempted_store = (u64a *)current;
+    current += som_attempted_store_size;
+
     current = ROUNDUP_PTR(current, 64);
     assert(ISALIGNED_CL(current));
     s->fullState = (char *)current;
     s->fullStateSize = fullStateSize;
     current += fullStateSize;
 
-    *scratch = s;
+    s->vector_buf = proto->vectorBufSize ? (char *)current : NULL;
+    s->vectorBufSize = proto->vectorBufSize;
+    current += proto->vectorBufSize;
+
+    current = ROUNDUP_PTR(current, 64);
+    s->limex_cache = NULL;
+    s->limexCacheSize = proto->limexCacheSize;
+    if (proto->limexCacheSize) {
+        s->limex_cache = (struct limex_dfa_cache *)current;
+        limexCacheReset(s->limex_cache, NULL);
+    }
+    current += proto->limexCacheSize;
 
     // Don't get too big for your boots
-    assert((size_t)(current - (char *)s) <= alloc_size);
+    assert((size_t)(current - s_alloc) <= alloc_size);
+}
 
-    // Init q->scratch ptr for every queue.
-    for (struct mq *qi = s->queues; qi != s->queues + queueCount; ++qi) {
-        qi->scratch = s;
+/** Used by hs_alloc_scratch and hs_clone_scratch to allocate a complete
+ * scratch region from a prototype structure with the given allocator (NULL for
+ * the scratch allocator). The allocation is at least min_size bytes, so that a
+ * clone keeps any room reserved in its source. */
+static
+hs_error_t alloc_scratch(const hs_scratch_t *proto,
+                         const hs_allocator_t *allocator, size_t min_size,
+                         hs_scratch_t **scratch) {
+    size_t alloc_size = MAX(scratch_alloc_size(proto), min_size);
+    char *s_tmp = hs_ctx_alloc(allocator, hs_scratch_alloc, alloc_size);
+    hs_error_t err = hs_check_alloc(s_tmp);
+    if (err != HS_SUCCESS) {
+        if (s_tmp) {
+            hs_ctx_free(allocator, hs_scratch_free, s_tmp);
+        }
+        *scratch = NULL;
+        return err;
     }
 
+    hs_scratch_t *s = (hs_scratch_t *)ROUNDUP_PTR(s_tmp, 64);
+    DEBUG_PRINTF("allocated %zu bytes at %p but realigning to %p\n",
+                 alloc_size, s_tmp, s);
+    layout_scratch(s, proto, s_tmp, alloc_size);
+    s->allocator = allocator;
+    *scratch = s;
     return HS_SUCCESS;
 }
 
-HS_PUBLIC_API
-hs_error_t hs_alloc_scratch(const hs_database_t *db, hs_scratch_t **scratch) {
+/** Frees the allocation behind a scratch region with its own allocator. */
+static
+void free_scratch_alloc(hs_scratch_t *s) {
+    hs_ctx_free(s->allocator, hs_scratch_free, s->scratch_alloc);
+}
+
+/** Returns the block state size required in scratch for the given Rose
+ * engine. */
+static
+u32 scratch_bstate_size(const struct RoseEngine *rose) {
+    if (rose->mode == HS_MODE_BLOCK) {
+        return rose->stateOffsets.end;
+    } else if (rose->mode == HS_MODE_VECTORED) {
+        /* vectoring database require a full stream state (inc header) */
+        return sizeof(struct hs_stream) + rose->stateOffsets.end;
+    }
+    return 0;
+}
+
+/** Returns non-zero if the scratch region s is large enough in every respect
+ * for the given Rose engine. Must be kept in step with
+ * grow_scratch_proto_engine. */
+static
+char scratch_fits_engine(const struct RoseEngine *rose,
+                         const struct hs_scratch *s) {
+    return rose->anchoredDistance <= s->anchored_literal_region_len
+        && rose->anchored_count <= s->anchored_literal_count
+        && rose->delay_count <= s->delay_count
+        && rose->handledKeyCount <= s->handledKeyCount
+        && rose->tStateSize <= s->tStateSize
+        && rose->somLocationCount <= s->som_store_count
+        && rose->queueCount <= s->queueCount
+        && (rose->mode == HS_MODE_BLOCK
+            || s->vectorBufSize >= VECTOR_COALESCE_BUF_SIZE)
+        && scratch_bstate_size(rose) <= s->bStateSize
+        && rose->scratchStateSize <= s->fullStateSize
+        && rose->limexCacheSize <= s->limexCacheSize
+        && rose->dkeyCount <= s->deduper.log_size
+#ifdef ROSE_PROFILE
+        && rose->literalCount <= s->profileLiteralCount
+#endif
+        ;
+}
+
+/** Raises each size in the prototype to at least that required by the given
+ * Rose engine. */
+static
+void grow_scratch_proto_engine(const struct RoseEngine *rose,
+                               struct hs_scratch *proto) {
+    proto->anchored_literal_region_len =
+        MAX(proto->anchored_literal_region_len, rose->anchoredDistance);
+    proto->anchored_literal_count =
+        MAX(proto->anchored_literal_count, rose->anchored_count);
+    proto->delay_count = MAX(proto->delay_count, rose->delay_count);
+    proto->handledKeyCount =
+        MAX(proto->handledKeyCount, rose->handledKeyCount);
+    proto->tStateSize = MAX(proto->tStateSize, rose->tStateSize);
+    proto->som_store_count =
+        MAX(proto->som_store_count, rose->somLocationCount);
+    proto->queueCount = MAX(proto->queueCount, rose->queueCount);
+    if (rose->mode != HS_MODE_BLOCK) {
+        proto->vectorBufSize =
+            MAX(proto->vectorBufSize, VECTOR_COALESCE_BUF_SIZE);
+    }
+    proto->bStateSize = MAX(proto->bStateSize, scratch_bstate_size(rose));
+    proto->fullStateSize = MAX(proto->fullStateSize, rose->scratchStateSize);
+    proto->limexCacheSize = MAX(proto->limexCacheSize, rose->limexCacheSize);
+    proto->deduper.log_size = MAX(proto->deduper.log_size, rose->dkeyCount);
+#ifdef ROSE_PROFILE
+    proto->profileLiteralCount =
+        MAX(proto->profileLiteralCount, rose->literalCount);
+#endif
+    assert(scratch_fits_engine(rose, proto));
+}
+
+/** Returns non-zero if the scratch region s is large enough for every engine
+ * in the database whose bytecode is rose. */
+static
+char scratch_fits(const struct RoseEngine *rose, const struct hs_scratch *s) {
+    const struct RoseEngine *alt = roseAltModeEngine(rose);
+    return scratch_fits_engine(rose, s) &&
+           (!alt || scratch_fits_engine(alt, s));
+}
+
+/** Raises each size in the prototype to at least that required by every
+ * engine in the database whose bytecode is rose. */
+static
+void grow_scratch_proto(const struct RoseEngine *rose,
+                        struct hs_scratch *proto) {
+    grow_scratch_proto_engine(rose, proto);
+    const struct RoseEngine *alt = roseAltModeEngine(rose);
+    if (alt) {
+        grow_scratch_proto_engine(alt, proto);
+    }
+}
+
+/** Shared by hs_alloc_scratch and hs_alloc_scratch_ex: a new scratch region
+ * is allocated with the given allocator, while an existing one keeps its
+ * own. */
+static
+hs_error_t alloc_scratch_for_db(const hs_database_t *db,
+                                const hs_allocator_t *allocator,
+                                hs_scratch_t **scratch) {
     if (!db || !scratch) {
         return HS_INVALID;
     }
@@ -250,6 +450,8 @@ hs_error_t hs_alloc_scratch(const hs_database_t *db, hs_scratch_t **scratch) {
         return rv;
     }
 
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+
     /* We can also sanity-check the scratch parameter: if it points to an
      * existing scratch area, that scratch should have valid magic bits. */
     if (*scratch != NULL) {
@@ -263,17 +465,34 @@ hs_error_t hs_alloc_scratch(const hs_database_t *db, hs_scratch_t **scratch) {
         if (markScratchInUse(*scratch)) {
             return HS_SCRATCH_IN_USE;
         }
+        if (scratch_fits(rose, *scratch)) {
+            /* the cache is keyed on engine addresses, which a new database
+             * may reuse */
+            if ((*scratch)->limex_cache) {
+                limexCacheReset((*scratch)->limex_cache, NULL);
+            }
+            unmarkScratchInUse(*scratch);
+            return HS_SUCCESS;
+        }
     }
 
-    const struct RoseEngine *rose = hs_get_bytecode(db);
-    int resize = 0;
+    if (*scratch) {
+        allocator = (*scratch)->allocator;
+    }
 
+    /* the temporary used for sizing is never in caller-provided memory */
+    const hs_allocator_t *proto_allocator = hs_ctx_for_copy(allocator);
     hs_scratch_t *proto;
-    hs_scratch_t *proto_tmp = hs_scratch_alloc(sizeof(struct hs_scratch) + 256);
+    hs_scratch_t *proto_tmp = hs_ctx_alloc(proto_allocator, hs_scratch_alloc,
+                                           sizeof(struct hs_scratch) + 256);
     hs_error_t proto_ret = hs_check_alloc(proto_tmp);
     if (proto_ret != HS_SUCCESS) {
-        hs_scratch_free(proto_tmp);
-        hs_scratch_free(*scratch);
+        if (proto_tmp) {
+            hs_ctx_free(proto_allocator, hs_scratch_free, proto_tmp);
+        }
+        if (*scratch) {
+            free_scratch_alloc(*scratch);
+        }
         *scratch = NULL;
         return proto_ret;
     }
@@ -284,88 +503,163 @@ hs_error_t hs_alloc_scratch(const hs_database_t *db, hs_scratch_t **scratch) {
         *proto = **scratch;
     } else {
         memset(proto, 0, sizeof(*proto));
-        resize = 1;
     }
     proto->scratch_alloc = (char *)proto_tmp;
 
-    if (rose->anchoredDistance > proto->anchored_literal_region_len) {
-        resize = 1;
-        proto->anchored_literal_region_len = rose->anchoredDistance;
+    grow_scratch_proto(rose, proto);
+
+    if (*scratch && scratch_alloc_size(proto) <= (*scratch)->scratchSize) {
+        /* The existing allocation is big enough for the new layout, so the
+         * scratch region can be grown in place. */
+        DEBUG_PRINTF("growing scratch %p in place\n", *scratch);
+        PMU_CLOSE(*scratch);
+        layout_scratch(*scratch, proto, (*scratch)->scratch_alloc,
+                       (*scratch)->scratchSize);
+        /* kill off temp used for sizing */
+        hs_ctx_free(proto_allocator, hs_scratch_free, proto_tmp);
+        assert(!(*scratch)->in_use);
+        return HS_SUCCESS;
     }
 
-    if (rose->anchored_count > proto->anchored_literal_count) {
-        resize = 1;
-        proto->anchored_literal_count = rose->anchored_count;
+    if (allocator == &hs_placement_allocator) {
+        /* caller-provided memory cannot be replaced by a larger region */
+        assert(*scratch);
+        hs_ctx_free(proto_allocator, hs_scratch_free, proto_tmp);
+        unmarkScratchInUse(*scratch);
+        return HS_INSUFFICIENT_SPACE;
     }
 
-    if (rose->delay_count > proto->delay_count) {
-        resize = 1;
-        proto->delay_count = rose->delay_count;
+    if (*scratch) {
+        PMU_CLOSE(*scratch);
+        free_scratch_alloc(*scratch);
     }
 
-    if (rose->handledKeyCount > proto->handledKeyCount) {
-        resize = 1;
-        proto->handledKeyCount = rose->handledKeyCount;
+    hs_error_t alloc_ret = alloc_scratch(proto, allocator, 0, scratch);
+    if (alloc_ret != HS_SUCCESS) {
+        latencyFree(proto); /* the old scratch has gone */
     }
-
-    if (rose->tStateSize > proto->tStateSize) {
-        resize = 1;
-        proto->tStateSize = rose->tStateSize;
+    /* kill off temp used for sizing */
+    hs_ctx_free(proto_allocator, hs_scratch_free, proto_tmp);
+    if (alloc_ret != HS_SUCCESS) {
+        *scratch = NULL;
+        return alloc_ret;
     }
 
-    u32 som_store_count = rose->somLocationCount;
-    if (som_store_count > proto->som_store_count) {
-        resize = 1;
-        proto->som_store_count = som_store_count;
-    }
+    assert(!(*scratch)->in_use);
+    return HS_SUCCESS;
+}
 
-    u32 queueCount = rose->queueCount;
-    if (queueCount > proto->queueCount) {
-        resize = 1;
-        proto->queueCount = queueCount;
+HS_PUBLIC_API
+hs_error_t hs_alloc_scratch(const hs_database_t *db, hs_scratch_t **scratch) {
+    return alloc_scratch_for_db(db, NULL, scratch);
+}
+
+HS_PUBLIC_API
+hs_error_t hs_alloc_scratch_ex(const hs_database_t *db,
+                               const hs_allocator_t *allocator,
+                               hs_scratch_t **scratch) {
+    if (!allocator || !allocator->alloc || !allocator->free) {
+        return HS_INVALID;
     }
+    return alloc_scratch_for_db(db, allocator, scratch);
+}
 
-    u32 bStateSize = 0;
-    if (rose->mode == HS_MODE_BLOCK) {
-        bStateSize = rose->stateOffsets.end;
-    } else if (rose->mode == HS_MODE_VECTORED) {
-        /* vectoring database require a full stream state (inc header) */
-        bStateSize = sizeof(struct hs_stream) + rose->stateOffsets.end;
+HS_PUBLIC_API
+hs_error_t hs_scratch_required_size(const hs_database_t *db,
+                                    size_t *scratch_size) {
+    if (!db || !scratch_size) {
+        return HS_INVALID;
+    }
+    hs_error_t rv = dbIsValid(db);
+    if (rv != HS_SUCCESS) {
+        return rv;
     }
 
-    if (bStateSize > proto->bStateSize) {
-        resize = 1;
-        proto->bStateSize = bStateSize;
+    hs_scratch_t proto;
+    memset(&proto, 0, sizeof(proto));
+    grow_scratch_proto(hs_get_bytecode(db), &proto);
+    *scratch_size = scratch_alloc_size(&proto);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_init_scratch_at(const hs_database_t *db, void *mem, size_t size,
+                              hs_scratch_t **scratch) {
+    if (!scratch) {
+        return HS_INVALID;
+    }
+    *scratch = NULL;
+    if (!db || !mem) {
+        return HS_INVALID;
+    }
+    if (!ISALIGNED_N(mem, alignof(unsigned long long))) {
+        return HS_BAD_ALIGN;
+    }
+    hs_error_t rv = dbIsValid(db);
+    if (rv != HS_SUCCESS) {
+        return rv;
     }
 
-    u32 fullStateSize = rose->scratchStateSize;
-    if (fullStateSize > proto->fullStateSize) {
-        resize = 1;
-        proto->fullStateSize = fullStateSize;
+    hs_scratch_t proto;
+    memset(&proto, 0, sizeof(proto));
+    grow_scratch_proto(hs_get_bytecode(db), &proto);
+    if (size < scratch_alloc_size(&proto) || size > ~0U) {
+        return HS_INSUFFICIENT_SPACE;
     }
 
-    if (rose->dkeyCount > proto->deduper.log_size) {
-        resize = 1;
-        proto->deduper.log_size = rose->dkeyCount;
+    hs_scratch_t *s = (hs_scratch_t *)ROUNDUP_PTR(mem, 64);
+    layout_scratch(s, &proto, (char *)mem, size);
+    s->allocator = &hs_placement_allocator;
+    *scratch = s;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scratch_compatible(const hs_database_t *db,
+                                 const hs_scratch_t *scratch) {
+    if (!scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    hs_error_t rv = validDatabase(db);
+    if (rv != HS_SUCCESS) {
+        return rv;
     }
 
-    if (resize) {
-        if (*scratch) {
-            hs_scratch_free((*scratch)->scratch_alloc);
-        }
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    return scratch_fits(rose, scratch) ? HS_SUCCESS : HS_INSUFFICIENT_SPACE;
+}
 
-        hs_error_t alloc_ret = alloc_scratch(proto, scratch);
-        hs_scratch_free(proto_tmp); /* kill off temp used for sizing */
-        if (alloc_ret != HS_SUCCESS) {
-            *scratch = NULL;
-            return alloc_ret;
-        }
-    } else {
-        hs_scratch_free(proto_tmp); /* kill off temp used for sizing */
+HS_PUBLIC_API
+hs_error_t hs_reserve_scratch(size_t size, hs_scratch_t **scratch) {
+    if (!scratch || !*scratch || !ISALIGNED_CL(*scratch) ||
+        (*scratch)->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    if (markScratchInUse(*scratch)) {
+        return HS_SCRATCH_IN_USE;
+    }
+    if (size <= (*scratch)->scratchSize) {
         unmarkScratchInUse(*scratch);
+        return HS_SUCCESS;
+    }
+    if ((*scratch)->allocator == &hs_placement_allocator) {
+        unmarkScratchInUse(*scratch);
+        return HS_INSUFFICIENT_SPACE;
     }
 
-    assert(!(*scratch)->in_use);
+    hs_scratch_t *s = NULL;
+    hs_error_t rv = alloc_scratch(*scratch, (*scratch)->allocator, size, &s);
+    if (rv != HS_SUCCESS) {
+        unmarkScratchInUse(*scratch);
+        return rv;
+    }
+
+    hs_scratch_t *old = *scratch;
+    PMU_CLOSE(old);
+    old->magic = 0;
+    free_scratch_alloc(old);
+    *scratch = s;
     return HS_SUCCESS;
 }
 
@@ -376,12 +670,30 @@ hs_error_t hs_clone_scratch(const hs_scratch_t *src, hs_scratch_t **dest) {
     }
 
     *dest = NULL;
-    hs_error_t ret = alloc_scratch(src, dest);
+    hs_error_t ret = alloc_scratch(src, hs_ctx_for_copy(src->allocator),
+                                   src->scratchSize, dest);
     if (ret != HS_SUCCESS) {
         *dest = NULL;
         return ret;
     }
 
+    /* the match buffer belongs to the source's thread */
+    memset(&(*dest)->batch, 0, sizeof((*dest)->batch));
+
+    /* the clone gets its own histograms rather than sharing the source's */
+    (*dest)->latency = NULL;
+    if (src->latency) {
+        ret = hs_scratch_latency_enable(*dest, 1);
+        if (ret != HS_SUCCESS) {
+            hs_free_scratch(*dest);
+            *dest = NULL;
+            return ret;
+        }
+    }
+
+    /* the clone samples into the same aggregate, on its own schedule */
+    sampleReseed(*dest);
+
     assert(!(*dest)->in_use);
     return HS_SUCCESS;
 }
@@ -400,11 +712,13 @@ hs_error_t hs_free_scratch(hs_scratch_t *scratch) {
             return HS_SCRATCH_IN_USE;
         }
 
+        PMU_CLOSE(scratch);
+        latencyFree(scratch);
         scratch->magic = 0;
         assert(scratch->scratch_alloc);
         DEBUG_PRINTF("scratch %p is really at %p : freeing\n", scratch,
                      scratch->scratch_alloc);
-        hs_scratch_free(scratch->scratch_alloc);
+        free_scratch_alloc(scratch);
     }
 
     return HS_SUCCESS;
@@ -421,3 +735,151 @@ hs_error_t hs_scratch_size(const hs_scratch_t *scratch, size_t *size) {
 
     return HS_SUCCESS;
 }
+
+static
+int cmp_u32(const void *a, const void *b) {
+    u32 x = *(const u32 *)a;
+    u32 y = *(const u32 *)b;
+    return x < y ? -1 : x > y;
+}
+
+/** Returns the literal groups of the given Rose engine that can lead to an id
+ * enabled in mask m. */
+static
+u64a pattern_mask_groups(const struct RoseEngine *rose,
+                         const struct hs_pattern_mask *m) {
+    const u32 *group_idx = (const u32 *)((const char *)rose +
+                                         rose->groupReportsOffset);
+    const u32 *group_ids = group_idx + sizeof(rose_group) * 8 + 1;
+    u64a groups = rose->patternMaskGroups;
+    for (u32 g = 0; g < sizeof(rose_group) * 8; g++) {
+        for (u32 i = group_idx[g]; i < group_idx[g + 1]; i++) {
+            if (patternMaskHasId(m, group_ids[i])) {
+                groups |= 1ULL << g;
+                break;
+            }
+        }
+    }
+    return groups;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_alloc_pattern_mask(const hs_database_t *db,
+                                 const unsigned int *ids, unsigned int count,
+                                 hs_pattern_mask_t **mask) {
+    if (!mask) {
+        return HS_INVALID;
+    }
+
+    *mask = NULL;
+
+    if (count && !ids) {
+        return HS_INVALID;
+    }
+
+    hs_error_t err = validDatabase(db);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    const struct RoseEngine *rose = hs_get_bytecode(db);
+    if (!ISALIGNED_16(rose)) {
+        return HS_INVALID;
+    }
+
+    u64a size = sizeof(struct hs_pattern_mask) + (u64a)count * sizeof(u32);
+    if (size > SIZE_MAX) {
+        return HS_NOMEM;
+    }
+
+    struct hs_pattern_mask *m = hs_misc_alloc((size_t)size);
+    err = hs_check_alloc(m);
+    if (err != HS_SUCCESS) {
+        hs_misc_free(m);
+        return err;
+    }
+
+    /* store the ids sorted and without duplicates, for binary search */
+    u32 n = 0;
+    if (count) {
+        memcpy(m->ids, ids, count * sizeof(u32));
+        qsort(m->ids, count, sizeof(u32), cmp_u32);
+        n = 1;
+        for (u32 i = 1; i < count; i++) {
+            if (m->ids[i] != m->ids[n - 1]) {
+                m->ids[n++] = m->ids[i];
+            }
+        }
+    }
+
+    m->magic = PATTERN_MASK_MAGIC;
+    m->count = n;
+    m->rose = rose;
+    m->groups = pattern_mask_groups(rose, m);
+    m->alt_rose = roseAltModeEngine(rose);
+    m->alt_groups = m->alt_rose ? pattern_mask_groups(m->alt_rose, m) : 0;
+
+    DEBUG_PRINTF("mask with %u ids, groups=%016llx\n", n, m->groups);
+    *mask = m;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_free_pattern_mask(hs_pattern_mask_t *mask) {
+    if (mask) {
+        if (mask->magic != PATTERN_MASK_MAGIC) {
+            return HS_INVALID;
+        }
+        mask->magic = 0;
+        hs_misc_free(mask);
+    }
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_set_scratch_pattern_mask(hs_scratch_t *scratch,
+                                       const hs_pattern_mask_t *mask) {
+    if (!scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    if (mask && mask->magic != PATTERN_MASK_MAGIC) {
+        return HS_INVALID;
+    }
+    if (markScratchInUse(scratch)) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    scratch->pattern_mask = mask;
+
+    unmarkScratchInUse(scratch);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_set_scratch_match_buffer(hs_scratch_t *scratch,
+                                       hs_match_t *buffer,
+                                       unsigned int capacity,
+                                       match_batch_handler onBatch) {
+    if (!scratch || !ISALIGNED_CL(scratch) ||
+        scratch->magic != SCRATCH_MAGIC) {
+        return HS_INVALID;
+    }
+    if (buffer && (!capacity || !onBatch)) {
+        return HS_INVALID;
+    }
+    if (markScratchInUse(scratch)) {
+        return HS_SCRATCH_IN_USE;
+    }
+
+    /* every API call empties the buffer before it returns */
+    assert(!scratch->batch.count);
+    scratch->batch.buf = buffer;
+    scratch->batch.capacity = buffer ? capacity : 0;
+    scratch->batch.count = 0;
+    scratch->batch.onBatch = buffer ? onBatch : NULL;
+
+    unmarkScratchInUse(scratch);
+    return HS_SUCCESS;
+}
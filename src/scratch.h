@@ -37,6 +37,7 @@
 #define SCRATCH_H_DA6D4FC06FF410
 
 #include "ue2common.h"
+#include "hs_runtime.h" // for hs_match_t, HS_PMU_PHASE_COUNT
 #include "rose/rose_types.h"
 
 #ifdef __cplusplus
@@ -47,11 +48,71 @@ extern "C"
 UNUSED static const u32 SCRATCH_MAGIC = 0x544F4259;
 #define FDR_TEMP_BUF_SIZE 220
 
+/** \brief Size of the staging buffer used to coalesce small segments in
+ * \ref hs_scan_vector and \ref hs_scan_stream_vector. */
+#define VECTOR_COALESCE_BUF_SIZE 2048
+
+/** \brief Segments shorter than this are copied into the staging buffer
+ * rather than scanned as separate stream writes. */
+#define VECTOR_COALESCE_MAX_SEG 256
+
+UNUSED static const u32 PATTERN_MASK_MAGIC = 0x504D534B;
+
+/** \brief Pattern mask: the subset of a database's pattern ids whose matches
+ * are delivered, see \ref hs_set_scratch_pattern_mask. */
+struct hs_pattern_mask {
+    u32 magic;
+    u32 count; /**< number of entries in ids */
+    const struct RoseEngine *rose; /**< database the mask was built for */
+    const struct RoseEngine *alt_rose; /**< the database's engine for another
+                                        * scanning mode, or NULL */
+    u64a groups; /**< literal groups in rose that can lead to an enabled id */
+    u64a alt_groups; /**< likewise for alt_rose */
+    u32 ids[]; /**< sorted enabled pattern ids */
+};
+
+/** \brief Number of delayed literal ids held inline in a delay slot before it
+ * spills into its fatbit. Chosen so that a slot fills one cacheline. */
+#define DELAY_SLOT_INLINE_MAX 14
+
+/** \brief Delayed literals pending in one slot of the delay ring.
+ *
+ * Slots are indexed by match offset modulo DELAY_SLOT_COUNT and are only valid
+ * while their bit is set in RoseContext::filledDelayedSlots, which serves as
+ * the occupancy summary. Most slots see a handful of distinct literals, which
+ * are kept here as a sorted list so that pushing and playing them back never
+ * touches a delay_count-sized structure. Once a slot overflows, its ids are
+ * moved into the slot's fatbit in scratch::delay_slots. */
+struct delay_slot {
+    u32 count; /**< number of entries in ids, sorted ascending */
+    u32 spilled; /**< non-zero if the slot's ids live in its fatbit */
+    u32 ids[DELAY_SLOT_INLINE_MAX]; /**< delay indices pending in this slot */
+};
+
 struct fatbit;
 struct hs_scratch;
+struct limex_dfa_cache;
 struct RoseEngine;
+struct RoseProfile;
 struct mq;
 
+#ifdef PMU_STATS
+/** \brief Number of hardware events counted in PMU_STATS builds. */
+#define PMU_EVENT_COUNT 5
+
+/** \brief Hardware performance counters, kept in scratch in PMU_STATS
+ * builds. See pmu_stats.h. */
+struct pmu_stats {
+    int fd[PMU_EVENT_COUNT]; /**< perf event fds, -1 if not open */
+    s8 slot[PMU_EVENT_COUNT]; /**< position of each event in a group read, or
+                               * -1 if the event could not be opened */
+    u8 open_count; /**< number of events in the group */
+    long tid; /**< thread the events were opened for, or 0 */
+    u64a calls[HS_PMU_PHASE_COUNT]; /**< entries to each phase */
+    u64a count[HS_PMU_PHASE_COUNT][PMU_EVENT_COUNT]; /**< event totals */
+};
+#endif
+
 struct queue_match {
     /** \brief used to store the current location of an (suf|out)fix match in
      * the current buffer.
@@ -63,11 +124,67 @@ struct queue_match {
     size_t loc;
 
     u32 queue; /**< queue index. */
+    u32 next; /**< next queue in the same catchup_pq bucket. */
 };
 
+/** \brief Number of buckets in the catchup_pq radix heap: one per bit of
+ * location, plus one for entries at the current minimum. */
+#define CATCHUP_PQ_BUCKETS 64
+
+/** \brief Radix heap of (suf|out)fix queues ordered by next match location,
+ * see rose/catchup_pq.h. */
 struct catchup_pq {
-    struct queue_match *qm;
+    struct queue_match *qm; /**< entries, indexed by queue */
     u32 qm_size; /**< current size of the priority queue */
+    u64a nonempty; /**< bitmap of non-empty buckets */
+    size_t last; /**< last minimum, the key buckets are relative to */
+    u32 head[CATCHUP_PQ_BUCKETS]; /**< first queue in each bucket */
+    size_t bucket_min[CATCHUP_PQ_BUCKETS]; /**< min loc in each bucket */
+};
+
+/** \brief Number of slots in the leftfix check cache in scratch. */
+#define LEFTFIX_CHECK_CACHE_SIZE 16
+
+/** \brief Result of a leftfix (prefix or infix) check, recorded so that
+ * further checks of the same leftfix report at the same location can be
+ * answered without asking the engine again.
+ *
+ * Only valid while the leftfix queue holds nothing but its start event at
+ * loc; anything that pushes events into the queue or reinitialises it must
+ * invalidate the slot. */
+struct leftfix_check_cache {
+    u32 gen; /**< value of hs_scratch::leftfix_check_gen when recorded */
+    u32 qi; /**< queue index of the leftfix */
+    s64a loc; /**< location the leftfix has been run to */
+    ReportID report; /**< leftfix report that was checked */
+    char rv; /**< true if the leftfix was in an accept state for report */
+};
+
+/** \brief Number of slots in the LBR escape scan cache in scratch. */
+#define LBR_ESCAPE_CACHE_SIZE 16
+
+/** \brief Result of an LBR escape scan, recorded so that other LBR engines
+ * with the same escape class can reuse it during the same scan call.
+ *
+ * The region [begin, end) of buf has been scanned. If found is set, there is
+ * an escape at end - 1 and none before it in the region; otherwise the region
+ * contains no escapes. */
+struct lbr_escape_cache {
+    u32 gen; /**< value of hs_scratch::lbr_escape_gen when recorded */
+    u32 escapeClass; /**< escape class of the engine that did the scan */
+    const u8 *buf; /**< buffer scanned */
+    size_t begin; /**< start of scanned region */
+    size_t end; /**< end of scanned region */
+    char found; /**< true if the region ends with an escape */
+};
+
+/** \brief Caller-provided match buffer attached to scratch, see
+ * hs_set_scratch_match_buffer(). */
+struct match_batch {
+    hs_match_t *buf; /**< match buffer, or NULL if none is attached */
+    u32 capacity; /**< number of matches buf can hold */
+    u32 count; /**< number of matches currently held in buf */
+    match_batch_handler onBatch; /**< handler for full buffers */
 };
 
 /** \brief Status flag: user requested termination. */
@@ -81,6 +198,11 @@ struct catchup_pq {
  * history. */
 #define STATUS_DELAY_DIRTY  (1U << 2)
 
+/** \brief Status flag: a role state or suffix engine has been switched on in
+ * this stream, so EOD processing may have work to do. See
+ * RoseEngine::eodNeedsLiveState. */
+#define STATUS_EOD_LIVE     (1U << 3)
+
 /** \brief Core information about the current scan, used everywhere. */
 struct core_info {
     void *userContext; /**< user-supplied context */
@@ -89,14 +211,24 @@ struct core_info {
     int (*userCallback)(unsigned int id, unsigned long long from,
                         unsigned long long to, unsigned int flags, void *ctx);
 
+    /** \brief match buffer to append matches to instead of calling
+     * userCallback, or NULL */
+    struct match_batch *batch;
+
     const struct RoseEngine *rose;
     char *state; /**< full stream state */
     char *exhaustionVector; /**< pointer to evec for this stream */
+    char *logicalVector; /**< pointer to lvec for this stream */
+    char *combVector; /**< pointer to cvec for this stream */
     const u8 *buf; /**< main scan buffer */
     size_t len; /**< length of main scan buffer in bytes */
     const u8 *hbuf; /**< history buffer */
     size_t hlen; /**< length of history buffer in bytes. */
     u64a buf_offset; /**< stream offset, for the base of the buffer */
+    u64a match_user_data; /**< user data of the match being delivered to
+                            *  userCallback */
+    u64a window_min; /**< smallest match end offset to report */
+    u64a window_max; /**< largest match end offset to report */
     u8 status; /**< stream status bitmask, using STATUS_ flags above */
 };
 
@@ -119,6 +251,9 @@ struct RoseContext {
                                 * still allowed to report */
     u64a next_mpv_offset; /**< earliest offset that the MPV can next report a
                            * match, cleared if top events arrive */
+    u64a lastCombMatchOffset; /**< last match offset of a logical combination
+                               * sub-pattern; active combinations are
+                               * evaluated here when they are flushed */
     u32 filledDelayedSlots;
     u32 curr_qi;    /**< currently executing main queue index during
                      * \ref nfaQueueExec */
@@ -130,6 +265,7 @@ struct match_deduper {
     u64a *som_start_log[2]; /**< even, odd start offset logs for som */
     u32 log_size;
     u64a current_report_offset;
+    u8 log_dirty; /**< bit i set if log[i] may be non-empty */
     u8 som_log_dirty;
 };
 
@@ -152,7 +288,8 @@ struct ALIGN_CL_DIRECTIVE hs_scratch {
     struct mq *queues;
     struct fatbit *aqa; /**< active queue array; fatbit of queues that are valid
                          * & active */
-    struct fatbit **delay_slots;
+    struct delay_slot *delay_ring; /**< DELAY_SLOT_COUNT compact slots */
+    struct fatbit **delay_slots; /**< per-slot overflow fatbits */
     struct fatbit **al_log;
     u64a al_log_sum;
     struct catchup_pq catchup_pq;
@@ -174,7 +311,43 @@ struct ALIGN_CL_DIRECTIVE hs_scratch {
     u32 handledKeyCount;
     u32 delay_count;
     u32 scratchSize;
+    u32 vectorBufSize; /**< size of vector_buf, zero if not needed */
+    char *vector_buf; /**< staging buffer for small vectored segments */
+    u32 limexCacheSize; /**< size of limex_cache, zero if not needed */
+    struct limex_dfa_cache *limex_cache; /**< lazy DFA cache for LimEx NFAs */
     char *scratch_alloc; /* user allocated scratch object */
+    const hs_allocator_t *allocator; /**< allocator context for scratch_alloc,
+                                      * or NULL for the scratch allocator */
+    u32 lbr_escape_gen; /**< bumped at the start of every scan call to
+                         * invalidate the LBR escape cache */
+    u32 leftfix_check_gen; /**< bumped at the start of every scan call to
+                            * invalidate the leftfix check cache */
+    u32 pool_gen; /**< generation of the scratch pool prototype this scratch
+                   * was cloned from, see hs_scratch_pool.cpp */
+    const struct hs_pattern_mask *pattern_mask; /**< enabled pattern ids, or
+                                                 * NULL for all */
+    struct hs_latency_stats *latency; /**< call latency histograms, or NULL
+                                       * if latency statistics are off */
+    struct hs_sample_aggregate *sample_agg; /**< aggregate charged by sampled
+                                             * scans, or NULL if sampling is
+                                             * off */
+    struct sample_counters *sample_set; /**< counters charged during a sampled
+                                         * scan call, NULL otherwise */
+    u32 sample_period; /**< one scan call in this many is sampled */
+    u32 sample_countdown; /**< scan calls until the next sample */
+    u32 sample_owner; /**< cost owner in a sampled call, see sample_stats.h */
+    u64a sample_tick; /**< time stamp counter at the last owner switch */
+    u64a sample_start; /**< time stamp counter at the start of the call */
+    struct match_batch batch; /**< attached match buffer, if any */
+    struct lbr_escape_cache lbr_escape[LBR_ESCAPE_CACHE_SIZE];
+    struct leftfix_check_cache leftfix_check[LEFTFIX_CHECK_CACHE_SIZE];
+#ifdef ROSE_PROFILE
+    u32 profileLiteralCount; /**< number of literals with profile counters */
+    struct RoseProfile *profile; /**< Rose interpreter profiling counters */
+#endif
+#ifdef PMU_STATS
+    struct pmu_stats pmu; /**< hardware performance counters */
+#endif
     u8 ALIGN_DIRECTIVE fdr_temp_buf[FDR_TEMP_BUF_SIZE];
 };
 
@@ -189,6 +362,11 @@ struct fatbit **getDelaySlots(struct hs_scratch *scratch) {
     return scratch->delay_slots;
 }
 
+static really_inline
+struct delay_slot *getDelayRing(struct hs_scratch *scratch) {
+    return scratch->delay_ring;
+}
+
 static really_inline
 char told_to_stop_matching(const struct hs_scratch *scratch) {
     return scratch->core_info.status & STATUS_TERMINATED;
@@ -227,6 +405,92 @@ void unmarkScratchInUse(struct hs_scratch *scratch) {
     scratch->in_use = 0;
 }
 
+/**
+ * \brief Literal groups left on by the scratch's pattern mask, or all groups
+ * if there is no mask.
+ */
+static really_inline
+u64a patternMaskGroups(const struct hs_scratch *scratch) {
+    const struct hs_pattern_mask *mask = scratch->pattern_mask;
+    if (!mask) {
+        return ~0ULL;
+    }
+    return scratch->core_info.rose == mask->rose ? mask->groups
+                                                 : mask->alt_groups;
+}
+
+/** \brief Returns non-zero if pattern id \a id is enabled in \a mask. */
+static really_inline
+char patternMaskHasId(const struct hs_pattern_mask *mask, u32 id) {
+    u32 lo = 0;
+    u32 hi = mask->count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (mask->ids[mid] < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < mask->count && mask->ids[lo] == id;
+}
+
+/**
+ * \brief Returns non-zero if matches for pattern id \a onmatch are to be
+ * delivered to the user callback under the scratch's pattern mask.
+ */
+static really_inline
+char patternMaskAllows(const struct hs_scratch *scratch, u32 onmatch) {
+    const struct hs_pattern_mask *mask = scratch->pattern_mask;
+    return !mask || patternMaskHasId(mask, onmatch);
+}
+
+/**
+ * \brief Returns non-zero if a match ending at \a to_offset lies inside the
+ * offset window of the current scan, see \ref hs_set_stream_window.
+ */
+static really_inline
+char matchInWindow(const struct core_info *ci, u64a to_offset) {
+    return to_offset >= ci->window_min && to_offset <= ci->window_max;
+}
+
+/**
+ * \brief Delivers a match to the user: appended to the attached match buffer
+ * if there is one, otherwise passed to the user callback.
+ *
+ * Returns non-zero if the user asked for matching to stop. With a match
+ * buffer, that can only happen when the buffer fills and is handed to the
+ * batch handler.
+ *
+ * The \a user_data of the match is recorded in the buffer, or held in the core
+ * info for \ref hs_get_match_user_data while the callback runs.
+ */
+static really_inline
+int deliverUserMatch(struct core_info *ci, u32 onmatch, u64a from_offset,
+                     u64a to_offset, u32 flags, u64a user_data) {
+    struct match_batch *mb = ci->batch;
+    if (!mb) {
+        ci->match_user_data = user_data;
+        return ci->userCallback(onmatch, from_offset, to_offset, flags,
+                                ci->userContext);
+    }
+
+    assert(mb->count < mb->capacity);
+    hs_match_t *m = &mb->buf[mb->count++];
+    m->from = from_offset;
+    m->to = to_offset;
+    m->id = onmatch;
+    m->flags = flags;
+    m->user_data = user_data;
+    if (mb->count < mb->capacity) {
+        return 0;
+    }
+
+    DEBUG_PRINTF("match buffer full, delivering %u matches\n", mb->count);
+    mb->count = 0;
+    return mb->onBatch(mb->buf, mb->capacity, ci->userContext);
+}
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -58,7 +58,9 @@ void dumpScratch(const struct hs_scratch *s, FILE *f) {
             mmbit_size(s->queueCount));
     fprintf(f, "  qmpq                 : %zu bytes\n",
             s->queueCount * sizeof(struct queue_match));
-    fprintf(f, "  delay info           : %u bytes\n",
+    fprintf(f, "  delay ring           : %zu bytes\n",
+            sizeof(struct delay_slot) * DELAY_SLOT_COUNT);
+    fprintf(f, "  delay overflow       : %u bytes\n",
             mmbit_size(s->delay_count) * DELAY_SLOT_COUNT);
 }
 
@@ -35,6 +35,8 @@
 #include "nfa/nfa_internal.h"
 #include "nfa/rdfa_merge.h"
 #include "nfa/shengcompile.h"
+#include "nfa/shufticompile.h"
+#include "nfa/trufflecompile.h"
 #include "nfagraph/ng.h"
 #include "nfagraph/ng_holder.h"
 #include "nfagraph/ng_mcclellan.h"
@@ -43,12 +45,15 @@
 #include "smallwrite/smallwrite_internal.h"
 #include "util/alloc.h"
 #include "util/charreach.h"
+#include "util/compare.h"
 #include "util/compile_context.h"
 #include "util/container.h"
 #include "util/make_unique.h"
 #include "util/ue2string.h"
 #include "util/verify_types.h"
 
+#include <algorithm>
+
 #include <map>
 #include <set>
 #include <vector>
@@ -61,6 +66,9 @@ namespace ue2 {
 #define LITERAL_MERGE_CHUNK_SIZE 25
 #define DFA_MERGE_MAX_STATES 8000
 
+/** \brief Widest class we will build a smallwrite prefilter for. */
+#define PREFILTER_MAX_CHARS 64
+
 namespace { // unnamed
 
 // Concrete impl class
@@ -85,6 +93,13 @@ public:
     unique_ptr<raw_dfa> rdfa;
     vector<pair<ue2_literal, ReportID> > cand_literals;
     bool poisoned;
+
+    /** \brief Largest buffer the DFA is being built for: the tiered size
+     * until a merge fails, after which we fall back to the base size. */
+    u32 region;
+
+private:
+    bool dropToBaseRegion();
 };
 
 } // namespace
@@ -98,7 +113,26 @@ SmallWriteBuildImpl::SmallWriteBuildImpl(size_t num_patterns,
       /* small write is block mode only */
       poisoned(!cc.grey.allowSmallWrite
                || cc.streaming
-               || num_patterns > cc.grey.smallWriteMaxPatterns) {
+               || num_patterns > cc.grey.smallWriteMaxPatterns),
+      region(max(cc.grey.smallWriteLargestBuffer,
+                 cc.grey.smallWriteLargestBufferTiered)) {
+}
+
+/** \brief Shrinks the DFA built so far to the base small write region, so that
+ * a merge which blew the state limit can be retried with fewer states. Returns
+ * false if we were already there. */
+bool SmallWriteBuildImpl::dropToBaseRegion() {
+    if (region <= cc.grey.smallWriteLargestBuffer) {
+        return false;
+    }
+
+    DEBUG_PRINTF("dropping region from %u to %u\n", region,
+                 cc.grey.smallWriteLargestBuffer);
+    region = cc.grey.smallWriteLargestBuffer;
+    if (rdfa) {
+        prune_overlong(*rdfa, region);
+    }
+    return true;
 }
 
 void SmallWriteBuildImpl::add(const NGWrapper &w) {
@@ -124,7 +158,7 @@ void SmallWriteBuildImpl::add(const NGWrapper &w) {
     // then we don't need to build a SmallWrite version.
     // However, we don't poison this case either, since it is simply a case,
     // where we know the resulting graph won't match.
-    if (findMinWidth(*h) > depth(cc.grey.smallWriteLargestBuffer)) {
+    if (findMinWidth(*h) > depth(region)) {
         return;
     }
 
@@ -140,12 +174,17 @@ void SmallWriteBuildImpl::add(const NGWrapper &w) {
         return;
     }
 
-    prune_overlong(*r, cc.grey.smallWriteLargestBuffer);
+    prune_overlong(*r, region);
 
     if (rdfa) {
         // do a merge of the new dfa with the existing dfa
         auto merged = mergeTwoDfas(rdfa.get(), r.get(), DFA_MERGE_MAX_STATES,
                                    &rm, cc.grey);
+        if (!merged && dropToBaseRegion()) {
+            prune_overlong(*r, region);
+            merged = mergeTwoDfas(rdfa.get(), r.get(), DFA_MERGE_MAX_STATES,
+                                  &rm, cc.grey);
+        }
         if (!merged) {
             DEBUG_PRINTF("merge failed\n");
             poisoned = true;
@@ -165,7 +204,7 @@ void SmallWriteBuildImpl::add(const ue2_literal &literal, ReportID r) {
         return;
     }
 
-    if (literal.length() > cc.grey.smallWriteLargestBuffer) {
+    if (literal.length() > region) {
         return; /* too long */
     }
 
@@ -257,6 +296,10 @@ bool SmallWriteBuildImpl::determiniseLiterals() {
 
     auto merged = mergeAllDfas(to_merge, DFA_MERGE_MAX_STATES, &rm, cc.grey);
 
+    if (!merged && rdfa && dropToBaseRegion()) {
+        merged = mergeAllDfas(to_merge, DFA_MERGE_MAX_STATES, &rm, cc.grey);
+    }
+
     if (!merged) {
         DEBUG_PRINTF("merge failed\n");
         poisoned = true;
@@ -328,7 +371,7 @@ aligned_unique_ptr<NFA> getDfa(raw_dfa &rdfa, const CompileContext &cc,
 }
 
 static
-aligned_unique_ptr<NFA> prepEngine(raw_dfa &rdfa, u32 roseQuality,
+aligned_unique_ptr<NFA> prepEngine(raw_dfa &rdfa, u32 region, u32 roseQuality,
                                    const CompileContext &cc,
                                    const ReportManager &rm, u32 *start_offset,
                                    u32 *small_region) {
@@ -363,7 +406,32 @@ aligned_unique_ptr<NFA> prepEngine(raw_dfa &rdfa, u32 roseQuality,
             }
         }
     } else {
-        *small_region = cc.grey.smallWriteLargestBuffer;
+        /* Medium sized writes are only worth taking off rose if the DFA for
+         * them stays small, so halve the region until it fits the budget. */
+        const u32 base = cc.grey.smallWriteLargestBuffer;
+        *small_region = region;
+        while (*small_region > base &&
+               (rdfa.states.size() > cc.grey.smallWriteTieredMaxStates ||
+                nfa->length > cc.grey.limitSmallWriteOutfixSize)) {
+            *small_region = max(*small_region / 2, base);
+            DEBUG_PRINTF("%zu states, trying region %u\n", rdfa.states.size(),
+                         *small_region);
+            if (*small_region <= *start_offset) {
+                return nullptr;
+            }
+            if (!prune_overlong(rdfa, *small_region - *start_offset)) {
+                continue;
+            }
+            if (rdfa.start_anchored == DEAD_STATE) {
+                DEBUG_PRINTF("all patterns pruned out\n");
+                return nullptr;
+            }
+            nfa = getDfa(rdfa, cc, rm, accel_states);
+            if (!nfa) {
+                DEBUG_PRINTF("DFA compile failed for smallwrite NFA\n");
+                return nullptr;
+            }
+        }
     }
 
     assert(isDfaType(nfa->type));
@@ -377,6 +445,132 @@ aligned_unique_ptr<NFA> prepEngine(raw_dfa &rdfa, u32 roseQuality,
     return nfa;
 }
 
+/** \brief Rough guess at how common a byte is in typical traffic, used to
+ * steer the prefilter class towards rare bytes. */
+static
+u32 byteCommonness(u8 c) {
+    if (ourisalpha(c) || c == ' ') {
+        return 4;
+    }
+    if (c >= '0' && c <= '9') {
+        return 3;
+    }
+    if (ourisprint(c) || c == '\r' || c == '\n' || c == '\t') {
+        return 2;
+    }
+    return 1;
+}
+
+/**
+ * \brief Grows the set of states reachable from the anchored start without
+ * using a symbol in the cut, after symbol s has been taken out of it. Returns
+ * false if an accepting state becomes reachable.
+ */
+static
+bool extendReach(const raw_dfa &rdfa, const vector<bool> &cut, u16 s,
+                 vector<bool> &reach) {
+    vector<dstate_id_t> pending;
+    for (dstate_id_t i = 0; i < rdfa.states.size(); i++) {
+        if (reach[i]) {
+            pending.push_back(rdfa.states[i].next[s]);
+        }
+    }
+
+    const u16 alpha = rdfa.getImplAlphaSize();
+    while (!pending.empty()) {
+        dstate_id_t t = pending.back();
+        pending.pop_back();
+        if (t == DEAD_STATE || reach[t]) {
+            continue;
+        }
+        const dstate &ds = rdfa.states[t];
+        if (!ds.reports.empty() || !ds.reports_eod.empty()) {
+            return false;
+        }
+        reach[t] = true;
+        for (u16 i = 0; i < alpha; i++) {
+            if (!cut[i]) {
+                pending.push_back(ds.next[i]);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * \brief Finds a narrow class of bytes of which every match must contain at
+ * least one, i.e. a set of symbols which cuts the anchored start off from all
+ * accepting states. Starting from the whole alphabet, symbols are greedily
+ * dropped from the cut, most common first, for as long as it still separates
+ * the start from the accepts.
+ */
+static
+CharReach findRequiredClass(const raw_dfa &rdfa) {
+    const dstate &start = rdfa.states[rdfa.start_anchored];
+    if (!start.reports.empty() || !start.reports_eod.empty()) {
+        return CharReach::dot();
+    }
+
+    const u16 alpha = rdfa.getImplAlphaSize();
+    vector<CharReach> sym_cr(alpha);
+    for (u32 c = 0; c < N_CHARS; c++) {
+        sym_cr[rdfa.alpha_remap[c]].set(c);
+    }
+
+    vector<pair<u32, u16>> order;
+    for (u16 s = 0; s < alpha; s++) {
+        u32 score = 0;
+        for (size_t c = sym_cr[s].find_first(); c != CharReach::npos;
+             c = sym_cr[s].find_next(c)) {
+            score += byteCommonness(c);
+        }
+        order.emplace_back(score, s);
+    }
+    sort(order.begin(), order.end(), greater<pair<u32, u16>>());
+
+    vector<bool> cut(alpha, true);
+    vector<bool> reach(rdfa.states.size(), false);
+    reach[rdfa.start_anchored] = true;
+
+    for (const auto &e : order) {
+        u16 s = e.second;
+        vector<bool> new_reach = reach;
+        cut[s] = false;
+        if (extendReach(rdfa, cut, s, new_reach)) {
+            reach.swap(new_reach);
+        } else {
+            cut[s] = true;
+        }
+    }
+
+    CharReach cr;
+    for (u16 s = 0; s < alpha; s++) {
+        if (cut[s]) {
+            cr |= sym_cr[s];
+        }
+    }
+    DEBUG_PRINTF("required class has %zu bytes\n", cr.count());
+    return cr;
+}
+
+static
+void buildPrefilter(const raw_dfa &rdfa, SmallWriteEngine *smwr) {
+    smwr->prefilter = SMWR_PREFILTER_NONE;
+
+    CharReach cr = findRequiredClass(rdfa);
+    if (cr.none() || cr.count() > PREFILTER_MAX_CHARS) {
+        DEBUG_PRINTF("no useful prefilter\n");
+        return;
+    }
+
+    if (shuftiBuildMasks(cr, &smwr->prefilter_lo, &smwr->prefilter_hi) != -1) {
+        smwr->prefilter = SMWR_PREFILTER_SHUFTI;
+    } else {
+        truffleBuildMasks(cr, &smwr->prefilter_lo, &smwr->prefilter_hi);
+        smwr->prefilter = SMWR_PREFILTER_TRUFFLE;
+    }
+}
+
 // SmallWriteBuild factory
 unique_ptr<SmallWriteBuild> makeSmallWriteBuilder(size_t num_patterns,
                                                   const ReportManager &rm,
@@ -407,7 +601,8 @@ SmallWriteBuildImpl::build(u32 roseQuality) {
     u32 start_offset;
     u32 small_region;
     auto nfa =
-        prepEngine(*rdfa, roseQuality, cc, rm, &start_offset, &small_region);
+        prepEngine(*rdfa, region, roseQuality, cc, rm, &start_offset,
+                   &small_region);
     if (!nfa) {
         DEBUG_PRINTF("some smallwrite outfix could not be prepped\n");
         /* just skip the smallwrite optimization */
@@ -421,6 +616,7 @@ SmallWriteBuildImpl::build(u32 roseQuality) {
     smwr->size = size;
     smwr->start_offset = start_offset;
     smwr->largestBuffer = small_region;
+    buildPrefilter(*rdfa, smwr.get());
 
     /* copy in nfa after the smwr */
     assert(ISALIGNED_CL(smwr.get() + 1));
@@ -34,6 +34,10 @@
 #include "nfa/nfa_build_util.h"
 #include "nfa/nfa_dump_api.h"
 #include "nfa/nfa_internal.h"
+#include "nfa/shufticompile.h"
+#include "nfa/trufflecompile.h"
+#include "util/charreach.h"
+#include "util/dump_charclass.h"
 
 #include <cstdio>
 #include <string>
@@ -60,6 +64,22 @@ void smwrDumpText(const SmallWriteEngine *smwr, FILE *f) {
     fprintf(f, "Length: %u\n", n->length);
     fprintf(f, "Largest Short Buffer: %u\n", smwr->largestBuffer);
     fprintf(f, "Start Offset: %u\n", smwr->start_offset);
+
+    switch (smwr->prefilter) {
+    case SMWR_PREFILTER_SHUFTI:
+        fprintf(f, "Prefilter: shufti %s\n",
+                describeClass(shufti2cr(smwr->prefilter_lo,
+                                        smwr->prefilter_hi)).c_str());
+        break;
+    case SMWR_PREFILTER_TRUFFLE:
+        fprintf(f, "Prefilter: truffle %s\n",
+                describeClass(truffle2cr(smwr->prefilter_lo,
+                                         smwr->prefilter_hi)).c_str());
+        break;
+    default:
+        fprintf(f, "Prefilter: none\n");
+        break;
+    }
 }
 
 void smwrDumpNFA(const SmallWriteEngine *smwr, bool dump_raw,
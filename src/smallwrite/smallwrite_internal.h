@@ -30,12 +30,29 @@
 #define SMALLWRITE_INTERNAL_H
 
 #include "ue2common.h"
+#include "util/simd_types.h"
+
+/** \brief No prefilter: always run the DFA. */
+#define SMWR_PREFILTER_NONE    0
+
+/** \brief Prefilter is a shufti class (prefilter_lo/hi are shufti masks). */
+#define SMWR_PREFILTER_SHUFTI  1
+
+/** \brief Prefilter is a truffle class (prefilter_lo/hi are truffle masks). */
+#define SMWR_PREFILTER_TRUFFLE 2
 
 // Runtime structure header for SmallWrite.
 struct ALIGN_CL_DIRECTIVE SmallWriteEngine {
     u32 largestBuffer; /**< largest buffer that can be considered small write */
     u32 start_offset; /**< where to start scanning in the buffer. */
     u32 size; /**< size of the small write engine in bytes (including the nfa) */
+
+    /** \brief One of the SMWR_PREFILTER_* types. If set, every match needs a
+     * byte from the prefilter class, so a buffer without one can be skipped
+     * without running the DFA. */
+    u8 prefilter;
+    m128 prefilter_lo;
+    m128 prefilter_hi;
 };
 
 struct NFA;
@@ -123,7 +123,8 @@ void runRevNfa(struct hs_scratch *scratch, const struct som_operation *ri,
     DEBUG_PRINTF("run rev nfa %u from to_offset=%llu\n", nfa_idx, to_offset);
     const struct NFA *nfa = getSomRevNFA(ci->rose, nfa_idx);
 
-    assert(nfa->maxWidth); // No inf width rev NFAs.
+    // Inf width rev NFAs are only built for block mode, with no history.
+    assert(nfa->maxWidth || !ci->hlen);
 
     size_t buf_bytes = to_offset - ci->buf_offset;
     size_t history_bytes = ci->hlen;
@@ -203,8 +204,8 @@ void handleSomInternal(struct hs_scratch *scratch,
         assert(scratch->som_set_now_offset == ~0ULL
                || to_offset > scratch->som_set_now_offset);
         DEBUG_PRINTF("setting som_set_now_offset=%llu\n", to_offset);
-        fatbit_clear(som_set_now);
-        fatbit_clear(som_attempted_set);
+        fatbit_clear(som_set_now, som_store_count);
+        fatbit_clear(som_attempted_set, som_store_count);
         scratch->som_set_now_offset = to_offset;
     }
 
@@ -430,8 +431,8 @@ void setSomFromSomAware(struct hs_scratch *scratch,
 
     if (to_offset != scratch->som_set_now_offset) {
         DEBUG_PRINTF("setting som_set_now_offset=%llu\n", to_offset);
-        fatbit_clear(som_set_now);
-        fatbit_clear(som_attempted_set);
+        fatbit_clear(som_set_now, som_store_count);
+        fatbit_clear(som_attempted_set, som_store_count);
         scratch->som_set_now_offset = to_offset;
     }
 
@@ -484,14 +485,18 @@ int clearSomLog(struct hs_scratch *scratch, u64a offset, struct fatbit *log,
              it != MMB_INVALID; it = fatbit_iterate(log, dkeyCount, it)) {
         u64a from_offset = starts[it];
         u32 onmatch = dkey_to_report[it];
-        int halt = ci->userCallback(onmatch, from_offset, offset, flags,
-                                    ci->userContext);
+        if (!patternMaskAllows(scratch, onmatch) ||
+            !matchInWindow(ci, offset)) {
+            continue;
+        }
+        int halt = deliverUserMatch(ci, onmatch, from_offset, offset, flags,
+                                    roseMatchUserData(ci->rose, onmatch));
         if (halt) {
             ci->status |= STATUS_TERMINATED;
             return 1;
         }
     }
-    fatbit_clear(log);
+    fatbit_clear(log, dkeyCount);
     return 0;
 }
 
@@ -503,8 +508,9 @@ int flushStoredSomMatches_i(struct hs_scratch *scratch, u64a offset) {
 
     if (scratch->deduper.current_report_offset == ~0ULL) {
         /* no matches recorded yet; just need to clear the logs */
-        fatbit_clear(scratch->deduper.som_log[0]);
-        fatbit_clear(scratch->deduper.som_log[1]);
+        const u32 dkeyCount = scratch->core_info.rose->dkeyCount;
+        fatbit_clear(scratch->deduper.som_log[0], dkeyCount);
+        fatbit_clear(scratch->deduper.som_log[1], dkeyCount);
         scratch->deduper.som_log_dirty = 0;
         return 0;
     }
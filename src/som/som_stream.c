@@ -92,6 +92,22 @@ void storeSomValue(void *stream_som_store, u64a som_value,
     }
 }
 
+/** \brief Writes out every valid slot. Inlined with a constant \a som_size
+ * so that the width dispatch in \ref storeSomValue is folded away rather than
+ * taken once per slot. */
+static really_inline
+void storeSomSlots(char *stream_som_store, const u8 *som_store_valid,
+                   u32 som_store_count, const u64a *som_store,
+                   const u64a offset, const u8 som_size) {
+    for (u32 i = mmbit_iterate(som_store_valid, som_store_count, MMB_INVALID);
+         i != MMB_INVALID;
+         i = mmbit_iterate(som_store_valid, som_store_count, i)) {
+        DEBUG_PRINTF("storing %llu in %u\n", som_store[i], i);
+        storeSomValue(stream_som_store + (i * som_size), som_store[i],
+                      offset, som_size);
+    }
+}
+
 void storeSomToStream(struct hs_scratch *scratch, const u64a offset) {
     assert(scratch);
     DEBUG_PRINTF("stream offset %llu\n", offset);
@@ -105,14 +121,23 @@ void storeSomToStream(struct hs_scratch *scratch, const u64a offset) {
     u8 *som_store_valid = (u8 *)ci->state + rose->stateOffsets.somValid;
     char *stream_som_store = ci->state + rose->stateOffsets.somLocation;
     const u64a *som_store = scratch->som_store;
-    const u8 som_size = rose->somHorizon;
 
-    for (u32 i = mmbit_iterate(som_store_valid, som_store_count, MMB_INVALID);
-         i != MMB_INVALID;
-         i = mmbit_iterate(som_store_valid, som_store_count, i)) {
-        DEBUG_PRINTF("storing %llu in %u\n", som_store[i], i);
-        storeSomValue(stream_som_store + (i * som_size), som_store[i],
-                      offset, som_size);
+    switch (rose->somHorizon) {
+    case 2:
+        storeSomSlots(stream_som_store, som_store_valid, som_store_count,
+                      som_store, offset, 2);
+        break;
+    case 4:
+        storeSomSlots(stream_som_store, som_store_valid, som_store_count,
+                      som_store, offset, 4);
+        break;
+    case 8:
+        storeSomSlots(stream_som_store, som_store_valid, som_store_count,
+                      som_store, offset, 8);
+        break;
+    default:
+        assert(0);
+        break;
     }
 }
 
@@ -149,6 +174,20 @@ u64a loadSomValue(const void *stream_som_store, u64a stream_offset,
     return stream_offset - rel_offset;
 }
 
+/** \brief Reads back every valid slot; see \ref storeSomSlots. */
+static really_inline
+void loadSomSlots(const char *stream_som_store, const u8 *som_store_valid,
+                  u32 som_store_count, u64a *som_store, const u64a offset,
+                  const u8 som_size) {
+    for (u32 i = mmbit_iterate(som_store_valid, som_store_count, MMB_INVALID);
+         i != MMB_INVALID;
+         i = mmbit_iterate(som_store_valid, som_store_count, i)) {
+        som_store[i] = loadSomValue(stream_som_store + (i*som_size), offset,
+                                    som_size);
+        DEBUG_PRINTF("loaded %llu from %u\n", som_store[i], i);
+    }
+}
+
 void loadSomFromStream(struct hs_scratch *scratch, const u64a offset) {
     assert(scratch);
     DEBUG_PRINTF("stream offset %llu\n", offset);
@@ -162,13 +201,22 @@ void loadSomFromStream(struct hs_scratch *scratch, const u64a offset) {
     const u8 *som_store_valid = (u8 *)ci->state + rose->stateOffsets.somValid;
     const char *stream_som_store = ci->state + rose->stateOffsets.somLocation;
     u64a *som_store = scratch->som_store;
-    const u8 som_size = rose->somHorizon;
 
-    for (u32 i = mmbit_iterate(som_store_valid, som_store_count, MMB_INVALID);
-         i != MMB_INVALID;
-         i = mmbit_iterate(som_store_valid, som_store_count, i)) {
-        som_store[i] = loadSomValue(stream_som_store + (i*som_size), offset,
-                                    som_size);
-        DEBUG_PRINTF("loaded %llu from %u\n", som_store[i], i);
+    switch (rose->somHorizon) {
+    case 2:
+        loadSomSlots(stream_som_store, som_store_valid, som_store_count,
+                     som_store, offset, 2);
+        break;
+    case 4:
+        loadSomSlots(stream_som_store, som_store_valid, som_store_count,
+                     som_store, offset, 4);
+        break;
+    case 8:
+        loadSomSlots(stream_som_store, som_store_valid, som_store_count,
+                     som_store, offset, 8);
+        break;
+    default:
+        assert(0);
+        break;
     }
 }
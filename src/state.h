@@ -57,11 +57,115 @@ struct hs_stream {
 
     /** \brief The current stream offset. */
     u64a offset;
+
+    /** \brief Offset window set by hs_set_stream_window(): only matches
+     * with end offsets in [window_min, window_max] are reported, and the
+     * stream stops scanning once it has passed window_max. */
+    u64a window_min;
+    u64a window_max;
+
+    /** \brief Number of valid bytes at the end of the history buffer. This
+     * is at most RoseEngine::historyRequired and the offset, and is less
+     * when no live engine needs that much history. */
+    u32 hlen;
+
+    /** \brief STREAM_DIRTY_* flags for the regions of stream state written
+     * since it was last initialised, so that a reset can skip the rest. */
+    u32 dirty;
+
+    /** \brief Number of bytes written to a coalescing stream that are held
+     * in its pending buffer and have not been scanned yet. */
+    u32 pending;
+
+    /** \brief Capacity of the pending buffer that follows the stream state,
+     * or zero if writes to the stream are scanned at once. Like the allocator,
+     * this belongs to the allocation and is kept by copies. */
+    u32 pending_cap;
+
+    /** \brief Allocator context the stream was allocated with, or NULL for
+     * the stream allocator. This belongs to the allocation rather than the
+     * stream state, so it is kept when another stream is copied over this
+     * one. */
+    const hs_allocator_t *allocator;
 };
 
+/** \brief Stream dirty flag: Rose and engine state (role multibits, active
+ * arrays, engine and matcher state, history) has been written. */
+#define STREAM_DIRTY_STATE  (1U << 0)
+
+/** \brief Stream dirty flag: the status byte or the report logs (exhaustion,
+ * logical and combination vectors, match counts, SOM) may have been
+ * written. */
+#define STREAM_DIRTY_LOGS   (1U << 1)
+
+/** \brief Stream dirty flag: writes have been buffered in the pending buffer
+ * of a coalescing stream. */
+#define STREAM_DIRTY_PENDING (1U << 2)
+
+#define STREAM_DIRTY_ALL                                                      \
+    (STREAM_DIRTY_STATE | STREAM_DIRTY_LOGS | STREAM_DIRTY_PENDING)
+
 #define getMultiState(hs_s)      ((char *)(hs_s) + sizeof(*(hs_s)))
 #define getMultiStateConst(hs_s) ((const char *)(hs_s) + sizeof(*(hs_s)))
 
+/** \brief The pending buffer of a coalescing stream, which follows the Rose
+ * state. */
+#define getPendingBuf(hs_s)                                                   \
+    (getMultiState(hs_s) + (hs_s)->rose->stateOffsets.end)
+#define getPendingBufConst(hs_s)                                              \
+    (getMultiStateConst(hs_s) + (hs_s)->rose->stateOffsets.end)
+
+UNUSED static const u32 STREAM_POOL_MAGIC = 0x53504f4c;
+
+/** \brief Stream pool: a slab of fixed-size stream slots for one database.
+ *
+ * The slots follow the used-slot flags and the free list in the same
+ * allocation; each slot is rounded up to a multiple of the cache line size so
+ * that neighbouring streams never share a line.
+ */
+struct ALIGN_CL_DIRECTIVE hs_stream_pool {
+    u32 magic;
+    u32 count; /**< total number of slots */
+    u32 freeCount; /**< number of entries on the free list */
+    u32 slotSize; /**< bytes per slot, a multiple of 64 */
+    size_t poolSize; /**< total size of the allocation */
+    const struct RoseEngine *rose;
+    char *slots; /**< cache-line aligned slot array */
+    u32 *freeList; /**< stack of free slot indices */
+    u8 *used; /**< non-zero for slots that hold an open stream */
+    struct hs_stream *pristine; /**< freshly opened stream that new slots
+                                 * are reset from */
+    char *pool_alloc; /**< allocation returned by the stream allocator */
+};
+
+UNUSED static const u32 STREAM_CHECKPOINT_MAGIC = 0x53434b50;
+
+/** \brief Stream checkpoint: a stream's state in compressed form (see
+ * stream_compress.h), in a buffer that is kept between checkpoints. */
+struct hs_stream_checkpoint {
+    u32 magic;
+    const struct RoseEngine *rose; /**< engine of the checkpointed stream */
+    size_t used; /**< bytes of buf holding the checkpoint, 0 if empty */
+    size_t capacity; /**< size of buf */
+    char *buf;
+};
+
+UNUSED static const u32 STREAM_SERIAL_MAGIC = 0x53534552;
+
+/** \brief Header of a stream serialized with hs_serialize_stream(), which is
+ * followed by the stream's compressed form (see stream_compress.h).
+ *
+ * The compressed form holds stream offsets and engine state but no pointers,
+ * so the header only needs to tie it to the database: it may only be
+ * deserialized against a database with the same CRC, which fixes both the
+ * bytecode and the platform it was built for. */
+struct hs_serialized_stream_header {
+    u32 magic;
+    u32 version; /**< HS_DB_VERSION of the library that wrote it */
+    u32 crc32; /**< CRC of the database the stream was opened against */
+    u32 length; /**< bytes of compressed stream that follow */
+};
+
 #ifdef __cplusplus
 }
 #endif
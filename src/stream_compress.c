@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Stream state compression.
+ *
+ * The compressed form of a stream is built by walking the Rose state layout
+ * and copying out only the live parts of it: multibits are stored as lists
+ * of set keys (see \ref mmbit_compress), only valid history bytes are kept
+ * and engine stream state is only stored for active engines.
+ *
+ * The same walk, copying between two streams at the same offsets, gives a
+ * sparse stream copy that skips the dead parts of large stream states.
+ */
+
+#include "stream_compress.h"
+
+#include "state.h"
+#include "nfa/nfa_internal.h"
+#include "rose/rose_internal.h"
+#include "util/multibit.h"
+
+#include <string.h>
+
+#define FN_SUFFIX size
+#define STREAM_QUAL const
+#define BUF_QUAL
+
+#define COPY(p, len) currOffset += (len)
+
+#define COPY_MULTIBIT(p, total_bits)                                           \
+    currOffset += mmbit_compsize((const u8 *)(p), total_bits)
+
+#include "stream_compress_impl.h"
+
+#undef FN_SUFFIX
+#undef STREAM_QUAL
+#undef BUF_QUAL
+#undef COPY
+#undef COPY_MULTIBIT
+
+#define FN_SUFFIX compress
+#define STREAM_QUAL const
+#define BUF_QUAL
+
+#define COPY(p, len)                                                           \
+    do {                                                                       \
+        size_t l_ = (len);                                                     \
+        if (currOffset + l_ > buf_size) {                                      \
+            return 0;                                                          \
+        }                                                                      \
+        memcpy(buf + currOffset, (p), l_);                                     \
+        currOffset += l_;                                                      \
+    } while (0)
+
+#define COPY_MULTIBIT(p, total_bits)                                           \
+    do {                                                                       \
+        size_t sz_;                                                            \
+        if (!mmbit_compress((const u8 *)(p), total_bits,                       \
+                            (u8 *)buf + currOffset, &sz_,                      \
+                            buf_size - currOffset)) {                          \
+            return 0;                                                          \
+        }                                                                      \
+        currOffset += sz_;                                                     \
+    } while (0)
+
+#include "stream_compress_impl.h"
+
+#undef FN_SUFFIX
+#undef STREAM_QUAL
+#undef BUF_QUAL
+#undef COPY
+#undef COPY_MULTIBIT
+
+#define FN_SUFFIX expand
+#define STREAM_QUAL
+#define BUF_QUAL const
+
+#define COPY(p, len)                                                           \
+    do {                                                                       \
+        size_t l_ = (len);                                                     \
+        if (currOffset + l_ > buf_size) {                                      \
+            return 0;                                                          \
+        }                                                                      \
+        memcpy((p), buf + currOffset, l_);                                     \
+        currOffset += l_;                                                      \
+    } while (0)
+
+#define COPY_MULTIBIT(p, total_bits)                                           \
+    do {                                                                       \
+        size_t sz_;                                                            \
+        if (!mmbit_decompress((u8 *)(p), total_bits,                           \
+                              (const u8 *)buf + currOffset, &sz_,              \
+                              buf_size - currOffset)) {                        \
+            return 0;                                                          \
+        }                                                                      \
+        currOffset += sz_;                                                     \
+    } while (0)
+
+#include "stream_compress_impl.h"
+
+#undef FN_SUFFIX
+#undef STREAM_QUAL
+#undef BUF_QUAL
+#undef COPY
+#undef COPY_MULTIBIT
+
+/* For the copy, buf is the source stream and each part is copied to the same
+ * offset in the destination stream. */
+#define FN_SUFFIX copy
+#define STREAM_QUAL
+#define BUF_QUAL const
+
+#define COPY(p, len)                                                           \
+    do {                                                                       \
+        size_t l_ = (len);                                                     \
+        memcpy((p), buf + ((const char *)(p) - (const char *)stream), l_);     \
+        currOffset += l_;                                                      \
+    } while (0)
+
+#define COPY_MULTIBIT(p, total_bits)                                           \
+    COPY(p, mmbit_size(total_bits))
+
+#include "stream_compress_impl.h"
+
+#undef FN_SUFFIX
+#undef STREAM_QUAL
+#undef BUF_QUAL
+#undef COPY
+#undef COPY_MULTIBIT
+
+size_t compressed_stream_size(const struct hs_stream *stream) {
+    return sc_size(stream->rose, stream, NULL, 0);
+}
+
+size_t compress_stream(char *buf, size_t buf_size,
+                       const struct hs_stream *stream) {
+    return sc_compress(stream->rose, stream, buf, buf_size);
+}
+
+int expand_stream(struct hs_stream *stream, const struct RoseEngine *rose,
+                  const char *buf, size_t buf_size) {
+    /* Anything not stored in the compressed form is dead, so start from a
+     * clean slate. */
+    const hs_allocator_t *allocator = stream->allocator;
+    u32 pending_cap = stream->pending_cap;
+    memset(stream, 0, sizeof(struct hs_stream) + rose->stateOffsets.end);
+    stream->rose = rose;
+    stream->allocator = allocator;
+    stream->pending_cap = pending_cap;
+
+    size_t used = sc_expand(rose, stream, buf, buf_size);
+    stream->dirty = STREAM_DIRTY_ALL;
+    return used && used == buf_size;
+}
+
+void copy_stream(struct hs_stream *to, const struct hs_stream *from) {
+    const struct RoseEngine *rose = from->rose;
+    size_t stateSize = sizeof(struct hs_stream) + rose->stateOffsets.end;
+    assert(from->pending <= to->pending_cap);
+
+    if (stateSize < SPARSE_COPY_MIN_SIZE) {
+        const hs_allocator_t *allocator = to->allocator;
+        u32 pending_cap = to->pending_cap;
+        memcpy(to, from, stateSize);
+        to->allocator = allocator;
+        to->pending_cap = pending_cap;
+    } else {
+        to->rose = rose;
+        to->dirty = from->dirty;
+        to->pending = from->pending;
+        UNUSED size_t copied =
+            sc_copy(rose, to, (const char *)from, stateSize);
+        DEBUG_PRINTF("copied %zu of %zu bytes\n", copied, stateSize);
+    }
+
+    if (from->pending) {
+        memcpy(getPendingBuf(to), getPendingBufConst(from), from->pending);
+    }
+}
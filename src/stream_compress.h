@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Stream state compression: packs a stream's state down to the parts
+ * that are live and expands it back again.
+ */
+
+#ifndef STREAM_COMPRESS_H
+#define STREAM_COMPRESS_H
+
+#include <stdlib.h>
+
+struct hs_stream;
+struct RoseEngine;
+
+/** \brief Returns the number of bytes required to compress the given stream
+ * with \ref compress_stream. */
+size_t compressed_stream_size(const struct hs_stream *stream);
+
+/** \brief Compress the stream state into \a buf.
+ *
+ * Returns the number of bytes written, or zero if \a buf_size bytes is not
+ * large enough. */
+size_t compress_stream(char *buf, size_t buf_size,
+                       const struct hs_stream *stream);
+
+/** \brief Expand compressed stream state from \a buf into the (already
+ * allocated) stream, which will be set up to match against the given
+ * RoseEngine. The stream keeps its allocator and pending buffer capacity, and
+ * has no pending bytes.
+ *
+ * Returns non-zero on success, or zero if the compressed data is malformed. */
+int expand_stream(struct hs_stream *stream, const struct RoseEngine *rose,
+                  const char *buf, size_t buf_size);
+
+/** \brief Stream states smaller than this are copied whole by \ref
+ * copy_stream, as walking the layout would cost more than it saves. */
+#define SPARSE_COPY_MIN_SIZE 512
+
+/** \brief Copy the live parts of stream \a from into the (already allocated)
+ * stream \a to, which must be for the same RoseEngine.
+ *
+ * Parts of the state that are dead (the stream state of inactive engines,
+ * history that has not been written yet and SOM locations that are not
+ * valid) are not copied, and are left as they were in \a to, as are the
+ * allocator and pending buffer capacity of \a to. Any bytes pending in \a from
+ * are copied, so \a to must have room for them. */
+void copy_stream(struct hs_stream *to, const struct hs_stream *from);
+
+#endif
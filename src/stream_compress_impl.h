@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Stream state compression: the body of the state walk, instantiated
+ * by stream_compress.c once each for sizing, compression and expansion.
+ *
+ * The including file must define FN_SUFFIX, STREAM_QUAL, BUF_QUAL, COPY and
+ * COPY_MULTIBIT.
+ */
+
+#include "util/join.h"
+
+#define COPY_FIELD(x) COPY(&x, sizeof(x))
+
+static
+size_t JOIN(sc_, FN_SUFFIX)(const struct RoseEngine *rose,
+                            STREAM_QUAL struct hs_stream *stream,
+                            UNUSED BUF_QUAL char *buf,
+                            UNUSED size_t buf_size) {
+    size_t currOffset = 0;
+    const struct RoseStateOffsets *so = &rose->stateOffsets;
+    STREAM_QUAL char *state = (STREAM_QUAL char *)stream + sizeof(*stream);
+
+    COPY_FIELD(stream->offset);
+    COPY_FIELD(stream->window_min);
+    COPY_FIELD(stream->window_max);
+    COPY_FIELD(stream->hlen);
+
+    /* runtime status byte, followed by the role state multibit */
+    COPY(state, sizeof(u8));
+    COPY_MULTIBIT(state + sizeof(u8), rose->rolesWithStateCount);
+
+    COPY_MULTIBIT(state + so->activeLeafArray, rose->activeArrayCount);
+    COPY_MULTIBIT(state + so->activeLeftArray, rose->activeLeftCount);
+
+    COPY(state + so->floatingMatcherState, rose->floatingStreamState);
+    COPY(state + so->leftfixLagTable, so->anchorState - so->leftfixLagTable);
+    COPY(state + so->anchorState, so->groups - so->anchorState);
+    COPY(state + so->groups, so->groups_size);
+    COPY(state + so->subgroups, rose->subgroupCount * sizeof(u64a));
+
+    /* Only the history that the stream has kept is live; it lives at the end
+     * of the history buffer. */
+    u32 hlen = stream->hlen;
+    COPY(state + so->history + rose->historyRequired - hlen, hlen);
+
+    COPY_MULTIBIT(state + so->exhausted, rose->ekeyCount);
+    COPY_MULTIBIT(state + so->logicalVec, rose->lkeyCount);
+    COPY_MULTIBIT(state + so->combVec, rose->ckeyCount);
+    COPY_MULTIBIT(state + so->activeCombVec, rose->ckeyCount);
+    COPY(state + so->matchCounts, rose->matchLimitCount * sizeof(u32));
+
+    /* SOM slots: only the locations of valid slots are stored. The somHorizon
+     * check excludes block mode, where there is no SOM location storage. */
+    if (rose->somLocationCount && rose->somHorizon) {
+        u32 count = rose->somLocationCount;
+        COPY_MULTIBIT(state + so->somValid, count);
+        COPY_MULTIBIT(state + so->somWritable, count);
+
+        const u8 *som_valid = (const u8 *)(state + so->somValid);
+        for (u32 i = mmbit_iterate(som_valid, count, MMB_INVALID);
+             i != MMB_INVALID; i = mmbit_iterate(som_valid, count, i)) {
+            COPY(state + so->somLocation + i * rose->somHorizon,
+                 rose->somHorizon);
+        }
+    }
+
+    /* Engine stream state is only stored for engines that are alive; the
+     * state of inactive engines is reinitialised when they are next
+     * triggered. */
+    const u8 *aa = (const u8 *)(state + so->activeLeafArray);
+    u32 aaCount = rose->activeArrayCount;
+    for (u32 qi = mmbit_iterate(aa, aaCount, MMB_INVALID); qi != MMB_INVALID;
+         qi = mmbit_iterate(aa, aaCount, qi)) {
+        const struct NfaInfo *info = getNfaInfoByQueue(rose, qi);
+        const struct NFA *nfa = getNfaByInfo(rose, info);
+        COPY(state + info->stateOffset, nfa->streamStateSize);
+    }
+
+    /* Transient leftfixes are rebuilt from history and have no stream
+     * state. */
+    const u8 *al = (const u8 *)(state + so->activeLeftArray);
+    u32 alCount = rose->activeLeftCount;
+    const struct LeftNfaInfo *left_table = getLeftTable(rose);
+    for (u32 i = mmbit_iterate(al, alCount, MMB_INVALID); i != MMB_INVALID;
+         i = mmbit_iterate(al, alCount, i)) {
+        if (left_table[i].transient) {
+            continue;
+        }
+        u32 qi = i + rose->leftfixBeginQueue;
+        const struct NfaInfo *info = getNfaInfoByQueue(rose, qi);
+        const struct NFA *nfa = getNfaByInfo(rose, info);
+        COPY(state + info->stateOffset, nfa->streamStateSize);
+    }
+
+    return currOffset;
+}
+
+#undef COPY_FIELD
@@ -0,0 +1,578 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: tiered stream store.
+ *
+ * A stream store keeps a stream per flow and moves each stream between three
+ * tiers. Hot and warm streams are resident in an internal stream pool; hot
+ * ones have been scanned since the last compaction pass, warm ones have not.
+ * Cold streams have been compressed (see \ref hs_compress_stream) into a
+ * packed arena and their pool slots returned, so that resident memory follows
+ * the active flows rather than all the open ones.
+ *
+ * Streams go cold in hs_store_compact(), which the owning thread calls
+ * periodically, or when the pool is full and a cold flow needs a slot, in
+ * which case a warm stream is evicted. Scanning a cold flow expands it back
+ * into a pool slot first.
+ *
+ * Arena records are a \ref store_record followed by the compressed stream,
+ * padded to an 8 byte boundary. Records of flows that have been expanded or
+ * closed are marked dead and reclaimed by sliding the live records down once
+ * they make up half of the arena.
+ */
+
+#include "allocator.h"
+#include "hs_internal.h"
+#include "hs_runtime.h"
+#include "ue2common.h"
+
+#include <string.h>
+
+#define STREAM_STORE_MAGIC 0x5353544f
+
+/** \brief Flow is not open; its entry is on the free list. */
+#define FLOW_FREE 0
+
+/** \brief Flow's stream is resident in the pool. */
+#define FLOW_RESIDENT 1
+
+/** \brief Flow's stream is compressed in the arena. */
+#define FLOW_COLD 2
+
+/** \brief Flow id marking a dead arena record. */
+#define DEAD_RECORD 0xffffffffU
+
+/** \brief Initial size of the flow table, in entries. */
+#define MIN_FLOWS 64
+
+/** \brief Smallest arena allocation, in bytes. */
+#define MIN_ARENA 4096
+
+struct store_flow {
+    u8 tier; /**< FLOW_FREE, FLOW_RESIDENT or FLOW_COLD */
+    u32 last_tick; /**< tick at which the flow was last opened or scanned */
+    u32 next_free; /**< next entry on the free list, if FLOW_FREE */
+    u32 len; /**< compressed length, if FLOW_COLD */
+    size_t offset; /**< offset of the arena record, if FLOW_COLD */
+    hs_stream_t *stream; /**< pool stream, if FLOW_RESIDENT */
+};
+
+/** \brief Header of a compressed stream in the arena. */
+struct store_record {
+    u32 flow; /**< owning flow, or DEAD_RECORD */
+    u32 len; /**< bytes of compressed stream that follow */
+};
+
+struct hs_stream_store {
+    u32 magic;
+    u32 hotCount; /**< number of pool slots */
+    u32 resident; /**< number of flows holding a pool slot */
+    u32 cold; /**< number of flows in the arena */
+    u32 flowCount; /**< size of the flow table */
+    u32 freeFlow; /**< head of the flow free list, or flowCount if empty */
+    u32 tick; /**< number of compaction passes so far */
+    u32 hand; /**< eviction clock hand over the flow table */
+    size_t streamSize; /**< bytes of state per resident stream */
+    hs_stream_pool_t *pool;
+    struct store_flow *flows;
+    char *arena;
+    size_t arenaSize; /**< allocated bytes */
+    size_t arenaUsed; /**< bytes of records, live and dead */
+    size_t arenaDead; /**< bytes of dead records */
+    unsigned long long compressions;
+    unsigned long long expansions;
+};
+
+static really_inline
+char validStreamStore(const struct hs_stream_store *store) {
+    return store && store->magic == STREAM_STORE_MAGIC;
+}
+
+static really_inline
+size_t recordSize(size_t len) {
+    return sizeof(struct store_record) + ROUNDUP_N(len, 8);
+}
+
+static really_inline
+struct store_record *recordAt(const struct hs_stream_store *store,
+                              size_t offset) {
+    return (struct store_record *)(store->arena + offset);
+}
+
+/** \brief Moves the live arena records into a buffer of \a size bytes, which
+ * is the current arena if \a size is its size, leaving no dead records. */
+static
+hs_error_t packArena(struct hs_stream_store *store, size_t size) {
+    char *to = store->arena;
+    if (size != store->arenaSize) {
+        to = hs_stream_alloc(size);
+        hs_error_t err = hs_check_alloc(to);
+        if (err != HS_SUCCESS) {
+            hs_stream_free(to);
+            return err;
+        }
+    }
+
+    size_t in = 0, out = 0;
+    while (in < store->arenaUsed) {
+        const struct store_record *rec = recordAt(store, in);
+        size_t rsize = recordSize(rec->len);
+        if (rec->flow != DEAD_RECORD) {
+            assert(out + rsize <= size);
+            memmove(to + out, rec, rsize);
+            store->flows[((const struct store_record *)(to + out))->flow]
+                .offset = out;
+            out += rsize;
+        }
+        in += rsize;
+    }
+
+    DEBUG_PRINTF("packed arena from %zu to %zu bytes in %zu\n",
+                 store->arenaUsed, out, size);
+    if (to != store->arena) {
+        hs_stream_free(store->arena);
+        store->arena = to;
+        store->arenaSize = size;
+    }
+    store->arenaUsed = out;
+    store->arenaDead = 0;
+    return HS_SUCCESS;
+}
+
+/** \brief Makes room for a record of \a rsize bytes at the end of the arena,
+ * reclaiming dead records or growing it as needed. */
+static
+hs_error_t reserveArena(struct hs_stream_store *store, size_t rsize) {
+    if (store->arenaUsed + rsize <= store->arenaSize) {
+        return HS_SUCCESS;
+    }
+
+    size_t live = store->arenaUsed - store->arenaDead;
+    size_t size = store->arenaSize;
+    if (live + rsize > size / 2) {
+        size = MAX(size, MIN_ARENA);
+        while (live + rsize > size / 2) {
+            size *= 2;
+        }
+    }
+    return packArena(store, size);
+}
+
+static
+void killRecord(struct hs_stream_store *store, struct store_flow *f) {
+    assert(f->tier == FLOW_COLD);
+    recordAt(store, f->offset)->flow = DEAD_RECORD;
+    store->arenaDead += recordSize(f->len);
+    store->cold--;
+}
+
+/** \brief Compresses a resident flow into the arena and returns its slot to
+ * the pool. */
+static
+hs_error_t freezeFlow(struct hs_stream_store *store, u32 flow) {
+    struct store_flow *f = &store->flows[flow];
+    assert(f->tier == FLOW_RESIDENT);
+
+    size_t len = 0;
+    hs_error_t err = hs_compress_stream(f->stream, NULL, 0, &len);
+    if (err != HS_INSUFFICIENT_SPACE && err != HS_SUCCESS) {
+        return err;
+    }
+
+    size_t rsize = recordSize(len);
+    err = reserveArena(store, rsize);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    struct store_record *rec = recordAt(store, store->arenaUsed);
+    size_t used = 0;
+    err = hs_compress_stream(f->stream, (char *)(rec + 1), len, &used);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+    assert(used == len);
+    rec->flow = flow;
+    rec->len = (u32)len;
+
+    /* no scratch or callback: the slot is returned without EOD matching */
+    err = hs_close_stream_to_pool(store->pool, f->stream, NULL, NULL, NULL);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    DEBUG_PRINTF("flow %u frozen in %zu bytes at %zu\n", flow, len,
+                 store->arenaUsed);
+    f->tier = FLOW_COLD;
+    f->stream = NULL;
+    f->offset = store->arenaUsed;
+    f->len = (u32)len;
+    store->arenaUsed += rsize;
+    store->resident--;
+    store->cold++;
+    store->compressions++;
+    return HS_SUCCESS;
+}
+
+/** \brief Frees a pool slot by freezing a resident flow, preferring one that
+ * is warm. */
+static
+hs_error_t evictFlow(struct hs_stream_store *store) {
+    assert(store->resident == store->hotCount);
+
+    u32 victim = store->flowCount;
+    u32 any = store->flowCount;
+    for (u32 i = 0; i < store->flowCount; i++) {
+        u32 flow = store->hand;
+        store->hand = flow + 1 == store->flowCount ? 0 : flow + 1;
+        const struct store_flow *f = &store->flows[flow];
+        if (f->tier != FLOW_RESIDENT) {
+            continue;
+        }
+        if (f->last_tick != store->tick) {
+            victim = flow;
+            break;
+        }
+        if (any == store->flowCount) {
+            any = flow;
+        }
+    }
+
+    if (victim == store->flowCount) {
+        victim = any;
+    }
+    assert(victim < store->flowCount);
+    DEBUG_PRINTF("evicting flow %u\n", victim);
+    return freezeFlow(store, victim);
+}
+
+/** \brief Takes a pool stream, evicting another flow if the pool is full. */
+static
+hs_error_t takeStream(struct hs_stream_store *store, hs_stream_t **stream) {
+    if (store->resident == store->hotCount) {
+        hs_error_t err = evictFlow(store);
+        if (err != HS_SUCCESS) {
+            return err;
+        }
+    }
+
+    hs_error_t err = hs_open_stream_from_pool(store->pool, 0, stream);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+    store->resident++;
+    return HS_SUCCESS;
+}
+
+/** \brief Expands a cold flow back into a pool slot. */
+static
+hs_error_t thawFlow(struct hs_stream_store *store, u32 flow) {
+    hs_stream_t *stream = NULL;
+    hs_error_t err = takeStream(store, &stream);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    /* Read the record only now, as eviction may have moved it. */
+    struct store_flow *f = &store->flows[flow];
+    assert(f->tier == FLOW_COLD);
+    const struct store_record *rec = recordAt(store, f->offset);
+    assert(rec->flow == flow);
+    err = hs_reset_and_expand_stream(stream, (const char *)(rec + 1),
+                                     rec->len, NULL, NULL, NULL);
+    if (err != HS_SUCCESS) {
+        hs_close_stream_to_pool(store->pool, stream, NULL, NULL, NULL);
+        store->resident--;
+        return err;
+    }
+
+    DEBUG_PRINTF("flow %u thawed from %u bytes\n", flow, f->len);
+    killRecord(store, f);
+    f->tier = FLOW_RESIDENT;
+    f->stream = stream;
+    store->expansions++;
+    return HS_SUCCESS;
+}
+
+/** \brief Doubles the flow table, which must have no free entries. */
+static
+hs_error_t growFlows(struct hs_stream_store *store) {
+    assert(store->freeFlow == store->flowCount);
+    if (store->flowCount > (1U << 30)) {
+        return HS_NOMEM;
+    }
+    u32 count = store->flowCount ? store->flowCount * 2 : MIN_FLOWS;
+
+    struct store_flow *flows = hs_stream_alloc(sizeof(*flows) * count);
+    hs_error_t err = hs_check_alloc(flows);
+    if (err != HS_SUCCESS) {
+        hs_stream_free(flows);
+        return err;
+    }
+
+    if (store->flows) {
+        memcpy(flows, store->flows, sizeof(*flows) * store->flowCount);
+        hs_stream_free(store->flows);
+    }
+    memset(flows + store->flowCount, 0,
+           sizeof(*flows) * (count - store->flowCount));
+    for (u32 i = store->flowCount; i < count; i++) {
+        flows[i].tier = FLOW_FREE;
+        flows[i].next_free = i + 1; /* the last is the table size: empty */
+    }
+    store->freeFlow = store->flowCount;
+    store->flows = flows;
+    store->flowCount = count;
+    return HS_SUCCESS;
+}
+
+static really_inline
+struct store_flow *getFlow(struct hs_stream_store *store, unsigned int flow) {
+    if (!validStreamStore(store) || flow >= store->flowCount
+        || store->flows[flow].tier == FLOW_FREE) {
+        return NULL;
+    }
+    return &store->flows[flow];
+}
+
+static
+void releaseFlow(struct hs_stream_store *store, u32 flow) {
+    struct store_flow *f = &store->flows[flow];
+    f->tier = FLOW_FREE;
+    f->stream = NULL;
+    f->next_free = store->freeFlow;
+    store->freeFlow = flow;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_alloc_stream_store(const hs_database_t *db,
+                                 unsigned int hot_count,
+                                 hs_stream_store_t **store) {
+    if (!store) {
+        return HS_INVALID;
+    }
+
+    *store = NULL;
+
+    size_t streamSize = 0;
+    hs_error_t err = hs_stream_size(db, &streamSize);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    struct hs_stream_store *s = hs_stream_alloc(sizeof(*s));
+    err = hs_check_alloc(s);
+    if (err != HS_SUCCESS) {
+        hs_stream_free(s);
+        return err;
+    }
+    memset(s, 0, sizeof(*s));
+
+    err = hs_alloc_stream_pool(db, hot_count, &s->pool);
+    if (err != HS_SUCCESS) {
+        hs_stream_free(s);
+        return err;
+    }
+
+    s->magic = STREAM_STORE_MAGIC;
+    s->hotCount = hot_count;
+    s->streamSize = streamSize;
+    *store = s;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_free_stream_store(hs_stream_store_t *store) {
+    if (!store) {
+        return HS_SUCCESS;
+    }
+
+    if (!validStreamStore(store)) {
+        return HS_INVALID;
+    }
+
+    hs_free_stream_pool(store->pool);
+    hs_stream_free(store->flows);
+    hs_stream_free(store->arena);
+    store->magic = 0;
+    hs_stream_free(store);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_store_open_stream(hs_stream_store_t *store,
+                                UNUSED unsigned int flags,
+                                unsigned int *flow) {
+    if (!flow || !validStreamStore(store)) {
+        return HS_INVALID;
+    }
+
+    if (store->freeFlow == store->flowCount) {
+        hs_error_t err = growFlows(store);
+        if (err != HS_SUCCESS) {
+            return err;
+        }
+    }
+
+    hs_stream_t *stream = NULL;
+    hs_error_t err = takeStream(store, &stream);
+    if (err != HS_SUCCESS) {
+        return err;
+    }
+
+    u32 id = store->freeFlow;
+    struct store_flow *f = &store->flows[id];
+    store->freeFlow = f->next_free;
+    f->tier = FLOW_RESIDENT;
+    f->stream = stream;
+    f->last_tick = store->tick;
+
+    DEBUG_PRINTF("opened flow %u\n", id);
+    *flow = id;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_store_scan_stream(hs_stream_store_t *store, unsigned int flow,
+                                const char *data, unsigned int length,
+                                unsigned int flags, hs_scratch_t *scratch,
+                                match_event_handler onEvent, void *context) {
+    struct store_flow *f = getFlow(store, flow);
+    if (!f) {
+        return HS_INVALID;
+    }
+
+    if (f->tier == FLOW_COLD) {
+        hs_error_t err = thawFlow(store, flow);
+        if (err != HS_SUCCESS) {
+            return err;
+        }
+    }
+
+    f->last_tick = store->tick;
+    return hs_scan_stream(f->stream, data, length, flags, scratch, onEvent,
+                          context);
+}
+
+HS_PUBLIC_API
+hs_error_t hs_store_close_stream(hs_stream_store_t *store, unsigned int flow,
+                                 hs_scratch_t *scratch,
+                                 match_event_handler onEvent, void *context) {
+    struct store_flow *f = getFlow(store, flow);
+    if (!f) {
+        return HS_INVALID;
+    }
+
+    if (f->tier == FLOW_COLD) {
+        if (!onEvent) {
+            /* no EOD matches wanted: the record can just be dropped */
+            killRecord(store, f);
+            releaseFlow(store, flow);
+            return HS_SUCCESS;
+        }
+        hs_error_t err = thawFlow(store, flow);
+        if (err != HS_SUCCESS) {
+            return err;
+        }
+    }
+
+    hs_error_t err = hs_close_stream_to_pool(store->pool, f->stream, scratch,
+                                             onEvent, context);
+    store->resident--;
+    releaseFlow(store, flow);
+    return err;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_store_compact(hs_stream_store_t *store,
+                            unsigned int idle_limit) {
+    if (!validStreamStore(store)) {
+        return HS_INVALID;
+    }
+
+    for (u32 i = 0; i < store->flowCount; i++) {
+        const struct store_flow *f = &store->flows[i];
+        if (f->tier == FLOW_RESIDENT
+            && store->tick - f->last_tick >= idle_limit) {
+            hs_error_t err = freezeFlow(store, i);
+            if (err != HS_SUCCESS) {
+                return err;
+            }
+        }
+    }
+
+    /* Reclaim dead records, and give memory back once the arena is mostly
+     * empty. */
+    size_t live = store->arenaUsed - store->arenaDead;
+    if (store->arenaSize > MIN_ARENA && live < store->arenaSize / 4) {
+        size_t size = MAX(ROUNDUP_N(live * 2, 64), MIN_ARENA);
+        hs_error_t err = packArena(store, size);
+        if (err != HS_SUCCESS) {
+            return err;
+        }
+    } else if (store->arenaDead > store->arenaUsed / 2) {
+        hs_error_t err = packArena(store, store->arenaSize);
+        if (err != HS_SUCCESS) {
+            return err;
+        }
+    }
+
+    store->tick++;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_stream_store_stats(const hs_stream_store_t *store,
+                                 hs_stream_store_info_t *stats) {
+    if (!stats || !validStreamStore(store)) {
+        return HS_INVALID;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    for (u32 i = 0; i < store->flowCount; i++) {
+        const struct store_flow *f = &store->flows[i];
+        if (f->tier == FLOW_RESIDENT) {
+            if (f->last_tick == store->tick) {
+                stats->hot++;
+            } else {
+                stats->warm++;
+            }
+        } else if (f->tier == FLOW_COLD) {
+            stats->cold_bytes += f->len;
+        }
+    }
+    assert(stats->hot + stats->warm == store->resident);
+    stats->cold = store->cold;
+    stats->resident_bytes = (unsigned long long)store->resident
+                            * store->streamSize;
+    stats->arena_bytes = store->arenaSize;
+    stats->compressions = store->compressions;
+    stats->expansions = store->expansions;
+    return HS_SUCCESS;
+}
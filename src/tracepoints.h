@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: optional static tracepoints at engine boundaries.
+ *
+ * When the library is configured with TRACEPOINTS and <sys/sdt.h> is
+ * available, the boundaries below are marked with SystemTap-style USDT probes
+ * in the "hyperscan" provider, which bpftrace, bcc, perf and SystemTap can
+ * attach to in a running process. A probe that is not attached is a single
+ * nop plus a note in the ELF file, so these are left in optimised builds. In
+ * other builds, the hooks compile away to nothing.
+ *
+ * Probes and their arguments:
+ *
+ *  - hwlm_exec_start(table, len, start) and hwlm_exec_end(table, rv): a
+ *    literal matcher scan of len bytes from start.
+ *  - rose_literal_start(id, end) and rose_literal_end(id, rv): the Rose
+ *    program for literal id, matched ending at stream offset end.
+ *  - nfa_queue_exec_start(queue, type, end) and nfa_queue_exec_end(queue, rv):
+ *    running the engine for a queue up to location end.
+ *  - catchup_start(loc) and catchup_end(loc, rv): catching engines up to loc.
+ *  - small_write(len): the small write engine scanning a block.
+ *  - stream_open(stream) and stream_close(stream, offset).
+ */
+
+#ifndef TRACEPOINTS_H
+#define TRACEPOINTS_H
+
+#ifdef HS_TRACEPOINTS
+
+#include <sys/sdt.h>
+
+#define HS_TRACE1(name, a) DTRACE_PROBE1(hyperscan, name, a)
+#define HS_TRACE2(name, a, b) DTRACE_PROBE2(hyperscan, name, a, b)
+#define HS_TRACE3(name, a, b, c) DTRACE_PROBE3(hyperscan, name, a, b, c)
+
+#else // HS_TRACEPOINTS
+
+#define HS_TRACE1(name, a) do { } while (0)
+#define HS_TRACE2(name, a, b) do { } while (0)
+#define HS_TRACE3(name, a, b, c) do { } while (0)
+
+#endif // HS_TRACEPOINTS
+
+#endif // TRACEPOINTS_H
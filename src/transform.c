@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Runtime: input transforms fused with stream scanning.
+ *
+ * hs_scan_stream_transformed() runs the built-in transforms over a block of
+ * input at a time into a buffer of TRANSFORM_BLOCK bytes, passes that through
+ * the custom transform if there is one, and scans it before moving on, so
+ * that the transformed data is scanned while it is still in cache.
+ *
+ * The built-in transforms are done in a single pass. Sixteen bytes at a time
+ * are checked with a pair of nibble lookups for bytes that start an escape or
+ * are whitespace; blocks without any are case folded in a vector and copied
+ * out, and other blocks are run through a byte at a time state machine, which
+ * also carries partial escapes from one write to the next.
+ *
+ * For each transformed byte of the block most recently scanned, the map holds
+ * the offset in the original data just past the last input byte it depends
+ * on, for hs_transform_map_offset().
+ */
+
+#include "allocator.h"
+#include "hs_internal.h"
+#include "hs_runtime.h"
+#include "ue2common.h"
+#include "util/compare.h"
+#include "util/simd_utils.h"
+
+#include <string.h>
+
+#define TRANSFORM_MAGIC 0x58464f52
+
+/** \brief Transformed bytes scanned at a time. */
+#define TRANSFORM_BLOCK 16384
+
+/** \brief Most bytes a step of the built-in transforms can write: sixteen
+ * input bytes, each of which may flush a held-back escape. */
+#define TRANSFORM_STEP_MAX (16 * 3)
+
+#define BUILTIN_TRANSFORMS                                                     \
+    (HS_TRANSFORM_URL_DECODE | HS_TRANSFORM_SQUEEZE_SPACE |                    \
+     HS_TRANSFORM_LOWERCASE)
+
+/** \brief Escape state: no escape in progress. */
+#define ESC_NONE 0
+
+/** \brief Escape state: seen '%'. */
+#define ESC_PERCENT 1
+
+/** \brief Escape state: seen '%' and one hex digit. */
+#define ESC_HEX 2
+
+struct hs_transform {
+    u32 magic;
+    u32 flags; /**< HS_TRANSFORM_* flags */
+    hs_transform_func_t func; /**< custom transform, or NULL */
+    void *context; /**< context for func */
+    u8 esc_state; /**< ESC_NONE, ESC_PERCENT or ESC_HEX */
+    u8 esc_hex; /**< first hex digit, if ESC_HEX */
+    u8 last_space; /**< last byte written was a squeezed space */
+    u8 special_lo[16]; /**< nibble lookups for bytes needing the slow path */
+    u8 special_hi[16];
+    u64a in_offset; /**< bytes of original data consumed */
+    u64a out_offset; /**< transformed bytes scanned */
+    u64a block_in; /**< in_offset at the start of the last block */
+    u64a block_out; /**< out_offset at the start of the last block */
+    u32 block_len; /**< transformed bytes in the last block */
+    u32 len; /**< bytes written to buf by the built-in transforms */
+    const u64a *block_map; /**< map of the last block */
+    char *buf; /**< output of the built-in transforms */
+    u64a *map; /**< map for buf */
+    char *cbuf; /**< output of the custom transform */
+    u32 *cmap; /**< custom transform's map, relative to its input */
+    u64a *fmap; /**< map for cbuf */
+};
+
+/* Nibble lookups matching 'A'..'Z': bit 0 for 0x41..0x4f, bit 1 for
+ * 0x50..0x5a. */
+static const u8 upper_lo[16] = {
+    2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 1, 1, 1, 1, 1
+};
+static const u8 upper_hi[16] = {
+    0, 0, 0, 0, 1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static really_inline
+char validTransform(const struct hs_transform *xf) {
+    return xf && xf->magic == TRANSFORM_MAGIC;
+}
+
+static really_inline
+m128 nibbleMatch(m128 v, const u8 *lo_tbl, const u8 *hi_tbl) {
+    const m128 low4bits = set16x8(0xf);
+    m128 lo = pshufb(loadu128(lo_tbl), and128(v, low4bits));
+    m128 hi = pshufb(loadu128(hi_tbl), and128(rshift64_m128(v, 4), low4bits));
+    return and128(lo, hi);
+}
+
+static really_inline
+m128 foldCase(m128 v) {
+    m128 upper = not128(eq128(nibbleMatch(v, upper_lo, upper_hi),
+                              zeroes128()));
+    return or128(v, and128(upper, set16x8(0x20)));
+}
+
+static really_inline
+char isSqueezeSpace(u8 c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static really_inline
+int hexValue(u8 c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = mytolower(c);
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/** \brief Runs a byte decoded by the escape stage through the rest of the
+ * built-in transforms. */
+static really_inline
+void emitByte(struct hs_transform *xf, u8 c, u64a end) {
+    if (xf->flags & HS_TRANSFORM_SQUEEZE_SPACE) {
+        if (isSqueezeSpace(c)) {
+            if (xf->last_space) {
+                return;
+            }
+            xf->last_space = 1;
+            c = ' ';
+        } else {
+            xf->last_space = 0;
+        }
+    }
+    if (xf->flags & HS_TRANSFORM_LOWERCASE) {
+        c = mytolower(c);
+    }
+    xf->buf[xf->len] = c;
+    xf->map[xf->len] = end;
+    xf->len++;
+}
+
+/** \brief Passes on an escape that turned out not to be one, the last byte of
+ * which ended at \a end. */
+static really_inline
+void flushEscape(struct hs_transform *xf, u64a end) {
+    if (xf->esc_state == ESC_HEX) {
+        emitByte(xf, '%', end - 1);
+        emitByte(xf, xf->esc_hex, end);
+    } else if (xf->esc_state == ESC_PERCENT) {
+        emitByte(xf, '%', end);
+    }
+    xf->esc_state = ESC_NONE;
+}
+
+/** \brief Runs the input byte \a c, which ends at \a end, through the
+ * built-in transforms. */
+static really_inline
+void stepByte(struct hs_transform *xf, u8 c, u64a end) {
+    if (!(xf->flags & HS_TRANSFORM_URL_DECODE)) {
+        emitByte(xf, c, end);
+        return;
+    }
+
+    int val = hexValue(c);
+    if (xf->esc_state == ESC_PERCENT && val >= 0) {
+        xf->esc_state = ESC_HEX;
+        xf->esc_hex = c;
+        return;
+    }
+    if (xf->esc_state == ESC_HEX && val >= 0) {
+        xf->esc_state = ESC_NONE;
+        emitByte(xf, (u8)(hexValue(xf->esc_hex) << 4 | val), end);
+        return;
+    }
+
+    flushEscape(xf, end - 1);
+    if (c == '%') {
+        xf->esc_state = ESC_PERCENT;
+        return;
+    }
+    emitByte(xf, c, end);
+}
+
+/** \brief Runs the built-in transforms over input from \a p until the input
+ * is used up or the buffer is nearly full; returns the new input pointer. */
+static
+const u8 *transformBlock(struct hs_transform *xf, const u8 *p, const u8 *end,
+                         char last) {
+    const char fold = !!(xf->flags & HS_TRANSFORM_LOWERCASE);
+
+    xf->len = 0;
+    while (p < end && xf->len + TRANSFORM_STEP_MAX <= TRANSFORM_BLOCK) {
+        if (xf->esc_state == ESC_NONE && end - p >= 16) {
+            m128 v = loadu128(p);
+            m128 special = nibbleMatch(v, xf->special_lo, xf->special_hi);
+            if (!isnonzero128(special)) {
+                storeu128(xf->buf + xf->len, fold ? foldCase(v) : v);
+                for (u32 i = 0; i < 16; i++) {
+                    xf->map[xf->len + i] = xf->in_offset + i + 1;
+                }
+                xf->len += 16;
+                xf->in_offset += 16;
+                xf->last_space = 0;
+                p += 16;
+                continue;
+            }
+        }
+
+        u32 n = MIN(16, end - p);
+        for (u32 i = 0; i < n; i++) {
+            stepByte(xf, p[i], xf->in_offset + i + 1);
+        }
+        xf->in_offset += n;
+        p += n;
+    }
+
+    if (p == end && last) {
+        flushEscape(xf, xf->in_offset);
+    }
+    return p;
+}
+
+/** \brief Runs the custom transform over \a len bytes at \a in, which start
+ * at original offset \a in_base and have the map \a map, or follow the
+ * original data byte for byte if \a map is NULL. Returns the bytes written to
+ * cbuf, or -1 if the transform wrote too much. */
+static
+s64a customBlock(struct hs_transform *xf, const char *in, u32 len,
+                 const u64a *map, u64a in_base) {
+    size_t out_len = xf->func(in, len, xf->cbuf, xf->cmap, xf->context);
+    if (out_len > len) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < out_len; i++) {
+        u32 m = xf->cmap[i];
+        if (m > len) {
+            return -1;
+        }
+        if (!m) {
+            xf->fmap[i] = in_base;
+        } else {
+            xf->fmap[i] = map ? map[m - 1] : in_base + m;
+        }
+    }
+    return (s64a)out_len;
+}
+
+static
+void resetTransform(struct hs_transform *xf) {
+    xf->esc_state = ESC_NONE;
+    xf->esc_hex = 0;
+    xf->last_space = 0;
+    xf->in_offset = 0;
+    xf->out_offset = 0;
+    xf->block_in = 0;
+    xf->block_out = 0;
+    xf->block_len = 0;
+    xf->len = 0;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_alloc_transform(unsigned int flags, hs_transform_func_t func,
+                              void *context, hs_transform_t **transform) {
+    if (!transform) {
+        return HS_INVALID;
+    }
+
+    *transform = NULL;
+
+    if ((flags & ~BUILTIN_TRANSFORMS) || (!flags && !func)) {
+        return HS_INVALID;
+    }
+
+    size_t headerSize = ROUNDUP_N(sizeof(struct hs_transform), 8);
+    size_t size = headerSize + TRANSFORM_BLOCK * sizeof(u64a) + TRANSFORM_BLOCK;
+    if (func) {
+        size += TRANSFORM_BLOCK * (sizeof(u64a) + sizeof(u32) + 1);
+    }
+
+    char *mem = hs_misc_alloc(size);
+    hs_error_t err = hs_check_alloc(mem);
+    if (err != HS_SUCCESS) {
+        hs_misc_free(mem);
+        return err;
+    }
+
+    struct hs_transform *xf = (struct hs_transform *)mem;
+    memset(xf, 0, sizeof(*xf));
+    char *p = mem + headerSize;
+    xf->map = (u64a *)p;
+    p += TRANSFORM_BLOCK * sizeof(u64a);
+    if (func) {
+        xf->fmap = (u64a *)p;
+        p += TRANSFORM_BLOCK * sizeof(u64a);
+        xf->cmap = (u32 *)p;
+        p += TRANSFORM_BLOCK * sizeof(u32);
+        xf->cbuf = p;
+        p += TRANSFORM_BLOCK;
+    }
+    xf->buf = p;
+
+    /* bytes that need the byte at a time path: bit 0 for '%', bit 1 for
+     * ' ' and bit 2 for '\t'..'\r' */
+    if (flags & HS_TRANSFORM_URL_DECODE) {
+        xf->special_lo['%' & 0xf] |= 1;
+        xf->special_hi['%' >> 4] |= 1;
+    }
+    if (flags & HS_TRANSFORM_SQUEEZE_SPACE) {
+        xf->special_lo[' ' & 0xf] |= 2;
+        xf->special_hi[' ' >> 4] |= 2;
+        for (u8 c = '\t'; c <= '\r'; c++) {
+            xf->special_lo[c & 0xf] |= 4;
+        }
+        xf->special_hi['\t' >> 4] |= 4;
+    }
+
+    xf->magic = TRANSFORM_MAGIC;
+    xf->flags = flags;
+    xf->func = func;
+    xf->context = context;
+    resetTransform(xf);
+
+    *transform = xf;
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_free_transform(hs_transform_t *transform) {
+    if (!transform) {
+        return HS_SUCCESS;
+    }
+
+    if (!validTransform(transform)) {
+        return HS_INVALID;
+    }
+
+    transform->magic = 0;
+    hs_misc_free(transform);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_reset_transform(hs_transform_t *transform) {
+    if (!validTransform(transform)) {
+        return HS_INVALID;
+    }
+
+    resetTransform(transform);
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_scan_stream_transformed(hs_stream_t *id,
+                                      hs_transform_t *transform,
+                                      const char *data, unsigned int length,
+                                      unsigned int flags,
+                                      hs_scratch_t *scratch,
+                                      match_event_handler onEvent,
+                                      void *ctxt) {
+    struct hs_transform *xf = transform;
+    if (!id || !validTransform(xf) || (!data && length) ||
+        (flags & ~HS_TRANSFORM_LAST)) {
+        return HS_INVALID;
+    }
+
+    const u8 *p = (const u8 *)data;
+    const u8 *end = p + length;
+    const char last = !!(flags & HS_TRANSFORM_LAST);
+
+    do {
+        u64a in_base = xf->in_offset;
+        const char *out;
+        const u64a *map;
+        u32 out_len;
+
+        if (xf->flags & BUILTIN_TRANSFORMS) {
+            p = transformBlock(xf, p, end, last);
+            out = xf->buf;
+            map = xf->map;
+            out_len = xf->len;
+        } else {
+            out_len = MIN(TRANSFORM_BLOCK, end - p);
+            out = (const char *)p;
+            map = NULL;
+            p += out_len;
+            xf->in_offset += out_len;
+        }
+
+        if (xf->func && out_len) {
+            s64a rv = customBlock(xf, out, out_len, map, in_base);
+            if (rv < 0) {
+                DEBUG_PRINTF("custom transform overran its block\n");
+                return HS_INVALID;
+            }
+            out = xf->cbuf;
+            map = xf->fmap;
+            out_len = (u32)rv;
+        }
+
+        xf->block_in = in_base;
+        xf->block_out = xf->out_offset;
+        xf->block_len = out_len;
+        xf->block_map = map;
+        if (!out_len) {
+            continue;
+        }
+
+        DEBUG_PRINTF("scanning block of %u at %llu (from %llu)\n", out_len,
+                     xf->out_offset, in_base);
+        hs_error_t err = hs_scan_stream(id, out, out_len, 0, scratch, onEvent,
+                                        ctxt);
+        xf->out_offset += out_len;
+        if (err != HS_SUCCESS) {
+            return err;
+        }
+    } while (p < end);
+
+    return HS_SUCCESS;
+}
+
+HS_PUBLIC_API
+hs_error_t hs_transform_map_offset(const hs_transform_t *transform,
+                                   unsigned long long to,
+                                   unsigned long long *from) {
+    const struct hs_transform *xf = transform;
+    if (!validTransform(xf) || !from) {
+        return HS_INVALID;
+    }
+
+    if (to < xf->block_out || to > xf->block_out + xf->block_len) {
+        return HS_INVALID;
+    }
+
+    if (to == xf->block_out) {
+        *from = xf->block_in;
+    } else {
+        *from = xf->block_map[to - xf->block_out - 1];
+    }
+    return HS_SUCCESS;
+}
@@ -33,6 +33,7 @@
 #include "util/ue2_containers.h"
 
 #include <utility>
+#include <vector>
 
 namespace ue2 {
 
@@ -44,6 +45,17 @@ struct AccelScheme {
     CharReach double_cr;
     u32 offset = MAX_ACCEL_DEPTH + 1;
     u32 double_offset = 0;
+
+    /* distance scheme: a byte in dist_cr1 followed dist bytes later by one in
+     * dist_cr2; dist == 0 if there is none */
+    CharReach dist_cr1;
+    CharReach dist_cr2;
+    u32 dist = 0;
+    u32 dist_offset = 0;
+
+    /* literal scheme: stop at the start of any of these sequences of classes;
+     * empty if there is none */
+    std::vector<std::vector<CharReach>> literals;
 };
 
 }
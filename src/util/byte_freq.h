@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Byte value frequencies of the data a database is expected to scan.
+ */
+
+#ifndef UTIL_BYTE_FREQ_H
+#define UTIL_BYTE_FREQ_H
+
+#include "ue2common.h"
+
+#include <array>
+#include <vector>
+
+namespace ue2 {
+
+/**
+ * \brief Byte value frequencies of the data a database is expected to scan,
+ * as supplied to hs_set_compile_byte_frequencies() or
+ * hs_set_compile_byte_pair_frequencies().
+ *
+ * Literal matcher construction uses these to estimate how often each part of
+ * the matcher will fire on real traffic, rather than assuming that all byte
+ * values are equally likely. Literal selection uses them to prefer literals
+ * that are rare in the traffic.
+ */
+struct ByteFrequencies {
+    /** \brief Builds a distribution from 256 byte value counts. Every value
+     * is given one extra count so that bytes absent from the sample are
+     * unlikely rather than impossible. */
+    explicit ByteFrequencies(const unsigned long long *counts) {
+        double total = 256;
+        for (u32 c = 0; c < 256; c++) {
+            total += counts[c];
+        }
+        for (u32 c = 0; c < 256; c++) {
+            prob[c] = (counts[c] + 1) / total;
+        }
+    }
+
+    /** \brief Builds a first-order model from 65536 counts of adjacent byte
+     * pairs, where element a * 256 + b counts byte a followed by byte b. Each
+     * row is smoothed in the same way as the byte value counts. */
+    static ByteFrequencies fromPairCounts(const unsigned long long *pairs) {
+        unsigned long long counts[256];
+        for (u32 a = 0; a < 256; a++) {
+            counts[a] = 0;
+            for (u32 b = 0; b < 256; b++) {
+                counts[a] += pairs[a * 256 + b];
+            }
+        }
+
+        ByteFrequencies freq(counts);
+        freq.next_prob.resize(256 * 256);
+        for (u32 a = 0; a < 256; a++) {
+            double total = 256 + (double)counts[a];
+            for (u32 b = 0; b < 256; b++) {
+                freq.next_prob[a * 256 + b] = (pairs[a * 256 + b] + 1) / total;
+            }
+        }
+        return freq;
+    }
+
+    /** \brief Probability of byte value \a c following byte value \a prev;
+     * the plain probability of \a c if there is no pair model. */
+    double probAfter(u8 prev, u8 c) const {
+        return next_prob.empty() ? prob[c] : next_prob[prev * 256 + c];
+    }
+
+    /** \brief Probability of each byte value; these sum to one. */
+    std::array<double, 256> prob;
+
+    /** \brief Probability of each byte value given the one before it,
+     * indexed by prev * 256 + c; empty if only byte counts were supplied. */
+    std::vector<double> next_prob;
+};
+
+} // namespace ue2
+
+#endif
@@ -29,6 +29,7 @@
 #ifndef COMPARE_H
 #define COMPARE_H
 
+#include "simd_utils.h"
 #include "unaligned.h"
 #include "ue2common.h"
 
@@ -95,6 +96,28 @@ u64a theirtoupper64(const u64a x) {
     return v;
 }
 
+/** \brief Upper-cases the ASCII letters in a vector. */
+static really_inline
+m128 toupper128(m128 x) {
+    // Signed compares: bytes with the top bit set are never letters.
+#if defined(HAVE_NEON)
+    int8x16_t sx = vreinterpretq_s8_s32(x);
+    m128 ge_a = vreinterpretq_s32_u8(vcgtq_s8(sx, vdupq_n_s8('a' - 1)));
+    m128 le_z = vreinterpretq_s32_u8(vcltq_s8(sx, vdupq_n_s8('z' + 1)));
+#else
+    m128 ge_a = _mm_cmpgt_epi8(x, set16x8('a' - 1));
+    m128 le_z = _mm_cmplt_epi8(x, set16x8('z' + 1));
+#endif
+    return xor128(x, and128(and128(ge_a, le_z), set16x8(0x20)));
+}
+
+/** \brief Compares 16 bytes caselessly; p2 is assumed to be upper-case. */
+static really_inline
+int cmpNocase128(const u8 *p1, const u8 *p2) {
+    m128 v1 = toupper128(loadu128(p1));
+    return movemask128(eq128(v1, loadu128(p2))) != 0xffff;
+}
+
 static really_inline
 int cmpNocaseNaive(const u8 *p1, const u8 *p2, size_t len) {
     const u8 *pEnd = p1 + len;
@@ -142,6 +165,17 @@ static really_inline
 #endif
 int cmpForward(const u8 *p1, const u8 *p2, size_t len, char nocase) {
     if (len < CMP_SIZE) {
+        if (len >= sizeof(u32)) {
+            // Two overlapping words cover the string.
+            u32 a1 = unaligned_load_u32(p1);
+            u32 b1 = unaligned_load_u32(p1 + len - sizeof(u32));
+            if (nocase) {
+                a1 = theirtoupper32(a1);
+                b1 = theirtoupper32(b1);
+            }
+            return a1 != unaligned_load_u32(p2) ||
+                   b1 != unaligned_load_u32(p2 + len - sizeof(u32));
+        }
         return nocase ? cmpNocaseNaive(p1, p2, len)
                       : cmpCaseNaive(p1, p2, len);
     }
@@ -149,6 +183,18 @@ int cmpForward(const u8 *p1, const u8 *p2, size_t len, char nocase) {
     const u8 *p1_end = p1 + len - CMP_SIZE;
     const u8 *p2_end = p2 + len - CMP_SIZE;
 
+    if (nocase && len >= sizeof(m128)) {
+        // Fold sixteen bytes at a time; the last block may overlap.
+        const u8 *p1_last = p1 + len - sizeof(m128);
+        const u8 *p2_last = p2 + len - sizeof(m128);
+        for (; p1 < p1_last; p1 += sizeof(m128), p2 += sizeof(m128)) {
+            if (cmpNocase128(p1, p2)) {
+                return 1;
+            }
+        }
+        return cmpNocase128(p1_last, p2_last);
+    }
+
     if (nocase) { // Case-insensitive version.
         for (; p1 < p1_end; p1 += CMP_SIZE, p2 += CMP_SIZE) {
             assert(ULOAD(p2) == TOUPPER(ULOAD(p2))); // Already upper-case.
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Compile time budget, after which the compiler falls back to cheaper
+ * strategies.
+ */
+
+#ifndef UTIL_COMPILE_BUDGET_H
+#define UTIL_COMPILE_BUDGET_H
+
+#include "ue2common.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace ue2 {
+
+/**
+ * \brief Deadline for a compile, as set with hs_set_compile_time_budget().
+ *
+ * Passes with a cheaper alternative check \ref exceeded before doing the
+ * expensive work, and record the patterns whose engines were built the
+ * cheap way with \ref markDegraded.
+ */
+class CompileBudget {
+public:
+    explicit CompileBudget(std::chrono::milliseconds limit)
+        : deadline(std::chrono::steady_clock::now() + limit) {}
+
+    /** \brief True once the deadline has passed. This latches, so that all
+     * later passes fall back as well. */
+    bool exceeded() const {
+        if (expired.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        if (std::chrono::steady_clock::now() < deadline) {
+            return false;
+        }
+        expired.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    /** \brief Records that the pattern with external id \a id was compiled
+     * with a cheaper strategy because the budget was exceeded. */
+    void markDegraded(u32 id) {
+        std::lock_guard<std::mutex> guard(lock);
+        degraded.insert(id);
+    }
+
+    /** \brief External ids of the degraded patterns, in ascending order. */
+    std::vector<u32> degradedIds() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return std::vector<u32>(degraded.begin(), degraded.end());
+    }
+
+private:
+    const std::chrono::steady_clock::time_point deadline;
+    mutable std::atomic<bool> expired{false};
+    mutable std::mutex lock; //!< guards degraded
+    std::set<u32> degraded;
+};
+
+} // namespace ue2
+
+#endif // UTIL_COMPILE_BUDGET_H
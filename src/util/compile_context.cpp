@@ -30,6 +30,7 @@
  * \brief Global compile context, describes compile environment.
  */
 #include "compile_context.h"
+#include "compile_budget.h"
 #include "grey.h"
 
 namespace ue2 {
@@ -43,4 +44,8 @@ CompileContext::CompileContext(bool in_isStreaming, bool in_isVectored,
       grey(in_grey) {
 }
 
+bool overBudget(const CompileContext &cc) {
+    return cc.budget && cc.budget->exceeded();
+}
+
 } // namespace ue2
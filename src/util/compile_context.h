@@ -36,8 +36,16 @@
 #include "target_info.h"
 #include "grey.h"
 
+#include <memory>
+
 namespace ue2 {
 
+class CompileBudget;
+class CompileReport;
+class EngineCache;
+class StreamStateUsage;
+struct ByteFrequencies;
+
 /** \brief Structure for describing the compile environment: grey box settings,
  * target arch, mode flags, etc. */
 struct CompileContext {
@@ -52,8 +60,51 @@ struct CompileContext {
 
     /** \brief Greybox structure, allows tuning of all sorts of behaviour. */
     const Grey grey;
+
+    /** \brief Cache of engines from earlier compiles, or nullptr. */
+    EngineCache *engine_cache = nullptr;
+
+    /** \brief HS_MODE_ANY_MATCH: the scan stops at the first match. */
+    bool any_match = false;
+
+    /** \brief HS_MODE_UNORDERED: matches need not be delivered in offset
+     * order. */
+    bool unordered_matches = false;
+
+    /** \brief HS_MODE_SOM_LAZY: compute start of match with reverse NFAs
+     * at match time rather than tracking it in the forward engines. */
+    bool lazy_som = false;
+
+    /** \brief HS_MODE_COST_ATTRIBUTION: record the patterns served by each
+     * literal program and engine, for hs_sample_report(). */
+    bool cost_attribution = false;
+
+    /** \brief Byte frequencies of the expected traffic, or nullptr if none
+     * were supplied with hs_set_compile_byte_frequencies() or
+     * hs_set_compile_byte_pair_frequencies(). */
+    std::shared_ptr<const ByteFrequencies> byte_freq;
+
+    /** \brief Compile time budget, or nullptr if none was set with
+     * hs_set_compile_time_budget(). */
+    CompileBudget *budget = nullptr;
+
+    /** \brief Per-phase time and memory report, or nullptr if none was
+     * requested with hs_set_compile_report(). */
+    CompileReport *report = nullptr;
+
+    /** \brief Stream state attributed to each pattern, or nullptr if no
+     * budget was set with hs_set_stream_state_budget(). */
+    StreamStateUsage *state_usage = nullptr;
+
+    /** \brief Number of threads the compiler may use for passes that can run
+     * in parallel, from hs_set_compile_threads(). */
+    unsigned threads = 1;
 };
 
+/** \brief True if the compile has run past its time budget, and passes with
+ * a cheaper alternative should use it. */
+bool overBudget(const CompileContext &cc);
+
 } // namespace ue2
 
 #endif
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Per-phase compile time and memory report.
+ */
+#include "compile_report.h"
+#include "compile_context.h"
+#include "hs_compile.h"
+#include "verify_types.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+namespace ue2 {
+
+/** \brief Innermost running timer on this thread. */
+static thread_local PhaseTimer *current_timer = nullptr;
+
+/** \brief High-water mark of the process resident set in bytes, or zero if
+ * it is not available on this platform. */
+static
+u64a peakResidentBytes() {
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru)) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return (u64a)ru.ru_maxrss;
+#else
+    return (u64a)ru.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+void CompileReport::record(CompilePhase phase, u64a ns, u32 index,
+                           u64a hwm_before, u64a hwm_after) {
+    assert(phase < PHASE_MAX);
+    lock_guard<mutex> guard(lock);
+    PhaseTotals &p = phases[phase];
+    p.time_ns += ns;
+    p.peak_mem = max(p.peak_mem, hwm_after);
+    if (hwm_after > hwm_before) {
+        p.mem_growth += hwm_after - hwm_before;
+    }
+    if (index != NO_EXPRESSION) {
+        p.expr_ns[index] += ns;
+    }
+}
+
+void CompileReport::fill(hs_compile_stats_t &out) const {
+    lock_guard<mutex> guard(lock);
+    memset(&out, 0, sizeof(out));
+    for (u32 i = 0; i < PHASE_MAX; i++) {
+        const PhaseTotals &p = phases[i];
+        hs_compile_phase_report_t &o = out.phases[i];
+        o.time_ns = p.time_ns;
+        o.peak_memory = p.peak_mem;
+        o.memory_growth = p.mem_growth;
+        out.total_time_ns += p.time_ns;
+
+        // Slowest first; ties go to the lower index.
+        vector<pair<u64a, u32>> by_time;
+        by_time.reserve(p.expr_ns.size());
+        for (const auto &m : p.expr_ns) {
+            by_time.emplace_back(m.second, m.first);
+        }
+        const size_t count = min(by_time.size(),
+                                 (size_t)HS_COMPILE_REPORT_SLOWEST);
+        partial_sort(by_time.begin(), by_time.begin() + count, by_time.end(),
+                     [](const pair<u64a, u32> &a, const pair<u64a, u32> &b) {
+                         return a.first != b.first ? a.first > b.first
+                                                   : a.second < b.second;
+                     });
+        o.slowest_count = verify_u32(count);
+        for (size_t j = 0; j < count; j++) {
+            o.slowest[j] = by_time[j].second;
+            o.slowest_time_ns[j] = by_time[j].first;
+        }
+    }
+}
+
+PhaseTimer::PhaseTimer(const CompileContext &cc, CompilePhase phase_in,
+                       u32 index_in)
+    : report(cc.report), phase(phase_in), index(index_in) {
+    begin();
+}
+
+PhaseTimer::PhaseTimer(CompilePhase phase_in)
+    : report(nullptr), phase(phase_in), index(NO_EXPRESSION) {
+    begin();
+}
+
+void PhaseTimer::begin() {
+    parent = current_timer;
+    if (parent) {
+        if (!report) {
+            report = parent->report;
+        }
+        if (index == NO_EXPRESSION) {
+            index = parent->index;
+        }
+    }
+    if (!report) {
+        return;
+    }
+
+    if (parent) {
+        parent->pause();
+    }
+    current_timer = this;
+    hwm_before = peakResidentBytes();
+    resume();
+}
+
+void PhaseTimer::pause() {
+    elapsed += chrono::duration_cast<chrono::nanoseconds>(
+                   chrono::steady_clock::now() - start).count();
+}
+
+void PhaseTimer::resume() {
+    start = chrono::steady_clock::now();
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (!report) {
+        return;
+    }
+
+    pause();
+    report->record(phase, elapsed, index, hwm_before, peakResidentBytes());
+
+    assert(current_timer == this);
+    current_timer = parent;
+    if (parent) {
+        parent->resume();
+    }
+}
+
+} // namespace ue2
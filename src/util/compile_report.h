@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Per-phase compile time and memory report, as returned by
+ * hs_compile_report().
+ */
+
+#ifndef UTIL_COMPILE_REPORT_H
+#define UTIL_COMPILE_REPORT_H
+
+#include "ue2common.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+struct hs_compile_stats;
+
+namespace ue2 {
+
+struct CompileContext;
+
+/** \brief Compile phases, matching the HS_COMPILE_PHASE_* constants. */
+enum CompilePhase {
+    PHASE_PARSE = 0,       //!< parse and Glushkov construction
+    PHASE_GRAPH = 1,       //!< NFA graph reductions
+    PHASE_VIOLET = 2,      //!< Violet decomposition
+    PHASE_DETERMINISE = 3, //!< NFA to DFA conversion
+    PHASE_ROSE = 4,        //!< Rose build, merges and role aliasing
+    PHASE_BYTECODE = 5,    //!< bytecode emission
+    PHASE_SMALLWRITE = 6,  //!< small write engine build
+    PHASE_MAX = 7
+};
+
+/** \brief Expression index for work that is not attributed to an
+ * expression. */
+static constexpr u32 NO_EXPRESSION = ~0U;
+
+/**
+ * \brief Time and memory accumulated for each phase of a compile, enabled
+ * with hs_set_compile_report().
+ *
+ * Filled in by \ref PhaseTimer, possibly from several compile threads at
+ * once.
+ */
+class CompileReport {
+public:
+    /** \brief Records \a ns of time spent in \a phase on the expression at
+     * \a index, during which the process peak resident set grew from
+     * \a hwm_before to \a hwm_after bytes. */
+    void record(CompilePhase phase, u64a ns, u32 index, u64a hwm_before,
+                u64a hwm_after);
+
+    /** \brief Writes the totals and the slowest expressions of each phase to
+     * \a out. */
+    void fill(struct hs_compile_stats &out) const;
+
+private:
+    struct PhaseTotals {
+        u64a time_ns = 0;
+        u64a peak_mem = 0;
+        u64a mem_growth = 0;
+        std::map<u32, u64a> expr_ns; //!< time by expression index
+    };
+
+    mutable std::mutex lock; //!< guards phases
+    PhaseTotals phases[PHASE_MAX];
+};
+
+/**
+ * \brief Charges the time for which it is in scope to a phase of the
+ * compile's \ref CompileReport. Does nothing if no report was requested.
+ *
+ * Timers nest: while an inner timer runs on the same thread, the enclosing
+ * one is paused, so that time is charged to the innermost phase only. An
+ * inner timer with no report or expression of its own takes them from the
+ * enclosing timer.
+ */
+class PhaseTimer {
+public:
+    PhaseTimer(const CompileContext &cc, CompilePhase phase,
+               u32 index = NO_EXPRESSION);
+    explicit PhaseTimer(CompilePhase phase);
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+    void begin();
+    void pause();
+    void resume();
+
+    CompileReport *report;
+    const CompilePhase phase;
+    u32 index;
+    PhaseTimer *parent = nullptr;
+    u64a elapsed = 0;
+    u64a hwm_before = 0;
+    std::chrono::steady_clock::time_point start;
+};
+
+} // namespace ue2
+
+#endif // UTIL_COMPILE_REPORT_H
@@ -30,113 +30,49 @@
 #include "ue2common.h"
 #include "hs_compile.h" // for HS_MODE_ flags
 #include "hs_internal.h"
+#include "util/cpuid_inline.h"
 
-#ifndef _WIN32
-#include <cpuid.h>
-#endif
-
-// ECX
-#define SSE3 (1 << 0)
-#define SSSE3 (1 << 9)
-#define SSE4_1 (1 << 19)
-#define SSE4_2 (1 << 20)
-#define XSAVE (1 << 27)
-#define AVX (1 << 28)
-
-// EDX
-#define SSE (1 << 25)
-#define SSE2 (1 << 25)
-#define HTT (1 << 28)
-
-// Structured Extended Feature Flags Enumeration Leaf ECX values
-#define BMI (1 << 3)
-#define AVX2 (1 << 5)
-#define BMI2 (1 << 8)
-
-// Extended Control Register 0 (XCR0) values
-#define XCR0_SSE (1 << 1)
-#define XCR0_AVX (1 << 2)
-
-static __inline
-void cpuid(unsigned int op, unsigned int leaf, unsigned int *eax,
-           unsigned int *ebx, unsigned int *ecx, unsigned int *edx) {
-#ifndef _WIN32
-    __cpuid_count(op, leaf, *eax, *ebx, *ecx, *edx);
-#else
-    unsigned int a[4];
-    __cpuidex(a, op, leaf);
-    *eax = a[0];
-    *ebx = a[1];
-    *ecx = a[2];
-    *edx = a[3];
-#endif
-}
-
-static inline
-u64a xgetbv(u32 op) {
-#if defined(_WIN32) || defined(__INTEL_COMPILER)
-    return _xgetbv(op);
-#else
-    u32 a, d;
-    __asm__ volatile (
-            "xgetbv\n"
-            : "=a"(a),
-              "=d"(d)
-            : "c"(op));
-    return ((u64a)d << 32) + a;
-#endif
-}
-
-static
-int check_avx2(void) {
-#if defined(__INTEL_COMPILER)
-    return _may_i_use_cpu_feature(_FEATURE_AVX2);
-#else
-    unsigned int eax, ebx, ecx, edx;
-
-    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+u64a cpuid_flags(void) {
+    u64a cap = 0;
 
-    /* check AVX is supported and XGETBV is enabled by OS */
-    if ((ecx & (AVX | XSAVE)) != (AVX | XSAVE)) {
-        DEBUG_PRINTF("AVX and XSAVE not supported\n");
-        return 0;
+    if (check_avx2()) {
+        DEBUG_PRINTF("AVX2 enabled\n");
+        cap |= HS_CPU_FEATURES_AVX2;
     }
 
-    /* check that SSE and AVX registers are enabled by OS */
-    u64a xcr0 = xgetbv(0);
-    if ((xcr0 & (XCR0_SSE | XCR0_AVX)) != (XCR0_SSE | XCR0_AVX)) {
-        DEBUG_PRINTF("SSE and AVX registers not enabled\n");
-        return 0;
+    if (check_avx512()) {
+        DEBUG_PRINTF("AVX512 enabled\n");
+        cap |= HS_CPU_FEATURES_AVX512;
     }
 
-    /* ECX and EDX contain capability flags */
-    ecx = 0;
-    cpuid(7, 0, &eax, &ebx, &ecx, &edx);
-
-    if (ebx & AVX2) {
-        DEBUG_PRINTF("AVX2 enabled\n");
-        return 1;
+    if (check_avx512vbmi()) {
+        DEBUG_PRINTF("AVX512VBMI enabled\n");
+        cap |= HS_CPU_FEATURES_AVX512VBMI;
     }
 
-    return 0;
+#if !defined(FAT_RUNTIME) && !defined(__AVX2__)
+    cap &= ~HS_CPU_FEATURES_AVX2;
 #endif
-}
-
-u64a cpuid_flags(void) {
-    u64a cap = 0;
 
-    if (check_avx2()) {
-        DEBUG_PRINTF("AVX2 enabled\n");
-        cap |= HS_CPU_FEATURES_AVX2;
-    }
+#if !defined(FAT_RUNTIME) && !defined(__AVX512BW__)
+    cap &= ~HS_CPU_FEATURES_AVX512;
+#endif
 
-#if !defined(__AVX2__)
-    cap &= ~HS_CPU_FEATURES_AVX2;
+#if !defined(FAT_RUNTIME) && !defined(__AVX512VBMI__)
+    cap &= ~HS_CPU_FEATURES_AVX512VBMI;
 #endif
 
     return cap;
 }
 
+#if defined(ARCH_AARCH64)
+
+u32 cpuid_tune(void) {
+    return HS_TUNE_FAMILY_GENERIC;
+}
+
+#else // !ARCH_AARCH64
+
 struct family_id {
     u32 full_family;
     u32 full_model;
@@ -225,3 +161,5 @@ u32 cpuid_tune(void) {
 
     return HS_TUNE_FAMILY_GENERIC;
 }
+
+#endif // ARCH_AARCH64
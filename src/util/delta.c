@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Binary delta encoding, used for database delta patches.
+ */
+
+#include "delta.h"
+#include "unaligned.h"
+
+#include <string.h>
+
+/** \brief Shortest run of bytes that will be encoded as a copy. */
+#define DELTA_MIN_COPY 16
+
+/** \brief Spacing of the base positions entered in the hash table. Any run
+ * of at least DELTA_MIN_COPY + DELTA_STRIDE - 1 common bytes is found. */
+#define DELTA_STRIDE 4
+
+size_t delta_table_entries(size_t base_len) {
+    size_t entries = 1;
+    while (entries < base_len / DELTA_STRIDE) {
+        entries <<= 1;
+    }
+    return entries;
+}
+
+static really_inline
+size_t delta_hash(const u8 *p, size_t mask) {
+    u64a a = unaligned_load_u64a(p);
+    u64a b = unaligned_load_u64a(p + 8);
+    u64a h = a * 0x9e3779b97f4a7c15ULL ^ b * 0xc2b2ae3d27d4eb4fULL;
+    return (size_t)(h >> 32) & mask;
+}
+
+/** \brief Output position for the encoder; counts without writing if the
+ * buffer is NULL. */
+struct delta_out {
+    u8 *buf;
+    size_t len;
+    size_t cap;
+};
+
+static
+int delta_put_varint(struct delta_out *o, u64a v) {
+    do {
+        u8 c = v & 0x7f;
+        v >>= 7;
+        if (v) {
+            c |= 0x80;
+        }
+        if (o->buf) {
+            if (o->len == o->cap) {
+                return 0;
+            }
+            o->buf[o->len] = c;
+        }
+        o->len++;
+    } while (v);
+    return 1;
+}
+
+static
+int delta_put_insert(struct delta_out *o, const u8 *p, size_t len) {
+    if (!len) {
+        return 1;
+    }
+    if (!delta_put_varint(o, (u64a)len << 1)) {
+        return 0;
+    }
+    if (o->buf) {
+        if (o->cap - o->len < len) {
+            return 0;
+        }
+        memcpy(o->buf + o->len, p, len);
+    }
+    o->len += len;
+    return 1;
+}
+
+static
+int delta_put_copy(struct delta_out *o, size_t offset, size_t len) {
+    return delta_put_varint(o, ((u64a)len << 1) | 1) &&
+           delta_put_varint(o, offset);
+}
+
+size_t delta_encode(const char *base, size_t base_len, const char *target,
+                    size_t target_len, char *out, size_t out_len, u32 *table) {
+    const u8 *b = (const u8 *)base;
+    const u8 *t = (const u8 *)target;
+    const size_t entries = delta_table_entries(base_len);
+    const size_t mask = entries - 1;
+    struct delta_out o = { (u8 *)out, 0, out_len };
+
+    // Table entries hold a base position plus one, so that zero means empty.
+    memset(table, 0, entries * sizeof(u32));
+    for (size_t p = 0; p + DELTA_MIN_COPY <= base_len; p += DELTA_STRIDE) {
+        table[delta_hash(b + p, mask)] = (u32)(p + 1);
+    }
+
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + DELTA_MIN_COPY <= target_len) {
+        size_t cand = table[delta_hash(t + i, mask)];
+        if (!cand || memcmp(b + cand - 1, t + i, DELTA_MIN_COPY)) {
+            i++;
+            continue;
+        }
+
+        size_t src = cand - 1;
+
+        // Extend the copy backwards over pending insert bytes, and forwards.
+        while (i > anchor && src && b[src - 1] == t[i - 1]) {
+            i--;
+            src--;
+        }
+        size_t len = DELTA_MIN_COPY;
+        while (i + len < target_len && src + len < base_len &&
+               b[src + len] == t[i + len]) {
+            len++;
+        }
+
+        if (!delta_put_insert(&o, t + anchor, i - anchor) ||
+            !delta_put_copy(&o, src, len)) {
+            return 0;
+        }
+        i += len;
+        anchor = i;
+    }
+
+    if (!delta_put_insert(&o, t + anchor, target_len - anchor)) {
+        return 0;
+    }
+
+    return o.len;
+}
+
+/** \brief Reads a varint, returning zero if the input runs out or the value
+ * is too large. */
+static really_inline
+int delta_get_varint(const u8 **ip, const u8 *iend, u64a *v) {
+    *v = 0;
+    for (u32 shift = 0; shift < 64; shift += 7) {
+        if (*ip == iend) {
+            return 0;
+        }
+        u8 c = *(*ip)++;
+        *v |= (u64a)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int delta_apply(const char *base, size_t base_len, const char *delta,
+                size_t delta_len, char *out, size_t out_len) {
+    const u8 *ip = (const u8 *)delta;
+    const u8 *iend = ip + delta_len;
+    u8 *op = (u8 *)out;
+    const u8 *oend = op + out_len;
+
+    // Stop once the output is complete: anything left is padding.
+    while (op < oend) {
+        u64a header;
+        if (!delta_get_varint(&ip, iend, &header)) {
+            return 0;
+        }
+        u64a len = header >> 1;
+        if (!len || len > (u64a)(oend - op)) {
+            return 0;
+        }
+
+        if (header & 1) {
+            u64a src;
+            if (!delta_get_varint(&ip, iend, &src)) {
+                return 0;
+            }
+            if (src > base_len || len > base_len - src) {
+                return 0;
+            }
+            memcpy(op, base + src, len);
+        } else {
+            if (len > (u64a)(iend - ip)) {
+                return 0;
+            }
+            memcpy(op, ip, len);
+            ip += len;
+        }
+        op += len;
+    }
+
+    return 1;
+}
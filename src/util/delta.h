@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Binary delta encoding, used for database delta patches.
+ *
+ * A delta describes a target buffer in terms of a base buffer, as a sequence
+ * of operations. Each starts with a LEB128 varint holding the operation length
+ * shifted left by one, with the low bit set for a copy. A copy is followed by
+ * a varint holding the offset in the base to copy from; an insert is followed
+ * by its bytes.
+ */
+
+#ifndef UTIL_DELTA_H
+#define UTIL_DELTA_H
+
+#include "ue2common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** \brief Number of u32 entries in the hash table used by \ref delta_encode
+ * for a base of \a base_len bytes. */
+size_t delta_table_entries(size_t base_len);
+
+/** \brief Encodes \a target as a delta against \a base into \a out, using
+ * \a table (of \ref delta_table_entries entries) as scratch space.
+ *
+ * If \a out is NULL, nothing is written. Returns the length of the delta, or
+ * zero if it would exceed \a out_len. */
+size_t delta_encode(const char *base, size_t base_len, const char *target,
+                    size_t target_len, char *out, size_t out_len, u32 *table);
+
+/** \brief Applies the delta of \a delta_len bytes against \a base, which
+ * must produce exactly \a out_len bytes into \a out.
+ *
+ * Any bytes left in the delta once the output is complete are ignored.
+ * Returns non-zero on success, or zero if the delta is malformed. Reads and
+ * writes are bounds checked, so malformed data is safe. */
+int delta_apply(const char *base, size_t base_len, const char *delta,
+                size_t delta_len, char *out, size_t out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UTIL_DELTA_H
@@ -139,20 +139,19 @@ int determinise(Auto &n, std::vector<ds> &dstates_out, dstate_id_t state_limit,
             if (s && succs[s] == succs[s - 1]) {
                 succ_id = dstates[curr_id].next[s - 1];
             } else {
-                typename DstateIdMap::const_iterator dstate_id_iter;
-                dstate_id_iter = dstate_ids.find(succs[s]);
-
-                if (dstate_id_iter != dstate_ids.end()) {
-                    succ_id = dstate_id_iter->second;
+                /* a single lookup both finds an existing state and reserves
+                 * the next id for a new one */
+                const dstate_id_t next_id = dstates.size();
+                auto inserted = dstate_ids.emplace(succs[s], next_id);
+                succ_id = inserted.first->second;
 
+                if (!inserted.second) {
                     if (succ_id > curr_id && !dstates[succ_id].daddy
                         && n.unalpha[s] < N_CHARS) {
                         dstates[succ_id].daddy = curr_id;
                     }
                 } else {
                     statesets.push_back(succs[s]);
-                    succ_id = dstates.size();
-                    dstate_ids[succs[s]] = succ_id;
                     dstates.push_back(ds(alphabet_size));
                     dstates.back().daddy = n.unalpha[s] < N_CHARS ? curr_id : 0;
                 }
@@ -170,7 +169,7 @@ int determinise(Auto &n, std::vector<ds> &dstates_out, dstate_id_t state_limit,
         }
     }
 
-    dstates_out = dstates;
+    dstates_out.swap(dstates);
     if (statesets_out) {
         statesets_out->swap(statesets);
     }
@@ -40,6 +40,10 @@
 #include "multibit.h"
 #include "ue2common.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define MIN_FAT_SIZE 32
 
 struct fatbit {
@@ -50,9 +54,19 @@ struct fatbit {
     u64a tail[];
 };
 
+/** \brief Clear a fatbit of the given size.
+ *
+ * Only as much as a subsequent set or iterate will read is zeroed: a single
+ * word for flat models of up to 64 bits, and the root block for multi-level
+ * models, whose lower blocks are cleared lazily by mmbit_set(). This keeps the
+ * cost of a clear independent of the number of keys. */
 static really_inline
-void fatbit_clear(struct fatbit *bits) {
+void fatbit_clear(struct fatbit *bits, u32 total_bits) {
     assert(ISALIGNED(bits));
+    if (total_bits <= MMB_KEY_BITS || !mmbit_is_flat_model(total_bits)) {
+        bits->fb_int.flat[0] = 0;
+        return;
+    }
     memset(bits, 0, sizeof(struct fatbit));
 }
 
@@ -89,4 +103,8 @@ u32 fatbit_iterate(const struct fatbit *bits, u32 total_bits, u32 it_in) {
  */
 u32 fatbit_size(u32 total_bits);
 
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
 #endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Logical combination data structures shared by the compiler and
+ * runtime.
+ */
+
+#ifndef LOGICAL_H
+#define LOGICAL_H
+
+#include "ue2common.h"
+
+/** Index meaning a given logical key is invalid. */
+#define INVALID_LKEY    (~(u32)0)
+
+/** Logical operation: value is the negation of the left operand. */
+#define LOGICAL_OP_NOT  0
+/** Logical operation: value is the AND of the two operands. */
+#define LOGICAL_OP_AND  1
+/** Logical operation: value is the OR of the two operands. */
+#define LOGICAL_OP_OR   2
+
+/** \brief A single operation in a logical combination.
+ *
+ * Operands and results are logical keys: indices into the logical vector in
+ * stream state. Sub-expressions are assigned keys first-come, first-served,
+ * and each operation has a key of its own to hold its result. */
+struct LogicalOp {
+    u32 id; /**< logical key holding the result of this operation */
+    u32 op; /**< one of the LOGICAL_OP_* values */
+    u32 lo; /**< logical key of the left operand */
+    u32 ro; /**< logical key of the right operand, unused for NOT */
+};
+
+/** \brief Information about a logical combination. */
+struct CombInfo {
+    u32 id;     /**< external report ID for the combination */
+    u32 start;  /**< index of the first operation in the logical tree */
+    u32 end;    /**< one past the index of the last operation */
+    u32 result; /**< logical key holding the combination's value */
+};
+
+#endif
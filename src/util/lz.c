@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Simple LZ77 byte compressor, used for compressed serialized
+ * databases.
+ */
+
+#include "lz.h"
+#include "unaligned.h"
+
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 0xffff
+#define LZ_NIBBLE_MAX 15
+
+static really_inline
+u32 lz_hash(u32 seq) {
+    return (seq * 2654435761U) >> 16;
+}
+
+/** \brief Writes the continuation bytes of a length of \a len beyond the
+ * nibble. Returns NULL if \a out runs out of space. */
+static
+u8 *lz_put_length(u8 *op, const u8 *oend, size_t len) {
+    for (;;) {
+        if (op == oend) {
+            return NULL;
+        }
+        if (len < 255) {
+            *op++ = (u8)len;
+            return op;
+        }
+        *op++ = 255;
+        len -= 255;
+    }
+}
+
+/** \brief Writes a block of \a lit_len literals followed by a match of
+ * \a match_len bytes at \a offset, or no match if \a match_len is zero.
+ * Returns NULL if \a out runs out of space. */
+static
+u8 *lz_put_block(u8 *op, const u8 *oend, const u8 *lit, size_t lit_len,
+                 size_t offset, size_t match_len) {
+    if (op == oend) {
+        return NULL;
+    }
+
+    u8 *token = op++;
+    u8 lit_nibble = lit_len < LZ_NIBBLE_MAX ? lit_len : LZ_NIBBLE_MAX;
+    *token = lit_nibble << 4;
+    if (lit_nibble == LZ_NIBBLE_MAX) {
+        op = lz_put_length(op, oend, lit_len - LZ_NIBBLE_MAX);
+        if (!op) {
+            return NULL;
+        }
+    }
+
+    if ((size_t)(oend - op) < lit_len) {
+        return NULL;
+    }
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (!match_len) {
+        return op;
+    }
+
+    assert(match_len >= LZ_MIN_MATCH);
+    assert(offset && offset <= LZ_MAX_OFFSET);
+
+    if (oend - op < 2) {
+        return NULL;
+    }
+    *op++ = offset & 0xff;
+    *op++ = offset >> 8;
+
+    size_t extra = match_len - LZ_MIN_MATCH;
+    u8 match_nibble = extra < LZ_NIBBLE_MAX ? extra : LZ_NIBBLE_MAX;
+    *token |= match_nibble;
+    if (match_nibble == LZ_NIBBLE_MAX) {
+        op = lz_put_length(op, oend, extra - LZ_NIBBLE_MAX);
+    }
+    return op;
+}
+
+size_t lz_compress(const char *in, size_t in_len, char *out, size_t out_len,
+                   u32 *table) {
+    const u8 *src = (const u8 *)in;
+    u8 *op = (u8 *)out;
+    const u8 *oend = op + out_len;
+
+    // Table entries hold a position plus one, so that zero means empty.
+    memset(table, 0, LZ_TABLE_ENTRIES * sizeof(u32));
+
+    size_t anchor = 0;
+    size_t i = 0;
+    while (in_len >= LZ_MIN_MATCH && i <= in_len - LZ_MIN_MATCH) {
+        u32 seq = unaligned_load_u32(src + i);
+        u32 h = lz_hash(seq);
+        size_t cand = table[h];
+        table[h] = (u32)(i + 1);
+
+        if (cand && i - (cand - 1) <= LZ_MAX_OFFSET &&
+            unaligned_load_u32(src + cand - 1) == seq) {
+            size_t ref = cand - 1;
+            size_t len = LZ_MIN_MATCH;
+            while (i + len < in_len && src[ref + len] == src[i + len]) {
+                len++;
+            }
+
+            op = lz_put_block(op, oend, src + anchor, i - anchor, i - ref,
+                              len);
+            if (!op) {
+                return 0;
+            }
+            i += len;
+            anchor = i;
+            continue;
+        }
+
+        // Step faster through data that isn't compressing.
+        i += 1 + ((i - anchor) >> 8);
+    }
+
+    op = lz_put_block(op, oend, src + anchor, in_len - anchor, 0, 0);
+    if (!op) {
+        return 0;
+    }
+
+    return op - (u8 *)out;
+}
+
+/** \brief Reads the continuation bytes of a length, adding them to \a len.
+ * Returns zero if the input runs out. */
+static really_inline
+int lz_get_length(const u8 **ip, const u8 *iend, size_t *len) {
+    for (;;) {
+        if (*ip == iend) {
+            return 0;
+        }
+        u8 c = *(*ip)++;
+        *len += c;
+        if (c != 255) {
+            return 1;
+        }
+    }
+}
+
+int lz_decompress(const char *in, size_t in_len, char *out, size_t out_len) {
+    const u8 *ip = (const u8 *)in;
+    const u8 *iend = ip + in_len;
+    u8 *op = (u8 *)out;
+    const u8 *oend = op + out_len;
+
+    while (ip < iend) {
+        const u8 token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == LZ_NIBBLE_MAX && !lz_get_length(&ip, iend, &lit_len)) {
+            return 0;
+        }
+        if ((size_t)(iend - ip) < lit_len || (size_t)(oend - op) < lit_len) {
+            return 0;
+        }
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == iend) {
+            break; // the final block has no match
+        }
+
+        if (iend - ip < 2) {
+            return 0;
+        }
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (!offset || offset > (size_t)(op - (u8 *)out)) {
+            return 0;
+        }
+
+        size_t match_len = token & 0xf;
+        if (match_len == LZ_NIBBLE_MAX &&
+            !lz_get_length(&ip, iend, &match_len)) {
+            return 0;
+        }
+        match_len += LZ_MIN_MATCH;
+        if ((size_t)(oend - op) < match_len) {
+            return 0;
+        }
+
+        const u8 *ref = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+        } else {
+            // Overlapping match: copy forwards a byte at a time.
+            for (size_t j = 0; j < match_len; j++) {
+                op[j] = ref[j];
+            }
+        }
+        op += match_len;
+    }
+
+    return op == oend;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Simple LZ77 byte compressor, used for compressed serialized
+ * databases.
+ *
+ * The format is a sequence of blocks, each a token byte holding a literal
+ * length (high nibble) and a match length (low nibble), the literal bytes, a
+ * two-byte little-endian match offset and the match. Lengths of 15 or more
+ * continue in following bytes, each adding up to 255. The final block has
+ * literals only.
+ */
+
+#ifndef UTIL_LZ_H
+#define UTIL_LZ_H
+
+#include "ue2common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** \brief Number of u32 entries in the hash table used by \ref lz_compress. */
+#define LZ_TABLE_ENTRIES (1U << 16)
+
+/** \brief Largest compressed size for \a len bytes of input. */
+static really_inline
+size_t lz_compress_bound(size_t len) {
+    return len + len / 255 + 16;
+}
+
+/** \brief Compresses \a in_len bytes from \a in into \a out, using \a table
+ * (of \ref LZ_TABLE_ENTRIES entries) as scratch space.
+ *
+ * Returns the compressed length, or zero if it would exceed \a out_len. */
+size_t lz_compress(const char *in, size_t in_len, char *out, size_t out_len,
+                   u32 *table);
+
+/** \brief Decompresses \a in_len bytes from \a in into \a out, which must
+ * decompress to exactly \a out_len bytes.
+ *
+ * Returns non-zero on success, or zero if the compressed data is malformed.
+ * Reads and writes are bounds checked, so malformed data is safe. */
+int lz_decompress(const char *in, size_t in_len, char *out, size_t out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UTIL_LZ_H
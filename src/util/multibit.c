@@ -197,3 +197,166 @@ void mmbit_sparse_iter_dump(const struct mmbit_sparse_iter *it,
 }
 
 #endif // DUMP_SUPPORT
+
+/* Compressed multibit format: a single tag byte, followed by either nothing
+ * (empty multibit), a key count and a list of keys, or a flat bit vector of
+ * all keys. The count and keys are stored in the fewest bytes that can hold
+ * any key. */
+#define MMB_COMP_EMPTY 0
+#define MMB_COMP_SPARSE 1
+#define MMB_COMP_DENSE 2
+
+static
+u32 mmbit_comp_key_width(u32 total_bits) {
+    if (total_bits <= (1U << 8)) {
+        return 1;
+    } else if (total_bits <= (1U << 16)) {
+        return 2;
+    } else {
+        return 4;
+    }
+}
+
+static
+u32 mmbit_count(const u8 *bits, u32 total_bits) {
+    u32 count = 0;
+    for (u32 i = mmbit_iterate(bits, total_bits, MMB_INVALID);
+         i != MMB_INVALID; i = mmbit_iterate(bits, total_bits, i)) {
+        count++;
+    }
+    return count;
+}
+
+static
+u8 mmbit_comp_type(u32 total_bits, u32 count, size_t *len) {
+    if (!count) {
+        *len = 1;
+        return MMB_COMP_EMPTY;
+    }
+
+    size_t sparse_len = (size_t)(count + 1) * mmbit_comp_key_width(total_bits);
+    size_t dense_len = ROUNDUP_N(total_bits, 8) / 8;
+    if (sparse_len <= dense_len) {
+        *len = 1 + sparse_len;
+        return MMB_COMP_SPARSE;
+    }
+    *len = 1 + dense_len;
+    return MMB_COMP_DENSE;
+}
+
+size_t mmbit_compsize(const u8 *bits, u32 total_bits) {
+    if (!total_bits) {
+        return 0;
+    }
+
+    size_t len;
+    mmbit_comp_type(total_bits, mmbit_count(bits, total_bits), &len);
+    return len;
+}
+
+char mmbit_compress(const u8 *bits, u32 total_bits, u8 *comp,
+                    size_t *comp_space, size_t max_comp_space) {
+    if (!total_bits) {
+        *comp_space = 0;
+        return 1;
+    }
+
+    u32 count = mmbit_count(bits, total_bits);
+    size_t len;
+    u8 type = mmbit_comp_type(total_bits, count, &len);
+    if (len > max_comp_space) {
+        return 0;
+    }
+
+    comp[0] = type;
+    u8 *out = comp + 1;
+
+    if (type == MMB_COMP_SPARSE) {
+        u32 width = mmbit_comp_key_width(total_bits);
+        partial_store_u32(out, count - 1, width);
+        out += width;
+        for (u32 i = mmbit_iterate(bits, total_bits, MMB_INVALID);
+             i != MMB_INVALID; i = mmbit_iterate(bits, total_bits, i)) {
+            partial_store_u32(out, i, width);
+            out += width;
+        }
+    } else if (type == MMB_COMP_DENSE) {
+        memset(out, 0, len - 1);
+        for (u32 i = mmbit_iterate(bits, total_bits, MMB_INVALID);
+             i != MMB_INVALID; i = mmbit_iterate(bits, total_bits, i)) {
+            out[i / 8] |= 1U << (i % 8);
+        }
+    }
+
+    *comp_space = len;
+    return 1;
+}
+
+char mmbit_decompress(u8 *bits, u32 total_bits, const u8 *comp,
+                      size_t *comp_space, size_t max_comp_space) {
+    if (!total_bits) {
+        *comp_space = 0;
+        return 1;
+    }
+
+    if (!max_comp_space) {
+        return 0;
+    }
+
+    mmbit_clear(bits, total_bits);
+
+    const u8 *in = comp + 1;
+    size_t len;
+
+    switch (comp[0]) {
+    case MMB_COMP_EMPTY:
+        len = 1;
+        break;
+    case MMB_COMP_SPARSE: {
+        u32 width = mmbit_comp_key_width(total_bits);
+        if (1 + width > max_comp_space) {
+            return 0;
+        }
+        u32 count = partial_load_u32(in, width) + 1;
+        in += width;
+        if (count > total_bits) {
+            return 0;
+        }
+        len = 1 + (size_t)(count + 1) * width;
+        if (len > max_comp_space) {
+            return 0;
+        }
+        for (u32 j = 0; j < count; j++, in += width) {
+            u32 key = partial_load_u32(in, width);
+            if (key >= total_bits) {
+                return 0;
+            }
+            mmbit_set(bits, total_bits, key);
+        }
+        break;
+    }
+    case MMB_COMP_DENSE: {
+        size_t dense_len = ROUNDUP_N(total_bits, 8) / 8;
+        len = 1 + dense_len;
+        if (len > max_comp_space) {
+            return 0;
+        }
+        for (u32 j = 0; j < dense_len; j++) {
+            u32 byte = in[j];
+            while (byte) {
+                u32 key = j * 8 + findAndClearLSB_32(&byte);
+                if (key >= total_bits) {
+                    return 0;
+                }
+                mmbit_set(bits, total_bits, key);
+            }
+        }
+        break;
+    }
+    default:
+        return 0;
+    }
+
+    *comp_space = len;
+    return 1;
+}
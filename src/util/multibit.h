@@ -504,12 +504,15 @@ u32 mmbit_iterate_flat(const u8 *bits, u32 total_bits, u32 it_in) {
         it_in++;
         assert(it_in < total_bits);
 
-        start = (ROUNDUP_N(it_in, MMB_KEY_BITS) / MMB_KEY_BITS) - 1;
+        // Resume in the block holding it_in; when the previous key was the
+        // last in its block, this skips straight to the next one rather than
+        // reloading a block with nothing left in it.
+        start = it_in / MMB_KEY_BITS;
         u32 start_key = start * MMB_KEY_BITS;
         u32 block_size = MIN(MMB_KEY_BITS, total_bits - start_key);
         MMB_TYPE block =
             mmbit_get_flat_block(bits + (start * sizeof(MMB_TYPE)), block_size);
-        block &= ~mmb_mask_zero_to(it_in - start_key);
+        block &= ~mmb_mask_zero_to_nocheck(it_in - start_key);
 
         if (block) {
             return start_key + mmb_ctz(block);
@@ -1483,6 +1486,28 @@ void mmbit_sparse_iter_unset(u8 *bits, u32 total_bits,
     }
 }
 
+/** \brief Returns the number of bytes required to store a compressed copy of
+ * the given multibit (see \ref mmbit_compress). */
+size_t mmbit_compsize(const u8 *bits, u32 total_bits);
+
+/** \brief Compress a multibit into a compact serialised form.
+ *
+ * Only the set keys are stored, either as a list of key indices or as a flat
+ * bit vector, whichever is smaller; the summary levels of large multibits are
+ * not stored at all. On success, returns 1 and writes the number of bytes
+ * used to \a comp_space. Returns 0 if more than \a max_comp_space bytes are
+ * required. */
+char mmbit_compress(const u8 *bits, u32 total_bits, u8 *comp,
+                    size_t *comp_space, size_t max_comp_space);
+
+/** \brief Rebuild a multibit from the form written by \ref mmbit_compress.
+ *
+ * On success, returns 1 and writes the number of bytes consumed to \a
+ * comp_space. Returns 0 if the compressed data is malformed or would extend
+ * past \a max_comp_space bytes. */
+char mmbit_decompress(u8 *bits, u32 total_bits, const u8 *comp,
+                      size_t *comp_space, size_t max_comp_space);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -30,14 +30,12 @@
 #define PARTITIONED_SET_H
 
 #include "container.h"
-#include "ue2_containers.h"
 #include "ue2common.h"
 
 #include <algorithm>
 #include <vector>
 
 #include <boost/core/noncopyable.hpp>
-#include <boost/dynamic_bitset.hpp>
 
 namespace ue2 {
 
@@ -89,7 +87,8 @@ public:
 
     /**
      * Splits the subset with the given subset_index based on whether its
-     * members are also members of the splitter set.
+     * members are also members of the splitter set, which must be sorted and
+     * free of duplicates.
      *
      * The smaller of the intersection and difference is placed into a new
      * subset, the index of which is returned. The larger part remains with the
@@ -98,9 +97,9 @@ public:
      * If the set was not split (due to there being no overlap with splitter or
      * being a complete subset), INVALID_SUBSET is returned.
      */
-    size_t split(size_t subset_index,
-                 const typename ue2::flat_set<T> &splitter) {
+    size_t split(size_t subset_index, const std::vector<T> &splitter) {
         assert(!splitter.empty());
+        assert(std::is_sorted(splitter.begin(), splitter.end()));
         if (splitter.empty()) {
             return INVALID_SUBSET;
         }
@@ -173,10 +172,9 @@ public:
             small = &split_temp_diff;
         }
 
-        /* larger subset replaces the input subset */
-        std::vector<T> temp_i;
-        insert(&temp_i, temp_i.end(), *big);
-        orig.members.swap(temp_i);
+        /* larger subset replaces the input subset; the old member list is
+         * left in the temp, which is cleared before its next use */
+        orig.members.swap(*big);
 
         /* smaller subset is placed in the new subset  */
         size_t new_index = subsets.size();
@@ -191,23 +189,31 @@ public:
     }
 
     /**
-     * Returns all subsets which have a member in keys.
+     * Returns all subsets which have a member in keys, in ascending order.
+     *
+     * The cost is proportional to the number of keys, not to the number of
+     * subsets in the partition.
      */
-    void find_overlapping(const typename ue2::flat_set<T> &keys,
-                          std::vector<size_t> *containing) const {
-        boost::dynamic_bitset<> seen(subsets.size()); // all zero by default.
+    void find_overlapping(const std::vector<T> &keys,
+                          std::vector<size_t> *containing) {
+        const size_t first = containing->size();
 
         for (const auto &key : keys) {
             assert(key < member_to_subset.size());
             size_t sub = member_to_subset[key];
             assert(sub < subsets.size());
-            seen.set(sub);
+            if (!overlap_seen[sub]) {
+                overlap_seen[sub] = true;
+                containing->push_back(sub);
+            }
         }
 
-        for (size_t i = seen.find_first(); i != seen.npos;
-             i = seen.find_next(i)) {
-            containing->push_back(i);
+        for (auto it = containing->begin() + first; it != containing->end();
+             ++it) {
+            overlap_seen[*it] = false;
         }
+
+        std::sort(containing->begin() + first, containing->end());
     }
 
     /**
@@ -223,6 +229,9 @@ public:
         subsets.reserve(state_to_subset.size());
         member_to_subset.resize(state_to_subset.size());
 
+        /* there can never be more subsets than members */
+        overlap_seen.resize(state_to_subset.size());
+
         split_temp_inter.reserve(state_to_subset.size());
         split_temp_diff.reserve(state_to_subset.size());
 
@@ -259,6 +268,8 @@ private:
                                       * intersection. */
     std::vector<T> split_temp_diff; /**< used internally by split to hold the
                                      * set difference. */
+    std::vector<bool> overlap_seen; /**< used internally by find_overlapping,
+                                     * all false between calls. */
 };
 
 } // namespace
@@ -44,7 +44,10 @@
 
 static really_inline
 u32 popcount32(u32 x) {
-#if defined(HAVE_POPCOUNT_INSTR)
+#if defined(ARCH_AARCH64)
+    // Lowered to the Advanced SIMD CNT instruction.
+    return (u32)__builtin_popcount(x);
+#elif defined(HAVE_POPCOUNT_INSTR)
     // Single-instruction builtin.
     return _mm_popcnt_u32(x);
 #else
@@ -58,7 +61,9 @@ u32 popcount32(u32 x) {
 
 static really_inline
 u32 popcount64(u64a x) {
-#if defined(ARCH_X86_64)
+#if defined(ARCH_AARCH64)
+    return (u32)__builtin_popcountll(x);
+#elif defined(ARCH_X86_64)
 # if defined(HAVE_POPCOUNT_INSTR)
     // Single-instruction builtin.
     return (u32)_mm_popcnt_u64(x);
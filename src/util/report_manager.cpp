@@ -36,6 +36,7 @@
 #include "rose/rose_build.h"
 #include "util/compile_error.h"
 #include "util/container.h"
+#include "util/verify_types.h"
 
 #include <deque>
 #include <map>
@@ -113,7 +114,10 @@ u32 ReportManager::numEkeys() const {
 }
 
 bool ReportManager::patternSetCanExhaust() const {
-    return global_exhaust && !toExhaustibleKeyMap.empty();
+    // Combinations are evaluated as their sub-patterns match, so a database
+    // containing them can never be considered exhausted.
+    return global_exhaust && !toExhaustibleKeyMap.empty() &&
+           !pl.numCombinations();
 }
 
 vector<ReportID> ReportManager::getDkeyToReportTable() const {
@@ -217,6 +221,96 @@ Report ReportManager::getBasicInternalReport(const NGWrapper &g, s32 adj) {
     return makeECallback(g.reportId, adj, ekey);
 }
 
+void ReportManager::setMatchLimit(ReportID id, u32 limit,
+                                  u32 expressionIndex) {
+    assert(limit);
+    auto it = matchLimits.find(id);
+    if (it != matchLimits.end()) {
+        if (it->second.limit != limit) {
+            ostringstream out;
+            out << "Expression (index " << expressionIndex << ") with match ID "
+                << id << " specified a different max_matches value to "
+                << "previous expression (index "
+                << it->second.first_pattern_index
+                << ") with the same match ID.";
+            throw CompileError(expressionIndex, out.str());
+        }
+        return;
+    }
+
+    u32 key = verify_u32(matchLimits.size());
+    u32 ekey = getUnassociatedExhaustibleKey();
+    matchLimits.emplace(id, match_limit_info(limit, key, ekey,
+                                             expressionIndex));
+    DEBUG_PRINTF("id %u limited to %u matches, key %u ekey %u\n", id, limit,
+                 key, ekey);
+}
+
+const match_limit_info *ReportManager::getMatchLimit(ReportID id) const {
+    auto it = matchLimits.find(id);
+    if (it == matchLimits.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+u32 ReportManager::numMatchLimits() const {
+    return verify_u32(matchLimits.size());
+}
+
+void ReportManager::setUserData(ReportID id, u64a value,
+                                u32 expressionIndex) {
+    auto it = userData.find(id);
+    if (it != userData.end()) {
+        if (it->second.value != value) {
+            ostringstream out;
+            out << "Expression (index " << expressionIndex << ") with match ID "
+                << id << " specified a different user_data value to "
+                << "previous expression (index "
+                << it->second.first_pattern_index
+                << ") with the same match ID.";
+            throw CompileError(expressionIndex, out.str());
+        }
+        return;
+    }
+
+    userData.emplace(id, user_data_info(value, expressionIndex));
+    DEBUG_PRINTF("id %u has user data 0x%llx\n", id, value);
+}
+
+void ReportManager::setConfirm(ReportID id,
+                               shared_ptr<const ConfirmProgram> prog,
+                               u32 expressionIndex) {
+    auto it = confirms.find(id);
+    if (it != confirms.end()) {
+        if (!prog && !it->second.prog) {
+            return;
+        }
+        ostringstream out;
+        out << "Expression (index " << expressionIndex << ") with match ID "
+            << id << " shares its match ID with a previous expression "
+            << "(index " << it->second.first_pattern_index << "), which is "
+            << "not supported for expressions using HS_FLAG_CONFIRM.";
+        throw CompileError(expressionIndex, out.str());
+    }
+
+    u32 key = ~0U;
+    if (prog) {
+        key = verify_u32(confirmPrograms.size());
+        confirmPrograms.push_back(prog);
+        DEBUG_PRINTF("id %u confirmed by program %u\n", id, key);
+    }
+    confirms.emplace(id, confirm_info(move(prog), key, expressionIndex));
+}
+
+const confirm_info *ReportManager::getConfirm(ReportID id) const {
+    auto it = confirms.find(id);
+    if (it == confirms.end() || !it->second.prog) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
 void ReportManager::setProgramOffset(ReportID id, u32 programOffset) {
     assert(id < reportIds.size());
     assert(!contains(reportIdToProgramOffset, id));
@@ -35,16 +35,19 @@
 #define REPORT_MANAGER_H
 
 #include "ue2common.h"
+#include "parser/logical_combination.h"
 #include "util/compile_error.h"
 #include "util/report.h"
 
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 #include <boost/core/noncopyable.hpp>
 
 namespace ue2 {
 
+struct ConfirmProgram;
 struct Grey;
 class RoseBuild;
 class NGWrapper;
@@ -56,6 +59,35 @@ struct external_report_info {
     const u32 first_pattern_index;
 };
 
+/** \brief Limit on the number of matches reported for an external report ID,
+ * from \ref hs_expr_ext::max_matches. */
+struct match_limit_info {
+    match_limit_info(u32 l, u32 k, u32 e, u32 fpi)
+    : limit(l), key(k), ekey(e), first_pattern_index(fpi) { }
+    u32 limit; //!< maximum number of matches to report
+    u32 key; //!< index of the match counter in stream state
+    u32 ekey; //!< exhaustion key set once the limit is reached
+    u32 first_pattern_index;
+};
+
+/** \brief User data for an external report ID, from
+ * \ref hs_expr_ext::user_data. */
+struct user_data_info {
+    user_data_info(u64a v, u32 fpi) : value(v), first_pattern_index(fpi) { }
+    u64a value;
+    u32 first_pattern_index;
+};
+
+/** \brief Confirm program for an external report ID, from patterns using
+ * \ref HS_FLAG_CONFIRM. */
+struct confirm_info {
+    confirm_info(std::shared_ptr<const ConfirmProgram> p, u32 k, u32 fpi)
+    : prog(std::move(p)), key(k), first_pattern_index(fpi) { }
+    std::shared_ptr<const ConfirmProgram> prog; //!< nullptr if unconfirmed
+    u32 key; //!< index of the program in the confirm table
+    u32 first_pattern_index;
+};
+
 /** \brief Tracks Report structures, exhaustion and dedupe keys. */
 class ReportManager : boost::noncopyable {
 public:
@@ -109,6 +141,45 @@ public:
      * assigning one if necessary. */
     u32 getExhaustibleKey(u32 expressionIndex);
 
+    /** \brief Set a limit on the number of matches reported for external
+     * report \a id, assigning a match counter and an exhaustion key for it.
+     * Throws a CompileError if a different limit has already been set for
+     * this ID. */
+    void setMatchLimit(ReportID id, u32 limit, u32 expressionIndex);
+
+    /** \brief Fetch the match limit for external report \a id, or nullptr if
+     * it has none. */
+    const match_limit_info *getMatchLimit(ReportID id) const;
+
+    /** \brief Total number of match limits (and match counters). */
+    u32 numMatchLimits() const;
+
+    /** \brief Attach \a value to matches for external report \a id. Throws
+     * a CompileError if a different value has already been set for this
+     * ID. */
+    void setUserData(ReportID id, u64a value, u32 expressionIndex);
+
+    /** \brief User data, keyed by external report ID. */
+    const std::map<ReportID, user_data_info> &getUserData() const {
+        return userData;
+    }
+
+    /** \brief Register the confirm program \a prog (nullptr if none) for an
+     * expression with external report \a id. Throws a CompileError if a
+     * confirmed expression shares its ID with another expression. */
+    void setConfirm(ReportID id, std::shared_ptr<const ConfirmProgram> prog,
+                    u32 expressionIndex);
+
+    /** \brief Fetch the confirm program for external report \a id, or
+     * nullptr if it has none. */
+    const confirm_info *getConfirm(ReportID id) const;
+
+    /** \brief Confirm programs, indexed by key. */
+    const std::vector<std::shared_ptr<const ConfirmProgram>> &
+    getConfirmPrograms() const {
+        return confirmPrograms;
+    }
+
     /** \brief Fetch the dedupe key associated with the given report. Returns
      * ~0U if no dkey is needed. */
     u32 getDkey(const Report &r) const;
@@ -121,6 +192,10 @@ public:
      * set. */
     u32 getProgramOffset(ReportID id) const;
 
+    /** \brief Logical combinations in this pattern set, and the patterns they
+     * refer to. */
+    ParsedLogical pl;
+
 private:
     /** \brief Grey box ref, for checking resource limits. */
     const Grey &grey;
@@ -142,6 +217,19 @@ private:
      * id. */
     std::map<ReportID, external_report_info> externalIdMap;
 
+    /** \brief Mapping from external match ids to their match limit. */
+    std::map<ReportID, match_limit_info> matchLimits;
+
+    /** \brief Mapping from external match ids to their user data. */
+    std::map<ReportID, user_data_info> userData;
+
+    /** \brief Mapping from external match ids to their confirm program, for
+     * every expression registered with \ref setConfirm. */
+    std::map<ReportID, confirm_info> confirms;
+
+    /** \brief Confirm programs, indexed by key. */
+    std::vector<std::shared_ptr<const ConfirmProgram>> confirmPrograms;
+
     /** \brief Mapping from expression index to exhaustion key. */
     std::map<s64a, u32> toExhaustibleKeyMap;
 
@@ -32,6 +32,11 @@
 #include "config.h"
 #include "ue2common.h"
 
+// AArch64 always has Advanced SIMD; it stands in for SSSE3 there.
+#if defined(ARCH_AARCH64) && defined(__ARM_NEON)
+#define HAVE_NEON
+#endif
+
 // more recent headers are bestest, but only if we can use them
 #ifdef __cplusplus
 # if defined(HAVE_CXX_X86INTRIN_H)
@@ -53,7 +58,9 @@
 # endif
 #endif
 
-#if defined(USE_X86INTRIN_H)
+#if defined(HAVE_NEON)
+#include <arm_neon.h>
+#elif defined(USE_X86INTRIN_H)
 #include <x86intrin.h>
 #elif defined(USE_INTRIN_H)
 #include <intrin.h>
@@ -61,16 +68,30 @@
 #error no intrinsics!
 #endif
 
+#if defined(HAVE_NEON)
+typedef int32x4_t m128;
+#else
 typedef __m128i m128;
+#endif
 #if defined(__AVX2__)
 typedef __m256i m256;
 #else
 typedef ALIGN_AVX_DIRECTIVE struct {m128 lo; m128 hi;} m256;
 #endif
 
-// these should align to 16 and 32 respectively
+// these should align to 16 and 64 respectively
 typedef struct {m128 lo; m128 mid; m128 hi;} m384;
-typedef struct {m256 lo; m256 hi;} m512;
+
+// m512 is always cacheline aligned, so that structures containing it have the
+// same layout whether or not the AVX-512 type is in use.
+#if defined(__AVX512BW__)
+typedef __m512i m512;
+#else
+typedef ALIGN_CL_DIRECTIVE struct {m256 lo; m256 hi;} m512;
+#endif
+
+// m1024 has no native type; it is always a pair of m512 halves.
+typedef ALIGN_CL_DIRECTIVE struct {m512 lo; m512 hi;} m1024;
 
 #endif /* SIMD_TYPES_H */
 
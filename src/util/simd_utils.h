@@ -33,45 +33,16 @@
 #ifndef SIMD_UTILS
 #define SIMD_UTILS
 
-#if !defined(_WIN32) && !defined(__SSSE3__)
-#error SSSE3 instructions must be enabled
-#endif
-
 #include "config.h"
 #include <string.h> // for memcpy
 
-// more recent headers are bestest, but only if we can use them
-#ifdef __cplusplus
-# if defined(HAVE_CXX_X86INTRIN_H)
-#  define USE_X86INTRIN_H
-# endif
-#else // C
-# if defined(HAVE_C_X86INTRIN_H)
-#  define USE_X86INTRIN_H
-# endif
-#endif
-
-#ifdef __cplusplus
-# if defined(HAVE_CXX_INTRIN_H)
-#  define USE_INTRIN_H
-# endif
-#else // C
-# if defined(HAVE_C_INTRIN_H)
-#  define USE_INTRIN_H
-# endif
-#endif
-
-#if defined(USE_X86INTRIN_H)
-#include <x86intrin.h>
-#elif defined(USE_INTRIN_H)
-#include <intrin.h>
-#else
-#error no intrins!
-#endif
-
 #include "ue2common.h"
 #include "simd_types.h"
 
+#if !defined(HAVE_NEON) && !defined(_WIN32) && !defined(__SSSE3__)
+#error SSSE3 instructions must be enabled
+#endif
+
 // Define a common assume_aligned using an appropriate compiler built-in, if
 // it's available. Note that we need to handle C or C++ compilation.
 #ifdef __cplusplus
@@ -97,6 +68,163 @@ extern const char vbs_mask_data[];
 }
 #endif
 
+#if defined(HAVE_NEON)
+
+/*
+ * AArch64 Advanced SIMD implementation of the 128-bit primitives. m128 is an
+ * int32x4_t; everything wider is built from these, as on SSE targets.
+ */
+
+#define m128_u8(a)  vreinterpretq_u8_s32(a)
+#define m128_u32(a) vreinterpretq_u32_s32(a)
+#define m128_u64(a) vreinterpretq_u64_s32(a)
+
+static really_inline m128 ones128(void) {
+    return vreinterpretq_s32_u8(vdupq_n_u8(0xff));
+}
+
+static really_inline m128 zeroes128(void) {
+    return vdupq_n_s32(0);
+}
+
+/** \brief Bitwise not for m128*/
+static really_inline m128 not128(m128 a) {
+    return vmvnq_s32(a);
+}
+
+/** \brief Return 1 if a and b are different otherwise 0 */
+static really_inline int diff128(m128 a, m128 b) {
+    return vmaxvq_u32(m128_u32(veorq_s32(a, b))) != 0;
+}
+
+/**
+ * "Rich" version of diff128(). Takes two vectors a and b and returns a 4-bit
+ * mask indicating which 32-bit words contain differences.
+ */
+static really_inline u32 diffrich128(m128 a, m128 b) {
+    const uint32x4_t lane_bits = { 0x1, 0x2, 0x4, 0x8 };
+    return vaddvq_u32(vbicq_u32(lane_bits, vceqq_s32(a, b)));
+}
+
+/**
+ * "Rich" version of diff128(), 64-bit variant. Takes two vectors a and b and
+ * returns a 4-bit mask indicating which 64-bit words contain differences.
+ */
+static really_inline u32 diffrich64_128(m128 a, m128 b) {
+    const uint64x2_t lane_bits = { 0x1, 0x4 };
+    return (u32)vaddvq_u64(vbicq_u64(lane_bits,
+                                     vceqq_u64(m128_u64(a), m128_u64(b))));
+}
+
+static really_inline m128 lshift64_m128(m128 a, unsigned b) {
+    return vreinterpretq_s32_u64(vshlq_u64(m128_u64(a), vdupq_n_s64(b)));
+}
+
+static really_inline m128 rshift64_m128(m128 a, unsigned b) {
+    return vreinterpretq_s32_u64(vshlq_u64(m128_u64(a),
+                                           vdupq_n_s64(-(s64a)b)));
+}
+
+static really_inline m128 eq128(m128 a, m128 b) {
+    return vreinterpretq_s32_u8(vceqq_u8(m128_u8(a), m128_u8(b)));
+}
+
+/** \brief PMOVMSKB equivalent: gathers the top bit of each byte. */
+static really_inline u32 movemask128(m128 a) {
+    uint16x8_t hi = vreinterpretq_u16_u8(vshrq_n_u8(m128_u8(a), 7));
+    uint32x4_t p16 = vreinterpretq_u32_u16(vsraq_n_u16(hi, hi, 7));
+    uint64x2_t p32 = vreinterpretq_u64_u32(vsraq_n_u32(p16, p16, 14));
+    uint8x16_t p64 = vreinterpretq_u8_u64(vsraq_n_u64(p32, p32, 28));
+    return vgetq_lane_u8(p64, 0) | ((u32)vgetq_lane_u8(p64, 8) << 8);
+}
+
+static really_inline m128 set16x8(u8 c) {
+    return vreinterpretq_s32_u8(vdupq_n_u8(c));
+}
+
+static really_inline m128 set4x32(u32 c) {
+    return vdupq_n_s32((s32)c);
+}
+
+/** \brief Signed 32-bit greater-than, all ones in each lane where a > b. */
+static really_inline m128 gt32x4(m128 a, m128 b) {
+    return vreinterpretq_s32_u32(vcgtq_s32(a, b));
+}
+
+static really_inline m128 set64x2(u64a hi, u64a lo) {
+    return vreinterpretq_s32_u64(vcombine_u64(vcreate_u64(lo),
+                                              vcreate_u64(hi)));
+}
+
+static really_inline u32 movd(const m128 in) {
+    return vgetq_lane_u32(m128_u32(in), 0);
+}
+
+static really_inline u64a movq(const m128 in) {
+    return vgetq_lane_u64(m128_u64(in), 0);
+}
+
+// count_immed must be an immediate in [0, 16]; EXT takes only [0, 15], hence
+// the masking in the branch that is folded away at the ends of the range.
+#define rshiftbyte_m128(a, count_immed)                                       \
+    ((count_immed) >= 16 ? zeroes128()                                        \
+        : vreinterpretq_s32_u8(vextq_u8(m128_u8(a), vdupq_n_u8(0),           \
+                                        (count_immed) & 15)))
+#define lshiftbyte_m128(a, count_immed)                                       \
+    ((count_immed) == 0 ? (a)                                                 \
+        : vreinterpretq_s32_u8(vextq_u8(vdupq_n_u8(0), m128_u8(a),           \
+                                        (16 - (count_immed)) & 15)))
+
+static really_inline m128 and128(m128 a, m128 b) {
+    return vandq_s32(a, b);
+}
+
+static really_inline m128 xor128(m128 a, m128 b) {
+    return veorq_s32(a, b);
+}
+
+static really_inline m128 or128(m128 a, m128 b) {
+    return vorrq_s32(a, b);
+}
+
+static really_inline m128 andnot128(m128 a, m128 b) {
+    return vbicq_s32(b, a);
+}
+
+// aligned load
+static really_inline m128 load128(const void *ptr) {
+    assert(ISALIGNED_N(ptr, alignof(m128)));
+    ptr = assume_aligned(ptr, 16);
+    return vld1q_s32((const s32 *)ptr);
+}
+
+// unaligned load
+static really_inline m128 loadu128(const void *ptr) {
+    return vreinterpretq_s32_u8(vld1q_u8((const u8 *)ptr));
+}
+
+// unaligned store
+static really_inline void storeu128(void *ptr, m128 a) {
+    vst1q_u8((u8 *)ptr, m128_u8(a));
+}
+
+// offset must be an immediate
+#define palignr(r, l, offset)                                                 \
+    vreinterpretq_s32_u8(vextq_u8(m128_u8(l), m128_u8(r), (offset)))
+
+/**
+ * PSHUFB semantics on TBL: an index byte with its top bit set selects zero and
+ * otherwise only its low nibble is used. TBL returns zero for any index past
+ * 15, so clearing bits 4-6 is all that is needed.
+ */
+static really_inline
+m128 pshufb(m128 a, m128 b) {
+    uint8x16_t idx = vandq_u8(m128_u8(b), vdupq_n_u8(0x8f));
+    return vreinterpretq_s32_u8(vqtbl1q_u8(m128_u8(a), idx));
+}
+
+#else // !HAVE_NEON
+
 static really_inline m128 ones128(void) {
 #if defined(__GNUC__) || defined(__INTEL_COMPILER)
     /* gcc gets this right */
@@ -122,10 +250,6 @@ static really_inline int diff128(m128 a, m128 b) {
     return (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xffff);
 }
 
-static really_inline int isnonzero128(m128 a) {
-    return !!diff128(a, zeroes128());
-}
-
 /**
  * "Rich" version of diff128(). Takes two vectors a and b and returns a 4-bit
  * mask indicating which 32-bit words contain differences.
@@ -158,6 +282,19 @@ static really_inline m128 set16x8(u8 c) {
     return _mm_set1_epi8(c);
 }
 
+static really_inline m128 set4x32(u32 c) {
+    return _mm_set1_epi32(c);
+}
+
+/** \brief Signed 32-bit greater-than, all ones in each lane where a > b. */
+static really_inline m128 gt32x4(m128 a, m128 b) {
+    return _mm_cmpgt_epi32(a, b);
+}
+
+static really_inline m128 set64x2(u64a hi, u64a lo) {
+    return _mm_set_epi64x(hi, lo);
+}
+
 static really_inline u32 movd(const m128 in) {
     return _mm_cvtsi128_si32(in);
 }
@@ -175,20 +312,6 @@ static really_inline u64a movq(const m128 in) {
 #define rshiftbyte_m128(a, count_immed) _mm_srli_si128(a, count_immed)
 #define lshiftbyte_m128(a, count_immed) _mm_slli_si128(a, count_immed)
 
-#if !defined(__AVX2__)
-// TODO: this entire file needs restructuring - this carveout is awful
-#define extractlow64from256(a) movq(a.lo)
-#define extractlow32from256(a) movd(a.lo)
-#if defined(__SSE4_1__)
-#define extract32from256(a, imm) _mm_extract_epi32((imm >> 2) ? a.hi : a.lo, imm % 4)
-#define extract64from256(a, imm) _mm_extract_epi64((imm >> 2) ? a.hi : a.lo, imm % 2)
-#else
-#define extract32from256(a, imm) movd(_mm_srli_si128((imm >> 2) ? a.hi : a.lo, (imm % 4) * 8))
-#define extract64from256(a, imm) movq(_mm_srli_si128((imm >> 2) ? a.hi : a.lo, (imm % 2) * 8))
-#endif
-
-#endif // !AVX2
-
 static really_inline m128 and128(m128 a, m128 b) {
     return _mm_and_si128(a,b);
 }
@@ -212,13 +335,6 @@ static really_inline m128 load128(const void *ptr) {
     return _mm_load_si128((const m128 *)ptr);
 }
 
-// aligned store
-static really_inline void store128(void *ptr, m128 a) {
-    assert(ISALIGNED_N(ptr, alignof(m128)));
-    ptr = assume_aligned(ptr, 16);
-    *(m128 *)ptr = a;
-}
-
 // unaligned load
 static really_inline m128 loadu128(const void *ptr) {
     return _mm_loadu_si128((const m128 *)ptr);
@@ -229,6 +345,46 @@ static really_inline void storeu128(void *ptr, m128 a) {
     _mm_storeu_si128 ((m128 *)ptr, a);
 }
 
+// offset must be an immediate
+#define palignr(r, l, offset) _mm_alignr_epi8(r, l, offset)
+
+static really_inline
+m128 pshufb(m128 a, m128 b) {
+    m128 result;
+    result = _mm_shuffle_epi8(a, b);
+    return result;
+}
+
+#endif // HAVE_NEON
+
+static really_inline int isnonzero128(m128 a) {
+    return !!diff128(a, zeroes128());
+}
+
+#if !defined(__AVX2__)
+// TODO: this entire file needs restructuring - this carveout is awful
+#define extractlow64from256(a) movq(a.lo)
+#define extractlow32from256(a) movd(a.lo)
+#if defined(HAVE_NEON)
+#define extract32from256(a, imm) vgetq_lane_u32(m128_u32((imm >> 2) ? a.hi : a.lo), imm % 4)
+#define extract64from256(a, imm) vgetq_lane_u64(m128_u64((imm >> 1) ? a.hi : a.lo), imm % 2)
+#elif defined(__SSE4_1__)
+#define extract32from256(a, imm) _mm_extract_epi32((imm >> 2) ? a.hi : a.lo, imm % 4)
+#define extract64from256(a, imm) _mm_extract_epi64((imm >> 2) ? a.hi : a.lo, imm % 2)
+#else
+#define extract32from256(a, imm) movd(_mm_srli_si128((imm >> 2) ? a.hi : a.lo, (imm % 4) * 8))
+#define extract64from256(a, imm) movq(_mm_srli_si128((imm >> 2) ? a.hi : a.lo, (imm % 2) * 8))
+#endif
+
+#endif // !AVX2
+
+// aligned store
+static really_inline void store128(void *ptr, m128 a) {
+    assert(ISALIGNED_N(ptr, alignof(m128)));
+    ptr = assume_aligned(ptr, 16);
+    *(m128 *)ptr = a;
+}
+
 // packed unaligned store of first N bytes
 static really_inline
 void storebytes128(void *ptr, m128 a, unsigned int n) {
@@ -278,16 +434,6 @@ char testbit128(const m128 *ptr, unsigned int n) {
 #endif
 }
 
-// offset must be an immediate
-#define palignr(r, l, offset) _mm_alignr_epi8(r, l, offset)
-
-static really_inline
-m128 pshufb(m128 a, m128 b) {
-    m128 result;
-    result = _mm_shuffle_epi8(a, b);
-    return result;
-}
-
 static really_inline
 m256 vpshufb(m256 a, m256 b) {
 #if defined(__AVX2__)
@@ -463,6 +609,8 @@ static really_inline u32 diffrich256(m256 a, m256 b) {
 #if defined(__AVX2__)
     a = _mm256_cmpeq_epi32(a, b);
     return ~(_mm256_movemask_ps(_mm256_castsi256_ps(a))) & 0xFF;
+#elif defined(HAVE_NEON)
+    return diffrich128(a.lo, b.lo) | (diffrich128(a.hi, b.hi) << 4);
 #else
     m128 z = zeroes128();
     a.lo = _mm_cmpeq_epi32(a.lo, b.lo);
@@ -713,6 +861,10 @@ static really_inline int isnonzero384(m384 a) {
  * mask indicating which 32-bit words contain differences.
  */
 static really_inline u32 diffrich384(m384 a, m384 b) {
+#if defined(HAVE_NEON)
+    return diffrich128(a.lo, b.lo) | (diffrich128(a.mid, b.mid) << 4) |
+           (diffrich128(a.hi, b.hi) << 8);
+#else
     m128 z = zeroes128();
     a.lo = _mm_cmpeq_epi32(a.lo, b.lo);
     a.mid = _mm_cmpeq_epi32(a.mid, b.mid);
@@ -720,6 +872,7 @@ static really_inline u32 diffrich384(m384 a, m384 b) {
     m128 packed = _mm_packs_epi16(_mm_packs_epi32(a.lo, a.mid),
                                   _mm_packs_epi32(a.hi, z));
     return ~(_mm_movemask_epi8(packed)) & 0xfff;
+#endif
 }
 
 /**
@@ -818,6 +971,145 @@ char testbit384(const m384 *ptr, unsigned int n) {
  **** 512-bit Primitives
  ****/
 
+#if defined(__AVX512BW__)
+
+static really_inline m512 and512(m512 a, m512 b) {
+    return _mm512_and_si512(a, b);
+}
+
+static really_inline m512 or512(m512 a, m512 b) {
+    return _mm512_or_si512(a, b);
+}
+
+static really_inline m512 xor512(m512 a, m512 b) {
+    return _mm512_xor_si512(a, b);
+}
+
+static really_inline m512 not512(m512 a) {
+    return _mm512_xor_si512(a, _mm512_set1_epi8(0xff));
+}
+
+static really_inline m512 andnot512(m512 a, m512 b) {
+    return _mm512_andnot_si512(a, b);
+}
+
+static really_really_inline
+m512 lshift64_m512(m512 a, unsigned b) {
+    return _mm512_slli_epi64(a, b);
+}
+
+static really_really_inline
+m512 rshift64_m512(m512 a, unsigned b) {
+    return _mm512_srli_epi64(a, b);
+}
+
+static really_inline
+m512 set64x8(u32 in) {
+    return _mm512_set1_epi8(in);
+}
+
+static really_inline
+m512 set4x128(m128 a) {
+    return _mm512_broadcast_i32x4(a);
+}
+
+static really_inline
+m512 pshufb_m512(m512 a, m512 b) {
+    return _mm512_shuffle_epi8(a, b);
+}
+
+static really_inline m512 zeroes512(void) {
+    return _mm512_setzero_si512();
+}
+
+static really_inline m512 ones512(void) {
+    return _mm512_set1_epi8(0xff);
+}
+
+static really_inline int diff512(m512 a, m512 b) {
+    return !!_mm512_cmpneq_epi8_mask(a, b);
+}
+
+static really_inline int isnonzero512(m512 a) {
+    return !!_mm512_test_epi64_mask(a, a);
+}
+
+/**
+ * "Rich" version of diff512(). Takes two vectors a and b and returns a 16-bit
+ * mask indicating which 32-bit words contain differences.
+ */
+static really_inline u32 diffrich512(m512 a, m512 b) {
+    return _mm512_cmpneq_epi32_mask(a, b);
+}
+
+/**
+ * Returns a 64-bit mask with a bit set for every byte in which a and b are
+ * equal.
+ */
+static really_inline u64a eq512mask(m512 a, m512 b) {
+    return _mm512_cmpeq_epi8_mask(a, b);
+}
+
+// aligned load
+static really_inline m512 load512(const void *ptr) {
+    assert(ISALIGNED_N(ptr, alignof(m512)));
+    return _mm512_load_si512(ptr);
+}
+
+// aligned store
+static really_inline void store512(void *ptr, m512 a) {
+    assert(ISALIGNED_N(ptr, alignof(m512)));
+    _mm512_store_si512(ptr, a);
+}
+
+// unaligned load
+static really_inline m512 loadu512(const void *ptr) {
+    return _mm512_loadu_si512(ptr);
+}
+
+static really_inline u64a bytemask512(unsigned int n) {
+    assert(n <= sizeof(m512));
+    return n == sizeof(m512) ? ~0ULL : (1ULL << n) - 1;
+}
+
+// packed unaligned store of first N bytes
+static really_inline
+void storebytes512(void *ptr, m512 a, unsigned int n) {
+    _mm512_mask_storeu_epi8(ptr, bytemask512(n), a);
+}
+
+// packed unaligned load of first N bytes, pad with zero
+static really_inline
+m512 loadbytes512(const void *ptr, unsigned int n) {
+    return _mm512_maskz_loadu_epi8(bytemask512(n), ptr);
+}
+
+static really_inline
+m512 mask1bit512(unsigned int n) {
+    assert(n < sizeof(m512) * 8);
+    return _mm512_maskz_set1_epi64(1U << (n / 64), 1ULL << (n % 64));
+}
+
+// switches on bit N in the given vector.
+static really_inline
+void setbit512(m512 *ptr, unsigned int n) {
+    *ptr = or512(mask1bit512(n), *ptr);
+}
+
+// switches off bit N in the given vector.
+static really_inline
+void clearbit512(m512 *ptr, unsigned int n) {
+    *ptr = andnot512(mask1bit512(n), *ptr);
+}
+
+// tests bit N in the given vector.
+static really_inline
+char testbit512(const m512 *ptr, unsigned int n) {
+    return !!_mm512_test_epi64_mask(mask1bit512(n), *ptr);
+}
+
+#else // !__AVX512BW__
+
 static really_inline m512 and512(m512 a, m512 b) {
     m512 rv;
     rv.lo = and256(a.lo, b.lo);
@@ -892,7 +1184,7 @@ static really_inline int isnonzero512(m512 a) {
  * mask indicating which 32-bit words contain differences.
  */
 static really_inline u32 diffrich512(m512 a, m512 b) {
-#if defined(__AVX2__)
+#if defined(__AVX2__) || defined(HAVE_NEON)
     return diffrich256(a.lo, b.lo) | (diffrich256(a.hi, b.hi) << 8);
 #else
     a.lo.lo = _mm_cmpeq_epi32(a.lo.lo, b.lo.lo);
@@ -905,14 +1197,6 @@ static really_inline u32 diffrich512(m512 a, m512 b) {
 #endif
 }
 
-/**
- * "Rich" version of diffrich(), 64-bit variant. Takes two vectors a and b and
- * returns a 16-bit mask indicating which 64-bit words contain differences.
- */
-static really_inline u32 diffrich64_512(m512 a, m512 b) {
-    u32 d = diffrich512(a, b);
-    return (d | (d >> 1)) & 0x55555555;
-}
 
 // aligned load
 static really_inline m512 load512(const void *ptr) {
@@ -1040,4 +1324,166 @@ char testbit512(const m512 *ptr, unsigned int n) {
 #endif
 }
 
+#endif // __AVX512BW__
+
+/**
+ * "Rich" version of diffrich(), 64-bit variant. Takes two vectors a and b and
+ * returns a 16-bit mask indicating which 64-bit words contain differences.
+ */
+static really_inline u32 diffrich64_512(m512 a, m512 b) {
+    u32 d = diffrich512(a, b);
+    return (d | (d >> 1)) & 0x55555555;
+}
+
+/****
+ **** 1024-bit Primitives
+ ****/
+
+static really_inline m1024 and1024(m1024 a, m1024 b) {
+    m1024 rv;
+    rv.lo = and512(a.lo, b.lo);
+    rv.hi = and512(a.hi, b.hi);
+    return rv;
+}
+
+static really_inline m1024 or1024(m1024 a, m1024 b) {
+    m1024 rv;
+    rv.lo = or512(a.lo, b.lo);
+    rv.hi = or512(a.hi, b.hi);
+    return rv;
+}
+
+static really_inline m1024 xor1024(m1024 a, m1024 b) {
+    m1024 rv;
+    rv.lo = xor512(a.lo, b.lo);
+    rv.hi = xor512(a.hi, b.hi);
+    return rv;
+}
+
+static really_inline m1024 not1024(m1024 a) {
+    m1024 rv;
+    rv.lo = not512(a.lo);
+    rv.hi = not512(a.hi);
+    return rv;
+}
+
+static really_inline m1024 andnot1024(m1024 a, m1024 b) {
+    m1024 rv;
+    rv.lo = andnot512(a.lo, b.lo);
+    rv.hi = andnot512(a.hi, b.hi);
+    return rv;
+}
+
+static really_really_inline
+m1024 lshift64_m1024(m1024 a, unsigned b) {
+    m1024 rv;
+    rv.lo = lshift64_m512(a.lo, b);
+    rv.hi = lshift64_m512(a.hi, b);
+    return rv;
+}
+
+static really_inline m1024 zeroes1024(void) {
+    m1024 rv = {zeroes512(), zeroes512()};
+    return rv;
+}
+
+static really_inline m1024 ones1024(void) {
+    m1024 rv = {ones512(), ones512()};
+    return rv;
+}
+
+static really_inline int diff1024(m1024 a, m1024 b) {
+    return diff512(a.lo, b.lo) || diff512(a.hi, b.hi);
+}
+
+static really_inline int isnonzero1024(m1024 a) {
+    return isnonzero512(or512(a.lo, a.hi));
+}
+
+/**
+ * "Rich" version of diff1024(). Takes two vectors a and b and returns a 32-bit
+ * mask indicating which 32-bit words contain differences.
+ */
+static really_inline u32 diffrich1024(m1024 a, m1024 b) {
+    return diffrich512(a.lo, b.lo) | (diffrich512(a.hi, b.hi) << 16);
+}
+
+/**
+ * "Rich" version of diffrich(), 64-bit variant. Takes two vectors a and b and
+ * returns a 32-bit mask indicating which 64-bit words contain differences.
+ */
+static really_inline u32 diffrich64_1024(m1024 a, m1024 b) {
+    u32 d = diffrich1024(a, b);
+    return (d | (d >> 1)) & 0x55555555;
+}
+
+// aligned load
+static really_inline m1024 load1024(const void *ptr) {
+    assert(ISALIGNED_N(ptr, alignof(m1024)));
+    m1024 rv = { load512(ptr), load512((const char *)ptr + 64) };
+    return rv;
+}
+
+// aligned store
+static really_inline void store1024(void *ptr, m1024 a) {
+    assert(ISALIGNED_N(ptr, alignof(m1024)));
+    store512(ptr, a.lo);
+    store512((char *)ptr + 64, a.hi);
+}
+
+// unaligned load
+static really_inline m1024 loadu1024(const void *ptr) {
+    m1024 rv = { loadu512(ptr), loadu512((const char *)ptr + 64) };
+    return rv;
+}
+
+// packed unaligned store of first N bytes
+static really_inline
+void storebytes1024(void *ptr, m1024 a, unsigned int n) {
+    assert(n <= sizeof(a));
+    memcpy(ptr, &a, n);
+}
+
+// packed unaligned load of first N bytes, pad with zero
+static really_inline
+m1024 loadbytes1024(const void *ptr, unsigned int n) {
+    m1024 a = zeroes1024();
+    assert(n <= sizeof(a));
+    memcpy(&a, ptr, n);
+    return a;
+}
+
+// switches on bit N in the given vector.
+static really_inline
+void setbit1024(m1024 *ptr, unsigned int n) {
+    assert(n < sizeof(*ptr) * 8);
+    if (n < 512) {
+        setbit512(&ptr->lo, n);
+    } else {
+        setbit512(&ptr->hi, n - 512);
+    }
+}
+
+// switches off bit N in the given vector.
+static really_inline
+void clearbit1024(m1024 *ptr, unsigned int n) {
+    assert(n < sizeof(*ptr) * 8);
+    if (n < 512) {
+        clearbit512(&ptr->lo, n);
+    } else {
+        clearbit512(&ptr->hi, n - 512);
+    }
+}
+
+// tests bit N in the given vector.
+static really_inline
+char testbit1024(const m1024 *ptr, unsigned int n) {
+    assert(n < sizeof(*ptr) * 8);
+    if (n < 512) {
+        return testbit512(&ptr->lo, n);
+    } else {
+        return testbit512(&ptr->hi, n - 512);
+    }
+}
+
 #endif
@@ -76,6 +76,57 @@ void loadcompressed64(u64a *x, const void *ptr, const u64a *m, u32 bytes) {
     *x = expand64(v, *m);
 }
 
+/*
+ * Single-word composed paths for wide state.
+ *
+ * When BMI2 is available and the compressed form of a wide state fits into a
+ * single 64-bit word, we can build it directly from the per-chunk PEXT
+ * results (and recover it with PDEP), skipping the general bit packing
+ * routines. The layout is identical to that produced by pack_bits_64().
+ */
+
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+static really_inline
+void storecompressed_word(void *ptr, const u64a *x, const u64a *m,
+                          u32 chunks, u32 bytes) {
+    assert(bytes && bytes <= sizeof(u64a));
+
+    u64a v = 0;
+    u32 shift = 0;
+    for (u32 i = 0; i < chunks; i++) {
+        if (!m[i]) {
+            continue;
+        }
+        assert(shift < 64);
+        v |= compress64(x[i], m[i]) << shift;
+        shift += popcount64(m[i]);
+    }
+
+    assert(shift <= bytes * 8);
+    partial_store_u64a(ptr, v, bytes);
+}
+
+static really_inline
+void loadcompressed_word(u64a *x, const void *ptr, const u64a *m,
+                         u32 chunks, u32 bytes) {
+    assert(bytes && bytes <= sizeof(u64a));
+
+    u64a v = partial_load_u64a(ptr, bytes);
+    u32 shift = 0;
+    for (u32 i = 0; i < chunks; i++) {
+        if (!m[i]) {
+            x[i] = 0;
+            continue;
+        }
+        assert(shift < 64);
+        x[i] = expand64(v >> shift, m[i]);
+        shift += popcount64(m[i]);
+    }
+
+    assert(shift <= bytes * 8);
+}
+#endif
+
 /*
  * 128-bit store/load.
  */
@@ -126,6 +177,15 @@ void storecompressed128_64bit(void *ptr, m128 xvec, m128 mvec) {
 
 void storecompressed128(void *ptr, const m128 *x, const m128 *m,
                         UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[2], mw[2];
+        memcpy(xw, x, sizeof(*x));
+        memcpy(mw, m, sizeof(*m));
+        storecompressed_word(ptr, xw, mw, 2, bytes);
+        return;
+    }
+#endif
 #if defined(ARCH_64_BIT)
     storecompressed128_64bit(ptr, *x, *m);
 #else
@@ -157,7 +217,7 @@ m128 loadcompressed128_32bit(const void *ptr, m128 mvec) {
 static really_inline
 m128 loadcompressed128_64bit(const void *ptr, m128 mvec) {
     // First, decompose our vectors into 64-bit chunks.
-    u64a m[2] = { movq(mvec), movq(_mm_srli_si128(mvec, 8)) };
+    u64a m[2] = { movq(mvec), movq(rshiftbyte_m128(mvec, 8)) };
 
     u32 bits[2] = { popcount64(m[0]), popcount64(m[1]) };
     u64a v[2];
@@ -166,12 +226,21 @@ m128 loadcompressed128_64bit(const void *ptr, m128 mvec) {
 
     u64a x[2] = { expand64(v[0], m[0]), expand64(v[1], m[1]) };
 
-    return _mm_set_epi64x(x[1], x[0]);
+    return set64x2(x[1], x[0]);
 }
 #endif
 
 void loadcompressed128(m128 *x, const void *ptr, const m128 *m,
                        UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[2], mw[2];
+        memcpy(mw, m, sizeof(*m));
+        loadcompressed_word(xw, ptr, mw, 2, bytes);
+        memcpy(x, xw, sizeof(*x));
+        return;
+    }
+#endif
 #if defined(ARCH_64_BIT)
     *x = loadcompressed128_64bit(ptr, *m);
 #else
@@ -235,6 +304,15 @@ void storecompressed256_64bit(void *ptr, m256 xvec, m256 mvec) {
 
 void storecompressed256(void *ptr, const m256 *x, const m256 *m,
                         UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[4], mw[4];
+        memcpy(xw, x, sizeof(*x));
+        memcpy(mw, m, sizeof(*m));
+        storecompressed_word(ptr, xw, mw, 4, bytes);
+        return;
+    }
+#endif
 #if defined(ARCH_64_BIT)
     storecompressed256_64bit(ptr, *x, *m);
 #else
@@ -290,8 +368,8 @@ m256 loadcompressed256_64bit(const void *ptr, m256 mvec) {
                   expand64(v[2], m[2]), expand64(v[3], m[3]) };
 
 #if !defined(__AVX2__)
-    m256 xvec = { .lo = _mm_set_epi64x(x[1], x[0]),
-                  .hi = _mm_set_epi64x(x[3], x[2]) };
+    m256 xvec = { .lo = set64x2(x[1], x[0]),
+                  .hi = set64x2(x[3], x[2]) };
 #else
     m256 xvec = _mm256_set_epi64x(x[3], x[2], x[1], x[0]);
 #endif
@@ -301,6 +379,15 @@ m256 loadcompressed256_64bit(const void *ptr, m256 mvec) {
 
 void loadcompressed256(m256 *x, const void *ptr, const m256 *m,
                        UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[4], mw[4];
+        memcpy(mw, m, sizeof(*m));
+        loadcompressed_word(xw, ptr, mw, 4, bytes);
+        memcpy(x, xw, sizeof(*x));
+        return;
+    }
+#endif
 #if defined(ARCH_64_BIT)
     *x = loadcompressed256_64bit(ptr, *m);
 #else
@@ -370,6 +457,15 @@ void storecompressed384_64bit(void *ptr, m384 xvec, m384 mvec) {
 
 void storecompressed384(void *ptr, const m384 *x, const m384 *m,
                         UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[6], mw[6];
+        memcpy(xw, x, sizeof(*x));
+        memcpy(mw, m, sizeof(*m));
+        storecompressed_word(ptr, xw, mw, 6, bytes);
+        return;
+    }
+#endif
 #if defined(ARCH_64_BIT)
     storecompressed384_64bit(ptr, *x, *m);
 #else
@@ -426,15 +522,24 @@ m384 loadcompressed384_64bit(const void *ptr, m384 mvec) {
                   expand64(v[2], m[2]), expand64(v[3], m[3]),
                   expand64(v[4], m[4]), expand64(v[5], m[5]) };
 
-    m384 xvec = { .lo = _mm_set_epi64x(x[1], x[0]),
-                  .mid = _mm_set_epi64x(x[3], x[2]),
-                  .hi = _mm_set_epi64x(x[5], x[4]) };
+    m384 xvec = { .lo = set64x2(x[1], x[0]),
+                  .mid = set64x2(x[3], x[2]),
+                  .hi = set64x2(x[5], x[4]) };
     return xvec;
 }
 #endif
 
 void loadcompressed384(m384 *x, const void *ptr, const m384 *m,
                        UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[6], mw[6];
+        memcpy(mw, m, sizeof(*m));
+        loadcompressed_word(xw, ptr, mw, 6, bytes);
+        memcpy(x, xw, sizeof(*x));
+        return;
+    }
+#endif
 #if defined(ARCH_64_BIT)
     *x = loadcompressed384_64bit(ptr, *m);
 #else
@@ -510,6 +615,15 @@ void storecompressed512_64bit(void *ptr, m512 xvec, m512 mvec) {
 
 void storecompressed512(void *ptr, const m512 *x, const m512 *m,
                         UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[8], mw[8];
+        memcpy(xw, x, sizeof(*x));
+        memcpy(mw, m, sizeof(*m));
+        storecompressed_word(ptr, xw, mw, 8, bytes);
+        return;
+    }
+#endif
 #if defined(ARCH_64_BIT)
     storecompressed512_64bit(ptr, *x, *m);
 #else
@@ -546,7 +660,12 @@ m512 loadcompressed512_32bit(const void *ptr, m512 mvec) {
                   expand32(v[14], m[14]), expand32(v[15], m[15]) };
 
     m512 xvec;
-#if !defined(__AVX2__)
+#if defined(__AVX512BW__)
+    xvec = _mm512_set_epi32(x[15], x[14], x[13], x[12],
+                            x[11], x[10], x[9], x[8],
+                            x[7], x[6], x[5], x[4],
+                            x[3], x[2], x[1], x[0]);
+#elif !defined(__AVX2__)
     xvec.lo.lo = _mm_set_epi32(x[3], x[2], x[1], x[0]);
     xvec.lo.hi = _mm_set_epi32(x[7], x[6], x[5], x[4]);
     xvec.hi.lo = _mm_set_epi32(x[11], x[10], x[9], x[8]);
@@ -581,11 +700,14 @@ m512 loadcompressed512_64bit(const void *ptr, m512 mvec) {
                   expand64(v[4], m[4]), expand64(v[5], m[5]),
                   expand64(v[6], m[6]), expand64(v[7], m[7]) };
 
-#if !defined(__AVX2__)
-    m512 xvec = { .lo = { _mm_set_epi64x(x[1], x[0]),
-                          _mm_set_epi64x(x[3], x[2]) },
-                  .hi = { _mm_set_epi64x(x[5], x[4]),
-                          _mm_set_epi64x(x[7], x[6]) } };
+#if defined(__AVX512BW__)
+    m512 xvec = _mm512_set_epi64(x[7], x[6], x[5], x[4],
+                                 x[3], x[2], x[1], x[0]);
+#elif !defined(__AVX2__)
+    m512 xvec = { .lo = { set64x2(x[1], x[0]),
+                          set64x2(x[3], x[2]) },
+                  .hi = { set64x2(x[5], x[4]),
+                          set64x2(x[7], x[6]) } };
 #else
     m512 xvec = { .lo = _mm256_set_epi64x(x[3], x[2], x[1], x[0]),
                   .hi = _mm256_set_epi64x(x[7], x[6], x[5], x[4])};
@@ -596,9 +718,159 @@ m512 loadcompressed512_64bit(const void *ptr, m512 mvec) {
 
 void loadcompressed512(m512 *x, const void *ptr, const m512 *m,
                        UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[8], mw[8];
+        memcpy(mw, m, sizeof(*m));
+        loadcompressed_word(xw, ptr, mw, 8, bytes);
+        memcpy(x, xw, sizeof(*x));
+        return;
+    }
+#endif
 #if defined(ARCH_64_BIT)
     *x = loadcompressed512_64bit(ptr, *m);
 #else
     *x = loadcompressed512_32bit(ptr, *m);
 #endif
 }
+
+/*
+ * 1024-bit store/load.
+ *
+ * These are written as loops over the GPR-sized chunks rather than fully
+ * unrolled like the smaller sizes above.
+ */
+
+#if defined(ARCH_32_BIT)
+static really_inline
+void storecompressed1024_32bit(void *ptr, const m1024 *xvec,
+                               const m1024 *mvec) {
+    // First, decompose our vectors into 32-bit chunks.
+    u32 x[32];
+    memcpy(x, xvec, sizeof(*xvec));
+    u32 m[32];
+    memcpy(m, mvec, sizeof(*mvec));
+
+    // Compress each 32-bit chunk individually, counting the number of bits
+    // of compressed state we're writing out per chunk.
+    u32 bits[32];
+    u32 v[32];
+    for (u32 i = 0; i < 32; i++) {
+        bits[i] = popcount32(m[i]);
+        v[i] = compress32(x[i], m[i]);
+    }
+
+    // Write packed data out.
+    pack_bits_32(ptr, v, bits, 32);
+}
+#endif
+
+#if defined(ARCH_64_BIT)
+static really_inline
+void storecompressed1024_64bit(void *ptr, const m1024 *xvec,
+                               const m1024 *mvec) {
+    // First, decompose our vectors into 64-bit chunks.
+    u64a x[16];
+    memcpy(x, xvec, sizeof(*xvec));
+    u64a m[16];
+    memcpy(m, mvec, sizeof(*mvec));
+
+    // Compress each 64-bit chunk individually, counting the number of bits
+    // of compressed state we're writing out per chunk.
+    u32 bits[16];
+    u64a v[16];
+    for (u32 i = 0; i < 16; i++) {
+        bits[i] = popcount64(m[i]);
+        v[i] = compress64(x[i], m[i]);
+    }
+
+    // Write packed data out.
+    pack_bits_64(ptr, v, bits, 16);
+}
+#endif
+
+void storecompressed1024(void *ptr, const m1024 *x, const m1024 *m,
+                         UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[16], mw[16];
+        memcpy(xw, x, sizeof(*x));
+        memcpy(mw, m, sizeof(*m));
+        storecompressed_word(ptr, xw, mw, 16, bytes);
+        return;
+    }
+#endif
+#if defined(ARCH_64_BIT)
+    storecompressed1024_64bit(ptr, x, m);
+#else
+    storecompressed1024_32bit(ptr, x, m);
+#endif
+}
+
+#if defined(ARCH_32_BIT)
+static really_inline
+void loadcompressed1024_32bit(m1024 *xvec, const void *ptr,
+                              const m1024 *mvec) {
+    // First, decompose our vectors into 32-bit chunks.
+    u32 m[32];
+    memcpy(m, mvec, sizeof(*mvec));
+
+    u32 bits[32];
+    for (u32 i = 0; i < 32; i++) {
+        bits[i] = popcount32(m[i]);
+    }
+
+    u32 v[32];
+    unpack_bits_32(v, (const u8 *)ptr, bits, 32);
+
+    u32 x[32];
+    for (u32 i = 0; i < 32; i++) {
+        x[i] = expand32(v[i], m[i]);
+    }
+
+    memcpy(xvec, x, sizeof(*xvec));
+}
+#endif
+
+#if defined(ARCH_64_BIT)
+static really_inline
+void loadcompressed1024_64bit(m1024 *xvec, const void *ptr,
+                              const m1024 *mvec) {
+    // First, decompose our vectors into 64-bit chunks.
+    u64a m[16];
+    memcpy(m, mvec, sizeof(*mvec));
+
+    u32 bits[16];
+    for (u32 i = 0; i < 16; i++) {
+        bits[i] = popcount64(m[i]);
+    }
+
+    u64a v[16];
+    unpack_bits_64(v, (const u8 *)ptr, bits, 16);
+
+    u64a x[16];
+    for (u32 i = 0; i < 16; i++) {
+        x[i] = expand64(v[i], m[i]);
+    }
+
+    memcpy(xvec, x, sizeof(*xvec));
+}
+#endif
+
+void loadcompressed1024(m1024 *x, const void *ptr, const m1024 *m,
+                        UNUSED u32 bytes) {
+#if defined(HAVE_BMI2) && defined(ARCH_64_BIT)
+    if (bytes && bytes <= sizeof(u64a)) {
+        u64a xw[16], mw[16];
+        memcpy(mw, m, sizeof(*m));
+        loadcompressed_word(xw, ptr, mw, 16, bytes);
+        memcpy(x, xw, sizeof(*x));
+        return;
+    }
+#endif
+#if defined(ARCH_64_BIT)
+    loadcompressed1024_64bit(x, ptr, m);
+#else
+    loadcompressed1024_32bit(x, ptr, m);
+#endif
+}
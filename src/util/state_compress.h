@@ -61,6 +61,11 @@ void loadcompressed384(m384 *x, const void *ptr, const m384 *m, u32 bytes);
 void storecompressed512(void *ptr, const m512 *x, const m512 *m, u32 bytes);
 void loadcompressed512(m512 *x, const void *ptr, const m512 *m, u32 bytes);
 
+void storecompressed1024(void *ptr, const m1024 *x, const m1024 *m,
+                         u32 bytes);
+void loadcompressed1024(m1024 *x, const void *ptr, const m1024 *m,
+                        u32 bytes);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Stream state attributed to each pattern.
+ */
+#include "stream_state_usage.h"
+#include "hs_compile.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace ue2 {
+
+void StreamStateUsage::addPattern(u32 id) {
+    patterns[id];
+}
+
+void StreamStateUsage::charge(const set<u32> &ids,
+                              double PatternStateUsage::*field,
+                              double amount) {
+    if (ids.empty()) {
+        return;
+    }
+    const double share = amount / ids.size();
+    for (u32 id : ids) {
+        patterns[id].*field += share;
+    }
+}
+
+void StreamStateUsage::needHistory(const set<u32> &ids, u32 bytes) {
+    for (u32 id : ids) {
+        u32 &h = patterns[id].history_bytes;
+        h = max(h, bytes);
+    }
+}
+
+static
+unsigned roundUp(double bytes) {
+    /* shares of a byte split three ways should not round up to a byte each */
+    return (unsigned)ceil(bytes - 1e-9);
+}
+
+void StreamStateUsage::fill(vector<hs_stream_state_usage> &out) const {
+    out.clear();
+    for (const auto &m : patterns) {
+        const PatternStateUsage &u = m.second;
+        hs_stream_state_usage row;
+        row.id = m.first;
+        row.role_bits = roundUp(u.role_bits);
+        row.engine_bytes = roundUp(u.engine_bytes);
+        row.repeat_bytes = roundUp(u.repeat_bytes);
+        row.som_bytes = roundUp(u.som_bytes);
+        row.history_bytes = u.history_bytes;
+        row.total_bytes = roundUp(u.role_bits / 8 + u.engine_bytes +
+                                  u.repeat_bytes + u.som_bytes) +
+                          u.history_bytes;
+        out.push_back(row);
+    }
+
+    stable_sort(out.begin(), out.end(),
+                [](const hs_stream_state_usage &a,
+                   const hs_stream_state_usage &b) {
+                    return a.total_bytes > b.total_bytes;
+                });
+}
+
+} // namespace ue2
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Stream state attributed to each pattern, as returned by
+ * hs_compile_stream_state_usage().
+ */
+
+#ifndef UTIL_STREAM_STATE_USAGE_H
+#define UTIL_STREAM_STATE_USAGE_H
+
+#include "ue2common.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+struct hs_stream_state_usage;
+
+namespace ue2 {
+
+/** \brief Stream state charged to one pattern. Shared state is split evenly
+ * between the patterns that share it, so the amounts may be fractional. */
+struct PatternStateUsage {
+    double role_bits = 0;    //!< Rose role multibit
+    double engine_bytes = 0; //!< engine state, less bounded repeats
+    double repeat_bytes = 0; //!< bounded repeat state
+    double som_bytes = 0;    //!< SOM slots
+    u32 history_bytes = 0;   //!< history needed by the pattern, not split
+};
+
+/**
+ * \brief Stream state attributed to each pattern by the Rose build, enabled
+ * with hs_set_stream_state_budget().
+ *
+ * State that serves the whole database rather than particular patterns, such
+ * as the literal matchers' state and the group masks, is not attributed.
+ */
+class StreamStateUsage {
+public:
+    /** \brief Makes sure that pattern \a id is listed, even if nothing is
+     * charged to it. */
+    void addPattern(u32 id);
+
+    /** \brief Splits \a amount of the \a field component evenly between the
+     * patterns in \a ids. */
+    void charge(const std::set<u32> &ids, double PatternStateUsage::*field,
+                double amount);
+
+    /** \brief Records that the patterns in \a ids need \a bytes of
+     * history. */
+    void needHistory(const std::set<u32> &ids, u32 bytes);
+
+    /** \brief Writes a row per pattern to \a out, in decreasing order of
+     * total bytes. */
+    void fill(std::vector<hs_stream_state_usage> &out) const;
+
+    /** \brief Bytes of stream state for the whole database, as returned by
+     * hs_stream_size(). */
+    u32 total_bytes = 0;
+
+private:
+    std::map<u32, PatternStateUsage> patterns; //!< by external id
+};
+
+} // namespace ue2
+
+#endif // UTIL_STREAM_STATE_USAGE_H
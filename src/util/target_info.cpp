@@ -46,6 +46,14 @@ bool target_t::can_run_on_code_built_for(const target_t &code_target) const {
         return false;
     }
 
+    if (!has_avx512() && code_target.has_avx512()) {
+        return false;
+    }
+
+    if (!has_avx512vbmi() && code_target.has_avx512vbmi()) {
+        return false;
+    }
+
     return true;
 }
 
@@ -56,6 +64,14 @@ bool target_t::has_avx2(void) const {
     return (cpu_features & HS_CPU_FEATURES_AVX2);
 }
 
+bool target_t::has_avx512(void) const {
+    return (cpu_features & HS_CPU_FEATURES_AVX512);
+}
+
+bool target_t::has_avx512vbmi(void) const {
+    return (cpu_features & HS_CPU_FEATURES_AVX512VBMI);
+}
+
 bool target_t::is_atom_class(void) const {
     return tune == HS_TUNE_FAMILY_SLM;
 }
@@ -40,6 +40,13 @@
 #include "simd_utils.h"
 #include "unaligned.h"
 
+/** \brief Returns a bitmask with bit i set if the i-th 32-bit chunk of \a a
+ * and \a b differ, matching the semantics of diffrich128() and friends. */
+static really_inline u32 diffrich_u64a_impl(u64a a, u64a b) {
+    u64a d = a ^ b;
+    return ((u32)d ? 1 : 0) | ((u32)(d >> 32) ? 2 : 0);
+}
+
 // Aligned loads
 #define load_u8(a)          (*(const u8 *)(a))
 #define load_u16(a)         (*(const u16 *)(a))
@@ -49,6 +56,7 @@
 #define load_m256(a)        load256(a)
 #define load_m384(a)        load384(a)
 #define load_m512(a)        load512(a)
+#define load_m1024(a)       load1024(a)
 
 // Unaligned loads
 #define loadu_u8(a)          (*(const u8 *)(a))
@@ -59,6 +67,7 @@
 #define loadu_m256(a)        loadu256(a)
 #define loadu_m384(a)        loadu384(a)
 #define loadu_m512(a)        loadu512(a)
+#define loadu_m1024(a)       loadu1024(a)
 
 // Aligned stores
 #define store_u8(ptr, a)    do { *(u8 *)(ptr) = (a); } while(0)
@@ -69,6 +78,7 @@
 #define store_m256(ptr, a)  store256(ptr, a)
 #define store_m384(ptr, a)  store384(ptr, a)
 #define store_m512(ptr, a)  store512(ptr, a)
+#define store_m1024(ptr, a) store1024(ptr, a)
 
 // Unaligned stores
 #define storeu_u8(ptr, a)    do { *(u8 *)(ptr) = (a); } while(0)
@@ -84,6 +94,7 @@
 #define zero_m256           zeroes256()
 #define zero_m384           zeroes384()
 #define zero_m512           zeroes512()
+#define zero_m1024          zeroes1024()
 
 #define ones_u8             0xff
 #define ones_u32            0xfffffffful
@@ -92,6 +103,7 @@
 #define ones_m256           ones256()
 #define ones_m384           ones384()
 #define ones_m512           ones512()
+#define ones_m1024          ones1024()
 
 #define or_u8(a, b)         ((a) | (b))
 #define or_u32(a, b)        ((a) | (b))
@@ -100,6 +112,7 @@
 #define or_m256(a, b)       (or256(a, b))
 #define or_m384(a, b)       (or384(a, b))
 #define or_m512(a, b)       (or512(a, b))
+#define or_m1024(a, b)      (or1024(a, b))
 
 #define and_u8(a, b)        ((a) & (b))
 #define and_u32(a, b)       ((a) & (b))
@@ -108,6 +121,7 @@
 #define and_m256(a, b)      (and256(a, b))
 #define and_m384(a, b)      (and384(a, b))
 #define and_m512(a, b)      (and512(a, b))
+#define and_m1024(a, b)     (and1024(a, b))
 
 #define not_u8(a)           (~(a))
 #define not_u32(a)          (~(a))
@@ -116,6 +130,7 @@
 #define not_m256(a)         (not256(a))
 #define not_m384(a)         (not384(a))
 #define not_m512(a)         (not512(a))
+#define not_m1024(a)        (not1024(a))
 
 #define andnot_u8(a, b)     ((~(a)) & (b))
 #define andnot_u32(a, b)    ((~(a)) & (b))
@@ -124,6 +139,7 @@
 #define andnot_m256(a, b)   (andnot256(a, b))
 #define andnot_m384(a, b)   (andnot384(a, b))
 #define andnot_m512(a, b)   (andnot512(a, b))
+#define andnot_m1024(a, b)  (andnot1024(a, b))
 
 #define lshift_u32(a, b)    ((a) << (b))
 #define lshift_u64a(a, b)   ((a) << (b))
@@ -131,6 +147,7 @@
 #define lshift_m256(a, b)   (lshift64_m256(a, b))
 #define lshift_m384(a, b)   (lshift64_m384(a, b))
 #define lshift_m512(a, b)   (lshift64_m512(a, b))
+#define lshift_m1024(a, b)  (lshift64_m1024(a, b))
 
 #define isZero_u8(a)        ((a) == 0)
 #define isZero_u32(a)       ((a) == 0)
@@ -139,6 +156,7 @@
 #define isZero_m256(a)      (!isnonzero256(a))
 #define isZero_m384(a)      (!isnonzero384(a))
 #define isZero_m512(a)      (!isnonzero512(a))
+#define isZero_m1024(a)     (!isnonzero1024(a))
 
 #define isNonZero_u8(a)     ((a) != 0)
 #define isNonZero_u32(a)    ((a) != 0)
@@ -147,13 +165,15 @@
 #define isNonZero_m256(a)   (isnonzero256(a))
 #define isNonZero_m384(a)   (isnonzero384(a))
 #define isNonZero_m512(a)   (isnonzero512(a))
+#define isNonZero_m1024(a)  (isnonzero1024(a))
 
 #define diffrich_u32(a, b)  ((a) != (b))
-#define diffrich_u64a(a, b) ((a) != (b) ? 3 : 0) //TODO: impl 32bit granularity
+#define diffrich_u64a(a, b) (diffrich_u64a_impl(a, b))
 #define diffrich_m128(a, b) (diffrich128(a, b))
 #define diffrich_m256(a, b) (diffrich256(a, b))
 #define diffrich_m384(a, b) (diffrich384(a, b))
 #define diffrich_m512(a, b) (diffrich512(a, b))
+#define diffrich_m1024(a, b) (diffrich1024(a, b))
 
 #define diffrich64_u32(a, b)  ((a) != (b))
 #define diffrich64_u64a(a, b) ((a) != (b) ? 1 : 0)
@@ -161,6 +181,7 @@
 #define diffrich64_m256(a, b) (diffrich64_256(a, b))
 #define diffrich64_m384(a, b) (diffrich64_384(a, b))
 #define diffrich64_m512(a, b) (diffrich64_512(a, b))
+#define diffrich64_m1024(a, b) (diffrich64_1024(a, b))
 
 #define noteq_u8(a, b)      ((a) != (b))
 #define noteq_u32(a, b)     ((a) != (b))
@@ -169,16 +190,19 @@
 #define noteq_m256(a, b)    (diff256(a, b))
 #define noteq_m384(a, b)    (diff384(a, b))
 #define noteq_m512(a, b)    (diff512(a, b))
+#define noteq_m1024(a, b)   (diff1024(a, b))
 
 #define partial_store_m128(ptr, v, sz) storebytes128(ptr, v, sz)
 #define partial_store_m256(ptr, v, sz) storebytes256(ptr, v, sz)
 #define partial_store_m384(ptr, v, sz) storebytes384(ptr, v, sz)
 #define partial_store_m512(ptr, v, sz) storebytes512(ptr, v, sz)
+#define partial_store_m1024(ptr, v, sz) storebytes1024(ptr, v, sz)
 
 #define partial_load_m128(ptr, sz) loadbytes128(ptr, sz)
 #define partial_load_m256(ptr, sz) loadbytes256(ptr, sz)
 #define partial_load_m384(ptr, sz) loadbytes384(ptr, sz)
 #define partial_load_m512(ptr, sz) loadbytes512(ptr, sz)
+#define partial_load_m1024(ptr, sz) loadbytes1024(ptr, sz)
 
 #define store_compressed_u32(ptr, x, m)     storecompressed32(ptr, x, m)
 #define store_compressed_u64a(ptr, x, m)    storecompressed64(ptr, x, m)
@@ -186,6 +210,7 @@
 #define store_compressed_m256(ptr, x, m)    storecompressed256(ptr, x, m)
 #define store_compressed_m384(ptr, x, m)    storecompressed384(ptr, x, m)
 #define store_compressed_m512(ptr, x, m)    storecompressed512(ptr, x, m)
+#define store_compressed_m1024(ptr, x, m)   storecompressed1024(ptr, x, m)
 
 #define load_compressed_u32(x, ptr, m)      loadcompressed32(x, ptr, m)
 #define load_compressed_u64a(x, ptr, m)     loadcompressed64(x, ptr, m)
@@ -193,6 +218,7 @@
 #define load_compressed_m256(x, ptr, m)     loadcompressed256(x, ptr, m)
 #define load_compressed_m384(x, ptr, m)     loadcompressed384(x, ptr, m)
 #define load_compressed_m512(x, ptr, m)     loadcompressed512(x, ptr, m)
+#define load_compressed_m1024(x, ptr, m)    loadcompressed1024(x, ptr, m)
 
 static really_inline void clearbit_u32(u32 *p, u32 n) {
     assert(n < sizeof(*p) * 8);
@@ -206,6 +232,7 @@ static really_inline void clearbit_u64a(u64a *p, u32 n) {
 #define clearbit_m256(ptr, n)   (clearbit256(ptr, n))
 #define clearbit_m384(ptr, n)   (clearbit384(ptr, n))
 #define clearbit_m512(ptr, n)   (clearbit512(ptr, n))
+#define clearbit_m1024(ptr, n)  (clearbit1024(ptr, n))
 
 static really_inline char testbit_u32(const u32 *p, u32 n) {
     assert(n < sizeof(*p) * 8);
@@ -219,5 +246,6 @@ static really_inline char testbit_u64a(const u64a *p, u32 n) {
 #define testbit_m256(ptr, n)    (testbit256(ptr, n))
 #define testbit_m384(ptr, n)    (testbit384(ptr, n))
 #define testbit_m512(ptr, n)    (testbit512(ptr, n))
+#define testbit_m1024(ptr, n)   (testbit1024(ptr, n))
 
 #endif
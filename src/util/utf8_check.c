@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief UTF-8 validation of scanned data.
+ *
+ * Runs of ASCII are skipped sixteen bytes at a time; multi-byte sequences
+ * are checked one at a time against the table of well-formed byte sequences
+ * in RFC 3629, which excludes overlong encodings, surrogates and code points
+ * above U+10FFFF without decoding.
+ */
+
+#include "utf8_check.h"
+#include "bitutils.h"
+#include "simd_utils.h"
+#include "unicode_def.h"
+
+/** \brief Checks the sequence led by the non-ASCII byte at \a s, returning
+ * its length, or zero if it is not well-formed. */
+static really_inline
+u32 utf8_sequence_len(const u8 *s, const u8 *end) {
+    u8 c = *s;
+    u32 len;
+    u8 lo = UTF_CONT_MIN; // bounds on the first continuation byte
+    u8 hi = UTF_CONT_MAX;
+
+    if (c < 0xc2) {
+        return 0; // continuation byte, or overlong two-byte lead
+    } else if (c <= UTF_TWO_BYTE_MAX) {
+        len = 2;
+    } else if (c <= UTF_THREE_BYTE_MAX) {
+        len = 3;
+        if (c == 0xe0) {
+            lo = 0xa0; // overlong
+        } else if (c == 0xed) {
+            hi = 0x9f; // surrogates
+        }
+    } else if (c <= UTF_FOUR_BYTE_MAX) {
+        len = 4;
+        if (c == 0xf0) {
+            lo = 0x90; // overlong
+        } else if (c == UTF_FOUR_BYTE_MAX) {
+            hi = 0x8f; // above U+10FFFF
+        }
+    } else {
+        return 0;
+    }
+
+    if (end - s < len) {
+        return 0;
+    }
+    if (s[1] < lo || s[1] > hi) {
+        return 0;
+    }
+    for (u32 i = 2; i < len; i++) {
+        if ((s[i] & 0xc0) != UTF_CONT_BYTE_HEADER) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+size_t utf8_check(const u8 *buf, size_t len) {
+    const u8 *s = buf;
+    const u8 *end = buf + len;
+
+    while (s < end) {
+        if (end - s >= 16) {
+            u32 z = movemask128(loadu128(s));
+            if (!z) {
+                s += 16;
+                continue;
+            }
+            s += ctz32(z);
+        } else if (*s < 0x80) {
+            s++;
+            continue;
+        }
+
+        u32 seq_len = utf8_sequence_len(s, end);
+        if (!seq_len) {
+            DEBUG_PRINTF("bad sequence at %zu\n", (size_t)(s - buf));
+            return s - buf;
+        }
+        s += seq_len;
+    }
+
+    return len;
+}
@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief hsaot: emits a compiled database as C source.
+ *
+ * The database is compiled from an expression set (or loaded from a
+ * serialized database), deserialized once here, and written out as a
+ * cacheline-aligned constant array holding the in-memory database. Linked
+ * into an application, the array can be passed straight to the runtime, with
+ * no deserialization or allocation at startup. The accompanying header gives
+ * the database, stream state and scratch sizes as compile-time constants, so
+ * that stream and scratch storage can also be laid out statically.
+ *
+ * The database is only valid for the Hyperscan version and platform it was
+ * built with; the runtime rejects it otherwise.
+ */
+
+#include "config.h"
+
+#include "expressions.h"
+#include "ExpressionParser.h"
+#include "hs.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+/** \brief Options gathered from the command line. */
+struct Options {
+    string exprPath;
+    string sigFile;
+    string dbFile;
+    string outBase;
+    string name = "hs_db";
+    unsigned int mode = HS_MODE_STREAM;
+};
+
+/** \brief Error raised for any failure; the message is printed by main. */
+struct AotError {
+    explicit AotError(string msg_in) : msg(move(msg_in)) {}
+    string msg;
+};
+
+void usage(const char *name, const char *error) {
+    printf("Usage: %s [OPTIONS...]\n\n", name);
+    printf("Options:\n\n");
+    printf("  -h              Display help and exit.\n");
+    printf("  -e PATH         Path to expression directory or file.\n");
+    printf("  -s FILE         Signature file to use.\n");
+    printf("  -d FILE         Serialized database to emit instead of "
+           "compiling (-e).\n");
+    printf("  -N              Compile for block mode (default: "
+           "streaming).\n");
+    printf("  -n NAME         C identifier prefix for the generated symbols "
+           "(default: hs_db).\n");
+    printf("  -o BASE         Write BASE.c and BASE.h.\n");
+    if (error) {
+        printf("Error: %s\n", error);
+    }
+}
+
+bool validIdentifier(const string &s) {
+    if (s.empty() || isdigit((unsigned char)s[0])) {
+        return false;
+    }
+    for (char c : s) {
+        if (!isalnum((unsigned char)c) && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+void processArgs(int argc, char *argv[], Options &opts) {
+    const char *options = "d:e:hn:No:s:";
+    int in;
+    while ((in = getopt(argc, argv, options)) != -1) {
+        switch (in) {
+        case 'd':
+            opts.dbFile = optarg;
+            break;
+        case 'e':
+            opts.exprPath = optarg;
+            break;
+        case 'h':
+            usage(argv[0], nullptr);
+            exit(0);
+        case 'n':
+            opts.name = optarg;
+            if (!validIdentifier(opts.name)) {
+                usage(argv[0], "Argument to -n must be a C identifier.");
+                exit(1);
+            }
+            break;
+        case 'N':
+            opts.mode = HS_MODE_BLOCK;
+            break;
+        case 'o':
+            opts.outBase = optarg;
+            break;
+        case 's':
+            opts.sigFile = optarg;
+            break;
+        default:
+            usage(argv[0], "Unrecognised command line argument.");
+            exit(1);
+        }
+    }
+
+    if (optind != argc) {
+        usage(argv[0], "Unexpected trailing arguments.");
+        exit(1);
+    }
+    if (opts.exprPath.empty() == opts.dbFile.empty()) {
+        usage(argv[0], "Must specify exactly one of an expression path (-e) "
+                       "and a database (-d).");
+        exit(1);
+    }
+    if (opts.outBase.empty()) {
+        usage(argv[0], "Must specify an output base name (-o).");
+        exit(1);
+    }
+}
+
+/** \brief Compiles the expressions given by \a opts and returns the
+ * serialized database. */
+string compileExprs(const Options &opts) {
+    ExpressionMap exprMap;
+    struct stat st;
+    if (stat(opts.exprPath.c_str(), &st) != 0) {
+        throw AotError("Can't stat path: '" + opts.exprPath + "'");
+    }
+    if (S_ISDIR(st.st_mode)) {
+        loadExpressions(opts.exprPath, exprMap);
+    } else {
+        loadExpressionsFromFile(opts.exprPath, exprMap);
+    }
+
+    if (!opts.sigFile.empty()) {
+        SignatureSet sigs;
+        loadSignatureList(opts.sigFile, sigs);
+        limitBySignature(exprMap, sigs);
+    }
+
+    if (exprMap.empty()) {
+        throw AotError("No expressions to compile.");
+    }
+
+    vector<string> exprs;
+    vector<unsigned int> flags;
+    vector<unsigned int> ids;
+    vector<hs_expr_ext> ext;
+    for (const auto &m : exprMap) {
+        string expr;
+        unsigned int f = 0;
+        hs_expr_ext e;
+        if (!readExpression(m.second, expr, &f, &e)) {
+            throw AotError("Unable to parse expression " + to_string(m.first)
+                           + ": " + m.second);
+        }
+        exprs.push_back(expr);
+        flags.push_back(f);
+        ids.push_back(m.first);
+        ext.push_back(e);
+    }
+
+    vector<const char *> patterns;
+    vector<const hs_expr_ext *> ext_ptr;
+    for (size_t i = 0; i < exprs.size(); i++) {
+        patterns.push_back(exprs[i].c_str());
+        ext_ptr.push_back(&ext[i]);
+    }
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_ext_multi(patterns.data(), flags.data(),
+                                          ids.data(), ext_ptr.data(),
+                                          patterns.size(), opts.mode, nullptr,
+                                          &db, &compile_err);
+    if (err != HS_SUCCESS) {
+        ostringstream oss;
+        oss << "Compile failed";
+        if (compile_err) {
+            if (compile_err->expression >= 0) {
+                oss << " for expression " << ids[compile_err->expression];
+            }
+            oss << ": " << compile_err->message;
+            hs_free_compile_error(compile_err);
+        }
+        throw AotError(oss.str());
+    }
+
+    char *bytes = nullptr;
+    size_t length = 0;
+    err = hs_serialize_database(db, &bytes, &length);
+    hs_free_database(db);
+    if (err != HS_SUCCESS) {
+        throw AotError("Unable to serialize database.");
+    }
+
+    string serialized(bytes, length);
+    free(bytes);
+    return serialized;
+}
+
+string readFile(const string &path) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        throw AotError("Unable to open database '" + path + "'");
+    }
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+/** \brief The in-memory database together with its runtime sizes. */
+struct DatabaseImage {
+    vector<char> storage;
+    const char *image = nullptr; //!< 64-byte aligned start of the database
+    size_t size = 0;
+    size_t streamSize = 0; //!< 0 for non-streaming databases
+    size_t scratchSize = 0;
+    string info;
+};
+
+/** \brief Deserializes \a serialized at a cacheline-aligned address, so that
+ * the bytes can be placed at any other cacheline-aligned address. */
+void loadImage(const string &serialized, DatabaseImage &out) {
+    hs_error_t err = hs_serialized_database_size(
+        serialized.data(), serialized.size(), &out.size);
+    if (err != HS_SUCCESS) {
+        throw AotError("Not a valid serialized database.");
+    }
+
+    out.storage.assign(out.size + 64, 0);
+    size_t misalign = (size_t)out.storage.data() % 64;
+    char *aligned = out.storage.data() + (misalign ? 64 - misalign : 0);
+    hs_database_t *db = (hs_database_t *)aligned;
+    err = hs_deserialize_database_at(serialized.data(), serialized.size(),
+                                     db);
+    if (err != HS_SUCCESS) {
+        throw AotError("Unable to deserialize database; it must be built "
+                       "for this Hyperscan version and platform.");
+    }
+    out.image = aligned;
+
+    char *info = nullptr;
+    if (hs_database_info(db, &info) == HS_SUCCESS) {
+        out.info = info;
+        free(info);
+    }
+
+    if (hs_stream_size(db, &out.streamSize) != HS_SUCCESS) {
+        out.streamSize = 0;
+    }
+
+    hs_scratch_t *scratch = nullptr;
+    if (hs_alloc_scratch(db, &scratch) != HS_SUCCESS ||
+        hs_scratch_size(scratch, &out.scratchSize) != HS_SUCCESS) {
+        hs_free_scratch(scratch);
+        throw AotError("Unable to allocate scratch for database.");
+    }
+    hs_free_scratch(scratch);
+}
+
+string upper(const string &s) {
+    string out;
+    for (char c : s) {
+        out += (char)toupper((unsigned char)c);
+    }
+    return out;
+}
+
+string baseName(const string &path) {
+    size_t pos = path.find_last_of('/');
+    return pos == string::npos ? path : path.substr(pos + 1);
+}
+
+void writeHeader(const Options &opts, const DatabaseImage &db,
+                 const string &path) {
+    const string guard = upper(opts.name) + "_H";
+    const string prefix = upper(opts.name);
+
+    ofstream out(path);
+    out << "/* Generated by hsaot; do not edit. */\n"
+        << "/* " << db.info << " */\n\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n\n"
+        << "#include <hs.h>\n\n"
+        << "/** Size of the database in bytes. */\n"
+        << "#define " << prefix << "_SIZE " << db.size << "\n\n";
+    if (db.streamSize) {
+        out << "/** Size of a stream's state in bytes, as reported by "
+            << "hs_stream_size(). */\n"
+            << "#define " << prefix << "_STREAM_SIZE " << db.streamSize
+            << "\n\n";
+    }
+    out << "/** Size of a scratch region for this database alone, as "
+        << "reported by\n * hs_scratch_size(). */\n"
+        << "#define " << prefix << "_SCRATCH_SIZE " << db.scratchSize
+        << "\n\n"
+        << "#ifdef __cplusplus\n"
+        << "extern \"C\" {\n"
+        << "#endif\n\n"
+        << "/** The compiled database, ready for use by the runtime. It must "
+        << "not be freed. */\n"
+        << "const hs_database_t *" << opts.name << "_database(void);\n\n"
+        << "#ifdef __cplusplus\n"
+        << "}\n"
+        << "#endif\n\n"
+        << "#endif /* " << guard << " */\n";
+    if (!out) {
+        throw AotError("Unable to write '" + path + "'");
+    }
+}
+
+void writeSource(const Options &opts, const DatabaseImage &db,
+                 const string &path, const string &header) {
+    ofstream out(path);
+    out << "/* Generated by hsaot; do not edit. */\n"
+        << "/* " << db.info << " */\n\n"
+        << "#include \"" << baseName(header) << "\"\n\n"
+        << "#if defined(_MSC_VER)\n"
+        << "__declspec(align(64))\n"
+        << "#endif\n"
+        << "static const unsigned char " << opts.name << "_image["
+        << db.size << "]\n"
+        << "#if !defined(_MSC_VER)\n"
+        << "    __attribute__((aligned(64)))\n"
+        << "#endif\n"
+        << "    = {\n";
+
+    out << hex << setfill('0');
+    for (size_t i = 0; i < db.size; i++) {
+        if (i % 12 == 0) {
+            out << "    ";
+        }
+        out << "0x" << setw(2) << (unsigned)(unsigned char)db.image[i] << ",";
+        out << ((i % 12 == 11 || i + 1 == db.size) ? "\n" : " ");
+    }
+    out << dec;
+
+    out << "};\n\n"
+        << "const hs_database_t *" << opts.name << "_database(void) {\n"
+        << "    return (const hs_database_t *)" << opts.name << "_image;\n"
+        << "}\n";
+    if (!out) {
+        throw AotError("Unable to write '" + path + "'");
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    processArgs(argc, argv, opts);
+
+    try {
+        string serialized = opts.dbFile.empty() ? compileExprs(opts)
+                                                : readFile(opts.dbFile);
+
+        DatabaseImage db;
+        loadImage(serialized, db);
+
+        const string header = opts.outBase + ".h";
+        writeHeader(opts, db, header);
+        writeSource(opts, db, opts.outBase + ".c", header);
+
+        printf("%s: %zu bytes", opts.name.c_str(), db.size);
+        if (db.streamSize) {
+            printf(", %zu bytes stream state", db.streamSize);
+        }
+        printf(", %zu bytes scratch\n", db.scratchSize);
+    } catch (const AotError &e) {
+        cerr << e.msg << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include "data_corpus.h"
+
+#include "ExpressionParser.h"
+#include "ng_adversary_generator.h"
+#include "ng_corpus_generator.h"
+#include "ng_corpus_properties.h"
+
+#include "hs_compile.h"
+#include "grey.h"
+#include "compiler/compiler.h"
+#include "nfagraph/ng.h"
+#include "util/compile_context.h"
+#include "util/compile_error.h"
+#include "util/report_manager.h"
+#include "util/target_info.h"
+
+#include <memory>
+#include <sstream>
+
+#include <sqlite3.h>
+
+using namespace std;
+using namespace ue2;
+
+namespace {
+
+/** \brief RAII wrapper for an open sqlite3 database. */
+class SqliteDb {
+public:
+    SqliteDb(const string &filename, int flags) {
+        int status = sqlite3_open_v2(filename.c_str(), &db, flags, nullptr);
+        if (status != SQLITE_OK) {
+            ostringstream err;
+            err << "Unable to open database '" << filename
+                << "': " << sqlite3_errmsg(db);
+            sqlite3_close(db);
+            throw DataCorpusError(err.str());
+        }
+    }
+
+    ~SqliteDb() {
+        sqlite3_close(db);
+    }
+
+    /** \brief Prepare \a sql, throwing on failure. */
+    sqlite3_stmt *prepare(const char *sql) {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+            fail("Unable to prepare statement");
+        }
+        return stmt;
+    }
+
+    /** \brief Execute \a sql, which must not return rows. */
+    void exec(const char *sql) {
+        if (sqlite3_exec(db, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+            fail("Unable to execute statement");
+        }
+    }
+
+    [[noreturn]] void fail(const char *what) {
+        ostringstream err;
+        err << what << ": " << sqlite3_errmsg(db);
+        throw DataCorpusError(err.str());
+    }
+
+private:
+    sqlite3 *db = nullptr;
+};
+
+} // namespace
+
+vector<DataBlock> readCorpus(const string &filename) {
+    SqliteDb db(filename, SQLITE_OPEN_READONLY);
+    sqlite3_stmt *stmt =
+        db.prepare("SELECT id, stream_id, data FROM chunk ORDER BY id;");
+
+    vector<DataBlock> blocks;
+    int status;
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        unsigned int id = sqlite3_column_int(stmt, 0);
+        unsigned int stream_id = sqlite3_column_int(stmt, 1);
+        const char *blob = (const char *)sqlite3_column_blob(stmt, 2);
+        int bytes = sqlite3_column_bytes(stmt, 2);
+        blocks.emplace_back(id, stream_id,
+                            blob ? string(blob, bytes) : string());
+    }
+    sqlite3_finalize(stmt);
+
+    if (status != SQLITE_DONE) {
+        db.fail("Error reading corpus");
+    }
+
+    if (blocks.empty()) {
+        throw DataCorpusError("Corpus '" + filename + "' contains no data");
+    }
+
+    return blocks;
+}
+
+void writeCorpus(const string &filename, const vector<DataBlock> &blocks) {
+    SqliteDb db(filename, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    db.exec("DROP TABLE IF EXISTS chunk;");
+    db.exec("CREATE TABLE chunk (id INTEGER PRIMARY KEY, "
+            "stream_id INTEGER NOT NULL, data BLOB);");
+    db.exec("BEGIN TRANSACTION;");
+
+    sqlite3_stmt *stmt =
+        db.prepare("INSERT INTO chunk (id, stream_id, data) "
+                   "VALUES (?, ?, ?);");
+    for (const auto &b : blocks) {
+        sqlite3_bind_int(stmt, 1, b.id);
+        sqlite3_bind_int(stmt, 2, b.stream_id);
+        sqlite3_bind_blob(stmt, 3, b.payload.data(), b.payload.size(),
+                          SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            sqlite3_finalize(stmt);
+            db.fail("Error writing corpus");
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    db.exec("COMMIT;");
+}
+
+/** \brief Maximum number of match strings generated per expression. */
+static const unsigned int CORPORA_PER_EXPRESSION = 16;
+
+/** \brief Maximum length of random filler around each match string. */
+static const unsigned int MAX_FILLER = 256;
+
+/**
+ * \brief Build the graph for each expression in \a exprMap and hand it to
+ * \a gen, which appends corpus data to \a data.
+ */
+template<class Gen>
+static
+void generateForGraphs(const ExpressionMap &exprMap, vector<string> &data,
+                       Gen gen) {
+    CompileContext cc(false, false, get_current_target(), Grey());
+
+    for (const auto &m : exprMap) {
+        string expr;
+        unsigned int flags = 0;
+        hs_expr_ext ext;
+        if (!readExpression(m.second, expr, &flags, &ext)) {
+            throw DataCorpusError("Unable to parse expression " +
+                                  to_string(m.first));
+        }
+
+        try {
+            ReportManager rm(cc.grey);
+            ParsedExpression pe(0, expr.c_str(), flags, m.first, &ext);
+            auto g = buildWrapper(rm, cc, pe);
+            if (!g) {
+                continue;
+            }
+            gen(*g, data);
+        } catch (const CompileError &) {
+            // Patterns that the compiler won't accept contribute no data;
+            // the database build will report the error.
+            continue;
+        }
+    }
+
+    if (data.empty()) {
+        throw DataCorpusError("Unable to generate any corpus data");
+    }
+}
+
+vector<DataBlock> generateCorpus(const ExpressionMap &exprMap,
+                                 unsigned int streams, unsigned int seed) {
+    if (!streams) {
+        streams = 1;
+    }
+
+    CorpusProperties props;
+    props.setPercentages(80, 10, 10);
+    props.prefixRange = min_max(0, MAX_FILLER);
+    props.suffixRange = min_max(0, MAX_FILLER);
+    props.corpusLimit = CORPORA_PER_EXPRESSION;
+    props.seed(seed);
+
+    vector<string> data;
+    generateForGraphs(exprMap, data,
+                      [&props](const NGWrapper &g, vector<string> &out) {
+                          makeCorpusGenerator(g, props)->generateCorpus(out);
+                      });
+
+    vector<DataBlock> blocks;
+    blocks.reserve(data.size());
+    for (size_t i = 0; i < data.size(); i++) {
+        blocks.emplace_back(i, i % streams, move(data[i]));
+    }
+    return blocks;
+}
+
+/** \brief Number of times each cyclic vertex is pumped in a near miss. */
+static const unsigned int WORST_CASE_PUMP = 8;
+
+/** \brief Number of blocks per stream in a worst-case corpus. */
+static const unsigned int WORST_CASE_BLOCKS_PER_STREAM = 16;
+
+vector<DataBlock> generateWorstCaseCorpus(const ExpressionMap &exprMap,
+                                          unsigned int streams,
+                                          unsigned int seed,
+                                          size_t blockLen) {
+    if (!streams) {
+        streams = 1;
+    }
+    if (!blockLen) {
+        blockLen = 1;
+    }
+
+    CorpusProperties props;
+    props.setCycleLimit(1, WORST_CASE_PUMP);
+    props.corpusLimit = CORPORA_PER_EXPRESSION;
+    props.seed(seed);
+
+    vector<string> misses;
+    generateForGraphs(exprMap, misses,
+                      [&props](const NGWrapper &g, vector<string> &out) {
+                          generateAdversarialCorpus(g, props, out);
+                      });
+
+    // Near misses are packed back to back with no filler, drawn at random
+    // from all expressions, so that the work of different expressions (and
+    // their engines) overlaps as much as possible.
+    const size_t count = (size_t)streams * WORST_CASE_BLOCKS_PER_STREAM;
+    vector<DataBlock> blocks;
+    blocks.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        string payload;
+        payload.reserve(blockLen);
+        while (payload.size() < blockLen) {
+            const string &s = misses[props.rand(0, misses.size() - 1)];
+            payload.append(s, 0, blockLen - payload.size());
+        }
+        blocks.emplace_back(i, i % streams, move(payload));
+    }
+    return blocks;
+}
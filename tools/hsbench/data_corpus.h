@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DATACORPUS_H
+#define DATACORPUS_H
+
+#include "expressions.h"
+
+#include <string>
+#include <vector>
+
+/** \brief A block of corpus data, belonging to a stream. */
+class DataBlock {
+public:
+    DataBlock(unsigned int in_id, unsigned int in_stream,
+              std::string in_data)
+        : id(in_id), stream_id(in_stream), payload(std::move(in_data)) {}
+
+    unsigned int id;        //!< unique block identifier
+    unsigned int stream_id; //!< stream this block belongs to
+    std::string payload;    //!< actual block payload
+};
+
+/** \brief Exception thrown when a corpus cannot be read or written. */
+class DataCorpusError {
+public:
+    explicit DataCorpusError(std::string msg_in) : msg(std::move(msg_in)) {}
+    std::string msg;
+};
+
+/**
+ * \brief Read a corpus database.
+ *
+ * The corpus is an SQLite database with a table named "chunk", with columns
+ * "id", "stream_id" and "data". Blocks are returned in id order, which is the
+ * order in which they will be scanned.
+ */
+std::vector<DataBlock> readCorpus(const std::string &filename);
+
+/**
+ * \brief Read the TCP and UDP payloads of the IPv4 packets in a pcap capture
+ * as a corpus.
+ *
+ * Packets become blocks in capture order, and each flow (protocol, addresses
+ * and ports) becomes a stream. Only available when built with libpcap.
+ */
+std::vector<DataBlock> readPcapCorpus(const std::string &filename);
+
+/** \brief Write \a blocks to a new corpus database in \a filename. */
+void writeCorpus(const std::string &filename,
+                 const std::vector<DataBlock> &blocks);
+
+/**
+ * \brief Generate a synthetic corpus that exercises the given expressions.
+ *
+ * Match data for each expression is produced by the corpus generator
+ * (corpusomatic) and wrapped in random filler. The resulting blocks are dealt
+ * out over \a streams interleaved streams.
+ */
+std::vector<DataBlock> generateCorpus(const ExpressionMap &exprMap,
+                                      unsigned int streams,
+                                      unsigned int seed);
+
+/**
+ * \brief Generate a worst-case corpus for the given expressions.
+ *
+ * Each block of \a blockLen bytes is packed with near misses: data that
+ * follows an expression almost to a match and then fails, maximising literal
+ * confirms, engine activations and catchup. Scanning it gives a lower bound
+ * on throughput for the expressions rather than a typical figure.
+ */
+std::vector<DataBlock> generateWorstCaseCorpus(const ExpressionMap &exprMap,
+                                               unsigned int streams,
+                                               unsigned int seed,
+                                               size_t blockLen);
+
+#endif // DATACORPUS_H
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include "engine_hyperscan.h"
+#include "timer.h"
+
+#include "ExpressionParser.h"
+#include "hs.h"
+#if !defined(RELEASE_BUILD)
+#include "grey.h"
+#include "hs_internal.h"
+#endif
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+static
+int onMatch(unsigned int id, unsigned long long, unsigned long long to,
+            unsigned int, void *ctx) {
+    EngineContext *c = static_cast<EngineContext *>(ctx);
+    c->matches++;
+    if (c->echo) {
+        printf("Match @%llu for %u\n", to, id);
+    }
+    return 0;
+}
+
+static
+void check(hs_error_t err, const char *what) {
+    if (err != HS_SUCCESS) {
+        ostringstream oss;
+        oss << what << " failed with error " << err;
+        throw EngineError(oss.str());
+    }
+}
+
+EngineContext::EngineContext(const hs_database *db) {
+    check(hs_alloc_scratch(db, &scratch), "hs_alloc_scratch");
+}
+
+EngineContext::~EngineContext() {
+    hs_free_scratch(scratch);
+}
+
+EngineHyperscan::EngineHyperscan(hs_database *db_in) : db(db_in) {
+    assert(db);
+}
+
+EngineHyperscan::~EngineHyperscan() {
+    hs_free_database(db);
+}
+
+unique_ptr<EngineContext> EngineHyperscan::makeContext() const {
+    return unique_ptr<EngineContext>(new EngineContext(db));
+}
+
+void EngineHyperscan::scan(const char *data, unsigned int len,
+                           EngineContext &ctx) const {
+    check(hs_scan(db, data, len, 0, ctx.scratch, onMatch, &ctx), "hs_scan");
+}
+
+unique_ptr<EngineStream> EngineHyperscan::streamOpen(EngineContext &ctx,
+                                                     unsigned int sn) const {
+    hs_stream *id = nullptr;
+    check(hs_open_stream(db, 0, &id), "hs_open_stream");
+    return unique_ptr<EngineStream>(new EngineStream(id, sn, &ctx));
+}
+
+void EngineHyperscan::streamScan(EngineStream &stream, const char *data,
+                                 unsigned int len) const {
+    check(hs_scan_stream(stream.id, data, len, 0, stream.ctx->scratch,
+                         onMatch, stream.ctx),
+          "hs_scan_stream");
+}
+
+void EngineHyperscan::streamClose(unique_ptr<EngineStream> stream) const {
+    assert(stream);
+    check(hs_close_stream(stream->id, stream->ctx->scratch, onMatch,
+                          stream->ctx),
+          "hs_close_stream");
+}
+
+ScanMode EngineHyperscan::mode() const {
+    return streamSize() ? ScanMode::STREAMING : ScanMode::BLOCK;
+}
+
+size_t EngineHyperscan::streamSize() const {
+    size_t stream_size = 0;
+    if (hs_stream_size(db, &stream_size) != HS_SUCCESS) {
+        return 0;
+    }
+    return stream_size;
+}
+
+size_t EngineHyperscan::bytecodeSize() const {
+    size_t db_size = 0;
+    check(hs_database_size(db, &db_size), "hs_database_size");
+    return db_size;
+}
+
+void EngineHyperscan::printStats() const {
+    char *info = nullptr;
+    check(hs_database_info(db, &info), "hs_database_info");
+    printf("Signatures:        %s\n", info);
+    free(info);
+
+    size_t db_size = 0;
+    check(hs_database_size(db, &db_size), "hs_database_size");
+    printf("Bytecode size:     %zu bytes\n", db_size);
+
+    if (mode() == ScanMode::STREAMING) {
+        size_t stream_size = 0;
+        check(hs_stream_size(db, &stream_size), "hs_stream_size");
+        printf("Stream state size: %zu bytes\n", stream_size);
+    }
+
+    hs_scratch *scratch = nullptr;
+    check(hs_alloc_scratch(db, &scratch), "hs_alloc_scratch");
+    size_t scratch_size = 0;
+    hs_error_t err = hs_scratch_size(scratch, &scratch_size);
+    hs_free_scratch(scratch);
+    check(err, "hs_scratch_size");
+    printf("Scratch size:      %zu bytes\n", scratch_size);
+}
+
+void EngineHyperscan::saveDatabase(const string &filename) const {
+    char *bytes = nullptr;
+    size_t length = 0;
+    check(hs_serialize_database(db, &bytes, &length),
+          "hs_serialize_database");
+
+    ofstream out(filename, ios::binary);
+    out.write(bytes, length);
+    free(bytes);
+    if (!out) {
+        throw EngineError("Unable to write database to '" + filename + "'");
+    }
+}
+
+unique_ptr<EngineHyperscan> buildEngineHyperscan(const ExpressionMap &exprMap,
+                                                 ScanMode scan_mode,
+                                                 double *compile_secs,
+                                                 const string &grey) {
+    vector<string> exprs;
+    vector<unsigned> flags;
+    vector<unsigned> ids;
+    vector<hs_expr_ext> ext;
+
+    for (const auto &m : exprMap) {
+        string expr;
+        unsigned int f = 0;
+        hs_expr_ext e;
+        if (!readExpression(m.second, expr, &f, &e)) {
+            throw EngineError("Unable to parse expression " +
+                              to_string(m.first) + ": " + m.second);
+        }
+        exprs.push_back(expr);
+        flags.push_back(f);
+        ids.push_back(m.first);
+        ext.push_back(e);
+    }
+
+    vector<const char *> patterns;
+    vector<const hs_expr_ext *> ext_ptr;
+    for (size_t i = 0; i < exprs.size(); i++) {
+        patterns.push_back(exprs[i].c_str());
+        ext_ptr.push_back(&ext[i]);
+    }
+
+    unsigned int mode = scan_mode == ScanMode::STREAMING ? HS_MODE_STREAM
+                                                         : HS_MODE_BLOCK;
+
+    hs_database *db = nullptr;
+    hs_compile_error *compile_err = nullptr;
+
+    Timer timer;
+    timer.start();
+#if !defined(RELEASE_BUILD)
+    ue2::Grey g;
+    if (!grey.empty()) {
+        ue2::applyGreyOverrides(&g, grey);
+    }
+    hs_error_t err = ue2::hs_compile_multi_int(patterns.data(), flags.data(),
+                                               ids.data(), ext_ptr.data(),
+                                               patterns.size(), mode, nullptr,
+                                               &db, &compile_err, g);
+#else
+    (void)grey;
+    hs_error_t err = hs_compile_ext_multi(patterns.data(), flags.data(),
+                                          ids.data(), ext_ptr.data(),
+                                          patterns.size(), mode, nullptr,
+                                          &db, &compile_err);
+#endif
+    timer.complete();
+
+    if (err != HS_SUCCESS) {
+        ostringstream oss;
+        oss << "Compile failed";
+        if (compile_err) {
+            if (compile_err->expression >= 0) {
+                oss << " for expression "
+                    << ids[compile_err->expression];
+            }
+            oss << ": " << compile_err->message;
+            hs_free_compile_error(compile_err);
+        }
+        throw EngineError(oss.str());
+    }
+
+    if (compile_secs) {
+        *compile_secs = timer.seconds();
+    }
+
+    return unique_ptr<EngineHyperscan>(new EngineHyperscan(db));
+}
+
+unique_ptr<EngineHyperscan> loadEngineHyperscan(const string &filename) {
+    ifstream in(filename, ios::binary);
+    if (!in) {
+        throw EngineError("Unable to open database file '" + filename + "'");
+    }
+    string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    hs_database *db = nullptr;
+    check(hs_deserialize_database(bytes.data(), bytes.size(), &db),
+          "hs_deserialize_database");
+    return unique_ptr<EngineHyperscan>(new EngineHyperscan(db));
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ENGINEHYPERSCAN_H
+#define ENGINEHYPERSCAN_H
+
+#include "common.h"
+#include "expressions.h"
+
+#include <memory>
+#include <string>
+
+struct hs_database;
+struct hs_scratch;
+struct hs_stream;
+
+/** \brief Per-thread state used by \ref EngineHyperscan scans. */
+class EngineContext {
+public:
+    explicit EngineContext(const hs_database *db);
+    ~EngineContext();
+
+    EngineContext(const EngineContext &) = delete;
+    EngineContext &operator=(const EngineContext &) = delete;
+
+    hs_scratch *scratch = nullptr; //!< private scratch for this thread
+    unsigned long long matches = 0; //!< matches seen since last reset
+    bool echo = false; //!< print each match as it arrives
+};
+
+/** \brief An open stream, with the context it is being scanned in. */
+class EngineStream {
+public:
+    EngineStream(hs_stream *id_in, unsigned int sn_in, EngineContext *ctx_in)
+        : id(id_in), sn(sn_in), ctx(ctx_in) {}
+
+    hs_stream *id;
+    unsigned int sn; //!< stream number from the corpus
+    EngineContext *ctx;
+};
+
+/** \brief Hyperscan database wrapper used by the benchmark. */
+class EngineHyperscan {
+public:
+    explicit EngineHyperscan(hs_database *db);
+    ~EngineHyperscan();
+
+    EngineHyperscan(const EngineHyperscan &) = delete;
+    EngineHyperscan &operator=(const EngineHyperscan &) = delete;
+
+    /** \brief Allocate a new per-thread context, with its own scratch. */
+    std::unique_ptr<EngineContext> makeContext() const;
+
+    /** \brief Scan a single block of data in block mode. */
+    void scan(const char *data, unsigned int len, EngineContext &ctx) const;
+
+    /** \brief Open a new stream. */
+    std::unique_ptr<EngineStream> streamOpen(EngineContext &ctx,
+                                             unsigned int sn) const;
+
+    /** \brief Scan a block of data as the next write to a stream. */
+    void streamScan(EngineStream &stream, const char *data,
+                    unsigned int len) const;
+
+    /** \brief Close a stream, delivering any end-of-data matches. */
+    void streamClose(std::unique_ptr<EngineStream> stream) const;
+
+    /** \brief Print database information and sizes to stdout. */
+    void printStats() const;
+
+    /** \brief Serialize the database to \a filename. */
+    void saveDatabase(const std::string &filename) const;
+
+    /** \brief Mode the database was built for. */
+    ScanMode mode() const;
+
+    /** \brief Memory used by each open stream in bytes, or zero for a block
+     * mode database. */
+    size_t streamSize() const;
+
+    /** \brief Size of the compiled database in bytes. */
+    size_t bytecodeSize() const;
+
+private:
+    hs_database *db;
+};
+
+/**
+ * \brief Compile the expressions in \a exprMap for the given scan mode.
+ *
+ * A non-empty \a grey applies compiler tuning overrides, in the
+ * "key:value;key:value" form; these are ignored in release builds.
+ */
+std::unique_ptr<EngineHyperscan> buildEngineHyperscan(
+    const ExpressionMap &exprMap, ScanMode scan_mode, double *compile_secs,
+    const std::string &grey = std::string());
+
+/** \brief Load a database previously saved with \ref saveDatabase. */
+std::unique_ptr<EngineHyperscan> loadEngineHyperscan(
+    const std::string &filename);
+
+/** \brief Exception thrown on Hyperscan API failures. */
+class EngineError {
+public:
+    explicit EngineError(std::string msg_in) : msg(std::move(msg_in)) {}
+    std::string msg;
+};
+
+#endif // ENGINEHYPERSCAN_H
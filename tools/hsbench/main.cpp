@@ -0,0 +1,652 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include "common.h"
+#include "data_corpus.h"
+#include "engine_hyperscan.h"
+#include "expressions.h"
+#include "thread_barrier.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/stat.h>
+
+#if defined(HAVE_DECL_PTHREAD_SETAFFINITY_NP)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+/** \brief Results gathered by a single benchmark thread. */
+struct ThreadResult {
+    double seconds = 0;
+    unsigned long long matches = 0; //!< matches over all repeats
+};
+
+/** \brief Options gathered from the command line. */
+struct Options {
+    BenchConfig config;
+    string exprPath;
+    string sigFile;
+    string corpusFile;
+    string loadDbFile;
+    string saveDbFile;
+    string generateFile;
+    string pcapFile;
+    string grey; //!< compiler tuning overrides, as written by hstune
+    unsigned int threads = 1;
+    unsigned int flows = 0; //!< concurrent streams to replay, 0 for all
+    unsigned int burst = 1; //!< blocks per stream turn when interleaving
+    unsigned int genStreams = 8;
+    unsigned int genSeed = 0;
+    size_t genBlockLen = 4096; //!< block size of a worst-case corpus
+    bool genWorstCase = false; //!< generate near misses rather than matches
+    vector<int> cpus; //!< cores to pin threads to, in thread order
+    bool forceBlock = false;
+};
+
+void usage(const char *name, const char *error) {
+    printf("Usage: %s [OPTIONS...]\n\n", name);
+    printf("Options:\n\n");
+    printf("  -h              Display help and exit.\n");
+    printf("  -e PATH         Path to expression directory or file.\n");
+    printf("  -s FILE         Signature file to use.\n");
+    printf("  -c FILE         Corpus database to scan.\n");
+#if defined(HAVE_PCAP)
+    printf("  -P FILE         Pcap capture to scan, one stream per flow.\n");
+#endif
+    printf("  -d FILE         Load a serialized database instead of "
+           "compiling.\n");
+    printf("  -D FILE         Save the compiled database to FILE.\n");
+    printf("  -G FILE         Generate a corpus for the expressions into "
+           "FILE and exit.\n");
+    printf("  -W FILE         Generate a worst-case corpus of near misses "
+           "into FILE and exit.\n");
+    printf("  -S NUM          Number of streams in a generated corpus "
+           "(default: 8).\n");
+    printf("  -z NUM          Seed for corpus generation (default: 0).\n");
+#if !defined(RELEASE_BUILD)
+    printf("  -g OVERRIDES    Compile with the given tuning overrides "
+           "(see hstune).\n");
+#endif
+    printf("  -N              Benchmark in block mode (default: "
+           "streaming).\n");
+    printf("  -n NUM          Repeat scan NUM times (default: 20).\n");
+    printf("  -F NUM          Replay streams with NUM flows active at once "
+           "(default: corpus order).\n");
+    printf("  -b NUM          With -F, scan NUM blocks of a flow per turn "
+           "(default: 1).\n");
+    printf("  -j NUM          Run NUM benchmark threads (default: 1).\n");
+#if defined(HAVE_DECL_PTHREAD_SETAFFINITY_NP)
+    printf("  -T CPU,CPU,...  Run one thread pinned to each listed core.\n");
+#endif
+    printf("  -V              Print every match (slow!).\n");
+    if (error) {
+        printf("Error: %s\n", error);
+    }
+}
+
+bool parseUnsigned(const char *s, unsigned int *out) {
+    char *end = nullptr;
+    unsigned long val = strtoul(s, &end, 10);
+    if (!*s || *end || val > 0xffffffffUL) {
+        return false;
+    }
+    *out = (unsigned int)val;
+    return true;
+}
+
+#if defined(HAVE_DECL_PTHREAD_SETAFFINITY_NP)
+bool parseCpuList(const char *s, vector<int> &cpus) {
+    stringstream ss(s);
+    string tok;
+    while (getline(ss, tok, ',')) {
+        unsigned int cpu;
+        if (!parseUnsigned(tok.c_str(), &cpu)) {
+            return false;
+        }
+        cpus.push_back(cpu);
+    }
+    return !cpus.empty();
+}
+#endif
+
+void processArgs(int argc, char *argv[], Options &opts) {
+    const char *options = "b:c:d:D:e:F:g:G:hj:n:NP:s:S:T:VW:z:";
+    int in;
+    while ((in = getopt(argc, argv, options)) != -1) {
+        switch (in) {
+        case 'b':
+            if (!parseUnsigned(optarg, &opts.burst) || !opts.burst) {
+                usage(argv[0], "Couldn't parse argument to -b flag.");
+                exit(1);
+            }
+            break;
+        case 'c':
+            opts.corpusFile = optarg;
+            break;
+        case 'd':
+            opts.loadDbFile = optarg;
+            break;
+        case 'D':
+            opts.saveDbFile = optarg;
+            break;
+        case 'e':
+            opts.exprPath = optarg;
+            break;
+        case 'F':
+            if (!parseUnsigned(optarg, &opts.flows)) {
+                usage(argv[0], "Couldn't parse argument to -F flag.");
+                exit(1);
+            }
+            break;
+        case 'g':
+#if !defined(RELEASE_BUILD)
+            opts.grey = optarg;
+            break;
+#else
+            usage(argv[0], "This build does not support tuning overrides.");
+            exit(1);
+#endif
+        case 'G':
+            opts.generateFile = optarg;
+            opts.genWorstCase = false;
+            break;
+        case 'h':
+            usage(argv[0], nullptr);
+            exit(0);
+        case 'j':
+            if (!parseUnsigned(optarg, &opts.threads) || !opts.threads) {
+                usage(argv[0], "Couldn't parse argument to -j flag.");
+                exit(1);
+            }
+            break;
+        case 'n':
+            if (!parseUnsigned(optarg, &opts.config.repeats) ||
+                !opts.config.repeats) {
+                usage(argv[0], "Couldn't parse argument to -n flag.");
+                exit(1);
+            }
+            break;
+        case 'N':
+            opts.forceBlock = true;
+            break;
+        case 'P':
+#if defined(HAVE_PCAP)
+            opts.pcapFile = optarg;
+            break;
+#else
+            usage(argv[0], "This build does not support pcap input.");
+            exit(1);
+#endif
+        case 's':
+            opts.sigFile = optarg;
+            break;
+        case 'S':
+            if (!parseUnsigned(optarg, &opts.genStreams) ||
+                !opts.genStreams) {
+                usage(argv[0], "Couldn't parse argument to -S flag.");
+                exit(1);
+            }
+            break;
+        case 'T':
+#if defined(HAVE_DECL_PTHREAD_SETAFFINITY_NP)
+            if (!parseCpuList(optarg, opts.cpus)) {
+                usage(argv[0], "Couldn't parse argument to -T flag.");
+                exit(1);
+            }
+            break;
+#else
+            usage(argv[0], "Thread pinning is not supported on this "
+                           "platform.");
+            exit(1);
+#endif
+        case 'V':
+            opts.config.echoMatches = true;
+            break;
+        case 'W':
+            opts.generateFile = optarg;
+            opts.genWorstCase = true;
+            break;
+        case 'z':
+            if (!parseUnsigned(optarg, &opts.genSeed)) {
+                usage(argv[0], "Couldn't parse argument to -z flag.");
+                exit(1);
+            }
+            break;
+        default:
+            usage(argv[0], "Unrecognised command line argument.");
+            exit(1);
+        }
+    }
+
+    if (optind != argc) {
+        usage(argv[0], "Unexpected trailing arguments.");
+        exit(1);
+    }
+
+    if (!opts.cpus.empty()) {
+        opts.threads = opts.cpus.size();
+    }
+
+    opts.config.mode = opts.forceBlock ? ScanMode::BLOCK : ScanMode::STREAMING;
+
+    if (opts.loadDbFile.empty() && opts.exprPath.empty()) {
+        usage(argv[0], "Must specify either an expression path (-e) or a "
+                       "database (-d).");
+        exit(1);
+    }
+    if (!opts.generateFile.empty()) {
+        if (opts.exprPath.empty()) {
+            usage(argv[0], "Corpus generation (-G, -W) requires "
+                           "expressions (-e).");
+            exit(1);
+        }
+    } else if (opts.corpusFile.empty() == opts.pcapFile.empty()) {
+        usage(argv[0], "Must specify one of a corpus (-c) or a pcap file "
+                       "(-P).");
+        exit(1);
+    }
+}
+
+ExpressionMap loadExprs(const Options &opts) {
+    ExpressionMap exprMap;
+    struct stat st;
+    if (stat(opts.exprPath.c_str(), &st) != 0) {
+        cerr << "Can't stat path: '" << opts.exprPath << "'" << endl;
+        exit(1);
+    }
+    if (S_ISDIR(st.st_mode)) {
+        loadExpressions(opts.exprPath, exprMap);
+    } else {
+        loadExpressionsFromFile(opts.exprPath, exprMap);
+    }
+
+    if (!opts.sigFile.empty()) {
+        SignatureSet sigs;
+        loadSignatureList(opts.sigFile, sigs);
+        limitBySignature(exprMap, sigs);
+    }
+
+    if (exprMap.empty()) {
+        cerr << "No expressions to benchmark." << endl;
+        exit(1);
+    }
+    return exprMap;
+}
+
+void pinThread(int cpu) {
+#if defined(HAVE_DECL_PTHREAD_SETAFFINITY_NP)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset)) {
+        cerr << "Unable to pin thread to core " << cpu << endl;
+        exit(1);
+    }
+#else
+    (void)cpu;
+#endif
+}
+
+void scanBlocks(const EngineHyperscan &engine, EngineContext &ctx,
+                const vector<DataBlock> &corpus) {
+    for (const auto &b : corpus) {
+        engine.scan(b.payload.data(), b.payload.size(), ctx);
+    }
+}
+
+/** \brief One step of a streaming replay: a block to scan, and whether its
+ * stream is opened just before it and closed just after it. */
+struct ReplayStep {
+    const DataBlock *block;
+    bool open;
+    bool close;
+};
+
+/**
+ * \brief Builds the order in which a corpus is replayed in streaming mode.
+ *
+ * With \a flows of zero, blocks are replayed in corpus order. Otherwise at
+ * most \a flows streams are active at once: active streams take turns to scan
+ * \a burst blocks each, and when a stream runs out of blocks the next stream
+ * (in order of first appearance in the corpus) takes its place.
+ *
+ * Either way, a stream is opened just before its first block and closed just
+ * after its last. The largest number of streams open at once is returned in
+ * \a peak.
+ */
+vector<ReplayStep> buildReplay(const vector<DataBlock> &corpus,
+                               unsigned int flows, unsigned int burst,
+                               size_t *peak) {
+    // Blocks of each stream in corpus order, with streams in order of first
+    // appearance.
+    vector<vector<const DataBlock *>> streams;
+    unordered_map<unsigned int, size_t> streamIndex;
+    for (const auto &b : corpus) {
+        auto it = streamIndex.emplace(b.stream_id, streams.size()).first;
+        if (it->second == streams.size()) {
+            streams.emplace_back();
+        }
+        streams[it->second].push_back(&b);
+    }
+
+    vector<ReplayStep> replay;
+    replay.reserve(corpus.size());
+    *peak = 0;
+
+    if (!flows) {
+        vector<size_t> seen(streams.size(), 0);
+        size_t open = 0;
+        for (const auto &b : corpus) {
+            size_t s = streamIndex[b.stream_id];
+            bool first = seen[s]++ == 0;
+            bool last = seen[s] == streams[s].size();
+            if (first) {
+                *peak = max(*peak, ++open);
+            }
+            if (last) {
+                open--;
+            }
+            replay.push_back({&b, first, last});
+        }
+        return replay;
+    }
+
+    deque<pair<size_t, size_t>> active; // stream, next block
+    size_t next = 0;
+    while (next < streams.size() || !active.empty()) {
+        while (active.size() < flows && next < streams.size()) {
+            active.emplace_back(next++, 0);
+        }
+        *peak = max(*peak, active.size());
+
+        auto cur = active.front();
+        active.pop_front();
+        const auto &blocks = streams[cur.first];
+        for (unsigned int i = 0; i < burst && cur.second < blocks.size();
+             i++, cur.second++) {
+            replay.push_back({blocks[cur.second], cur.second == 0,
+                              cur.second + 1 == blocks.size()});
+        }
+        if (cur.second < blocks.size()) {
+            active.push_back(cur);
+        }
+    }
+    return replay;
+}
+
+void scanStreams(const EngineHyperscan &engine, EngineContext &ctx,
+                 const vector<ReplayStep> &replay) {
+    unordered_map<unsigned int, unique_ptr<EngineStream>> streams;
+    for (const auto &step : replay) {
+        const DataBlock &b = *step.block;
+        auto &stream = streams[b.stream_id];
+        if (step.open) {
+            stream = engine.streamOpen(ctx, b.stream_id);
+        }
+        engine.streamScan(*stream, b.payload.data(), b.payload.size());
+        if (step.close) {
+            engine.streamClose(move(stream));
+            streams.erase(b.stream_id);
+        }
+    }
+    assert(streams.empty());
+}
+
+/** \brief Number of streams opened and closed when timing stream setup. */
+static const size_t OPEN_CLOSE_STREAMS = 100000;
+
+/**
+ * \brief Times opening and closing streams with no data, \a batch streams at
+ * a time. Returns the mean cost of opening and closing one stream in seconds.
+ */
+double timeOpenClose(const EngineHyperscan &engine, size_t batch) {
+    batch = max(min(batch, OPEN_CLOSE_STREAMS), (size_t)1);
+    auto ctx = engine.makeContext();
+    vector<unique_ptr<EngineStream>> streams;
+    streams.reserve(batch);
+
+    size_t done = 0;
+    Timer timer;
+    timer.start();
+    while (done < OPEN_CLOSE_STREAMS) {
+        for (size_t i = 0; i < batch; i++) {
+            streams.push_back(engine.streamOpen(*ctx, i));
+        }
+        for (auto &stream : streams) {
+            engine.streamClose(move(stream));
+        }
+        streams.clear();
+        done += batch;
+    }
+    timer.complete();
+    return timer.seconds() / done;
+}
+
+void benchThread(const EngineHyperscan &engine, const BenchConfig &config,
+                 const vector<DataBlock> &corpus,
+                 const vector<ReplayStep> &replay, thread_barrier &barrier,
+                 int cpu, ThreadResult &result) {
+    if (cpu >= 0) {
+        pinThread(cpu);
+    }
+
+    unique_ptr<EngineContext> ctx;
+    try {
+        ctx = engine.makeContext();
+    } catch (const EngineError &e) {
+        cerr << e.msg << endl;
+        exit(1);
+    }
+    ctx->echo = config.echoMatches;
+
+    barrier.wait();
+
+    Timer timer;
+    timer.start();
+    try {
+        for (unsigned int i = 0; i < config.repeats; i++) {
+            if (config.mode == ScanMode::BLOCK) {
+                scanBlocks(engine, *ctx, corpus);
+            } else {
+                scanStreams(engine, *ctx, replay);
+            }
+        }
+    } catch (const EngineError &e) {
+        cerr << e.msg << endl;
+        exit(1);
+    }
+    timer.complete();
+
+    result.seconds = timer.seconds();
+    result.matches = ctx->matches;
+}
+
+double mbitPerSec(size_t bytes, unsigned int repeats, double secs) {
+    if (secs <= 0) {
+        return 0;
+    }
+    return (double)bytes * repeats * 8 / secs / 1000000.0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    processArgs(argc, argv, opts);
+    BenchConfig &config = opts.config;
+
+    try {
+        if (!opts.generateFile.empty()) {
+            ExpressionMap exprMap = loadExprs(opts);
+            auto blocks = opts.genWorstCase
+                ? generateWorstCaseCorpus(exprMap, opts.genStreams,
+                                          opts.genSeed, opts.genBlockLen)
+                : generateCorpus(exprMap, opts.genStreams, opts.genSeed);
+            writeCorpus(opts.generateFile, blocks);
+            printf("Wrote %zu blocks to corpus '%s'.\n", blocks.size(),
+                   opts.generateFile.c_str());
+            return 0;
+        }
+
+        unique_ptr<EngineHyperscan> engine;
+        double compile_secs = 0;
+        if (!opts.loadDbFile.empty()) {
+            engine = loadEngineHyperscan(opts.loadDbFile);
+            if (opts.forceBlock && engine->mode() != ScanMode::BLOCK) {
+                cerr << "Database '" << opts.loadDbFile
+                     << "' is not a block mode database." << endl;
+                return 1;
+            }
+            config.mode = engine->mode();
+        } else {
+            ExpressionMap exprMap = loadExprs(opts);
+            engine = buildEngineHyperscan(exprMap, config.mode,
+                                          &compile_secs, opts.grey);
+        }
+
+        if (!opts.saveDbFile.empty()) {
+            engine->saveDatabase(opts.saveDbFile);
+        }
+
+        vector<DataBlock> corpus;
+#if defined(HAVE_PCAP)
+        if (!opts.pcapFile.empty()) {
+            corpus = readPcapCorpus(opts.pcapFile);
+        } else
+#endif
+        {
+            corpus = readCorpus(opts.corpusFile);
+        }
+        size_t bytes = 0;
+        map<unsigned int, size_t> streamIds;
+        for (const auto &b : corpus) {
+            bytes += b.payload.size();
+            streamIds[b.stream_id]++;
+        }
+
+        printf("Scan mode:         %s\n",
+               config.mode == ScanMode::BLOCK ? "block" : "streaming");
+        if (opts.loadDbFile.empty()) {
+            printf("Compile time:      %.3f seconds\n", compile_secs);
+        }
+        engine->printStats();
+        printf("Corpus size:       %zu bytes in %zu blocks",
+               bytes, corpus.size());
+        if (config.mode == ScanMode::STREAMING) {
+            printf(" (%zu streams)", streamIds.size());
+        }
+        printf("\n");
+
+        vector<ReplayStep> replay;
+        size_t peakStreams = 0;
+        if (config.mode == ScanMode::STREAMING) {
+            replay = buildReplay(corpus, opts.flows, opts.burst,
+                                 &peakStreams);
+            if (opts.flows) {
+                printf("Replay:            %u flows at once, %u blocks "
+                       "per turn\n", opts.flows, opts.burst);
+            }
+            printf("Peak open streams: %zu per thread (%zu bytes of stream "
+                   "state)\n", peakStreams,
+                   peakStreams * engine->streamSize());
+        }
+
+        vector<ThreadResult> results(opts.threads);
+        thread_barrier barrier(opts.threads);
+        vector<thread> threads;
+        for (unsigned int i = 0; i < opts.threads; i++) {
+            int cpu = opts.cpus.empty() ? -1 : opts.cpus[i];
+            threads.emplace_back(benchThread, cref(*engine), cref(config),
+                                 cref(corpus), cref(replay), ref(barrier),
+                                 cpu, ref(results[i]));
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+
+        double max_secs = 0;
+        double best_rate = 0;
+        unsigned long long matches = results.front().matches;
+        for (unsigned int i = 0; i < opts.threads; i++) {
+            const auto &r = results[i];
+            double rate = mbitPerSec(bytes, config.repeats, r.seconds);
+            if (opts.threads > 1) {
+                printf("Thread %u:          %.2f Mbit/sec\n", i, rate);
+            }
+            if (r.matches != matches) {
+                cerr << "Thread " << i << " saw " << r.matches
+                     << " matches, expected " << matches << endl;
+                return 1;
+            }
+            max_secs = max(max_secs, r.seconds);
+            best_rate = max(best_rate, rate);
+        }
+
+        printf("Matches per iteration: %llu\n", matches / config.repeats);
+        printf("Time spent scanning:   %.3f seconds\n", max_secs);
+        printf("Overall throughput:    %.2f Mbit/sec\n",
+               mbitPerSec(bytes, config.repeats * opts.threads, max_secs));
+        printf("Max throughput (per core): %.2f Mbit/sec\n", best_rate);
+
+        if (config.mode == ScanMode::STREAMING) {
+            double secs = timeOpenClose(*engine, peakStreams);
+            printf("Stream open/close:     %.1f ns per stream\n",
+                   secs * 1e9);
+        }
+    } catch (const EngineError &e) {
+        cerr << e.msg << endl;
+        return 1;
+    } catch (const DataCorpusError &e) {
+        cerr << e.msg << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "config.h"
+
+#include "data_corpus.h"
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// We use the BSD primitives throughout as they exist on both BSD and Linux.
+#define __FAVOR_BSD
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+#include <netinet/in_systm.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+
+#include <pcap.h>
+
+using namespace std;
+
+namespace {
+
+/** \brief Key identifying the flow a packet belongs to. */
+using FlowKey = tuple<unsigned int, unsigned int, unsigned int, unsigned int,
+                      unsigned int>;
+
+/**
+ * \brief Locates the TCP or UDP payload of an Ethernet frame holding an
+ * unfragmented IPv4 packet. Returns false for any other packet.
+ */
+bool packetPayload(const u_char *pkt, unsigned int caplen, FlowKey *key,
+                   unsigned int *offset, unsigned int *length) {
+    if (caplen < sizeof(ether_header) + sizeof(ip)) {
+        return false;
+    }
+    const ether_header *eth = (const ether_header *)pkt;
+    if (ntohs(eth->ether_type) != ETHERTYPE_IP) {
+        return false;
+    }
+
+    const ip *iph = (const ip *)(pkt + sizeof(ether_header));
+    if (iph->ip_v != 4 || (iph->ip_off & htons(IP_MF | IP_OFFMASK))) {
+        return false;
+    }
+
+    unsigned int ihlen = iph->ip_hl * 4;
+    unsigned int thlen;
+    const u_char *th = (const u_char *)iph + ihlen;
+    const u_char *end = pkt + caplen;
+    unsigned int sport;
+    unsigned int dport;
+
+    switch (iph->ip_p) {
+    case IPPROTO_TCP: {
+        if (th + sizeof(tcphdr) > end) {
+            return false;
+        }
+        const tcphdr *tcp = (const tcphdr *)th;
+        thlen = tcp->th_off * 4;
+        sport = tcp->th_sport;
+        dport = tcp->th_dport;
+        break;
+    }
+    case IPPROTO_UDP: {
+        if (th + sizeof(udphdr) > end) {
+            return false;
+        }
+        const udphdr *udp = (const udphdr *)th;
+        thlen = sizeof(udphdr);
+        sport = udp->uh_sport;
+        dport = udp->uh_dport;
+        break;
+    }
+    default:
+        return false;
+    }
+
+    *offset = sizeof(ether_header) + ihlen + thlen;
+    unsigned int total = sizeof(ether_header) + ntohs(iph->ip_len);
+    if (total > caplen) {
+        total = caplen; // truncated capture
+    }
+    if (total <= *offset) {
+        return false;
+    }
+    *length = total - *offset;
+
+    *key = make_tuple(iph->ip_p, iph->ip_src.s_addr, sport,
+                      iph->ip_dst.s_addr, dport);
+    return true;
+}
+
+} // namespace
+
+vector<DataBlock> readPcapCorpus(const string &filename) {
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *handle = pcap_open_offline(filename.c_str(), errbuf);
+    if (!handle) {
+        throw DataCorpusError("Unable to open pcap file '" + filename +
+                              "': " + errbuf);
+    }
+    if (pcap_datalink(handle) != DLT_EN10MB) {
+        pcap_close(handle);
+        throw DataCorpusError("Pcap file '" + filename +
+                              "' is not an Ethernet capture");
+    }
+
+    map<FlowKey, unsigned int> flows;
+    vector<DataBlock> blocks;
+    struct pcap_pkthdr *hdr;
+    const u_char *pkt;
+    int status;
+    while ((status = pcap_next_ex(handle, &hdr, &pkt)) == 1) {
+        FlowKey key;
+        unsigned int offset;
+        unsigned int length;
+        if (!packetPayload(pkt, hdr->caplen, &key, &offset, &length)) {
+            continue;
+        }
+        unsigned int stream_id =
+            flows.emplace(key, flows.size()).first->second;
+        blocks.emplace_back(blocks.size(), stream_id,
+                            string((const char *)pkt + offset, length));
+    }
+
+    if (status == -1) {
+        string err = pcap_geterr(handle);
+        pcap_close(handle);
+        throw DataCorpusError("Error reading pcap file '" + filename +
+                              "': " + err);
+    }
+    pcap_close(handle);
+
+    if (blocks.empty()) {
+        throw DataCorpusError("Pcap file '" + filename +
+                              "' contains no TCP or UDP payloads");
+    }
+    return blocks;
+}
@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief hstune: searches compiler tuning parameters for a pattern set.
+ *
+ * Starting from the default parameters, each tunable is tried at each of its
+ * candidate values in turn, keeping any change that improves the score of
+ * the database on the corpus. The score weighs scan time against stream
+ * state and bytecode size, each relative to the defaults. The best
+ * configuration is printed as a grey override string, which hsbench -g
+ * accepts.
+ */
+
+#include "config.h"
+
+#include "common.h"
+#include "data_corpus.h"
+#include "engine_hyperscan.h"
+#include "expressions.h"
+#include "timer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+/** \brief A compiler parameter to search, with the values to try. */
+struct Tunable {
+    const char *name;
+    vector<unsigned int> values;
+};
+
+/** \brief The parameters searched, and their candidate values. */
+const vector<Tunable> TUNABLES = {
+    {"smallWriteLargestBuffer", {0, 35, 70, 140}},
+    {"maxHistoryAvailable", {55, 110, 220}},
+    {"minRoseLiteralLength", {2, 3, 4, 5}},
+    {"allowShermanStates", {0, 1}},
+    {"allowMcSheng", {0, 1}},
+    {"fdrAllowTeddy", {0, 1}},
+    {"roseMcClellanSuffix", {0, 1, 2}},
+    {"roseMcClellanPrefix", {0, 1, 2}},
+    {"violetAvoidSuffixes", {0, 1}},
+    {"violetAvoidWeakInfixes", {0, 1}},
+    {"violetDoubleCut", {0, 1}},
+    {"violetExtractStrongLiterals", {0, 1}},
+    {"violetLiteralChains", {0, 1}},
+    {"violetDoubleCutLiteralLen", {2, 3, 4, 5}},
+    {"violetEarlyCleanLiteralLen", {4, 6, 8}},
+};
+
+/** \brief Changes smaller than this fraction of the score are noise. */
+const double MIN_IMPROVEMENT = 0.02;
+
+/** \brief Options gathered from the command line. */
+struct Options {
+    string exprPath;
+    string sigFile;
+    string corpusFile;
+    string outFile;
+    ScanMode mode = ScanMode::STREAMING;
+    unsigned int repeats = 5;
+    unsigned int passes = 2;
+    unsigned int stateWeight = 10; //!< percent
+    unsigned int sizeWeight = 10; //!< percent
+};
+
+/** \brief What a candidate configuration costs on the corpus. */
+struct Measurement {
+    double seconds = 0;
+    size_t streamSize = 0;
+    size_t bytecodeSize = 0;
+    unsigned long long matches = 0;
+};
+
+void usage(const char *name, const char *error) {
+    printf("Usage: %s [OPTIONS...]\n\n", name);
+    printf("Options:\n\n");
+    printf("  -h              Display help and exit.\n");
+    printf("  -e PATH         Path to expression directory or file.\n");
+    printf("  -s FILE         Signature file to use.\n");
+    printf("  -c FILE         Corpus database to scan.\n");
+    printf("  -N              Tune for block mode (default: streaming).\n");
+    printf("  -n NUM          Scan the corpus NUM times per candidate "
+           "(default: 5).\n");
+    printf("  -p NUM          Make NUM passes over the parameters "
+           "(default: 2).\n");
+    printf("  -S PERCENT      Weight of stream state size in the score "
+           "(default: 10).\n");
+    printf("  -B PERCENT      Weight of bytecode size in the score "
+           "(default: 10).\n");
+    printf("  -o FILE         Write the best overrides to FILE.\n");
+    if (error) {
+        printf("Error: %s\n", error);
+    }
+}
+
+bool parseUnsigned(const char *s, unsigned int *out) {
+    char *end = nullptr;
+    unsigned long val = strtoul(s, &end, 10);
+    if (!*s || *end || val > 0xffffffffUL) {
+        return false;
+    }
+    *out = (unsigned int)val;
+    return true;
+}
+
+void processArgs(int argc, char *argv[], Options &opts) {
+    const char *options = "B:c:e:hn:No:p:s:S:";
+    int in;
+    while ((in = getopt(argc, argv, options)) != -1) {
+        switch (in) {
+        case 'B':
+            if (!parseUnsigned(optarg, &opts.sizeWeight)) {
+                usage(argv[0], "Couldn't parse argument to -B flag.");
+                exit(1);
+            }
+            break;
+        case 'c':
+            opts.corpusFile = optarg;
+            break;
+        case 'e':
+            opts.exprPath = optarg;
+            break;
+        case 'h':
+            usage(argv[0], nullptr);
+            exit(0);
+        case 'n':
+            if (!parseUnsigned(optarg, &opts.repeats) || !opts.repeats) {
+                usage(argv[0], "Couldn't parse argument to -n flag.");
+                exit(1);
+            }
+            break;
+        case 'N':
+            opts.mode = ScanMode::BLOCK;
+            break;
+        case 'o':
+            opts.outFile = optarg;
+            break;
+        case 'p':
+            if (!parseUnsigned(optarg, &opts.passes) || !opts.passes) {
+                usage(argv[0], "Couldn't parse argument to -p flag.");
+                exit(1);
+            }
+            break;
+        case 's':
+            opts.sigFile = optarg;
+            break;
+        case 'S':
+            if (!parseUnsigned(optarg, &opts.stateWeight)) {
+                usage(argv[0], "Couldn't parse argument to -S flag.");
+                exit(1);
+            }
+            break;
+        default:
+            usage(argv[0], "Unrecognised command line argument.");
+            exit(1);
+        }
+    }
+
+    if (optind != argc) {
+        usage(argv[0], "Unexpected trailing arguments.");
+        exit(1);
+    }
+    if (opts.exprPath.empty() || opts.corpusFile.empty()) {
+        usage(argv[0], "Must specify an expression path (-e) and a corpus "
+                       "(-c).");
+        exit(1);
+    }
+}
+
+ExpressionMap loadExprs(const Options &opts) {
+    ExpressionMap exprMap;
+    struct stat st;
+    if (stat(opts.exprPath.c_str(), &st) != 0) {
+        cerr << "Can't stat path: '" << opts.exprPath << "'" << endl;
+        exit(1);
+    }
+    if (S_ISDIR(st.st_mode)) {
+        loadExpressions(opts.exprPath, exprMap);
+    } else {
+        loadExpressionsFromFile(opts.exprPath, exprMap);
+    }
+
+    if (!opts.sigFile.empty()) {
+        SignatureSet sigs;
+        loadSignatureList(opts.sigFile, sigs);
+        limitBySignature(exprMap, sigs);
+    }
+
+    if (exprMap.empty()) {
+        cerr << "No expressions to tune." << endl;
+        exit(1);
+    }
+    return exprMap;
+}
+
+/** \brief Renders \a config in the form accepted by grey overrides. */
+string overrideString(const map<string, unsigned int> &config) {
+    ostringstream oss;
+    for (const auto &m : config) {
+        if (oss.tellp()) {
+            oss << ';';
+        }
+        oss << m.first << ':' << m.second;
+    }
+    return oss.str();
+}
+
+/**
+ * \brief Scans the corpus with \a engine, streams in corpus order, returning
+ * the total matches.
+ */
+unsigned long long scanCorpus(const EngineHyperscan &engine, ScanMode mode,
+                              const vector<DataBlock> &corpus) {
+    auto ctx = engine.makeContext();
+    if (mode == ScanMode::BLOCK) {
+        for (const auto &b : corpus) {
+            engine.scan(b.payload.data(), b.payload.size(), *ctx);
+        }
+        return ctx->matches;
+    }
+
+    unordered_map<unsigned int, size_t> remaining;
+    for (const auto &b : corpus) {
+        remaining[b.stream_id]++;
+    }
+    unordered_map<unsigned int, unique_ptr<EngineStream>> streams;
+    for (const auto &b : corpus) {
+        auto &stream = streams[b.stream_id];
+        if (!stream) {
+            stream = engine.streamOpen(*ctx, b.stream_id);
+        }
+        engine.streamScan(*stream, b.payload.data(), b.payload.size());
+        if (!--remaining[b.stream_id]) {
+            engine.streamClose(move(stream));
+            streams.erase(b.stream_id);
+        }
+    }
+    return ctx->matches;
+}
+
+/** \brief Compiles with \a config and measures the result on the corpus. */
+Measurement measure(const ExpressionMap &exprMap, const Options &opts,
+                    const vector<DataBlock> &corpus,
+                    const map<string, unsigned int> &config) {
+    auto engine = buildEngineHyperscan(exprMap, opts.mode, nullptr,
+                                       overrideString(config));
+    Measurement m;
+    m.streamSize = engine->streamSize();
+    m.bytecodeSize = engine->bytecodeSize();
+
+    // Warm up caches before timing.
+    m.matches = scanCorpus(*engine, opts.mode, corpus);
+
+    Timer timer;
+    timer.start();
+    for (unsigned int i = 0; i < opts.repeats; i++) {
+        scanCorpus(*engine, opts.mode, corpus);
+    }
+    timer.complete();
+    m.seconds = timer.seconds();
+    return m;
+}
+
+/** \brief Score of \a m relative to the defaults in \a base; lower is
+ * better, and the defaults score 1 plus the weights. */
+double score(const Measurement &m, const Measurement &base,
+             const Options &opts) {
+    double s = base.seconds > 0 ? m.seconds / base.seconds : 1.0;
+    if (base.streamSize) {
+        s += opts.stateWeight / 100.0 * m.streamSize / base.streamSize;
+    }
+    if (base.bytecodeSize) {
+        s += opts.sizeWeight / 100.0 * m.bytecodeSize / base.bytecodeSize;
+    }
+    return s;
+}
+
+void printMeasurement(const char *label, const Measurement &m, double s) {
+    printf("%-40s %8.3f s %8zu B state %10zu B bytecode  score %.3f\n",
+           label, m.seconds, m.streamSize, m.bytecodeSize, s);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    processArgs(argc, argv, opts);
+
+    try {
+        ExpressionMap exprMap = loadExprs(opts);
+        vector<DataBlock> corpus = readCorpus(opts.corpusFile);
+
+        map<string, unsigned int> best;
+        const Measurement base = measure(exprMap, opts, corpus, best);
+        double bestScore = score(base, base, opts);
+        printMeasurement("defaults", base, bestScore);
+
+        for (unsigned int pass = 0; pass < opts.passes; pass++) {
+            bool changed = false;
+            for (const auto &t : TUNABLES) {
+                for (unsigned int v : t.values) {
+                    auto it = best.find(t.name);
+                    if (it != best.end() && it->second == v) {
+                        continue;
+                    }
+                    auto candidate = best;
+                    candidate[t.name] = v;
+                    string label = string(t.name) + ":" + to_string(v);
+
+                    Measurement m;
+                    try {
+                        m = measure(exprMap, opts, corpus, candidate);
+                    } catch (const EngineError &e) {
+                        printf("%-40s failed: %s\n", label.c_str(),
+                               e.msg.c_str());
+                        continue;
+                    }
+                    if (m.matches != base.matches) {
+                        printf("%-40s changed the match count (%llu, "
+                               "expected %llu)\n", label.c_str(), m.matches,
+                               base.matches);
+                        continue;
+                    }
+
+                    double s = score(m, base, opts);
+                    printMeasurement(label.c_str(), m, s);
+                    if (s < bestScore * (1 - MIN_IMPROVEMENT)) {
+                        best = move(candidate);
+                        bestScore = s;
+                        changed = true;
+                    }
+                }
+            }
+            if (!changed) {
+                break;
+            }
+        }
+
+        string overrides = overrideString(best);
+        printf("Best score:  %.3f (defaults %.3f)\n", bestScore,
+               score(base, base, opts));
+        printf("Overrides:   %s\n",
+               overrides.empty() ? "(defaults)" : overrides.c_str());
+        if (!opts.outFile.empty()) {
+            ofstream out(opts.outFile);
+            out << overrides << endl;
+            if (!out) {
+                cerr << "Unable to write overrides to '" << opts.outFile
+                     << "'" << endl;
+                return 1;
+            }
+        }
+    } catch (const EngineError &e) {
+        cerr << e.msg << endl;
+        return 1;
+    } catch (const DataCorpusError &e) {
+        cerr << e.msg << endl;
+        return 1;
+    }
+
+    return 0;
+}
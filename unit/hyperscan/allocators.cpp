@@ -33,7 +33,9 @@
 #include "test_util.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <string>
+#include <vector>
 
 using std::string;
 
@@ -195,3 +197,163 @@ TEST(CustomAllocator, TwoAlignedExpressionInfo) {
     hs_free_compile_error(c_err);
     hs_set_allocator(nullptr, nullptr);
 }
+
+TEST(CustomAllocator, HugePageAllocator) {
+    hs_set_database_allocator(hs_huge_page_alloc, hs_huge_page_free);
+    hs_set_scratch_allocator(hs_huge_page_alloc, hs_huge_page_free);
+    hs_set_stream_allocator(hs_huge_page_alloc, hs_huge_page_free);
+
+    hs_database_t *db = buildDB("foo.*bar", 0, 0, HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    const string data = "xxfooxxxxbarxx";
+    err = hs_scan_stream(stream, data.c_str(), data.size(), 0, scratch,
+                         record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(stream, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(12, 0), c.matches[0]);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+    hs_set_allocator(nullptr, nullptr);
+
+    // Large blocks are mapped rather than taken from malloc.
+    const size_t len = 3 << 20;
+    char *mem = (char *)hs_huge_page_alloc(len);
+    ASSERT_TRUE(mem != nullptr);
+    memset(mem, 0xaa, len);
+    hs_huge_page_free(mem);
+    hs_huge_page_free(nullptr);
+}
+
+namespace {
+struct CountingArena {
+    size_t allocs = 0;
+    size_t frees = 0;
+};
+}
+
+static
+void *counting_alloc(size_t len, void *context) {
+    static_cast<CountingArena *>(context)->allocs++;
+    return malloc(len);
+}
+
+static
+void counting_free(void *mem, void *context) {
+    static_cast<CountingArena *>(context)->frees++;
+    free(mem);
+}
+
+TEST(CustomAllocator, AllocatorContext) {
+    hs_database_t *db = buildDB("foo.*bar", 0, 0, HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    // Nothing should come from the process-wide allocators.
+    hs_set_scratch_allocator(null_malloc, nullptr);
+    hs_set_stream_allocator(null_malloc, nullptr);
+
+    CountingArena arena;
+    const hs_allocator_t allocator = {counting_alloc, counting_free, &arena};
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch_ex(db, &allocator, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_scratch_t *clone = nullptr;
+    err = hs_clone_scratch(scratch, &clone);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream_ex(db, 0, &allocator, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_stream_t *copy = nullptr;
+    err = hs_copy_stream(&copy, stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    const string data = "xxfooxxxxbarxx";
+    err = hs_scan_stream(stream, data.c_str(), data.size(), 0, scratch,
+                         record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(stream, clone, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(copy, nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+
+    hs_free_scratch(clone);
+    hs_free_scratch(scratch);
+    EXPECT_LT(0U, arena.allocs);
+    EXPECT_EQ(arena.allocs, arena.frees);
+
+    err = hs_open_stream_ex(db, 0, nullptr, &stream);
+    ASSERT_EQ(HS_INVALID, err);
+
+    hs_set_allocator(nullptr, nullptr);
+    hs_free_database(db);
+}
+
+TEST(CustomAllocator, PlacementScratchAndStream) {
+    hs_database_t *db = buildDB("foo.*bar", 0, 0, HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    size_t scratch_size = 0;
+    hs_error_t err = hs_scratch_required_size(db, &scratch_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    size_t stream_size = 0;
+    err = hs_stream_size(db, &stream_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Neither should allocate.
+    hs_set_scratch_allocator(null_malloc, nullptr);
+    hs_set_stream_allocator(null_malloc, nullptr);
+
+    std::vector<unsigned long long> scratch_mem(scratch_size / 8 + 1);
+    std::vector<unsigned long long> stream_mem(stream_size / 8 + 1);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_init_scratch_at(db, scratch_mem.data(), scratch_size - 1,
+                             &scratch);
+    ASSERT_EQ(HS_INSUFFICIENT_SPACE, err);
+    err = hs_init_scratch_at(db, scratch_mem.data(), scratch_size, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream_at(db, 0, stream_mem.data(), stream_size - 1,
+                            &stream);
+    ASSERT_EQ(HS_INSUFFICIENT_SPACE, err);
+    err = hs_open_stream_at(db, 0, (char *)stream_mem.data() + 1,
+                            stream_size, &stream);
+    ASSERT_EQ(HS_BAD_ALIGN, err);
+    err = hs_open_stream_at(db, 0, stream_mem.data(), stream_size, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    const string data = "xxfooxxxxbarxx";
+    err = hs_scan_stream(stream, data.c_str(), data.size(), 0, scratch,
+                         record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(stream, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(12, 0), c.matches[0]);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_set_allocator(nullptr, nullptr);
+    hs_free_database(db);
+}
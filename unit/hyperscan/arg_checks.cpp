@@ -28,6 +28,9 @@
 
 #include "config.h"
 
+#include <cstring>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "hs.h"
 #include "test_util.h"
@@ -1064,6 +1067,211 @@ TEST(HyperscanArgChecks, ScanBlockNoHandler) {
     hs_free_database(db);
 }
 
+// hs_scan_batch: Call with no database
+TEST(HyperscanArgChecks, ScanBatchNoDatabase) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile("foobar", 0, HS_MODE_BLOCK, nullptr, &db,
+                                &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+    const char *data[] = {"data", "data"};
+    unsigned int len[] = {4, 4};
+    err = hs_scan_batch(nullptr, data, len, 2, 0, scratch, dummy_cb, nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// hs_scan_batch: Call with a database built for streaming mode
+TEST(HyperscanArgChecks, ScanBatchStreamingDatabase) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile("foobar", 0, HS_MODE_STREAM, nullptr, &db,
+                                &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+    const char *data[] = {"data", "data"};
+    unsigned int len[] = {4, 4};
+    err = hs_scan_batch(db, data, len, 2, 0, scratch, dummy_cb, nullptr);
+    ASSERT_EQ(HS_DB_MODE_ERROR, err);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// hs_scan_batch: Call with no data
+TEST(HyperscanArgChecks, ScanBatchNoData) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile("foobar", 0, HS_MODE_BLOCK, nullptr, &db,
+                                &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+    unsigned int len[] = {4, 4};
+    err = hs_scan_batch(db, nullptr, len, 2, 0, scratch, dummy_cb, nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    // one of the elements of the batch is NULL
+    const char *data[] = {"data", nullptr};
+    err = hs_scan_batch(db, data, len, 2, 0, scratch, dummy_cb, nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// hs_scan_batch: Call with no lengths
+TEST(HyperscanArgChecks, ScanBatchNoLength) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile("foobar", 0, HS_MODE_BLOCK, nullptr, &db,
+                                &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+    const char *data[] = {"data", "data"};
+    err = hs_scan_batch(db, data, nullptr, 2, 0, scratch, dummy_cb, nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// hs_scan_batch: Call with no scratch
+TEST(HyperscanArgChecks, ScanBatchNoScratch) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile("foobar", 0, HS_MODE_BLOCK, nullptr, &db,
+                                &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+    const char *data[] = {"data", "data"};
+    unsigned int len[] = {4, 4};
+    err = hs_scan_batch(db, data, len, 2, 0, nullptr, dummy_cb, nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    // teardown
+    hs_free_database(db);
+}
+
+// hs_scan_stream_batch: Call with no streams
+TEST(HyperscanArgChecks, ScanStreamBatchNoStreams) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile("foobar", 0, HS_MODE_STREAM, nullptr, &db,
+                                &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    const char *data[] = {"data", "data"};
+    unsigned int len[] = {4, 4};
+    err = hs_scan_stream_batch(nullptr, data, len, 2, 0, scratch, dummy_cb,
+                               nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    // one of the elements of the batch is NULL
+    hs_stream_t *ids[] = {stream, nullptr};
+    err = hs_scan_stream_batch(ids, data, len, 2, 0, scratch, dummy_cb,
+                               nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    // teardown
+    err = hs_close_stream(stream, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// hs_scan_stream_batch: Call with no data or scratch
+TEST(HyperscanArgChecks, ScanStreamBatchNoData) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile("foobar", 0, HS_MODE_STREAM, nullptr, &db,
+                                &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    hs_stream_t *ids[] = {stream};
+    const char *data[] = {nullptr};
+    unsigned int len[] = {4};
+    err = hs_scan_stream_batch(ids, data, len, 1, 0, scratch, dummy_cb,
+                               nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    err = hs_scan_stream_batch(ids, nullptr, len, 1, 0, scratch, dummy_cb,
+                               nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    const char *good_data[] = {"data"};
+    err = hs_scan_stream_batch(ids, good_data, nullptr, 1, 0, scratch,
+                               dummy_cb, nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    err = hs_scan_stream_batch(ids, good_data, len, 1, 0, nullptr, dummy_cb,
+                               nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+    EXPECT_NE(HS_SCAN_TERMINATED, err);
+
+    // teardown
+    err = hs_close_stream(stream, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
 // hs_scan_vector: Call with no database
 TEST(HyperscanArgChecks, ScanVectorNoDatabase) {
     hs_database_t *db = nullptr;
@@ -1685,6 +1893,33 @@ TEST(HyperscanArgChecks, DatabaseSizeBadDb) {
     ASSERT_EQ(HS_INVALID, err);
 }
 
+TEST(HyperscanArgChecks, DatabaseMemoryNoDatabase) {
+    hs_db_memory_t mem;
+    hs_error_t err = hs_database_memory(nullptr, &mem);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, DatabaseMemoryNoMemory) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile("foobar", 0, HS_MODE_STREAM, nullptr, &db,
+                                &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+
+    err = hs_database_memory(db, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    hs_free_database(db);
+}
+
+TEST(HyperscanArgChecks, DatabaseMemoryBadDb) {
+    hs_database_t *db = (hs_database_t *)garbage;
+    hs_db_memory_t mem;
+    hs_error_t err = hs_database_memory(db, &mem);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
 TEST(HyperscanArgChecks, DatabaseInfoBadDb) {
     hs_database_t *db = (hs_database_t *)garbage;
     char *info = garbage;
@@ -2022,6 +2257,223 @@ TEST(HyperscanArgChecks, ScratchSizeBadScratch) {
     ASSERT_EQ(HS_INVALID, err);
 }
 
+TEST(HyperscanArgChecks, CompileCacheNoCache) {
+    const char *expr[] = {"foobar"};
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_ext_multi_cached(expr, nullptr, nullptr,
+                                                 nullptr, 1, HS_MODE_BLOCK,
+                                                 nullptr, nullptr, &db,
+                                                 &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    EXPECT_TRUE(db == nullptr);
+    EXPECT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+}
+
+TEST(HyperscanArgChecks, CompilePartitionedNoCount) {
+    const char *expr[] = {"foobar"};
+    hs_database_t *dbs[2];
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_ext_multi_partitioned(
+        expr, nullptr, nullptr, nullptr, 1, HS_MODE_BLOCK, nullptr, nullptr, 2,
+        dbs, nullptr, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    EXPECT_TRUE(dbs[0] == nullptr);
+    EXPECT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+}
+
+TEST(HyperscanArgChecks, CompilePartitionedNoDatabases) {
+    const char *expr[] = {"foobar"};
+    hs_database_t *dbs[2];
+    unsigned count = 1;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_ext_multi_partitioned(
+        expr, nullptr, nullptr, nullptr, 1, HS_MODE_BLOCK, nullptr, nullptr, 0,
+        dbs, &count, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    EXPECT_EQ(0U, count);
+    EXPECT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+}
+
+TEST(HyperscanArgChecks, CompileTunedNoCorpus) {
+    const char *expr[] = {"foo.*bar"};
+    const unsigned flags[] = {HS_FLAG_PREFILTER};
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_ext_multi_tuned(
+        expr, flags, nullptr, nullptr, 1, HS_MODE_BLOCK, nullptr, nullptr, 10,
+        100, &db, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    EXPECT_TRUE(db == nullptr);
+    EXPECT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+}
+
+TEST(HyperscanArgChecks, CompileCacheAllocNull) {
+    hs_error_t err = hs_alloc_compile_cache(nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, CompileCacheInfoNoCache) {
+    size_t engines, size;
+    hs_error_t err = hs_compile_cache_info(nullptr, &engines, &size);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, CompileCacheFreeNull) {
+    hs_error_t err = hs_free_compile_cache(nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+}
+
+TEST(HyperscanArgChecks, ScratchProfileInfoNoInfo) {
+    hs_error_t err;
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    err = hs_compile("foo.*bar$", 0, HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_TRUE(scratch != nullptr);
+
+    err = hs_scratch_profile_info(scratch, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(HyperscanArgChecks, ScratchProfileInfoNoScratch) {
+    char *info = nullptr;
+    hs_error_t err = hs_scratch_profile_info(nullptr, &info);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(info == nullptr);
+}
+
+TEST(HyperscanArgChecks, ScratchProfileInfoBadScratch) {
+    hs_scratch_t *scratch = (hs_scratch_t *)garbage;
+    char *info = nullptr;
+    hs_error_t err = hs_scratch_profile_info(scratch, &info);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(info == nullptr);
+}
+
+TEST(HyperscanArgChecks, ScratchProfileResetNoScratch) {
+    hs_error_t err = hs_scratch_profile_reset(nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, ScratchProfileResetBadScratch) {
+    hs_scratch_t *scratch = (hs_scratch_t *)garbage;
+    hs_error_t err = hs_scratch_profile_reset(scratch);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, ProfileReportNoInfo) {
+    hs_error_t err;
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    err = hs_compile("foo.*bar$", 0, HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_TRUE(scratch != nullptr);
+
+    err = hs_profile_report(db, scratch, 0, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(HyperscanArgChecks, ProfileReportNoDatabase) {
+    hs_error_t err;
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    err = hs_compile("foo.*bar$", 0, HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_TRUE(scratch != nullptr);
+
+    char *info = nullptr;
+    err = hs_profile_report(nullptr, scratch, 0, &info);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(info == nullptr);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(HyperscanArgChecks, ProfileReportNoScratch) {
+    hs_error_t err;
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    err = hs_compile("foo.*bar$", 0, HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    char *info = nullptr;
+    err = hs_profile_report(db, nullptr, 0, &info);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(info == nullptr);
+
+    hs_free_database(db);
+}
+
+TEST(HyperscanArgChecks, ScratchPmuStatsNoStats) {
+    hs_error_t err;
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    err = hs_compile("foo.*bar$", 0, HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_TRUE(scratch != nullptr);
+
+    err = hs_scratch_pmu_stats(scratch, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(HyperscanArgChecks, ScratchPmuStatsNoScratch) {
+    hs_pmu_stats_t stats;
+    hs_error_t err = hs_scratch_pmu_stats(nullptr, &stats);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, ScratchPmuStatsBadScratch) {
+    hs_scratch_t *scratch = (hs_scratch_t *)garbage;
+    hs_pmu_stats_t stats;
+    hs_error_t err = hs_scratch_pmu_stats(scratch, &stats);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, ScratchPmuResetNoScratch) {
+    hs_error_t err = hs_scratch_pmu_reset(nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
 // hs_clone_scratch: bad scratch arg
 TEST(HyperscanArgChecks, CloneBadScratch) {
     // Try cloning the scratch
@@ -2312,6 +2764,242 @@ TEST(HyperscanArgChecks, hs_populate_platform_null) {
     ASSERT_EQ(HS_INVALID, err);
 }
 
+TEST(HyperscanArgChecks, hs_valid_platform) {
+    // we can't be running the unit tests on a platform that we don't support
+    hs_error_t err = hs_valid_platform();
+    ASSERT_EQ(HS_SUCCESS, err);
+}
+
+TEST(HyperscanArgChecks, hs_set_compile_byte_frequencies_zero) {
+    unsigned long long counts[256] = {0};
+    hs_error_t err = hs_set_compile_byte_frequencies(counts);
+    ASSERT_EQ(HS_INVALID, err);
+
+    counts['a'] = 1;
+    err = hs_set_compile_byte_frequencies(counts);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_set_compile_byte_frequencies(nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+}
+
+TEST(HyperscanArgChecks, hs_set_compile_byte_pair_frequencies_zero) {
+    std::vector<unsigned long long> counts(256 * 256, 0);
+    hs_error_t err = hs_set_compile_byte_pair_frequencies(counts.data());
+    ASSERT_EQ(HS_INVALID, err);
+
+    counts['a' * 256 + 'b'] = 1;
+    err = hs_set_compile_byte_pair_frequencies(counts.data());
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_set_compile_byte_pair_frequencies(nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+}
+
+TEST(HyperscanArgChecks, hs_compile_degraded_patterns_null) {
+    const unsigned int *ids = nullptr;
+    unsigned int count = 0;
+    hs_error_t err = hs_compile_degraded_patterns(nullptr, &count);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_compile_degraded_patterns(&ids, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, hs_compile_degraded_patterns_no_budget) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile("foo.*bar", 0, HS_MODE_BLOCK, nullptr, &db,
+                                &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, db);
+
+    const unsigned int *ids = nullptr;
+    unsigned int count = 1;
+    err = hs_compile_degraded_patterns(&ids, &count);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, count);
+    ASSERT_EQ(nullptr, ids);
+
+    hs_free_database(db);
+}
+
+TEST(HyperscanArgChecks, hs_compile_report_null) {
+    hs_error_t err = hs_compile_report(nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, hs_compile_report_enabled) {
+    hs_error_t err = hs_set_compile_report(1);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const char *exprs[] = {"foo.*bar", "abc[^x]{20}def", "x.*y.*z"};
+    const unsigned ids[] = {10, 11, 12};
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    err = hs_compile_multi(exprs, nullptr, ids, 3, HS_MODE_BLOCK, nullptr,
+                           &db, &compile_err);
+    hs_set_compile_report(0);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, db);
+
+    const hs_compile_stats_t *report = nullptr;
+    err = hs_compile_report(&report);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, report);
+
+    unsigned long long total = 0;
+    for (unsigned i = 0; i < HS_COMPILE_PHASE_COUNT; i++) {
+        const hs_compile_phase_report_t &p = report->phases[i];
+        total += p.time_ns;
+        ASSERT_LE(p.slowest_count, (unsigned)HS_COMPILE_REPORT_SLOWEST);
+        for (unsigned j = 0; j < p.slowest_count; j++) {
+            ASSERT_GT(3U, p.slowest[j]); // indices, not ids
+            if (j) {
+                ASSERT_LE(p.slowest_time_ns[j], p.slowest_time_ns[j - 1]);
+            }
+        }
+    }
+    ASSERT_EQ(total, report->total_time_ns);
+
+    // Every expression was parsed and built into a graph.
+    const hs_compile_phase_report_t &parse =
+        report->phases[HS_COMPILE_PHASE_PARSE];
+    ASSERT_EQ(3U, parse.slowest_count);
+    ASSERT_LT(0ULL, parse.time_ns);
+    ASSERT_LT(0ULL, report->phases[HS_COMPILE_PHASE_BYTECODE].time_ns);
+
+    hs_free_database(db);
+
+    // With reports disabled again, the next compile has none.
+    err = hs_compile("foo", 0, HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_compile_report(&report);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(nullptr, report);
+
+    hs_free_database(db);
+}
+
+TEST(HyperscanArgChecks, hs_compile_stream_state_usage_null) {
+    const hs_stream_state_usage_t *usage = nullptr;
+    unsigned int count = 0;
+    hs_error_t err = hs_compile_stream_state_usage(nullptr, &count);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_compile_stream_state_usage(&usage, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, hs_set_stream_state_budget_bad_flags) {
+    hs_stream_state_budget_t budget = {0, 0, 0x80};
+    hs_error_t err = hs_set_stream_state_budget(&budget);
+    ASSERT_EQ(HS_INVALID, err);
+}
+
+TEST(HyperscanArgChecks, hs_compile_stream_state_usage_listed) {
+    hs_stream_state_budget_t budget = {0, 0, 0};
+    hs_error_t err = hs_set_stream_state_budget(&budget);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const char *exprs[] = {"foo", "abc[^x]{200}def", "x.*y.*z"};
+    const unsigned ids[] = {10, 11, 12};
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    err = hs_compile_multi(exprs, nullptr, ids, 3, HS_MODE_STREAM, nullptr,
+                           &db, &compile_err);
+    hs_set_stream_state_budget(nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, db);
+
+    const hs_stream_state_usage_t *usage = nullptr;
+    unsigned int count = 0;
+    err = hs_compile_stream_state_usage(&usage, &count);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(3U, count);
+    ASSERT_NE(nullptr, usage);
+
+    size_t stream_size = 0;
+    err = hs_stream_size(db, &stream_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    for (unsigned i = 0; i < count; i++) {
+        const hs_stream_state_usage_t &u = usage[i];
+        ASSERT_TRUE(u.id >= 10 && u.id <= 12);
+        ASSERT_LE(u.engine_bytes + u.repeat_bytes + u.som_bytes,
+                  u.total_bytes);
+        ASSERT_LE(u.total_bytes, stream_size);
+        if (i) {
+            ASSERT_LE(u.total_bytes, usage[i - 1].total_bytes);
+        }
+    }
+
+    // The bounded repeat is the most expensive pattern.
+    ASSERT_EQ(11U, usage[0].id);
+    ASSERT_LT(0U, usage[0].repeat_bytes + usage[0].engine_bytes);
+
+    hs_free_database(db);
+
+    // Block mode compiles are not attributed.
+    err = hs_set_stream_state_budget(&budget);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_compile("foo", 0, HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    hs_set_stream_state_budget(nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_compile_stream_state_usage(&usage, &count);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(nullptr, usage);
+    ASSERT_EQ(0U, count);
+
+    hs_free_database(db);
+}
+
+TEST(HyperscanArgChecks, hs_stream_state_budget_rejects) {
+    hs_stream_state_budget_t budget = {1, 0, 0};
+    hs_error_t err = hs_set_stream_state_budget(&budget);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    err = hs_compile("abc[^x]{200}def", 0, HS_MODE_STREAM, nullptr, &db,
+                     &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_EQ(nullptr, db);
+    ASSERT_NE(nullptr, compile_err);
+    ASSERT_EQ(-1, compile_err->expression);
+    ASSERT_NE(nullptr, strstr(compile_err->message, "Pattern 0"));
+    hs_free_compile_error(compile_err);
+
+    // The attribution is kept for the rejected compile.
+    const hs_stream_state_usage_t *usage = nullptr;
+    unsigned int count = 0;
+    err = hs_compile_stream_state_usage(&usage, &count);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, count);
+    ASSERT_LT(1U, usage[0].total_bytes);
+
+    // Still over budget after restructuring.
+    budget.flags = HS_STATE_BUDGET_RESTRUCTURE;
+    err = hs_set_stream_state_budget(&budget);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_compile("abc[^x]{200}def", 0, HS_MODE_STREAM, nullptr, &db,
+                     &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    hs_free_compile_error(compile_err);
+
+    // A database budget.
+    budget = {0, 1, 0};
+    err = hs_set_stream_state_budget(&budget);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_compile("foo", 0, HS_MODE_STREAM, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_NE(nullptr, strstr(compile_err->message, "Database"));
+    hs_free_compile_error(compile_err);
+
+    // Disabled again, compiles succeed.
+    hs_set_stream_state_budget(nullptr);
+    err = hs_compile("abc[^x]{200}def", 0, HS_MODE_STREAM, nullptr, &db,
+                     &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
 class BadModeTest : public testing::TestWithParam<unsigned> {};
 
 // hs_compile: Compile a pattern with bogus mode flags set.
@@ -2332,7 +3020,6 @@ TEST_P(BadModeTest, FailCompile) {
 static const unsigned badModeValues[] = {
     // Multiple modes at once.
     HS_MODE_BLOCK | HS_MODE_STREAM | HS_MODE_VECTORED,
-    HS_MODE_BLOCK | HS_MODE_STREAM,
     HS_MODE_BLOCK | HS_MODE_VECTORED,
     HS_MODE_STREAM | HS_MODE_VECTORED,
     // SOM horizon modes are only accepted in streaming mode.
@@ -2347,6 +3034,8 @@ static const unsigned badModeValues[] = {
     HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE | HS_MODE_SOM_HORIZON_SMALL,
     HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE | HS_MODE_SOM_HORIZON_MEDIUM,
     HS_MODE_STREAM | HS_MODE_SOM_HORIZON_MEDIUM | HS_MODE_SOM_HORIZON_SMALL,
+    // Any-match mode does not track SOM.
+    HS_MODE_STREAM | HS_MODE_ANY_MATCH | HS_MODE_SOM_HORIZON_LARGE,
 };
 
 INSTANTIATE_TEST_CASE_P(HyperscanArgChecks, BadModeTest,
@@ -29,6 +29,7 @@
 #include "config.h"
 #include <algorithm>
 #include <climits>
+#include <cstring>
 #include <sstream>
 #include <string>
 
@@ -388,6 +389,990 @@ TEST(HyperscanTestBehaviour, BlockThereCanBeOnlyOne) {
     hs_free_database(db);
 }
 
+// Each block in a batch is scanned independently, with its own context.
+TEST(HyperscanTestBehaviour, BlockBatch) {
+    hs_database_t *db = buildDB("foo", 0, 1000, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    const char *data[] = {"foo", "xxfooxxfoo", "", "fo", "o"};
+    const unsigned int len[] = {3, 10, 0, 2, 1};
+    const unsigned int count = sizeof(data) / sizeof(data[0]);
+    CallBackContext c[count];
+    void *ctx[count];
+    for (unsigned int i = 0; i < count; i++) {
+        ctx[i] = &c[i];
+    }
+
+    err = hs_scan_batch(db, data, len, count, 0, scratch, record_cb, ctx);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(1U, c[0].matches.size());
+    EXPECT_EQ(MatchRecord(3, 1000), c[0].matches[0]);
+    ASSERT_EQ(2U, c[1].matches.size());
+    EXPECT_EQ(MatchRecord(5, 1000), c[1].matches[0]);
+    EXPECT_EQ(MatchRecord(10, 1000), c[1].matches[1]);
+    EXPECT_TRUE(c[2].matches.empty());
+    EXPECT_TRUE(c[3].matches.empty());
+    EXPECT_TRUE(c[4].matches.empty());
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Terminating one block in a batch does not stop the others being scanned.
+TEST(HyperscanTestBehaviour, BlockBatchTerminate) {
+    hs_database_t *db = buildDB("foo", 0, 1000, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    const char *data[] = {"foofoofoo", "foofoofoo"};
+    const unsigned int len[] = {9, 9};
+    CallBackContext c[2];
+    c[0].halt = true;
+    void *ctx[] = {&c[0], &c[1]};
+
+    err = hs_scan_batch(db, data, len, 2, 0, scratch, record_cb, ctx);
+    ASSERT_EQ(HS_SCAN_TERMINATED, err);
+    ASSERT_EQ(1U, c[0].matches.size());
+    EXPECT_EQ(MatchRecord(3, 1000), c[0].matches[0]);
+    EXPECT_EQ(3U, c[1].matches.size());
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Batches of small blocks are screened against the small write DFA several
+// blocks at a time; results must match scanning each block on its own.
+TEST(HyperscanTestBehaviour, BlockBatchSmallWriteLanes) {
+    hs_database_t *db = buildDB("fo+[a-z]?bar", 0, 1000, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    const vector<string> blocks = {
+        "xxxxxxxx", "foobar", "fobar", "foxbar", "fooo", "", "bar",
+        "zzfoooobarzz", "foqbarfobar", "foo", "xfoobar", "f", "fooooooooooooo",
+        "qqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqfobar",
+        "nothing to see", "fooxxbar", "foobarfoobar"};
+    const unsigned int count = blocks.size();
+
+    vector<const char *> data;
+    vector<unsigned int> len;
+    vector<CallBackContext> c(count);
+    vector<void *> ctx;
+    for (unsigned int i = 0; i < count; i++) {
+        data.push_back(blocks[i].c_str());
+        len.push_back(blocks[i].size());
+        ctx.push_back(&c[i]);
+    }
+
+    err = hs_scan_batch(db, data.data(), len.data(), count, 0, scratch,
+                        record_cb, ctx.data());
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    for (unsigned int i = 0; i < count; i++) {
+        CallBackContext single;
+        err = hs_scan(db, data[i], len[i], 0, scratch, record_cb, &single);
+        ASSERT_EQ(HS_SUCCESS, err);
+        EXPECT_EQ(single.matches, c[i].matches) << "block " << i;
+    }
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Build a large buffer with matches for the parallel scan tests placed on
+// and around the boundaries of the pieces it will be split into.
+static
+string makeParallelCorpus(size_t len) {
+    string corpus(len, 'x');
+    auto put = [&corpus](size_t pos, const string &s) {
+        corpus.replace(pos, s.size(), s);
+    };
+    put(0, "start");
+    for (size_t pos = 1000; pos + 64 < len; pos += (1 << 20) / 3) {
+        put(pos - 10, "word foo ab bar ");
+        put(pos + 20, "\nend\n");
+    }
+    put(len - 3, "end");
+    return corpus;
+}
+
+// A parallel scan produces the same matches, in the same order, as hs_scan.
+TEST(HyperscanTestBehaviour, BlockParallel) {
+    vector<pattern> patterns;
+    patterns.emplace_back("foo[^x]{0,10}bar", 0, 1);
+    patterns.emplace_back("\\bword\\b", HS_FLAG_SOM_LEFTMOST, 2);
+    patterns.emplace_back("^start", 0, 3);
+    patterns.emplace_back("end$", 0, 4);
+    patterns.emplace_back("^end$", HS_FLAG_MULTILINE, 5);
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    const string corpus = makeParallelCorpus(16 << 20);
+
+    CallBackContext expected;
+    err = hs_scan(db, corpus.data(), corpus.size(), 0, scratch, record_cb,
+                  &expected);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_LT(40U, expected.matches.size());
+
+    for (unsigned threads : {1U, 2U, 4U, 0U}) {
+        CallBackContext c;
+        err = hs_scan_parallel(db, corpus.data(), corpus.size(), 0, threads,
+                               scratch, record_cb, &c);
+        ASSERT_EQ(HS_SUCCESS, err);
+        EXPECT_EQ(expected.matches, c.matches);
+    }
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Databases that cannot be split are scanned on the calling thread.
+TEST(HyperscanTestBehaviour, BlockParallelUnbounded) {
+    vector<pattern> patterns;
+    patterns.emplace_back("foo.*bar", 0, 1);
+    patterns.emplace_back("word", HS_FLAG_SINGLEMATCH, 2);
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    const string corpus = makeParallelCorpus(4 << 20);
+
+    CallBackContext expected;
+    err = hs_scan(db, corpus.data(), corpus.size(), 0, scratch, record_cb,
+                  &expected);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    err = hs_scan_parallel(db, corpus.data(), corpus.size(), 0, 4, scratch,
+                           record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(expected.matches, c.matches);
+    EXPECT_EQ(1, count_if(c.matches.begin(), c.matches.end(),
+                          [](const MatchRecord &m) { return m.id == 2; }));
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Terminating a parallel scan stops match delivery at once.
+TEST(HyperscanTestBehaviour, BlockParallelTerminate) {
+    hs_database_t *db = buildDB("foo[^x]{0,10}bar", 0, 1000, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    const string corpus = makeParallelCorpus(16 << 20);
+
+    CallBackContext c;
+    c.halt = true;
+    err = hs_scan_parallel(db, corpus.data(), corpus.size(), 0, 4, scratch,
+                           record_cb, &c);
+    ASSERT_EQ(HS_SCAN_TERMINATED, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(1005, 1000), c.matches[0]);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Stream writes queued on a flow scheduler produce the same matches for each
+// flow as writing to the streams directly, whichever worker scans them.
+TEST(HyperscanTestBehaviour, SchedulerStreams) {
+    hs_database_t *db = buildDB("foo[^x]{0,10}bar", 0, 1, HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_scheduler_t *sched = nullptr;
+    err = hs_alloc_scheduler(db, 4, scratch, &sched);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(sched != nullptr);
+
+    // One heavy flow, worth stealing, among many light ones.
+    const unsigned int flows = 16;
+    const string heavy = makeParallelCorpus(1 << 20);
+    const string light = "xxfoo ab barxxfoo";
+    vector<CallBackContext> expected(flows), c(flows);
+    for (unsigned int f = 0; f < flows; f++) {
+        hs_stream_t *stream = nullptr;
+        err = hs_open_stream(db, 0, &stream);
+        ASSERT_EQ(HS_SUCCESS, err);
+        const string &data = f ? light : heavy;
+        for (unsigned int i = 0; i < 8; i++) {
+            err = hs_scan_stream(stream, data.data(), data.size(), 0, scratch,
+                                 record_cb, &expected[f]);
+            ASSERT_EQ(HS_SUCCESS, err);
+            err = hs_scheduler_scan_stream(sched, f, data.data(), data.size(),
+                                           record_cb, &c[f]);
+            ASSERT_EQ(HS_SUCCESS, err);
+        }
+        err = hs_close_stream(stream, scratch, record_cb, &expected[f]);
+        ASSERT_EQ(HS_SUCCESS, err);
+        err = hs_scheduler_close_stream(sched, f, record_cb, &c[f]);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    err = hs_scheduler_wait(sched);
+    ASSERT_EQ(HS_SUCCESS, err);
+    for (unsigned int f = 0; f < flows; f++) {
+        ASSERT_LT(0U, expected[f].matches.size());
+        EXPECT_EQ(expected[f].matches, c[f].matches);
+    }
+
+    unsigned long long writes = 0;
+    for (unsigned int w = 0; w < 4; w++) {
+        hs_scheduler_stats_t stats;
+        err = hs_scheduler_worker_stats(sched, w, &stats);
+        ASSERT_EQ(HS_SUCCESS, err);
+        writes += stats.writes;
+    }
+    EXPECT_EQ(flows * 8, writes);
+
+    // closed flows are gone
+    err = hs_scheduler_close_stream(sched, 0, nullptr, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    // teardown
+    err = hs_free_scheduler(sched);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Block-mode jobs queued on a flow scheduler match as hs_scan does.
+TEST(HyperscanTestBehaviour, SchedulerBlocks) {
+    hs_database_t *db = buildDB("foo[^x]{0,10}bar", 0, 1, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_scheduler_t *sched = nullptr;
+    err = hs_alloc_scheduler(db, 0, scratch, &sched);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string corpus = makeParallelCorpus(1 << 20);
+    CallBackContext expected;
+    err = hs_scan(db, corpus.data(), corpus.size(), 0, scratch, record_cb,
+                  &expected);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const unsigned int jobs = 32;
+    vector<CallBackContext> c(jobs);
+    for (unsigned int i = 0; i < jobs; i++) {
+        err = hs_scheduler_scan(sched, corpus.data(), corpus.size(),
+                                record_cb, &c[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    err = hs_scheduler_wait(sched);
+    ASSERT_EQ(HS_SUCCESS, err);
+    for (const auto &ci : c) {
+        EXPECT_EQ(expected.matches, ci.matches);
+    }
+
+    // stream writes against a block-mode database fail when scanned
+    err = hs_scheduler_scan_stream(sched, 1, corpus.data(), 16, nullptr,
+                                   nullptr);
+    ASSERT_NE(HS_SUCCESS, err);
+
+    err = hs_free_scheduler(sched);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_alloc_scheduler(nullptr, 1, scratch, &sched);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(sched == nullptr);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Scanning several databases together produces the same matches for each
+// database as hs_scan.
+TEST(HyperscanTestBehaviour, BlockMultiDb) {
+    vector<pattern> patterns;
+    patterns.emplace_back("foo[^x]{0,10}bar", 0, 1);
+    patterns.emplace_back("\\bword\\b", HS_FLAG_SOM_LEFTMOST, 2);
+    patterns.emplace_back("^start", 0, 3);
+    patterns.emplace_back("end$", 0, 4);
+    patterns.emplace_back("^end$", HS_FLAG_MULTILINE, 5);
+    hs_database_t *db0 = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db0);
+    hs_database_t *db1 = buildDB("foo.*bar", 0, 6, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db1);
+    hs_database_t *db2 = buildDB("ab b", 0, 7, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db2);
+    const hs_database_t *dbs[] = {db0, db1, db2};
+
+    hs_scratch_t *scratch = nullptr;
+    for (const hs_database_t *db : dbs) {
+        hs_error_t err = hs_alloc_scratch(db, &scratch);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    ASSERT_TRUE(scratch != nullptr);
+
+    const string corpus = makeParallelCorpus(4 << 20);
+
+    CallBackContext expected[3];
+    for (size_t i = 0; i < 3; i++) {
+        hs_error_t err = hs_scan(dbs[i], corpus.data(), corpus.size(), 0,
+                                 scratch, record_cb, &expected[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_FALSE(expected[i].matches.empty());
+        sort(expected[i].matches.begin(), expected[i].matches.end());
+    }
+
+    CallBackContext c[3];
+    void *contexts[] = {&c[0], &c[1], &c[2]};
+    hs_error_t err = hs_scan_multi_db(dbs, 3, corpus.data(), corpus.size(), 0,
+                                      scratch, record_cb, contexts);
+    ASSERT_EQ(HS_SUCCESS, err);
+    for (size_t i = 0; i < 3; i++) {
+        sort(c[i].matches.begin(), c[i].matches.end());
+        EXPECT_EQ(expected[i].matches, c[i].matches);
+    }
+
+    // Terminating one database leaves the others to finish.
+    for (auto &cc : c) {
+        cc.clear();
+    }
+    c[0].halt = true;
+    err = hs_scan_multi_db(dbs, 3, corpus.data(), corpus.size(), 0, scratch,
+                           record_cb, contexts);
+    ASSERT_EQ(HS_SCAN_TERMINATED, err);
+    EXPECT_EQ(1U, c[0].matches.size());
+    sort(c[2].matches.begin(), c[2].matches.end());
+    EXPECT_EQ(expected[2].matches, c[2].matches);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    for (const hs_database_t *db : dbs) {
+        hs_free_database(const_cast<hs_database_t *>(db));
+    }
+}
+
+// A partitioned compile divides a large set between databases which together
+// match as the whole set does.
+TEST(HyperscanTestBehaviour, CompilePartitioned) {
+    vector<string> exprs;
+    vector<unsigned> ids;
+    for (unsigned i = 0; i < 40; i++) {
+        exprs.push_back("lit" + to_string(i % 20) + "[a-f]{2}x" +
+                        to_string(i));
+        ids.push_back(i);
+    }
+    exprs.push_back("[0-9]{3}-[0-9]{4}");
+    ids.push_back(40);
+    exprs.push_back("z[^z]{4}z");
+    ids.push_back(41);
+    vector<const char *> cexprs;
+    for (const auto &e : exprs) {
+        cexprs.push_back(e.c_str());
+    }
+
+    hs_database_t *whole = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_multi(cexprs.data(), nullptr, ids.data(),
+                                      cexprs.size(), HS_MODE_BLOCK, nullptr,
+                                      &whole, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_partition_limits_t limits = {5, 0};
+    hs_database_t *dbs[8];
+    unsigned count = 0;
+    err = hs_compile_ext_multi_partitioned(cexprs.data(), nullptr, ids.data(),
+                                           nullptr, cexprs.size(),
+                                           HS_MODE_BLOCK, nullptr, &limits, 8,
+                                           dbs, &count, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_LT(1U, count);
+
+    string corpus;
+    for (unsigned i = 0; i < 40; i++) {
+        corpus += "lit" + to_string(i % 20) + "cex" + to_string(i) + " ";
+    }
+    corpus += "555-1234 zabcdz";
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(whole, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    for (unsigned i = 0; i < count; i++) {
+        err = hs_alloc_scratch(dbs[i], &scratch);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    CallBackContext expected;
+    err = hs_scan(whole, corpus.data(), corpus.size(), 0, scratch, record_cb,
+                  &expected);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_LE(42U, expected.matches.size());
+
+    CallBackContext c;
+    vector<void *> contexts(count, &c);
+    err = hs_scan_multi_db(dbs, count, corpus.data(), corpus.size(), 0,
+                           scratch, record_cb, contexts.data());
+    ASSERT_EQ(HS_SUCCESS, err);
+    sort(expected.matches.begin(), expected.matches.end());
+    sort(c.matches.begin(), c.matches.end());
+    EXPECT_EQ(expected.matches, c.matches);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    for (unsigned i = 0; i < count; i++) {
+        hs_free_database(dbs[i]);
+    }
+    hs_free_database(whole);
+}
+
+// Errors in a partitioned compile give the index of the bad pattern in the
+// caller's array.
+TEST(HyperscanTestBehaviour, CompilePartitionedError) {
+    const char *exprs[] = {"foo", "bar", "baz(", "qux"};
+    hs_partition_limits_t limits = {1, 0};
+    hs_database_t *dbs[4];
+    unsigned count = 0;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_ext_multi_partitioned(
+        exprs, nullptr, nullptr, nullptr, 4, HS_MODE_BLOCK, nullptr, &limits,
+        4, dbs, &count, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    EXPECT_EQ(2, compile_err->expression);
+    EXPECT_EQ(0U, count);
+    hs_free_compile_error(compile_err);
+}
+
+// Each stream in a batch keeps its own state across batched writes.
+TEST(HyperscanTestBehaviour, StreamBatch) {
+    hs_database_t *db = buildDB("foo.*bar", 0, 1000, HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    const unsigned int count = 3;
+    hs_stream_t *ids[count];
+    CallBackContext c[count];
+    void *ctx[count];
+    for (unsigned int i = 0; i < count; i++) {
+        err = hs_open_stream(db, 0, &ids[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ctx[i] = &c[i];
+    }
+
+    const char *data1[] = {"xxfoo", "bar", "foob"};
+    const unsigned int len1[] = {5, 3, 4};
+    err = hs_scan_stream_batch(ids, data1, len1, count, 0, scratch, record_cb,
+                               ctx);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_TRUE(c[0].matches.empty());
+    EXPECT_TRUE(c[1].matches.empty());
+    EXPECT_TRUE(c[2].matches.empty());
+
+    const char *data2[] = {"xbar", "foo", "ar"};
+    const unsigned int len2[] = {4, 3, 2};
+    err = hs_scan_stream_batch(ids, data2, len2, count, 0, scratch, record_cb,
+                               ctx);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c[0].matches.size());
+    EXPECT_EQ(MatchRecord(9, 1000), c[0].matches[0]);
+    EXPECT_TRUE(c[1].matches.empty());
+    ASSERT_EQ(1U, c[2].matches.size());
+    EXPECT_EQ(MatchRecord(6, 1000), c[2].matches[0]);
+
+    for (unsigned int i = 0; i < count; i++) {
+        err = hs_close_stream(ids[i], scratch, record_cb, ctx[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Only prefilter matches that pass the confirm program are reported.
+TEST(HyperscanTestBehaviour, ConfirmBlock) {
+    hs_database_t *db = buildDB("(\\w+) again \\1", HS_FLAG_CONFIRM, 1,
+                                HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data("foo again bar. baz again baz");
+    CallBackContext c;
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(28, 1), c.matches[0]);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Confirmation can see data from earlier stream writes.
+TEST(HyperscanTestBehaviour, ConfirmStream) {
+    hs_database_t *db = buildDB("(\\w+) again \\1", HS_FLAG_CONFIRM, 1,
+                                HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    const char *data[] = {"baz aga", "in ba", "z foo again bar"};
+    for (const char *d : data) {
+        err = hs_scan_stream(stream, d, strlen(d), 0, scratch, record_cb, &c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    err = hs_close_stream(stream, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(13, 1), c.matches[0]);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// A confirmed expression may not share its match ID.
+TEST(HyperscanTestBehaviour, ConfirmSharedId) {
+    const char *exprs[] = {"(a+)b\\1", "foo"};
+    const unsigned flags[] = {HS_FLAG_CONFIRM, 0};
+    const unsigned ids[] = {1, 1};
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_multi(exprs, flags, ids, 2, HS_MODE_BLOCK,
+                                      nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    EXPECT_EQ(1, compile_err->expression);
+    hs_free_compile_error(compile_err);
+}
+
+// Tuning against a sample changes only how prefilters are built, not the
+// matches that are confirmed.
+TEST(HyperscanTestBehaviour, CompileTuned) {
+    const char *exprs[] = {"(\\w+) again \\1", "foo"};
+    const unsigned flags[] = {HS_FLAG_CONFIRM, 0};
+    const unsigned ids[] = {1, 2};
+    const string corpus("foo again bar. one again two. baz again baz");
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_ext_multi_tuned(
+        exprs, flags, ids, nullptr, 2, HS_MODE_BLOCK, nullptr, corpus.c_str(),
+        corpus.size(), 1000, &db, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data("foo again bar. baz again baz");
+    CallBackContext c;
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.matches.size());
+    EXPECT_EQ(MatchRecord(3, 2), c.matches[0]);
+    EXPECT_EQ(MatchRecord(28, 1), c.matches[1]);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// With many more literals than groups, a literal whose later matches are
+// redundant has its own subgroup squashed; other literals must be unaffected.
+TEST(HyperscanTestBehaviour, ManyLiteralSquashStreaming) {
+    const unsigned N = 200;
+    vector<pattern> patterns;
+    for (unsigned i = 0; i < N; i++) {
+        ostringstream oss;
+        oss << "foo" << 1000 + i << ".*bar" << 1000 + i;
+        patterns.push_back(pattern(oss.str(), HS_FLAG_DOTALL, i));
+    }
+
+    hs_database_t *db = buildDB(patterns, HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Every third pattern sees foo, bar, foo, bar; the others only bar.
+    string data;
+    vector<MatchRecord> expected;
+    for (unsigned i = 0; i < N; i++) {
+        ostringstream oss;
+        if (i % 3 == 0) {
+            oss << " foo" << 1000 + i;
+        }
+        oss << " bar" << 1000 + i;
+        data += oss.str();
+        if (i % 3 == 0) {
+            expected.push_back(MatchRecord(data.size(), i));
+        }
+    }
+    for (unsigned i = 0; i < N; i += 3) {
+        ostringstream oss;
+        oss << " foo" << 1000 + i << " bar" << 1000 + i;
+        data += oss.str();
+        expected.push_back(MatchRecord(data.size(), i));
+    }
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    const size_t chunk = 7;
+    for (size_t i = 0; i < data.size(); i += chunk) {
+        size_t len = min(chunk, data.size() - i);
+        err = hs_scan_stream(stream, data.c_str() + i, len, 0, scratch,
+                             record_cb, &c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    err = hs_close_stream(stream, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    EXPECT_EQ(expected, c.matches);
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// EOD-anchored matches must still be raised on close when the state that
+// leads to them was switched on in an earlier write, and not otherwise.
+TEST(HyperscanTestBehaviour, CloseStreamEodLiveState) {
+    vector<pattern> patterns;
+    patterns.push_back(pattern("foo[^\\n]*bar$", 0, 1));
+    patterns.push_back(pattern("abc[0-9]+x{2,}$", 0, 2));
+
+    hs_database_t *db = buildDB(patterns, HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    struct Case {
+        vector<string> writes;
+        vector<MatchRecord> expected;
+    };
+    const vector<Case> cases = {
+        {{"nothing", " to see"}, {}},
+        {{"foo and", " then bar"}, {MatchRecord(16, 1)}},
+        {{"bar foo"}, {}},
+        {{"abc12", "3xx"}, {MatchRecord(8, 2)}},
+        {{"abc12", "3xx", "y"}, {}},
+    };
+
+    for (const auto &tc : cases) {
+        hs_stream_t *stream = nullptr;
+        err = hs_open_stream(db, 0, &stream);
+        ASSERT_EQ(HS_SUCCESS, err);
+
+        CallBackContext c;
+        for (const auto &w : tc.writes) {
+            err = hs_scan_stream(stream, w.c_str(), w.size(), 0, scratch,
+                                 record_cb, &c);
+            ASSERT_EQ(HS_SUCCESS, err);
+        }
+        err = hs_close_stream(stream, scratch, record_cb, &c);
+        ASSERT_EQ(HS_SUCCESS, err);
+
+        EXPECT_EQ(tc.expected, c.matches);
+    }
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Resetting a stream, or resetting it to an unwritten snapshot, must restore
+// the state of a freshly opened stream however much of it was written.
+TEST(HyperscanTestBehaviour, ResetStreamDirtyState) {
+    vector<pattern> patterns;
+    patterns.push_back(pattern("foo", HS_FLAG_SINGLEMATCH, 1));
+    patterns.push_back(pattern("bar[^\\n]*baz", 0, 2));
+    patterns.push_back(pattern("qux$", 0, 3));
+
+    hs_database_t *db = buildDB(patterns, HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *snapshot = nullptr;
+    err = hs_open_stream(db, 0, &snapshot);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    size_t size = 0;
+    err = hs_stream_size(db, &size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    vector<char> fresh(size), buf(size);
+    size_t fresh_used = 0;
+    err = hs_compress_stream(snapshot, fresh.data(), size, &fresh_used);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data = "foo bar foo qux";
+    const vector<MatchRecord> expected = {MatchRecord(3, 1),
+                                          MatchRecord(15, 3)};
+
+    for (int i = 0; i < 6; i++) {
+        // alternate plain resets and resets from the snapshot, with and
+        // without writes and EOD processing in between
+        CallBackContext c;
+        if (i % 3 != 2) {
+            err = hs_scan_stream(stream, data.c_str(), data.size(), 0,
+                                 scratch, record_cb, &c);
+            ASSERT_EQ(HS_SUCCESS, err);
+        }
+        if (i % 2) {
+            err = hs_reset_and_copy_stream(stream, snapshot, scratch,
+                                           record_cb, &c);
+        } else {
+            err = hs_reset_stream(stream, 0, scratch, record_cb, &c);
+        }
+        ASSERT_EQ(HS_SUCCESS, err);
+
+        if (i % 3 != 2) {
+            EXPECT_EQ(expected, c.matches);
+        } else {
+            EXPECT_TRUE(c.matches.empty());
+        }
+
+        size_t used = 0;
+        err = hs_compress_stream(stream, buf.data(), size, &used);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_EQ(fresh_used, used);
+        EXPECT_EQ(0, memcmp(fresh.data(), buf.data(), used));
+    }
+
+    // teardown
+    err = hs_close_stream(stream, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(snapshot, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// In any-match mode, the first match terminates the scan.
+TEST(HyperscanTestBehaviour, AnyMatchBlock) {
+    vector<pattern> patterns;
+    patterns.push_back(pattern("foo", 0, 1));
+    patterns.push_back(pattern("bar", HS_FLAG_SINGLEMATCH, 2));
+    patterns.push_back(pattern("foo.*bar", HS_FLAG_SOM_LEFTMOST, 3));
+    patterns.push_back(pattern("[0-9]{3}", 0, 4));
+
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK | HS_MODE_ANY_MATCH);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    const string data("xx123 bar foo bar 456 foo");
+    CallBackContext c;
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SCAN_TERMINATED, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(5, 4), c.matches[0]);
+
+    // No callback: the return value alone says whether anything matched.
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SCAN_TERMINATED, err);
+
+    c.clear();
+    const string nomatch("xx12 ba fo");
+    err = hs_scan(db, nomatch.c_str(), nomatch.size(), 0, scratch, record_cb,
+                  &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_TRUE(c.matches.empty());
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(HyperscanTestBehaviour, AnyMatchStreaming) {
+    hs_database_t *db = buildDB("foo.*bar", 0, 1000,
+                                HS_MODE_STREAM | HS_MODE_ANY_MATCH);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    CallBackContext c;
+    err = hs_scan_stream(stream, "xxfoo", 5, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_TRUE(c.matches.empty());
+
+    err = hs_scan_stream(stream, "barbar", 6, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SCAN_TERMINATED, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(8, 1000), c.matches[0]);
+
+    // The stream stays terminated.
+    err = hs_scan_stream(stream, "bar", 3, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SCAN_TERMINATED, err);
+    EXPECT_EQ(1U, c.matches.size());
+
+    err = hs_close_stream(stream, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(1U, c.matches.size());
+
+    // teardown
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+static const char *unorderedPatterns[] = {
+    "foo[^z]*bar",
+    "a[bc]{3,10}d",
+    "xyz",
+    "[0-9]{2}x[a-f]+y",
+    "(abc|def).{4}ghi",
+};
+
+static const char unorderedData[] =
+    "xx12xabcy foo abcbd fooxxbar 99xffy defabcdghi xyz abccccbd foobar 34xay";
+
+static vector<MatchRecord> unorderedScan(unsigned int mode, bool streaming) {
+    vector<pattern> patterns;
+    unsigned int id = 1;
+    for (const char *expr : unorderedPatterns) {
+        patterns.push_back(pattern(expr, 0, id++));
+    }
+
+    hs_database_t *db = buildDB(patterns, mode);
+    EXPECT_NE(nullptr, db);
+    hs_scratch_t *scratch = nullptr;
+    EXPECT_EQ(HS_SUCCESS, hs_alloc_scratch(db, &scratch));
+
+    CallBackContext c;
+    const string data(unorderedData);
+    if (streaming) {
+        hs_stream_t *stream = nullptr;
+        EXPECT_EQ(HS_SUCCESS, hs_open_stream(db, 0, &stream));
+        for (size_t i = 0; i < data.size(); i += 7) {
+            size_t len = min(data.size() - i, size_t{7});
+            EXPECT_EQ(HS_SUCCESS, hs_scan_stream(stream, data.c_str() + i, len,
+                                                 0, scratch, record_cb, &c));
+        }
+        EXPECT_EQ(HS_SUCCESS, hs_close_stream(stream, scratch, record_cb, &c));
+    } else {
+        EXPECT_EQ(HS_SUCCESS, hs_scan(db, data.c_str(), data.size(), 0,
+                                      scratch, record_cb, &c));
+    }
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+    return c.matches;
+}
+
+// Unordered mode delivers the same matches, though perhaps in another order.
+TEST(HyperscanTestBehaviour, UnorderedBlock) {
+    auto ordered = unorderedScan(HS_MODE_BLOCK, false);
+    auto unordered = unorderedScan(HS_MODE_BLOCK | HS_MODE_UNORDERED, false);
+    ASSERT_FALSE(ordered.empty());
+    ASSERT_TRUE(is_sorted(ordered.begin(), ordered.end(),
+                          [](const MatchRecord &a, const MatchRecord &b) {
+                              return a.to < b.to;
+                          }));
+    sort(ordered.begin(), ordered.end());
+    sort(unordered.begin(), unordered.end());
+    EXPECT_EQ(ordered, unordered);
+}
+
+TEST(HyperscanTestBehaviour, UnorderedStreaming) {
+    auto ordered = unorderedScan(HS_MODE_STREAM, true);
+    auto unordered = unorderedScan(HS_MODE_STREAM | HS_MODE_UNORDERED, true);
+    ASSERT_FALSE(ordered.empty());
+    sort(ordered.begin(), ordered.end());
+    sort(unordered.begin(), unordered.end());
+    EXPECT_EQ(ordered, unordered);
+}
+
 class HyperscanLiteralLengthTest : public TestWithParam<size_t> {
 protected:
     virtual void SetUp() {
@@ -1172,6 +2157,68 @@ TEST(HyperscanTestBehaviour, Vectored7) {
     hs_free_database(db);
 }
 
+// Many small segments are coalesced before scanning; check that matches are
+// still exactly those of a block scan over the concatenated data.
+TEST(HyperscanTestBehaviour, VectoredManySegments) {
+    hs_error_t err;
+    vector<pattern> patterns;
+    patterns.push_back(pattern("abc", 0, 1));
+    patterns.push_back(pattern("x[^y]{3}z", 0, 2));
+    patterns.push_back(pattern("foo.*bar$", HS_FLAG_DOTALL, 3));
+
+    hs_database_t *vdb = buildDB(patterns, HS_MODE_VECTORED);
+    ASSERT_NE(nullptr, vdb);
+    hs_database_t *bdb = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, bdb);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(vdb, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_alloc_scratch(bdb, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    string corpus = "foo";
+    for (size_t i = 0; i < 2000; i++) {
+        corpus += (i % 3) ? "..abc" : "xqqqz-";
+    }
+    corpus += "bar";
+
+    // Segment lengths include empty segments, runs of tiny segments longer
+    // than the staging buffer, and segments too big to be coalesced.
+    const unsigned int seg_lens[] = { 1, 0, 2, 1, 7, 300, 1, 50, 3, 1000 };
+    vector<const char *> data;
+    vector<unsigned int> len;
+    size_t pos = 0;
+    for (size_t i = 0; pos < corpus.size(); i++) {
+        unsigned int l = seg_lens[i % (sizeof(seg_lens) / sizeof(seg_lens[0]))];
+        if (i < 1500) {
+            l = min(l, 2U); // long run of tiny segments first
+        }
+        l = min(l, (unsigned int)(corpus.size() - pos));
+        data.push_back(corpus.data() + pos);
+        len.push_back(l);
+        pos += l;
+    }
+
+    CallBackContext vc, bc;
+    err = hs_scan_vector(vdb, data.data(), len.data(), data.size(), 0,
+                         scratch, record_cb, (void *)&vc);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan(bdb, corpus.data(), corpus.size(), 0, scratch, record_cb,
+                  (void *)&bc);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(2001U, bc.matches.size());
+    sort(vc.matches.begin(), vc.matches.end());
+    sort(bc.matches.begin(), bc.matches.end());
+    EXPECT_EQ(bc.matches, vc.matches);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(vdb);
+    hs_free_database(bdb);
+}
+
 TEST(regression, UE_1005) {
     hs_error_t err;
     vector<pattern> patterns;
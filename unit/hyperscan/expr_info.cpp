@@ -175,4 +175,68 @@ static const expected_info ei_test[] = {
 
 INSTANTIATE_TEST_CASE_P(ExprInfo, ExprInfop, ValuesIn(ei_test));
 
+static
+hs_expr_cost_info_t *getCostInfo(const char *pattern, unsigned int mode) {
+    hs_expr_cost_info_t *info = nullptr;
+    hs_compile_error_t *c_err = nullptr;
+    hs_error_t err =
+        hs_expression_cost_info(pattern, 0, nullptr, mode, &info, &c_err);
+    EXPECT_EQ(HS_SUCCESS, err);
+    EXPECT_TRUE(c_err == nullptr);
+    return info;
+}
+
+TEST(ExprCostInfo, PureLiteral) {
+    hs_expr_cost_info_t *info = getCostInfo("foobar", HS_MODE_BLOCK);
+    ASSERT_TRUE(info != nullptr);
+
+    EXPECT_EQ(HS_EXPR_ENGINE_LITERAL, info->engines);
+    EXPECT_EQ(HS_EXPR_COST_LOW, info->cost_class);
+    EXPECT_EQ(0U, info->stream_state_size);
+    ASSERT_EQ(1U, info->literal_count);
+    ASSERT_EQ(6U, info->literal_lengths[0]);
+    EXPECT_EQ(string("foobar"),
+              string(info->literals, info->literal_lengths[0]));
+    free(info);
+}
+
+TEST(ExprCostInfo, LiteralFactor) {
+    hs_expr_cost_info_t *info =
+        getCostInfo("[a-z]+foobar[0-9]", HS_MODE_STREAM);
+    ASSERT_TRUE(info != nullptr);
+
+    EXPECT_TRUE(info->engines & HS_EXPR_ENGINE_LITERAL);
+    EXPECT_EQ(HS_EXPR_COST_LOW, info->cost_class);
+    EXPECT_LT(0U, info->stream_state_size);
+
+    unsigned int total = 0;
+    for (unsigned int i = 0; i < info->literal_count; i++) {
+        EXPECT_LE(4U, info->literal_lengths[i]);
+        total += info->literal_lengths[i];
+    }
+    EXPECT_NE(string::npos,
+              string(info->literals, total).find("foobar"));
+    free(info);
+}
+
+TEST(ExprCostInfo, NoLiteral) {
+    hs_expr_cost_info_t *info = getCostInfo("[a-z][0-9][a-z]", HS_MODE_BLOCK);
+    ASSERT_TRUE(info != nullptr);
+
+    EXPECT_EQ(HS_EXPR_COST_HIGH, info->cost_class);
+    EXPECT_TRUE(info->engines & (HS_EXPR_ENGINE_DFA | HS_EXPR_ENGINE_LIMEX));
+    free(info);
+}
+
+TEST(ExprCostInfo, BadMode) {
+    hs_expr_cost_info_t *info = nullptr;
+    hs_compile_error_t *c_err = nullptr;
+    hs_error_t err = hs_expression_cost_info("foobar", 0, nullptr, 0, &info,
+                                             &c_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(info == nullptr);
+    ASSERT_TRUE(c_err != nullptr);
+    hs_free_compile_error(c_err);
+}
+
 }
@@ -159,3 +159,363 @@ TEST(ExtParam, LargeMinLength) {
     ASSERT_EQ(HS_SUCCESS, err);
     hs_free_database(db);
 }
+
+TEST(ExtParam, MaxMatchesBlock) {
+    hs_expr_ext ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.max_matches = 3;
+    ext.flags = HS_EXT_FLAG_MAX_MATCHES;
+
+    vector<pattern> patterns;
+    patterns.push_back(pattern("foo", 0, 1, ext));
+    patterns.push_back(pattern("ba[rz]", 0, 2));
+    hs_database_t *db = buildDB(patterns, HS_MODE_NOSTREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    CallBackContext c;
+
+    // Only the first three matches of id 1 are reported; id 2 is unlimited.
+    string corpus = "foobarfoobazfoobarfoobazfoo";
+    err = hs_scan(db, corpus.c_str(), corpus.length(), 0, scratch, record_cb,
+                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(7U, c.matches.size());
+    EXPECT_EQ(MatchRecord(3, 1), c.matches[0]);
+    EXPECT_EQ(MatchRecord(9, 1), c.matches[2]);
+    EXPECT_EQ(MatchRecord(15, 1), c.matches[4]);
+    EXPECT_EQ(MatchRecord(24, 2), c.matches[6]);
+
+    // The limit applies to each scan separately.
+    c.clear();
+    err = hs_scan(db, corpus.c_str(), corpus.length(), 0, scratch, record_cb,
+                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(7U, c.matches.size());
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(ExtParam, MaxMatchesStreaming) {
+    hs_expr_ext ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.max_matches = 2;
+    ext.flags = HS_EXT_FLAG_MAX_MATCHES;
+
+    pattern p("foo.*bar", 0, 0, ext);
+    hs_database_t *db = buildDB(p, HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    // The limit applies over the lifetime of the stream.
+    CallBackContext c;
+    err = hs_scan_stream(stream, "foobar", 6, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(1U, c.matches.size());
+    err = hs_scan_stream(stream, "barbar", 6, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.matches.size());
+    EXPECT_EQ(MatchRecord(6, 0), c.matches[0]);
+    EXPECT_EQ(MatchRecord(9, 0), c.matches[1]);
+
+    // Resetting the stream resets the count.
+    err = hs_reset_stream(stream, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    c.clear();
+    err = hs_scan_stream(stream, "foobarbar", 9, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(2U, c.matches.size());
+
+    err = hs_close_stream(stream, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(2U, c.matches.size());
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(ExtParam, MaxMatchesInvalid) {
+    hs_expr_ext ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.flags = HS_EXT_FLAG_MAX_MATCHES;
+
+    const char *expr = "foobar";
+    const hs_expr_ext *exts[] = {&ext};
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+
+    // Zero is not a valid limit.
+    hs_error_t err = hs_compile_ext_multi(&expr, nullptr, nullptr, exts, 1,
+                                          HS_MODE_BLOCK, nullptr, &db,
+                                          &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+
+    // Neither is anything that doesn't fit in 32 bits.
+    ext.max_matches = 1ULL << 32;
+    err = hs_compile_ext_multi(&expr, nullptr, nullptr, exts, 1,
+                               HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+}
+
+static
+size_t countMatches(const hs_database_t *db, hs_scratch_t *scratch,
+                    const string &corpus) {
+    CallBackContext c;
+    hs_error_t err = hs_scan(db, corpus.c_str(), corpus.length(), 0, scratch,
+                             record_cb, (void *)&c);
+    EXPECT_EQ(HS_SUCCESS, err);
+    return c.matches.size();
+}
+
+TEST(ExtParam, EditDistance) {
+    hs_expr_ext ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.edit_distance = 1;
+    ext.flags = HS_EXT_FLAG_EDIT_DISTANCE;
+
+    pattern p("foobar", 0, 0, ext);
+    hs_database_t *db = buildDB(p, HS_MODE_NOSTREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    EXPECT_NE(0U, countMatches(db, scratch, "__foobar__"));
+    EXPECT_NE(0U, countMatches(db, scratch, "__foxbar__")); // substitution
+    EXPECT_NE(0U, countMatches(db, scratch, "__fobar__"));  // deletion
+    EXPECT_NE(0U, countMatches(db, scratch, "__fooxbar__")); // insertion
+    EXPECT_EQ(0U, countMatches(db, scratch, "__fxxbar__"));
+    EXPECT_EQ(0U, countMatches(db, scratch, "__bazqux__"));
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(ExtParam, EditDistanceAnchored) {
+    hs_expr_ext ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.edit_distance = 1;
+    ext.flags = HS_EXT_FLAG_EDIT_DISTANCE;
+
+    pattern p("^foobar$", 0, 0, ext);
+    hs_database_t *db = buildDB(p, HS_MODE_NOSTREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    EXPECT_NE(0U, countMatches(db, scratch, "foobar"));
+    EXPECT_NE(0U, countMatches(db, scratch, "xfoobar"));
+    EXPECT_NE(0U, countMatches(db, scratch, "foobarx"));
+    EXPECT_NE(0U, countMatches(db, scratch, "oobar"));
+    EXPECT_EQ(0U, countMatches(db, scratch, "xxfoobar"));
+    EXPECT_EQ(0U, countMatches(db, scratch, "foobarxx"));
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(ExtParam, HammingDistance) {
+    hs_expr_ext ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.hamming_distance = 1;
+    ext.flags = HS_EXT_FLAG_HAMMING_DISTANCE;
+
+    pattern p("foobar", 0, 0, ext);
+    hs_database_t *db = buildDB(p, HS_MODE_NOSTREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(scratch != nullptr);
+
+    EXPECT_NE(0U, countMatches(db, scratch, "__foobar__"));
+    EXPECT_NE(0U, countMatches(db, scratch, "__foxbar__"));
+    EXPECT_EQ(0U, countMatches(db, scratch, "__fobar__"));
+    EXPECT_EQ(0U, countMatches(db, scratch, "__fooxbar__"));
+    EXPECT_EQ(0U, countMatches(db, scratch, "__fxxbar__"));
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(ExtParam, ApproxMatchingInvalid) {
+    hs_expr_ext ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.edit_distance = 1;
+    ext.hamming_distance = 1;
+    ext.flags = HS_EXT_FLAG_EDIT_DISTANCE | HS_EXT_FLAG_HAMMING_DISTANCE;
+
+    const char *expr = "foobar";
+    const hs_expr_ext *exts[] = {&ext};
+    unsigned flags = 0;
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+
+    // Only one kind of distance at a time.
+    hs_error_t err = hs_compile_ext_multi(&expr, &flags, nullptr, exts, 1,
+                                          HS_MODE_BLOCK, nullptr, &db,
+                                          &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+
+    // Too large a distance.
+    ext.flags = HS_EXT_FLAG_EDIT_DISTANCE;
+    ext.edit_distance = 17;
+    expr = "foobarbazquxquuxcorgegraultgarply";
+    err = hs_compile_ext_multi(&expr, &flags, nullptr, exts, 1,
+                               HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+
+    // A pattern that every position would match.
+    ext.edit_distance = 2;
+    expr = "ab";
+    err = hs_compile_ext_multi(&expr, &flags, nullptr, exts, 1,
+                               HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+
+    // Zero-width assertions.
+    expr = "\\bfoobar";
+    err = hs_compile_ext_multi(&expr, &flags, nullptr, exts, 1,
+                               HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+
+    // UTF-8 mode.
+    expr = "foobar";
+    flags = HS_FLAG_UTF8;
+    err = hs_compile_ext_multi(&expr, &flags, nullptr, exts, 1,
+                               HS_MODE_BLOCK, nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+}
+
+namespace {
+struct UserDataContext {
+    hs_scratch_t *scratch;
+    vector<pair<unsigned int, unsigned long long>> seen;
+};
+}
+
+static
+int record_user_data(unsigned int id, unsigned long long, unsigned long long,
+                     unsigned int, void *ctxt) {
+    UserDataContext *c = (UserDataContext *)ctxt;
+    unsigned long long user_data = ~0ULL;
+    hs_error_t err = hs_get_match_user_data(c->scratch, &user_data);
+    EXPECT_EQ(HS_SUCCESS, err);
+    c->seen.emplace_back(id, user_data);
+    return 0;
+}
+
+TEST(ExtParam, UserData) {
+    // Both a dense and a sparse set of IDs.
+    for (unsigned int big_id : {3U, 1000000U}) {
+        const char *exprs[] = {"foo", "bar", "baz"};
+        unsigned int flags[] = {0, 0, 0};
+        unsigned int ids[] = {1, 2, big_id};
+        hs_expr_ext ext[3];
+        memset(ext, 0, sizeof(ext));
+        ext[0].flags = HS_EXT_FLAG_USER_DATA;
+        ext[0].user_data = 0x1234567890abcdefULL;
+        ext[2].flags = HS_EXT_FLAG_USER_DATA;
+        ext[2].user_data = 42;
+        const hs_expr_ext *exts[] = {&ext[0], &ext[1], &ext[2]};
+
+        hs_database_t *db = nullptr;
+        hs_compile_error_t *compile_err = nullptr;
+        hs_error_t err = hs_compile_ext_multi(exprs, flags, ids, exts, 3,
+                                              HS_MODE_BLOCK, nullptr, &db,
+                                              &compile_err);
+        ASSERT_EQ(HS_SUCCESS, err);
+
+        hs_scratch_t *scratch = nullptr;
+        err = hs_alloc_scratch(db, &scratch);
+        ASSERT_EQ(HS_SUCCESS, err);
+
+        UserDataContext c;
+        c.scratch = scratch;
+        const string data = "foo bar baz";
+        err = hs_scan(db, data.c_str(), data.size(), 0, scratch,
+                      record_user_data, &c);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_EQ(3U, c.seen.size());
+        EXPECT_EQ(make_pair(1U, 0x1234567890abcdefULL), c.seen[0]);
+        EXPECT_EQ(make_pair(2U, 0ULL), c.seen[1]);
+        EXPECT_EQ(make_pair(big_id, 42ULL), c.seen[2]);
+
+        // Not available outside a callback.
+        unsigned long long user_data = 0;
+        err = hs_get_match_user_data(scratch, &user_data);
+        EXPECT_EQ(HS_DATA_UNAVAILABLE, err);
+
+        err = hs_free_scratch(scratch);
+        ASSERT_EQ(HS_SUCCESS, err);
+        hs_free_database(db);
+    }
+}
+
+TEST(ExtParam, UserDataSharedId) {
+    const char *exprs[] = {"foo", "bar"};
+    unsigned int flags[] = {0, 0};
+    unsigned int ids[] = {7, 7};
+    hs_expr_ext ext[2];
+    memset(ext, 0, sizeof(ext));
+    ext[0].flags = HS_EXT_FLAG_USER_DATA;
+    ext[0].user_data = 1;
+    ext[1].flags = HS_EXT_FLAG_USER_DATA;
+    ext[1].user_data = 2;
+    const hs_expr_ext *exts[] = {&ext[0], &ext[1]};
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_ext_multi(exprs, flags, ids, exts, 2,
+                                          HS_MODE_BLOCK, nullptr, &db,
+                                          &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(compile_err != nullptr);
+    EXPECT_EQ(1, compile_err->expression);
+    hs_free_compile_error(compile_err);
+
+    // The same value may be shared.
+    ext[1].user_data = 1;
+    err = hs_compile_ext_multi(exprs, flags, ids, exts, 2, HS_MODE_BLOCK,
+                               nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
@@ -32,6 +32,9 @@
 #include "test_util.h"
 #include "hs.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace {
 
 struct PatternInfo {
@@ -185,10 +188,52 @@ static const PatternInfo patterns[] = {
     { "eod\\z", 0, "eod", 3 },
     { "eod\\z", HS_FLAG_SINGLEMATCH, "eod", 3 },
     { "eod\\z", HS_FLAG_SOM_LEFTMOST, "eod", 3 },
+    { "foo[^\\n]{5,}bar", 0, "foo12345bar", 11 },
+    { "a\\d{20,30}b", 0, "a01234567890123456789012345b", 28 },
+    { "^(ab|cd)+ef$", HS_FLAG_MULTILINE, "abcdef", 6 },
 };
 
 INSTANTIATE_TEST_CASE_P(Identical, IdenticalTest, testing::ValuesIn(patterns));
 
+// Repeats of an expression share a parse only when their flags and extended
+// parameters agree as well.
+TEST(Identical, RepeatsWithDifferentFlags) {
+    hs_expr_ext ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.flags = HS_EXT_FLAG_MIN_OFFSET;
+    ext.min_offset = 10;
+
+    std::vector<pattern> patterns;
+    patterns.push_back(pattern("foo.*bar", 0, 0));
+    patterns.push_back(pattern("foo.*bar", HS_FLAG_CASELESS, 1));
+    patterns.push_back(pattern("foo.*bar", 0, 2));
+    patterns.push_back(pattern("foo.*bar", 0, 3, ext));
+    patterns.push_back(pattern("foo.*bar", HS_FLAG_CASELESS, 4));
+
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, scratch);
+
+    const std::string corpus = "FOOBAR foobar";
+    CallBackContext cb;
+    err = hs_scan(db, corpus.c_str(), corpus.size(), 0, scratch, record_cb,
+                  &cb);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+
+    std::vector<MatchRecord> expected = {
+        {6, 1}, {6, 4}, {13, 0}, {13, 1}, {13, 2}, {13, 3}, {13, 4}};
+    std::sort(cb.matches.begin(), cb.matches.end());
+    ASSERT_EQ(expected, cb.matches);
+}
+
 // teach google-test how to print a param
 void PrintTo(const PatternInfo &p, ::std::ostream *os) {
     *os << p.expr << ":" << p.flags << ", " << p.corpus;
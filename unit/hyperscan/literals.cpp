@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "hs.h"
+#include "test_util.h"
+
+using namespace std;
+
+namespace {
+
+hs_database_t *buildLitDB(const vector<string> &lits,
+                          const vector<unsigned> &flags,
+                          const vector<unsigned> &ids, unsigned mode) {
+    vector<const char *> ptrs;
+    vector<size_t> lens;
+    for (const auto &lit : lits) {
+        ptrs.push_back(lit.data());
+        lens.push_back(lit.size());
+    }
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_lit_multi(ptrs.data(), flags.data(),
+                                          ids.data(), lens.data(),
+                                          lits.size(), mode, nullptr, &db,
+                                          &compile_err);
+    if (err != HS_SUCCESS) {
+        EXPECT_TRUE(compile_err != nullptr);
+        hs_free_compile_error(compile_err);
+        return nullptr;
+    }
+    return db;
+}
+
+void scanBlock(const hs_database_t *db, const string &data,
+               CallBackContext &c) {
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_scan(db, data.data(), data.size(), 0, scratch, record_cb,
+                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_free_scratch(scratch);
+}
+
+} // namespace
+
+TEST(LiteralApi, SingleLiteral) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    const string lit = "a.b*c";
+    hs_error_t err = hs_compile_lit(lit.data(), 0, lit.size(), HS_MODE_BLOCK,
+                                    nullptr, &db, &compile_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+
+    // Regex meta-characters are matched as themselves.
+    CallBackContext c;
+    scanBlock(db, "aXbbc a.b*c axbc", c);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(11, 0), c.matches[0]);
+
+    hs_free_database(db);
+}
+
+TEST(LiteralApi, EmbeddedNul) {
+    const vector<string> lits = {string("ab\0cd", 5), string("\0\0\0", 3)};
+    hs_database_t *db = buildLitDB(lits, {0, 0}, {1, 2}, HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr);
+
+    CallBackContext c;
+    const string data("xxab\0cd\0\0\0yab", 13);
+    scanBlock(db, data, c);
+    ASSERT_EQ(2U, c.matches.size());
+    ASSERT_EQ(MatchRecord(7, 1), c.matches[0]);
+    ASSERT_EQ(MatchRecord(10, 2), c.matches[1]);
+
+    hs_free_database(db);
+}
+
+TEST(LiteralApi, Caseless) {
+    const vector<string> lits = {"foobar", "FooBar"};
+    hs_database_t *db = buildLitDB(lits, {HS_FLAG_CASELESS, 0}, {1, 2},
+                                   HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr);
+
+    CallBackContext c;
+    scanBlock(db, "FOOBAR FooBar", c);
+    ASSERT_EQ(3U, c.matches.size());
+    ASSERT_EQ(MatchRecord(6, 1), c.matches[0]);
+    auto end = c.matches.end();
+    ASSERT_NE(end, find(c.matches.begin(), end, MatchRecord(13, 1)));
+    ASSERT_NE(end, find(c.matches.begin(), end, MatchRecord(13, 2)));
+
+    hs_free_database(db);
+}
+
+TEST(LiteralApi, SingleMatch) {
+    const vector<string> lits = {"abc", "z"};
+    hs_database_t *db = buildLitDB(lits,
+                                   {HS_FLAG_SINGLEMATCH, HS_FLAG_SINGLEMATCH},
+                                   {1, 2}, HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr);
+
+    CallBackContext c;
+    scanBlock(db, "abczabczabcz", c);
+    ASSERT_EQ(2U, c.matches.size());
+    ASSERT_EQ(MatchRecord(3, 1), c.matches[0]);
+    ASSERT_EQ(MatchRecord(4, 2), c.matches[1]);
+
+    hs_free_database(db);
+}
+
+TEST(LiteralApi, Streaming) {
+    const vector<string> lits = {"hello world", "wor"};
+    hs_database_t *db = buildLitDB(lits, {0, 0}, {1, 2}, HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    const string data = "xxhello world";
+    for (char ch : data) {
+        err = hs_scan_stream(stream, &ch, 1, 0, scratch, record_cb,
+                             (void *)&c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(2U, c.matches.size());
+    ASSERT_EQ(MatchRecord(11, 2), c.matches[0]);
+    ASSERT_EQ(MatchRecord(13, 1), c.matches[1]);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+TEST(LiteralApi, BadFlags) {
+    const vector<string> lits = {"abc", "def"};
+    hs_database_t *db = buildLitDB(lits, {0, HS_FLAG_DOTALL}, {1, 2},
+                                   HS_MODE_BLOCK);
+    ASSERT_TRUE(db == nullptr);
+
+    db = buildLitDB(lits, {HS_FLAG_UTF8, 0}, {1, 2}, HS_MODE_BLOCK);
+    ASSERT_TRUE(db == nullptr);
+}
+
+TEST(LiteralApi, EmptyLiteral) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    const char *lits[] = {"abc", "def"};
+    const size_t lens[] = {3, 0};
+    hs_error_t err = hs_compile_lit_multi(lits, nullptr, nullptr, lens, 2,
+                                          HS_MODE_BLOCK, nullptr, &db,
+                                          &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(db == nullptr);
+    ASSERT_TRUE(compile_err != nullptr);
+    ASSERT_EQ(1, compile_err->expression);
+    hs_free_compile_error(compile_err);
+}
+
+TEST(LiteralApi, NullLens) {
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    const char *lits[] = {"abc"};
+    hs_error_t err = hs_compile_lit_multi(lits, nullptr, nullptr, nullptr, 1,
+                                          HS_MODE_BLOCK, nullptr, &db,
+                                          &compile_err);
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(db == nullptr);
+    ASSERT_TRUE(compile_err != nullptr);
+    hs_free_compile_error(compile_err);
+}
+
+namespace {
+
+struct DecoratedLiteral {
+    const char *expr;
+    unsigned flags;
+    unsigned long long min_offset;
+    unsigned long long max_offset;
+    const char *corpus;
+    vector<unsigned long long> matches;
+};
+
+class DecoratedLiteralTest : public testing::TestWithParam<DecoratedLiteral> {
+protected:
+    hs_database_t *build(unsigned mode) {
+        const DecoratedLiteral &info = GetParam();
+        hs_expr_ext ext;
+        memset(&ext, 0, sizeof(ext));
+        if (info.min_offset) {
+            ext.flags |= HS_EXT_FLAG_MIN_OFFSET;
+            ext.min_offset = info.min_offset;
+        }
+        if (info.max_offset) {
+            ext.flags |= HS_EXT_FLAG_MAX_OFFSET;
+            ext.max_offset = info.max_offset;
+        }
+        return buildDB(pattern(info.expr, info.flags, 0, ext), mode);
+    }
+
+    void check(const CallBackContext &c) {
+        vector<unsigned long long> ends;
+        for (const auto &m : c.matches) {
+            ends.push_back(m.to);
+        }
+        EXPECT_EQ(GetParam().matches, ends);
+    }
+};
+
+} // namespace
+
+TEST_P(DecoratedLiteralTest, Block) {
+    hs_database_t *db = build(HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr);
+
+    CallBackContext c;
+    scanBlock(db, GetParam().corpus, c);
+    check(c);
+
+    hs_free_database(db);
+}
+
+TEST_P(DecoratedLiteralTest, Streaming) {
+    hs_database_t *db = build(HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // One byte per write, so that every match crosses a stream boundary.
+    CallBackContext c;
+    const string data = GetParam().corpus;
+    for (const char &ch : data) {
+        err = hs_scan_stream(stream, &ch, 1, 0, scratch, record_cb, &c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    err = hs_close_stream(stream, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    check(c);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+static const DecoratedLiteral decoratedLiterals[] = {
+    {"^foo", 0, 0, 0, "foofoo", {3}},
+    {"\\Afoo", HS_FLAG_CASELESS, 0, 0, "FOOfoo", {3}},
+    {"foo$", 0, 0, 0, "foo foo\n", {7}},
+    {"foo$", 0, 0, 0, "foo foo", {7}},
+    {"foo\\z", 0, 0, 0, "foo foo\n", {}},
+    {"foo\\z", 0, 0, 0, "foo foo", {7}},
+    {"^foo$", 0, 0, 0, "foo\n", {3}},
+    {"^foo$", 0, 0, 0, "foofoo", {}},
+    {"[Aa]bc", 0, 0, 0, "abc Abc ABC aBC", {3, 7}},
+    {"[ab]cd", 0, 0, 0, "acd bcd ccd", {3, 7}},
+    {"x[ab][cd]", HS_FLAG_CASELESS, 0, 0, "xac XBD xbe", {3, 7}},
+    {"foo", 0, 5, 0, "foo foo", {7}},
+    {"foo", 0, 0, 5, "foo foo", {3}},
+    {"^foo", 0, 3, 3, "foofoo", {3}},
+    {"foo$", 0, 0, 7, "xxxxfoo\n", {7}},
+    {"foo$", 0, 8, 0, "xxxxfoo\n", {}},
+};
+
+INSTANTIATE_TEST_CASE_P(LiteralApi, DecoratedLiteralTest,
+                        testing::ValuesIn(decoratedLiterals));
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "hs.h"
+#include "test_util.h"
+
+using namespace std;
+
+namespace {
+
+void scanBlock(const hs_database_t *db, const string &data,
+               CallBackContext &c) {
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_scan(db, data.data(), data.size(), 0, scratch, record_cb,
+                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_free_scratch(scratch);
+}
+
+void scanStream(const hs_database_t *db, const vector<string> &writes,
+                CallBackContext &c) {
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    for (const auto &data : writes) {
+        err = hs_scan_stream(stream, data.data(), data.size(), 0, scratch,
+                             record_cb, (void *)&c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_free_scratch(scratch);
+}
+
+string compileError(const vector<pattern> &patterns) {
+    vector<const char *> expressions;
+    vector<unsigned> flags;
+    vector<unsigned> ids;
+    for (const auto &p : patterns) {
+        expressions.push_back(p.expression.c_str());
+        flags.push_back(p.flags);
+        ids.push_back(p.id);
+    }
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_multi(expressions.data(), flags.data(),
+                                      ids.data(), patterns.size(),
+                                      HS_MODE_BLOCK, nullptr, &db,
+                                      &compile_err);
+    EXPECT_EQ(HS_COMPILER_ERROR, err);
+    EXPECT_TRUE(db == nullptr);
+    if (!compile_err) {
+        return string();
+    }
+    string msg = compile_err->message;
+    hs_free_compile_error(compile_err);
+    return msg;
+}
+
+} // namespace
+
+TEST(LogicalCombination, AndOfQuietPatterns) {
+    vector<pattern> patterns = {
+        pattern("abc", HS_FLAG_QUIET, 101),
+        pattern("def", HS_FLAG_QUIET, 102),
+        pattern("xyz", 0, 103),
+        pattern("101 & 102", HS_FLAG_COMBINATION, 1001),
+    };
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr);
+
+    // Sub-patterns are silent; the combination is raised once, at the
+    // offset where it first became true.
+    CallBackContext c;
+    scanBlock(db, "abc xyz def abc def", c);
+    ASSERT_EQ(2U, c.matches.size());
+    ASSERT_EQ(MatchRecord(7, 103), c.matches[0]);
+    ASSERT_EQ(MatchRecord(11, 1001), c.matches[1]);
+
+    c.clear();
+    scanBlock(db, "abc abc", c);
+    ASSERT_EQ(0U, c.matches.size());
+
+    hs_free_database(db);
+}
+
+TEST(LogicalCombination, OrPrecedence) {
+    vector<pattern> patterns = {
+        pattern("aaa", HS_FLAG_QUIET, 1),
+        pattern("bbb", HS_FLAG_QUIET, 2),
+        pattern("ccc", HS_FLAG_QUIET, 3),
+        pattern("1 | 2 & 3", HS_FLAG_COMBINATION, 10),
+        pattern("(1 | 2) & 3", HS_FLAG_COMBINATION, 11),
+    };
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr);
+
+    CallBackContext c;
+    scanBlock(db, "aaa", c);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(3, 10), c.matches[0]);
+
+    c.clear();
+    scanBlock(db, "bbb ccc", c);
+    ASSERT_EQ(2U, c.matches.size());
+    ASSERT_EQ(MatchRecord(7, 10), c.matches[0]);
+    ASSERT_EQ(MatchRecord(7, 11), c.matches[1]);
+
+    hs_free_database(db);
+}
+
+TEST(LogicalCombination, NegationAtEod) {
+    vector<pattern> patterns = {
+        pattern("abc", HS_FLAG_QUIET, 1),
+        pattern("def", 0, 2),
+        pattern("2 & !1", HS_FLAG_COMBINATION, 10),
+    };
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr);
+
+    // True as soon as 2 matches.
+    CallBackContext c;
+    scanBlock(db, "xxdefxx", c);
+    ASSERT_EQ(2U, c.matches.size());
+    ASSERT_EQ(MatchRecord(5, 2), c.matches[0]);
+    ASSERT_EQ(MatchRecord(5, 10), c.matches[1]);
+
+    // False once 1 has matched first.
+    c.clear();
+    scanBlock(db, "abcdef", c);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(6, 2), c.matches[0]);
+
+    hs_free_database(db);
+}
+
+TEST(LogicalCombination, VacuousNegation) {
+    vector<pattern> patterns = {
+        pattern("abc", HS_FLAG_QUIET, 1),
+        pattern("!1", HS_FLAG_COMBINATION, 10),
+    };
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr);
+
+    // Never evaluated during the scan, so reported at end of data.
+    CallBackContext c;
+    scanBlock(db, "xyz", c);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(3, 10), c.matches[0]);
+
+    c.clear();
+    scanBlock(db, "", c);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(0, 10), c.matches[0]);
+
+    c.clear();
+    scanBlock(db, "xabcx", c);
+    ASSERT_EQ(0U, c.matches.size());
+
+    hs_free_database(db);
+}
+
+TEST(LogicalCombination, Streaming) {
+    vector<pattern> patterns = {
+        pattern("foo", HS_FLAG_QUIET, 1),
+        pattern("bar", HS_FLAG_QUIET, 2),
+        pattern("1 & 2", HS_FLAG_COMBINATION, 10),
+        pattern("!2", HS_FLAG_COMBINATION, 11),
+    };
+    hs_database_t *db = buildDB(patterns, HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr);
+
+    // Sub-pattern state is carried across writes.
+    CallBackContext c;
+    scanStream(db, {"xxfo", "oxx", "xba", "rxx"}, c);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(11, 10), c.matches[0]);
+
+    c.clear();
+    scanStream(db, {"foo", "xx"}, c);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(5, 11), c.matches[0]);
+
+    hs_free_database(db);
+}
+
+TEST(LogicalCombination, SyntaxErrors) {
+    const char *bad[] = {"", "1 &", "(1 | 2", "1 2", "& 1", "1 | x", "()",
+                         "1 ! 2"};
+    for (const char *logical : bad) {
+        SCOPED_TRACE(logical);
+        vector<pattern> patterns = {
+            pattern("abc", 0, 1),
+            pattern("def", 0, 2),
+            pattern(logical, HS_FLAG_COMBINATION, 10),
+        };
+        string msg = compileError(patterns);
+        ASSERT_EQ(0U, msg.find("Logical combination syntax error"));
+    }
+}
+
+TEST(LogicalCombination, UnknownId) {
+    vector<pattern> patterns = {
+        pattern("abc", 0, 1),
+        pattern("1 & 7", HS_FLAG_COMBINATION, 10),
+    };
+    ASSERT_EQ("Logical combination refers to unknown pattern ID 7.",
+              compileError(patterns));
+}
+
+TEST(LogicalCombination, BadFlags) {
+    vector<pattern> patterns = {
+        pattern("abc", 0, 1),
+        pattern("1", HS_FLAG_COMBINATION | HS_FLAG_CASELESS, 10),
+    };
+    ASSERT_EQ("Only HS_FLAG_SINGLEMATCH is supported in combination with "
+              "HS_FLAG_COMBINATION.", compileError(patterns));
+}
+
+TEST(LogicalCombination, InconsistentQuiet) {
+    vector<pattern> patterns = {
+        pattern("abc", HS_FLAG_QUIET, 1),
+        pattern("def", 0, 1),
+    };
+    string msg = compileError(patterns);
+    ASSERT_NE(string::npos, msg.find("HS_FLAG_QUIET"));
+}
@@ -333,3 +333,36 @@ TEST(MPV, UE_2395) {
     err = hs_free_scratch(scratch);
     ASSERT_EQ(HS_SUCCESS, err);
 }
+
+// Anchored literals that are folded into the floating table must still only
+// match at their anchored offsets.
+TEST(MMRose, AnchoredAndFloating) {
+    vector<pattern> patterns;
+    patterns.push_back(pattern("^abcd", 0, 1));
+    patterns.push_back(pattern("^.{2,3}efgh", HS_FLAG_DOTALL, 2));
+    patterns.push_back(pattern("xyz", 0, 3));
+
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data = "abcdxyzefghabcdxyz..efghabcd" + string(100, '.') +
+                        "abcdefgh";
+
+    CallBackContext c;
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb,
+                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(3U, c.matches.size());
+    EXPECT_EQ(MatchRecord(4, 1), c.matches[0]);
+    EXPECT_EQ(MatchRecord(7, 3), c.matches[1]);
+    EXPECT_EQ(MatchRecord(18, 3), c.matches[2]);
+
+    hs_free_database(db);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+}
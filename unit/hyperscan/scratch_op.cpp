@@ -29,6 +29,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <vector>
 
@@ -291,4 +292,696 @@ TEST(scratch, damagedScratch) {
     hs_free_database(db);
 }
 
+TEST(scratch, compatible) {
+    hs_database_t *db1 = buildDB("foobar", 0, 0, HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db1);
+    hs_database_t *db2 =
+        buildDB("(a.?b.?c.?d.?e.?f.?g)|(hatstand(..)+teakettle)", 0, 0,
+                HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db2);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db1, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_compatible(db1, scratch));
+    ASSERT_EQ(HS_INSUFFICIENT_SPACE, hs_scratch_compatible(db2, scratch));
+    ASSERT_EQ(HS_INVALID, hs_scratch_compatible(nullptr, scratch));
+    ASSERT_EQ(HS_INVALID, hs_scratch_compatible(db1, nullptr));
+
+    err = hs_alloc_scratch(db2, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_compatible(db1, scratch));
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_compatible(db2, scratch));
+
+    // No reallocation when the scratch already fits.
+    hs_scratch_t *before = scratch;
+    err = hs_alloc_scratch(db1, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(before, scratch);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db1);
+    hs_free_database(db2);
+}
+
+TEST(scratch, reserveGrowsInPlace) {
+    hs_database_t *db1 = buildDB("foobar", 0, 0, HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db1);
+    hs_database_t *db2 =
+        buildDB("(a.?b.?c.?d.?e.?f.?g)|(hatstand(..)+teakettle)", 0, 0,
+                HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db2);
+
+    // Find out how big a scratch for db2 needs to be.
+    hs_scratch_t *big = nullptr;
+    hs_error_t err = hs_alloc_scratch(db2, &big);
+    ASSERT_EQ(HS_SUCCESS, err);
+    size_t big_size = 0;
+    err = hs_scratch_size(big, &big_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_scratch(big);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db1, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_reserve_scratch(2 * big_size, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    size_t size = 0;
+    err = hs_scratch_size(scratch, &size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_LE(2 * big_size, size);
+
+    // The reserved size survives cloning.
+    hs_scratch_t *clone = nullptr;
+    err = hs_clone_scratch(scratch, &clone);
+    ASSERT_EQ(HS_SUCCESS, err);
+    size_t clone_size = 0;
+    err = hs_scratch_size(clone, &clone_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(size, clone_size);
+    hs_free_scratch(clone);
+
+    ASSERT_EQ(HS_INSUFFICIENT_SPACE, hs_scratch_compatible(db2, scratch));
+    hs_scratch_t *before = scratch;
+    err = hs_alloc_scratch(db2, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(before, scratch);
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_compatible(db2, scratch));
+
+    CallBackContext c;
+    const string data("hatstand__teakettle");
+    err = hs_scan(db2, data.c_str(), data.size(), 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    err = hs_scan(db1, "foobar", 6, 0, scratch, dummy_cb, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db1);
+    hs_free_database(db2);
+}
+
+TEST(scratch, poolReuse) {
+    hs_database_t *db = buildDB("foobar", 0, 0, HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_pool_t *pool = nullptr;
+    hs_error_t err = hs_alloc_scratch_pool(db, 2, &pool);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, pool);
+
+    hs_scratch_t *s1 = nullptr;
+    hs_scratch_t *s2 = nullptr;
+    err = hs_scratch_pool_get(pool, &s1);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scratch_pool_get(pool, &s2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(s1, s2);
+
+    CallBackContext c;
+    err = hs_scan(db, "xfoobarx", 8, 0, s1, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+
+    // A returned scratch is handed out again.
+    err = hs_scratch_pool_put(pool, s1);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_scratch_t *s3 = nullptr;
+    err = hs_scratch_pool_get(pool, &s3);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(s1, s3);
+
+    err = hs_scratch_pool_put(pool, s2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scratch_pool_put(pool, s3);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_free_scratch_pool(pool);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(scratch, poolUpdate) {
+    hs_database_t *db1 = buildDB("foobar", 0, 0, HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db1);
+    hs_database_t *db2 =
+        buildDB("(a.?b.?c.?d.?e.?f.?g)|(hatstand(..)+teakettle)", 0, 0,
+                HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db2);
+
+    hs_scratch_pool_t *pool = nullptr;
+    hs_error_t err = hs_alloc_scratch_pool(db1, 0, &pool);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_scratch_t *old_scratch = nullptr;
+    err = hs_scratch_pool_get(pool, &old_scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_scratch_t *idle = nullptr;
+    err = hs_scratch_pool_get(pool, &idle);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scratch_pool_put(pool, idle);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_scratch_pool_update(pool, db2);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Scratch taken before the update still works with the old database.
+    err = hs_scan(db1, "foobar", 6, 0, old_scratch, dummy_cb, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scratch_pool_put(pool, old_scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Scratch taken after the update is suitable for the new database.
+    hs_scratch_t *scratch = nullptr;
+    err = hs_scratch_pool_get(pool, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    CallBackContext c;
+    const string data("hatstand__teakettle");
+    err = hs_scan(db2, data.c_str(), data.size(), 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    err = hs_scratch_pool_put(pool, scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_free_scratch_pool(pool);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db1);
+    hs_free_database(db2);
+}
+
+static int db_frees;
+
+static void count_db_free(void *p) {
+    db_frees++;
+    free(p);
+}
+
+TEST(scratch, dbHandleReload) {
+    hs_set_database_allocator(nullptr, count_db_free);
+    db_frees = 0;
+
+    hs_database_t *db1 = buildDB("foo.*bar", 0, 0, HS_MODE_STREAM, nullptr);
+    ASSERT_NE(nullptr, db1);
+    hs_database_t *db2 = buildDB("foo.*baz", 0, 0, HS_MODE_STREAM, nullptr);
+    ASSERT_NE(nullptr, db2);
+
+    hs_db_handle_t *handle = nullptr;
+    hs_error_t err = hs_alloc_db_handle(db1, &handle);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // a reader and a stream on the first database
+    const hs_database_t *reader_db = nullptr, *stream_db = nullptr;
+    unsigned int token;
+    err = hs_db_handle_acquire(handle, &reader_db, &token);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(db1, reader_db);
+    err = hs_db_handle_pin(handle, &stream_db);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(db1, stream_db);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db1, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_alloc_scratch(db2, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(stream_db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, "foo", 3, 0, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_db_handle_update(handle, db2);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // new readers see the new database
+    const hs_database_t *db = nullptr;
+    unsigned int token2;
+    err = hs_db_handle_acquire(handle, &db, &token2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(db2, db);
+    err = hs_db_handle_release(handle, token2);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // the old one is kept while the reader and the stream use it
+    unsigned int pending = 0;
+    err = hs_db_handle_reclaim(handle, &pending);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, pending);
+    err = hs_db_handle_release(handle, token);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_db_handle_reclaim(handle, &pending);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, pending);
+    ASSERT_EQ(0, db_frees);
+
+    CallBackContext c;
+    err = hs_scan_stream(stream, "bar", 3, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+
+    // and freed once the stream lets go of it
+    err = hs_db_handle_unpin(handle, stream_db);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_db_handle_reclaim(handle, &pending);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, pending);
+    ASSERT_EQ(1, db_frees);
+
+    err = hs_db_handle_unpin(handle, stream_db);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_free_db_handle(handle);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2, db_frees);
+    hs_set_database_allocator(nullptr, nullptr);
+    hs_free_scratch(scratch);
+}
+
+TEST(scratch, poolBadParams) {
+    hs_database_t *db = buildDB("foobar", 0, 0, HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_pool_t *pool = nullptr;
+    ASSERT_EQ(HS_INVALID, hs_alloc_scratch_pool(nullptr, 1, &pool));
+    ASSERT_EQ(HS_INVALID, hs_alloc_scratch_pool(db, 1, nullptr));
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_scratch_pool(db, 1, &pool));
+
+    hs_scratch_t *scratch = nullptr;
+    ASSERT_EQ(HS_INVALID, hs_scratch_pool_get(nullptr, &scratch));
+    ASSERT_EQ(HS_INVALID, hs_scratch_pool_get(pool, nullptr));
+    ASSERT_EQ(HS_INVALID, hs_scratch_pool_put(pool, nullptr));
+    ASSERT_EQ(HS_INVALID, hs_scratch_pool_update(pool, nullptr));
+
+    ASSERT_EQ(HS_SUCCESS, hs_free_scratch_pool(pool));
+    ASSERT_EQ(HS_SUCCESS, hs_free_scratch_pool(nullptr));
+    hs_free_database(db);
+}
+
+TEST(scratch, patternMaskBlock) {
+    vector<pattern> patterns;
+    patterns.push_back(pattern("foobar", 0, 1));
+    patterns.push_back(pattern("ba[rz]", 0, 2));
+    patterns.push_back(pattern("hatstand.*teakettle", 0, 3));
+    hs_database_t *db = buildDB(patterns, HS_MODE_BLOCK);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const unsigned int ids[] = {3, 2, 3};
+    hs_pattern_mask_t *mask = nullptr;
+    err = hs_alloc_pattern_mask(db, ids, 3, &mask);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, mask);
+
+    const string data("foobar hatstand teakettle baz");
+    CallBackContext c;
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(4U, c.matches.size());
+
+    err = hs_set_scratch_pattern_mask(scratch, mask);
+    ASSERT_EQ(HS_SUCCESS, err);
+    c.clear();
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(3U, c.matches.size());
+    for (const auto &m : c.matches) {
+        ASSERT_NE(1, m.id);
+    }
+
+    // Masks are inherited by clones.
+    hs_scratch_t *clone = nullptr;
+    err = hs_clone_scratch(scratch, &clone);
+    ASSERT_EQ(HS_SUCCESS, err);
+    c.clear();
+    err = hs_scan(db, "foobar", 6, 0, clone, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(6, 2), c.matches[0]);
+    hs_free_scratch(clone);
+
+    // An empty mask suppresses everything; NULL enables everything again.
+    hs_pattern_mask_t *empty = nullptr;
+    err = hs_alloc_pattern_mask(db, nullptr, 0, &empty);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_set_scratch_pattern_mask(scratch, empty);
+    ASSERT_EQ(HS_SUCCESS, err);
+    c.clear();
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, c.matches.size());
+
+    err = hs_set_scratch_pattern_mask(scratch, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    c.clear();
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(4U, c.matches.size());
+
+    hs_free_pattern_mask(empty);
+    hs_free_pattern_mask(mask);
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+TEST(scratch, patternMaskStream) {
+    vector<pattern> patterns;
+    patterns.push_back(pattern("foo.*bar", 0, 1));
+    patterns.push_back(pattern("foo.*baz", 0, 2));
+    hs_database_t *db = buildDB(patterns, HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const unsigned int only1 = 1;
+    const unsigned int only2 = 2;
+    hs_pattern_mask_t *mask1 = nullptr;
+    hs_pattern_mask_t *mask2 = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_pattern_mask(db, &only1, 1, &mask1));
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_pattern_mask(db, &only2, 1, &mask2));
+
+    // Two streams over the same database with different masks.
+    hs_stream_t *s1 = nullptr;
+    hs_stream_t *s2 = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_open_stream(db, 0, &s1));
+    ASSERT_EQ(HS_SUCCESS, hs_open_stream(db, 0, &s2));
+
+    CallBackContext c1;
+    CallBackContext c2;
+    const char *writes[] = {"xxfoo", "xxbar", "xxbaz"};
+    for (const char *w : writes) {
+        ASSERT_EQ(HS_SUCCESS, hs_set_scratch_pattern_mask(scratch, mask1));
+        err = hs_scan_stream(s1, w, 5, 0, scratch, record_cb, &c1);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_EQ(HS_SUCCESS, hs_set_scratch_pattern_mask(scratch, mask2));
+        err = hs_scan_stream(s2, w, 5, 0, scratch, record_cb, &c2);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    ASSERT_EQ(HS_SUCCESS, hs_close_stream(s1, scratch, record_cb, &c1));
+    ASSERT_EQ(HS_SUCCESS, hs_close_stream(s2, scratch, record_cb, &c2));
+
+    ASSERT_EQ(1U, c1.matches.size());
+    ASSERT_EQ(MatchRecord(10, 1), c1.matches[0]);
+    ASSERT_EQ(1U, c2.matches.size());
+    ASSERT_EQ(MatchRecord(15, 2), c2.matches[0]);
+
+    hs_free_pattern_mask(mask1);
+    hs_free_pattern_mask(mask2);
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+TEST(scratch, patternMaskBadParams) {
+    hs_database_t *db1 = buildDB("foobar", 0, 1, HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db1);
+    hs_database_t *db2 = buildDB("foobaz", 0, 1, HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db2);
+
+    const unsigned int id = 1;
+    hs_pattern_mask_t *mask = nullptr;
+    ASSERT_EQ(HS_INVALID, hs_alloc_pattern_mask(nullptr, &id, 1, &mask));
+    ASSERT_EQ(HS_INVALID, hs_alloc_pattern_mask(db1, &id, 1, nullptr));
+    ASSERT_EQ(HS_INVALID, hs_alloc_pattern_mask(db1, nullptr, 1, &mask));
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_pattern_mask(db1, &id, 1, &mask));
+
+    hs_scratch_t *scratch = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_scratch(db1, &scratch));
+    ASSERT_EQ(HS_INVALID, hs_set_scratch_pattern_mask(nullptr, mask));
+    ASSERT_EQ(HS_SUCCESS, hs_set_scratch_pattern_mask(scratch, mask));
+
+    // The mask ties the scratch to its database.
+    hs_error_t err = hs_scan(db2, "foobaz", 6, 0, scratch, dummy_cb, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_scan(db1, "foobar", 6, 0, scratch, dummy_cb, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(HS_SUCCESS, hs_free_pattern_mask(mask));
+    ASSERT_EQ(HS_SUCCESS, hs_free_pattern_mask(nullptr));
+    hs_free_scratch(scratch);
+    hs_free_database(db1);
+    hs_free_database(db2);
+}
+
+TEST(scratch, latencyStats) {
+    hs_database_t *db = buildDB("foo.*bar", 0, 1, HS_MODE_STREAM, nullptr);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_scratch(db, &scratch));
+
+    hs_latency_stats_t stats;
+    ASSERT_EQ(HS_INVALID, hs_scratch_latency_stats(scratch, &stats));
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_latency_enable(scratch, 1));
+
+    const string small(10, 'x');
+    const string large(1000, 'x');
+    hs_stream_t *stream = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_open_stream(db, 0, &stream));
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(HS_SUCCESS, hs_scan_stream(stream, small.c_str(),
+                                             small.size(), 0, scratch,
+                                             dummy_cb, nullptr));
+    }
+    ASSERT_EQ(HS_SUCCESS, hs_scan_stream(stream, large.c_str(), large.size(),
+                                         0, scratch, dummy_cb, nullptr));
+    ASSERT_EQ(HS_SUCCESS, hs_close_stream(stream, scratch, dummy_cb, nullptr));
+
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_latency_stats(scratch, &stats));
+    EXPECT_EQ(0U, stats.call[HS_LATENCY_CALL_SCAN][0].count);
+    EXPECT_EQ(3U, stats.call[HS_LATENCY_CALL_SCAN_STREAM][0].count);
+    EXPECT_EQ(1U, stats.call[HS_LATENCY_CALL_SCAN_STREAM][3].count);
+    EXPECT_EQ(1U, stats.call[HS_LATENCY_CALL_CLOSE_STREAM][0].count);
+
+    const hs_latency_histogram_t &h = stats.call[HS_LATENCY_CALL_SCAN_STREAM][0];
+    unsigned long long total = 0;
+    for (unsigned int i = 0; i < HS_LATENCY_BUCKETS; i++) {
+        total += h.bucket[i];
+    }
+    EXPECT_EQ(h.count, total);
+    unsigned long long p100 = 0;
+    ASSERT_EQ(HS_SUCCESS, hs_latency_percentile(&h, 100.0, &p100));
+    EXPECT_EQ(h.max_ns, p100);
+
+    // A clone starts with empty histograms of its own.
+    hs_scratch_t *clone = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_clone_scratch(scratch, &clone));
+    hs_latency_stats_t clone_stats;
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_latency_stats(clone, &clone_stats));
+    EXPECT_EQ(0U, clone_stats.call[HS_LATENCY_CALL_SCAN_STREAM][0].count);
+
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_latency_reset(scratch));
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_latency_stats(scratch, &stats));
+    EXPECT_EQ(0U, stats.call[HS_LATENCY_CALL_SCAN_STREAM][0].count);
+
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_latency_enable(scratch, 0));
+    ASSERT_EQ(HS_INVALID, hs_scratch_latency_stats(scratch, &stats));
+    ASSERT_EQ(HS_INVALID, hs_scratch_latency_reset(scratch));
+
+    hs_free_scratch(clone);
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+TEST(scratch, latencyPercentile) {
+    hs_latency_histogram_t h;
+    memset(&h, 0, sizeof(h));
+
+    unsigned long long ns = 1;
+    ASSERT_EQ(HS_SUCCESS, hs_latency_percentile(&h, 50.0, &ns));
+    EXPECT_EQ(0U, ns);
+
+    // Buckets below 8ns are one nanosecond wide.
+    h.count = 100;
+    h.bucket[2] = 99;
+    h.bucket[7] = 1;
+    h.max_ns = 7;
+    ASSERT_EQ(HS_SUCCESS, hs_latency_percentile(&h, 50.0, &ns));
+    EXPECT_EQ(2U, ns);
+    ASSERT_EQ(HS_SUCCESS, hs_latency_percentile(&h, 99.0, &ns));
+    EXPECT_EQ(2U, ns);
+    ASSERT_EQ(HS_SUCCESS, hs_latency_percentile(&h, 99.9, &ns));
+    EXPECT_EQ(7U, ns);
+
+    ASSERT_EQ(HS_INVALID, hs_latency_percentile(nullptr, 50.0, &ns));
+    ASSERT_EQ(HS_INVALID, hs_latency_percentile(&h, 50.0, nullptr));
+    ASSERT_EQ(HS_INVALID, hs_latency_percentile(&h, 101.0, &ns));
+    ASSERT_EQ(HS_INVALID, hs_latency_percentile(&h, -1.0, &ns));
+    ASSERT_EQ(HS_INVALID, hs_scratch_latency_enable(nullptr, 1));
+    ASSERT_EQ(HS_INVALID, hs_scratch_latency_reset(nullptr));
+}
+
+TEST(scratch, sampleReport) {
+    hs_database_t *db = buildDB("foo.*bar", 0, 0,
+                                HS_MODE_BLOCK | HS_MODE_COST_ATTRIBUTION);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_scratch(db, &scratch));
+
+    hs_sample_aggregate_t *agg = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_sample_aggregate(db, &agg));
+    ASSERT_NE(nullptr, agg);
+
+    ASSERT_EQ(HS_INVALID, hs_scratch_sample_enable(nullptr, agg, 1));
+    ASSERT_EQ(HS_INVALID, hs_scratch_sample_enable(scratch, agg, 0));
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_sample_enable(scratch, agg, 1));
+
+    const string data("xxfooxxxxbarxx");
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(HS_SUCCESS, hs_scan(db, data.c_str(), data.size(), 0,
+                                      scratch, dummy_cb, nullptr));
+    }
+
+    char *info = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_sample_report(agg, 0, &info));
+    ASSERT_NE(nullptr, info);
+    string report(info);
+    free(info);
+    EXPECT_EQ(0U, report.find("sampled calls: 4 of 4, bytes: 56,"));
+    EXPECT_NE(string::npos, report.find("patterns (id: cycles"));
+
+    // Once sampling is off, calls are no longer counted.
+    ASSERT_EQ(HS_SUCCESS, hs_scratch_sample_enable(scratch, nullptr, 0));
+    ASSERT_EQ(HS_SUCCESS, hs_scan(db, data.c_str(), data.size(), 0, scratch,
+                                  dummy_cb, nullptr));
+    ASSERT_EQ(HS_SUCCESS, hs_sample_report(agg, 0, &info));
+    report = info;
+    free(info);
+    EXPECT_EQ(0U, report.find("sampled calls: 4 of 4,"));
+
+    ASSERT_EQ(HS_INVALID, hs_sample_report(nullptr, 0, &info));
+    ASSERT_EQ(HS_INVALID, hs_sample_report(agg, 0, nullptr));
+    ASSERT_EQ(HS_INVALID, hs_alloc_sample_aggregate(db, nullptr));
+
+    hs_free_scratch(scratch);
+    hs_free_sample_aggregate(agg);
+    hs_free_database(db);
+}
+
+struct BatchContext {
+    vector<vector<MatchRecord>> batches;
+    size_t halt_after = 0; // halt once this many batches are seen, if set
+};
+
+static
+int record_batch(const hs_match_t *matches, unsigned int count, void *ctxt) {
+    BatchContext *c = (BatchContext *)ctxt;
+    vector<MatchRecord> batch;
+    for (unsigned int i = 0; i < count; i++) {
+        batch.push_back(MatchRecord(matches[i].to, matches[i].id));
+    }
+    c->batches.push_back(batch);
+    return c->halt_after && c->batches.size() >= c->halt_after;
+}
+
+TEST(scratch, matchBufferBlock) {
+    hs_database_t *db = buildDB("a", 0, 1, HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_scratch(db, &scratch));
+
+    hs_match_t buf[2];
+    ASSERT_EQ(HS_SUCCESS,
+              hs_set_scratch_match_buffer(scratch, buf, 2, record_batch));
+
+    // Five matches: two full batches and the remainder at the end of the call.
+    // The per-match handler is not used while a buffer is attached.
+    BatchContext bc;
+    hs_error_t err = hs_scan(db, "aaxaaa", 6, 0, scratch, dummy_cb, &bc);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(3U, bc.batches.size());
+    ASSERT_EQ(2U, bc.batches[0].size());
+    ASSERT_EQ(MatchRecord(1, 1), bc.batches[0][0]);
+    ASSERT_EQ(MatchRecord(2, 1), bc.batches[0][1]);
+    ASSERT_EQ(2U, bc.batches[1].size());
+    ASSERT_EQ(1U, bc.batches[2].size());
+    ASSERT_EQ(MatchRecord(6, 1), bc.batches[2][0]);
+
+    // Halting from the batch handler terminates the scan.
+    BatchContext halt;
+    halt.halt_after = 1;
+    err = hs_scan(db, "aaxaaa", 6, 0, scratch, dummy_cb, &halt);
+    ASSERT_EQ(HS_SCAN_TERMINATED, err);
+    ASSERT_EQ(1U, halt.batches.size());
+
+    // Clones do not share the buffer.
+    hs_scratch_t *clone = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_clone_scratch(scratch, &clone));
+    CallBackContext c;
+    err = hs_scan(db, "aa", 2, 0, clone, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.matches.size());
+    hs_free_scratch(clone);
+
+    // Detaching returns to per-match delivery.
+    ASSERT_EQ(HS_SUCCESS,
+              hs_set_scratch_match_buffer(scratch, nullptr, 0, nullptr));
+    c.clear();
+    err = hs_scan(db, "aaa", 3, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(3U, c.matches.size());
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+TEST(scratch, matchBufferStream) {
+    hs_database_t *db = buildDB("foo.*bar$", 0, 1, HS_MODE_STREAM, nullptr);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_scratch(db, &scratch));
+
+    hs_match_t buf[4];
+    ASSERT_EQ(HS_SUCCESS,
+              hs_set_scratch_match_buffer(scratch, buf, 4, record_batch));
+
+    hs_stream_t *stream = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_open_stream(db, 0, &stream));
+    BatchContext bc;
+    ASSERT_EQ(HS_SUCCESS, hs_scan_stream(stream, "foo", 3, 0, scratch,
+                                         nullptr, &bc));
+    ASSERT_EQ(HS_SUCCESS, hs_scan_stream(stream, "bar", 3, 0, scratch,
+                                         nullptr, &bc));
+    ASSERT_TRUE(bc.batches.empty());
+
+    // The end-anchored match is raised at close even without a handler.
+    ASSERT_EQ(HS_SUCCESS, hs_close_stream(stream, scratch, nullptr, &bc));
+    ASSERT_EQ(1U, bc.batches.size());
+    ASSERT_EQ(1U, bc.batches[0].size());
+    ASSERT_EQ(MatchRecord(6, 1), bc.batches[0][0]);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+TEST(scratch, matchBufferBadParams) {
+    hs_database_t *db = buildDB("foobar", 0, 1, HS_MODE_BLOCK, nullptr);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    ASSERT_EQ(HS_SUCCESS, hs_alloc_scratch(db, &scratch));
+
+    hs_match_t buf[4];
+    ASSERT_EQ(HS_INVALID,
+              hs_set_scratch_match_buffer(nullptr, buf, 4, record_batch));
+    ASSERT_EQ(HS_INVALID,
+              hs_set_scratch_match_buffer(scratch, buf, 0, record_batch));
+    ASSERT_EQ(HS_INVALID, hs_set_scratch_match_buffer(scratch, buf, 4,
+                                                      nullptr));
+    ASSERT_EQ(HS_SUCCESS,
+              hs_set_scratch_match_buffer(scratch, nullptr, 0, nullptr));
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
 } // namespace
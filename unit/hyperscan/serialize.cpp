@@ -31,10 +31,15 @@
  */
 #include "config.h"
 
+#include <cstdio>
 #include <cstring>
 #include <string>
 #include <vector>
 
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
 #include "gtest/gtest.h"
 #include "hs.h"
 #include "hs_internal.h"
@@ -217,9 +222,453 @@ TEST_P(Serializep, DeserializeAtFromAnyAlignment) {
     delete[] mem;
 }
 
+// A compressed serialization should deserialize to a database identical to
+// that from the uncompressed one.
+TEST_P(Serializep, CompressedRoundTrip) {
+    const unsigned mode = GetParam();
+    SCOPED_TRACE(mode);
+
+    hs_database_t *db = buildDB("hatstand.*teakettle.*badgerbrush",
+                                HS_FLAG_CASELESS, 1000, mode);
+    ASSERT_TRUE(db != nullptr) << "database build failed.";
+
+    char *bytes = nullptr;
+    size_t length = 0;
+    hs_error_t err = hs_serialize_database(db, &bytes, &length);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    char *packed = nullptr;
+    size_t packed_length = 0;
+    err = hs_serialize_database_compressed(db, &packed, &packed_length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, packed);
+    ASSERT_LT(packed_length, length);
+    hs_free_database(db);
+
+    char *info = nullptr;
+    char *packed_info = nullptr;
+    err = hs_serialized_database_info(bytes, length, &info);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_serialized_database_info(packed, packed_length, &packed_info);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_STREQ(info, packed_info);
+    free(info);
+    free(packed_info);
+
+    size_t size = 0;
+    size_t packed_size = 0;
+    err = hs_serialized_database_size(bytes, length, &size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_serialized_database_size(packed, packed_length, &packed_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(size, packed_size);
+
+    hs_database_t *db1 = nullptr;
+    err = hs_deserialize_database(bytes, length, &db1);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_database_t *db2 = nullptr;
+    err = hs_deserialize_database(packed, packed_length, &db2);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Deserialize the compressed form in place as well.
+    char *mem = new char[packed_size];
+    hs_database_t *db3 = (hs_database_t *)mem;
+    err = hs_deserialize_database_at(packed, packed_length, db3);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // All three should serialize to the same bytes.
+    for (const hs_database_t *d : {(const hs_database_t *)db2,
+                                   (const hs_database_t *)db3}) {
+        char *out = nullptr;
+        size_t out_length = 0;
+        err = hs_serialize_database(d, &out, &out_length);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_EQ(length, out_length);
+        ASSERT_EQ(0, memcmp(bytes, out, length));
+        free(out);
+    }
+
+    // Truncated or corrupted compressed data must be rejected.
+    hs_database_t *bad = nullptr;
+    err = hs_deserialize_database(packed, packed_length - 1, &bad);
+    ASSERT_NE(HS_SUCCESS, err);
+    packed[packed_length / 2] ^= 0x55;
+    err = hs_deserialize_database(packed, packed_length, &bad);
+    ASSERT_NE(HS_SUCCESS, err);
+
+    hs_free_database(db1);
+    hs_free_database(db2);
+    delete[] mem;
+    free(bytes);
+    free(packed);
+}
+
+static
+vector<pattern> threadTestPatterns(unsigned count) {
+    static const char *templates[] = {
+        "hatstand%u.*teakettle", "^badger%u[a-f]+brush",
+        "foo[0-9]{2,%u}bar", "(abc|def)%u\\d+$", "lit%uxyzzy",
+    };
+    const size_t num_templates = sizeof(templates) / sizeof(templates[0]);
+
+    vector<pattern> patterns;
+    for (unsigned i = 0; i < count; i++) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), templates[i % num_templates], i % 17 + 2);
+        patterns.push_back(pattern(buf, HS_FLAG_DOTALL, i));
+    }
+    return patterns;
+}
+
+// A threaded compile should produce exactly the same bytecode.
+TEST_P(Serializep, CompileThreadsIdentical) {
+    const unsigned mode = GetParam();
+    SCOPED_TRACE(mode);
+
+    // Enough patterns that the threaded front end uses more than one window.
+    const vector<pattern> patterns = threadTestPatterns(1200);
+
+    vector<string> serialized;
+    for (unsigned threads : {1U, 3U}) {
+        SCOPED_TRACE(threads);
+        hs_error_t err = hs_set_compile_threads(threads);
+        ASSERT_EQ(HS_SUCCESS, err);
+
+        hs_database_t *db = buildDB(patterns, mode);
+        ASSERT_TRUE(db != nullptr) << "database build failed.";
+
+        char *bytes = nullptr;
+        size_t length = 0;
+        err = hs_serialize_database(db, &bytes, &length);
+        ASSERT_EQ(HS_SUCCESS, err) << "serialize failed.";
+        serialized.push_back(string(bytes, length));
+
+        free(bytes);
+        hs_free_database(db);
+    }
+
+    hs_set_compile_threads(1);
+    ASSERT_EQ(2U, serialized.size());
+    ASSERT_TRUE(serialized[0] == serialized[1]);
+}
+
+TEST_P(Serializep, DeltaRoundTrip) {
+    const unsigned mode = GetParam();
+    SCOPED_TRACE(mode);
+
+    vector<pattern> patterns = threadTestPatterns(50);
+    hs_database_t *old_db = buildDB(patterns, mode);
+    ASSERT_TRUE(old_db != nullptr) << "database build failed.";
+    patterns.push_back(pattern("newrule[0-9]+xyzzy", HS_FLAG_DOTALL, 1000));
+    hs_database_t *new_db = buildDB(patterns, mode);
+    ASSERT_TRUE(new_db != nullptr) << "database build failed.";
+
+    char *bytes = nullptr;
+    size_t length = 0;
+    hs_error_t err = hs_serialize_database(new_db, &bytes, &length);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // A patch between identical databases is little more than its header.
+    char *patch = nullptr;
+    size_t patch_length = 0;
+    err = hs_serialize_database_delta(new_db, new_db, &patch, &patch_length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_LT(patch_length, length / 4);
+    free(patch);
+
+    err = hs_serialize_database_delta(old_db, new_db, &patch, &patch_length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, patch);
+
+    // Applying the patch reproduces the new database exactly.
+    hs_database_t *patched = nullptr;
+    err = hs_apply_database_delta(old_db, patch, patch_length, &patched);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(patched != nullptr);
+
+    char *out = nullptr;
+    size_t out_length = 0;
+    err = hs_serialize_database(patched, &out, &out_length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(length, out_length);
+    ASSERT_EQ(0, memcmp(bytes, out, length));
+    free(out);
+    hs_free_database(patched);
+
+    // The patch only applies to the database it was made against, and must
+    // be complete.
+    hs_database_t *bad = nullptr;
+    err = hs_apply_database_delta(new_db, patch, patch_length, &bad);
+    ASSERT_NE(HS_SUCCESS, err);
+    ASSERT_EQ(nullptr, bad);
+    err = hs_apply_database_delta(old_db, patch, 16, &bad);
+    ASSERT_NE(HS_SUCCESS, err);
+
+    free(patch);
+    free(bytes);
+    hs_free_database(old_db);
+    hs_free_database(new_db);
+}
+
+// A multi-target database loads the variant best suited to the host, which
+// is identical to the database compiled for the host.
+TEST_P(Serializep, MultiTargetRoundTrip) {
+    const unsigned mode = GetParam();
+    SCOPED_TRACE(mode);
+
+    hs_platform_info host;
+    hs_error_t err = hs_populate_platform(&host);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_platform_info generic;
+    generic.cpu_features = 0;
+    generic.tune = HS_TUNE_FAMILY_GENERIC;
+
+    vector<pattern> patterns = threadTestPatterns(50);
+    hs_database_t *generic_db = buildDB(patterns, mode, &generic);
+    ASSERT_TRUE(generic_db != nullptr) << "database build failed.";
+    hs_database_t *host_db = buildDB(patterns, mode, &host);
+    ASSERT_TRUE(host_db != nullptr) << "database build failed.";
+
+    char *host_bytes = nullptr;
+    size_t host_length = 0;
+    err = hs_serialize_database(host_db, &host_bytes, &host_length);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const hs_database_t *dbs[] = {generic_db, host_db};
+    char *bytes = nullptr;
+    size_t length = 0;
+    err = hs_serialize_database_multi_target(dbs, 2, &bytes, &length);
+    if (!host.cpu_features) {
+        // Both builds are for the same platform.
+        ASSERT_EQ(HS_INVALID, err);
+        free(host_bytes);
+        hs_free_database(generic_db);
+        hs_free_database(host_db);
+        return;
+    }
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, bytes);
+
+    // The host variant is stored relative to the generic one.
+    ASSERT_LT(length, 2 * host_length);
+
+    size_t db_size = 0, host_size = 0;
+    err = hs_serialized_database_size(bytes, length, &db_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_database_size(host_db, &host_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(host_size, db_size);
+
+    hs_database_t *db = nullptr;
+    err = hs_deserialize_database(bytes, length, &db);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+
+    char *out = nullptr;
+    size_t out_length = 0;
+    err = hs_serialize_database(db, &out, &out_length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(host_length, out_length);
+    ASSERT_EQ(0, memcmp(host_bytes, out, out_length));
+    free(out);
+    hs_free_database(db);
+
+    char *info = nullptr, *host_info = nullptr;
+    err = hs_serialized_database_info(bytes, length, &info);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_database_info(host_db, &host_info);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_STREQ(host_info, info);
+    free(info);
+    free(host_info);
+
+    // Variants must be for distinct platforms, and truncation is detected.
+    const hs_database_t *dup[] = {host_db, host_db};
+    char *bad = nullptr;
+    size_t bad_length = 0;
+    err = hs_serialize_database_multi_target(dup, 2, &bad, &bad_length);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_deserialize_database(bytes, length - 8, &db);
+    ASSERT_NE(HS_SUCCESS, err);
+
+    free(bytes);
+    free(host_bytes);
+    hs_free_database(generic_db);
+    hs_free_database(host_db);
+}
+
+// A single expression with several large components is reduced on the
+// workers; this should also produce exactly the same bytecode.
+TEST_P(Serializep, CompileThreadsComponentsIdentical) {
+    const unsigned mode = GetParam();
+    SCOPED_TRACE(mode);
+
+    const vector<pattern> patterns = {
+        pattern("abc[^\\n]{300}def|ghi[^\\n]{300}jkl|"
+                "mno[0-9]{300}pqr|stu[a-z]{300}vwx", HS_FLAG_DOTALL, 1),
+    };
+
+    vector<string> serialized;
+    for (unsigned threads : {1U, 4U}) {
+        SCOPED_TRACE(threads);
+        hs_error_t err = hs_set_compile_threads(threads);
+        ASSERT_EQ(HS_SUCCESS, err);
+
+        hs_database_t *db = buildDB(patterns, mode);
+        ASSERT_TRUE(db != nullptr) << "database build failed.";
+
+        char *bytes = nullptr;
+        size_t length = 0;
+        err = hs_serialize_database(db, &bytes, &length);
+        ASSERT_EQ(HS_SUCCESS, err) << "serialize failed.";
+        serialized.push_back(string(bytes, length));
+
+        free(bytes);
+        hs_free_database(db);
+    }
+
+    hs_set_compile_threads(1);
+    ASSERT_EQ(2U, serialized.size());
+    ASSERT_TRUE(serialized[0] == serialized[1]);
+}
+
 INSTANTIATE_TEST_CASE_P(Serialize, Serializep,
                         ValuesIn(validModes));
 
+static
+hs_database_t *buildCachedDB(const vector<pattern> &patterns, unsigned mode,
+                             hs_compile_cache_t *cache) {
+    vector<const char *> exprs;
+    vector<unsigned> flags, ids;
+    for (const auto &pat : patterns) {
+        exprs.push_back(pat.expression.c_str());
+        flags.push_back(pat.flags);
+        ids.push_back(pat.id);
+    }
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    hs_error_t err = hs_compile_ext_multi_cached(exprs.data(), flags.data(),
+                                                 ids.data(), nullptr,
+                                                 exprs.size(), mode, nullptr,
+                                                 cache, &db, &compile_err);
+    if (err != HS_SUCCESS) {
+        hs_free_compile_error(compile_err);
+        return nullptr;
+    }
+    return db;
+}
+
+static
+string serializeDB(const hs_database_t *db) {
+    char *bytes = nullptr;
+    size_t length = 0;
+    hs_error_t err = hs_serialize_database(db, &bytes, &length);
+    if (err != HS_SUCCESS) {
+        return string();
+    }
+    string s(bytes, length);
+    free(bytes);
+    return s;
+}
+
+// Compiles using a compile cache should produce exactly the same bytecode,
+// whether or not the cache already holds the engines.
+TEST_P(Serializep, CompileCacheIdentical) {
+    const unsigned mode = GetParam();
+    SCOPED_TRACE(mode);
+
+    // Patterns with no useful literals, which should be built as DFAs.
+    vector<pattern> patterns;
+    patterns.push_back(pattern("[a-c]+[d-f]{2}[a-z]", 0, 1));
+    patterns.push_back(pattern("[0-3][x-z]+[0-3]{3}", 0, 2));
+    patterns.push_back(pattern("^[g-k]{2,5}[^a]", 0, 3));
+
+    hs_database_t *db = buildDB(patterns, mode);
+    ASSERT_TRUE(db != nullptr);
+    const string uncached = serializeDB(db);
+    hs_free_database(db);
+
+    hs_compile_cache_t *cache = nullptr;
+    hs_error_t err = hs_alloc_compile_cache(&cache);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(cache != nullptr);
+
+    size_t engines = 0, size = 0;
+    err = hs_compile_cache_info(cache, &engines, &size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, engines);
+    ASSERT_EQ(0U, size);
+
+    // First compile populates the cache.
+    db = buildCachedDB(patterns, mode, cache);
+    ASSERT_TRUE(db != nullptr);
+    ASSERT_TRUE(uncached == serializeDB(db));
+    hs_free_database(db);
+
+    err = hs_compile_cache_info(cache, &engines, &size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_LT(0U, engines);
+    ASSERT_LT(0U, size);
+
+    // Second compile should take its engines from the cache.
+    db = buildCachedDB(patterns, mode, cache);
+    ASSERT_TRUE(db != nullptr);
+    ASSERT_TRUE(uncached == serializeDB(db));
+    hs_free_database(db);
+
+    size_t engines2 = 0;
+    err = hs_compile_cache_info(cache, &engines2, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(engines, engines2);
+
+    // Adding a pattern should still give the same result as a fresh build.
+    patterns.push_back(pattern("[p-r]{3}[s-u]+q", 0, 4));
+    db = buildDB(patterns, mode);
+    ASSERT_TRUE(db != nullptr);
+    const string uncached2 = serializeDB(db);
+    hs_free_database(db);
+
+    db = buildCachedDB(patterns, mode, cache);
+    ASSERT_TRUE(db != nullptr);
+    ASSERT_TRUE(uncached2 == serializeDB(db));
+    hs_free_database(db);
+
+    err = hs_free_compile_cache(cache);
+    ASSERT_EQ(HS_SUCCESS, err);
+}
+
+// Errors from a threaded compile should refer to the first bad expression.
+TEST(Serialize, CompileThreadsErrorIndex) {
+    vector<pattern> patterns = threadTestPatterns(1000);
+    patterns[900].expression = "unbalanced(";
+    patterns[950].expression = "(?<!lookbehind)foo";
+
+    vector<const char *> exprs;
+    vector<unsigned> flags, ids;
+    for (const auto &pat : patterns) {
+        exprs.push_back(pat.expression.c_str());
+        flags.push_back(pat.flags);
+        ids.push_back(pat.id);
+    }
+
+    hs_error_t err = hs_set_compile_threads(4);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *compile_err = nullptr;
+    err = hs_compile_multi(exprs.data(), flags.data(), ids.data(),
+                           exprs.size(), HS_MODE_BLOCK, nullptr, &db,
+                           &compile_err);
+    hs_set_compile_threads(1);
+
+    ASSERT_EQ(HS_COMPILER_ERROR, err);
+    ASSERT_TRUE(db == nullptr);
+    ASSERT_TRUE(compile_err != nullptr);
+    EXPECT_EQ(900, compile_err->expression);
+    hs_free_compile_error(compile_err);
+}
+
 // Attempt to reproduce the scenario in UE-1946.
 TEST(Serialize, CrossCompileSom) {
     hs_platform_info plat;
@@ -550,4 +999,411 @@ TEST(Serialize, DeserializeGarbage) {
     free(bytes);
 }
 
+// A database image should be usable in place, and give the same matches as
+// the original database.
+TEST(Serialize, MapDatabaseImage) {
+    hs_database_t *db = buildDB("hatstand.*(badgerbrush|teakettle)", 0, 1000,
+                                HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr) << "database build failed.";
+
+    char *bytes = nullptr;
+    size_t length = 0;
+    hs_error_t err = hs_serialize_database_image(db, &bytes, &length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, bytes);
+
+    size_t db_size = 0;
+    err = hs_database_size(db, &db_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(db_size, length);
+    hs_free_database(db);
+
+    // Copy the image into cacheline-aligned memory, as an mmap would be.
+    const size_t maxalign = 64;
+    char *mem = new char[length + maxalign];
+    char *image = mem + (maxalign - ((uintptr_t)mem % maxalign)) % maxalign;
+    memcpy(image, bytes, length);
+    free(bytes);
+
+    const hs_database_t *mapped = nullptr;
+    err = hs_map_database(image, length, &mapped);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(mapped == (const hs_database_t *)image);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(mapped, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data("hatstand teakettle badgerbrush");
+    CallBackContext c;
+    err = hs_scan(mapped, data.c_str(), data.size(), 0, scratch, record_cb,
+                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.matches.size());
+    EXPECT_EQ(MatchRecord(18, 1000), c.matches[0]);
+    EXPECT_EQ(MatchRecord(30, 1000), c.matches[1]);
+
+    hs_free_scratch(scratch);
+    delete[] mem;
+}
+
+TEST(Serialize, MapDatabaseBadImage) {
+    hs_database_t *db = buildDB("hatstand.*teakettle", 0, 1, HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr) << "database build failed.";
+
+    char *bytes = nullptr;
+    size_t length = 0;
+    hs_error_t err = hs_serialize_database_image(db, &bytes, &length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+
+    const size_t maxalign = 64;
+    char *mem = new char[length + 2 * maxalign];
+    char *image = mem + (maxalign - ((uintptr_t)mem % maxalign)) % maxalign;
+    memcpy(image, bytes, length);
+
+    const hs_database_t *mapped = nullptr;
+
+    // Null args.
+    err = hs_map_database(nullptr, length, &mapped);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_map_database(image, length, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    // Wrong length.
+    err = hs_map_database(image, length - 1, &mapped);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(mapped == nullptr);
+
+    // Misaligned.
+    memcpy(image + 8, bytes, length);
+    err = hs_map_database(image + 8, length, &mapped);
+    ASSERT_EQ(HS_BAD_ALIGN, err);
+    ASSERT_TRUE(mapped == nullptr);
+
+    // Corrupt bytecode fails the CRC check.
+    memcpy(image, bytes, length);
+    image[length / 2] ^= 0xff;
+    err = hs_map_database(image, length, &mapped);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(mapped == nullptr);
+
+    free(bytes);
+    delete[] mem;
+}
+
+
+TEST(Serialize, CloneDatabase) {
+    hs_database_t *db = buildDB("hatstand.*teakettle", 0, 1000,
+                                HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr) << "database build failed.";
+
+    hs_database_t *clone = nullptr;
+    hs_error_t err = hs_clone_database(nullptr, &clone);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_clone_database(db, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_clone_database(db, &clone);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(clone != nullptr);
+    ASSERT_NE(db, clone);
+
+    // The clone serializes to exactly the same bytes.
+    char *bytes1 = nullptr, *bytes2 = nullptr;
+    size_t len1 = 0, len2 = 0;
+    err = hs_serialize_database(db, &bytes1, &len1);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_serialize_database(clone, &bytes2, &len2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(len1, len2);
+    EXPECT_EQ(0, memcmp(bytes1, bytes2, len1));
+    free(bytes1);
+    free(bytes2);
+
+    // The clone is independent of the original.
+    hs_free_database(db);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(clone, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(clone, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data("hatstand teakettle badgerbrush");
+    CallBackContext c;
+    err = hs_scan_stream(stream, data.c_str(), data.size(), 0, scratch,
+                         record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(18, 1000), c.matches[0]);
+
+    hs_free_scratch(scratch);
+    hs_free_database(clone);
+}
+
+TEST(Serialize, CloneMappedDatabase) {
+    hs_database_t *db = buildDB("hatstand.*teakettle", 0, 1000,
+                                HS_MODE_BLOCK);
+    ASSERT_TRUE(db != nullptr) << "database build failed.";
+
+    char *bytes = nullptr;
+    size_t length = 0;
+    hs_error_t err = hs_serialize_database_image(db, &bytes, &length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+
+    const size_t maxalign = 64;
+    char *mem = new char[length + maxalign];
+    char *image = mem + (maxalign - ((uintptr_t)mem % maxalign)) % maxalign;
+    memcpy(image, bytes, length);
+    free(bytes);
+
+    const hs_database_t *mapped = nullptr;
+    err = hs_map_database(image, length, &mapped);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_database_t *clone = nullptr;
+    err = hs_clone_database(mapped, &clone);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // The image can go away once it has been cloned.
+    memset(mem, 0, length + maxalign);
+    delete[] mem;
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(clone, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data("hatstand teakettle badgerbrush");
+    CallBackContext c;
+    err = hs_scan(clone, data.c_str(), data.size(), 0, scratch, record_cb,
+                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(18, 1000), c.matches[0]);
+
+    hs_free_scratch(scratch);
+    hs_free_database(clone);
+}
+
+
+TEST(Serialize, MultiModeDatabase) {
+    const char *expr[] = {"hatstand.*teakettle", "badger"};
+    const unsigned flags[] = {0, 0};
+    const unsigned ids[] = {1000, 1001};
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *c_err = nullptr;
+    hs_error_t err = hs_compile_multi(expr, flags, ids, 2,
+                                      HS_MODE_BLOCK | HS_MODE_STREAM, nullptr,
+                                      &db, &c_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, db);
+
+    char *info = nullptr;
+    err = hs_database_info(db, &info);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_NE(nullptr, strstr(info, "BLOCK STREAM"));
+    free(info);
+
+    // Round trip through serialization, which must keep both engines.
+    char *bytes = nullptr;
+    size_t length = 0;
+    err = hs_serialize_database(db, &bytes, &length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+    db = nullptr;
+    err = hs_deserialize_database(bytes, length, &db);
+    ASSERT_EQ(HS_SUCCESS, err);
+    free(bytes);
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Block mode calls use the block engine.
+    const string data("hatstand teakettle badgerbrush");
+    CallBackContext c;
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb,
+                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.matches.size());
+    EXPECT_EQ(MatchRecord(18, 1000), c.matches[0]);
+    EXPECT_EQ(MatchRecord(25, 1001), c.matches[1]);
+
+    // Streaming calls use the streaming engine, with the same scratch.
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    c.clear();
+    for (size_t i = 0; i < data.size(); i += 5) {
+        size_t len = min(data.size() - i, (size_t)5);
+        err = hs_scan_stream(stream, data.c_str() + i, len, 0, scratch,
+                             record_cb, (void *)&c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.matches.size());
+    EXPECT_EQ(MatchRecord(18, 1000), c.matches[0]);
+    EXPECT_EQ(MatchRecord(25, 1001), c.matches[1]);
+
+    // There is no vectored engine.
+    const char *vdata[] = {data.c_str()};
+    const unsigned vlen[] = {(unsigned)data.size()};
+    err = hs_scan_vector(db, vdata, vlen, 1, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_DB_MODE_ERROR, err);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+TEST(Serialize, WarmDatabase) {
+    const char *expr[] = {"hatstand.*teakettle", "badger"};
+    const unsigned flags[] = {0, 0};
+    const unsigned ids[] = {1000, 1001};
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *c_err = nullptr;
+    hs_error_t err = hs_compile_multi(expr, flags, ids, 2,
+                                      HS_MODE_BLOCK | HS_MODE_STREAM, nullptr,
+                                      &db, &c_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, db);
+
+    err = hs_database_warm(nullptr, 0);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_database_warm(db, ~0U);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_database_warm(db, 0);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+#if !defined(_WIN32)
+    // Locking may be refused by the locked memory limit.
+    err = hs_database_warm(db, HS_WARM_LOCK);
+    ASSERT_TRUE(err == HS_SUCCESS || err == HS_NOMEM);
+    if (err == HS_SUCCESS) {
+        size_t db_len = 0;
+        err = hs_database_size(db, &db_len);
+        ASSERT_EQ(HS_SUCCESS, err);
+        EXPECT_EQ(0, munlock(db, db_len));
+    }
+#endif
+
+    // Warming does not change the database.
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data("hatstand teakettle badgerbrush");
+    CallBackContext c;
+    err = hs_scan(db, data.c_str(), data.size(), 0, scratch, record_cb,
+                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.matches.size());
+    EXPECT_EQ(MatchRecord(18, 1000), c.matches[0]);
+    EXPECT_EQ(MatchRecord(25, 1001), c.matches[1]);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+
+TEST(Serialize, EngineStore) {
+    const char *expr[] = {"hatstand.*teakettle", "badger",
+                          "^foo[^\\n]{3,50}bar"};
+    const unsigned flags[] = {0, 0, 0};
+    const unsigned ids[] = {1000, 1001, 1002};
+
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *c_err = nullptr;
+    hs_error_t err = hs_compile_multi(expr, flags, ids, 3,
+                                      HS_MODE_BLOCK | HS_MODE_STREAM, nullptr,
+                                      &db, &c_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, db);
+
+    char *bytes = nullptr;
+    size_t length = 0;
+    err = hs_serialize_database(db, &bytes, &length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+
+    const size_t size = 16 << 20;
+    hs_engine_store_t *store = nullptr;
+    err = hs_alloc_engine_store(0, &store);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_alloc_engine_store(size, &store);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_NE(nullptr, store);
+
+    hs_database_t *db1 = nullptr, *db2 = nullptr;
+    err = hs_engine_store_load(store, bytes, length, &db1);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_engine_store_info_t first;
+    err = hs_engine_store_stats(store, &first);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(1U, first.databases);
+    ASSERT_LT(0U, first.engines);
+
+    err = hs_engine_store_load(store, bytes, length, &db2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    free(bytes);
+
+    // The second copy uses every engine of the first, and adds none.
+    hs_engine_store_info_t stats;
+    err = hs_engine_store_stats(store, &stats);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(2U, stats.databases);
+    EXPECT_EQ(first.engines, stats.engines);
+    EXPECT_EQ(first.engine_bytes, stats.engine_bytes);
+    EXPECT_EQ(2 * first.references, stats.references);
+    EXPECT_LT(first.saved_bytes, stats.saved_bytes);
+
+    // Databases in a store belong to it.
+    EXPECT_EQ(HS_INVALID, hs_free_database(db1));
+    EXPECT_EQ(HS_INVALID, hs_serialize_database(db1, &bytes, &length));
+    hs_database_t *clone = nullptr;
+    EXPECT_EQ(HS_INVALID, hs_clone_database(db1, &clone));
+
+    hs_scratch_t *scratch = nullptr;
+    err = hs_alloc_scratch(db1, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_alloc_scratch(db2, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Each database still works once the other has gone.
+    const string data("foo is a bar hatstand teakettle badgerbrush");
+    for (hs_database_t *d : {db1, db2}) {
+        CallBackContext c;
+        err = hs_scan(d, data.c_str(), data.size(), 0, scratch, record_cb,
+                      (void *)&c);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_EQ(3U, c.matches.size());
+        EXPECT_EQ(MatchRecord(12, 1002), c.matches[0]);
+        EXPECT_EQ(MatchRecord(31, 1000), c.matches[1]);
+        EXPECT_EQ(MatchRecord(38, 1001), c.matches[2]);
+
+        err = hs_engine_store_unload(store, d);
+        ASSERT_EQ(HS_SUCCESS, err);
+        EXPECT_EQ(HS_INVALID, hs_engine_store_unload(store, d));
+    }
+
+    err = hs_engine_store_stats(store, &stats);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(0U, stats.databases);
+    EXPECT_EQ(0U, stats.engines);
+    EXPECT_EQ(size, stats.free_bytes);
+
+    hs_free_scratch(scratch);
+    hs_free_engine_store(store);
+}
+
 }
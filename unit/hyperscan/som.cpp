@@ -200,3 +200,80 @@ INSTANTIATE_TEST_CASE_P(Som, SomTest,
                         Values(HS_MODE_SOM_HORIZON_SMALL,
                                HS_MODE_SOM_HORIZON_MEDIUM));
 
+
+static
+vector<Match> scanBlockSom(const char *expr, unsigned mode,
+                           const string &data) {
+    vector<Match> matches;
+    hs_database_t *db = buildDB(expr, HS_FLAG_SOM_LEFTMOST, 1, mode);
+    EXPECT_TRUE(db != nullptr);
+    if (!db) {
+        return matches;
+    }
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    EXPECT_EQ(HS_SUCCESS, err);
+
+    err = hs_scan(db, data.c_str(), data.length(), 0, scratch, vectorCallback,
+                  &matches);
+    EXPECT_EQ(HS_SUCCESS, err);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+    return matches;
+}
+
+TEST(SomLazy, BlockMatchesEager) {
+    const char *exprs[] = {"foo.*bar", "a[bc]{2,5}d", "(ab|abab)+c",
+                           "x[^y]*y\\d", "z.{3,}q", "(foo|fo|f)obar"};
+    const string data = "xfoobar foobaar ffoofoobar abababcabbcdacccccd "
+                        "x12y3 zz_qq xyzy7 fooobar abababababc";
+
+    for (const char *expr : exprs) {
+        SCOPED_TRACE(expr);
+        auto eager = scanBlockSom(expr, HS_MODE_BLOCK, data);
+        auto lazy = scanBlockSom(expr, HS_MODE_BLOCK | HS_MODE_SOM_LAZY, data);
+        ASSERT_FALSE(eager.empty());
+        ASSERT_EQ(eager.size(), lazy.size());
+        for (size_t i = 0; i < eager.size(); i++) {
+            EXPECT_EQ(eager[i].id, lazy[i].id);
+            EXPECT_EQ(eager[i].from, lazy[i].from);
+            EXPECT_EQ(eager[i].to, lazy[i].to);
+        }
+    }
+}
+
+TEST(SomLazy, StreamWithinHistory) {
+    hs_database_t *db = buildDB("foo.{0,20}bar", HS_FLAG_SOM_LEFTMOST, 1,
+                                HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE |
+                                    HS_MODE_SOM_LAZY);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    vector<Match> matches;
+    const string first("xxfoo12");
+    const string second("345bar");
+    err = hs_scan_stream(stream, first.c_str(), first.length(), 0, scratch,
+                         vectorCallback, &matches);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, second.c_str(), second.length(), 0, scratch,
+                         vectorCallback, &matches);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(stream, scratch, vectorCallback, &matches);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(1U, matches.size());
+    EXPECT_EQ(2U, matches[0].from);
+    EXPECT_EQ(13U, matches[0].to);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
@@ -26,6 +26,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cstring>
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -87,6 +89,43 @@ TEST(StreamUtil, reset1) {
     hs_free_database(db);
 }
 
+TEST(StreamUtil, prefetch) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    err = hs_prefetch_stream(nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    // Prefetching before each write does not change the matches.
+    CallBackContext c;
+    err = hs_prefetch_stream(stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, "barfoo", 6, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, c.matches.size());
+
+    err = hs_prefetch_stream(stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, "xbar", 4, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(10, 0), c.matches[0]);
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
 TEST(StreamUtil, reset2) {
     hs_error_t err;
     hs_scratch_t *scratch = nullptr;
@@ -289,6 +328,55 @@ TEST(StreamUtil, copy2) {
     hs_free_database(db);
 }
 
+// Large stream states are copied region by region; check that a copy taken
+// mid-match carries on exactly as the original does.
+TEST(StreamUtil, copy_large_state) {
+    std::vector<pattern> patterns;
+    for (unsigned i = 0; i < 64; i++) {
+        patterns.push_back(pattern("foo" + std::to_string(i) +
+                                       "[^\\n]{5,}bar",
+                                   HS_FLAG_SINGLEMATCH, i));
+    }
+    hs_database_t *db = buildDB(patterns, HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    hs_stream_t *stream2 = nullptr;
+    CallBackContext c;
+
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const std::string head("foo7 hello");
+    const std::string tail(" world bar");
+    err = hs_scan_stream(stream, head.c_str(), head.size(), 0, scratch,
+                         record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, c.matches.size());
+
+    err = hs_copy_stream(&stream2, stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    for (hs_stream_t *s : {stream, stream2}) {
+        c.matches.clear();
+        err = hs_scan_stream(s, tail.c_str(), tail.size(), 0, scratch,
+                             record_cb, (void *)&c);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_EQ(1U, c.matches.size());
+        ASSERT_EQ(MatchRecord(20, 7), c.matches[0]);
+    }
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    hs_close_stream(stream2, scratch, nullptr, nullptr);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
 TEST(StreamUtil, copy_reset1) {
     hs_error_t err;
     hs_scratch_t *scratch = nullptr;
@@ -573,6 +661,239 @@ TEST(StreamUtil, copy_reset_matches) {
     hs_free_database(db);
 }
 
+TEST(StreamUtil, compress1) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    hs_stream_t *stream2 = nullptr;
+
+    CallBackContext c;
+
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    err = hs_scan_stream(stream, data1, sizeof(data1), 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(9, 0), c.matches[0]);
+
+    c.matches.clear();
+
+    size_t used = 0;
+    err = hs_compress_stream(stream, nullptr, 0, &used);
+    ASSERT_EQ(HS_INSUFFICIENT_SPACE, err);
+    ASSERT_LT(0U, used);
+
+    vector<char> buf(used);
+    size_t used2 = 0;
+    err = hs_compress_stream(stream, buf.data(), buf.size(), &used2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(used, used2);
+
+    err = hs_expand_stream(db, &stream2, buf.data(), buf.size());
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream2 != nullptr);
+
+    err = hs_scan_stream(stream, data1, sizeof(data1), 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.matches.size());
+    ASSERT_EQ(MatchRecord(13, 0), c.matches[0]);
+    ASSERT_EQ(MatchRecord(19, 0), c.matches[1]);
+
+    c.matches.clear();
+
+    err = hs_scan_stream(stream2, data1, sizeof(data1), 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.matches.size());
+    ASSERT_EQ(MatchRecord(13, 0), c.matches[0]);
+    ASSERT_EQ(MatchRecord(19, 0), c.matches[1]);
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    hs_close_stream(stream2, scratch, nullptr, nullptr);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, compress_reset_matches) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar$", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    hs_stream_t *stream2 = nullptr;
+
+    CallBackContext c;
+
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    err = hs_open_stream(db, 0, &stream2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream2 != nullptr);
+
+    err = hs_scan_stream(stream, data1, strlen(data1), 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, c.matches.size());
+
+    vector<char> buf(1024);
+    size_t used = 0;
+    err = hs_compress_stream(stream2, buf.data(), buf.size(), &used);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_reset_and_expand_stream(stream, buf.data(), used, scratch,
+                                     record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(9, 0), c.matches[0]);
+
+    // stream now has the (empty) state of stream2
+    c.matches.clear();
+    hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(0U, c.matches.size());
+
+    hs_close_stream(stream2, scratch, nullptr, nullptr);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, compress_bad) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    hs_stream_t *stream2 = nullptr;
+
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    err = hs_scan_stream(stream, data1, sizeof(data1), 0, scratch, nullptr,
+                         nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    vector<char> buf(1024);
+    size_t used = 0;
+    err = hs_compress_stream(nullptr, buf.data(), buf.size(), &used);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_compress_stream(stream, buf.data(), buf.size(), nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_compress_stream(stream, nullptr, buf.size(), &used);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_compress_stream(stream, buf.data(), buf.size(), &used);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // truncated
+    err = hs_expand_stream(db, &stream2, buf.data(), used - 1);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(stream2 == nullptr);
+
+    // trailing junk
+    err = hs_expand_stream(db, &stream2, buf.data(), used + 1);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(stream2 == nullptr);
+
+    err = hs_expand_stream(db, nullptr, buf.data(), used);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_expand_stream(nullptr, &stream2, buf.data(), used);
+    ASSERT_NE(HS_SUCCESS, err);
+    err = hs_reset_and_expand_stream(nullptr, buf.data(), used, nullptr,
+                                     nullptr, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// Compress and expand the stream between every write and check that we get
+// the same matches as an uninterrupted stream.
+TEST(StreamUtil, compress_matches) {
+    const vector<pattern> patterns = {
+        pattern("foo.*bar", 0, 1),
+        pattern("a[^x]{5,10}b", 0, 2),
+        pattern("\\w+x\\d{3}", HS_FLAG_SOM_LEFTMOST, 3),
+        pattern("^abc", 0, 4),
+        pattern("(hatstand|teakettle).*zz[a-f]{2,}", 0, 5),
+        pattern("[0-9]{4}y$", 0, 6),
+    };
+    hs_database_t *db = buildDB(patterns, HS_MODE_STREAM |
+                                              HS_MODE_SOM_HORIZON_LARGE);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const vector<string> writes = {
+        "abcfo", "obaaaa", "aabqqx", "123fo", "o hat", "standzzab", "cdef",
+        "aq bar", "x1234x", "", "56", "78y",
+    };
+
+    CallBackContext c1, c2;
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    for (const auto &w : writes) {
+        err = hs_scan_stream(stream, w.c_str(), w.size(), 0, scratch,
+                             record_cb, (void *)&c1);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c1);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    size_t stream_size = 0;
+    err = hs_stream_size(db, &stream_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    vector<char> buf(stream_size * 2);
+    for (const auto &w : writes) {
+        err = hs_scan_stream(stream, w.c_str(), w.size(), 0, scratch,
+                             record_cb, (void *)&c2);
+        ASSERT_EQ(HS_SUCCESS, err);
+
+        size_t used = 0;
+        err = hs_compress_stream(stream, buf.data(), buf.size(), &used);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_GE(stream_size, used);
+        err = hs_close_stream(stream, nullptr, nullptr, nullptr);
+        ASSERT_EQ(HS_SUCCESS, err);
+
+        stream = nullptr;
+        err = hs_expand_stream(db, &stream, buf.data(), used);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_TRUE(stream != nullptr);
+    }
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c2);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_FALSE(c1.matches.empty());
+    ASSERT_EQ(c1.matches, c2.matches);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
 static size_t last_alloc;
 
 static
@@ -581,6 +902,115 @@ void *wrap_m(size_t s) {
     return malloc(s);
 }
 
+TEST(StreamUtil, serialize) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    err = hs_scan_stream(stream, data1, 6, 0, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, c.matches.size());
+
+    size_t used = 0;
+    err = hs_serialize_stream(db, stream, nullptr, 0, &used);
+    ASSERT_EQ(HS_INSUFFICIENT_SPACE, err);
+
+    vector<char> buf(used);
+    size_t used2 = 0;
+    err = hs_serialize_stream(db, stream, buf.data(), buf.size(), &used2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(used, used2);
+
+    // move the database, as if to another node
+    char *bytes = nullptr;
+    size_t length = 0;
+    err = hs_serialize_database(db, &bytes, &length);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_database_t *db2 = nullptr;
+    err = hs_deserialize_database(bytes, length, &db2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    free(bytes);
+    err = hs_alloc_scratch(db2, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream2 = nullptr;
+    err = hs_deserialize_stream(db2, buf.data(), buf.size(), &stream2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream2 != nullptr);
+
+    // the flow carries on where it left off
+    err = hs_scan_stream(stream2, data1 + 6, 3, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(9, 0), c.matches[0]);
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    hs_close_stream(stream2, scratch, nullptr, nullptr);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+    hs_free_database(db2);
+}
+
+TEST(StreamUtil, serialize_bad) {
+    hs_error_t err;
+    hs_database_t *db = buildDB("foo.*bar", 0, 0, HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr);
+    hs_database_t *db2 = buildDB("foo.*baz", 0, 0, HS_MODE_STREAM);
+    ASSERT_TRUE(db2 != nullptr);
+
+    hs_stream_t *stream = nullptr, *stream2 = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    vector<char> buf(1024);
+    size_t used = 0;
+
+    // the stream must belong to the database given
+    err = hs_serialize_stream(db2, stream, buf.data(), buf.size(), &used);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_serialize_stream(db, nullptr, buf.data(), buf.size(), &used);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_serialize_stream(db, stream, buf.data(), buf.size(), nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_serialize_stream(db, stream, buf.data(), buf.size(), &used);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // a different database is refused
+    err = hs_deserialize_stream(db2, buf.data(), used, &stream2);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(stream2 == nullptr);
+
+    // truncated, trailing junk, not a stream
+    err = hs_deserialize_stream(db, buf.data(), used - 1, &stream2);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_deserialize_stream(db, buf.data(), used + 1, &stream2);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_deserialize_stream(db, buf.data(), 3, &stream2);
+    ASSERT_EQ(HS_INVALID, err);
+    buf[0] ^= 1;
+    err = hs_deserialize_stream(db, buf.data(), used, &stream2);
+    ASSERT_EQ(HS_INVALID, err);
+    ASSERT_TRUE(stream2 == nullptr);
+
+    err = hs_deserialize_stream(db, nullptr, used, &stream2);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_deserialize_stream(db, buf.data(), used, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    hs_close_stream(stream, nullptr, nullptr, nullptr);
+    hs_free_database(db);
+    hs_free_database(db2);
+}
+
 TEST(StreamUtil, size) {
     hs_error_t err;
     hs_scratch_t *scratch = nullptr;
@@ -823,4 +1253,1288 @@ TEST(StreamUtil, StreamAllocUsage) {
     ASSERT_EQ(0, alloc3_called);
 }
 
+
+TEST(StreamPool, OpenClose) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_set_stream_allocator(my_alloc2, my_free2);
+    alloc2_called = 0;
+
+    hs_stream_pool_t *pool = nullptr;
+    err = hs_alloc_stream_pool(db, 2, &pool);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(pool != nullptr);
+    ASSERT_EQ(1, alloc2_called);
+
+    size_t stream_size = 0, pool_size = 0;
+    err = hs_stream_size(db, &stream_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_stream_pool_size(pool, &pool_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_LE(2 * stream_size, pool_size);
+
+    hs_stream_t *s1 = nullptr, *s2 = nullptr, *s3 = nullptr;
+    err = hs_open_stream_from_pool(pool, 0, &s1);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_open_stream_from_pool(pool, 0, &s2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(s1 != nullptr);
+    ASSERT_TRUE(s2 != nullptr);
+    ASSERT_NE(s1, s2);
+    ASSERT_EQ(0U, ((size_t)s1 | (size_t)s2) % 64);
+
+    // pool is now empty
+    err = hs_open_stream_from_pool(pool, 0, &s3);
+    ASSERT_EQ(HS_NOMEM, err);
+    ASSERT_TRUE(s3 == nullptr);
+
+    CallBackContext c, c2;
+    err = hs_scan_stream(s1, data1, sizeof(data1), 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(s2, data1, 3, 0, scratch, record_cb2,
+                         (void *)&c2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(9, 0), c.matches[0]);
+    ASSERT_EQ(0U, c2.matches.size());
+
+    err = hs_close_stream_to_pool(pool, s1, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // closing twice is an error
+    err = hs_close_stream_to_pool(pool, s1, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_INVALID, err);
+
+    // reopened stream is reinitialised
+    err = hs_open_stream_from_pool(pool, 0, &s3);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(s1, s3);
+    c.matches.clear();
+    err = hs_scan_stream(s3, data1, 3, 0, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, c.matches.size());
+
+    // the other stream is unaffected
+    err = hs_scan_stream(s2, data1 + 3, sizeof(data1) - 3, 0, scratch,
+                         record_cb2, (void *)&c2);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c2.matches.size());
+    ASSERT_EQ(MatchRecord(1009, 0), c2.matches[0]);
+
+    // no further allocations were made
+    ASSERT_EQ(1, alloc2_called);
+
+    err = hs_free_stream_pool(pool);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0, alloc2_called);
+
+    hs_set_stream_allocator(nullptr, nullptr);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamPool, BulkOpenReset) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar$", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    const unsigned int N = 4;
+    hs_stream_pool_t *pool = nullptr;
+    err = hs_alloc_stream_pool(db, N, &pool);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // all or nothing
+    hs_stream_t *streams[N + 1];
+    err = hs_open_stream_bulk(pool, 0, N + 1, streams);
+    ASSERT_EQ(HS_NOMEM, err);
+
+    err = hs_open_stream_bulk(pool, 0, N, streams);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c[N];
+    void *ctxts[N];
+    for (unsigned int i = 0; i < N; i++) {
+        ctxts[i] = &c[i];
+        // only even streams see the whole match
+        size_t len = i % 2 ? 4 : sizeof(data1) - 1;
+        err = hs_scan_stream(streams[i], data1, len, 0, scratch, record_cb,
+                             ctxts[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_EQ(0U, c[i].matches.size());
+    }
+
+    // EOD matches are delivered with each stream's context
+    err = hs_reset_stream_bulk(streams, N, 0, scratch, record_cb, ctxts);
+    ASSERT_EQ(HS_SUCCESS, err);
+    for (unsigned int i = 0; i < N; i++) {
+        if (i % 2) {
+            ASSERT_EQ(0U, c[i].matches.size());
+        } else {
+            ASSERT_EQ(1U, c[i].matches.size());
+            ASSERT_EQ(MatchRecord(9, 0), c[i].matches[0]);
+        }
+        c[i].matches.clear();
+    }
+
+    // streams are back at offset zero
+    for (unsigned int i = 0; i < N; i++) {
+        err = hs_scan_stream(streams[i], data1 + 3, 6, 0, scratch, record_cb,
+                             ctxts[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    err = hs_reset_stream_bulk(streams, N, 0, scratch, record_cb, ctxts);
+    ASSERT_EQ(HS_SUCCESS, err);
+    for (unsigned int i = 0; i < N; i++) {
+        ASSERT_EQ(1U, c[i].matches.size());
+        ASSERT_EQ(MatchRecord(6, 0), c[i].matches[0]);
+    }
+
+    for (unsigned int i = 0; i < N; i++) {
+        err = hs_close_stream_to_pool(pool, streams[i], nullptr, nullptr,
+                                      nullptr);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    err = hs_free_stream_pool(pool);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamPool, BadArgs) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+    hs_database_t *bdb = buildDB("foo.*bar", 0, 0, HS_MODE_BLOCK);
+    ASSERT_TRUE(bdb != nullptr);
+
+    hs_stream_pool_t *pool = nullptr, *pool2 = nullptr;
+    err = hs_alloc_stream_pool(bdb, 1, &pool);
+    ASSERT_EQ(HS_DB_MODE_ERROR, err);
+    ASSERT_TRUE(pool == nullptr);
+    err = hs_alloc_stream_pool(db, 0, &pool);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_alloc_stream_pool(nullptr, 1, &pool);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_alloc_stream_pool(db, 1, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_alloc_stream_pool(db, 1, &pool);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_alloc_stream_pool(db, 1, &pool2);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr, *other = nullptr;
+    err = hs_open_stream_from_pool(pool, 0, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_open_stream_from_pool(nullptr, 0, &stream);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_open_stream_bulk(pool, 0, 1, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_open_stream_from_pool(pool, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_open_stream(db, 0, &other);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // streams must be returned to the pool they came from
+    err = hs_close_stream_to_pool(pool2, stream, nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_close_stream_to_pool(pool, other, nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_close_stream_to_pool(pool, nullptr, nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    // scratch is required if a callback is given
+    CallBackContext c;
+    err = hs_close_stream_to_pool(pool, stream, nullptr, record_cb,
+                                  (void *)&c);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_reset_stream_bulk(nullptr, 1, 0, nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    hs_stream_t *bulk[] = {stream, nullptr};
+    err = hs_reset_stream_bulk(bulk, 2, 0, nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    bulk[1] = other;
+    err = hs_reset_stream_bulk(bulk, 2, 0, scratch, record_cb, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_stream_pool_size(pool, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    size_t pool_size = 0;
+    err = hs_stream_pool_size(nullptr, &pool_size);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_close_stream_to_pool(pool, stream, scratch, record_cb,
+                                  (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_close_stream(other, scratch, nullptr, nullptr);
+
+    ASSERT_EQ(HS_SUCCESS, hs_free_stream_pool(pool));
+    ASSERT_EQ(HS_SUCCESS, hs_free_stream_pool(pool2));
+    ASSERT_EQ(HS_SUCCESS, hs_free_stream_pool(nullptr));
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+    hs_free_database(bdb);
+}
+
+TEST(StreamCheckpoint, Rollback) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foobar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_checkpoint_t *ckpt = nullptr;
+    err = hs_alloc_stream_checkpoint(db, &ckpt);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(ckpt != nullptr);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    err = hs_scan_stream(stream, "xxfoo", 5, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_checkpoint_stream(stream, ckpt);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Data scanned after the checkpoint, including its history, is forgotten
+    // on rollback.
+    err = hs_scan_stream(stream, "qqqqqqqqqq", 10, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_rollback_stream(stream, ckpt);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_scan_stream(stream, "bar", 3, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(8, 0), c.matches[0]);
+
+    // The checkpoint can be used again.
+    err = hs_rollback_stream(stream, ckpt);
+    ASSERT_EQ(HS_SUCCESS, err);
+    c.clear();
+    err = hs_scan_stream(stream, "bar", 3, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(8, 0), c.matches[0]);
+
+    err = hs_close_stream(stream, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(HS_SUCCESS, hs_free_stream_checkpoint(ckpt));
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamCheckpoint, BadArgs) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+    hs_database_t *db2 = buildDB("foo.*baz", 0, 0, HS_MODE_STREAM);
+    ASSERT_TRUE(db2 != nullptr);
+    hs_database_t *bdb = buildDB("foo.*bar", 0, 0, HS_MODE_BLOCK);
+    ASSERT_TRUE(bdb != nullptr);
+
+    hs_stream_checkpoint_t *ckpt = nullptr;
+    err = hs_alloc_stream_checkpoint(bdb, &ckpt);
+    ASSERT_EQ(HS_DB_MODE_ERROR, err);
+    err = hs_alloc_stream_checkpoint(nullptr, &ckpt);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_alloc_stream_checkpoint(db, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_alloc_stream_checkpoint(db, &ckpt);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr, *other = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_open_stream(db2, 0, &other);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // nothing recorded yet
+    err = hs_rollback_stream(stream, ckpt);
+    ASSERT_EQ(HS_INVALID, err);
+
+    // checkpoints are tied to their database
+    err = hs_checkpoint_stream(other, ckpt);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_checkpoint_stream(stream, ckpt);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_rollback_stream(other, ckpt);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_checkpoint_stream(nullptr, ckpt);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_rollback_stream(stream, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    hs_close_stream(other, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, hs_free_stream_checkpoint(ckpt));
+    ASSERT_EQ(HS_SUCCESS, hs_free_stream_checkpoint(nullptr));
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+    hs_free_database(db2);
+    hs_free_database(bdb);
+}
+
+TEST(StreamStore, Tiers) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    // one resident stream for three flows
+    hs_stream_store_t *store = nullptr;
+    err = hs_alloc_stream_store(db, 1, &store);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(store != nullptr);
+
+    unsigned int flow[3];
+    for (unsigned int i = 0; i < 3; i++) {
+        err = hs_store_open_stream(store, 0, &flow[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    ASSERT_NE(flow[0], flow[1]);
+    ASSERT_NE(flow[1], flow[2]);
+
+    hs_stream_store_info_t stats;
+    err = hs_stream_store_stats(store, &stats);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, stats.hot);
+    ASSERT_EQ(0U, stats.warm);
+    ASSERT_EQ(2U, stats.cold);
+    ASSERT_EQ(2U, stats.compressions);
+
+    // each flow sees only its own data, however often it is evicted
+    CallBackContext c[3];
+    for (unsigned int i = 0; i < 3; i++) {
+        err = hs_store_scan_stream(store, flow[i], data1, 4, 0, scratch,
+                                   record_cb, (void *)&c[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+        err = hs_store_scan_stream(store, flow[i], data1 + 4,
+                                   sizeof(data1) - 4, 0, scratch, record_cb,
+                                   (void *)&c[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ASSERT_EQ(1U, c[i].matches.size());
+        ASSERT_EQ(MatchRecord(9, 0), c[i].matches[0]);
+    }
+
+    // the resident flow goes warm, then cold
+    err = hs_store_compact(store, 1);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_stream_store_stats(store, &stats);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, stats.hot);
+    ASSERT_EQ(1U, stats.warm);
+    ASSERT_EQ(2U, stats.cold);
+
+    err = hs_store_compact(store, 1);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_stream_store_stats(store, &stats);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, stats.warm);
+    ASSERT_EQ(3U, stats.cold);
+    ASSERT_EQ(0U, stats.resident_bytes);
+    ASSERT_LT(0U, stats.cold_bytes);
+    ASSERT_LE(stats.cold_bytes, stats.arena_bytes);
+
+    // closing a cold flow without a callback does not expand it
+    unsigned long long expansions = stats.expansions;
+    err = hs_store_close_stream(store, flow[0], nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_stream_store_stats(store, &stats);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(expansions, stats.expansions);
+    ASSERT_EQ(2U, stats.cold);
+
+    // closed flows are invalid
+    err = hs_store_scan_stream(store, flow[0], data1, sizeof(data1), 0,
+                               scratch, record_cb, (void *)&c[0]);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_store_close_stream(store, flow[0], nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    err = hs_store_close_stream(store, flow[1], scratch, record_cb,
+                                (void *)&c[1]);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_free_stream_store(store);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamStore, ExpandReportsEod) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar$", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_store_t *store = nullptr;
+    err = hs_alloc_stream_store(db, 4, &store);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    unsigned int flow;
+    err = hs_store_open_stream(store, 0, &flow);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    err = hs_store_scan_stream(store, flow, data1, sizeof(data1) - 1, 0,
+                               scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, c.matches.size());
+
+    err = hs_store_compact(store, 0);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_store_info_t stats;
+    err = hs_stream_store_stats(store, &stats);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, stats.cold);
+
+    // the EOD match survives compression
+    err = hs_store_close_stream(store, flow, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    ASSERT_EQ(MatchRecord(9, 0), c.matches[0]);
+
+    err = hs_stream_store_stats(store, &stats);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, stats.cold);
+    ASSERT_EQ(1U, stats.expansions);
+
+    err = hs_free_stream_store(store);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamStore, BadArgs) {
+    hs_error_t err;
+    hs_database_t *db = buildDB("foo.*bar", 0, 0, HS_MODE_STREAM);
+    ASSERT_TRUE(db != nullptr);
+    hs_database_t *bdb = buildDB("foo.*bar", 0, 0, HS_MODE_BLOCK);
+    ASSERT_TRUE(bdb != nullptr);
+
+    hs_stream_store_t *store = nullptr;
+    err = hs_alloc_stream_store(bdb, 1, &store);
+    ASSERT_NE(HS_SUCCESS, err);
+    ASSERT_TRUE(store == nullptr);
+    err = hs_alloc_stream_store(db, 0, &store);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_alloc_stream_store(db, 1, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_alloc_stream_store(db, 1, &store);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    unsigned int flow = 0;
+    err = hs_store_open_stream(nullptr, 0, &flow);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_store_open_stream(store, 0, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_store_scan_stream(store, 0, data1, sizeof(data1), 0, nullptr,
+                               nullptr, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_store_compact(nullptr, 0);
+    ASSERT_EQ(HS_INVALID, err);
+    err = hs_stream_store_stats(store, nullptr);
+    ASSERT_EQ(HS_INVALID, err);
+
+    ASSERT_EQ(HS_SUCCESS, hs_free_stream_store(store));
+    ASSERT_EQ(HS_SUCCESS, hs_free_stream_store(nullptr));
+    hs_free_database(db);
+    hs_free_database(bdb);
+}
+
+TEST(StreamUtil, partial1) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    const string data = "xxfooxxxbarxxbarfoxobar";
+    CallBackContext c;
+    const char *p = data.c_str();
+    unsigned int remaining = data.size();
+    unsigned int calls = 0;
+    while (remaining) {
+        unsigned int consumed = 0;
+        err = hs_scan_stream_partial(stream, p, remaining, 0, 4, scratch,
+                                     record_cb, (void *)&c, &consumed);
+        calls++;
+        ASSERT_EQ(min(remaining, 4U), consumed);
+        p += consumed;
+        remaining -= consumed;
+        ASSERT_EQ(remaining ? HS_SCAN_YIELD : HS_SUCCESS, err);
+    }
+    EXPECT_EQ(6U, calls);
+
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // The same matches as a single write.
+    ASSERT_EQ(3U, c.matches.size());
+    EXPECT_EQ(MatchRecord(11, 0), c.matches[0]);
+    EXPECT_EQ(MatchRecord(16, 0), c.matches[1]);
+    EXPECT_EQ(MatchRecord(23, 0), c.matches[2]);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, partialTerminate) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    c.halt = 1;
+    unsigned int consumed = 0;
+    err = hs_scan_stream_partial(stream, data1, sizeof(data1), 0, 100,
+                                 scratch, record_cb, (void *)&c, &consumed);
+    ASSERT_EQ(HS_SCAN_TERMINATED, err);
+    EXPECT_EQ(sizeof(data1), consumed);
+    ASSERT_EQ(1U, c.matches.size());
+
+    // Invalid budget and missing out-parameter.
+    err = hs_scan_stream_partial(stream, data1, sizeof(data1), 0, 0, scratch,
+                                 record_cb, (void *)&c, &consumed);
+    EXPECT_EQ(HS_INVALID, err);
+    err = hs_scan_stream_partial(stream, data1, sizeof(data1), 0, 4, scratch,
+                                 record_cb, (void *)&c, nullptr);
+    EXPECT_EQ(HS_INVALID, err);
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+struct TransformContext {
+    hs_transform_t *xf = nullptr;
+    vector<pair<unsigned long long, unsigned long long>> matches; // to, from
+};
+
+int transform_cb(unsigned, unsigned long long, unsigned long long to,
+                 unsigned, void *ctxt) {
+    TransformContext *c = (TransformContext *)ctxt;
+    unsigned long long from = ~0ULL;
+    hs_error_t err = hs_transform_map_offset(c->xf, to, &from);
+    EXPECT_EQ(HS_SUCCESS, err);
+    c->matches.push_back(make_pair(to, from));
+    return 0;
+}
+
+TEST(StreamUtil, transform1) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("select from", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    TransformContext c;
+    err = hs_alloc_transform(HS_TRANSFORM_URL_DECODE |
+                             HS_TRANSFORM_SQUEEZE_SPACE |
+                             HS_TRANSFORM_LOWERCASE, nullptr, nullptr, &c.xf);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(c.xf != nullptr);
+
+    // "xxSELECT%20%20 \t FROM", with escapes split between writes
+    const vector<string> writes = {"xxSEL", "ECT%2", "0%20 \t FR", "OM"};
+    for (size_t i = 0; i < writes.size(); i++) {
+        unsigned int flags = i + 1 == writes.size() ? HS_TRANSFORM_LAST : 0;
+        err = hs_scan_stream_transformed(stream, c.xf, writes[i].c_str(),
+                                         writes[i].size(), flags, scratch,
+                                         transform_cb, &c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    // matched as "xxselect from"
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(13ULL, c.matches[0].first);
+    EXPECT_EQ(21ULL, c.matches[0].second);
+
+    // a partial escape at the end is scanned as it is
+    err = hs_reset_stream(stream, 0, nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_reset_transform(c.xf);
+    ASSERT_EQ(HS_SUCCESS, err);
+    c.matches.clear();
+    const string data = "select%20from%4";
+    err = hs_scan_stream_transformed(stream, c.xf, data.c_str(), data.size(),
+                                     HS_TRANSFORM_LAST, scratch, transform_cb,
+                                     &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(11ULL, c.matches[0].first);
+    EXPECT_EQ(13ULL, c.matches[0].second);
+    unsigned long long from = 0;
+    err = hs_transform_map_offset(c.xf, 13, &from);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(15ULL, from);
+    err = hs_transform_map_offset(c.xf, 14, &from);
+    EXPECT_EQ(HS_INVALID, err);
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    err = hs_free_transform(c.xf);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, transformLong) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("xabc", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    TransformContext c;
+    err = hs_alloc_transform(HS_TRANSFORM_URL_DECODE | HS_TRANSFORM_LOWERCASE,
+                             nullptr, nullptr, &c.xf);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // one write spanning several blocks, with matches either side of them
+    string data;
+    vector<pair<unsigned long long, unsigned long long>> expected;
+    unsigned long long out = 0;
+    for (size_t i = 0; i < 8; i++) {
+        data += string(5000 + i * 11, 'X');
+        out += 5000 + i * 11;
+        data += "%61Bc";
+        out += 3;
+        expected.push_back(make_pair(out, (unsigned long long)data.size()));
+    }
+
+    err = hs_scan_stream_transformed(stream, c.xf, data.c_str(), data.size(),
+                                     HS_TRANSFORM_LAST, scratch, transform_cb,
+                                     &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(expected, c.matches);
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    hs_free_transform(c.xf);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+size_t drop_dashes(const char *in, size_t in_len, char *out,
+                   unsigned int *map, void *) {
+    size_t len = 0;
+    for (size_t i = 0; i < in_len; i++) {
+        if (in[i] != '-') {
+            out[len] = in[i];
+            map[len] = i + 1;
+            len++;
+        }
+    }
+    return len;
+}
+
+TEST(StreamUtil, transformCustom) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("abc", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // custom transform after a built-in one
+    TransformContext c;
+    err = hs_alloc_transform(HS_TRANSFORM_URL_DECODE, drop_dashes, nullptr,
+                             &c.xf);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data = "--a-%62--c-";
+    err = hs_scan_stream_transformed(stream, c.xf, data.c_str(), data.size(),
+                                     HS_TRANSFORM_LAST, scratch, transform_cb,
+                                     &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(3ULL, c.matches[0].first);
+    EXPECT_EQ(10ULL, c.matches[0].second);
+
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    hs_free_transform(c.xf);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, transformBadArgs) {
+    hs_transform_t *xf = nullptr;
+    EXPECT_EQ(HS_INVALID, hs_alloc_transform(0, nullptr, nullptr, &xf));
+    EXPECT_EQ(HS_INVALID, hs_alloc_transform(0x100, nullptr, nullptr, &xf));
+    EXPECT_EQ(HS_INVALID, hs_alloc_transform(HS_TRANSFORM_LOWERCASE, nullptr,
+                                             nullptr, nullptr));
+    EXPECT_EQ(HS_SUCCESS, hs_free_transform(nullptr));
+
+    hs_error_t err = hs_alloc_transform(HS_TRANSFORM_LOWERCASE, nullptr,
+                                        nullptr, &xf);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(HS_INVALID, hs_scan_stream_transformed(nullptr, xf, "a", 1, 0,
+                                                     nullptr, nullptr,
+                                                     nullptr));
+    unsigned long long from;
+    EXPECT_EQ(HS_INVALID, hs_transform_map_offset(xf, 1, &from));
+    EXPECT_EQ(HS_INVALID, hs_transform_map_offset(xf, 0, nullptr));
+    hs_free_transform(xf);
+}
+
+TEST(StreamUtil, vector1) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Segments small enough to gather, then one large enough that they are
+    // not all gathered.
+    const string big = string(4000, 'x') + "bar";
+    const vector<string> writes[] = {
+        {"xxfo", "", "oxxxb", "arxx"},
+        {"bar", big, "foxo", "bar"},
+    };
+
+    CallBackContext c;
+    for (const auto &segs : writes) {
+        vector<const char *> data;
+        vector<unsigned int> len;
+        for (const auto &seg : segs) {
+            data.push_back(seg.c_str());
+            len.push_back(seg.size());
+        }
+        err = hs_scan_stream_vector(stream, data.data(), len.data(),
+                                    data.size(), 0, scratch, record_cb,
+                                    (void *)&c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    err = hs_scan_stream_vector(stream, nullptr, nullptr, 1, 0, scratch,
+                                nullptr, nullptr);
+    EXPECT_EQ(HS_INVALID, err);
+
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(4U, c.matches.size());
+    EXPECT_EQ(MatchRecord(11, 0), c.matches[0]);
+    EXPECT_EQ(MatchRecord(16, 0), c.matches[1]);
+    EXPECT_EQ(MatchRecord(4019, 0), c.matches[2]);
+    EXPECT_EQ(MatchRecord(4026, 0), c.matches[3]);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, window1) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_set_stream_window(stream, 12, 11);
+    EXPECT_EQ(HS_INVALID, err);
+    err = hs_set_stream_window(stream, 5, 11);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Matches end at 3, 7, 11, 15 and 19; the second write crosses the end of
+    // the window, and the third is past it.
+    const string data = "foo.foo.foo.foo.foo";
+    CallBackContext c;
+    err = hs_scan_stream(stream, data.c_str(), 9, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, data.c_str() + 9, 8, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, data.c_str() + 17, 2, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(2U, c.matches.size());
+    EXPECT_EQ(MatchRecord(7, 0), c.matches[0]);
+    EXPECT_EQ(MatchRecord(11, 0), c.matches[1]);
+
+    // A reset stream has no window.
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_set_stream_window(stream, 0, 3);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_reset_stream(stream, 0, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    c.matches.clear();
+    err = hs_scan_stream(stream, data.c_str(), data.size(), 0, scratch,
+                         record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(5U, c.matches.size());
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, coalesced1) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream_coalesced(db, 0, 8, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(stream != nullptr);
+
+    // Writes are held back until eight bytes have been written.
+    CallBackContext c;
+    const string data = "xxfooxxxbarxxbarfoxobar";
+    for (size_t i = 0; i < 11; i++) {
+        err = hs_scan_stream(stream, data.c_str() + i, 1, 0, scratch,
+                             record_cb, (void *)&c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    EXPECT_TRUE(c.matches.empty());
+
+    err = hs_flush_stream(stream, 0, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(11, 0), c.matches[0]);
+
+    // A write too large to buffer is scanned at once, after the rest.
+    err = hs_scan_stream(stream, data.c_str() + 11, 2, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, data.c_str() + 13, 10, 0, scratch,
+                         record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    err = hs_close_stream(stream, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // The same matches as a single write.
+    ASSERT_EQ(3U, c.matches.size());
+    EXPECT_EQ(MatchRecord(16, 0), c.matches[1]);
+    EXPECT_EQ(MatchRecord(23, 0), c.matches[2]);
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, coalescedCopy) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foo.*bar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream_coalesced(db, 0, 64, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    err = hs_scan_stream(stream, "xfoox", 5, 0, scratch, record_cb,
+                         (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Buffered data cannot be compressed, but it is copied.
+    size_t len = 0;
+    err = hs_compress_stream(stream, nullptr, 0, &len);
+    EXPECT_EQ(HS_INVALID, err);
+
+    hs_stream_t *copy = nullptr;
+    err = hs_copy_stream(&copy, stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // Nor can it be copied into a stream with no room for it.
+    hs_stream_t *plain = nullptr;
+    err = hs_open_stream(db, 0, &plain);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_reset_and_copy_stream(plain, stream, nullptr, nullptr, nullptr);
+    EXPECT_EQ(HS_INVALID, err);
+
+    err = hs_scan_stream(copy, "bar", 3, 0, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(copy, scratch, record_cb, (void *)&c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.matches.size());
+    EXPECT_EQ(MatchRecord(8, 0), c.matches[0]);
+
+    // Resetting the original drops its buffered data.
+    err = hs_reset_stream(stream, 0, nullptr, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_compress_stream(stream, nullptr, 0, &len);
+    EXPECT_EQ(HS_INSUFFICIENT_SPACE, err);
+
+    hs_close_stream(plain, scratch, nullptr, nullptr);
+    hs_close_stream(stream, scratch, nullptr, nullptr);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
+// A burst may mix streams from several databases sharing one scratch.
+TEST(StreamUtil, batchTwoDatabases) {
+    hs_error_t err;
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db1 = buildDBAndScratch("foo.*bar", 0, 1, HS_MODE_STREAM,
+                                           &scratch);
+    hs_database_t *db2 = buildDB("baz[0-9]+qux", 0, 2, HS_MODE_STREAM);
+    ASSERT_TRUE(db2 != nullptr);
+    err = hs_alloc_scratch(db2, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const hs_database_t *dbs[] = {db1, db2, db1, db2};
+    hs_stream_t *ids[4];
+    CallBackContext c[4];
+    void *ctx[4];
+    for (size_t i = 0; i < 4; i++) {
+        err = hs_open_stream(dbs[i], 0, &ids[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+        ctx[i] = &c[i];
+    }
+
+    const vector<vector<string>> bursts = {
+        {"xxfoo", "baz1", "foo", "ba"},
+        {"bar", "2qux", "xbar", "z3qux"},
+    };
+    for (const auto &burst : bursts) {
+        const char *data[4];
+        unsigned int len[4];
+        for (size_t i = 0; i < 4; i++) {
+            data[i] = burst[i].c_str();
+            len[i] = burst[i].size();
+        }
+        err = hs_scan_stream_batch(ids, data, len, 4, 0, scratch, record_cb,
+                                   ctx);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        err = hs_close_stream(ids[i], scratch, record_cb, ctx[i]);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    // Each stream matches across the two bursts.
+    const MatchRecord expected[] = {MatchRecord(8, 1), MatchRecord(8, 2),
+                                    MatchRecord(7, 1), MatchRecord(7, 2)};
+    for (size_t i = 0; i < 4; i++) {
+        ASSERT_EQ(1U, c[i].matches.size());
+        EXPECT_EQ(expected[i], c[i].matches[0]);
+    }
+
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db1);
+    hs_free_database(db2);
+}
+
+TEST(StreamUtil, exhaustedGroups) {
+    // Once the single-match patterns have fired, their literals can be
+    // turned off for the rest of the stream; the other pattern keeps matching.
+    vector<pattern> patterns;
+    patterns.push_back(pattern("foo", HS_FLAG_SINGLEMATCH, 1));
+    patterns.push_back(pattern("bar\\d+x", HS_FLAG_SINGLEMATCH, 2));
+    patterns.push_back(pattern("baz", 0, 3));
+    hs_database_t *db = buildDB(patterns, HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    const string data("foo bar12x baz ");
+    CallBackContext c;
+    for (size_t round = 0; round < 2; round++) {
+        c.clear();
+        for (size_t i = 0; i < 3; i++) {
+            err = hs_scan_stream(stream, data.c_str(), data.size(), 0, scratch,
+                                 record_cb, &c);
+            ASSERT_EQ(HS_SUCCESS, err);
+        }
+
+        ASSERT_EQ(5U, c.matches.size());
+        EXPECT_EQ(MatchRecord(3, 1), c.matches[0]);
+        EXPECT_EQ(MatchRecord(10, 2), c.matches[1]);
+        EXPECT_EQ(MatchRecord(14, 3), c.matches[2]);
+        EXPECT_EQ(MatchRecord(29, 3), c.matches[3]);
+        EXPECT_EQ(MatchRecord(44, 3), c.matches[4]);
+
+        // A reset stream can match the single-match patterns again.
+        err = hs_reset_stream(stream, 0, scratch, record_cb, &c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+
+    err = hs_close_stream(stream, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, pastMaxMatchOffset) {
+    // Every pattern is bounded, so nothing can match once the stream has
+    // passed offset 20.
+    hs_expr_ext ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.flags = HS_EXT_FLAG_MAX_OFFSET;
+    ext.max_offset = 20;
+    vector<pattern> patterns;
+    patterns.push_back(pattern("^foo\\d{0,3}bar", 0, 1));
+    patterns.push_back(pattern("abc", 0, 2, ext));
+    patterns.push_back(pattern("^foo$", 0, 3));
+    hs_database_t *db = buildDB(patterns, HS_MODE_STREAM);
+    ASSERT_NE(nullptr, db);
+
+    hs_scratch_t *scratch = nullptr;
+    hs_error_t err = hs_alloc_scratch(db, &scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    hs_stream_t *stream = nullptr;
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    CallBackContext c;
+    const char *writes[] = {"foo12bar", "xxabc", "abcabcabcabc", "abcabc"};
+    for (const char *w : writes) {
+        err = hs_scan_stream(stream, w, strlen(w), 0, scratch, record_cb, &c);
+        ASSERT_EQ(HS_SUCCESS, err);
+    }
+    err = hs_close_stream(stream, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    ASSERT_EQ(4U, c.matches.size());
+    EXPECT_EQ(MatchRecord(8, 1), c.matches[0]);
+    EXPECT_EQ(MatchRecord(13, 2), c.matches[1]);
+    EXPECT_EQ(MatchRecord(16, 2), c.matches[2]);
+    EXPECT_EQ(MatchRecord(19, 2), c.matches[3]);
+
+    // An end-anchored match is not raised once the stream has moved past it.
+    c.clear();
+    err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, "foo", 3, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    const string pad(20, 'x');
+    err = hs_scan_stream(stream, pad.c_str(), pad.size(), 0, scratch,
+                         record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, "x", 1, 0, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_close_stream(stream, scratch, record_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(0U, c.matches.size());
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+}
+
+TEST(StreamUtil, database_memory) {
+    const char *expr[] = {"hatstand.*teakettle", "foo[^\\n]{20,40}bar",
+                          "^badger"};
+    const unsigned flags[] = {0, 0, 0};
+    const unsigned ids[] = {1, 2, 3};
+    hs_database_t *db = nullptr;
+    hs_compile_error_t *c_err = nullptr;
+    hs_error_t err = hs_compile_multi(expr, flags, ids, 3, HS_MODE_STREAM,
+                                      nullptr, &db, &c_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+
+    hs_db_memory_t mem;
+    err = hs_database_memory(db, &mem);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    size_t db_size = 0;
+    err = hs_database_size(db, &db_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(db_size, mem.total);
+
+    size_t stream_size = 0;
+    err = hs_stream_size(db, &stream_size);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(stream_size, mem.stream_state);
+
+    // The parts add up to no more than the whole.
+    size_t bytes = mem.program_bytes + mem.lookaround_bytes
+                 + mem.small_write_bytes;
+    size_t state = mem.rose_state;
+    size_t engines = 0;
+    for (size_t i = 0; i < HS_DB_ENGINE_COUNT; i++) {
+        bytes += mem.engine_bytes[i];
+        state += mem.engine_state[i];
+        engines += mem.engine_count[i];
+        if (!mem.engine_count[i]) {
+            EXPECT_EQ(0U, mem.engine_bytes[i]);
+            EXPECT_EQ(0U, mem.engine_state[i]);
+        }
+    }
+    for (size_t i = 0; i < HS_DB_MATCHER_COUNT; i++) {
+        bytes += mem.matcher_bytes[i];
+        state += mem.matcher_state[i];
+    }
+    EXPECT_LT(0U, engines);
+    EXPECT_LT(0U, mem.program_bytes);
+    EXPECT_GE(mem.total, bytes);
+    EXPECT_EQ(mem.stream_state, state);
+
+    // Block mode databases have no stream state.
+    hs_free_database(db);
+    db = nullptr;
+    err = hs_compile_multi(expr, flags, ids, 3, HS_MODE_BLOCK, nullptr, &db,
+                           &c_err);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_TRUE(db != nullptr);
+    err = hs_database_memory(db, &mem);
+    ASSERT_EQ(HS_SUCCESS, err);
+    EXPECT_EQ(0U, mem.stream_state);
+    EXPECT_EQ(0U, mem.rose_state);
+    for (size_t i = 0; i < HS_DB_ENGINE_COUNT; i++) {
+        EXPECT_EQ(0U, mem.engine_state[i]);
+    }
+
+    hs_free_database(db);
+}
+
+
+struct MatchDataContext {
+    hs_scratch_t *scratch = nullptr;
+    unsigned long long back = 0; //!< bytes before each match end to ask for
+    vector<hs_error_t> errs;
+    vector<string> seen;
+};
+
+int match_data_cb(unsigned, unsigned long long, unsigned long long to,
+                  unsigned, void *ctxt) {
+    MatchDataContext *c = (MatchDataContext *)ctxt;
+    const char *hist = nullptr, *data = nullptr;
+    size_t hist_len = 0, data_len = 0;
+    hs_error_t err = hs_get_match_data(c->scratch, to - c->back, to, &hist,
+                                       &hist_len, &data, &data_len);
+    c->errs.push_back(err);
+    if (err == HS_SUCCESS) {
+        string s;
+        if (hist) {
+            s.append(hist, hist_len);
+        }
+        if (data) {
+            s.append(data, data_len);
+        }
+        c->seen.push_back(s);
+    }
+    return 0;
+}
+
+TEST(StreamUtil, matchData) {
+    hs_scratch_t *scratch = nullptr;
+    hs_database_t *db = buildDBAndScratch("foobar", 0, 0, HS_MODE_STREAM,
+                                          &scratch);
+
+    hs_stream_t *stream = nullptr;
+    hs_error_t err = hs_open_stream(db, 0, &stream);
+    ASSERT_EQ(HS_SUCCESS, err);
+
+    // The match spans two writes, so its start is in stream history.
+    MatchDataContext c;
+    c.scratch = scratch;
+    c.back = 6;
+    const string pad(1000, 'x');
+    const string write1 = pad + "foo";
+    err = hs_scan_stream(stream, write1.c_str(), write1.size(), 0, scratch,
+                         match_data_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_scan_stream(stream, "barfoobar", 9, 0, scratch, match_data_cb,
+                         &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(2U, c.errs.size());
+    ASSERT_EQ(2U, c.seen.size());
+    EXPECT_EQ("foobar", c.seen[0]);
+    EXPECT_EQ("foobar", c.seen[1]);
+
+    // Data long gone from the stream is not available.
+    c = MatchDataContext();
+    c.scratch = scratch;
+    c.back = 1000;
+    err = hs_scan_stream(stream, "foobar", 6, 0, scratch, match_data_cb, &c);
+    ASSERT_EQ(HS_SUCCESS, err);
+    ASSERT_EQ(1U, c.errs.size());
+    EXPECT_EQ(HS_DATA_UNAVAILABLE, c.errs[0]);
+
+    // Nor is anything outside a callback.
+    const char *hist = nullptr, *data = nullptr;
+    size_t hist_len = 0, data_len = 0;
+    err = hs_get_match_data(scratch, 0, 1, &hist, &hist_len, &data,
+                            &data_len);
+    EXPECT_EQ(HS_DATA_UNAVAILABLE, err);
+    err = hs_get_match_data(nullptr, 0, 1, &hist, &hist_len, &data,
+                            &data_len);
+    EXPECT_EQ(HS_INVALID, err);
+
+    err = hs_close_stream(stream, scratch, nullptr, nullptr);
+    ASSERT_EQ(HS_SUCCESS, err);
+    err = hs_free_scratch(scratch);
+    ASSERT_EQ(HS_SUCCESS, err);
+    hs_free_database(db);
+}
+
 }
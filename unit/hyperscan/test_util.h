@@ -49,6 +49,9 @@ struct MatchRecord {
     bool operator==(const MatchRecord &o) const {
         return to == o.to && id == o.id;
     }
+    bool operator<(const MatchRecord &o) const {
+        return to < o.to || (to == o.to && id < o.id);
+    }
     unsigned long long to;
     int id;
 };
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+extern "C" {
+#include "nfa/accel.h"
+}
+
+#include "config.h"
+
+#include "gtest/gtest.h"
+#include "nfa/accelcompile.h"
+#include "util/charreach.h"
+#include "util/compare.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace ue2;
+
+static
+vector<CharReach> toLiteral(const string &s, bool nocase = false) {
+    vector<CharReach> rv;
+    for (char c : s) {
+        CharReach cr(c);
+        if (nocase) {
+            cr.set(mytolower(c));
+            cr.set(mytoupper(c));
+        }
+        rv.push_back(cr);
+    }
+    return rv;
+}
+
+static
+AccelAux buildAux(const vector<vector<CharReach>> &lits) {
+    AccelAux aux;
+    memset(&aux, 0, sizeof(aux));
+    bool ok = buildLiteralAccel(lits, &aux);
+    EXPECT_TRUE(ok);
+    EXPECT_EQ(ACCEL_LITERAL, aux.accel_type);
+    return aux;
+}
+
+TEST(LiteralAccel, BuildFail) {
+    AccelAux aux;
+    memset(&aux, 0, sizeof(aux));
+
+    // single bytes are left to the single-byte schemes
+    EXPECT_FALSE(buildLiteralAccel({toLiteral("a"), toLiteral("c")}, &aux));
+
+    // an empty literal would match everywhere
+    EXPECT_FALSE(buildLiteralAccel({toLiteral("ab"), {}}, &aux));
+}
+
+TEST(LiteralAccel, Single) {
+    AccelAux aux = buildAux({toLiteral("-->")});
+
+    const size_t len = 128;
+    string buf(len, 'x');
+    for (size_t i = 0; i + 3 <= len; i++) {
+        string t = buf;
+        t.replace(i, 3, "-->");
+        const u8 *c = (const u8 *)t.c_str();
+        for (size_t start = 0; start <= i; start++) {
+            const u8 *rv = run_accel(&aux, c + start, c + len);
+            if (c + start + 15 + 2 >= c + len) {
+                // too short to accelerate
+                ASSERT_EQ(c + start, rv);
+            } else {
+                ASSERT_EQ(c + i, rv);
+            }
+        }
+    }
+}
+
+TEST(LiteralAccel, NoMatch) {
+    AccelAux aux = buildAux({toLiteral("-->")});
+
+    // partial literals, including one cut off by the end of the buffer
+    string t;
+    for (u32 i = 0; i < 10; i++) {
+        t += "x--x->-";
+    }
+    t += "--";
+    const u8 *c = (const u8 *)t.c_str();
+    const u8 *c_end = c + t.size();
+    for (size_t start = 0; start + 18 < t.size(); start++) {
+        ASSERT_EQ(c_end - 2, run_accel(&aux, c + start, c_end));
+    }
+}
+
+TEST(LiteralAccel, Multiple) {
+    AccelAux aux = buildAux({toLiteral("abc"), toLiteral("xyz", true),
+                             toLiteral("foo")});
+
+    const string t = string(50, '.') + "XyZ" + string(20, '.') + "abc" +
+                     string(20, '.') + "foo" + string(20, '.');
+    const u8 *c = (const u8 *)t.c_str();
+    const u8 *c_end = c + t.size();
+    EXPECT_EQ(c + 50, run_accel(&aux, c, c_end));
+    EXPECT_EQ(c + 73, run_accel(&aux, c + 51, c_end));
+    EXPECT_EQ(c + 96, run_accel(&aux, c + 74, c_end));
+    EXPECT_EQ(c_end - 2, run_accel(&aux, c + 97, c_end));
+}
+
+TEST(LiteralAccel, Classes) {
+    // a byte class in the middle, and literals of different lengths
+    CharReach digit('0', '9');
+    AccelAux aux = buildAux({{CharReach('<'), digit, CharReach('>')},
+                             toLiteral("%%")});
+
+    const string t = string(30, 'a') + "<x>" + string(30, 'a') + "<7>" +
+                     string(30, 'a') + "%%" + string(30, 'a');
+    const u8 *c = (const u8 *)t.c_str();
+    const u8 *c_end = c + t.size();
+    EXPECT_EQ(c + 63, run_accel(&aux, c, c_end));
+    EXPECT_EQ(c + 96, run_accel(&aux, c + 64, c_end));
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "config.h"
+
+#include "gtest/gtest.h"
+#include "rose/catchup_pq.h"
+#include "scratch.h"
+#include "ue2common.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct CatchupPQ {
+    explicit CatchupPQ(u32 num_queues) : qm(num_queues) {
+        pq.qm = qm.data();
+        catchupPqReset(&pq);
+    }
+
+    vector<queue_match> qm;
+    catchup_pq pq;
+};
+
+} // namespace
+
+TEST(catchup_pq, empty) {
+    CatchupPQ c(4);
+    EXPECT_EQ(0U, c.pq.qm_size);
+}
+
+TEST(catchup_pq, single) {
+    CatchupPQ c(4);
+    catchupPqInsert(&c.pq, 2, 100);
+    ASSERT_EQ(1U, c.pq.qm_size);
+    EXPECT_EQ(100U, catchupPqMinLoc(&c.pq));
+    EXPECT_EQ(2U, catchupPqTop(&c.pq)->queue);
+    EXPECT_EQ(500U, catchupPqSecondLoc(&c.pq, 500));
+    catchupPqPop(&c.pq);
+    EXPECT_EQ(0U, c.pq.qm_size);
+}
+
+TEST(catchup_pq, ties) {
+    CatchupPQ c(4);
+    catchupPqInsert(&c.pq, 0, 7);
+    catchupPqInsert(&c.pq, 1, 7);
+    catchupPqInsert(&c.pq, 2, 9);
+    EXPECT_EQ(7U, catchupPqMinLoc(&c.pq));
+    EXPECT_EQ(7U, catchupPqSecondLoc(&c.pq, 100));
+    catchupPqPop(&c.pq);
+    EXPECT_EQ(7U, catchupPqMinLoc(&c.pq));
+    EXPECT_EQ(9U, catchupPqSecondLoc(&c.pq, 100));
+    EXPECT_EQ(8U, catchupPqSecondLoc(&c.pq, 8));
+    catchupPqPop(&c.pq);
+    EXPECT_EQ(2U, catchupPqTop(&c.pq)->queue);
+}
+
+/* Mimics catch up: the top queue is repeatedly advanced to a later location
+ * or removed, with occasional insertions, checked against a reference. */
+TEST(catchup_pq, randomCatchup) {
+    const u32 num_queues = 50;
+    mt19937 rng(1234);
+
+    for (u32 trial = 0; trial < 100; trial++) {
+        CatchupPQ c(num_queues);
+        vector<pair<size_t, u32>> ref; // (loc, queue)
+        vector<u32> idle;
+
+        for (u32 q = 0; q < num_queues; q++) {
+            if (rng() % 2) {
+                size_t loc = 1 + rng() % 10000;
+                catchupPqInsert(&c.pq, q, loc);
+                ref.emplace_back(loc, q);
+            } else {
+                idle.push_back(q);
+            }
+        }
+
+        while (!ref.empty()) {
+            ASSERT_EQ(ref.size(), c.pq.qm_size);
+            sort(ref.begin(), ref.end());
+            size_t min_loc = ref[0].first;
+            ASSERT_EQ(min_loc, catchupPqMinLoc(&c.pq));
+
+            const queue_match *top = catchupPqTop(&c.pq);
+            ASSERT_EQ(min_loc, top->loc);
+            u32 qi = top->queue;
+            auto it = find(ref.begin(), ref.end(), make_pair(min_loc, qi));
+            ASSERT_TRUE(it != ref.end());
+
+            size_t limit = min_loc + rng() % 2000;
+            size_t expected_second = ref.size() > 1
+                                         ? min(ref[1].first, limit) : limit;
+            ASSERT_EQ(expected_second, catchupPqSecondLoc(&c.pq, limit));
+
+            u32 action = rng() % 4;
+            if (action == 0) {
+                catchupPqPop(&c.pq);
+                ref.erase(it);
+                idle.push_back(qi);
+            } else {
+                size_t loc = min_loc + rng() % 3000;
+                catchupPqReplaceTop(&c.pq, qi, loc);
+                it->first = loc;
+            }
+
+            /* queues joining late may land before the current minimum */
+            if (!idle.empty() && rng() % 8 == 0) {
+                u32 q = idle.back();
+                idle.pop_back();
+                size_t loc = 1 + rng() % 12000;
+                catchupPqInsert(&c.pq, q, loc);
+                ref.emplace_back(loc, q);
+            }
+        }
+        ASSERT_EQ(0U, c.pq.qm_size);
+    }
+}
+
+TEST(catchup_pq, rebase) {
+    CatchupPQ c(8);
+    catchupPqInsert(&c.pq, 0, 1000);
+    catchupPqInsert(&c.pq, 1, 2000);
+    catchupPqInsert(&c.pq, 2, 3000);
+    catchupPqReplaceTop(&c.pq, 0, 2500);
+    EXPECT_EQ(2000U, catchupPqMinLoc(&c.pq));
+    EXPECT_EQ(1U, catchupPqTop(&c.pq)->queue);
+
+    /* insert before the current minimum */
+    catchupPqInsert(&c.pq, 3, 10);
+    EXPECT_EQ(10U, catchupPqMinLoc(&c.pq));
+
+    const size_t expected[][2] = {{10, 3}, {2000, 1}, {2500, 0}, {3000, 2}};
+    for (const auto &e : expected) {
+        const queue_match *top = catchupPqTop(&c.pq);
+        EXPECT_EQ(e[0], top->loc);
+        EXPECT_EQ(e[1], top->queue);
+        catchupPqPop(&c.pq);
+    }
+    EXPECT_EQ(0U, c.pq.qm_size);
+}
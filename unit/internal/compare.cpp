@@ -30,6 +30,8 @@
 #include "gtest/gtest.h"
 #include "util/compare.h"
 #include <ctype.h>
+#include <cstring>
+#include <string>
 
 using namespace std;
 using namespace testing;
@@ -102,6 +104,44 @@ TEST_P(compare, their64) {
 
 }
 
+TEST_P(compare, upper128) {
+    u8 c = (u8)GetParam();
+    u8 cu = (u8)toupper(c);
+
+    u8 in[16];
+    u8 expected[16];
+    for (u32 i = 0; i < 16; i++) {
+        in[i] = i % 2 ? c : (u8)(c + i);
+        expected[i] = (u8)toupper(in[i]);
+    }
+    u8 out[16];
+    storeu128(out, toupper128(loadu128(in)));
+    EXPECT_EQ(0, memcmp(expected, out, 16));
+    EXPECT_EQ(cu, out[1]);
+}
+
+// Caseless compares of every length, with a mismatch at every position,
+// through the word, overlapping word and vector paths.
+TEST(compare, cmpForwardNocase) {
+    const string text = "Hatstand, TEAKETTLE & badgerbrush: 0123456789";
+    string upper = text;
+    for (auto &c : upper) {
+        c = mytoupper(c);
+    }
+    const u8 *s1 = (const u8 *)text.c_str();
+    const u8 *s2 = (const u8 *)upper.c_str();
+
+    for (size_t len = 0; len <= text.size(); len++) {
+        EXPECT_EQ(0, cmpForward(s1, s2, len, 1));
+        for (size_t i = 0; i < len; i++) {
+            string bad = upper.substr(0, len);
+            bad[i] ^= 0x01;
+            EXPECT_EQ(1, cmpForward(s1, (const u8 *)bad.c_str(), len, 1));
+            EXPECT_EQ(1, cmpForward((const u8 *)bad.c_str(),
+                                    (const u8 *)upper.c_str(), len, 0));
+        }
+    }
+}
 
 INSTANTIATE_TEST_CASE_P(compare, compare, Range((int)0, (int)256));
 
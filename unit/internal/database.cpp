@@ -51,6 +51,14 @@ TEST(DB, flagsToPlatform) {
     p.cpu_features |= HS_CPU_FEATURES_AVX2;
 #endif
 
+#if defined(__AVX512BW__)
+    p.cpu_features |= HS_CPU_FEATURES_AVX512;
+#endif
+
+#if defined(__AVX512VBMI__)
+    p.cpu_features |= HS_CPU_FEATURES_AVX512VBMI;
+#endif
+
     platform_t pp = target_to_platform(target_t(p));
     ASSERT_EQ(pp, hs_current_platform);
 }
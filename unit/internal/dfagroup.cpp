@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include "gtest/gtest.h"
+
+#include "grey.h"
+#include "compiler/compiler.h"
+#include "nfa/dfagroupcompile.h"
+#include "nfa/mcclellancompile.h"
+#include "nfa/nfa_api.h"
+#include "nfa/nfa_api_util.h"
+#include "nfa/nfa_internal.h"
+#include "nfa/rdfa.h"
+#include "nfagraph/ng.h"
+#include "nfagraph/ng_mcclellan.h"
+#include "nfagraph/ng_util.h"
+#include "util/alloc.h"
+#include "util/target_info.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace testing;
+using namespace ue2;
+
+static const char *const groupExprs[] = {
+    "a[ab]{4}c",   // 8-bit McClellan
+    "a[ab]{9}c",   // 16-bit McClellan
+    "b[^c]{3}a",
+    "ca|ba[ab]c",
+};
+
+static const size_t NUM_EXPRS = sizeof(groupExprs) / sizeof(groupExprs[0]);
+
+static
+int onMatch(u64a, u64a to, ReportID id, void *ctx) {
+    vector<pair<u64a, ReportID>> *matches
+        = (vector<pair<u64a, ReportID>> *)ctx;
+    matches->push_back(make_pair(to, id));
+    return MO_CONTINUE_MATCHING;
+}
+
+class DfaGroupTest : public TestWithParam<size_t> {
+protected:
+    virtual void SetUp() {
+        size_t num = GetParam();
+        ASSERT_LE(num, NUM_EXPRS);
+
+        CompileContext cc(false, false, get_current_target(), Grey());
+        ReportManager rm(cc.grey);
+
+        for (size_t i = 0; i < num; i++) {
+            ParsedExpression parsed(0, groupExprs[i], 0, 0);
+            unique_ptr<NGWrapper> g = buildWrapper(rm, cc, parsed);
+            ASSERT_TRUE(g != nullptr);
+            clearReports(*g);
+            rm.setProgramOffset(0, i);
+
+            unique_ptr<raw_dfa> rdfa = buildMcClellan(*g, &rm, cc.grey);
+            ASSERT_TRUE(rdfa != nullptr);
+            auto nfa = mcclellanCompile(*rdfa, cc, rm);
+            ASSERT_TRUE(nfa != nullptr);
+            members.push_back(move(nfa));
+        }
+
+        vector<const NFA *> member_ptrs;
+        for (const auto &n : members) {
+            member_ptrs.push_back(n.get());
+        }
+        group = buildDfaGroup(member_ptrs);
+        ASSERT_TRUE(group != nullptr);
+        ASSERT_EQ(DFA_GROUP_NFA_0, group->type);
+
+        mt19937 prng(27);
+        for (u32 i = 0; i < 8192; i++) {
+            data += "abcx"[prng() % 4];
+        }
+    }
+
+    void initQueue(const NFA *nfa, char *full_state, char *stream_state,
+                   vector<pair<u64a, ReportID>> *matches) {
+        q.nfa = nfa;
+        q.cur = 0;
+        q.end = 0;
+        q.state = full_state;
+        q.streamState = stream_state;
+        q.offset = 0;
+        q.buffer = (const u8 *)data.c_str();
+        q.length = data.size();
+        q.history = nullptr;
+        q.hlength = 0;
+        q.scratch = nullptr;
+        q.report_current = 0;
+        q.cb = onMatch;
+        q.context = matches;
+    }
+
+    // Runs the whole of the scan data through the engine.
+    void scan(const NFA *nfa, vector<pair<u64a, ReportID>> *matches) {
+        auto full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+        auto stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+
+        initQueue(nfa, full_state.get(), stream_state.get(), matches);
+        nfaQueueInitState(nfa, &q);
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_TOP, 0);
+        pushQueue(&q, MQE_END, data.size());
+        nfaQueueExec(nfa, &q, data.size());
+    }
+
+    // Matches from running each member on its own, in the order the group
+    // should produce them.
+    vector<pair<u64a, ReportID>> expectedMatches() {
+        vector<pair<u64a, ReportID>> expected;
+        for (const auto &n : members) {
+            scan(n.get(), &expected);
+        }
+        sort(expected.begin(), expected.end());
+        return expected;
+    }
+
+    string data;
+    struct mq q;
+    vector<aligned_unique_ptr<NFA>> members;
+    aligned_unique_ptr<NFA> group;
+};
+
+INSTANTIATE_TEST_CASE_P(DfaGroup, DfaGroupTest,
+                        Range(size_t{2}, NUM_EXPRS + 1));
+
+TEST_P(DfaGroupTest, QueueExec) {
+    vector<pair<u64a, ReportID>> expected = expectedMatches();
+    ASSERT_FALSE(expected.empty());
+
+    vector<pair<u64a, ReportID>> matches;
+    scan(group.get(), &matches);
+    sort(matches.begin(), matches.end());
+    ASSERT_EQ(expected, matches);
+}
+
+TEST_P(DfaGroupTest, QueueExecToMatch) {
+    const NFA *nfa = group.get();
+    vector<pair<u64a, ReportID>> expected = expectedMatches();
+
+    auto full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+    auto stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+    vector<pair<u64a, ReportID>> matches;
+
+    initQueue(nfa, full_state.get(), stream_state.get(), &matches);
+    nfaQueueInitState(nfa, &q);
+    pushQueue(&q, MQE_START, 0);
+    pushQueue(&q, MQE_TOP, 0);
+    pushQueue(&q, MQE_END, data.size());
+
+    while (nfaQueueExecToMatch(nfa, &q, data.size()) == MO_MATCHES_PENDING) {
+        ASSERT_NE(0, nfaInAnyAcceptState(nfa, &q));
+        nfaReportCurrentMatches(nfa, &q);
+    }
+
+    sort(matches.begin(), matches.end());
+    ASSERT_EQ(expected, matches);
+}
+
+TEST_P(DfaGroupTest, StreamExec) {
+    const NFA *nfa = group.get();
+    vector<pair<u64a, ReportID>> expected = expectedMatches();
+
+    auto full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+    auto stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+    vector<pair<u64a, ReportID>> matches;
+
+    initQueue(nfa, full_state.get(), stream_state.get(), &matches);
+    nfaInitCompressedState(nfa, 0, stream_state.get(), 0);
+
+    // Scan in uneven chunks, compressing and expanding state between them.
+    const size_t chunk_len = 37;
+    for (size_t off = 0; off < data.size(); off += chunk_len) {
+        size_t len = min(chunk_len, data.size() - off);
+        q.cur = 0;
+        q.end = 0;
+        q.offset = off;
+        q.buffer = (const u8 *)data.c_str() + off;
+        q.length = len;
+        nfaExpandState(nfa, full_state.get(), stream_state.get(), off, 0);
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_END, len);
+        nfaQueueExec(nfa, &q, len);
+        nfaQueueCompressState(nfa, &q, len);
+    }
+
+    sort(matches.begin(), matches.end());
+    ASSERT_EQ(expected, matches);
+}
@@ -37,6 +37,7 @@
 #include "fdr/teddy_compile.h"
 #include "fdr/teddy_engine_description.h"
 #include "util/alloc.h"
+#include "util/byte_freq.h"
 
 #include "database.h"
 #include "gtest/gtest.h"
@@ -45,6 +46,7 @@
 #include <array>
 #include <cmath>
 #include <fstream>
+#include <map>
 #include <boost/random.hpp>
 
 using namespace std;
@@ -129,6 +131,23 @@ hwlmcb_rv_t decentCallbackT(size_t start, size_t end, u32 id, void *ctxt) {
     return HWLM_TERMINATE_MATCHING;
 }
 
+struct GroupContext {
+    vector<match> matches;
+    hwlm_group_t groups;
+    map<u32, hwlm_group_t> groups_after; // new groups after a match of id
+};
+
+static
+hwlmcb_rv_t groupCallback(size_t start, size_t end, u32 id, void *ctxt) {
+    GroupContext *gc = (GroupContext *)ctxt;
+    gc->matches.push_back(match(start, end, id));
+    auto it = gc->groups_after.find(id);
+    if (it != gc->groups_after.end()) {
+        gc->groups = it->second;
+    }
+    return gc->groups;
+}
+
 } // extern "C"
 
 } // namespace
@@ -231,6 +250,33 @@ TEST_P(FDRp, MultiLocation) {
     }
 }
 
+TEST_P(FDRp, MultiLocationLengths) {
+    const u32 hint = GetParam();
+    SCOPED_TRACE(hint);
+
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("abc", 0, 1));
+    lits.push_back(hwlmLiteral("wxyz", 0, 2));
+
+    auto fdr = fdrBuildTableHinted(lits, false, hint, get_current_target(), Grey());
+    CHECK_WITH_TEDDY_OK_TO_FAIL(fdr, hint);
+
+    // Cover every split of a buffer between the wide and narrow main loops
+    // and the end zone.
+    for (u32 len = 20; len < 200; len++) {
+        vector<u8> data(len, 0);
+        for (u32 i = 0; i + 4 <= len; i += 5) {
+            memcpy(data.data() + i, "wxyz", 4);
+            vector<match> matches;
+            fdrExec(fdr.get(), data.data(), len, 0, decentCallback, &matches,
+                    HWLM_ALL_GROUPS);
+            ASSERT_EQ(1U, matches.size());
+            EXPECT_EQ(match(i, i + 3, 2), matches[0]);
+            memset(data.data() + i, 0, 4);
+        }
+    }
+}
+
 TEST_P(FDRp, Flood) {
     const u32 hint = GetParam();
     SCOPED_TRACE(hint);
@@ -334,6 +380,75 @@ TEST_P(FDRp, NoRepeat3) {
  * \brief Helper function wrapping the FDR streaming call that ensures it is
  * always safe to read 16 bytes before the end of the history buffer.
  */
+// Groups switched on or off by the callback must take effect for the very
+// next match, even within the same block of input.
+TEST_P(FDRp, GroupChanges) {
+    const u32 hint = GetParam();
+    SCOPED_TRACE(hint);
+
+    const char data[] = "abcxyzpqr";
+
+    vector<hwlmLiteral> lits = {
+        hwlmLiteral("abc", 0, 0, 0, 1, {}, {}),
+        hwlmLiteral("xyz", 0, 0, 1, 2, {}, {}),
+        hwlmLiteral("pqr", 0, 0, 2, 1, {}, {}) };
+
+    auto fdr = fdrBuildTableHinted(lits, false, hint, get_current_target(),
+                                   Grey());
+    CHECK_WITH_TEDDY_OK_TO_FAIL(fdr, hint);
+
+    // Group 2 is switched off by the match of "abc".
+    GroupContext gc1;
+    gc1.groups = 3;
+    gc1.groups_after[0] = 1;
+    fdrExec(fdr.get(), (const u8 *)data, sizeof(data) - 1, 0, groupCallback,
+            &gc1, gc1.groups);
+
+    ASSERT_EQ(2U, gc1.matches.size());
+    EXPECT_EQ(match(0, 2, 0), gc1.matches[0]);
+    EXPECT_EQ(match(6, 8, 2), gc1.matches[1]);
+
+    // Group 2 is switched on by the match of "abc".
+    GroupContext gc2;
+    gc2.groups = 1;
+    gc2.groups_after[0] = 3;
+    fdrExec(fdr.get(), (const u8 *)data, sizeof(data) - 1, 0, groupCallback,
+            &gc2, gc2.groups);
+
+    ASSERT_EQ(3U, gc2.matches.size());
+    EXPECT_EQ(match(0, 2, 0), gc2.matches[0]);
+    EXPECT_EQ(match(3, 5, 1), gc2.matches[1]);
+    EXPECT_EQ(match(6, 8, 2), gc2.matches[2]);
+}
+
+TEST_P(FDRp, GroupChangesDeadBuckets) {
+    const u32 hint = GetParam();
+    SCOPED_TRACE(hint);
+
+    const char data[] = "xyzxyzabcxyzxyz";
+
+    vector<hwlmLiteral> lits = {
+        hwlmLiteral("abc", 0, 0, 0, 1, {}, {}),
+        hwlmLiteral("xyz", 0, 0, 1, 2, {}, {}) };
+
+    auto fdr = fdrBuildTableHinted(lits, false, hint, get_current_target(),
+                                   Grey());
+    CHECK_WITH_TEDDY_OK_TO_FAIL(fdr, hint);
+
+    // "xyz" is in a group that is off until "abc" matches, and then off again
+    // after its first match.
+    GroupContext gc;
+    gc.groups = 1;
+    gc.groups_after[0] = 3;
+    gc.groups_after[1] = 1;
+    fdrExec(fdr.get(), (const u8 *)data, sizeof(data) - 1, 0, groupCallback,
+            &gc, gc.groups);
+
+    ASSERT_EQ(2U, gc.matches.size());
+    EXPECT_EQ(match(6, 8, 0), gc.matches[0]);
+    EXPECT_EQ(match(9, 11, 1), gc.matches[1]);
+}
+
 static
 hwlm_error_t safeExecStreaming(const FDR *fdr, const u8 *hbuf, size_t hlen,
                                const u8 *buf, size_t len, size_t start,
@@ -839,3 +954,99 @@ TEST(FDR, ManyLengths) {
 
     ASSERT_EQ(768U, matches.size());
 }
+
+TEST(FDR, ByteFrequencies) {
+    // Building with a byte frequency profile may change the bucketing and
+    // domain, but never the matches.
+    Grey grey;
+    grey.fdrAllowTeddy = false;
+
+    boost::random::mt19937 rng(42);
+    boost::random::uniform_int_distribution<> len_dist(1, 12);
+    boost::random::uniform_int_distribution<> char_dist('a', 'h');
+
+    vector<hwlmLiteral> lits;
+    for (u32 i = 0; i < 300; i++) {
+        string s;
+        u32 len = len_dist(rng);
+        for (u32 j = 0; j < len; j++) {
+            s.push_back(char_dist(rng));
+        }
+        lits.push_back(hwlmLiteral(s, i % 3 == 0, i));
+    }
+
+    // Traffic that is mostly 'a' and 'b'.
+    unsigned long long counts[256] = {0};
+    counts['a'] = 1000;
+    counts['b'] = 500;
+    counts['c'] = 10;
+    ByteFrequencies freq(counts);
+
+    auto fdr = fdrBuildTable(lits, false, get_current_target(), grey);
+    ASSERT_TRUE(fdr != nullptr);
+    auto fdr_freq = fdrBuildTable(lits, false, get_current_target(), grey,
+                                  nullptr, &freq);
+    ASSERT_TRUE(fdr_freq != nullptr);
+
+    string data;
+    for (u32 i = 0; i < 4096; i++) {
+        data.push_back(i % 7 ? 'a' + i % 3 : char_dist(rng));
+    }
+
+    vector<match> matches, matches_freq;
+    fdrExec(fdr.get(), (const u8 *)data.c_str(), data.size(), 0,
+            decentCallback, &matches, HWLM_ALL_GROUPS);
+    fdrExec(fdr_freq.get(), (const u8 *)data.c_str(), data.size(), 0,
+            decentCallback, &matches_freq, HWLM_ALL_GROUPS);
+
+    ASSERT_FALSE(matches.empty());
+    sort(matches.begin(), matches.end());
+    sort(matches_freq.begin(), matches_freq.end());
+    ASSERT_EQ(matches, matches_freq);
+}
+
+TEST(FDR, ConfirmFilter) {
+    // Enough literals that the confirm tables are built with a filter; check
+    // that it lets through every real match.
+    Grey grey;
+    grey.fdrAllowTeddy = false;
+
+    boost::random::mt19937 rng(17);
+    boost::random::uniform_int_distribution<> len_dist(3, 10);
+    boost::random::uniform_int_distribution<> char_dist('a', 'z');
+
+    vector<hwlmLiteral> lits;
+    for (u32 i = 0; i < 4000; i++) {
+        string s;
+        u32 len = len_dist(rng);
+        for (u32 j = 0; j < len; j++) {
+            s.push_back(char_dist(rng));
+        }
+        lits.push_back(hwlmLiteral(s, false, i));
+    }
+
+    auto fdr = fdrBuildTable(lits, false, get_current_target(), grey);
+    ASSERT_TRUE(fdr != nullptr);
+
+    string data;
+    for (u32 i = 0; i < lits.size(); i += 7) {
+        data += lits[i].s;
+        data.push_back(char_dist(rng));
+    }
+
+    vector<match> expected;
+    for (const auto &lit : lits) {
+        for (size_t pos = data.find(lit.s); pos != string::npos;
+             pos = data.find(lit.s, pos + 1)) {
+            expected.push_back(match(pos, pos + lit.s.size() - 1, lit.id));
+        }
+    }
+
+    vector<match> matches;
+    fdrExec(fdr.get(), (const u8 *)data.c_str(), data.size(), 0,
+            decentCallback, &matches, HWLM_ALL_GROUPS);
+
+    sort(expected.begin(), expected.end());
+    sort(matches.begin(), matches.end());
+    ASSERT_EQ(expected, matches);
+}
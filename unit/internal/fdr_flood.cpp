@@ -38,6 +38,11 @@
 #include "fdr/teddy_engine_description.h"
 #include "util/alloc.h"
 #include "util/bitutils.h"
+#include "util/compare.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -116,8 +121,42 @@ static hwlmcb_rv_t countCallback(UNUSED size_t start, UNUSED size_t end, u32 id,
     return HWLM_CONTINUE_MATCHING;
 }
 
+static hwlmcb_rv_t recordCallback(size_t start, size_t end, u32 id,
+                                  void *cntxt) {
+    vector<match> *matches = (vector<match> *)cntxt;
+    matches->push_back(match(start, end, id));
+    return HWLM_CONTINUE_MATCHING;
+}
+
 } // extern "C"
 
+// Brute force matches of the literals in data, in the order FDR reports them
+// after sorting by end offset.
+static vector<match> findMatches(const vector<hwlmLiteral> &lits,
+                                 const vector<u8> &data) {
+    vector<match> matches;
+    for (const auto &lit : lits) {
+        const size_t len = lit.s.length();
+        const size_t mlen = lit.msk.size();
+        for (size_t end = max(len, mlen) - 1; end < data.size(); end++) {
+            bool ok = true;
+            for (size_t i = 0; ok && i < len; i++) {
+                u8 a = data[end - i];
+                u8 b = lit.s[len - 1 - i];
+                ok = lit.nocase ? mytolower(a) == mytolower(b) : a == b;
+            }
+            for (size_t i = 0; ok && i < mlen; i++) {
+                u8 m = lit.msk[mlen - 1 - i];
+                ok = (data[end - i] & m) == (lit.cmp[mlen - 1 - i] & m);
+            }
+            if (ok) {
+                matches.push_back(match(end + 1 - len, end, lit.id));
+            }
+        }
+    }
+    return matches;
+}
+
 } // namespace
 
 static vector<u32> getValidFdrEngines() {
@@ -554,5 +593,78 @@ TEST_P(FDRFloodp, StreamingMask) {
     }
 }
 
+TEST_P(FDRFloodp, Periodic) {
+    const u32 hint = GetParam();
+    SCOPED_TRACE(hint);
+    const string unit = "qZ3x!aQ@";
+
+    for (u32 period = 2; period <= 8; period++) {
+        SCOPED_TRACE(period);
+
+        // Non-periodic lead-in and tail around a long flood of the given
+        // period.
+        vector<u8> data;
+        for (u32 i = 0; i < 100; i++) {
+            data.push_back('0' + (i * 7) % 43);
+        }
+        const size_t floodStart = data.size();
+        for (u32 i = 0; i < 2000; i++) {
+            data.push_back(unit[i % period]);
+        }
+        for (u32 i = 0; i < 100; i++) {
+            data.push_back('0' + (i * 5) % 41);
+        }
+
+        vector<hwlmLiteral> lits;
+        u32 id = 0;
+        for (u32 len : {1, 3, 9, 40}) {
+            for (u32 phase : {0U, period - 1}) {
+                string s(data.begin() + floodStart + phase,
+                         data.begin() + floodStart + phase + len);
+                lits.push_back(hwlmLiteral(s, false, id++));
+                s[0] = mytoupper(s[0]) == s[0] ? mytolower(s[0])
+                                               : mytoupper(s[0]);
+                lits.push_back(hwlmLiteral(s, true, id++));
+            }
+        }
+
+        // A literal whose mask extends back before it, matching the flood
+        // only at one phase.
+        vector<u8> msk(8, 0), cmp(8, 0);
+        msk[0] = 0xff;
+        cmp[0] = unit[0];
+        lits.push_back(hwlmLiteral(string(1, unit[7 % period]), false, false,
+                                   id++, HWLM_ALL_GROUPS, msk, cmp));
+
+        // Literals that straddle the start and end of the flood.
+        lits.push_back(hwlmLiteral(string(data.begin() + floodStart - 3,
+                                          data.begin() + floodStart + 12),
+                                   false, id++));
+        lits.push_back(hwlmLiteral(string(data.end() - 112, data.end() - 95),
+                                   false, id++));
+
+        auto fdr = fdrBuildTableHinted(lits, false, hint, get_current_target(),
+                                       Grey());
+        CHECK_WITH_TEDDY_OK_TO_FAIL(fdr, hint);
+
+        vector<match> matches;
+        hwlm_error_t fdrStatus = fdrExec(fdr.get(), data.data(), data.size(),
+                                         0, recordCallback, &matches,
+                                         HWLM_ALL_GROUPS);
+        ASSERT_EQ(0, fdrStatus);
+
+        // Matches must be delivered in order of end offset.
+        for (size_t i = 1; i < matches.size(); i++) {
+            ASSERT_LE(matches[i - 1].end, matches[i].end);
+        }
+
+        vector<match> expected = findMatches(lits, data);
+        sort(matches.begin(), matches.end());
+        sort(expected.begin(), expected.end());
+        ASSERT_EQ(expected.size(), matches.size());
+        ASSERT_TRUE(expected == matches);
+    }
+}
+
 INSTANTIATE_TEST_CASE_P(FDRFlood, FDRFloodp, ValuesIn(getValidFdrEngines()));
 
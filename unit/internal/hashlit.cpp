@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "config.h"
+
+#include "ue2common.h"
+#include "hwlm/hashlit_build.h"
+#include "hwlm/hashlit_engine.h"
+#include "hwlm/hashlit_internal.h"
+#include "hwlm/hwlm.h"
+#include "hwlm/hwlm_literal.h"
+#include "util/alloc.h"
+#include "util/ue2string.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace std;
+using namespace ue2;
+
+namespace {
+
+struct HashLitMatch {
+    size_t from;
+    size_t to;
+    u32 id;
+    HashLitMatch(size_t start, size_t end, u32 identifier)
+        : from(start), to(end), id(identifier) {}
+    bool operator<(const HashLitMatch &b) const {
+        return tie(to, from, id) < tie(b.to, b.from, b.id);
+    }
+    bool operator==(const HashLitMatch &b) const {
+        return tie(to, from, id) == tie(b.to, b.from, b.id);
+    }
+};
+
+typedef vector<HashLitMatch> HashLitMatchRecord;
+
+hwlmcb_rv_t recordMatch(size_t from, size_t to, u32 id, void *context) {
+    auto *mr = (HashLitMatchRecord *)context;
+    mr->push_back(HashLitMatch(from, to, id));
+    return HWLM_CONTINUE_MATCHING;
+}
+
+hwlmcb_rv_t terminateMatch(size_t from, size_t to, u32 id, void *context) {
+    recordMatch(from, to, id, context);
+    return HWLM_TERMINATE_MATCHING;
+}
+
+hwlmcb_rv_t group2Match(size_t from, size_t to, u32 id, void *context) {
+    recordMatch(from, to, id, context);
+    return 2;
+}
+
+/** \brief The matches of \a lits in \a data, found the slow way. */
+HashLitMatchRecord bruteForce(const string &data,
+                              const vector<hwlmLiteral> &lits) {
+    HashLitMatchRecord mr;
+    for (const auto &lit : lits) {
+        const size_t len = lit.s.length();
+        for (size_t i = 0; i + len <= data.size(); i++) {
+            bool match = lit.nocase
+                ? !cmp(data.c_str() + i, lit.s.c_str(), len, true)
+                : !memcmp(data.c_str() + i, lit.s.c_str(), len);
+            if (match) {
+                mr.push_back(HashLitMatch(i, i + len - 1, lit.id));
+            }
+        }
+    }
+    sort(mr.begin(), mr.end());
+    return mr;
+}
+
+/** \brief Checks that matches are in end offset order, then sorts them within
+ * each end offset for comparison. */
+void checkOrderAndSort(HashLitMatchRecord &mr) {
+    for (size_t i = 1; i < mr.size(); i++) {
+        ASSERT_LE(mr[i - 1].to, mr[i].to);
+    }
+    sort(mr.begin(), mr.end());
+}
+
+TEST(HashLit, Simple) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("evil.example.com", false, 1));
+    lits.push_back(hwlmLiteral("example.com", false, 2));
+    lits.push_back(hwlmLiteral("BAD.ORG", true, 3));
+    lits.push_back(hwlmLiteral("x.io", false, 4));
+
+    auto t = hashLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+    EXPECT_EQ(4U, t->count);
+    EXPECT_EQ(16U, t->max_len);
+
+    const string data = "get http://evil.example.com/ from bad.org, x.iox.IO";
+    HashLitMatchRecord mr;
+    hwlm_error_t rv = hashLitExec(t.get(), (const u8 *)data.c_str(),
+                                  data.size(), 0, recordMatch, &mr,
+                                  HWLM_ALL_GROUPS);
+    ASSERT_EQ(HWLM_SUCCESS, rv);
+
+    checkOrderAndSort(mr);
+    const HashLitMatch expected[] = {{11, 26, 1}, {16, 26, 2}, {34, 40, 3},
+                                     {43, 46, 4}};
+    ASSERT_EQ(ARRAY_LENGTH(expected), mr.size());
+    for (size_t i = 0; i < mr.size(); i++) {
+        EXPECT_EQ(expected[i], mr[i]);
+    }
+    EXPECT_EQ(bruteForce(data, lits), mr);
+}
+
+TEST(HashLit, TooShort) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("abcd", false, 1));
+    lits.push_back(hwlmLiteral("abc", false, 2));
+    EXPECT_TRUE(hashLitBuildTable(lits) == nullptr);
+}
+
+TEST(HashLit, Random) {
+    mt19937 prng(17);
+    const string alphabet = "abcdeABCDE.-/";
+    auto randomString = [&](size_t len) {
+        string s;
+        for (size_t i = 0; i < len; i++) {
+            s.push_back(alphabet[prng() % alphabet.size()]);
+        }
+        return s;
+    };
+
+    // A small alphabet, so that literals share keys and buckets.
+    vector<hwlmLiteral> lits;
+    for (u32 i = 0; i < 2000; i++) {
+        size_t len = HASHLIT_MIN_LEN + prng() % 12;
+        lits.push_back(hwlmLiteral(randomString(len), prng() % 2, i));
+    }
+
+    auto t = hashLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+
+    string data;
+    for (u32 i = 0; i < 200; i++) {
+        const auto &lit = lits[prng() % lits.size()];
+        data += randomString(prng() % 8) + lit.s;
+    }
+    const auto expected = bruteForce(data, lits);
+    ASSERT_FALSE(expected.empty());
+
+    // Scan at every alignment and from a few starting points, to cover the
+    // blocks and the scalar head and tail.
+    for (size_t align = 0; align < 16; align++) {
+        string padded = string(align, 'z') + data;
+        HashLitMatchRecord mr;
+        hwlm_error_t rv = hashLitExec(t.get(), (const u8 *)padded.c_str() +
+                                      align, data.size(), 0, recordMatch, &mr,
+                                      HWLM_ALL_GROUPS);
+        ASSERT_EQ(HWLM_SUCCESS, rv);
+        checkOrderAndSort(mr);
+        EXPECT_EQ(expected, mr);
+    }
+}
+
+TEST(HashLit, Groups) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("aaaa", false, false, 1, 1, {}, {}));
+    lits.push_back(hwlmLiteral("aaaaaaaa", false, false, 2, 2, {}, {}));
+
+    auto t = hashLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+
+    const string data(32, 'a');
+    HashLitMatchRecord mr;
+    hwlm_error_t rv = hashLitExec(t.get(), (const u8 *)data.c_str(),
+                                  data.size(), 0, group2Match, &mr, 2);
+    ASSERT_EQ(HWLM_SUCCESS, rv);
+    ASSERT_EQ(data.size() - 7, mr.size());
+    for (const auto &m : mr) {
+        EXPECT_EQ(2U, m.id);
+    }
+}
+
+TEST(HashLit, Terminate) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("abcdef", false, 1));
+
+    auto t = hashLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+
+    const string data = "abcdef abcdef abcdef abcdef abcdef";
+    HashLitMatchRecord mr;
+    hwlm_error_t rv = hashLitExec(t.get(), (const u8 *)data.c_str(),
+                                  data.size(), 0, terminateMatch, &mr,
+                                  HWLM_ALL_GROUPS);
+    ASSERT_EQ(HWLM_TERMINATED, rv);
+    ASSERT_EQ(1U, mr.size());
+    EXPECT_EQ(5U, mr[0].to);
+}
+
+TEST(HashLit, Streaming) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("malware.net", false, 1));
+    lits.push_back(hwlmLiteral("WARE", true, 2));
+
+    auto t = hashLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+
+    const string hist = "xxxxmalw";
+    const string data = "are.net malware.net";
+    u8 temp_buf[64];
+    HashLitMatchRecord mr;
+    hwlm_error_t rv = hashLitExecStreaming(t.get(), (const u8 *)hist.c_str(),
+                                           hist.size(),
+                                           (const u8 *)data.c_str(),
+                                           data.size(), recordMatch, &mr,
+                                           HWLM_ALL_GROUPS, temp_buf,
+                                           sizeof(temp_buf));
+    ASSERT_EQ(HWLM_SUCCESS, rv);
+
+    // Matches spanning the boundary start before the new data.
+    const HashLitMatch expected[] = {{(size_t)-1, 2, 2}, {(size_t)-4, 6, 1},
+                                     {11, 14, 2}, {8, 18, 1}};
+    ASSERT_EQ(ARRAY_LENGTH(expected), mr.size());
+    for (size_t i = 0; i < mr.size(); i++) {
+        EXPECT_EQ(expected[i].from, mr[i].from);
+        EXPECT_EQ(expected[i].to, mr[i].to);
+        EXPECT_EQ(expected[i].id, mr[i].id);
+    }
+}
+
+} // namespace
@@ -31,15 +31,18 @@
 
 #include "grey.h"
 #include "compiler/compiler.h"
+#include "nfa/limex_cache.h"
 #include "nfa/limex_context.h"
 #include "nfa/limex_internal.h"
 #include "nfa/nfa_api.h"
 #include "nfa/nfa_api_util.h"
+#include "nfa/nfa_build_util.h"
 #include "nfa/nfa_internal.h"
 #include "nfagraph/ng.h"
 #include "nfagraph/ng_limex.h"
 #include "nfagraph/ng_restructuring.h"
 #include "nfagraph/ng_util.h"
+#include "scratch.h"
 #include "util/alloc.h"
 #include "util/target_info.h"
 
@@ -131,7 +134,7 @@ protected:
 
 INSTANTIATE_TEST_CASE_P(
     LimEx, LimExModelTest,
-    Range((int)LIMEX_NFA_32, (int)LIMEX_NFA_512));
+    Range((int)LIMEX_NFA_32, (int)LIMEX_NFA_1024 + 1));
 
 TEST_P(LimExModelTest, StateSize) {
     ASSERT_TRUE(nfa != nullptr);
@@ -164,6 +167,33 @@ TEST_P(LimExModelTest, QueueExec) {
     ASSERT_EQ(3, matches);
 }
 
+TEST_P(LimExModelTest, QueueExecManyTops) {
+    ASSERT_TRUE(nfa != nullptr);
+    initQueue();
+    nfaQueueInitState(nfa.get(), &q);
+
+    // A run of tops longer than the old queue length, pushed in one go and
+    // run in a single exec call.
+    const u32 num_tops = 20;
+    vector<mq_item> tops(num_tops);
+    for (u32 i = 0; i < num_tops; i++) {
+        tops[i].type = MQE_TOP;
+        tops[i].location = i;
+        tops[i].som = 0;
+    }
+
+    u64a end = SCAN_DATA.size();
+    pushQueue(&q, MQE_START, 0);
+    ASSERT_LE(num_tops + 1, q_space(&q));
+    pushQueueItems(&q, tops.data(), num_tops);
+    ASSERT_EQ(num_tops + 1, q.end);
+    pushQueue(&q, MQE_END, end);
+
+    nfaQueueExec(nfa.get(), &q, end);
+
+    ASSERT_EQ(3, matches);
+}
+
 TEST_P(LimExModelTest, CompressExpand) {
     ASSERT_TRUE(nfa != nullptr);
 
@@ -298,6 +328,34 @@ TEST_P(LimExModelTest, CheckFinalState) {
     ASSERT_EQ(MO_CONTINUE_MATCHING, rv);
 }
 
+// Wider models of the same graph are never estimated to be cheaper.
+TEST_P(LimExModelTest, ScanCost) {
+    ASSERT_TRUE(nfa != nullptr);
+
+    hs_platform_info plat;
+    hs_error_t err = hs_populate_platform(&plat);
+    ASSERT_EQ(HS_SUCCESS, err);
+    target_t target(plat);
+
+    CompileContext cc(false, false, target, Grey());
+    ReportManager rm(cc.grey);
+    ParsedExpression parsed(0, "(foo.*bar)|end\\z", 0, 0);
+    unique_ptr<NGWrapper> g = buildWrapper(rm, cc, parsed);
+    ASSERT_TRUE(g != nullptr);
+    clearReports(*g);
+    rm.setProgramOffset(0, MATCH_REPORT);
+
+    const map<u32, u32> fixed_depth_tops;
+    const map<u32, vector<vector<CharReach>>> triggers;
+    auto narrow = constructNFA(*g, &rm, fixed_depth_tops, triggers, false,
+                               LIMEX_NFA_32, cc);
+    ASSERT_TRUE(narrow != nullptr);
+
+    u32 cost = estimated_scan_cost(*nfa, target);
+    EXPECT_LT(0U, cost);
+    EXPECT_LE(estimated_scan_cost(*narrow, target), cost);
+}
+
 // For testing the _B_Reverse backwards-scanning block-mode path.
 class LimExReverseTest : public TestWithParam<int> {
 protected:
@@ -337,7 +395,7 @@ protected:
 };
 
 INSTANTIATE_TEST_CASE_P(LimExReverse, LimExReverseTest,
-                        Range((int)LIMEX_NFA_32, (int)LIMEX_NFA_512));
+                        Range((int)LIMEX_NFA_32, (int)LIMEX_NFA_1024 + 1));
 
 TEST_P(LimExReverseTest, BlockExecReverse) {
     ASSERT_TRUE(nfa != nullptr);
@@ -424,7 +482,7 @@ protected:
 };
 
 INSTANTIATE_TEST_CASE_P(LimExZombie, LimExZombieTest,
-                        Range((int)LIMEX_NFA_32, (int)LIMEX_NFA_512));
+                        Range((int)LIMEX_NFA_32, (int)LIMEX_NFA_1024 + 1));
 
 TEST_P(LimExZombieTest, GetZombieStatus) {
     ASSERT_TRUE(nfa != nullptr);
@@ -448,3 +506,132 @@ TEST_P(LimExZombieTest, GetZombieStatus) {
     // The .* at the end of the pattern should have turned us into a zombie...
     ASSERT_EQ(NFA_ZOMBIE_ALWAYS_YES, nfaGetZombieStatus(nfa.get(), &q, end));
 }
+
+// Test the lazy DFA cache path, with the NFA forced to use the cache.
+class LimExLazyDfaTest : public TestWithParam<int> {
+protected:
+    virtual void SetUp() {
+        type = GetParam();
+        matches = 0;
+
+        const string expr = "(foo.*bar)|end\\z";
+        const unsigned flags = 0;
+        Grey grey;
+        grey.limexLazyDfaMinStates = 1;
+        CompileContext cc(false, false, get_current_target(), grey);
+        ReportManager rm(cc.grey);
+        ParsedExpression parsed(0, expr.c_str(), flags, 0);
+        unique_ptr<NGWrapper> g = buildWrapper(rm, cc, parsed);
+        ASSERT_TRUE(g != nullptr);
+        clearReports(*g);
+
+        rm.setProgramOffset(0, MATCH_REPORT);
+
+        const map<u32, u32> fixed_depth_tops;
+        const map<u32, vector<vector<CharReach>>> triggers;
+        bool compress_state = false;
+
+        nfa = constructNFA(*g, &rm, fixed_depth_tops, triggers, compress_state,
+                           type, cc);
+        ASSERT_TRUE(nfa != nullptr);
+
+        full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+        stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+
+        // LimEx only needs the cache from scratch.
+        scratch = aligned_zmalloc_unique<hs_scratch>(sizeof(hs_scratch));
+        cache = aligned_zmalloc_unique<limex_dfa_cache>(
+            sizeof(limex_dfa_cache));
+        limexCacheReset(cache.get(), nullptr);
+        scratch->limex_cache = cache.get();
+    }
+
+    virtual void initQueue() {
+        q.nfa = nfa.get();
+        q.cur = 0;
+        q.end = 0;
+        q.state = full_state.get();
+        q.streamState = stream_state.get();
+        q.offset = 0;
+        q.buffer = (const u8 *)SCAN_DATA.c_str();
+        q.length = SCAN_DATA.size();
+        q.history = nullptr;
+        q.hlength = 0;
+        q.scratch = scratch.get();
+        q.report_current = 0;
+        q.cb = onMatch;
+        q.context = &matches;
+    }
+
+    // NFA type (enum NFAEngineType)
+    int type;
+
+    // Match count
+    unsigned matches;
+
+    // Compiled NFA structure.
+    aligned_unique_ptr<NFA> nfa;
+
+    // Space for full state.
+    aligned_unique_ptr<char> full_state;
+
+    // Space for stream state.
+    aligned_unique_ptr<char> stream_state;
+
+    // Scratch and the lazy DFA cache within it.
+    aligned_unique_ptr<hs_scratch> scratch;
+    aligned_unique_ptr<limex_dfa_cache> cache;
+
+    // Queue structure.
+    struct mq q;
+};
+
+INSTANTIATE_TEST_CASE_P(LimExLazyDfa, LimExLazyDfaTest,
+                        Range((int)LIMEX_NFA_32, (int)LIMEX_NFA_1024 + 1));
+
+TEST_P(LimExLazyDfaTest, QueueExec) {
+    ASSERT_TRUE(nfa != nullptr);
+    ASSERT_TRUE(nfaUsesLimExCache(nfa.get()));
+
+    // Scan twice, so that the second scan runs from a warm cache.
+    for (u32 i = 0; i < 2; i++) {
+        matches = 0;
+        initQueue();
+        nfaQueueInitState(nfa.get(), &q);
+
+        u64a end = SCAN_DATA.size();
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_TOP, 0);
+        pushQueue(&q, MQE_END, end);
+
+        nfaQueueExec(nfa.get(), &q, end);
+
+        ASSERT_EQ(3, matches);
+        ASSERT_EQ(getImplNfa(nfa.get()), cache->owner);
+        ASSERT_LT(0U, cache->count);
+    }
+}
+
+TEST_P(LimExLazyDfaTest, QueueExecToMatch) {
+    ASSERT_TRUE(nfa != nullptr);
+    initQueue();
+    nfaQueueInitState(nfa.get(), &q);
+
+    u64a end = SCAN_DATA.size();
+    pushQueue(&q, MQE_START, 0);
+    pushQueue(&q, MQE_TOP, 0);
+    pushQueue(&q, MQE_END, end);
+
+    for (u32 i = 0; i < 3; i++) {
+        char rv = nfaQueueExecToMatch(nfa.get(), &q, end);
+        ASSERT_EQ(MO_MATCHES_PENDING, rv);
+        ASSERT_EQ(i, matches);
+        ASSERT_NE(0, nfaInAcceptState(nfa.get(), MATCH_REPORT, &q));
+        nfaReportCurrentMatches(nfa.get(), &q);
+        ASSERT_EQ(i + 1, matches);
+    }
+
+    char rv = nfaQueueExecToMatch(nfa.get(), &q, end);
+    ASSERT_EQ(MO_ALIVE, rv);
+    ASSERT_EQ(3, matches);
+}
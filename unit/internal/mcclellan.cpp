@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include "gtest/gtest.h"
+
+#include "grey.h"
+#include "compiler/compiler.h"
+#include "nfa/mcclellan_internal.h"
+#include "nfa/mcclellancompile.h"
+#include "nfa/nfa_api.h"
+#include "nfa/nfa_api_util.h"
+#include "nfa/nfa_internal.h"
+#include "nfa/rdfa.h"
+#include "nfagraph/ng.h"
+#include "nfagraph/ng_mcclellan.h"
+#include "nfagraph/ng_util.h"
+#include "util/alloc.h"
+#include "util/target_info.h"
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace testing;
+using namespace ue2;
+
+static const u32 MATCH_REPORT = 1024;
+
+struct StrideTestParams {
+    const char *expr;
+    const char *alphabet; //!< characters to build the scan data from
+};
+
+static const StrideTestParams strideTests[] = {
+    { "a[ab]{4}c", "abcx" },
+    { "(ab|cd)+e", "abcde" },
+    { "foo.*bar", "fobarx" },
+    { "x(ab)*c", "abcx" },
+};
+
+static
+int onMatch(u64a, u64a to, ReportID id, void *ctx) {
+    vector<u64a> *matches = (vector<u64a> *)ctx;
+    EXPECT_EQ(MATCH_REPORT, id);
+    matches->push_back(to);
+    return MO_CONTINUE_MATCHING;
+}
+
+class McClellanStrideTest : public TestWithParam<StrideTestParams> {
+protected:
+    virtual void SetUp() {
+        const StrideTestParams &p = GetParam();
+
+        CompileContext cc(false, false, get_current_target(), Grey());
+        ReportManager rm(cc.grey);
+        ParsedExpression parsed(0, p.expr, 0, 0);
+        unique_ptr<NGWrapper> g = buildWrapper(rm, cc, parsed);
+        ASSERT_TRUE(g != nullptr);
+        clearReports(*g);
+
+        rm.setProgramOffset(0, MATCH_REPORT);
+
+        unique_ptr<raw_dfa> rdfa = buildMcClellan(*g, &rm, cc.grey);
+        ASSERT_TRUE(rdfa != nullptr);
+        raw_dfa rdfa2 = *rdfa;
+
+        stride = mcclellanCompile(*rdfa, cc, rm);
+        ASSERT_TRUE(stride != nullptr);
+        ASSERT_EQ(MCCLELLAN_NFA_8, stride->type);
+
+        Grey no_stride_grey;
+        no_stride_grey.mcclellanStride2MaxSize = 0;
+        CompileContext cc2(false, false, get_current_target(), no_stride_grey);
+        single = mcclellanCompile(rdfa2, cc2, rm);
+        ASSERT_TRUE(single != nullptr);
+
+        const string alphabet(p.alphabet);
+        mt19937 prng(31);
+        for (u32 i = 0; i < 8192; i++) {
+            data += alphabet[prng() % alphabet.size()];
+        }
+    }
+
+    static const mcclellan *getMcClellan(const NFA *nfa) {
+        return (const mcclellan *)getImplNfa(nfa);
+    }
+
+    // Runs data[start, end) through the engine, returning match offsets.
+    vector<u64a> scan(const NFA *nfa, size_t start, size_t end,
+                      bool to_match) {
+        auto full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+        auto stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+        vector<u64a> matches;
+
+        struct mq q;
+        q.nfa = nfa;
+        q.cur = 0;
+        q.end = 0;
+        q.state = full_state.get();
+        q.streamState = stream_state.get();
+        q.offset = 0;
+        q.buffer = (const u8 *)data.c_str() + start;
+        q.length = end - start;
+        q.history = nullptr;
+        q.hlength = 0;
+        q.scratch = nullptr;
+        q.report_current = 0;
+        q.cb = onMatch;
+        q.context = &matches;
+
+        nfaQueueInitState(nfa, &q);
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_TOP, 0);
+        pushQueue(&q, MQE_END, end - start);
+        if (!to_match) {
+            nfaQueueExec(nfa, &q, end - start);
+            return matches;
+        }
+
+        while (nfaQueueExecToMatch(nfa, &q, end - start)
+               == MO_MATCHES_PENDING) {
+            EXPECT_NE(0, nfaInAcceptState(nfa, MATCH_REPORT, &q));
+            nfaReportCurrentMatches(nfa, &q);
+        }
+        return matches;
+    }
+
+    string data;
+    aligned_unique_ptr<NFA> stride;
+    aligned_unique_ptr<NFA> single;
+};
+
+INSTANTIATE_TEST_CASE_P(McClellan, McClellanStrideTest,
+                        ValuesIn(strideTests));
+
+TEST_P(McClellanStrideTest, HasStrideTable) {
+    EXPECT_NE(0U, getMcClellan(stride.get())->stride2_offset);
+    EXPECT_EQ(0U, getMcClellan(single.get())->stride2_offset);
+    EXPECT_LT(single->length, stride->length);
+}
+
+TEST_P(McClellanStrideTest, QueueExec) {
+    vector<u64a> expected = scan(single.get(), 0, data.size(), false);
+    ASSERT_FALSE(expected.empty());
+    ASSERT_EQ(expected, scan(stride.get(), 0, data.size(), false));
+}
+
+TEST_P(McClellanStrideTest, QueueExecToMatch) {
+    vector<u64a> expected = scan(single.get(), 0, data.size(), false);
+    ASSERT_EQ(expected, scan(stride.get(), 0, data.size(), true));
+}
+
+TEST_P(McClellanStrideTest, OddLengths) {
+    // Scans that end part way through a byte pair must take the last byte
+    // singly.
+    for (size_t end = 1; end < 64; end++) {
+        vector<u64a> expected = scan(single.get(), 1, end + 1, false);
+        ASSERT_EQ(expected, scan(stride.get(), 1, end + 1, false));
+    }
+}
+
+struct RowDispTestParams {
+    const char *expr;
+    const char *tokens; //!< space-separated pieces to build scan data from
+};
+
+// Floating literal sets over a wide alphabet: most transitions of each state
+// go back to the start, so rows are close to their default.
+static const RowDispTestParams rowDispTests[] = {
+    { "#(abcd|efgh|ijkl|mnop|qrst|uvwx)", "# #a abcd efgh ijkl mnop qrst "
+                                          "uvwx abc e i m q u x" },
+    { "#(ab|cd|ef|gh|ij|kl|mn|op)(qr|st)", "# ab cd ef gh ij kl mn op qr "
+                                           "st a q" },
+};
+
+class McClellanRowDispTest : public TestWithParam<RowDispTestParams> {
+protected:
+    virtual void SetUp() {
+        const RowDispTestParams &p = GetParam();
+
+        // Build 16-bit DFAs without Sherman states so that displaced rows
+        // are compared with full rows.
+        Grey grey;
+        grey.allowMcClellan8 = false;
+        grey.allowShermanStates = false;
+
+        CompileContext cc(false, false, get_current_target(), grey);
+        ReportManager rm(cc.grey);
+        ParsedExpression parsed(0, p.expr, 0, 0);
+        unique_ptr<NGWrapper> g = buildWrapper(rm, cc, parsed);
+        ASSERT_TRUE(g != nullptr);
+        clearReports(*g);
+
+        rm.setProgramOffset(0, MATCH_REPORT);
+
+        unique_ptr<raw_dfa> rdfa = buildMcClellan(*g, &rm, cc.grey);
+        ASSERT_TRUE(rdfa != nullptr);
+        raw_dfa rdfa2 = *rdfa;
+
+        // Try displaced rows regardless of table size.
+        Grey disp_grey = grey;
+        disp_grey.mcclellanRowDispMinSize = 1;
+        CompileContext cc_disp(false, false, get_current_target(), disp_grey);
+        disp = mcclellanCompile(*rdfa, cc_disp, rm);
+        ASSERT_TRUE(disp != nullptr);
+        ASSERT_EQ(MCCLELLAN_NFA_16, disp->type);
+
+        Grey plain_grey = grey;
+        plain_grey.mcclellanRowDispMinSize = 0;
+        CompileContext cc_plain(false, false, get_current_target(),
+                                plain_grey);
+        plain = mcclellanCompile(rdfa2, cc_plain, rm);
+        ASSERT_TRUE(plain != nullptr);
+
+        vector<string> tokens;
+        istringstream iss(p.tokens);
+        for (string t; iss >> t;) {
+            tokens.push_back(t);
+        }
+        mt19937 prng(43);
+        while (data.size() < 16384) {
+            data += tokens[prng() % tokens.size()];
+        }
+    }
+    vector<u64a> scan(const NFA *nfa) {
+        auto full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+        auto stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+        vector<u64a> matches;
+
+        struct mq q;
+        q.nfa = nfa;
+        q.cur = 0;
+        q.end = 0;
+        q.state = full_state.get();
+        q.streamState = stream_state.get();
+        q.offset = 0;
+        q.buffer = (const u8 *)data.c_str();
+        q.length = data.size();
+        q.history = nullptr;
+        q.hlength = 0;
+        q.scratch = nullptr;
+        q.report_current = 0;
+        q.cb = onMatch;
+        q.context = &matches;
+
+        nfaQueueInitState(nfa, &q);
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_TOP, 0);
+        pushQueue(&q, MQE_END, data.size());
+        nfaQueueExec(nfa, &q, data.size());
+        return matches;
+    }
+
+    string data;
+    aligned_unique_ptr<NFA> disp;
+    aligned_unique_ptr<NFA> plain;
+};
+
+INSTANTIATE_TEST_CASE_P(McClellan, McClellanRowDispTest,
+                        ValuesIn(rowDispTests));
+
+TEST_P(McClellanRowDispTest, Layout) {
+    const mcclellan *m = (const mcclellan *)getImplNfa(disp.get());
+    ASSERT_TRUE(m->flags & MCCLELLAN_FLAG_ROWDISP);
+    EXPECT_EQ(m->state_count, m->sherman_limit);
+    EXPECT_LT(disp->length, plain->length);
+
+    const mcclellan *mp = (const mcclellan *)getImplNfa(plain.get());
+    EXPECT_FALSE(mp->flags & MCCLELLAN_FLAG_ROWDISP);
+}
+
+TEST_P(McClellanRowDispTest, QueueExec) {
+    vector<u64a> expected = scan(plain.get());
+    ASSERT_FALSE(expected.empty());
+    ASSERT_EQ(expected, scan(disp.get()));
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include "gtest/gtest.h"
+
+#include "grey.h"
+#include "compiler/compiler.h"
+#include "nfa/mcclellancompile.h"
+#include "nfa/mcshengcompile.h"
+#include "nfa/nfa_api.h"
+#include "nfa/nfa_api_util.h"
+#include "nfa/nfa_internal.h"
+#include "nfa/rdfa.h"
+#include "nfagraph/ng.h"
+#include "nfagraph/ng_mcclellan.h"
+#include "nfagraph/ng_util.h"
+#include "util/alloc.h"
+#include "util/target_info.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace testing;
+using namespace ue2;
+
+static const u32 MATCH_REPORT = 1024;
+
+struct McShengTestParams {
+    int type; //!< expected engine type (enum NFAEngineType)
+    const char *expr;
+    const char *alphabet; //!< characters to build the scan data from
+};
+
+static const McShengTestParams mcshengTests[] = {
+    { MCSHENG_NFA_8, "a[ab]{4}c", "abcx" },
+    { MCSHENG_NFA_8, "ab|a[ab]{5}c", "abcx" },
+    { MCSHENG_NFA_16, "a[ab]{9}c", "abc" },
+};
+
+static
+int onMatch(u64a, u64a to, ReportID id, void *ctx) {
+    vector<u64a> *matches = (vector<u64a> *)ctx;
+    EXPECT_EQ(MATCH_REPORT, id);
+    matches->push_back(to);
+    return MO_CONTINUE_MATCHING;
+}
+
+class McShengTest : public TestWithParam<McShengTestParams> {
+protected:
+    virtual void SetUp() {
+        const McShengTestParams &p = GetParam();
+
+        CompileContext cc(false, false, get_current_target(), Grey());
+        ReportManager rm(cc.grey);
+        ParsedExpression parsed(0, p.expr, 0, 0);
+        unique_ptr<NGWrapper> g = buildWrapper(rm, cc, parsed);
+        ASSERT_TRUE(g != nullptr);
+        clearReports(*g);
+
+        rm.setProgramOffset(0, MATCH_REPORT);
+
+        unique_ptr<raw_dfa> rdfa = buildMcClellan(*g, &rm, cc.grey);
+        ASSERT_TRUE(rdfa != nullptr);
+        raw_dfa rdfa2 = *rdfa;
+
+        mcsheng = mcshengCompile(*rdfa, cc, rm);
+        ASSERT_TRUE(mcsheng != nullptr);
+        ASSERT_EQ(p.type, mcsheng->type);
+
+        mcclellan = mcclellanCompile(rdfa2, cc, rm);
+        ASSERT_TRUE(mcclellan != nullptr);
+
+        const string alphabet(p.alphabet);
+        mt19937 prng(27);
+        for (u32 i = 0; i < 8192; i++) {
+            data += alphabet[prng() % alphabet.size()];
+        }
+    }
+
+    void initQueue(const NFA *nfa, char *full_state, char *stream_state,
+                   vector<u64a> *matches) {
+        q.nfa = nfa;
+        q.cur = 0;
+        q.end = 0;
+        q.state = full_state;
+        q.streamState = stream_state;
+        q.offset = 0;
+        q.buffer = (const u8 *)data.c_str();
+        q.length = data.size();
+        q.history = nullptr;
+        q.hlength = 0;
+        q.scratch = nullptr;
+        q.report_current = 0;
+        q.cb = onMatch;
+        q.context = matches;
+    }
+
+    // Runs the whole of the scan data through the engine.
+    vector<u64a> scan(const NFA *nfa) {
+        auto full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+        auto stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+        vector<u64a> matches;
+
+        initQueue(nfa, full_state.get(), stream_state.get(), &matches);
+        nfaQueueInitState(nfa, &q);
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_TOP, 0);
+        pushQueue(&q, MQE_END, data.size());
+        nfaQueueExec(nfa, &q, data.size());
+        return matches;
+    }
+
+    string data;
+    struct mq q;
+    aligned_unique_ptr<NFA> mcsheng;
+    aligned_unique_ptr<NFA> mcclellan;
+};
+
+INSTANTIATE_TEST_CASE_P(McSheng, McShengTest, ValuesIn(mcshengTests));
+
+TEST_P(McShengTest, ShengRegion) {
+    // The DFA should be too big to be a Sheng on its own.
+    EXPECT_LT(16U, mcsheng->nPositions);
+    EXPECT_EQ(mcclellan->nPositions, mcsheng->nPositions);
+}
+
+TEST_P(McShengTest, QueueExec) {
+    vector<u64a> expected = scan(mcclellan.get());
+    vector<u64a> matches = scan(mcsheng.get());
+    ASSERT_FALSE(expected.empty());
+    ASSERT_EQ(expected, matches);
+}
+
+TEST_P(McShengTest, QueueExecToMatch) {
+    const NFA *nfa = mcsheng.get();
+    vector<u64a> expected = scan(mcclellan.get());
+
+    auto full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+    auto stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+    vector<u64a> matches;
+
+    initQueue(nfa, full_state.get(), stream_state.get(), &matches);
+    nfaQueueInitState(nfa, &q);
+    pushQueue(&q, MQE_START, 0);
+    pushQueue(&q, MQE_TOP, 0);
+    pushQueue(&q, MQE_END, data.size());
+
+    while (nfaQueueExecToMatch(nfa, &q, data.size()) == MO_MATCHES_PENDING) {
+        ASSERT_NE(0, nfaInAcceptState(nfa, MATCH_REPORT, &q));
+        nfaReportCurrentMatches(nfa, &q);
+    }
+
+    ASSERT_EQ(expected, matches);
+}
+
+TEST_P(McShengTest, StreamExec) {
+    const NFA *nfa = mcsheng.get();
+    vector<u64a> expected = scan(mcclellan.get());
+
+    auto full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+    auto stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+    vector<u64a> matches;
+
+    initQueue(nfa, full_state.get(), stream_state.get(), &matches);
+    nfaInitCompressedState(nfa, 0, stream_state.get(), 0);
+
+    // Scan in uneven chunks, compressing and expanding state between them.
+    const size_t chunk_len = 37;
+    for (size_t off = 0; off < data.size(); off += chunk_len) {
+        size_t len = min(chunk_len, data.size() - off);
+        q.cur = 0;
+        q.end = 0;
+        q.offset = off;
+        q.buffer = (const u8 *)data.c_str() + off;
+        q.length = len;
+        nfaExpandState(nfa, full_state.get(), stream_state.get(), off, 0);
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_END, len);
+        nfaQueueExec(nfa, &q, len);
+        nfaQueueCompressState(nfa, &q, len);
+    }
+
+    ASSERT_EQ(expected, matches);
+}
@@ -30,6 +30,7 @@
 
 #include "gtest/gtest.h"
 #include "ue2common.h"
+#include "util/fatbit.h"
 #include "util/make_unique.h"
 #include "util/multibit.h"
 #include "util/multibit_build.h"
@@ -1259,6 +1260,70 @@ TEST_P(MultiBitTest, SparseIteratorUnsetHalves) {
     }
 }
 
+static
+void check_compress(const u8 *ba, u32 test_size) {
+    size_t comp_size = mmbit_compsize(ba, test_size);
+    vector<u8> comp(comp_size);
+    size_t used = 0;
+
+    // too small a buffer must fail
+    if (comp_size) {
+        ASSERT_FALSE(mmbit_compress(ba, test_size, comp.data(), &used,
+                                    comp_size - 1));
+    }
+
+    ASSERT_TRUE(mmbit_compress(ba, test_size, comp.data(), &used,
+                               comp_size));
+    ASSERT_EQ(comp_size, used);
+
+    // decompress over a full multibit, which must be cleared
+    mmbit_holder ba2(test_size);
+    fill_mmbit(ba2, test_size);
+    size_t consumed = 0;
+    ASSERT_TRUE(mmbit_decompress(ba2, test_size, comp.data(), &consumed,
+                                 comp_size));
+    ASSERT_EQ(comp_size, consumed);
+
+    u32 it = mmbit_iterate(ba, test_size, MMB_INVALID);
+    u32 it2 = mmbit_iterate(ba2, test_size, MMB_INVALID);
+    for (; it != MMB_INVALID; it = mmbit_iterate(ba, test_size, it),
+                              it2 = mmbit_iterate(ba2, test_size, it2)) {
+        ASSERT_EQ(it, it2);
+    }
+    ASSERT_EQ(MMB_INVALID, it2);
+
+    // truncated input must fail
+    if (comp_size) {
+        ASSERT_FALSE(mmbit_decompress(ba2, test_size, comp.data(), &consumed,
+                                      comp_size - 1));
+    }
+}
+
+TEST_P(MultiBitTest, CompressNone) {
+    SCOPED_TRACE(test_size);
+    ASSERT_TRUE(ba != nullptr);
+
+    mmbit_clear(ba, test_size);
+    ASSERT_EQ(1U, mmbit_compsize(ba, test_size));
+    check_compress(ba, test_size);
+}
+
+TEST_P(MultiBitTest, CompressStrided) {
+    SCOPED_TRACE(test_size);
+    ASSERT_TRUE(ba != nullptr);
+
+    mmbit_clear(ba, test_size);
+    for (u64a i = 0; i < test_size; i += stride) {
+        mmbit_set(ba, test_size, i);
+    }
+    check_compress(ba, test_size);
+
+    // and with only the last key set
+    mmbit_clear(ba, test_size);
+    mmbit_set(ba, test_size, test_size - 1);
+    check_compress(ba, test_size);
+}
+
 static const MultiBitTestParam multibitTests[] = {
     // We provide both test size and stride so that larger tests don't take
     // forever checking every single key.
@@ -1309,3 +1374,38 @@ static const MultiBitTestParam multibitTests[] = {
 
 INSTANTIATE_TEST_CASE_P(MultiBit, MultiBitTest, ValuesIn(multibitTests));
 
+
+TEST(FatBit, ClearOnlyWhatIsRead) {
+    const u32 sizes[] = { 1, 63, 64, 65, 200, 256, 257, 4096, 100000 };
+    for (u32 total_bits : sizes) {
+        SCOPED_TRACE(total_bits);
+        vector<u64a> mem(ROUNDUP_N(fatbit_size(total_bits), 8) / 8, ~0ULL);
+        struct fatbit *bits = (struct fatbit *)mem.data();
+
+        // Garbage beyond the words the clear touches must not be visible.
+        fatbit_clear(bits, total_bits);
+        ASSERT_EQ(MMB_INVALID, fatbit_iterate(bits, total_bits, MMB_INVALID));
+
+        vector<u32> keys;
+        for (u32 i = 0; i < total_bits; i += 37) {
+            keys.push_back(i);
+        }
+        keys.push_back(total_bits - 1);
+        for (u32 key : keys) {
+            fatbit_set(bits, total_bits, key);
+        }
+        sort(keys.begin(), keys.end());
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+        vector<u32> seen;
+        for (u32 i = fatbit_iterate(bits, total_bits, MMB_INVALID);
+             i != MMB_INVALID; i = fatbit_iterate(bits, total_bits, i)) {
+            seen.push_back(i);
+        }
+        ASSERT_EQ(keys, seen);
+
+        fatbit_clear(bits, total_bits);
+        ASSERT_EQ(MMB_INVALID, fatbit_iterate(bits, total_bits, MMB_INVALID));
+        ASSERT_FALSE(fatbit_isset(bits, total_bits, total_bits - 1));
+    }
+}
@@ -32,7 +32,11 @@
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "nfagraph/ng_holder.h"
 #include "nfagraph/ng_literal_analysis.h"
+#include "nfagraph/ng_netflow.h"
+#include "nfagraph/ng_util.h"
+#include "util/byte_freq.h"
 
 using namespace std;
 using namespace boost;
@@ -88,3 +92,70 @@ TEST_P(LiteralSetCompressTest, Run) {
 }
 
 INSTANTIATE_TEST_CASE_P(NFAGraph, LiteralSetCompressTest, testing::ValuesIn(paramFactory()));
+
+TEST(NFAGraph, LiteralScoreByteFrequencies) {
+    const set<ue2_literal> common = {ue2_literal("HTTP/1.1", false)};
+    const set<ue2_literal> rare = {ue2_literal("qz7", false)};
+
+    // Without a model, the longer literal is better.
+    EXPECT_LT(scoreSet(common), scoreSet(rare));
+
+    // Traffic in which "HTTP/1.1\r\n" is everywhere.
+    const string sample = "HTTP/1.1\r\n";
+    vector<unsigned long long> pairs(256 * 256, 1);
+    for (size_t i = 0; i < sample.size(); i++) {
+        u8 a = sample[i];
+        u8 b = sample[(i + 1) % sample.size()];
+        pairs[a * 256 + b] += 1000000;
+    }
+    auto freq = ByteFrequencies::fromPairCounts(pairs.data());
+
+    EXPECT_GT(scoreSet(common, &freq), scoreSet(rare, &freq));
+
+    // A model with byte values equally likely scores as no model does.
+    vector<unsigned long long> uniform(256 * 256, 1);
+    auto flat = ByteFrequencies::fromPairCounts(uniform.data());
+    EXPECT_EQ(scoreSet(common), scoreSet(common, &flat));
+    EXPECT_EQ(scoreSet(rare), scoreSet(rare, &flat));
+    const set<ue2_literal> nocase = {ue2_literal("get /", true)};
+    EXPECT_EQ(scoreSet(nocase), scoreSet(nocase, &flat));
+}
+
+TEST(NFAGraph, NetflowMinCut) {
+    // start -> a -> b -> accept, start -> c -> b, with cheap edges into b.
+    NGHolder h;
+    NFAVertex a = add_vertex(h);
+    NFAVertex b = add_vertex(h);
+    NFAVertex c = add_vertex(h);
+    add_edge(h.start, a, h);
+    add_edge(h.start, c, h);
+    add_edge(a, b, h);
+    add_edge(c, b, h);
+    add_edge(b, b, h);
+    add_edge(b, h.accept, h);
+    renumber_edges(h);
+
+    vector<u64a> scores(num_edges(h), 0);
+    auto score = [&](NFAVertex u, NFAVertex v, u64a cap) {
+        scores[h[edge(u, v, h).first].index] = cap;
+    };
+    score(h.start, a, INVALID_EDGE_CAP);
+    score(h.start, c, INVALID_EDGE_CAP);
+    score(a, b, 3);
+    score(c, b, 4);
+    score(b, b, 1);
+    score(b, h.accept, 10);
+    score(h.accept, h.acceptEod, INVALID_EDGE_CAP);
+
+    NetflowGraph ng(h);
+    auto cut = ng.findMinCut(scores);
+    ASSERT_EQ(2U, cut.size());
+    set<NFAEdge> expected = {edge(a, b, h).first, edge(c, b, h).first};
+    EXPECT_EQ(expected, set<NFAEdge>(cut.begin(), cut.end()));
+
+    // The same network can be cut again with different scores.
+    score(b, h.accept, 5);
+    cut = ng.findMinCut(scores);
+    ASSERT_EQ(1U, cut.size());
+    EXPECT_EQ(edge(b, h.accept, h).first, cut.front());
+}
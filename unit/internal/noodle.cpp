@@ -281,3 +281,129 @@ TEST(Noodle, noodCutoverDouble) {
     }
 }
 
+
+static
+void noodleMultiMatch(const u8 *data, size_t data_len,
+                      const vector<hwlmLiteral> &lits, HWLMCallback cb,
+                      void *ctxt) {
+    auto n = noodBuildMultiTable(lits);
+    ASSERT_TRUE(n != nullptr);
+
+    hwlm_error_t rv;
+    rv = noodExecMulti(n.get(), data, data_len, 0, cb, ctxt, HWLM_ALL_GROUPS);
+    ASSERT_EQ(HWLM_SUCCESS, rv);
+}
+
+TEST(Noodle, noodMulti) {
+    const u8 data[] = "xxabAbxbabbAB";
+    const size_t data_len = sizeof(data) - 1;
+    hlmMatchRecord ctxt;
+
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("ab", true, 10));
+    lits.push_back(hwlmLiteral("b", false, 11));
+
+    noodleMultiMatch(data, data_len, lits, hlmSimpleCallback, &ctxt);
+
+    // Matches come out in end offset order.
+    const hlmMatchEntry expected[] = {
+        {2, 3, 10}, {3, 3, 11}, {4, 5, 10}, {5, 5, 11}, {7, 7, 11},
+        {8, 9, 10}, {9, 9, 11}, {10, 10, 11}, {11, 12, 10}};
+    ASSERT_EQ(ARRAY_LENGTH(expected), ctxt.size());
+    for (size_t i = 0; i < ctxt.size(); i++) {
+        EXPECT_EQ(expected[i].from, ctxt[i].from);
+        EXPECT_EQ(expected[i].to, ctxt[i].to);
+        EXPECT_EQ(expected[i].id, ctxt[i].id);
+    }
+}
+
+TEST(Noodle, noodMultiCutover) {
+    const size_t max_data_len = 128;
+    hlmMatchRecord ctxt;
+    u8 data[max_data_len + 31];
+
+    for (u32 i = 0; i < sizeof(data); i++) {
+        data[i] = i % 2 ? 'a' : 'b';
+    }
+
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("ab", false, 1));
+    lits.push_back(hwlmLiteral("ba", false, 2));
+
+    for (u32 align = 0; align < 32; align += 2) {
+        for (u32 len = 0; len < max_data_len; len++) {
+            ctxt.clear();
+            noodleMultiMatch(data + align, len, lits, hlmSimpleCallback,
+                             &ctxt);
+            EXPECT_EQ(len ? len - 1 : 0U, ctxt.size());
+            for (u32 i = 0; i < ctxt.size(); i++) {
+                ASSERT_EQ(i, ctxt[i].from);
+                ASSERT_EQ(i + 1, ctxt[i].to);
+                ASSERT_EQ(i % 2 ? 1U : 2U, ctxt[i].id);
+            }
+        }
+    }
+}
+
+static
+hwlmcb_rv_t hlmGroupsCallback(size_t from, size_t to, u32 id, void *context) {
+    hlmSimpleCallback(from, to, id, context);
+
+    // Switch off the group of literal 1 after the first match.
+    return ~1ULL;
+}
+
+TEST(Noodle, noodMultiGroups) {
+    const size_t data_len = 100;
+    hlmMatchRecord ctxt;
+    u8 data[data_len];
+
+    memset(data, 'a', data_len);
+
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("a", false, false, 1, 1, {}, {}));
+    lits.push_back(hwlmLiteral("aa", false, false, 2, 2, {}, {}));
+
+    noodleMultiMatch(data, data_len, lits, hlmGroupsCallback, &ctxt);
+
+    ASSERT_EQ(data_len, ctxt.size());
+    EXPECT_EQ(1U, ctxt[0].id);
+    for (size_t i = 1; i < ctxt.size(); i++) {
+        EXPECT_EQ(2U, ctxt[i].id);
+        EXPECT_EQ(i - 1, ctxt[i].from);
+        EXPECT_EQ(i, ctxt[i].to);
+    }
+}
+
+TEST(Noodle, noodMultiStreaming) {
+    const u8 hist[] = "xxxxab";
+    const u8 data[] = "cdabcd";
+    hlmMatchRecord ctxt;
+    u8 temp_buf[64];
+
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("bc", false, 1));
+    lits.push_back(hwlmLiteral("bC", true, 2));
+    lits.push_back(hwlmLiteral("d", false, 3));
+
+    auto n = noodBuildMultiTable(lits);
+    ASSERT_TRUE(n != nullptr);
+
+    hwlm_error_t rv = noodExecMultiStreaming(n.get(), hist, sizeof(hist) - 1,
+                                             data, sizeof(data) - 1,
+                                             hlmSimpleCallback, &ctxt,
+                                             HWLM_ALL_GROUPS, temp_buf,
+                                             sizeof(temp_buf));
+    ASSERT_EQ(HWLM_SUCCESS, rv);
+
+    // The match spanning the boundary starts before the new data.
+    const hlmMatchEntry expected[] = {
+        {(size_t)-1, 0, 1}, {(size_t)-1, 0, 2}, {1, 1, 3}, {3, 4, 1},
+        {3, 4, 2}, {5, 5, 3}};
+    ASSERT_EQ(ARRAY_LENGTH(expected), ctxt.size());
+    for (size_t i = 0; i < ctxt.size(); i++) {
+        EXPECT_EQ(expected[i].from, ctxt[i].from);
+        EXPECT_EQ(expected[i].to, ctxt[i].to);
+        EXPECT_EQ(expected[i].id, ctxt[i].id);
+    }
+}
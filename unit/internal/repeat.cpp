@@ -164,6 +164,18 @@ static const RepeatTestInfo repeatTests[] = {
     { REPEAT_RANGE, 1, 200 },
     { REPEAT_RANGE, 10, 16000 },
     { REPEAT_RANGE, 10000, 16000 },
+    { REPEAT_RANGE, 4500, 5000 },
+    // {N, M} repeats -- delta model
+    { REPEAT_DELTA, 1, 4 },
+    { REPEAT_DELTA, 5, 10 },
+    { REPEAT_DELTA, 10, 20 },
+    { REPEAT_DELTA, 10, 50 },
+    { REPEAT_DELTA, 50, 60 },
+    { REPEAT_DELTA, 100, 200 },
+    { REPEAT_DELTA, 1, 200 },
+    { REPEAT_DELTA, 10, 16000 },
+    { REPEAT_DELTA, 10000, 16000 },
+    { REPEAT_DELTA, 4500, 5000 },
     // {N,M} repeats -- small bitmap model
     { REPEAT_BITMAP, 1, 2 },
     { REPEAT_BITMAP, 5, 10 },
@@ -455,6 +467,51 @@ TEST_P(RepeatTest, Pack) {
     }
 }
 
+TEST_P(RepeatTest, StoreBatch) {
+    SCOPED_TRACE(testing::Message() << "Repeat: " << info);
+
+    // Two more copies of the repeat, updated together with repeatStoreBatch
+    // alongside the first, which is updated with repeatStore.
+    const size_t num_copies = 2;
+    RepeatControl ctrls[num_copies];
+    unique_ptr<char[]> states_int[num_copies];
+    RepeatStoreEntry entries[num_copies];
+    for (size_t j = 0; j < num_copies; j++) {
+        states_int[j] = ue2::make_unique<char[]>(info.stateSize + 7);
+        entries[j].info = &info;
+        entries[j].ctrl = &ctrls[j];
+        entries[j].state = states_int[j].get() + 7;
+    }
+
+    const u64a offset = 1000;
+    const u64a tops[] = { offset, offset + 1, offset + 3,
+                          offset + info.repeatMin + 7 };
+
+    for (size_t i = 0; i < ARRAY_LENGTH(tops); i++) {
+        char is_alive = i != 0;
+        repeatStore(&info, ctrl, state, tops[i], is_alive);
+        for (size_t j = 0; j < num_copies; j++) {
+            entries[j].is_alive = is_alive;
+        }
+        repeatStoreBatch(entries, num_copies, tops[i]);
+    }
+
+    const u64a last = tops[ARRAY_LENGTH(tops) - 1];
+    for (size_t j = 0; j < num_copies; j++) {
+        const RepeatControl *ctrl2 = entries[j].ctrl;
+        const char *state2 = (const char *)entries[j].state;
+        if (info.type != REPEAT_ALWAYS) {
+            ASSERT_EQ(repeatLastTop(&info, ctrl, state),
+                      repeatLastTop(&info, ctrl2, state2));
+        }
+        for (u64a i = last; i <= last + info.repeatMin + 10; i++) {
+            ASSERT_EQ(repeatHasMatch(&info, ctrl, state, i),
+                      repeatHasMatch(&info, ctrl2, state2, i))
+                << "mismatch at offset " << i;
+        }
+    }
+}
+
 TEST_P(RepeatTest, LargeGap) {
     SCOPED_TRACE(testing::Message() << "Repeat: " << info);
 
@@ -474,6 +531,29 @@ TEST_P(RepeatTest, LargeGap) {
     }
 }
 
+static
+u32 totalStateSize(RepeatType type, const depth &repeatMin,
+                   const depth &repeatMax) {
+    RepeatStateInfo rsi(type, repeatMin, repeatMax, 0);
+    return rsi.packedCtrlSize + rsi.stateSize;
+}
+
+TEST(RepeatChoice, LargeBoundedRepeat) {
+    const depth repeatMin(4500), repeatMax(5000);
+    RepeatType type = chooseRepeatType(repeatMin, repeatMax, 0, false, false);
+    ASSERT_NE(REPEAT_RING, type);
+    EXPECT_GT(totalStateSize(REPEAT_RING, repeatMin, repeatMax),
+              totalStateSize(type, repeatMin, repeatMax));
+}
+
+TEST(RepeatChoice, DeltaSmallerThanRange) {
+    const depth repeatMin(1000), repeatMax(5000);
+    EXPECT_GT(totalStateSize(REPEAT_RANGE, repeatMin, repeatMax),
+              totalStateSize(REPEAT_DELTA, repeatMin, repeatMax));
+    EXPECT_EQ(REPEAT_DELTA,
+              chooseRepeatType(repeatMin, repeatMax, 0, false, false));
+}
+
 static
 const u32 sparsePeriods[] = {
     2,
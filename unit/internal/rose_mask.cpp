@@ -29,8 +29,11 @@
 #include "config.h"
 
 #include "rose/validate_mask.h"
+#include "rose/validate_shufti.h"
 #include "gtest/gtest.h"
 
+#include <random>
+
 #define ONES64 0xffffffffffffffffULL
 
 /* valid_data_mask is flexible, don't need to be fixed in Info */
@@ -300,3 +303,96 @@ TEST(ValidateMask, ManualTest_2) {
     EXPECT_EQ(0, validateMask(t.data, (ONES64 << 56) >> 48,
                               t.and_mask, t.cmp_mask, 0xff00ULL));
 }
+
+/*
+ * Reference implementation of the wide mask checks: byte i fails if it does
+ * not match its and/cmp masks (or does, when negated) and is valid.
+ */
+static
+int validateMaskRef(const u8 *data, u64a valid_data_mask, const u8 *and_mask,
+                    const u8 *cmp_mask, u64a neg_mask, u32 len) {
+    for (u32 i = 0; i < len; i++) {
+        if (!(valid_data_mask & (1ULL << i))) {
+            continue;
+        }
+        bool mismatch = (data[i] & and_mask[i]) != cmp_mask[i];
+        bool neg = neg_mask & (1ULL << i);
+        if (mismatch != neg) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Random data and masks, where cmp_mask is mostly derived from the data so
+ * that we see both passes and failures.
+ */
+TEST(ValidateMask, Mask32AndMask64) {
+    std::mt19937 rng(0x1234);
+    u8 data[64], and_mask[64], cmp_mask[64];
+    for (u32 iter = 0; iter < 10000; iter++) {
+        u64a neg_mask = 0;
+        for (u32 i = 0; i < 64; i++) {
+            data[i] = rng();
+            and_mask[i] = rng();
+            cmp_mask[i] = data[i] & and_mask[i];
+            if (rng() % 64 == 0) {
+                cmp_mask[i] ^= 1;
+                neg_mask |= 1ULL << i;
+            }
+            if (rng() % 256 == 0) {
+                neg_mask ^= 1ULL << i;
+            }
+        }
+        u64a valid = (u64a)rng() << 32 | rng();
+        if (iter % 2) {
+            valid = ~0ULL;
+        }
+
+        EXPECT_EQ(validateMaskRef(data, valid, and_mask, cmp_mask, neg_mask,
+                                  32),
+                  validateMask32(loadu256(data), (u32)valid,
+                                 loadu256(and_mask), loadu256(cmp_mask),
+                                 (u32)neg_mask));
+        EXPECT_EQ(validateMaskRef(data, valid, and_mask, cmp_mask, neg_mask,
+                                  64),
+                  validateMask64(loadu512(data), valid, loadu512(and_mask),
+                                 loadu512(cmp_mask), neg_mask));
+    }
+}
+
+TEST(ValidateShuftiMask, Shufti32x8) {
+    std::mt19937 rng(0x5678);
+    u8 data[32], lo_mask[32], hi_mask[32], select[32];
+    for (u32 iter = 0; iter < 10000; iter++) {
+        for (u32 i = 0; i < 16; i++) {
+            lo_mask[i] = lo_mask[i + 16] = rng();
+            hi_mask[i] = hi_mask[i + 16] = rng();
+        }
+        u32 neg_mask = rng();
+        u32 valid = iter % 2 ? ~0U : (u32)rng();
+        int expected = 1;
+        for (u32 i = 0; i < 32; i++) {
+            data[i] = rng();
+            select[i] = rng() % 4 ? (u8)rng() : 0;
+            u8 t = lo_mask[data[i] & 0xf] & hi_mask[data[i] >> 4] & select[i];
+            bool nresult = !t;
+            bool neg = neg_mask & (1U << i);
+            if (rng() % 8) {
+                // Mostly choose neg_mask to agree with the data.
+                neg = nresult;
+                neg_mask = (neg_mask & ~(1U << i)) | (u32)neg << i;
+            }
+            if ((valid & (1U << i)) && nresult != neg) {
+                expected = 0;
+            }
+        }
+
+        EXPECT_EQ(expected,
+                  validateShuftiMask32x8(loadu256(data), loadu256(hi_mask),
+                                         loadu256(lo_mask), loadu256(select),
+                                         neg_mask, valid));
+    }
+}
+
@@ -28,6 +28,8 @@
 
 #include "config.h"
 
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "nfa/vermicelli.h"
 
@@ -218,3 +220,39 @@ TEST(RDoubleVermicelli, Exec5) {
         }
     }
 }
+
+TEST(RVermicelli, ExecMatchLong) {
+    // Long enough to exercise the wide block loops at every alignment.
+    std::vector<u8> t1(320, 'b');
+    std::vector<u8> t2(320, 'a');
+
+    for (size_t i = 0; i < 64; i++) {
+        const u8 *buf_end = t1.data() + t1.size() - i;
+        for (size_t j = 0; j + 1 < t1.size() - i; j++) {
+            t1[j] = 'a';
+            t1[j + 1] = 'z';
+            const u8 *rv = rvermicelliExec('z', 0, t1.data(), buf_end);
+            ASSERT_EQ((size_t)t1.data() + j + 1, (size_t)rv);
+
+            rv = rvermicelliExec('Z', 1, t1.data(), buf_end);
+            ASSERT_EQ((size_t)t1.data() + j + 1, (size_t)rv);
+
+            // The double scan may stop conservatively in the last aligned
+            // block before buf.
+            if (j >= 32) {
+                rv = rvermicelliDoubleExec('a', 'z', 0, t1.data(), buf_end);
+                ASSERT_EQ((size_t)t1.data() + j + 1, (size_t)rv);
+
+                rv = rvermicelliDoubleExec('A', 'Z', 1, t1.data(), buf_end);
+                ASSERT_EQ((size_t)t1.data() + j + 1, (size_t)rv);
+            }
+            t1[j] = 'b';
+            t1[j + 1] = 'b';
+
+            t2[j] = 'b';
+            rv = rnvermicelliExec('a', 0, t2.data(), t2.data() + t2.size() - i);
+            ASSERT_EQ((size_t)t2.data() + j, (size_t)rv);
+            t2[j] = 'a';
+        }
+    }
+}
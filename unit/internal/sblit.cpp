@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include "ue2common.h"
+#include "hwlm/hwlm.h"
+#include "hwlm/hwlm_literal.h"
+#include "hwlm/sblit_build.h"
+#include "hwlm/sblit_engine.h"
+#include "hwlm/sblit_internal.h"
+#include "util/alloc.h"
+#include "util/ue2string.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace std;
+using namespace ue2;
+
+namespace {
+
+struct SbLitMatch {
+    size_t from;
+    size_t to;
+    u32 id;
+    SbLitMatch(size_t start, size_t end, u32 identifier)
+        : from(start), to(end), id(identifier) {}
+    bool operator<(const SbLitMatch &b) const {
+        return tie(to, from, id) < tie(b.to, b.from, b.id);
+    }
+    bool operator==(const SbLitMatch &b) const {
+        return tie(to, from, id) == tie(b.to, b.from, b.id);
+    }
+};
+
+typedef vector<SbLitMatch> SbLitMatchRecord;
+
+hwlmcb_rv_t recordMatch(size_t from, size_t to, u32 id, void *context) {
+    auto *mr = (SbLitMatchRecord *)context;
+    mr->push_back(SbLitMatch(from, to, id));
+    return HWLM_CONTINUE_MATCHING;
+}
+
+hwlmcb_rv_t terminateMatch(size_t from, size_t to, u32 id, void *context) {
+    recordMatch(from, to, id, context);
+    return HWLM_TERMINATE_MATCHING;
+}
+
+hwlmcb_rv_t group2Match(size_t from, size_t to, u32 id, void *context) {
+    recordMatch(from, to, id, context);
+    return 2;
+}
+
+/** \brief The matches of \a lits in \a data, found the slow way. */
+SbLitMatchRecord bruteForce(const string &data,
+                            const vector<hwlmLiteral> &lits) {
+    SbLitMatchRecord mr;
+    for (const auto &lit : lits) {
+        const size_t len = lit.s.length();
+        for (size_t i = 0; i + len <= data.size(); i++) {
+            bool match = lit.nocase
+                ? !cmp(data.c_str() + i, lit.s.c_str(), len, true)
+                : !memcmp(data.c_str() + i, lit.s.c_str(), len);
+            if (match) {
+                mr.push_back(SbLitMatch(i, i + len - 1, lit.id));
+            }
+        }
+    }
+    sort(mr.begin(), mr.end());
+    return mr;
+}
+
+/** \brief Checks that matches are in end offset order, then sorts them within
+ * each end offset for comparison. */
+void checkOrderAndSort(SbLitMatchRecord &mr) {
+    for (size_t i = 1; i < mr.size(); i++) {
+        ASSERT_LE(mr[i - 1].to, mr[i].to);
+    }
+    sort(mr.begin(), mr.end());
+}
+
+TEST(SbLit, Simple) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("foo", false, 1));
+    lits.push_back(hwlmLiteral("fooBar", false, 2));
+    lits.push_back(hwlmLiteral("BAZ", true, 3));
+    lits.push_back(hwlmLiteral("z", false, 4));
+
+    auto t = sbLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+    EXPECT_EQ(4U, t->entry_count);
+    EXPECT_EQ(6U, t->max_len);
+
+    const string data = "xfooBar baz fooZbAz";
+    SbLitMatchRecord mr;
+    hwlm_error_t rv = sbLitExec(t.get(), (const u8 *)data.c_str(),
+                                data.size(), 0, recordMatch, &mr,
+                                HWLM_ALL_GROUPS);
+    ASSERT_EQ(HWLM_SUCCESS, rv);
+
+    checkOrderAndSort(mr);
+    EXPECT_EQ(bruteForce(data, lits), mr);
+    EXPECT_EQ(7U, mr.size());
+}
+
+TEST(SbLit, Offset) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("abc", false, 1));
+
+    auto t = sbLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+
+    const string data = "zabc";
+    SbLitMatchRecord mr;
+    hwlm_error_t rv = sbLitExec(t.get(), (const u8 *)data.c_str() + 1,
+                                data.size() - 1, 1, recordMatch, &mr,
+                                HWLM_ALL_GROUPS);
+    ASSERT_EQ(HWLM_SUCCESS, rv);
+    ASSERT_EQ(1U, mr.size());
+    EXPECT_EQ(SbLitMatch(1, 3, 1), mr[0]);
+}
+
+TEST(SbLit, TooLong) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("abcd", false, 1));
+    lits.push_back(hwlmLiteral(string(SBLIT_MAX_LEN + 1, 'a'), false, 2));
+    EXPECT_TRUE(sbLitBuildTable(lits) == nullptr);
+}
+
+TEST(SbLit, TooManyKeys) {
+    vector<hwlmLiteral> lits;
+    for (u32 i = 0; i <= SBLIT_MAX_KEYS; i++) {
+        lits.push_back(hwlmLiteral(string(i / 16 + 1, 'a' + i % 16), false,
+                                   i));
+    }
+    EXPECT_TRUE(sbLitBuildTable(lits) == nullptr);
+}
+
+TEST(SbLit, Masks) {
+    vector<hwlmLiteral> lits;
+    // Caseless, but the last byte must be upper case.
+    lits.push_back(hwlmLiteral("abc", true, false, 1, HWLM_ALL_GROUPS,
+                               {0x20}, {0}));
+
+    auto t = sbLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+
+    const string data = "abc abC ABc ABC";
+    SbLitMatchRecord mr;
+    hwlm_error_t rv = sbLitExec(t.get(), (const u8 *)data.c_str(),
+                                data.size(), 0, recordMatch, &mr,
+                                HWLM_ALL_GROUPS);
+    ASSERT_EQ(HWLM_SUCCESS, rv);
+    ASSERT_EQ(2U, mr.size());
+    EXPECT_EQ(6U, mr[0].to);
+    EXPECT_EQ(14U, mr[1].to);
+}
+
+TEST(SbLit, Random) {
+    mt19937 prng(17);
+    const string alphabet = "abcdABCD.-";
+    auto randomString = [&](size_t len) {
+        string s;
+        for (size_t i = 0; i < len; i++) {
+            s.push_back(alphabet[prng() % alphabet.size()]);
+        }
+        return s;
+    };
+
+    // A small alphabet, so that literals share keys.
+    vector<hwlmLiteral> lits;
+    for (u32 i = 0; i < 40; i++) {
+        size_t len = 1 + prng() % 6;
+        lits.push_back(hwlmLiteral(randomString(len), prng() % 2, i));
+    }
+
+    auto t = sbLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+
+    for (u32 i = 0; i < 200; i++) {
+        const string data = randomString(prng() % (SBLIT_MAX_LEN + 1));
+        SbLitMatchRecord mr;
+        hwlm_error_t rv = sbLitExec(t.get(), (const u8 *)data.c_str(),
+                                    data.size(), 0, recordMatch, &mr,
+                                    HWLM_ALL_GROUPS);
+        ASSERT_EQ(HWLM_SUCCESS, rv);
+        checkOrderAndSort(mr);
+        EXPECT_EQ(bruteForce(data, lits), mr);
+    }
+}
+
+TEST(SbLit, Groups) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("aa", false, false, 1, 1, {}, {}));
+    lits.push_back(hwlmLiteral("aaaa", false, false, 2, 2, {}, {}));
+
+    auto t = sbLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+
+    const string data(SBLIT_MAX_LEN, 'a');
+    SbLitMatchRecord mr;
+    hwlm_error_t rv = sbLitExec(t.get(), (const u8 *)data.c_str(),
+                                data.size(), 0, group2Match, &mr, 2);
+    ASSERT_EQ(HWLM_SUCCESS, rv);
+    ASSERT_EQ(data.size() - 3, mr.size());
+    for (const auto &m : mr) {
+        EXPECT_EQ(2U, m.id);
+    }
+}
+
+TEST(SbLit, Terminate) {
+    vector<hwlmLiteral> lits;
+    lits.push_back(hwlmLiteral("abc", false, 1));
+
+    auto t = sbLitBuildTable(lits);
+    ASSERT_TRUE(t != nullptr);
+
+    const string data = "abc abc abc abc";
+    SbLitMatchRecord mr;
+    hwlm_error_t rv = sbLitExec(t.get(), (const u8 *)data.c_str(),
+                                data.size(), 0, terminateMatch, &mr,
+                                HWLM_ALL_GROUPS);
+    ASSERT_EQ(HWLM_TERMINATED, rv);
+    ASSERT_EQ(1U, mr.size());
+    EXPECT_EQ(2U, mr[0].to);
+}
+
+} // namespace
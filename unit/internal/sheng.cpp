@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include "gtest/gtest.h"
+
+#include "grey.h"
+#include "compiler/compiler.h"
+#include "nfa/mcclellancompile.h"
+#include "nfa/nfa_api.h"
+#include "nfa/nfa_api_util.h"
+#include "nfa/nfa_internal.h"
+#include "nfa/rdfa.h"
+#include "nfa/shengcompile.h"
+#include "nfagraph/ng.h"
+#include "nfagraph/ng_mcclellan.h"
+#include "nfagraph/ng_util.h"
+#include "util/alloc.h"
+#include "util/target_info.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace testing;
+using namespace ue2;
+
+static const u32 MATCH_REPORT = 1024;
+
+struct ShengTestParams {
+    int type; //!< expected engine type (enum NFAEngineType)
+    const char *expr;
+};
+
+static const ShengTestParams shengTests[] = {
+    { SHENG_NFA_0, "foo[^\\n]*bar" },
+    { SHENG_NFA_32, "hyperscan(sheng|dfa)[0-9]+engine" },
+    { SHENG_NFA_32, "^(foo|bar)[a-z]{20}baz" },
+    { SHENG_NFA_64, "hyperscan wide (sheng|dfa) engines run [0-9]+ states fast" },
+    { SHENG_NFA_64, "^(foo|bar)[a-z]{40}[0-9]baz" },
+};
+
+static
+int onMatch(u64a, u64a to, ReportID id, void *ctx) {
+    vector<u64a> *matches = (vector<u64a> *)ctx;
+    EXPECT_EQ(MATCH_REPORT, id);
+    matches->push_back(to);
+    return MO_CONTINUE_MATCHING;
+}
+
+// Builds data containing pieces of the pattern text, so that there are both
+// matches and near misses, separated by noise.
+static
+string makeScanData(const string &expr) {
+    const string alphabet = "abcdefghijklmnopqrstuvwxyz0123456789 \n";
+    mt19937 prng(27);
+    string data;
+    for (u32 i = 0; i < 64; i++) {
+        size_t from = prng() % expr.size();
+        size_t len = prng() % (expr.size() - from + 1);
+        data += expr.substr(from, len);
+        for (u32 j = prng() % 8; j; j--) {
+            data += alphabet[prng() % alphabet.size()];
+        }
+    }
+    return data;
+}
+
+class ShengTest : public TestWithParam<ShengTestParams> {
+protected:
+    virtual void SetUp() {
+        const ShengTestParams &p = GetParam();
+
+        hs_platform_info plat;
+        hs_error_t err = hs_populate_platform(&plat);
+        ASSERT_EQ(HS_SUCCESS, err);
+        target_t target(plat);
+
+        if (p.type != SHENG_NFA_0 && !target.has_avx512vbmi()) {
+            skip = true;
+            return;
+        }
+
+        CompileContext cc(false, false, target, Grey());
+        ReportManager rm(cc.grey);
+        ParsedExpression parsed(0, p.expr, 0, 0);
+        unique_ptr<NGWrapper> g = buildWrapper(rm, cc, parsed);
+        ASSERT_TRUE(g != nullptr);
+        clearReports(*g);
+
+        rm.setProgramOffset(0, MATCH_REPORT);
+
+        unique_ptr<raw_dfa> rdfa = buildMcClellan(*g, &rm, cc.grey);
+        ASSERT_TRUE(rdfa != nullptr);
+        raw_dfa rdfa2 = *rdfa;
+
+        switch (p.type) {
+        case SHENG_NFA_0:
+            sheng = shengCompile(*rdfa, cc, rm);
+            break;
+        case SHENG_NFA_32:
+            sheng = sheng32Compile(*rdfa, cc, rm);
+            break;
+        case SHENG_NFA_64:
+            sheng = sheng64Compile(*rdfa, cc, rm);
+            break;
+        }
+        ASSERT_TRUE(sheng != nullptr);
+        ASSERT_EQ(p.type, sheng->type);
+
+        mcclellan = mcclellanCompile(rdfa2, cc, rm);
+        ASSERT_TRUE(mcclellan != nullptr);
+
+        data = makeScanData(p.expr);
+    }
+
+    // Runs the whole of the scan data through the engine.
+    vector<u64a> scan(const NFA *nfa) {
+        auto full_state = aligned_zmalloc_unique<char>(nfa->scratchStateSize);
+        auto stream_state = aligned_zmalloc_unique<char>(nfa->streamStateSize);
+        vector<u64a> matches;
+
+        struct mq q;
+        q.nfa = nfa;
+        q.cur = 0;
+        q.end = 0;
+        q.state = full_state.get();
+        q.streamState = stream_state.get();
+        q.offset = 0;
+        q.buffer = (const u8 *)data.c_str();
+        q.length = data.size();
+        q.history = nullptr;
+        q.hlength = 0;
+        q.scratch = nullptr;
+        q.report_current = 0;
+        q.cb = onMatch;
+        q.context = &matches;
+
+        nfaQueueInitState(nfa, &q);
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_TOP, 0);
+        pushQueue(&q, MQE_END, data.size());
+        nfaQueueExec(nfa, &q, data.size());
+        return matches;
+    }
+
+    bool skip = false;
+    string data;
+    aligned_unique_ptr<NFA> sheng;
+    aligned_unique_ptr<NFA> mcclellan;
+};
+
+INSTANTIATE_TEST_CASE_P(Sheng, ShengTest, ValuesIn(shengTests));
+
+TEST_P(ShengTest, StateCount) {
+    if (skip) {
+        return;
+    }
+
+    // The pattern should need the engine we asked for, not a narrower one.
+    u32 max_states = 16;
+    if (sheng->type == SHENG_NFA_32) {
+        max_states = 32;
+    } else if (sheng->type == SHENG_NFA_64) {
+        max_states = 64;
+    }
+    EXPECT_GE(max_states, sheng->nPositions);
+    EXPECT_LT(max_states / 2, sheng->nPositions);
+}
+
+TEST_P(ShengTest, QueueExec) {
+    if (skip) {
+        return;
+    }
+
+    vector<u64a> expected = scan(mcclellan.get());
+    vector<u64a> matches = scan(sheng.get());
+    ASSERT_FALSE(expected.empty());
+    ASSERT_EQ(expected, matches);
+}
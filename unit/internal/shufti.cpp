@@ -29,6 +29,7 @@
 #include "config.h"
 
 #include <set>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "nfa/shufti.h"
@@ -276,6 +277,34 @@ TEST(Shufti, ExecMatch5) {
     }
 }
 
+TEST(Shufti, ExecMatchLong) {
+    m128 lo, hi;
+
+    CharReach chars;
+    chars.set('a');
+    chars.set('Z');
+
+    int ret = shuftiBuildMasks(chars, &lo, &hi);
+    ASSERT_NE(-1, ret);
+
+    // Long enough to exercise the wide block loops at every alignment.
+    std::vector<u8> t1(320, 'b');
+
+    for (size_t i = 0; i < 64; i++) {
+        for (size_t j = i; j < t1.size(); j++) {
+            t1[j] = 'Z';
+            const u8 *rv = shuftiExec(lo, hi, t1.data() + i,
+                                      t1.data() + t1.size());
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+            t1[j] = 'b';
+        }
+
+        const u8 *rv = shuftiExec(lo, hi, t1.data() + i,
+                                  t1.data() + t1.size());
+        ASSERT_EQ((size_t)t1.data() + t1.size(), (size_t)rv);
+    }
+}
+
 TEST(DoubleShufti, BuildMask1) {
     m128 lo1m, hi1m, lo2m, hi2m;
 
@@ -865,6 +894,138 @@ TEST(DoubleShufti, ExecMatchMixed3) {
     }
 }
 
+TEST(DoubleShufti, ExecMatchLong) {
+    m128 lo1, hi1, lo2, hi2;
+
+    flat_set<pair<u8, u8>> twobyte;
+    twobyte.insert(make_pair('x', 'y'));
+
+    bool ret = shuftiBuildDoubleMasks(CharReach(), twobyte, &lo1, &hi1, &lo2,
+                                      &hi2);
+    ASSERT_TRUE(ret);
+
+    // Long enough to exercise the wide block loops at every alignment.
+    std::vector<u8> t1(320, 'b');
+
+    for (size_t i = 0; i < 64; i++) {
+        for (size_t j = i; j + 1 < t1.size(); j++) {
+            t1[j] = 'x';
+            t1[j + 1] = 'y';
+            const u8 *rv = shuftiDoubleExec(lo1, hi1, lo2, hi2, t1.data() + i,
+                                            t1.data() + t1.size());
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+            t1[j] = 'b';
+            t1[j + 1] = 'b';
+        }
+    }
+}
+
+TEST(DistShufti, ExecNoMatch1) {
+    m128 lo1, hi1, lo2, hi2;
+
+    CharReach cr1("xX");
+    CharReach cr2("yY");
+    ASSERT_NE(-1, shuftiBuildMasks(cr1, &lo1, &hi1));
+    ASSERT_NE(-1, shuftiBuildMasks(cr2, &lo2, &hi2));
+
+    // Both classes occur, but never the right distance apart.
+    std::vector<u8> t1(200, 'b');
+    for (size_t j = 0; j + 4 < t1.size(); j += 7) {
+        t1[j] = 'x';
+        t1[j + 4] = 'Y';
+    }
+
+    for (size_t i = 0; i < 32; i++) {
+        const u8 *rv = shuftiDistExec(lo1, hi1, lo2, hi2, 3, t1.data() + i,
+                                      t1.data() + t1.size() - 3);
+        ASSERT_EQ((size_t)t1.data() + t1.size() - 3, (size_t)rv);
+    }
+}
+
+TEST(DistShufti, ExecMatchLong) {
+    m128 lo1, hi1, lo2, hi2;
+
+    CharReach cr1("abc");
+    CharReach cr2("xyz");
+    ASSERT_NE(-1, shuftiBuildMasks(cr1, &lo1, &hi1));
+    ASSERT_NE(-1, shuftiBuildMasks(cr2, &lo2, &hi2));
+
+    // Long enough to exercise the wide block loops at every alignment, and
+    // with a lone first-class byte just ahead of each pair.
+    std::vector<u8> t1(320, 'q');
+
+    for (u8 dist = 1; dist <= 8; dist++) {
+        const u8 *end = t1.data() + t1.size() - dist;
+        for (size_t i = 0; i < 64; i++) {
+            for (size_t j = i; j + dist < t1.size(); j++) {
+                if (j > i) {
+                    t1[j - 1] = 'c';
+                }
+                t1[j] = 'b';
+                t1[j + dist] = 'y';
+                const u8 *rv = shuftiDistExec(lo1, hi1, lo2, hi2, dist,
+                                              t1.data() + i, end);
+                ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+                t1[j + dist] = 'q';
+                t1[j] = 'q';
+                if (j > i) {
+                    t1[j - 1] = 'q';
+                }
+            }
+        }
+    }
+}
+
+TEST(ShuftiVermDouble, ExecNoMatch1) {
+    m128 lo, hi;
+
+    CharReach cr("ab");
+    ASSERT_NE(-1, shuftiBuildMasks(cr, &lo, &hi));
+
+    // Both bytes of the pair occur, but never together.
+    std::vector<u8> t1(200, 'q');
+    for (size_t j = 0; j + 3 < t1.size(); j += 5) {
+        t1[j] = 'x';
+        t1[j + 2] = 'y';
+    }
+
+    for (size_t i = 0; i < 32; i++) {
+        const u8 *rv = shuftiVermDoubleExec(lo, hi, 'x', 'y', t1.data() + i,
+                                            t1.data() + t1.size() - 1);
+        ASSERT_EQ((size_t)t1.data() + t1.size() - 1, (size_t)rv);
+    }
+}
+
+TEST(ShuftiVermDouble, ExecMatchLong) {
+    m128 lo, hi;
+
+    CharReach cr("ab");
+    ASSERT_NE(-1, shuftiBuildMasks(cr, &lo, &hi));
+
+    // Long enough to exercise the wide block loops at every alignment.
+    std::vector<u8> t1(320, 'q');
+    const u8 *end = t1.data() + t1.size() - 1;
+
+    for (size_t i = 0; i < 64; i++) {
+        for (size_t j = i; j + 1 < t1.size(); j++) {
+            // A pair.
+            t1[j] = 'x';
+            t1[j + 1] = 'y';
+            const u8 *rv = shuftiVermDoubleExec(lo, hi, 'x', 'y',
+                                                t1.data() + i, end);
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+            t1[j + 1] = 'q';
+
+            // A byte from the class, behind a lone first byte of the pair.
+            t1[j + 1] = 'b';
+            rv = shuftiVermDoubleExec(lo, hi, 'x', 'y', t1.data() + i, end);
+            ASSERT_EQ((size_t)t1.data() + j + 1, (size_t)rv);
+            t1[j] = 'q';
+            t1[j + 1] = 'q';
+        }
+    }
+}
+
 TEST(ReverseShufti, ExecNoMatch1) {
     m128 lo, hi;
 
@@ -1072,3 +1233,30 @@ TEST(ReverseShufti, ExecMatch6) {
         ASSERT_EQ((const u8 *)t1 + i, rv);
     }
 }
+
+TEST(ReverseShufti, ExecMatchLong) {
+    m128 lo, hi;
+
+    CharReach chars;
+    chars.set('a');
+    chars.set('Z');
+
+    int ret = shuftiBuildMasks(chars, &lo, &hi);
+    ASSERT_NE(-1, ret);
+
+    // Long enough to exercise the wide block loops at every alignment.
+    std::vector<u8> t1(320, 'b');
+
+    for (size_t i = 0; i < 64; i++) {
+        const u8 *end = t1.data() + t1.size() - i;
+        for (size_t j = 0; j < t1.size() - i; j++) {
+            t1[j] = 'Z';
+            const u8 *rv = rshuftiExec(lo, hi, t1.data(), end);
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+            t1[j] = 'b';
+        }
+
+        const u8 *rv = rshuftiExec(lo, hi, t1.data(), end);
+        ASSERT_EQ((size_t)t1.data() - 1, (size_t)rv);
+    }
+}
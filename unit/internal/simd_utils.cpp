@@ -54,6 +54,12 @@ Mask setbit(unsigned int bit) {
     return cf.simd;
 }
 
+// Mask with the low n bits on, for n <= 32.
+static
+u32 wordMask(unsigned int n) {
+    return n >= 32 ? ~0U : (1U << n) - 1;
+}
+
 // Parameterized tests follow!
 //
 // Irritatingly we have to define a whole bunch of overrides here... because
@@ -65,6 +71,7 @@ struct simd_zeroes {
     operator m256() { return zeroes256(); }
     operator m384() { return zeroes384(); }
     operator m512() { return zeroes512(); }
+    operator m1024() { return zeroes1024(); }
 };
 
 struct simd_ones {
@@ -72,83 +79,101 @@ struct simd_ones {
     operator m256() { return ones256(); }
     operator m384() { return ones384(); }
     operator m512() { return ones512(); }
+    operator m1024() { return ones1024(); }
 };
 
 bool simd_diff(const m128 &a, const m128 &b) { return !!diff128(a, b); }
 bool simd_diff(const m256 &a, const m256 &b) { return !!diff256(a, b); }
 bool simd_diff(const m384 &a, const m384 &b) { return !!diff384(a, b); }
 bool simd_diff(const m512 &a, const m512 &b) { return !!diff512(a, b); }
+bool simd_diff(const m1024 &a, const m1024 &b) { return !!diff1024(a, b); }
 bool simd_isnonzero(const m128 &a) { return !!isnonzero128(a); }
 bool simd_isnonzero(const m256 &a) { return !!isnonzero256(a); }
 bool simd_isnonzero(const m384 &a) { return !!isnonzero384(a); }
 bool simd_isnonzero(const m512 &a) { return !!isnonzero512(a); }
+bool simd_isnonzero(const m1024 &a) { return !!isnonzero1024(a); }
 m128 simd_and(const m128 &a, const m128 &b) { return and128(a, b); }
 m256 simd_and(const m256 &a, const m256 &b) { return and256(a, b); }
 m384 simd_and(const m384 &a, const m384 &b) { return and384(a, b); }
 m512 simd_and(const m512 &a, const m512 &b) { return and512(a, b); }
+m1024 simd_and(const m1024 &a, const m1024 &b) { return and1024(a, b); }
 m128 simd_or(const m128 &a, const m128 &b) { return or128(a, b); }
 m256 simd_or(const m256 &a, const m256 &b) { return or256(a, b); }
 m384 simd_or(const m384 &a, const m384 &b) { return or384(a, b); }
 m512 simd_or(const m512 &a, const m512 &b) { return or512(a, b); }
+m1024 simd_or(const m1024 &a, const m1024 &b) { return or1024(a, b); }
 m128 simd_xor(const m128 &a, const m128 &b) { return xor128(a, b); }
 m256 simd_xor(const m256 &a, const m256 &b) { return xor256(a, b); }
 m384 simd_xor(const m384 &a, const m384 &b) { return xor384(a, b); }
 m512 simd_xor(const m512 &a, const m512 &b) { return xor512(a, b); }
+m1024 simd_xor(const m1024 &a, const m1024 &b) { return xor1024(a, b); }
 m128 simd_andnot(const m128 &a, const m128 &b) { return andnot128(a, b); }
 m256 simd_andnot(const m256 &a, const m256 &b) { return andnot256(a, b); }
 m384 simd_andnot(const m384 &a, const m384 &b) { return andnot384(a, b); }
 m512 simd_andnot(const m512 &a, const m512 &b) { return andnot512(a, b); }
+m1024 simd_andnot(const m1024 &a, const m1024 &b) { return andnot1024(a, b); }
 m128 simd_not(const m128 &a) { return not128(a); }
 m256 simd_not(const m256 &a) { return not256(a); }
 m384 simd_not(const m384 &a) { return not384(a); }
 m512 simd_not(const m512 &a) { return not512(a); }
+m1024 simd_not(const m1024 &a) { return not1024(a); }
 void simd_clearbit(m128 *a, unsigned int i) { return clearbit128(a, i); }
 void simd_clearbit(m256 *a, unsigned int i) { return clearbit256(a, i); }
 void simd_clearbit(m384 *a, unsigned int i) { return clearbit384(a, i); }
 void simd_clearbit(m512 *a, unsigned int i) { return clearbit512(a, i); }
+void simd_clearbit(m1024 *a, unsigned int i) { return clearbit1024(a, i); }
 void simd_setbit(m128 *a, unsigned int i) { return setbit128(a, i); }
 void simd_setbit(m256 *a, unsigned int i) { return setbit256(a, i); }
 void simd_setbit(m384 *a, unsigned int i) { return setbit384(a, i); }
 void simd_setbit(m512 *a, unsigned int i) { return setbit512(a, i); }
+void simd_setbit(m1024 *a, unsigned int i) { return setbit1024(a, i); }
 bool simd_testbit(const m128 *a, unsigned int i) { return testbit128(a, i); }
 bool simd_testbit(const m256 *a, unsigned int i) { return testbit256(a, i); }
 bool simd_testbit(const m384 *a, unsigned int i) { return testbit384(a, i); }
 bool simd_testbit(const m512 *a, unsigned int i) { return testbit512(a, i); }
+bool simd_testbit(const m1024 *a, unsigned int i) { return testbit1024(a, i); }
 u32 simd_diffrich(const m128 &a, const m128 &b) { return diffrich128(a, b); }
 u32 simd_diffrich(const m256 &a, const m256 &b) { return diffrich256(a, b); }
 u32 simd_diffrich(const m384 &a, const m384 &b) { return diffrich384(a, b); }
 u32 simd_diffrich(const m512 &a, const m512 &b) { return diffrich512(a, b); }
+u32 simd_diffrich(const m1024 &a, const m1024 &b) { return diffrich1024(a, b); }
 u32 simd_diffrich64(const m128 &a, const m128 &b) { return diffrich64_128(a, b); }
 u32 simd_diffrich64(const m256 &a, const m256 &b) { return diffrich64_256(a, b); }
 u32 simd_diffrich64(const m384 &a, const m384 &b) { return diffrich64_384(a, b); }
 u32 simd_diffrich64(const m512 &a, const m512 &b) { return diffrich64_512(a, b); }
+u32 simd_diffrich64(const m1024 &a, const m1024 &b) { return diffrich64_1024(a, b); }
 void simd_store(void *ptr, const m128 &a) { store128(ptr, a); }
 void simd_store(void *ptr, const m256 &a) { store256(ptr, a); }
 void simd_store(void *ptr, const m384 &a) { store384(ptr, a); }
 void simd_store(void *ptr, const m512 &a) { store512(ptr, a); }
+void simd_store(void *ptr, const m1024 &a) { store1024(ptr, a); }
 void simd_load(m128 *a, const void *ptr) { *a = load128(ptr); }
 void simd_load(m256 *a, const void *ptr) { *a = load256(ptr); }
 void simd_load(m384 *a, const void *ptr) { *a = load384(ptr); }
 void simd_load(m512 *a, const void *ptr) { *a = load512(ptr); }
+void simd_load(m1024 *a, const void *ptr) { *a = load1024(ptr); }
 void simd_loadu(m128 *a, const void *ptr) { *a = loadu128(ptr); }
 void simd_loadu(m256 *a, const void *ptr) { *a = loadu256(ptr); }
 void simd_loadu(m384 *a, const void *ptr) { *a = loadu384(ptr); }
 void simd_loadu(m512 *a, const void *ptr) { *a = loadu512(ptr); }
+void simd_loadu(m1024 *a, const void *ptr) { *a = loadu1024(ptr); }
 void simd_storebytes(void *ptr, const m128 &a, unsigned i) { storebytes128(ptr, a, i); }
 void simd_storebytes(void *ptr, const m256 &a, unsigned i) { storebytes256(ptr, a, i); }
 void simd_storebytes(void *ptr, const m384 &a, unsigned i) { storebytes384(ptr, a, i); }
 void simd_storebytes(void *ptr, const m512 &a, unsigned i) { storebytes512(ptr, a, i); }
+void simd_storebytes(void *ptr, const m1024 &a, unsigned i) { storebytes1024(ptr, a, i); }
 void simd_loadbytes(m128 *a, const void *ptr, unsigned i) { *a = loadbytes128(ptr, i); }
 void simd_loadbytes(m256 *a, const void *ptr, unsigned i) { *a = loadbytes256(ptr, i); }
 void simd_loadbytes(m384 *a, const void *ptr, unsigned i) { *a = loadbytes384(ptr, i); }
 void simd_loadbytes(m512 *a, const void *ptr, unsigned i) { *a = loadbytes512(ptr, i); }
+void simd_loadbytes(m1024 *a, const void *ptr, unsigned i) { *a = loadbytes1024(ptr, i); }
 
 template<typename T>
 class SimdUtilsTest : public testing::Test {
     // empty
 };
 
-typedef ::testing::Types<m128, m256, m384, m512> SimdTypes;
+typedef ::testing::Types<m128, m256, m384, m512, m1024> SimdTypes;
 TYPED_TEST_CASE(SimdUtilsTest, SimdTypes);
 
 //
@@ -474,7 +499,7 @@ TYPED_TEST(SimdUtilsTest, diffrich) {
     }
 
     // All-zeroes and all-ones differ in all words
-    EXPECT_EQ((1U << (total_bits / 32)) - 1, simd_diffrich(zeroes, ones));
+    EXPECT_EQ(wordMask(total_bits / 32), simd_diffrich(zeroes, ones));
 
     // Cases that differ in one 32-bit word
     for (unsigned i = 0; i < total_bits; i++) {
@@ -501,7 +526,7 @@ TYPED_TEST(SimdUtilsTest, diffrich64) {
 
     // All-zeroes and all-ones differ in all words, which will result in every
     // second bit being on.
-    EXPECT_EQ(((1U << (total_bits / 32)) - 1) & 0x55555555u,
+    EXPECT_EQ(wordMask(total_bits / 32) & 0x55555555u,
               simd_diffrich64(zeroes, ones));
 
     // Cases that differ in one 64-bit word
@@ -598,7 +623,7 @@ TEST(SimdUtilsTest, movq) {
     ASSERT_EQ(0, memcmp(cmp, &simd, sizeof(simd)));
     ASSERT_EQ(0, memcmp(cmp, &r, sizeof(r)));
 
-    simd = _mm_set_epi64x(~0LL, 0x123456789abcdef);
+    simd = set64x2(~0ULL, 0x123456789abcdef);
     r = movq(simd);
     ASSERT_EQ(r, 0x123456789abcdef);
 }
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include "gtest/gtest.h"
+
+#include "grey.h"
+#include "compiler/compiler.h"
+#include "nfa/mcclellancompile.h"
+#include "nfa/nfa_api.h"
+#include "nfa/nfa_api_util.h"
+#include "nfa/nfa_internal.h"
+#include "nfa/rdfa.h"
+#include "nfa/shengcompile.h"
+#include "nfagraph/ng.h"
+#include "nfagraph/ng_mcclellan.h"
+#include "nfagraph/ng_util.h"
+#include "util/alloc.h"
+#include "util/target_info.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace testing;
+using namespace ue2;
+
+struct StateMapTestParams {
+    int type; //!< expected engine type (enum NFAEngineType)
+    const char *expr;
+    const char *alphabet; //!< characters to build the scan data from
+};
+
+static const StateMapTestParams stateMapTests[] = {
+    { SHENG_NFA_0, "a[ab]{2}c", "abcx" },
+    { SHENG_NFA_0, "ab[^a]c", "abcx" },
+    { MCCLELLAN_NFA_8, "a[ab]{2}c", "abcx" },
+    { MCCLELLAN_NFA_8, "a[ab]{6}c|b[^a]{3}a", "abcx" },
+};
+
+static
+int onMatch(u64a, u64a, ReportID, void *) {
+    return MO_CONTINUE_MATCHING;
+}
+
+class StateMapTest : public TestWithParam<StateMapTestParams> {
+protected:
+    virtual void SetUp() {
+        const StateMapTestParams &p = GetParam();
+
+        CompileContext cc(false, false, get_current_target(), Grey());
+        ReportManager rm(cc.grey);
+        ParsedExpression parsed(0, p.expr, 0, 0);
+        unique_ptr<NGWrapper> g = buildWrapper(rm, cc, parsed);
+        ASSERT_TRUE(g != nullptr);
+        clearReports(*g);
+
+        rm.setProgramOffset(0, 0);
+
+        unique_ptr<raw_dfa> rdfa = buildMcClellan(*g, &rm, cc.grey);
+        ASSERT_TRUE(rdfa != nullptr);
+
+        if (p.type == SHENG_NFA_0) {
+            nfa = shengCompile(*rdfa, cc, rm);
+        } else {
+            nfa = mcclellanCompile(*rdfa, cc, rm);
+        }
+        ASSERT_TRUE(nfa != nullptr);
+        ASSERT_EQ(p.type, nfa->type);
+
+        const string alphabet(p.alphabet);
+        mt19937 prng(99);
+        for (u32 i = 0; i < 4096; i++) {
+            data += alphabet[prng() % alphabet.size()];
+        }
+    }
+
+    // Runs the engine over the data from the given stream state.
+    u8 run(u8 start, size_t off, size_t len) {
+        const NFA *n = nfa.get();
+        auto full_state = aligned_zmalloc_unique<char>(n->scratchStateSize);
+        char stream_state = (char)start;
+
+        struct mq q;
+        q.nfa = n;
+        q.cur = 0;
+        q.end = 0;
+        q.state = full_state.get();
+        q.streamState = &stream_state;
+        q.offset = off + 1; // not at stream start
+        q.buffer = (const u8 *)data.c_str() + off;
+        q.length = len;
+        q.history = nullptr;
+        q.hlength = 0;
+        q.scratch = nullptr;
+        q.report_current = 0;
+        q.cb = onMatch;
+        q.context = nullptr;
+
+        nfaExpandState(n, full_state.get(), &stream_state, q.offset, 0);
+        pushQueue(&q, MQE_START, 0);
+        pushQueue(&q, MQE_END, len);
+        nfaQueueExec(n, &q, len);
+        nfaQueueCompressState(n, &q, len);
+        return (u8)stream_state;
+    }
+
+    string data;
+    aligned_unique_ptr<NFA> nfa;
+};
+
+INSTANTIATE_TEST_CASE_P(StateMap, StateMapTest, ValuesIn(stateMapTests));
+
+TEST_P(StateMapTest, MatchesScan) {
+    const NFA *n = nfa.get();
+    const u32 size = nfaStateMapSize(n);
+    ASSERT_NE(0U, size);
+
+    for (size_t len : {1, 3, 17, 100}) {
+        vector<u8> map(size);
+        ASSERT_TRUE(nfaBuildStateMap(n, (const u8 *)data.c_str(), len,
+                                     map.data()));
+
+        // Start from every state, skipping the dead state of McClellan.
+        for (u32 i = n->type == MCCLELLAN_NFA_8 ? 1 : 0; i < size; i++) {
+            char state = (char)i;
+            nfaApplyStateMap(n, map.data(), &state);
+            EXPECT_EQ(run(i, 0, len), (u8)state) << "state " << i;
+        }
+    }
+}
+
+TEST_P(StateMapTest, Compose) {
+    const NFA *n = nfa.get();
+    const u32 size = nfaStateMapSize(n);
+    ASSERT_NE(0U, size);
+    const u8 *buf = (const u8 *)data.c_str();
+
+    vector<u8> expected(size);
+    nfaBuildStateMap(n, buf, data.size(), expected.data());
+
+    // Build maps for uneven pieces, then combine them pairwise as parallel
+    // workers would.
+    vector<vector<u8>> maps;
+    const size_t piece = 301;
+    for (size_t off = 0; off < data.size(); off += piece) {
+        maps.emplace_back(size);
+        nfaBuildStateMap(n, buf + off, min(piece, data.size() - off),
+                         maps.back().data());
+    }
+    while (maps.size() > 1) {
+        vector<vector<u8>> next;
+        for (size_t i = 0; i < maps.size(); i += 2) {
+            if (i + 1 < maps.size()) {
+                nfaComposeStateMaps(n, maps[i].data(), maps[i + 1].data());
+            }
+            next.push_back(move(maps[i]));
+        }
+        maps.swap(next);
+    }
+
+    EXPECT_EQ(expected, maps[0]);
+}
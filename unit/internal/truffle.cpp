@@ -28,6 +28,8 @@
 
 #include "config.h"
 
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "nfa/truffle.h"
 #include "nfa/trufflecompile.h"
@@ -383,6 +385,33 @@ TEST(Truffle, ExecMatch7) {
     }
 }
 
+TEST(Truffle, ExecMatchLong) {
+    m128 mask1, mask2;
+
+    CharReach chars;
+    chars.set('a');
+    chars.set(0xf0);
+
+    truffleBuildMasks(chars, &mask1, &mask2);
+
+    // Long enough to exercise the wide block loops at every alignment.
+    std::vector<u8> t1(320, 'b');
+
+    for (size_t i = 0; i < 64; i++) {
+        for (size_t j = i; j < t1.size(); j++) {
+            t1[j] = 0xf0;
+            const u8 *rv = truffleExec(mask1, mask2, t1.data() + i,
+                                       t1.data() + t1.size());
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+            t1[j] = 'b';
+        }
+
+        const u8 *rv = truffleExec(mask1, mask2, t1.data() + i,
+                                   t1.data() + t1.size());
+        ASSERT_EQ((size_t)t1.data() + t1.size(), (size_t)rv);
+    }
+}
+
 TEST(ReverseTruffle, ExecNoMatch1) {
     m128 mask1, mask2;
 
@@ -614,3 +643,29 @@ TEST(ReverseTruffle, ExecMatch5) {
         ASSERT_EQ((const u8 *)t1 + i, rv);
     }
 }
+
+TEST(ReverseTruffle, ExecMatchLong) {
+    m128 mask1, mask2;
+
+    CharReach chars;
+    chars.set('a');
+    chars.set(0xf0);
+
+    truffleBuildMasks(chars, &mask1, &mask2);
+
+    // Long enough to exercise the wide block loops at every alignment.
+    std::vector<u8> t1(320, 'b');
+
+    for (size_t i = 0; i < 64; i++) {
+        const u8 *end = t1.data() + t1.size() - i;
+        for (size_t j = 0; j < t1.size() - i; j++) {
+            t1[j] = 0xf0;
+            const u8 *rv = rtruffleExec(mask1, mask2, t1.data(), end);
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+            t1[j] = 'b';
+        }
+
+        const u8 *rv = rtruffleExec(mask1, mask2, t1.data(), end);
+        ASSERT_EQ((size_t)t1.data() - 1, (size_t)rv);
+    }
+}
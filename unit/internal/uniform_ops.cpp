@@ -46,6 +46,9 @@ TEST(Uniform, Sizes) {
     EXPECT_EQ(16U, sizeof(m128));
     EXPECT_EQ(32U, sizeof(m256));
     EXPECT_EQ(64U, sizeof(m512));
+
+    // m512 must have the same layout with and without AVX-512.
+    EXPECT_EQ(64U, alignof(m512));
 }
 
 TEST(Uniform, loadstore_u8) {
@@ -31,6 +31,7 @@
 #include "parser/utf8_validate.h"
 
 #include "ue2common.h"
+#include "util/utf8_check.h"
 #include "util/string_util.h"
 
 #include "gtest/gtest.h"
@@ -120,3 +121,36 @@ TEST_P(ValidUtf8Test, check) {
     ASSERT_EQ(info.is_valid, isValidUtf8(info.str.c_str()))
         << "String is: " << printable(info.str) << std::endl;
 }
+
+// The runtime check should agree with the parser, except that it accepts
+// DEL, which the parser does not allow in patterns.
+TEST_P(ValidUtf8Test, runtime) {
+    const auto &info = GetParam();
+    if (info.str == "\x7f") {
+        return;
+    }
+    const u8 *s = (const u8 *)info.str.c_str();
+    const size_t len = info.str.size();
+    ASSERT_EQ(info.is_valid, utf8_check(s, len) == len)
+        << "String is: " << printable(info.str) << std::endl;
+}
+
+// Errors should be found at every position, in and after runs of ASCII long
+// enough to take the vector path.
+TEST(Utf8Check, ErrorOffsets) {
+    const std::string valid = "\xc3\xa0\xe2\x89\xa2\xf0\xa3\x8e\xb4";
+    for (size_t prefix = 0; prefix < 40; prefix++) {
+        std::string str(prefix, 'a');
+        str += valid;
+        ASSERT_EQ(str.size(), utf8_check((const u8 *)str.c_str(), str.size()));
+
+        // A stray continuation byte.
+        std::string bad = str + std::string(20, 'b') + "\x80" + valid;
+        ASSERT_EQ(str.size() + 20,
+                  utf8_check((const u8 *)bad.c_str(), bad.size()));
+
+        // A sequence cut short by the end of the data.
+        bad = str + "\xf0\xa3\x8e";
+        ASSERT_EQ(str.size(), utf8_check((const u8 *)bad.c_str(), bad.size()));
+    }
+}
@@ -28,6 +28,8 @@
 
 #include "config.h"
 
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "nfa/vermicelli.h"
 
@@ -518,3 +520,40 @@ TEST(DoubleVermicelliMasked, Exec4) {
     }
 }
 
+TEST(Vermicelli, ExecMatchLong) {
+    // Long enough to exercise the wide block loops at every alignment.
+    std::vector<u8> t1(320, 'b');
+    std::vector<u8> t2(320, 'a');
+
+    for (size_t i = 0; i < 64; i++) {
+        const u8 *buf = t1.data() + i;
+        const u8 *buf_end = t1.data() + t1.size();
+        for (size_t j = i; j + 1 < t1.size(); j++) {
+            t1[j] = 'a';
+            t1[j + 1] = 'z';
+            const u8 *rv = vermicelliExec('a', 0, buf, buf_end);
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+
+            rv = vermicelliExec('A', 1, buf, buf_end);
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+
+            rv = vermicelliDoubleExec('a', 'z', 0, buf, buf_end);
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+
+            rv = vermicelliDoubleExec('A', 'Z', 1, buf, buf_end);
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+
+            rv = vermicelliDoubleMaskedExec('a', 'z', 0xff, 0xff, buf,
+                                            buf_end);
+            ASSERT_EQ((size_t)t1.data() + j, (size_t)rv);
+            t1[j] = 'b';
+            t1[j + 1] = 'b';
+
+            t2[j] = 'b';
+            rv = nvermicelliExec('a', 0, t2.data() + i,
+                                 t2.data() + t2.size());
+            ASSERT_EQ((size_t)t2.data() + j, (size_t)rv);
+            t2[j] = 'a';
+        }
+    }
+}
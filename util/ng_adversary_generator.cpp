@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Worst-case (adversarial) corpus generation.
+ */
+
+#include "config.h"
+
+#include "ng_adversary_generator.h"
+
+#include "nfagraph/ng_holder.h"
+#include "ue2common.h"
+#include "util/charreach.h"
+#include "util/graph.h"
+#include "util/graph_range.h"
+
+#include <set>
+
+using namespace std;
+using namespace ue2;
+
+/** \brief Maximum number of vertices visited by one walk. */
+static const u32 MAX_WALK_LEN = 1000;
+
+/** \brief Walks at random from start until an edge to accept is taken,
+ * recording the non-special vertices visited. Returns false if no accept was
+ * reached. */
+static
+bool randomWalk(const NGHolder &g, CorpusProperties &props,
+                vector<NFAVertex> &path) {
+    NFAVertex u = g.start;
+    for (u32 steps = 0; steps < MAX_WALK_LEN; steps++) {
+        vector<NFAVertex> succ;
+        bool can_accept = false;
+        for (auto v : adjacent_vertices_range(u, g)) {
+            if (v == g.accept || v == g.acceptEod) {
+                can_accept = true;
+            } else if (v != u) {
+                // Self-loops are followed by pumping, not by walking.
+                succ.push_back(v);
+            }
+        }
+
+        // Prefer to carry on past an accept some of the time, so that longer
+        // paths through the graph are represented.
+        if (can_accept && (succ.empty() || !props.rand(0, 3))) {
+            return true;
+        }
+        if (succ.empty()) {
+            return false;
+        }
+
+        u = succ[props.rand(0, succ.size() - 1)];
+        if (!is_special(u, g)) {
+            path.push_back(u);
+        }
+    }
+    return false;
+}
+
+static
+u8 pickChar(const CharReach &cr, CorpusProperties &props) {
+    assert(cr.any());
+    return (u8)cr.find_nth(props.rand(0, cr.count() - 1));
+}
+
+/** \brief Turns a path into a near miss: every vertex matches except the
+ * last one whose reach is not the full alphabet, which fails. */
+static
+string nearMiss(const NGHolder &g, const vector<NFAVertex> &path, u32 pump,
+                CorpusProperties &props) {
+    size_t fail = path.size();
+    for (size_t i = path.size(); i > 0; i--) {
+        if (!g[path[i - 1]].char_reach.all()) {
+            fail = i - 1;
+            break;
+        }
+    }
+
+    string s;
+    for (size_t i = 0; i < path.size(); i++) {
+        NFAVertex v = path[i];
+        const CharReach &cr = g[v].char_reach;
+        if (i == fail) {
+            s.push_back(pickChar(~cr, props));
+            break;
+        }
+        s.push_back(pickChar(cr, props));
+        if (hasSelfLoop(v, g)) {
+            for (u32 j = 0; j < pump; j++) {
+                s.push_back(pickChar(cr, props));
+            }
+        }
+    }
+    return s;
+}
+
+void generateAdversarialCorpus(const NGHolder &graph, CorpusProperties &props,
+                               vector<string> &data) {
+    const u32 pump = props.getCycleLimit().second;
+
+    // Unique strings only; as in the corpus generator, give up when the walks
+    // stop producing anything new.
+    set<string> seen;
+    u32 attempts = 0;
+    while (seen.size() < props.corpusLimit &&
+           attempts < props.corpusLimit * 4) {
+        attempts++;
+        vector<NFAVertex> path;
+        if (!randomWalk(graph, props, path) || path.empty()) {
+            continue;
+        }
+        string s = nearMiss(graph, path, pump, props);
+        if (seen.insert(s).second) {
+            DEBUG_PRINTF("near miss %zu: %zu bytes\n", seen.size(), s.size());
+            data.push_back(move(s));
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * \brief Worst-case (adversarial) corpus generation.
+ *
+ * Where the ordinary corpus generator produces data that matches, this
+ * produces data that almost matches: strings that follow a path through the
+ * graph nearly to accept and then fail. Such data drives literal confirms,
+ * engine activations and catchup without the early exits that matches and
+ * exhaustion give, so it approximates the worst-case scan throughput of a
+ * database.
+ */
+
+#ifndef NG_ADVERSARY_GENERATOR_H_
+#define NG_ADVERSARY_GENERATOR_H_
+
+#include "ng_corpus_properties.h"
+
+#include <string>
+#include <vector>
+
+namespace ue2 {
+
+class NGHolder;
+
+} // namespace ue2
+
+/** \brief Generate up to props.corpusLimit near-miss strings for \a graph,
+ * appending them to \a data.
+ *
+ * Each string follows a random path from start towards accept, matching
+ * every vertex except the last one that can be made to fail. Cyclic vertices
+ * are pumped (by props.getCycleLimit().second characters) to keep their
+ * states alive. Graphs that cannot be made to fail contribute full matches
+ * instead.
+ */
+void generateAdversarialCorpus(const ue2::NGHolder &graph,
+                               CorpusProperties &props,
+                               std::vector<std::string> &data);
+
+#endif